@@ -53,6 +53,14 @@ Java_com_google_android_filament_Material_nCreateInstance(JNIEnv*, jclass,
     return (jlong) material->createInstance();
 }
 
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_com_google_android_filament_Material_nCompile(JNIEnv*, jclass,
+        jlong nativeMaterial, jint variants) {
+    Material* material = (Material*) nativeMaterial;
+    return (jlong) material->compile((uint8_t) variants);
+}
+
 extern "C"
 JNIEXPORT jstring JNICALL
 Java_com_google_android_filament_Material_nGetName(JNIEnv* env, jclass, jlong nativeMaterial) {
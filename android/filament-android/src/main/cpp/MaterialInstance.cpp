@@ -26,8 +26,15 @@
 #include <math/vec3.h>
 #include <math/vec4.h>
 
+#include <string.h>
+
+#include "NioUtils.h"
+
 using namespace filament;
 
+static_assert(sizeof(jlong) == sizeof(MaterialInstance::ParameterHandle),
+        "jlong and MaterialInstance::ParameterHandle are not compatible!!");
+
 template<typename T>
 static void setParameter(JNIEnv* env, jlong nativeMaterialInstance, jstring name_, T v) {
     MaterialInstance* instance = (MaterialInstance*) nativeMaterialInstance;
@@ -179,6 +186,54 @@ Java_com_google_android_filament_MaterialInstance_nSetFloatParameterArray(JNIEnv
     env->ReleaseStringUTFChars(name_, name);
 }
 
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_com_google_android_filament_MaterialInstance_nGetParameterHandle(JNIEnv *env, jclass,
+        jlong nativeMaterialInstance, jstring name_) {
+    MaterialInstance* instance = (MaterialInstance*) nativeMaterialInstance;
+    const char *name = env->GetStringUTFChars(name_, 0);
+    MaterialInstance::ParameterHandle handle = instance->getParameterHandle(name);
+    env->ReleaseStringUTFChars(name_, name);
+    if (!handle.isValid()) {
+        return 0;
+    }
+    jlong packed = 0;
+    memcpy(&packed, &handle, sizeof(handle));
+    return packed;
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_com_google_android_filament_MaterialInstance_nSetFloatParameters(JNIEnv *env, jclass,
+        jlong nativeMaterialInstance, jlongArray handles_, jint element,
+        jobject values, jint remaining, jint count) {
+    MaterialInstance* instance = (MaterialInstance*) nativeMaterialInstance;
+
+    // same layout as nSetFloatParameterArray()
+    static constexpr size_t sizes[] = { 1, 2, 3, 4, 9, 16 };
+    AutoBuffer nioBuffer(env, values, jint(count * sizes[element]));
+    if (nioBuffer.getSize() > (remaining << nioBuffer.getShift())) {
+        // BufferOverflowException
+        return -1;
+    }
+
+    // the handles are packed as they are, see nGetParameterHandle()
+    jlong* packed = env->GetLongArrayElements(handles_, NULL);
+    auto const* handles = reinterpret_cast<MaterialInstance::ParameterHandle const*>(packed);
+    void const* v = nioBuffer.getData();
+    switch (element) {
+        case 0: instance->setParameters(handles, (float const*) v, count); break;
+        case 1: instance->setParameters(handles, (math::float2 const*) v, count); break;
+        case 2: instance->setParameters(handles, (math::float3 const*) v, count); break;
+        case 3: instance->setParameters(handles, (math::float4 const*) v, count); break;
+        case 4: instance->setParameters(handles, (math::mat3f const*) v, count); break;
+        case 5: instance->setParameters(handles, (math::mat4f const*) v, count); break;
+        default: break;
+    }
+    env->ReleaseLongArrayElements(handles_, packed, JNI_ABORT);
+    return 0;
+}
+
 extern "C"
 JNIEXPORT void JNICALL
 Java_com_google_android_filament_MaterialInstance_nSetParameterTexture(
@@ -35,6 +35,23 @@ Java_com_google_android_filament_Renderer_nBeginFrame(JNIEnv *, jclass, jlong na
     return (jboolean) renderer->beginFrame(swapChain);
 }
 
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_google_android_filament_Renderer_nBeginFrameAt(JNIEnv *, jclass, jlong nativeRenderer,
+        jlong nativeSwapChain, jlong frameTimeNanos) {
+    Renderer *renderer = (Renderer *) nativeRenderer;
+    SwapChain *swapChain = (SwapChain *) nativeSwapChain;
+    return (jboolean) renderer->beginFrame(swapChain, (uint64_t) frameTimeNanos);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_filament_Renderer_nSetDisplayInfo(JNIEnv *, jclass, jlong nativeRenderer,
+        jfloat refreshRate) {
+    Renderer *renderer = (Renderer *) nativeRenderer;
+    Renderer::DisplayInfo info;
+    info.refreshRate = refreshRate;
+    renderer->setDisplayInfo(info);
+}
+
 extern "C" JNIEXPORT void JNICALL
 Java_com_google_android_filament_Renderer_nEndFrame(JNIEnv *, jclass, jlong nativeRenderer) {
     Renderer *renderer = (Renderer *) nativeRenderer;
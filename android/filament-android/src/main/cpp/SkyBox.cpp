@@ -40,6 +40,20 @@ Java_com_google_android_filament_Skybox_nBuilderEnvironment(JNIEnv *env, jclass
     builder->environment(texture);
 }
 
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_filament_Skybox_nBuilderEnvironmentLevel(JNIEnv *env, jclass type,
+        jlong nativeSkyBoxBuilder, jint level) {
+    Skybox::Builder *builder = (Skybox::Builder *) nativeSkyBoxBuilder;
+    builder->environmentLevel((uint8_t) level);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_filament_Skybox_nBuilderIrradiance(JNIEnv *env, jclass type,
+        jlong nativeSkyBoxBuilder, jboolean enabled) {
+    Skybox::Builder *builder = (Skybox::Builder *) nativeSkyBoxBuilder;
+    builder->irradiance(enabled);
+}
+
 extern "C" JNIEXPORT void JNICALL
 Java_com_google_android_filament_Skybox_nBuilderShowSun(JNIEnv *env, jclass type,
         jlong nativeSkyBoxBuilder, jboolean show) {
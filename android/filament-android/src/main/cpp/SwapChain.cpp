@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <jni.h>
+
+#include <filament/SwapChain.h>
+
+using namespace filament;
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_filament_SwapChain_nSetFrameLatency(JNIEnv *, jclass,
+        jlong nativeSwapChain, jint latency) {
+    SwapChain *swapChain = (SwapChain *) nativeSwapChain;
+    swapChain->setFrameLatency((uint8_t) latency);
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_google_android_filament_SwapChain_nGetFrameLatency(JNIEnv *, jclass,
+        jlong nativeSwapChain) {
+    SwapChain *swapChain = (SwapChain *) nativeSwapChain;
+    return (jint) swapChain->getFrameLatency();
+}
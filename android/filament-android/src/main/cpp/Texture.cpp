@@ -16,6 +16,8 @@
 
 #include <jni.h>
 
+#include <android/bitmap.h>
+
 #include <algorithm>
 #include <functional>
 
@@ -30,6 +32,38 @@
 using namespace filament;
 using namespace driver;
 
+// Keeps a Bitmap's pixels locked while Filament uses them, they're then unlocked on the thread
+// which called setImage(), before the optional user callback is posted to its handler.
+struct BitmapCallback {
+    static BitmapCallback* make(Engine* engine, JNIEnv* env, jobject bitmap,
+            jobject handler, jobject runnable) {
+        void* that = engine->streamAlloc(sizeof(BitmapCallback), alignof(BitmapCallback));
+        return new (that) BitmapCallback(env, bitmap, JniCallback::make(engine, env, handler,
+                runnable));
+    }
+
+    static void invoke(void*, size_t, void* user) {
+        BitmapCallback* data = reinterpret_cast<BitmapCallback*>(user);
+        // don't call delete here, because we don't own the storage
+        data->~BitmapCallback();
+    }
+
+private:
+    BitmapCallback(JNIEnv* env, jobject bitmap, JniCallback* callback)
+            : mEnv(env), mBitmap(env->NewGlobalRef(bitmap)), mCallback(callback) {
+    }
+
+    ~BitmapCallback() {
+        AndroidBitmap_unlockPixels(mEnv, mBitmap);
+        mEnv->DeleteGlobalRef(mBitmap);
+        JniCallback::invoke(nullptr, 0, mCallback);
+    }
+
+    JNIEnv* mEnv;
+    jobject mBitmap;
+    JniCallback* mCallback;
+};
+
 static size_t getTextureDataSize(const Texture *texture, size_t level,
         Texture::Format format, Texture::Type type, size_t stride, size_t alignment) {
     return Texture::computeTextureDataSize(format, type,
@@ -283,6 +317,62 @@ Java_com_google_android_filament_Texture_nSetImageCubemapCompressed(JNIEnv *env,
     return 0;
 }
 
+extern "C" JNIEXPORT jint JNICALL
+Java_com_google_android_filament_Texture_nSetBitmap(JNIEnv *env, jclass type_,
+        jlong nativeTexture, jlong nativeEngine, jint level, jint xoffset, jint yoffset,
+        jobject bitmap, jobject handler, jobject runnable) {
+    Texture *texture = (Texture *) nativeTexture;
+    Engine *engine = (Engine *) nativeEngine;
+
+    AndroidBitmapInfo info;
+    if (AndroidBitmap_getInfo(env, bitmap, &info) != ANDROID_BITMAP_RESULT_SUCCESS) {
+        return -1;
+    }
+
+    driver::PixelDataFormat format;
+    driver::PixelDataType type;
+    size_t bytesPerPixel;
+    switch (info.format) {
+        case ANDROID_BITMAP_FORMAT_RGBA_8888:
+            format = driver::PixelDataFormat::RGBA;
+            type = driver::PixelDataType::UBYTE;
+            bytesPerPixel = 4;
+            break;
+        case ANDROID_BITMAP_FORMAT_RGBA_F16:
+            format = driver::PixelDataFormat::RGBA;
+            type = driver::PixelDataType::HALF;
+            bytesPerPixel = 8;
+            break;
+        case ANDROID_BITMAP_FORMAT_A_8:
+            format = driver::PixelDataFormat::ALPHA;
+            type = driver::PixelDataType::UBYTE;
+            bytesPerPixel = 1;
+            break;
+        default:
+            // e.g. RGB_565, which has no matching PixelDataType
+            return -2;
+    }
+
+    // the pixels are used in place, they stay locked until Filament is done with them. This
+    // fails for the bitmaps which have no CPU-side pixels, e.g. Bitmap.Config.HARDWARE.
+    void *pixels;
+    if (AndroidBitmap_lockPixels(env, bitmap, &pixels) != ANDROID_BITMAP_RESULT_SUCCESS) {
+        return -3;
+    }
+
+    auto *callback = BitmapCallback::make(engine, env, bitmap, handler, runnable);
+
+    // the bitmap's rows may be padded, its stride is in bytes
+    Texture::PixelBufferDescriptor desc(pixels, size_t(info.stride) * info.height, format, type,
+            1, 0, 0, (uint32_t) (info.stride / bytesPerPixel),
+            &BitmapCallback::invoke, callback);
+
+    texture->setImage(*engine, (size_t) level, (uint32_t) xoffset, (uint32_t) yoffset,
+            info.width, info.height, std::move(desc));
+
+    return 0;
+}
+
 extern "C" JNIEXPORT void JNICALL
 Java_com_google_android_filament_Texture_nSetExternalImage(JNIEnv*, jclass, jlong nativeTexture, jlong nativeEngine, jlong eglImage) {
     Texture *texture = (Texture *) nativeTexture;
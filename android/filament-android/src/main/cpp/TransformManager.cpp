@@ -20,10 +20,14 @@
 #include <utils/Entity.h>
 #include <filament/TransformManager.h>
 
+#include "NioUtils.h"
+
 using namespace utils;
 using namespace filament;
 
 static_assert(sizeof(jint) == sizeof(Entity), "jint and Entity are not compatible!!");
+static_assert(sizeof(jint) == sizeof(TransformManager::Instance),
+        "jint and TransformManager::Instance are not compatible!!");
 
 extern "C" JNIEXPORT jboolean JNICALL
 Java_com_google_android_filament_TransformManager_nHasComponent(JNIEnv *env, jclass type,
@@ -86,6 +90,30 @@ Java_com_google_android_filament_TransformManager_nSetTransform(JNIEnv *env, jcl
     env->ReleaseFloatArrayElements(localTransform_, localTransform, JNI_ABORT);
 }
 
+extern "C" JNIEXPORT jint JNICALL
+Java_com_google_android_filament_TransformManager_nSetTransforms(JNIEnv *env, jclass type,
+        jlong nativeTransformManager, jobject instances, jint instancesRemaining,
+        jobject transforms, jint transformsRemaining, jint count, jboolean affine) {
+    TransformManager *tm = (TransformManager *) nativeTransformManager;
+    const size_t floatsPerTransform = affine ? 12 : 16;
+    AutoBuffer instancesBuffer(env, instances, count);
+    AutoBuffer transformsBuffer(env, transforms, jint(count * floatsPerTransform));
+    if (instancesBuffer.getSize() > (instancesRemaining << instancesBuffer.getShift()) ||
+            transformsBuffer.getSize() > (transformsRemaining << transformsBuffer.getShift())) {
+        // BufferOverflowException
+        return -1;
+    }
+    auto const* i = static_cast<TransformManager::Instance const*>(instancesBuffer.getData());
+    if (affine) {
+        tm->setTransforms(i, static_cast<math::float3 const*>(transformsBuffer.getData()),
+                (size_t) count);
+    } else {
+        tm->setTransforms(i, static_cast<math::mat4f const*>(transformsBuffer.getData()),
+                (size_t) count);
+    }
+    return 0;
+}
+
 extern "C" JNIEXPORT void JNICALL
 Java_com_google_android_filament_TransformManager_nGetTransform(JNIEnv *env, jclass type,
         jlong nativeTransformManager, jint i, jfloatArray outLocalTransform_) {
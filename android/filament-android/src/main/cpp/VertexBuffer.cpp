@@ -70,6 +70,28 @@ Java_com_google_android_filament_VertexBuffer_nBuilderNormalized(JNIEnv *env, jc
     builder->normalized((VertexAttribute) attribute);
 }
 
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_filament_VertexBuffer_nBuilderUsage(JNIEnv *env, jclass type,
+        jlong nativeBuilder, jint usage) {
+    VertexBuffer::Builder* builder = (VertexBuffer::Builder *) nativeBuilder;
+    builder->usage((VertexBuffer::Usage) usage);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_filament_VertexBuffer_nBuilderQuantized(JNIEnv *env, jclass type,
+        jlong nativeBuilder, jboolean enabled) {
+    VertexBuffer::Builder* builder = (VertexBuffer::Builder *) nativeBuilder;
+    builder->quantized(enabled);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_filament_VertexBuffer_nBuilderPositionBounds(JNIEnv *env, jclass type,
+        jlong nativeBuilder, jfloat cx, jfloat cy, jfloat cz, jfloat ex, jfloat ey, jfloat ez) {
+    VertexBuffer::Builder* builder = (VertexBuffer::Builder *) nativeBuilder;
+    builder->positionBounds({{cx, cy, cz},
+                             {ex, ey, ez}});
+}
+
 extern "C" JNIEXPORT jlong JNICALL
 Java_com_google_android_filament_VertexBuffer_nBuilderBuild(JNIEnv *env, jclass type,
         jlong nativeBuilder, jlong nativeEngine) {
@@ -93,6 +93,103 @@ Java_com_google_android_filament_View_nSetShadowsEnabled(JNIEnv*, jclass, jlong
     view->setShadowsEnabled(enabled);
 }
 
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_filament_View_nSetShadowCachingEnabled(JNIEnv*, jclass, jlong nativeView,
+        jboolean enabled) {
+    View* view = (View*) nativeView;
+    view->setShadowCachingEnabled(enabled);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_filament_View_nSetShadowAutoSizingEnabled(JNIEnv*, jclass, jlong nativeView,
+        jboolean enabled) {
+    View* view = (View*) nativeView;
+    view->setShadowAutoSizingEnabled(enabled);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_filament_View_nSetShadowType(JNIEnv*, jclass, jlong nativeView,
+        jint type) {
+    View* view = (View*) nativeView;
+    view->setShadowType(View::ShadowType(type));
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_com_google_android_filament_View_nGetShadowType(JNIEnv*, jclass, jlong nativeView) {
+    View* view = (View*) nativeView;
+    return (jint)view->getShadowType();
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_filament_View_nSetOcclusionCullingEnabled(JNIEnv*, jclass, jlong nativeView,
+        jboolean enabled) {
+    View* view = (View*) nativeView;
+    view->setOcclusionCullingEnabled(enabled);
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_google_android_filament_View_nIsOcclusionCullingEnabled(JNIEnv*, jclass,
+        jlong nativeView) {
+    View* view = (View*) nativeView;
+    return static_cast<jboolean>(view->isOcclusionCullingEnabled());
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_filament_View_nSetTemporalCullingEnabled(JNIEnv*, jclass, jlong nativeView,
+        jboolean enabled) {
+    View* view = (View*) nativeView;
+    view->setTemporalCullingEnabled(enabled);
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_google_android_filament_View_nIsTemporalCullingEnabled(JNIEnv*, jclass,
+        jlong nativeView) {
+    View* view = (View*) nativeView;
+    return static_cast<jboolean>(view->isTemporalCullingEnabled());
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_filament_View_nSetGpuCullingEnabled(JNIEnv*, jclass, jlong nativeView,
+        jboolean enabled) {
+    View* view = (View*) nativeView;
+    view->setGpuCullingEnabled(enabled);
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_google_android_filament_View_nIsGpuCullingEnabled(JNIEnv*, jclass,
+        jlong nativeView) {
+    View* view = (View*) nativeView;
+    return static_cast<jboolean>(view->isGpuCullingEnabled());
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_filament_View_nSetTemporalUpscalingEnabled(JNIEnv*, jclass,
+        jlong nativeView, jboolean enabled) {
+    View* view = (View*) nativeView;
+    view->setTemporalUpscalingEnabled(enabled);
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_google_android_filament_View_nIsTemporalUpscalingEnabled(JNIEnv*, jclass,
+        jlong nativeView) {
+    View* view = (View*) nativeView;
+    return static_cast<jboolean>(view->isTemporalUpscalingEnabled());
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_filament_View_nSetOrderIndependentTransparencyEnabled(JNIEnv*, jclass,
+        jlong nativeView, jboolean enabled) {
+    View* view = (View*) nativeView;
+    view->setOrderIndependentTransparencyEnabled(enabled);
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_com_google_android_filament_View_nIsOrderIndependentTransparencyEnabled(JNIEnv*, jclass,
+        jlong nativeView) {
+    View* view = (View*) nativeView;
+    return static_cast<jboolean>(view->isOrderIndependentTransparencyEnabled());
+}
+
 extern "C" JNIEXPORT void JNICALL
 Java_com_google_android_filament_View_nSetSampleCount(JNIEnv*, jclass, jlong nativeView,
         jint count) {
@@ -144,9 +241,30 @@ Java_com_google_android_filament_View_nSetDynamicLightingOptions(JNIEnv *env,
     view->setDynamicLightingOptions(zLightNear, zLightFar);
 }
 
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_filament_View_nSetDynamicLightingLimits(JNIEnv *env,
+        jclass, jlong nativeView, jint maxFroxelCount, jint maxLightCount) {
+    View* view = (View*) nativeView;
+    view->setDynamicLightingLimits((uint32_t) maxFroxelCount, (uint32_t) maxLightCount);
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_filament_View_nSetLightBinning(JNIEnv *env,
+        jclass, jlong nativeView, jboolean enabled) {
+    View* view = (View*) nativeView;
+    view->setLightBinning(enabled);
+}
+
 extern "C" JNIEXPORT void JNICALL
 Java_com_google_android_filament_View_nSetDepthPrepass(JNIEnv *env,
         jclass, jlong nativeView, jint value) {
     View* view = (View*) nativeView;
     view->setDepthPrepass(View::DepthPrepass(value));
 }
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_google_android_filament_View_nSetSortOrder(JNIEnv *env,
+        jclass, jlong nativeView, jint value) {
+    View* view = (View*) nativeView;
+    view->setSortOrder(View::SortOrder(value));
+}
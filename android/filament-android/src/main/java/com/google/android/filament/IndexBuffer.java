@@ -48,6 +48,11 @@ public class IndexBuffer {
             UINT,
         }
 
+        public enum Usage {
+            STATIC,
+            DYNAMIC,
+        }
+
         public Builder() {
             mNativeBuilder = nCreateBuilder();
             mFinalizer = new BuilderFinalizer(mNativeBuilder);
@@ -65,6 +70,12 @@ public class IndexBuffer {
             return this;
         }
 
+        @NonNull
+        public Builder usage(@NonNull Usage usage) {
+            nBuilderUsage(mNativeBuilder, usage.ordinal());
+            return this;
+        }
+
         @NonNull
         public IndexBuffer build(@NonNull Engine engine) {
             long nativeIndexBuffer = nBuilderBuild(mNativeBuilder, engine.getNativeObject());
@@ -129,6 +140,7 @@ public class IndexBuffer {
     private static native void nDestroyBuilder(long nativeBuilder);
     private static native void nBuilderIndexCount(long nativeBuilder, int indexCount);
     private static native void nBuilderBufferType(long nativeBuilder, int indexType);
+    private static native void nBuilderUsage(long nativeBuilder, int usage);
     private static native long nBuilderBuild(long nativeBuilder, long nativeEngine);
 
     private static native int nGetIndexCount(long nativeIndexBuffer);
@@ -33,6 +33,14 @@ public class Material {
 
     private Set<VertexBuffer.VertexAttribute> mRequiredAttributes;
 
+    // bits of the variants mask given to compile()
+    public static final int VARIANT_DIRECTIONAL_LIGHTING = 0x01;
+    public static final int VARIANT_DYNAMIC_LIGHTING     = 0x02;
+    public static final int VARIANT_SHADOW_RECEIVER      = 0x04;
+    public static final int VARIANT_SKINNING             = 0x08;
+    public static final int VARIANT_INSTANCING           = 0x10;
+    public static final int VARIANT_ALL                  = 0x1F;
+
     public enum Shading {
         UNLIT,
         LIT,
@@ -90,7 +98,9 @@ public class Material {
             MAT4,
             SAMPLER_2D,
             SAMPLER_CUBEMAP,
-            SAMPLER_EXTERNAL
+            SAMPLER_EXTERNAL,
+            SAMPLER_2D_ARRAY,
+            SAMPLER_3D
         }
 
         public enum Precision {
@@ -163,6 +173,22 @@ public class Material {
         return new MaterialInstance(this, nativeInstance);
     }
 
+    /**
+     * Builds the programs of the given variants ahead of time, on filament's render thread.
+     * Destroy the returned fence with {@link Engine#destroyFence} once it is signaled.
+     */
+    @NonNull
+    public Fence compile(int variants) {
+        long nativeFence = nCompile(getNativeObject(), variants);
+        if (nativeFence == 0) throw new IllegalStateException("Couldn't create Fence");
+        return new Fence(nativeFence);
+    }
+
+    @NonNull
+    public Fence compile() {
+        return compile(VARIANT_ALL);
+    }
+
     @NonNull
     public MaterialInstance getDefaultInstance() {
         return mDefaultInstance;
@@ -340,6 +366,7 @@ public class Material {
 
     private static native long nBuilderBuild(long nativeEngine, @NonNull Buffer buffer, int size);
     private static native long nCreateInstance(long nativeMaterial);
+    private static native long nCompile(long nativeMaterial, int variants);
     private static native long nGetDefaultInstance(long nativeMaterial);
 
     private static native String nGetName(long nativeMaterial);
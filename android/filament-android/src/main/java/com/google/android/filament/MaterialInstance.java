@@ -20,6 +20,9 @@ import android.support.annotation.IntRange;
 import android.support.annotation.NonNull;
 import android.support.annotation.Size;
 
+import java.nio.Buffer;
+import java.nio.BufferOverflowException;
+
 public class MaterialInstance {
     private final Material mMaterial;
     private long mNativeObject;
@@ -138,6 +141,38 @@ public class MaterialInstance {
         setParameter(name, FloatElement.FLOAT4, Colors.toLinear(type, r, g, b, a), 0, 1);
     }
 
+    /**
+     * Resolves a parameter once, so that it can be set many times with setParameters() without
+     * looking up its name.
+     * @param name Name of the parameter as defined by the Material
+     * @return A handle to the parameter, valid for all the instances of the Material, or 0 if
+     *         the parameter doesn't exist
+     */
+    public long getParameterHandle(@NonNull String name) {
+        return nGetParameterHandle(getNativeObject(), name);
+    }
+
+    /**
+     * Sets several float parameters of the same type in a single call.
+     * @param handles count handles of parameters of the given type, from getParameterHandle()
+     * @param type Type of the parameters
+     * @param values A FloatBuffer containing count packed values, e.g. 4 floats per value for
+     *               FLOAT4 and 16 floats per value for MAT4, the i-th value is the value of the
+     *               i-th parameter
+     * @param count Number of parameters to set
+     */
+    public void setParameters(@NonNull long[] handles, @NonNull FloatElement type,
+            @NonNull Buffer values, @IntRange(from = 0) int count) {
+        if (handles.length < count) {
+            throw new ArrayIndexOutOfBoundsException("Array length must be at least count");
+        }
+        int result = nSetFloatParameters(getNativeObject(), handles, type.ordinal(),
+                values, values.remaining(), count);
+        if (result < 0) {
+            throw new BufferOverflowException();
+        }
+    }
+
     public void setScissor(@IntRange(from = 0) int left, @IntRange(from = 0) int bottom,
             @IntRange(from = 0) int width, @IntRange(from = 0) int height) {
         nSetScissor(getNativeObject(), left, bottom, width, height);
@@ -196,6 +231,12 @@ public class MaterialInstance {
             @NonNull String name, int element, @NonNull @Size(min = 1) float[] v,
             @IntRange(from = 0) int offset, @IntRange(from = 1) int count);
 
+    private static native long nGetParameterHandle(long nativeMaterialInstance,
+            @NonNull String name);
+    private static native int nSetFloatParameters(long nativeMaterialInstance,
+            @NonNull long[] handles, int element, @NonNull Buffer values, int remaining,
+            int count);
+
     private static native void nSetParameterTexture(long nativeMaterialInstance,
             @NonNull String name, long nativeTexture, int sampler);
 
@@ -147,6 +147,12 @@ public class RenderableManager {
             return this;
         }
 
+        @NonNull
+        public Builder staticShadowCaster(boolean enabled) {
+            nBuilderStaticShadowCaster(mNativeBuilder, enabled);
+            return this;
+        }
+
         @NonNull
         public Builder skinning(@IntRange(from = 0, to = 255) int boneCount) {
             nBuilderSkinning(mNativeBuilder, boneCount);
@@ -248,6 +254,10 @@ public class RenderableManager {
         nSetReceiveShadows(mNativeObject, i, enabled);
     }
 
+    public void setStaticShadowCaster(@EntityInstance int i, boolean enabled) {
+        nSetStaticShadowCaster(mNativeObject, i, enabled);
+    }
+
     public boolean isShadowCaster(@EntityInstance int i) {
         return nIsShadowCaster(mNativeObject, i);
     }
@@ -256,6 +266,10 @@ public class RenderableManager {
         return nIsShadowReceiver(mNativeObject, i);
     }
 
+    public boolean isStaticShadowCaster(@EntityInstance int i) {
+        return nIsStaticShadowCaster(mNativeObject, i);
+    }
+
     @NonNull
     public Box getAxisAlignedBoundingBox(@EntityInstance int i, @Nullable Box out) {
         if (out == null) out = new Box();
@@ -341,6 +355,7 @@ public class RenderableManager {
     private static native void nBuilderCulling(long nativeBuilder, boolean enabled);
     private static native void nBuilderCastShadows(long nativeBuilder, boolean enabled);
     private static native void nBuilderReceiveShadows(long nativeBuilder, boolean enabled);
+    private static native void nBuilderStaticShadowCaster(long nativeBuilder, boolean enabled);
     private static native void nBuilderSkinning(long nativeBuilder, int boneCount);
     private static native int nBuilderSkinningBones(long nativeBuilder, int boneCount, Buffer bones, int remaining);
 
@@ -351,8 +366,10 @@ public class RenderableManager {
     private static native void nSetPriority(long nativeRenderableManager, int i, int priority);
     private static native void nSetCastShadows(long nativeRenderableManager, int i, boolean enabled);
     private static native void nSetReceiveShadows(long nativeRenderableManager, int i, boolean enabled);
+    private static native void nSetStaticShadowCaster(long nativeRenderableManager, int i, boolean enabled);
     private static native boolean nIsShadowCaster(long nativeRenderableManager, int i);
     private static native boolean nIsShadowReceiver(long nativeRenderableManager, int i);
+    private static native boolean nIsStaticShadowCaster(long nativeRenderableManager, int i);
     private static native void nGetAxisAlignedBoundingBox(long nativeRenderableManager, int i, float[] center, float[] halfExtent);
     private static native int nGetPrimitiveCount(long nativeRenderableManager, int i);
     private static native void nSetMaterialInstanceAt(long nativeRenderableManager, int i, int primitiveIndex, long nativeMaterialInstance);
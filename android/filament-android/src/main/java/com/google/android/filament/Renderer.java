@@ -38,10 +38,30 @@ public class Renderer {
         return mEngine;
     }
 
+    public static class DisplayInfo {
+        public float refreshRate = 60.0f;
+    }
+
     public boolean beginFrame(@NonNull SwapChain swapChain) {
         return nBeginFrame(getNativeObject(), swapChain.getNativeObject());
     }
 
+    /**
+     * Same as {@link #beginFrame(SwapChain)}, and schedules the presentation of the frame
+     * {@link SwapChain#getFrameLatency()} vsyncs after frameTimeNanos.
+     *
+     * @param frameTimeNanos the time of the vsync this frame starts at, in the
+     *                       {@link System#nanoTime()} time base, as given to
+     *                       {@link android.view.Choreographer.FrameCallback#doFrame(long)}
+     */
+    public boolean beginFrame(@NonNull SwapChain swapChain, long frameTimeNanos) {
+        return nBeginFrameAt(getNativeObject(), swapChain.getNativeObject(), frameTimeNanos);
+    }
+
+    public void setDisplayInfo(@NonNull DisplayInfo info) {
+        nSetDisplayInfo(getNativeObject(), info.refreshRate);
+    }
+
     public void endFrame() {
         nEndFrame(getNativeObject());
     }
@@ -86,6 +106,9 @@ public class Renderer {
     }
 
     private static native boolean nBeginFrame(long nativeRenderer, long nativeSwapChain);
+    private static native boolean nBeginFrameAt(long nativeRenderer, long nativeSwapChain,
+            long frameTimeNanos);
+    private static native void nSetDisplayInfo(long nativeRenderer, float refreshRate);
     private static native void nEndFrame(long nativeRenderer);
     private static native void nRender(long nativeRenderer, long nativeView);
     private static native int nReadPixels(long nativeRenderer, long nativeEngine,
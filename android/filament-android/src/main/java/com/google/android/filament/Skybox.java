@@ -42,6 +42,18 @@ public class Skybox {
             return this;
         }
 
+        @NonNull
+        public Builder environmentLevel(@IntRange(from = 0, to = 255) int level) {
+            nBuilderEnvironmentLevel(mNativeBuilder, level & 0xff);
+            return this;
+        }
+
+        @NonNull
+        public Builder irradiance(boolean enabled) {
+            nBuilderIrradiance(mNativeBuilder, enabled);
+            return this;
+        }
+
         @NonNull
         public Builder showSun(boolean show) {
             nBuilderShowSun(mNativeBuilder, show);
@@ -94,6 +106,8 @@ public class Skybox {
     private static native long nCreateBuilder();
     private static native void nDestroyBuilder(long nativeSkyboxBuilder);
     private static native void nBuilderEnvironment(long nativeSkyboxBuilder, long nativeTexture);
+    private static native void nBuilderEnvironmentLevel(long nativeSkyboxBuilder, int level);
+    private static native void nBuilderIrradiance(long nativeSkyboxBuilder, boolean enabled);
     private static native void nBuilderShowSun(long nativeSkyboxBuilder, boolean show);
     private static native long nBuilderBuild(long nativeSkyboxBuilder, long nativeEngine);
     private static native void nSetLayerMask(long nativeSkybox, int select, int value);
@@ -16,6 +16,7 @@
 
 package com.google.android.filament;
 
+import android.support.annotation.IntRange;
 import android.support.annotation.NonNull;
 
 public class SwapChain {
@@ -34,6 +35,18 @@ public class SwapChain {
         return mSurface;
     }
 
+    /**
+     * Sets how many frames the CPU can run ahead of the GPU, between 1 and 4. A lower latency
+     * is more responsive, a higher one absorbs the frames that take longer. The default is 2.
+     */
+    public void setFrameLatency(@IntRange(from = 1, to = 4) int latency) {
+        nSetFrameLatency(getNativeObject(), latency);
+    }
+
+    public int getFrameLatency() {
+        return nGetFrameLatency(getNativeObject());
+    }
+
     long getNativeObject() {
         if (mNativeObject == 0) {
             throw new IllegalStateException("Calling method on destroyed SwapChain");
@@ -44,4 +57,7 @@ public class SwapChain {
     void clearNativeObject() {
         mNativeObject = 0;
     }
+
+    private static native void nSetFrameLatency(long nativeSwapChain, int latency);
+    private static native int nGetFrameLatency(long nativeSwapChain);
 }
@@ -16,6 +16,7 @@
 
 package com.google.android.filament;
 
+import android.graphics.Bitmap;
 import android.support.annotation.IntRange;
 import android.support.annotation.NonNull;
 import android.support.annotation.Nullable;
@@ -37,7 +38,9 @@ public class Texture {
     public enum Sampler {
         SAMPLER_2D,
         SAMPLER_CUBEMAP,
-        SAMPLER_EXTERNAL
+        SAMPLER_EXTERNAL,
+        SAMPLER_2D_ARRAY,
+        SAMPLER_3D
     }
 
     public enum InternalFormat {
@@ -385,8 +388,6 @@ public class Texture {
         return InternalFormat.values()[nGetInternalFormat(getNativeObject())];
     }
 
-    // TODO: add a setImage() version that takes an android Bitmap
-
     public void setImage(@NonNull Engine engine,
             @IntRange(from = 0) int level,
             @NonNull PixelBufferDescriptor buffer) {
@@ -419,6 +420,30 @@ public class Texture {
         }
     }
 
+    public void setImage(@NonNull Engine engine,
+            @IntRange(from = 0) int level,
+            @NonNull Bitmap bitmap) {
+        setImage(engine, level, 0, 0, bitmap, null, null);
+    }
+
+    // note: the bitmap's pixels are used in place, without a copy, they stay locked until the
+    //       callback runs, the bitmap must not be modified or recycled before then
+    // note: only the ARGB_8888, RGBA_F16 and ALPHA_8 configs are supported, HARDWARE bitmaps
+    //       aren't, as their pixels can't be accessed
+    public void setImage(@NonNull Engine engine,
+            @IntRange(from = 0) int level,
+            @IntRange(from = 0) int xoffset, @IntRange(from = 0) int yoffset,
+            @NonNull Bitmap bitmap,
+            @Nullable Object handler, @Nullable Runnable callback) {
+        int result = nSetBitmap(getNativeObject(), engine.getNativeObject(), level,
+                xoffset, yoffset, bitmap, handler, callback);
+        if (result == -2) {
+            throw new IllegalArgumentException("Unsupported bitmap config: " + bitmap.getConfig());
+        } else if (result < 0) {
+            throw new IllegalArgumentException("Could not access the bitmap's pixels");
+        }
+    }
+
     // note: faceOffsetsInBytes are offsets in byte in the buffer relative to the current position()
     // note: use Texture CubemapFace to index the faceOffsetsInBytes array
     // note: we assume all 6 faces are tightly packed
@@ -515,6 +540,10 @@ public class Texture {
             int alignment, int compressedSizeInBytes, int compressedFormat,
             int[] faceOffsetsInBytes, Object handler, Runnable callback);
 
+    private static native int nSetBitmap(long nativeTexture, long nativeEngine,
+            int level, int xoffset, int yoffset, Bitmap bitmap,
+            Object handler, Runnable callback);
+
     private static native void nSetExternalImage(long nativeObject, long nativeObject1, long eglImage);
 
     private static native void nSetExternalStream(long nativeTexture,
@@ -16,10 +16,14 @@
 
 package com.google.android.filament;
 
+import android.support.annotation.IntRange;
 import android.support.annotation.NonNull;
 import android.support.annotation.Nullable;
 import android.support.annotation.Size;
 
+import java.nio.Buffer;
+import java.nio.BufferOverflowException;
+
 public class TransformManager {
     private long mNativeObject;
 
@@ -59,6 +63,41 @@ public class TransformManager {
         nSetTransform(mNativeObject, i, localTransform);
     }
 
+    /**
+     * Sets the local transforms of many transform components in a single call.
+     * @param instances An IntBuffer containing count instances
+     * @param localTransforms A FloatBuffer containing count 4x4 packed matrices (i.e. 16 floats
+     *                        each matrix, by columns, and no gap between matrices), the i-th
+     *                        matrix is the local transform of the i-th instance
+     * @param count Number of transforms to set
+     */
+    public void setTransforms(@NonNull Buffer instances, @NonNull Buffer localTransforms,
+            @IntRange(from = 0) int count) {
+        int result = nSetTransforms(mNativeObject, instances, instances.remaining(),
+                localTransforms, localTransforms.remaining(), count, false);
+        if (result < 0) {
+            throw new BufferOverflowException();
+        }
+    }
+
+    /**
+     * Sets the local transforms of many transform components in a single call, from affine
+     * transforms, which is 12 floats per transform instead of 16.
+     * @param instances An IntBuffer containing count instances
+     * @param affineTransforms A FloatBuffer containing count transforms of 12 floats each: the
+     *                         first three rows of the matrix, by columns, i.e. the three basis
+     *                         vectors followed by the translation
+     * @param count Number of transforms to set
+     */
+    public void setAffineTransforms(@NonNull Buffer instances, @NonNull Buffer affineTransforms,
+            @IntRange(from = 0) int count) {
+        int result = nSetTransforms(mNativeObject, instances, instances.remaining(),
+                affineTransforms, affineTransforms.remaining(), count, true);
+        if (result < 0) {
+            throw new BufferOverflowException();
+        }
+    }
+
     @NonNull
     @Size(min = 16)
     public float[] getTransform(@EntityInstance int i, @Nullable @Size(min = 16) float[] outLocalTransform) {
@@ -99,6 +138,7 @@ public class TransformManager {
     private static native void nDestroy(long nativeTransformManager, int entity);
     private static native void nSetParent(long nativeTransformManager, int i, int newParent);
     private static native void nSetTransform(long nativeTransformManager, int i, float[] localTransform);
+    private static native int nSetTransforms(long nativeTransformManager, Buffer instances, int instancesRemaining, Buffer transforms, int transformsRemaining, int count, boolean affine);
     private static native void nGetTransform(long nativeTransformManager, int i, float[] outLocalTransform);
     private static native void nGetWorldTransform(long nativeTransformManager, int i, float[] outWorldTransform);
     private static native void nOpenLocalTransformTransaction(long nativeTransformManager);
@@ -69,6 +69,11 @@ public class VertexBuffer {
         HALF4,
     }
 
+    public enum Usage {
+        STATIC,
+        DYNAMIC,
+    }
+
     public static class Builder {
         @SuppressWarnings({"FieldCanBeLocal", "UnusedDeclaration"}) // Keep to finalize native resources
         private final BuilderFinalizer mFinalizer;
@@ -112,6 +117,26 @@ public class VertexBuffer {
             return this;
         }
 
+        @NonNull
+        public Builder usage(@NonNull Usage usage) {
+            nBuilderUsage(mNativeBuilder, usage.ordinal());
+            return this;
+        }
+
+        @NonNull
+        public Builder quantized(boolean enabled) {
+            nBuilderQuantized(mNativeBuilder, enabled);
+            return this;
+        }
+
+        @NonNull
+        public Builder positionBounds(@NonNull Box bounds) {
+            nBuilderPositionBounds(mNativeBuilder,
+                    bounds.getCenter()[0], bounds.getCenter()[1], bounds.getCenter()[2],
+                    bounds.getHalfExtent()[0], bounds.getHalfExtent()[1], bounds.getHalfExtent()[2]);
+            return this;
+        }
+
         @NonNull
         public VertexBuffer build(@NonNull Engine engine) {
             long nativeVertexBuffer = nBuilderBuild(mNativeBuilder, engine.getNativeObject());
@@ -184,6 +209,10 @@ public class VertexBuffer {
     private static native void nBuilderAttribute(long nativeBuilder, int attribute,
             int bufferIndex, int attributeType, int byteOffset, int byteStride);
     private static native void nBuilderNormalized(long nativeBuilder, int attribute);
+    private static native void nBuilderUsage(long nativeBuilder, int usage);
+    private static native void nBuilderQuantized(long nativeBuilder, boolean enabled);
+    private static native void nBuilderPositionBounds(long nativeBuilder,
+            float cx, float cy, float cz, float ex, float ey, float ez);
     private static native long nBuilderBuild(long nativeBuilder, long nativeEngine);
 
     private static native int nGetVertexCount(long nativeVertexBuffer);
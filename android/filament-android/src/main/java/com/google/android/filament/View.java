@@ -31,6 +31,7 @@ public class View {
     private Viewport mViewport;
     private DynamicResolutionOptions mDynamicResolution;
     private DepthPrepass mDepthPrepass = DepthPrepass.DEFAULT;
+    private SortOrder mSortOrder = SortOrder.DEFAULT;
 
     public static class DynamicResolutionOptions {
         public boolean enabled = false;
@@ -48,10 +49,16 @@ public class View {
         FXAA
     }
 
+    public enum ShadowType {
+        PCF,
+        EVSM
+    }
+
     public enum DepthPrepass {
         DEFAULT(-1),
         DISABLED(0),
-        ENABLED(1);
+        ENABLED(1),
+        AUTOMATIC(2);
 
         final int value;
 
@@ -60,6 +67,19 @@ public class View {
         }
     };
 
+    public enum SortOrder {
+        DEFAULT(-1),
+        DEPTH_FIRST(0),
+        MATERIAL_FIRST(1),
+        FRONT_TO_BACK(2);
+
+        final int value;
+
+        SortOrder(int value) {
+            this.value = value;
+        }
+    };
+
     View(long nativeView) {
         mNativeObject = nativeView;
     }
@@ -131,6 +151,63 @@ public class View {
         nSetShadowsEnabled(getNativeObject(), enabled);
     }
 
+    public void setShadowCachingEnabled(boolean enabled) {
+        nSetShadowCachingEnabled(getNativeObject(), enabled);
+    }
+
+    public void setShadowAutoSizingEnabled(boolean enabled) {
+        nSetShadowAutoSizingEnabled(getNativeObject(), enabled);
+    }
+
+    public void setShadowType(@NonNull ShadowType type) {
+        nSetShadowType(getNativeObject(), type.ordinal());
+    }
+
+    @NonNull
+    public ShadowType getShadowType() {
+        return ShadowType.values()[nGetShadowType(getNativeObject())];
+    }
+
+    public void setOcclusionCullingEnabled(boolean enabled) {
+        nSetOcclusionCullingEnabled(getNativeObject(), enabled);
+    }
+
+    public boolean isOcclusionCullingEnabled() {
+        return nIsOcclusionCullingEnabled(getNativeObject());
+    }
+
+    public void setTemporalCullingEnabled(boolean enabled) {
+        nSetTemporalCullingEnabled(getNativeObject(), enabled);
+    }
+
+    public boolean isTemporalCullingEnabled() {
+        return nIsTemporalCullingEnabled(getNativeObject());
+    }
+
+    public void setGpuCullingEnabled(boolean enabled) {
+        nSetGpuCullingEnabled(getNativeObject(), enabled);
+    }
+
+    public boolean isGpuCullingEnabled() {
+        return nIsGpuCullingEnabled(getNativeObject());
+    }
+
+    public void setTemporalUpscalingEnabled(boolean enabled) {
+        nSetTemporalUpscalingEnabled(getNativeObject(), enabled);
+    }
+
+    public boolean isTemporalUpscalingEnabled() {
+        return nIsTemporalUpscalingEnabled(getNativeObject());
+    }
+
+    public void setOrderIndependentTransparencyEnabled(boolean enabled) {
+        nSetOrderIndependentTransparencyEnabled(getNativeObject(), enabled);
+    }
+
+    public boolean isOrderIndependentTransparencyEnabled() {
+        return nIsOrderIndependentTransparencyEnabled(getNativeObject());
+    }
+
     public void setSampleCount(int count) {
         nSetSampleCount(getNativeObject(), count);
     }
@@ -179,10 +256,30 @@ public class View {
         nSetDepthPrepass(getNativeObject(), depthPrepass.value);
     }
 
+    @NonNull
+    public SortOrder getSortOrder() {
+        return mSortOrder;
+    }
+
+    public void setSortOrder(@NonNull SortOrder sortOrder) {
+        mSortOrder = sortOrder;
+        nSetSortOrder(getNativeObject(), sortOrder.value);
+    }
+
     public void setDynamicLightingOptions(float zLightNear, float zLightFar) {
         nSetDynamicLightingOptions(getNativeObject(), zLightNear, zLightFar);
     }
 
+    public void setDynamicLightingLimits(
+            @IntRange(from = 1024, to = 8192) int maxFroxelCount,
+            @IntRange(from = 0, to = 256) int maxLightCount) {
+        nSetDynamicLightingLimits(getNativeObject(), maxFroxelCount, maxLightCount);
+    }
+
+    public void setLightBinning(boolean enabled) {
+        nSetLightBinning(getNativeObject(), enabled);
+    }
+
     long getNativeObject() {
         if (mNativeObject == 0) {
             throw new IllegalStateException("Calling method on destroyed View");
@@ -212,6 +309,20 @@ public class View {
     private static native void nSetClearTargets(long nativeView, boolean color, boolean depth, boolean stencil);
     private static native void nSetVisibleLayers(long nativeView, int select, int value);
     private static native void nSetShadowsEnabled(long nativeView, boolean enabled);
+    private static native void nSetShadowCachingEnabled(long nativeView, boolean enabled);
+    private static native void nSetShadowAutoSizingEnabled(long nativeView, boolean enabled);
+    private static native void nSetShadowType(long nativeView, int type);
+    private static native int nGetShadowType(long nativeView);
+    private static native void nSetOcclusionCullingEnabled(long nativeView, boolean enabled);
+    private static native boolean nIsOcclusionCullingEnabled(long nativeView);
+    private static native void nSetTemporalCullingEnabled(long nativeView, boolean enabled);
+    private static native boolean nIsTemporalCullingEnabled(long nativeView);
+    private static native void nSetGpuCullingEnabled(long nativeView, boolean enabled);
+    private static native boolean nIsGpuCullingEnabled(long nativeView);
+    private static native void nSetTemporalUpscalingEnabled(long nativeView, boolean enabled);
+    private static native boolean nIsTemporalUpscalingEnabled(long nativeView);
+    private static native void nSetOrderIndependentTransparencyEnabled(long nativeView, boolean enabled);
+    private static native boolean nIsOrderIndependentTransparencyEnabled(long nativeView);
     private static native void nSetSampleCount(long nativeView, int count);
     private static native int nGetSampleCount(long nativeView);
     private static native void nSetAntiAliasing(long nativeView, int type);
@@ -221,5 +332,8 @@ public class View {
             float targetFrameTimeMilli, float headRoomRatio, float scaleRate,
             float minScale, float maxScale, int history);
     private static native void nSetDynamicLightingOptions(long nativeView, float zLightNear, float zLightFar);
+    private static native void nSetDynamicLightingLimits(long nativeView, int maxFroxelCount, int maxLightCount);
+    private static native void nSetLightBinning(long nativeView, boolean enabled);
     private static native void nSetDepthPrepass(long nativeView, int value);
+    private static native void nSetSortOrder(long nativeView, int value);
 }
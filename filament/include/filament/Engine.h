@@ -26,17 +26,26 @@
 #include <utils/compiler.h>
 #include <utils/EntityManager.h>
 
+namespace utils {
+class JobSystem;
+} // namespace utils
+
 namespace filament {
 
 class Camera;
 class DebugRegistry;
 class Fence;
+class IBLPrefilter;
 class IndexBuffer;
 class IndirectLight;
+class LoaderContext;
 class Material;
 class MaterialInstance;
+class MorphTargetBuffer;
 class Renderer;
 class Scene;
+class SceneLoader;
+class SkinningBuffer;
 class Skybox;
 class Stream;
 class Texture;
@@ -143,6 +152,7 @@ class TransformManager;
 class UTILS_PUBLIC Engine {
 public:
     using ExternalContext = driver::ExternalContext;
+    using BlobCache = driver::BlobCache;
     using Backend = driver::Backend;
 
     /**
@@ -166,6 +176,20 @@ public:
      *                          Setting this parameter will force filament to use the OpenGL
      *                          implementation (instead of Vulkaan for instance).
      *
+     *  @param blobCache        A pointer to an object that implements BlobCache. If this is
+     *                          provided, the driver uses it to store the compiled programs
+     *                          (OpenGL) or its pipeline cache (Vulkan) and reuse them in later
+     *                          runs, instead of compiling them again.
+     *
+     *                          All methods of this interface are called from filament's
+     *                          render thread. The lifetime of \p blobCache must exceed the
+     *                          life time of the Engine object.
+     *
+     *  @param dfgLutSize       Width and height of the pre-integrated BRDF lookup table used for
+     *                          image based lighting. The table is computed on the CPU the first
+     *                          time a View is created, larger tables are more accurate at low
+     *                          roughness but take longer to compute. The size is clamped to
+     *                          [16, 512].
      *
      * @return A pointer to the newly created Engine, or nullptr if the Engine couldn't be created.
      *
@@ -180,7 +204,8 @@ public:
      * This method is thread-safe.
      */
     static Engine* create(Backend backend = Backend::DEFAULT,
-            ExternalContext* externalContext = nullptr, void* sharedGLContext = nullptr);
+            ExternalContext* externalContext = nullptr, void* sharedGLContext = nullptr,
+            BlobCache* blobCache = nullptr, size_t dfgLutSize = 128);
 
     /**
      * Destroy the Engine instance and all associated resources.
@@ -210,12 +235,36 @@ public:
      */
     static void destroy(Engine** engine);
 
+    /**
+     * Lets the Engines created from now on share the programs they compile, so that the
+     * Engines created after the first one (e.g. one per window, or for offscreen work) don't
+     * compile the same shaders again. Disabled by default.
+     *
+     * The programs are shared through an in-memory BlobCache, which is only used by the
+     * Engines created without a BlobCache of their own. Applications providing one can share
+     * it between their Engines instead. The cache is freed with the last Engine using it.
+     *
+     * The pre-integrated BRDF lookup table is always shared by the Engines of a process.
+     *
+     * @param enabled  true to share the programs of the Engines created afterwards.
+     *
+     * \remark
+     * This method is thread-safe.
+     */
+    static void setResourceSharing(bool enabled) noexcept;
+
     RenderableManager& getRenderableManager() noexcept;
 
     LightManager& getLightManager() noexcept;
 
     TransformManager& getTransformManager() noexcept;
 
+    /**
+     * Returns the JobSystem used by this Engine. Applications can use it to run their own work
+     * in parallel, e.g. to decode resources, from the thread that created the Engine.
+     */
+    utils::JobSystem& getJobSystem() noexcept;
+
     /**
      * Creates a SwapChain from the given Operating System's native window handle.
      *
@@ -229,6 +278,28 @@ public:
      */
     SwapChain* createSwapChain(void* nativeWindow, uint64_t flags = 0) noexcept;
 
+    /**
+     * Creates a headless SwapChain, which renders offscreen without any window, e.g. on a server.
+     *
+     * It's used like any other SwapChain, but Renderer::beginFrame() never skips its frames, it
+     * waits for the GPU instead, so that SwapChain::getFrameLatency() frames are always in flight.
+     * Several Views can be rendered in a frame, each into its own viewport, and read back with
+     * Renderer::readPixels(), whose callback is called once the pixels are available, without
+     * stalling the frames that follow.
+     *
+     * This is backed by a pbuffer with EGL and GLX, and by images that are never presented with
+     * Vulkan. Other platforms don't support it, the SwapChain doesn't render anything.
+     *
+     * @param width     Width of the SwapChain, in pixels.
+     * @param height    Height of the SwapChain, in pixels.
+     * @param flags     One or more configuration flags as defined in `SwapChain`.
+     *
+     * @return A pointer to the newly created SwapChain or nullptr if it couldn't be created.
+     *
+     * @see SwapChain::isHeadless()
+     */
+    SwapChain* createSwapChain(uint32_t width, uint32_t height, uint64_t flags = 0) noexcept;
+
     /**
      * Creates a renderer associated to this engine.
      *
@@ -269,10 +340,22 @@ public:
      */
     Fence* createFence(Fence::Type type = Fence::Type::SOFT) noexcept;
 
+    /**
+     * Creates a LoaderContext, through which other threads can upload the content of the
+     * buffers and textures of this engine.
+     *
+     * @return A pointer to the newly created LoaderContext or nullptr if it couldn't be created.
+     *
+     * @see LoaderContext
+     */
+    LoaderContext* createLoaderContext() noexcept;
+
     void destroy(const VertexBuffer* p);        //!< Destroys an VertexBuffer object.
     void destroy(const Fence* p);               //!< Destroys a Fence object.
+    void destroy(const IBLPrefilter* p);        //!< Destroys an IBLPrefilter object.
     void destroy(const IndexBuffer* p);         //!< Destroys an IndexBuffer object.
     void destroy(const IndirectLight* p);       //!< Destroys an IndirectLight object.
+    void destroy(const LoaderContext* p);       //!< Destroys a LoaderContext object.
 
     /**
      * Destroys a Material object
@@ -284,8 +367,11 @@ public:
      */
     void destroy(const Material* p);
     void destroy(const MaterialInstance* p);    //!< Destroys a MaterialInstance object.
+    void destroy(const MorphTargetBuffer* p);   //!< Destroys a MorphTargetBuffer object.
     void destroy(const Renderer* p);            //!< Destroys a Renderer object.
     void destroy(const Scene* p);               //!< Destroys a Scene object.
+    void destroy(const SceneLoader* p);         //!< Destroys a SceneLoader object.
+    void destroy(const SkinningBuffer* p);      //!< Destroys a SkinningBuffer object.
     void destroy(const Skybox* p);              //!< Destroys a SkyBox object.
     void destroy(const SwapChain* p);           //!< Destroys a SwapChain object.
     void destroy(const Stream* p);              //!< Destroys a Stream object.
@@ -293,6 +379,76 @@ public:
     void destroy(const View* p);                //!< Destroys a View object.
     void destroy(utils::Entity e);              //!< Destroys all filament-known components from this entity
 
+    /**
+     * Destroys many objects without stalling the calling thread, e.g. when a level is unloaded.
+     *
+     * The objects are queued, and destroyed at the end of the next frames, in the order they
+     * were queued, within the time budget set by setDeferredDestroyBudget(). They must not be
+     * used after this call.
+     *
+     * @param objects  array of objects to destroy, nullptr entries are ignored.
+     * @param count    number of entries in objects.
+     *
+     * @attention A Material is destroyed after the MaterialInstances queued before it, so they
+     *            must be queued first.
+     */
+    void destroyDeferred(const VertexBuffer* const* objects, size_t count);
+    void destroyDeferred(const IndexBuffer* const* objects, size_t count);     //!< \see destroyDeferred()
+    void destroyDeferred(const IndirectLight* const* objects, size_t count);   //!< \see destroyDeferred()
+    void destroyDeferred(const Material* const* objects, size_t count);        //!< \see destroyDeferred()
+    void destroyDeferred(const MaterialInstance* const* objects, size_t count);//!< \see destroyDeferred()
+    void destroyDeferred(const MorphTargetBuffer* const* objects, size_t count);//!< \see destroyDeferred()
+    void destroyDeferred(const SkinningBuffer* const* objects, size_t count);  //!< \see destroyDeferred()
+    void destroyDeferred(const Texture* const* objects, size_t count);         //!< \see destroyDeferred()
+
+    /**
+     * Limits the time spent each frame destroying the objects given to destroyDeferred().
+     *
+     * @param microseconds  time budget per frame, 1000 (1 ms) by default. 0 destroys all the
+     *                      queued objects at the end of the next frame.
+     */
+    void setDeferredDestroyBudget(uint32_t microseconds) noexcept;
+
+    /**
+     * Memory used by the Engine, see getMemoryReport().
+     *
+     * The GPU memory of the objects is estimated from their sizes. Backends add padding,
+     * alignment and their own allocations, which only gpuAllocated accounts for.
+     */
+    struct MemoryReport {
+        // GPU memory, in bytes
+        size_t textures = 0;                    //!< all the levels and samples of the Textures
+        size_t vertexBuffers = 0;               //!< all the buffers of the VertexBuffers
+        size_t indexBuffers = 0;
+        size_t renderTargets = 0;               //!< intermediate targets, see setRenderTargetBudget()
+        size_t gpuAllocated = 0;                //!< measured by the backend, 0 if it can't tell
+
+        // CPU memory, in bytes
+        size_t driverHandles = 0;               //!< arena of the backend's objects
+        size_t commandBuffer = 0;               //!< the buffer of the commands sent to the backend
+        size_t commandBufferHighWatermark = 0;  //!< most of commandBuffer used so far
+        size_t perRenderPassArena = 0;          //!< scratch memory of the render passes
+        size_t components = 0;                  //!< Renderable, Transform, Light, Camera components
+        size_t materialPackages = 0;            //!< packages the Materials were built from
+
+        // number of objects
+        uint32_t textureCount = 0;
+        uint32_t vertexBufferCount = 0;
+        uint32_t indexBufferCount = 0;
+        uint32_t renderTargetCount = 0;
+        uint32_t materialCount = 0;
+        uint32_t materialInstanceCount = 0;
+    };
+
+    /**
+     * Reports where the memory of the Engine goes, e.g. to check per-device budgets or find
+     * leaks.
+     *
+     * This waits for the render thread to execute the pending commands, don't call it every
+     * frame.
+     */
+    MemoryReport getMemoryReport() noexcept;
+
     /**
      * Returns the default Material.
      *
@@ -316,6 +472,95 @@ public:
      */
     void* streamAlloc(size_t size, size_t alignment = alignof(double)) noexcept;
 
+    /**
+     * Limits the amount of texture data uploaded to the GPU per frame.
+     *
+     * Texture uploads that don't fit in the budget are split and spread over the following
+     * frames, so that streaming large textures doesn't cause frame hitches. A level of a texture
+     * becomes visible once it's fully uploaded.
+     *
+     * @param bytesPerFrame  maximum number of bytes uploaded per frame, 0 means no limit
+     *                       (the default).
+     *
+     * @note This is a hint, which is currently only used by the OpenGL backend.
+     */
+    void setTextureUploadBudget(size_t bytesPerFrame) noexcept;
+
+    /**
+     * Limits the memory used by the Engine's intermediate render targets (e.g. for
+     * post-processing or dynamic resolution).
+     *
+     * Render targets are cached across frames; the least recently used ones that are not in use
+     * are destroyed to stay within the budget. The render targets needed by a frame are always
+     * allocated, even if they exceed the budget.
+     *
+     * @param bytes  maximum number of bytes, 128 MiB by default.
+     */
+    void setRenderTargetBudget(size_t bytes) noexcept;
+
+    /**
+     * Limits the memory used by the levels of the streamed textures (see
+     * Texture::setStreaming()).
+     *
+     * The levels the textures need are kept while they fit. When they don't, the finest levels
+     * of the textures that were seen the least recently are evicted first, which is equivalent
+     * to biasing their level of detail.
+     *
+     * @param bytes  maximum number of bytes, 256 MiB by default.
+     *
+     * @note Only the levels sampled are limited, both backends allocate the storage of all the
+     *       levels of a texture when it's created.
+     */
+    void setTextureStreamingBudget(size_t bytes) noexcept;
+
+    /**
+     * Keeps the Engine's threads off some CPUs, so the application can dedicate them to its own
+     * threads.
+     *
+     * By default, the render thread runs on the fastest cores of the device and the worker
+     * threads on all cores. The threads move off the reserved cores the next time they're
+     * scheduled. If all fast cores are reserved, the render thread runs on the remaining ones.
+     *
+     * @param cpuMask  bit i is set to reserve CPU i, 0 (the default) reserves no CPU.
+     *
+     * @note CPU affinity is currently only supported on Linux and Android.
+     */
+    void setReservedCores(uint32_t cpuMask) noexcept;
+
+    /**
+     * A Material and the variants of its programs to build with warmup().
+     */
+    struct Warmup {
+        Material const* material;
+        uint8_t variants;       //!< mask of Material::VARIANT_* bits, see Material::compile()
+    };
+
+    /**
+     * Called on filament's render thread as the programs given to warmup() are built.
+     *
+     * @param built  number of programs built so far.
+     * @param count  number of programs to build, built == count for the last call.
+     * @param user   the user pointer given to warmup().
+     */
+    using WarmupCallback = void(*)(size_t built, size_t count, void* user);
+
+    /**
+     * Builds the programs of several materials ahead of time, typically right after they're
+     * created while the application is loading, so that the first frames don't stall on shader
+     * compilation. This is Material::compile() for a list of materials, with progress reporting.
+     *
+     * The shaders are compiled on filament's render thread, this call doesn't block. Programs
+     * shared between materials, like the depth variants of the default material, are only
+     * built once.
+     *
+     * @param materials  the materials and the variants to build.
+     * @param count      number of entries in materials.
+     * @param callback   called after each program is built, can be nullptr.
+     * @param user       passed to the callback.
+     */
+    void warmup(Warmup const* materials, size_t count,
+            WarmupCallback callback = nullptr, void* user = nullptr) noexcept;
+
 
     /**
      * helper for creating an Entity and Camera component in one call
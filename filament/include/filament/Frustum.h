@@ -54,6 +54,12 @@ public:
     // set the frustum from the given projection matrix
     void setProjection(const math::mat4f& pv);
 
+    // Set the frustum to one enclosing a and b, the frustums of cameras at aPosition and
+    // bPosition looking in the same direction, e.g. the eyes of a stereo pair. Each plane is
+    // the one of a or b which has the other camera on its inner side.
+    void setEnclosing(Frustum const& a, math::float3 aPosition,
+            Frustum const& b, math::float3 bPosition) noexcept;
+
     // return the plane equation parameters with normalized normals
     math::float4 getNormalizedPlane(Plane plane) const noexcept;
 
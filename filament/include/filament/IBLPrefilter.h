@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//! \file
+
+#ifndef TNT_FILAMENT_IBLPREFILTER_H
+#define TNT_FILAMENT_IBLPREFILTER_H
+
+#include <filament/FilamentAPI.h>
+
+#include <utils/compiler.h>
+
+#include <math/vec3.h>
+
+#include <stdint.h>
+
+namespace filament {
+
+namespace details {
+class FIBLPrefilter;
+} // namespace details
+
+class Engine;
+class Texture;
+
+/**
+ * IBLPrefilter computes, at runtime, the data an IndirectLight needs from an environment
+ * captured by the application (e.g. with AR light estimation or a dynamic sky): the reflections
+ * cubemap, prefiltered for each roughness level, and the irradiance as 3 bands of Spherical
+ * Harmonics.
+ *
+ * This is the same processing the **cmgen** tool does offline, at a lower quality. The work is
+ * spread over the frames that follow the creation of the IBLPrefilter, and at most
+ * Builder::budget() is spent on it each frame, so that it doesn't cause hitches.
+ *
+ * Creation and destruction
+ * ========================
+ *
+ * An IBLPrefilter object is created using the IBLPrefilter::Builder and destroyed by calling
+ * Engine::destroy(const IBLPrefilter*). It can be destroyed as soon as it's ready.
+ *
+ * ~~~~~~~~~~~{.cpp}
+ *  filament::Engine* engine = filament::Engine::create();
+ *
+ *  filament::Texture* reflections = filament::Texture::Builder()
+ *              .width(256)
+ *              .height(256)
+ *              .levels(9)
+ *              .sampler(filament::Texture::Sampler::SAMPLER_CUBEMAP)
+ *              .format(filament::Texture::InternalFormat::RGBM)
+ *              .build(*engine);
+ *
+ *  filament::IBLPrefilter* prefilter = filament::IBLPrefilter::Builder()
+ *              .environment(size, faces)
+ *              .reflections(reflections)
+ *              .build(*engine);
+ *
+ *  // later, once prefilter->isReady() returns true
+ *  math::float3 sh[9];
+ *  prefilter->getIrradiance(sh);
+ *  filament::IndirectLight* ibl = filament::IndirectLight::Builder()
+ *              .reflections(reflections)
+ *              .irradiance(3, sh)
+ *              .build(*engine);
+ *
+ *  engine->destroy(prefilter);
+ * ~~~~~~~~~~~
+ *
+ * @see IndirectLight
+ */
+class UTILS_PUBLIC IBLPrefilter : public FilamentAPI {
+    struct BuilderDetails;
+
+public:
+    //! Use Builder to construct an IBLPrefilter object instance
+    class Builder : public BuilderBase<BuilderDetails> {
+        friend struct BuilderDetails;
+    public:
+        Builder() noexcept;
+        Builder(Builder const& rhs) noexcept;
+        Builder(Builder&& rhs) noexcept;
+        ~Builder() noexcept;
+        Builder& operator=(Builder const& rhs) noexcept;
+        Builder& operator=(Builder&& rhs) noexcept;
+
+        /**
+         * Sets the environment to prefilter.
+         *
+         * @param size  Width and height of each face, in texels. Must be a power of two.
+         * @param faces The six faces in the order +x, -x, +y, -y, +z, -z, each made of
+         *              size x size linear RGB texels, with the top row first. The data is
+         *              copied by build().
+         *
+         * @return This Builder, for chaining calls.
+         */
+        Builder& environment(uint32_t size, math::float3 const* faces) noexcept;
+
+        /**
+         * Sets the cubemap receiving the prefiltered reflections. Each level is set as soon as
+         * it's computed.
+         *
+         * @param cubemap A 256x256 cubemap in `RGBM` format with 9 levels, which must outlive
+         *                the IBLPrefilter.
+         *
+         * @return This Builder, for chaining calls.
+         */
+        Builder& reflections(Texture* cubemap) noexcept;
+
+        /**
+         * (optional) Number of samples of the GGX importance sampling, for each texel of the
+         * reflections. The default is 64.
+         *
+         * @param count Number of samples, more is slower but less noisy.
+         *
+         * @return This Builder, for chaining calls.
+         */
+        Builder& samples(uint32_t count) noexcept;
+
+        /**
+         * (optional) CPU time spent prefiltering in each frame, in microseconds. The default
+         * is 2000.
+         *
+         * @param microseconds Time budget per frame.
+         *
+         * @return This Builder, for chaining calls.
+         */
+        Builder& budget(uint32_t microseconds) noexcept;
+
+        /**
+         * Creates the IBLPrefilter object and returns a pointer to it.
+         *
+         * @param engine Reference to the filament::Engine to associate this IBLPrefilter with.
+         *
+         * @return pointer to the newly created object or nullptr if exceptions are disabled and
+         *         an error occured.
+         *
+         * @exception utils::PreConditionPanic if a parameter to a builder function was invalid.
+         */
+        IBLPrefilter* build(Engine& engine);
+
+    private:
+        friend class details::FIBLPrefilter;
+    };
+
+    /**
+     * Returns whether all the levels of the reflections cubemap have been set and the
+     * irradiance is available.
+     */
+    bool isReady() const noexcept;
+
+    /**
+     * Returns the irradiance, pre-convolved by \f$ \langle n \cdot l \rangle \f$ and pre-scaled
+     * as expected by IndirectLight::Builder::irradiance().
+     *
+     * @param sh Array receiving the 9 coefficients of the 3 bands.
+     *
+     * @attention isReady() must be true.
+     */
+    void getIrradiance(math::float3* sh) const noexcept;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_IBLPREFILTER_H
@@ -108,16 +108,16 @@ public:
          *
          * @param cubemap   A mip-mapped cubemap generated by **cmgen**. Each cubemap level
          *                  encodes a the irradiance for a roughness level.
-         *                  The cubemap *must be* a 256x256 cubemap in `RGBM` format.
+         *                  The cubemap *must be* a 256x256 cubemap in `RGBM` format, or in
+         *                  one of the packed float formats `RGB9_E5` or `R11F_G11F_B10F`
+         *                  (or `RGBA16F`), which keep the full range of the environment for
+         *                  the same size, or twice the size for `RGBA16F`.
          *
          * @return This Builder, for chaining calls.
          *
          * @attention
          * \p cubemap *must* be of dimension 256x256
          *
-         * @attention
-         * \p cubemap *must* be encoded in `RGBM` format
-         *
          */
         Builder& reflections(Texture const* cubemap) noexcept;
 
@@ -178,6 +178,9 @@ public:
         /**
          * Specifies the rigid-body transformation to apply to the IBL.
          *
+         * Only the environment is rotated, the rotation is applied to its lookups in the
+         * shaders and to the spherical harmonics, so it's cheap to change every frame.
+         *
          * @param rotation 3x3 rotation matrix. Must be a rigid-body transform.
          *
          * @return This Builder, for chaining calls.
@@ -221,6 +224,9 @@ public:
     /**
      * Sets the rigid-body transformation to apply to the IBL.
      *
+     * This can be called every frame, e.g. to animate the environment, see
+     * Builder::rotation().
+     *
      * @param rotation 3x3 rotation matrix. Must be a rigid-body transform.
      */
     void setRotation(math::mat3f const& rotation) noexcept;
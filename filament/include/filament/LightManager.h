@@ -212,6 +212,14 @@ public:
          * use the camera far distance.
          */
         float shadowFarHint = 100.0f;
+
+        /** Number of shadow cascades to use for directional lights, between 1 and 4.
+         * The view frustum, up to shadowFar, is split into this many ranges which each get
+         * their own region of the shadow map. Higher values improve the quality of nearby
+         * shadows, at the cost of rendering the shadow casters once per cascade.
+         * This value is ignored for other types of lights.
+         */
+        uint8_t shadowCascades = 1;
     };
 
     //! Use Builder to construct a Light object instance
@@ -573,6 +581,47 @@ public:
      */
     float getIntensity(Instance i) const noexcept;
 
+    /**
+     * Dynamically updates the positions of several lights in one call, this is equivalent to
+     * calling setPosition() for each light, but cheaper when many lights are animated.
+     *
+     * @param instances Instances of the components obtained from getInstance().
+     * @param positions Lights' positions in world space, positions[k] is the position of
+     *                  instances[k].
+     * @param count     Number of lights to update.
+     *
+     * @see setPosition()
+     */
+    void setPositions(Instance const* instances, math::float3 const* positions,
+            size_t count) noexcept;
+
+    /**
+     * Dynamically updates the colors of several lights in one call, this is equivalent to
+     * calling setColor() for each light.
+     *
+     * @param instances Instances of the components obtained from getInstance().
+     * @param colors    Colors of the lights specified in the linear sRGB color-space,
+     *                  colors[k] is the color of instances[k].
+     * @param count     Number of lights to update.
+     *
+     * @see setColor()
+     */
+    void setColors(Instance const* instances, LinearColor const* colors, size_t count) noexcept;
+
+    /**
+     * Dynamically updates the intensities of several lights in one call, this is equivalent to
+     * calling setIntensity() for each light.
+     *
+     * @param instances     Instances of the components obtained from getInstance().
+     * @param intensities   Lights' intensities, intensities[k] is the intensity of
+     *                      instances[k], see setIntensity() for their units.
+     * @param count         Number of lights to update.
+     *
+     * @see setIntensity()
+     */
+    void setIntensities(Instance const* instances, float const* intensities,
+            size_t count) noexcept;
+
     /**
      * Set the falloff distance for point lights and spot lights.
      *
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//! \file
+
+#ifndef TNT_FILAMENT_LOADERCONTEXT_H
+#define TNT_FILAMENT_LOADERCONTEXT_H
+
+#include <filament/FilamentAPI.h>
+
+#include <filament/driver/BufferDescriptor.h>
+#include <filament/driver/PixelBufferDescriptor.h>
+
+#include <utils/compiler.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+
+class IndexBuffer;
+class Texture;
+class VertexBuffer;
+
+/**
+ * LoaderContext lets other threads than the engine's upload the content of vertex buffers,
+ * index buffers and textures, e.g. the threads decoding the assets being streamed.
+ *
+ * All the methods of Engine, and of the objects it creates, must be called from the thread the
+ * engine was created on. The methods of LoaderContext are the exception: they can be called
+ * from any thread, and from several threads at once. The uploads are recorded by the
+ * LoaderContext, and issued by the engine at the beginning of its next frame, in
+ * Renderer::beginFrame(), as if they had been called on the engine's thread at that time.
+ *
+ * The resources themselves are still built on the engine's thread, which is cheap, before
+ * their content is given to a LoaderContext:
+ *
+ * ~~~~~~~~~~~{.cpp}
+ *  // on the engine's thread
+ *  filament::LoaderContext* loader = engine->createLoaderContext();
+ *  filament::Texture* texture = filament::Texture::Builder()
+ *              .width(1024)
+ *              .height(1024)
+ *              .format(filament::Texture::InternalFormat::RGBA8)
+ *              .build(*engine);
+ *
+ *  // on a worker thread, once the image is decoded
+ *  loader->setImage(texture, 0, std::move(buffer));
+ *  loader->commit([](void*, size_t, void* user) {
+ *      // called on the engine's thread, the texture is ready to be used
+ *  }, asset);
+ * ~~~~~~~~~~~
+ *
+ * The resources given to a LoaderContext must not be destroyed until the callback of the
+ * commit() that follows their uploads is called.
+ *
+ * A LoaderContext is destroyed with Engine::destroy(const LoaderContext*), from the engine's
+ * thread. The uploads it still holds are dropped, and their buffers given back.
+ */
+class UTILS_PUBLIC LoaderContext : public FilamentAPI {
+public:
+    using BufferDescriptor = driver::BufferDescriptor;
+    using PixelBufferDescriptor = driver::PixelBufferDescriptor;
+
+    /**
+     * Records the upload of a buffer of a VertexBuffer, see VertexBuffer::setBufferAt().
+     *
+     * This can be called from any thread.
+     */
+    void setBufferAt(VertexBuffer* vertexBuffer, uint8_t bufferIndex,
+            BufferDescriptor&& buffer, uint32_t byteOffset = 0, uint32_t byteSize = 0) noexcept;
+
+    /**
+     * Records the upload of an IndexBuffer, see IndexBuffer::setBuffer().
+     *
+     * This can be called from any thread.
+     */
+    void setBuffer(IndexBuffer* indexBuffer,
+            BufferDescriptor&& buffer, uint32_t byteOffset = 0, uint32_t byteSize = 0) noexcept;
+
+    /**
+     * Records the upload of a whole level of a Texture, see
+     * Texture::setImage(Engine&, size_t, PixelBufferDescriptor&&).
+     *
+     * This can be called from any thread.
+     */
+    void setImage(Texture* texture, size_t level, PixelBufferDescriptor&& buffer) noexcept;
+
+    /**
+     * Records the upload of a sub-image of a level of a 2D Texture, see
+     * Texture::setImage(Engine&, size_t, uint32_t, uint32_t, uint32_t, uint32_t,
+     * PixelBufferDescriptor&&).
+     *
+     * This can be called from any thread.
+     */
+    void setImage(Texture* texture, size_t level,
+            uint32_t xoffset, uint32_t yoffset, uint32_t width, uint32_t height,
+            PixelBufferDescriptor&& buffer) noexcept;
+
+    /**
+     * Reports the completion of the uploads recorded so far.
+     *
+     * \p callback is called on the engine's thread, once the driver has processed all the
+     * uploads recorded before this call, by any thread: the resources can then be used. The
+     * memory of each upload is given back by the callback of its own buffer, which may be
+     * called later, e.g. when the driver spreads the texture uploads over several frames.
+     *
+     * This can be called from any thread.
+     *
+     * @param callback  Called with a null buffer, a size of 0 and \p user.
+     * @param user      Given to \p callback.
+     */
+    void commit(BufferDescriptor::Callback callback, void* user = nullptr) noexcept;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_LOADERCONTEXT_H
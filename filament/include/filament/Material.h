@@ -46,6 +46,7 @@ struct ShaderGenerator;
 } // namespace details
 
 class Engine;
+class Fence;
 
 class UTILS_PUBLIC Material : public FilamentAPI {
     struct BuilderDetails;
@@ -77,6 +78,18 @@ public:
         Precision precision;
     };
 
+    /**
+     * Bits of the variants mask given to compile(). A material is drawn with a variant of its
+     * programs that depends on the lights and shadows of the scene, and on the skinning and
+     * instancing of each renderable.
+     */
+    static constexpr uint8_t VARIANT_DIRECTIONAL_LIGHTING = 0x01;
+    static constexpr uint8_t VARIANT_DYNAMIC_LIGHTING     = 0x02;
+    static constexpr uint8_t VARIANT_SHADOW_RECEIVER      = 0x04;
+    static constexpr uint8_t VARIANT_SKINNING             = 0x08;
+    static constexpr uint8_t VARIANT_INSTANCING           = 0x10;
+    static constexpr uint8_t VARIANT_ALL                  = 0x1F;
+
     class Builder : public BuilderBase<BuilderDetails> {
         friend struct BuilderDetails;
     public:
@@ -91,6 +104,12 @@ public:
         // The RAM must stay valid until build() is called.
         Builder& package(const void* payload, size_t size);
 
+        // Same as package(), but the Material keeps referencing the payload instead of copying
+        // it, e.g. to build it directly over a memory-mapped .filamat file. Shaders are then
+        // only copied into the programs handed over to the driver.
+        // The RAM must stay valid and unchanged until the Material is destroyed.
+        Builder& packageView(const void* payload, size_t size);
+
         /**
          * Creates the Material object and returns a pointer to it.
          *
@@ -110,6 +129,33 @@ public:
 
     MaterialInstance* createInstance() const noexcept;
 
+    /**
+     * Builds the programs of this material ahead of time, so that the first frames using it don't
+     * stall while its shaders compile, e.g. during a loading screen. Programs are otherwise built
+     * the first time they're needed.
+     *
+     * The programs are built on filament's render thread, this call doesn't block.
+     *
+     * @param variants  Mask of VARIANT_* bits. Only the variants that use a subset of these bits
+     *                  are built. Variants that are not relevant to this material, or that were
+     *                  filtered out when it was compiled, are skipped.
+     *
+     * @return A SOFT Fence signaled once all the programs are built. Poll it with
+     *         Fence::wait(Fence::Mode::FLUSH, 0) and destroy it with Engine::destroy().
+     */
+    Fence* compile(uint8_t variants = VARIANT_ALL) noexcept;
+
+    /**
+     * Returns the variants this material was drawn with so far, as a mask where bit k is set if
+     * the variant with key k was used.
+     *
+     * Recorded over typical runs of an application, this is the usage profile matc's
+     * --variant-profile option reads to only generate the variants that are actually used.
+     * The profile is a text file with one line per material: its name followed by this mask,
+     * e.g. "DefaultMaterial 0x00000015". Masks of the same material are merged.
+     */
+    uint32_t getUsedVariants() const noexcept;
+
     const char* getName() const noexcept;
     Shading getShading()  const noexcept;
     Interpolation getInterpolation() const noexcept;
@@ -23,8 +23,15 @@
 
 #include <utils/compiler.h>
 
+#include <stddef.h>
+#include <stdint.h>
+
 namespace filament {
 
+namespace details {
+class FMaterialInstance;
+} // namespace details
+
 class Material;
 class Texture;
 class UniformBuffer;
@@ -37,6 +44,38 @@ public:
      */
     Material const* getMaterial() const noexcept;
 
+    /**
+     * A parameter resolved by getParameterHandle(). Setting a parameter through its handle
+     * doesn't look up its name.
+     *
+     * A handle is valid for all the instances of the Material it was obtained from.
+     */
+    class ParameterHandle {
+    public:
+        ParameterHandle() noexcept = default;
+
+        /**
+         * @return false if the handle was obtained for a parameter that doesn't exist
+         */
+        bool isValid() const noexcept { return mKind != Kind::INVALID; }
+
+    private:
+        friend class details::FMaterialInstance;
+        enum class Kind : uint8_t { INVALID, UNIFORM, SAMPLER };
+        ParameterHandle(Kind kind, uint32_t offset) noexcept : mOffset(offset), mKind(kind) { }
+        uint32_t mOffset = 0;   // in bytes for uniforms, index of the sampler for samplers
+        Kind mKind = Kind::INVALID;
+    };
+
+    /**
+     * Resolves a parameter once, so that it can be set many times without looking up its name.
+     *
+     * @param name      Name of the parameter as defined by Material. Cannot be nullptr.
+     * @return A handle to the parameter, invalid if the parameter doesn't exist.
+     * @throws utils::PreConditionPanic if name doesn't exist or no-op if exceptions are disabled.
+     */
+    ParameterHandle getParameterHandle(const char* name) const noexcept;
+
     /**
      * Set a uniform by name
      *
@@ -91,6 +130,45 @@ public:
      */
     void setParameter(const char* name, RgbaType type, math::float4 color) noexcept;
 
+    /**
+     * Set a uniform by handle
+     *
+     * @param handle    Valid handle of a parameter of type T, from getParameterHandle().
+     * @param value     Value of the parameter to set.
+     */
+    template<typename T>
+    void setParameter(ParameterHandle handle, T value) noexcept;
+
+    /**
+     * Set a uniform array by handle
+     *
+     * @param handle    Valid handle of a parameter array of type T, from getParameterHandle().
+     * @param values    Array of values to set to the parameter array.
+     * @param count     Size of the array to set.
+     */
+    template<typename T>
+    void setParameter(ParameterHandle handle, const T* values, size_t count) noexcept;
+
+    /**
+     * Set a texture by handle
+     *
+     * @param handle    Valid handle of a sampler parameter, from getParameterHandle().
+     * @param texture   Non nullptr Texture object pointer.
+     * @param sampler   Sampler parameters.
+     */
+    void setParameter(ParameterHandle handle,
+            Texture const* texture, TextureSampler const& sampler) noexcept;
+
+    /**
+     * Set several uniforms of the same type by handle, in a single call.
+     *
+     * @param handles   Valid handles of parameters of type T, from getParameterHandle().
+     * @param values    Value of each parameter.
+     * @param count     Number of handles and values.
+     */
+    template<typename T>
+    void setParameters(const ParameterHandle* handles, const T* values, size_t count) noexcept;
+
     /**
      * Set up a custom scissor rectangle; by default this encompasses the View.
      * 
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//! \file
+
+#ifndef TNT_FILAMENT_MORPHTARGETBUFFER_H
+#define TNT_FILAMENT_MORPHTARGETBUFFER_H
+
+#include <filament/FilamentAPI.h>
+
+#include <math/vec3.h>
+
+#include <utils/compiler.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+
+namespace details {
+class FMorphTargetBuffer;
+} // namespace details
+
+class Engine;
+
+/**
+ * MorphTargetBuffer holds the morph targets (or blend shapes) of a mesh, as sparse position and
+ * normal deltas: only the vertices a target moves are stored.
+ *
+ * The deltas are applied on the GPU, weighted by the morph weights of each Renderable using
+ * the buffer, see RenderableManager::Builder::morphing() and RenderableManager::setMorphWeights().
+ * Several Renderables drawing the same mesh can share a MorphTargetBuffer.
+ */
+class UTILS_PUBLIC MorphTargetBuffer : public FilamentAPI {
+    struct BuilderDetails;
+
+public:
+    class Builder : public BuilderBase<BuilderDetails> {
+        friend struct BuilderDetails;
+    public:
+        Builder() noexcept;
+        Builder(Builder const& rhs) noexcept;
+        Builder(Builder&& rhs) noexcept;
+        ~Builder() noexcept;
+        Builder& operator=(Builder const& rhs) noexcept;
+        Builder& operator=(Builder&& rhs) noexcept;
+
+        /**
+         * Number of vertices of the VertexBuffer the targets apply to.
+         */
+        Builder& vertexCount(uint32_t vertexCount) noexcept;
+
+        /**
+         * Number of morph targets, at most 64.
+         */
+        Builder& targetCount(uint8_t targetCount) noexcept;
+
+        /**
+         * Creates the MorphTargetBuffer object and returns a pointer to it. All the targets are
+         * initially empty.
+         *
+         * @param engine Reference to the filament::Engine to associate this MorphTargetBuffer
+         *               with.
+         *
+         * @return pointer to the newly created object or nullptr if exceptions are disabled and
+         *         an error occured.
+         *
+         * @exception utils::PostConditionPanic if a runtime error occured, such as running out of
+         *            memory or other resources.
+         * @exception utils::PreConditionPanic if a parameter to a builder function was invalid.
+         */
+        MorphTargetBuffer* build(Engine& engine);
+    private:
+        friend class details::FMorphTargetBuffer;
+    };
+
+    /**
+     * Replaces the deltas of a morph target.
+     *
+     * @param engine    Reference to the filament::Engine this MorphTargetBuffer belongs to.
+     * @param target    Index of the morph target.
+     * @param indices   Indices of the vertices moved by the target, each at most once.
+     * @param positions Position delta of each of these vertices, in model space.
+     * @param normals   Normal delta of each of these vertices, or nullptr.
+     * @param count     Number of vertices moved by the target.
+     *
+     * The data is copied, and uploaded to the GPU before the next frame that uses it.
+     */
+    void setTarget(Engine& engine, size_t target, uint32_t const* indices,
+            math::float3 const* positions, math::float3 const* normals, size_t count);
+
+    size_t getVertexCount() const noexcept;
+    size_t getTargetCount() const noexcept;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_MORPHTARGETBUFFER_H
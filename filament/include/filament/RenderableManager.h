@@ -42,6 +42,9 @@ class FRenderPrimitive;
 class FRenderableManager;
 } // namespace details
 
+class MorphTargetBuffer;
+class SkinningBuffer;
+
 class UTILS_PUBLIC RenderableManager : public FilamentAPI {
     struct BuilderDetails;
 
@@ -53,6 +56,9 @@ public:
 
     Instance getInstance(utils::Entity e) const noexcept;
 
+    // maximum number of levels of detail of a Renderable, see Builder::levelOfDetail()
+    static constexpr size_t MAX_LEVEL_OF_DETAIL_COUNT = 4;
+
     struct Bone {
         math::quatf unitQuaternion = { 1, 0, 0, 0 };
         math::float3 translation = { 0, 0, 0 };
@@ -73,6 +79,30 @@ public:
         Builder& geometry(size_t index, PrimitiveType type, VertexBuffer* vertices, IndexBuffer* indices) noexcept;
         Builder& geometry(size_t index, PrimitiveType type, VertexBuffer* vertices, IndexBuffer* indices, size_t offset, size_t count) noexcept;
         Builder& geometry(size_t index, PrimitiveType type, VertexBuffer* vertices, IndexBuffer* indices, size_t offset, size_t minIndex, size_t maxIndex, size_t count) noexcept;
+
+        /**
+         * Sets the geometry of a primitive for a given level of detail. Level 0 is the most
+         * detailed one, it's the geometry set by the methods above. A primitive that doesn't
+         * have a geometry for a level uses the geometry of the previous level. The material and
+         * blend order of a primitive are the same for all levels.
+         *
+         * @see levelOfDetail()
+         */
+        Builder& geometry(size_t index, uint8_t level, PrimitiveType type, VertexBuffer* vertices, IndexBuffer* indices, size_t offset, size_t minIndex, size_t maxIndex, size_t count) noexcept;
+
+        /**
+         * Sets when a level of detail is used.
+         *
+         * @param level         Level of detail, between 1 and MAX_LEVEL_OF_DETAIL_COUNT - 1.
+         * @param screenSize    The level is used when the height of the Renderable's bounding
+         *                      sphere on screen is smaller than this fraction of the viewport's
+         *                      height. It must decrease with the level.
+         *
+         * The Renderable has as many levels of detail as the highest level set here, plus one.
+         * The level is picked every frame for each view (and shadow map) the Renderable is
+         * visible in.
+         */
+        Builder& levelOfDetail(uint8_t level, float screenSize) noexcept;
         Builder& material(size_t index, MaterialInstance const* materialInstance) noexcept;
         // The axis aligned bounding box of the Renderable. Mandatory unless culling is disabled.
         Builder& boundingBox(const Box& axisAlignedBoundingBox) noexcept;
@@ -82,10 +112,38 @@ public:
         Builder& culling(bool enable) noexcept; // true by default
         Builder& castShadows(bool enable) noexcept; // false by default
         Builder& receiveShadows(bool enable) noexcept; // true by default
+        // Static shadow casters promise not to move or change, with View::setShadowCachingEnabled()
+        // they're not rendered in the shadow maps every frame.
+        Builder& staticShadowCaster(bool enable) noexcept; // false by default
         Builder& skinning(size_t boneCount) noexcept; // 0 by default, 255 max
         Builder& skinning(size_t boneCount, Bone const* transforms) noexcept;
         Builder& skinning(size_t boneCount, math::mat4f const* transforms) noexcept;
 
+        /**
+         * Uses boneCount bones of a SkinningBuffer shared with other Renderables, starting at
+         * offset, instead of bones owned by this Renderable. The offset must be a multiple of
+         * SkinningBuffer::getBoneOffsetAlignment(). setBones() then updates the bones of the
+         * SkinningBuffer.
+         */
+        Builder& skinning(SkinningBuffer* skinningBuffer,
+                size_t boneCount, size_t offset) noexcept;
+
+        /**
+         * Computes the bounding box of a skinned Renderable from its bones, every time they're
+         * set with setBones(), instead of using boundingBox() as is. boundingBox() is then the
+         * box of the bind pose: its bounding sphere is moved by each bone, and the bounding box
+         * of these spheres contains the skinned vertices, so that a conservative box covering
+         * all the poses isn't needed. False by default.
+         */
+        Builder& skinningBounds(bool enable) noexcept;
+
+        /**
+         * Deforms the geometry with the morph targets of a MorphTargetBuffer, which must have
+         * as many vertices as the VertexBuffers of this Renderable. The morph weights start at 0,
+         * see setMorphWeights(). Morphing is applied before skinning.
+         */
+        Builder& morphing(MorphTargetBuffer* morphTargetBuffer) noexcept;
+
         // Sets an ordering index for blended primitives that all live at the same Z value.
         Builder& blendOrder(size_t index, uint16_t order) noexcept; // 0 by default
 
@@ -134,12 +192,18 @@ public:
     void setPriority(Instance instance, uint8_t priority) noexcept;
     void setCastShadows(Instance instance, bool enable) noexcept;
     void setReceiveShadows(Instance instance, bool enable) noexcept;
+    void setStaticShadowCaster(Instance instance, bool enable) noexcept;
     bool isShadowCaster(Instance instance) const noexcept;
     bool isShadowReceiver(Instance instance) const noexcept;
+    bool isStaticShadowCaster(Instance instance) const noexcept;
 
+    // With a shared SkinningBuffer, offset is relative to this Renderable's range of bones.
     void setBones(Instance instance, Bone const* transforms, size_t boneCount = 1, size_t offset = 0) noexcept;
     void setBones(Instance instance, math::mat4f const* transforms, size_t boneCount = 1, size_t offset = 0) noexcept;
 
+    // Sets the weights of count morph targets starting at offset, see Builder::morphing().
+    void setMorphWeights(Instance instance, float const* weights, size_t count, size_t offset = 0) noexcept;
+
 
     // getters...
     const Box& getAxisAlignedBoundingBox(Instance instance) const noexcept;
@@ -147,12 +211,15 @@ public:
     // number of render primitives in this renderable
     size_t getPrimitiveCount(Instance instance) const noexcept;
 
-    // set/change the material of a given render primitive
+    // number of levels of detail of this renderable, see Builder::levelOfDetail()
+    size_t getLevelOfDetailCount(Instance instance) const noexcept;
+
+    // set/change the material of a given render primitive, at all levels of detail
     void setMaterialInstanceAt(Instance instance,
             size_t primitiveIndex, MaterialInstance const* materialInstance) noexcept;
     MaterialInstance* getMaterialInstanceAt(Instance instance, size_t primitiveIndex) const noexcept;
 
-    // set/change the geometry (vertex/index buffers) of a given primitive
+    // set/change the geometry (vertex/index buffers) of a given primitive, at level of detail 0
     void setGeometryAt(Instance instance, size_t primitiveIndex,
             PrimitiveType type, VertexBuffer* vertices, IndexBuffer* indices,
             size_t offset, size_t count) noexcept;
@@ -161,7 +228,8 @@ public:
     void setGeometryAt(Instance instance, size_t primitiveIndex,
             PrimitiveType type, size_t offset, size_t count) noexcept;
 
-    // set the blend order of the given primitive, only the first 15 bits are used
+    // set the blend order of the given primitive at all levels of detail, only the first 15 bits
+    // are used
     void setBlendOrderAt(Instance instance, size_t primitiveIndex, uint16_t order) noexcept;
 
     AttributeBitset getEnabledAttributesAt(Instance instance, size_t primitiveIndex) const noexcept;
@@ -23,6 +23,7 @@
 
 #include <utils/compiler.h>
 
+#include <stddef.h>
 #include <stdint.h>
 
 namespace filament {
@@ -30,6 +31,7 @@ namespace filament {
 class Engine;
 class SwapChain;
 class View;
+class Viewport;
 
 namespace driver {
 class PixelBufferDescriptor;
@@ -64,6 +66,88 @@ class PixelBufferDescriptor;
  */
 class UTILS_PUBLIC Renderer : public FilamentAPI {
 public:
+    /**
+     * Memory used by the per-frame allocations of a frame, all sizes are in bytes.
+     *
+     * The commands of a frame and most of its temporary data are allocated from a fixed-size
+     * arena. When it's exhausted, memory is allocated from the heap instead, which is slower.
+     * These statistics can be used to check the arena is large enough.
+     *
+     * @see getFrameMemoryStatistics()
+     */
+    struct FrameMemoryStatistics {
+        //! Size of the per-frame arena.
+        size_t arenaSize = 0;
+        //! Peak memory used by the per-frame allocations. When it's larger than arenaSize,
+        //! the difference was allocated from the heap.
+        size_t arenaHighWatermark = 0;
+        //! Initial size of the draw commands buffer, it is allocated from the per-frame arena.
+        size_t commandsSize = 0;
+        //! Peak size of the draw commands of a View. When it's larger than commandsSize, the
+        //! commands were copied to a larger buffer.
+        size_t commandsHighWatermark = 0;
+    };
+
+    /**
+     * Timings and statistics of a frame, see getFrameInfoHistory(). All times are in
+     * milliseconds.
+     */
+    struct FrameInfo {
+        //! Identifier of the frame, incremented by each beginFrame().
+        uint32_t frameId = 0;
+        //! Time between the GPU starting and finishing the frame, measured with fences.
+        float frameTime = 0;
+        //! Time spent by the GPU in the frame's passes, measured with timer queries, negative
+        //! when the backend can't time the GPU. It's the time of the latest frame the GPU was
+        //! done with when this frame ended, usually a frame or two earlier.
+        float gpuTime = -1;
+        //! Part of gpuTime spent in the shadow passes, the color passes and the post-processing
+        //! passes respectively.
+        float shadowPassGpuTime = 0;
+        float colorPassGpuTime = 0;
+        float postProcessGpuTime = 0;
+        //! Time spent on the calling thread between beginFrame() and endFrame().
+        float mainThreadTime = 0;
+        //! Part of mainThreadTime spent waiting for the driver thread to make room for more
+        //! commands. When it's large, the driver thread is the bottleneck.
+        float mainThreadWaitTime = 0;
+        //! Time the driver thread spent executing commands, between the previous frame's
+        //! endFrame() and this one's.
+        float driverThreadTime = 0;
+        //! Time the driver thread waited for commands over the same interval. When it's large
+        //! while the main thread doesn't wait, the main thread is the bottleneck.
+        float driverThreadWaitTime = 0;
+        //! Time the JobSystem's worker threads spent executing jobs, and waiting for jobs,
+        //! summed over all the workers, between the previous frame's endFrame() and this one's.
+        float workerBusyTime = 0;
+        float workerIdleTime = 0;
+        //! CPU time of the main phases of the frame, on all threads. Only measured when the
+        //! "d.profiler.phases" debug property is set, zero otherwise.
+        float scenePrepareTime = 0;
+        float cullingTime = 0;
+        float froxelizeTime = 0;
+        float commandsTime = 0;
+        float sortTime = 0;
+        float recordTime = 0;
+        //! Bytes of commands handed to the driver thread, between the previous frame's
+        //! endFrame() and this one's.
+        size_t commandBufferSize = 0;
+        //! Draw calls issued by the frame's passes (an instanced draw counts once).
+        uint32_t drawCount = 0;
+        //! Triangles drawn by the frame's passes, the other primitive types aren't counted.
+        uint32_t triangleCount = 0;
+    };
+
+    /**
+     * Information about the display the Renderer's SwapChain is presented on.
+     *
+     * @see setDisplayInfo(), beginFrame(SwapChain*, uint64_t)
+     */
+    struct DisplayInfo {
+        //! Refresh rate of the display in Hz, used to schedule the presentation of the frames.
+        float refreshRate = 60.0f;
+    };
+
      /**
       * Get the Engine that created this Renderer.
       *
@@ -225,6 +309,43 @@ public:
      */
     bool beginFrame(SwapChain* swapChain);
 
+    /**
+     * Set-up a frame for this Renderer, and schedules its presentation.
+     *
+     * Same as beginFrame(SwapChain*), but the frame is also displayed at a given vsync instead
+     * of as soon as it's ready: SwapChain::getFrameLatency() vsyncs after vsyncSteadyClockTimeNano,
+     * which leaves the CPU and the GPU that many refresh periods to work on it. This delivers
+     * the frames evenly when their cost varies, instead of displaying each as soon as it's done.
+     *
+     * The frame is skipped when it would be displayed at the same vsync as the previous one.
+     *
+     * The presentation is scheduled with EGL_ANDROID_presentation_time on OpenGL, and with
+     * VK_GOOGLE_display_timing on Vulkan. Without them, this behaves like
+     * beginFrame(SwapChain*).
+     *
+     * @param swapChain A pointer to the SwapChain instance to use.
+     * @param vsyncSteadyClockTimeNano The time of the vsync this frame starts at, in nanoseconds
+     *                                 of std::chrono::steady_clock (e.g. the frame time given by
+     *                                 Android's Choreographer).
+     *
+     * @return
+     *      *false* the current frame must be skipped,
+     *      *true* the current frame can be drawn.
+     *
+     * @see
+     * beginFrame(SwapChain*), setDisplayInfo(), SwapChain::setFrameLatency()
+     */
+    bool beginFrame(SwapChain* swapChain, uint64_t vsyncSteadyClockTimeNano);
+
+    /**
+     * Sets information about the display, used to schedule the presentation of the frames.
+     *
+     * @param info The DisplayInfo of the display the SwapChain is presented on.
+     *
+     * @see beginFrame(SwapChain*, uint64_t)
+     */
+    void setDisplayInfo(DisplayInfo const& info) noexcept;
+
     /**
      * Finishes the current frame and schedules it for display.
      *
@@ -237,6 +358,49 @@ public:
      * beginFrame()
      */
     void endFrame();
+
+    /**
+     * Same as endFrame(), but only the given regions of the SwapChain changed since the previous
+     * frame, so that only they need to be presented, e.g. when a UI redraws a few widgets.
+     *
+     * The whole frame is still rendered. This saves the composition and the transfer to the
+     * display of the regions that didn't change, on the platforms that support it
+     * (EGL_KHR_swap_buffers_with_damage, VK_KHR_incremental_present). The others present the
+     * whole frame.
+     *
+     * @param damage The regions that changed, in pixels, from the bottom-left corner of the
+     *               SwapChain. The array can be reused right after the call.
+     * @param count  The number of regions, 0 presents the whole frame.
+     */
+    void endFrame(Viewport const* damage, size_t count);
+
+    /**
+     * Returns the memory used by the per-frame allocations of the last frame, i.e. of all calls
+     * to render() between the last beginFrame() and endFrame().
+     *
+     * @return The FrameMemoryStatistics of the last frame, all zeros until a frame has ended.
+     *
+     * @see FrameMemoryStatistics
+     */
+    FrameMemoryStatistics getFrameMemoryStatistics() const noexcept;
+
+    /**
+     * Returns the FrameInfo of the latest frames the GPU has finished, oldest first.
+     *
+     * Frames are only reported once the GPU is done with them, which is usually a couple of
+     * frames after their endFrame(). Skipped frames aren't reported.
+     *
+     * @param history   Where the FrameInfo are written.
+     * @param count     Maximum number of FrameInfo written to history, at most
+     *                  FRAME_INFO_HISTORY_SIZE are available.
+     * @return The number of FrameInfo written to history.
+     *
+     * @see FrameInfo
+     */
+    size_t getFrameInfoHistory(FrameInfo* history, size_t count) const noexcept;
+
+    //! Number of frames kept by getFrameInfoHistory().
+    static constexpr size_t FRAME_INFO_HISTORY_SIZE = 5;
 };
 
 } // namespace filament
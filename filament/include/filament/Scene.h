@@ -114,6 +114,27 @@ public:
      * @return The total number of Light objects in the Scene.
      */
     size_t getLightCount() const noexcept;
+
+    /**
+     * Enables or disables hierarchical culling for this Scene.
+     *
+     * When enabled, a bounding volume hierarchy is built over the Renderable objects of the
+     * Scene, which allows culling to reject many of them at once. The hierarchy is rebuilt when
+     * Renderable objects are added or removed and refit when they move, so this is mostly
+     * beneficial for large scenes whose Renderable objects don't move much.
+     *
+     * A second hierarchy is built over the point and spot lights of the Scene, the same way.
+     *
+     * Hierarchical culling is disabled by default.
+     *
+     * @param enabled true to enable hierarchical culling, false otherwise.
+     */
+    void setHierarchicalCulling(bool enabled) noexcept;
+
+    /**
+     * @return Whether hierarchical culling is enabled for this Scene.
+     */
+    bool isHierarchicalCullingEnabled() const noexcept;
 };
 
 } // namespace filament
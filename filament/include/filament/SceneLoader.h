@@ -0,0 +1,210 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//! \file
+
+#ifndef TNT_FILAMENT_SCENELOADER_H
+#define TNT_FILAMENT_SCENELOADER_H
+
+#include <filament/FilamentAPI.h>
+
+#include <utils/compiler.h>
+#include <utils/Entity.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+
+namespace details {
+class FSceneLoader;
+} // namespace details
+
+class Box;
+class Camera;
+class Engine;
+class Scene;
+
+/**
+ * SceneLoader adds the entities of a large scene to a Scene progressively, over several frames,
+ * so that loading it doesn't stall the application.
+ *
+ * The application queues the entities with add(), along with their bounding box and a callback
+ * that creates their components (e.g. with RenderableManager::Builder::build()) and uploads
+ * their buffers and textures. At the beginning of each frame, in Renderer::beginFrame(), the
+ * SceneLoader calls the callbacks of the queued entities closest to the camera first, and adds
+ * the entities to the Scene, until the CPU time or the upload budget of the frame is spent.
+ *
+ * The uploads issued by the callbacks, or given to a LoaderContext by the threads decoding the
+ * assets, are issued in the same frame. The textures set with Texture::setStreaming() only get
+ * the levels the visible entities need, and Engine::setTextureUploadBudget() spreads large
+ * texture uploads over several frames.
+ *
+ * ~~~~~~~~~~~{.cpp}
+ *  filament::SceneLoader* loader = filament::SceneLoader::Builder()
+ *              .scene(scene)
+ *              .camera(camera)
+ *              .budget(2000)
+ *              .uploadBudget(4 * 1024 * 1024)
+ *              .build(*engine);
+ *
+ *  for (Mesh const& mesh : meshes) {
+ *      loader->add(mesh.entity, mesh.aabb, [](filament::Engine& engine, utils::Entity entity,
+ *              void* user) -> size_t {
+ *          Mesh const* mesh = static_cast<Mesh const*>(user);
+ *          // creates the buffers and the renderable, returns the number of bytes uploaded
+ *          return mesh->build(engine, entity);
+ *      }, &mesh);
+ *  }
+ *
+ *  // later, once loader->getPendingCount() returns 0
+ *  engine->destroy(loader);
+ * ~~~~~~~~~~~
+ *
+ * The Scene and the Camera must outlive the SceneLoader. The entities still queued when it's
+ * destroyed are dropped, and their callbacks aren't called.
+ */
+class UTILS_PUBLIC SceneLoader : public FilamentAPI {
+    struct BuilderDetails;
+
+public:
+    /**
+     * Called on the engine's thread to create the components of an entity and upload their
+     * content. The entity is added to the Scene when the callback returns.
+     *
+     * @return The number of bytes the callback uploaded, counted against the upload budget.
+     */
+    using LoadCallback = size_t(*)(Engine& engine, utils::Entity entity, void* user);
+
+    //! Use Builder to construct a SceneLoader object instance
+    class Builder : public BuilderBase<BuilderDetails> {
+        friend struct BuilderDetails;
+    public:
+        Builder() noexcept;
+        Builder(Builder const& rhs) noexcept;
+        Builder(Builder&& rhs) noexcept;
+        ~Builder() noexcept;
+        Builder& operator=(Builder const& rhs) noexcept;
+        Builder& operator=(Builder&& rhs) noexcept;
+
+        /**
+         * Sets the Scene the entities are added to.
+         *
+         * @param scene The Scene, which must outlive the SceneLoader.
+         *
+         * @return This Builder, for chaining calls.
+         */
+        Builder& scene(Scene* scene) noexcept;
+
+        /**
+         * (optional) Sets the Camera whose position sets the order the entities are loaded in,
+         * see SceneLoader::setCamera(). Without one, they're loaded in the order they're added.
+         *
+         * @param camera The Camera, which must outlive the SceneLoader.
+         *
+         * @return This Builder, for chaining calls.
+         */
+        Builder& camera(Camera const* camera) noexcept;
+
+        /**
+         * (optional) CPU time spent loading entities in each frame, in microseconds. The
+         * default is 2000.
+         *
+         * @param microseconds Time budget per frame.
+         *
+         * @return This Builder, for chaining calls.
+         */
+        Builder& budget(uint32_t microseconds) noexcept;
+
+        /**
+         * (optional) Number of bytes the callbacks can upload in each frame, 0 means no limit.
+         * The default is 8 MiB.
+         *
+         * @param bytes Upload budget per frame.
+         *
+         * @return This Builder, for chaining calls.
+         */
+        Builder& uploadBudget(size_t bytes) noexcept;
+
+        /**
+         * Creates the SceneLoader object and returns a pointer to it.
+         *
+         * @param engine Reference to the filament::Engine to associate this SceneLoader with.
+         *
+         * @return pointer to the newly created object or nullptr if exceptions are disabled and
+         *         an error occured.
+         *
+         * @exception utils::PreConditionPanic if a parameter to a builder function was invalid.
+         */
+        SceneLoader* build(Engine& engine);
+
+    private:
+        friend class details::FSceneLoader;
+    };
+
+    /**
+     * Queues an entity to be loaded in one of the next frames.
+     *
+     * At least one entity is loaded each frame, the budgets are checked after each callback.
+     *
+     * @param entity    The entity to load, which must not be destroyed until it's loaded or
+     *                  removed from the SceneLoader.
+     * @param aabb      The bounding box of the entity in world space, used for its priority.
+     * @param callback  Called to create the components of the entity.
+     * @param user      Given to \p callback.
+     */
+    void add(utils::Entity entity, Box const& aabb, LoadCallback callback,
+            void* user = nullptr) noexcept;
+
+    /**
+     * Removes an entity which hasn't been loaded yet. Its callback won't be called.
+     *
+     * @param entity    The entity to remove, does nothing if it isn't queued.
+     */
+    void remove(utils::Entity entity) noexcept;
+
+    /**
+     * Sets the Camera whose position sets the order the entities are loaded in: the closest
+     * to the camera first. Typically the camera of the main View.
+     *
+     * @param camera    The Camera, which must outlive the SceneLoader, or nullptr to load the
+     *                  entities in the order they're added.
+     */
+    void setCamera(Camera const* camera) noexcept;
+
+    /**
+     * Sets the CPU time spent loading entities in each frame.
+     *
+     * @param microseconds  Time budget per frame.
+     */
+    void setBudget(uint32_t microseconds) noexcept;
+
+    /**
+     * Sets the number of bytes the callbacks can upload in each frame.
+     *
+     * @param bytes Upload budget per frame, 0 means no limit.
+     */
+    void setUploadBudget(size_t bytes) noexcept;
+
+    /**
+     * Returns the number of entities which haven't been loaded yet.
+     */
+    size_t getPendingCount() const noexcept;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_SCENELOADER_H
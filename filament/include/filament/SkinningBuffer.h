@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+//! \file
+
+#ifndef TNT_FILAMENT_SKINNINGBUFFER_H
+#define TNT_FILAMENT_SKINNINGBUFFER_H
+
+#include <filament/FilamentAPI.h>
+#include <filament/RenderableManager.h>
+
+#include <math/mat4.h>
+
+#include <utils/compiler.h>
+
+#include <stddef.h>
+
+namespace filament {
+
+namespace details {
+class FSkinningBuffer;
+} // namespace details
+
+class Engine;
+
+/**
+ * SkinningBuffer holds the bones of many skinned Renderables in a single GPU buffer.
+ *
+ * Each Renderable uses a range of the buffer, see RenderableManager::Builder::skinning(). All the
+ * bones set during a frame are uploaded at once, instead of once per Renderable, which is much
+ * cheaper when drawing many skinned Renderables.
+ */
+class UTILS_PUBLIC SkinningBuffer : public FilamentAPI {
+    struct BuilderDetails;
+
+public:
+    using Bone = RenderableManager::Bone;
+
+    class Builder : public BuilderBase<BuilderDetails> {
+        friend struct BuilderDetails;
+    public:
+        Builder() noexcept;
+        Builder(Builder const& rhs) noexcept;
+        Builder(Builder&& rhs) noexcept;
+        ~Builder() noexcept;
+        Builder& operator=(Builder const& rhs) noexcept;
+        Builder& operator=(Builder&& rhs) noexcept;
+
+        /**
+         * Size of the buffer in bones. This is the sum of the bone counts of the Renderables
+         * using it, each rounded up to getBoneOffsetAlignment().
+         */
+        Builder& boneCount(uint32_t boneCount) noexcept;
+
+        /**
+         * Creates the SkinningBuffer object and returns a pointer to it. All the bones are
+         * initialized to the identity.
+         *
+         * @param engine Reference to the filament::Engine to associate this SkinningBuffer with.
+         *
+         * @return pointer to the newly created object or nullptr if exceptions are disabled and
+         *         an error occured.
+         *
+         * @exception utils::PostConditionPanic if a runtime error occured, such as running out of
+         *            memory or other resources.
+         * @exception utils::PreConditionPanic if a parameter to a builder function was invalid.
+         */
+        SkinningBuffer* build(Engine& engine);
+    private:
+        friend class details::FSkinningBuffer;
+    };
+
+    /**
+     * Updates boneCount bones starting at offset. The new bones are uploaded with all the other
+     * changes made to this buffer during the frame.
+     */
+    void setBones(Engine& engine, Bone const* transforms, size_t boneCount, size_t offset = 0);
+    void setBones(Engine& engine, math::mat4f const* transforms, size_t boneCount,
+            size_t offset = 0);
+
+    size_t getBoneCount() const noexcept;
+
+    /**
+     * The offset of each Renderable in this buffer must be a multiple of this number of bones.
+     */
+    size_t getBoneOffsetAlignment() const noexcept;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_SKINNINGBUFFER_H
@@ -56,8 +56,13 @@ class Texture;
  * ~~~~~~~~~~~
  *
  *
- * @note
- * Currently only Texture based sky boxes are supported.
+ * On low-end devices, where fetching the environment for every pixel of the background is
+ * measurable, the environment can be sampled at a coarser level (see Builder::environmentLevel()),
+ * or replaced by the irradiance of the Scene's IndirectLight, which needs no texture at all (see
+ * Builder::irradiance()).
+ *
+ * The skybox is drawn after all the opaque objects, at the far plane, so that the pixels they
+ * cover are rejected by the depth test before being shaded.
  *
  * @see Scene, IndirectLight
  */
@@ -87,6 +92,32 @@ public:
          */
         Builder& environment(Texture* cubemap) noexcept;
 
+        /**
+         * Samples the environment map at a coarser level, e.g. one of the smaller levels of
+         * the reflections map of the IndirectLight. Sampling a small level is much cheaper, at
+         * the cost of a blurrier sky. The default value is 0, which samples the full resolution.
+         *
+         * @param level Level of the environment map to sample, the environment map must have
+         *              at least level + 1 levels.
+         *
+         * @return This Builder, for chaining calls.
+         */
+        Builder& environmentLevel(uint8_t level) noexcept;
+
+        /**
+         * Renders the irradiance of the Scene's IndirectLight (its spherical harmonics) instead
+         * of the environment map. No texture is sampled, which makes it the cheapest skybox,
+         * suitable for a background that's mostly hidden, or blurred anyway. An environment map
+         * isn't needed in this mode. The default value is false.
+         *
+         * @param enabled True to render the irradiance, false to render the environment map.
+         *
+         * @return This Builder, for chaining calls.
+         *
+         * @see IndirectLight::Builder::irradiance()
+         */
+        Builder& irradiance(bool enabled) noexcept;
+
         /**
          * Indicates whether the sun should be rendered. The sun can only be
          * rendered if there is at least one light of type SUN in the scene.
@@ -19,6 +19,7 @@
 
 #include <filament/FilamentAPI.h>
 
+#include <filament/driver/BufferDescriptor.h>
 #include <filament/driver/DriverEnums.h>
 #include <filament/driver/PixelBufferDescriptor.h>
 
@@ -36,7 +37,12 @@ class UTILS_PUBLIC Stream : public FilamentAPI {
     struct BuilderDetails;
 
 public:
-    //! Use Builder to construct an Stream object instance
+    /**
+     * Use Builder to construct an Stream object instance.
+     *
+     * A stream built without a stream source (see stream()) is an acquired stream, which gets
+     * its images from setAcquiredImage().
+     */
     class Builder : public BuilderBase<BuilderDetails> {
         friend struct BuilderDetails;
     public:
@@ -98,6 +104,7 @@ public:
          * @param engine Reference to the filament::Engine to associate this Stream with.
          *
          * @return pointer to the newly created object, or nullptr if the stream couldn't be created.
+         *         Acquired streams are only supported by the OpenGL backend.
          */
         Stream* build(Engine& engine);
 
@@ -110,6 +117,27 @@ public:
      */
     bool isNativeStream() const noexcept;
 
+    /**
+     * Updates an acquired stream with a new image, which the textures using the stream sample
+     * from the next commands on, without any copy. The image is typically produced by the camera
+     * or a video decoder.
+     *
+     * @param image         The buffer of the image. On Android, an AHardwareBuffer* with the
+     *                      AHARDWAREBUFFER_USAGE_GPU_SAMPLED_IMAGE usage.
+     * @param acquireFence  A fence signaled once the image is written (on Android, a sync file
+     *                      descriptor), or -1 if it's ready. Filament takes ownership of it. The
+     *                      GPU waits for it, the CPU doesn't.
+     * @param callback      Called with the image once Filament doesn't use it anymore, i.e. once
+     *                      the GPU is done with the frames which sampled it, after another image
+     *                      was set or the stream was destroyed. It's called on the application
+     *                      thread, like the callbacks of BufferDescriptor.
+     * @param user          An opaque pointer given to the callback.
+     *
+     * The stream must be an acquired stream, see Builder.
+     */
+    void setAcquiredImage(void* image, int acquireFence,
+            driver::BufferDescriptor::Callback callback, void* user) noexcept;
+
     /**
      * Updates the size of the incoming stream. Whether this value is used is
      *              stream dependent. On Android, it must be set when using
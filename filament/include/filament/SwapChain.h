@@ -144,7 +144,50 @@ class UTILS_PUBLIC SwapChain : public FilamentAPI {
 public:
     static const uint64_t CONFIG_TRANSPARENT = driver::SWAP_CHAIN_CONFIG_TRANSPARENT;
 
+    /**
+     * The frames are presented at the next vsync without waiting for it, a frame replacing the
+     * one still waiting to be displayed, if any. This lowers the latency without tearing.
+     * Only supported by the Vulkan backend, when the surface supports it.
+     */
+    static const uint64_t CONFIG_PRESENT_MAILBOX = driver::SWAP_CHAIN_CONFIG_PRESENT_MAILBOX;
+
+    /**
+     * The frames are presented right away, which gives the lowest latency but can tear.
+     * Only supported by the Vulkan backend, when the surface supports it.
+     */
+    static const uint64_t CONFIG_PRESENT_IMMEDIATE = driver::SWAP_CHAIN_CONFIG_PRESENT_IMMEDIATE;
+
     void* getNativeWindow() const noexcept;
+
+    /**
+     * @return Whether this SwapChain was created with Engine::createSwapChain(uint32_t, uint32_t,
+     *         uint64_t), in which case it isn't associated with a window.
+     */
+    bool isHeadless() const noexcept;
+
+    /**
+     * Sets how many frames the CPU can run ahead of the GPU when rendering into this SwapChain.
+     *
+     * When the GPU is further behind, Renderer::beginFrame() skips frames. A latency of 1
+     * minimizes the input latency but the CPU and GPU then mostly wait for each other, a larger
+     * latency lets them run in parallel and absorbs the frames that take longer, at the cost of
+     * input latency. The default is 2.
+     *
+     * When the frames are scheduled with Renderer::beginFrame(SwapChain*, uint64_t), a frame is
+     * displayed this many vsyncs after its vsync.
+     *
+     * A headless SwapChain never skips frames, Renderer::beginFrame() waits for the GPU instead,
+     * so this is the number of frames in flight.
+     *
+     * @param latency The number of frames, clamped to [1, 4].
+     */
+    void setFrameLatency(uint8_t latency) noexcept;
+
+    /**
+     * @return The number of frames the CPU can run ahead of the GPU.
+     * @see setFrameLatency()
+     */
+    uint8_t getFrameLatency() const noexcept;
 };
 
 } // namespace filament
@@ -77,10 +77,17 @@ public:
     using Format = driver::PixelDataFormat;                         //!< Pixel color format
     using Type = driver::PixelDataType;                             //!< Pixel data format
     using FaceOffsets = driver::FaceOffsets;                        //!< Cube map faces offsets
+    using Region = driver::TextureRegion;                           //!< Rectangle of a level
     using Usage = driver::TextureUsage;                             //!< Usage affects texel layout
 
     static bool isTextureFormatSupported(Engine& engine, InternalFormat format) noexcept;
 
+    /**
+     * Returns whether generateMipmaps(Engine&) works with a format on this platform, i.e.
+     * whether the GPU can filter and render to it.
+     */
+    static bool isTextureFormatMipmappable(Engine& engine, InternalFormat format) noexcept;
+
     static size_t computeTextureDataSize(Texture::Format format, Texture::Type type,
             size_t stride, size_t height, size_t alignment) noexcept;
 
@@ -110,9 +117,9 @@ public:
         Builder& height(uint32_t height) noexcept;
 
         /**
-         * Specifies the depth in texels of the texture. Doesn't need to be a power-of-two.
-         * This creates a 3D textures.
-         * @param depth Depth of the texture in texels (default: 1).
+         * Specifies the depth in texels of a 3D texture, or the number of layers of a 2D array.
+         * Doesn't need to be a power-of-two.
+         * @param depth Depth of the texture in texels, or layers (default: 1).
          * @return This Builder, for chaining calls.
          */
         Builder& depth(uint32_t depth) noexcept;
@@ -127,9 +134,11 @@ public:
         Builder& levels(uint8_t levels) noexcept;
 
         /**
-         * Specifies whether this texture is a cubemap
-         * @param target either driver::SamplerType::SAMPLER_2D or
-         *                      driver::SamplerType::SAMPLER_CUBEMAP
+         * Specifies the type of this texture, e.g. whether it's a cubemap
+         * @param target either driver::SamplerType::SAMPLER_2D,
+         *                      driver::SamplerType::SAMPLER_CUBEMAP,
+         *                      driver::SamplerType::SAMPLER_2D_ARRAY or
+         *                      driver::SamplerType::SAMPLER_3D
          * @return This Builder, for chaining calls.
          * @see Sampler
          */
@@ -245,6 +254,11 @@ public:
      * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
      * setImage(engine, level, 0, 0, getWidth(level), getHeight(level), buffer);
      * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+     * or, for driver::SamplerType::SAMPLER_2D_ARRAY and driver::SamplerType::SAMPLER_3D, which
+     * are set whole:
+     * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+     * setImage(engine, level, 0, 0, 0, getWidth(level), getHeight(level), getDepth(level), buffer);
+     * ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
      *
      * @see Builder::sampler()
      */
@@ -276,6 +290,61 @@ public:
             uint32_t xoffset, uint32_t yoffset, uint32_t width, uint32_t height,
             PixelBufferDescriptor&& buffer) const noexcept;
 
+    /**
+     * Updates a sub-box of a 3D texture level, or layers of a 2D array.
+     *
+     * Many instances can share a 2D array, each with its own layer, so that they use the same
+     * material instance and can be batched, where they would each need their own 2D texture.
+     *
+     * @param engine    Engine this texture is associated to.
+     * @param level     Level to set the image for.
+     * @param xoffset   Left offset of the sub-region to update.
+     * @param yoffset   Bottom offset of the sub-region to update.
+     * @param zoffset   Depth offset of the sub-region to update, or first layer to update.
+     * @param width     Width of the sub-region to update.
+     * @param height    Height of the sub-region to update.
+     * @param depth     Depth of the sub-region to update, or number of layers to update.
+     * @param buffer    Client-side buffer containing the slices or layers to set, one after the
+     *                  other.
+     *
+     * @attention \p engine must be the instance passed to Builder::build()
+     * @attention \p level must be less than getLevels().
+     * @attention \p buffer's driver::PixelDataFormat must match that of getFormat().
+     * @attention This Texture instance must use driver::SamplerType::SAMPLER_2D_ARRAY or
+     *            driver::SamplerType::SAMPLER_3D or it has no effect
+     *
+     * @see Builder::sampler(), Builder::depth()
+     */
+    void setImage(Engine& engine, size_t level,
+            uint32_t xoffset, uint32_t yoffset, uint32_t zoffset,
+            uint32_t width, uint32_t height, uint32_t depth,
+            PixelBufferDescriptor&& buffer) const noexcept;
+
+    /**
+     * Updates several sub-images of a 2D texture level at once, e.g. the tiles of an atlas that
+     * changed. The pixels of all the regions are in the same buffer, which is uploaded as a
+     * whole, this is cheaper than calling setImage() for each of them.
+     *
+     * @param engine    Engine this texture is associated to.
+     * @param level     Level to update.
+     * @param regions   The sub-regions to update, and where their pixels are in \p buffer. They're
+     *                  copied, they don't need to outlive this call.
+     * @param count     Number of sub-regions in \p regions.
+     * @param buffer    Client-side buffer containing the pixels of all the sub-regions. Its
+     *                  left, top and stride are ignored, see Region::offset and Region::stride.
+     *
+     * @attention \p engine must be the instance passed to Builder::build()
+     * @attention \p level must be less than getLevels().
+     * @attention \p buffer's driver::PixelDataFormat must match that of getFormat(), and it
+     *            can't be compressed.
+     * @attention This Texture instance must use driver::SamplerType::SAMPLER_2D or
+     *            driver::SamplerType::SAMPLER_EXTERNAL, see setImage() above.
+     *
+     * @see Region, Builder::sampler()
+     */
+    void setImage(Engine& engine, size_t level, Region const* regions, size_t count,
+            PixelBufferDescriptor&& buffer) const noexcept;
+
     /**
      * Specify all six images of a cube map level.
      *
@@ -342,9 +411,63 @@ public:
      * @param engine        Engine this texture is associated to.
      *
      * @attention \p engine must be the instance passed to Builder::build()
-     * @attention This Texture instance must NOT use driver::SamplerType::SAMPLER_CUBEMAP or it has no effect
+     * @attention This Texture instance must NOT use driver::SamplerType::SAMPLER_EXTERNAL or it has no effect
+     * @attention The format of this Texture must be mipmappable, see isTextureFormatMipmappable(),
+     *            or it has no effect
      */
     void generateMipmaps(Engine& engine) const noexcept;
+
+    /**
+     * Sets the base level of a driver::SamplerType::SAMPLER_2D texture and generates all the
+     * other levels from it.
+     *
+     * The levels are generated by the GPU when the format is mipmappable, see
+     * isTextureFormatMipmappable(). Otherwise they're generated from \p buffer on the CPU, in
+     * the background, and uploaded at the end of a later frame, until then only the base level is
+     * sampled.
+     *
+     * @param engine        Engine this texture is associated to.
+     * @param buffer        Client-side buffer containing the base level, see setImage().
+     *                      On the CPU, only R, RG, RGB and RGBA buffers of UBYTE, HALF or FLOAT
+     *                      can be filtered, other buffers set the base level only.
+     *
+     * @attention \p engine must be the instance passed to Builder::build()
+     * @attention The pixels are filtered as stored, in particular sRGB pixels aren't linearized
+     *            on the CPU.
+     */
+    void generateMipmaps(Engine& engine, PixelBufferDescriptor&& buffer) const noexcept;
+
+    /**
+     * Called by a streamed texture for a level it needs, see setStreaming().
+     *
+     * @param texture   The texture the level is needed for.
+     * @param level     The level needed, all the coarser levels are already uploaded.
+     * @param user      The user pointer given to setStreaming().
+     */
+    using StreamingCallback = void(*)(Texture* texture, size_t level, void* user);
+
+    /**
+     * Lets the Engine decide which levels of this texture are uploaded, based on how large the
+     * renderables using it appear on screen, and on the texture streaming budget (see
+     * Engine::setTextureStreamingBudget()).
+     *
+     * The application uploads the coarsest levels itself. The Engine then asks for the finer
+     * levels it needs, one at a time, by calling \p callback from Renderer::endFrame(). The
+     * application uploads each level with setImage(), whole, whenever it's ready.
+     *
+     * When the budget is exceeded, the finest levels of the least recently seen textures are
+     * evicted: they're not sampled anymore, and will be asked for again when needed.
+     *
+     * @param engine        Engine this texture is associated to.
+     * @param callback      Called with the levels needed, nullptr stops streaming this texture.
+     * @param user          Passed to \p callback.
+     *
+     * @attention \p engine must be the instance passed to Builder::build()
+     * @attention Only the samplers of type driver::SamplerType::SAMPLER_2D can be streamed.
+     *
+     * @see Engine::setTextureStreamingBudget()
+     */
+    void setStreaming(Engine& engine, StreamingCallback callback, void* user = nullptr) noexcept;
 };
 
 } // namespace filament
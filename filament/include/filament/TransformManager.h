@@ -24,6 +24,9 @@
 #include <utils/EntityInstance.h>
 
 #include <math/mat4.h>
+#include <math/vec3.h>
+
+#include <stddef.h>
 
 namespace filament {
 
@@ -124,6 +127,38 @@ public:
      */
     void setTransform(Instance ci, const math::mat4f& localTransform) noexcept;
 
+    /**
+     * Sets the local transforms of many transform components at once.
+     * @param instances         Array of \p count instances of transform components.
+     * @param localTransforms   Array of \p count local transforms, localTransforms[i] is the local
+     *                          transform of instances[i].
+     * @param count             Number of transforms to set.
+     *
+     * Within a local transform transaction, the local transforms are only copied and the world
+     * transforms are computed once by commitLocalTransformTransaction(), which is the most
+     * efficient way to update a lot of transforms. Outside of a transaction, this is equivalent
+     * to calling setTransform() for each instance.
+     *
+     * @see setTransform(), openLocalTransformTransaction()
+     */
+    void setTransforms(Instance const* instances, math::mat4f const* localTransforms,
+            size_t count) noexcept;
+
+    /**
+     * Sets the local transforms of many transform components at once, from affine transforms.
+     * @param instances         Array of \p count instances of transform components.
+     * @param affineTransforms  Array of 4 * \p count vectors. Each transform is given by its
+     *                          first three rows, stored by columns: the three basis vectors
+     *                          followed by the translation. The last row is always (0, 0, 0, 1).
+     * @param count             Number of transforms to set.
+     *
+     * This is the same as setTransforms() above, but reads 48 bytes per transform instead of 64.
+     *
+     * @see setTransform(), openLocalTransformTransaction()
+     */
+    void setTransforms(Instance const* instances, math::float3 const* affineTransforms,
+            size_t count) noexcept;
+
     /**
      * Returns the local transform of a transform component.
      * @param ci The instance of the transform component to query the local transform from.
@@ -17,6 +17,7 @@
 #ifndef TNT_FILAMENT_VERTEXBUFFER_H
 #define TNT_FILAMENT_VERTEXBUFFER_H
 
+#include <filament/Box.h>
 #include <filament/EngineEnums.h>
 #include <filament/FilamentAPI.h>
 
@@ -39,6 +40,7 @@ class UTILS_PUBLIC VertexBuffer : public FilamentAPI {
 public:
     using AttributeType = driver::ElementType;
     using BufferDescriptor = driver::BufferDescriptor;
+    using Usage = driver::Usage;
 
     class Builder : public BuilderBase<BuilderDetails> {
         friend struct BuilderDetails;
@@ -63,6 +65,43 @@ public:
         // no-op if attribute is an invalid enum
         Builder& normalized(VertexAttribute attribute) noexcept;
 
+        /**
+         * Specifies how often the buffers are updated. Usage::DYNAMIC buffers can be updated
+         * every frame without stalling the GPU, at the cost of more memory.
+         *
+         * @param usage Defaults to Usage::STATIC.
+         */
+        Builder& usage(Usage usage) noexcept;
+
+        /**
+         * Quantizes the attributes when they're uploaded, which roughly halves the memory and
+         * bandwidth taken by the vertices. The attributes are still declared and given to
+         * setBufferAt() as floats:
+         *  - FLOAT3 and FLOAT4 POSITION are stored as HALF4, or as normalized SHORT4 with
+         *    positionBounds(),
+         *  - FLOAT4 TANGENTS (a quaternion) are stored as normalized SHORT4,
+         *  - FLOAT2 UV0 and UV1 are stored as HALF2.
+         *
+         * The other attributes are stored as they are declared. Only the buffers whose
+         * attributes are interleaved (each vertex within the stride) are quantized, and the
+         * ranges uploaded to these buffers must start and end on a vertex.
+         *
+         * @param enabled Defaults to false.
+         */
+        Builder& quantized(bool enabled = true) noexcept;
+
+        /**
+         * Stores the quantized positions as normalized SHORT4 within this box, instead of HALF4,
+         * for a precision independent of the distance to the origin. The renderables drawing
+         * the buffer undo the quantization with their world transform, so their positions must
+         * not be skinned nor morphed.
+         *
+         * @param bounds A box enclosing all the positions, in model space.
+         *
+         * @see quantized()
+         */
+        Builder& positionBounds(Box const& bounds) noexcept;
+
         /**
          * Creates the VertexBuffer object and returns a pointer to it.
          *
@@ -120,6 +120,7 @@ public:
         DEFAULT = -1,
         DISABLED,
         ENABLED,
+        AUTOMATIC,
     };
 
     /**
@@ -135,12 +136,44 @@ public:
      *
      * The best strategy may depend on the scene and/or GPU.
      *
+     * With DepthPrepass::AUTOMATIC, only the opaque renderables with a lit material that cover
+     * a large part of the viewport (estimated from their bounding box) are drawn in the depth
+     * pre-pass: they're the ones likely to hide other objects, and their shading is expensive.
+     * The others are drawn once, sorted as if there were no depth pre-pass.
+     *
      * @param prepass   DepthPrepass::DEFAULT uses the most appropriate strategy,
      *                  DepthPrepass::DISABLED disables the depth pre-pass,
-     *                  DepthPrepass::ENABLE enables the depth pre-pass.
+     *                  DepthPrepass::ENABLE enables the depth pre-pass,
+     *                  DepthPrepass::AUTOMATIC enables it for the large occluders only.
      */
     void setDepthPrepass(DepthPrepass prepass) noexcept;
 
+    enum class SortOrder : int8_t {
+        DEFAULT = -1,
+        DEPTH_FIRST,
+        MATERIAL_FIRST,
+        FRONT_TO_BACK,
+    };
+
+    /**
+     * Sets how opaque objects are ordered when this view is rendered without a depth pre-pass.
+     *
+     * With DEPTH_FIRST, objects are bucketed by distance, front to back, and sorted by material
+     * within each bucket, which minimizes overdraw. With MATERIAL_FIRST, objects are sorted by
+     * material and front to back within each material, which minimizes the program and
+     * material state changes. With FRONT_TO_BACK, objects are sorted by distance only (and by
+     * material at equal distances), which minimizes overdraw at the cost of the most state
+     * changes.
+     *
+     * With the depth pre-pass enabled, objects are always sorted by material.
+     *
+     * @param order     SortOrder::DEFAULT picks the order best suited to the backend,
+     *                  SortOrder::DEPTH_FIRST minimizes overdraw,
+     *                  SortOrder::MATERIAL_FIRST minimizes state changes,
+     *                  SortOrder::FRONT_TO_BACK minimizes overdraw regardless of state changes.
+     */
+    void setSortOrder(SortOrder order) noexcept;
+
     /**
      * Sets the View's name. Only useful for debugging.
      * @param name Pointer to the View's name. The string is copied.
@@ -212,6 +245,51 @@ public:
         return const_cast<View*>(this)->getCamera();
     }
 
+    /**
+     * Renders this View in stereo, side by side: the View's Camera is the left eye and renders
+     * into the left half of the Viewport, \p rightEye renders into the right half.
+     *
+     * The scene is culled once for both eyes, and the draw commands are generated and sorted
+     * once, then recorded for each eye with its own camera uniforms. Both cameras should look
+     * in the same direction from nearby positions.
+     *
+     * Point and spot lights are assigned to the screen with the left eye's camera, which is
+     * approximate for the right eye. Occlusion culling and temporal upscaling are disabled.
+     *
+     * @param rightEye  The Camera of the right eye, or nullptr to render in mono (the default).
+     *                  The View doesn't take ownership of the Camera pointer.
+     */
+    void setStereoCamera(Camera* rightEye) noexcept;
+
+    /**
+     * Returns the Camera of the right eye set by setStereoCamera(), or nullptr.
+     */
+    Camera const* getStereoCamera() const noexcept;
+
+    /**
+     * Reuses the culling and lighting results of another View, instead of computing them again.
+     * This is useful when the same Scene is rendered from the same Camera into several Views,
+     * e.g. a main View and a low resolution reflection or minimap overlay.
+     *
+     * The Scene is prepared and culled, and its lights are culled and sorted, only once per
+     * frame, by \p view. The results are reused when \p view was rendered earlier in the same
+     * frame, with the same Scene, culling Camera and visible layers, and no other View
+     * rendered that Scene in between. Otherwise this View computes its own results.
+     *
+     * The shadow options and the dynamic lighting limits of both Views should match, since the
+     * shadow casters and the lights are those \p view found. Each View still assigns the lights
+     * to its own froxels, as those depend on its Viewport.
+     *
+     * @param view  The View whose results are reused, or nullptr to compute them (the default).
+     *              The View doesn't take ownership of the View pointer.
+     */
+    void setCullingSource(View const* view) noexcept;
+
+    /**
+     * Returns the View set by setCullingSource(), or nullptr.
+     */
+    View const* getCullingSource() const noexcept;
+
     /**
      * Set this View Viewport.
      *
@@ -290,6 +368,59 @@ public:
      */
     void setShadowsEnabled(bool enabled) noexcept;
 
+    /**
+     * Enable or disable the caching of static shadow casters. Disabled by default.
+     *
+     * When enabled, static shadow casters are rendered in a cache that persists across frames,
+     * which is only updated when the light moves or the static casters change. Each frame the
+     * cache is copied in the shadow maps and only dynamic casters are rendered on top of it.
+     * This works best for spot lights, and for the directional light when the camera doesn't
+     * move, and requires twice the memory for shadow maps.
+     *
+     * @param enabled true enables shadow caching, false disables it.
+     *
+     * @see Renderable::Builder::staticShadowCaster()
+     */
+    void setShadowCachingEnabled(bool enabled) noexcept;
+
+    /**
+     * Enables or disables shadow map auto-sizing. Disabled by default.
+     *
+     * When enabled, the dimension of each shadow map is chosen every frame to match the area its
+     * shadow receivers cover in the viewport, rounded to a power of two. The shadow map dimension
+     * given by LightManager::ShadowOptions::mapSize becomes the maximum dimension. This saves
+     * memory and bandwidth when the receivers are far away or cover a small part of the screen.
+     *
+     * @param enabled true enables shadow map auto-sizing, false disables it.
+     */
+    void setShadowAutoSizingEnabled(bool enabled) noexcept;
+
+    enum class ShadowType : uint8_t {
+        PCF,    //!< percentage-closer filtering of the depths of the shadow maps
+        EVSM,   //!< exponential variance shadow maps
+    };
+
+    /**
+     * Sets how the shadow maps are filtered. Defaults to ShadowType::PCF.
+     *
+     * With ShadowType::PCF, each shadow receiver compares its depth with several texels of the
+     * shadow map. With ShadowType::EVSM, the shadow maps are converted to exponential moments
+     * which are blurred once per texel, and each receiver samples them once: this is cheaper
+     * when the receivers cover more pixels than the shadow maps have texels, and gives softer
+     * shadows, at the cost of two RGBA16F textures the size of the shadow maps and of some
+     * light bleeding where the shadow casters overlap.
+     *
+     * ShadowType::EVSM falls back to ShadowType::PCF when the driver can't render to RGBA16F.
+     *
+     * @param type the filtering of the shadow maps.
+     */
+    void setShadowType(ShadowType type) noexcept;
+
+    /**
+     * Returns the filtering of the shadow maps set by setShadowType().
+     */
+    ShadowType getShadowType() const noexcept;
+
     /**
      * Specifies which buffers can be discarded before rendering.
      *
@@ -379,6 +510,36 @@ public:
      */
     void setDynamicLightingOptions(float zLightNear, float zLightFar) noexcept;
 
+    /**
+     * Sets upper bounds for the dynamic lighting of this view.
+     *
+     * The froxel grid, used to find the lights affecting each pixel, is sized every frame from
+     * the viewport's dimensions and the number of visible lights. Lowering these limits reduces
+     * the memory and CPU time used by dynamic lighting, which can be useful on low-end devices.
+     *
+     * @param maxFroxelCount Maximum number of froxels used by this view, between 1024 and
+     *                       8192 (Default 8192).
+     *
+     * @param maxLightCount  Maximum number of point and spot lights used by this view, the lights
+     *                       with the largest contribution on screen (intensity times projected
+     *                       radius) are kept, and fade out as they get close to the lights left
+     *                       out. At most 256 (Default 256).
+     */
+    void setDynamicLightingLimits(uint32_t maxFroxelCount, uint32_t maxLightCount) noexcept;
+
+    /**
+     * Selects how the point and spot lights affecting each pixel are found.
+     *
+     * By default each froxel has a list of the lights intersecting it. With light binning, each
+     * tile of the screen has a bitmask of the lights intersecting it, and each depth slice the
+     * range of lights intersecting it (lights are sorted by distance to the camera). This is
+     * cheaper to build and upload, and the lights are evaluated in a more coherent loop, which
+     * is faster on some mobile GPUs, but a pixel may evaluate lights that don't reach it.
+     *
+     * @param enabled true to use light binning, false by default.
+     */
+    void setLightBinning(bool enabled) noexcept;
+
     /**
      * Enable or disable post processing. Enabled by default.
      *
@@ -395,6 +556,123 @@ public:
      */
     void setPostProcessingEnabled(bool enabled) noexcept;
 
+    /**
+     * Enables or disables occlusion culling. Disabled by default.
+     *
+     * When enabled, the depth buffer of each frame is reduced and read back, and renderables
+     * hidden behind what was rendered in a previous frame are culled. This helps scenes with
+     * a lot of occlusion, like cities or interiors, but because the depth buffer is always a
+     * frame or two late, renderables which become visible can appear with a small delay.
+     *
+     * Occlusion culling requires post-processing and is disabled with multi-sample
+     * anti-aliasing. It is currently only supported by the OpenGL backend.
+     *
+     * @param enabled true enables occlusion culling, false disables it.
+     *
+     * @see setPostProcessingEnabled(), setSampleCount()
+     */
+    void setOcclusionCullingEnabled(bool enabled) noexcept;
+
+    /**
+     * Returns whether occlusion culling is enabled.
+     */
+    bool isOcclusionCullingEnabled() const noexcept;
+
+    /**
+     * Enables or disables temporal culling. Disabled by default.
+     *
+     * When enabled, the results of the frustum culling of a frame are reused by the next
+     * frames: a renderable well inside (or well outside) the frustum isn't tested again until
+     * the camera moved enough for its result to change. The results are the same as without
+     * temporal culling, but the culling is much cheaper when the camera moves slowly. This
+     * uses a little memory per renderable, and renderables whose transform changes every frame
+     * don't benefit from it.
+     *
+     * Temporal culling has no effect when culling is disabled.
+     *
+     * @param enabled true enables temporal culling, false disables it.
+     *
+     * @see setCulling()
+     */
+    void setTemporalCullingEnabled(bool enabled) noexcept;
+
+    /**
+     * Returns whether temporal culling is enabled.
+     */
+    bool isTemporalCullingEnabled() const noexcept;
+
+    /**
+     * Enables or disables GPU culling. Disabled by default.
+     *
+     * When enabled, the renderables of the color pass are no longer culled against the camera
+     * on the CPU. Instead, the renderables sharing their vertex and index buffers are drawn in
+     * batches, each renderable with its own draw, and the draws outside the camera frustum are
+     * skipped on the GPU. This keeps the CPU cost of the culling and of the draw commands
+     * nearly constant with large numbers of renderables, e.g. static geometry merged into
+     * shared buffers. Renderables that can't be batched are drawn and clipped by the GPU.
+     *
+     * GPU culling needs indirect draws (see Engine::getBackend()), it has no effect without
+     * them, nor when culling is disabled or with a stereo camera. Temporal culling has no
+     * effect while GPU culling is active.
+     *
+     * @param enabled true enables GPU culling, false disables it.
+     *
+     * @see setCulling(), setTemporalCullingEnabled()
+     */
+    void setGpuCullingEnabled(bool enabled) noexcept;
+
+    /**
+     * Returns whether GPU culling is enabled.
+     */
+    bool isGpuCullingEnabled() const noexcept;
+
+    /**
+     * Enables or disables temporal upscaling. Disabled by default.
+     *
+     * When enabled, each frame is rendered with a different sub-pixel offset and accumulated
+     * into a full resolution history, reprojected with the camera motion. This reconstructs
+     * a sharp image from the lower resolution of dynamic resolution, and anti-aliases it in
+     * place of FXAA. Because only the camera motion is taken into account, moving objects can
+     * leave a short trail.
+     *
+     * Temporal upscaling requires post-processing and is disabled with multi-sample
+     * anti-aliasing.
+     *
+     * @param enabled true enables temporal upscaling, false disables it.
+     *
+     * @see setDynamicResolutionOptions(), setPostProcessingEnabled(), setSampleCount()
+     */
+    void setTemporalUpscalingEnabled(bool enabled) noexcept;
+
+    /**
+     * Returns whether temporal upscaling is enabled.
+     */
+    bool isTemporalUpscalingEnabled() const noexcept;
+
+    /**
+     * Enables or disables order-independent transparency. Disabled by default.
+     *
+     * When enabled, the transparent objects whose material uses the `orderIndependent`
+     * transparency mode are not sorted back to front. They're drawn in any order, sorted by
+     * material, into two extra buffers which are then composited over the opaque objects. This
+     * saves the sorting and the state changes of many overlapping transparent objects (e.g.
+     * particles or foliage), at the cost of two screen-sized buffers and of an approximation of
+     * the blending: the layers of a pixel are averaged, weighted by their opacity.
+     *
+     * Order-independent transparency requires post-processing and is disabled with
+     * multi-sample anti-aliasing.
+     *
+     * @param enabled true enables order-independent transparency, false disables it.
+     *
+     * @see setPostProcessingEnabled(), setSampleCount()
+     */
+    void setOrderIndependentTransparencyEnabled(bool enabled) noexcept;
+
+    /**
+     * Returns whether order-independent transparency is enabled.
+     */
+    bool isOrderIndependentTransparencyEnabled() const noexcept;
+
 
     // for debugging...
 
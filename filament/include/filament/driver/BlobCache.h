@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DRIVER_BLOBCACHE_H
+#define TNT_FILAMENT_DRIVER_BLOBCACHE_H
+
+#include <utils/compiler.h>
+
+#include <stddef.h>
+
+namespace filament {
+namespace driver {
+
+/**
+ * BlobCache is implemented by the application to let the driver store data that is expensive to
+ * produce, such as compiled programs, and retrieve it in a later run. This mirrors
+ * EGL_ANDROID_blob_cache's set/get functions.
+ *
+ * Both methods are called from filament's render thread. Keys and values are opaque binary data,
+ * the application is free to store them as it wishes (e.g. on disk) and to evict entries at any
+ * time.
+ */
+class UTILS_PUBLIC BlobCache {
+public:
+    virtual ~BlobCache() noexcept;
+
+    /**
+     * Stores value for the given key, replacing any previous value.
+     *
+     * @param key       pointer to the key, only valid for the duration of the call
+     * @param keySize   size of the key in bytes
+     * @param value     pointer to the value, only valid for the duration of the call
+     * @param valueSize size of the value in bytes
+     */
+    virtual void insert(void const* key, size_t keySize,
+            void const* value, size_t valueSize) noexcept = 0;
+
+    /**
+     * Retrieves the value of the given key.
+     *
+     * @param key       pointer to the key
+     * @param keySize   size of the key in bytes
+     * @param value     where to copy the value, if it's at least valueSize bytes
+     * @param valueSize size of the space pointed to by value
+     *
+     * @return The size of the value in bytes, or 0 if there is no value for this key. The value
+     *         is only copied if its size is less or equal to \p valueSize, and retrieve() can be
+     *         called with a null \p value to query the size first.
+     */
+    virtual size_t retrieve(void const* key, size_t keySize,
+            void* value, size_t valueSize) noexcept = 0;
+};
+
+} // namespace driver
+} // namespace filament
+
+#endif // TNT_FILAMENT_DRIVER_BLOBCACHE_H
@@ -19,6 +19,7 @@
 
 #include <memory>
 
+#include <filament/driver/BlobCache.h>
 #include <filament/driver/DriverEnums.h>
 
 #include <utils/compiler.h>
@@ -50,6 +51,14 @@ public:
     virtual ~ExternalContext() noexcept;
 
     virtual int getOSVersion() const noexcept = 0;
+
+    // Sets the cache the driver can use to persist data across runs (e.g. compiled programs).
+    // This must be called before createDriver() and the cache must outlive the driver.
+    void setBlobCache(BlobCache* blobCache) noexcept { mBlobCache = blobCache; }
+    BlobCache* getBlobCache() const noexcept { return mBlobCache; }
+
+private:
+    BlobCache* mBlobCache = nullptr;
 };
 
 class UTILS_PUBLIC ContextManagerGL : public ExternalContext {
@@ -61,6 +70,12 @@ public:
     virtual void terminate() noexcept = 0;
 
     virtual SwapChain* createSwapChain(void* nativeWindow, uint64_t& flags) noexcept = 0;
+
+    // Creates an offscreen swap chain of the given size, e.g. a pbuffer, destroyed with
+    // destroySwapChain(). Returns nullptr if the platform can't.
+    virtual SwapChain* createSwapChain(uint32_t width, uint32_t height, uint64_t& flags) noexcept {
+        return nullptr;
+    }
     virtual void destroySwapChain(SwapChain* swapChain) noexcept = 0;
 
     // Called to make the OpenGL context active on the calling thread.
@@ -70,6 +85,15 @@ public:
     // swap draw buffers (i.e. for double-buffered rendering).
     virtual void commit(SwapChain* swapChain) noexcept = 0;
 
+    // Called before commit() to schedule the presentation of the current frame of the current
+    // swap chain, in nanoseconds of CLOCK_MONOTONIC. Platforms which can't do it ignore it.
+    virtual void setPresentationTime(int64_t presentationTimeInNanosecond) noexcept { }
+
+    // Called before commit() with the regions of the current frame of the current swap chain
+    // that changed, as (left, bottom, width, height) quadruplets in pixels. Platforms which can't
+    // present regions ignore it.
+    virtual void setDamageRegions(int32_t const* rects, size_t count) noexcept { }
+
     virtual bool canCreateFence() noexcept { return false; }
     virtual Fence* createFence() noexcept = 0;
     virtual void destroyFence(Fence* fence) noexcept = 0;
@@ -95,6 +119,17 @@ public:
             uint32_t w, uint32_t h, TextureFormat format) noexcept = 0;
 
     virtual void destroyExternalTextureStorage(ExternalTexture* ets) noexcept = 0;
+
+    // Creates an image external textures can be bound to from a platform buffer (an
+    // AHardwareBuffer on Android), which is shared, not copied. Returns null when the platform
+    // can't, which is the default.
+    virtual ExternalTexture* createExternalImage(void* buffer) noexcept { return nullptr; }
+    virtual void destroyExternalImage(ExternalTexture* image) noexcept { }
+
+    // Makes the GPU wait for a platform fence (a sync file descriptor on Android) before it runs
+    // the following commands, and takes ownership of the fence. Platforms which can't wait on
+    // the GPU wait on the CPU instead, platforms without fences ignore it.
+    virtual void waitFenceOnGpu(int fence) noexcept { }
 };
 
 class UTILS_PUBLIC ContextManagerVk : public ExternalContext {
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_AFFINETRANSFORM_H
+#define TNT_FILAMENT_AFFINETRANSFORM_H
+
+#include <utils/compiler.h>
+
+#include <math/mat3.h>
+#include <math/mat4.h>
+#include <math/vec3.h>
+#include <math/vec4.h>
+
+#include <cmath>
+
+#include <stddef.h>
+
+namespace filament {
+
+/*
+ * An affine transform, stored as the first three rows of its 4x4 matrix (the last row is always
+ * (0, 0, 0, 1)). This takes 48 bytes instead of 64 for a mat4f, and it's also the layout of the
+ * world transform in the per-renderable uniform buffers.
+ */
+struct AffineTransform {
+    math::float4 rows[3];
+
+    AffineTransform() noexcept = default;
+
+    // the last row of m is ignored
+    explicit AffineTransform(math::mat4f const& m) noexcept
+            : rows{{ m[0][0], m[1][0], m[2][0], m[3][0] },
+                   { m[0][1], m[1][1], m[2][1], m[3][1] },
+                   { m[0][2], m[1][2], m[2][2], m[3][2] }} {
+    }
+
+    math::mat3f upperLeft() const noexcept {
+        return math::mat3f{
+                math::float3{ rows[0].x, rows[1].x, rows[2].x },
+                math::float3{ rows[0].y, rows[1].y, rows[2].y },
+                math::float3{ rows[0].z, rows[1].z, rows[2].z }};
+    }
+
+    // transforms the box given by its center and half-extent, in place, like rigidTransform()
+    // does. Written with scalars only, so that loops over arrays of boxes are vectorized.
+    void transformBox(math::float3& center, math::float3& extent) const noexcept {
+        const math::float3 c = center;
+        const math::float3 e = extent;
+        for (size_t j = 0; j < 3; j++) {
+            const math::float4 row = rows[j];
+            center[j] = row.x * c.x + row.y * c.y + row.z * c.z + row.w;
+            extent[j] = std::abs(row.x) * e.x + std::abs(row.y) * e.y + std::abs(row.z) * e.z;
+        }
+    }
+
+    friend AffineTransform operator*(AffineTransform const& lhs, AffineTransform const& rhs)
+            noexcept {
+        AffineTransform result;
+        for (size_t r = 0; r < 3; r++) {
+            const math::float4 row = lhs.rows[r];
+            result.rows[r] = row.x * rhs.rows[0] + row.y * rhs.rows[1] + row.z * rhs.rows[2] +
+                    math::float4{ 0, 0, 0, row.w };
+        }
+        return result;
+    }
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_AFFINETRANSFORM_H
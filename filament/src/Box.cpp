@@ -16,13 +16,27 @@
 
 #include <filament/Box.h>
 
+#include <math/simd.h>
+
 using namespace math;
 
 namespace filament {
 
 Box rigidTransform(Box const& UTILS_RESTRICT box, const math::mat4f& UTILS_RESTRICT m) noexcept {
+#if MATH_SIMD
+    // same operations as below, on the columns of m, the 4th components are ignored
+    const simd::float4 u[3] = {
+            simd::load(&m[0][0]), simd::load(&m[1][0]), simd::load(&m[2][0]) };
+    const simd::float4 a[3] = { simd::abs(u[0]), simd::abs(u[1]), simd::abs(u[2]) };
+    float4 center, halfExtent;
+    simd::store(&center[0],
+            simd::add(simd::transform(u, &box.center[0], 3), simd::load(&m[3][0])));
+    simd::store(&halfExtent[0], simd::transform(a, &box.halfExtent[0], 3));
+    return { center.xyz, halfExtent.xyz };
+#else
     const mat3f u(m.upperLeft());
     return { u * box.center + m[3].xyz, abs(u) * box.halfExtent };
+#endif
 }
 
 Box rigidTransform(Box const& UTILS_RESTRICT box, const math::mat3f& UTILS_RESTRICT u) noexcept {
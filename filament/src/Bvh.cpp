@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "details/Bvh.h"
+
+#include <algorithm>
+
+using namespace math;
+
+namespace filament {
+namespace details {
+
+void Bvh::clear() noexcept {
+    mNodes.clear();
+    mLeafOf.clear();
+    mDirty.clear();
+    mHasDirtyNodes = false;
+}
+
+void Bvh::build(float3 const* center, float3 const* extent, size_t count,
+        std::vector<uint32_t>& order) {
+    clear();
+    order.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        order[i] = uint32_t(i);
+    }
+    if (count) {
+        mNodes.reserve(2 * (count + LEAF_SIZE - 1) / LEAF_SIZE);
+        mLeafOf.resize(count);
+        build(center, extent, order.data(), 0, uint32_t(count), 0);
+        mDirty.resize(mNodes.size(), false);
+    }
+}
+
+uint32_t Bvh::build(float3 const* center, float3 const* extent,
+        uint32_t* order, uint32_t first, uint32_t count, uint32_t parent) {
+    const uint32_t index = uint32_t(mNodes.size());
+    mNodes.push_back({ computeBounds(center, extent, order + first, count), first, count, 0, parent });
+
+    if (count <= LEAF_SIZE) {
+        std::fill(mLeafOf.begin() + first, mLeafOf.begin() + first + count, index);
+        return index;
+    }
+
+    // split along the largest axis of the centers' bounds
+    float3 cmin = std::numeric_limits<float>::max();
+    float3 cmax = std::numeric_limits<float>::lowest();
+    for (uint32_t i = first, e = first + count; i < e; i++) {
+        cmin = min(cmin, center[order[i]]);
+        cmax = max(cmax, center[order[i]]);
+    }
+    const float3 size = cmax - cmin;
+    const size_t axis = (size.x >= size.y && size.x >= size.z) ? 0 : (size.y >= size.z ? 1 : 2);
+
+    // the split point is rounded to Culler::MODULO, so that all ranges start on a multiple
+    // of it ('first' always is one).
+    const uint32_t half = uint32_t(Culler::round(count / 2));
+    std::nth_element(order + first, order + first + half, order + first + count,
+            [center, axis](uint32_t lhs, uint32_t rhs) {
+                return center[lhs][axis] < center[rhs][axis];
+            });
+
+    build(center, extent, order, first, half, index);
+    const uint32_t right = build(center, extent, order, first + half, count - half, index);
+    mNodes[index].right = right;
+    return index;
+}
+
+Aabb Bvh::computeBounds(float3 const* center, float3 const* extent,
+        uint32_t const* order, size_t count) noexcept {
+    Aabb aabb;
+    for (size_t i = 0; i < count; i++) {
+        const size_t j = order ? order[i] : i;
+        aabb.min = min(aabb.min, center[j] - extent[j]);
+        aabb.max = max(aabb.max, center[j] + extent[j]);
+    }
+    return aabb;
+}
+
+void Bvh::invalidate(size_t index) noexcept {
+    assert(index < mLeafOf.size());
+    // mark the leaf dirty, and all its parents up to the first one already marked
+    uint32_t node = mLeafOf[index];
+    while (!mDirty[node]) {
+        mDirty[node] = true;
+        if (node == 0) {
+            break;
+        }
+        node = mNodes[node].parent;
+    }
+    mHasDirtyNodes = true;
+}
+
+void Bvh::refit(float3 const* center, float3 const* extent) noexcept {
+    if (!mHasDirtyNodes) {
+        return;
+    }
+    // children are always stored after their parent, so walking the nodes backward
+    // updates them bottom-up.
+    Node* const nodes = mNodes.data();
+    for (size_t i = mNodes.size(); i-- > 0;) {
+        if (mDirty[i]) {
+            Node& node = nodes[i];
+            if (node.right == 0) {
+                node.aabb = computeBounds(center + node.first, extent + node.first,
+                        nullptr, node.count);
+            } else {
+                Aabb const& l = nodes[i + 1].aabb;
+                Aabb const& r = nodes[node.right].aabb;
+                node.aabb = { min(l.min, r.min), max(l.max, r.max) };
+            }
+            mDirty[i] = false;
+        }
+    }
+    mHasDirtyNodes = false;
+}
+
+} // namespace details
+} // namespace filament
@@ -16,6 +16,8 @@
 
 #include "details/Culler.h"
 
+#include "Intersections.h"
+
 #include <math/fast.h>
 
 using namespace math;
@@ -23,69 +25,183 @@ using namespace math;
 namespace filament {
 namespace details {
 
-void Culler::intersects(
-        result_type* UTILS_RESTRICT results,
-        Frustum const& UTILS_RESTRICT frustum,
-        math::float4 const* UTILS_RESTRICT b,
-        size_t count) noexcept {
+/*
+ * The kernels are compiled twice on x86: for the baseline instruction set (SSE2, 4 floats) and
+ * for AVX2 (8 floats), which is chosen at runtime when the CPU supports it. Both process
+ * Culler::MODULO (8) items per iteration, so that the padding given by round() is the same.
+ * FMA isn't enabled with AVX2, so that both give the exact same results.
+ */
 
-    math::float4 const * const UTILS_RESTRICT planes = frustum.mPlanes;
+#if defined(__x86_64__) && (defined(__clang__) || defined(__GNUC__)) && !defined(__AVX2__)
+#   define CULLER_AVX2_DISPATCH 1
+#   define CULLER_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#   define CULLER_AVX2_DISPATCH 0
+#endif
+
+#if CULLER_AVX2_DISPATCH
+static bool hasAvx2() noexcept {
+    static const bool avx2 = []() {
+        __builtin_cpu_init();
+        return bool(__builtin_cpu_supports("avx2"));
+    }();
+    return avx2;
+}
+#endif
 
+UTILS_ALWAYS_INLINE
+static inline void intersectSpheres(
+        Culler::result_type* UTILS_RESTRICT results,
+        float4 const* UTILS_RESTRICT planes,
+        float4 const* UTILS_RESTRICT b,
+        size_t count) noexcept {
     // we use a vectorize width of 8 because, on ARMv8 it allow the compiler to write 8
     // 8-bits results in one go. Without this it has to do 4 separate byte writes, which
     // ends-up being slower.
-    count = round(count); // capacity guaranteed to be multiple of 8
     #pragma clang loop vectorize_width(8)
     for (size_t i = 0; i < count; i++) {
         int visible = ~0;
-        math::float4 const sphere(b[i]);
+        float4 const sphere(b[i]);
 
         #pragma clang loop unroll(full)
         for (size_t j = 0; j < 6; j++) {
             // clang doesn't seem to generate vector * scalar instructions, which leads
-            // to increased register pressure and stack spills
-            const float dot = planes[j].x * sphere.x +
-                              planes[j].y * sphere.y +
-                              planes[j].z * sphere.z +
-                              planes[j].w - sphere.w;
-            visible &= fast::signbit(dot);
+            // to increased register pressure and stack spills (spherePlaneDistance() uses
+            // scalars only)
+            visible &= fast::signbit(spherePlaneDistance(planes[j], sphere));
         }
-        results[i] = result_type(visible);
+        results[i] = Culler::result_type(visible);
     }
 }
 
-void Culler::intersects(
-        result_type* UTILS_RESTRICT results,
-        Frustum const& UTILS_RESTRICT frustum,
-        math::float3 const* UTILS_RESTRICT center,
-        math::float3 const* UTILS_RESTRICT extent,
+UTILS_ALWAYS_INLINE
+static inline void intersectBoxes(
+        Culler::result_type* UTILS_RESTRICT results,
+        float4 const* UTILS_RESTRICT planes,
+        float3 const* UTILS_RESTRICT center,
+        float3 const* UTILS_RESTRICT extent,
         size_t count, size_t bit) noexcept {
-
-    math::float4 const * UTILS_RESTRICT const planes = frustum.mPlanes;
-
     // we use a vectorize width of 8 because, on ARMv8 it allows the compiler to write eight
     // 8-bits results in one go. Without this it has to do 4 separate byte writes, which
     // ends-up being slower.
-    count = round(count); // capacity guaranteed to be multiple of 8
     #pragma clang loop vectorize_width(8)
     for (size_t i = 0; i < count; i++) {
         int visible = ~0;
 
         #pragma clang loop unroll(full)
         for (size_t j = 0; j < 6; j++) {
-            // clang doesn't seem to generate vector * scalar instructions, which leads
-            // to increased register pressure and stack spills
-            const float dot =
-                    planes[j].x * center[i].x - std::abs(planes[j].x) * extent[i].x +
-                    planes[j].y * center[i].y - std::abs(planes[j].y) * extent[i].y +
-                    planes[j].z * center[i].z - std::abs(planes[j].z) * extent[i].z +
-                    planes[j].w;
-
+            const float dot = boxPlaneDistance(planes[j], center[i], extent[i]);
             visible &= fast::signbit(dot) << bit;
         }
 
-        results[i] |= result_type(visible);
+        results[i] = Culler::result_type(visible);
+    }
+}
+
+UTILS_ALWAYS_INLINE
+static inline void intersectBoxes(
+        Culler::result_type* UTILS_RESTRICT results,
+        float4 const* UTILS_RESTRICT planes0,
+        float4 const* UTILS_RESTRICT planes1,
+        float3 const* UTILS_RESTRICT center,
+        float3 const* UTILS_RESTRICT extent,
+        size_t count, size_t bit0, size_t bit1) noexcept {
+    // same as above, but each AABB is loaded only once for both frustums
+    #pragma clang loop vectorize_width(8)
+    for (size_t i = 0; i < count; i++) {
+        int visible0 = ~0;
+        int visible1 = ~0;
+        const float3 c = center[i];
+        const float3 e = extent[i];
+
+        #pragma clang loop unroll(full)
+        for (size_t j = 0; j < 6; j++) {
+            const float dot0 = boxPlaneDistance(planes0[j], c, e);
+            const float dot1 = boxPlaneDistance(planes1[j], c, e);
+
+            visible0 &= fast::signbit(dot0) << bit0;
+            visible1 &= fast::signbit(dot1) << bit1;
+        }
+
+        results[i] = Culler::result_type(visible0 | visible1);
+    }
+}
+
+#if CULLER_AVX2_DISPATCH
+
+CULLER_TARGET_AVX2 UTILS_NOINLINE
+static void intersectSpheresAvx2(Culler::result_type* UTILS_RESTRICT results,
+        float4 const* UTILS_RESTRICT planes, float4 const* UTILS_RESTRICT b,
+        size_t count) noexcept {
+    intersectSpheres(results, planes, b, count);
+}
+
+CULLER_TARGET_AVX2 UTILS_NOINLINE
+static void intersectBoxesAvx2(Culler::result_type* UTILS_RESTRICT results,
+        float4 const* UTILS_RESTRICT planes,
+        float3 const* UTILS_RESTRICT center, float3 const* UTILS_RESTRICT extent,
+        size_t count, size_t bit) noexcept {
+    intersectBoxes(results, planes, center, extent, count, bit);
+}
+
+CULLER_TARGET_AVX2 UTILS_NOINLINE
+static void intersectBoxesAvx2(Culler::result_type* UTILS_RESTRICT results,
+        float4 const* UTILS_RESTRICT planes0, float4 const* UTILS_RESTRICT planes1,
+        float3 const* UTILS_RESTRICT center, float3 const* UTILS_RESTRICT extent,
+        size_t count, size_t bit0, size_t bit1) noexcept {
+    intersectBoxes(results, planes0, planes1, center, extent, count, bit0, bit1);
+}
+
+#endif
+
+void Culler::intersects(
+        result_type* UTILS_RESTRICT results,
+        Frustum const& UTILS_RESTRICT frustum,
+        math::float4 const* UTILS_RESTRICT b,
+        size_t count) noexcept {
+    count = round(count); // capacity guaranteed to be multiple of 8
+#if CULLER_AVX2_DISPATCH
+    if (hasAvx2()) {
+        intersectSpheresAvx2(results, frustum.mPlanes, b, count);
+        return;
     }
+#endif
+    intersectSpheres(results, frustum.mPlanes, b, count);
+}
+
+void Culler::intersects(
+        result_type* UTILS_RESTRICT results,
+        Frustum const& UTILS_RESTRICT frustum,
+        math::float3 const* UTILS_RESTRICT center,
+        math::float3 const* UTILS_RESTRICT extent,
+        size_t count, size_t bit) noexcept {
+    count = round(count); // capacity guaranteed to be multiple of 8
+#if CULLER_AVX2_DISPATCH
+    if (hasAvx2()) {
+        intersectBoxesAvx2(results, frustum.mPlanes, center, extent, count, bit);
+        return;
+    }
+#endif
+    intersectBoxes(results, frustum.mPlanes, center, extent, count, bit);
+}
+
+void Culler::intersects(
+        result_type* UTILS_RESTRICT results,
+        Frustum const& UTILS_RESTRICT frustum0,
+        Frustum const& UTILS_RESTRICT frustum1,
+        math::float3 const* UTILS_RESTRICT center,
+        math::float3 const* UTILS_RESTRICT extent,
+        size_t count, size_t bit0, size_t bit1) noexcept {
+    count = round(count); // capacity guaranteed to be multiple of 8
+#if CULLER_AVX2_DISPATCH
+    if (hasAvx2()) {
+        intersectBoxesAvx2(results, frustum0.mPlanes, frustum1.mPlanes, center, extent,
+                count, bit0, bit1);
+        return;
+    }
+#endif
+    intersectBoxes(results, frustum0.mPlanes, frustum1.mPlanes, center, extent,
+            count, bit0, bit1);
 }
 
 /*
@@ -99,7 +215,6 @@ bool Culler::intersects(Frustum const& frustum, Box const& box) noexcept {
     Culler::result_type results[MODULO];
     centers[0] = box.center;
     extents[0] = box.halfExtent;
-    results[0] = 0;
     Culler::intersects(results, frustum, centers, extents, MODULO, 0);
     return bool(results[0]);
 }
@@ -14,39 +14,170 @@
  * limitations under the License.
  */
 
+
 #include "details/DFG.h"
 
 #include "details/Engine.h"
 #include "details/Texture.h"
 
+#include <math/half.h>
+#include <math/scalar.h>
+#include <math/vec2.h>
+
+#include <utils/JobSystem.h>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <mutex>
+
+using namespace math;
+using namespace utils;
+
 namespace filament {
 namespace details {
 
-const uint16_t DFG::DFG_LUT[] = {
-#include "generated/data/dfg.inc"
-};
+// Number of importance samples per texel, the same as the LUT cmgen used to bake.
+static constexpr size_t DFG_SAMPLE_COUNT = 1024;
+
+// Second coordinate of the Hammersley point set, i.e. the radical inverse of i.
+static float radicalInverse(uint32_t i) noexcept {
+    uint32_t bits = i;
+    bits = (bits << 16) | (bits >> 16);
+    bits = ((bits & 0x55555555) << 1) | ((bits & 0xAAAAAAAA) >> 1);
+    bits = ((bits & 0x33333333) << 2) | ((bits & 0xCCCCCCCC) >> 2);
+    bits = ((bits & 0x0F0F0F0F) << 4) | ((bits & 0xF0F0F0F0) >> 4);
+    bits = ((bits & 0x00FF00FF) << 8) | ((bits & 0xFF00FF00) >> 8);
+    return bits * (0.5f / 0x80000000U);
+}
+
+static inline float pow5(float x) noexcept {
+    const float x2 = x * x;
+    return x2 * x2 * x;
+}
+
+DFG::DFG(FEngine& engine, size_t lutSize) noexcept
+        : mEngine(engine),
+          mLutSize(std::min(std::max(lutSize, MIN_LUT_SIZE), MAX_LUT_SIZE)) {
+}
+
+void DFG::prepare() noexcept {
+    if (mLUT || mJob) {
+        return;
+    }
+    mData = SharedResources::getDfgLut(mLutSize);
+
+    // another engine may be computing it already, in which case the job waits for it
+    JobSystem& js = mEngine.getJobSystem();
+    SharedResources::DfgLut* const lut = mData.get();
+    mJob = js.createJob();
+    js.run(js.createJob(mJob, [this, lut](JobSystem&, JobSystem::Job*) {
+        std::call_once(lut->once, [this, lut]() {
+            lut->data.reset(new half2[mLutSize * mLutSize]);
+            generate(lut->data.get());
+        });
+    }));
+}
 
-DFG::DFG(FEngine& engine) noexcept : mEngine(engine) {
-    constexpr size_t fp16Count = DFG_LUT_SIZE * DFG_LUT_SIZE * 2;
-    constexpr size_t byteCount = fp16Count * sizeof(uint16_t);
+Handle<HwTexture> DFG::getTexture() noexcept {
+    if (UTILS_UNLIKELY(!mLUT)) {
+        prepare();
+        mEngine.getJobSystem().runAndWait(mJob);
+        mJob = nullptr;
 
-    static_assert(sizeof(DFG_LUT) == byteCount, "DFG_LUT_SIZE doesn't match size of the DFG LUT");
+        // the upload keeps the shared LUT alive
+        const size_t size = mLutSize;
+        const size_t byteCount = size * size * sizeof(half2);
+        auto* const lut = new std::shared_ptr<SharedResources::DfgLut>(std::move(mData));
 
-    Texture* lut = Texture::Builder()
-            .width(DFG_LUT_SIZE)
-            .height(DFG_LUT_SIZE)
-            .format(driver::TextureFormat::RG16F)
-            .build(mEngine);
+        Texture* texture = Texture::Builder()
+                .width(uint32_t(size))
+                .height(uint32_t(size))
+                .format(driver::TextureFormat::RG16F)
+                .build(mEngine);
 
-    Texture::PixelBufferDescriptor buffer(DFG_LUT, byteCount, Texture::Format::RG,
-            Texture::Type::HALF);
+        texture->setImage(mEngine, 0,
+                Texture::PixelBufferDescriptor((*lut)->data.get(), byteCount, Texture::Format::RG,
+                        Texture::Type::HALF, [](void*, size_t, void* user) {
+                            delete static_cast<std::shared_ptr<SharedResources::DfgLut>*>(user);
+                        }, lut));
 
-    lut->setImage(mEngine, 0, std::move(buffer));
+        mLUT = upcast(texture);
+    }
+    return mLUT->getHwHandle();
+}
+
+/*
+ * This is cmgen's multiscatter DFG integration (see CubemapIBL::DFG), in single precision and
+ * restructured so that the inner loop vectorizes: V is in the XZ plane, so only the X and Z
+ * components of the half vectors are needed, and they only depend on the roughness, i.e. the row.
+ */
+void DFG::generate(half2* lut) const noexcept {
+    const size_t size = mLutSize;
+    constexpr size_t N = DFG_SAMPLE_COUNT;
 
-    mLUT = upcast(lut);
+    // parts of the importance samples that don't depend on the roughness
+    std::unique_ptr<float[]> cosPhi(new float[N]);
+    std::unique_ptr<float[]> uy(new float[N]);
+    for (size_t i = 0; i < N; i++) {
+        cosPhi[i] = float(std::cos(2 * M_PI * i / N));
+        uy[i] = radicalInverse(uint32_t(i));
+    }
+
+    auto generateRows = [ lut, size, &cosPhi, &uy ](uint32_t start, uint32_t count) {
+        std::unique_ptr<float[]> Hx(new float[N]);
+        std::unique_ptr<float[]> Hz(new float[N]);
+        for (uint32_t y = start; y < start + count; y++) {
+            // the texture is sampled with (NoV, roughness) at the texel centers
+            const float roughness = (y + 0.5f) / size;
+            const float a = roughness * roughness;
+            const float a2 = a * a;
+
+            // importance sampling GGX, see hemisphereImportanceSampleDggx() in cmgen
+            for (size_t i = 0; i < N; i++) {
+                // NOTE: (aa-1) == (a-1)(a+1) produces better fp accuracy
+                const float cosTheta2 = (1 - uy[i]) / (1 + (a + 1) * ((a - 1) * uy[i]));
+                Hx[i] = std::sqrt(1 - cosTheta2) * cosPhi[i];
+                Hz[i] = std::sqrt(cosTheta2);
+            }
+
+            half2* UTILS_RESTRICT row = lut + y * size;
+            for (size_t x = 0; x < size; x++) {
+                const float NoV = (x + 0.5f) / size;
+                const float Vx = std::sqrt(1 - NoV * NoV);
+                // the NoV part of the height-correlated GGX visibility is the same for all samples
+                const float GGXVTerm = std::sqrt((NoV - NoV * a2) * NoV + a2);
+                float rx = 0;
+                float ry = 0;
+                for (size_t i = 0; i < N; i++) {
+                    const float VoH = saturate(Vx * Hx[i] + NoV * Hz[i]);
+                    const float NoL = 2 * VoH * Hz[i] - NoV;
+                    const float NoLc = saturate(NoL);
+                    const float GGXL = NoV * std::sqrt((NoLc - NoLc * a2) * NoLc + a2);
+                    const float GGXV = NoLc * GGXVTerm;
+                    // Note: remember VoH == LoH  (H is half vector)
+                    const float v = (0.5f / (GGXV + GGXL)) * NoLc * (VoH / Hz[i]);
+                    const float Fc = pow5(1 - VoH);
+                    rx += NoL > 0 ? v * Fc : 0.0f;
+                    ry += NoL > 0 ? v : 0.0f;
+                }
+                row[x] = half2(float2{ rx, ry } * (4.0f / N));
+            }
+        }
+    };
+
+    JobSystem& js = mEngine.getJobSystem();
+    auto job = jobs::parallel_for(js, nullptr, 0, uint32_t(size),
+            std::cref(generateRows), jobs::CountSplitter<1, 8>());
+    js.runAndWait(job);
 }
 
 void DFG::terminate() {
+    if (mJob) {
+        mEngine.getJobSystem().runAndWait(mJob);
+        mJob = nullptr;
+    }
+    mData.reset();
     if (mLUT) {
         mEngine.destroy(mLUT);
     }
@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "details/DepthPyramid.h"
+
+#include "PostProcessManager.h"
+
+#include "details/Engine.h"
+
+#include <filament/driver/PixelBufferDescriptor.h>
+
+#include <utils/Systrace.h>
+
+#include <algorithm>
+#include <limits>
+
+#include <stdlib.h>
+#include <string.h>
+
+using namespace utils;
+
+namespace filament {
+using namespace driver;
+using namespace math;
+
+namespace details {
+
+DepthPyramid::DepthPyramid(FEngine& engine) noexcept
+        : mEngine(engine),
+          // VulkanDriver::readPixels() doesn't read anything back yet
+          mSupported(engine.getBackend() == Backend::OPENGL) {
+}
+
+DepthPyramid::~DepthPyramid() noexcept {
+    terminate();
+}
+
+void DepthPyramid::terminate() noexcept {
+    // the read-backs are freed by their callback, which can be called after we're gone
+    for (Readback* readback : mPending) {
+        readback->owner = nullptr;
+    }
+    mPending.clear();
+}
+
+void DepthPyramid::clear() noexcept {
+    terminate();
+    mLevelCount = 0;
+}
+
+void DepthPyramid::update(RenderTargetPool::Target const* source, Viewport const& viewport,
+        mat4f const& clipFromWorld) noexcept {
+    SYSTRACE_CALL();
+
+    assert(source && source->depth);
+
+    if (mPending.size() >= MAX_PENDING_READBACKS) {
+        // we're too far ahead of the driver, skip this frame
+        return;
+    }
+
+    FEngine& engine = mEngine;
+    DriverApi& driver = engine.getDriverApi();
+    RenderTargetPool& rtp = engine.getRenderTargetPool();
+
+    const uint32_t width = (viewport.width + TILE_SIZE - 1) / TILE_SIZE;
+    const uint32_t height = (viewport.height + TILE_SIZE - 1) / TILE_SIZE;
+
+    RenderTargetPool::Target const* target = rtp.get(TargetBufferFlags::COLOR,
+            width, height, 1, TextureFormat::RGBA8, RenderTargetPool::Target::NO_TEXTURE);
+
+    engine.getPostProcessManager().depthPass(
+            engine.getPostProcessProgram(PostProcessStage::DEPTH_DOWNSAMPLE),
+            source, viewport.height, target, width, height);
+
+    const size_t size = size_t(width) * height * 4;
+    Readback* const readback = static_cast<Readback*>(malloc(sizeof(Readback) + size));
+    readback->owner = this;
+    readback->clipFromWorld = clipFromWorld;
+    readback->viewportSize = float2{ viewport.width, viewport.height };
+    readback->width = width;
+    readback->height = height;
+
+    // If the read-back fails, the pixels are left at the farthest depth which doesn't occlude
+    // anything.
+    uint8_t* const pixels = reinterpret_cast<uint8_t*>(readback + 1);
+    memset(pixels, 0xFF, size);
+
+    driver.readPixels(target->target, 0, 0, width, height,
+            PixelBufferDescriptor(pixels, size, PixelDataFormat::RGBA, PixelDataType::UBYTE,
+                    1, 0, 0, 0, &DepthPyramid::onReadback, readback));
+
+    rtp.put(target);
+    mPending.push_back(readback);
+}
+
+void DepthPyramid::onReadback(void* buffer, size_t, void* user) {
+    // this is called on the engine's thread, while flushing the command buffer
+    Readback* const readback = static_cast<Readback*>(user);
+    DepthPyramid* const owner = readback->owner;
+    if (owner) {
+        auto& pending = owner->mPending;
+        pending.erase(std::find(pending.begin(), pending.end(), readback));
+        owner->build(*readback, static_cast<uint8_t const*>(buffer));
+    }
+    free(readback);
+}
+
+void DepthPyramid::build(Readback const& readback, uint8_t const* pixels) noexcept {
+    SYSTRACE_CALL();
+
+    // lay out all the levels in a single buffer
+    size_t count = 0;
+    size_t size = 0;
+    uint32_t width = readback.width;
+    uint32_t height = readback.height;
+    do {
+        mLevels[count++] = { size, width, height };
+        size += size_t(width) * height;
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+    } while ((mLevels[count - 1].width > 1 || mLevels[count - 1].height > 1) &&
+             count < MAX_LEVEL_COUNT);
+    std::vector<float>& depths = mDepths;
+    depths.resize(size);
+    width = readback.width;
+    height = readback.height;
+
+    // The pixels are read from the top, while our levels go up like in clip space. Depths are
+    // stored as 24-bits fixed point.
+    float* dst = depths.data();
+    for (uint32_t y = 0; y < height; y++) {
+        uint8_t const* const src = pixels + size_t(height - 1 - y) * width * 4;
+        for (uint32_t x = 0; x < width; x++) {
+            uint8_t const* const p = src + x * 4;
+            const uint32_t d = (uint32_t(p[0]) << 16u) | (uint32_t(p[1]) << 8u) | uint32_t(p[2]);
+            dst[x] = d * (1.0f / 16777215.0f);
+        }
+        dst += width;
+    }
+
+    for (size_t l = 1; l < count; l++) {
+        Level const& below = mLevels[l - 1];
+        width = mLevels[l].width;
+        height = mLevels[l].height;
+        float const* const UTILS_RESTRICT in = depths.data() + below.offset;
+        float* const UTILS_RESTRICT out = depths.data() + mLevels[l].offset;
+        // levels with an odd dimension clamp the texels below them
+        const uint32_t xmax = below.width - 1;
+        const uint32_t ymax = below.height - 1;
+        for (uint32_t y = 0; y < height; y++) {
+            float const* const row0 = in + size_t(std::min(2 * y,     ymax)) * below.width;
+            float const* const row1 = in + size_t(std::min(2 * y + 1, ymax)) * below.width;
+            for (uint32_t x = 0; x < width; x++) {
+                const uint32_t x0 = std::min(2 * x, xmax);
+                const uint32_t x1 = std::min(2 * x + 1, xmax);
+                out[y * width + x] = std::max(
+                        std::max(row0[x0], row0[x1]), std::max(row1[x0], row1[x1]));
+            }
+        }
+    }
+
+    mLevelCount = count;
+    mClipFromWorld = readback.clipFromWorld;
+    mViewportSize = readback.viewportSize;
+}
+
+bool DepthPyramid::isOccluded(float3 const& center, float3 const& extent) const noexcept {
+    // project the 8 corners of the box
+    mat4f const& m = mClipFromWorld;
+    const float4 c = m * float4{ center, 1 };
+    const float4 ex = m[0] * extent.x;
+    const float4 ey = m[1] * extent.y;
+    const float4 ez = m[2] * extent.z;
+
+    float2 csMin = std::numeric_limits<float>::max();
+    float2 csMax = std::numeric_limits<float>::lowest();
+    float zmin = std::numeric_limits<float>::max();
+    for (size_t i = 0; i < 8; i++) {
+        const float4 p = c + ((i & 1u) ? ex : -ex) + ((i & 2u) ? ey : -ey) + ((i & 4u) ? ez : -ez);
+        if (p.w <= 0 || p.z < -p.w) {
+            // the box crosses the near plane, it can't be occluded
+            return false;
+        }
+        const float3 ndc = p.xyz / p.w;
+        csMin = min(csMin, ndc.xy);
+        csMax = max(csMax, ndc.xy);
+        zmin = std::min(zmin, ndc.z);
+    }
+
+    // in tiles of the first level, which is at least 1x1
+    Level const& level0 = mLevels[0];
+    const float2 scale = mViewportSize * (0.5f / TILE_SIZE);
+    const float2 tsMin = (csMin + 1.0f) * scale;
+    const float2 tsMax = (csMax + 1.0f) * scale;
+    if (tsMax.x < 0 || tsMax.y < 0 || tsMin.x >= level0.width || tsMin.y >= level0.height) {
+        // outside of the pyramid, this is for frustum culling to decide
+        return false;
+    }
+    uint32_t x0 = uint32_t(std::max(0.0f, tsMin.x));
+    uint32_t y0 = uint32_t(std::max(0.0f, tsMin.y));
+    uint32_t x1 = uint32_t(std::min(tsMax.x, float(level0.width - 1)));
+    uint32_t y1 = uint32_t(std::min(tsMax.y, float(level0.height - 1)));
+
+    // pick the level where the box covers at most 2x2 texels
+    size_t l = 0;
+    while (l + 1 < mLevelCount && (x1 - x0 > 1 || y1 - y0 > 1)) {
+        x0 >>= 1u; y0 >>= 1u;
+        x1 >>= 1u; y1 >>= 1u;
+        l++;
+    }
+
+    Level const& level = mLevels[l];
+    float const* const depths = mDepths.data() + level.offset;
+    float farthest = 0;
+    for (uint32_t y = y0; y <= y1; y++) {
+        for (uint32_t x = x0; x <= x1; x++) {
+            farthest = std::max(farthest, depths[y * level.width + x]);
+        }
+    }
+
+    // the depth buffer is in window space
+    return zmin * 0.5f + 0.5f > farthest;
+}
+
+void DepthPyramid::cull(Culler::result_type* results,
+        float3 const* center, float3 const* extent, size_t count,
+        Culler::result_type testMask, size_t bit) const noexcept {
+    assert(isValid());
+    for (size_t i = 0; i < count; i++) {
+        if ((results[i] & testMask) && isOccluded(center[i], extent[i])) {
+            results[i] |= Culler::result_type(1u << bit);
+        }
+    }
+}
+
+} // namespace details
+} // namespace filament
@@ -23,9 +23,11 @@
 #include "details/IndexBuffer.h"
 #include "details/IndirectLight.h"
 #include "details/Material.h"
+#include "details/MorphTargetBuffer.h"
 #include "details/Renderer.h"
 #include "details/RenderPrimitive.h"
 #include "details/Scene.h"
+#include "details/SkinningBuffer.h"
 #include "details/Skybox.h"
 #include "details/Stream.h"
 #include "details/SwapChain.h"
@@ -34,6 +36,7 @@
 #include "driver/Program.h"
 
 #include "PrecompiledMaterials.h"
+#include "SharedResources.h"
 
 #include <filament/Exposure.h>
 
@@ -52,7 +55,9 @@
 #include <math/fast.h>
 #include <math/scalar.h>
 
+#include <algorithm>
 #include <functional>
+#include <vector>
 
 #include <stdio.h>
 
@@ -71,8 +76,10 @@ namespace details {
 static std::unordered_map<Engine const*, std::unique_ptr<FEngine>> sEngines;
 static std::mutex sEnginesLock;
 
-FEngine* FEngine::create(Backend backend, ExternalContext* externalContext, void* sharedGLContext) {
-    FEngine* instance = new FEngine(backend, externalContext, sharedGLContext);
+FEngine* FEngine::create(Backend backend, ExternalContext* externalContext, void* sharedGLContext,
+        BlobCache* blobCache, size_t dfgLutSize) {
+    FEngine* instance = new FEngine(backend, externalContext, sharedGLContext, blobCache,
+            dfgLutSize);
 
     slog.i << "FEngine (" << sizeof(void*) * 8 << " bits) created at " << instance << io::endl;
 
@@ -82,12 +89,19 @@ FEngine* FEngine::create(Backend backend, ExternalContext* externalContext, void
     // start the driver thread
     instance->mDriverThread = std::thread(&FEngine::loop, instance);
 
+    // initialize what doesn't need the driver while it's being created
+    instance->preInit();
+
     // wait for the driver to be ready
     instance->mDriverBarrier.await();
 
     if (UTILS_UNLIKELY(!instance->mDriver)) {
         // something went horribly wrong during driver initialization
+        instance->mDFG->terminate();
         instance->mDriverThread.join();
+        if (instance->mSharesProgramCache) {
+            SharedResources::releaseProgramCache();
+        }
         return nullptr;
     }
 
@@ -101,10 +115,18 @@ UniformInterfaceBlock FEngine::PerViewUib::getUib() noexcept {
     return UibGenerator::getPerViewUib();
 }
 
+UniformInterfaceBlock FEngine::PerFrameUib::getUib() noexcept {
+    return UibGenerator::getPerFrameUib();
+}
+
 UniformInterfaceBlock FEngine::PerRenderableUib::getUib() noexcept {
     return UibGenerator::getPerRenderableUib();
 }
 
+UniformInterfaceBlock FEngine::PerRenderableInstancesUib::getUib() noexcept {
+    return UibGenerator::getPerRenderableInstancesUib();
+}
+
 UniformInterfaceBlock FEngine::PostProcessingUib::getUib() noexcept {
     return UibGenerator::getPostProcessingUib();
 }
@@ -127,17 +149,22 @@ static const half4 sFullScreenTriangleVertices[3] = {
 // these must be static because only a pointer is copied to the render stream
 static const uint16_t sFullScreenTriangleIndices[3] = { 0, 1, 2 };
 
-FEngine::FEngine(Backend backend, ExternalContext* externalContext, void* sharedGLContext) :
+FEngine::FEngine(Backend backend, ExternalContext* externalContext, void* sharedGLContext,
+        BlobCache* blobCache, size_t dfgLutSize) :
         mBackend(backend),
         mExternalContext(externalContext),
         mSharedGLContext(sharedGLContext),
+        mBlobCache(blobCache),
+        mDfgLutSize(dfgLutSize),
         mEntityManager(EntityManager::get()),
         mRenderableManager(*this),
-        mTransformManager(),
+        mTransformManager(&mJobSystem),
         mLightManager(*this),
         mCameraManager(*this),
         mPerViewUib(PerViewUib::getUib()),
+        mPerFrameUib(PerFrameUib::getUib()),
         mPerRenderableUib(PerRenderableUib::getUib()),
+        mPerRenderableInstancesUib(PerRenderableInstancesUib::getUib()),
         mPerViewSib(PerViewSib::getSib()),
         mPostProcessUib(PostProcessingUib::getUib()),
         mPostProcessSib(PostProcessSib::getSib()),
@@ -151,6 +178,54 @@ FEngine::FEngine(Backend backend, ExternalContext* externalContext, void* shared
     // we're assuming we're on the main thread here.
     // (it may not be the case)
     mJobSystem.adopt();
+
+    if (!mBlobCache && SharedResources::isEnabled()) {
+        mBlobCache = SharedResources::acquireProgramCache();
+        mSharesProgramCache = true;
+    }
+}
+
+/*
+ * preInit() is called while the driver thread creates the driver, it must not issue driver
+ * commands.
+ */
+
+void FEngine::preInit() {
+    // Parse all post process shaders now, but create them lazily
+    // (the built-in packages live as long as the engine, they don't need to be copied)
+    mPostProcessParser = std::make_unique<filaflat::MaterialParser>(mBackend,
+            POST_PROCESS_PACKAGE, POST_PROCESS_PACKAGE_SIZE, false);
+
+    UTILS_UNUSED_IN_RELEASE bool ppMaterialOk =
+            mPostProcessParser->parse() && mPostProcessParser->isPostProcessMaterial();
+    assert(ppMaterialOk);
+
+    // the LUT is computed by the job system, and uploaded the first time it's needed
+    mDFG.reset(new DFG(*this, mDfgLutSize));
+    mDFG->prepare();
+
+    FDebugRegistry& debugRegistry = getDebugRegistry();
+    debugRegistry.registerProperty("d.commandbuffer.high_watermark", &debug.commandbuffer.high_watermark);
+    debugRegistry.registerProperty("d.commandbuffer.frame_size", &debug.commandbuffer.frame_size);
+    debugRegistry.registerProperty("d.commandbuffer.stall_count", &debug.commandbuffer.stall_count);
+    debugRegistry.registerProperty("d.commandbuffer.stall_time", &debug.commandbuffer.stall_time);
+    debugRegistry.registerProperty("d.driver.state_changes_issued", &debug.driver.state_changes_issued);
+    debugRegistry.registerProperty("d.driver.state_changes_skipped", &debug.driver.state_changes_skipped);
+    debugRegistry.registerProperty("d.driver.program_switches", &debug.driver.program_switches);
+    debugRegistry.registerProperty("d.driver.texture_switches", &debug.driver.texture_switches);
+    debugRegistry.registerProperty("d.rendertargetpool.size", &debug.rendertargetpool.size);
+    debugRegistry.registerProperty("d.rendertargetpool.count", &debug.rendertargetpool.count);
+    debugRegistry.registerProperty("d.rendertargetpool.hits", &debug.rendertargetpool.hits);
+    debugRegistry.registerProperty("d.rendertargetpool.misses", &debug.rendertargetpool.misses);
+    debugRegistry.registerProperty("d.profiler.phases", &debug.profiler.phases);
+    debugRegistry.registerProperty("d.profiler.allocations", &debug.profiler.allocations);
+    debugRegistry.registerProperty("d.profiler.scene_prepare", &debug.profiler.scene_prepare);
+    debugRegistry.registerProperty("d.profiler.culling", &debug.profiler.culling);
+    debugRegistry.registerProperty("d.profiler.froxelize", &debug.profiler.froxelize);
+    debugRegistry.registerProperty("d.profiler.commands", &debug.profiler.commands);
+    debugRegistry.registerProperty("d.profiler.sort", &debug.profiler.sort);
+    debugRegistry.registerProperty("d.profiler.record", &debug.profiler.record);
+    debugRegistry.registerProperty("d.postprocess.compute", &debug.postprocess.compute);
 }
 
 /*
@@ -163,29 +238,40 @@ void FEngine::init() {
     mCommandStream = CommandStream(*mDriver, mCommandBufferQueue.getCircularBuffer());
     DriverApi& driverApi = getDriverApi();
 
-    // Parse all post process shaders now, but create them lazily
-    mPostProcessParser = std::make_unique<filaflat::MaterialParser>(mBackend,
-            POST_PROCESS_PACKAGE, POST_PROCESS_PACKAGE_SIZE);
+    mDrawIndirectSupported = driverApi.isDrawIndirectSupported();
+    mComputeSupported = driverApi.isComputeSupported();
 
-    UTILS_UNUSED_IN_RELEASE bool ppMaterialOk =
-            mPostProcessParser->parse() && mPostProcessParser->isPostProcessMaterial();
-    assert(ppMaterialOk);
+    mPostProcessManager.init(*this);
+    mRenderTargetPool.init(*this);
+    mLightManager.init(*this);
+    mRenderableManager.init();
+
+    // Always initialize the default material, most materials' depth shaders fallback on it.
+    mDefaultMaterial = upcast(
+            FMaterial::DefaultMaterialBuilder()
+                    .packageView(DEFAULT_MATERIAL_PACKAGE, DEFAULT_MATERIAL_PACKAGE_SIZE)
+                    .build(*const_cast<FEngine*>(this)));
+}
+
+void FEngine::createFullScreenTriangle() const noexcept {
+    FEngine& engine = *const_cast<FEngine*>(this);
+    DriverApi& driverApi = engine.getDriverApi();
 
     mFullScreenTriangleVb = upcast(VertexBuffer::Builder()
             .vertexCount(3)
             .bufferCount(1)
             .attribute(VertexAttribute::POSITION, 0, VertexBuffer::AttributeType::HALF4, 0)
-            .build(*this));
+            .build(engine));
 
-    mFullScreenTriangleVb->setBufferAt(*this, 0,
+    mFullScreenTriangleVb->setBufferAt(engine, 0,
             { sFullScreenTriangleVertices, sizeof(sFullScreenTriangleVertices) });
 
     mFullScreenTriangleIb = upcast(IndexBuffer::Builder()
             .indexCount(3)
             .bufferType(IndexBuffer::IndexType::USHORT)
-            .build(*this));
+            .build(engine));
 
-    mFullScreenTriangleIb->setBuffer(*this,
+    mFullScreenTriangleIb->setBuffer(engine,
             { sFullScreenTriangleIndices, sizeof(sFullScreenTriangleIndices) });
 
     mFullScreenTriangleRph = driverApi.createRenderPrimitive();
@@ -194,18 +280,22 @@ void FEngine::init() {
             mFullScreenTriangleVb->getDeclaredAttributes().getValue());
     driverApi.setRenderPrimitiveRange(mFullScreenTriangleRph, Driver::PrimitiveType::TRIANGLES,
             0, 0, 2, (uint32_t)mFullScreenTriangleIb->getIndexCount());
+}
+
+void FEngine::createDefaultIndirectLight() const noexcept {
+    FEngine& engine = *const_cast<FEngine*>(this);
 
     mDefaultIblTexture = upcast(Texture::Builder()
             .width(1).height(1).levels(1)
             .format(Texture::InternalFormat::RGBM)
             .sampler(Texture::Sampler::SAMPLER_CUBEMAP)
-            .build(*this));
+            .build(engine));
     static uint32_t pixel = 0;
     Texture::PixelBufferDescriptor buffer(
             &pixel, 4, // 4 bytes in 1 RGBM pixel
             Texture::Format::RGBM, Texture::Type::UBYTE);
     Texture::FaceOffsets offsets = {};
-    mDefaultIblTexture->setImage(*this, 0, std::move(buffer), offsets);
+    mDefaultIblTexture->setImage(engine, 0, std::move(buffer), offsets);
 
     // 3 bands = 9 float3
     const float sh[9 * 3] = { 0.0f };
@@ -213,18 +303,7 @@ void FEngine::init() {
             .reflections(mDefaultIblTexture)
             .irradiance(3, reinterpret_cast<const float3*>(sh))
             .intensity(1.0f)
-            .build(*this));
-
-    mPostProcessManager.init(*this);
-    mRenderTargetPool.init(*this);
-    mLightManager.init(*this);
-    mDFG.reset(new DFG(*this));
-
-    // Always initialize the default material, most materials' depth shaders fallback on it.
-    mDefaultMaterial = upcast(
-            FMaterial::DefaultMaterialBuilder()
-                    .package(DEFAULT_MATERIAL_PACKAGE, DEFAULT_MATERIAL_PACKAGE_SIZE)
-                    .build(*const_cast<FEngine*>(this)));
+            .build(engine));
 }
 
 FEngine::~FEngine() noexcept {
@@ -234,7 +313,7 @@ FEngine::~FEngine() noexcept {
 void FEngine::shutdown() {
 #ifndef NDEBUG
     // print out some statistics about this run
-    size_t wm = mCommandBufferQueue.getHigWatermark();
+    size_t wm = mCommandBufferQueue.getStatistics().highWatermark;
     size_t wmpct = wm / (CONFIG_COMMAND_BUFFERS_SIZE / 100);
     slog.d << "CircularBuffer: High watermark "
            << wm / 1024 << " KiB (" << wmpct << "%)" << io::endl;
@@ -246,14 +325,17 @@ void FEngine::shutdown() {
      * Destroy our own state first
      */
 
+    destroyDeferredObjects(true);           // destroy the objects still queued
+    mMipmapGenerator.terminate(*this);      // wait for the mipmaps being generated
     mPostProcessManager.terminate(driver);  // free-up post-process manager resources
-    mRenderTargetPool.terminate(driver);    // free-up all offscreen render targets
     mDFG->terminate();                      // free-up the DFG
     mRenderableManager.terminate();         // free-up all renderables
     mLightManager.terminate();              // free-up all lights
     mCameraManager.terminate();             // free-up all cameras
 
-    driver.destroyRenderPrimitive(mFullScreenTriangleRph);
+    if (mFullScreenTriangleRph) {
+        driver.destroyRenderPrimitive(mFullScreenTriangleRph);
+    }
     destroy(mFullScreenTriangleIb);
     destroy(mFullScreenTriangleVb);
 
@@ -269,6 +351,11 @@ void FEngine::shutdown() {
     // try to destroy objects in the inverse dependency
     cleanupResourceList(mRenderers);
     cleanupResourceList(mViews);
+
+    // this must be done after Views, which return their shadow atlas to the pool
+    mRenderTargetPool.terminate(driver);    // free-up all offscreen render targets
+
+    cleanupResourceList(mSceneLoaders);    // before the scenes they fill
     cleanupResourceList(mScenes);
     cleanupResourceList(mSkyboxes);
 
@@ -277,8 +364,12 @@ void FEngine::shutdown() {
         destroy(material);
     }
 
+    cleanupResourceList(mLoaderContexts);
     cleanupResourceList(mIndexBuffers);
     cleanupResourceList(mVertexBuffers);
+    cleanupResourceList(mSkinningBuffers);
+    cleanupResourceList(mMorphTargetBuffers);
+    cleanupResourceList(mIBLPrefilters);   // before the textures they fill
     cleanupResourceList(mTextures);
     cleanupResourceList(mMaterials);
     for (auto& item : mMaterialInstances) {
@@ -301,12 +392,24 @@ void FEngine::shutdown() {
     mDriverThread.join();
     mTerminated = true;
 
+    if (mSharesProgramCache) {
+        SharedResources::releaseProgramCache();
+    }
+
     // detach this thread from the jobsystem
     mJobSystem.emancipate();
 }
 
 void FEngine::prepare() {
     SYSTRACE_CALL();
+    mFrameCount++;
+
+    // the entities loaded this frame can create material instances and record uploads, so the
+    // scene loaders run first
+    for (FSceneLoader* loader : mSceneLoaders) {
+        loader->execute(*this);
+    }
+
     // prepare() is called once per Renderer frame. Ideally we would upload the content of
     // UBOs that are visible only. It's not such a big issue because the actual upload() is
     // skipped is the UBO hasn't changed. Still we could have a lot of these.
@@ -315,6 +418,16 @@ void FEngine::prepare() {
             item->commit(*this);
         }
     }
+
+    // the uploads recorded by the other threads since the last frame
+    for (FLoaderContext* loader : mLoaderContexts) {
+        loader->execute(*this);
+    }
+
+    // the runtime IBL prefiltering is spread over several frames
+    for (FIBLPrefilter* prefilter : mIBLPrefilters) {
+        prefilter->execute(*this);
+    }
 }
 
 void FEngine::gc() {
@@ -332,6 +445,77 @@ void FEngine::gc() {
             JobSystem::DONT_SIGNAL);
 
     js.runAndWait(parent);
+
+    // gc() happens at the end of the frame, so all scenes have caught up with the change journals,
+    // scenes that haven't will simply gather all their data again (see FScene::prepare()).
+    mRenderableManager.trimChangeJournal();
+    mTransformManager.trimChangeJournal();
+    mLightManager.trimChangeJournal();
+}
+
+Engine::MemoryReport FEngine::getMemoryReport() noexcept {
+    MemoryReport report;
+
+    // the statistics of the backend are copied by a command, which we wait for
+    Driver::MemoryStatistics stats;
+    getDriverApi().getMemoryStatistics(&stats);
+    FFence::waitAndDestroy(createFence(Fence::Type::SOFT), Fence::Mode::FLUSH);
+    report.gpuAllocated = stats.gpuAllocated;
+    report.driverHandles = stats.handleArena;
+
+    for (FTexture const* texture : mTextures) {
+        report.textures += texture->getSize();
+    }
+    for (FVertexBuffer const* vertexBuffer : mVertexBuffers) {
+        report.vertexBuffers += vertexBuffer->getSize();
+    }
+    for (FIndexBuffer const* indexBuffer : mIndexBuffers) {
+        report.indexBuffers += indexBuffer->getSize();
+    }
+    for (FMaterial const* material : mMaterials) {
+        report.materialPackages += material->getPackageSize();
+    }
+    for (auto const& materialInstanceList : mMaterialInstances) {
+        report.materialInstanceCount += uint32_t(materialInstanceList.second.size());
+    }
+    report.textureCount = uint32_t(mTextures.size());
+    report.vertexBufferCount = uint32_t(mVertexBuffers.size());
+    report.indexBufferCount = uint32_t(mIndexBuffers.size());
+    report.materialCount = uint32_t(mMaterials.size());
+
+    RenderTargetPool::Statistics const targets = mRenderTargetPool.getStatistics();
+    report.renderTargets = targets.size;
+    report.renderTargetCount = targets.count;
+
+    report.commandBuffer = CONFIG_COMMAND_BUFFERS_SIZE;
+    report.commandBufferHighWatermark = mCommandBufferQueue.getStatistics().highWatermark;
+    report.perRenderPassArena = mPerRenderPassAllocator.getArea().getSize();
+    report.components = mRenderableManager.getMemorySize() + mTransformManager.getMemorySize() +
+            mLightManager.getMemorySize() + mCameraManager.getMemorySize();
+    return report;
+}
+
+void FEngine::destroyDeferredObjects(bool all) noexcept {
+    if (mDeferredDestroys.empty()) {
+        return;
+    }
+
+    SYSTRACE_CALL();
+
+    // the clock is only read every few objects, destroying one is usually much faster
+    constexpr size_t BATCH_SIZE = 64;
+    const auto start = std::chrono::steady_clock::now();
+    const bool unlimited = all || mDeferredDestroyBudget.count() == 0;
+    while (!mDeferredDestroys.empty()) {
+        for (size_t i = 0; i < BATCH_SIZE && !mDeferredDestroys.empty(); i++) {
+            DeferredDestroy const item = mDeferredDestroys.front();
+            mDeferredDestroys.pop_front();
+            item.destroy(*this, item.object);
+        }
+        if (!unlimited && std::chrono::steady_clock::now() - start >= mDeferredDestroyBudget) {
+            break;
+        }
+    }
 }
 
 void FEngine::flush() {
@@ -339,6 +523,16 @@ void FEngine::flush() {
     flushCommandBuffer(mCommandBufferQueue);
 }
 
+void FEngine::updateCommandBufferStatistics() noexcept {
+    CommandBufferQueue::Statistics const& stats = mCommandBufferQueue.getStatistics();
+    auto& properties = debug.commandbuffer;
+    properties.high_watermark = int(stats.highWatermark / 1024);
+    properties.frame_size = int((stats.flushedBytes - mLastFrameFlushedBytes) / 1024);
+    properties.stall_count = int(stats.stallCount);
+    properties.stall_time = int(stats.stallTime / 1000000);
+    mLastFrameFlushedBytes = stats.flushedBytes;
+}
+
 // -----------------------------------------------------------------------------------------------
 // Render thread / command queue
 // -----------------------------------------------------------------------------------------------
@@ -351,6 +545,9 @@ int FEngine::loop() {
                << (mBackend == driver::Backend::VULKAN ? "Vulkan" : "OpenGL") << io::endl;
 #endif
     }
+    if (mBlobCache) {
+        mExternalContext->setBlobCache(mBlobCache);
+    }
     mDriver = mExternalContext->createDriver(mSharedGLContext);
     mDriverBarrier.latch();
     if (UTILS_UNLIKELY(!mDriver)) {
@@ -362,29 +559,42 @@ int FEngine::loop() {
     JobSystem::setThreadName("FEngine::loop");
     JobSystem::setThreadPriority(JobSystem::Priority::DISPLAY);
 
-    // FIXME: we should do this based on the CPUs we actually have
-    uint32_t affinityMask = (std::thread::hardware_concurrency() >= 6) ? 0xF0 : 0;
+    // The driver thread is latency critical, keep it on the big cores when there are any.
+    const uint32_t bigCoreMask = JobSystem::getBigCoreMask();
 
     auto& commandBufferQueue = mCommandBufferQueue;
+    std::vector<CommandBufferQueue::Slice> buffers; // keeps its storage from one wait to the next
     while (true) {
         // wait until we get command buffers to be executed (or thread exit requested)
-        auto buffers = commandBufferQueue.waitForCommands();
+        const auto waitStart = std::chrono::steady_clock::now();
+        commandBufferQueue.waitForCommands(buffers);
+        const std::chrono::nanoseconds wait = std::chrono::steady_clock::now() - waitStart;
+        mDriverThreadWaitTime.fetch_add(uint64_t(wait.count()), std::memory_order_relaxed);
         if (UTILS_UNLIKELY(!buffers.size())) {
             break;
         }
 
+        // the cores reserved by the application are avoided, even if they're the big cores
+        const uint32_t reservedCoreMask = mJobSystem.getReservedCoreMask();
+        uint32_t affinityMask = bigCoreMask & ~reservedCoreMask;
+        if (!affinityMask && reservedCoreMask) {
+            affinityMask = ~reservedCoreMask;
+        }
         if (affinityMask) {
             // looks like thread affinity needs to be reset regularly (on Android)
             JobSystem::setThreadAffinity(affinityMask);
         }
 
         // execute all command buffers
+        const auto start = std::chrono::steady_clock::now();
         for (auto& item : buffers) {
             if (UTILS_LIKELY(item.begin)) {
                 mCommandStream.execute(item.begin);
                 mCommandBufferQueue.releaseBuffer(item);
             }
         }
+        const std::chrono::nanoseconds time = std::chrono::steady_clock::now() - start;
+        mDriverThreadTime.fetch_add(uint64_t(time.count()), std::memory_order_relaxed);
     }
 
     // terminate() is a synchronous API
@@ -392,16 +602,30 @@ int FEngine::loop() {
     return 0;
 }
 
+JobSystem::Job* FEngine::getRecordingJob() noexcept {
+    if (!mRecordingJob) {
+        // it's only run when we wait for it, which keeps it alive until then
+        mRecordingJob = mJobSystem.createJob();
+    }
+    return mRecordingJob;
+}
+
 void FEngine::flushCommandBuffer(CommandBufferQueue& commandQueue) {
+    if (mRecordingJob) {
+        // the reserved ranges must be filled before the buffer is handed to the driver thread
+        mJobSystem.runAndWait(mRecordingJob);
+        mRecordingJob = nullptr;
+    }
     getDriver().purge();
     commandQueue.flush();
 }
 
-const FMaterial* FEngine::getSkyboxMaterial(driver::TextureFormat format) const noexcept {
-    size_t index = (format == driver::TextureFormat::RGBM) ? 0 : 1;
+const FMaterial* FEngine::getSkyboxMaterial(driver::TextureFormat format,
+        bool irradiance) const noexcept {
+    size_t index = irradiance ? 2 : (format == driver::TextureFormat::RGBM) ? 0 : 1;
     FMaterial const* material = mSkyboxMaterials[index];
     if (UTILS_UNLIKELY(material == nullptr)) {
-        material = FSkybox::createMaterial(*const_cast<FEngine*>(this), format);
+        material = FSkybox::createMaterial(*const_cast<FEngine*>(this), format, irradiance);
         mSkyboxMaterials[index] = material;
     }
     return material;
@@ -410,10 +634,6 @@ const FMaterial* FEngine::getSkyboxMaterial(driver::TextureFormat format) const
 
 Handle<HwProgram> FEngine::createPostProcessProgram(MaterialParser& parser,
         ShaderModel shaderModel, PostProcessStage stage) const noexcept {
-    ShaderBuilder vShaderBuilder;
-    ShaderBuilder fShaderBuilder;
-    parser.getShader(shaderModel, (uint8_t) stage, ShaderType::VERTEX, vShaderBuilder);
-    parser.getShader(shaderModel, (uint8_t) stage, ShaderType::FRAGMENT, fShaderBuilder);
 
     // For the post-process program, we don't care about per-material sampler bindings but we still
     // need to populate a SamplerBindingMap and pass a weak reference to Program. Binding maps are
@@ -428,11 +648,24 @@ Handle<HwProgram> FEngine::createPostProcessProgram(MaterialParser& parser,
     Program pb;
     pb      .diagnostics(CString("Post Process"))
             .withSamplerBindings(pBindings)
-            .withVertexShader(CString(vShaderBuilder.getShader(), vShaderBuilder.size()))
-            .withFragmentShader(CString(fShaderBuilder.getShader(), fShaderBuilder.size()))
             .addUniformBlock(BindingPoints::PER_VIEW, &UibGenerator::getPerViewUib())
+            .addUniformBlock(BindingPoints::PER_FRAME, &UibGenerator::getPerFrameUib())
             .addUniformBlock(BindingPoints::POST_PROCESS, &UibGenerator::getPostProcessingUib())
             .addSamplerBlock(BindingPoints::POST_PROCESS, &SibGenerator::getPostProcessSib());
+
+    if (isComputeStage(stage)) {
+        ShaderBuilder cShaderBuilder;
+        parser.getShader(shaderModel, (uint8_t) stage, ShaderType::COMPUTE, cShaderBuilder);
+        pb.withComputeShader(cShaderBuilder.release());
+    } else {
+        ShaderBuilder vShaderBuilder;
+        ShaderBuilder fShaderBuilder;
+        parser.getShader(shaderModel, (uint8_t) stage, ShaderType::VERTEX, vShaderBuilder);
+        parser.getShader(shaderModel, (uint8_t) stage, ShaderType::FRAGMENT, fShaderBuilder);
+        pb.withVertexShader(vShaderBuilder.release());
+        pb.withFragmentShader(fShaderBuilder.release());
+    }
+
     auto program = const_cast<DriverApi&>(mCommandStream).createProgram(std::move(pb));
     assert(program);
     return program;
@@ -479,6 +712,14 @@ FIndirectLight* FEngine::createIndirectLight(const IndirectLight::Builder& build
     return create(mIndirectLights, builder);
 }
 
+FIBLPrefilter* FEngine::createIBLPrefilter(const IBLPrefilter::Builder& builder) noexcept {
+    return create(mIBLPrefilters, builder);
+}
+
+FSceneLoader* FEngine::createSceneLoader(const SceneLoader::Builder& builder) noexcept {
+    return create(mSceneLoaders, builder);
+}
+
 FMaterial* FEngine::createMaterial(const Material::Builder& builder) noexcept {
     return create(mMaterials, builder);
 }
@@ -491,6 +732,15 @@ FStream* FEngine::createStream(const Stream::Builder& builder) noexcept {
     return create(mStreams, builder);
 }
 
+FSkinningBuffer* FEngine::createSkinningBuffer(const SkinningBuffer::Builder& builder) noexcept {
+    return create(mSkinningBuffers, builder);
+}
+
+FMorphTargetBuffer* FEngine::createMorphTargetBuffer(
+        const MorphTargetBuffer::Builder& builder) noexcept {
+    return create(mMorphTargetBuffers, builder);
+}
+
 /*
  * Special cases
  */
@@ -541,6 +791,14 @@ FFence* FEngine::createFence(Fence::Type type) noexcept {
     return p;
 }
 
+FLoaderContext* FEngine::createLoaderContext() noexcept {
+    FLoaderContext* p = mHeapAllocator.make<FLoaderContext>();
+    if (p) {
+        mLoaderContexts.insert(p);
+    }
+    return p;
+}
+
 FSwapChain* FEngine::createSwapChain(void* nativeWindow, uint64_t flags) noexcept {
     FSwapChain* p = mHeapAllocator.make<FSwapChain>(*this, nativeWindow, flags);
     if (p) {
@@ -549,6 +807,14 @@ FSwapChain* FEngine::createSwapChain(void* nativeWindow, uint64_t flags) noexcep
     return p;
 }
 
+FSwapChain* FEngine::createSwapChain(uint32_t width, uint32_t height, uint64_t flags) noexcept {
+    FSwapChain* p = mHeapAllocator.make<FSwapChain>(*this, width, height, flags);
+    if (p) {
+        mSwapChains.insert(p);
+    }
+    return p;
+}
+
 /*
  * Objects created with a component manager
  */
@@ -628,6 +894,10 @@ inline void FEngine::destroy(const FScene* p) {
     terminateAndDestroy(p, mScenes);
 }
 
+void FEngine::destroy(const FSceneLoader* p) {
+    terminateAndDestroy(p, mSceneLoaders);
+}
+
 inline void FEngine::destroy(const FSkybox* p) {
     terminateAndDestroy(p, mSkyboxes);
 }
@@ -638,6 +908,12 @@ void FEngine::destroy(const FTexture* p) {
 }
 
 inline void FEngine::destroy(const FView* p) {
+    // the views sharing its culling results would keep a dangling pointer
+    for (FView* view : mViews) {
+        if (view->getCullingSource() == p) {
+            view->setCullingSource(nullptr);
+        }
+    }
     terminateAndDestroy(p, mViews);
 }
 
@@ -645,11 +921,19 @@ inline void FEngine::destroy(const FIndirectLight* p) {
     terminateAndDestroy(p, mIndirectLights);
 }
 
+void FEngine::destroy(const FIBLPrefilter* p) {
+    terminateAndDestroy(p, mIBLPrefilters);
+}
+
 UTILS_NOINLINE
 void FEngine::destroy(const FFence* p) {
     terminateAndDestroy(p, mFences);
 }
 
+void FEngine::destroy(const FLoaderContext* p) {
+    terminateAndDestroy(p, mLoaderContexts);
+}
+
 void FEngine::destroy(const FSwapChain* p) {
     terminateAndDestroy(p, mSwapChains);
 }
@@ -658,6 +942,14 @@ void FEngine::destroy(const FStream* p) {
     terminateAndDestroy(p, mStreams);
 }
 
+void FEngine::destroy(const FSkinningBuffer* p) {
+    terminateAndDestroy(p, mSkinningBuffers);
+}
+
+void FEngine::destroy(const FMorphTargetBuffer* p) {
+    terminateAndDestroy(p, mMorphTargetBuffers);
+}
+
 
 inline void FEngine::destroy(const FMaterial* ptr) {
     if (ptr != nullptr) {
@@ -699,6 +991,55 @@ void* FEngine::streamAlloc(size_t size, size_t alignment) noexcept {
     return getDriverApi().allocate(size, alignment);
 }
 
+void FEngine::setTextureUploadBudget(size_t bytesPerFrame) noexcept {
+    getDriverApi().setTextureUploadBudget(uint32_t(std::min(bytesPerFrame, size_t(UINT32_MAX))));
+}
+
+void FEngine::setRenderTargetBudget(size_t bytes) noexcept {
+    mRenderTargetPool.setBudget(bytes);
+}
+
+void FEngine::setTextureStreamingBudget(size_t bytes) noexcept {
+    mTextureStreamer.setBudget(bytes);
+}
+
+void FEngine::setReservedCores(uint32_t cpuMask) noexcept {
+    mJobSystem.setReservedCoreMask(cpuMask);
+}
+
+void FEngine::warmup(Warmup const* materials, size_t count,
+        WarmupCallback callback, void* user) noexcept {
+    // the programs to build, without the ones shared between materials
+    std::vector<Handle<HwProgram>> programs;
+    for (size_t i = 0; i < count; i++) {
+        FMaterial const* const material = upcast(materials[i].material);
+        const uint32_t keys = material->getVariantsToCompile(materials[i].variants);
+        for (uint8_t key = 0; key < VARIANT_COUNT; key++) {
+            if (keys & (1u << key)) {
+                Handle<HwProgram> program = material->getProgram(key);
+                if (std::find(programs.begin(), programs.end(), program) == programs.end()) {
+                    programs.push_back(program);
+                }
+            }
+        }
+    }
+
+    // each program is compiled by its own command, so the progress is reported between them
+    DriverApi& driverApi = getDriverApi();
+    const size_t total = programs.size();
+    for (size_t i = 0; i < total; i++) {
+        driverApi.compileProgram(programs[i]);
+        if (callback) {
+            driverApi.queueCommand([callback, user, i, total]() {
+                callback(i + 1, total, user);
+            });
+        }
+    }
+    if (callback && !total) {
+        driverApi.queueCommand([callback, user]() { callback(0, 0, user); });
+    }
+}
+
 // ---------------------------------------------------------------------------------------------
 
 EnginePerformanceTest::~EnginePerformanceTest() noexcept = default;
@@ -733,8 +1074,10 @@ EnginePerformanceTest::PFN EnginePerformanceTest::getDestroyUniverseApi() {
 
 using namespace details;
 
-Engine* Engine::create(Backend backend, ExternalContext* externalContext, void* sharedGLContext) {
-    std::unique_ptr<FEngine> engine(FEngine::create(backend, externalContext, sharedGLContext));
+Engine* Engine::create(Backend backend, ExternalContext* externalContext, void* sharedGLContext,
+        BlobCache* blobCache, size_t dfgLutSize) {
+    std::unique_ptr<FEngine> engine(
+            FEngine::create(backend, externalContext, sharedGLContext, blobCache, dfgLutSize));
     if (UTILS_UNLIKELY(!engine)) {
         // something went wrong during the driver or engine initialization
         return nullptr;
@@ -746,6 +1089,10 @@ Engine* Engine::create(Backend backend, ExternalContext* externalContext, void*
     return handle;
 }
 
+void Engine::setResourceSharing(bool enabled) noexcept {
+    SharedResources::setEnabled(enabled);
+}
+
 void Engine::destroy(Engine** engine) {
     if (engine) {
         std::unique_ptr<FEngine> filamentEngine;
@@ -795,10 +1142,18 @@ Fence* Engine::createFence(Fence::Type type) noexcept {
     return upcast(this)->createFence(type);
 }
 
+LoaderContext* Engine::createLoaderContext() noexcept {
+    return upcast(this)->createLoaderContext();
+}
+
 SwapChain* Engine::createSwapChain(void* nativeWindow, uint64_t flags) noexcept {
     return upcast(this)->createSwapChain(nativeWindow, flags);
 }
 
+SwapChain* Engine::createSwapChain(uint32_t width, uint32_t height, uint64_t flags) noexcept {
+    return upcast(this)->createSwapChain(width, height, flags);
+}
+
 void Engine::destroy(const VertexBuffer* p) {
     upcast(this)->destroy(upcast(p));
 }
@@ -811,6 +1166,14 @@ void Engine::destroy(const IndirectLight* p) {
     upcast(this)->destroy(upcast(p));
 }
 
+void Engine::destroy(const IBLPrefilter* p) {
+    upcast(this)->destroy(upcast(p));
+}
+
+void Engine::destroy(const SceneLoader* p) {
+    upcast(this)->destroy(upcast(p));
+}
+
 void Engine::destroy(const Material* p) {
     upcast(this)->destroy(upcast(p));
 }
@@ -819,6 +1182,10 @@ void Engine::destroy(const MaterialInstance* p) {
     upcast(this)->destroy(upcast(p));
 }
 
+void Engine::destroy(const MorphTargetBuffer* p) {
+    upcast(this)->destroy(upcast(p));
+}
+
 void Engine::destroy(const Renderer* p) {
     upcast(this)->destroy(upcast(p));
 }
@@ -831,6 +1198,10 @@ void Engine::destroy(const Scene* p) {
     upcast(this)->destroy(upcast(p));
 }
 
+void Engine::destroy(const SkinningBuffer* p) {
+    upcast(this)->destroy(upcast(p));
+}
+
 void Engine::destroy(const Skybox* p) {
     upcast(this)->destroy(upcast(p));
 }
@@ -847,6 +1218,10 @@ void Engine::destroy(const Fence* p) {
     upcast(this)->destroy(upcast(p));
 }
 
+void Engine::destroy(const LoaderContext* p) {
+    upcast(this)->destroy(upcast(p));
+}
+
 void Engine::destroy(const SwapChain* p) {
     upcast(this)->destroy(upcast(p));
 }
@@ -855,6 +1230,62 @@ void Engine::destroy(Entity e) {
     upcast(this)->destroy(e);
 }
 
+void Engine::destroyDeferred(const VertexBuffer* const* objects, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        upcast(this)->destroyDeferred(upcast(objects[i]));
+    }
+}
+
+void Engine::destroyDeferred(const IndexBuffer* const* objects, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        upcast(this)->destroyDeferred(upcast(objects[i]));
+    }
+}
+
+void Engine::destroyDeferred(const IndirectLight* const* objects, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        upcast(this)->destroyDeferred(upcast(objects[i]));
+    }
+}
+
+void Engine::destroyDeferred(const Material* const* objects, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        upcast(this)->destroyDeferred(upcast(objects[i]));
+    }
+}
+
+void Engine::destroyDeferred(const MaterialInstance* const* objects, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        upcast(this)->destroyDeferred(upcast(objects[i]));
+    }
+}
+
+void Engine::destroyDeferred(const MorphTargetBuffer* const* objects, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        upcast(this)->destroyDeferred(upcast(objects[i]));
+    }
+}
+
+void Engine::destroyDeferred(const SkinningBuffer* const* objects, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        upcast(this)->destroyDeferred(upcast(objects[i]));
+    }
+}
+
+void Engine::destroyDeferred(const Texture* const* objects, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        upcast(this)->destroyDeferred(upcast(objects[i]));
+    }
+}
+
+Engine::MemoryReport Engine::getMemoryReport() noexcept {
+    return upcast(this)->getMemoryReport();
+}
+
+void Engine::setDeferredDestroyBudget(uint32_t microseconds) noexcept {
+    upcast(this)->setDeferredDestroyBudget(microseconds);
+}
+
 RenderableManager& Engine::getRenderableManager() noexcept {
     return upcast(this)->getRenderableManager();
 }
@@ -867,10 +1298,35 @@ TransformManager& Engine::getTransformManager() noexcept {
     return upcast(this)->getTransformManager();
 }
 
+utils::JobSystem& Engine::getJobSystem() noexcept {
+    return upcast(this)->getJobSystem();
+}
+
 void* Engine::streamAlloc(size_t size, size_t alignment) noexcept {
     return upcast(this)->streamAlloc(size, alignment);
 }
 
+void Engine::setTextureUploadBudget(size_t bytesPerFrame) noexcept {
+    upcast(this)->setTextureUploadBudget(bytesPerFrame);
+}
+
+void Engine::setRenderTargetBudget(size_t bytes) noexcept {
+    upcast(this)->setRenderTargetBudget(bytes);
+}
+
+void Engine::setTextureStreamingBudget(size_t bytes) noexcept {
+    upcast(this)->setTextureStreamingBudget(bytes);
+}
+
+void Engine::setReservedCores(uint32_t cpuMask) noexcept {
+    upcast(this)->setReservedCores(cpuMask);
+}
+
+void Engine::warmup(Warmup const* materials, size_t count,
+        WarmupCallback callback, void* user) noexcept {
+    upcast(this)->warmup(materials, count, callback, user);
+}
+
 DebugRegistry& Engine::getDebugRegistry() noexcept {
     return upcast(this)->getDebugRegistry();
 }
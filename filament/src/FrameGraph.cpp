@@ -0,0 +1,334 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FrameGraph.h"
+
+#include <utils/Panic.h>
+
+#include <string.h>
+
+namespace filament {
+
+using namespace driver;
+
+// ------------------------------------------------------------------------------------------------
+
+FrameGraphResource FrameGraph::Builder::create(const char* name, Descriptor const& desc) noexcept {
+    return mFrameGraph.create(name, desc);
+}
+
+FrameGraphResource FrameGraph::Builder::read(FrameGraphResource r,
+        TargetBufferFlags attachments) noexcept {
+    Access& access = mFrameGraph.getAccess(mPass, r);
+    access.reads |= attachments;
+    access.sampled = true;
+    return r;
+}
+
+FrameGraphResource FrameGraph::Builder::blit(FrameGraphResource r) noexcept {
+    Access& access = mFrameGraph.getAccess(mPass, r);
+    access.reads |= TargetBufferFlags::COLOR;
+    return r;
+}
+
+FrameGraphResource FrameGraph::Builder::write(FrameGraphResource r) noexcept {
+    Access& access = mFrameGraph.getAccess(mPass, r);
+    access.writes = true;
+    return r;
+}
+
+FrameGraphResource FrameGraph::Builder::image(FrameGraphResource r) noexcept {
+    Access& access = mFrameGraph.getAccess(mPass, r);
+    access.writes = true;
+    access.image = true;
+    return r;
+}
+
+void FrameGraph::Builder::sideEffect() noexcept {
+    mFrameGraph.mPasses[mPass].sideEffect = true;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+RenderTargetPool::Target const* FrameGraph::Resources::getTarget(
+        FrameGraphResource r) const noexcept {
+    assert(mFrameGraph.findAccess(mPass, r.index));
+    return mFrameGraph.mResources[r.index].target;
+}
+
+Handle<HwRenderTarget> FrameGraph::Resources::getRenderTarget(
+        FrameGraphResource r) const noexcept {
+    assert(mFrameGraph.findAccess(mPass, r.index));
+    ResourceNode const& resource = mFrameGraph.mResources[r.index];
+    return resource.isImported ? resource.imported : resource.target->target;
+}
+
+TargetBufferFlags FrameGraph::Resources::getDiscardStart(FrameGraphResource r) const noexcept {
+    return TargetBufferFlags(mFrameGraph.getDiscardStart(mPass, r.index));
+}
+
+TargetBufferFlags FrameGraph::Resources::getDiscardEnd(FrameGraphResource r) const noexcept {
+    return TargetBufferFlags(mFrameGraph.getDiscardEnd(mPass, r.index));
+}
+
+// ------------------------------------------------------------------------------------------------
+
+FrameGraph::FrameGraph(details::ArenaScope& arena, RenderTargetPool& pool) noexcept
+        : mArena(arena), mPool(pool) {
+    mPasses.reserve(16);
+    mResources.reserve(16);
+}
+
+FrameGraph::~FrameGraph() noexcept {
+    // targets are returned to the pool as soon as they're not needed, unless execute()
+    // wasn't called
+    for (ResourceNode const& resource : mResources) {
+        assert(!resource.target || resource.isImported);
+    }
+}
+
+uint16_t FrameGraph::addPassNode(const char* name, Executor* executor) noexcept {
+    assert(!mCompiled);
+    uint16_t index = uint16_t(mPasses.size());
+    mPasses.push_back({ name, executor });
+    return index;
+}
+
+FrameGraph::Access& FrameGraph::getAccess(uint16_t pass, FrameGraphResource r) noexcept {
+    assert(r.isValid() && r.index < mResources.size());
+    std::vector<Access>& accesses = mPasses[pass].accesses;
+    for (Access& access : accesses) {
+        if (access.resource == r.index) {
+            return access;
+        }
+    }
+    accesses.push_back({ r.index, 0, false, false, false });
+    return accesses.back();
+}
+
+FrameGraph::Access const* FrameGraph::findAccess(uint16_t pass, uint16_t resource) const noexcept {
+    for (Access const& access : mPasses[pass].accesses) {
+        if (access.resource == resource) {
+            return &access;
+        }
+    }
+    return nullptr;
+}
+
+FrameGraphResource FrameGraph::create(const char* name, Descriptor const& desc) noexcept {
+    FrameGraphResource r(uint16_t(mResources.size()));
+    mResources.push_back({ name, desc });
+    return r;
+}
+
+FrameGraphResource FrameGraph::import(const char* name, Descriptor const& desc,
+        Handle<HwRenderTarget> target, TargetBufferFlags discardStart) noexcept {
+    FrameGraphResource r(uint16_t(mResources.size()));
+    ResourceNode resource{ name, desc };
+    resource.imported = target;
+    resource.isImported = true;
+    resource.importDiscardStart = discardStart;
+    mResources.push_back(resource);
+    return r;
+}
+
+void FrameGraph::present(FrameGraphResource r) noexcept {
+    assert(r.isValid() && r.index < mResources.size());
+    mResources[r.index].presented = true;
+}
+
+void FrameGraph::compile() noexcept {
+    assert(!mCompiled);
+    mCompiled = true;
+
+    // reference counts: a pass is referenced by the resources it writes, a resource by the
+    // passes reading it (and by the presentation)
+    for (PassNode& pass : mPasses) {
+        for (Access const& access : pass.accesses) {
+            if (access.writes) {
+                pass.refCount++;
+            }
+            if (access.reads) {
+                mResources[access.resource].refCount++;
+            }
+        }
+    }
+
+    std::vector<uint16_t> unreferenced;
+    auto cull = [this, &unreferenced](PassNode& pass) {
+        pass.culled = true;
+        for (Access const& read : pass.accesses) {
+            if (read.reads && --mResources[read.resource].refCount == 0) {
+                unreferenced.push_back(read.resource);
+            }
+        }
+    };
+
+    for (size_t i = 0, c = mResources.size(); i < c; i++) {
+        ResourceNode& resource = mResources[i];
+        if (resource.presented) {
+            resource.refCount++;
+        }
+        if (resource.refCount == 0) {
+            unreferenced.push_back(uint16_t(i));
+        }
+    }
+    for (PassNode& pass : mPasses) {
+        if (!pass.sideEffect && pass.refCount == 0) {
+            cull(pass);
+        }
+    }
+
+    // cull the passes whose writes are all unreferenced, which in turn may leave the resources
+    // they read unreferenced
+    while (!unreferenced.empty()) {
+        const uint16_t index = unreferenced.back();
+        unreferenced.pop_back();
+        for (size_t i = 0, c = mPasses.size(); i < c; i++) {
+            PassNode& pass = mPasses[i];
+            Access const* access = findAccess(uint16_t(i), index);
+            if (!access || !access->writes || pass.sideEffect || pass.culled) {
+                continue;
+            }
+            assert(pass.refCount > 0);
+            if (--pass.refCount == 0) {
+                cull(pass);
+            }
+        }
+    }
+
+    // lifetimes, and how the resources are used by the passes left
+    std::vector<uint8_t> sampled(mResources.size(), 0);
+    for (size_t i = 0, c = mPasses.size(); i < c; i++) {
+        PassNode const& pass = mPasses[i];
+        if (pass.culled) {
+            continue;
+        }
+        for (Access const& access : pass.accesses) {
+            ResourceNode& resource = mResources[access.resource];
+            if (!resource.used) {
+                resource.used = true;
+                resource.first = uint16_t(i);
+            }
+            resource.last = uint16_t(i);
+            if (access.sampled) {
+                sampled[access.resource] |= access.reads;
+            }
+            if (access.image) {
+                sampled[access.resource] |= TargetBufferFlags::COLOR;
+            }
+        }
+    }
+
+    for (size_t i = 0, c = mResources.size(); i < c; i++) {
+        ResourceNode& resource = mResources[i];
+        if (resource.isImported) {
+            continue;
+        }
+        Descriptor& desc = resource.desc;
+        if (sampled[i] & TargetBufferFlags::DEPTH) {
+            desc.flags |= RenderTargetPool::Target::DEPTH_TEXTURE;
+        }
+        if ((desc.attachments & TargetBufferFlags::COLOR) &&
+                !(sampled[i] & TargetBufferFlags::COLOR) &&
+                !(desc.flags & (RenderTargetPool::Target::SUBPASS |
+                                RenderTargetPool::Target::DEPTH_TEXTURE))) {
+            // only rendered into or blitted from: renderbuffers are enough
+            desc.flags |= RenderTargetPool::Target::NO_TEXTURE;
+        }
+    }
+}
+
+uint8_t FrameGraph::getDiscardStart(uint16_t pass, uint16_t resource) const noexcept {
+    ResourceNode const& node = mResources[resource];
+    if (node.first != pass) {
+        return TargetBufferFlags::NONE;
+    }
+    return node.isImported ? node.importDiscardStart : uint8_t(TargetBufferFlags::ALL);
+}
+
+uint8_t FrameGraph::getDiscardEnd(uint16_t pass, uint16_t resource) const noexcept {
+    ResourceNode const& node = mResources[resource];
+    uint8_t needed = node.presented ? uint8_t(TargetBufferFlags::COLOR) : uint8_t(0);
+    for (size_t i = pass + 1u, c = mPasses.size(); i < c; i++) {
+        if (mPasses[i].culled) {
+            continue;
+        }
+        Access const* access = findAccess(uint16_t(i), resource);
+        if (access) {
+            // a later pass rendering into the target may load any of its buffers
+            needed |= access->writes ? uint8_t(TargetBufferFlags::ALL) : access->reads;
+        }
+    }
+    return uint8_t(TargetBufferFlags::ALL & ~needed);
+}
+
+void FrameGraph::execute() noexcept {
+    assert(mCompiled);
+    for (size_t i = 0, c = mPasses.size(); i < c; i++) {
+        PassNode const& pass = mPasses[i];
+        if (pass.culled) {
+            continue;
+        }
+
+        // the transient targets are allocated right before their first use...
+        for (Access const& access : pass.accesses) {
+            ResourceNode& resource = mResources[access.resource];
+            if (!resource.isImported && resource.first == i) {
+                Descriptor const& desc = resource.desc;
+                resource.target = mPool.get(desc.attachments,
+                        desc.width, desc.height, desc.samples, desc.format, desc.flags);
+            }
+        }
+
+        pass.executor->execute(Resources(*this, uint16_t(i)));
+
+        // ...and returned to the pool right after their last use, so that the targets of the
+        // following passes can reuse them
+        for (Access const& access : pass.accesses) {
+            ResourceNode& resource = mResources[access.resource];
+            if (!resource.isImported && resource.last == i) {
+                mPool.put(resource.target);
+                resource.target = nullptr;
+            }
+        }
+    }
+}
+
+bool FrameGraph::isCulled(const char* name) const noexcept {
+    for (PassNode const& pass : mPasses) {
+        if (!strcmp(pass.name, name)) {
+            return pass.culled;
+        }
+    }
+    return true;
+}
+
+TargetBufferFlags FrameGraph::getDiscardEnd(const char* name,
+        FrameGraphResource r) const noexcept {
+    for (size_t i = 0, c = mPasses.size(); i < c; i++) {
+        if (!strcmp(mPasses[i].name, name)) {
+            return TargetBufferFlags(getDiscardEnd(uint16_t(i), r.index));
+        }
+    }
+    return TargetBufferFlags::NONE;
+}
+
+FrameGraph::Descriptor const& FrameGraph::getDescriptor(FrameGraphResource r) const noexcept {
+    return mResources[r.index].desc;
+}
+
+} // namespace filament
@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_FRAMEGRAPH_H
+#define TNT_FILAMENT_FRAMEGRAPH_H
+
+#include "RenderTargetPool.h"
+
+#include "details/Allocators.h"
+
+#include "driver/Handle.h"
+
+#include <filament/driver/DriverEnums.h>
+
+#include <utils/compiler.h>
+
+#include <utility>
+#include <vector>
+
+#include <stdint.h>
+
+namespace filament {
+
+// A render target declared in a FrameGraph
+class FrameGraphResource {
+public:
+    FrameGraphResource() noexcept = default;
+    bool isValid() const noexcept { return index != UNINITIALIZED; }
+    bool operator==(FrameGraphResource rhs) const noexcept { return index == rhs.index; }
+
+private:
+    friend class FrameGraph;
+    static constexpr uint16_t UNINITIALIZED = 0xFFFF;
+    explicit FrameGraphResource(uint16_t index) noexcept : index(index) { }
+    uint16_t index = UNINITIALIZED;
+};
+
+/*
+ * The passes of a frame, declared along with the render targets they read and write.
+ *
+ * Passes are added with addPass(): the setup function runs immediately and declares the pass'
+ * resources with a Builder, the execute function runs in execute(), in the order the passes were
+ * added, and gets the concrete render targets from Resources.
+ *
+ * compile() works out from these declarations:
+ * - which passes can be culled, because nothing uses what they write,
+ * - the lifetime of the transient render targets. They're taken from the RenderTargetPool right
+ *   before the first pass using them, and returned right after the last one, so that later
+ *   targets with the same description reuse their memory within the frame,
+ * - the buffers each pass can discard when it starts and ends rendering into a target,
+ * - whether a target needs textures at all (NO_TEXTURE), and whether its depth buffer must be a
+ *   texture (DEPTH_TEXTURE).
+ *
+ * A FrameGraph lives for one frame, its passes are allocated in the per-frame arena.
+ */
+class FrameGraph {
+public:
+    // describes a transient render target, see RenderTargetPool::get()
+    struct Descriptor {
+        driver::TargetBufferFlags attachments = driver::TargetBufferFlags::COLOR;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint8_t samples = 1;
+        driver::TextureFormat format = driver::TextureFormat::RGBA8;
+        uint8_t flags = 0;  // only RenderTargetPool::Target::SUBPASS, the others are computed
+    };
+
+    class Builder {
+    public:
+        // declares a transient render target, its content is undefined before it's written
+        FrameGraphResource create(const char* name, Descriptor const& desc) noexcept;
+
+        // the pass samples the given buffers of the resource
+        FrameGraphResource read(FrameGraphResource r,
+                driver::TargetBufferFlags attachments = driver::TargetBufferFlags::COLOR) noexcept;
+
+        // the pass blits from the color buffer of the resource, which doesn't need a texture
+        FrameGraphResource blit(FrameGraphResource r) noexcept;
+
+        // the pass renders into the resource
+        FrameGraphResource write(FrameGraphResource r) noexcept;
+
+        // a compute shader of the pass writes the color buffer of the resource as an image, which
+        // needs a texture
+        FrameGraphResource image(FrameGraphResource r) noexcept;
+
+        // the pass has effects outside of the frame graph, it's never culled
+        void sideEffect() noexcept;
+
+    private:
+        friend class FrameGraph;
+        Builder(FrameGraph& fg, uint16_t pass) noexcept : mFrameGraph(fg), mPass(pass) { }
+        FrameGraph& mFrameGraph;
+        uint16_t mPass;
+    };
+
+    class Resources {
+    public:
+        // the target of a resource used by the executing pass
+        RenderTargetPool::Target const* getTarget(FrameGraphResource r) const noexcept;
+        Handle<HwRenderTarget> getRenderTarget(FrameGraphResource r) const noexcept;
+
+        // the buffers of a resource written by the executing pass, which it can discard before
+        // rendering (nothing was written before) and after rendering (nothing reads them later)
+        driver::TargetBufferFlags getDiscardStart(FrameGraphResource r) const noexcept;
+        driver::TargetBufferFlags getDiscardEnd(FrameGraphResource r) const noexcept;
+
+    private:
+        friend class FrameGraph;
+        Resources(FrameGraph const& fg, uint16_t pass) noexcept : mFrameGraph(fg), mPass(pass) { }
+        FrameGraph const& mFrameGraph;
+        uint16_t mPass;
+    };
+
+    FrameGraph(details::ArenaScope& arena, RenderTargetPool& pool) noexcept;
+    ~FrameGraph() noexcept;
+
+    FrameGraph(FrameGraph const&) = delete;
+    FrameGraph& operator=(FrameGraph const&) = delete;
+
+    /*
+     * Adds a pass. setup(Builder&, Data&) runs immediately, execute(Resources const&,
+     * Data const&) runs in execute() unless the pass is culled.
+     */
+    template<typename Data, typename Setup, typename Execute>
+    Data const& addPass(const char* name, Setup setup, Execute&& execute) noexcept {
+        using PassType = Pass<Data, typename std::decay<Execute>::type>;
+        PassType* const pass = mArena.make<PassType>(std::forward<Execute>(execute));
+        const uint16_t index = addPassNode(name, pass);
+        Builder builder(*this, index);
+        setup(builder, pass->data);
+        return pass->data;
+    }
+
+    // declares a transient render target outside of a pass, e.g. to hand it from one group of
+    // passes to another. Same as Builder::create().
+    FrameGraphResource create(const char* name, Descriptor const& desc) noexcept;
+
+    // An existing render target, e.g. the view's. Its buffers are kept across the frame, except
+    // for discardStart, which may be discarded by the first pass writing it.
+    FrameGraphResource import(const char* name, Descriptor const& desc,
+            Handle<HwRenderTarget> target,
+            driver::TargetBufferFlags discardStart = driver::TargetBufferFlags::NONE) noexcept;
+
+    // the color buffer of the resource is used after the frame (e.g. it's presented)
+    void present(FrameGraphResource r) noexcept;
+
+    void compile() noexcept;
+
+    // runs the passes that were not culled, in order
+    void execute() noexcept;
+
+    // for debugging and tests
+    bool isCulled(const char* name) const noexcept;
+    driver::TargetBufferFlags getDiscardEnd(const char* pass, FrameGraphResource r) const noexcept;
+    Descriptor const& getDescriptor(FrameGraphResource r) const noexcept;
+
+private:
+    struct Executor {
+        virtual ~Executor() noexcept = default;
+        virtual void execute(Resources const& resources) noexcept = 0;
+    };
+
+    template<typename Data, typename Execute>
+    struct Pass final : public Executor {
+        explicit Pass(Execute&& execute) noexcept : exec(std::move(execute)) { }
+        explicit Pass(Execute const& execute) noexcept : exec(execute) { }
+        void execute(Resources const& resources) noexcept override { exec(resources, data); }
+        Data data{};
+        Execute exec;
+    };
+
+    // how a pass uses a resource
+    struct Access {
+        uint16_t resource;
+        uint8_t reads;      // TargetBufferFlags sampled or blitted by the pass
+        bool sampled;
+        bool writes;
+        bool image;         // written as an image
+    };
+
+    struct PassNode {
+        const char* name;
+        Executor* executor;
+        std::vector<Access> accesses;
+        uint32_t refCount = 0;          // number of resources written that are used
+        bool sideEffect = false;
+        bool culled = false;
+    };
+
+    struct ResourceNode {
+        const char* name;
+        Descriptor desc;
+        Handle<HwRenderTarget> imported;
+        bool isImported = false;
+        bool presented = false;
+        uint8_t importDiscardStart = 0;
+        uint32_t refCount = 0;          // number of readers that are not culled
+        uint16_t first = 0;             // first and last passes using the resource
+        uint16_t last = 0;
+        bool used = false;
+        RenderTargetPool::Target const* target = nullptr;
+    };
+
+    uint16_t addPassNode(const char* name, Executor* executor) noexcept;
+    Access& getAccess(uint16_t pass, FrameGraphResource r) noexcept;
+    Access const* findAccess(uint16_t pass, uint16_t resource) const noexcept;
+    uint8_t getDiscardStart(uint16_t pass, uint16_t resource) const noexcept;
+    uint8_t getDiscardEnd(uint16_t pass, uint16_t resource) const noexcept;
+
+    details::ArenaScope& mArena;
+    RenderTargetPool& mPool;
+    std::vector<PassNode> mPasses;
+    std::vector<ResourceNode> mResources;
+    bool mCompiled = false;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_FRAMEGRAPH_H
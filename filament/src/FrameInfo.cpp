@@ -56,6 +56,8 @@ void FrameInfo::lap(FrameInfoManager* mgr, lap_id id) {
 }
 
 void FrameInfo::endFrame(FrameInfoManager* mgr) {
+    // the fence below guarantees the statistics are written when it's signaled
+    mgr->mEngine.getDriverApi().getFrameStatistics(&statistics);
     Fence* fence = mgr->getEngine().createFence(Fence::Type::HARD);
     mgr->push([this, mgr, fence]() {
         char buf[256];
@@ -78,14 +80,20 @@ void FrameInfoManager::beginFrame(uint32_t frameId) {
     mCurrentFrameInfo = info;
     if (info) {
         info->frame = frameId;
+        info->statistics = {};
+        info->phases = {};
+        info->cpu = {};
         info->beginFrame(this);
     }
 }
 
-void FrameInfoManager::endFrame() {
+void FrameInfoManager::endFrame(PhaseProfiler::FrameCounters const& phases,
+        FrameInfo::CpuStatistics const& cpu) {
     FrameInfo* const info = mCurrentFrameInfo;
     if (info) {
         mCurrentFrameInfo = nullptr;
+        info->phases = phases;
+        info->cpu = cpu;
         info->endFrame(this);
     }
 }
@@ -17,9 +17,12 @@
 #ifndef TNT_FILAMENT_FRAMEINFO_H
 #define TNT_FILAMENT_FRAMEINFO_H
 
+#include "PhaseProfiler.h"
+
 #include "details/Engine.h"
 
 #include <filament/Fence.h>
+#include <filament/Renderer.h>
 
 #include <utils/Allocator.h>
 
@@ -68,11 +71,31 @@ public:
 
     uint32_t frame = 0;
     time_point laps[MAX_LAPS_IDS] = { time_point::max() };
+
+    // state changes issued by the driver, filled in by the driver thread before FINISH
+    Driver::FrameStatistics statistics;
+
+    // hardware counters of each phase of the frame, only set when the PhaseProfiler is enabled
+    PhaseProfiler::FrameCounters phases;
+
+    // measured on the CPU when the frame ends, see FRenderer::endFrame()
+    struct CpuStatistics {
+        duration mainThreadTime{};
+        duration mainThreadWaitTime{};  // waiting for the driver thread, in flush()
+        duration driverThreadTime{};    // since the previous frame ended
+        duration driverThreadWaitTime{};
+        duration workerBusyTime{};      // of all the JobSystem workers
+        duration workerIdleTime{};
+        uint64_t commandBufferSize = 0; // bytes flushed since the previous frame ended
+        uint32_t drawCount = 0;
+        uint32_t triangleCount = 0;
+    };
+    CpuStatistics cpu;
 };
 
 class FrameInfoManager {
     friend class FrameInfo;
-    static constexpr size_t HISTORY_COUNT = 5;
+    static constexpr size_t HISTORY_COUNT = Renderer::FRAME_INFO_HISTORY_SIZE;
     static constexpr size_t POOL_COUNT = 8;
 
     // set this to true to enable extra timing infos
@@ -109,7 +132,8 @@ public:
     }
 
     // call this immediately before "swap buffers"
-    void endFrame();
+    void endFrame(PhaseProfiler::FrameCounters const& phases = {},
+            FrameInfo::CpuStatistics const& cpu = {});
 
     void cancelFrame();
 
@@ -119,10 +143,21 @@ public:
 
     duration getLastFrameTime() const noexcept {
         std::unique_lock<std::mutex> lock(mLock);
-        FrameInfo const& info = mFrameInfoHistory.front();
+        FrameInfo const& info = mFrameInfoHistory.back();
         return info.laps[FrameInfo::FINISH] - info.laps[FrameInfo::START];
     }
 
+    // the latest frame that completed, with its GPU timings (see Driver::FrameStatistics)
+    FrameInfo getLastFrameInfo() const noexcept {
+        std::unique_lock<std::mutex> lock(mLock);
+        return mFrameInfoHistory.back();
+    }
+
+    Driver::FrameStatistics getLastFrameStatistics() const noexcept {
+        std::unique_lock<std::mutex> lock(mLock);
+        return mFrameInfoHistory.back().statistics;
+    }
+
     std::vector<FrameInfo> getHistory() const noexcept {
         std::unique_lock<std::mutex> lock(mLock);
         return mFrameInfoHistory;
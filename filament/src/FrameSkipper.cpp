@@ -23,8 +23,9 @@ namespace details {
 
 FrameSkipper::FrameSkipper(FEngine& engine, size_t latency) noexcept
     : mEngine(engine) {
-    latency = std::max(latency, size_t(1));
+    latency = std::min(std::max(latency, size_t(1)), MAX_LATENCY);
     mFences.resize(latency);
+    mLatency = latency;
 }
 
 FrameSkipper::~FrameSkipper() noexcept {
@@ -35,6 +36,23 @@ FrameSkipper::~FrameSkipper() noexcept {
     }
 }
 
+void FrameSkipper::setLatency(size_t latency) noexcept {
+    latency = std::min(std::max(latency, size_t(1)), MAX_LATENCY);
+    // the oldest fences are at the front: a longer latency doesn't wait on the frames already
+    // in flight, a shorter one forgets the oldest ones
+    auto& fences = mFences;
+    while (fences.size() < latency) {
+        fences.push_front(nullptr);
+    }
+    while (fences.size() > latency) {
+        if (fences.front()) {
+            mEngine.destroy(fences.front());
+        }
+        fences.pop_front();
+    }
+    mLatency = latency;
+}
+
 void FrameSkipper::endFrame() noexcept {
     mFences.push_back( mEngine.createFence(Fence::Type::HARD) );
 }
@@ -64,6 +82,19 @@ bool FrameSkipper::skipFrameNeeded() const noexcept {
     return false;
 }
 
+void FrameSkipper::waitForFrame() noexcept {
+    mExtraSkipCount = 0;
+    if (mFences.empty()) {
+        return;
+    }
+    FFence* fence = mFences.front();
+    if (fence) {
+        fence->wait(Fence::Mode::FLUSH, Fence::FENCE_WAIT_FOR_EVER);
+        mEngine.destroy(fence);
+    }
+    mFences.pop_front();
+}
+
 
 } // namespace details
 } // namespace filament
@@ -25,6 +25,7 @@
 
 #include <utils/Allocator.h>
 #include <utils/BinaryTreeArray.h>
+#include <utils/Hash.h>
 #include <utils/Systrace.h>
 
 #include <math/mat4.h>
@@ -76,11 +77,40 @@ constexpr size_t RECORD_BUFFER_WIDTH_MASK   = RECORD_BUFFER_WIDTH - 1u;
 constexpr size_t RECORD_BUFFER_HEIGHT       = 2048;
 constexpr size_t RECORD_BUFFER_ENTRY_COUNT  = RECORD_BUFFER_WIDTH * RECORD_BUFFER_HEIGHT; // 64K
 
-// Buffer needed for Froxelizer internal data structures (~256 KiB)
+// The record buffer is sized for 8 lights per froxel with the froxel budget, so that smaller
+// budgets also use a smaller record buffer.
+constexpr size_t RECORD_BUFFER_ENTRY_PER_FROXEL = RECORD_BUFFER_ENTRY_COUNT / FROXEL_BUFFER_ENTRY_COUNT_MAX;
+
+// With light binning, the froxel buffer holds the light range of each slice in its first row,
+// then the light bitmask of each tile, 32 bits per entry.
+// Make sure these match the same constants in light_punctual.fs
+constexpr size_t LIGHT_BIN_TILE_OFFSET      = FROXEL_BUFFER_WIDTH;
+constexpr size_t LIGHT_BIN_WORD_COUNT       = (CONFIG_MAX_LIGHT_COUNT + 31u) / 32u;
+
+static_assert(FEngine::CONFIG_FROXEL_SLICE_COUNT <= LIGHT_BIN_TILE_OFFSET,
+        "the light ranges of the slices must fit in the first row of the froxel buffer");
+static_assert(LIGHT_BIN_TILE_OFFSET + LIGHT_BIN_WORD_COUNT *
+        FROXEL_BUFFER_ENTRY_COUNT_MAX / FEngine::CONFIG_FROXEL_SLICE_COUNT <=
+                FROXEL_BUFFER_ENTRY_COUNT_MAX,
+        "the light bitmasks of the tiles must fit in the froxel buffer");
+
+// Froxels smaller than this (in pixels) don't make the per-froxel light lists much shorter,
+// this bounds the froxel budget of small viewports.
+constexpr size_t FROXEL_DIMENSION_MIN = 16;
+
+// Froxels added to the budget per light (the light count is rounded up to a power of two first),
+// i.e. 64 lights or more use FROXEL_BUFFER_ENTRY_COUNT_MAX froxels.
+constexpr size_t FROXEL_BUDGET_PER_LIGHT = 128;
+
+// Buffer needed for Froxelizer internal data structures (~352 KiB)
 constexpr size_t PER_FROXELDATA_ARENA_SIZE = sizeof(float4) *
                                                  (FROXEL_BUFFER_ENTRY_COUNT_MAX +
                                                   FROXEL_BUFFER_ENTRY_COUNT_MAX + 3 +
-                                                  FEngine::CONFIG_FROXEL_SLICE_COUNT / 4 + 1);
+                                                  FEngine::CONFIG_FROXEL_SLICE_COUNT / 4 + 1) +
+                                             sizeof(Froxelizer::FroxelEntry) *
+                                                  FROXEL_BUFFER_ENTRY_COUNT_MAX +
+                                             sizeof(Froxelizer::RecordBufferType) *
+                                                  RECORD_BUFFER_ENTRY_COUNT;
 
 
 // number of lights processed by one group (e.g. 32)
@@ -96,17 +126,35 @@ static constexpr size_t GROUP_COUNT =
 static_assert(RECORD_BUFFER_ENTRY_COUNT <= 65536,
         "RecordBuffer cannot be larger than 65536 entries");
 
+// the storage buffers are read as arrays of uint, 4 records per uint, see light_punctual.fs
+static_assert(sizeof(Froxelizer::FroxelEntry) == sizeof(uint32_t),
+        "a froxel entry must be read as a single uint from the froxel storage buffer");
+static_assert(sizeof(Froxelizer::RecordBufferType) == sizeof(uint8_t),
+        "the records must be read as bytes from the record storage buffer");
+
 Froxelizer::Froxelizer(FEngine& engine)
         : mArena("froxel", PER_FROXELDATA_ARENA_SIZE) {
 
     DriverApi& driverApi = engine.getDriverApi();
 
+    // The shaders of the Vulkan backend read the froxel data from storage buffers, which are
+    // updated like any buffer and don't need a sampler. The other backends use textures.
+    const GPUBuffer::Storage storage = engine.getBackend() == Backend::VULKAN ?
+            GPUBuffer::Storage::BUFFER : GPUBuffer::Storage::TEXTURE;
+
     // RecordBuffer cannot be larger than 65536 entries, because indices are uint16_t
     GPUBuffer::ElementType type = std::is_same<RecordBufferType, uint8_t>::value
                                   ? GPUBuffer::ElementType::UINT8 : GPUBuffer::ElementType::UINT16;
-    mRecordsBuffer = GPUBuffer(driverApi, { type, 1 }, RECORD_BUFFER_WIDTH, RECORD_BUFFER_HEIGHT);
+    mRecordsBuffer = GPUBuffer(driverApi, { type, 1 }, RECORD_BUFFER_WIDTH, RECORD_BUFFER_HEIGHT,
+            storage);
     mFroxelBuffer  = GPUBuffer(driverApi, { GPUBuffer::ElementType::UINT16, 2 },
-            FROXEL_BUFFER_WIDTH, FROXEL_BUFFER_HEIGHT);
+            FROXEL_BUFFER_WIDTH, FROXEL_BUFFER_HEIGHT, storage);
+
+    // these are never freed, so they must be allocated before the viewport dependant data
+    mFroxelBufferGpu = mArena.alloc<FroxelEntry>(FROXEL_BUFFER_ENTRY_COUNT_MAX);
+    mRecordBufferGpu = mArena.alloc<RecordBufferType>(RECORD_BUFFER_ENTRY_COUNT);
+    assert(mFroxelBufferGpu);
+    assert(mRecordBufferGpu);
 }
 
 Froxelizer::~Froxelizer() {
@@ -121,6 +169,8 @@ void Froxelizer::terminate(DriverApi& driverApi) noexcept {
     mPlanesY = nullptr;
     mPlanesX = nullptr;
     mDistancesZ = nullptr;
+    mFroxelBufferGpu = nullptr;
+    mRecordBufferGpu = nullptr;
 
     mRecordsBuffer.terminate(driverApi);
     mFroxelBuffer.terminate(driverApi);
@@ -135,6 +185,23 @@ void Froxelizer::setOptions(float zLightNear, float zLightFar) noexcept {
 }
 
 
+void Froxelizer::setMaxFroxelCount(size_t maxFroxelCount) noexcept {
+    maxFroxelCount = std::min(std::max(maxFroxelCount, FROXEL_BUFFER_ENTRY_COUNT_MIN),
+            FROXEL_BUFFER_ENTRY_COUNT_MAX);
+    if (UTILS_UNLIKELY(mMaxFroxelCount != maxFroxelCount)) {
+        mMaxFroxelCount = uint16_t(maxFroxelCount);
+        mDirtyFlags |= VIEWPORT_CHANGED;
+    }
+}
+
+void Froxelizer::setLightBinning(bool enabled) noexcept {
+    if (UTILS_UNLIKELY(mLightBinning != enabled)) {
+        mLightBinning = enabled;
+        // the froxel buffer's layout and the uniforms change
+        mDirtyFlags |= VIEWPORT_CHANGED;
+    }
+}
+
 void Froxelizer::setViewport(Viewport const& viewport) noexcept {
     if (UTILS_UNLIKELY(mViewport != viewport)) {
         mViewport = viewport;
@@ -152,13 +219,28 @@ void Froxelizer::setProjection(const mat4f& projection, float near, float far) n
 
 bool Froxelizer::prepare(
         FEngine::DriverApi& driverApi, ArenaScope& arena, Viewport const& viewport,
-        const math::mat4f& projection, float projectionNear, float projectionFar) noexcept {
+        const math::mat4f& projection, float projectionNear, float projectionFar,
+        size_t lightCount) noexcept {
     setViewport(viewport);
     setProjection(projection, projectionNear, projectionFar);
 
+    // The budget grows as soon as needed, but only shrinks when it's at least halved, so that
+    // the layout isn't recomputed every frame when the light count oscillates around a
+    // power of two. Any other change recomputes the layout anyways.
+    const size_t froxelBudget = computeFroxelBudget(viewport, lightCount);
+    if (UTILS_UNLIKELY(froxelBudget > mFroxelBudget || 2 * froxelBudget <= mFroxelBudget ||
+            (mDirtyFlags & VIEWPORT_CHANGED))) {
+        if (mFroxelBudget != froxelBudget) {
+            mFroxelBudget = uint16_t(froxelBudget);
+            mDirtyFlags |= VIEWPORT_CHANGED;
+        }
+    }
+
     bool uniformsNeedUpdating = false;
     if (UTILS_UNLIKELY(mDirtyFlags)) {
         uniformsNeedUpdating = update();
+        // the froxels need to be computed again with the new layout
+        mInputsHashValid = false;
     }
 
     /*
@@ -166,24 +248,26 @@ bool Froxelizer::prepare(
      * the command stream.
      */
 
-    // froxel buffer (~32 KiB)
+    // froxel buffer (~32 KiB max), in whole rows of the froxel texture
+    const size_t froxelBufferEntryCount =
+            (getFroxelBufferEntryCount() + FROXEL_BUFFER_WIDTH_MASK) & ~FROXEL_BUFFER_WIDTH_MASK;
     mFroxelBufferUser = {
-            driverApi.allocatePod<FroxelEntry>(FROXEL_BUFFER_ENTRY_COUNT_MAX, CACHELINE_SIZE),
-            FROXEL_BUFFER_ENTRY_COUNT_MAX };
+            driverApi.allocatePod<FroxelEntry>(froxelBufferEntryCount, CACHELINE_SIZE),
+            froxelBufferEntryCount };
 
-    // record buffer (~64 KiB)
+    // record buffer (~64 KiB max)
     mRecordBufferUser = {
-            driverApi.allocatePod<RecordBufferType>(RECORD_BUFFER_ENTRY_COUNT, CACHELINE_SIZE),
-            RECORD_BUFFER_ENTRY_COUNT };
+            driverApi.allocatePod<RecordBufferType>(mRecordBufferEntryCount, CACHELINE_SIZE),
+            mRecordBufferEntryCount };
 
     /*
      * Temporary allocations for processing all froxel data
      */
 
-    // light records per froxel (~256 KiB)
+    // light records per froxel (~256 KiB max)
     mLightRecords = {
-            arena.allocate<LightRecord>(FROXEL_BUFFER_ENTRY_COUNT_MAX, CACHELINE_SIZE),
-            FROXEL_BUFFER_ENTRY_COUNT_MAX };
+            arena.allocate<LightRecord>(mFroxelCount, CACHELINE_SIZE),
+            mFroxelCount };
 
     // froxel thread data (~256 KiB)
     mFroxelShardedData = {
@@ -205,20 +289,48 @@ bool Froxelizer::prepare(
     return uniformsNeedUpdating;
 }
 
+size_t Froxelizer::getFroxelBufferEntryCount() const noexcept {
+    if (mLightBinning) {
+        return LIGHT_BIN_TILE_OFFSET + LIGHT_BIN_WORD_COUNT * mFroxelCountX * mFroxelCountY;
+    }
+    return mFroxelCount;
+}
+
+size_t Froxelizer::computeFroxelBudget(
+        Viewport const& viewport, size_t lightCount) const noexcept {
+    // froxels needed so they're not smaller than FROXEL_DIMENSION_MIN
+    const size_t viewportBudget = FEngine::CONFIG_FROXEL_SLICE_COUNT *
+            ((viewport.width  + FROXEL_DIMENSION_MIN - 1) / FROXEL_DIMENSION_MIN) *
+            ((viewport.height + FROXEL_DIMENSION_MIN - 1) / FROXEL_DIMENSION_MIN);
+
+    // froxels needed for the lights, with the light count rounded up to a power of two
+    size_t lightBudget = FROXEL_BUDGET_PER_LIGHT;
+    while (lightBudget < lightCount * FROXEL_BUDGET_PER_LIGHT && lightBudget < mMaxFroxelCount) {
+        lightBudget *= 2;
+    }
+
+    size_t budget = std::min({ viewportBudget, lightBudget, size_t(mMaxFroxelCount) });
+    return std::max(budget, FROXEL_BUFFER_ENTRY_COUNT_MIN);
+}
+
 void Froxelizer::computeFroxelLayout(
         uint2* dim, uint16_t* countX, uint16_t* countY, uint16_t* countZ,
-        Viewport const& viewport) noexcept {
+        Viewport const& viewport, size_t froxelBudget) noexcept {
+
+    assert(froxelBudget <= FROXEL_BUFFER_ENTRY_COUNT_MAX);
 
     if (SUPPORTS_NON_SQUARE_FROXELS == false) {
-        // calculate froxel dimension from FROXEL_BUFFER_ENTRY_COUNT_MAX and viewport
+        // calculate froxel dimension from the froxel budget and viewport
         // - Start from the maximum number of froxels we can use in the x-y plane
         size_t froxelSliceCount = FEngine::CONFIG_FROXEL_SLICE_COUNT;
-        size_t froxelPlaneCount = FROXEL_BUFFER_ENTRY_COUNT_MAX / froxelSliceCount;
+        size_t froxelPlaneCount = froxelBudget / froxelSliceCount;
         // - compute the number of square froxels we need in width and height, rounded down
         //   solving: |  froxelCountX * froxelCountY == froxelPlaneCount
         //            |  froxelCountX / froxelCountY == width / height
-        size_t froxelCountX = size_t(std::sqrt(froxelPlaneCount * viewport.width  / viewport.height));
-        size_t froxelCountY = size_t(std::sqrt(froxelPlaneCount * viewport.height / viewport.width));
+        size_t froxelCountX = std::max(size_t(1),
+                size_t(std::sqrt(froxelPlaneCount * viewport.width  / viewport.height)));
+        size_t froxelCountY = std::max(size_t(1),
+                size_t(std::sqrt(froxelPlaneCount * viewport.height / viewport.width)));
         // - copmute the froxels dimensions, rounded up
         size_t froxelSizeX = (viewport.width  + froxelCountX - 1) / froxelCountX;
         size_t froxelSizeY = (viewport.height + froxelCountY - 1) / froxelCountY;
@@ -255,7 +367,8 @@ bool Froxelizer::update() noexcept {
 
         uint2 froxelDimension;
         uint16_t froxelCountX, froxelCountY, froxelCountZ;
-        computeFroxelLayout(&froxelDimension, &froxelCountX, &froxelCountY, &froxelCountZ, viewport);
+        computeFroxelLayout(&froxelDimension, &froxelCountX, &froxelCountY, &froxelCountZ,
+                viewport, mFroxelBudget);
 
         mFroxelDimension = froxelDimension;
         mClipToFroxelX = (0.5f * viewport.width)  / froxelDimension.x;
@@ -270,7 +383,7 @@ bool Froxelizer::update() noexcept {
                << froxelDimension.x << "x" << froxelDimension.y << io::endl
                << "Froxel: " << froxelCountX << "x" << froxelCountY << "x" << froxelSliceCount
                << " = " << (froxelCountX * froxelCountY * froxelSliceCount)
-               << " (" << FROXEL_BUFFER_ENTRY_COUNT_MAX - froxelCountX * froxelCountY * froxelSliceCount << " lost)"
+               << " (" << mFroxelBudget - froxelCountX * froxelCountY * froxelSliceCount << " lost)"
                << io::endl;
 #endif
 
@@ -280,6 +393,9 @@ bool Froxelizer::update() noexcept {
         // froxel count must fit on 16 bits
         const uint16_t froxelCount = uint16_t(froxelCountX * froxelCountY * froxelCountZ);
         mFroxelCount = froxelCount;
+        mRecordBufferEntryCount = uint32_t(std::min(RECORD_BUFFER_ENTRY_COUNT,
+                (mFroxelBudget * RECORD_BUFFER_ENTRY_PER_FROXEL + RECORD_BUFFER_WIDTH_MASK) &
+                        ~RECORD_BUFFER_WIDTH_MASK));
 
         if (mDistancesZ) {
             // this is a LinearAllocator arena, use rewind() instead of free (which is a no op).
@@ -534,11 +650,57 @@ void Froxelizer::commit(driver::DriverApi& driverApi) {
 #endif
 }
 
+uint32_t Froxelizer::computeInputsHash(CameraInfo const& camera,
+        const FScene::LightSoa& lightData) noexcept {
+    // this must cover everything froxelizeLoop() uses, the projection and viewport are
+    // tracked by mDirtyFlags
+    struct {
+        float4 sphere;
+        float3 direction;
+        float cosSqr;
+        float invSin;
+    } key;
+    static_assert(sizeof(key) == 9 * sizeof(float), "key can't have padding, it would be hashed");
+
+    auto const* UTILS_RESTRICT spheres      = lightData.data<FScene::POSITION_RADIUS>();
+    auto const* UTILS_RESTRICT directions   = lightData.data<FScene::DIRECTION>();
+    auto const* UTILS_RESTRICT spotParams   = lightData.data<FScene::SPOT_PARAMS>();
+
+    uint32_t hash = utils::hash::murmur3(
+            reinterpret_cast<uint32_t const*>(&camera.view), sizeof(camera.view) / 4,
+            uint32_t(lightData.size()));
+    for (size_t i = FScene::DIRECTIONAL_LIGHTS_COUNT, c = lightData.size(); i < c; i++) {
+        key.sphere = spheres[i];
+        key.direction = directions[i];
+        key.cosSqr = spotParams[i].x;
+        key.invSin = spotParams[i].y;
+        hash = utils::hash::murmur3(reinterpret_cast<uint32_t const*>(&key), sizeof(key) / 4, hash);
+    }
+    return hash;
+}
+
 void Froxelizer::froxelizeLights(FEngine& engine,
         CameraInfo const& UTILS_RESTRICT camera,
         const FScene::LightSoa& UTILS_RESTRICT lightData) noexcept {
     // note: this is called asynchronously
+
+    // When nothing changed since the last frame, the GPU buffers are still valid, we skip
+    // the froxelization and, because nothing is invalidated, commit() doesn't upload anything.
+    const uint32_t hash = computeInputsHash(camera, lightData);
+    if (mInputsHashValid && mInputsHash == hash) {
+        mFroxelBufferUser.clear();
+        mRecordBufferUser.clear();
+        return;
+    }
+    mInputsHash = hash;
+    mInputsHashValid = true;
+
     froxelizeLoop(engine, camera, lightData);
+    froxelizeGatherRecords();
+    if (mLightBinning) {
+        froxelizeAssignBins();
+        return;
+    }
     froxelizeAssignRecordsCompress();
 
 #ifndef NDEBUG
@@ -570,16 +732,20 @@ void Froxelizer::froxelizeLoop(FEngine& engine,
         const FScene::LightSoa& UTILS_RESTRICT lightData) noexcept {
     SYSTRACE_CALL();
 
+    // only clear the entries of the froxels in use (and the light types)
     Slice<FroxelThreadData> froxelThreadData = mFroxelShardedData;
-    memset(froxelThreadData.data(), 0, froxelThreadData.sizeInBytes());
+    for (FroxelThreadData& threadData : froxelThreadData) {
+        memset(threadData.data(), 0, (mFroxelCount + 1) * sizeof(LightGroupType));
+    }
 
-    auto& lcm = engine.getLightManager();
+    // the spot parameters are read from the LightSoa rather than through the light instances,
+    // so that this loop streams through contiguous arrays
     auto const* UTILS_RESTRICT spheres      = lightData.data<FScene::POSITION_RADIUS>();
     auto const* UTILS_RESTRICT directions   = lightData.data<FScene::DIRECTION>();
-    auto const* UTILS_RESTRICT instances    = lightData.data<FScene::LIGHT_INSTANCE>();
+    auto const* UTILS_RESTRICT spotParams   = lightData.data<FScene::SPOT_PARAMS>();
 
     auto process = [ this, &froxelThreadData,
-                     spheres, directions, instances, &camera, &lcm ]
+                     spheres, directions, spotParams, &camera ]
             (size_t count, size_t offset, size_t stride) {
 
         const mat4f& projection = mProjection;
@@ -587,12 +753,11 @@ void Froxelizer::froxelizeLoop(FEngine& engine,
 
         for (size_t i = offset; i < count; i += stride) {
             const size_t j = i + FScene::DIRECTIONAL_LIGHTS_COUNT;
-            FLightManager::Instance li = instances[j];
             LightParams light = {
                     .position = (camera.view * float4{ spheres[j].xyz, 1 }).xyz, // to view-space
-                    .cosSqr = lcm.getCosOuterSquared(li),   // spot only
+                    .cosSqr = spotParams[j].x,              // spot only
                     .axis = vn * directions[j],             // spot only
-                    .invSin = lcm.getSinInverse(li),        // spot only
+                    .invSin = spotParams[j].y,              // spot only
                     .radius = spheres[j].w,
             };
 
@@ -625,31 +790,37 @@ void Froxelizer::froxelizeLoop(FEngine& engine,
     }
 }
 
-void Froxelizer::froxelizeAssignRecordsCompress() noexcept {
-
-    SYSTRACE_CALL();
+/*
+ * Invalidates the rows of 'buffer' which differ from their copy in 'gpu', and updates the copy.
+ * Only the first 'validRowCount' rows of the copy match what the GPU has, the others are
+ * always invalidated.
+ */
+template<typename T>
+static void invalidateChangedRows(GPUBuffer& buffer,
+        T const* UTILS_RESTRICT data, T* UTILS_RESTRICT gpu,
+        size_t rowSize, size_t rowCount, size_t validRowCount) noexcept {
+    const size_t rowSizeInBytes = rowSize * sizeof(T);
+    for (size_t row = 0; row < rowCount; row++) {
+        T const* const src = data + row * rowSize;
+        T* const dst = gpu + row * rowSize;
+        if (row >= validRowCount || memcmp(src, dst, rowSizeInBytes) != 0) {
+            memcpy(dst, src, rowSizeInBytes);
+            // adjacent rows are merged in a single range
+            buffer.invalidate(row, 1);
+        }
+    }
+}
 
+void Froxelizer::froxelizeGatherRecords() noexcept {
     Slice<FroxelThreadData> froxelThreadData = mFroxelShardedData;
 
     // convert froxel data from N groups of M bits to LightRecord::bitset, so we can
-    // easily compare adjacent froxels, for compaction. The conversion loops below get
+    // easily compare adjacent froxels, for compaction. The conversion loop below gets
     // inlined and vectorized in release builds.
 
-    // keep these two loops separate, it helps the compiler a lot
-    LightRecord::bitset spotLights;
-    for (size_t i = 0; i < LightRecord::bitset::WORLD_COUNT; i++) {
-        using container_type = LightRecord::bitset::container_type;
-        constexpr size_t r = sizeof(container_type) / sizeof(LightGroupType);
-        container_type b = froxelThreadData[i * r][0];
-        for (size_t k = 0; k < r; k++) {
-            b |= (container_type(froxelThreadData[i * r + k][0]) << (LIGHT_PER_GROUP * k));
-        }
-        spotLights.getBitsAt(i) = b;
-    }
-
     // this gets very well vectorized...
     utils::Slice<LightRecord> records(mLightRecords);
-    for (size_t j = 1, jc = FROXEL_BUFFER_ENTRY_COUNT_MAX; j < jc; j++) {
+    for (size_t j = 1, jc = mFroxelCount + 1; j < jc; j++) {
         for (size_t i = 0; i < LightRecord::bitset::WORLD_COUNT; i++) {
             using container_type = LightRecord::bitset::container_type;
             constexpr size_t r = sizeof(container_type) / sizeof(LightGroupType);
@@ -660,6 +831,35 @@ void Froxelizer::froxelizeAssignRecordsCompress() noexcept {
             records[j - 1].lights.getBitsAt(i) = b;
         }
     }
+}
+
+// the index of the light of bit l of a LightRecord::bitset, the lights are interleaved in the
+// groups, see froxelizeLoop()
+static inline size_t getLightIndex(size_t l) noexcept {
+    const size_t word = l / LIGHT_PER_GROUP;
+    const size_t bit  = l % LIGHT_PER_GROUP;
+    return (bit * GROUP_COUNT) | (word % GROUP_COUNT);
+}
+
+void Froxelizer::froxelizeAssignRecordsCompress() noexcept {
+
+    SYSTRACE_CALL();
+
+    Slice<FroxelThreadData> froxelThreadData = mFroxelShardedData;
+
+    // the light types, converted like the records in froxelizeGatherRecords()
+    LightRecord::bitset spotLights;
+    for (size_t i = 0; i < LightRecord::bitset::WORLD_COUNT; i++) {
+        using container_type = LightRecord::bitset::container_type;
+        constexpr size_t r = sizeof(container_type) / sizeof(LightGroupType);
+        container_type b = froxelThreadData[i * r][0];
+        for (size_t k = 0; k < r; k++) {
+            b |= (container_type(froxelThreadData[i * r + k][0]) << (LIGHT_PER_GROUP * k));
+        }
+        spotLights.getBitsAt(i) = b;
+    }
+
+    utils::Slice<LightRecord> records(mLightRecords);
 
     uint16_t offset = 0;
     FroxelEntry* const UTILS_RESTRICT froxels = mFroxelBufferUser.data();
@@ -693,7 +893,7 @@ void Froxelizer::froxelizeAssignRecordsCompress() noexcept {
         };
         const size_t lightCount = entry.count[0] + entry.count[1];
 
-        if (UTILS_UNLIKELY(offset + lightCount >= RECORD_BUFFER_ENTRY_COUNT)) {
+        if (UTILS_UNLIKELY(offset + lightCount >= mRecordBufferUser.size())) {
 #ifndef NDEBUG
             slog.d << "out of space: " << i << ", at " << offset << io::endl;
 #endif
@@ -717,11 +917,7 @@ void Froxelizer::froxelizeAssignRecordsCompress() noexcept {
             auto& p = isSpot ? spot      : point;
             auto  s = isSpot ? beginSpot : beginPoint;
 
-            const size_t word = l / LIGHT_PER_GROUP;
-            const size_t bit  = l % LIGHT_PER_GROUP;
-            l = (bit * GROUP_COUNT) | (word % GROUP_COUNT);
-
-            *p = (RecordBufferType)l;
+            *p = (RecordBufferType)getLightIndex(l);
             // we need to "cancel" the write if we have more than 255 spot or point lights
             // (this is a limitation of the data type used to store the light counts per froxel)
             p += (p - s < 255) ? 1 : 0;
@@ -750,11 +946,78 @@ void Froxelizer::froxelizeAssignRecordsCompress() noexcept {
     }
 out_of_memory:
 
-    // froxel buffer is always fully invalidated
-    mFroxelBuffer.invalidate();
+    // clear the end of the last row of the froxel buffer
+    memset(froxels + getFroxelCount(), 0,
+            (mFroxelBufferUser.size() - getFroxelCount()) * sizeof(FroxelEntry));
+
+    // only invalidate the rows which changed since they were last sent
+    const size_t froxelRowCount = mFroxelBufferUser.size() >> FROXEL_BUFFER_WIDTH_SHIFT;
+    invalidateChangedRows(mFroxelBuffer, mFroxelBufferUser.data(), mFroxelBufferGpu,
+            FROXEL_BUFFER_WIDTH, froxelRowCount, mFroxelBufferGpuRowCount);
+    mFroxelBufferGpuRowCount = std::max(mFroxelBufferGpuRowCount, uint32_t(froxelRowCount));
 
     // needed record buffer size may change at each frame
-    mRecordsBuffer.invalidate(0, (offset + RECORD_BUFFER_WIDTH_MASK) >> RECORD_BUFFER_WIDTH_SHIFT);
+    const size_t recordRowCount = (offset + RECORD_BUFFER_WIDTH_MASK) >> RECORD_BUFFER_WIDTH_SHIFT;
+    invalidateChangedRows(mRecordsBuffer, mRecordBufferUser.data(), mRecordBufferGpu,
+            RECORD_BUFFER_WIDTH, recordRowCount, mRecordBufferGpuRowCount);
+    mRecordBufferGpuRowCount = std::max(mRecordBufferGpuRowCount, uint32_t(recordRowCount));
+}
+
+/*
+ * Light binning: instead of a list of lights per froxel, the lights are assigned separately to
+ * the tiles of the screen (all the froxels at the same x, y) with a bitmask, and to the slices
+ * (all the froxels at the same z) with the range of their indices. A pixel evaluates the lights
+ * of its tile within the range of its slice. The lights are sorted by distance to the camera,
+ * so that the ranges are short. This is built from the same froxelization, without the
+ * compaction of froxelizeAssignRecordsCompress() and without the record buffer.
+ */
+void Froxelizer::froxelizeAssignBins() noexcept {
+    SYSTRACE_CALL();
+
+    Slice<LightRecord> records(mLightRecords);
+    FroxelEntry* const UTILS_RESTRICT froxels = mFroxelBufferUser.data();
+    const size_t tileCount = size_t(mFroxelCountX) * mFroxelCountY;
+    const size_t sliceCount = mFroxelCountZ;
+
+    LightRecord::bitset slices[FEngine::CONFIG_FROXEL_SLICE_COUNT];
+    for (size_t t = 0; t < tileCount; t++) {
+        LightRecord::bitset tile;
+        for (size_t z = 0; z < sliceCount; z++) {
+            LightRecord::bitset const& lights = records[t + z * tileCount].lights;
+            tile |= lights;
+            slices[z] |= lights;
+        }
+        uint32_t mask[LIGHT_BIN_WORD_COUNT] = {};
+        tile.forEachSetBit([&mask](size_t l) {
+            const size_t i = getLightIndex(l);
+            mask[i / 32] |= 1u << (i % 32);
+        });
+        static_assert(sizeof(FroxelEntry) == sizeof(uint32_t), "a bitmask word per entry");
+        memcpy(froxels + LIGHT_BIN_TILE_OFFSET + t * LIGHT_BIN_WORD_COUNT, mask, sizeof(mask));
+    }
+
+    for (size_t z = 0; z < sliceCount; z++) {
+        // the slice's lights are in [first, end)
+        uint32_t first = CONFIG_MAX_LIGHT_COUNT;
+        uint32_t end = 0;
+        slices[z].forEachSetBit([&first, &end](size_t l) {
+            const uint32_t i = uint32_t(getLightIndex(l));
+            first = std::min(first, i);
+            end = std::max(end, i + 1);
+        });
+        froxels[z].u32 = first < end ? (first | (end << 16u)) : 0;
+    }
+    memset(froxels + sliceCount, 0, (LIGHT_BIN_TILE_OFFSET - sliceCount) * sizeof(FroxelEntry));
+
+    // clear the end of the last row of the froxel buffer
+    const size_t used = LIGHT_BIN_TILE_OFFSET + tileCount * LIGHT_BIN_WORD_COUNT;
+    memset(froxels + used, 0, (mFroxelBufferUser.size() - used) * sizeof(FroxelEntry));
+
+    // only invalidate the rows which changed since they were last sent
+    const size_t froxelRowCount = mFroxelBufferUser.size() >> FROXEL_BUFFER_WIDTH_SHIFT;
+    invalidateChangedRows(mFroxelBuffer, mFroxelBufferUser.data(), mFroxelBufferGpu,
+            FROXEL_BUFFER_WIDTH, froxelRowCount, mFroxelBufferGpuRowCount);
+    mFroxelBufferGpuRowCount = std::max(mFroxelBufferGpuRowCount, uint32_t(froxelRowCount));
 }
 
 static inline float2 project(mat4f const& p, float3 const& v) noexcept {
@@ -779,6 +1042,23 @@ static inline float2 project(mat4f const& p, float3 const& v) noexcept {
     return float2{ x, y } * (1 / w);
 }
 
+/*
+ * Returns how many of the vertical planes in [begin, end) the circle 'cy' doesn't intersect.
+ * These planes are all on the same side of the circle's center and sorted, so that once a plane
+ * intersects the circle, all the following ones do. This is therefore the index (from begin)
+ * of the first intersecting plane, but unlike a search, this loop has no early exit and is
+ * vectorized: 4 (NEON, SSE) or 8 (AVX) planes are tested per iteration.
+ */
+static inline size_t countPlanesOutside(float4 const& UTILS_RESTRICT cy,
+        float4 const* UTILS_RESTRICT planesX, size_t begin, size_t end) noexcept {
+    uint32_t count = 0;
+    #pragma clang loop vectorize_width(8)
+    for (size_t i = begin; i < end; i++) {
+        count += uint32_t(spherePlaneDistanceSquared(cy, planesX[i].x, planesX[i].z) <= 0);
+    }
+    return count;
+}
+
 void Froxelizer::froxelizePointAndSpotLight(
         FroxelThreadData& froxelThread, size_t bit,
         mat4f const& UTILS_RESTRICT p,
@@ -860,23 +1140,12 @@ void Froxelizer::froxelizePointAndSpotLight(
                     cy = spherePlaneIntersection(cz, plane.y, plane.z);
                 }
                 if (cy.w > 0) { // intersection of light with this horizontal plane
-                    size_t bx, ex; // horizontal begin/end indices
-                    // find the begin index (left side)
-                    for (bx = x0; bx <= xcenter; ++bx) {
-                        if (spherePlaneDistanceSquared(cy, planesX[bx].x, planesX[bx].z) > 0) {
-                            // intersection
-                            break;
-                        }
-                    }
-
-                    // find the end index (right side), x1 is past the end
-                    for (ex = x1; --ex > xcenter;) {
-                        if (spherePlaneDistanceSquared(cy, planesX[ex].x, planesX[ex].z) > 0) {
-                            // intersection
-                            break;
-                        }
-                    }
-                    ++ex;
+                    // horizontal begin/end indices: the first intersecting plane on the
+                    // left side, and one past the last intersecting plane on the right side
+                    // (x1 is past the end)
+                    const size_t xsplit = std::min(std::max(xcenter + 1, x0), x1);
+                    size_t bx = x0 + countPlanesOutside(cy, planesX, x0, xsplit);
+                    size_t ex = x1 - countPlanesOutside(cy, planesX, xsplit, x1);
 
                     if (UTILS_UNLIKELY(bx >= ex)) {
                         continue;
@@ -885,20 +1154,24 @@ void Froxelizer::froxelizePointAndSpotLight(
                     assert(bx < mFroxelCountX && ex <= mFroxelCountX);
 
                     // The first entry reserved for type of light, i.e. point/spot
-                    size_t fi = getFroxelIndex(bx, iy, iz) + 1;
+                    const size_t fi = getFroxelIndex(bx, iy, iz);
+                    const size_t count = ex - bx;
+                    LightGroupType* const UTILS_RESTRICT froxels = froxelThread.data() + fi + 1;
                     if (light.invSin != std::numeric_limits<float>::infinity()) {
                         // This is a spotlight (common case)
-                        // this loops gets vectorized (on arm64) w/ clang
-                        while (bx++ != ex) {
+                        // test 4 (NEON, SSE) or 8 (AVX) froxels of the row at once
+                        float4 const* const UTILS_RESTRICT spheres = boundingSpheres + fi;
+                        #pragma clang loop vectorize_width(8)
+                        for (size_t i = 0; i < count; i++) {
                             // see if this froxel intersects the cone
-                            bool intersect = sphereConeIntersectionFast(boundingSpheres[fi - 1],
+                            bool intersect = sphereConeIntersectionFast(spheres[i],
                                     light.position, light.axis, light.invSin, light.cosSqr);
-                            froxelThread[fi++] |= LightGroupType(intersect) << bit;
+                            froxels[i] |= LightGroupType(intersect) << bit;
                         }
                     } else {
-                        // this loops gets vectorized (on arm64) w/ clang
-                        while (bx++ != ex) {
-                            froxelThread[fi++] |= LightGroupType(1) << bit;
+                        #pragma clang loop vectorize_width(8)
+                        for (size_t i = 0; i < count; i++) {
+                            froxels[i] |= LightGroupType(1) << bit;
                         }
                     }
                 }
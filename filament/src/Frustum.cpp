@@ -62,6 +62,19 @@ void Frustum::setProjection(const mat4f& pv) {
     mPlanes[5] = n;
 }
 
+void Frustum::setEnclosing(Frustum const& a, float3 aPosition,
+        Frustum const& b, float3 bPosition) noexcept {
+    for (size_t i = 0; i < 6; i++) {
+        // signed distance to the plane, negative inside
+        const float4 pa = a.mPlanes[i];
+        const float4 pb = b.mPlanes[i];
+        const float da = dot(pa.xyz, bPosition) + pa.w;
+        const float db = dot(pb.xyz, aPosition) + pb.w;
+        // parallel planes (e.g. the near and far planes of parallel eyes) are equivalent
+        mPlanes[i] = da <= db ? pa : pb;
+    }
+}
+
 float4 Frustum::getNormalizedPlane(Frustum::Plane plane) const noexcept {
     return mPlanes[size_t(plane)];
 }
@@ -51,8 +51,7 @@ void GpuLightBuffer::commit(FEngine& engine) noexcept {
 
 void GpuLightBuffer::commitSlow(FEngine& engine) noexcept {
     DriverApi& driverApi = engine.getDriverApi();
-    driverApi.updateUniformBuffer(mLightUbh, UniformBuffer(mLightsUb));
-    mLightsUb.clean();
+    driverApi.commitUniforms(mLightUbh, mLightsUb);
 }
 
 } // namespace details
@@ -0,0 +1,503 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "details/IBLPrefilter.h"
+
+#include "details/Engine.h"
+#include "details/Texture.h"
+
+#include "FilamentAPI-impl.h"
+
+#include <filament/EngineEnums.h>
+
+#include <utils/Panic.h>
+#include <utils/Systrace.h>
+
+#include <math/scalar.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include <math.h>
+#include <stdlib.h>
+
+using namespace math;
+
+namespace filament {
+
+using namespace details;
+using namespace driver;
+
+struct IBLPrefilter::BuilderDetails {
+    uint32_t mSize = 0;
+    float3 const* mFaces = nullptr;
+    Texture* mReflections = nullptr;
+    uint32_t mSamples = 64;
+    uint32_t mBudget = 2000;
+};
+
+using BuilderType = IBLPrefilter;
+BuilderType::Builder::Builder() noexcept = default;
+BuilderType::Builder::~Builder() noexcept = default;
+BuilderType::Builder::Builder(BuilderType::Builder const& rhs) noexcept = default;
+BuilderType::Builder::Builder(BuilderType::Builder&& rhs) noexcept = default;
+BuilderType::Builder& BuilderType::Builder::operator=(BuilderType::Builder const& rhs) noexcept = default;
+BuilderType::Builder& BuilderType::Builder::operator=(BuilderType::Builder&& rhs) noexcept = default;
+
+IBLPrefilter::Builder& IBLPrefilter::Builder::environment(
+        uint32_t size, float3 const* faces) noexcept {
+    mImpl->mSize = size;
+    mImpl->mFaces = faces;
+    return *this;
+}
+
+IBLPrefilter::Builder& IBLPrefilter::Builder::reflections(Texture* cubemap) noexcept {
+    mImpl->mReflections = cubemap;
+    return *this;
+}
+
+IBLPrefilter::Builder& IBLPrefilter::Builder::samples(uint32_t count) noexcept {
+    mImpl->mSamples = std::max(1u, count);
+    return *this;
+}
+
+IBLPrefilter::Builder& IBLPrefilter::Builder::budget(uint32_t microseconds) noexcept {
+    mImpl->mBudget = microseconds;
+    return *this;
+}
+
+IBLPrefilter* IBLPrefilter::Builder::build(Engine& engine) {
+    if (!ASSERT_PRECONDITION_NON_FATAL(mImpl->mFaces && mImpl->mSize &&
+            !(mImpl->mSize & (mImpl->mSize - 1)),
+            "environment must be set, with a power of two size")) {
+        return nullptr;
+    }
+
+    FTexture const* reflections = upcast(mImpl->mReflections);
+    if (!ASSERT_PRECONDITION_NON_FATAL(reflections && reflections->isCubemap() &&
+            reflections->getFormat() == Texture::InternalFormat::RGBM &&
+            reflections->getWidth() == CONFIG_IBL_SIZE && reflections->getLevels() == 9,
+            "reflections must be a 256x256 RGBM cubemap with 9 mipmap levels")) {
+        return nullptr;
+    }
+
+    return upcast(engine).createIBLPrefilter(*this);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+namespace details {
+
+// We use the faces in the order of TextureCubemapFace (+x, -x, +y, -y, +z, -z), with the same
+// orientation as cmgen.
+
+static float3 getDirectionFor(size_t face, float cx, float cy) noexcept {
+    float3 dir;
+    switch (face) {
+        case 0:  dir = {   1, cy, -cx }; break;
+        case 1:  dir = {  -1, cy,  cx }; break;
+        case 2:  dir = {  cx,  1, -cy }; break;
+        case 3:  dir = {  cx, -1,  cy }; break;
+        case 4:  dir = {  cx, cy,   1 }; break;
+        default: dir = { -cx, cy,  -1 }; break;
+    }
+    return normalize(dir);
+}
+
+// returns the face and the texture coordinates in [0, 1] for a direction
+static size_t getAddressFor(float3 const& r, float2& st) noexcept {
+    size_t face;
+    float sc, tc, ma;
+    const float rx = std::abs(r.x);
+    const float ry = std::abs(r.y);
+    const float rz = std::abs(r.z);
+    if (rx >= ry && rx >= rz) {
+        ma = rx;
+        face = r.x >= 0 ? 0 : 1;
+        sc = r.x >= 0 ? -r.z : r.z;
+        tc = -r.y;
+    } else if (ry >= rx && ry >= rz) {
+        ma = ry;
+        face = r.y >= 0 ? 2 : 3;
+        sc = r.x;
+        tc = r.y >= 0 ? r.z : -r.z;
+    } else {
+        ma = rz;
+        face = r.z >= 0 ? 4 : 5;
+        sc = r.z >= 0 ? r.x : -r.x;
+        tc = -r.y;
+    }
+    st = float2{ sc / ma + 1, tc / ma + 1 } * 0.5f;
+    return face;
+}
+
+static double sphereQuadrantArea(double x, double y) noexcept {
+    return std::atan2(x * y, std::sqrt(x * x + y * y + 1));
+}
+
+static double solidAngle(uint32_t size, uint32_t u, uint32_t v) noexcept {
+    const double iSize = 1.0 / size;
+    const double s = ((u + 0.5) * 2 * iSize) - 1;
+    const double t = ((v + 0.5) * 2 * iSize) - 1;
+    const double x0 = s - iSize;
+    const double y0 = t - iSize;
+    const double x1 = s + iSize;
+    const double y1 = t + iSize;
+    return sphereQuadrantArea(x0, y0) - sphereQuadrantArea(x0, y1) -
+           sphereQuadrantArea(x1, y0) + sphereQuadrantArea(x1, y1);
+}
+
+static float2 hammersley(uint32_t i, float iN) noexcept {
+    constexpr float tof = 0.5f / 0x80000000U;
+    uint32_t bits = i;
+    bits = (bits << 16u) | (bits >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    return { i * iN, bits * tof };
+}
+
+static float3 hemisphereImportanceSampleDggx(float2 u, float a) noexcept {
+    const float phi = 2.0f * float(M_PI) * u.x;
+    // NOTE: (aa-1) == (a-1)(a+1) produces better fp accuracy
+    const float cosTheta2 = (1 - u.y) / (1 + (a + 1) * ((a - 1) * u.y));
+    const float cosTheta = std::sqrt(cosTheta2);
+    const float sinTheta = std::sqrt(1 - cosTheta2);
+    return { sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta };
+}
+
+static float distributionGGX(float NoH, float a) noexcept {
+    // NOTE: (aa-1) == (a-1)(a+1) produces better fp accuracy
+    const float f = (a - 1) * ((a + 1) * (NoH * NoH)) + 1;
+    return (a * a) / (float(M_PI) * f * f);
+}
+
+static float visibility(float NoV, float NoL, float a) noexcept {
+    // Heitz 2014, "Understanding the Masking-Shadowing Function in Microfacet-Based BRDFs"
+    // Height-correlated GGX
+    const float a2 = a * a;
+    const float GGXL = NoV * std::sqrt((NoL - NoL * a2) * NoL + a2);
+    const float GGXV = NoL * std::sqrt((NoV - NoV * a2) * NoV + a2);
+    return 0.5f / (GGXV + GGXL);
+}
+
+static float log4(float x) noexcept {
+    return std::log2(x) * 0.5f;
+}
+
+// see linearToRGBM() in libs/image, and decodeRGBM() in the shaders
+static void encodeRGBM(float3 linear, uint8_t* out) noexcept {
+    float3 c = sqrt(linear) / 16.0f;
+    float m = std::max(std::max(c.r, c.g), std::max(c.b, 1e-6f));
+    m = std::ceil(clamp(m, 1.0f / 16.0f, 1.0f) * 255.0f) / 255.0f;
+    c = saturate(c / m);
+    out[0] = uint8_t(c.r * 255.0f + 0.5f);
+    out[1] = uint8_t(c.g * 255.0f + 0.5f);
+    out[2] = uint8_t(c.b * 255.0f + 0.5f);
+    out[3] = uint8_t(m * 255.0f + 0.5f);
+}
+
+FIBLPrefilter::FIBLPrefilter(FEngine& engine, const Builder& builder) noexcept
+        : mReflections(upcast(builder->mReflections)),
+          mSampleCount(builder->mSamples),
+          mBudget(builder->mBudget) {
+    // the environment is copied here, its mipmaps are computed later
+    const uint32_t size = builder->mSize;
+    mEnvironment.reserve(size_t(log2f(size)) + 1);
+    mEnvironment.emplace_back();
+    Cubemap& base = mEnvironment.back();
+    base.size = size;
+    base.texels.assign(builder->mFaces, builder->mFaces + size_t(size) * size * 6);
+}
+
+void FIBLPrefilter::terminate(FEngine& engine) noexcept {
+}
+
+void FIBLPrefilter::execute(FEngine& engine) noexcept {
+    if (isReady()) {
+        return;
+    }
+
+    SYSTRACE_CALL();
+
+    using clock = std::chrono::steady_clock;
+    const clock::time_point deadline = clock::now() + std::chrono::microseconds(mBudget);
+    do {
+        runItem(engine);
+    } while (!isReady() && clock::now() < deadline);
+}
+
+void FIBLPrefilter::runItem(FEngine& engine) noexcept {
+    switch (mStage) {
+        case Stage::IRRADIANCE: {
+            const uint32_t size = mEnvironment[0].size;
+            accumulateIrradiance(mItem / size, mItem % size);
+            if (++mItem == size * 6) {
+                finishIrradiance();
+                mStage = Stage::MIPMAPS;
+                mItem = 0;
+            }
+            break;
+        }
+        case Stage::MIPMAPS: {
+            if (mEnvironment.back().size > 1) {
+                downsample(mEnvironment.size());
+            } else {
+                mStage = Stage::REFLECTIONS;
+            }
+            break;
+        }
+        case Stage::REFLECTIONS: {
+            const uint32_t size = uint32_t(CONFIG_IBL_SIZE) >> mLevelIndex;
+            if (mItem == 0) {
+                prepareSamples(mLevelIndex);
+            }
+            filterRow(mItem / size, mItem % size);
+            if (++mItem == size * 6) {
+                uploadLevel(engine, mLevelIndex);
+                mItem = 0;
+                if (++mLevelIndex == mReflections->getLevels()) {
+                    // we don't need any of this anymore
+                    mEnvironment = {};
+                    mLevel = {};
+                    mSamples = {};
+                    mStage = Stage::DONE;
+                }
+            }
+            break;
+        }
+        case Stage::DONE:
+            break;
+    }
+}
+
+void FIBLPrefilter::accumulateIrradiance(size_t face, uint32_t y) noexcept {
+    // see CubemapSH::computeIrradianceSH3Bands() in cmgen
+    Cubemap const& cm = mEnvironment[0];
+    const uint32_t size = cm.size;
+    const float scale = 2.0f / size;
+    float3 const* row = cm.getFace(face) + size_t(y) * size;
+    for (uint32_t x = 0; x < size; x++) {
+        const float3 s = getDirectionFor(face, (x + 0.5f) * scale - 1, 1 - (y + 0.5f) * scale);
+        const double3 color = double3(row[x]) * solidAngle(size, x, y);
+        mSH[0] += color;
+        mSH[1] += color * s.y;
+        mSH[2] += color * s.z;
+        mSH[3] += color * s.x;
+        mSH[4] += color * (s.y * s.x);
+        mSH[5] += color * (s.y * s.z);
+        mSH[6] += color * (3 * s.z * s.z - 1);
+        mSH[7] += color * (s.z * s.x);
+        mSH[8] += color * (s.x * s.x - s.y * s.y);
+    }
+}
+
+void FIBLPrefilter::finishIrradiance() noexcept {
+    // the bases, pre-scaled by the reconstruction factors and convolved by < n.l >
+    constexpr double K = 0.25 * M_2_SQRTPI;
+    constexpr double c0 = M_PI;
+    constexpr double c1 = 2.0 * M_PI / 3.0;
+    constexpr double c2 = M_PI / 4.0;
+    const double A[9] = {
+            (K * K)             * c0,
+            (K * K) * 3         * c1,
+            (K * K) * 3         * c1,
+            (K * K) * 3         * c1,
+            (K * K) * 15        * c2,
+            (K * K) * 15        * c2,
+            (K * K) * 5 / 4     * c2,
+            (K * K) * 15        * c2,
+            (K * K) * 15 / 4    * c2,
+    };
+    for (size_t i = 0; i < 9; i++) {
+        mIrradiance[i] = float3(mSH[i] * A[i]);
+    }
+}
+
+void FIBLPrefilter::downsample(size_t level) noexcept {
+    // a simple box filter
+    Cubemap const& src = mEnvironment[level - 1];
+    Cubemap dst;
+    dst.size = src.size / 2;
+    dst.texels.resize(size_t(dst.size) * dst.size * 6);
+    for (size_t face = 0; face < 6; face++) {
+        float3 const* in = src.getFace(face);
+        float3* out = dst.getFace(face);
+        for (uint32_t y = 0; y < dst.size; y++) {
+            float3 const* row0 = in + size_t(2 * y) * src.size;
+            float3 const* row1 = row0 + src.size;
+            for (uint32_t x = 0; x < dst.size; x++) {
+                *out++ = (row0[2 * x] + row0[2 * x + 1] + row1[2 * x] + row1[2 * x + 1]) * 0.25f;
+            }
+        }
+    }
+    mEnvironment.push_back(std::move(dst));
+}
+
+void FIBLPrefilter::prepareSamples(size_t level) noexcept {
+    // see CubemapIBL::roughnessFilter() in cmgen
+    const size_t levelCount = mReflections->getLevels();
+    const float roughness = float(level) / (levelCount - 1);
+    const float linearRoughness = roughness * roughness;
+    const uint32_t size = uint32_t(CONFIG_IBL_SIZE) >> level;
+
+    mLevel.size = size;
+    mLevel.texels.resize(size_t(size) * size * 6);
+    mSamples.clear();
+
+    if (level == 0) {
+        // no filtering, we just resample the environment
+        return;
+    }
+
+    // the wider the filter, the more samples, like cmgen
+    const uint32_t count = mSampleCount << (level - 1);
+    const float iCount = 1.0f / count;
+    const uint32_t size0 = mEnvironment[0].size;
+    const float omegaP = float((4 * M_PI) / (6.0 * size0 * size0));
+    const float maxLod = float(mEnvironment.size() - 1);
+    float weight = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const float3 H = hemisphereImportanceSampleDggx(hammersley(i, iCount), linearRoughness);
+        const float NoH = H.z;
+        const float NoL = 2 * NoH * NoH - 1;
+        if (NoL > 0) {
+            const float3 L(2 * NoH * H.x, 2 * NoH * H.y, NoL);
+            const float LoH = dot(L, H);
+
+            // pre-filtered importance sampling, with a LOD bias of log4(4)
+            const float pdf = distributionGGX(NoH, linearRoughness) / 4;
+            const float omegaS = 1 / (count * pdf);
+            const float lod = clamp(log4(omegaS) - log4(omegaP) + 1.0f, 0.0f, maxLod);
+
+            const float Fc = std::pow(1 - LoH, 5.0f);
+            const float brdf_NoL = (1 - Fc) * visibility(1, NoL, linearRoughness) * NoL;
+            weight += brdf_NoL;
+            mSamples.push_back({ L, brdf_NoL, lod });
+        }
+    }
+    for (Sample& s : mSamples) {
+        s.weight /= weight;
+    }
+}
+
+float3 FIBLPrefilter::sample(float3 const& direction, float lod) const noexcept {
+    float2 st;
+    const size_t face = getAddressFor(direction, st);
+
+    auto bilinear = [face, st](Cubemap const& cm) -> float3 {
+        // the filtering doesn't cross the edges of the face
+        const float max = cm.size - 1;
+        const float x = clamp(st.x * cm.size - 0.5f, 0.0f, max);
+        const float y = clamp(st.y * cm.size - 0.5f, 0.0f, max);
+        const uint32_t x0 = uint32_t(x);
+        const uint32_t y0 = uint32_t(y);
+        const uint32_t x1 = std::min(x0 + 1, cm.size - 1);
+        const uint32_t y1 = std::min(y0 + 1, cm.size - 1);
+        const float u = x - x0;
+        const float v = y - y0;
+        float3 const* texels = cm.getFace(face);
+        float3 const* row0 = texels + size_t(y0) * cm.size;
+        float3 const* row1 = texels + size_t(y1) * cm.size;
+        const float3 c0 = row0[x0] + (row0[x1] - row0[x0]) * u;
+        const float3 c1 = row1[x0] + (row1[x1] - row1[x0]) * u;
+        return c0 + (c1 - c0) * v;
+    };
+
+    const size_t l0 = size_t(lod);
+    const size_t l1 = std::min(l0 + 1, mEnvironment.size() - 1);
+    const float3 c0 = bilinear(mEnvironment[l0]);
+    if (l0 == l1) {
+        return c0;
+    }
+    return c0 + (bilinear(mEnvironment[l1]) - c0) * (lod - l0);
+}
+
+void FIBLPrefilter::filterRow(size_t face, uint32_t y) noexcept {
+    const uint32_t size = mLevel.size;
+    const float scale = 2.0f / size;
+    float3* out = mLevel.getFace(face) + size_t(y) * size;
+
+    if (mSamples.empty()) {
+        // pick the mipmap of the environment closest to our resolution
+        const float lod = std::max(0.0f, std::log2(float(mEnvironment[0].size) / size));
+        for (uint32_t x = 0; x < size; x++) {
+            const float3 N = getDirectionFor(face, (x + 0.5f) * scale - 1, 1 - (y + 0.5f) * scale);
+            out[x] = sample(N, std::min(lod, float(mEnvironment.size() - 1)));
+        }
+        return;
+    }
+
+    for (uint32_t x = 0; x < size; x++) {
+        const float3 N = getDirectionFor(face, (x + 0.5f) * scale - 1, 1 - (y + 0.5f) * scale);
+
+        // center the cone around the normal (handle case of normal close to up)
+        const float3 up = std::abs(N.z) < 0.999f ? float3{ 0, 0, 1 } : float3{ 1, 0, 0 };
+        const float3 T = normalize(cross(up, N));
+        const float3 B = cross(N, T);
+
+        float3 Li = 0;
+        for (Sample const& s : mSamples) {
+            const float3 L = T * s.L.x + B * s.L.y + N * s.L.z;
+            Li += sample(L, s.lod) * s.weight;
+        }
+        out[x] = Li;
+    }
+}
+
+void FIBLPrefilter::uploadLevel(FEngine& engine, size_t level) noexcept {
+    const size_t count = mLevel.texels.size();
+    const size_t size = count * 4;
+    uint8_t* const rgbm = static_cast<uint8_t*>(malloc(size));
+    for (size_t i = 0; i < count; i++) {
+        encodeRGBM(mLevel.texels[i], rgbm + i * 4);
+    }
+
+    const size_t faceSize = size / 6;
+    FaceOffsets offsets;
+    for (size_t face = 0; face < 6; face++) {
+        offsets[face] = face * faceSize;
+    }
+
+    mReflections->setImage(engine, level,
+            PixelBufferDescriptor(rgbm, size, PixelDataFormat::RGBM, PixelDataType::UBYTE,
+                    [](void* buffer, size_t, void*) { free(buffer); }),
+            offsets);
+}
+
+void FIBLPrefilter::getIrradiance(float3* sh) const noexcept {
+    assert(isReady());
+    std::copy(mIrradiance.begin(), mIrradiance.end(), sh);
+}
+
+} // namespace details
+
+// ------------------------------------------------------------------------------------------------
+// Trampoline calling into private implementation
+// ------------------------------------------------------------------------------------------------
+
+using namespace details;
+
+bool IBLPrefilter::isReady() const noexcept {
+    return upcast(this)->isReady();
+}
+
+void IBLPrefilter::getIrradiance(float3* sh) const noexcept {
+    upcast(this)->getIrradiance(sh);
+}
+
+} // namespace filament
@@ -27,6 +27,7 @@ using namespace details;
 struct IndexBuffer::BuilderDetails {
     uint32_t mIndexCount = 0;
     IndexType mIndexType = IndexType::UINT;
+    Usage mUsage = Usage::STATIC;
 };
 
 using BuilderType = IndexBuffer;
@@ -47,6 +48,11 @@ IndexBuffer::Builder& IndexBuffer::Builder::bufferType(IndexType indexType) noex
     return *this;
 }
 
+IndexBuffer::Builder& IndexBuffer::Builder::usage(Usage usage) noexcept {
+    mImpl->mUsage = usage;
+    return *this;
+}
+
 IndexBuffer* IndexBuffer::Builder::build(Engine& engine) {
     return upcast(engine).createIndexBuffer(*this);
 }
@@ -56,11 +62,13 @@ IndexBuffer* IndexBuffer::Builder::build(Engine& engine) {
 namespace details {
 
 FIndexBuffer::FIndexBuffer(FEngine& engine, const IndexBuffer::Builder& builder)
-        : mIndexCount(builder->mIndexCount) {
+        : mIndexCount(builder->mIndexCount),
+          mIndexSize(uint8_t(builder->mIndexType == IndexType::UINT ? 4 : 2)) {
     FEngine::DriverApi& driver = engine.getDriverApi();
     mHandle = driver.createIndexBuffer(
             (driver::ElementType)builder->mIndexType,
-            uint32_t(builder->mIndexCount));
+            uint32_t(builder->mIndexCount),
+            builder->mUsage);
 }
 
 void FIndexBuffer::terminate(FEngine& engine) {
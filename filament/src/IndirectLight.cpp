@@ -23,6 +23,8 @@
 
 #include <utils/Panic.h>
 
+#include <math.h>
+
 
 using namespace math;
 
@@ -112,13 +114,16 @@ namespace details {
 FIndirectLight::FIndirectLight(FEngine& engine, const Builder& builder) noexcept {
 
     if (builder->mReflectionsMap) {
-        mReflectionsMapHandle = upcast(builder->mReflectionsMap)->getHwHandle();
+        FTexture const* reflections = upcast(builder->mReflectionsMap);
+        mReflectionsMapHandle = reflections->getHwHandle();
+        mReflectionsRGBM = reflections->getFormat() == Texture::InternalFormat::RGBM;
     }
 
     std::copy(
             std::begin(builder->mIrradianceCoefs),
             std::end(builder->mIrradianceCoefs),
             mIrradianceCoefs.begin());
+    setRotation(builder->mRotation);
 
     mIntensity = builder->mIntensity;
     if (builder->mIrradianceMap) {
@@ -130,6 +135,44 @@ FIndirectLight::FIndirectLight(FEngine& engine, const Builder& builder) noexcept
     }
 }
 
+void FIndirectLight::setRotation(math::mat3f const& rotation) noexcept {
+    mRotation = rotation;
+
+    // The environment is rotated in the shaders by looking it up with M = transpose(rotation),
+    // the spherical harmonics are rotated the same way here, i.e. f'(n) = f(M n), so that the
+    // shaders don't pay for it.
+    // Each band is rotated on its own: band 1 is linear in n, band 2 is recovered from 5
+    // samples of the rotated band, which only takes a few evaluations.
+    const mat3f M = transpose(rotation);
+    std::array<float3, 9> const& c = mIrradianceCoefs;
+
+    auto band1 = [&c](float3 const& n) -> float3 {
+        return c[1] * n.y + c[2] * n.z + c[3] * n.x;
+    };
+    auto band2 = [&c](float3 const& n) -> float3 {
+        return c[4] * (n.y * n.x) + c[5] * (n.y * n.z) + c[6] * (3.0f * n.z * n.z - 1.0f)
+                + c[7] * (n.z * n.x) + c[8] * (n.x * n.x - n.y * n.y);
+    };
+
+    const float s = float(M_SQRT1_2);
+    const float3 b1 = band2(M * float3{ 1, 0, 0 });
+    const float3 b2 = band2(M * float3{ 0, 0, 1 });
+    const float3 b3 = band2(M * float3{ s, s, 0 });
+    const float3 b4 = band2(M * float3{ s, 0, s });
+    const float3 b5 = band2(M * float3{ 0, s, s });
+
+    std::array<float3, 9>& r = mRotatedCoefs;
+    r[0] = c[0];
+    r[1] = band1(M * float3{ 0, 1, 0 });
+    r[2] = band1(M * float3{ 0, 0, 1 });
+    r[3] = band1(M * float3{ 1, 0, 0 });
+    r[6] = b2 * 0.5f;
+    r[8] = b1 + r[6];
+    r[4] = 2.0f * (b3 + r[6]);
+    r[7] = 2.0f * b4 - r[6] - r[8];
+    r[5] = 2.0f * b5 - r[6] + r[8];
+}
+
 void FIndirectLight::terminate(FEngine& engine) {
     if (FEngine::CONFIG_IBL_USE_IRRADIANCE_MAP) {
         FEngine::DriverApi& driver = engine.getDriverApi();
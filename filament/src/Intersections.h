@@ -22,8 +22,33 @@
 #include <math/mat4.h>
 #include <math/vec4.h>
 
+#include <cmath>
+
 namespace filament {
 
+/*
+ * These are the per-element kernels of the loops over arrays of spheres, boxes or planes
+ * (Culler, FScene, Froxelizer). They're written so that these loops can be vectorized once
+ * they're inlined, which is why they take and return values.
+ */
+
+// plane equation must be normalized, its normal points outside
+// returns the signed distance to the plane of the sphere's point farthest inside, i.e. the
+// sphere is entirely outside when > 0
+inline constexpr float spherePlaneDistance(math::float4 p, math::float4 s) noexcept {
+    return p.x * s.x + p.y * s.y + p.z * s.z + p.w - s.w;
+}
+
+// plane normal points outside (it doesn't need to be normalized)
+// returns the signed distance to the plane of the box's corner farthest inside, i.e. the box
+// is entirely outside when > 0
+inline float boxPlaneDistance(math::float4 p, math::float3 center, math::float3 extent) noexcept {
+    return p.x * center.x - std::abs(p.x) * extent.x +
+           p.y * center.y - std::abs(p.y) * extent.y +
+           p.z * center.z - std::abs(p.z) * extent.z +
+           p.w;
+}
+
 // sphere radius must be squared
 // plane equation must be normalized, sphere radius must be squared
 // return float4.w <= 0 if no intersection
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "details/LoaderContext.h"
+
+#include "details/Engine.h"
+#include "details/IndexBuffer.h"
+#include "details/Texture.h"
+#include "details/VertexBuffer.h"
+
+#include <utils/Systrace.h>
+
+namespace filament {
+
+using namespace driver;
+
+namespace details {
+
+void FLoaderContext::terminate(FEngine& engine) noexcept {
+    // the uploads which weren't issued give their buffers back, and the callbacks are called
+    std::lock_guard<std::mutex> lock(mLock);
+    mPending = {};
+    mExecuting = {};
+}
+
+void FLoaderContext::setBufferAt(FVertexBuffer* vertexBuffer, uint8_t bufferIndex,
+        BufferDescriptor&& buffer, uint32_t byteOffset, uint32_t byteSize) noexcept {
+    std::lock_guard<std::mutex> lock(mLock);
+    mPending.vertices.push_back({ vertexBuffer, bufferIndex, byteOffset, byteSize,
+            std::move(buffer) });
+}
+
+void FLoaderContext::setBuffer(FIndexBuffer* indexBuffer,
+        BufferDescriptor&& buffer, uint32_t byteOffset, uint32_t byteSize) noexcept {
+    std::lock_guard<std::mutex> lock(mLock);
+    mPending.indices.push_back({ indexBuffer, byteOffset, byteSize, std::move(buffer) });
+}
+
+void FLoaderContext::setImage(FTexture* texture, size_t level,
+        uint32_t xoffset, uint32_t yoffset, uint32_t width, uint32_t height,
+        PixelBufferDescriptor&& buffer) noexcept {
+    std::lock_guard<std::mutex> lock(mLock);
+    mPending.images.push_back({ texture, uint32_t(level), xoffset, yoffset, width, height,
+            std::move(buffer) });
+}
+
+void FLoaderContext::commit(BufferDescriptor::Callback callback, void* user) noexcept {
+    std::lock_guard<std::mutex> lock(mLock);
+    mPending.callbacks.emplace_back(nullptr, 0, callback, user);
+}
+
+void FLoaderContext::execute(FEngine& engine) noexcept {
+    std::unique_lock<std::mutex> lock(mLock);
+    if (mPending.empty()) {
+        return;
+    }
+    std::swap(mPending, mExecuting);
+    lock.unlock(); // the other threads can record the next uploads while these are issued
+
+    SYSTRACE_CALL();
+
+    Uploads& uploads = mExecuting;
+    for (VertexUpload& upload : uploads.vertices) {
+        upload.vertexBuffer->setBufferAt(engine, upload.bufferIndex, std::move(upload.buffer),
+                upload.byteOffset, upload.byteSize);
+    }
+    for (IndexUpload& upload : uploads.indices) {
+        upload.indexBuffer->setBuffer(engine, std::move(upload.buffer),
+                upload.byteOffset, upload.byteSize);
+    }
+    for (ImageUpload& upload : uploads.images) {
+        if (upload.width) {
+            upload.texture->setImage(engine, upload.level, upload.xoffset, upload.yoffset,
+                    upload.width, upload.height, std::move(upload.buffer));
+        } else {
+            // the public overload picks the upload of the whole level for the texture's target
+            static_cast<Texture const*>(upload.texture)->setImage(engine, upload.level,
+                    std::move(upload.buffer));
+        }
+    }
+
+    // the callbacks are called on this thread, by the driver's purge() that follows the uploads
+    FEngine::DriverApi& driver = engine.getDriverApi();
+    for (BufferDescriptor& callback : uploads.callbacks) {
+        driver.queueCallback(std::move(callback));
+    }
+
+    uploads.vertices.clear();
+    uploads.indices.clear();
+    uploads.images.clear();
+    uploads.callbacks.clear();
+}
+
+} // namespace details
+
+// ------------------------------------------------------------------------------------------------
+// Trampoline calling into private implementation
+// ------------------------------------------------------------------------------------------------
+
+using namespace details;
+
+void LoaderContext::setBufferAt(VertexBuffer* vertexBuffer, uint8_t bufferIndex,
+        BufferDescriptor&& buffer, uint32_t byteOffset, uint32_t byteSize) noexcept {
+    upcast(this)->setBufferAt(upcast(vertexBuffer), bufferIndex, std::move(buffer),
+            byteOffset, byteSize);
+}
+
+void LoaderContext::setBuffer(IndexBuffer* indexBuffer,
+        BufferDescriptor&& buffer, uint32_t byteOffset, uint32_t byteSize) noexcept {
+    upcast(this)->setBuffer(upcast(indexBuffer), std::move(buffer), byteOffset, byteSize);
+}
+
+void LoaderContext::setImage(Texture* texture, size_t level,
+        PixelBufferDescriptor&& buffer) noexcept {
+    upcast(this)->setImage(upcast(texture), level, 0, 0, 0, 0, std::move(buffer));
+}
+
+void LoaderContext::setImage(Texture* texture, size_t level,
+        uint32_t xoffset, uint32_t yoffset, uint32_t width, uint32_t height,
+        PixelBufferDescriptor&& buffer) noexcept {
+    upcast(this)->setImage(upcast(texture), level, xoffset, yoffset, width, height,
+            std::move(buffer));
+}
+
+void LoaderContext::commit(BufferDescriptor::Callback callback, void* user) noexcept {
+    upcast(this)->commit(callback, user);
+}
+
+} // namespace filament
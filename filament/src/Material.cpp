@@ -17,6 +17,7 @@
 #include "details/Material.h"
 
 #include "details/Engine.h"
+#include "details/Fence.h"
 #include "details/DFG.h"
 #include "driver/Program.h"
 
@@ -47,6 +48,7 @@ using namespace driver;
 struct Material::BuilderDetails {
     const void* mPayload = nullptr;
     size_t mSize = 0;
+    bool mCopyPayload = true;
     filaflat::MaterialParser* mMaterialParser = nullptr;
     bool mDefaultMaterial = false;
 };
@@ -66,12 +68,20 @@ BuilderType::Builder& BuilderType::Builder::operator=(BuilderType::Builder&& rhs
 Material::Builder& Material::Builder::package(const void* payload, size_t size) {
     mImpl->mPayload = payload;
     mImpl->mSize = size;
+    mImpl->mCopyPayload = true;
+    return *this;
+}
+
+Material::Builder& Material::Builder::packageView(const void* payload, size_t size) {
+    mImpl->mPayload = payload;
+    mImpl->mSize = size;
+    mImpl->mCopyPayload = false;
     return *this;
 }
 
 Material* Material::Builder::build(Engine& engine) {
     MaterialParser* materialParser = new MaterialParser(
-            upcast(engine).getBackend(), mImpl->mPayload, mImpl->mSize);
+            upcast(engine).getBackend(), mImpl->mPayload, mImpl->mSize, mImpl->mCopyPayload);
     bool materialOK = materialParser->parse() && materialParser->isShadingMaterial();
     if (!ASSERT_POSTCONDITION_NON_FATAL(materialOK, "could not parse the material package")) {
         return nullptr;
@@ -200,6 +210,11 @@ FMaterial::FMaterial(FEngine& engine, const Material::Builder& builder)
     parser->getTransparencyMode(&mTransparencyMode);
     parser->hasCustomDepthShader(&mHasCustomDepthShader);
     mIsDefaultMaterial = builder->mDefaultMaterial;
+    mPackageSize = builder->mSize;
+
+    // the instancing variant can be filtered out when the material is compiled
+    mSupportsInstancing = parser->getShader(engine.getDriver().getShaderModel(),
+            Variant::INSTANCING, ShaderType::VERTEX, engine.getVertexShaderBuilder());
 
     // pre-cache the shared variants -- these variants are shared with the default material.
     if (UTILS_UNLIKELY(!mIsDefaultMaterial && !mHasCustomDepthShader)) {
@@ -276,7 +291,7 @@ Handle<HwProgram> FMaterial::getProgramSlow(uint8_t variantKey) const noexcept {
             "GLSL or SPIR-V chunks for the vertex shader (variant=0x%x, filtered=0x%x).",
             mName.c_str(), variantKey, vertexVariantKey);
 
-    CString vs(vsBuilder.getShader(), (CString::size_type) vsBuilder.size());
+    CString vs(vsBuilder.release());
 
     /*
      * Fragment shader
@@ -291,22 +306,32 @@ Handle<HwProgram> FMaterial::getProgramSlow(uint8_t variantKey) const noexcept {
             "The material '%s' has not been compiled to include the required "
             "GLSL or SPIR-V chunks for the fragment shader (variant=0x%x, filterer=0x%x).",
             mName.c_str(), variantKey, fragmentVariantKey);
-    CString fs(fsBuilder.getShader(), (CString::size_type) fsBuilder.size());
+    CString fs(fsBuilder.release());
+
+    // the instancing variant reads its transforms from an array instead
+    UniformInterfaceBlock const* perRenderableUib = Variant(variantKey).hasInstancing() ?
+            &UibGenerator::getPerRenderableInstancesUib() : &UibGenerator::getPerRenderableUib();
 
     Program pb;
     pb      .diagnostics(mName, variantKey)
-            .withVertexShader(vs)
-            .withFragmentShader(fs)
+            .withVertexShader(std::move(vs))
+            .withFragmentShader(std::move(fs))
             .withSamplerBindings(&mSamplerBindings)
+            .specialization(Variant::getSpecialization(variantKey))
             .addUniformBlock(BindingPoints::PER_VIEW, &UibGenerator::getPerViewUib())
+            .addUniformBlock(BindingPoints::PER_FRAME, &UibGenerator::getPerFrameUib())
             .addUniformBlock(BindingPoints::LIGHTS, &UibGenerator::getLightsUib())
-            .addUniformBlock(BindingPoints::PER_RENDERABLE, &UibGenerator::getPerRenderableUib())
+            .addUniformBlock(BindingPoints::PER_RENDERABLE, perRenderableUib)
             .addUniformBlock(BindingPoints::PER_MATERIAL_INSTANCE, &mUniformInterfaceBlock)
             .addSamplerBlock(BindingPoints::PER_VIEW, &SibGenerator::getPerViewSib())
             .addSamplerBlock(BindingPoints::PER_MATERIAL_INSTANCE, &mSamplerInterfaceBlock);
 
     if (Variant(variantKey).hasSkinning()) {
         pb.addUniformBlock(BindingPoints::PER_RENDERABLE_BONES, &UibGenerator::getPerRenderableBonesUib());
+        pb.addUniformBlock(BindingPoints::PER_RENDERABLE_MORPHING,
+                &UibGenerator::getPerRenderableMorphingUib());
+        pb.addSamplerBlock(BindingPoints::PER_RENDERABLE_MORPHING,
+                &SibGenerator::getPerRenderableMorphingSib());
     }
 
     auto program = mEngine.getDriverApi().createProgram(std::move(pb));
@@ -316,6 +341,54 @@ Handle<HwProgram> FMaterial::getProgramSlow(uint8_t variantKey) const noexcept {
     return program;
 }
 
+bool FMaterial::hasVariant(uint8_t variantKey) const noexcept {
+    if (mCachedPrograms[variantKey]) {
+        return true;
+    }
+    if (Variant(variantKey).hasInstancing() && !mSupportsInstancing) {
+        return false;
+    }
+    const ShaderModel sm = mEngine.getDriver().getShaderModel();
+    return mMaterialParser->getShader(sm, Variant::filterVariantVertex(variantKey),
+                    ShaderType::VERTEX, mEngine.getVertexShaderBuilder()) &&
+            mMaterialParser->getShader(sm, Variant::filterVariantFragment(variantKey),
+                    ShaderType::FRAGMENT, mEngine.getFragmentShaderBuilder());
+}
+
+FFence* FMaterial::compile(uint8_t variants) noexcept {
+    static_assert(VARIANT_DIRECTIONAL_LIGHTING == Variant::DIRECTIONAL_LIGHTING &&
+                  VARIANT_DYNAMIC_LIGHTING == Variant::DYNAMIC_LIGHTING &&
+                  VARIANT_SHADOW_RECEIVER == Variant::SHADOW_RECEIVER &&
+                  VARIANT_SKINNING == Variant::SKINNING &&
+                  VARIANT_INSTANCING == Variant::INSTANCING &&
+                  VARIANT_ALL == VARIANT_COUNT - 1,
+            "Material::VARIANT_* must match the Variant bits");
+
+    DriverApi& driverApi = mEngine.getDriverApi();
+    const uint32_t keys = getVariantsToCompile(variants);
+    for (uint8_t key = 0; key < VARIANT_COUNT; key++) {
+        if (keys & (1u << key)) {
+            driverApi.compileProgram(getProgram(key));
+        }
+    }
+
+    // the fence is signaled once the commands above have been executed
+    return mEngine.createFence(Fence::Type::SOFT);
+}
+
+uint32_t FMaterial::getVariantsToCompile(uint8_t variants) const noexcept {
+    uint32_t keys = 0;
+    for (uint8_t key = 0; key < VARIANT_COUNT; key++) {
+        // skip the variants this material never uses, e.g. the lighting variants when it's unlit
+        if ((key & ~variants) || Variant::isReserved(key) ||
+                Variant::filterVariant(key, mIsVariantLit) != key || !hasVariant(key)) {
+            continue;
+        }
+        keys |= 1u << key;
+    }
+    return keys;
+}
+
 size_t FMaterial::getParameters(ParameterInfo* parameters, size_t count) const noexcept {
     count = std::min(count, getParameterCount());
 
@@ -358,6 +431,14 @@ MaterialInstance* Material::createInstance() const noexcept {
     return upcast(this)->createInstance();
 }
 
+Fence* Material::compile(uint8_t variants) noexcept {
+    return upcast(this)->compile(variants);
+}
+
+uint32_t Material::getUsedVariants() const noexcept {
+    return upcast(this)->getUsedVariants();
+}
+
 const char* Material::getName() const noexcept {
     return upcast(this)->getName().c_str();
 }
@@ -40,6 +40,9 @@ FMaterialInstance::FMaterialInstance(FEngine& engine, FMaterial const* material)
 
     if (!material->getUniformInterfaceBlock().isEmpty()) {
         mUniforms = UniformBuffer(upcast(material)->getDefaultInstance()->mUniforms);
+        // the default instance may have uploaded some of its uniforms already, but we have a
+        // buffer of our own
+        mUniforms.invalidate();
         mUbHandle = driver.createUniformBuffer(mUniforms.getSize());
     }
 
@@ -88,14 +91,8 @@ void FMaterialInstance::terminate(FEngine& engine) {
 void FMaterialInstance::commitSlow(FEngine& engine) const {
     // update uniforms if needed
     FEngine::DriverApi& driver = engine.getDriverApi();
-    if (mUniforms.isDirty()) {
-        driver.updateUniformBuffer(mUbHandle, UniformBuffer(mUniforms));
-        mUniforms.clean();
-    }
-    if (mSamplers.isDirty()) {
-        driver.updateSamplerBuffer(mSbHandle, SamplerBuffer(mSamplers));
-        mSamplers.clean();
-    }
+    driver.commitUniforms(mUbHandle, mUniforms);
+    driver.commitSamplers(mSbHandle, mSamplers);
 }
 
 template <typename T>
@@ -117,6 +114,51 @@ void FMaterialInstance::setParameter(const char* name,
             { upcast(texture)->getHwHandle(), sampler.getSamplerParams() });
 }
 
+MaterialInstance::ParameterHandle FMaterialInstance::getParameterHandle(
+        const char* name) const noexcept {
+    UniformInterfaceBlock const& uib = mMaterial->getUniformInterfaceBlock();
+    if (uib.hasUniform(name)) {
+        return { ParameterHandle::Kind::UNIFORM, uint32_t(uib.getUniformOffset(name, 0)) };
+    }
+    // this fails the precondition if the sampler doesn't exist either
+    SamplerInterfaceBlock::SamplerInfo const* const info =
+            mMaterial->getSamplerInterfaceBlock().getSamplerInfo(name);
+    if (info) {
+        return { ParameterHandle::Kind::SAMPLER, info->offset };
+    }
+    return {};
+}
+
+template <typename T>
+inline void FMaterialInstance::setParameter(ParameterHandle handle, T value) noexcept {
+    assert(handle.mKind == ParameterHandle::Kind::UNIFORM);
+    mUniforms.setUniform<T>(handle.mOffset, value);
+}
+
+template <typename T>
+inline void FMaterialInstance::setParameter(ParameterHandle handle,
+        const T* value, size_t count) noexcept {
+    assert(handle.mKind == ParameterHandle::Kind::UNIFORM);
+    mUniforms.setUniformArray<T>(handle.mOffset, value, count);
+}
+
+void FMaterialInstance::setParameter(ParameterHandle handle,
+        Texture const* texture, TextureSampler const& sampler) noexcept {
+    assert(handle.mKind == ParameterHandle::Kind::SAMPLER);
+    mSamplers.setSampler(handle.mOffset,
+            { upcast(texture)->getHwHandle(), sampler.getSamplerParams() });
+}
+
+template <typename T>
+inline void FMaterialInstance::setParameters(const ParameterHandle* handles,
+        const T* values, size_t count) noexcept {
+    UniformBuffer& uniforms = mUniforms;
+    for (size_t i = 0; i < count; i++) {
+        assert(handles[i].mKind == ParameterHandle::Kind::UNIFORM);
+        uniforms.setUniform<T>(handles[i].mOffset, values[i]);
+    }
+}
+
 } // namespace details
 
 using namespace details;
@@ -175,6 +217,92 @@ template UTILS_PUBLIC void MaterialInstance::setParameter<float4>  (const char*
 template UTILS_PUBLIC void MaterialInstance::setParameter<mat3f>   (const char* name, const mat3f    *v, size_t c);
 template UTILS_PUBLIC void MaterialInstance::setParameter<mat4f>   (const char* name, const mat4f    *v, size_t c);
 
+MaterialInstance::ParameterHandle MaterialInstance::getParameterHandle(
+        const char* name) const noexcept {
+    return upcast(this)->getParameterHandle(name);
+}
+
+template <typename T>
+void MaterialInstance::setParameter(ParameterHandle handle, T value) noexcept {
+    upcast(this)->setParameter<T>(handle, value);
+}
+
+// explicit template instantiation of our supported types
+template UTILS_PUBLIC void MaterialInstance::setParameter<bool>    (ParameterHandle h, bool     v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<float>   (ParameterHandle h, float    v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<int32_t> (ParameterHandle h, int32_t  v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<uint32_t>(ParameterHandle h, uint32_t v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<bool2>   (ParameterHandle h, bool2    v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<bool3>   (ParameterHandle h, bool3    v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<bool4>   (ParameterHandle h, bool4    v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<int2>    (ParameterHandle h, int2     v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<int3>    (ParameterHandle h, int3     v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<int4>    (ParameterHandle h, int4     v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<uint2>   (ParameterHandle h, uint2    v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<uint3>   (ParameterHandle h, uint3    v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<uint4>   (ParameterHandle h, uint4    v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<float2>  (ParameterHandle h, float2   v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<float3>  (ParameterHandle h, float3   v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<float4>  (ParameterHandle h, float4   v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<mat3f>   (ParameterHandle h, mat3f    v);
+template UTILS_PUBLIC void MaterialInstance::setParameter<mat4f>   (ParameterHandle h, mat4f    v);
+
+template <typename T>
+void MaterialInstance::setParameter(ParameterHandle handle, const T* value, size_t count) noexcept {
+    upcast(this)->setParameter<T>(handle, value, count);
+}
+
+// explicit template instantiation of our supported types
+template UTILS_PUBLIC void MaterialInstance::setParameter<bool>    (ParameterHandle h, const bool     *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<float>   (ParameterHandle h, const float    *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<int32_t> (ParameterHandle h, const int32_t  *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<uint32_t>(ParameterHandle h, const uint32_t *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<bool2>   (ParameterHandle h, const bool2    *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<bool3>   (ParameterHandle h, const bool3    *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<bool4>   (ParameterHandle h, const bool4    *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<int2>    (ParameterHandle h, const int2     *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<int3>    (ParameterHandle h, const int3     *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<int4>    (ParameterHandle h, const int4     *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<uint2>   (ParameterHandle h, const uint2    *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<uint3>   (ParameterHandle h, const uint3    *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<uint4>   (ParameterHandle h, const uint4    *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<float2>  (ParameterHandle h, const float2   *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<float3>  (ParameterHandle h, const float3   *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<float4>  (ParameterHandle h, const float4   *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<mat3f>   (ParameterHandle h, const mat3f    *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameter<mat4f>   (ParameterHandle h, const mat4f    *v, size_t c);
+
+template <typename T>
+void MaterialInstance::setParameters(const ParameterHandle* handles, const T* values,
+        size_t count) noexcept {
+    upcast(this)->setParameters<T>(handles, values, count);
+}
+
+// explicit template instantiation of our supported types
+template UTILS_PUBLIC void MaterialInstance::setParameters<bool>    (const ParameterHandle* h, const bool     *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameters<float>   (const ParameterHandle* h, const float    *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameters<int32_t> (const ParameterHandle* h, const int32_t  *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameters<uint32_t>(const ParameterHandle* h, const uint32_t *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameters<bool2>   (const ParameterHandle* h, const bool2    *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameters<bool3>   (const ParameterHandle* h, const bool3    *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameters<bool4>   (const ParameterHandle* h, const bool4    *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameters<int2>    (const ParameterHandle* h, const int2     *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameters<int3>    (const ParameterHandle* h, const int3     *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameters<int4>    (const ParameterHandle* h, const int4     *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameters<uint2>   (const ParameterHandle* h, const uint2    *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameters<uint3>   (const ParameterHandle* h, const uint3    *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameters<uint4>   (const ParameterHandle* h, const uint4    *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameters<float2>  (const ParameterHandle* h, const float2   *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameters<float3>  (const ParameterHandle* h, const float3   *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameters<float4>  (const ParameterHandle* h, const float4   *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameters<mat3f>   (const ParameterHandle* h, const mat3f    *v, size_t c);
+template UTILS_PUBLIC void MaterialInstance::setParameters<mat4f>   (const ParameterHandle* h, const mat4f    *v, size_t c);
+
+void MaterialInstance::setParameter(ParameterHandle handle, Texture const* texture,
+        TextureSampler const& sampler) noexcept {
+    upcast(this)->setParameter(handle, texture, sampler);
+}
+
 void MaterialInstance::setParameter(const char* name, Texture const* texture,
         TextureSampler const& sampler) noexcept {
     return upcast(this)->setParameter(name, texture, sampler);
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MipmapGenerator.h"
+
+#include "details/Engine.h"
+#include "details/Texture.h"
+
+#include <image/ImageSampler.h>
+
+#include <utils/Systrace.h>
+
+#include <algorithm>
+
+#include <string.h>
+
+namespace filament {
+
+using namespace details;
+using namespace driver;
+using namespace image;
+using namespace utils;
+
+bool MipmapGenerator::generate(FEngine& engine, FTexture const* texture,
+        Texture::PixelBufferDescriptor const& buffer) noexcept {
+    // the pixels are filtered as stored, the formats the image library can store are supported
+    PackedImage::Storage storage;
+    switch (buffer.type) {
+        case PixelDataType::UBYTE: storage = PackedImage::Storage::U8;  break;
+        case PixelDataType::HALF:  storage = PackedImage::Storage::F16; break;
+        case PixelDataType::FLOAT: storage = PackedImage::Storage::F32; break;
+        default: return false;
+    }
+    uint32_t channels;
+    switch (buffer.format) {
+        case PixelDataFormat::R:    channels = 1; break;
+        case PixelDataFormat::RG:   channels = 2; break;
+        case PixelDataFormat::RGB:  channels = 3; break;
+        case PixelDataFormat::RGBA: channels = 4; break;
+        default: return false;
+    }
+
+    SYSTRACE_CALL();
+
+    // the base level is copied, the buffer is uploaded right away
+    const uint32_t width = uint32_t(texture->getWidth());
+    const uint32_t height = uint32_t(texture->getHeight());
+    std::unique_ptr<Work> work(new Work);
+    work->texture = texture;
+    work->format = buffer.format;
+    work->type = buffer.type;
+    work->base = PackedImage(width, height, channels, storage);
+    work->levels.resize(texture->getLevels() - 1);
+
+    const size_t bpp = work->base.getBytesPerPixel();
+    const size_t bpr = Texture::PixelBufferDescriptor::computeDataSize(buffer.format, buffer.type,
+            buffer.stride ? buffer.stride : width, 1, buffer.alignment);
+    uint8_t const* const src = static_cast<uint8_t const*>(buffer.buffer);
+    for (uint32_t row = 0; row < height; row++) {
+        memcpy(work->base.getPixelRef(0, row),
+                src + bpr * (buffer.top + row) + bpp * buffer.left, bpp * width);
+    }
+
+    JobSystem& js = engine.getJobSystem();
+    Work* const w = work.get();
+    w->parent = js.createJob();
+    js.run(js.createJob(w->parent, [w](JobSystem&, JobSystem::Job*) {
+        SYSTRACE_NAME("generateMipmaps");
+        image::generateMipmaps(w->base, Filter::DEFAULT, w->levels.data(), uint32_t(w->levels.size()));
+        w->done.store(true, std::memory_order_release);
+    }));
+    mWork.push_back(std::move(work));
+    return true;
+}
+
+void MipmapGenerator::update(FEngine& engine) noexcept {
+    if (mWork.empty()) {
+        return;
+    }
+
+    JobSystem& js = engine.getJobSystem();
+    auto last = std::remove_if(mWork.begin(), mWork.end(), [&](std::unique_ptr<Work>& work) {
+        if (!work->done.load(std::memory_order_acquire)) {
+            return false;
+        }
+        js.runAndWait(work->parent);
+
+        // each level is handed over to the driver, which destroys it once uploaded
+        for (size_t i = 0, c = work->levels.size(); i < c; i++) {
+            PackedImage* const image = new PackedImage(std::move(work->levels[i]));
+            if (!image->isValid()) {
+                // the levels after 1x1 aren't generated
+                delete image;
+                break;
+            }
+            const uint32_t width = image->getWidth();
+            const uint32_t height = image->getHeight();
+            work->texture->setImage(engine, i + 1, 0, 0, width, height,
+                    Texture::PixelBufferDescriptor(image->getPixelRef(),
+                            image->getBytesPerRow() * height, work->format, work->type,
+                            1, 0, 0, 0, [](void*, size_t, void* user) {
+                                delete static_cast<PackedImage*>(user);
+                            }, image));
+        }
+        return true;
+    });
+    mWork.erase(last, mWork.end());
+}
+
+void MipmapGenerator::cancel(FEngine& engine, FTexture const* texture) noexcept {
+    JobSystem& js = engine.getJobSystem();
+    auto last = std::remove_if(mWork.begin(), mWork.end(), [&](std::unique_ptr<Work>& work) {
+        if (work->texture != texture) {
+            return false;
+        }
+        js.runAndWait(work->parent);
+        return true;
+    });
+    mWork.erase(last, mWork.end());
+}
+
+void MipmapGenerator::terminate(FEngine& engine) noexcept {
+    JobSystem& js = engine.getJobSystem();
+    for (std::unique_ptr<Work>& work : mWork) {
+        js.runAndWait(work->parent);
+    }
+    mWork.clear();
+}
+
+} // namespace filament
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_MIPMAPGENERATOR_H
+#define TNT_FILAMENT_MIPMAPGENERATOR_H
+
+#include <filament/Texture.h>
+
+#include <image/PackedImage.h>
+
+#include <utils/JobSystem.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace filament {
+
+namespace details {
+class FEngine;
+class FTexture;
+} // namespace details
+
+/*
+ * Generates the mipmaps of the textures the GPU can't generate them for (see
+ * Driver::isTextureFormatMipmappable()) on the CPU, with the image library.
+ *
+ * The base level is copied by generate(), the other levels are computed by a job and uploaded
+ * by the first update() after it finished, so the application never waits for them.
+ */
+class MipmapGenerator {
+public:
+    // returns false if the pixel format of the buffer isn't supported, in which case nothing
+    // is generated
+    bool generate(details::FEngine& engine, details::FTexture const* texture,
+            Texture::PixelBufferDescriptor const& buffer) noexcept;
+
+    // uploads the levels generated since the last call, call once per frame
+    void update(details::FEngine& engine) noexcept;
+
+    // waits for the levels of the texture being generated, and drops them
+    void cancel(details::FEngine& engine, details::FTexture const* texture) noexcept;
+
+    // waits for all the levels being generated, and drops them
+    void terminate(details::FEngine& engine) noexcept;
+
+private:
+    struct Work {
+        details::FTexture const* texture;
+        Texture::Format format;
+        Texture::Type type;
+        utils::JobSystem::Job* parent;      // only run to be waited on, so it outlives the job
+        std::atomic<bool> done = { false };
+        image::PackedImage base;
+        std::vector<image::PackedImage> levels;
+    };
+
+    std::vector<std::unique_ptr<Work>> mWork;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_MIPMAPGENERATOR_H
@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "details/MorphTargetBuffer.h"
+
+#include "details/Engine.h"
+
+#include "driver/SamplerBuffer.h"
+
+#include "FilamentAPI-impl.h"
+
+#include <private/filament/SibGenerator.h>
+
+#include <utils/Panic.h>
+
+#include <algorithm>
+
+#include <stdlib.h>
+
+using namespace math;
+
+namespace filament {
+
+using namespace details;
+using namespace driver;
+
+struct MorphTargetBuffer::BuilderDetails {
+    uint32_t mVertexCount = 0;
+    uint8_t mTargetCount = 0;
+};
+
+using BuilderType = MorphTargetBuffer;
+BuilderType::Builder::Builder() noexcept = default;
+BuilderType::Builder::~Builder() noexcept = default;
+BuilderType::Builder::Builder(BuilderType::Builder const& rhs) noexcept = default;
+BuilderType::Builder::Builder(BuilderType::Builder&& rhs) noexcept = default;
+BuilderType::Builder& BuilderType::Builder::operator=(BuilderType::Builder const& rhs) noexcept = default;
+BuilderType::Builder& BuilderType::Builder::operator=(BuilderType::Builder&& rhs) noexcept = default;
+
+MorphTargetBuffer::Builder& MorphTargetBuffer::Builder::vertexCount(uint32_t vertexCount) noexcept {
+    mImpl->mVertexCount = vertexCount;
+    return *this;
+}
+
+MorphTargetBuffer::Builder& MorphTargetBuffer::Builder::targetCount(uint8_t targetCount) noexcept {
+    mImpl->mTargetCount = targetCount;
+    return *this;
+}
+
+MorphTargetBuffer* MorphTargetBuffer::Builder::build(Engine& engine) {
+    if (!ASSERT_PRECONDITION_NON_FATAL(mImpl->mVertexCount > 0,
+            "vertexCount cannot be 0")) {
+        return nullptr;
+    }
+    if (!ASSERT_PRECONDITION_NON_FATAL(mImpl->mVertexCount < FMorphTargetBuffer::MAX_TEXEL_COUNT,
+            "vertexCount is %u, but cannot be more than %u",
+            mImpl->mVertexCount, unsigned(FMorphTargetBuffer::MAX_TEXEL_COUNT - 1))) {
+        return nullptr;
+    }
+    if (!ASSERT_PRECONDITION_NON_FATAL(
+            mImpl->mTargetCount > 0 && mImpl->mTargetCount <= CONFIG_MAX_MORPH_TARGET_COUNT,
+            "targetCount is %u, but must be between 1 and %u",
+            unsigned(mImpl->mTargetCount), unsigned(CONFIG_MAX_MORPH_TARGET_COUNT))) {
+        return nullptr;
+    }
+    return upcast(engine).createMorphTargetBuffer(*this);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+namespace details {
+
+FMorphTargetBuffer::FMorphTargetBuffer(FEngine& engine, const MorphTargetBuffer::Builder& builder)
+        : mVertexCount(builder->mVertexCount), mTargets(builder->mTargetCount) {
+    FEngine::DriverApi& driver = engine.getDriverApi();
+    mSbHandle = driver.createSamplerBuffer(SibGenerator::getPerRenderableMorphingSib().getSize());
+    // the per-vertex header must be uploaded even if all targets stay empty
+    mDirty = true;
+}
+
+void FMorphTargetBuffer::terminate(FEngine& engine) {
+    FEngine::DriverApi& driver = engine.getDriverApi();
+    driver.destroySamplerBuffer(mSbHandle);
+    if (mTexture) {
+        driver.destroyTexture(mTexture);
+    }
+}
+
+void FMorphTargetBuffer::setTarget(size_t target, uint32_t const* indices,
+        float3 const* positions, float3 const* normals, size_t count) {
+    if (!ASSERT_PRECONDITION_NON_FATAL(target < mTargets.size(),
+            "target %u out of range (%u targets)", unsigned(target), unsigned(mTargets.size()))) {
+        return;
+    }
+
+    std::vector<Delta>& deltas = mTargets[target];
+    const size_t deltaCount = mDeltaCount - deltas.size() + count;
+    if (!ASSERT_PRECONDITION_NON_FATAL(mVertexCount + deltaCount * 2 <= MAX_TEXEL_COUNT,
+            "too many deltas (%u)", unsigned(deltaCount))) {
+        return;
+    }
+
+    mDeltaCount -= deltas.size();
+    deltas.clear();
+    deltas.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        if (!ASSERT_PRECONDITION_NON_FATAL(indices[i] < mVertexCount,
+                "vertex index %u out of range (%u vertices)", indices[i], mVertexCount)) {
+            continue;
+        }
+        deltas.push_back({ indices[i], positions[i], normals ? normals[i] : float3{} });
+    }
+    mDeltaCount += deltas.size();
+    mDirty = true;
+}
+
+void FMorphTargetBuffer::commit(driver::DriverApi& driver) noexcept {
+    if (!mDirty) {
+        return;
+    }
+    mDirty = false;
+
+    // count the deltas of each vertex, to lay them out contiguously
+    std::vector<uint32_t> first(mVertexCount + 1, 0);
+    for (auto const& deltas : mTargets) {
+        for (Delta const& delta : deltas) {
+            first[delta.vertex + 1]++;
+        }
+    }
+    for (size_t i = 1; i <= mVertexCount; i++) {
+        first[i] += first[i - 1];
+    }
+
+    const size_t texelCount = mVertexCount + mDeltaCount * 2;
+    const uint32_t width = uint32_t(std::min(texelCount, TEXTURE_WIDTH));
+    const uint32_t height = uint32_t((texelCount + width - 1) / width);
+    const size_t size = width * height * sizeof(float4);
+    float4* const UTILS_RESTRICT texels = (float4*)malloc(size);
+    std::fill_n(texels, width * height, float4{});
+
+    for (size_t i = 0; i < mVertexCount; i++) {
+        texels[i] = { float(mVertexCount + first[i] * 2), float(first[i + 1] - first[i]), 0, 0 };
+    }
+    for (size_t target = 0; target < mTargets.size(); target++) {
+        for (Delta const& delta : mTargets[target]) {
+            float4* out = texels + mVertexCount + (first[delta.vertex]++) * 2;
+            out[0] = { delta.position, float(target) };
+            out[1] = { delta.normal, 0 };
+        }
+    }
+
+    if (!mTexture || width != mTextureWidth || height != mTextureHeight) {
+        if (mTexture) {
+            driver.destroyTexture(mTexture);
+        }
+        mTexture = driver.createTexture(SamplerType::SAMPLER_2D, 1, TextureFormat::RGBA32F, 1,
+                width, height, 1, TextureUsage::DEFAULT);
+        mTextureWidth = width;
+        mTextureHeight = height;
+
+        // deltas are fetched, never filtered
+        SamplerParams params;
+        params.filterMag = SamplerMagFilter::NEAREST;
+        params.filterMin = SamplerMinFilter::NEAREST;
+        SamplerBuffer sb(1);
+        sb.setSampler(0, mTexture, params);
+        driver.updateSamplerBuffer(mSbHandle, std::move(sb));
+    }
+
+    driver.load2DImage(mTexture, 0, 0, 0, width, height,
+            PixelBufferDescriptor(texels, size, PixelDataFormat::RGBA, PixelDataType::FLOAT,
+                    [](void* buffer, size_t, void*) { free(buffer); }));
+}
+
+} // namespace details
+
+// ------------------------------------------------------------------------------------------------
+// Trampoline calling into private implementation
+// ------------------------------------------------------------------------------------------------
+
+using namespace details;
+
+void MorphTargetBuffer::setTarget(Engine& engine, size_t target, uint32_t const* indices,
+        float3 const* positions, float3 const* normals, size_t count) {
+    upcast(this)->setTarget(target, indices, positions, normals, count);
+}
+
+size_t MorphTargetBuffer::getVertexCount() const noexcept {
+    return upcast(this)->getVertexCount();
+}
+
+size_t MorphTargetBuffer::getTargetCount() const noexcept {
+    return upcast(this)->getTargetCount();
+}
+
+} // namespace filament
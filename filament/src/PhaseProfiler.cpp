@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "PhaseProfiler.h"
+
+#include <utils/Profiler.h>
+#include <utils/ThreadLocal.h>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <new>
+
+#include <stdlib.h>
+
+#if defined(FILAMENT_TRACK_ALLOCATIONS)
+
+// operator new calls of the thread, it's POD so that it's usable before the thread is set up
+static thread_local uint64_t sAllocations = 0;
+
+static void* allocate(size_t size) noexcept {
+    sAllocations++;
+    return malloc(size ? size : 1);
+}
+
+void* operator new(size_t size) {
+    void* p = allocate(size);
+    if (UTILS_UNLIKELY(!p)) {
+        abort(); // exceptions are disabled
+    }
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, std::nothrow_t const&) noexcept {
+    return allocate(size);
+}
+
+void* operator new[](size_t size, std::nothrow_t const&) noexcept {
+    return allocate(size);
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+void operator delete(void* p, std::nothrow_t const&) noexcept { free(p); }
+void operator delete[](void* p, std::nothrow_t const&) noexcept { free(p); }
+
+#endif
+
+namespace filament {
+
+using namespace utils;
+
+namespace {
+
+struct ThreadState {
+    // opened the first time a Scope is used on this thread, closed when the thread exits
+    std::unique_ptr<Profiler> profiler;
+    bool initialized = false;
+    // innermost Scope of this thread
+    PhaseProfiler::Scope* current = nullptr;
+};
+
+UTILS_DEFINE_TLS(ThreadState) sThreadState;
+
+Profiler* getThreadProfiler(ThreadState& state) noexcept {
+    if (UTILS_UNLIKELY(!state.initialized)) {
+        state.initialized = true;
+        std::unique_ptr<Profiler> profiler(new Profiler());
+        profiler->resetEvents(
+                Profiler::EV_CPU_CYCLES | Profiler::EV_L1D_MISSES | Profiler::EV_STALLED_CYCLES);
+        if (profiler->isValid()) {
+            profiler->reset();
+            profiler->start();
+            state.profiler = std::move(profiler);
+        }
+    }
+    return state.profiler.get();
+}
+
+void readCounters(Profiler* profiler, uint64_t* out) noexcept {
+    if (profiler) {
+        Profiler::Counters counters;
+        profiler->readCounters(&counters);
+        const double scale = counters.getMultiplexingScale();
+        out[0] = counters.getWallTime().count();
+        out[1] = uint64_t(counters.getInstructions() * scale);
+        out[2] = uint64_t(counters.getCpuCycles() * scale);
+        out[3] = uint64_t(counters.getL1DMisses() * scale);
+        out[4] = uint64_t(counters.getStalledCycles() * scale);
+    } else {
+        // hardware counters aren't supported or allowed
+        out[0] = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+        out[1] = out[2] = out[3] = out[4] = 0;
+    }
+#if defined(FILAMENT_TRACK_ALLOCATIONS)
+    out[5] = sAllocations;
+#else
+    out[5] = 0;
+#endif
+}
+
+} // anonymous namespace
+
+PhaseProfiler& PhaseProfiler::get() noexcept {
+    static PhaseProfiler sPhaseProfiler;
+    return sPhaseProfiler;
+}
+
+const char* PhaseProfiler::getPhaseName(Phase phase) noexcept {
+    switch (phase) {
+        case SCENE_PREPARE: return "scene_prepare";
+        case CULLING:       return "culling";
+        case FROXELIZE:     return "froxelize";
+        case COMMANDS:      return "commands";
+        case SORT:          return "sort";
+        case RECORD:        return "record";
+        default:            return "unknown";
+    }
+}
+
+void PhaseProfiler::Scope::begin(Phase phase) noexcept {
+    ThreadState& state = sThreadState;
+    uint64_t now[COUNTER_COUNT];
+    readCounters(getThreadProfiler(state), now);
+
+    // the parent stops counting until we're done
+    Scope* const parent = state.current;
+    if (parent) {
+        parent->mProfiler->accumulate(parent->mPhase, parent->mStart, now);
+    }
+
+    mProfiler = &PhaseProfiler::get();
+    mParent = parent;
+    mPhase = phase;
+    std::copy(std::begin(now), std::end(now), mStart);
+    state.current = this;
+}
+
+void PhaseProfiler::Scope::end() noexcept {
+    ThreadState& state = sThreadState;
+    uint64_t now[COUNTER_COUNT];
+    readCounters(state.profiler.get(), now);
+    mProfiler->accumulate(mPhase, mStart, now);
+
+    // and the parent resumes
+    state.current = mParent;
+    if (mParent) {
+        std::copy(std::begin(now), std::end(now), mParent->mStart);
+    }
+}
+
+void PhaseProfiler::accumulate(Phase phase,
+        uint64_t const* start, uint64_t const* now) noexcept {
+    std::atomic<uint64_t>* const counters = mCounters[phase];
+    for (size_t i = 0; i < COUNTER_COUNT; i++) {
+        // the scaled counters can go slightly backward
+        if (now[i] > start[i]) {
+            counters[i].fetch_add(now[i] - start[i], std::memory_order_relaxed);
+        }
+    }
+}
+
+PhaseProfiler::FrameCounters PhaseProfiler::collect() noexcept {
+    FrameCounters result;
+    for (size_t i = 0; i < PHASE_COUNT; i++) {
+        std::atomic<uint64_t>* const counters = mCounters[i];
+        result[i].time          = counters[0].exchange(0, std::memory_order_relaxed);
+        result[i].instructions  = counters[1].exchange(0, std::memory_order_relaxed);
+        result[i].cpuCycles     = counters[2].exchange(0, std::memory_order_relaxed);
+        result[i].cacheMisses   = counters[3].exchange(0, std::memory_order_relaxed);
+        result[i].stalledCycles = counters[4].exchange(0, std::memory_order_relaxed);
+        result[i].allocations   = counters[5].exchange(0, std::memory_order_relaxed);
+    }
+    return result;
+}
+
+} // namespace filament
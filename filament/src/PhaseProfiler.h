@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_PHASEPROFILER_H
+#define TNT_FILAMENT_PHASEPROFILER_H
+
+#include <utils/compiler.h>
+
+#include <array>
+#include <atomic>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+
+/*
+ * Counts the CPU hardware events (instructions, cycles, cache misses and stalled cycles) spent in
+ * the main phases of a frame, using utils::Profiler.
+ *
+ * A Scope counts the events of the thread it's on, so phases which run as jobs open a Scope in
+ * each job. Scopes can nest, e.g. when a thread waiting for its jobs runs a job of another phase,
+ * the events are only counted in the innermost one.
+ *
+ * The counters are per-thread and the kernel multiplexes them when there are more events than
+ * hardware counters, the counts are scaled accordingly, so they're estimates. Without hardware
+ * counters, only the time and the allocations are counted.
+ *
+ * Builds with FILAMENT_TRACK_ALLOCATIONS replace the global operator new, to also count the
+ * allocations made in each phase, so that the steady state frames can be kept allocation-free.
+ * This is a debugging tool, the other builds count no allocations.
+ *
+ * The profiler is process-wide, like the hardware counters it reads. It's disabled by default
+ * and costs a relaxed atomic load per Scope when disabled.
+ */
+class PhaseProfiler {
+public:
+    enum Phase : uint8_t {
+        SCENE_PREPARE,
+        CULLING,
+        FROXELIZE,
+        COMMANDS,
+        SORT,
+        RECORD,
+        PHASE_COUNT
+    };
+
+    struct Counters {
+        uint64_t time = 0;              // CPU time spent in the phase, in ns
+        uint64_t instructions = 0;
+        uint64_t cpuCycles = 0;
+        uint64_t cacheMisses = 0;
+        uint64_t stalledCycles = 0;     // cycles stalled in the back-end (e.g. waiting for memory)
+        uint64_t allocations = 0;       // operator new calls, see FILAMENT_TRACK_ALLOCATIONS
+    };
+
+    // the number of values of Counters
+    static constexpr size_t COUNTER_COUNT = 6;
+
+    using FrameCounters = std::array<Counters, PHASE_COUNT>;
+
+    class Scope {
+    public:
+        explicit Scope(Phase phase) noexcept {
+            if (UTILS_UNLIKELY(get().isEnabled())) {
+                begin(phase);
+            }
+        }
+        ~Scope() noexcept {
+            if (UTILS_UNLIKELY(mProfiler)) {
+                end();
+            }
+        }
+        Scope(Scope const& rhs) = delete;
+        Scope& operator=(Scope const& rhs) = delete;
+    private:
+        void begin(Phase phase) noexcept;
+        void end() noexcept;
+        friend class PhaseProfiler;
+        PhaseProfiler* mProfiler = nullptr;
+        Scope* mParent = nullptr;
+        Phase mPhase = SCENE_PREPARE;
+        uint64_t mStart[COUNTER_COUNT] = {};  // time, the hardware counters, then allocations
+    };
+
+    static PhaseProfiler& get() noexcept;
+
+    static const char* getPhaseName(Phase phase) noexcept;
+
+    // only affects the Scopes opened after this call
+    void setEnabled(bool enabled) noexcept {
+        mEnabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    bool isEnabled() const noexcept {
+        return mEnabled.load(std::memory_order_relaxed);
+    }
+
+    // returns the counters accumulated since the last call, and resets them.
+    FrameCounters collect() noexcept;
+
+private:
+    PhaseProfiler() noexcept = default;
+    void accumulate(Phase phase, uint64_t const* start, uint64_t const* now) noexcept;
+
+    std::atomic<bool> mEnabled = { false };
+    std::atomic<uint64_t> mCounters[PHASE_COUNT][COUNTER_COUNT] = {};
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_PHASEPROFILER_H
@@ -74,7 +74,7 @@ void PostProcessManager::setSource(uint32_t viewportWidth, uint32_t viewportHeig
     ub.setUniform(offsetof(FEngine::PostProcessingUib, yOffset), yOffset);
 
     driver.updateSamplerBuffer(mPostProcessSbh, std::move(sb));
-    driver.updateUniformBuffer(mPostProcessUbh, UniformBuffer(ub));
+    driver.commitUniforms(mPostProcessUbh, ub);
 }
 
 void PostProcessManager::blit(driver::TextureFormat format) noexcept {
@@ -85,93 +85,316 @@ void PostProcessManager::pass(driver::TextureFormat format, Handle<HwProgram> pr
     mCommands.push_back({program, format});
 }
 
-void PostProcessManager::finish(driver::TargetBufferFlags discarded,
-        Handle<HwRenderTarget> viewRenderTarget,
-        Viewport const& vp,
-        RenderTargetPool::Target const* previous,
-        Viewport const& svp) {
+void PostProcessManager::compute(Handle<HwProgram> program) noexcept {
+    mCommands.push_back({program, TextureFormat::RGBA8, true});
+}
+
+void PostProcessManager::subpass(Handle<HwProgram> program) noexcept {
+    FEngine& engine = *mEngine;
+    DriverApi& driver = engine.getDriverApi();
+
+    // the source is read through the subpass input, no sampler is needed
+    auto duration = engine.getTime();
+    float fraction = (duration.count() % 1000000000) / 1000000000.0f;
+
+    UniformBuffer& ub = mPostProcessUb;
+    ub.setUniform(offsetof(FEngine::PostProcessingUib, time), fraction);
 
-    assert(viewRenderTarget);
-    assert(previous);
+    driver.updateSamplerBuffer(mPostProcessSbh, SamplerBuffer(engine.getPostProcessSib()));
+    driver.commitUniforms(mPostProcessUbh, ub);
+
+    Driver::RasterState rs;
+    rs.culling = Driver::RasterState::CullingMode::NONE;
+    rs.colorWrite = true;
+    rs.depthFunc = Driver::RasterState::DepthFunc::A;
+
+    driver.nextSubpass();
+    driver.draw(program, rs, engine.getFullScreenRenderPrimitive(), 1);
+}
+
+void PostProcessManager::depthPass(Handle<HwProgram> program,
+        RenderTargetPool::Target const* source, uint32_t sourceHeight,
+        RenderTargetPool::Target const* target, uint32_t width, uint32_t height) noexcept {
+    assert(source && source->depth);
+    assert(target);
 
     FEngine& engine = *mEngine;
     DriverApi& driver = engine.getDriverApi();
-    RenderTargetPool& rtp = engine.getRenderTargetPool();
-    Handle<HwRenderPrimitive> const& fullScreenRenderPrimitive = engine.getFullScreenRenderPrimitive();
-    std::vector<Command>& commands = mCommands;
 
-    if (UTILS_UNLIKELY(commands.empty())) {
-        rtp.put(previous);
-        return;
-    }
+    // depth textures can't be filtered (and we want the exact values anyways)
+    driver::SamplerParams params;
+    params.filterMag = SamplerMagFilter::NEAREST;
+    params.filterMin = SamplerMinFilter::NEAREST;
+    SamplerBuffer sb(engine.getPostProcessSib());
+    sb.setSampler(FEngine::PostProcessSib::DEPTH_BUFFER, source->depth, params);
+
+    UniformBuffer& ub = mPostProcessUb;
+    ub.setUniform(offsetof(FEngine::PostProcessingUib, yOffset), float(source->h - sourceHeight));
+
+    driver.updateSamplerBuffer(mPostProcessSbh, std::move(sb));
+    driver.commitUniforms(mPostProcessUbh, ub);
 
     Driver::RasterState rs;
     rs.culling = Driver::RasterState::CullingMode::NONE;
     rs.colorWrite = true;
     rs.depthFunc = Driver::RasterState::DepthFunc::A;
 
-    RenderPassParams params = {};
-    params.discardStart = TargetBufferFlags::ALL;
-    params.discardEnd = TargetBufferFlags::DEPTH_AND_STENCIL;
-    params.left = 0;
-    params.bottom = 0;
-    params.width = svp.width;
-    params.height = svp.height;
-    params.dependencies = RenderPassParams::DEPENDENCY_BY_REGION;
-
-    for (size_t i = 0, c = commands.size() - 1; i < c; i++) {
-        // if the next command is a blit, it we don't need a texture
-        uint8_t flags = !commands[i + 1].program ? RenderTargetPool::Target::NO_TEXTURE : uint8_t();
-
-        // create a render target for this pass
-        RenderTargetPool::Target const* target = rtp.get(
-                TargetBufferFlags::COLOR, svp.width, svp.height, 1, commands[i].format, flags);
-
-        assert(target);
-
-        if (commands[i].program) {
-            // set the source for this pass (i.e. previous target)
-            setSource(params.width, params.height, previous);
-
-            // draw a full screen triangle
-            driver.beginRenderPass(target->target, params);
-            driver.draw(commands[i].program, rs, fullScreenRenderPrimitive);
-            driver.endRenderPass();
-        } else {
-            driver.blit(TargetBufferFlags::COLOR,
-                    target->target, 0, 0, svp.width, svp.height,
-                    previous->target, 0, 0, svp.width, svp.height);
-        }
-        // return the previous target to the pool
-        rtp.put(previous);
-        previous = target;
-    }
+    RenderPassParams rp = {};
+    rp.discardStart = TargetBufferFlags::ALL;
+    rp.discardEnd = TargetBufferFlags::DEPTH_AND_STENCIL;
+    rp.width = width;
+    rp.height = height;
+
+    driver.beginRenderPass(target->target, rp);
+    driver.draw(program, rs, engine.getFullScreenRenderPrimitive(), 1);
+    driver.endRenderPass();
+}
+
+void PostProcessManager::temporalPass(Handle<HwProgram> program,
+        RenderTargetPool::Target const* color, RenderTargetPool::Target const* depth,
+        Viewport const& svp, RenderTargetPool::Target const* history,
+        math::mat4f const& reprojection, math::float4 const& historyUv,
+        math::float4 const& temporal,
+        RenderTargetPool::Target const* target, uint32_t width, uint32_t height) noexcept {
+    assert(color && color->texture);
+    assert(depth && depth->depth);
+    assert(target);
+
+    FEngine& engine = *mEngine;
+    DriverApi& driver = engine.getDriverApi();
+
+    driver::SamplerParams linear;
+    linear.filterMag = SamplerMagFilter::LINEAR;
+    linear.filterMin = SamplerMinFilter::LINEAR;
+    driver::SamplerParams nearest;
+    nearest.filterMag = SamplerMagFilter::NEAREST;
+    nearest.filterMin = SamplerMinFilter::NEAREST;
+    SamplerBuffer sb(engine.getPostProcessSib());
+    sb.setSampler(FEngine::PostProcessSib::COLOR_BUFFER, color->texture, linear);
+    sb.setSampler(FEngine::PostProcessSib::DEPTH_BUFFER, depth->depth, nearest);
+    // without history, something must still be bound, it's ignored by the shader
+    sb.setSampler(FEngine::PostProcessSib::HISTORY_BUFFER,
+            history ? history->texture : color->texture, linear);
 
-    assert(!commands.empty());
-    assert(previous);
+    // color and depth are both svp sized targets, so they have the same size
+    assert(color->w == depth->w && color->h == depth->h);
 
-    // The last command is special, it always draw to the viewRenderTarget and uses
-    // the non scaled viewport.
-    if (commands.back().program) {
-        params.discardStart = discarded;
-        params.discardEnd = TargetBufferFlags::DEPTH_AND_STENCIL;
-        params.left = vp.left;
-        params.bottom = vp.bottom;
-        params.width = vp.width;
-        params.height = vp.height;
+    UniformBuffer& ub = mPostProcessUb;
+    ub.setUniform(offsetof(FEngine::PostProcessingUib, uvScale),
+            math::float2{ svp.width, svp.height } / math::float2{ color->w, color->h });
+    ub.setUniform(offsetof(FEngine::PostProcessingUib, yOffset), float(color->h - svp.height));
+    ub.setUniform(offsetof(FEngine::PostProcessingUib, reprojection), reprojection);
+    ub.setUniform(offsetof(FEngine::PostProcessingUib, historyUv), historyUv);
+    ub.setUniform(offsetof(FEngine::PostProcessingUib, temporal), temporal);
 
-        setSource(params.width, params.height, previous);
-        driver.beginRenderPass(viewRenderTarget, params);
-        driver.draw(commands.back().program, rs, fullScreenRenderPrimitive);
-        driver.endRenderPass();
+    driver.updateSamplerBuffer(mPostProcessSbh, std::move(sb));
+    driver.commitUniforms(mPostProcessUbh, ub);
+
+    Driver::RasterState rs;
+    rs.culling = Driver::RasterState::CullingMode::NONE;
+    rs.colorWrite = true;
+    rs.depthFunc = Driver::RasterState::DepthFunc::A;
 
+    RenderPassParams rp = {};
+    rp.discardStart = TargetBufferFlags::ALL;
+    rp.discardEnd = TargetBufferFlags::DEPTH_AND_STENCIL;
+    rp.width = width;
+    rp.height = height;
+
+    driver.beginRenderPass(target->target, rp);
+    driver.draw(program, rs, engine.getFullScreenRenderPrimitive(), 1);
+    driver.endRenderPass();
+}
+
+void PostProcessManager::oitCompositePass(Handle<HwProgram> program,
+        RenderTargetPool::Target const* accumulation,
+        RenderTargetPool::Target const* revealage, Viewport const& svp,
+        Handle<HwRenderTarget> target,
+        TargetBufferFlags discardStart, TargetBufferFlags discardEnd) noexcept {
+    assert(accumulation && accumulation->texture);
+    assert(revealage && revealage->texture);
+
+    FEngine& engine = *mEngine;
+    DriverApi& driver = engine.getDriverApi();
+
+    // the layers are read at the pixel they're blended into
+    driver::SamplerParams params;
+    params.filterMag = SamplerMagFilter::NEAREST;
+    params.filterMin = SamplerMinFilter::NEAREST;
+    SamplerBuffer sb(engine.getPostProcessSib());
+    sb.setSampler(FEngine::PostProcessSib::COLOR_BUFFER, accumulation->texture, params);
+    sb.setSampler(FEngine::PostProcessSib::REVEALAGE_BUFFER, revealage->texture, params);
+
+    UniformBuffer& ub = mPostProcessUb;
+    ub.setUniform(offsetof(FEngine::PostProcessingUib, yOffset),
+            float(accumulation->h - svp.height));
+
+    driver.updateSamplerBuffer(mPostProcessSbh, std::move(sb));
+    driver.commitUniforms(mPostProcessUbh, ub);
+
+    Driver::RasterState rs;
+    rs.culling = Driver::RasterState::CullingMode::NONE;
+    rs.colorWrite = true;
+    rs.depthWrite = false;
+    rs.depthFunc = Driver::RasterState::DepthFunc::A;
+    rs.blendFunctionSrcRGB   = BlendFunction::SRC_ALPHA;
+    rs.blendFunctionSrcAlpha = BlendFunction::ONE;
+    rs.blendFunctionDstRGB   = BlendFunction::ONE_MINUS_SRC_ALPHA;
+    rs.blendFunctionDstAlpha = BlendFunction::ONE_MINUS_SRC_ALPHA;
+
+    RenderPassParams rp = {};
+    rp.discardStart = discardStart;
+    rp.discardEnd = discardEnd;
+    rp.width = svp.width;
+    rp.height = svp.height;
+
+    driver.beginRenderPass(target, rp);
+    driver.draw(program, rs, engine.getFullScreenRenderPrimitive(), 1);
+    driver.endRenderPass();
+}
+
+void PostProcessManager::shadowMomentsPass(Handle<HwProgram> program,
+        Handle<HwTexture> source, bool depth,
+        RenderTargetPool::Target const* target, Viewport const& viewport) noexcept {
+    assert(source);
+    assert(target);
+
+    FEngine& engine = *mEngine;
+    DriverApi& driver = engine.getDriverApi();
+
+    // the blur fetches the texels of the tile, which must not be filtered
+    driver::SamplerParams params;
+    params.filterMag = SamplerMagFilter::NEAREST;
+    params.filterMin = SamplerMinFilter::NEAREST;
+    SamplerBuffer sb(engine.getPostProcessSib());
+    if (depth) {
+        params.depthStencil = true;
+        sb.setSampler(FEngine::PostProcessSib::DEPTH_BUFFER, source, params);
     } else {
-        driver.blit(TargetBufferFlags::COLOR,
-                viewRenderTarget, vp.left, vp.bottom, vp.width, vp.height,
-                previous->target, 0, 0, svp.width, svp.height);
+        sb.setSampler(FEngine::PostProcessSib::COLOR_BUFFER, source, params);
+    }
+
+    UniformBuffer& ub = mPostProcessUb;
+    ub.setUniform(offsetof(FEngine::PostProcessingUib, shadowTile), math::float4{
+            viewport.left, viewport.bottom,
+            viewport.left + viewport.width - 1, viewport.bottom + viewport.height - 1 });
+
+    driver.updateSamplerBuffer(mPostProcessSbh, std::move(sb));
+    driver.commitUniforms(mPostProcessUbh, ub);
+
+    Driver::RasterState rs;
+    rs.culling = Driver::RasterState::CullingMode::NONE;
+    rs.colorWrite = true;
+    rs.depthFunc = Driver::RasterState::DepthFunc::A;
+
+    // the other tiles of the target are kept
+    RenderPassParams rp = {};
+    rp.discardEnd = TargetBufferFlags::DEPTH_AND_STENCIL;
+    rp.left = viewport.left;
+    rp.bottom = viewport.bottom;
+    rp.width = viewport.width;
+    rp.height = viewport.height;
+
+    driver.beginRenderPass(target->target, rp);
+    driver.draw(program, rs, engine.getFullScreenRenderPrimitive(), 1);
+    driver.endRenderPass();
+}
+
+void PostProcessManager::finish(FrameGraph& fg,
+        FrameGraphResource input, FrameGraphResource output,
+        Viewport const& vp, Viewport const& svp) {
+
+    std::vector<Command>& commands = mCommands;
+    if (UTILS_UNLIKELY(commands.empty())) {
+        return;
     }
 
-    rtp.put(previous);
+    struct PostProcessPass {
+        FrameGraphResource input;
+        FrameGraphResource output;
+    };
+
+    FrameGraphResource previous = input;
+    for (size_t i = 0, c = commands.size(); i < c; i++) {
+        Command const command = commands[i];
+
+        // The last command is special, it always draws to the output and uses the non scaled
+        // viewport.
+        const bool last = i == c - 1;
+        assert(!last || !command.compute);
+        const Viewport viewport = last ? vp : Viewport{ 0, 0, svp.width, svp.height };
+
+        auto const& data = fg.addPass<PostProcessPass>(
+                command.compute ? "Post Process Compute" :
+                command.program ? "Post Process" : "Post Process Blit",
+                [&](FrameGraph::Builder& builder, PostProcessPass& data) {
+                    data.input = command.program ?
+                            builder.read(previous) : builder.blit(previous);
+                    if (last) {
+                        data.output = builder.write(output);
+                    } else if (command.compute) {
+                        FrameGraph::Descriptor desc;
+                        desc.width = svp.width;
+                        desc.height = svp.height;
+                        desc.format = TextureFormat::RGBA8;
+                        data.output = builder.image(builder.create("Post Process Image", desc));
+                    } else {
+                        FrameGraph::Descriptor desc;
+                        desc.width = svp.width;
+                        desc.height = svp.height;
+                        desc.format = command.format;
+                        data.output = builder.write(builder.create("Post Process Buffer", desc));
+                    }
+                },
+                [this, command, viewport, svp](FrameGraph::Resources const& resources,
+                        PostProcessPass const& data) {
+                    DriverApi& driver = mEngine->getDriverApi();
+                    RenderTargetPool::Target const* source = resources.getTarget(data.input);
+                    Handle<HwRenderTarget> target = resources.getRenderTarget(data.output);
+
+                    driver.pushGroupMarker("Post Processing");
+                    driver.beginTimer(Driver::TIMER_POST_PROCESS);
+                    if (command.compute) {
+                        // one invocation per pixel of the scaled viewport
+                        setSource(svp.width, svp.height, source);
+                        driver.dispatchCompute(command.program,
+                                resources.getTarget(data.output)->texture,
+                                (svp.width + COMPUTE_GROUP_SIZE - 1) / COMPUTE_GROUP_SIZE,
+                                (svp.height + COMPUTE_GROUP_SIZE - 1) / COMPUTE_GROUP_SIZE);
+                    } else if (command.program) {
+                        Driver::RasterState rs;
+                        rs.culling = Driver::RasterState::CullingMode::NONE;
+                        rs.colorWrite = true;
+                        rs.depthFunc = Driver::RasterState::DepthFunc::A;
+
+                        RenderPassParams params = {};
+                        params.discardStart = resources.getDiscardStart(data.output);
+                        params.discardEnd = resources.getDiscardEnd(data.output);
+                        params.left = viewport.left;
+                        params.bottom = viewport.bottom;
+                        params.width = viewport.width;
+                        params.height = viewport.height;
+                        params.dependencies = RenderPassParams::DEPENDENCY_BY_REGION;
+
+                        // set the source for this pass (i.e. previous target), which always
+                        // holds the scaled viewport, even when the last pass upscales it
+                        setSource(svp.width, svp.height, source);
+
+                        // draw a full screen triangle
+                        driver.beginRenderPass(target, params);
+                        driver.draw(command.program, rs,
+                                mEngine->getFullScreenRenderPrimitive(), 1);
+                        driver.endRenderPass();
+                    } else {
+                        driver.blit(TargetBufferFlags::COLOR, target,
+                                viewport.left, viewport.bottom, viewport.width, viewport.height,
+                                source->target, 0, 0, svp.width, svp.height);
+                    }
+                    driver.endTimer();
+                    driver.popGroupMarker();
+                });
+        previous = data.output;
+    }
 
     // clear our command buffer
     commands.clear();
@@ -17,6 +17,7 @@
 #ifndef TNT_FILAMENT_POSTPROCESS_MANAGER_H
 #define TNT_FILAMENT_POSTPROCESS_MANAGER_H
 
+#include "FrameGraph.h"
 #include "RenderTargetPool.h"
 
 #include "driver/DriverApiForward.h"
@@ -27,6 +28,9 @@
 
 #include <filament/driver/DriverEnums.h>
 
+#include <math/mat4.h>
+#include <math/vec4.h>
+
 #include <vector>
 
 namespace filament {
@@ -38,6 +42,9 @@ class FView;
 
 class PostProcessManager {
 public:
+    // size of the work groups of the compute stages, see post_process.cs
+    static constexpr uint32_t COMPUTE_GROUP_SIZE = 8;
+
     void init(details::FEngine& engine) noexcept;
     void terminate(driver::DriverApi& driver) noexcept;
     void setSource(uint32_t viewportWidth, uint32_t viewportHeight,
@@ -49,15 +56,54 @@ public:
     // a fullscreen pass, using the given format as target and writing into the specified program
     void pass(driver::TextureFormat format, Handle<HwProgram> program) noexcept;
 
+    // draws program in the second subpass of the current render pass, which must have been
+    // started with DEPENDENCY_SUBPASS_INPUT. This isn't part of the command list.
+    void subpass(Handle<HwProgram> program) noexcept;
+
+    // A compute pass, writing an RGBA8 image at the scaled viewport. It can't be the last
+    // command, since the view's target can't be written as an image. The driver must support
+    // compute shaders.
+    void compute(Handle<HwProgram> program) noexcept;
+
     // a blit pass, using the given format as target
     void blit(driver::TextureFormat format = driver::TextureFormat::RGBA8) noexcept;
 
-    void finish(driver::TargetBufferFlags discarded,
-            Handle<HwRenderTarget> viewRenderTarget,
-            Viewport const& vp,
-            RenderTargetPool::Target const* linearTarget,
-            Viewport const& svp);
-
+    // a fullscreen pass into the lower-left width x height corner of target, which samples the
+    // depth texture of source (a DEPTH_TEXTURE target). This isn't part of the command list.
+    void depthPass(Handle<HwProgram> program,
+            RenderTargetPool::Target const* source, uint32_t sourceHeight,
+            RenderTargetPool::Target const* target, uint32_t width, uint32_t height) noexcept;
+
+    // A fullscreen pass into the lower-left width x height corner of target, which blends color
+    // (rendered at svp along with the depth of depth, a DEPTH_TEXTURE target) with history.
+    // history can be null, then its weight must be 0. See TemporalUpscaler. This isn't part of
+    // the command list.
+    void temporalPass(Handle<HwProgram> program,
+            RenderTargetPool::Target const* color, RenderTargetPool::Target const* depth,
+            Viewport const& svp, RenderTargetPool::Target const* history,
+            math::mat4f const& reprojection, math::float4 const& historyUv,
+            math::float4 const& temporal,
+            RenderTargetPool::Target const* target, uint32_t width, uint32_t height) noexcept;
+
+    // A fullscreen pass blending the layers of the order-independent transparent objects (see
+    // FRenderer::OitPass), rendered at svp, over the color buffer of target. This isn't part of
+    // the command list.
+    void oitCompositePass(Handle<HwProgram> program,
+            RenderTargetPool::Target const* accumulation,
+            RenderTargetPool::Target const* revealage, Viewport const& svp,
+            Handle<HwRenderTarget> target,
+            driver::TargetBufferFlags discardStart, driver::TargetBufferFlags discardEnd) noexcept;
+
+    // A pass into the tile given by viewport of target, which reads the same tile of source:
+    // the depth texture of the shadow atlas when depth is set, or the moments of a previous pass.
+    // See ShadowAtlas::resolveMoments(). This isn't part of the command list.
+    void shadowMomentsPass(Handle<HwProgram> program, Handle<HwTexture> source, bool depth,
+            RenderTargetPool::Target const* target, Viewport const& viewport) noexcept;
+
+    // adds the commands to the frame graph, as passes reading input (at svp) and finally writing
+    // output (at vp). The intermediate targets are transient.
+    void finish(FrameGraph& fg, FrameGraphResource input, FrameGraphResource output,
+            Viewport const& vp, Viewport const& svp);
 
 private:
     details::FEngine* mEngine = nullptr;
@@ -65,6 +111,7 @@ private:
     struct Command {
         Handle<HwProgram> program = {};
         driver::TextureFormat format;
+        bool compute = false;
     };
 
     std::vector<Command> mCommands;
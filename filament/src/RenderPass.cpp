@@ -16,6 +16,8 @@
 
 #include "RenderPass.h"
 
+#include "PhaseProfiler.h"
+
 #include "details/Culler.h"
 #include "details/Material.h"
 #include "details/MaterialInstance.h"
@@ -26,9 +28,18 @@
 // NOTE: We only need Renderer.h here because the definition of some FRenderer methods are here
 #include "details/Renderer.h"
 
+#include "driver/CircularBuffer.h"
+#include "driver/CommandStream.h"
+
+#include <utils/Hash.h>
 #include <utils/JobSystem.h>
 #include <utils/Systrace.h>
 
+#include <algorithm>
+#include <iterator>
+
+#include <string.h>
+
 using namespace utils;
 using namespace math;
 
@@ -43,17 +54,104 @@ RenderPass::~RenderPass() noexcept = default;
 UTILS_ALWAYS_INLINE // this allows the compiler to devirtualize some calls
 inline              // this removes the code from the compilation unit
 void RenderPass::render(
-        FEngine& engine, JobSystem& js,
+        FEngine& engine, JobSystem& js, ArenaScope& arena,
         FScene::RenderableSoa const& soa, Range<uint32_t> vr,
-        uint32_t commandTypeFlags, RenderFlags renderFlags,
+        uint32_t commandTypeFlags, RenderFlags renderFlags, uint32_t visibilityMask,
         const CameraInfo& camera, Viewport const& viewport,
-        GrowingSlice<Command>& commands) noexcept {
+        PerRenderableUniforms const& uniforms,
+        GrowingSlice<Command>& commands, CommandCache* cache) noexcept {
 
     SYSTRACE_CONTEXT();
 
     // trace the number of visible renderables
     SYSTRACE_VALUE32("visibleRenderables", vr.size());
 
+    // we extract camera position/forward outside of the loop, because these are not cheap.
+    const float3 cameraPosition(camera.getPosition());
+    const float3 cameraForwardVector(camera.getForwardVector());
+
+    // if nothing changed since the commands were cached, we just need to record them again
+    Slice<Command> sortedCommands;
+    if (cache && updateSignature(*cache, commandTypeFlags, soa, vr, renderFlags, visibilityMask,
+            cameraPosition, cameraForwardVector) && !cache->mCommands.empty()) {
+        sortedCommands = { cache->mCommands.data(), cache->mCommands.size() };
+    } else {
+        generateSortedCommands(engine, js, arena, soa, vr, commandTypeFlags, renderFlags,
+                visibilityMask, cameraPosition, cameraForwardVector, commands);
+        sortedCommands = commands;
+        if (cache) {
+            cache->mCommands.assign(commands.begin(), commands.end());
+        }
+    }
+
+    // the order-independent transparent commands are sorted last, just before the SENTINEL
+    // commands, they're left to their own passes
+    Command oit;
+    oit.key = uint64_t(Pass::ORDER_INDEPENDENT);
+    Command sentinel;
+    sentinel.key = uint64_t(Pass::SENTINEL);
+    Command* const first = std::lower_bound(sortedCommands.begin(), sortedCommands.end(), oit);
+    Command* const last = std::lower_bound(first, sortedCommands.end(), sentinel);
+    mOrderIndependentCommands = { first, last };
+
+    render(engine, js, arena, soa, { sortedCommands.begin(), first }, camera, viewport, uniforms);
+}
+
+void RenderPass::render(FEngine& engine, JobSystem& js, ArenaScope& arena,
+        FScene::RenderableSoa const& soa, Slice<Command> const& sortedCommands,
+        const CameraInfo& camera, Viewport const& viewport,
+        PerRenderableUniforms const& uniforms) noexcept {
+    mSortedCommands = sortedCommands;
+
+    // the planes the batches are culled against are shared by all the batches of the pass
+    float4* planes = nullptr;
+    if (mGpuCullingFrustum) {
+        planes = engine.getDriverApi().allocatePod<float4>(6);
+        std::copy_n(mGpuCullingFrustum->getNormalizedPlanes(), 6, planes);
+    }
+
+    // the transforms of instanced draws must be uploaded before the render pass starts
+    Slice<const InstanceBuffer> instanceBuffers =
+            createInstanceBuffers(engine, arena, soa, sortedCommands, planes);
+
+    updateDrawStatistics(engine.getDrawStatistics(), soa, sortedCommands,
+            !instanceBuffers.empty());
+
+    // The previous pass was recorded while this one was prepared, its commands are handed to the
+    // driver thread before this pass adds its own, so that the command stream doesn't overflow.
+    if (engine.hasPendingRecording()) {
+        engine.flush();
+    }
+
+    // Take care not to upload data within the render pass (synchronize can commit froxel data)
+    driver::DriverApi& driver = engine.getDriverApi();
+    beginRenderPass(driver, viewport, camera);
+
+    // Now, execute all commands
+    RenderPass::recordDriverCommands(driver, js, arena, sortedCommands, uniforms, instanceBuffers,
+            mOverlapNextPass ? engine.getRecordingJob() : nullptr);
+
+    endRenderPass(driver, viewport);
+
+    for (InstanceBuffer const& instanceBuffer : instanceBuffers) {
+        driver.destroyUniformBuffer(instanceBuffer.ubh);
+    }
+
+    // Kick the GPU since we're done with this render target
+    driver.flush();
+    // Wake-up the driver thread, unless the next pass does it
+    if (!mOverlapNextPass) {
+        engine.flush();
+    }
+}
+
+void RenderPass::generateSortedCommands(
+        FEngine& engine, JobSystem& js, ArenaScope& arena,
+        FScene::RenderableSoa const& soa, Range<uint32_t> vr,
+        uint32_t commandTypeFlags, RenderFlags renderFlags, uint32_t visibilityMask,
+        float3 cameraPosition, float3 cameraForwardVector,
+        GrowingSlice<Command>& commands) noexcept {
+
     // up-to-date summed primitive counts needed for generateCommands()
     updateSummedPrimitiveCounts(const_cast<FScene::RenderableSoa&>(soa), vr);
 
@@ -63,15 +161,70 @@ void RenderPass::render(
     const bool colorPass  = bool(commandTypeFlags & CommandTypeFlags::COLOR);
     const bool depthPass  = bool(commandTypeFlags & (CommandTypeFlags::DEPTH | CommandTypeFlags::SHADOW));
     growBy *= uint32_t(colorPass * 2 + depthPass);
+
+    // make room for the commands and the sentinel. When the commands buffer is too small, they're
+    // moved to a larger one, the old one is only reclaimed at the end of the frame.
+    if (UTILS_UNLIKELY(commands.remain() < growBy + 1)) {
+        const uint32_t count = uint32_t(commands.size());
+        const uint32_t capacity = std::max(uint32_t(commands.capacity() * 2), count + growBy + 1);
+        Command* const buffer = arena.allocate<Command>(capacity, CACHELINE_SIZE);
+        std::copy(commands.begin(), commands.end(), buffer);
+        commands.set(buffer, capacity);
+        commands.resize(count);
+    }
+
+    // the commands of a shadow pass are generated and sorted in their compact form
+    if (commandTypeFlags == CommandTypeFlags::SHADOW) {
+        ArenaScope scope(arena.getAllocator());
+        DepthCommand* const depthCommands =
+                scope.allocate<DepthCommand>(growBy + 1, CACHELINE_SIZE);
+        if (UTILS_LIKELY(depthCommands)) {
+            auto work = [depthCommands, &soa, renderFlags, visibilityMask,
+                    cameraPosition, cameraForwardVector](uint32_t startIndex, uint32_t indexCount) {
+                PhaseProfiler::Scope profile(PhaseProfiler::COMMANDS);
+                RenderPass::generateDepthCommands(depthCommands,
+                        soa, { startIndex, startIndex + indexCount }, renderFlags, visibilityMask,
+                        cameraPosition, cameraForwardVector);
+            };
+            auto jobCommandsParallel = jobs::parallel_for(js, nullptr,
+                    vr.first, (uint32_t)vr.size(), std::cref(work),
+                    jobs::CountSplitter<JOBS_PARALLEL_FOR_COMMANDS_COUNT, 8>());
+            { // scope for systrace
+                SYSTRACE_NAME("jobCommandsParallel");
+                js.runAndWait(jobCommandsParallel);
+            }
+            depthCommands[growBy].key = uint64_t(Pass::SENTINEL);
+            RenderPass::sortCommands(js, scope, depthCommands, growBy + 1);
+
+            // skipped commands are sorted last, they're not expanded
+            DepthCommand sentinel;
+            sentinel.key = uint64_t(Pass::SENTINEL);
+            const uint32_t count = uint32_t(std::lower_bound(depthCommands,
+                    depthCommands + growBy, sentinel) - depthCommands);
+
+            Command* const curr = commands.grow(count);
+            auto expand = [curr, depthCommands, &soa](uint32_t first, uint32_t c) {
+                RenderPass::expandDepthCommands(curr + first, depthCommands + first, c, soa);
+            };
+            auto jobExpandParallel = jobs::parallel_for(js, nullptr, 0, count,
+                    std::cref(expand), jobs::CountSplitter<JOBS_PARALLEL_FOR_COMMANDS_COUNT, 8>());
+            js.runAndWait(jobExpandParallel);
+
+            commands.grow(1)->key = uint64_t(Pass::SENTINEL);
+
+            RenderPass::instanceCommands(commands.begin(), commands.size(), soa,
+                    engine.isDrawIndirectSupported());
+            return;
+        }
+    }
+
     Command* const curr = commands.grow(growBy);
 
-    // we extract camera position/forward outside of the loop, because these are not cheap.
-    const float3 cameraPosition(camera.getPosition());
-    const float3 cameraForwardVector(camera.getForwardVector());
-    auto work = [commandTypeFlags, curr, &soa, renderFlags, cameraPosition, cameraForwardVector]
-            (uint32_t startIndex, uint32_t indexCount) {
+    auto work = [commandTypeFlags, curr, &soa, renderFlags, visibilityMask,
+            cameraPosition, cameraForwardVector](uint32_t startIndex, uint32_t indexCount) {
+        PhaseProfiler::Scope profile(PhaseProfiler::COMMANDS);
         RenderPass::generateCommands(commandTypeFlags, curr,
-                soa, { startIndex, startIndex + indexCount }, renderFlags,
+                soa, { startIndex, startIndex + indexCount }, renderFlags, visibilityMask,
                 cameraPosition, cameraForwardVector);
     };
 
@@ -88,65 +241,634 @@ void RenderPass::render(
     // command buffer.
     commands.grow(1)->key = uint64_t(Pass::SENTINEL);
 
-    { // sort all commands
-        SYSTRACE_NAME("sort commands");
-        std::sort(commands.begin(), commands.end());
+    // sort all commands
+    RenderPass::sortCommands(js, arena, commands.begin(), commands.size());
+
+    RenderPass::instanceCommands(commands.begin(), commands.size(), soa,
+            engine.isDrawIndirectSupported());
+}
+
+UTILS_NOINLINE
+bool RenderPass::updateSignature(CommandCache& cache, uint32_t commandTypeFlags,
+        FScene::RenderableSoa const& soa, utils::Range<uint32_t> range, RenderFlags renderFlags,
+        uint32_t visibilityMask, float3 cameraPosition, float3 cameraForward) noexcept {
+    SYSTRACE_CALL();
+
+    // The signature contains everything generateCommands() reads, except for the materials,
+    // which can't change. Values are compared bitwise, which at worst causes a cache miss.
+    std::vector<uint64_t>& signature = cache.mScratch;
+    signature.clear();
+    auto append = [&signature](auto const& value) {
+        uint64_t words[(sizeof(value) + 7) / 8] = {};
+        memcpy(words, &value, sizeof(value));
+        signature.insert(signature.end(), std::begin(words), std::end(words));
+    };
+
+    append(commandTypeFlags);
+    append(renderFlags);
+    append(visibilityMask);
+    append(cameraPosition);
+    append(cameraForward);
+
+    auto const* const UTILS_RESTRICT soaInstance        = soa.data<FScene::RENDERABLE_INSTANCE>();
+    auto const* const UTILS_RESTRICT soaWorldAABBCenter = soa.data<FScene::WORLD_AABB_CENTER>();
+    auto const* const UTILS_RESTRICT soaVisibility      = soa.data<FScene::VISIBILITY_STATE>();
+    auto const* const UTILS_RESTRICT soaPrimitives      = soa.data<FScene::PRIMITIVES>();
+    auto const* const UTILS_RESTRICT soaBonesUbh        = soa.data<FScene::BONES_UBH>();
+    auto const* const UTILS_RESTRICT soaBonesOffset     = soa.data<FScene::BONES_OFFSET>();
+    auto const* const UTILS_RESTRICT soaMorphingUbh     = soa.data<FScene::MORPHING_UBH>();
+    auto const* const UTILS_RESTRICT soaMorphTargetsSbh = soa.data<FScene::MORPH_TARGETS_SBH>();
+    auto const* const UTILS_RESTRICT soaVisibleMask     = soa.data<FScene::VISIBLE_MASK>();
+    auto const* const UTILS_RESTRICT soaSpotShadowMask  = soa.data<FScene::SPOT_SHADOW_MASK>();
+    auto const* const UTILS_RESTRICT soaScreenCoverage  = soa.data<FScene::SCREEN_COVERAGE>();
+    const bool automaticPrepass = renderFlags & DEPTH_PREPASS_AUTOMATIC;
+
+    for (uint32_t i = range.first; i < range.last; ++i) {
+        append(soaInstance[i]);
+        if (automaticPrepass) {
+            append(soaScreenCoverage[i] > DEPTH_PREPASS_MIN_COVERAGE);
+        }
+        append(FView::getShadowCasterMask(soaVisibleMask[i], soaSpotShadowMask[i],
+                soaVisibility[i].staticShadowCaster) & visibilityMask);
+        append(soaWorldAABBCenter[i]);
+        append(soaVisibility[i]);
+        append(soaBonesUbh[i]);
+        append(soaBonesOffset[i]);
+        append(soaMorphingUbh[i]);
+        append(soaMorphTargetsSbh[i]);
+        append(soaPrimitives[i].size());
+        for (auto const& primitive : soaPrimitives[i]) {
+            FMaterialInstance const* const mi = primitive.getMaterialInstance();
+            append(mi);
+            append(mi->getSortingKey());
+            append(primitive.getHwHandle());
+            append(primitive.getVertexBufferHandle());
+            append(primitive.getIndexBufferHandle());
+            append(primitive.getPrimitiveType());
+            append(primitive.getBlendOrder());
+        }
     }
 
-    // Take care not to upload data within the render pass (synchronize can commit froxel data)
-    driver::DriverApi& driver = engine.getDriverApi();
-    beginRenderPass(driver, viewport, camera);
+    const bool same = signature == cache.mSignature;
+    std::swap(cache.mSignature, cache.mScratch);
+    return same;
+}
 
-    // Now, execute all commands
-    RenderPass::recordDriverCommands(driver, commands);
+/*
+ * Commands are sorted with a parallel LSD radix sort, 8 bits at a time. Each job handles a
+ * contiguous chunk of the commands, for each pass:
+ * - each job computes the histogram of its chunk,
+ * - the histograms are turned into per-job destination offsets,
+ * - each job scatters its chunk into the destination buffer (this keeps the sort stable).
+ *
+ * A first parallel scan finds which bits actually vary across keys, passes on bytes that are
+ * the same for all commands are skipped entirely (that's usually most of them), and also
+ * detects if the commands are already sorted.
+ *
+ * SENTINEL commands, which are used to mark unused commands, would otherwise make all bytes
+ * look like they vary. They get their own bucket that is always last.
+ */
+template<typename T>
+UTILS_NOINLINE
+void RenderPass::sortCommands(JobSystem& js, ArenaScope& rootArena,
+        T* const commands, size_t count) noexcept {
+    SYSTRACE_CALL();
+    PhaseProfiler::Scope profile(PhaseProfiler::SORT);
 
-    endRenderPass(driver, viewport);
+    if (count < RADIX_SORT_MIN_COMMANDS_COUNT) {
+        std::sort(commands, commands + count);
+        return;
+    }
 
-    // Kick the GPU since we're done with this render target
-    driver.flush();
-    // Wake-up the driver thread
-    engine.flush();
+    ArenaScope arena(rootArena.getAllocator());
+    T* const scratch = arena.allocate<T>(count, CACHELINE_SIZE);
+    uint32_t (* const histograms)[RADIX_SORT_BUCKET_COUNT] =
+            arena.allocate<uint32_t[RADIX_SORT_BUCKET_COUNT]>(RADIX_SORT_MAX_JOBS, CACHELINE_SIZE);
+    if (UTILS_UNLIKELY(!scratch || !histograms)) {
+        // not enough scratch memory left for this pass
+        std::sort(commands, commands + count);
+        return;
+    }
+
+    const size_t jobCount = std::min(RADIX_SORT_MAX_JOBS, count / (RADIX_SORT_MIN_COMMANDS_COUNT / 2));
+    const size_t chunkSize = (count + jobCount - 1) / jobCount;
+    auto chunk = [count, chunkSize](uint32_t job) -> Range<size_t> {
+        return { std::min(count, job * chunkSize), std::min(count, (job + 1) * chunkSize) };
+    };
+    auto dispatch = [&js, jobCount](auto& functor) {
+        auto job = jobs::parallel_for(js, nullptr, 0, (uint32_t)jobCount,
+                [&functor](uint32_t first, uint32_t c) {
+                    PhaseProfiler::Scope profile(PhaseProfiler::SORT);
+                    for (uint32_t i = first; i < first + c; i++) {
+                        functor(i);
+                    }
+                }, jobs::CountSplitter<1, RADIX_SORT_MAX_JOBS>());
+        js.runAndWait(job);
+    };
+
+    // find the bits that vary in non-sentinel keys, and whether the commands are already sorted
+    struct {
+        CommandKey ones;
+        CommandKey zeros;
+        bool sorted;
+    } scans[RADIX_SORT_MAX_JOBS];
+
+    auto scan = [&](uint32_t job) {
+        Range<size_t> const r = chunk(job);
+        CommandKey ones = 0;
+        CommandKey zeros = 0;
+        bool sorted = true;
+        for (size_t i = r.first; i < r.last; i++) {
+            const CommandKey key = commands[i].key;
+            const bool sentinel = key == CommandKey(Pass::SENTINEL);
+            ones  |= sentinel ? 0 : key;
+            zeros |= sentinel ? 0 : ~key;
+            sorted &= (i == r.first) || !(key < commands[i - 1].key);
+        }
+        scans[job] = { ones, zeros, sorted };
+    };
+    dispatch(scan);
+
+    CommandKey ones = 0;
+    CommandKey zeros = 0;
+    bool sorted = true;
+    for (size_t job = 0; job < jobCount; job++) {
+        Range<size_t> const r = chunk(uint32_t(job));
+        ones  |= scans[job].ones;
+        zeros |= scans[job].zeros;
+        sorted &= scans[job].sorted;
+        sorted &= (job == 0) || r.empty() || !(commands[r.first].key < commands[r.first - 1].key);
+    }
+    if (sorted) {
+        return;
+    }
+    // always do at least one pass, so that SENTINEL commands end-up last
+    const CommandKey varying = (ones & zeros) ? (ones & zeros) : 1;
+
+    T* src = commands;
+    T* dst = scratch;
+    for (size_t shift = 0; shift < 64; shift += 8) {
+        if (!((varying >> shift) & 0xFF)) {
+            // this byte is the same for all keys (except sentinels)
+            continue;
+        }
+
+        auto bucket = [shift](CommandKey key) -> size_t {
+            return key == CommandKey(Pass::SENTINEL) ? 256 : size_t((key >> shift) & 0xFF);
+        };
+
+        auto histogram = [&](uint32_t job) {
+            Range<size_t> const r = chunk(job);
+            uint32_t* const UTILS_RESTRICT h = histograms[job];
+            std::fill_n(h, RADIX_SORT_BUCKET_COUNT, 0);
+            for (size_t i = r.first; i < r.last; i++) {
+                h[bucket(src[i].key)]++;
+            }
+        };
+        dispatch(histogram);
+
+        // turn the histograms into destination offsets (all jobs for bucket 0 first, etc...)
+        uint32_t offset = 0;
+        for (size_t b = 0; b < RADIX_SORT_BUCKET_COUNT; b++) {
+            for (size_t job = 0; job < jobCount; job++) {
+                const uint32_t n = histograms[job][b];
+                histograms[job][b] = offset;
+                offset += n;
+            }
+        }
+
+        auto scatter = [&](uint32_t job) {
+            Range<size_t> const r = chunk(job);
+            uint32_t* const UTILS_RESTRICT offsets = histograms[job];
+            for (size_t i = r.first; i < r.last; i++) {
+                dst[offsets[bucket(src[i].key)]++] = src[i];
+            }
+        };
+        dispatch(scatter);
+
+        std::swap(src, dst);
+    }
+
+    if (src != commands) {
+        auto copy = [&](uint32_t job) {
+            Range<size_t> const r = chunk(job);
+            std::copy(src + r.first, src + r.last, commands + r.first);
+        };
+        dispatch(copy);
+    }
 }
 
-UTILS_NOINLINE // no need to be inlined
-void RenderPass::recordDriverCommands(
-        FEngine::DriverApi& UTILS_RESTRICT driver,  // using restrict here is very important
-        Slice<Command> const& commands) noexcept {
+/*
+ * Consecutive sorted commands that draw the same primitive with the same material instance,
+ * variant and raster state, only differ by their per-renderable uniforms. Such runs are drawn
+ * with a single instanced draw call, using the instancing variant of the material, which reads
+ * each instance's transforms from an array (see createInstanceBuffers()).
+ *
+ * With multiDraw, runs extend to commands drawing other primitives that use the same vertex and
+ * index buffers, e.g.: static geometry merged into shared buffers. These batches are drawn with a
+ * single indirect draw call, where each draw's base instance is the index of its transforms.
+ *
+ * The first command of a run records the size of the run, the other commands are left as-is,
+ * so they can still be drawn individually if needed. Skinned renderables are never instanced,
+ * since the bones are per-renderable.
+ */
+UTILS_NOINLINE
+void RenderPass::instanceCommands(Command* const commands, size_t count,
+        FScene::RenderableSoa const& soa, bool multiDraw) noexcept {
     SYSTRACE_CALL();
 
-    if (!commands.empty()) {
-        FMaterialInstance const* UTILS_RESTRICT previousMi = nullptr;
-        FMaterial const* UTILS_RESTRICT ma = nullptr;
-        Command const* UTILS_RESTRICT c;
-        for (c = commands.cbegin(); c->key != -1LLU; ++c) {
-            /*
-             * Be careful when changing code below, this is the hot inner-loop
-             */
-
-            // per-renderable uniform
-            PrimitiveInfo const& UTILS_RESTRICT info = c->primitive;
-            driver.bindUniforms(BindingPoints::PER_RENDERABLE, info.perRenderableUniforms);
-            if (info.perRenderableBones) {
-                driver.bindUniforms(BindingPoints::PER_RENDERABLE_BONES, info.perRenderableBones);
+    auto canBeInstanced = [](PrimitiveInfo const& info) -> bool {
+        return !info.perRenderableBones &&
+               info.mi->getMaterial()->isInstancingSupported();
+    };
+
+    auto isSameDraw = [](PrimitiveInfo const& lhs, PrimitiveInfo const& rhs) -> bool {
+        return lhs.mi == rhs.mi &&
+               lhs.primitiveHandle.getId() == rhs.primitiveHandle.getId() &&
+               lhs.materialVariant.key == rhs.materialVariant.key &&
+               lhs.rasterState == rhs.rasterState &&
+               !rhs.perRenderableBones;
+    };
+
+    auto isSameBatch = [&soa](PrimitiveInfo const& lhs, PrimitiveInfo const& rhs) -> bool {
+        if (lhs.mi != rhs.mi ||
+            lhs.materialVariant.key != rhs.materialVariant.key ||
+            lhs.rasterState != rhs.rasterState ||
+            rhs.perRenderableBones) {
+            return false;
+        }
+        FRenderPrimitive const* const UTILS_RESTRICT l = getPrimitive(soa, lhs);
+        FRenderPrimitive const* const UTILS_RESTRICT r = getPrimitive(soa, rhs);
+        return l->getVertexBufferHandle().getId() == r->getVertexBufferHandle().getId() &&
+               l->getIndexBufferHandle().getId() == r->getIndexBufferHandle().getId() &&
+               l->getPrimitiveType() == r->getPrimitiveType() &&
+               l->getEnabledAttributes() == r->getEnabledAttributes();
+    };
+
+    Command* const last = commands + count;
+    Command* UTILS_RESTRICT c = commands;
+    while (c != last && c->key != CommandKey(Pass::SENTINEL)) {
+        Command* UTILS_RESTRICT e = c + 1;
+        bool batch = false;
+        if (canBeInstanced(c->primitive)) {
+            Command const* const end = c + std::min(size_t(last - c), CONFIG_MAX_INSTANCES);
+            while (e != end && e->key != CommandKey(Pass::SENTINEL)) {
+                if (!isSameDraw(c->primitive, e->primitive)) {
+                    if (!multiDraw || !isSameBatch(c->primitive, e->primitive)) {
+                        break;
+                    }
+                    batch = true;
+                }
+                ++e;
             }
+        }
+        c->primitive.instanceCount = uint16_t(e - c);
+        c->primitive.multiDraw = batch;
+        c = e;
+    }
+}
 
-            FMaterialInstance const* const UTILS_RESTRICT mi = info.mi;
-            if (UTILS_UNLIKELY(mi != previousMi)) {
-                // this is always taken the first time
-                previousMi = mi;
-                mi->use(driver);
-                ma = mi->getMaterial();
+UTILS_NOINLINE // no need to be inlined
+void RenderPass::updateDrawStatistics(FEngine::DrawStatistics& statistics,
+        FScene::RenderableSoa const& soa, Slice<Command> const& commands,
+        bool instancing) noexcept {
+    if (commands.empty()) {
+        return;
+    }
+    uint32_t drawCount = 0;
+    uint32_t triangleCount = 0;
+    // walks the commands like recordDriverCommandsRange()
+    for (Command const* c = commands.cbegin(); c != commands.cend() && c->key != -1LLU; ) {
+        const uint32_t instanceCount =
+                (instancing && c->primitive.instanceCount > 1) ? c->primitive.instanceCount : 1u;
+        for (uint32_t i = 0; i < instanceCount; i++) {
+            FRenderPrimitive const* const primitive = getPrimitive(soa, c[i].primitive);
+            if (primitive->getPrimitiveType() == PrimitiveType::TRIANGLES) {
+                triangleCount += primitive->getIndexCount() / 3;
             }
+        }
+        drawCount++;
+        c += instanceCount;
+    }
+    statistics.drawCount += drawCount;
+    statistics.triangleCount += triangleCount;
+}
+
+FRenderPrimitive const* RenderPass::getPrimitive(
+        FScene::RenderableSoa const& soa, PrimitiveInfo const& info) noexcept {
+    // renderables only have a few primitives
+    Slice<FRenderPrimitive> const& primitives = soa.data<FScene::PRIMITIVES>()[info.index];
+    FRenderPrimitive const* primitive = primitives.cbegin();
+    while (primitive->getHwHandle().getId() != info.primitiveHandle.getId()) {
+        ++primitive;
+        assert(primitive != primitives.cend());
+    }
+    return primitive;
+}
+
+UTILS_NOINLINE
+Slice<const RenderPass::InstanceBuffer> RenderPass::createInstanceBuffers(
+        FEngine& engine, ArenaScope& arena, FScene::RenderableSoa const& soa,
+        Slice<Command> const& commands, float4 const* planes) noexcept {
+    SYSTRACE_CALL();
 
-            Handle<HwProgram> const ph = ma->getProgram(info.materialVariant.key);
-            driver.draw(ph, info.rasterState, info.primitiveHandle);
+    if (commands.empty()) {
+        return {};
+    }
+
+    size_t count = 0;
+    for (Command const* c = commands.cbegin(); c != commands.cend() && c->key != -1LLU;
+            c += c->primitive.instanceCount) {
+        count += c->primitive.instanceCount > 1;
+    }
+
+    InstanceBuffer* const buffers = count ? arena.allocate<InstanceBuffer>(count) : nullptr;
+    if (!buffers) {
+        // either there is nothing to instance, or we're out of memory, in which case all
+        // commands are drawn individually.
+        return {};
+    }
+
+    using InstancesUib = FEngine::PerRenderableInstancesUib;
+    using PerRenderableUib = FEngine::PerRenderableUib;
+    constexpr size_t TRANSFORM_SIZE = sizeof(InstancesUib::worldFromModelMatrix[0]);
+    constexpr size_t NORMAL_MATRIX_SIZE = sizeof(InstancesUib::worldFromModelNormalMatrix[0]);
+
+    FEngine::DriverApi& driver = engine.getDriverApi();
+    FRenderableManager const& rcm = engine.getRenderableManager();
+    auto const* const UTILS_RESTRICT soaInstance = soa.data<FScene::RENDERABLE_INSTANCE>();
+    auto const* const UTILS_RESTRICT soaWorldAABBCenter = soa.data<FScene::WORLD_AABB_CENTER>();
+    auto const* const UTILS_RESTRICT soaWorldAABBExtent = soa.data<FScene::WORLD_AABB_EXTENT>();
+    const size_t size = engine.getPerRenderableInstancesUib().getSize();
+
+    InstanceBuffer* UTILS_RESTRICT buffer = buffers;
+    for (Command const* c = commands.cbegin(); c != commands.cend() && c->key != -1LLU;
+            c += c->primitive.instanceCount) {
+        const size_t instanceCount = c->primitive.instanceCount;
+        if (instanceCount > 1) {
+            // transforms are copied from each renderable's uniform buffer, which is up-to-date,
+            // straight into the command stream
+            buffer->ubh = driver.createUniformBuffer(size);
+            char* const UTILS_RESTRICT transforms = static_cast<char*>(
+                    driver.allocate(TRANSFORM_SIZE * instanceCount, 16));
+            char* const UTILS_RESTRICT normalMatrices = static_cast<char*>(
+                    driver.allocate(NORMAL_MATRIX_SIZE * instanceCount, 16));
+            for (size_t i = 0; i < instanceCount; i++) {
+                char const* const src = static_cast<char const*>(
+                        rcm.getUniformBuffer(soaInstance[c[i].primitive.index]).getBuffer());
+                memcpy(transforms + i * TRANSFORM_SIZE,
+                        src + offsetof(PerRenderableUib, worldFromModelMatrix), TRANSFORM_SIZE);
+                memcpy(normalMatrices + i * NORMAL_MATRIX_SIZE,
+                        src + offsetof(PerRenderableUib, worldFromModelNormalMatrix), NORMAL_MATRIX_SIZE);
+            }
+            driver.loadUniformBuffer(buffer->ubh, transforms,
+                    offsetof(InstancesUib, worldFromModelMatrix),
+                    uint32_t(TRANSFORM_SIZE * instanceCount));
+            driver.loadUniformBuffer(buffer->ubh, normalMatrices,
+                    offsetof(InstancesUib, worldFromModelNormalMatrix),
+                    uint32_t(NORMAL_MATRIX_SIZE * instanceCount));
+
+            // the draws of a batch index the transforms with their base instance, consecutive
+            // commands drawing the same primitive are merged into instanced draws, unless each
+            // renderable is culled on its own
+            buffer->draws = nullptr;
+            buffer->drawCount = 0;
+            buffer->planes = nullptr;
+            buffer->bounds = nullptr;
+            if (c->primitive.multiDraw || planes) {
+                Driver::DrawIndirectCommand* const UTILS_RESTRICT draws =
+                        driver.allocatePod<Driver::DrawIndirectCommand>(instanceCount);
+                Driver::DrawBounds* const UTILS_RESTRICT bounds =
+                        planes ? driver.allocatePod<Driver::DrawBounds>(instanceCount) : nullptr;
+                uint32_t drawCount = 0;
+                for (size_t i = 0; i < instanceCount; i++) {
+                    if (!planes && i && c[i].primitive.primitiveHandle.getId() ==
+                                        c[i - 1].primitive.primitiveHandle.getId()) {
+                        draws[drawCount - 1].instanceCount++;
+                        continue;
+                    }
+                    FRenderPrimitive const* const primitive = getPrimitive(soa, c[i].primitive);
+                    if (bounds) {
+                        Driver::DrawBounds& box = bounds[drawCount];
+                        box.center = soaWorldAABBCenter[c[i].primitive.index];
+                        box.halfExtent = soaWorldAABBExtent[c[i].primitive.index];
+                    }
+                    Driver::DrawIndirectCommand& draw = draws[drawCount++];
+                    draw.count = primitive->getIndexCount();
+                    draw.instanceCount = 1;
+                    draw.firstIndex = primitive->getIndexOffset();
+                    draw.baseVertex = 0;
+                    draw.baseInstance = uint32_t(i);
+                }
+                buffer->draws = draws;
+                buffer->drawCount = drawCount;
+                buffer->planes = planes;
+                buffer->bounds = bounds;
+            }
+            ++buffer;
         }
+    }
+    return { buffers, buffers + count };
+}
+
+/*
+ * Recording the driver commands is the last part of a pass running on the main thread, so large
+ * passes are split in chunks recorded in parallel. Each chunk gets its own range of the command
+ * stream, which it ends with a jump to the next chunk. The ranges are sized upfront from the
+ * commands they'll record, which slightly overestimates the space needed because the material
+ * instances are assumed to bind all their state. The unused space is skipped by the jumps.
+ */
+UTILS_NOINLINE // no need to be inlined
+void RenderPass::recordDriverCommands(
+        FEngine::DriverApi& driver, JobSystem& js, ArenaScope& arena,
+        Slice<Command> const& commands,
+        PerRenderableUniforms const& uniforms,
+        Slice<const InstanceBuffer> const& instanceBuffers,
+        JobSystem::Job* background) noexcept {
+    SYSTRACE_CALL();
+    PhaseProfiler::Scope profile(PhaseProfiler::RECORD);
 
-        SYSTRACE_VALUE32("commandCount", c - commands.cbegin());
+    if (commands.empty()) {
+        return;
     }
+
+    // without instance buffers, all commands are drawn individually
+    const bool instancing = !instanceBuffers.empty();
+
+    if (commands.size() < RECORD_PARALLEL_MIN_COMMANDS_COUNT) {
+        Command const* const last = recordDriverCommandsRange(driver,
+                commands.cbegin(), commands.cend(), uniforms, instanceBuffers.cbegin(), instancing);
+        SYSTRACE_VALUE32("commandCount", last - commands.cbegin());
+        return;
+    }
+
+    using CS = CommandStream;
+    constexpr size_t NOOP_SIZE = CommandBase::align(sizeof(NoopCommand));
+    constexpr size_t BIND_SIZE =
+            CS::commandSize<decltype(&Driver::bindUniforms), &Driver::bindUniforms>();
+    constexpr size_t BIND_RANGE_SIZE =
+            CS::commandSize<decltype(&Driver::bindUniformsRange), &Driver::bindUniformsRange>();
+    constexpr size_t BIND_SAMPLERS_SIZE =
+            CS::commandSize<decltype(&Driver::bindSamplers), &Driver::bindSamplers>();
+    constexpr size_t DRAW_SIZE = std::max(BIND_SIZE, BIND_RANGE_SIZE) + std::max(
+            CS::commandSize<decltype(&Driver::draw), &Driver::draw>(),
+            CS::commandSize<decltype(&Driver::drawIndirect), &Driver::drawIndirect>());
+    // bones, morph weights and morph targets, see recordDriverCommandsRange()
+    constexpr size_t SKINNING_SIZE = BIND_RANGE_SIZE + BIND_SIZE + BIND_SAMPLERS_SIZE;
+    // see FMaterialInstance::use()
+    constexpr size_t USE_SIZE = BIND_SIZE + BIND_SAMPLERS_SIZE +
+            CS::commandSize<decltype(&Driver::setViewportScissor), &Driver::setViewportScissor>();
+
+    struct Chunk {
+        Command const* first;
+        InstanceBuffer const* instanceBuffer;
+        size_t offset;      // in the reserved range
+    };
+
+    // The chunks can't split an instanced draw, so each of them is a bit larger than
+    // chunkSize, which guarantees there are at most RECORD_MAX_JOBS of them. The chunk after
+    // the last one marks the end of the range. They're in the arena, the jobs may outlive this
+    // function.
+    Chunk* const chunks = arena.allocate<Chunk>(RECORD_MAX_JOBS + 1);
+    const size_t chunkSize = std::max(RECORD_JOB_MIN_COMMANDS_COUNT,
+            (commands.size() + RECORD_MAX_JOBS - 1) / RECORD_MAX_JOBS);
+
+    size_t count = 0;
+    size_t offset = 0;
+    FMaterialInstance const* UTILS_RESTRICT previousMi = nullptr;
+    InstanceBuffer const* UTILS_RESTRICT instanceBuffer = instanceBuffers.cbegin();
+    Command const* UTILS_RESTRICT c = commands.cbegin();
+    chunks[0] = { c, instanceBuffer, 0 };
+    while (c != commands.cend() && c->key != -1LLU) {
+        if (size_t(c - chunks[count].first) >= chunkSize) {
+            assert(count + 1 < RECORD_MAX_JOBS);
+            offset += NOOP_SIZE;
+            chunks[++count] = { c, instanceBuffer, offset };
+            // each chunk starts by using its material instance
+            previousMi = nullptr;
+        }
+
+        PrimitiveInfo const& UTILS_RESTRICT info = c->primitive;
+        Variant variant = info.materialVariant;
+        uint32_t instanceCount = 1;
+        if (UTILS_UNLIKELY(instancing && info.instanceCount > 1)) {
+            instanceCount = info.instanceCount;
+            variant.setInstancing(true);
+            ++instanceBuffer;
+        }
+        offset += DRAW_SIZE;
+        if (info.perRenderableBones) {
+            offset += SKINNING_SIZE;
+        }
+        if (UTILS_UNLIKELY(info.mi != previousMi)) {
+            previousMi = info.mi;
+            offset += USE_SIZE;
+        }
+
+        // Programs are created lazily, which can only be done here. The jobs below only get
+        // the cached programs.
+        info.mi->getMaterial()->prepareProgram(variant.key);
+
+        c += instanceCount;
+    }
+    offset += NOOP_SIZE;
+    chunks[++count] = { c, instanceBuffer, offset };
+
+    char* const UTILS_RESTRICT base = static_cast<char*>(driver.reserve(offset));
+
+    auto work = [&driver, &uniforms, chunks, base, instancing](uint32_t start, uint32_t n) {
+        PhaseProfiler::Scope profile(PhaseProfiler::RECORD);
+        for (uint32_t i = start; i < start + n; i++) {
+            Chunk const& chunk = chunks[i];
+            char* const end = base + chunks[i + 1].offset;
+            CircularBuffer buffer(base + chunk.offset, size_t(end - (base + chunk.offset)));
+            CommandStream stream(driver, buffer);
+            recordDriverCommandsRange(stream, chunk.first, chunks[i + 1].first, uniforms,
+                    chunk.instanceBuffer, instancing);
+            // jump to the next chunk, or back to the main stream after the last one
+            new(buffer.allocate(sizeof(NoopCommand))) NoopCommand(end);
+            assert(buffer.getHead() <= end);
+        }
+    };
+
+    SYSTRACE_VALUE32("commandCount", c - commands.cbegin());
+
+    if (background) {
+        auto* const w = arena.make<decltype(work)>(work);
+        js.run(jobs::parallel_for(js, background, 0, uint32_t(count),
+                std::cref(*w), jobs::CountSplitter<1, 8>()));
+        return;
+    }
+
+    auto job = jobs::parallel_for(js, nullptr, 0, uint32_t(count),
+            std::cref(work), jobs::CountSplitter<1, 8>());
+    js.runAndWait(job);
+}
+
+UTILS_NOINLINE // no need to be inlined
+RenderPass::Command const* RenderPass::recordDriverCommandsRange(
+        FEngine::DriverApi& UTILS_RESTRICT driver,  // using restrict here is very important
+        Command const* first, Command const* last,
+        PerRenderableUniforms const& uniforms,
+        InstanceBuffer const* UTILS_RESTRICT instanceBuffer, bool instancing) noexcept {
+    FMaterialInstance const* UTILS_RESTRICT previousMi = nullptr;
+    FMaterial const* UTILS_RESTRICT ma = nullptr;
+    Command const* UTILS_RESTRICT c;
+    const Handle<HwUniformBuffer> ubh = uniforms.ubh;
+    const uint32_t stride = uniforms.stride;
+    const uint32_t size = uniforms.size;
+    for (c = first; c != last && c->key != -1LLU; ) {
+        /*
+         * Be careful when changing code below, this is the hot inner-loop
+         */
+
+        // per-renderable uniform
+        PrimitiveInfo const& UTILS_RESTRICT info = c->primitive;
+        Variant variant = info.materialVariant;
+        uint32_t instanceCount = 1;
+        InstanceBuffer const* UTILS_RESTRICT instances = nullptr;
+        if (UTILS_UNLIKELY(instancing && info.instanceCount > 1)) {
+            instanceCount = info.instanceCount;
+            variant.setInstancing(true);
+            instances = instanceBuffer++;
+            driver.bindUniforms(BindingPoints::PER_RENDERABLE, instances->ubh);
+        } else {
+            driver.bindUniformsRange(BindingPoints::PER_RENDERABLE, ubh, info.index * stride, size);
+        }
+        if (info.perRenderableBones) {
+            // the bones can be a range of a buffer shared with other renderables
+            driver.bindUniformsRange(BindingPoints::PER_RENDERABLE_BONES, info.perRenderableBones,
+                    info.bonesOffset, CONFIG_MAX_BONE_COUNT * sizeof(RenderableManager::Bone));
+            // the skinning variant also morphs, renderables without morph targets get buffers
+            // with no weights
+            driver.bindUniforms(BindingPoints::PER_RENDERABLE_MORPHING,
+                    uniforms.morphingUbh[info.index]);
+            driver.bindSamplers(BindingPoints::PER_RENDERABLE_MORPHING,
+                    uniforms.morphTargetsSbh[info.index]);
+        }
+
+        FMaterialInstance const* const UTILS_RESTRICT mi = info.mi;
+        if (UTILS_UNLIKELY(mi != previousMi)) {
+            // this is always taken the first time
+            previousMi = mi;
+            mi->use(driver);
+            ma = mi->getMaterial();
+        }
+
+        Handle<HwProgram> const ph = ma->getProgram(variant.key);
+        if (UTILS_UNLIKELY(instances && instances->draws)) {
+            driver.drawIndirect(ph, info.rasterState, info.primitiveHandle,
+                    instances->draws, instances->drawCount, instances->planes, instances->bounds);
+        } else {
+            driver.draw(ph, info.rasterState, info.primitiveHandle, instanceCount);
+        }
+        c += instanceCount;
+    }
+    return c;
 }
 
 /* static */
+template<bool prepass>
 UTILS_ALWAYS_INLINE // this function exists only to make the code more readable. we want it inlined.
 inline              // and we don't need it in the compilation unit
 void RenderPass::setupColorCommand(Command& cmdDraw, bool hasDepthPass,
@@ -176,6 +898,11 @@ void RenderPass::setupColorCommand(Command& cmdDraw, bool hasDepthPass,
     cmdDraw.primitive.mi = mi;
     cmdDraw.primitive.materialVariant.key = variant;
 
+    // Without a depth pre-pass, the depth writes are left as the material set them.
+    if (!prepass) {
+        return;
+    }
+
     // Code below is branch-less with clang.
 
     bool skipDepthWrite = hasDepthPass &
@@ -198,7 +925,7 @@ void RenderPass::setupColorCommand(Command& cmdDraw, bool hasDepthPass,
 UTILS_NOINLINE
 void RenderPass::generateCommands(uint32_t commandTypeFlags, Command* const commands,
         FScene::RenderableSoa const& soa, utils::Range<uint32_t> range, RenderFlags renderFlags,
-        math::float3 cameraPosition, math::float3 cameraForward) noexcept {
+        uint32_t visibilityMask, math::float3 cameraPosition, math::float3 cameraForward) noexcept {
 
     // generateCommands() writes both the draw and depth commands simultaneously such that
     // we go throw the list of renderables just once.
@@ -231,17 +958,22 @@ void RenderPass::generateCommands(uint32_t commandTypeFlags, Command* const comm
 
     switch (commandTypeFlags) {
         default: // squash IDE warning -- should never happen.
+            assert(false);
         case CommandTypeFlags::COLOR:
             generateCommandsImpl<CommandTypeFlags::COLOR>(commandTypeFlags, curr,
-                    soa, range, renderFlags, cameraPosition, cameraForward);
+                    soa, range, renderFlags, visibilityMask, cameraPosition, cameraForward);
+            break;
+        case CommandTypeFlags::DEPTH:
+            generateCommandsImpl<CommandTypeFlags::DEPTH>(commandTypeFlags, curr,
+                    soa, range, renderFlags, visibilityMask, cameraPosition, cameraForward);
             break;
         case CommandTypeFlags::DEPTH_AND_COLOR:
             generateCommandsImpl<CommandTypeFlags::DEPTH_AND_COLOR>(commandTypeFlags, curr,
-                    soa, range, renderFlags, cameraPosition, cameraForward);
+                    soa, range, renderFlags, visibilityMask, cameraPosition, cameraForward);
             break;
         case CommandTypeFlags::SHADOW:
             generateCommandsImpl<CommandTypeFlags::SHADOW>(commandTypeFlags, curr,
-                    soa, range, renderFlags, cameraPosition, cameraForward);
+                    soa, range, renderFlags, visibilityMask, cameraPosition, cameraForward);
             break;
     }
 }
@@ -252,7 +984,7 @@ UTILS_NOINLINE
 void RenderPass::generateCommandsImpl(uint32_t,
         Command* UTILS_RESTRICT curr,
         FScene::RenderableSoa const& UTILS_RESTRICT soa, utils::Range<uint32_t> range,
-        RenderFlags renderFlags,
+        RenderFlags renderFlags, uint32_t visibilityMask,
         float3 cameraPosition, float3 cameraForward) noexcept {
 
     // generateCommands() writes both the draw and depth commands simultaneously such that
@@ -260,17 +992,27 @@ void RenderPass::generateCommandsImpl(uint32_t,
     // (in principle, we could have split this method into two, at the cost of going through
     // the list twice)
 
-    const bool colorPass  = bool(commandTypeFlags & CommandTypeFlags::COLOR);
-    const bool depthPass  = bool(commandTypeFlags & (CommandTypeFlags::DEPTH | CommandTypeFlags::SHADOW));
-    const bool shadowPass = bool(commandTypeFlags & CommandTypeFlags::SHADOW);
+    // Each instantiation only keeps the code of its pass: depth-only, shadow, or color with or
+    // without a depth pre-pass. The branches on these are resolved at compile time.
+    constexpr bool colorPass  = bool(commandTypeFlags & CommandTypeFlags::COLOR);
+    constexpr bool depthPass  = bool(commandTypeFlags & (CommandTypeFlags::DEPTH | CommandTypeFlags::SHADOW));
+    constexpr bool shadowPass = bool(commandTypeFlags & CommandTypeFlags::SHADOW);
+    constexpr bool prepass    = colorPass && depthPass;
 
     auto const* const UTILS_RESTRICT soaWorldAABBCenter = soa.data<FScene::WORLD_AABB_CENTER>();
     auto const* const UTILS_RESTRICT soaVisibility      = soa.data<FScene::VISIBILITY_STATE>();
     auto const* const UTILS_RESTRICT soaPrimitives      = soa.data<FScene::PRIMITIVES>();
-    auto const* const UTILS_RESTRICT soaUbh             = soa.data<FScene::UBH>();
     auto const* const UTILS_RESTRICT soaBonesUbh        = soa.data<FScene::BONES_UBH>();
+    auto const* const UTILS_RESTRICT soaBonesOffset     = soa.data<FScene::BONES_OFFSET>();
+    auto const* const UTILS_RESTRICT soaVisibleMask     = soa.data<FScene::VISIBLE_MASK>();
+    auto const* const UTILS_RESTRICT soaSpotShadowMask  = soa.data<FScene::SPOT_SHADOW_MASK>();
+    auto const* const UTILS_RESTRICT soaScreenCoverage  = soa.data<FScene::SCREEN_COVERAGE>();
 
     const bool hasShadowing = renderFlags & HAS_SHADOWING;
+    const bool automaticPrepass = prepass && (renderFlags & DEPTH_PREPASS_AUTOMATIC);
+    const bool materialFirst = renderFlags & SORT_MATERIAL_FIRST;
+    const bool frontToBack = renderFlags & SORT_FRONT_TO_BACK;
+    const bool orderIndependentTransparency = renderFlags & HAS_ORDER_INDEPENDENT_TRANSPARENCY;
     Variant materialVariant;
     materialVariant.setDirectionalLighting(renderFlags & HAS_DIRECTIONAL_LIGHT);
     materialVariant.setDynamicLighting(renderFlags & HAS_DYNAMIC_LIGHTING);
@@ -278,13 +1020,7 @@ void RenderPass::generateCommandsImpl(uint32_t,
 
     Command cmdColor;
 
-    Command cmdDepth;
-    cmdDepth.primitive.materialVariant = { Variant::DEPTH_VARIANT };
-    cmdDepth.primitive.rasterState = Driver::RasterState();
-    cmdDepth.primitive.rasterState.colorWrite = false;
-    cmdDepth.primitive.rasterState.depthWrite = true;
-    cmdDepth.primitive.rasterState.depthFunc = Driver::RasterState::DepthFunc::L;
-    cmdDepth.primitive.rasterState.alphaToCoverage = false;
+    Command cmdDepth = makeDepthCommand();
 
     for (uint32_t i = range.first; i < range.last; ++i) {
         // Signed distance from camera to object's center. Positive distances are in front of
@@ -317,23 +1053,38 @@ void RenderPass::generateCommandsImpl(uint32_t,
         distance = -distance;
         const uint32_t distanceBits = reinterpret_cast<uint32_t&>(distance);
 
-        cmdColor.key = makeField(soaVisibility[i].priority, PRIORITY_MASK, PRIORITY_SHIFT);
-        cmdColor.primitive.perRenderableUniforms = soaUbh[i];
-        cmdColor.primitive.perRenderableBones = soaBonesUbh[i];
-        materialVariant.setShadowReceiver(soaVisibility[i].receiveShadows & hasShadowing);
-        materialVariant.setSkinning(soaVisibility[i].skinning);
+        if (colorPass) {
+            cmdColor.key = makeField(soaVisibility[i].priority, PRIORITY_MASK, PRIORITY_SHIFT);
+            cmdColor.primitive.perRenderableBones = soaBonesUbh[i];
+            cmdColor.primitive.bonesOffset = soaBonesOffset[i];
+            cmdColor.primitive.index = i;
+            materialVariant.setShadowReceiver(soaVisibility[i].receiveShadows & hasShadowing);
+            materialVariant.setSkinning(soaVisibility[i].skinning);
+        }
 
-        // we're assuming we're always doing the depth (either way, it's correct)
-        // this will generate front to back rendering
-        cmdDepth.key = uint64_t(Pass::DEPTH);
-        cmdDepth.key |= makeField(soaVisibility[i].priority, PRIORITY_MASK, PRIORITY_SHIFT);
-        cmdDepth.key |= makeField(distanceBits, DISTANCE_BITS_MASK, DISTANCE_BITS_SHIFT);
-        cmdDepth.primitive.perRenderableUniforms = soaUbh[i];
-        cmdDepth.primitive.perRenderableBones = soaBonesUbh[i];
-        cmdDepth.primitive.materialVariant.setSkinning(soaVisibility[i].skinning);
+        if (depthPass) {
+            // this will generate front to back rendering
+            cmdDepth.key = uint64_t(Pass::DEPTH);
+            cmdDepth.key |= makeField(soaVisibility[i].priority, PRIORITY_MASK, PRIORITY_SHIFT);
+            cmdDepth.key |= makeField(distanceBits, DISTANCE_BITS_MASK, DISTANCE_BITS_SHIFT);
+            cmdDepth.primitive.perRenderableBones = soaBonesUbh[i];
+            cmdDepth.primitive.bonesOffset = soaBonesOffset[i];
+            cmdDepth.primitive.index = i;
+            cmdDepth.primitive.materialVariant.setSkinning(soaVisibility[i].skinning);
+        }
 
-        const bool shadowCaster = soaVisibility[i].castShadows & hasShadowing;
-        const bool writeDepthForShadows = shadowPass & shadowCaster;
+        // the shadow casters are only looked at by the shadow pass
+        const bool writeDepthForShadows = shadowPass &&
+                (soaVisibility[i].castShadows & hasShadowing);
+        // in a shadow pass, renderables which aren't in this shadow map are skipped entirely
+        const bool skipShadowCaster = shadowPass && !FView::isInShadowMap(
+                FView::getShadowCasterMask(soaVisibleMask[i], soaSpotShadowMask[i],
+                        soaVisibility[i].staticShadowCaster), visibilityMask);
+
+        // with an automatic depth pre-pass, only the renderables covering a large part of the
+        // viewport are likely to hide enough of the others to be worth drawing twice
+        const bool largeOccluder = !automaticPrepass ||
+                (soaScreenCoverage[i] > DEPTH_PREPASS_MIN_COVERAGE);
 
         const Slice<FRenderPrimitive>& primitives = soaPrimitives[i];
 
@@ -343,13 +1094,51 @@ void RenderPass::generateCommandsImpl(uint32_t,
          */
         for (auto const& primitive : primitives) {
             FMaterialInstance const* const mi = primitive.getMaterialInstance();
+
+            // ...and unlit materials are cheap enough to be shaded where they're hidden
+            const bool hasDepthPass = depthPass &&
+                    (!automaticPrepass || (largeOccluder & mi->getMaterial()->isVariantLit()));
+
             if (colorPass) {
                 cmdColor.primitive.primitiveHandle = primitive.getHwHandle();
                 cmdColor.primitive.materialVariant = materialVariant;
-                RenderPass::setupColorCommand(cmdColor, depthPass, mi);
+                RenderPass::setupColorCommand<prepass>(cmdColor, hasDepthPass, mi);
 
                 const bool blendPass = Pass(cmdColor.key & PASS_MASK) == Pass::BLENDED;
-                if (blendPass) {
+                const TransparencyMode mode = mi->getMaterial()->getTransparencyMode();
+                // additive blending is order-independent already
+                const bool orderIndependent = blendPass && orderIndependentTransparency &&
+                        mode == TransparencyMode::ORDER_INDEPENDENT &&
+                        mi->getMaterial()->getBlendingMode() != BlendingMode::ADD;
+                if (orderIndependent) {
+                    // order-independent transparency: sorted by material instead of distance,
+                    // each primitive is drawn once in each layer, which doesn't write depth
+                    // (see FRenderer::OitPass)
+                    cmdColor.key &= PRIORITY_MASK;
+                    cmdColor.key |= uint64_t(Pass::ORDER_INDEPENDENT);
+                    cmdColor.key |= mi->getSortingKey();
+                    cmdColor.key |= makeField(cmdColor.primitive.materialVariant.key,
+                            MATERIAL_VARIANT_KEY_MASK, MATERIAL_VARIANT_KEY_SHIFT);
+
+                    Driver::RasterState& rs = cmdColor.primitive.rasterState;
+                    rs.depthWrite = false;
+
+                    // accumulation layer: sums of the premultiplied colors and of the alphas
+                    rs.blendFunctionSrcRGB   = BlendFunction::ONE;
+                    rs.blendFunctionSrcAlpha = BlendFunction::ONE;
+                    rs.blendFunctionDstRGB   = BlendFunction::ONE;
+                    rs.blendFunctionDstAlpha = BlendFunction::ONE;
+                    *curr = cmdColor;
+                    curr->key |= select(primitive.getPrimitiveType() == PrimitiveType::NONE);
+                    ++curr;
+
+                    // revealage layer: product of the transparencies
+                    cmdColor.key |= makeField(1, BLENDING_MASK, BLENDING_SHIFT);
+                    rs.blendFunctionSrcRGB   = BlendFunction::ZERO;
+                    rs.blendFunctionSrcAlpha = BlendFunction::ZERO;
+                    rs.blendFunctionDstRGB   = BlendFunction::ONE_MINUS_SRC_ALPHA;
+                    rs.blendFunctionDstAlpha = BlendFunction::ONE_MINUS_SRC_ALPHA;
+                } else if (blendPass) {
                     // TODO: at least for transparent objects, AABB should be per primitive
                     // blend pass:
                     // this will sort back-to-front for blended, and honor explicit ordering
@@ -361,8 +1150,6 @@ void RenderPass::generateCommandsImpl(uint32_t,
                     cmdColor.key |= makeField(primitive.getBlendOrder(),
                             BLEND_ORDER_MASK, BLEND_ORDER_SHIFT);
 
-                    const TransparencyMode mode = mi->getMaterial()->getTransparencyMode();
-
                     // handle transparent objects, two techniques:
                     //
                     //   - TWO_PASSES_ONE_SIDE: draw the front faces in the depth buffer then
@@ -386,8 +1173,10 @@ void RenderPass::generateCommandsImpl(uint32_t,
                     // handle the case where this primitive is empty / no-op
                     key |= select(primitive.getPrimitiveType() == PrimitiveType::NONE);
 
-                    // correct for TransparencyMode::DEFAULT -- i.e. cancel the command
-                    key |= select(mode == TransparencyMode::DEFAULT);
+                    // correct for TransparencyMode::DEFAULT -- i.e. cancel the command, which
+                    // ORDER_INDEPENDENT falls back to without order-independent transparency
+                    key |= select(mode == TransparencyMode::DEFAULT ||
+                                  mode == TransparencyMode::ORDER_INDEPENDENT);
 
                     *curr = cmdColor;
                     curr->key = key;
@@ -406,7 +1195,21 @@ void RenderPass::generateCommandsImpl(uint32_t,
                             SamplerCompareFunc::LE : cmdColor.primitive.rasterState.depthFunc;
                 } else {
                     // color pass, opaque objects...
-                    if (!depthPass) {
+                    // ...the background (i.e. the skybox) goes after all of them, so that the
+                    // pixels they cover are rejected by the depth test before it's shaded.
+                    cmdColor.key |= makeField(uint32_t(soaVisibility[i].background) << 2u,
+                            BLENDING_MASK, BLENDING_SHIFT);
+                    if (!hasDepthPass && frontToBack) {
+                        // ...without depth pre-pass, sorted front to back:
+                        // the whole distance is used, objects at the same distance are sorted
+                        // by material and variant (the top 16 bits of the material key).
+                        const uint64_t material = (cmdColor.key & MATERIAL_MASK) >> MATERIAL_SHIFT;
+                        cmdColor.key &= ~(MATERIAL_MASK | FRONT_TO_BACK_DISTANCE_MASK);
+                        cmdColor.key |= makeField(distanceBits, FRONT_TO_BACK_DISTANCE_MASK,
+                                FRONT_TO_BACK_DISTANCE_SHIFT);
+                        cmdColor.key |= makeField(material >> 16u, FRONT_TO_BACK_MATERIAL_MASK,
+                                FRONT_TO_BACK_MATERIAL_SHIFT);
+                    } else if (!hasDepthPass && !materialFirst) {
                         // ...without depth pre-pass:
                         // this will bucket objects by Z, front-to-back and then sort by material
                         // in each buckets. We use the top 10 bits of the distance, which
@@ -414,6 +1217,16 @@ void RenderPass::generateCommandsImpl(uint32_t,
                         cmdColor.key &= ~Z_BUCKET_MASK;
                         cmdColor.key |= makeField(distanceBits >> 22, Z_BUCKET_MASK,
                                 Z_BUCKET_SHIFT);
+                    } else if (!hasDepthPass) {
+                        // ...without depth pre-pass, sorted by material first:
+                        // this moves the material key above the same Z-bucket, so objects are
+                        // sorted front-to-back within each material instead.
+                        const uint64_t material = (cmdColor.key & MATERIAL_MASK) >> MATERIAL_SHIFT;
+                        cmdColor.key &= ~(MATERIAL_MASK | MATERIAL_FIRST_MASK);
+                        cmdColor.key |= makeField(material, MATERIAL_FIRST_MASK,
+                                MATERIAL_FIRST_SHIFT);
+                        cmdColor.key |= makeField(distanceBits >> 22, MATERIAL_FIRST_Z_BUCKET_MASK,
+                                MATERIAL_FIRST_Z_BUCKET_SHIFT);
                     }
                     // ...with depth pre-pass, we just sort by materials
                     curr->key = uint64_t(Pass::SENTINEL);
@@ -444,7 +1257,7 @@ void RenderPass::generateCommandsImpl(uint32_t,
                 bool issueDepth =
                         (rs.depthWrite & !(colorPass & (rs.alphaToCoverage | rs.hasBlending())))
                         | writeDepthForShadows;
-                curr->key |= select(!issueDepth);
+                curr->key |= select(!issueDepth | skipShadowCaster | !hasDepthPass);
 
                 // handle the case where this primitive is empty / no-op
                 curr->key |= select(primitive.getPrimitiveType() == PrimitiveType::NONE);
@@ -454,6 +1267,93 @@ void RenderPass::generateCommandsImpl(uint32_t,
     }
 }
 
+/* static */
+RenderPass::Command RenderPass::makeDepthCommand() noexcept {
+    Command cmdDepth;
+    cmdDepth.primitive.materialVariant = { Variant::DEPTH_VARIANT };
+    cmdDepth.primitive.rasterState = Driver::RasterState();
+    cmdDepth.primitive.rasterState.colorWrite = false;
+    cmdDepth.primitive.rasterState.depthWrite = true;
+    cmdDepth.primitive.rasterState.depthFunc = Driver::RasterState::DepthFunc::L;
+    cmdDepth.primitive.rasterState.alphaToCoverage = false;
+    return cmdDepth;
+}
+
+/* static */
+UTILS_NOINLINE
+void RenderPass::generateDepthCommands(DepthCommand* const commands,
+        FScene::RenderableSoa const& UTILS_RESTRICT soa, utils::Range<uint32_t> range,
+        RenderFlags renderFlags, uint32_t visibilityMask,
+        float3 cameraPosition, float3 cameraForward) noexcept {
+
+    // same as the depth commands of generateCommandsImpl<CommandTypeFlags::SHADOW>()
+
+    auto const* const UTILS_RESTRICT soaWorldAABBCenter = soa.data<FScene::WORLD_AABB_CENTER>();
+    auto const* const UTILS_RESTRICT soaVisibility      = soa.data<FScene::VISIBILITY_STATE>();
+    auto const* const UTILS_RESTRICT soaPrimitives      = soa.data<FScene::PRIMITIVES>();
+    auto const* const UTILS_RESTRICT soaVisibleMask     = soa.data<FScene::VISIBLE_MASK>();
+    auto const* const UTILS_RESTRICT soaSpotShadowMask  = soa.data<FScene::SPOT_SHADOW_MASK>();
+
+    const bool hasShadowing = renderFlags & HAS_SHADOWING;
+
+    DepthCommand* UTILS_RESTRICT curr = commands + FScene::getPrimitiveCount(soa, range.first);
+    for (uint32_t i = range.first; i < range.last; ++i) {
+        // negated distance to the camera plane, see generateCommandsImpl()
+        float distance = dot(cameraPosition, cameraForward) - dot(soaWorldAABBCenter[i], cameraForward);
+        const uint32_t distanceBits = reinterpret_cast<uint32_t&>(distance);
+
+        CommandKey key = uint64_t(Pass::DEPTH);
+        key |= makeField(soaVisibility[i].priority, PRIORITY_MASK, PRIORITY_SHIFT);
+        key |= makeField(distanceBits, DISTANCE_BITS_MASK, DISTANCE_BITS_SHIFT);
+
+        const bool writeDepthForShadows = soaVisibility[i].castShadows & hasShadowing;
+        const bool skipShadowCaster = !FView::isInShadowMap(
+                FView::getShadowCasterMask(soaVisibleMask[i], soaSpotShadowMask[i],
+                        soaVisibility[i].staticShadowCaster), visibilityMask);
+
+        const Slice<FRenderPrimitive>& primitives = soaPrimitives[i];
+        for (uint32_t j = 0, c = uint32_t(primitives.size()); j < c; j++) {
+            FRenderPrimitive const& primitive = primitives[j];
+            const bool depthWrite =
+                    primitive.getMaterialInstance()->getMaterial()->getRasterState().depthWrite;
+            curr->key = key;
+            curr->key |= select(!(depthWrite | writeDepthForShadows) | skipShadowCaster);
+            curr->key |= select(primitive.getPrimitiveType() == PrimitiveType::NONE);
+            curr->index = i;
+            curr->primitive = j;
+            ++curr;
+        }
+    }
+}
+
+/* static */
+UTILS_NOINLINE
+void RenderPass::expandDepthCommands(Command* UTILS_RESTRICT commands,
+        DepthCommand const* UTILS_RESTRICT depthCommands, size_t count,
+        FScene::RenderableSoa const& UTILS_RESTRICT soa) noexcept {
+    auto const* const UTILS_RESTRICT soaVisibility      = soa.data<FScene::VISIBILITY_STATE>();
+    auto const* const UTILS_RESTRICT soaPrimitives      = soa.data<FScene::PRIMITIVES>();
+    auto const* const UTILS_RESTRICT soaBonesUbh        = soa.data<FScene::BONES_UBH>();
+    auto const* const UTILS_RESTRICT soaBonesOffset     = soa.data<FScene::BONES_OFFSET>();
+
+    const Command cmdDepth = makeDepthCommand();
+    for (size_t k = 0; k < count; k++) {
+        const uint32_t i = depthCommands[k].index;
+        FRenderPrimitive const& primitive = soaPrimitives[i][depthCommands[k].primitive];
+        FMaterialInstance const* const mi = primitive.getMaterialInstance();
+        Command& cmd = commands[k];
+        cmd = cmdDepth;
+        cmd.key = depthCommands[k].key;
+        cmd.primitive.primitiveHandle = primitive.getHwHandle();
+        cmd.primitive.mi = mi;
+        cmd.primitive.rasterState.culling = mi->getMaterial()->getRasterState().culling;
+        cmd.primitive.materialVariant.setSkinning(soaVisibility[i].skinning);
+        cmd.primitive.perRenderableBones = soaBonesUbh[i];
+        cmd.primitive.bonesOffset = soaBonesOffset[i];
+        cmd.primitive.index = i;
+    }
+}
+
 void RenderPass::updateSummedPrimitiveCounts(
         FScene::RenderableSoa& renderableData, Range<uint32_t> vr) noexcept {
     auto const* const UTILS_RESTRICT primitives = renderableData.data<FScene::PRIMITIVES>();
@@ -472,21 +1372,29 @@ void RenderPass::updateSummedPrimitiveCounts(
 // inlining and devirtualization.
 // ------------------------------------------------------------------------------------------------
 
-FRenderer::ColorPass::ColorPass(const char* name,
-        JobSystem& js, JobSystem::Job* jobFroxelize,FView* view, Handle<HwRenderTarget> const rth)
-        : RenderPass(name), js(js), jobFroxelize(jobFroxelize), view(view), rth(rth) {
+FRenderer::ColorPass::ColorPass(const char* name, FEngine& engine,
+        JobSystem& js, JobSystem::Job* jobFroxelize,FView* view, Handle<HwRenderTarget> const rth,
+        TargetBufferFlags discardStart, TargetBufferFlags discardEnd,
+        Handle<HwProgram> subpassProgram, Eye eye)
+        : RenderPass(name), js(js), jobFroxelize(jobFroxelize), engine(engine), view(view),
+          rth(rth), discardStart(discardStart), discardEnd(discardEnd),
+          subpassProgram(subpassProgram), eye(eye) {
 }
 
 void FRenderer::ColorPass::beginRenderPass(
         driver::DriverApi& driver, Viewport const& viewport, const CameraInfo& camera) noexcept {
-    // wait for froxelization to finish
+    // wait for froxelization to finish, it was started from FRenderer::renderJob()
     // (this could even be a special command between the depth and color passes)
-    js.wait(jobFroxelize);
-    view->commitFroxels(driver);
+    if (eye != Eye::RIGHT) {
+        js.runAndWait(jobFroxelize);
+        view->commitFroxels(driver);
+    }
 
-    // We won't need the depth or stencil buffers after this pass.
+    // The frame graph knows which buffers are used before and after this pass, e.g. the depth
+    // buffer is kept for occlusion culling.
     RenderPassParams params = {};
-    params.discardEnd = TargetBufferFlags::DEPTH_AND_STENCIL;
+    params.discardStart = discardStart;
+    params.discardEnd = discardEnd;
     params.left = viewport.left;
     params.bottom = viewport.bottom;
     params.width = viewport.width;
@@ -494,21 +1402,24 @@ void FRenderer::ColorPass::beginRenderPass(
     params.clearColor = view->getClearColor();
     params.clearDepth = 1.0;
 
-    if (view->hasPostProcessPass()) {
+    if (eye == Eye::RIGHT) {
+        // the target was cleared by the left eye, which rendered next to this viewport
+        driver.beginRenderPass(rth, params);
+    } else if (view->hasPostProcessPass()) {
         // When using a post-process pass, composition of Views is done during the post-process
         // pass, which means it's NOT done here. For this reason, we need to clear the depth/stencil
         // buffers unconditionally. The color buffer must be cleared to what the user asked for,
         // since it's akin to a drawing command.
-        // Also, all buffers can be invalidated before rendering.
         if (view->getClearTargetColor()) {
             params.clear = TargetBufferFlags::ALL;
         } else {
             params.clear = TargetBufferFlags::DEPTH_AND_STENCIL;
         }
-        params.discardStart = TargetBufferFlags::ALL;
+        if (subpassProgram) {
+            params.dependencies |= RenderPassParams::DEPENDENCY_SUBPASS_INPUT;
+        }
         driver.beginRenderPass(rth, params);
     } else {
-        params.discardStart = view->getDiscardedTargetBuffers();
         if (view->getClearTargetColor()) {
             params.clear |= TargetBufferFlags::COLOR;
         }
@@ -523,27 +1434,30 @@ void FRenderer::ColorPass::beginRenderPass(
 }
 
 void FRenderer::ColorPass::endRenderPass(DriverApi& driver, Viewport const& viewport) noexcept {
+    if (subpassProgram) {
+        engine.getPostProcessManager().subpass(subpassProgram);
+    }
     driver.endRenderPass();
 
-    // and we don't need the color buffer in the areas we don't use
-    if (view->hasPostProcessPass()) {
+    // and we don't need the color buffer in the areas we don't use, the right eye is yet to be
+    // rendered next to the left one
+    if (view->hasPostProcessPass() && eye != Eye::LEFT) {
         // discard parts of the color buffer we didn't render into
         const uint32_t large = std::numeric_limits<uint16_t>::max();
+        const uint32_t right = viewport.left + viewport.width;
         driver.discardSubRenderTargetBuffers(rth, TargetBufferFlags::COLOR,
                 0, viewport.height, large, large);          // top side
         driver.discardSubRenderTargetBuffers(rth, TargetBufferFlags::COLOR,
-                viewport.width, 0, large, viewport.height); // right side
+                right, 0, large, viewport.height);          // right side
     }
 }
 
-void FRenderer::ColorPass::renderColorPass(FEngine& engine, JobSystem& js,
-        Handle<HwRenderTarget> const rth, FView* view, Viewport const& scaledViewport,
-        GrowingSlice<Command>& commands) noexcept {
-
-    // start the froxelization immediately, it has no dependencies
-    JobSystem::Job* jobFroxelize = js.createJob(nullptr,
-            [&engine, view](JobSystem&, JobSystem::Job*) { view->froxelize(engine); });
-    js.run(jobFroxelize);
+Slice<RenderPass::Command> FRenderer::ColorPass::renderColorPass(FEngine& engine, JobSystem& js,
+        JobSystem::Job* jobFroxelize, ArenaScope& arena,
+        Handle<HwRenderTarget> const rth,
+        TargetBufferFlags discardStart, TargetBufferFlags discardEnd,
+        FView* view, Viewport const& scaledViewport,
+        GrowingSlice<Command>& commands, Handle<HwProgram> subpassProgram) noexcept {
 
     CameraInfo const& cameraInfo = view->getCameraInfo();
     auto& soa = view->getScene()->getRenderableData();
@@ -553,13 +1467,32 @@ void FRenderer::ColorPass::renderColorPass(FEngine& engine, JobSystem& js,
     view->updatePrimitivesLod(engine, cameraInfo, soa, vr);
 
     DriverApi& driver = engine.getDriverApi();
-    view->prepareCamera(cameraInfo, scaledViewport);
-    view->commitUniforms(driver);
 
     RenderPass::RenderFlags flags = 0;
     if (view->hasShadowing())           flags |= RenderPass::HAS_SHADOWING;
     if (view->hasDirectionalLight())    flags |= RenderPass::HAS_DIRECTIONAL_LIGHT;
     if (view->hasDynamicLighting())     flags |= RenderPass::HAS_DYNAMIC_LIGHTING;
+    if (view->hasOrderIndependentTransparency()) {
+        flags |= RenderPass::HAS_ORDER_INDEPENDENT_TRANSPARENCY;
+    }
+
+    switch (view->getSortOrder()) {
+        case View::SortOrder::DEFAULT:
+            // program and pipeline changes are cheap compared to overdraw on GL, but Vulkan
+            // pipelines are looked up (or created) on each change
+            if (engine.getBackend() == Backend::VULKAN) {
+                flags |= RenderPass::SORT_MATERIAL_FIRST;
+            }
+            break;
+        case View::SortOrder::DEPTH_FIRST:
+            break;
+        case View::SortOrder::MATERIAL_FIRST:
+            flags |= RenderPass::SORT_MATERIAL_FIRST;
+            break;
+        case View::SortOrder::FRONT_TO_BACK:
+            flags |= RenderPass::SORT_FRONT_TO_BACK;
+            break;
+    }
 
     CommandTypeFlags commandType;
     switch (view->getDepthPrepass()) {
@@ -577,58 +1510,260 @@ void FRenderer::ColorPass::renderColorPass(FEngine& engine, JobSystem& js,
         case View::DepthPrepass::ENABLED:
             commandType = DEPTH_AND_COLOR;
             break;
+        case View::DepthPrepass::AUTOMATIC:
+            commandType = DEPTH_AND_COLOR;
+            flags |= RenderPass::DEPTH_PREPASS_AUTOMATIC;
+            break;
+    }
+
+    if (view->isStereo()) {
+        // The commands are generated and sorted once, from the left eye, and recorded for each
+        // eye with its camera. The left eye leaves the buffers to the right one.
+        const Viewport left = FView::getEyeViewport(scaledViewport, 0);
+        const Viewport right = FView::getEyeViewport(scaledViewport, 1);
+        ColorPass leftPass("ColorPass", engine, js, jobFroxelize, view, rth,
+                discardStart, TargetBufferFlags::NONE, subpassProgram, Eye::LEFT);
+        ColorPass rightPass("ColorPass", engine, js, jobFroxelize, view, rth,
+                TargetBufferFlags::NONE, discardEnd, subpassProgram, Eye::RIGHT);
+        driver.pushGroupMarker("Color Pass");
+        view->prepareCamera(cameraInfo, left, view->getJitter());
+        view->commitUniforms(driver);
+        leftPass.render(engine, js, arena, soa, vr, commandType, flags, 0, cameraInfo, left,
+                view->getPerRenderableUniforms(),
+                commands, &view->getCommandCache(CommandTypeFlags::COLOR));
+        view->prepareCamera(view->getStereoCameraInfo(), right, view->getJitter());
+        view->commitUniforms(driver);
+        rightPass.render(engine, js, arena, soa, leftPass.getSortedCommands(),
+                view->getStereoCameraInfo(), right, view->getPerRenderableUniforms());
+        driver.popGroupMarker();
+        return {};
     }
 
-    ColorPass colorPass("ColorPass", js, jobFroxelize, view, rth);
+    view->prepareCamera(cameraInfo, scaledViewport, view->getJitter());
+    view->commitUniforms(driver);
+
+    ColorPass colorPass("ColorPass", engine, js, jobFroxelize, view, rth,
+            discardStart, discardEnd, subpassProgram);
+    colorPass.setGpuCullingFrustum(view->hasGpuCulling() ? &view->getCullingFrustum() : nullptr);
     driver.pushGroupMarker("Color Pass");
-    colorPass.render(engine, js, soa, vr, commandType, flags, cameraInfo, scaledViewport, commands);
+    colorPass.render(engine, js, arena, soa, vr, commandType, flags, 0, cameraInfo, scaledViewport,
+            view->getPerRenderableUniforms(),
+            commands, &view->getCommandCache(CommandTypeFlags::COLOR));
+    driver.popGroupMarker();
+    return colorPass.getOrderIndependentCommands();
+}
+
+// ------------------------------------------------------------------------------------------------
+
+FRenderer::OitPass::OitPass(const char* name, Handle<HwRenderTarget> const rth,
+        float4 clearColor) noexcept
+        : RenderPass(name), rth(rth), clearColor(clearColor) {
+}
+
+void FRenderer::OitPass::beginRenderPass(
+        driver::DriverApi& driver, Viewport const& viewport, const CameraInfo&) noexcept {
+    // the depth buffer of the color pass is tested, and kept for the next layer and passes
+    RenderPassParams params = {};
+    params.clear = TargetBufferFlags::COLOR;
+    params.discardStart = TargetBufferFlags::COLOR;
+    params.discardEnd = TargetBufferFlags::NONE;
+    params.left = viewport.left;
+    params.bottom = viewport.bottom;
+    params.width = viewport.width;
+    params.height = viewport.height;
+    params.clearColor = clearColor;
+    driver.beginRenderPass(rth, params);
+}
+
+void FRenderer::OitPass::endRenderPass(DriverApi& driver, Viewport const&) noexcept {
+    driver.endRenderPass();
+}
+
+void FRenderer::OitPass::renderOitPass(FEngine& engine, JobSystem& js, ArenaScope& arena,
+        FView* view, Viewport const& scaledViewport, Slice<Command> const& commands,
+        Handle<HwRenderTarget> accumulation, Handle<HwRenderTarget> revealage) noexcept {
+
+    // the commands of the revealage layer follow the ones of the accumulation layer
+    Command split;
+    split.key = uint64_t(Pass::ORDER_INDEPENDENT) | makeField(1, BLENDING_MASK, BLENDING_SHIFT);
+    Command const* const first = commands.cbegin();
+    Command const* const middle = std::lower_bound(first, commands.cend(), split);
+
+    // the camera, lights and froxels are still the ones the color pass committed
+    CameraInfo const& cameraInfo = view->getCameraInfo();
+    auto& soa = view->getScene()->getRenderableData();
+
+    DriverApi& driver = engine.getDriverApi();
+    driver.pushGroupMarker("OIT Pass");
+    OitPass accumulationPass("OitAccumulationPass", accumulation, float4{ 0.0f });
+    accumulationPass.render(engine, js, arena, soa, { first, middle },
+            cameraInfo, scaledViewport, view->getPerRenderableUniforms());
+    OitPass revealagePass("OitRevealagePass", revealage, float4{ 1.0f });
+    revealagePass.render(engine, js, arena, soa, { middle, commands.cend() },
+            cameraInfo, scaledViewport, view->getPerRenderableUniforms());
     driver.popGroupMarker();
 }
 
 // ------------------------------------------------------------------------------------------------
 
 FRenderer::ShadowPass::ShadowPass(const char* name,
-        ShadowMap const& shadowMap) noexcept
-        : RenderPass(name), shadowMap(shadowMap) {
+        ShadowAtlas const& atlas, Viewport const& viewport, bool clear, bool cache) noexcept
+        : RenderPass(name), atlas(atlas), viewport(viewport), clear(clear), cache(cache) {
 }
 
 void FRenderer::ShadowPass::beginRenderPass(driver::DriverApi& driver, Viewport const&, const CameraInfo&) noexcept {
-    shadowMap.beginRenderPass(driver);
+    if (cache) {
+        atlas.beginCacheRenderPass(driver, viewport);
+    } else {
+        atlas.beginRenderPass(driver, viewport, clear);
+    }
 }
 
-void FRenderer::ShadowPass::renderShadowMap(FEngine& engine, JobSystem& js,
+// Identifies the static casters of a shadow map. The hashes of the casters are summed so that
+// the result doesn't depend on their order in the scene. Returns 0 when there are none.
+static uint32_t computeStaticCastersHash(FScene::RenderableSoa const& soa, Range<uint32_t> vr,
+        uint32_t visibilityMask) noexcept {
+    auto const* const UTILS_RESTRICT soaInstance        = soa.data<FScene::RENDERABLE_INSTANCE>();
+    auto const* const UTILS_RESTRICT soaWorldAABBCenter = soa.data<FScene::WORLD_AABB_CENTER>();
+    auto const* const UTILS_RESTRICT soaVisibility      = soa.data<FScene::VISIBILITY_STATE>();
+    auto const* const UTILS_RESTRICT soaVisibleMask     = soa.data<FScene::VISIBLE_MASK>();
+    auto const* const UTILS_RESTRICT soaSpotShadowMask  = soa.data<FScene::SPOT_SHADOW_MASK>();
+
+    visibilityMask |= FView::STATIC_SHADOW_CASTERS;
+    uint32_t hash = 0;
+    for (uint32_t i = vr.first; i < vr.last; ++i) {
+        if (soaVisibility[i].staticShadowCaster && FView::isInShadowMap(
+                FView::getShadowCasterMask(soaVisibleMask[i], soaSpotShadowMask[i], true),
+                visibilityMask)) {
+            // the center of the bounding box catches most changes of a "static" caster
+            uint32_t key[4] = { soaInstance[i].asValue() };
+            memcpy(&key[1], &soaWorldAABBCenter[i], sizeof(float3));
+            hash += utils::hash::murmur3(key, 4, 0) | 1u;
+        }
+    }
+    return hash;
+}
+
+void FRenderer::ShadowPass::renderShadowMap(FEngine& engine, JobSystem& js, ArenaScope& arena,
         FView* view, GrowingSlice<Command>& commands) noexcept {
 
     auto& soa = view->getScene()->getRenderableData();
     auto vr = view->getVisibleShadowCasters();
-    ShadowMap const& shadowMap = view->getShadowMap();
-    Viewport const& viewport = shadowMap.getViewport();
-    FCamera const& camera = shadowMap.getCamera();
-
-    CameraInfo cameraInfo = {
-            .projection         = mat4f{ camera.getProjectionMatrix() },
-            .cullingProjection  = mat4f{ camera.getCullingProjectionMatrix() },
-            .model              = camera.getModelMatrix(),
-            .view               = camera.getViewMatrix(),
-            .zn                 = camera.getNear(),
-            .zf                 = camera.getCullingFar(),
-    };
-
-    // populate the RenderPrimitive array with the proper LOD
-    view->updatePrimitivesLod(engine, cameraInfo, soa, vr);
-
     driver::DriverApi& driver = engine.getDriverApi();
-    view->prepareCamera(cameraInfo, viewport);
-    view->commitUniforms(driver);
+    ShadowAtlas const& atlas = view->getShadowAtlas();
 
     RenderPass::RenderFlags flags = 0;
     if (view->hasShadowing())           flags |= RenderPass::HAS_SHADOWING;
     if (view->hasDirectionalLight())    flags |= RenderPass::HAS_DIRECTIONAL_LIGHT;
     if (view->hasDynamicLighting())     flags |= RenderPass::HAS_DYNAMIC_LIGHTING;
 
-    ShadowPass shadowPass("ShadowPass", shadowMap);
+    // all shadow maps are rendered in the same atlas, each with its own casters and commands.
+    // The directional light's cascades come first, then the spot lights.
+    struct Tile {
+        ShadowMap* shadowMap;
+        size_t cascade;
+        uint32_t visibilityMask;
+        bool cached;
+    };
+    Tile tiles[ShadowAtlas::MAX_TILE_COUNT];
+    size_t count = 0;
+    if (view->hasDirectionalShadowing()) {
+        ShadowMap& shadowMap = view->getShadowMap();
+        for (size_t i = 0, c = shadowMap.getCascadeCount(); i < c; i++) {
+            if (shadowMap.hasVisibleShadows(i)) {
+                tiles[count++] = { &shadowMap, i, FView::getShadowCascadeVisibleMask(i), false };
+            }
+        }
+    }
+    for (size_t i = 0, c = view->getSpotShadowCount(); i < c; i++) {
+        ShadowMap& shadowMap = view->getSpotShadowMap(i);
+        if (shadowMap.hasVisibleShadows(0)) {
+            tiles[count++] = { &shadowMap, 0, FView::getSpotShadowVisibleMask(i), false };
+        }
+    }
+
+    auto renderTile = [&](size_t i, uint32_t visibilityMask, bool clear, bool cache,
+            bool overlap) {
+        ShadowMap const& shadowMap = *tiles[i].shadowMap;
+        const size_t cascade = tiles[i].cascade;
+        Viewport const& viewport = shadowMap.getViewport(cascade);
+        FCamera const& camera = shadowMap.getCamera(cascade);
+
+        CameraInfo cameraInfo = {
+                .projection         = mat4f{ camera.getProjectionMatrix() },
+                .cullingProjection  = mat4f{ camera.getCullingProjectionMatrix() },
+                .model              = camera.getModelMatrix(),
+                .view               = camera.getViewMatrix(),
+                .zn                 = camera.getNear(),
+                .zf                 = camera.getCullingFar(),
+        };
+
+        // populate the RenderPrimitive array with the proper LOD
+        view->updatePrimitivesLod(engine, cameraInfo, soa, vr);
+
+        view->prepareCamera(cameraInfo, viewport);
+        view->commitUniforms(driver);
+
+        // the cache is rarely rendered, its commands aren't worth caching
+        ShadowPass shadowPass(cache ? "ShadowCachePass" : "ShadowPass",
+                atlas, viewport, clear, cache);
+        shadowPass.setOverlapNextPass(overlap);
+        shadowPass.render(engine, js, arena, soa, vr, CommandTypeFlags::SHADOW, flags,
+                visibilityMask, cameraInfo, viewport,
+                view->getPerRenderableUniforms(),
+                commands, cache ? nullptr : &view->getCommandCache(CommandTypeFlags::SHADOW, i));
+        // the commands of this tile may still be recorded, the next tile's go after them
+        commands.set(commands.end(), uint32_t(commands.remain()));
+        commands.clear();
+    };
+
     driver.pushGroupMarker("Shadow map Pass");
-    shadowPass.render(engine, js, soa, vr, CommandTypeFlags::SHADOW, flags, cameraInfo, viewport, commands);
+
+    // Each tile is recorded while the next one is prepared: the tiles only share the renderables'
+    // data in the scene, which the recording doesn't read (the commands hold what it needs).
+
+    // With caching, the static casters of a tile are only rendered in the cache when they or
+    // the light changed. The cached tiles are then copied in the atlas, which must be cleared
+    // first, and only the dynamic casters are rendered on top of them.
+    bool clear = true;
+    if (atlas.hasCache()) {
+        for (size_t i = 0; i < count; i++) {
+            Tile& tile = tiles[i];
+            const uint32_t hash = computeStaticCastersHash(soa, vr, tile.visibilityMask);
+            if (hash) {
+                tile.cached = true;
+                if (!tile.shadowMap->updateStaticCache(tile.cascade, hash,
+                        atlas.getCacheGeneration())) {
+                    renderTile(i, tile.visibilityMask | FView::STATIC_SHADOW_CASTERS,
+                            true, true, true);
+                }
+            }
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (tiles[i].cached) {
+                if (clear) {
+                    atlas.clearTarget(driver);
+                    clear = false;
+                }
+                atlas.copyFromCache(driver,
+                        tiles[i].shadowMap->getViewport(tiles[i].cascade));
+            }
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const uint32_t casters = tiles[i].cached ?
+                FView::DYNAMIC_SHADOW_CASTERS : FView::ALL_SHADOW_CASTERS;
+        renderTile(i, tiles[i].visibilityMask | casters, clear, false, i + 1 < count);
+        clear = false;
+    }
+
+    // the receivers sample the moments of the tiles, rather than their depths
+    if (atlas.hasMoments()) {
+        for (size_t i = 0; i < count; i++) {
+            atlas.resolveMoments(tiles[i].shadowMap->getViewport(tiles[i].cascade));
+        }
+    }
     driver.popGroupMarker();
 }
 
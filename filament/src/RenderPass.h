@@ -17,6 +17,7 @@
 #ifndef TNT_UTILS_RENDERPASS_H
 #define TNT_UTILS_RENDERPASS_H
 
+#include <filament/Frustum.h>
 #include <filament/Viewport.h>
 
 #include "details/Camera.h"
@@ -30,6 +31,8 @@
 #include <utils/compiler.h>
 #include <utils/Slice.h>
 
+#include <vector>
+
 namespace utils {
 class JobSystem;
 }
@@ -66,6 +69,18 @@ public:
     static constexpr uint64_t Z_BUCKET_MASK                 = 0x3FF00000000llu;
     static constexpr int Z_BUCKET_SHIFT                     = 32;
 
+    static constexpr uint64_t MATERIAL_FIRST_MASK           = 0xFFFFFFFF0000llu;
+    static constexpr int MATERIAL_FIRST_SHIFT               = 16;
+
+    static constexpr uint64_t MATERIAL_FIRST_Z_BUCKET_MASK  = 0x3FFllu;
+    static constexpr int MATERIAL_FIRST_Z_BUCKET_SHIFT      = 0;
+
+    static constexpr uint64_t FRONT_TO_BACK_DISTANCE_MASK   = 0xFFFFFFFF0000llu;
+    static constexpr int FRONT_TO_BACK_DISTANCE_SHIFT       = 16;
+
+    static constexpr uint64_t FRONT_TO_BACK_MATERIAL_MASK   = 0xFFFFllu;
+    static constexpr int FRONT_TO_BACK_MATERIAL_SHIFT       = 0;
+
     static constexpr uint64_t PRIORITY_MASK                 = 0x001C000000000000llu;
     static constexpr int PRIORITY_SHIFT                     = 50;
 
@@ -80,6 +95,7 @@ public:
         DEPTH    = 0llu << PASS_SHIFT,
         COLOR    = 1llu << PASS_SHIFT,
         BLENDED  = 2llu << PASS_SHIFT,
+        ORDER_INDEPENDENT = 3llu << PASS_SHIFT,
         SENTINEL = 0xffffffffffffffffllu
     };
 
@@ -94,9 +110,11 @@ public:
     // --------------------
     //
     // a     = alpha masking
+    // s     = background (skybox), sorted after the other opaque objects
     // bbb   = blending
     // ppp   = priority
     // t     = two-pass transparency ordering
+    // r     = order-independent transparency layer: accumulation (0) or revealage (1)
     // 0     = reserved, must be zero
     //
     // DEPTH command
@@ -110,7 +128,7 @@ public:
     // COLOR command (with depth prepass)
     // |    8   | 3 | 3 | 2|       16       |               32               |
     // +--------+---+---+--+----------------+--------------------------------+
-    // |00000001|00a|ppp|00|0000000000000000|          material-id           |
+    // |00000001|s0a|ppp|00|0000000000000000|          material-id           |
     // +--------+---+---+--+----------------+--------------------------------+
     // | correctness    |        optimizations (truncation allowed)          |
     //
@@ -118,11 +136,27 @@ public:
     // COLOR command (without depth prepass)
     // |    8   | 3 | 3 | 2|  6   |   10     |               32               |
     // +--------+---+---+--+------+----------+--------------------------------+
-    // |00000001|00a|ppp|00|000000| Z-bucket |          material-id           |
+    // |00000001|s0a|ppp|00|000000| Z-bucket |          material-id           |
     // +--------+---+---+--+------+----------+--------------------------------+
     // | correctness    |      optimizations (truncation allowed)             |
     //
     //
+    // COLOR command (without depth prepass, sorted by material first)
+    // |    8   | 3 | 3 | 2|               32               |  6   |   10     |
+    // +--------+---+---+--+--------------------------------+------+----------+
+    // |00000001|s0a|ppp|00|          material-id           |000000| Z-bucket |
+    // +--------+---+---+--+--------------------------------+------+----------+
+    // | correctness    |      optimizations (truncation allowed)             |
+    //
+    //
+    // COLOR command (without depth prepass, sorted front to back)
+    // |    8   | 3 | 3 | 2|               32               |       16       |
+    // +--------+---+---+--+--------------------------------+----------------+
+    // |00000001|s0a|ppp|00|          distanceBits          | material-id/16 |
+    // +--------+---+---+--+--------------------------------+----------------+
+    // | correctness    |      optimizations (truncation allowed)             |
+    //
+    //
     // BLENDED command
     // |    8   | 3 | 3 | 2|              32                |         15    |1|
     // +--------+---+---+--+--------------------------------+---------------+-+
@@ -131,6 +165,14 @@ public:
     // | correctness                                                          |
     //
     //
+    // ORDER_INDEPENDENT command
+    // |    8   | 3 | 3 | 2|       16       |               32               |
+    // +--------+---+---+--+----------------+--------------------------------+
+    // |00000011|00r|ppp|00|0000000000000000|          material-id           |
+    // +--------+---+---+--+----------------+--------------------------------+
+    // | correctness    |        optimizations (truncation allowed)          |
+    //
+    //
     // SENTINEL command
     // |                                   64                                  |
     // +--------.--------.--------.--------.--------.--------.--------.--------+
@@ -172,19 +214,32 @@ public:
         return boolish ? -1llu : 0llu;
     }
 
-    struct PrimitiveInfo { // 28 bytes
+    struct PrimitiveInfo { // 32 bytes
         FMaterialInstance const* mi = nullptr;              // 8 bytes (4)
         Handle<HwRenderPrimitive> primitiveHandle;          // 4 bytes
-        Handle<HwUniformBuffer> perRenderableUniforms;      // 4 bytes
         Handle<HwUniformBuffer> perRenderableBones;         // 4 bytes
         Driver::RasterState rasterState;                    // 4 bytes
         Variant materialVariant;                            // 1 byte
-        uint8_t reserved[3] = { };                          // 3 bytes (that helps the compiler)
+        bool multiDraw = false;                             // 1 byte (see instanceCommands())
+        uint16_t instanceCount = 1;                         // 2 bytes (see instanceCommands())
+        uint32_t index = 0;                                 // 4 bytes (index of the renderable)
+        uint32_t bonesOffset = 0;                           // 4 bytes (in perRenderableBones)
+    };
+
+    // Where the per-renderable uniforms are: the uniforms of the renderable at index i in the
+    // soa are 'size' bytes at offset i * stride in 'ubh' (see FView::commitPerRenderableUniforms).
+    // The morphing buffers of skinned renderables are looked up in the soa the same way.
+    struct PerRenderableUniforms {
+        Handle<HwUniformBuffer> ubh;
+        uint32_t stride = 0;
+        uint32_t size = 0;
+        Handle<HwUniformBuffer> const* morphingUbh = nullptr;
+        Handle<HwSamplerBuffer> const* morphTargetsSbh = nullptr;
     };
 
-    struct alignas(8) Command {     // 32 bytes
+    struct alignas(8) Command {     // 40 bytes
         CommandKey key = 0;         //  8 bytes
-        PrimitiveInfo primitive;    // 24 bytes
+        PrimitiveInfo primitive;    // 32 bytes
         bool operator < (Command const& rhs) const noexcept { return key < rhs.key; }
         // placement new declared as "throw" to avoid the compiler's null-check
         inline void* operator new (std::size_t size, void* ptr) {
@@ -195,11 +250,41 @@ public:
     static_assert(std::is_trivially_destructible<Command>::value,
             "Command isn't trivially destructible");
 
+    // The compact form of the commands of the passes drawing only depth (shadow maps), which
+    // are generated and sorted as such, and only expanded to Commands once sorted: everything
+    // but the key is found again from the renderable and the primitive.
+    struct DepthCommand {           // 16 bytes
+        CommandKey key = 0;         //  8 bytes
+        uint32_t index = 0;         //  4 bytes (index of the renderable)
+        uint32_t primitive = 0;     //  4 bytes (index of the primitive in the renderable)
+        bool operator < (DepthCommand const& rhs) const noexcept { return key < rhs.key; }
+    };
+
+    /*
+     * Sorted commands of a previous frame, along with a signature of everything they were
+     * generated from. When the signature of the current frame is the same, the commands are
+     * reused as-is and only need to be recorded (e.g.: when the camera and scene don't change).
+     */
+    class CommandCache {
+        friend class RenderPass;
+        std::vector<uint64_t> mSignature;
+        std::vector<uint64_t> mScratch;
+        std::vector<Command> mCommands;
+    };
+
 
     using RenderFlags = uint8_t;
     static constexpr RenderFlags HAS_SHADOWING          = 0x01;
     static constexpr RenderFlags HAS_DIRECTIONAL_LIGHT  = 0x02;
     static constexpr RenderFlags HAS_DYNAMIC_LIGHTING   = 0x04;
+    static constexpr RenderFlags SORT_MATERIAL_FIRST    = 0x08;
+    static constexpr RenderFlags SORT_FRONT_TO_BACK     = 0x10;
+    static constexpr RenderFlags DEPTH_PREPASS_AUTOMATIC = 0x20;
+    static constexpr RenderFlags HAS_ORDER_INDEPENDENT_TRANSPARENCY = 0x40;
+
+    // fraction of the viewport a renderable must cover to be drawn in an automatic depth
+    // pre-pass, see FScene::SCREEN_COVERAGE
+    static constexpr float DEPTH_PREPASS_MIN_COVERAGE = 0.05f;
 
 
     RenderPass(const char* name) noexcept : mName(name) { }
@@ -207,12 +292,42 @@ public:
     virtual ~RenderPass() noexcept;
 
     // appends rendering commands for the given view
+    // shadow passes only draw the renderables whose shadow caster mask matches visibilityMask
+    // (see FView::isInShadowMap()), it's ignored by other passes.
     void render(
-            FEngine& engine, utils::JobSystem& js,
+            FEngine& engine, utils::JobSystem& js, ArenaScope& arena,
             FScene::RenderableSoa const& soa, utils::Range<uint32_t> visibleRenderables,
-            uint32_t commandTypeFlags, RenderFlags renderFlags,
+            uint32_t commandTypeFlags, RenderFlags renderFlags, uint32_t visibilityMask,
             const CameraInfo& camera, Viewport const& viewport,
-            utils::GrowingSlice<Command>& commands) noexcept;
+            PerRenderableUniforms const& uniforms,
+            utils::GrowingSlice<Command>& commands, CommandCache* cache) noexcept;
+
+    // records commands sorted by an earlier render() again, e.g. from another point of view.
+    // They're only valid until the next pass generates its own.
+    void render(FEngine& engine, utils::JobSystem& js, ArenaScope& arena,
+            FScene::RenderableSoa const& soa, utils::Slice<Command> const& sortedCommands,
+            const CameraInfo& camera, Viewport const& viewport,
+            PerRenderableUniforms const& uniforms) noexcept;
+
+    // the commands recorded by the last render() call
+    utils::Slice<Command> const& getSortedCommands() const noexcept { return mSortedCommands; }
+
+    // The ORDER_INDEPENDENT commands of the last render() call generating its commands, which it
+    // doesn't record: they're sorted last and drawn by their own passes (see
+    // FRenderer::OitPass). Valid as long as the sorted commands.
+    utils::Slice<Command> const& getOrderIndependentCommands() const noexcept {
+        return mOrderIndependentCommands;
+    }
+
+    // The driver commands of this pass are recorded in the background while the next pass
+    // prepares its own, and the next pass hands them to the driver thread. The next pass must not
+    // write the commands of this one, nor anything they reference.
+    void setOverlapNextPass(bool overlap) noexcept { mOverlapNextPass = overlap; }
+
+    // When not null, the draws of the batches are culled against this frustum by the driver,
+    // one draw per renderable, instead of by the view (see FView::hasGpuCulling()). It must stay
+    // valid until render() returns.
+    void setGpuCullingFrustum(Frustum const* frustum) noexcept { mGpuCullingFrustum = frustum; }
 
 private:
     // Called just before rendering, make sure all needed asynchronous tasks are finished.
@@ -239,23 +354,117 @@ private:
 
     static inline void generateCommands(uint32_t commandTypeFlags, Command* const commands,
             FScene::RenderableSoa const& soa, utils::Range<uint32_t> range, RenderFlags renderFlags,
-            math::float3 cameraPosition, math::float3 cameraForward) noexcept;
+            uint32_t visibilityMask, math::float3 cameraPosition, math::float3 cameraForward) noexcept;
 
     template<uint32_t commandTypeFlags>
     static inline void generateCommandsImpl(uint32_t, Command* commands, FScene::RenderableSoa const& soa,
-            utils::Range<uint32_t> range, RenderFlags renderFlags, math::float3 cameraPosition,
-            math::float3 cameraForward) noexcept;
+            utils::Range<uint32_t> range, RenderFlags renderFlags, uint32_t visibilityMask,
+            math::float3 cameraPosition, math::float3 cameraForward) noexcept;
 
+    static void generateSortedCommands(FEngine& engine, utils::JobSystem& js, ArenaScope& arena,
+            FScene::RenderableSoa const& soa, utils::Range<uint32_t> visibleRenderables,
+            uint32_t commandTypeFlags, RenderFlags renderFlags, uint32_t visibilityMask,
+            math::float3 cameraPosition, math::float3 cameraForward,
+            utils::GrowingSlice<Command>& commands) noexcept;
+
+    // 'prepass' is whether the pass has a depth pre-pass, in which case 'hasDepthPass' is whether
+    // this command is drawn by it
+    template<bool prepass>
     static void setupColorCommand(Command& cmdDraw, bool hasDepthPass,
             FMaterialInstance const* const mi) noexcept;
 
-    static void recordDriverCommands(FEngine::DriverApi& driver,
-            utils::Slice<Command> const& commands) noexcept;
+    // the state shared by all depth commands
+    static Command makeDepthCommand() noexcept;
+
+    // generates the DepthCommands of a shadow pass, one per primitive (SENTINEL when skipped)
+    static void generateDepthCommands(DepthCommand* commands,
+            FScene::RenderableSoa const& soa, utils::Range<uint32_t> range,
+            RenderFlags renderFlags, uint32_t visibilityMask,
+            math::float3 cameraPosition, math::float3 cameraForward) noexcept;
+
+    // expands sorted DepthCommands to the Commands they stand for
+    static void expandDepthCommands(Command* commands, DepthCommand const* depthCommands,
+            size_t count, FScene::RenderableSoa const& soa) noexcept;
+
+    // below this many commands, the driver commands are recorded on the calling thread
+    static constexpr size_t RECORD_PARALLEL_MIN_COMMANDS_COUNT = 1024;
+    // minimum number of commands recorded by each job
+    static constexpr size_t RECORD_JOB_MIN_COMMANDS_COUNT = 256;
+    // maximum number of jobs recording driver commands
+    static constexpr size_t RECORD_MAX_JOBS = 16;
+
+    // The transforms of an instanced draw or of a batch of draws (see instanceCommands()). The
+    // draws of a batch are allocated in the command stream, as well as their boxes and the
+    // planes they're culled against, when culled by the driver.
+    struct InstanceBuffer {
+        Handle<HwUniformBuffer> ubh;
+        Driver::DrawIndirectCommand const* draws;
+        uint32_t drawCount;
+        math::float4 const* planes;
+        Driver::DrawBounds const* bounds;
+    };
+
+    // When background isn't null, the jobs recording the commands are its children and this
+    // returns without waiting for them (see FEngine::getRecordingJob()).
+    static void recordDriverCommands(FEngine::DriverApi& driver, utils::JobSystem& js,
+            ArenaScope& arena, utils::Slice<Command> const& commands,
+            PerRenderableUniforms const& uniforms,
+            utils::Slice<const InstanceBuffer> const& instanceBuffers,
+            utils::JobSystem::Job* background) noexcept;
+
+    // records the commands in [first, last) and returns where it stopped, which is either 'last'
+    // or the first SENTINEL command. 'last' must be the start of a draw.
+    static Command const* recordDriverCommandsRange(FEngine::DriverApi& driver,
+            Command const* first, Command const* last,
+            PerRenderableUniforms const& uniforms,
+            InstanceBuffer const* instanceBuffer, bool instancing) noexcept;
+
+    // merges runs of sorted commands that only differ by their per-renderable uniforms, so
+    // they can be drawn with a single instanced draw call. With multiDraw, runs can also draw
+    // different ranges of the same buffers, with a single indirect draw call.
+    static void instanceCommands(Command* commands, size_t count,
+            FScene::RenderableSoa const& soa, bool multiDraw) noexcept;
+
+    // adds the draws and triangles of sorted commands to the engine's frame statistics
+    static void updateDrawStatistics(FEngine::DrawStatistics& statistics,
+            FScene::RenderableSoa const& soa, utils::Slice<Command> const& commands,
+            bool instancing) noexcept;
+
+    // returns the primitive a command draws
+    static FRenderPrimitive const* getPrimitive(
+            FScene::RenderableSoa const& soa, PrimitiveInfo const& info) noexcept;
+
+    // creates the uniform buffers holding the transforms of each instanced draw call, along
+    // with the draws of the batches. When 'planes' isn't null, each command of a run is its own
+    // draw, culled against them.
+    static utils::Slice<const InstanceBuffer> createInstanceBuffers(
+            FEngine& engine, ArenaScope& arena, FScene::RenderableSoa const& soa,
+            utils::Slice<Command> const& commands, math::float4 const* planes) noexcept;
+
+    // computes the signature of this pass and returns whether it's the same as the cached one
+    static bool updateSignature(CommandCache& cache, uint32_t commandTypeFlags,
+            FScene::RenderableSoa const& soa, utils::Range<uint32_t> range, RenderFlags renderFlags,
+            uint32_t visibilityMask, math::float3 cameraPosition, math::float3 cameraForward) noexcept;
+
+    // below this many commands, a radix sort is not worth it
+    static constexpr size_t RADIX_SORT_MIN_COMMANDS_COUNT = 1024;
+    // maximum number of jobs used by the radix sort (8 bits per pass)
+    static constexpr size_t RADIX_SORT_MAX_JOBS = 8;
+    static constexpr size_t RADIX_SORT_BUCKET_COUNT = 256 + 1; // +1 for SENTINEL commands
+
+    // sorts commands by key, using scratch memory from 'arena'. Command or DepthCommand.
+    template<typename T>
+    static void sortCommands(utils::JobSystem& js, ArenaScope& arena,
+            T* commands, size_t count) noexcept;
 
     static void updateSummedPrimitiveCounts(
             FScene::RenderableSoa& renderableData, utils::Range<uint32_t> vr) noexcept;
 
     const char* const mName;
+    bool mOverlapNextPass = false;
+    Frustum const* mGpuCullingFrustum = nullptr;
+    utils::Slice<Command> mSortedCommands;
+    utils::Slice<Command> mOrderIndependentCommands;
 };
 
 } // namespace details
@@ -49,6 +49,10 @@ void FRenderPrimitive::init(driver::DriverApi& driver,
 
         mPrimitiveType = entry.type;
         mEnabledAttributes = enabledAttributes;
+        mVertexBuffer = ebh;
+        mIndexBuffer = ibh;
+        mIndexOffset = (uint32_t)entry.offset;
+        mIndexCount = (uint32_t)entry.count;
     }
 }
 
@@ -72,6 +76,10 @@ void FRenderPrimitive::set(FEngine& engine, RenderableManager::PrimitiveType typ
 
     mPrimitiveType = type;
     mEnabledAttributes = enabledAttributes;
+    mVertexBuffer = ebh;
+    mIndexBuffer = ibh;
+    mIndexOffset = (uint32_t)offset;
+    mIndexCount = (uint32_t)count;
 }
 
 void FRenderPrimitive::set(FEngine& engine, RenderableManager::PrimitiveType type, size_t offset,
@@ -80,6 +88,8 @@ void FRenderPrimitive::set(FEngine& engine, RenderableManager::PrimitiveType typ
     driver.setRenderPrimitiveRange(mHandle, type,
             (uint32_t)offset, (uint32_t)minIndex, (uint32_t)maxIndex, (uint32_t)count);
     mPrimitiveType = type;
+    mIndexOffset = (uint32_t)offset;
+    mIndexCount = (uint32_t)count;
 }
 
 } // namespace details
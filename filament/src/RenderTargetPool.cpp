@@ -19,8 +19,11 @@
 #include "details/Engine.h"
 #include "details/Texture.h"
 
+#include <utils/algorithm.h>
 #include <utils/Log.h>
 
+#include <algorithm>
+
 namespace filament {
 
 using namespace utils;
@@ -29,171 +32,200 @@ using namespace details;
 
 void RenderTargetPool::init(FEngine& engine) noexcept {
     mEngine = &engine;
-    mPool.reserve(16);
+    mBuckets.reserve(16);
+    mIsAutoResolveSupported = engine.getDriverApi().isAutoResolveSupported();
 }
 
 void RenderTargetPool::terminate(DriverApi& driver) noexcept {
-    for (Entry const* entry : mPool) {
-        destroyEntry(driver, entry);
+    while (mLeastRecentlyUsed) {
+        evict(driver, mLeastRecentlyUsed);
     }
 }
 
+uint32_t RenderTargetPool::getSizeClass(uint32_t size) noexcept {
+    // round all allocations to 32 pixels, to avoid too many small resize, and large ones to
+    // 1/8th of their power of two: a size class is never more than 12.5% larger than the size
+    // (or ~27% for the area), which is a good compromise between reuse and wasted memory.
+    size = (std::max(1u, size) + 31u) & ~31u;
+    const uint32_t shift = std::max(5u, 31u - utils::clz(size) - 3u);
+    const uint32_t mask = (1u << shift) - 1u;
+    return (size + mask) & ~mask;
+}
+
+uint64_t RenderTargetPool::getKey(Entry const& entry) noexcept {
+    // sizes are multiples of 32 (at most 2^21), the other fields fit in 8 bits
+    return  (uint64_t(entry.w >> 5u)          << 48u) |
+            (uint64_t(entry.h >> 5u)          << 32u) |
+            (uint64_t(entry.attachments)      << 24u) |
+            (uint64_t(entry.samples)          << 16u) |
+            (uint64_t(entry.format)           <<  8u) |
+            (uint64_t(entry.flags)            <<  0u);
+}
+
 RenderTargetPool::Target const* RenderTargetPool::get(
         driver::TargetBufferFlags attachments,
         uint32_t w, uint32_t h, uint8_t samples, TextureFormat format,
-        uint8_t flags) const noexcept {
+        uint8_t flags) noexcept {
 
     // samples can't be less than 1
     samples = std::max(uint8_t(1), samples);
 
-    // round all allocations to 32x32 pixels, to avoid too many small resize
-    uint32_t target_w = (w + 31u) & ~31u;
-    uint32_t target_h = (h + 31u) & ~31u;
-    Entry entry = { attachments, target_w, target_h, samples, format, flags };
+    Entry entry = { attachments, getSizeClass(w), getSizeClass(h), samples, format, flags };
+    entry.key = getKey(entry);
+    entry.age = mCacheAge;
+
+    // reuse the most recently used target of the same size class, if any
+    auto pos = mBuckets.find(entry.key);
+    if (pos != mBuckets.end() && !pos->second.empty()) {
+        Entry* const found = pos.value().back();
+        pos.value().pop_back();
+        unlink(found);
+        found->age = mCacheAge;
+        mHits++;
+        return found;
+    }
+    mMisses++;
 
     FEngine& engine = *mEngine;
     DriverApi& driver = engine.getDriverApi();
-    
-    // Since we order the cache by width then by height, we can get a cached
-    // entry with a smaller height. Only reuse if both dimensions are higher.
-    auto pos = find(&entry);
-    Entry const* const it = pos != mPool.end() ? *pos : nullptr;
-    if (UTILS_LIKELY(it &&
-                     it->attachments == attachments &&
-                     it->samples == samples &&
-                     it->format == format &&
-                     it->flags == flags &&
-                     it->w >= target_w &&
-                     it->h >= target_h)) {
-        if (2 * it->w * it->h >= 3 * target_w * target_h) {
-            // the surface we found is 1.5x larger than requested
-            // there is a performance cost, especially on tilers, it's better to not allow
-            // too much of a size difference
-            goto not_found;
-        }
 
-        // update last usage age, remove the entry from the pool and return it
-        (*pos)->age = mCacheAge;
-        mPool.erase(pos);
-        return it;
+    // make room for the new target, the least recently used first. The unused targets can be
+    // destroyed even if they were used earlier in this frame, since the driver executes the
+    // commands in order.
+    const size_t size = getSize(&entry);
+    while (mLeastRecentlyUsed &&
+           (mPoolSize + size > mBudget || mEntryCount >= POOL_MAX_ENTRY_COUNT)) {
+        evict(driver, mLeastRecentlyUsed);
     }
 
-    not_found:
-
+    const uint32_t target_w = entry.w;
+    const uint32_t target_h = entry.h;
     if (flags & RenderTargetPool::Target::NO_TEXTURE) {
         entry.target = driver.createRenderTarget(
                 entry.attachments, target_w, target_h, samples, format, {}, {}, {});
+    } else if (!(attachments & TargetBufferFlags::COLOR)) {
+        // depth-only targets (e.g. shadow maps) are sampled from their depth attachment
+        entry.texture = driver.createTexture(Driver::SamplerType::SAMPLER_2D, 1,
+                format, samples, target_w, target_h, 1, Driver::TextureUsage::DEPTH_ATTACHMENT);
+
+        entry.target = driver.createRenderTarget(
+                entry.attachments, target_w, target_h, samples, format,
+                {}, { entry.texture }, {});
     } else {
+        const TextureFormat textureFormat =
+                (flags & RenderTargetPool::Target::SUBPASS) ? TextureFormat::RGBA8 : format;
+        // the samples only live in tile memory, they're resolved into the textures
+        const uint8_t textureSamples = mIsAutoResolveSupported ? uint8_t(1) : samples;
         entry.texture = driver.createTexture(Driver::SamplerType::SAMPLER_2D, 1,
-                format, samples, target_w, target_h, 1, Driver::TextureUsage::COLOR_ATTACHMENT);
+                textureFormat, textureSamples, target_w, target_h, 1,
+                Driver::TextureUsage::COLOR_ATTACHMENT);
+
+        if ((flags & RenderTargetPool::Target::DEPTH_TEXTURE) &&
+                (attachments & TargetBufferFlags::DEPTH)) {
+            // same format as the depth renderbuffer the driver would create otherwise
+            entry.depth = driver.createTexture(Driver::SamplerType::SAMPLER_2D, 1,
+                    TextureFormat::DEPTH24, textureSamples, target_w, target_h, 1,
+                    Driver::TextureUsage::DEPTH_ATTACHMENT);
+        }
 
         entry.target = driver.createRenderTarget(
                 entry.attachments, target_w, target_h, samples, format,
-                { entry.texture }, {}, {});
+                { entry.texture }, { entry.depth }, {});
     }
 
-    // update last used age
-    entry.age = mCacheAge;
-
-    mPoolSize += getSize(&entry);
+    mPoolSize += size;
+    mEntryCount++;
 
     // entry not found, create one
     return mEntryArena.make<Entry>(entry);
 }
 
 void RenderTargetPool::put(Target const* target) noexcept {
-    // insert the entry back into the pool
-    Entry const* entry = static_cast<Entry const*>(target);
-    auto pos = find(entry);
-    mPool.insert(pos, entry);
+    // insert the entry back into its bucket, and at the end of the LRU list
+    Entry* const entry = const_cast<Entry*>(static_cast<Entry const*>(target));
+    entry->age = mCacheAge;
+    mBuckets[entry->key].push_back(entry);
+
+    entry->prev = mMostRecentlyUsed;
+    entry->next = nullptr;
+    if (mMostRecentlyUsed) {
+        mMostRecentlyUsed->next = entry;
+    } else {
+        mLeastRecentlyUsed = entry;
+    }
+    mMostRecentlyUsed = entry;
 }
 
-std::vector<RenderTargetPool::Entry const*>::iterator
-RenderTargetPool::find(Entry const* entry) const noexcept {
-    auto& cache = mPool;
-    auto pos = std::lower_bound(cache.begin(), cache.end(), entry,
-            [](Entry const* const& l, Entry const* const& r) {
-                Entry const& lhs = *l;
-                Entry const& rhs = *r;
-                if (lhs.attachments == rhs.attachments) {
-                    if (lhs.samples == rhs.samples) {
-                        if (lhs.format == rhs.format) {
-                            if (lhs.flags == rhs.flags) {
-                                if (lhs.w == rhs.w) {
-                                    return lhs.h < rhs.h;
-                                }
-                                return lhs.w < rhs.w;
-                            }
-                            return lhs.flags < rhs.flags;
-                        }
-                        return lhs.format < rhs.format;
-                    }
-                    return lhs.samples < rhs.samples;
-                }
-                return lhs.attachments < rhs.attachments;
-            });
-    return pos;
+void RenderTargetPool::unlink(Entry* entry) noexcept {
+    if (entry->prev) {
+        entry->prev->next = entry->next;
+    } else {
+        mLeastRecentlyUsed = entry->next;
+    }
+    if (entry->next) {
+        entry->next->prev = entry->prev;
+    } else {
+        mMostRecentlyUsed = entry->prev;
+    }
+    entry->prev = entry->next = nullptr;
 }
 
-void RenderTargetPool::gc() noexcept {
-//#ifndef NDEBUG
-//    slog.d << "RenderTargetPool: " << mPoolSize/1024.0f << "KiB, count=" << mPool.size() << io::endl;
-//#endif
+void RenderTargetPool::evict(DriverApi& driver, Entry* entry) noexcept {
+    // the buckets are small, and evictions rare
+    std::vector<Entry*>& bucket = mBuckets[entry->key];
+    bucket.erase(std::find(bucket.begin(), bucket.end(), entry));
+    unlink(entry);
+    destroyEntry(driver, entry);
+}
 
+void RenderTargetPool::gc() noexcept {
     DriverApi& driver = mEngine->getDriverApi();
-    auto& cache = mPool;
-    size_t count = cache.size();
-    while (count && (count > POOL_MAX_ENTRY_COUNT || mPoolSize > POOL_MAX_SIZE)) {
-
-        // find the least recently used entry (linear search here)
-        auto pos = std::min_element(cache.begin(), cache.end(),
-                [](const Entry* rhs, const Entry* lhs) { return rhs->age < lhs->age; });
-
-        // don't remove entries that were used in the last frame
-        if ((*pos)->age == mCacheAge) {
-            // no more entries old enough to remove
-            break;
-        }
 
-        // free resources
-        destroyEntry(driver, *pos);
-        // lastly, remove entry from cache
-        cache.erase(pos);
-        count--;
+    // The LRU list is ordered by age: remove the entries over budget, but not the ones used
+    // in the last frame, which will likely be needed again. Then those too old to be useful.
+    while (mLeastRecentlyUsed && mLeastRecentlyUsed->age != mCacheAge &&
+           (mPoolSize > mBudget || mEntryCount > POOL_MAX_ENTRY_COUNT)) {
+        evict(driver, mLeastRecentlyUsed);
     }
-
-    if (UTILS_UNLIKELY(mDeepPurgeCountDown-- == 0)) {
-        mDeepPurgeCountDown = POOL_ENTRY_MAX_AGE;
-        uint32_t age = mCacheAge - POOL_ENTRY_MAX_AGE;
-        // remove all entries that are older than CACHE_ENTRY_MAX_AGE
-        auto last = std::remove_if(cache.begin(), cache.end(),
-                [this, &driver, age](const Entry* entry) {
-                    bool remove = entry->age <= age;
-                    if (remove) {
-                        destroyEntry(driver, entry);
-                    }
-                    return remove;
-                });
-        cache.erase(last, cache.end());
+    while (mLeastRecentlyUsed && mCacheAge - mLeastRecentlyUsed->age >= POOL_ENTRY_MAX_AGE) {
+        evict(driver, mLeastRecentlyUsed);
     }
 
+    mStatistics.size = mPoolSize;
+    mStatistics.count = uint32_t(mEntryCount);
+    mStatistics.hits = mHits;
+    mStatistics.misses = mMisses;
+    mHits = mMisses = 0;
+
+    FEngine& engine = *mEngine;
+    engine.debug.rendertargetpool.size = int(mStatistics.size / 1024);
+    engine.debug.rendertargetpool.count = int(mStatistics.count);
+    engine.debug.rendertargetpool.hits = int(mStatistics.hits);
+    engine.debug.rendertargetpool.misses = int(mStatistics.misses);
+
     // all cache entries get older
     mCacheAge++;
 }
 
-void RenderTargetPool::destroyEntry(DriverApi& driver, Entry const* entry) noexcept {
+void RenderTargetPool::destroyEntry(DriverApi& driver, Entry* entry) noexcept {
     assert(entry);
     driver.destroyRenderTarget(entry->target);
     driver.destroyTexture(entry->texture);
+    if (entry->depth) {
+        driver.destroyTexture(entry->depth);
+    }
+    assert(mPoolSize >= getSize(entry));
     mPoolSize -= getSize(entry);
+    mEntryCount--;
     mEntryArena.destroy(entry);
-    assert(mPoolSize >= 0);
 }
 
 size_t RenderTargetPool::getSize(Entry const* entry) noexcept {
     size_t size = 0;
     if (entry->attachments & TargetBufferFlags::COLOR) {
-        size += FTexture::getFormatSize(entry->format);
+        // the first subpass attachment of a SUBPASS target lives in tile memory only
+        size += FTexture::getFormatSize((entry->flags & Target::SUBPASS) ?
+                TextureFormat::RGBA8 : entry->format);
     }
 
     if (entry->attachments & TargetBufferFlags::DEPTH) {
@@ -26,6 +26,8 @@
 
 #include <utils/Allocator.h>
 
+#include <tsl/robin_map.h>
+
 #include <vector>
 
 namespace filament {
@@ -41,7 +43,7 @@ class RenderTargetPool {
     // e.g. layer sizes
     // 1440 x 2560 is ~ 29 MB for color buffer
     // 1280 x 720  is ~  7 MB for color buffer
-    static constexpr size_t POOL_MAX_SIZE = 128 * 1024 * 1024;
+    static constexpr size_t POOL_DEFAULT_BUDGET = 128 * 1024 * 1024;
 
     // 2 pages is way enough for the entry sturctures (should be about 400)
     static constexpr size_t POOL_ENTRY_ARENA_SIZE = 8192;
@@ -56,6 +58,7 @@ public:
     struct Target {
         Handle<HwRenderTarget> target;
         Handle<HwTexture> texture;
+        Handle<HwTexture> depth;    // only with DEPTH_TEXTURE
         uint32_t w = 0;
         uint32_t h = 0;
         driver::TargetBufferFlags attachments = driver::TargetBufferFlags::NONE;
@@ -63,14 +66,39 @@ public:
         uint8_t samples = 1;
         uint8_t flags = 0;
         static constexpr uint8_t NO_TEXTURE = 0x1;
+        // the depth attachment of a color target is a texture, so it can be sampled
+        static constexpr uint8_t DEPTH_TEXTURE = 0x2;
+        // the target is drawn in two subpasses: `format` is the format of the transient
+        // attachment written by the first one, the texture is the RGBA8 output of the second
+        static constexpr uint8_t SUBPASS = 0x4;
+    };
+
+    struct Statistics {
+        size_t size = 0;        // bytes used by all the targets, in use or not
+        uint32_t count = 0;     // number of targets, in use or not
+        uint32_t hits = 0;      // get() calls of the last frame which reused a target
+        uint32_t misses = 0;    // get() calls of the last frame which created a target
     };
 
+    // The returned target is at least width x height, and belongs to a size class not much
+    // larger, so that slightly different sizes (e.g. with dynamic resolution) share targets.
+    // The textures of a multisampled color target are already resolved when
+    // isAutoResolved() is true, otherwise they're multisampled too.
     Target const* get(driver::TargetBufferFlags attachments,
             uint32_t width, uint32_t height, uint8_t samples, TextureFormat format,
-            uint8_t flags = 0) const noexcept;
+            uint8_t flags = 0) noexcept;
 
     void put(Target const* entry) noexcept;
 
+    bool isAutoResolved() const noexcept { return mIsAutoResolveSupported; }
+
+    // Memory the targets should fit in, the least recently used unused targets are destroyed
+    // to stay within the budget. Targets in use are never destroyed, so the budget can be
+    // exceeded.
+    void setBudget(size_t bytes) noexcept { mBudget = bytes; }
+
+    Statistics getStatistics() const noexcept { return mStatistics; }
+
     // remove older items in the cache. call this once per frame.
     void gc() noexcept;
 
@@ -87,25 +115,45 @@ private:
             this->format = format;
             this->flags = flags;
         }
-        mutable uint32_t age = 0;
+        uint64_t key = 0;
+        uint32_t age = 0;
+        // unused entries, from the least to the most recently used
+        Entry* prev = nullptr;
+        Entry* next = nullptr;
     };
 
     // we divide by two, so we have plenty of room
     static constexpr size_t POOL_MAX_ENTRY_COUNT = (POOL_ENTRY_ARENA_SIZE / sizeof(Entry)) / 2;
 
+    static uint32_t getSizeClass(uint32_t size) noexcept;
+    static uint64_t getKey(Entry const& entry) noexcept;
     static size_t getSize(Entry const* entry) noexcept;
-    void destroyEntry(driver::DriverApi& driver, Entry const* entry) noexcept;
-    std::vector<Entry const*>::iterator find(Entry const* entry) const noexcept;
+    void destroyEntry(driver::DriverApi& driver, Entry* entry) noexcept;
+    void evict(driver::DriverApi& driver, Entry* entry) noexcept;
+    void unlink(Entry* entry) noexcept;
 
     details::FEngine* mEngine = nullptr;
-    mutable std::vector<Entry const*> mPool;
-    mutable size_t mPoolSize = 0;
+
+    // multisampled color targets have single-sampled textures, see Driver::isAutoResolveSupported()
+    bool mIsAutoResolveSupported = false;
+
+    // unused entries, per size class and description
+    tsl::robin_map<uint64_t, std::vector<Entry*>> mBuckets;
+    Entry* mLeastRecentlyUsed = nullptr;
+    Entry* mMostRecentlyUsed = nullptr;
+
+    size_t mPoolSize = 0;
+    size_t mEntryCount = 0;
+    size_t mBudget = POOL_DEFAULT_BUDGET;
     // at 60 fps, 32 bit gives us 828 days without overflow
-    uint32_t mDeepPurgeCountDown = POOL_ENTRY_MAX_AGE;
     uint32_t mCacheAge = POOL_ENTRY_MAX_AGE;
 
+    uint32_t mHits = 0;
+    uint32_t mMisses = 0;
+    Statistics mStatistics;
+
     using PoolAllocator = utils::Arena<utils::ObjectPoolAllocator<Entry>, utils::LockingPolicy::NoLock>;
-    mutable PoolAllocator mEntryArena = { "PoolAllocator", POOL_ENTRY_ARENA_SIZE };
+    PoolAllocator mEntryArena = { "PoolAllocator", POOL_ENTRY_ARENA_SIZE };
 
 };
 
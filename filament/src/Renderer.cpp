@@ -16,6 +16,8 @@
 
 #include "details/Renderer.h"
 
+#include "FrameGraph.h"
+#include "PhaseProfiler.h"
 #include "RenderPass.h"
 
 #include "details/Engine.h"
@@ -32,6 +34,8 @@
 #include <utils/Systrace.h>
 #include <utils/vector.h>
 
+#include <algorithm>
+
 #include <assert.h>
 
 using namespace math;
@@ -49,6 +53,7 @@ FRenderer::FRenderer(FEngine& engine) :
         mFrameInfoManager(engine),
         mIsRGB16FSupported(false),
         mIsRGB8Supported(false),
+        mIsSubpassSupported(false),
         mPerRenderPassArena(engine.getPerRenderPassAllocator())
 {
 }
@@ -58,6 +63,7 @@ void FRenderer::init() noexcept {
     mRenderTarget = driver.createDefaultRenderTarget();
     mIsRGB16FSupported = driver.isRenderTargetFormatSupported(driver::TextureFormat::RGB16F);
     mIsRGB8Supported = driver.isRenderTargetFormatSupported(driver::TextureFormat::RGB8);
+    mIsSubpassSupported = driver.isSubpassInputSupported();
     mFrameInfoManager.run();
 }
 
@@ -114,6 +120,27 @@ void FRenderer::render(FView const* view) {
     }
 }
 
+// the timing of the latest frame that completed, for the dynamic resolution
+static FView::FrameTiming getFrameTiming(FrameInfo const& info) noexcept {
+    Driver::FrameStatistics const& stats = info.statistics;
+    FView::FrameTiming timing;
+    if (stats.gpuTimeAge != Driver::FrameStatistics::GPU_TIME_UNKNOWN) {
+        // The GPU timers tell apart the shadow maps, whose cost doesn't depend on the
+        // resolution. They're a few frames older than the frame they were reported in.
+        timing.frame = info.frame - stats.gpuTimeAge;
+        timing.fixedMilli = stats.gpuTimeMilli[Driver::TIMER_SHADOW_PASS];
+        timing.scalableMilli = stats.gpuTimeMilli[Driver::TIMER_COLOR_PASS] +
+                               stats.gpuTimeMilli[Driver::TIMER_POST_PROCESS];
+    } else {
+        // otherwise the whole frame, as measured with fences
+        const FrameInfo::duration frameTime =
+                info.laps[FrameInfo::FINISH] - info.laps[FrameInfo::START];
+        timing.frame = info.frame;
+        timing.scalableMilli = frameTime.count();
+    }
+    return timing;
+}
+
 void FRenderer::renderJob(ArenaScope& arena, FView* view) {
     FEngine& engine = getEngine();
     JobSystem& js = engine.getJobSystem();
@@ -126,7 +153,8 @@ void FRenderer::renderJob(ArenaScope& arena, FView* view) {
 
     Viewport const& vp = view->getViewport();
     const bool hasPostProcess = view->hasPostProcessPass();
-    float2 scale = view->updateScale(mFrameInfoManager.getLastFrameTime());
+    float2 scale = view->updateScale(mFrameId,
+            getFrameTiming(mFrameInfoManager.getLastFrameInfo()));
     bool mUseFXAA = view->getAntiAliasing() == View::AntiAliasing::FXAA;
     if (!hasPostProcess) {
         // dynamic scaling and FXAA are part of the post-process phase and can't happen if
@@ -135,6 +163,12 @@ void FRenderer::renderJob(ArenaScope& arena, FView* view) {
         scale = 1.0f;
     }
 
+    // the temporal upscaler anti-aliases the image as well
+    const bool hasTemporalUpscaling = view->hasTemporalUpscaling();
+    if (hasTemporalUpscaling) {
+        mUseFXAA = false;
+    }
+
     const bool scaled = any(notEqual(scale, float2(1.0f)));
     Viewport svp = vp.scale(scale);
     if (svp.empty()) {
@@ -142,7 +176,18 @@ void FRenderer::renderJob(ArenaScope& arena, FView* view) {
     }
 
     view->prepare(engine, driver, arena, svp);
-    // TODO: froxelization could actually start now, instead of in ColorPass::renderColorPass()
+
+    // the levels of the streamed textures needed by the visible renderables
+    engine.getTextureStreamer().update(*view->getScene(), view->getVisibleRenderables(), svp);
+
+    // Start the froxelization immediately, it only depends on prepare() and runs while the
+    // shadow and color pass commands are generated. The froxelization itself is a child of
+    // jobFroxelize, which is only run when we wait for it before the froxels are committed
+    // (see ColorPass::beginRenderPass()); this keeps jobFroxelize alive until then, even if
+    // the froxelization finishes long before.
+    JobSystem::Job* jobFroxelize = js.createJob();
+    js.run(js.createJob(jobFroxelize,
+            [&engine, view](JobSystem&, JobSystem::Job*) { view->froxelize(engine); }));
 
     /*
      * Allocate command buffer.
@@ -153,15 +198,45 @@ void FRenderer::renderJob(ArenaScope& arena, FView* view) {
     GrowingSlice<Command> commands(
             arena.allocate<Command>(commandsCount, CACHELINE_SIZE), commandsCount);
 
+    /*
+     * The passes are declared in a frame graph, which culls the unused ones, works out which
+     * buffers can be discarded, and allocates the intermediate targets only for as long as
+     * they're used.
+     */
+
+    FrameGraph fg(arena, rtp);
+
+    // FIXME: viewRenderTarget doesn't have a depth-buffer, so when skipping post-process, don't rely on it
+    const Handle<HwRenderTarget> viewRenderTarget = getRenderTarget();
+    FrameGraph::Descriptor viewDesc;
+    viewDesc.attachments = TargetBufferFlags::ALL;
+    viewDesc.width = vp.width;
+    viewDesc.height = vp.height;
+    FrameGraphResource output = fg.import("View Target", viewDesc, viewRenderTarget,
+            view->getDiscardedTargetBuffers());
+    fg.present(output);
+
     /*
      * Shadow pass
      */
 
     if (view->hasShadowing()) {
-        ShadowPass::renderShadowMap(engine, js, view, commands);
-        recordHighWatermark(commands); // for debugging
-        // reset the command buffer
-        commands.clear();
+        // the shadow atlas is kept across frames, it's not a resource of the graph
+        struct ShadowPassData { };
+        fg.addPass<ShadowPassData>("Shadow Pass",
+                [](FrameGraph::Builder& builder, ShadowPassData&) {
+                    builder.sideEffect();
+                },
+                [this, &engine, &js, &arena, view, &commands](FrameGraph::Resources const&,
+                        ShadowPassData const&) {
+                    DriverApi& driver = engine.getDriverApi();
+                    driver.beginTimer(Driver::TIMER_SHADOW_PASS);
+                    ShadowPass::renderShadowMap(engine, js, arena, view, commands);
+                    driver.endTimer();
+                    recordHighWatermark(commands); // for debugging
+                    // reset the command buffer
+                    commands.clear();
+                });
     }
 
     /*
@@ -171,63 +246,238 @@ void FRenderer::renderJob(ArenaScope& arena, FView* view) {
     const uint8_t useMSAA = view->getSampleCount();
     const TextureFormat hdrFormat = getHdrFormat();
     const TextureFormat ldrFormat = getLdrFormat();
-    RenderTargetPool::Target const* colorTarget = nullptr;
+
+    // occlusion culling needs the depth buffer of the color pass as a texture
+    const bool hasOcclusionCulling = view->hasOcclusionCulling();
+
+    // the order-independent transparent objects are composited over the HDR color buffer, after
+    // the color pass, which rules out tone mapping in its subpass
+    const bool hasOrderIndependentTransparency = view->hasOrderIndependentTransparency();
+
+    // Tone mapping only reads the pixel it writes, so when FXAA follows it, it can run as a
+    // second subpass of the color pass and the HDR buffer never leaves tile memory.
+    // FXAA itself samples neighboring pixels and can't be merged the same way.
+    // Otherwise, tone mapping, FXAA and the scaling run as a single pass reading the HDR buffer,
+    // which saves the round trips through memory of the intermediate targets. This is also
+    // better than the subpass when scaling, which would need one more pass.
+    // When enabled (debug.postprocess.compute), the single pass is a compute shader instead,
+    // which shares the neighborhoods FXAA reads between the pixels of a group; its image is
+    // then blitted into the view's target.
+    const bool translucent = mSwapChain->isTransparent();
+    const bool computePostProcess = mUseFXAA &&
+            engine.debug.postprocess.compute && engine.isComputeSupported();
+    const bool canToneMapInSubpass = mIsSubpassSupported && mUseFXAA && useMSAA <= 1 &&
+            !computePostProcess && !hasOrderIndependentTransparency;
+    const bool fusedPostProcess = mUseFXAA && !computePostProcess &&
+            (!canToneMapInSubpass || scaled);
+    const bool toneMapInSubpass = canToneMapInSubpass && !fusedPostProcess;
+
+    Handle<HwProgram> subpassProgram;
+    if (toneMapInSubpass) {
+        subpassProgram = engine.getPostProcessProgram(
+                translucent ? PostProcessStage::TONE_MAPPING_SUBPASS_TRANSLUCENT
+                            : PostProcessStage::TONE_MAPPING_SUBPASS_OPAQUE);
+    }
 
     if (UTILS_LIKELY(hasPostProcess)) {
-        // allocate the target we need for rendering the scene
-        colorTarget = rtp.get(TargetBufferFlags::COLOR_AND_DEPTH,
-                svp.width, svp.height, useMSAA, hdrFormat);
+        // the color pass renders into the lower-left corner of its own target
         svp.left = svp.bottom = 0;
     }
 
-    // FIXME: viewRenderTarget doesn't have a depth-buffer, so when skipping post-process, don't rely on it
-    const Handle<HwRenderTarget> viewRenderTarget = getRenderTarget();
-    ColorPass::renderColorPass(engine, js,
-            colorTarget ? colorTarget->target : viewRenderTarget, view, svp, commands);
+    // the commands the color pass leaves to the order-independent transparency pass
+    Slice<Command> oitCommands;
+
+    struct ColorPassData {
+        FrameGraphResource color;
+    };
+    auto const& colorPass = fg.addPass<ColorPassData>("Color Pass",
+            [&](FrameGraph::Builder& builder, ColorPassData& data) {
+                if (UTILS_LIKELY(hasPostProcess)) {
+                    // the target we need for rendering the scene
+                    FrameGraph::Descriptor desc;
+                    desc.attachments = TargetBufferFlags::COLOR_AND_DEPTH;
+                    desc.width = svp.width;
+                    desc.height = svp.height;
+                    desc.samples = useMSAA;
+                    desc.format = hdrFormat;
+                    desc.flags = toneMapInSubpass ? RenderTargetPool::Target::SUBPASS : uint8_t(0);
+                    data.color = builder.write(builder.create("Color Buffer", desc));
+                } else {
+                    data.color = builder.write(output);
+                }
+            },
+            [&engine, &js, jobFroxelize, &arena, view, svp, &commands, subpassProgram,
+                    &oitCommands](
+                    FrameGraph::Resources const& resources, ColorPassData const& data) {
+                DriverApi& driver = engine.getDriverApi();
+                driver.beginTimer(Driver::TIMER_COLOR_PASS);
+                oitCommands = ColorPass::renderColorPass(engine, js, jobFroxelize, arena,
+                        resources.getRenderTarget(data.color),
+                        resources.getDiscardStart(data.color),
+                        resources.getDiscardEnd(data.color),
+                        view, svp, commands, subpassProgram);
+                driver.endTimer();
+            });
+
+    if (hasOrderIndependentTransparency) {
+        // The order-independent transparent objects are drawn in any order, into an
+        // accumulation and a revealage layer tested against the depth buffer of the color pass,
+        // and then composited over the color buffer. Nothing is drawn without such objects.
+        struct OitPassData {
+            FrameGraphResource color;
+            FrameGraphResource accumulation;
+            FrameGraphResource revealage;
+        };
+        auto const& oitPass = fg.addPass<OitPassData>("OIT Pass",
+                [&](FrameGraph::Builder& builder, OitPassData& data) {
+                    data.color = builder.read(colorPass.color, TargetBufferFlags::DEPTH);
+                    FrameGraph::Descriptor desc;
+                    desc.width = svp.width;
+                    desc.height = svp.height;
+                    desc.format = TextureFormat::RGBA16F;
+                    data.accumulation = builder.write(
+                            builder.create("OIT Accumulation Buffer", desc));
+                    desc.format = TextureFormat::R8;
+                    data.revealage = builder.write(builder.create("OIT Revealage Buffer", desc));
+                },
+                [&engine, &js, &arena, view, svp, &oitCommands](
+                        FrameGraph::Resources const& resources, OitPassData const& data) {
+                    if (oitCommands.empty()) {
+                        return;
+                    }
+                    RenderTargetPool::Target const* color = resources.getTarget(data.color);
+                    RenderTargetPool::Target const* accumulation =
+                            resources.getTarget(data.accumulation);
+                    RenderTargetPool::Target const* revealage =
+                            resources.getTarget(data.revealage);
+                    // same size class as the color pass target, so they have the same size
+                    assert(accumulation->w == color->w && accumulation->h == color->h);
+
+                    // the pool's targets have their own depth buffer, the targets sharing the
+                    // color pass one are only made for this frame
+                    DriverApi& driver = engine.getDriverApi();
+                    Handle<HwRenderTarget> accumulationTarget = driver.createRenderTarget(
+                            TargetBufferFlags::COLOR_AND_DEPTH, color->w, color->h, 1,
+                            TextureFormat::RGBA16F, { accumulation->texture }, { color->depth },
+                            {});
+                    Handle<HwRenderTarget> revealageTarget = driver.createRenderTarget(
+                            TargetBufferFlags::COLOR_AND_DEPTH, color->w, color->h, 1,
+                            TextureFormat::R8, { revealage->texture }, { color->depth }, {});
+                    OitPass::renderOitPass(engine, js, arena, view, svp, oitCommands,
+                            accumulationTarget, revealageTarget);
+                    driver.destroyRenderTarget(accumulationTarget);
+                    driver.destroyRenderTarget(revealageTarget);
+                });
+
+        struct OitCompositeData {
+            FrameGraphResource accumulation;
+            FrameGraphResource revealage;
+            FrameGraphResource color;
+        };
+        fg.addPass<OitCompositeData>("OIT Composite",
+                [&](FrameGraph::Builder& builder, OitCompositeData& data) {
+                    data.accumulation = builder.read(oitPass.accumulation);
+                    data.revealage = builder.read(oitPass.revealage);
+                    data.color = builder.write(colorPass.color);
+                },
+                [&engine, &ppm, svp, &oitCommands](
+                        FrameGraph::Resources const& resources, OitCompositeData const& data) {
+                    if (oitCommands.empty()) {
+                        return;
+                    }
+                    ppm.oitCompositePass(
+                            engine.getPostProcessProgram(PostProcessStage::OIT_COMPOSITE),
+                            resources.getTarget(data.accumulation),
+                            resources.getTarget(data.revealage), svp,
+                            resources.getRenderTarget(data.color),
+                            resources.getDiscardStart(data.color),
+                            resources.getDiscardEnd(data.color));
+                });
+    }
+
+    if (hasOcclusionCulling) {
+        // reduce and read back the depth buffer, for the next frames
+        struct DepthPyramidData {
+            FrameGraphResource color;
+        };
+        fg.addPass<DepthPyramidData>("Depth Pyramid",
+                [&](FrameGraph::Builder& builder, DepthPyramidData& data) {
+                    data.color = builder.read(colorPass.color, TargetBufferFlags::DEPTH);
+                    builder.sideEffect();
+                },
+                [view, svp](FrameGraph::Resources const& resources, DepthPyramidData const& data) {
+                    view->updateDepthPyramid(resources.getTarget(data.color), svp);
+                });
+    }
 
     /*
      * Post Processing...
      */
 
     if (UTILS_LIKELY(hasPostProcess)) {
-        driver.pushGroupMarker("Post Processing");
-
         ppm.start();
 
-        if (useMSAA > 1) {
+        if (useMSAA > 1 && !rtp.isAutoResolved()) {
             // Note: MSAA, when used is applied before tone-mapping (which is not ideal)
             // (tone mapping currently only works without multi-sampling)
-            // this blit does a MSAA resolve
+            // this blit does a MSAA resolve, unless the color pass resolved on tile already
             ppm.blit(hdrFormat);
         }
 
-        const bool translucent = mSwapChain->isTransparent();
-        Handle<HwProgram> toneMappingProgram = engine.getPostProcessProgram(
-                translucent ? PostProcessStage::TONE_MAPPING_TRANSLUCENT
-                            : PostProcessStage::TONE_MAPPING_OPAQUE);
-        ppm.pass(mUseFXAA ? TextureFormat::RGBA8 : ldrFormat, toneMappingProgram);
+        if (computePostProcess) {
+            // the view's target can't be written as an image, the blit also scales
+            Handle<HwProgram> computeProgram = engine.getPostProcessProgram(
+                    translucent ? PostProcessStage::FUSED_COMPUTE_TRANSLUCENT
+                                : PostProcessStage::FUSED_COMPUTE_OPAQUE);
+            ppm.compute(computeProgram);
+            ppm.blit(ldrFormat);
+        } else if (fusedPostProcess) {
+            // the single pass is the last command, it draws directly into the view's target
+            Handle<HwProgram> fusedProgram = engine.getPostProcessProgram(
+                    translucent ? PostProcessStage::FUSED_TRANSLUCENT
+                                : PostProcessStage::FUSED_OPAQUE);
+            ppm.pass(ldrFormat, fusedProgram);
+        } else if (!toneMapInSubpass) {
+            Handle<HwProgram> toneMappingProgram = engine.getPostProcessProgram(
+                    translucent ? PostProcessStage::TONE_MAPPING_TRANSLUCENT
+                                : PostProcessStage::TONE_MAPPING_OPAQUE);
+            ppm.pass(mUseFXAA ? TextureFormat::RGBA8 : ldrFormat, toneMappingProgram);
+        }
 
-        if (mUseFXAA) {
+        if (mUseFXAA && !fusedPostProcess && !computePostProcess) {
             Handle<HwProgram> antiAliasingProgram = engine.getPostProcessProgram(
                     translucent ? PostProcessStage::ANTI_ALIASING_TRANSLUCENT
                                 : PostProcessStage::ANTI_ALIASING_OPAQUE);
             ppm.pass(ldrFormat, antiAliasingProgram);
         }
 
-        if (scaled) {
-            // because it's the last command, the TextureFormat is not relevant
-            ppm.blit();
+        if (hasTemporalUpscaling) {
+            // the temporal upscaler takes the tone mapped image at svp (the color pass ran
+            // with a jittered projection), and upscales it to the view's target
+            FrameGraph::Descriptor desc;
+            desc.width = svp.width;
+            desc.height = svp.height;
+            desc.format = ldrFormat;
+            FrameGraphResource toneMapped = fg.create("Tone Mapped Buffer", desc);
+            ppm.finish(fg, colorPass.color, toneMapped, svp, svp);
+            view->getTemporalUpscaler().addPass(fg, toneMapped, colorPass.color, output, vp, svp);
+        } else {
+            if (scaled && !fusedPostProcess && !computePostProcess) {
+                // because it's the last command, the TextureFormat is not relevant
+                ppm.blit();
+            }
+            ppm.finish(fg, colorPass.color, output, vp, svp);
         }
-        ppm.finish(view->getDiscardedTargetBuffers(), viewRenderTarget, vp, colorTarget, svp);
-
-        driver.popGroupMarker();
     }
 
+    fg.compile();
+    fg.execute();
+
     // for debugging
     recordHighWatermark(commands);
 }
 
-bool FRenderer::beginFrame(FSwapChain* swapChain) {
+bool FRenderer::beginFrame(FSwapChain* swapChain, uint64_t vsyncSteadyClockTimeNano) {
     SYSTRACE_CALL();
 
     assert(swapChain);
@@ -253,20 +503,59 @@ bool FRenderer::beginFrame(FSwapChain* swapChain) {
     driver.beginFrame(
             uint64_t(std::chrono::steady_clock::now().time_since_epoch().count()), mFrameId);
 
-    if (mFrameSkipper.skipFrameNeeded()) {
+    // the latency can be changed between frames
+    const uint8_t latency = swapChain->getFrameLatency();
+    mFrameSkipper.setLatency(latency);
+
+    // When the vsync is known, the frame is displayed `latency` vsyncs later: the time the CPU
+    // and the GPU had for the previous frames. A frame displayed at the same vsync as the
+    // previous one would only replace it, so it's skipped. Half a period of tolerance absorbs
+    // the jitter of the vsync timestamps.
+    int64_t presentationTime = 0;
+    bool sameVsync = false;
+    if (vsyncSteadyClockTimeNano) {
+        const int64_t period = int64_t(1e9 / std::max(mDisplayInfo.refreshRate, 1.0f));
+        presentationTime = int64_t(vsyncSteadyClockTimeNano) + latency * period;
+        sameVsync = presentationTime < mPresentationTime + period / 2;
+    }
+
+    // A headless swap chain isn't displayed, nothing would be gained by skipping its frames: the
+    // CPU waits for the GPU instead, which keeps `latency` frames in flight.
+    if (swapChain->isHeadless()) {
+        mFrameSkipper.waitForFrame();
+    } else if (sameVsync || mFrameSkipper.skipFrameNeeded()) {
         mFrameInfoManager.cancelFrame();
         driver.endFrame(mFrameId);
         engine.flush();
         return false;
     }
 
+    if (presentationTime) {
+        driver.setPresentationTime(presentationTime);
+        mPresentationTime = presentationTime;
+    }
+
+    // start measuring the per-frame allocations of this frame
+    mPerRenderPassArena.getListener().resetHighWatermark();
+    mFrameCommandsHighWatermark = 0;
+
+    // the counters are collected in endFrame(), discard what was counted outside of the frame
+    PhaseProfiler& phaseProfiler = PhaseProfiler::get();
+    phaseProfiler.setEnabled(engine.debug.profiler.phases);
+    phaseProfiler.collect();
+
+    // the draws are counted by the passes, see RenderPass::render()
+    engine.getDrawStatistics() = {};
+    mBeginFrameTime = filament::FrameInfo::clock::now();
+    mBeginFrameStallTime = engine.getFlushStallTime();
+
     // ask the engine to do what it needs to (e.g. updates light buffer, materials...)
     engine.prepare();
 
     return true;
 }
 
-void FRenderer::endFrame() {
+void FRenderer::endFrame(Viewport const* damage, size_t count) {
     SYSTRACE_CALL();
 
     FEngine& engine = getEngine();
@@ -277,17 +566,73 @@ void FRenderer::endFrame() {
     // the buffer form another thread, which is currently not allowed.
     driver.debugThreading();
 
+    // the driver thread executes the frame's commands later, it's not part of the phases
+    const PhaseProfiler::FrameCounters phases = PhaseProfiler::get().collect();
+
+    // the work of the other threads is measured between two endFrame(), it lags behind the frames
+    using std::chrono::nanoseconds;
+    const auto now = filament::FrameInfo::clock::now();
+    const uint64_t flushedBytes = engine.getFlushedBytes();
+    const uint64_t driverThreadTime = engine.getDriverThreadTime();
+    const uint64_t driverThreadWaitTime = engine.getDriverThreadWaitTime();
+    JobSystem const& workers = engine.getJobSystem();
+    const uint64_t workerIdleTime = workers.getWorkerIdleTime();
+    filament::FrameInfo::CpuStatistics cpu;
+    cpu.mainThreadTime = now - mBeginFrameTime;
+    cpu.mainThreadWaitTime = nanoseconds(engine.getFlushStallTime() - mBeginFrameStallTime);
+    cpu.driverThreadTime = nanoseconds(driverThreadTime - mLastDriverThreadTime);
+    cpu.driverThreadWaitTime = nanoseconds(driverThreadWaitTime - mLastDriverThreadWaitTime);
+    cpu.workerIdleTime = nanoseconds(workerIdleTime - mLastWorkerIdleTime);
+    if (mLastEndFrameTime != filament::FrameInfo::time_point{}) {
+        // the workers that are not idle are executing jobs
+        const filament::FrameInfo::duration total =
+                (now - mLastEndFrameTime) * float(workers.getWorkerCount());
+        cpu.workerBusyTime = std::max(filament::FrameInfo::duration{},
+                total - cpu.workerIdleTime);
+    }
+    cpu.commandBufferSize = flushedBytes - mLastFlushedBytes;
+    cpu.drawCount = engine.getDrawStatistics().drawCount;
+    cpu.triangleCount = engine.getDrawStatistics().triangleCount;
+    mLastEndFrameTime = now;
+    mLastFlushedBytes = flushedBytes;
+    mLastDriverThreadTime = driverThreadTime;
+    mLastDriverThreadWaitTime = driverThreadWaitTime;
+    mLastWorkerIdleTime = workerIdleTime;
+
     FrameInfoManager& frameInfoManager = mFrameInfoManager;
-    frameInfoManager.endFrame();
+    frameInfoManager.endFrame(phases, cpu);
     mFrameSkipper.endFrame();
 
+    // all the per-frame allocations of this frame are done
+    TrackingPolicy::HighWatermark const& arenaWatermark = mPerRenderPassArena.getListener();
+    mFrameMemoryStatistics.arenaSize = arenaWatermark.getSize();
+    mFrameMemoryStatistics.arenaHighWatermark = arenaWatermark.getHighWatermark();
+    mFrameMemoryStatistics.commandsSize = FEngine::CONFIG_PER_FRAME_COMMANDS_SIZE;
+    mFrameMemoryStatistics.commandsHighWatermark = mFrameCommandsHighWatermark * sizeof(Command);
+
+    // the mipmaps generated on the CPU since the last frame are uploaded
+    engine.getMipmapGenerator().update(engine);
+
+    // the levels of the streamed textures needed by this frame's views are requested
+    engine.getTextureStreamer().commit(driver);
+
     driver.endFrame(mFrameId);
 
     if (mSwapChain) {
+        if (count) {
+            Driver::DamageRegion* const regions = driver.allocatePod<Driver::DamageRegion>(count);
+            for (size_t i = 0; i < count; i++) {
+                regions[i] = { damage[i].left, damage[i].bottom, damage[i].width, damage[i].height };
+            }
+            driver.setDamageRegions(regions, uint32_t(count));
+        }
         mSwapChain->commit(driver);
         mSwapChain = nullptr;
     }
 
+    // destroy the objects given to Engine::destroyDeferred(), within the budget
+    engine.destroyDeferredObjects(false);
+
     // Run the component managers' GC in parallel
     // WARNING: while doing this we can't access any component manager
     auto& js = engine.getJobSystem();
@@ -297,6 +642,30 @@ void FRenderer::endFrame() {
 
     rtp.gc();           // gc post-processing targets (this can generate driver commands)
     engine.flush();     // flush command stream
+    engine.updateCommandBufferStatistics();
+
+    Driver::FrameStatistics const stats = frameInfoManager.getLastFrameStatistics();
+    engine.debug.driver.state_changes_issued = int(stats.stateChangesIssued);
+    engine.debug.driver.state_changes_skipped = int(stats.stateChangesSkipped);
+    engine.debug.driver.program_switches = int(stats.programSwitches);
+    engine.debug.driver.texture_switches = int(stats.textureSwitches);
+
+    auto thousands = [&phases](PhaseProfiler::Phase phase) {
+        PhaseProfiler::Counters const& c = phases[phase];
+        return float4{ float(c.instructions), float(c.cpuCycles),
+                       float(c.cacheMisses), float(c.stalledCycles) } * 1e-3f;
+    };
+    engine.debug.profiler.scene_prepare = thousands(PhaseProfiler::SCENE_PREPARE);
+    engine.debug.profiler.culling = thousands(PhaseProfiler::CULLING);
+    engine.debug.profiler.froxelize = thousands(PhaseProfiler::FROXELIZE);
+    engine.debug.profiler.commands = thousands(PhaseProfiler::COMMANDS);
+    engine.debug.profiler.sort = thousands(PhaseProfiler::SORT);
+    engine.debug.profiler.record = thousands(PhaseProfiler::RECORD);
+    uint64_t allocations = 0;
+    for (PhaseProfiler::Counters const& c : phases) {
+        allocations += c.allocations;
+    }
+    engine.debug.profiler.allocations = int(allocations);
 
     // make sure we're done with the gcs
     js.wait(job);
@@ -305,9 +674,9 @@ void FRenderer::endFrame() {
 #if EXTRA_TIMING_INFO
     if (UTILS_UNLIKELY(frameInfoManager.isLapRecordsEnabled())) {
         auto history = frameInfoManager.getHistory();
-        FrameInfo const& info = history.back();
-        FrameInfo::duration rendering   = info.laps[FrameInfo::LAP_0]  - info.laps[FrameInfo::START];
-        FrameInfo::duration postprocess = info.laps[FrameInfo::FINISH] - info.laps[FrameInfo::LAP_0];
+        filament::FrameInfo const& info = history.back();
+        filament::FrameInfo::duration rendering   = info.laps[filament::FrameInfo::LAP_0]  - info.laps[filament::FrameInfo::START];
+        filament::FrameInfo::duration postprocess = info.laps[filament::FrameInfo::FINISH] - info.laps[filament::FrameInfo::LAP_0];
         mRendering.push(rendering.count());
         mPostProcess.push(postprocess.count());
         slog.d << mRendering.latest() << ", "
@@ -316,6 +685,50 @@ void FRenderer::endFrame() {
 #endif
 }
 
+size_t FRenderer::getFrameInfoHistory(FrameInfo* history,
+        size_t count) const noexcept {
+    // the history is oldest first, it starts with empty entries until enough frames completed
+    const std::vector<filament::FrameInfo> frames = mFrameInfoManager.getHistory();
+    auto first = std::find_if(frames.begin(), frames.end(),
+            [](filament::FrameInfo const& info) { return info.frame != 0; });
+    first += std::max(std::ptrdiff_t(0), std::distance(first, frames.end()) - std::ptrdiff_t(count));
+
+    auto milli = [](PhaseProfiler::Counters const& c) { return float(c.time) * 1e-6f; };
+
+    size_t n = 0;
+    for (auto it = first; it != frames.end(); ++it, ++n) {
+        filament::FrameInfo const& info = *it;
+        Driver::FrameStatistics const& stats = info.statistics;
+        FrameInfo& out = history[n];
+        out = {};
+        out.frameId = info.frame;
+        out.frameTime = filament::FrameInfo::duration(info.laps[filament::FrameInfo::FINISH] -
+                info.laps[filament::FrameInfo::START]).count();
+        if (stats.gpuTimeAge != Driver::FrameStatistics::GPU_TIME_UNKNOWN) {
+            out.shadowPassGpuTime = stats.gpuTimeMilli[Driver::TIMER_SHADOW_PASS];
+            out.colorPassGpuTime = stats.gpuTimeMilli[Driver::TIMER_COLOR_PASS];
+            out.postProcessGpuTime = stats.gpuTimeMilli[Driver::TIMER_POST_PROCESS];
+            out.gpuTime = out.shadowPassGpuTime + out.colorPassGpuTime + out.postProcessGpuTime;
+        }
+        out.mainThreadTime = info.cpu.mainThreadTime.count();
+        out.mainThreadWaitTime = info.cpu.mainThreadWaitTime.count();
+        out.driverThreadTime = info.cpu.driverThreadTime.count();
+        out.driverThreadWaitTime = info.cpu.driverThreadWaitTime.count();
+        out.workerBusyTime = info.cpu.workerBusyTime.count();
+        out.workerIdleTime = info.cpu.workerIdleTime.count();
+        out.scenePrepareTime = milli(info.phases[PhaseProfiler::SCENE_PREPARE]);
+        out.cullingTime = milli(info.phases[PhaseProfiler::CULLING]);
+        out.froxelizeTime = milli(info.phases[PhaseProfiler::FROXELIZE]);
+        out.commandsTime = milli(info.phases[PhaseProfiler::COMMANDS]);
+        out.sortTime = milli(info.phases[PhaseProfiler::SORT]);
+        out.recordTime = milli(info.phases[PhaseProfiler::RECORD]);
+        out.commandBufferSize = size_t(info.cpu.commandBufferSize);
+        out.drawCount = info.cpu.drawCount;
+        out.triangleCount = info.cpu.triangleCount;
+    }
+    return n;
+}
+
 void FRenderer::readPixels(uint32_t xoffset, uint32_t yoffset, uint32_t width, uint32_t height,
         driver::PixelBufferDescriptor&& buffer) {
 
@@ -373,6 +786,14 @@ bool Renderer::beginFrame(SwapChain* swapChain) {
     return upcast(this)->beginFrame(upcast(swapChain));
 }
 
+bool Renderer::beginFrame(SwapChain* swapChain, uint64_t vsyncSteadyClockTimeNano) {
+    return upcast(this)->beginFrame(upcast(swapChain), vsyncSteadyClockTimeNano);
+}
+
+void Renderer::setDisplayInfo(DisplayInfo const& info) noexcept {
+    upcast(this)->setDisplayInfo(info);
+}
+
 void Renderer::readPixels(uint32_t xoffset, uint32_t yoffset, uint32_t width, uint32_t height,
         driver::PixelBufferDescriptor&& buffer) {
     upcast(this)->readPixels(xoffset, yoffset, width, height, std::move(buffer));
@@ -382,4 +803,16 @@ void Renderer::endFrame() {
     upcast(this)->endFrame();
 }
 
+void Renderer::endFrame(Viewport const* damage, size_t count) {
+    upcast(this)->endFrame(damage, count);
+}
+
+Renderer::FrameMemoryStatistics Renderer::getFrameMemoryStatistics() const noexcept {
+    return upcast(this)->getFrameMemoryStatistics();
+}
+
+size_t Renderer::getFrameInfoHistory(FrameInfo* history, size_t count) const noexcept {
+    return upcast(this)->getFrameInfoHistory(history, count);
+}
+
 } // namespace filament
@@ -27,10 +27,14 @@
 
 #include <utils/compiler.h>
 #include <utils/EntityManager.h>
+#include <utils/JobSystem.h>
 #include <utils/Range.h>
+#include <utils/Systrace.h>
 #include <utils/Zip2Iterator.h>
 
 #include <algorithm>
+#include <functional>
+#include <utility>
 
 using namespace math;
 using namespace utils;
@@ -49,46 +53,169 @@ FScene::FScene(FEngine& engine) :
 FScene::~FScene() noexcept = default;
 
 
+// copies all the arrays of 'src' into 'dst', starting at index 'offset'
+template<typename SoA, size_t ... Is>
+static void copyArrays(SoA& UTILS_RESTRICT dst, size_t offset, SoA const& UTILS_RESTRICT src,
+        std::index_sequence<Is...>) noexcept {
+    int UTILS_UNUSED dummy[] = { (std::copy(
+            src.template begin<Is>(), src.template end<Is>(),
+            dst.template begin<Is>() + offset), 0)... };
+}
+
+// moves element 'order[i]' of 'src' to position 'i' of 'dst', for all arrays
+template<typename T>
+static void permute(T* UTILS_RESTRICT dst, T const* UTILS_RESTRICT src,
+        uint32_t const* UTILS_RESTRICT order, size_t count) noexcept {
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = src[order[i]];
+    }
+}
+
+template<typename SoA, size_t ... Is>
+static void permuteArrays(SoA& UTILS_RESTRICT dst, SoA const& UTILS_RESTRICT src,
+        uint32_t const* order, std::index_sequence<Is...>) noexcept {
+    int UTILS_UNUSED dummy[] = { (permute(
+            dst.template data<Is>(), src.template data<Is>(), order, src.size()), 0)... };
+}
+
+static bool isEqual(mat4f const& lhs, mat4f const& rhs) noexcept {
+    for (size_t i = 0; i < 4; i++) {
+        if (lhs[i] != rhs[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void FScene::prepare(const math::mat4f& worldOriginTansform) {
-    // TODO: can we skip this in most cases? Since we rely on indices staying the same,
-    //       we could only skip, if nothing changed in the RCM.
+    SYSTRACE_CALL();
 
     FEngine& engine = mEngine;
     EntityManager& em = engine.getEntityManager();
     FRenderableManager& rcm = engine.getRenderableManager();
     FTransformManager& tcm = engine.getTransformManager();
     FLightManager& lcm = engine.getLightManager();
-    // go through the list of entities, and gather the data of those that are renderables
-    auto& sceneData = mRenderableData;
-    auto& lightData = mLightData;
-    auto const& entities = mEntities;
 
+    /*
+     * Bring our copy of the scene data up-to-date. Everything is gathered again only when
+     * the set of entities, their components or the world origin changed; otherwise we just patch
+     * the entities recorded in the component managers' change journals.
+     */
 
-    // NOTE: we can't know in advance how many entities are renderable or lights because the corresponding
-    // component can be added after the entity is added to the scene.
+    Slice<const Entity> renderableChanges;
+    Slice<const Entity> transformChanges;
+    Slice<const Entity> lightChanges;
+    bool gatherEverything = mEntitiesChanged ||
+            !isEqual(worldOriginTansform, mWorldOriginTransform) ||
+            !rcm.getChangeJournal().since(mRenderableJournalPosition, renderableChanges) ||
+            !tcm.getChangeJournal().since(mTransformJournalPosition, transformChanges) ||
+            !lcm.getChangeJournal().since(mLightJournalPosition, lightChanges);
+
+    if (!gatherEverything) {
+        // entities destroyed with the EntityManager keep their components until the next gc()
+        gatherEverything = std::any_of(mCachedEntities.begin(), mCachedEntities.end(),
+                [&em](Entity e) { return !em.isAlive(e); });
+    }
 
-    // for the purpose of allocation, we'll assume all our entities are renderables
-    size_t capacity = entities.size();
-    // we need the capacity to be multiple of 16 for SIMD loops
-    capacity = (capacity + 0xF) & ~0xF;
-    // we need 1 extra entry at the end for teh summed primitive count
-    capacity = capacity + 1;
+    // the entries gathered by this call are stamped with the new version
+    mVersion++;
 
+    if (gatherEverything) {
+        gatherAll(worldOriginTansform);
+        mRenderableVersions.assign(mRenderableCache.size(), mVersion);
+    } else {
+        for (Entity e : renderableChanges) {
+            gather(e, worldOriginTansform);
+        }
+        for (Entity e : transformChanges) {
+            gather(e, worldOriginTansform);
+        }
+        for (Entity e : lightChanges) {
+            gather(e, worldOriginTansform);
+        }
+        if (mHierarchicalCulling) {
+            mBvh.refit(mRenderableCache.data<WORLD_AABB_CENTER>(),
+                    mRenderableCache.data<WORLD_AABB_EXTENT>());
+            mLightBvh.refit(mLightCenters.data(), mLightExtents.data());
+        }
+    }
+
+    mRenderableJournalPosition = rcm.getChangeJournal().end();
+    mTransformJournalPosition = tcm.getChangeJournal().end();
+    mLightJournalPosition = lcm.getChangeJournal().end();
+    mWorldOriginTransform = worldOriginTansform;
+    mEntitiesChanged = false;
+
+    /*
+     * Initialize the per-frame arrays from our copy
+     */
+
+    auto& sceneData = mRenderableData;
+    auto& lightData = mLightData;
+
+    // we need the capacity to be multiple of 16 for SIMD loops
+    // and we need 1 extra entry at the end for the summed primitive count
+    size_t capacity = ((mRenderableCache.size() + 0xF) & ~0xF) + 1;
     sceneData.clear();
     if (sceneData.capacity() < capacity) {
         sceneData.setCapacity(capacity);
     }
+    sceneData.resize(mRenderableCache.size());
+    copyArrays(sceneData, 0, mRenderableCache,
+            std::make_index_sequence<RenderableSoa::getArrayCount()>());
 
+    // the first entries are reserved for the directional lights (currently only one)
+    capacity = ((DIRECTIONAL_LIGHTS_COUNT + mLightCache.size() + 0xF) & ~0xF) + 1;
     lightData.clear();
     if (lightData.capacity() < capacity) {
         lightData.setCapacity(capacity);
     }
-    // the first entries are reserved for the directional lights (currently only one)
-    lightData.resize(DIRECTIONAL_LIGHTS_COUNT);
-
+    lightData.resize(DIRECTIONAL_LIGHTS_COUNT + mLightCache.size());
+    copyArrays(lightData, DIRECTIONAL_LIGHTS_COUNT, mLightCache,
+            std::make_index_sequence<LightSoa::getArrayCount()>());
 
-    // find the max intensity directional light index in our local array
+    // find the max intensity directional light, we don't store the other ones, because
+    // we only support a single one
     float maxIntensity = 0;
+    for (DirectionalLight const& light : mDirectionalLights) {
+        if (lcm.getIntensity(light.instance) >= maxIntensity) {
+            maxIntensity = lcm.getIntensity(light.instance);
+            lightData.elementAt<FScene::DIRECTION>(0)       = light.direction;
+            lightData.elementAt<FScene::LIGHT_INSTANCE>(0)  = light.instance;
+        }
+    }
+}
+
+void FScene::gatherAll(const math::mat4f& worldOriginTansform) {
+    SYSTRACE_CALL();
+
+    FEngine& engine = mEngine;
+    JobSystem& js = engine.getJobSystem();
+    EntityManager& em = engine.getEntityManager();
+    FRenderableManager& rcm = engine.getRenderableManager();
+    FTransformManager& tcm = engine.getTransformManager();
+    FLightManager& lcm = engine.getLightManager();
+    auto const& entities = mEntities;
+
+    sortEntities();
+
+    // NOTE: we can't know in advance how many entities are renderable or lights because the corresponding
+    // component can be added after the entity is added to the scene.
+    mRenderableCache.clear();
+    mLightCache.clear();
+    mLightTransforms.clear();
+    mDirectionalLights.clear();
+    mCachedEntities.clear();
+    mRenderableSlots.clear();
+    mLightSlots.clear();
+
+    /*
+     * First, find out which entities end-up in the cache. This only looks-up instances, the
+     * actual (more expensive) work is done below, in parallel.
+     */
+
+    // make room for all entities up-front, so push_back() below never needs to grow the arrays
+    mRenderableCache.ensureCapacity(entities.size());
 
     for (Entity e : entities) {
         if (!em.isAlive(e))
@@ -101,54 +228,229 @@ void FScene::prepare(const math::mat4f& worldOriginTansform) {
         if (!ri & !li)
             continue;
 
-        // get the world transform
         auto ti = tcm.getInstance(e);
-        const mat4f worldTransform = worldOriginTansform * tcm.getWorldTransform(ti);
 
         // don't even draw this object if it doesn't have a transform (which shouldn't happen
         // because one is always created when creating a Renderable component).
         if (ri && ti) {
-            // compute the world AABB so we can perform culling
-            const Box worldAABB = rigidTransform(rcm.getAABB(ri), worldTransform);
-
-            // we know there is enough space in the array
-            sceneData.push_back_unsafe(
-                    ri,
-                    worldTransform,
-                    rcm.getVisibility(ri),
-                    rcm.getUbh(ri),
-                    rcm.getBonesUbh(ri),
-                    worldAABB.center,
-                    0,
-                    rcm.getLayerMask(ri),
-                    worldAABB.halfExtent,
-                    {}, {});
+            // the world origin is applied by prepareRenderables()
+            mRenderableSlots[e] = uint32_t(mRenderableCache.size());
+            const size_t index = mRenderableCache.size();
+            mRenderableCache.push_back();
+            mRenderableCache.elementAt<RENDERABLE_INSTANCE>(index) = ri;
+            mRenderableCache.elementAt<WORLD_TRANSFORM>(index)     =
+                    AffineTransform(tcm.getWorldTransform(ti));
         }
 
         if (li) {
-            // find the dominant directional light
+            const mat4f worldTransform = worldOriginTansform * tcm.getWorldTransform(ti);
             if (UTILS_UNLIKELY(lcm.isDirectionalLight(li))) {
-                // we don't store the directional lights, because we only have a single one
-                if (lcm.getIntensity(li) >= maxIntensity) {
-                    float3 d = lcm.getLocalDirection(li);
-                    // using the inverse-transpose handles non-uniform scaling
-                    d = normalize(transpose(inverse(worldTransform.upperLeft())) * d);
-                    lightData.elementAt<FScene::DIRECTION>(0)       = d;
-                    lightData.elementAt<FScene::LIGHT_INSTANCE>(0)  = li;
-                }
+                mDirectionalLights.push_back({ e, li, getWorldDirection(li, worldTransform) });
             } else {
-                const float4 p = worldTransform * float4{ lcm.getLocalPosition(li), 1 };
-                float3 d = 0;
-                if (!lcm.isPointLight(li) || lcm.isIESLight(li)) {
-                    d = lcm.getLocalDirection(li);
-                    // using the inverse-transpose handles non-uniform scaling
-                    d = normalize(transpose(inverse(worldTransform.upperLeft())) * d);
-                }
-                lightData.push_back_unsafe(
-                        float4{ p.xyz, lcm.getRadius(li) }, d, li, {}, {});
+                mLightSlots[e] = uint32_t(mLightCache.size());
+                mLightCache.push_back();
+                mLightCache.elementAt<LIGHT_INSTANCE>(mLightCache.size() - 1) = li;
+                mLightTransforms.push_back(worldTransform);
             }
         }
+
+        mCachedEntities.push_back(e);
+    }
+
+    /*
+     * Then compute the world-space data of each range of entities on multiple threads, each
+     * job writes a disjoint slice of the cache.
+     */
+
+    auto renderableFunctor = [this, &worldOriginTansform](uint32_t index, uint32_t c) {
+        prepareRenderables(index, c, worldOriginTansform);
+    };
+
+    auto lightFunctor = [this](uint32_t index, uint32_t c) {
+        for (uint32_t i = index, e = index + c; i < e; i++) {
+            setLightData(i, mLightCache.elementAt<LIGHT_INSTANCE>(i), mLightTransforms[i]);
+        }
+    };
+
+    auto* root = js.createJob();
+    js.run(jobs::parallel_for(js, root, 0, (uint32_t)mRenderableCache.size(),
+            std::ref(renderableFunctor), jobs::CountSplitter<Culler::MODULO * 8, 8>()));
+    js.run(jobs::parallel_for(js, root, 0, (uint32_t)mLightCache.size(),
+            std::ref(lightFunctor), jobs::CountSplitter<Culler::MODULO * 8, 8>()));
+    js.runAndWait(root);
+
+    /*
+     * Finally, build the culling hierarchies if needed. This reorders the caches so that each
+     * node of a hierarchy covers a contiguous range of renderables or lights.
+     */
+
+    if (mHierarchicalCulling) {
+        buildBvh();
+        buildLightBvh();
+    } else {
+        mBvh.clear();
+        mLightBvh.clear();
+    }
+}
+
+// reorders 'cache' as given by Bvh::build(), and updates the slots of its entities
+template<typename SoA>
+static void reorderCache(SoA& cache, SoA& scratch, std::vector<uint32_t> const& order,
+        tsl::robin_map<Entity, uint32_t>& slots) {
+    scratch.clear();
+    if (scratch.capacity() < cache.capacity()) {
+        scratch.setCapacity(cache.capacity());
+    }
+    scratch.resize(cache.size());
+    permuteArrays(scratch, cache, order.data(), std::make_index_sequence<SoA::getArrayCount()>());
+    copyArrays(cache, 0, scratch, std::make_index_sequence<SoA::getArrayCount()>());
+
+    // update the slots, for that we need the new position of each entry
+    std::vector<uint32_t> positions(order.size());
+    for (uint32_t i = 0, c = uint32_t(order.size()); i < c; i++) {
+        positions[order[i]] = i;
+    }
+    for (auto it = slots.begin(); it != slots.end(); ++it) {
+        it.value() = positions[it->second];
+    }
+}
+
+void FScene::buildBvh() {
+    SYSTRACE_CALL();
+
+    RenderableSoa& cache = mRenderableCache;
+    std::vector<uint32_t>& order = mBvhOrder;
+    mBvh.build(cache.data<WORLD_AABB_CENTER>(), cache.data<WORLD_AABB_EXTENT>(), cache.size(),
+            order);
+    reorderCache(cache, mRenderableScratch, order, mRenderableSlots);
+}
+
+void FScene::buildLightBvh() {
+    SYSTRACE_CALL();
+
+    LightSoa& cache = mLightCache;
+    const size_t count = cache.size();
+    float4 const* const UTILS_RESTRICT spheres = cache.data<POSITION_RADIUS>();
+    mLightCenters.resize(count);
+    mLightExtents.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        mLightCenters[i] = spheres[i].xyz;
+        mLightExtents[i] = spheres[i].w;
+    }
+
+    std::vector<uint32_t>& order = mBvhOrder;
+    mLightBvh.build(mLightCenters.data(), mLightExtents.data(), count, order);
+    reorderCache(cache, mLightScratch, order, mLightSlots);
+
+    // the boxes must follow the lights
+    for (size_t i = 0; i < count; i++) {
+        mLightCenters[i] = spheres[i].xyz;
+        mLightExtents[i] = spheres[i].w;
+    }
+}
+
+void FScene::gather(Entity e, const math::mat4f& worldOriginTansform) {
+    FEngine& engine = mEngine;
+    FTransformManager& tcm = engine.getTransformManager();
+
+    // most changes are for entities that are not in this scene
+    auto renderable = mRenderableSlots.find(e);
+    auto light = mLightSlots.find(e);
+    auto directional = std::find_if(mDirectionalLights.begin(), mDirectionalLights.end(),
+            [e](DirectionalLight const& item) { return item.entity == e; });
+    if (renderable == mRenderableSlots.end() && light == mLightSlots.end() &&
+            directional == mDirectionalLights.end()) {
+        return;
+    }
+
+    auto ti = tcm.getInstance(e);
+    if (renderable != mRenderableSlots.end()) {
+        const uint32_t index = renderable->second;
+        mRenderableCache.elementAt<RENDERABLE_INSTANCE>(index) =
+                engine.getRenderableManager().getInstance(e);
+        mRenderableCache.elementAt<WORLD_TRANSFORM>(index) =
+                AffineTransform(tcm.getWorldTransform(ti));
+        prepareRenderables(index, 1, worldOriginTansform);
+        mRenderableVersions[index] = mVersion;
+        if (mHierarchicalCulling) {
+            mBvh.invalidate(index);
+        }
+    }
+
+    const mat4f worldTransform = worldOriginTansform * tcm.getWorldTransform(ti);
+    if (light != mLightSlots.end()) {
+        const uint32_t index = light->second;
+        setLightData(index, engine.getLightManager().getInstance(e), worldTransform);
+        if (mHierarchicalCulling) {
+            const float4 sphere = mLightCache.elementAt<POSITION_RADIUS>(index);
+            mLightCenters[index] = sphere.xyz;
+            mLightExtents[index] = sphere.w;
+            mLightBvh.invalidate(index);
+        }
+    }
+    if (directional != mDirectionalLights.end()) {
+        directional->direction = getWorldDirection(directional->instance, worldTransform);
+    }
+}
+
+void FScene::prepareRenderables(uint32_t first, uint32_t count,
+        const math::mat4f& worldOriginTransform) noexcept {
+    // this is called from multiple threads, it must only write entries [first, first + count)
+    FRenderableManager& rcm = mEngine.getRenderableManager();
+    RenderableSoa& cache = mRenderableCache;
+
+    auto const* const UTILS_RESTRICT instances = cache.data<RENDERABLE_INSTANCE>() + first;
+    AffineTransform* const UTILS_RESTRICT worldTransforms = cache.data<WORLD_TRANSFORM>() + first;
+    float3* const UTILS_RESTRICT worldAABBCenter = cache.data<WORLD_AABB_CENTER>() + first;
+    float3* const UTILS_RESTRICT worldAABBExtent = cache.data<WORLD_AABB_EXTENT>() + first;
+
+    // WORLD_TRANSFORM holds the transform from TransformManager, which doesn't include
+    // the world origin yet. Also, fetch the local AABB and transform them all in one go below.
+    const AffineTransform origin(worldOriginTransform);
+    for (size_t i = 0; i < count; i++) {
+        const auto ri = instances[i];
+        const Box& aabb = rcm.getAABB(ri);
+        worldTransforms[i] = origin * worldTransforms[i];
+        worldAABBCenter[i] = aabb.center;
+        worldAABBExtent[i] = aabb.halfExtent;
+        cache.elementAt<VISIBILITY_STATE>(first + i)    = rcm.getVisibility(ri);
+        cache.elementAt<BONES_UBH>(first + i)           = rcm.getBonesUbh(ri);
+        cache.elementAt<BONES_OFFSET>(first + i)        = rcm.getBonesOffset(ri);
+        cache.elementAt<MORPHING_UBH>(first + i)        = rcm.getMorphingUbh(ri);
+        cache.elementAt<MORPH_TARGETS_SBH>(first + i)   = rcm.getMorphTargetsSbh(ri);
+        cache.elementAt<VISIBLE_MASK>(first + i)        = 0;
+        cache.elementAt<SPOT_SHADOW_MASK>(first + i)    = 0;
+        cache.elementAt<LAYERS>(first + i)              = rcm.getLayerMask(ri);
     }
+
+    // compute the world AABBs so we can perform culling
+    computeWorldAABBs(worldAABBCenter, worldAABBExtent, worldTransforms, count);
+}
+
+void FScene::setLightData(size_t index, FLightManager::Instance li,
+        const math::mat4f& worldTransform) noexcept {
+    FLightManager& lcm = mEngine.getLightManager();
+    LightSoa& cache = mLightCache;
+
+    const float4 p = worldTransform * float4{ lcm.getLocalPosition(li), 1 };
+    float3 d = 0;
+    if (!lcm.isPointLight(li) || lcm.isIESLight(li)) {
+        d = getWorldDirection(li, worldTransform);
+    }
+
+    cache.elementAt<POSITION_RADIUS>(index) = float4{ p.xyz, lcm.getRadius(li) };
+    cache.elementAt<DIRECTION>(index)       = d;
+    cache.elementAt<SPOT_PARAMS>(index)     = float2{
+            lcm.getCosOuterSquared(li), lcm.getSinInverse(li) };
+    cache.elementAt<LIGHT_INSTANCE>(index)  = li;
+}
+
+float3 FScene::getWorldDirection(FLightManager::Instance li,
+        const math::mat4f& worldTransform) const noexcept {
+    FLightManager& lcm = mEngine.getLightManager();
+    float3 d = lcm.getLocalDirection(li);
+    // using the inverse-transpose handles non-uniform scaling
+    return normalize(transpose(inverse(worldTransform.upperLeft())) * d);
 }
 
 void FScene::updateUBOs(utils::Range<uint32_t> visibleRenderables) const noexcept {
@@ -165,27 +467,51 @@ void FScene::terminate(FEngine& engine) {
     mGpuLightData.terminate(engine);
 }
 
-void FScene::prepareDynamicLights(const CameraInfo& camera, ArenaScope& rootArena) noexcept {
+void FScene::prepareDynamicLights(const CameraInfo& camera, ArenaScope& rootArena,
+        size_t maxLightCount, Slice<const FLightManager::Instance> shadowedSpotLights) noexcept {
     FLightManager& lcm = mEngine.getLightManager();
     GpuLightBuffer& gpuLightData = mGpuLightData;
     FScene::LightSoa& lightData = getLightData();
 
     /*
      * Here we copy our lights data into the GPU buffer, some lights might be left out if there
-     * are more than the GPU buffer allows (i.e. 256).
+     * are more than the GPU buffer allows (i.e. 256) or than the view's limit.
      *
-     * We always sort lights by distance to the camera plane so that:
-     * - we can build light trees
-     * - lights farther from the camera are dropped when in excess
-     *   (note this doesn't work well, e.g. for search-lights)
+     * The lights kept are those with the largest contribution on screen, estimated as their
+     * intensity times their projected radius. They fade out as their contribution gets close to
+     * the one of the first light left out, so that they don't pop in and out of the budget.
+     *
+     * We always sort lights by distance to the camera plane so that we can build light trees
+     * and bin the lights by depth.
      */
 
     ArenaScope arena(rootArena.getAllocator());
     float* const UTILS_RESTRICT distances = arena.allocate<float>(lightData.size(), CACHELINE_SIZE);
 
+    float4 const* const UTILS_RESTRICT spheres = lightData.data<FScene::POSITION_RADIUS>();
+    auto const* UTILS_RESTRICT instances = lightData.data<FScene::LIGHT_INSTANCE>();
+    const float3 cameraPosition = camera.getPosition();
+
+    // drop excess lights
+    assert(maxLightCount <= CONFIG_MAX_LIGHT_COUNT);
+    float importanceCutoff = 0.0f;
+    if (lightData.size() > maxLightCount + DIRECTIONAL_LIGHTS_COUNT) {
+        float* const UTILS_RESTRICT importances =
+                arena.allocate<float>(lightData.size(), CACHELINE_SIZE);
+        for (size_t i = DIRECTIONAL_LIGHTS_COUNT, c = lightData.size(); i < c; ++i) {
+            importances[i] = computeLightImportance(
+                    cameraPosition, spheres[i], lcm.getIntensity(instances[i]));
+        }
+        Zip2Iterator<FScene::LightSoa::iterator, float*> b = { lightData.begin(), importances };
+        std::nth_element(b + DIRECTIONAL_LIGHTS_COUNT,
+                b + DIRECTIONAL_LIGHTS_COUNT + maxLightCount, b + lightData.size(),
+                [](auto const& lhs, auto const& rhs) { return lhs.second > rhs.second; });
+        importanceCutoff = importances[DIRECTIONAL_LIGHTS_COUNT + maxLightCount];
+        lightData.resize(maxLightCount + DIRECTIONAL_LIGHTS_COUNT);
+    }
+
     // pre-compute the lights' distance to the camera plane, for sorting below
     // - we don't skip the directional light, because we don't care, it's ignored during sorting
-    float4 const* const UTILS_RESTRICT spheres = lightData.data<FScene::POSITION_RADIUS>();
     computeLightCameraPlaneDistances(distances, camera, spheres, lightData.size());
 
     // skip directional light
@@ -193,23 +519,35 @@ void FScene::prepareDynamicLights(const CameraInfo& camera, ArenaScope& rootAren
     std::sort(b + DIRECTIONAL_LIGHTS_COUNT, b + lightData.size(),
             [](auto const& lhs, auto const& rhs) { return lhs.second < rhs.second; });
 
-    // drop excess lights
-    lightData.resize(std::min(lightData.size(), CONFIG_MAX_LIGHT_COUNT + DIRECTIONAL_LIGHTS_COUNT));
-
     // compute the light ranges (needed when building light trees)
     float2* const zrange = lightData.data<FScene::SCREEN_SPACE_Z_RANGE>();
     computeLightRanges(zrange, camera, spheres, lightData.size());
 
     auto const* UTILS_RESTRICT directions   = lightData.data<FScene::DIRECTION>();
-    auto const* UTILS_RESTRICT instances    = lightData.data<FScene::LIGHT_INSTANCE>();
     for (size_t i = DIRECTIONAL_LIGHTS_COUNT, c = lightData.size(); i < c; ++i) {
         GpuLightBuffer::LightIndex gpuIndex = GpuLightBuffer::LightIndex(i - DIRECTIONAL_LIGHTS_COUNT);
         GpuLightBuffer::LightParameters& lp = gpuLightData.getLightParameters(gpuIndex);
         auto li = instances[i];
+        float3 const& color = lcm.getColor(li);
+        float3 const& direction = directions[i];
+        // index of the light's shadow map (there are only a few shadowed lights)
+        auto shadow = std::find(shadowedSpotLights.begin(), shadowedSpotLights.end(), li);
         lp.positionFalloff      = { spheres[i].xyz, lcm.getSquaredFalloffInv(li) };
-        lp.colorIntensity       = { lcm.getColor(li), lcm.getIntensity(li) };
-        lp.directionIES         = { directions[i], 0 };
-        lp.spotScaleOffset.xy   = { lcm.getSpotParams(li).scaleOffset };
+        lp.colorDirection       = {
+                GpuLightBuffer::packHalf2x16(color.xy),
+                GpuLightBuffer::packHalf2x16({ color.z, direction.x }),
+                GpuLightBuffer::packHalf2x16(direction.yz),
+                shadow != shadowedSpotLights.end() ?
+                        uint32_t(shadow - shadowedSpotLights.begin()) : GpuLightBuffer::NO_SHADOW };
+        // point lights have no angle attenuation, so that they can be evaluated as spot lights
+        const float2 scaleOffset = lcm.isPointLight(li) ?
+                float2{ 0, 1 } : lcm.getSpotParams(li).scaleOffset;
+        float intensity = lcm.getIntensity(li);
+        if (importanceCutoff > 0.0f) {
+            const float importance = computeLightImportance(cameraPosition, spheres[i], intensity);
+            intensity *= saturate((importance - importanceCutoff) / importanceCutoff);
+        }
+        lp.intensitySpot        = { intensity, scaleOffset.x, scaleOffset.y, 0 };
     }
 
     gpuLightData.invalidate(0, lightData.size() - DIRECTIONAL_LIGHTS_COUNT);
@@ -220,6 +558,33 @@ void FScene::prepareDynamicLights(const CameraInfo& camera, ArenaScope& rootAren
 // produces much better vectorization. The ALWAYS_INLINE keyword makes sure we actually don't
 // pay the price of the call!
 UTILS_ALWAYS_INLINE
+void FScene::computeWorldAABBs(
+        float3* UTILS_RESTRICT const center,
+        float3* UTILS_RESTRICT const extent,
+        AffineTransform const* UTILS_RESTRICT const worldTransforms, size_t count) noexcept {
+
+    // This is the same as rigidTransform(), but written as a loop over the SoA so it gets
+    // vectorized, processing several boxes per iteration. We can't round count up here
+    // (like Culler does) because the boxes are transformed in place and the next entries
+    // may belong to another job.
+    #pragma clang loop vectorize_width(4)
+    for (size_t i = 0; i < count; i++) {
+        worldTransforms[i].transformBox(center[i], extent[i]);
+    }
+}
+
+// These methods need to exist so clang honors the __restrict__ keyword, which in turn
+// produces much better vectorization. The ALWAYS_INLINE keyword makes sure we actually don't
+// pay the price of the call!
+UTILS_ALWAYS_INLINE
+float FScene::computeLightImportance(float3 const& cameraPosition, float4 const& sphere,
+        float intensity) noexcept {
+    // the radius over the distance approximates the projected radius, it's 1 when the camera
+    // is within the light's influence
+    const float distance = length(sphere.xyz - cameraPosition);
+    return intensity * sphere.w / std::max(distance, sphere.w);
+}
+
 void FScene::computeLightCameraPlaneDistances(
         float* UTILS_RESTRICT const distances,
         CameraInfo const& UTILS_RESTRICT camera,
@@ -269,11 +634,55 @@ void FScene::computeLightRanges(
 }
 
 void FScene::addEntity(Entity entity) {
-    mEntities.insert(entity);
+    if (mEntityIndices.find(entity) == mEntityIndices.end()) {
+        mEntityIndices[entity] = uint32_t(mEntities.size());
+        mEntities.push_back(entity);
+        mEntitiesChanged = true;
+    }
 }
 
 void FScene::remove(Entity entity) {
-    mEntities.erase(entity);
+    auto pos = mEntityIndices.find(entity);
+    if (pos == mEntityIndices.end()) {
+        return;
+    }
+    // the last entity takes the place of the one removed, the order is restored by gatherAll()
+    const uint32_t index = pos->second;
+    mEntityIndices.erase(pos);
+    if (index != mEntities.size() - 1) {
+        mEntities[index] = mEntities.back();
+        mEntityIndices[mEntities[index]] = index;
+    }
+    mEntities.pop_back();
+    mEntitiesChanged = true;
+}
+
+void FScene::sortEntities() noexcept {
+    FEngine& engine = mEngine;
+    FRenderableManager& rcm = engine.getRenderableManager();
+    FLightManager& lcm = engine.getLightManager();
+
+    // The renderables come first, by instance, then the lights, by instance, then the others.
+    // Instances are mostly allocated in creation order, so the transforms follow roughly too.
+    auto& keys = mEntityKeys;
+    keys.clear();
+    keys.reserve(mEntities.size());
+    for (Entity e : mEntities) {
+        auto ri = rcm.getInstance(e);
+        auto li = lcm.getInstance(e);
+        const uint64_t key = ri ? ri.asValue() :
+                li ? (uint64_t(1) << 32u) + li.asValue() : (uint64_t(2) << 32u);
+        keys.emplace_back(key, e);
+    }
+    std::sort(keys.begin(), keys.end(), [](auto const& lhs, auto const& rhs) {
+        return lhs.first < rhs.first;
+    });
+    for (uint32_t i = 0, c = uint32_t(keys.size()); i < c; i++) {
+        if (mEntities[i] != keys[i].second) {
+            mEntities[i] = keys[i].second;
+            mEntityIndices[keys[i].second] = i;
+        }
+    }
 }
 
 size_t FScene::getRenderableCount() const noexcept {
@@ -300,6 +709,14 @@ size_t FScene::getLightCount() const noexcept {
     return count;
 }
 
+void FScene::setHierarchicalCulling(bool enabled) noexcept {
+    if (mHierarchicalCulling != enabled) {
+        mHierarchicalCulling = enabled;
+        // the cache must be gathered again, to build the hierarchy (or release it)
+        mEntitiesChanged = true;
+    }
+}
+
 void FScene::setSkybox(FSkybox const* skybox) noexcept {
     std::swap(mSkybox, skybox);
     if (skybox) {
@@ -314,6 +731,48 @@ void FScene::computeBounds(
         Aabb& UTILS_RESTRICT castersBox,
         Aabb& UTILS_RESTRICT receiversBox,
         uint32_t visibleLayers) const noexcept {
+    SYSTRACE_CALL();
+
+    // The renderables are split in (at most) MAX_CHUNK_COUNT chunks whose bounds are computed
+    // in parallel, then merged. Each chunk has its own result so the jobs don't need to
+    // synchronize, and the result doesn't depend on how the jobs were scheduled.
+    constexpr size_t MAX_CHUNK_COUNT = 64;
+    constexpr size_t MIN_CHUNK_SIZE = 512;
+    const size_t count = mRenderableData.size();
+    const size_t chunkSize = std::max(MIN_CHUNK_SIZE, (count + MAX_CHUNK_COUNT - 1) / MAX_CHUNK_COUNT);
+    const size_t chunkCount = (count + chunkSize - 1) / chunkSize;
+    assert(chunkCount <= MAX_CHUNK_COUNT);
+
+    Aabb casters[MAX_CHUNK_COUNT];
+    Aabb receivers[MAX_CHUNK_COUNT];
+    auto functor = [this, &casters, &receivers, chunkSize, count, visibleLayers]
+            (uint32_t index, uint32_t c) {
+        for (size_t i = index, e = index + c; i < e; i++) {
+            computeBounds(casters[i], receivers[i], visibleLayers,
+                    i * chunkSize, std::min(count, (i + 1) * chunkSize));
+        }
+    };
+
+    if (chunkCount > 1) {
+        JobSystem& js = mEngine.getJobSystem();
+        js.runAndWait(jobs::parallel_for(js, nullptr, 0, uint32_t(chunkCount),
+                std::cref(functor), jobs::CountSplitter<1, 8>()));
+    } else {
+        functor(0, uint32_t(chunkCount));
+    }
+
+    for (size_t i = 0; i < chunkCount; i++) {
+        castersBox.min = min(castersBox.min, casters[i].min);
+        castersBox.max = max(castersBox.max, casters[i].max);
+        receiversBox.min = min(receiversBox.min, receivers[i].min);
+        receiversBox.max = max(receiversBox.max, receivers[i].max);
+    }
+}
+
+void FScene::computeBounds(
+        Aabb& UTILS_RESTRICT castersBox,
+        Aabb& UTILS_RESTRICT receiversBox,
+        uint32_t visibleLayers, size_t first, size_t last) const noexcept {
     using State = FRenderableManager::Visibility;
 
     // Compute the scene bounding volume
@@ -322,8 +781,7 @@ void FScene::computeBounds(
     float3 const* const UTILS_RESTRICT worldAABBExtent = soa.data<WORLD_AABB_EXTENT>();
     uint8_t const* const UTILS_RESTRICT layers = soa.data<LAYERS>();
     State const* const UTILS_RESTRICT visibility = soa.data<VISIBILITY_STATE>();
-    size_t c = soa.size();
-    for (size_t i = 0; i < c; i++) {
+    for (size_t i = first; i < last; i++) {
         if (layers[i] & visibleLayers) {
             const Aabb aabb{ worldAABBCenter[i] - worldAABBExtent[i],
                              worldAABBCenter[i] + worldAABBExtent[i] };
@@ -371,4 +829,12 @@ size_t Scene::getLightCount() const noexcept {
     return upcast(this)->getLightCount();
 }
 
+void Scene::setHierarchicalCulling(bool enabled) noexcept {
+    upcast(this)->setHierarchicalCulling(enabled);
+}
+
+bool Scene::isHierarchicalCullingEnabled() const noexcept {
+    return upcast(this)->isHierarchicalCullingEnabled();
+}
+
 } // namespace filament
@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "details/SceneLoader.h"
+
+#include "details/Camera.h"
+#include "details/Engine.h"
+#include "details/Scene.h"
+
+#include "FilamentAPI-impl.h"
+
+#include <filament/Box.h>
+
+#include <utils/Panic.h>
+#include <utils/Systrace.h>
+
+#include <algorithm>
+#include <chrono>
+
+using namespace math;
+using namespace utils;
+
+namespace filament {
+
+using namespace details;
+
+struct SceneLoader::BuilderDetails {
+    Scene* mScene = nullptr;
+    Camera const* mCamera = nullptr;
+    uint32_t mBudget = 2000;
+    size_t mUploadBudget = 8 * 1024 * 1024;
+};
+
+using BuilderType = SceneLoader;
+BuilderType::Builder::Builder() noexcept = default;
+BuilderType::Builder::~Builder() noexcept = default;
+BuilderType::Builder::Builder(BuilderType::Builder const& rhs) noexcept = default;
+BuilderType::Builder::Builder(BuilderType::Builder&& rhs) noexcept = default;
+BuilderType::Builder& BuilderType::Builder::operator=(BuilderType::Builder const& rhs) noexcept = default;
+BuilderType::Builder& BuilderType::Builder::operator=(BuilderType::Builder&& rhs) noexcept = default;
+
+SceneLoader::Builder& SceneLoader::Builder::scene(Scene* scene) noexcept {
+    mImpl->mScene = scene;
+    return *this;
+}
+
+SceneLoader::Builder& SceneLoader::Builder::camera(Camera const* camera) noexcept {
+    mImpl->mCamera = camera;
+    return *this;
+}
+
+SceneLoader::Builder& SceneLoader::Builder::budget(uint32_t microseconds) noexcept {
+    mImpl->mBudget = microseconds;
+    return *this;
+}
+
+SceneLoader::Builder& SceneLoader::Builder::uploadBudget(size_t bytes) noexcept {
+    mImpl->mUploadBudget = bytes;
+    return *this;
+}
+
+SceneLoader* SceneLoader::Builder::build(Engine& engine) {
+    if (!ASSERT_PRECONDITION_NON_FATAL(mImpl->mScene, "scene must be set")) {
+        return nullptr;
+    }
+    return upcast(engine).createSceneLoader(*this);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+namespace details {
+
+FSceneLoader::FSceneLoader(FEngine& engine, const Builder& builder) noexcept
+        : mScene(upcast(builder->mScene)),
+          mCamera(upcast(builder->mCamera)),
+          mBudget(builder->mBudget),
+          mUploadBudget(builder->mUploadBudget) {
+}
+
+void FSceneLoader::terminate(FEngine& engine) noexcept {
+    // the entities still queued are dropped, they belong to the application
+    mPending.clear();
+}
+
+void FSceneLoader::add(Entity entity, Box const& aabb, LoadCallback callback,
+        void* user) noexcept {
+    mPending.push_back({ entity, aabb.center, length(aabb.halfExtent), 0.0f, mSequence++,
+            callback, user });
+    mSorted = false;
+}
+
+void FSceneLoader::remove(Entity entity) noexcept {
+    auto pos = std::find_if(mPending.begin(), mPending.end(),
+            [entity](Pending const& p) { return p.entity == entity; });
+    if (pos != mPending.end()) {
+        // erase() keeps the queue sorted
+        mPending.erase(pos);
+    }
+}
+
+void FSceneLoader::sort() noexcept {
+    SYSTRACE_CALL();
+
+    // without a camera, all the distances are 0 and the entities load in the order of add()
+    const float3 eye = mCamera ? mCamera->getPosition() : float3{};
+    for (Pending& p : mPending) {
+        p.distance = mCamera ? std::max(0.0f, length(p.center - eye) - p.radius) : 0.0f;
+    }
+    std::sort(mPending.begin(), mPending.end(), [](Pending const& lhs, Pending const& rhs) {
+        return lhs.distance != rhs.distance ? lhs.distance > rhs.distance
+                                            : lhs.sequence > rhs.sequence;
+    });
+    mSortPosition = eye;
+    mSorted = true;
+}
+
+void FSceneLoader::execute(FEngine& engine) noexcept {
+    if (mPending.empty()) {
+        return;
+    }
+
+    SYSTRACE_CALL();
+
+    using clock = std::chrono::steady_clock;
+    const clock::time_point deadline = clock::now() + std::chrono::microseconds(mBudget);
+
+    // Sorting tens of thousands of entities each frame the camera moves would eat the budget,
+    // so we only do it once the camera moved by a tenth of the distance to the next entity,
+    // which bounds the error on the priorities of the entities loaded until then.
+    if (mSorted && mCamera) {
+        const float moved = length(mCamera->getPosition() - mSortPosition);
+        mSorted = moved <= mPending.back().distance * 0.1f;
+    }
+    if (!mSorted) {
+        sort();
+    }
+
+    Engine& api = engine;
+    size_t uploaded = 0;
+    do {
+        const Pending p = mPending.back();
+        mPending.pop_back();
+        uploaded += p.callback(api, p.entity, p.user);
+        mScene->addEntity(p.entity);
+    } while (!mPending.empty() && clock::now() < deadline &&
+             (!mUploadBudget || uploaded < mUploadBudget));
+}
+
+} // namespace details
+
+// ------------------------------------------------------------------------------------------------
+// Trampoline calling into private implementation
+// ------------------------------------------------------------------------------------------------
+
+void SceneLoader::add(Entity entity, Box const& aabb, LoadCallback callback,
+        void* user) noexcept {
+    upcast(this)->add(entity, aabb, callback, user);
+}
+
+void SceneLoader::remove(Entity entity) noexcept {
+    upcast(this)->remove(entity);
+}
+
+void SceneLoader::setCamera(Camera const* camera) noexcept {
+    upcast(this)->setCamera(upcast(camera));
+}
+
+void SceneLoader::setBudget(uint32_t microseconds) noexcept {
+    upcast(this)->setBudget(microseconds);
+}
+
+void SceneLoader::setUploadBudget(size_t bytes) noexcept {
+    upcast(this)->setUploadBudget(bytes);
+}
+
+size_t SceneLoader::getPendingCount() const noexcept {
+    return upcast(this)->getPendingCount();
+}
+
+} // namespace filament
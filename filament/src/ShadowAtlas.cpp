@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "details/ShadowAtlas.h"
+
+#include "PostProcessManager.h"
+
+#include "details/Engine.h"
+
+#include <filament/driver/DriverEnums.h>
+
+#include <utils/algorithm.h>
+
+#include <algorithm>
+
+using namespace utils;
+
+namespace filament {
+using namespace driver;
+
+namespace details {
+
+// keeps the even bits of v, packed in its lower half
+static inline uint32_t compactBits(uint32_t v) noexcept {
+    v &= 0x55555555u;
+    v = (v | (v >> 1u)) & 0x33333333u;
+    v = (v | (v >> 2u)) & 0x0F0F0F0Fu;
+    v = (v | (v >> 4u)) & 0x00FF00FFu;
+    v = (v | (v >> 8u)) & 0x0000FFFFu;
+    return v;
+}
+
+ShadowAtlas::ShadowAtlas(FEngine& engine) noexcept
+        : mEngine(engine) {
+}
+
+void ShadowAtlas::terminate() noexcept {
+    RenderTargetPool& rtp = mEngine.getRenderTargetPool();
+    if (mTarget) {
+        rtp.put(mTarget);
+        mTarget = nullptr;
+    }
+    if (mCacheTarget) {
+        rtp.put(mCacheTarget);
+        mCacheTarget = nullptr;
+    }
+    if (mMomentsTarget) {
+        rtp.put(mMomentsTarget);
+        rtp.put(mBlurTarget);
+        mMomentsTarget = nullptr;
+        mBlurTarget = nullptr;
+    }
+}
+
+size_t ShadowAtlas::add(uint32_t dimension) noexcept {
+    assert(mTileCount < MAX_TILE_COUNT);
+    dimension = std::min(std::max(1u, dimension), CONFIG_MAX_SHADOW_ATLAS_DIMENSION);
+    // round up to a power of two
+    if (dimension & (dimension - 1u)) {
+        dimension = 1u << (32u - utils::clz(dimension));
+    }
+    mTiles[mTileCount] = { dimension, {} };
+    return mTileCount++;
+}
+
+void ShadowAtlas::allocate(SamplerBuffer& sb) noexcept {
+    // sort the tiles by decreasing dimension (there is only a handful of them)
+    size_t order[MAX_TILE_COUNT];
+    uint32_t atlasDimension = 1;
+    uint64_t area = 0;
+    for (size_t i = 0; i < mTileCount; i++) {
+        order[i] = i;
+        atlasDimension = std::max(atlasDimension, mTiles[i].dimension);
+        area += uint64_t(mTiles[i].dimension) * mTiles[i].dimension;
+    }
+    std::stable_sort(order, order + mTileCount, [this](size_t lhs, size_t rhs) {
+        return mTiles[lhs].dimension > mTiles[rhs].dimension;
+    });
+
+    // the atlas is the smallest power-of-two square which holds all the tiles
+    while (uint64_t(atlasDimension) * atlasDimension < area &&
+           atlasDimension < CONFIG_MAX_SHADOW_ATLAS_DIMENSION) {
+        atlasDimension *= 2;
+    }
+
+    // Because the tiles are sorted and their dimensions are powers of two, the area allocated
+    // so far is always a multiple of the next tile's area: the position of the tile in the atlas
+    // is simply given by the Morton code of the number of tiles of its size before it.
+    const uint64_t atlasArea = uint64_t(atlasDimension) * atlasDimension;
+    uint64_t offset = 0;
+    for (size_t i = 0; i < mTileCount; i++) {
+        Tile& tile = mTiles[order[i]];
+        const uint32_t dim = tile.dimension;
+        const uint64_t tileArea = uint64_t(dim) * dim;
+        if (offset + tileArea > atlasArea) {
+            // doesn't fit, and no other (smaller or equal) tile will
+            tile.viewport = {};
+            continue;
+        }
+        const uint32_t code = uint32_t(offset / tileArea);
+        tile.viewport = {
+                int32_t(compactBits(code) * dim), int32_t(compactBits(code >> 1u) * dim), dim, dim };
+        offset += tileArea;
+    }
+
+    // keep the current atlas if it's large enough, unless it's much larger than needed.
+    RenderTargetPool& rtp = mEngine.getRenderTargetPool();
+    bool keepTarget = false;
+    if (mTarget) {
+        const uint64_t currentArea = uint64_t(mTarget->w) * mTarget->h;
+        keepTarget = mTarget->w >= atlasDimension && mTarget->h >= atlasDimension &&
+                     2 * currentArea < 3 * atlasArea;
+        if (!keepTarget) {
+            rtp.put(mTarget);
+        }
+    }
+
+    if (!mFormatsChosen) {
+        // 16 bits are enough for shadow maps, which have a tight depth range, and halve the
+        // memory and bandwidth. Not all Vulkan devices can render to them though.
+        DriverApi& driver = mEngine.getDriverApi();
+        mDepthFormat = driver.isRenderTargetFormatSupported(TextureFormat::DEPTH16) ?
+                TextureFormat::DEPTH16 : TextureFormat::DEPTH24;
+        // without RGBA16F targets (e.g. ES 3.0 without EXT_color_buffer_half_float), the
+        // moments are disabled and the receivers use PCF
+        mMomentsSupported = driver.isRenderTargetFormatSupported(TextureFormat::RGBA16F);
+        mFormatsChosen = true;
+    }
+
+    if (!keepTarget) {
+        mTarget = rtp.get(TargetBufferFlags::SHADOW,
+                atlasDimension, atlasDimension, 1, mDepthFormat);
+
+        SamplerParams s;
+        s.filterMag = SamplerMagFilter::LINEAR;
+        s.filterMin = SamplerMinFilter::LINEAR;
+        s.compareFunc = SamplerCompareFunc::LE;
+        s.compareMode = SamplerCompareMode::COMPARE_TO_TEXTURE;
+        s.depthStencil = true;
+        sb.setSampler(FEngine::PerViewSib::SHADOW_MAP, { mTarget->texture, s });
+    }
+
+    // the cache always has the same size as the atlas, so tiles can be copied as-is
+    if (mCacheTarget && (!mCachingEnabled ||
+            mCacheTarget->w != mTarget->w || mCacheTarget->h != mTarget->h)) {
+        rtp.put(mCacheTarget);
+        mCacheTarget = nullptr;
+    }
+    if (mCachingEnabled && !mCacheTarget) {
+        mCacheTarget = rtp.get(TargetBufferFlags::SHADOW,
+                mTarget->w, mTarget->h, 1, mDepthFormat);
+        mCacheGeneration++;
+    }
+
+    // the moments have the same layout as the atlas too
+    const bool moments = mMomentsEnabled && mMomentsSupported;
+    if (mMomentsTarget && (!moments ||
+            mMomentsTarget->w != mTarget->w || mMomentsTarget->h != mTarget->h)) {
+        rtp.put(mMomentsTarget);
+        rtp.put(mBlurTarget);
+        mMomentsTarget = nullptr;
+        mBlurTarget = nullptr;
+        sb.setSampler(FEngine::PerViewSib::SHADOW_MOMENTS, {}, {});
+    }
+    if (moments && !mMomentsTarget) {
+        mMomentsTarget = rtp.get(TargetBufferFlags::COLOR,
+                mTarget->w, mTarget->h, 1, TextureFormat::RGBA16F);
+        mBlurTarget = rtp.get(TargetBufferFlags::COLOR,
+                mTarget->w, mTarget->h, 1, TextureFormat::RGBA16F);
+
+        // the moments are filtered by the receivers, unlike depths
+        SamplerParams s;
+        s.filterMag = SamplerMagFilter::LINEAR;
+        s.filterMin = SamplerMinFilter::LINEAR;
+        sb.setSampler(FEngine::PerViewSib::SHADOW_MOMENTS, { mMomentsTarget->texture, s });
+    }
+}
+
+void ShadowAtlas::beginRenderPass(DriverApi& driver, Viewport const& viewport,
+        bool clear) const noexcept {
+    assert(mTarget);
+    RenderPassParams params = {};
+    if (clear) {
+        params.clear = TargetBufferFlags::SHADOW;
+        params.discardStart = TargetBufferFlags::DEPTH;
+    }
+    params.discardEnd = TargetBufferFlags::COLOR_AND_STENCIL;
+    params.clearDepth = 1.0;
+    params.width = mTarget->w;
+    params.height = mTarget->h;
+    // Disable scissor and viewport to avoid bugs in some drivers where the GPU memory is reloaded
+    // needlessly.
+    params.clear |= RenderPassParams::IGNORE_SCISSOR | RenderPassParams::IGNORE_VIEWPORT;
+    driver.beginRenderPass(mTarget->target, params);
+    driver.viewport(viewport.left, viewport.bottom, viewport.width, viewport.height);
+}
+
+void ShadowAtlas::beginCacheRenderPass(DriverApi& driver,
+        Viewport const& viewport) const noexcept {
+    assert(mCacheTarget);
+    // only the tile is cleared, the other tiles of the cache are still valid
+    RenderPassParams params = {};
+    params.clear = TargetBufferFlags::SHADOW;
+    params.discardEnd = TargetBufferFlags::COLOR_AND_STENCIL;
+    params.clearDepth = 1.0;
+    params.left = viewport.left;
+    params.bottom = viewport.bottom;
+    params.width = viewport.width;
+    params.height = viewport.height;
+    driver.beginRenderPass(mCacheTarget->target, params);
+}
+
+void ShadowAtlas::clearTarget(DriverApi& driver) const noexcept {
+    beginRenderPass(driver, {}, true);
+    driver.endRenderPass();
+}
+
+void ShadowAtlas::copyFromCache(DriverApi& driver, Viewport const& viewport) const noexcept {
+    assert(mTarget && mCacheTarget);
+    driver.blit(TargetBufferFlags::DEPTH,
+            mTarget->target, viewport.left, viewport.bottom, viewport.width, viewport.height,
+            mCacheTarget->target, viewport.left, viewport.bottom, viewport.width, viewport.height);
+}
+
+void ShadowAtlas::resolveMoments(Viewport const& viewport) const noexcept {
+    assert(mTarget && mMomentsTarget);
+    // The moments of the depths are blurred horizontally, then vertically. Each texel of the
+    // atlas is filtered once per frame, rather than at each fragment of the receivers.
+    FEngine& engine = mEngine;
+    PostProcessManager& ppm = engine.getPostProcessManager();
+    ppm.shadowMomentsPass(engine.getPostProcessProgram(PostProcessStage::SHADOW_MOMENTS),
+            mTarget->texture, true, mBlurTarget, viewport);
+    ppm.shadowMomentsPass(engine.getPostProcessProgram(PostProcessStage::SHADOW_BLUR),
+            mBlurTarget->texture, false, mMomentsTarget, viewport);
+}
+
+} // namespace details
+} // namespace filament
@@ -40,10 +40,31 @@ static constexpr bool USE_DEPTH_CLAMP = false;
 // currently disabled because it creates shadow acnee problems at a distance
 static constexpr bool ENABLE_LISPSM = true;
 
+// weight of the logarithmic split vs. the uniform split of the cascades
+static constexpr float CASCADE_SPLIT_LOG_WEIGHT = 0.5f;
+
+// the near plane of spot lights shadow cameras is never closer than this fraction of the radius
+static constexpr float SPOT_SHADOW_MIN_NEAR_RATIO = 1.0f / 256.0f;
+
+// shadows of spot lights wider than ~84 degrees are clipped
+static constexpr float SPOT_SHADOW_MIN_COS_OUTER = 0.1f;
+
+// cached static casters are rendered again when the light moves by more than this many texels
+static constexpr float STATIC_CACHE_TOLERANCE_TEXELS = 0.25f;
+
+// smallest shadow map chosen by auto-sizing
+static constexpr uint32_t AUTO_SIZE_MIN_DIMENSION = 64;
+
+// auto-sizing only shrinks a shadow map when it needs less than this fraction of its current
+// dimension, so that it doesn't alternate between two powers of two
+static constexpr float AUTO_SIZE_SHRINK_RATIO = 0.4f;
+
 ShadowMap::ShadowMap(FEngine& engine) noexcept :
         mEngine(engine),
         mClipSpaceFlipped(engine.getBackend() == Backend::VULKAN) {
-    mCamera = mEngine.createCamera(EntityManager::get().create());
+    for (Cascade& cascade : mCascades) {
+        cascade.camera = mEngine.createCamera(EntityManager::get().create());
+    }
     mDebugCamera = mEngine.createCamera(EntityManager::get().create());
     FDebugRegistry& debugRegistry = engine.getDebugRegistry();
     debugRegistry.registerProperty("d.shadowmap.focus_shadowcasters", &engine.debug.shadowmap.focus_shadowcasters);
@@ -56,150 +77,271 @@ ShadowMap::ShadowMap(FEngine& engine) noexcept :
 }
 
 ShadowMap::~ShadowMap() {
-    mEngine.destroy(mCamera->getEntity());
+    for (Cascade& cascade : mCascades) {
+        mEngine.destroy(cascade.camera->getEntity());
+    }
     mEngine.destroy(mDebugCamera->getEntity());
 }
 
-void ShadowMap::prepare(DriverApi& driver, SamplerBuffer& sb) noexcept {
-    assert(mShadowMapDimension);
-
-    uint32_t dim = mShadowMapDimension;
-    uint32_t currentDimension = mViewport.width + 2;
-    if (currentDimension == dim) {
-        // nothing to do here.
-        assert(mShadowMapHandle);
-        return;
-    }
-
-    // destroy the current rendertarget and texture
-    if (mShadowMapRenderTarget) {
-        driver.destroyRenderTarget(mShadowMapRenderTarget);
+void ShadowMap::setTile(size_t cascade, Viewport const& tile,
+        uint32_t atlasWidth, uint32_t atlasHeight) noexcept {
+    Cascade& c = mCascades[cascade];
+    if (tile.width == 0 || tile.height == 0) {
+        // the tile didn't fit in the atlas
+        c.hasVisibleShadows = false;
     }
-    if (mShadowMapHandle) {
-        driver.destroyTexture(mShadowMapHandle);
+    if (!c.hasVisibleShadows) {
+        c.viewport = {};
+        c.lightSpace = getLitLightSpaceMatrix();
+        return;
     }
 
-    // allocate new ones...
-    // we set a viewport with a 1-texel border for when we index outside of the texture
-    // DON'T CHANGE this unless computeLightSpaceMatrix() is updated too.
-    // see: computeLightSpaceMatrix()
-    mViewport = { 1, 1, dim - 2, dim - 2 };
-
-    mShadowMapHandle = driver.createTexture(
-            Driver::SamplerType::SAMPLER_2D, 1, Driver::TextureFormat::DEPTH16, 1, dim, dim, 1,
-            TextureUsage::DEPTH_ATTACHMENT);
-
-    mShadowMapRenderTarget = driver.createRenderTarget(
-            TargetBufferFlags::SHADOW, dim, dim, 1, Driver::TextureFormat::DEPTH16,
-            {}, { mShadowMapHandle }, {});
-
-    SamplerParams s;
-    s.filterMag = SamplerMagFilter::LINEAR;
-    s.filterMin = SamplerMinFilter::LINEAR;
-    s.compareFunc = SamplerCompareFunc::LE;
-    s.compareMode = SamplerCompareMode::COMPARE_TO_TEXTURE;
-    s.depthStencil = true;
-    sb.setSampler(FEngine::PerViewSib::SHADOW_MAP, { mShadowMapHandle, s });
+    // each tile has a 1-texel border for when we index outside of it.
+    // DON'T CHANGE this unless getTextureCoordsMapping() is updated too.
+    c.viewport = { tile.left + 1, tile.bottom + 1, tile.width - 2, tile.height - 2 };
+
+    // maps the texture coordinates of the tile to its place in the atlas, the bottom of the
+    // viewport is the top of the texture when the clip-space is flipped.
+    const float sx = float(tile.width) / atlasWidth;
+    const float sy = float(tile.height) / atlasHeight;
+    const float ox = float(tile.left) / atlasWidth;
+    const float oy = float(mClipSpaceFlipped ?
+            (atlasHeight - tile.bottom - tile.height) : uint32_t(tile.bottom)) / atlasHeight;
+    const mat4f Ma(mat4f::row_major_init{
+            sx,  0, 0, ox,
+             0, sy, 0, oy,
+             0,  0, 1,  0,
+             0,  0, 0,  1
+    });
+    c.lightSpace = Ma * c.tileLightSpace;
 }
 
-void ShadowMap::terminate(DriverApi& driverApi) noexcept {
-    if (mShadowMapRenderTarget) {
-        driverApi.destroyRenderTarget(mShadowMapRenderTarget);
+bool ShadowMap::updateStaticCache(size_t cascade, uint32_t staticCastersHash,
+        uint32_t cacheGeneration) noexcept {
+    Cascade& c = mCascades[cascade];
+    StaticCache& cache = c.cache;
+
+    // Each column of the light space matrix is the contribution of one of the world-space
+    // coordinates to the texture coordinates of the tile, so we compare them relative to their
+    // magnitude. This is only an approximation of the texels' motion, but a conservative one.
+    const float tolerance = STATIC_CACHE_TOLERANCE_TEXELS / c.viewport.width;
+    bool sameLightSpace = true;
+    for (size_t i = 0; i < 4; i++) {
+        const float4 d = abs(c.tileLightSpace[i] - cache.tileLightSpace[i]);
+        const float scale = std::max(max(abs(c.tileLightSpace[i])), max(abs(cache.tileLightSpace[i])));
+        sameLightSpace = sameLightSpace && max(d) <= tolerance * scale;
     }
-    if (mShadowMapHandle) {
-        driverApi.destroyTexture(mShadowMapHandle);
+
+    if (cache.valid && sameLightSpace &&
+        cache.viewport == c.viewport &&
+        cache.castersHash == staticCastersHash &&
+        cache.generation == cacheGeneration) {
+        return true;
     }
+
+    cache.tileLightSpace = c.tileLightSpace;
+    cache.viewport = c.viewport;
+    cache.castersHash = staticCastersHash;
+    cache.generation = cacheGeneration;
+    cache.valid = true;
+    return false;
 }
 
-void ShadowMap::beginRenderPass(DriverApi& driver) const noexcept {
-    RenderPassParams params = {};
-    params.clear = TargetBufferFlags::SHADOW;
-    params.discardStart = TargetBufferFlags::DEPTH;
-    params.discardEnd = TargetBufferFlags::COLOR_AND_STENCIL;
-    params.clearDepth = 1.0;
-    params.width = params.height = mShadowMapDimension;
-    // Disable scissor and viewport to avoid bugs in some drivers where the GPU memory is reloaded
-    // needlessly.
-    params.clear |= RenderPassParams::IGNORE_SCISSOR | RenderPassParams::IGNORE_VIEWPORT;
-    driver.beginRenderPass(mShadowMapRenderTarget, params);
-
-    driver.viewport(mViewport.left, mViewport.bottom,
-            mViewport.width, mViewport.height);
+mat4f ShadowMap::getLitLightSpaceMatrix() noexcept {
+    // maps everything to a depth of 0, i.e.: fully lit
+    return mat4f{ float4{ 0 }, float4{ 0 }, float4{ 0 }, float4{ 0, 0, 0, 1 } };
 }
 
 void ShadowMap::update(
-        const FScene::LightSoa& lightData, size_t index, FScene const* scene,
-        details::CameraInfo const& camera, uint8_t visibleLayers) noexcept {
+        const FScene::LightSoa& lightData, size_t index,
+        Aabb const& wsShadowCastersVolume, Aabb const& wsShadowReceiversVolume,
+        details::CameraInfo const& camera, Viewport const& autoSizeViewport) noexcept {
     // this is the hard part here, find a good frustum for our camera
 
     auto& lcm = mEngine.getLightManager();
 
     FLightManager::Instance li = lightData.elementAt<FScene::LIGHT_INSTANCE>(index);
-    mShadowMapDimension = std::max(1u, lcm.getShadowMapSize(li));
+    const uint32_t maxDimension = std::min(std::max(1u, lcm.getShadowMapSize(li)),
+            CONFIG_MAX_SHADOW_ATLAS_DIMENSION);
+
+    using Type = FLightManager::Type;
+    const Type type = lcm.getType(li);
+    const bool directional = type == Type::SUN || type == Type::DIRECTIONAL;
 
     FLightManager::ShadowParams params = lcm.getShadowParams(li);
-    mat4f projection(camera.cullingProjection);
-    if (params.shadowFar > 0.0f) {
-        float n = camera.zn;
-        float f = params.shadowFar;
-        if (std::abs(projection[2].w) <= std::numeric_limits<float>::epsilon()) {
-            // perspective projection
-            projection[2].z =     (f + n) / (n - f);
-            projection[3].z = (2 * f * n) / (n - f);
-        } else {
-            // ortho projection
-            projection[2].z =    2.0f / (n - f);
-            projection[3].z = (f + n) / (n - f);
+    mCascadeCount = directional ? params.shadowCascades : 1u;
+
+    if (!autoSizeViewport.empty()) {
+        // only the receivers lit by a spot light matter
+        Aabb wsReceivers = wsShadowReceiversVolume;
+        if (!directional) {
+            const float4 sphere = lightData.elementAt<FScene::POSITION_RADIUS>(index);
+            wsReceivers.min = max(wsReceivers.min, sphere.xyz - sphere.w);
+            wsReceivers.max = min(wsReceivers.max, sphere.xyz + sphere.w);
         }
+        const float receiversDimension =
+                computeReceiversDimension(wsReceivers, camera, autoSizeViewport);
+        mShadowMapDimension = chooseDimension(receiversDimension,
+                mShadowMapDimension, maxDimension);
+    } else {
+        mShadowMapDimension = maxDimension;
     }
 
-    CameraInfo cameraInfo = {
-            .projection = projection,
-            .model = camera.model,
-            .view = camera.view,
-            .zn = camera.zn,
-            .zf = camera.zf,
-            .dzn = std::max(0.0f, params.shadowNearHint - camera.zn),
-            .dzf = std::max(0.0f, camera.zf - params.shadowFarHint),
-            .frustum = Frustum(projection * camera.view),
-            .worldOrigin = camera.worldOrigin
-    };
+    // the view frustum, up to shadowFar, is split in as many ranges as we have cascades
+    float splits[CONFIG_MAX_SHADOW_CASCADES + 1];
+    computeCascadeSplits(splits, mCascadeCount,
+            camera.zn, params.shadowFar > 0.0f ? params.shadowFar : camera.zf);
+
+    mHasVisibleShadows = false;
+    for (size_t i = 0; i < CONFIG_MAX_SHADOW_CASCADES; i++) {
+        Cascade& cascade = mCascades[i];
+        cascade.hasVisibleShadows = false;
+        // unused cascades are never selected by the shaders
+        cascade.split = i < mCascadeCount ? splits[i + 1] : std::numeric_limits<float>::max();
+    }
 
-    // debugging...
-    const float dz = cameraInfo.zf - cameraInfo.zn;
-    float& dzn = mEngine.debug.shadowmap.dzn;
-    float& dzf = mEngine.debug.shadowmap.dzf;
-    if (dzn < 0)    dzn = cameraInfo.dzn / dz;
-    else            cameraInfo.dzn = dzn * dz;
-    if (dzf > 0)    dzf =-cameraInfo.dzf / dz;
-    else            cameraInfo.dzf =-dzf * dz;
+    if (type == Type::SPOT || type == Type::FOCUSED_SPOT) {
+        const float4 sphere = lightData.elementAt<FScene::POSITION_RADIUS>(index);
+        computeShadowCameraSpot(sphere.xyz, lightData.elementAt<FScene::DIRECTION>(index),
+                std::sqrt(lcm.getCosOuterSquared(li)), sphere.w,
+                wsShadowCastersVolume, wsShadowReceiversVolume);
+        mHasVisibleShadows = mCascades[0].hasVisibleShadows;
+        return;
+    }
 
+    if (!directional) {
+        // TODO: point lights
+        return;
+    }
 
-    using Type = FLightManager::Type;
-    switch (lcm.getType(li)) {
-        case Type::SUN:
-        case Type::DIRECTIONAL:
-            computeShadowCameraDirectional(
-                    lightData.elementAt<FScene::DIRECTION>(index), scene, cameraInfo,
-                    visibleLayers);
-            break;
-        case Type::FOCUSED_SPOT:
-        case Type::SPOT:
-            break;
-        case Type::POINT:
-            break;
+    for (size_t i = 0; i < mCascadeCount; i++) {
+        const float n = splits[i];
+        const float f = splits[i + 1];
+
+        mat4f projection(camera.cullingProjection);
+        if (params.shadowFar > 0.0f || mCascadeCount > 1) {
+            setProjectionNearFar(projection, n, f);
+        }
+
+        CameraInfo cameraInfo = {
+                .projection = projection,
+                .model = camera.model,
+                .view = camera.view,
+                .zn = n,
+                .zf = f,
+                .dzn = std::max(0.0f, params.shadowNearHint - n),
+                .dzf = std::max(0.0f, f - params.shadowFarHint),
+                .frustum = Frustum(projection * camera.view),
+                .worldOrigin = camera.worldOrigin
+        };
+
+        // debugging...
+        const float dz = cameraInfo.zf - cameraInfo.zn;
+        float& dzn = mEngine.debug.shadowmap.dzn;
+        float& dzf = mEngine.debug.shadowmap.dzf;
+        if (dzn < 0)    dzn = cameraInfo.dzn / dz;
+        else            cameraInfo.dzn = dzn * dz;
+        if (dzf > 0)    dzf =-cameraInfo.dzf / dz;
+        else            cameraInfo.dzf =-dzf * dz;
+
+        computeShadowCameraDirectional(
+                lightData.elementAt<FScene::DIRECTION>(index),
+                wsShadowCastersVolume, wsShadowReceiversVolume, cameraInfo, i);
+
+        mHasVisibleShadows |= mCascades[i].hasVisibleShadows;
+    }
+}
+
+float ShadowMap::computeReceiversDimension(Aabb const& wsShadowReceiversVolume,
+        details::CameraInfo const& camera, Viewport const& viewport) noexcept {
+    if (wsShadowReceiversVolume.isEmpty()) {
+        return 0.0f;
+    }
+
+    // intersect the receivers with the view frustum, and find the bounds of the result in
+    // clip space.
+    const mat4f projection = camera.cullingProjection * camera.view;
+    float3 wsViewFrustumCorners[8];
+    computeFrustumCorners(wsViewFrustumCorners,
+            camera.model * FCamera::inverseProjection(camera.cullingProjection));
+    const size_t vertexCount = intersectFrustumWithBox(mWsClippedShadowReceiverVolume,
+            Frustum(projection), wsViewFrustumCorners, wsShadowReceiversVolume);
+    if (vertexCount < 2) {
+        return 0.0f;
+    }
+
+    float2 csMin = std::numeric_limits<float>::max();
+    float2 csMax = std::numeric_limits<float>::lowest();
+    #pragma clang loop vectorize(disable)
+    for (size_t i = 0; i < vertexCount; ++i) {
+        const float2 v = mat4f::project(projection, mWsClippedShadowReceiverVolume[i]).xy;
+        csMin = min(csMin, v);
+        csMax = max(csMax, v);
+    }
+    csMin = max(csMin, float2{ -1 });
+    csMax = min(csMax, float2{  1 });
+
+    // The receivers get about as many texels as they cover pixels, these are shared by
+    // the cascades (which cover different parts of the view).
+    const float2 size = max(csMax - csMin, float2{ 0 }) * 0.5f *
+            float2{ viewport.width, viewport.height };
+    return std::sqrt(size.x * size.y / mCascadeCount);
+}
+
+uint32_t ShadowMap::chooseDimension(float receiversDimension,
+        uint32_t currentDimension, uint32_t maxDimension) noexcept {
+    // round up to a power of two, which is what the atlas allocates anyways
+    uint32_t dimension = AUTO_SIZE_MIN_DIMENSION;
+    while (dimension < receiversDimension && dimension < maxDimension) {
+        dimension *= 2;
+    }
+    dimension = std::min(dimension, maxDimension);
+
+    // grow right away, but keep the current dimension unless much less is needed
+    if (dimension < currentDimension && currentDimension <= maxDimension &&
+            receiversDimension > currentDimension * AUTO_SIZE_SHRINK_RATIO) {
+        dimension = currentDimension;
+    }
+    return dimension;
+}
+
+void ShadowMap::computeCascadeSplits(float* splits, size_t count, float n, float f) noexcept {
+    // "practical split scheme", i.e. a blend between logarithmic and uniform splits. The
+    // logarithmic split gives the same resolution in all cascades, but allocates a very short
+    // range to the first one.
+    splits[0] = n;
+    for (size_t i = 1; i < count; i++) {
+        const float t = float(i) / count;
+        const float uniformSplit = n + (f - n) * t;
+        const float logSplit = n > 0.0f ? n * std::pow(f / n, t) : uniformSplit;
+        splits[i] = uniformSplit + (logSplit - uniformSplit) * CASCADE_SPLIT_LOG_WEIGHT;
+    }
+    splits[count] = f;
+}
+
+void ShadowMap::setProjectionNearFar(mat4f& projection, float n, float f) noexcept {
+    if (std::abs(projection[2].w) <= std::numeric_limits<float>::epsilon()) {
+        // ortho projection
+        projection[2].z =    2.0f / (n - f);
+        projection[3].z = (f + n) / (n - f);
+    } else {
+        // perspective projection
+        projection[2].z =     (f + n) / (n - f);
+        projection[3].z = (2 * f * n) / (n - f);
     }
 }
 
 void ShadowMap::computeShadowCameraDirectional(
-        math::float3 const& dir, FScene const* scene, CameraInfo const& camera,
-        uint8_t visibleLayers) noexcept {
+        math::float3 const& dir,
+        Aabb const& wsShadowCastersVolume, Aabb const& wsShadowReceiversVolume,
+        CameraInfo const& camera, size_t index) noexcept {
+
+    Cascade& cascade = mCascades[index];
+
+    cascade.tileLightSpace = getLitLightSpaceMatrix();
 
-    // scene bounds in world space
-    Aabb wsShadowCastersVolume, wsShadowReceiversVolume;
-    scene->computeBounds(wsShadowCastersVolume, wsShadowReceiversVolume, visibleLayers);
     if (wsShadowCastersVolume.isEmpty() || wsShadowReceiversVolume.isEmpty()) {
-        mHasVisibleShadows = false;
+        cascade.hasVisibleShadows = false;
         return;
     }
 
@@ -212,8 +354,8 @@ void ShadowMap::computeShadowCameraDirectional(
     size_t vertexCount = intersectFrustumWithBox(mWsClippedShadowReceiverVolume,
             camera.frustum, wsViewFrustumCorners, wsShadowReceiversVolume);
 
-    mHasVisibleShadows = vertexCount >= 2;
-    if (mHasVisibleShadows) {
+    cascade.hasVisibleShadows = vertexCount >= 2;
+    if (cascade.hasVisibleShadows) {
         const bool USE_LISPSM = ENABLE_LISPSM && mEngine.debug.shadowmap.lispsm;
 
         /*
@@ -331,8 +473,7 @@ void ShadowMap::computeShadowCameraDirectional(
 
         // For directional lights, we further constraint the light frustum to the
         // intersection of the shadow casters & receivers in light-space.
-        // However, since this relies on the 1-texel shadow map border, this wouldn't directly
-        // work if we were storing several shadow maps in a single texture.
+        // This relies on the 1-texel border of each cascade in the shadow map.
         if (mEngine.debug.shadowmap.focus_shadowcasters) {
             intersectWithShadowCasters(lsLightFrustum, WLMpMv, wsShadowCastersVolume);
         }
@@ -341,7 +482,7 @@ void ShadowMap::computeShadowCameraDirectional(
                            (lsLightFrustum.min.y >= lsLightFrustum.max.y))) {
             // this could happen if the only thing visible is a perfectly horizontal or
             // vertical thin line
-            mHasVisibleShadows = false;
+            cascade.hasVisibleShadows = false;
             return;
         }
 
@@ -377,16 +518,63 @@ void ShadowMap::computeShadowCameraDirectional(
         // Final shadowmap texture transform
         const mat4f St = mat4f(MbMt * S);
 
-        mTexelSizeWs = texelSizeWorldSpace(St, float3{ 0.5f });
-        mLightSpace = St;
-        mSceneRange = (zfar - znear);
-        mCamera->setCustomProjection(mat4(S), znear, zfar);
+        cascade.texelSizeWs = texelSizeWorldSpace(St, float3{ 0.5f });
+        cascade.tileLightSpace = St;
+        cascade.sceneRange = (zfar - znear);
+        cascade.camera->setCustomProjection(mat4(S), znear, zfar);
 
-        // for the debug camera, we need to undo the world origin
-        mDebugCamera->setCustomProjection(mat4(S * camera.worldOrigin), znear, zfar);
+        if (index == 0) {
+            // for the debug camera, we need to undo the world origin
+            mDebugCamera->setCustomProjection(mat4(S * camera.worldOrigin), znear, zfar);
+        }
     }
 }
 
+void ShadowMap::computeShadowCameraSpot(float3 const& position, float3 const& dir,
+        float cosOuter, float radius,
+        Aabb const& wsShadowCastersVolume, Aabb const& wsShadowReceiversVolume) noexcept {
+
+    Cascade& cascade = mCascades[0];
+    cascade.tileLightSpace = getLitLightSpaceMatrix();
+
+    // the light must reach both the shadow casters and the shadow receivers
+    auto distanceToBox = [&position](Aabb const& box) {
+        return length(position - min(max(position, box.min), box.max));
+    };
+    cascade.hasVisibleShadows =
+            !wsShadowCastersVolume.isEmpty() && !wsShadowReceiversVolume.isEmpty() &&
+            distanceToBox(wsShadowCastersVolume) < radius &&
+            distanceToBox(wsShadowReceiversVolume) < radius;
+    if (!cascade.hasVisibleShadows) {
+        return;
+    }
+
+    // The near plane is pushed up to the shadow casters to keep as much depth precision as
+    // possible, the far plane is the light's radius.
+    const float zfar = radius;
+    const float znear = std::min(std::max(distanceToBox(wsShadowCastersVolume),
+            radius * SPOT_SHADOW_MIN_NEAR_RATIO), zfar * 0.5f);
+
+    // the light looks down its direction, the up vector just needs to not be parallel to it
+    const float3 up = std::abs(dir.y) < 0.999f ? float3{ 0, 1, 0 } : float3{ 1, 0, 0 };
+    const mat4f M = mat4f::lookAt(position, position + dir, up);
+    const mat4f Mv = FCamera::rigidTransformInverse(M);
+
+    // the frustum encloses the outer cone, very wide cones are clipped
+    const float cosAngle = std::max(cosOuter, SPOT_SHADOW_MIN_COS_OUTER);
+    const float t = std::sqrt(1.0f - cosAngle * cosAngle) / cosAngle;   // tan(outer)
+    const mat4f Mp = mat4f::frustum(-t * znear, t * znear, -t * znear, t * znear, znear, zfar);
+
+    const mat4f S = Mp * Mv;
+    const mat4f St = getTextureCoordsMapping() * S;
+
+    // texels grow with the distance to the light, this is their size at a distance of 1
+    cascade.texelSizeWs = 2.0f * t / mShadowMapDimension;
+    cascade.tileLightSpace = St;
+    cascade.sceneRange = zfar - znear;
+    cascade.camera->setCustomProjection(mat4(S), znear, zfar);
+}
+
 mat4f ShadowMap::applyLISPSM(CameraInfo const& camera, float dzn, float dzf, mat4f const& LMpMv,
         Aabb const& wsShadowReceiversVolume, const float3 wsViewFrustumCorners[8],
         float3 const& dir) {
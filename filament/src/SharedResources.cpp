@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SharedResources.h"
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace filament {
+
+using namespace driver;
+
+namespace {
+
+// BlobCache::insert() and retrieve() are called from the render threads of all the Engines
+class SharedProgramCache : public BlobCache {
+public:
+    void insert(void const* key, size_t keySize,
+            void const* value, size_t valueSize) noexcept override {
+        std::lock_guard<std::mutex> guard(mLock);
+        auto const* const bytes = static_cast<uint8_t const*>(value);
+        mEntries[std::string(static_cast<char const*>(key), keySize)].assign(
+                bytes, bytes + valueSize);
+    }
+
+    size_t retrieve(void const* key, size_t keySize,
+            void* value, size_t valueSize) noexcept override {
+        std::lock_guard<std::mutex> guard(mLock);
+        auto pos = mEntries.find(std::string(static_cast<char const*>(key), keySize));
+        if (pos == mEntries.end()) {
+            return 0;
+        }
+        std::vector<uint8_t> const& entry = pos->second;
+        if (value && entry.size() <= valueSize) {
+            std::copy(entry.begin(), entry.end(), static_cast<uint8_t*>(value));
+        }
+        return entry.size();
+    }
+
+private:
+    std::mutex mLock;
+    std::unordered_map<std::string, std::vector<uint8_t>> mEntries;
+};
+
+std::mutex sLock;
+std::unordered_map<size_t, std::weak_ptr<SharedResources::DfgLut>> sDfgLuts;
+std::unique_ptr<SharedProgramCache> sProgramCache;
+size_t sProgramCacheUsers = 0;
+std::atomic<bool> sEnabled = { false };
+
+} // anonymous namespace
+
+std::shared_ptr<SharedResources::DfgLut> SharedResources::getDfgLut(size_t size) noexcept {
+    std::lock_guard<std::mutex> guard(sLock);
+    std::weak_ptr<DfgLut>& entry = sDfgLuts[size];
+    std::shared_ptr<DfgLut> lut = entry.lock();
+    if (!lut) {
+        lut = std::make_shared<DfgLut>();
+        entry = lut;
+    }
+    return lut;
+}
+
+void SharedResources::setEnabled(bool enabled) noexcept {
+    sEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool SharedResources::isEnabled() noexcept {
+    return sEnabled.load(std::memory_order_relaxed);
+}
+
+BlobCache* SharedResources::acquireProgramCache() noexcept {
+    std::lock_guard<std::mutex> guard(sLock);
+    if (!sProgramCacheUsers++) {
+        sProgramCache.reset(new SharedProgramCache);
+    }
+    return sProgramCache.get();
+}
+
+void SharedResources::releaseProgramCache() noexcept {
+    std::lock_guard<std::mutex> guard(sLock);
+    if (!--sProgramCacheUsers) {
+        sProgramCache.reset();
+    }
+}
+
+} // namespace filament
@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_SHAREDRESOURCES_H
+#define TNT_FILAMENT_SHAREDRESOURCES_H
+
+#include <filament/driver/BlobCache.h>
+
+#include <math/half.h>
+#include <math/vec2.h>
+
+#include <memory>
+#include <mutex>
+
+namespace filament {
+
+/*
+ * The immutable resources the Engines of a process can share, instead of building their own.
+ *
+ * The DFG LUT is the same for all the Engines, it's computed once per size and kept while an
+ * Engine uses it.
+ *
+ * The program binaries are shared through an in-memory BlobCache, used by the Engines created
+ * with resource sharing enabled and no BlobCache of their own. The binaries are tagged with the
+ * GPU driver that produced them (see OpenGLDriver), so Engines on different drivers don't mix
+ * them up. The cache lives as long as one of these Engines.
+ */
+class SharedResources {
+public:
+    struct DfgLut {
+        std::once_flag once;                    // the first Engine to need it computes it
+        std::unique_ptr<math::half2[]> data;
+    };
+
+    // returns the LUT of the given size, which is computed once by std::call_once()
+    static std::shared_ptr<DfgLut> getDfgLut(size_t size) noexcept;
+
+    static void setEnabled(bool enabled) noexcept;
+    static bool isEnabled() noexcept;
+
+    // the cache shared by the Engines, created by the first one and destroyed with the last one
+    static driver::BlobCache* acquireProgramCache() noexcept;
+    static void releaseProgramCache() noexcept;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_SHAREDRESOURCES_H
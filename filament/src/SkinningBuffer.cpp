@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "details/SkinningBuffer.h"
+
+#include "details/Engine.h"
+
+#include "FilamentAPI-impl.h"
+
+#include <utils/Panic.h>
+
+#include <algorithm>
+
+using namespace math;
+
+namespace filament {
+
+using namespace details;
+
+struct SkinningBuffer::BuilderDetails {
+    uint32_t mBoneCount = 0;
+};
+
+using BuilderType = SkinningBuffer;
+BuilderType::Builder::Builder() noexcept = default;
+BuilderType::Builder::~Builder() noexcept = default;
+BuilderType::Builder::Builder(BuilderType::Builder const& rhs) noexcept = default;
+BuilderType::Builder::Builder(BuilderType::Builder&& rhs) noexcept = default;
+BuilderType::Builder& BuilderType::Builder::operator=(BuilderType::Builder const& rhs) noexcept = default;
+BuilderType::Builder& BuilderType::Builder::operator=(BuilderType::Builder&& rhs) noexcept = default;
+
+SkinningBuffer::Builder& SkinningBuffer::Builder::boneCount(uint32_t boneCount) noexcept {
+    mImpl->mBoneCount = boneCount;
+    return *this;
+}
+
+SkinningBuffer* SkinningBuffer::Builder::build(Engine& engine) {
+    if (!ASSERT_PRECONDITION_NON_FATAL(mImpl->mBoneCount > 0,
+            "boneCount cannot be 0")) {
+        return nullptr;
+    }
+    if (!ASSERT_PRECONDITION_NON_FATAL(mImpl->mBoneCount <= FSkinningBuffer::MAX_BONE_COUNT,
+            "boneCount is %u, but cannot be more than %u",
+            mImpl->mBoneCount, unsigned(FSkinningBuffer::MAX_BONE_COUNT))) {
+        return nullptr;
+    }
+    return upcast(engine).createSkinningBuffer(*this);
+}
+
+// ------------------------------------------------------------------------------------------------
+
+namespace details {
+
+FSkinningBuffer::FSkinningBuffer(FEngine& engine, const SkinningBuffer::Builder& builder)
+        : mBoneCount(builder->mBoneCount) {
+    FEngine::DriverApi& driver = engine.getDriverApi();
+
+    // the offset of each renderable is a whole number of bones
+    const size_t alignment = driver.getUniformBufferOffsetAlignment();
+    mBoneOffsetAlignment = uint32_t((alignment + sizeof(Bone) - 1) / sizeof(Bone));
+
+    const size_t size = (mBoneCount + CONFIG_MAX_BONE_COUNT) * sizeof(Bone);
+    mBones = UniformBuffer(size);
+    mHandle = driver.createUniformBuffer(size);
+
+    // initialize all the bones (and the padding) to identity
+    Bone* UTILS_RESTRICT out = (Bone*)mBones.invalidateUniforms(0, size);
+    std::fill_n(out, mBoneCount + CONFIG_MAX_BONE_COUNT, Bone{});
+}
+
+void FSkinningBuffer::terminate(FEngine& engine) {
+    FEngine::DriverApi& driver = engine.getDriverApi();
+    driver.destroyUniformBuffer(mHandle);
+}
+
+void FSkinningBuffer::setBones(
+        Bone const* transforms, size_t boneCount, size_t offset) noexcept {
+    assert(offset + boneCount <= mBoneCount);
+    boneCount = std::min(boneCount, mBoneCount - std::min(offset, size_t(mBoneCount)));
+    writeBones(mBones, transforms, boneCount, offset);
+}
+
+void FSkinningBuffer::setBones(
+        math::mat4f const* transforms, size_t boneCount, size_t offset) noexcept {
+    assert(offset + boneCount <= mBoneCount);
+    boneCount = std::min(boneCount, mBoneCount - std::min(offset, size_t(mBoneCount)));
+    writeBones(mBones, transforms, boneCount, offset);
+}
+
+void FSkinningBuffer::commit(driver::DriverApi& driver) const noexcept {
+    driver.commitUniforms(mHandle, mBones);
+}
+
+void FSkinningBuffer::writeBones(UniformBuffer& buffer,
+        Bone const* UTILS_RESTRICT transforms, size_t boneCount, size_t offset) noexcept {
+    if (boneCount) {
+        Bone* UTILS_RESTRICT out = (Bone*)buffer.invalidateUniforms(
+                offset * sizeof(Bone), boneCount * sizeof(Bone));
+        std::copy_n(transforms, boneCount, out);
+    }
+}
+
+void FSkinningBuffer::writeBones(UniformBuffer& buffer,
+        math::mat4f const* UTILS_RESTRICT transforms, size_t boneCount, size_t offset) noexcept {
+    if (boneCount) {
+        Bone* UTILS_RESTRICT out = (Bone*)buffer.invalidateUniforms(
+                offset * sizeof(Bone), boneCount * sizeof(Bone));
+        for (size_t i = 0; i < boneCount; ++i) {
+            mat4f const& m = transforms[i];
+            out[i].unitQuaternion = m.toQuaternion();
+            out[i].translation = m[3].xyz;
+        }
+    }
+}
+
+} // namespace details
+
+// ------------------------------------------------------------------------------------------------
+// Trampoline calling into private implementation
+// ------------------------------------------------------------------------------------------------
+
+using namespace details;
+
+void SkinningBuffer::setBones(Engine& engine,
+        Bone const* transforms, size_t boneCount, size_t offset) {
+    upcast(this)->setBones(transforms, boneCount, offset);
+}
+
+void SkinningBuffer::setBones(Engine& engine,
+        math::mat4f const* transforms, size_t boneCount, size_t offset) {
+    upcast(this)->setBones(transforms, boneCount, offset);
+}
+
+size_t SkinningBuffer::getBoneCount() const noexcept {
+    return upcast(this)->getBoneCount();
+}
+
+size_t SkinningBuffer::getBoneOffsetAlignment() const noexcept {
+    return upcast(this)->getBoneOffsetAlignment();
+}
+
+} // namespace filament
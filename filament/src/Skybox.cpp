@@ -48,9 +48,17 @@ static const uint8_t SKYBOXRGBM_MATERIAL_PACKAGE[] = {
 #include "generated/material/skyboxRGBM.inc"
 };
 
+// This package is generated with matc and contains the skybox material shader
+// code which renders the irradiance of the indirect light.
+static const uint8_t SKYBOXSH_MATERIAL_PACKAGE[] = {
+#include "generated/material/skyboxSH.inc"
+};
+
 
 struct Skybox::BuilderDetails {
     Texture* mEnvironmentMap = nullptr;
+    uint8_t mEnvironmentLevel = 0;
+    bool mIrradiance = false;
     bool mShowSun = false;
 };
 
@@ -68,6 +76,16 @@ Skybox::Builder& Skybox::Builder::environment(Texture* cubemap) noexcept {
     return *this;
 }
 
+Skybox::Builder& Skybox::Builder::environmentLevel(uint8_t level) noexcept {
+    mImpl->mEnvironmentLevel = level;
+    return *this;
+}
+
+Skybox::Builder& Skybox::Builder::irradiance(bool enabled) noexcept {
+    mImpl->mIrradiance = enabled;
+    return *this;
+}
+
 Skybox::Builder& Skybox::Builder::showSun(bool show) noexcept {
     mImpl->mShowSun = show;
     return *this;
@@ -76,12 +94,22 @@ Skybox::Builder& Skybox::Builder::showSun(bool show) noexcept {
 Skybox* Skybox::Builder::build(Engine& engine) {
     FTexture* cubemap = upcast(mImpl->mEnvironmentMap);
 
-    if (!ASSERT_PRECONDITION_NON_FATAL(cubemap, "environment texture not set")) {
-        return nullptr;
-    }
-
-    if (!ASSERT_PRECONDITION_NON_FATAL(cubemap->isCubemap(), "environment maps must be a cubemap")) {
-        return nullptr;
+    // the irradiance skybox doesn't sample the environment
+    if (!mImpl->mIrradiance) {
+        if (!ASSERT_PRECONDITION_NON_FATAL(cubemap, "environment texture not set")) {
+            return nullptr;
+        }
+
+        if (!ASSERT_PRECONDITION_NON_FATAL(cubemap->isCubemap(),
+                "environment maps must be a cubemap")) {
+            return nullptr;
+        }
+
+        if (!ASSERT_PRECONDITION_NON_FATAL(mImpl->mEnvironmentLevel < cubemap->getLevels(),
+                "environment level %u out of range (%u levels)",
+                unsigned(mImpl->mEnvironmentLevel), unsigned(cubemap->getLevels()))) {
+            return nullptr;
+        }
     }
 
     return upcast(engine).createSkybox(*this);
@@ -95,12 +123,22 @@ FSkybox::FSkybox(FEngine& engine, const Builder& builder) noexcept
         : mSkyboxTexture(upcast(builder->mEnvironmentMap)),
           mRenderableManager(engine.getRenderableManager()) {
 
-    FMaterial const* material = engine.getSkyboxMaterial(mSkyboxTexture->getFormat());
+    const bool irradiance = builder->mIrradiance;
+    FMaterial const* material = engine.getSkyboxMaterial(
+            irradiance ? driver::TextureFormat::RGBA8 : mSkyboxTexture->getFormat(), irradiance);
     mSkyboxMaterialInstance = material->createInstance();
 
-    TextureSampler sampler(TextureSampler::MagFilter::LINEAR, TextureSampler::WrapMode::REPEAT);
-    static_cast<MaterialInstance*>(mSkyboxMaterialInstance)->setParameter("skybox", mSkyboxTexture, sampler);
-    static_cast<MaterialInstance*>(mSkyboxMaterialInstance)->setParameter("showSun", builder->mShowSun);
+    MaterialInstance* const mi = mSkyboxMaterialInstance;
+    if (!irradiance) {
+        // a coarser level needs the mipmaps to be sampled
+        const uint8_t level = builder->mEnvironmentLevel;
+        TextureSampler sampler(level ? TextureSampler::MinFilter::LINEAR_MIPMAP_LINEAR :
+                        TextureSampler::MinFilter::LINEAR,
+                TextureSampler::MagFilter::LINEAR, TextureSampler::WrapMode::REPEAT);
+        mi->setParameter("skybox", mSkyboxTexture, sampler);
+        mi->setParameter("level", float(level));
+    }
+    mi->setParameter("showSun", builder->mShowSun);
 
     mSkybox = engine.getEntityManager().create();
 
@@ -114,17 +152,28 @@ FSkybox::FSkybox(FEngine& engine, const Builder& builder) noexcept
             .priority(0x7)
             .culling(false)
             .build(engine, mSkybox);
+
+    // drawn after the opaque objects
+    mRenderableManager.setBackground(mRenderableManager.getInstance(mSkybox), true);
 }
 
-FMaterial const* FSkybox::createMaterial(FEngine& engine, driver::TextureFormat format) {
+FMaterial const* FSkybox::createMaterial(FEngine& engine, driver::TextureFormat format,
+        bool irradiance) {
+   if (irradiance) {
+       FMaterial const* material = upcast(Material::Builder().packageView(
+               (void*)SKYBOXSH_MATERIAL_PACKAGE,
+               sizeof(SKYBOXSH_MATERIAL_PACKAGE)).build(engine));
+       return material;
+   }
+
    if (format == driver::TextureFormat::RGBM) {
-       FMaterial const* material = upcast(Material::Builder().package(
+       FMaterial const* material = upcast(Material::Builder().packageView(
                (void*)SKYBOXRGBM_MATERIAL_PACKAGE,
                sizeof(SKYBOXRGBM_MATERIAL_PACKAGE)).build(engine));
        return material;
    }
 
-    FMaterial const* material = upcast(Material::Builder().package(
+    FMaterial const* material = upcast(Material::Builder().packageView(
             (void*)SKYBOX_MATERIAL_PACKAGE,
             sizeof(SKYBOX_MATERIAL_PACKAGE)).build(engine));
     return material;
@@ -73,6 +73,13 @@ Stream* Stream::Builder::build(Engine& engine) {
         return nullptr;
     }
 
+    if (!mImpl->mStream && !mImpl->mExternalTextureId) {
+        if (!ASSERT_PRECONDITION_NON_FATAL(upcast(engine).getBackend() == Backend::OPENGL,
+                "Acquired streams are only supported by the OpenGL backend")) {
+            return nullptr;
+        }
+    }
+
     return upcast(engine).createStream(*this);
 }
 
@@ -82,6 +89,8 @@ namespace details {
 
 FStream::FStream(FEngine& engine, const Builder& builder) noexcept
         : mEngine(engine),
+          mStreamType(builder->mStream ? StreamType::NATIVE :
+                      builder->mExternalTextureId ? StreamType::TEXTURE_ID : StreamType::ACQUIRED),
           mNativeStream(builder->mStream),
           mExternalTextureId(builder->mExternalTextureId),
           mWidth(builder->mWidth),
@@ -93,6 +102,8 @@ FStream::FStream(FEngine& engine, const Builder& builder) noexcept
     } else if (mExternalTextureId) {
         mStreamHandle = engine.getDriverApi().createStreamFromTextureId(
                 mExternalTextureId, mWidth, mHeight);
+    } else {
+        mStreamHandle = engine.getDriverApi().createStreamAcquired();
     }
 }
 
@@ -112,6 +123,16 @@ void FStream::setDimensions(uint32_t width, uint32_t height) noexcept {
     mEngine.getDriverApi().setStreamDimensions(mStreamHandle, mWidth, mHeight);
 }
 
+void FStream::setAcquiredImage(void* image, int acquireFence,
+        BufferDescriptor::Callback callback, void* user) noexcept {
+    if (!ASSERT_PRECONDITION_NON_FATAL(mStreamType == StreamType::ACQUIRED,
+            "setAcquiredImage() requires an acquired stream")) {
+        return;
+    }
+    mEngine.getDriverApi().setAcquiredImage(mStreamHandle, acquireFence,
+            BufferDescriptor(image, 0, callback, user));
+}
+
 void FStream::readPixels(uint32_t xoffset, uint32_t yoffset, uint32_t width, uint32_t height,
         driver::PixelBufferDescriptor&& buffer) noexcept {
     if (isExternalTextureId()) {
@@ -146,6 +167,11 @@ bool Stream::isNativeStream() const noexcept {
     return upcast(this)->isNativeStream();
 }
 
+void Stream::setAcquiredImage(void* image, int acquireFence,
+        driver::BufferDescriptor::Callback callback, void* user) noexcept {
+    upcast(this)->setAcquiredImage(image, acquireFence, callback, user);
+}
+
 void Stream::setDimensions(uint32_t width, uint32_t height) noexcept {
     upcast(this)->setDimensions(width, height);
 }
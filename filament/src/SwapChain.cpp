@@ -17,6 +17,9 @@
 #include "details/SwapChain.h"
 
 #include "details/Engine.h"
+#include "details/FrameSkipper.h"
+
+#include <algorithm>
 
 namespace filament {
 namespace details {
@@ -27,10 +30,21 @@ FSwapChain::FSwapChain(FEngine& engine, void* nativeWindow, uint64_t flags)
     mSwapChain = engine.getDriverApi().createSwapChain(nativeWindow, mConfigFlags);
 }
 
+FSwapChain::FSwapChain(FEngine& engine, uint32_t width, uint32_t height, uint64_t flags)
+        : mHeadless(true) {
+    mConfigFlags = flags;
+    mSwapChain = engine.getDriverApi().createSwapChainHeadless(width, height, mConfigFlags);
+}
+
 void FSwapChain::terminate(FEngine& engine) noexcept {
     engine.getDriverApi().destroySwapChain(mSwapChain);
 }
 
+void FSwapChain::setFrameLatency(uint8_t latency) noexcept {
+    mFrameLatency = uint8_t(std::min(std::max(size_t(latency), size_t(1)),
+            FrameSkipper::MAX_LATENCY));
+}
+
 } // namespace details
 
 using namespace details;
@@ -39,4 +53,16 @@ void* SwapChain::getNativeWindow() const noexcept {
     return upcast(this)->getNativeWindow();
 }
 
+bool SwapChain::isHeadless() const noexcept {
+    return upcast(this)->isHeadless();
+}
+
+void SwapChain::setFrameLatency(uint8_t latency) noexcept {
+    upcast(this)->setFrameLatency(latency);
+}
+
+uint8_t SwapChain::getFrameLatency() const noexcept {
+    return upcast(this)->getFrameLatency();
+}
+
 } // namespace filament
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "details/TemporalCuller.h"
+
+#include "Intersections.h"
+
+#include <algorithm>
+
+#include <math.h>
+
+using namespace math;
+
+namespace filament {
+namespace details {
+
+void TemporalCuller::clear() noexcept {
+    mHasFrustum = false;
+    mDistances.clear();
+    mRadii.clear();
+    mVersions.clear();
+}
+
+void TemporalCuller::prepare(Frustum const& frustum, float3 const& position,
+        size_t count) noexcept {
+    float4 const* const planes = frustum.getNormalizedPlanes();
+
+    if (mDistances.size() != count || !mHasFrustum) {
+        // the renderables aren't the same anymore, they're all tested
+        mDistances.assign(count, 0.0f);
+        mRadii.assign(count, 0.0f);
+        mVersions.assign(count, 0);
+        mTranslation = 0;
+        mRotation = 0;
+        mMotion = 0;
+    } else {
+        // For a point p, a plane moves by dot(n1 - n0, p - position) plus its translation at the
+        // camera position, dot(n1, position) + w1 - dot(n0, position) - w0. The normals being
+        // normalized, |n1 - n0| bounds the first term per unit of distance.
+        float translation = 0;
+        float rotation = 0;
+        for (size_t i = 0; i < 6; i++) {
+            const float4 p0 = mPlanes[i];
+            const float4 p1 = planes[i];
+            translation = std::max(translation,
+                    std::abs(dot(p1.xyz, position) + p1.w - dot(p0.xyz, position) - p0.w));
+            rotation = std::max(rotation, length(p1.xyz - p0.xyz));
+        }
+        mTranslation = translation;
+        mRotation = rotation;
+        mMotion = length(position - mPosition);
+    }
+
+    std::copy_n(planes, 6, mPlanes);
+    mPosition = position;
+    mHasFrustum = true;
+}
+
+void TemporalCuller::cull(Culler::result_type* UTILS_RESTRICT results,
+        float3 const* UTILS_RESTRICT center, float3 const* UTILS_RESTRICT extent,
+        uint32_t const* UTILS_RESTRICT versions,
+        size_t first, size_t count, size_t bit) noexcept {
+    float4 const* const UTILS_RESTRICT planes = mPlanes;
+    float* const UTILS_RESTRICT distances = mDistances.data();
+    float* const UTILS_RESTRICT radii = mRadii.data();
+    uint32_t* const UTILS_RESTRICT testedVersions = mVersions.data();
+    const float translation = mTranslation;
+    const float rotation = mRotation;
+    const float motion = mMotion;
+    const Culler::result_type visibleBit = Culler::result_type(1u << bit);
+
+    for (size_t i = first, e = std::min(first + count, mDistances.size()); i < e; i++) {
+        if (testedVersions[i] == versions[i]) {
+            // the box didn't move, only the frustum did
+            const float bound = translation + rotation * radii[i];
+            const float d = distances[i];
+            if (d < -bound || d > bound) {
+                distances[i] = d < 0 ? d + bound : d - bound;
+                radii[i] += motion;
+                results[i] = d < 0 ? visibleBit : Culler::result_type(0);
+                continue;
+            }
+        }
+
+        // the box is visible if it's on the inner side of all the planes, see Culler
+        float d = boxPlaneDistance(planes[0], center[i], extent[i]);
+        for (size_t j = 1; j < 6; j++) {
+            d = std::max(d, boxPlaneDistance(planes[j], center[i], extent[i]));
+        }
+        distances[i] = d;
+        radii[i] = length(center[i] - mPosition) + length(extent[i]);
+        testedVersions[i] = versions[i];
+        results[i] = d < 0 ? visibleBit : Culler::result_type(0);
+    }
+}
+
+void TemporalCuller::invalidate(size_t first, size_t count) noexcept {
+    // a distance of 0 never passes the test of cull()
+    const size_t size = mDistances.size();
+    first = std::min(first, size);
+    std::fill_n(mDistances.begin() + first, std::min(count, size - first), 0.0f);
+}
+
+} // namespace details
+} // namespace filament
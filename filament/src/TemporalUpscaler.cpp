@@ -0,0 +1,151 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "details/TemporalUpscaler.h"
+
+#include "PostProcessManager.h"
+
+#include "details/Engine.h"
+
+#include <utils/Systrace.h>
+
+using namespace utils;
+
+namespace filament {
+using namespace driver;
+using namespace math;
+
+namespace details {
+
+// the index-th element of the Halton sequence of the given base, in [0, 1)
+static float halton(uint32_t index, uint32_t base) noexcept {
+    float f = 1.0f;
+    float r = 0.0f;
+    while (index > 0) {
+        f /= float(base);
+        r += f * float(index % base);
+        index /= base;
+    }
+    return r;
+}
+
+TemporalUpscaler::TemporalUpscaler(FEngine& engine) noexcept
+        : mEngine(engine) {
+}
+
+TemporalUpscaler::~TemporalUpscaler() noexcept {
+    assert(!mHistory);
+}
+
+void TemporalUpscaler::terminate() noexcept {
+    clear();
+}
+
+void TemporalUpscaler::clear() noexcept {
+    if (mHistory) {
+        mEngine.getRenderTargetPool().put(mHistory);
+        mHistory = nullptr;
+    }
+}
+
+void TemporalUpscaler::prepare(CameraInfo const& camera, Viewport const& viewport) noexcept {
+    // the (2, 3) Halton sequence covers the pixel evenly even with a few samples, 0 is skipped
+    // because it's the corner of the pixel
+    const uint32_t index = mFrameIndex % JITTER_COUNT + 1;
+    mFrameIndex++;
+    mJitter = float2{ halton(index, 2) - 0.5f, halton(index, 3) - 0.5f };
+    mClipFromWorld = camera.projection * camera.view;
+}
+
+void TemporalUpscaler::addPass(FrameGraph& fg, FrameGraphResource color,
+        FrameGraphResource depth, FrameGraphResource output,
+        Viewport const& vp, Viewport const& svp) noexcept {
+    struct TemporalUpscaleData {
+        FrameGraphResource color;
+        FrameGraphResource depth;
+        FrameGraphResource output;
+    };
+
+    fg.addPass<TemporalUpscaleData>("Temporal Upscale",
+            [&](FrameGraph::Builder& builder, TemporalUpscaleData& data) {
+                data.color = builder.read(color);
+                data.depth = builder.read(depth, TargetBufferFlags::DEPTH);
+                data.output = builder.write(output);
+            },
+            [this, vp, svp](FrameGraph::Resources const& resources,
+                    TemporalUpscaleData const& data) {
+                DriverApi& driver = mEngine.getDriverApi();
+                driver.pushGroupMarker("Temporal Upscale");
+                driver.beginTimer(Driver::TIMER_POST_PROCESS);
+                resolve(resources.getTarget(data.color), resources.getTarget(data.depth),
+                        resources.getRenderTarget(data.output), vp, svp);
+                driver.endTimer();
+                driver.popGroupMarker();
+            });
+}
+
+void TemporalUpscaler::resolve(RenderTargetPool::Target const* color,
+        RenderTargetPool::Target const* depth, Handle<HwRenderTarget> output,
+        Viewport const& vp, Viewport const& svp) noexcept {
+    SYSTRACE_CALL();
+
+    FEngine& engine = mEngine;
+    DriverApi& driver = engine.getDriverApi();
+    RenderTargetPool& rtp = engine.getRenderTargetPool();
+
+    // the new history is rendered from the previous one, they ping-pong through the pool
+    RenderTargetPool::Target const* history = rtp.get(TargetBufferFlags::COLOR,
+            vp.width, vp.height, 1, TextureFormat::RGBA8);
+
+    // a history of another size (the view was resized) is dropped
+    RenderTargetPool::Target const* previous = mHistory;
+    if (previous && (mHistoryWidth != vp.width || mHistoryHeight != vp.height)) {
+        previous = nullptr;
+    }
+
+    float4 historyUv{ 0.0f };
+    float weight = 0.0f;
+    if (previous) {
+        historyUv.xy = float2{ vp.width, vp.height } / float2{ previous->w, previous->h };
+        if (engine.getBackend() == Backend::VULKAN) {
+            // the viewport sits at the bottom of the texture, see post_process.vs
+            historyUv.w = float(previous->h - vp.height) / float(previous->h);
+        }
+        weight = HISTORY_WEIGHT;
+    }
+
+    engine.getPostProcessManager().temporalPass(
+            engine.getPostProcessProgram(PostProcessStage::TEMPORAL_UPSCALE),
+            color, depth, svp, previous,
+            mHistoryClipFromWorld * inverse(mClipFromWorld),
+            historyUv, float4{ mJitter, weight, 0.0f },
+            history, vp.width, vp.height);
+
+    driver.blit(TargetBufferFlags::COLOR, output,
+            vp.left, vp.bottom, vp.width, vp.height,
+            history->target, 0, 0, vp.width, vp.height);
+
+    if (mHistory) {
+        rtp.put(mHistory);
+    }
+    mHistory = history;
+    mHistoryWidth = vp.width;
+    mHistoryHeight = vp.height;
+    mHistoryClipFromWorld = mClipFromWorld;
+}
+
+} // namespace details
+} // namespace filament
@@ -23,6 +23,8 @@
 
 #include <utils/Panic.h>
 
+#include <algorithm>
+
 namespace filament {
 
 using namespace details;
@@ -101,8 +103,10 @@ FTexture::FTexture(FEngine& engine, const Builder& builder) {
     mUsage = builder->mUsage;
     mTarget = builder->mTarget;
     mDepth  = static_cast<uint32_t>(builder->mDepth);
-    mLevels = std::min(builder->mLevels,
-            static_cast<uint8_t>(std::ilogbf(std::max(mWidth, mHeight)) + 1));
+    // the layers of an array don't get smaller with the levels
+    const uint32_t size = std::max(mWidth, mHeight);
+    mLevels = std::min(builder->mLevels, static_cast<uint8_t>(std::ilogbf(
+            mTarget == Sampler::SAMPLER_3D ? std::max(size, mDepth) : size) + 1));
 
     FEngine::DriverApi& driver = engine.getDriverApi();
     mHandle = driver.createTexture(
@@ -111,6 +115,10 @@ FTexture::FTexture(FEngine& engine, const Builder& builder) {
 
 // frees driver resources, object becomes invalid
 void FTexture::terminate(FEngine& engine) {
+    if (mStreamed) {
+        engine.getTextureStreamer().remove(this);
+    }
+    engine.getMipmapGenerator().cancel(engine, this);
     FEngine::DriverApi& driver = engine.getDriverApi();
     driver.destroyTexture(mHandle);
 }
@@ -128,16 +136,18 @@ size_t FTexture::getHeight(size_t level) const noexcept {
 }
 
 size_t FTexture::getDepth(size_t level) const noexcept {
-    return valueForLevel(level, mDepth);
+    return mTarget == Sampler::SAMPLER_2D_ARRAY ? mDepth : valueForLevel(level, mDepth);
 }
 
 void FTexture::setImage(FEngine& engine,
         size_t level, uint32_t xoffset, uint32_t yoffset, uint32_t width, uint32_t height,
         Texture::PixelBufferDescriptor&& buffer) const noexcept {
-    if (!mStream && mTarget != Sampler::SAMPLER_CUBEMAP && level < mLevels) {
+    if (!mStream && (mTarget == Sampler::SAMPLER_2D || mTarget == Sampler::SAMPLER_EXTERNAL)
+            && level < mLevels) {
         if (buffer.buffer) {
             engine.getDriverApi().load2DImage(mHandle,
                     uint8_t(level), xoffset, yoffset, width, height, std::move(buffer));
+            mLoadedLevels |= 1u << level;
         }
     }
 }
@@ -148,6 +158,37 @@ void FTexture::setImage(FEngine& engine, size_t level,
         if (buffer.buffer) {
             engine.getDriverApi().loadCubeImage(mHandle, uint8_t(level),
                     std::move(buffer), faceOffsets);
+            mLoadedLevels |= 1u << level;
+        }
+    }
+}
+
+void FTexture::setImage(FEngine& engine, size_t level,
+        uint32_t xoffset, uint32_t yoffset, uint32_t zoffset,
+        uint32_t width, uint32_t height, uint32_t depth,
+        Texture::PixelBufferDescriptor&& buffer) const noexcept {
+    if ((mTarget == Sampler::SAMPLER_2D_ARRAY || mTarget == Sampler::SAMPLER_3D)
+            && level < mLevels) {
+        if (buffer.buffer) {
+            engine.getDriverApi().load3DImage(mHandle, uint8_t(level),
+                    xoffset, yoffset, zoffset, width, height, depth, std::move(buffer));
+            mLoadedLevels |= 1u << level;
+        }
+    }
+}
+
+void FTexture::setImage(FEngine& engine, size_t level, Region const* regions, size_t count,
+        Texture::PixelBufferDescriptor&& buffer) const noexcept {
+    if (!mStream && (mTarget == Sampler::SAMPLER_2D || mTarget == Sampler::SAMPLER_EXTERNAL)
+            && level < mLevels) {
+        if (buffer.buffer && count) {
+            FEngine::DriverApi& driver = engine.getDriverApi();
+            // the regions are read when the command is executed
+            Region* const copy = driver.allocatePod<Region>(count);
+            std::copy_n(regions, count, copy);
+            driver.load2DImageRegions(mHandle,
+                    uint8_t(level), copy, uint32_t(count), std::move(buffer));
+            mLoadedLevels |= 1u << level;
         }
     }
 }
@@ -173,21 +214,69 @@ void FTexture::setExternalStream(FEngine& engine, FStream* stream) noexcept {
 }
 
 void FTexture::generateMipmaps(FEngine& engine) const noexcept {
-    if ((mTarget == Sampler::SAMPLER_2D || mTarget == Sampler::SAMPLER_CUBEMAP)
-            && mLevels > 1) {
+    if (mTarget != Sampler::SAMPLER_EXTERNAL && mLevels > 1) {
+        if (!ASSERT_POSTCONDITION_NON_FATAL(isTextureFormatMipmappable(engine, mFormat),
+                "Texture format %u can't be mipmapped on this platform", mFormat)) {
+            return;
+        }
         engine.getDriverApi().generateMipmaps(mHandle);
+        mLoadedLevels = (1u << mLevels) - 1u;
+    }
+}
+
+void FTexture::generateMipmaps(FEngine& engine, PixelBufferDescriptor&& buffer) const noexcept {
+    if (!ASSERT_POSTCONDITION_NON_FATAL(mTarget == Sampler::SAMPLER_2D,
+            "generateMipmaps() with a buffer requires a SAMPLER_2D texture")) {
+        return;
+    }
+    if (mLevels == 1 || isTextureFormatMipmappable(engine, mFormat)) {
+        setImage(engine, 0, 0, 0, mWidth, mHeight, std::move(buffer));
+        generateMipmaps(engine);
+        return;
+    }
+    // the other levels are generated on the CPU, from a copy of the base level
+    ASSERT_POSTCONDITION_NON_FATAL(engine.getMipmapGenerator().generate(engine, this, buffer),
+            "Mipmaps of format %u, type %u can't be generated on the CPU",
+            buffer.format, buffer.type);
+    setImage(engine, 0, 0, 0, mWidth, mHeight, std::move(buffer));
+}
+
+void FTexture::setStreaming(FEngine& engine, StreamingCallback callback, void* user) noexcept {
+    if (!ASSERT_POSTCONDITION_NON_FATAL(mTarget == Sampler::SAMPLER_2D,
+            "Only SAMPLER_2D textures can be streamed")) {
+        return;
+    }
+    engine.getTextureStreamer().setStreaming(this, callback, user);
+    if (mStreamed && !callback) {
+        // all the levels uploaded are sampled again
+        engine.getDriverApi().setMinMaxLevels(mHandle, 0, uint8_t(mLevels - 1));
     }
+    mStreamed = callback != nullptr;
 }
 
 bool FTexture::isTextureFormatSupported(FEngine& engine, InternalFormat format) noexcept {
     return engine.getDriverApi().isTextureFormatSupported(format);
 }
 
+bool FTexture::isTextureFormatMipmappable(FEngine& engine, InternalFormat format) noexcept {
+    return engine.getDriverApi().isTextureFormatMipmappable(format);
+}
+
 size_t FTexture::computeTextureDataSize(Texture::Format format, Texture::Type type,
         size_t stride, size_t height, size_t alignment) noexcept {
     return PixelBufferDescriptor::computeDataSize(format, type, stride, height, alignment);
 }
 
+size_t FTexture::getSize() const noexcept {
+    const size_t texelSize = std::max(size_t(1), getFormatSize(mFormat));
+    const size_t faces = isCubemap() ? 6 : 1;
+    size_t size = 0;
+    for (size_t l = 0; l < mLevels; l++) {
+        size += getWidth(l) * getHeight(l) * getDepth(l);
+    }
+    return size * texelSize * faces * mSampleCount;
+}
+
 size_t FTexture::getFormatSize(InternalFormat format) noexcept {
     using TextureFormat = InternalFormat;
     switch (format) {
@@ -310,6 +399,13 @@ Texture::InternalFormat Texture::getFormat() const noexcept {
 
 void Texture::setImage(Engine& engine, size_t level,
         Texture::PixelBufferDescriptor&& buffer) const noexcept {
+    const Sampler target = getTarget();
+    if (target == Sampler::SAMPLER_2D_ARRAY || target == Sampler::SAMPLER_3D) {
+        upcast(this)->setImage(upcast(engine), level, 0, 0, 0,
+                uint32_t(getWidth(level)), uint32_t(getHeight(level)), uint32_t(getDepth(level)),
+                std::move(buffer));
+        return;
+    }
     upcast(this)->setImage(upcast(engine),
             level, 0, 0, uint32_t(getWidth(level)), uint32_t(getHeight(level)), std::move(buffer));
 }
@@ -326,6 +422,19 @@ void Texture::setImage(Engine& engine, size_t level,
     upcast(this)->setImage(upcast(engine), level, std::move(buffer), faceOffsets);
 }
 
+void Texture::setImage(Engine& engine, size_t level,
+        uint32_t xoffset, uint32_t yoffset, uint32_t zoffset,
+        uint32_t width, uint32_t height, uint32_t depth,
+        PixelBufferDescriptor&& buffer) const noexcept {
+    upcast(this)->setImage(upcast(engine),
+            level, xoffset, yoffset, zoffset, width, height, depth, std::move(buffer));
+}
+
+void Texture::setImage(Engine& engine, size_t level, Region const* regions, size_t count,
+        PixelBufferDescriptor&& buffer) const noexcept {
+    upcast(this)->setImage(upcast(engine), level, regions, count, std::move(buffer));
+}
+
 void Texture::setExternalImage(Engine& engine, void* image) noexcept {
     upcast(this)->setExternalImage(upcast(engine), image);
 }
@@ -338,10 +447,22 @@ void Texture::generateMipmaps(Engine& engine) const noexcept {
     upcast(this)->generateMipmaps(upcast(engine));
 }
 
+void Texture::generateMipmaps(Engine& engine, PixelBufferDescriptor&& buffer) const noexcept {
+    upcast(this)->generateMipmaps(upcast(engine), std::move(buffer));
+}
+
+void Texture::setStreaming(Engine& engine, StreamingCallback callback, void* user) noexcept {
+    upcast(this)->setStreaming(upcast(engine), callback, user);
+}
+
 bool Texture::isTextureFormatSupported(Engine& engine, InternalFormat format) noexcept {
     return FTexture::isTextureFormatSupported(upcast(engine), format);
 }
 
+bool Texture::isTextureFormatMipmappable(Engine& engine, InternalFormat format) noexcept {
+    return FTexture::isTextureFormatMipmappable(upcast(engine), format);
+}
+
 size_t Texture::computeTextureDataSize(Texture::Format format, Texture::Type type, size_t stride,
         size_t height, size_t alignment) noexcept {
     return FTexture::computeTextureDataSize(format, type, stride, height, alignment);
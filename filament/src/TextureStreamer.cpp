@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TextureStreamer.h"
+
+#include "details/Engine.h"
+#include "details/MaterialInstance.h"
+#include "details/RenderPrimitive.h"
+#include "details/Scene.h"
+#include "details/Texture.h"
+
+#include <utils/Systrace.h>
+
+#include <algorithm>
+
+#include <math.h>
+
+namespace filament {
+
+using namespace utils;
+using namespace driver;
+using namespace details;
+
+void TextureStreamer::setStreaming(FTexture* texture, Callback callback, void* user) noexcept {
+    auto pos = mIndices.find(texture->getHwHandle().getId());
+    if (!callback) {
+        if (pos != mIndices.end()) {
+            remove(texture);
+        }
+        return;
+    }
+    if (pos != mIndices.end()) {
+        Entry& entry = mEntries[pos->second];
+        entry.callback = callback;
+        entry.user = user;
+        return;
+    }
+    mIndices[texture->getHwHandle().getId()] = uint32_t(mEntries.size());
+    const uint8_t finest = getFinestLoadedLevel(texture);
+    mEntries.push_back({ texture, callback, user, mFrame, NONE,
+            uint8_t(std::min(finest, uint8_t(texture->getLevels() - 1))), 0, NONE });
+}
+
+void TextureStreamer::remove(FTexture const* texture) noexcept {
+    auto pos = mIndices.find(texture->getHwHandle().getId());
+    if (pos == mIndices.end()) {
+        return;
+    }
+    // the last entry takes the place of the one removed
+    const uint32_t index = pos->second;
+    mIndices.erase(pos);
+    if (index != mEntries.size() - 1) {
+        mEntries[index] = mEntries.back();
+        mIndices[mEntries[index].texture->getHwHandle().getId()] = index;
+    }
+    mEntries.pop_back();
+}
+
+size_t TextureStreamer::getSize(FTexture const* texture, uint8_t level) noexcept {
+    // the compressed formats report no size, they're counted as 1 byte per texel
+    const size_t texelSize = std::max(size_t(1), FTexture::getFormatSize(texture->getFormat()));
+    size_t size = 0;
+    for (size_t l = level, c = texture->getLevels(); l < c; l++) {
+        size += texture->getWidth(l) * texture->getHeight(l) * texelSize;
+    }
+    return size;
+}
+
+uint8_t TextureStreamer::getFinestLoadedLevel(FTexture const* texture) noexcept {
+    const uint32_t loaded = texture->getLoadedLevels();
+    uint8_t level = uint8_t(texture->getLevels());
+    while (level > 0 && (loaded & (1u << (level - 1u)))) {
+        level--;
+    }
+    return level;
+}
+
+void TextureStreamer::update(FScene const& scene, Range<uint32_t> visibles,
+        Viewport const& viewport) noexcept {
+    if (mEntries.empty()) {
+        return;
+    }
+
+    SYSTRACE_CALL();
+
+    FScene::RenderableSoa const& soa = scene.getRenderableData();
+    auto const* const UTILS_RESTRICT soaPrimitives = soa.data<FScene::PRIMITIVES>();
+    auto const* const UTILS_RESTRICT soaScreenCoverage = soa.data<FScene::SCREEN_COVERAGE>();
+    const float area = float(viewport.width) * float(viewport.height);
+
+    for (uint32_t i : visibles) {
+        // diameter in pixels of the disk covering the same area as the renderable
+        const float size = std::max(1.0f,
+                2.0f * std::sqrt(soaScreenCoverage[i] * area * float(M_1_PI)));
+        for (FRenderPrimitive const& primitive : soaPrimitives[i]) {
+            FMaterialInstance const* const mi = primitive.getMaterialInstance();
+            if (!mi) {
+                continue;
+            }
+            SamplerBuffer const& samplers = mi->getSamplerBuffer();
+            for (size_t s = 0, c = samplers.getSize(); s < c; s++) {
+                Handle<HwTexture> const t = samplers.getBuffer()[s].t;
+                auto pos = t ? mIndices.find(t.getId()) : mIndices.end();
+                if (pos == mIndices.end()) {
+                    continue;
+                }
+                // about one texel per pixel
+                Entry& entry = mEntries[pos->second];
+                FTexture const* const texture = entry.texture;
+                const float texels = float(std::max(texture->getWidth(), texture->getHeight()));
+                const int level = std::min(std::ilogbf(std::max(1.0f, texels / size)),
+                        int(texture->getLevels()) - 1);
+                entry.needed = std::min(entry.needed, uint8_t(level));
+                entry.lastNeeded = mFrame;
+            }
+        }
+    }
+}
+
+void TextureStreamer::commit(DriverApi& driver) noexcept {
+    Statistics stats;
+    stats.count = uint32_t(mEntries.size());
+    if (mEntries.empty()) {
+        mStatistics = stats;
+        return;
+    }
+
+    SYSTRACE_CALL();
+
+    // The textures needed this frame get the levels they need, the others keep theirs, as long
+    // as they fit in the budget.
+    size_t total = 0;
+    for (Entry& entry : mEntries) {
+        if (entry.needed != NONE) {
+            entry.target = entry.needed;
+        }
+        total += getSize(entry.texture, entry.target);
+    }
+
+    if (total > mBudget) {
+        // The least recently needed textures are coarsened first, down to their coarsest level
+        // if needed. The textures needed this frame are coarsened one level at a time, in turn,
+        // which is like a mip bias shared by all of them.
+        std::vector<uint32_t> order(mEntries.size());
+        for (uint32_t i = 0, c = uint32_t(order.size()); i < c; i++) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [this](uint32_t lhs, uint32_t rhs) {
+            return mEntries[lhs].lastNeeded < mEntries[rhs].lastNeeded;
+        });
+
+        auto coarsen = [this, &total](Entry& entry) -> bool {
+            if (entry.target + 1u >= entry.texture->getLevels()) {
+                return false;
+            }
+            total -= getSize(entry.texture, entry.target);
+            entry.target++;
+            total += getSize(entry.texture, entry.target);
+            return true;
+        };
+
+        auto current = order.begin();
+        for ( ; current != order.end() && total > mBudget; ++current) {
+            Entry& entry = mEntries[*current];
+            if (entry.lastNeeded == mFrame) {
+                break;
+            }
+            while (total > mBudget && coarsen(entry)) { }
+        }
+        for (bool coarsened = true; coarsened && total > mBudget; ) {
+            coarsened = false;
+            for (auto it = current; it != order.end() && total > mBudget; ++it) {
+                coarsened |= coarsen(mEntries[*it]);
+            }
+        }
+    }
+
+    // The levels finer than the target are evicted, the missing ones are asked for, from the
+    // coarsest to the finest, so that the levels uploaded are always contiguous. The requests
+    // start from a different texture each frame, so that they're all served.
+    struct Request {
+        FTexture* texture;
+        Callback callback;
+        void* user;
+        uint8_t level;
+    };
+    Request requests[MAX_REQUESTS_PER_FRAME];
+    size_t requestCount = 0;
+
+    const size_t count = mEntries.size();
+    for (size_t n = 0; n < count; n++) {
+        Entry& entry = mEntries[(mFrame + n) % count];
+        FTexture* const texture = entry.texture;
+        uint8_t finest = getFinestLoadedLevel(texture);
+        if (finest < entry.target) {
+            texture->evictLevels(entry.target);
+            stats.evictions += entry.target - finest;
+            finest = entry.target;
+        }
+
+        if (entry.requested != NONE &&
+                (entry.requested < entry.target || finest <= entry.requested)) {
+            // the level was uploaded, or isn't needed anymore
+            entry.requested = NONE;
+        }
+        if (entry.requested == NONE && entry.target < finest &&
+                requestCount < MAX_REQUESTS_PER_FRAME) {
+            entry.requested = uint8_t(finest - 1);
+            requests[requestCount++] = { texture, entry.callback, entry.user, entry.requested };
+        }
+
+        // nothing is sampled before the application uploads the first level
+        if (finest < texture->getLevels()) {
+            const uint8_t minLevel = std::max(entry.target, finest);
+            if (minLevel != entry.minLevel) {
+                entry.minLevel = minLevel;
+                driver.setMinMaxLevels(texture->getHwHandle(), minLevel,
+                        uint8_t(texture->getLevels() - 1));
+            }
+            stats.size += getSize(texture, minLevel);
+        }
+        entry.needed = NONE;
+    }
+
+    mFrame++;
+    stats.requests = uint32_t(requestCount);
+    mStatistics = stats;
+
+    // the callbacks may upload the levels right away
+    for (size_t i = 0; i < requestCount; i++) {
+        Request const& request = requests[i];
+        request.callback(request.texture, request.level, request.user);
+    }
+}
+
+} // namespace filament
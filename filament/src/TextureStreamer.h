@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_TEXTURESTREAMER_H
+#define TNT_FILAMENT_TEXTURESTREAMER_H
+
+#include "driver/DriverApiForward.h"
+
+#include <filament/Texture.h>
+#include <filament/Viewport.h>
+
+#include <utils/Range.h>
+
+#include <tsl/robin_map.h>
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+
+namespace details {
+class FScene;
+class FTexture;
+} // namespace details
+
+/*
+ * Decides which levels of the streamed textures (see Texture::setStreaming()) are sampled.
+ *
+ * Each frame, update() estimates the finest level each texture needs from the size on screen of
+ * the visible renderables using it (FScene::SCREEN_COVERAGE), assuming the texture is mapped
+ * once over the renderable. commit() then fits the levels needed in the budget, by coarsening
+ * the least recently needed textures first, asks the application for the missing levels, and
+ * restricts the levels the GPU samples to the ones kept (Driver::setMinMaxLevels()).
+ */
+class TextureStreamer {
+    static constexpr size_t DEFAULT_BUDGET = 256 * 1024 * 1024;
+
+    // levels asked for per frame, the uploads of a frame are usually processed together
+    static constexpr size_t MAX_REQUESTS_PER_FRAME = 8;
+
+public:
+    using Callback = Texture::StreamingCallback;
+
+    struct Statistics {
+        size_t size = 0;            // bytes of the levels sampled
+        uint32_t count = 0;         // number of streamed textures
+        uint32_t requests = 0;      // levels asked for by the last commit()
+        uint32_t evictions = 0;     // levels evicted by the last commit()
+    };
+
+    // a null callback stops streaming the texture
+    void setStreaming(details::FTexture* texture, Callback callback, void* user) noexcept;
+
+    void remove(details::FTexture const* texture) noexcept;
+
+    void setBudget(size_t bytes) noexcept { mBudget = bytes; }
+
+    // records the levels needed by the visible renderables of a view, after its culling
+    void update(details::FScene const& scene, utils::Range<uint32_t> visibles,
+            Viewport const& viewport) noexcept;
+
+    // call once per frame
+    void commit(driver::DriverApi& driver) noexcept;
+
+    Statistics getStatistics() const noexcept { return mStatistics; }
+
+private:
+    struct Entry {
+        details::FTexture* texture;
+        Callback callback;
+        void* user;
+        uint32_t lastNeeded;    // frame the texture was last needed
+        uint8_t needed;         // finest level needed since the last commit()
+        uint8_t target;         // finest level kept, within the budget
+        uint8_t minLevel;       // finest level sampled
+        uint8_t requested;      // level asked for and not uploaded yet, or NONE
+    };
+    static constexpr uint8_t NONE = 0xFF;
+
+    // bytes of the levels [level, levels) of a texture
+    static size_t getSize(details::FTexture const* texture, uint8_t level) noexcept;
+
+    // finest level of the texture uploaded along with all the coarser ones, levels if none
+    static uint8_t getFinestLoadedLevel(details::FTexture const* texture) noexcept;
+
+    std::vector<Entry> mEntries;
+    tsl::robin_map<uint32_t, uint32_t> mIndices;    // HwTexture id to index in mEntries
+    size_t mBudget = DEFAULT_BUDGET;
+    uint32_t mFrame = 0;
+    Statistics mStatistics;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_TEXTURESTREAMER_H
@@ -22,6 +22,13 @@
 
 #include <utils/Panic.h>
 
+#include <math/half.h>
+#include <math/norm.h>
+
+#include <algorithm>
+
+#include <stdlib.h>
+
 namespace filament {
 
 using namespace details;
@@ -31,6 +38,10 @@ struct VertexBuffer::BuilderDetails {
     AttributeBitset mDeclaredAttributes;
     uint32_t mVertexCount = 0;
     uint8_t mBufferCount = 0;
+    Usage mUsage = Usage::STATIC;
+    bool mQuantized = false;
+    bool mHasPositionBounds = false;
+    Box mPositionBounds;
 };
 
 using BuilderType = VertexBuffer;
@@ -94,6 +105,22 @@ VertexBuffer::Builder& VertexBuffer::Builder::normalized(VertexAttribute attribu
     return *this;
 }
 
+VertexBuffer::Builder& VertexBuffer::Builder::usage(Usage usage) noexcept {
+    mImpl->mUsage = usage;
+    return *this;
+}
+
+VertexBuffer::Builder& VertexBuffer::Builder::quantized(bool enabled) noexcept {
+    mImpl->mQuantized = enabled;
+    return *this;
+}
+
+VertexBuffer::Builder& VertexBuffer::Builder::positionBounds(Box const& bounds) noexcept {
+    mImpl->mPositionBounds = bounds;
+    mImpl->mHasPositionBounds = true;
+    return *this;
+}
+
 VertexBuffer* VertexBuffer::Builder::build(Engine& engine) {
     if (!ASSERT_PRECONDITION_NON_FATAL(mImpl->mVertexCount > 0, "vertexCount cannot be 0")) {
         return nullptr;
@@ -115,6 +142,10 @@ FVertexBuffer::FVertexBuffer(FEngine& engine, const VertexBuffer::Builder& build
     std::copy(std::begin(builder->mAttributes), std::end(builder->mAttributes), mAttributes.begin());
 
     mDeclaredAttributes = builder->mDeclaredAttributes;
+    if (builder->mQuantized) {
+        mPositionBounds = builder->mPositionBounds;
+        quantize(builder->mHasPositionBounds);
+    }
     uint8_t attributeCount = (uint8_t) mDeclaredAttributes.count();
 
     Driver::AttributeArray attributeArray;
@@ -139,7 +170,134 @@ FVertexBuffer::FVertexBuffer(FEngine& engine, const VertexBuffer::Builder& build
 
     FEngine::DriverApi& driver = engine.getDriverApi();
     mHandle = driver.createVertexBuffer(
-            mBufferCount, attributeCount, mVertexCount, attributeArray);
+            mBufferCount, attributeCount, mVertexCount, attributeArray, builder->mUsage);
+}
+
+FVertexBuffer::AttributeType FVertexBuffer::getQuantizedType(size_t attribute,
+        AttributeType type, bool hasPositionBounds) noexcept {
+    switch (attribute) {
+        case VertexAttribute::POSITION:
+            if (type == AttributeType::FLOAT3 || type == AttributeType::FLOAT4) {
+                return hasPositionBounds ? AttributeType::SHORT4 : AttributeType::HALF4;
+            }
+            break;
+        case VertexAttribute::TANGENTS:
+            if (type == AttributeType::FLOAT4) {
+                return AttributeType::SHORT4;
+            }
+            break;
+        case VertexAttribute::UV0:
+        case VertexAttribute::UV1:
+            if (type == AttributeType::FLOAT2) {
+                return AttributeType::HALF2;
+            }
+            break;
+        default:
+            break;
+    }
+    return type;
+}
+
+void FVertexBuffer::quantize(bool hasPositionBounds) noexcept {
+    mSourceAttributes = mAttributes;
+    for (size_t b = 0; b < mBufferCount; b++) {
+        // the attributes of the buffer, by increasing offset
+        size_t indices[MAX_ATTRIBUTE_BUFFERS_COUNT];
+        size_t count = 0;
+        for (size_t i = 0, n = mAttributes.size(); i < n; i++) {
+            if (mDeclaredAttributes[i] && mAttributes[i].buffer == b) {
+                indices[count++] = i;
+            }
+        }
+        std::sort(indices, indices + count, [this](size_t lhs, size_t rhs) {
+            return mAttributes[lhs].offset < mAttributes[rhs].offset;
+        });
+
+        // the buffer is only quantized if each vertex is a record of the same stride
+        bool quantized = false;
+        bool interleaved = count > 0;
+        const uint8_t stride = count ? mAttributes[indices[0]].stride : uint8_t(0);
+        for (size_t k = 0; k < count; k++) {
+            auto const& attribute = mAttributes[indices[k]];
+            interleaved = interleaved && attribute.stride == stride &&
+                    attribute.offset + Driver::getElementTypeSize(attribute.type) <= stride;
+            quantized = quantized || attribute.type !=
+                    getQuantizedType(indices[k], attribute.type, hasPositionBounds);
+        }
+        if (!interleaved || !quantized) {
+            continue;
+        }
+
+        // the attributes are packed in the same order, 4-bytes aligned
+        uint32_t offset = 0;
+        for (size_t k = 0; k < count; k++) {
+            auto& attribute = mAttributes[indices[k]];
+            const AttributeType type =
+                    getQuantizedType(indices[k], attribute.type, hasPositionBounds);
+            if (type != attribute.type) {
+                attribute.type = type;
+                attribute.normalized = type == AttributeType::SHORT4;
+                mHasPositionBounds = mHasPositionBounds ||
+                        (indices[k] == VertexAttribute::POSITION && hasPositionBounds);
+            }
+            attribute.offset = offset;
+            offset += (Driver::getElementTypeSize(type) + 3u) & ~3u;
+        }
+        for (size_t k = 0; k < count; k++) {
+            mAttributes[indices[k]].stride = uint8_t(offset);
+        }
+        mSourceStrides[b] = stride;
+        mQuantizedStrides[b] = uint8_t(offset);
+    }
+}
+
+void FVertexBuffer::quantizeVertices(uint8_t bufferIndex, void* dst, void const* src,
+        size_t count) const noexcept {
+    using namespace math;
+    const uint8_t srcStride = mSourceStrides[bufferIndex];
+    const float3 center = mPositionBounds.center;
+    const float3 scale = 1.0f / max(mPositionBounds.halfExtent, float3(
+            std::numeric_limits<float>::min()));
+
+    for (size_t i = 0, n = mAttributes.size(); i < n; i++) {
+        auto const& to = mAttributes[i];
+        auto const& from = mSourceAttributes[i];
+        if (!mDeclaredAttributes[i] || to.buffer != bufferIndex) {
+            continue;
+        }
+        char* UTILS_RESTRICT out = static_cast<char*>(dst) + to.offset;
+        char const* UTILS_RESTRICT in = static_cast<char const*>(src) + from.offset;
+        if (to.type == from.type) {
+            const size_t size = Driver::getElementTypeSize(to.type);
+            for (size_t v = 0; v < count; v++, out += to.stride, in += srcStride) {
+                memcpy(out, in, size);
+            }
+            continue;
+        }
+        // the source components are floats, 4 of them for positions declared as FLOAT4
+        const bool hasW = from.type == AttributeType::FLOAT4;
+        for (size_t v = 0; v < count; v++, out += to.stride, in += srcStride) {
+            float4 f{ 0, 0, 0, 1 };
+            memcpy(&f, in, Driver::getElementTypeSize(from.type));
+            if (i == VertexAttribute::POSITION && !hasW) {
+                f.w = 1;
+            }
+            if (to.type == AttributeType::HALF4) {
+                const half4 h{ f };
+                memcpy(out, &h, sizeof(h));
+            } else if (to.type == AttributeType::HALF2) {
+                const half2 h{ f.xy };
+                memcpy(out, &h, sizeof(h));
+            } else if (i == VertexAttribute::POSITION) {
+                // positions are mapped from the box to [-1, 1]
+                const short4 s = packSnorm16(float4{ (f.xyz - center) * scale, f.w });
+                memcpy(out, &s, sizeof(s));
+            } else {
+                const short4 s = packSnorm16(f);
+                memcpy(out, &s, sizeof(s));
+            }
+        }
+    }
 }
 
 void FVertexBuffer::terminate(FEngine& engine) {
@@ -151,6 +309,23 @@ size_t FVertexBuffer::getVertexCount() const noexcept {
     return mVertexCount;
 }
 
+size_t FVertexBuffer::getSize() const noexcept {
+    // each buffer ends with the last attribute it holds, as sized by the driver
+    size_t sizes[MAX_ATTRIBUTE_BUFFERS_COUNT] = {};
+    for (size_t i = 0, n = mAttributes.size(); i < n; i++) {
+        if (mDeclaredAttributes[i]) {
+            auto const& attribute = mAttributes[i];
+            sizes[attribute.buffer] = std::max(sizes[attribute.buffer],
+                    attribute.offset + size_t(mVertexCount) * attribute.stride);
+        }
+    }
+    size_t size = 0;
+    for (size_t s : sizes) {
+        size += s;
+    }
+    return size;
+}
+
 void FVertexBuffer::setBufferAt(FEngine& engine, uint8_t bufferIndex,
         driver::BufferDescriptor&& buffer, uint32_t byteOffset, uint32_t byteSize) {
 
@@ -158,7 +333,22 @@ void FVertexBuffer::setBufferAt(FEngine& engine, uint8_t bufferIndex,
         byteSize = uint32_t(buffer.size);
     }
 
-    if (bufferIndex < mBufferCount) {
+    if (bufferIndex < mBufferCount && mSourceStrides[bufferIndex]) {
+        // the vertices are quantized here, the user's buffer is released when this returns
+        const uint32_t srcStride = mSourceStrides[bufferIndex];
+        const uint32_t dstStride = mQuantizedStrides[bufferIndex];
+        if (!ASSERT_PRECONDITION_NON_FATAL(byteOffset % srcStride == 0 && byteSize % srcStride == 0,
+                "quantized buffers must be updated by whole vertices")) {
+            return;
+        }
+        const size_t count = byteSize / srcStride;
+        void* const vertices = malloc(count * dstStride);
+        quantizeVertices(bufferIndex, vertices, buffer.buffer, count);
+        engine.getDriverApi().loadVertexBuffer(mHandle, bufferIndex,
+                BufferDescriptor(vertices, count * dstStride,
+                        [](void* buffer, size_t, void*) { free(buffer); }),
+                byteOffset / srcStride * dstStride, uint32_t(count * dstStride));
+    } else if (bufferIndex < mBufferCount) {
         engine.getDriverApi().loadVertexBuffer(mHandle, bufferIndex,
                 std::move(buffer), byteOffset, byteSize);
     } else {
@@ -26,6 +26,8 @@
 #include "details/Scene.h"
 #include "details/Skybox.h"
 
+#include "PhaseProfiler.h"
+
 #include <filament/Exposure.h>
 
 #include <utils/Allocator.h>
@@ -51,16 +53,40 @@ static constexpr size_t VISIBLE_SHADOW_CASTER_BIT = 1u;
 static constexpr uint8_t VISIBLE_RENDERABLE = 1u << VISIBLE_RENDERABLE_BIT;
 static constexpr uint8_t VISIBLE_SHADOW_CASTER = 1u << VISIBLE_SHADOW_CASTER_BIT;
 static constexpr uint8_t VISIBLE_ALL = VISIBLE_RENDERABLE | VISIBLE_SHADOW_CASTER;
+// casters of each shadow cascade, VISIBLE_SHADOW_CASTER is set if any of these is
+static constexpr size_t VISIBLE_SHADOW_CASCADE_BIT = 2u;
+static constexpr uint8_t VISIBLE_SHADOW_CASCADES =
+        ((1u << CONFIG_MAX_SHADOW_CASCADES) - 1u) << VISIBLE_SHADOW_CASCADE_BIT;
+// set by the occlusion culling, on renderables hidden in the depth pyramid
+static constexpr size_t OCCLUDED_RENDERABLE_BIT =
+        VISIBLE_SHADOW_CASCADE_BIT + CONFIG_MAX_SHADOW_CASCADES;
+static constexpr uint8_t OCCLUDED_RENDERABLE = 1u << OCCLUDED_RENDERABLE_BIT;
+static_assert(OCCLUDED_RENDERABLE_BIT < 8,
+        "shadow cascades and occlusion don't fit in VISIBLE_MASK");
+
+// gains of the dynamic resolution controller, see updateScale()
+static constexpr float PID_KP = 0.5f;
+static constexpr float PID_KI = 1.0f;
+static constexpr float PID_KD = 0.1f;
+
+// part of the frame time target always left to the resolution dependent work, when the fixed
+// work alone exceeds the target
+static constexpr float MIN_SCALABLE_BUDGET = 0.1f;
 
 FView::FView(FEngine& engine)
     : mFroxelizer(engine),
       mPerViewUb(engine.getPerViewUib()),
+      mPerFrameUb(engine.getPerFrameUib()),
       mPerViewSb(engine.getPerViewSib()),
       mClipSpace01(engine.getBackend() == Backend::VULKAN),
-      mDirectionalShadowMap(engine) {
+      mDirectionalShadowMap(engine),
+      mShadowAtlas(engine),
+      mDepthPyramid(engine),
+      mTemporalUpscaler(engine) {
     DriverApi& driverApi = engine.getDriverApi();
 
     mPerViewUbh = driverApi.createUniformBuffer(mPerViewUb.getSize());
+    mPerFrameUbh = driverApi.createUniformBuffer(mPerFrameUb.getSize());
     mPerViewSbh = driverApi.createSamplerBuffer(mPerViewSb.getSize());
 
     mPerViewSb.setBuffer(FEngine::PerViewSib::RECORDS, mFroxelizer.getRecordBuffer());
@@ -73,6 +99,15 @@ FView::FView(FEngine& engine)
     }
 
     mIsDynamicResolutionSupported = driverApi.isFrameTimeSupported();
+    // the driver culls the draws of the batches, which are only formed with drawIndirect()
+    mGpuCullingSupported = engine.isDrawIndirectSupported();
+    std::fill(std::begin(mScaleHistory), std::end(mScaleHistory), float2{ 1.0f });
+
+    // each renderable's uniforms must start at a multiple of the driver's alignment
+    const uint32_t alignment = driverApi.getUniformBufferOffsetAlignment();
+    const uint32_t size = uint32_t(engine.getPerRenderableUib().getSize());
+    mPerRenderableUniforms.size = size;
+    mPerRenderableUniforms.stride = ((size + alignment - 1) / alignment) * alignment;
 
     driverApi.updateSamplerBuffer(mPerViewSbh, SamplerBuffer(mPerViewSb));
 }
@@ -83,8 +118,16 @@ void FView::terminate(FEngine& engine) {
     // Here we would cleanly free resources we've allocated or we own (currently none).
     DriverApi& driverApi = engine.getDriverApi();
     driverApi.destroyUniformBuffer(mPerViewUbh);
+    driverApi.destroyUniformBuffer(mPerFrameUbh);
     driverApi.destroySamplerBuffer(mPerViewSbh);
-    mDirectionalShadowMap.terminate(driverApi);
+    for (PerRenderableUbo const& ubo : mPerRenderableUbos) {
+        if (ubo.handle) {
+            driverApi.destroyUniformBuffer(ubo.handle);
+        }
+    }
+    mShadowAtlas.terminate();
+    mDepthPyramid.terminate();
+    mTemporalUpscaler.terminate();
     mFroxelizer.terminate(driverApi);
 }
 
@@ -104,8 +147,9 @@ void FView::setDynamicResolutionOptions(DynamicResolutionOptions const& options)
         // History can't be more than 30 frames (~0.5s)
         dynamicResolution.history = std::min(dynamicResolution.history, uint8_t(30));
 
-        // History must at least be 3 frames
+        // History must at least be 3 frames, and at most 30
         dynamicResolution.history = std::max(dynamicResolution.history, uint8_t(3));
+        dynamicResolution.history = std::min(dynamicResolution.history, uint8_t(COST_HISTORY_SIZE));
 
         // can't ask more 240 fps
         dynamicResolution.targetFrameTimeMilli =
@@ -130,9 +174,11 @@ void FView::setDynamicResolutionOptions(DynamicResolutionOptions const& options)
         dynamicResolution.maxScale = min(dynamicResolution.maxScale, float2(2.0f));
 
         // reset the history, so we start from a known (and current) state
-        mFrameTimeHistory.clear();
+        mCostHistoryCount = 0;
+        mCostHistoryHead = 0;
         mScale = 1.0f;
-        mDynamicWorkloadScale = 1.0f;
+        std::fill(std::begin(mScaleHistory), std::end(mScaleHistory), float2{ 1.0f });
+        mPidErrors[0] = mPidErrors[1] = 0.0f;
     }
 }
 
@@ -140,46 +186,71 @@ void FView::setDynamicLightingOptions(float zLightNear, float zLightFar) noexcep
     mFroxelizer.setOptions(zLightNear, zLightFar);
 }
 
+void FView::setDynamicLightingLimits(uint32_t maxFroxelCount, uint32_t maxLightCount) noexcept {
+    mFroxelizer.setMaxFroxelCount(maxFroxelCount);
+    mMaxLightCount = std::min(maxLightCount, uint32_t(CONFIG_MAX_LIGHT_COUNT));
+}
 
-math::float2 FView::updateScale(duration frameTime) noexcept {
+void FView::setLightBinning(bool enabled) noexcept {
+    mFroxelizer.setLightBinning(enabled);
+}
+
+
+math::float2 FView::updateScale(uint32_t frame, FrameTiming const& timing) noexcept {
     DynamicResolutionOptions const& options = mDynamicResolution;
     if (options.enabled) {
+        // the scale used by this frame, unless we have a new measurement
+        mScaleHistory[frame % SCALE_HISTORY_SIZE] = mScale;
 
-        if (UTILS_UNLIKELY(frameTime.count() <= std::numeric_limits<float>::epsilon())) {
-            mScale = 1.0f;
+        const uint32_t age = frame - timing.frame;
+        if (UTILS_UNLIKELY(timing.scalableMilli <= std::numeric_limits<float>::epsilon() ||
+                age == 0 || age >= SCALE_HISTORY_SIZE)) {
+            // nothing was measured yet, or it's too old to know the scale it was rendered at
             return mScale;
         }
-
-        // keep an history of frame times
-        auto& history = mFrameTimeHistory;
-        history.push_front(frameTime);
-        if (history.size() > options.history) {
-            history.pop_back();
-        } else if (UTILS_UNLIKELY(history.size() < 3)) {
+        if (timing.frame == mTimedFrame) {
+            // the controller only steps on new measurements
+            return mScale;
+        }
+        mTimedFrame = timing.frame;
+
+        // The frame time is modeled as fixed + cost * area, where area is the fraction of the
+        // viewport rendered. The cost is estimated from the measured frame and the scale it was
+        // rendered at, and median filtered since single frames are noisy.
+        const float2 timedScale = mScaleHistory[timing.frame % SCALE_HISTORY_SIZE];
+        mCostHistory[mCostHistoryHead] = timing.scalableMilli / (timedScale.x * timedScale.y);
+        mCostHistoryHead = (mCostHistoryHead + 1) % options.history;
+        mCostHistoryCount = std::min(mCostHistoryCount + 1, uint32_t(options.history));
+        if (UTILS_UNLIKELY(mCostHistoryCount < 3)) {
             // don't make any decision if we don't have enough data
-            mScale = 1.0f;
             return mScale;
         }
-
-        // apply a median filter to get a good representation of the frame time of the last
-        // N frames.
-        std::array<duration, 30> median; // NOLINT -- it's initialized below
-        size_t size = std::min(history.size(), median.size());
-        std::uninitialized_copy_n(history.begin(), size, median.begin());
+        std::array<float, COST_HISTORY_SIZE> median; // NOLINT -- it's initialized below
+        const size_t size = mCostHistoryCount;
+        std::copy_n(mCostHistory, size, median.begin());
         std::sort(median.begin(), median.begin() + size);
-        duration filteredFrameTime = median[size / 2];
-
-        // how much we need to scale the current workload to fit in our target, at this instant
-        const float targetWithHeadroom = options.targetFrameTimeMilli * (1 - options.headRoomRatio);
-        const float workloadScale = targetWithHeadroom / filteredFrameTime.count();
-
-        // low-pass: y += b * (x - y)
-        const float oneOverTau = options.scaleRate;
-        const float x = mScale.x * mScale.y * workloadScale;
-        mDynamicWorkloadScale += (1.0f - std::exp(-oneOverTau)) * (x - mDynamicWorkloadScale);
+        const float cost = median[size / 2];
+
+        // The measurement is a few frames late, so rather than the measured frame time, the
+        // time the model predicts for the current scale is compared to the target. This keeps
+        // the controller from overshooting while its previous corrections are in flight.
+        // The error is in the log domain: the area must be scaled by exp(error) to hit the target.
+        const float target = options.targetFrameTimeMilli * (1 - options.headRoomRatio);
+        const float budget = std::max(target - timing.fixedMilli, target * MIN_SCALABLE_BUDGET);
+        const float area = mScale.x * mScale.y;
+        const float error = std::log(budget / (cost * area));
+
+        // PID controller in velocity form, its output is the change of the (log) area. Because
+        // it restarts from the actual scale at each step, clamping the scale can't wind it up.
+        const float rate = 1.0f - std::exp(-options.scaleRate);
+        const float de = error - mPidErrors[0];
+        const float d2e = error - 2.0f * mPidErrors[0] + mPidErrors[1];
+        const float du = rate * (PID_KP * de + PID_KI * error + PID_KD * d2e);
+        mPidErrors[1] = mPidErrors[0];
+        mPidErrors[0] = error;
 
         // scaling factor we need to apply on the whole surface
-        const float scale = mDynamicWorkloadScale;
+        const float scale = area * std::exp(du);
 
         const float w = mViewport.width;
         const float h = mViewport.height;
@@ -213,16 +284,17 @@ math::float2 FView::updateScale(duration frameTime) noexcept {
 
         // always clamp to the min/max scale range
         mScale = clamp(mScale, options.minScale, options.maxScale);
+        mScaleHistory[frame % SCALE_HISTORY_SIZE] = mScale;
 
 //#define DEBUG_DYNAMIC_RESOLUTION
 #if !defined(NDEBUG) && defined(DEBUG_DYNAMIC_RESOLUTION)
         static int sLogCounter = 15;
         if (!--sLogCounter) {
             sLogCounter = 15;
-            slog.d << frameTime.count()
-                   << ", " << filteredFrameTime.count()
-                   << ", " << workloadScale
-                   << ", " << mDynamicWorkloadScale
+            slog.d << timing.fixedMilli
+                   << ", " << timing.scalableMilli
+                   << ", " << cost
+                   << ", " << error
                    << ", " << mScale.x
                    << ", " << mScale.y
                    << ", " << mScale.x * mScale.y
@@ -257,57 +329,176 @@ bool FView::isSkyboxVisible() const noexcept {
 }
 
 void FView::prepareShadowing(FEngine& engine, driver::DriverApi& driver,
-        FScene::RenderableSoa& renderableData, FScene::LightSoa const& lightData) noexcept {
+        FScene::LightSoa const& lightData, Viewport const& viewport) noexcept {
     SYSTRACE_CALL();
 
-    // setup shadow mapping
-    // TODO: for now we only consider THE directional light
+    // All shadow maps are tiles of the shadow atlas: the cascades of the dominant directional
+    // light, and the spot lights closest to the camera.
 
     auto& lcm = engine.getLightManager();
     UniformBuffer& u = getUb();
     FScene* const scene = mScene;
 
+    mHasShadowing = false;
+    mHasDirectionalShadowing = false;
+    mSpotShadowCount = 0;
+    if (!mShadowingEnabled) {
+        return;
+    }
+
+    // with auto-sizing, shadow maps are sized from the area their receivers cover on screen
+    const Viewport autoSizeViewport = mShadowAutoSizingEnabled ? viewport : Viewport{};
+
+    // scene bounds in world space, shared by all shadow maps
+    Aabb wsShadowCastersVolume, wsShadowReceiversVolume;
+    scene->computeBounds(wsShadowCastersVolume, wsShadowReceiversVolume, mVisibleLayers);
+
     // dominant directional light is always as index 0
     FLightManager::Instance directionalLight = lightData.elementAt<FScene::LIGHT_INSTANCE>(0);
-    mHasShadowing = mShadowingEnabled && directionalLight && lcm.isShadowCaster(directionalLight);
-    if (UTILS_UNLIKELY(mHasShadowing)) {
+    ShadowMap& shadowMap = mDirectionalShadowMap;
+    if (directionalLight && lcm.isShadowCaster(directionalLight)) {
         // compute the frustum for this light
-        ShadowMap& shadowMap = mDirectionalShadowMap;
-        shadowMap.update(lightData, 0, scene, mViewingCameraInfo, mVisibleLayers);
-        if (shadowMap.hasVisibleShadows()) {
-            // Cull shadow casters
-            Frustum const& frustum = shadowMap.getCamera().getFrustum();
-            prepareVisibleShadowCasters(engine.getJobSystem(), renderableData, frustum);
-
-            // allocates shadowmap driver resources
-            shadowMap.prepare(driver, getUs());
-
-            mat4f const& lightFromWorldMatrix = shadowMap.getLightSpaceMatrix();
-            u.setUniform(offsetof(FEngine::PerViewUib, lightFromWorldMatrix), lightFromWorldMatrix);
-
-            // the 2x bias is needed in opengl because the depth maps to -1/1. It may not be
-            // needed with other APIs, but at least it won't worsen the acnee there.
-            const float sceneRange = shadowMap.getSceneRange();
-            const float texelSizeWorldSpace = shadowMap.getTexelSizeWorldSpace();
-            const float constantBias = lcm.getShadowConstantBias(directionalLight);
-            const float normalBias = lcm.getShadowNormalBias(directionalLight);
-            u.setUniform(offsetof(FEngine::PerViewUib, shadowBias),
-                    float3{ 2 * constantBias / sceneRange, normalBias * texelSizeWorldSpace, 0 });
+        shadowMap.update(lightData, 0,
+                wsShadowCastersVolume, wsShadowReceiversVolume, mViewingCameraInfo,
+                autoSizeViewport);
+        mHasDirectionalShadowing = shadowMap.hasVisibleShadows();
+    }
+
+    prepareSpotShadows(engine, lightData, wsShadowCastersVolume, wsShadowReceiversVolume,
+            autoSizeViewport);
+
+    mHasShadowing = mHasDirectionalShadowing || mSpotShadowCount > 0;
+    if (!mHasShadowing) {
+        return;
+    }
+
+    // shadow casters are culled later, by prepareVisibleRenderables()
+
+    // request a tile for each cascade and spot light with visible shadows
+    ShadowAtlas& atlas = mShadowAtlas;
+    atlas.clear();
+    const size_t cascadeCount = mHasDirectionalShadowing ? shadowMap.getCascadeCount() : 0;
+    size_t cascadeTiles[CONFIG_MAX_SHADOW_CASCADES];
+    for (size_t i = 0; i < cascadeCount; i++) {
+        if (shadowMap.hasVisibleShadows(i)) {
+            cascadeTiles[i] = atlas.add(shadowMap.getDimension());
+        }
+    }
+    size_t spotTiles[CONFIG_MAX_SHADOWED_SPOT_LIGHTS];
+    for (size_t i = 0; i < mSpotShadowCount; i++) {
+        spotTiles[i] = atlas.add(mSpotShadowMaps[i]->getDimension());
+    }
+
+    // allocates the atlas driver resources
+    atlas.setCachingEnabled(mShadowCachingEnabled);
+    atlas.setMomentsEnabled(mShadowType == ShadowType::EVSM);
+    atlas.allocate(getUs());
+    u.setUniform(offsetof(FEngine::PerViewUib, shadowMoments), atlas.hasMoments() ? 1.0f : 0.0f);
+    const uint32_t atlasWidth = atlas.getWidth();
+    const uint32_t atlasHeight = atlas.getHeight();
+
+    if (mHasDirectionalShadowing) {
+        // the 2x bias is needed in opengl because the depth maps to -1/1. It may not be
+        // needed with other APIs, but at least it won't worsen the acnee there.
+        const float constantBias = lcm.getShadowConstantBias(directionalLight);
+        const float normalBias = lcm.getShadowNormalBias(directionalLight);
+        float4 cascadeSplits{ 0 }, cascadeConstantBias{ 0 }, cascadeNormalBias{ 0 };
+        for (size_t i = 0; i < CONFIG_MAX_SHADOW_CASCADES; i++) {
+            cascadeSplits[i] = shadowMap.getCascadeSplit(i);
+            if (i < cascadeCount) {
+                shadowMap.setTile(i, shadowMap.hasVisibleShadows(i) ?
+                        atlas.getTile(cascadeTiles[i]) : Viewport{}, atlasWidth, atlasHeight);
+                u.setUniform(offsetof(FEngine::PerViewUib, lightFromWorldMatrix) +
+                        i * sizeof(mat4f), shadowMap.getLightSpaceMatrix(i));
+            }
+            if (shadowMap.hasVisibleShadows(i)) {
+                cascadeConstantBias[i] = 2 * constantBias / shadowMap.getSceneRange(i);
+                cascadeNormalBias[i] = normalBias * shadowMap.getTexelSizeWorldSpace(i);
+            }
+        }
+
+        // the first cascade is computed per vertex, the others are computed per fragment
+        u.setUniform(offsetof(FEngine::PerViewUib, shadowBias),
+                float3{ cascadeConstantBias[0], cascadeNormalBias[0], float(cascadeCount) });
+        u.setUniform(offsetof(FEngine::PerViewUib, cascadeSplits), cascadeSplits);
+        u.setUniform(offsetof(FEngine::PerViewUib, cascadeConstantBias), cascadeConstantBias);
+        u.setUniform(offsetof(FEngine::PerViewUib, cascadeNormalBias), cascadeNormalBias);
+    } else {
+        // shadow receivers still look up the directional light's shadows
+        u.setUniform(offsetof(FEngine::PerViewUib, lightFromWorldMatrix),
+                ShadowMap::getLitLightSpaceMatrix());
+        u.setUniform(offsetof(FEngine::PerViewUib, shadowBias), float3{ 0, 0, 1 });
+    }
+
+    for (size_t i = 0; i < mSpotShadowCount; i++) {
+        ShadowMap& spotShadowMap = *mSpotShadowMaps[i];
+        spotShadowMap.setTile(0, atlas.getTile(spotTiles[i]), atlasWidth, atlasHeight);
+
+        // the constant bias is in world units, the normal bias scales with the distance
+        // to the light (like the texels of the shadow map).
+        FLightManager::Instance li = mSpotShadowLights[i];
+        const float4 bias{ lcm.getShadowConstantBias(li),
+                lcm.getShadowNormalBias(li) * spotShadowMap.getTexelSizeWorldSpace(0), 0, 0 };
+        u.setUniform(offsetof(FEngine::PerViewUib, spotLightFromWorldMatrix) + i * sizeof(mat4f),
+                spotShadowMap.getLightSpaceMatrix(0));
+        u.setUniform(offsetof(FEngine::PerViewUib, spotShadowBias) + i * sizeof(float4), bias);
+    }
+}
+
+void FView::prepareSpotShadows(FEngine& engine, FScene::LightSoa const& lightData,
+        Aabb const& wsShadowCastersVolume, Aabb const& wsShadowReceiversVolume,
+        Viewport const& autoSizeViewport) noexcept {
+    auto& lcm = engine.getLightManager();
+    float4 const* const spheres = lightData.data<FScene::POSITION_RADIUS>();
+    auto const* const instances = lightData.data<FScene::LIGHT_INSTANCE>();
+
+    // the shadow casting spot lights in the view frustum are candidates, only the closest to
+    // the camera get a shadow map. (lights are culled more precisely later, by cullLights())
+    using Type = FLightManager::Type;
+    const float3 cameraPosition = mViewingCameraInfo.getPosition();
+    std::vector<std::pair<float, size_t>>& candidates = mSpotShadowCandidates;
+    candidates.clear();
+    for (size_t i = FScene::DIRECTIONAL_LIGHTS_COUNT, c = lightData.size(); i < c; i++) {
+        FLightManager::Instance li = instances[i];
+        const Type type = lcm.getType(li);
+        if ((type == Type::SPOT || type == Type::FOCUSED_SPOT) && lcm.isShadowCaster(li) &&
+                mCullingFrustum.intersects(spheres[i])) {
+            candidates.emplace_back(length(spheres[i].xyz - cameraPosition), i);
+        }
+    }
+
+    const size_t count = std::min(candidates.size(), CONFIG_MAX_SHADOWED_SPOT_LIGHTS);
+    std::partial_sort(candidates.begin(), candidates.begin() + count, candidates.end());
+
+    for (size_t i = 0; i < count; i++) {
+        const size_t index = candidates[i].second;
+        std::unique_ptr<ShadowMap>& shadowMap = mSpotShadowMaps[mSpotShadowCount];
+        if (!shadowMap) {
+            shadowMap = std::make_unique<ShadowMap>(engine);
+        }
+        shadowMap->update(lightData, index,
+                wsShadowCastersVolume, wsShadowReceiversVolume, mViewingCameraInfo,
+                autoSizeViewport);
+        if (shadowMap->hasVisibleShadows()) {
+            mSpotShadowLights[mSpotShadowCount++] = instances[index];
         }
     }
 }
 
 void FView::prepareLighting(FEngine& engine, FEngine::DriverApi& driver, ArenaScope& arena,
-        Viewport const& viewport) noexcept {
+        Viewport const& viewport, bool prepareLights) noexcept {
     SYSTRACE_CALL();
 
     UniformBuffer& u = getUb();
     const CameraInfo& camera = mViewingCameraInfo;
     FScene* const scene = mScene;
 
-    scene->prepareDynamicLights(camera, arena);
+    if (prepareLights) {
+        scene->prepareDynamicLights(camera, arena, mMaxLightCount,
+                { mSpotShadowLights, mSpotShadowLights + mSpotShadowCount });
+    }
 
-    // here the array of visible lights has been shrunk to CONFIG_MAX_LIGHT_COUNT
+    // here the array of visible lights has been shrunk to mMaxLightCount
     auto const& lightData = scene->getLightData();
 
     // trace the number of visible lights
@@ -324,6 +515,10 @@ void FView::prepareLighting(FEngine& engine, FEngine::DriverApi& driver, ArenaSc
     if (ibl) {
         u.setUniform(offsetof(FEngine::PerViewUib, iblLuminance), ibl->getIntensity() * exposure);
         u.setUniformArray(offsetof(FEngine::PerViewUib, iblSH), ibl->getSH(), 9);
+        u.setUniform(offsetof(FEngine::PerViewUib, iblRGBM),
+                ibl->isReflectionMapRGBM() ? 1.0f : 0.0f);
+        // the environment is looked up in its own space, for a rotation the inverse is the transpose
+        u.setUniform(offsetof(FEngine::PerViewUib, iblRotation), transpose(ibl->getRotation()));
         if (ibl->getReflectionMap()) {
             SamplerParams reflectionSamplerParams;
             reflectionSamplerParams.filterMag = SamplerMagFilter::LINEAR;
@@ -334,6 +529,8 @@ void FView::prepareLighting(FEngine& engine, FEngine::DriverApi& driver, ArenaSc
     } else {
         u.setUniform(offsetof(FEngine::PerViewUib, iblLuminance),
                 FIndirectLight::DEFAULT_INTENSITY * exposure);
+        u.setUniform(offsetof(FEngine::PerViewUib, iblRGBM), 1.0f);
+        u.setUniform(offsetof(FEngine::PerViewUib, iblRotation), mat3f{});
     }
 
     // Directional light (always at index 0)
@@ -372,16 +569,43 @@ void FView::prepareLighting(FEngine& engine, FEngine::DriverApi& driver, ArenaSc
     // Dynamic lighting
     if (mHasDynamicLighting) {
         Froxelizer& froxelizer = mFroxelizer;
-        if (froxelizer.prepare(driver, arena, viewport, camera.projection, camera.zn, camera.zf)) {
+        if (froxelizer.prepare(driver, arena, viewport, camera.projection, camera.zn, camera.zf,
+                lightData.size() - FScene::DIRECTIONAL_LIGHTS_COUNT)) {
             froxelizer.updateUniforms(u); // update our uniform buffer if needed
         }
     }
 }
 
+static CameraInfo computeCameraInfo(FCamera const& camera, mat4f const& worldOrigin) noexcept {
+    const mat4f model{ worldOrigin * camera.getModelMatrix() };
+    return CameraInfo{
+            // projection with infinite z-far
+            .projection         = mat4f{ camera.getProjectionMatrix() },
+            // projection used for culling, with finite z-far
+            .cullingProjection  = mat4f{ camera.getCullingProjectionMatrix() },
+            // camera model matrix -- apply the world origin to it
+            .model              = model,
+            // camera view matrix
+            .view               = FCamera::getViewMatrix(model),
+            // near plane
+            .zn                 = camera.getNear(),
+            // far plane
+            .zf                 = camera.getCullingFar(),
+            // exposure
+            .ev100              = Exposure::ev100(camera),
+            // world origin transform, use only for debugging
+            .worldOrigin        = worldOrigin
+    };
+}
+
+Viewport FView::getEyeViewport(Viewport const& viewport, size_t eye) noexcept {
+    const uint32_t width = viewport.width / 2;
+    return Viewport{ viewport.left + int32_t(eye * width), viewport.bottom,
+            width, viewport.height };
+}
+
 void FView::prepare(FEngine& engine, driver::DriverApi& driver, ArenaScope& arena,
         Viewport const& viewport) noexcept {
-    JobSystem& js = engine.getJobSystem();
-
     /*
      * Prepare the scene -- this is where we gather all the objects added to the scene,
      * and in particular their world-space AABB.
@@ -390,18 +614,12 @@ void FView::prepare(FEngine& engine, driver::DriverApi& driver, ArenaScope& aren
     FScene* const scene = getScene();
 
     /*
-     * We apply a "world origin" to "everything" in order to implement the IBL rotation.
-     * The "world origin" could also be useful for other things, like keeping the origin
-     * close to the camera position to improve fp precision in the shader for large scenes.
+     * We apply a "world origin" to "everything". It's currently the identity, the IBL rotation
+     * is applied to the environment lookups instead (see FIndirectLight::setRotation()), but
+     * it could be useful for other things, like keeping the origin close to the camera
+     * position to improve fp precision in the shader for large scenes.
      */
-    mat4f worldOriginScene;
-    FIndirectLight const* const ibl = scene->getIndirectLight();
-    if (ibl) {
-        // the IBL transformation must be a rigid transform
-        mat3f rotation{ scene->getIndirectLight()->getRotation() };
-        // for a rigid-body transform, the inverse is the transpose
-        worldOriginScene = mat4f{ transpose(rotation) };
-    }
+    const mat4f worldOriginScene;
 
     /*
      * Calculate all camera parameters needed to render this View for this frame.
@@ -414,51 +632,168 @@ void FView::prepare(FEngine& engine, driver::DriverApi& driver, ArenaScope& aren
     //      worldOriginCamera = mViewingCamera ? mat4f{} : worldOriginScene
 
     const mat4f worldOriginCamera = worldOriginScene;
-    const mat4f model{ worldOriginCamera * camera->getModelMatrix() };
-    mViewingCameraInfo = CameraInfo{
-            // projection with infinite z-far
-            .projection         = mat4f{ camera->getProjectionMatrix() },
-            // projection used for culling, with finite z-far
-            .cullingProjection  = mat4f{ camera->getCullingProjectionMatrix() },
-            // camera model matrix -- apply the world origin to it
-            .model              = model,
-            // camera view matrix
-            .view               = FCamera::getViewMatrix(model),
-            // near plane
-            .zn                 = camera->getNear(),
-            // far plane
-            .zf                 = camera->getCullingFar(),
-            // exposure
-            .ev100              = Exposure::ev100(*camera),
-            // world origin transform, use only for debugging
-            .worldOrigin        = worldOriginCamera
-    };
+    mViewingCameraInfo = computeCameraInfo(*camera, worldOriginCamera);
     mCullingFrustum = FCamera::getFrustum(
             mCullingCamera->getCullingProjectionMatrix(),
             FCamera::getViewMatrix(worldOriginScene * mCullingCamera->getModelMatrix()));
 
+    if (isStereo()) {
+        mStereoCameraInfo = computeCameraInfo(*mStereoCamera, worldOriginCamera);
+
+        // both eyes are culled at once, against a frustum enclosing theirs
+        const mat4f leftModel{ worldOriginScene * mCullingCamera->getModelMatrix() };
+        const mat4f rightModel{ worldOriginScene * mStereoCamera->getModelMatrix() };
+        const Frustum right = FCamera::getFrustum(
+                mStereoCamera->getCullingProjectionMatrix(), FCamera::getViewMatrix(rightModel));
+        mCullingFrustum.setEnclosing(Frustum(mCullingFrustum), leftModel[3].xyz,
+                right, rightModel[3].xyz);
+    }
+
+    if (hasTemporalUpscaling()) {
+        mTemporalUpscaler.prepare(mViewingCameraInfo, viewport);
+    } else {
+        // don't blend with a stale history if the upscaling becomes active again
+        mTemporalUpscaler.clear();
+    }
+
+    /*
+     * When the culling source rendered the same scene from the same camera earlier in this
+     * frame, the scene still holds its results, which we reuse.
+     */
+    FView const* const source = mCullingSource;
+    const bool shared = source && source != this && source->mScene == scene &&
+            scene->getCullingView() == source && source->mCulledFrame == engine.getFrameCount() &&
+            source->mCullingCamera == mCullingCamera && source->mStereoCamera == mStereoCamera &&
+            source->mVisibleLayers == mVisibleLayers && source->mCulling == mCulling;
+
+    if (shared) {
+        // our results of the temporal culling would be stale when we cull again
+        mTemporalCuller.clear();
+
+        // the shadow maps are our own, but their casters were culled by the source
+        prepareShadowing(engine, driver, scene->getLightData(), viewport);
+
+        mVisibleRenderables = source->mVisibleRenderables;
+        mVisibleShadowCasters = source->mVisibleShadowCasters;
+        mPerRenderableUniforms = source->mPerRenderableUniforms;
+    } else {
+        prepareScene(engine, driver, viewport, worldOriginScene);
+    }
+
+    /*
+     * Prepare lighting -- this is where we update the lights UBOs, set-up the IBL,
+     * set-up the froxelization parameters.
+     * Relies on FScene::prepare() and prepareVisibleLights()
+     */
+
+    // in stereo, the lights are assigned to the froxels of the left eye
+    prepareLighting(engine, driver, arena, isStereo() ? getEyeViewport(viewport, 0) : viewport,
+            !shared);
+
+    /*
+     * Update driver state
+     */
+
+    float fraction = (engine.getTime().count() % 1000000000) / 1000000000.0f;
+    mPerFrameUb.setUniform(offsetof(FEngine::PerFrameUib, time), fraction);
+
+    // set uniforms and samplers
+    bindPerViewUniformsAndSamplers(driver);
+}
+
+void FView::prepareScene(FEngine& engine, driver::DriverApi& driver, Viewport const& viewport,
+        mat4f const& worldOriginScene) noexcept {
+    JobSystem& js = engine.getJobSystem();
+    FScene* const scene = mScene;
+
     /*
      * Gather all information needed to render this scene. Apply the world origin to all
      * objects in the scene.
      */
-    scene->prepare(worldOriginScene);
+    { // scope for the profiler
+        PhaseProfiler::Scope profile(PhaseProfiler::SCENE_PREPARE);
+        scene->prepare(worldOriginScene);
+    }
+
+    if (hasTemporalCulling()) {
+        const mat4f cullingModel{ worldOriginScene * mCullingCamera->getModelMatrix() };
+        mTemporalCuller.prepare(mCullingFrustum, cullingModel[3].xyz,
+                scene->getRenderableData().size());
+    } else {
+        // the results would be stale when the temporal culling becomes active again
+        mTemporalCuller.clear();
+    }
 
     /*
-     * Culling: as soon as possible we perform our camera-culling
-     * (this will set the VISIBLE_RENDERABLE bit)
+     * Shadowing: compute the shadow camera, this only depends on the scene's bounds, so it
+     * can be done before culling.
      */
 
     FScene::RenderableSoa& renderableData = scene->getRenderableData();
-    Slice<Culler::result_type> cullingMask = renderableData.slice<FScene::VISIBLE_MASK>();
-    std::fill(cullingMask.begin(), cullingMask.end(), 0); // TODO: can we avoid this fill?
-    prepareVisibleRenderables(js, renderableData);
+    prepareShadowing(engine, driver, scene->getLightData(), viewport);
 
     /*
-     * Shadowing: compute the shadow camera and cull shadow casters
-     * (this will set the VISIBLE_SHADOW_CASTER bit)
+     * Culling: the lights and the renderables are culled concurrently, with a single wait.
+     * Renderables are culled against the camera and the shadow camera in a single pass
+     * (this will set the VISIBLE_RENDERABLE and VISIBLE_SHADOW_CASTER bits)
      */
 
-    prepareShadowing(engine, driver, renderableData, scene->getLightData());
+    FLightManager& lcm = engine.getLightManager();
+    FScene::LightSoa& lightData = scene->getLightData();
+
+    // lights are processed by groups of Culler::MODULO, so each job's range can be culled
+    // independently.
+    auto cullLightsFunctor = [this, &lcm, &lightData](uint32_t index, uint32_t c) {
+        cullLights(lcm, lightData, index * Culler::MODULO, (index + c) * Culler::MODULO);
+    };
+
+    // With a hierarchy, only the lights of the leaves intersecting the frustum are culled, the
+    // other ones are invisible. Leaves start on a multiple of Culler::MODULO and only the last
+    // one can have a size which isn't, so they can be culled independently too.
+    Bvh const* const lightBvh = scene->getLightBvh();
+    std::vector<Range>& lightLeaves = mCullingLightLeaves;
+    if (lightBvh) {
+        PhaseProfiler::Scope profile(PhaseProfiler::CULLING);
+        lightLeaves.clear();
+        Frustum const& frustum = mCullingFrustum;
+        Culler::result_type* const visibleLights =
+                lightData.data<FScene::VISIBILITY>() + FScene::DIRECTIONAL_LIGHTS_COUNT;
+        lightBvh->traverse(
+                [&frustum](Box const& box) { return frustum.intersects(box); },
+                [&lightLeaves](uint32_t first, uint32_t count) {
+                    lightLeaves.push_back({ first, first + count });
+                },
+                [visibleLights](uint32_t first, uint32_t count) {
+                    std::fill_n(visibleLights + first, count, 0);
+                });
+    }
+    auto cullLightLeavesFunctor = [this, &lcm, &lightData, leaves = lightLeaves.data()]
+            (uint32_t index, uint32_t c) {
+        for (uint32_t i = index, e = index + c; i < e; i++) {
+            cullLights(lcm, lightData,
+                    leaves[i].first + FScene::DIRECTIONAL_LIGHTS_COUNT,
+                    leaves[i].last + FScene::DIRECTIONAL_LIGHTS_COUNT);
+        }
+    };
+
+    JobSystem::Job* cullingJob = js.createJob();
+    if (lightBvh) {
+        constexpr size_t leavesPerJob = std::max(size_t(1),
+                JOBS_PARALLEL_FOR_LIGHTS_GROUPS * Culler::MODULO / Bvh::LEAF_SIZE);
+        js.run(jobs::parallel_for(js, cullingJob, 0, uint32_t(lightLeaves.size()),
+                std::cref(cullLightLeavesFunctor), jobs::CountSplitter<leavesPerJob, 8>()));
+    } else {
+        js.run(jobs::parallel_for(js, cullingJob,
+                0, uint32_t(Culler::round(lightData.size()) / Culler::MODULO),
+                std::cref(cullLightsFunctor), jobs::CountSplitter<JOBS_PARALLEL_FOR_LIGHTS_GROUPS, 8>()));
+    }
+    prepareVisibleRenderables(js, cullingJob, renderableData);
+    js.runAndWait(cullingJob);
+
+    // only keep the visible lights
+    prepareVisibleLights(lightData);
+
+    Slice<Culler::result_type> cullingMask = renderableData.slice<FScene::VISIBLE_MASK>();
 
     /*
      * partition the array of renderable w.r.t their visibility:
@@ -473,7 +808,7 @@ void FView::prepare(FEngine& engine, driver::DriverApi& driver, ArenaScope& aren
     uint8_t const* layers = renderableData.data<FScene::LAYERS>();
     auto const* visibility = renderableData.data<FScene::VISIBILITY_STATE>();
     computeVisibilityMasks(getVisibleLayers(), layers, visibility, cullingMask.begin(),
-            renderableData.size());
+            renderableData.data<FScene::SPOT_SHADOW_MASK>(), renderableData.size());
 
     auto const beginRenderables = renderableData.begin();
     auto beginCasters = partition(beginRenderables, renderableData.end(), VISIBLE_RENDERABLE);
@@ -489,42 +824,58 @@ void FView::prepare(FEngine& engine, driver::DriverApi& driver, ArenaScope& aren
     // update those UBOs
     scene->updateUBOs(merged);
 
-    /*
-     * Light culling
-     *
-     * TODO: this could be done in parallel with culling above
-     */
+    // upload the renderables's UBOs
+    commitPerRenderableUniforms(engine, driver, renderableData, merged);
 
-    prepareVisibleLights(engine.getLightManager(), js, scene->getLightData());
+    // the scene now holds our results, the views using us as their culling source reuse them
+    scene->setCullingView(this);
+    mCulledFrame = engine.getFrameCount();
+}
 
-    /*
-     * Prepare lighting -- this is where we update the lights UBOs, set-up the IBL,
-     * set-up the froxelization parameters.
-     * Relies on FScene::prepare() and prepareVisibleLights()
-     */
+void FView::commitPerRenderableUniforms(FEngine& engine, driver::DriverApi& driver,
+        FScene::RenderableSoa const& renderableData, Range range) noexcept {
+    SYSTRACE_CALL();
 
-    prepareLighting(engine, driver, arena, viewport);
+    // the commands find the uniforms of a renderable from its index in the soa
+    assert(range.first == 0);
 
-    /*
-     * Update driver state
-     */
+    const size_t stride = mPerRenderableUniforms.stride;
+    const size_t size = range.last * stride;
+    if (UTILS_UNLIKELY(!size)) {
+        return;
+    }
 
-    float fraction = (engine.getTime().count() % 1000000000) / 1000000000.0f;
-    getUb().setUniform(offsetof(FEngine::PerViewUib, time), fraction);
+    // use the least recently used buffer, grow it if needed
+    mCurrentPerRenderableUbo = uint32_t(
+            (mCurrentPerRenderableUbo + 1) % FEngine::CONFIG_PER_RENDERABLE_UBO_COUNT);
+    PerRenderableUbo& ubo = mPerRenderableUbos[mCurrentPerRenderableUbo];
+    if (UTILS_UNLIKELY(ubo.capacity < size)) {
+        if (ubo.handle) {
+            driver.destroyUniformBuffer(ubo.handle);
+        }
+        // leave some room, so we don't reallocate every time a renderable becomes visible
+        ubo.capacity = std::max(size, ubo.capacity * 2);
+        ubo.handle = driver.createUniformBuffer(ubo.capacity);
+    }
 
-    // upload the renderables's dirty UBOs
+    // gather all the uniforms (and update the bones) then send them all at once
+    UniformBuffer uniforms(size);
     engine.getRenderableManager().prepare(driver,
-            renderableData.data<FScene::RENDERABLE_INSTANCE>(), merged);
+            renderableData.data<FScene::RENDERABLE_INSTANCE>(), range,
+            uniforms.invalidateUniforms(0, size), stride);
+    driver.updateUniformBuffer(ubo.handle, std::move(uniforms));
 
-    // set uniforms and samplers
-    bindPerViewUniformsAndSamplers(driver);
+    mPerRenderableUniforms.ubh = ubo.handle;
+    mPerRenderableUniforms.morphingUbh = renderableData.data<FScene::MORPHING_UBH>();
+    mPerRenderableUniforms.morphTargetsSbh = renderableData.data<FScene::MORPH_TARGETS_SBH>();
 }
 
 void FView::computeVisibilityMasks(
         uint8_t visibleLayers,
         uint8_t const* UTILS_RESTRICT layers,
         FRenderableManager::Visibility const* UTILS_RESTRICT visibility,
-        uint8_t* UTILS_RESTRICT visibleMask, size_t count) const {
+        uint8_t* UTILS_RESTRICT visibleMask,
+        uint8_t* UTILS_RESTRICT spotShadowMask, size_t count) const {
     // __restrict__ seems to only be taken into account as function parameters. This is very
     // important here, otherwise, this loop doesn't get vectorized.
     // This is vectorized 16x.
@@ -533,10 +884,16 @@ void FView::computeVisibilityMasks(
         Culler::result_type mask = visibleMask[i];
         FRenderableManager::Visibility v = visibility[i];
         bool inVisibleLayer = layers[i] & visibleLayers;
-        bool visRenderables   = (!v.culling || (mask & VISIBLE_RENDERABLE))    && inVisibleLayer;
-        bool visShadowCasters = (!v.culling || (mask & VISIBLE_SHADOW_CASTER)) && inVisibleLayer && v.castShadows;
+        Culler::result_type cascades = v.culling ? (mask & VISIBLE_SHADOW_CASCADES) : VISIBLE_SHADOW_CASCADES;
+        Culler::result_type spots = v.culling ? spotShadowMask[i] : Culler::result_type(0xFF);
+        bool visRenderables   = (!v.culling ||
+                (mask & (VISIBLE_RENDERABLE | OCCLUDED_RENDERABLE)) == VISIBLE_RENDERABLE) &&
+                inVisibleLayer;
+        bool visShadowCasters = (cascades | spots) && inVisibleLayer && v.castShadows;
         visibleMask[i] = Culler::result_type(visRenderables) |
-                         Culler::result_type(visShadowCasters << 1);
+                         Culler::result_type(visShadowCasters << 1) |
+                         Culler::result_type(visShadowCasters ? cascades : 0);
+        spotShadowMask[i] = Culler::result_type(visShadowCasters ? spots : 0);
     }
 }
 
@@ -546,16 +903,24 @@ UTILS_NOINLINE
         FScene::RenderableSoa::iterator end,
         uint8_t mask) noexcept {
     return std::partition(begin, end, [mask](auto it) {
-        return it.template get<FScene::VISIBLE_MASK>() == mask;
+        // the cascades of the shadow casters don't participate in the partitioning
+        return (it.template get<FScene::VISIBLE_MASK>() & VISIBLE_ALL) == mask;
     });
 }
 
-void FView::prepareCamera(const CameraInfo& camera, const Viewport& viewport) const noexcept {
+void FView::prepareCamera(const CameraInfo& camera, const Viewport& viewport,
+        float2 jitter) const noexcept {
     SYSTRACE_CALL();
 
     const mat4f viewFromWorld(camera.view);
     const mat4f worldFromView(camera.model);
-    const mat4f projectionMatrix(camera.projection);
+    mat4f projectionMatrix(camera.projection);
+    if (jitter.x != 0.0f || jitter.y != 0.0f) {
+        // translates the whole image by a fraction of a pixel
+        mat4f translation;
+        translation[3].xy = 2.0f * jitter / float2{ viewport.width, viewport.height };
+        projectionMatrix = translation * projectionMatrix;
+    }
 
     // In Vulkan, clip-space Z is [0,w] rather than [-w,+w] and Y is flipped.
     // See https://matthewwellings.com/blog/the-new-vulkan-coordinate-system/
@@ -587,6 +952,7 @@ void FView::prepareCamera(const CameraInfo& camera, const Viewport& viewport) co
 
 void FView::froxelize(FEngine& engine) const noexcept {
     SYSTRACE_CALL();
+    PhaseProfiler::Scope profile(PhaseProfiler::FROXELIZE);
 
     if (mHasDynamicLighting) {
         // froxelize lights
@@ -595,15 +961,9 @@ void FView::froxelize(FEngine& engine) const noexcept {
 }
 
 void FView::commitUniforms(driver::DriverApi& driverApi) const noexcept {
-    if (mPerViewUb.isDirty()) {
-        driverApi.updateUniformBuffer(mPerViewUbh, UniformBuffer(mPerViewUb));
-        mPerViewUb.clean();
-    }
-
-    if (mPerViewSb.isDirty()) {
-        driverApi.updateSamplerBuffer(mPerViewSbh, SamplerBuffer(mPerViewSb));
-        mPerViewSb.clean();
-    }
+    driverApi.commitUniforms(mPerViewUbh, mPerViewUb);
+    driverApi.commitUniforms(mPerFrameUbh, mPerFrameUb);
+    driverApi.commitSamplers(mPerViewSbh, mPerViewSb);
 }
 
 void FView::commitFroxels(driver::DriverApi& driverApi) const noexcept {
@@ -613,62 +973,345 @@ void FView::commitFroxels(driver::DriverApi& driverApi) const noexcept {
 }
 
 UTILS_NOINLINE
-void FView::prepareVisibleRenderables(JobSystem& js,
+void FView::prepareVisibleRenderables(JobSystem& js, JobSystem::Job* parent,
         FScene::RenderableSoa& renderableData) const noexcept {
     SYSTRACE_CALL();
-    if (UTILS_LIKELY(isCullingEnabled())) {
-        cullRenderables(js, renderableData, mCullingFrustum, VISIBLE_RENDERABLE_BIT);
+    PhaseProfiler::Scope profile(PhaseProfiler::CULLING);
+
+    // the culling kernels write all the bits of VISIBLE_MASK, so it doesn't need to be
+    // cleared first.
+    // the first cascade is culled along with the camera, the other shadow maps in a second pass.
+    // The TemporalCuller only culls against the camera, so all the cascades are in the second
+    // pass when it's used. So are they when the driver culls against the camera, in which case
+    // all the renderables are visible here.
+    const bool temporal = hasTemporalCulling();
+    const bool gpu = hasGpuCulling();
+    const bool shadowing = hasDirectionalShadowing();
+    if (shadowing) {
+        mShadowCullingFrustum = mDirectionalShadowMap.getCamera(0).getFrustum();
+    }
+
+    // Each pass is a job which launches its culling jobs as its own children, without waiting
+    // for them, and the next pass only runs once they're all done. This way no worker is ever
+    // blocked, and parent finishes with the last pass.
+    JobSystem::Job* passes[3];
+    size_t passCount = 0;
+    auto addPass = [&](auto pass) {
+        JobSystem::Job* job = js.createJob(parent, pass);
+        if (passCount) {
+            js.addDependency(passes[passCount - 1], job);
+        }
+        passes[passCount++] = job;
+    };
+
+    if (gpu) {
+        addPass([&renderableData](JobSystem&, JobSystem::Job*) {
+            std::fill(renderableData.begin<FScene::VISIBLE_MASK>(),
+                      renderableData.end<FScene::VISIBLE_MASK>(), VISIBLE_RENDERABLE);
+        });
+    } else if (UTILS_LIKELY(isCullingEnabled())) {
+        addPass([this, &renderableData, shadowing, temporal](JobSystem& js, JobSystem::Job* job) {
+            Bvh const* const bvh = mScene->getBvh();
+            if (bvh) {
+                cullRenderables(js, job, renderableData, *bvh, mCullingFrustum,
+                        shadowing && !temporal ? &mShadowCullingFrustum : nullptr);
+            } else if (temporal) {
+                cullRenderablesTemporally(js, job, renderableData);
+            } else if (shadowing) {
+                cullRenderables(js, job, renderableData, mCullingFrustum, mShadowCullingFrustum);
+            } else {
+                cullRenderables(js, job, renderableData, mCullingFrustum, VISIBLE_RENDERABLE_BIT);
+            }
+        });
     } else {
-        std::fill(renderableData.begin<FScene::VISIBLE_MASK>(),
-                  renderableData.end<FScene::VISIBLE_MASK>(), VISIBLE_RENDERABLE);
+        addPass([this, &renderableData, shadowing](JobSystem& js, JobSystem::Job*) {
+            PhaseProfiler::Scope profile(PhaseProfiler::CULLING);
+            if (shadowing) {
+                // this is a debugging path, there is no need to run it in parallel
+                Culler::intersects(renderableData.data<FScene::VISIBLE_MASK>(),
+                        mShadowCullingFrustum,
+                        renderableData.data<FScene::WORLD_AABB_CENTER>(),
+                        renderableData.data<FScene::WORLD_AABB_EXTENT>(),
+                        renderableData.size(), VISIBLE_SHADOW_CASCADE_BIT);
+                for (auto& mask : renderableData.slice<FScene::VISIBLE_MASK>()) {
+                    mask |= VISIBLE_RENDERABLE;
+                }
+            } else {
+                std::fill(renderableData.begin<FScene::VISIBLE_MASK>(),
+                          renderableData.end<FScene::VISIBLE_MASK>(), VISIBLE_RENDERABLE);
+            }
+        });
+    }
+
+    if ((shadowing && (mDirectionalShadowMap.getCascadeCount() > 1 || temporal || gpu)) ||
+            mSpotShadowCount) {
+        addPass([this, &renderableData](JobSystem& js, JobSystem::Job* job) {
+            cullShadowMaps(js, job, renderableData);
+        });
+    }
+
+    // occlusion culling only applies to the renderables visible from the camera, it doesn't
+    // affect the shadow casters.
+    if (isCullingEnabled() && hasOcclusionCulling() && mDepthPyramid.isValid()) {
+        addPass([this, &renderableData](JobSystem& js, JobSystem::Job* job) {
+            cullOccludedRenderables(js, job, renderableData);
+        });
+    }
+
+    // the passes only start once all the dependencies are set
+    for (size_t i = 0; i < passCount; i++) {
+        js.run(passes[i]);
     }
 }
 
-UTILS_NOINLINE
-void FView::prepareVisibleShadowCasters(JobSystem& js,
-        FScene::RenderableSoa& renderableData, Frustum const& lightFrustum) const noexcept {
+void FView::cullOccludedRenderables(JobSystem& js, JobSystem::Job* parent,
+        FScene::RenderableSoa& renderableData) const noexcept {
     SYSTRACE_CALL();
-    cullRenderables(js, renderableData, lightFrustum, VISIBLE_SHADOW_CASTER_BIT);
+
+    DepthPyramid const& depthPyramid = mDepthPyramid;
+    auto functor = [&renderableData, &depthPyramid](uint32_t index, uint32_t c) {
+        PhaseProfiler::Scope profile(PhaseProfiler::CULLING);
+        depthPyramid.cull(renderableData.data<FScene::VISIBLE_MASK>() + index,
+                renderableData.data<FScene::WORLD_AABB_CENTER>() + index,
+                renderableData.data<FScene::WORLD_AABB_EXTENT>() + index, c,
+                VISIBLE_RENDERABLE, OCCLUDED_RENDERABLE_BIT);
+    };
+
+    js.run(jobs::parallel_for(js, parent, 0, (uint32_t)renderableData.size(),
+            functor, jobs::CountSplitter<Culler::MODULO * Culler::MIN_LOOP_COUNT_HINT, 8>()));
 }
 
-void FView::cullRenderables(JobSystem& js,
-        FScene::RenderableSoa& renderableData, Frustum const& frustum, size_t bit) noexcept {
+void FView::setOcclusionCullingEnabled(bool enabled) noexcept {
+    if (!enabled) {
+        // the pyramid would be stale when occlusion culling is enabled again
+        mDepthPyramid.clear();
+    }
+    mOcclusionCullingEnabled = enabled;
+}
 
-    float3 const* worldAABBCenter = renderableData.data<FScene::WORLD_AABB_CENTER>();
-    float3 const* worldAABBExtent = renderableData.data<FScene::WORLD_AABB_EXTENT>();
-    uint8_t     * visibleArray    = renderableData.data<FScene::VISIBLE_MASK>();
+void FView::setTemporalCullingEnabled(bool enabled) noexcept {
+    if (!enabled) {
+        // the results would be stale when the temporal culling is enabled again
+        mTemporalCuller.clear();
+    }
+    mTemporalCullingEnabled = enabled;
+}
+
+void FView::setTemporalUpscalingEnabled(bool enabled) noexcept {
+    if (!enabled) {
+        // the history would be stale when the upscaling is enabled again
+        mTemporalUpscaler.clear();
+    }
+    mTemporalUpscalingEnabled = enabled;
+}
+
+void FView::updateDepthPyramid(RenderTargetPool::Target const* colorTarget,
+        Viewport const& viewport) noexcept {
+    CameraInfo const& camera = mViewingCameraInfo;
+    mDepthPyramid.update(colorTarget, viewport, camera.projection * camera.view);
+}
+
+void FView::cullShadowMaps(JobSystem& js, JobSystem::Job* parent,
+        FScene::RenderableSoa& renderableData) const noexcept {
+    SYSTRACE_CALL();
+
+    uint8_t* visibleArray    = renderableData.data<FScene::VISIBLE_MASK>();
+    uint8_t* spotShadowArray = renderableData.data<FScene::SPOT_SHADOW_MASK>();
+
+    // the first cascade is already culled, unless the camera was culled by the TemporalCuller
+    // or isn't culled here
+    ShadowFrustum* const frustums = mShadowCullingFrustums;
+    size_t count = 0;
+    ShadowMap const& shadowMap = mDirectionalShadowMap;
+    if (hasDirectionalShadowing()) {
+        const size_t first = (hasTemporalCulling() || hasGpuCulling()) ? 0 : 1;
+        for (size_t i = first, c = shadowMap.getCascadeCount(); i < c; i++) {
+            if (shadowMap.hasVisibleShadows(i)) {
+                frustums[count++] = { shadowMap.getCamera(i).getFrustum(),
+                        visibleArray, VISIBLE_SHADOW_CASCADE_BIT + i };
+            }
+        }
+    }
+    for (size_t i = 0; i < mSpotShadowCount; i++) {
+        if (mSpotShadowMaps[i]->hasVisibleShadows(0)) {
+            frustums[count++] = { mSpotShadowMaps[i]->getCamera(0).getFrustum(),
+                    spotShadowArray, i };
+        }
+    }
+
+    // renderables are processed by groups of Culler::MODULO, so the culling kernels never
+    // touch the results of another job.
+    auto functor = [&renderableData, frustums, count](uint32_t index, uint32_t c) {
+        PhaseProfiler::Scope profile(PhaseProfiler::CULLING);
+        float3 const* worldAABBCenter = renderableData.data<FScene::WORLD_AABB_CENTER>();
+        float3 const* worldAABBExtent = renderableData.data<FScene::WORLD_AABB_EXTENT>();
+        constexpr uint32_t BATCH_SIZE = Culler::MODULO * Culler::MIN_LOOP_COUNT_HINT;
+        Culler::result_type results[BATCH_SIZE];
+        for (uint32_t i = index * Culler::MODULO, e = (index + c) * Culler::MODULO; i < e; i += BATCH_SIZE) {
+            const uint32_t n = std::min(BATCH_SIZE, e - i);
+            for (size_t j = 0; j < count; j++) {
+                Culler::intersects(results, frustums[j].frustum,
+                        worldAABBCenter + i, worldAABBExtent + i, n, frustums[j].bit);
+                uint8_t* const UTILS_RESTRICT masks = frustums[j].results + i;
+                for (uint32_t k = 0; k < n; k++) {
+                    masks[k] |= results[k];
+                }
+            }
+        }
+    };
+
+    js.run(jobs::parallel_for(js, parent,
+            0, uint32_t(Culler::round(renderableData.size()) / Culler::MODULO),
+            functor, jobs::CountSplitter<Culler::MIN_LOOP_COUNT_HINT, 8>()));
+}
+
+uint32_t FView::getShadowCascadeVisibleMask(size_t cascade) noexcept {
+    return 1u << (VISIBLE_SHADOW_CASCADE_BIT + cascade);
+}
+
+uint32_t FView::getSpotShadowVisibleMask(size_t index) noexcept {
+    return 1u << (8u + index);
+}
+
+void FView::cullRenderables(JobSystem& js, JobSystem::Job* parent,
+        FScene::RenderableSoa& renderableData, Frustum const& frustum, size_t bit) noexcept {
 
     // culling job (this runs on multiple threads)
-    auto functor = [&frustum, worldAABBCenter, worldAABBExtent, visibleArray, bit]
-            (uint32_t index, uint32_t c) {
+    auto functor = [&renderableData, &frustum, bit](uint32_t index, uint32_t c) {
+        PhaseProfiler::Scope profile(PhaseProfiler::CULLING);
         Culler::intersects(
-                visibleArray + index,
+                renderableData.data<FScene::VISIBLE_MASK>() + index,
                 frustum,
-                worldAABBCenter + index,
-                worldAABBExtent + index, c, bit);
+                renderableData.data<FScene::WORLD_AABB_CENTER>() + index,
+                renderableData.data<FScene::WORLD_AABB_EXTENT>() + index, c, bit);
+    };
+
+    // launch the computation on multiple threads
+    js.run(jobs::parallel_for(js, parent, 0, (uint32_t)renderableData.size(),
+            functor, jobs::CountSplitter<Culler::MODULO * Culler::MIN_LOOP_COUNT_HINT, 8>()));
+}
+
+void FView::cullRenderables(JobSystem& js, JobSystem::Job* parent,
+        FScene::RenderableSoa& renderableData,
+        Frustum const& cameraFrustum, Frustum const& lightFrustum) noexcept {
+
+    // culling job (this runs on multiple threads)
+    auto functor = [&renderableData, &cameraFrustum, &lightFrustum](uint32_t index, uint32_t c) {
+        PhaseProfiler::Scope profile(PhaseProfiler::CULLING);
+        Culler::intersects(
+                renderableData.data<FScene::VISIBLE_MASK>() + index,
+                cameraFrustum, lightFrustum,
+                renderableData.data<FScene::WORLD_AABB_CENTER>() + index,
+                renderableData.data<FScene::WORLD_AABB_EXTENT>() + index, c,
+                VISIBLE_RENDERABLE_BIT, VISIBLE_SHADOW_CASCADE_BIT);
+    };
+
+    // launch the computation on multiple threads
+    js.run(jobs::parallel_for(js, parent, 0, (uint32_t)renderableData.size(),
+            functor, jobs::CountSplitter<Culler::MODULO * Culler::MIN_LOOP_COUNT_HINT, 8>()));
+}
+
+void FView::cullRenderables(JobSystem& js, JobSystem::Job* parent,
+        FScene::RenderableSoa& renderableData, Bvh const& bvh,
+        Frustum const& cameraFrustum, Frustum const* lightFrustum) const noexcept {
+    SYSTRACE_CALL();
+    PhaseProfiler::Scope profile(PhaseProfiler::CULLING);
+
+    uint8_t* visibleArray = renderableData.data<FScene::VISIBLE_MASK>();
+    TemporalCuller* const temporalCuller = hasTemporalCulling() ? &mTemporalCuller : nullptr;
+
+    // walk the hierarchy to find the leaves that need to go through the culling kernels,
+    // renderables in rejected nodes are all invisible.
+    std::vector<Range>& leaves = mCullingLeaves;
+    leaves.clear();
+    bvh.traverse(
+            [&cameraFrustum, lightFrustum](Box const& box) {
+                return cameraFrustum.intersects(box) ||
+                       (lightFrustum && lightFrustum->intersects(box));
+            },
+            [&leaves](uint32_t first, uint32_t count) {
+                leaves.push_back({ first, first + count });
+            },
+            [visibleArray, temporalCuller](uint32_t first, uint32_t count) {
+                std::fill_n(visibleArray + first, count, 0);
+                if (temporalCuller) {
+                    // their results won't follow the motion of the frustum this frame
+                    temporalCuller->invalidate(first, count);
+                }
+            });
+
+    // culling job (this runs on multiple threads), leaves start on a multiple of
+    // Culler::MODULO, so they can be processed independently.
+    auto functor = [this, &renderableData, &cameraFrustum, lightFrustum]
+            (uint32_t index, uint32_t c) {
+        PhaseProfiler::Scope profile(PhaseProfiler::CULLING);
+        Range const* const ranges = mCullingLeaves.data();
+        float3 const* worldAABBCenter = renderableData.data<FScene::WORLD_AABB_CENTER>();
+        float3 const* worldAABBExtent = renderableData.data<FScene::WORLD_AABB_EXTENT>();
+        uint8_t     * visibleArray    = renderableData.data<FScene::VISIBLE_MASK>();
+        const bool temporal = hasTemporalCulling();
+        for (uint32_t i = index, e = index + c; i < e; i++) {
+            const uint32_t first = ranges[i].first;
+            if (temporal) {
+                mTemporalCuller.cull(visibleArray, worldAABBCenter, worldAABBExtent,
+                        mScene->getRenderableVersions(), first, ranges[i].size(),
+                        VISIBLE_RENDERABLE_BIT);
+            } else if (lightFrustum) {
+                Culler::intersects(visibleArray + first, cameraFrustum, *lightFrustum,
+                        worldAABBCenter + first, worldAABBExtent + first, ranges[i].size(),
+                        VISIBLE_RENDERABLE_BIT, VISIBLE_SHADOW_CASCADE_BIT);
+            } else {
+                Culler::intersects(visibleArray + first, cameraFrustum,
+                        worldAABBCenter + first, worldAABBExtent + first, ranges[i].size(),
+                        VISIBLE_RENDERABLE_BIT);
+            }
+        }
     };
 
     // launch the computation on multiple threads
-    auto job = jobs::parallel_for(js, nullptr, 0, (uint32_t)renderableData.size(),
-            std::ref(functor), jobs::CountSplitter<Culler::MODULO * Culler::MIN_LOOP_COUNT_HINT, 8>());
-    js.runAndWait(job);
+    constexpr size_t leavesPerJob = Culler::MODULO * Culler::MIN_LOOP_COUNT_HINT * 8 / Bvh::LEAF_SIZE;
+    js.run(jobs::parallel_for(js, parent, 0, (uint32_t)leaves.size(),
+            functor, jobs::CountSplitter<leavesPerJob, 8>()));
 }
 
-void FView::prepareVisibleLights(FLightManager& lcm, utils::JobSystem&, FScene::LightSoa& lightData) const {
+void FView::cullRenderablesTemporally(JobSystem& js, JobSystem::Job* parent,
+        FScene::RenderableSoa& renderableData) const noexcept {
+    TemporalCuller& temporalCuller = mTemporalCuller;
+    uint32_t const* const versions = mScene->getRenderableVersions();
+
+    // culling job (this runs on multiple threads)
+    auto functor = [&renderableData, &temporalCuller, versions](uint32_t index, uint32_t c) {
+        PhaseProfiler::Scope profile(PhaseProfiler::CULLING);
+        temporalCuller.cull(renderableData.data<FScene::VISIBLE_MASK>(),
+                renderableData.data<FScene::WORLD_AABB_CENTER>(),
+                renderableData.data<FScene::WORLD_AABB_EXTENT>(), versions,
+                index, c, VISIBLE_RENDERABLE_BIT);
+    };
+
+    // launch the computation on multiple threads
+    js.run(jobs::parallel_for(js, parent, 0, (uint32_t)renderableData.size(),
+            functor, jobs::CountSplitter<Culler::MODULO * Culler::MIN_LOOP_COUNT_HINT, 8>()));
+}
+
+void FView::cullLights(FLightManager const& lcm, FScene::LightSoa& lightData,
+        size_t first, size_t last) const noexcept {
+    PhaseProfiler::Scope profile(PhaseProfiler::CULLING);
 
     auto const* UTILS_RESTRICT sphereArray     = lightData.data<FScene::POSITION_RADIUS>();
     auto const* UTILS_RESTRICT directions      = lightData.data<FScene::DIRECTION>();
     auto const* UTILS_RESTRICT instanceArray   = lightData.data<FScene::LIGHT_INSTANCE>();
     auto      * UTILS_RESTRICT visibleArray    = lightData.data<FScene::VISIBILITY>();
 
+    // 'first' is a multiple of Culler::MODULO, and the capacity of lightData is rounded up
+    // to a multiple of Culler::MODULO, so we can cull the whole range at once
     Frustum const& frustum = mCullingFrustum;
-    Culler::intersects(visibleArray, frustum, sphereArray, lightData.size());
+    Culler::intersects(visibleArray + first, frustum, sphereArray + first, last - first);
 
     const float4* const UTILS_RESTRICT planes = frustum.getNormalizedPlanes();
-    // the directional light is considered visible
-    size_t visibleLightCount = FScene::DIRECTIONAL_LIGHTS_COUNT;
-    // skip directional light
-    for (size_t i = FScene::DIRECTIONAL_LIGHTS_COUNT; i < lightData.size(); i++) {
+    // skip directional light, it's considered visible
+    first = std::max(first, size_t(FScene::DIRECTIONAL_LIGHTS_COUNT));
+    last = std::min(last, lightData.size());
+    for (size_t i = first; i < last; i++) {
         FLightManager::Instance li = instanceArray[i];
         if (visibleArray[i]) {
             if (!lcm.isLightCaster(li)) {
@@ -695,29 +1338,64 @@ void FView::prepareVisibleLights(FLightManager& lcm, utils::JobSystem&, FScene::
                     continue;
                 }
             }
-            visibleLightCount++;
         }
     }
+}
 
-    // Partition array such that all visible lights appear first
-    UTILS_UNUSED_IN_RELEASE auto last =
-            std::partition(lightData.begin() + FScene::DIRECTIONAL_LIGHTS_COUNT, lightData.end(),
-                    [](auto const& it) {
-                        return it.template get<FScene::VISIBILITY>() != 0;
-                    });
-    assert(visibleLightCount == size_t(last - lightData.begin()));
+void FView::prepareVisibleLights(FScene::LightSoa& lightData) const noexcept {
+    PhaseProfiler::Scope profile(PhaseProfiler::CULLING);
 
+    // Partition array such that all visible lights appear first, the directional light is
+    // considered visible
+    auto last = std::partition(
+            lightData.begin() + FScene::DIRECTIONAL_LIGHTS_COUNT, lightData.end(),
+            [](auto const& it) {
+                return it.template get<FScene::VISIBILITY>() != 0;
+            });
+
+    const size_t visibleLightCount = size_t(last - lightData.begin());
     lightData.resize(visibleLightCount);
     mHasDynamicLighting = visibleLightCount > FScene::DIRECTIONAL_LIGHTS_COUNT;
 }
 
-void FView::updatePrimitivesLod(FEngine& engine, const CameraInfo&,
+void FView::updatePrimitivesLod(FEngine& engine, const CameraInfo& camera,
         FScene::RenderableSoa& renderableData, Range visibles) noexcept {
     FRenderableManager const& rcm = engine.getRenderableManager();
+
+    // The height on screen of a bounding sphere of radius r at distance z from the camera, as a
+    // fraction of the viewport's height, is r * p[1][1] / z (or r * p[1][1] with an orthographic
+    // projection). This ignores the sphere's offset from the view axis, which is good enough to
+    // pick a level of detail, and to estimate the fraction of the viewport the renderable covers
+    // (SCREEN_COVERAGE), which decides which renderables are drawn in an automatic depth
+    // pre-pass.
+    mat4f const& p = camera.projection;
+    const bool perspective = p[2][3] != 0;
+    mat4f const& v = camera.view;
+    float4 const viewRowZ{ v[0][2], v[1][2], v[2][2], v[3][2] };
+    const float aspect = p[0][0] / p[1][1];
+
     for (uint32_t index : visibles) {
-        uint8_t level = 0; // TODO: pick the proper level of detail
         auto ri = renderableData.elementAt<FScene::RENDERABLE_INSTANCE>(index);
+        float3 const& center = renderableData.elementAt<FScene::WORLD_AABB_CENTER>(index);
+        float3 const& extent = renderableData.elementAt<FScene::WORLD_AABB_EXTENT>(index);
+        const float radius = length(extent);
+        const float z = -dot(viewRowZ, float4{ center, 1 });
+
+        // the whole viewport is covered when the camera is inside the bounding sphere
+        const bool inside = perspective && z <= radius;
+        const float screenSize = radius * p[1][1] / (perspective ? z : 1.0f);
+
+        // use the most detailed level when the camera is inside the bounding sphere
+        uint8_t level = 0;
+        if (UTILS_UNLIKELY(rcm.getLevelCount(ri) > 1) && !inside) {
+            level = rcm.getLevelOfDetail(ri, screenSize);
+        }
         renderableData.elementAt<FScene::PRIMITIVES>(index) = rcm.getRenderPrimitives(ri, level);
+
+        // the area of the projected disk (an ellipse of half-axes screenSize * aspect and
+        // screenSize, in NDC) over the area of the viewport (4, in NDC)
+        renderableData.elementAt<FScene::SCREEN_COVERAGE>(index) = inside ? 1.0f :
+                std::min(1.0f, float(M_PI) * screenSize * screenSize * aspect * 0.25f);
     }
 }
 
@@ -746,6 +1424,21 @@ Camera& View::getCamera() noexcept {
     return upcast(this)->getCameraUser();
 }
 
+void View::setStereoCamera(Camera* rightEye) noexcept {
+    upcast(this)->setStereoCamera(upcast(rightEye));
+}
+
+Camera const* View::getStereoCamera() const noexcept {
+    return upcast(this)->getStereoCamera();
+}
+
+void View::setCullingSource(View const* view) noexcept {
+    upcast(this)->setCullingSource(upcast(view));
+}
+
+View const* View::getCullingSource() const noexcept {
+    return upcast(this)->getCullingSource();
+}
 
 void View::setViewport(Viewport const& viewport) noexcept {
     upcast(this)->setViewport(viewport);
@@ -800,6 +1493,62 @@ void View::setShadowsEnabled(bool enabled) noexcept {
     upcast(this)->setShadowsEnabled(enabled);
 }
 
+void View::setShadowCachingEnabled(bool enabled) noexcept {
+    upcast(this)->setShadowCachingEnabled(enabled);
+}
+
+void View::setShadowAutoSizingEnabled(bool enabled) noexcept {
+    upcast(this)->setShadowAutoSizingEnabled(enabled);
+}
+
+void View::setShadowType(ShadowType type) noexcept {
+    upcast(this)->setShadowType(type);
+}
+
+View::ShadowType View::getShadowType() const noexcept {
+    return upcast(this)->getShadowType();
+}
+
+void View::setOcclusionCullingEnabled(bool enabled) noexcept {
+    upcast(this)->setOcclusionCullingEnabled(enabled);
+}
+
+bool View::isOcclusionCullingEnabled() const noexcept {
+    return upcast(this)->isOcclusionCullingEnabled();
+}
+
+void View::setTemporalCullingEnabled(bool enabled) noexcept {
+    upcast(this)->setTemporalCullingEnabled(enabled);
+}
+
+bool View::isTemporalCullingEnabled() const noexcept {
+    return upcast(this)->isTemporalCullingEnabled();
+}
+
+void View::setGpuCullingEnabled(bool enabled) noexcept {
+    upcast(this)->setGpuCullingEnabled(enabled);
+}
+
+bool View::isGpuCullingEnabled() const noexcept {
+    return upcast(this)->isGpuCullingEnabled();
+}
+
+void View::setTemporalUpscalingEnabled(bool enabled) noexcept {
+    upcast(this)->setTemporalUpscalingEnabled(enabled);
+}
+
+bool View::isTemporalUpscalingEnabled() const noexcept {
+    return upcast(this)->isTemporalUpscalingEnabled();
+}
+
+void View::setOrderIndependentTransparencyEnabled(bool enabled) noexcept {
+    upcast(this)->setOrderIndependentTransparencyEnabled(enabled);
+}
+
+bool View::isOrderIndependentTransparencyEnabled() const noexcept {
+    return upcast(this)->isOrderIndependentTransparencyEnabled();
+}
+
 void View::setRenderTarget(TargetBufferFlags discard) noexcept {
     upcast(this)->setRenderTarget(discard);
 }
@@ -836,9 +1585,21 @@ void View::setDepthPrepass(View::DepthPrepass prepass) noexcept {
     upcast(this)->setDepthPrepass(prepass);
 }
 
+void View::setSortOrder(View::SortOrder order) noexcept {
+    upcast(this)->setSortOrder(order);
+}
+
 void View::setDynamicLightingOptions(float zLightNear, float zLightFar) noexcept {
     upcast(this)->setDynamicLightingOptions(zLightNear, zLightFar);
 }
 
+void View::setDynamicLightingLimits(uint32_t maxFroxelCount, uint32_t maxLightCount) noexcept {
+    upcast(this)->setDynamicLightingLimits(maxFroxelCount, maxLightCount);
+}
+
+void View::setLightBinning(bool enabled) noexcept {
+    upcast(this)->setLightBinning(enabled);
+}
+
 
 } // namespace filament
@@ -48,6 +48,10 @@ public:
     // free-up all resources
     void terminate() noexcept;
 
+    size_t getMemorySize() const noexcept {
+        return mManager.getMemorySize();
+    }
+
     void gc(utils::EntityManager& em) noexcept;
 
     /*
@@ -173,6 +173,8 @@ void FLightManager::create(const FLightManager::Builder& builder, utils::Entity
         shadowParams.shadowFar = std::max(builder->mShadowOptions.shadowFar, 0.0f);
         shadowParams.shadowNearHint = std::max(builder->mShadowOptions.shadowNearHint, 0.0f);
         shadowParams.shadowFarHint = std::max(builder->mShadowOptions.shadowFarHint, 0.0f);
+        shadowParams.shadowCascades = clamp(uint32_t(builder->mShadowOptions.shadowCascades),
+                1u, uint32_t(CONFIG_MAX_SHADOW_CASCADES));
 
         // set default values by calling the setters
         setLocalPosition(i, builder->mPosition);
@@ -188,6 +190,9 @@ void FLightManager::create(const FLightManager::Builder& builder, utils::Entity
         setSunHaloSize(i, builder->mSunHaloSize);
         setSunHaloFalloff(i, builder->mSunHaloFalloff);
     }
+
+    // scenes containing this entity must pick-up the new component
+    mChangeJournal.invalidate();
 }
 
 void FLightManager::prepare(driver::DriverApi& driver) const noexcept {
@@ -198,6 +203,7 @@ void FLightManager::destroy(utils::Entity e) noexcept {
     if (i) {
         auto& manager = mManager;
         manager.removeComponent(e);
+        mChangeJournal.invalidate();
     }
 }
 
@@ -212,6 +218,7 @@ void FLightManager::terminate() noexcept {
             Instance ci = manager.end() - 1;
             manager.removeComponent(manager.getEntity(ci));
         }
+        mChangeJournal.invalidate();
     }
 }
 
@@ -219,12 +226,14 @@ void FLightManager::setLocalPosition(Instance i, const math::float3& position) n
     assert(i);
     auto& manager = mManager;
     manager[i].position = position;
+    mChangeJournal.record(manager.getEntity(i));
 }
 
 void FLightManager::setLocalDirection(Instance i, float3 direction) noexcept {
     assert(i);
     auto& manager = mManager;
     manager[i].direction = direction;
+    mChangeJournal.record(manager.getEntity(i));
 }
 
 void FLightManager::setColor(Instance i, const LinearColor& color) noexcept {
@@ -278,6 +287,7 @@ void FLightManager::setFalloff(Instance i, float falloff) noexcept {
         SpotParams& spotParams = manager[i].spotParams;
         manager[i].squaredFallOffInv = sqFalloff ? (1 / sqFalloff) : 0;
         spotParams.radius = falloff;
+        mChangeJournal.record(manager.getEntity(i));
     }
 }
 
@@ -301,6 +311,8 @@ void FLightManager::setSpotLightCone(Instance i, float inner, float outer) noexc
         spotParams.cosOuterSquared = cosOuterSquared;
         spotParams.sinInverse = 1 / std::sqrt(1 - cosOuterSquared);
         spotParams.scaleOffset = { scale, offset };
+        // the scene caches the cone for the froxelizer
+        mChangeJournal.record(manager.getEntity(i));
 
         // we need to recompute the luminous intensity
         Type type = getLightType(i).type;
@@ -313,6 +325,34 @@ void FLightManager::setSpotLightCone(Instance i, float inner, float outer) noexc
     }
 }
 
+void FLightManager::setLocalPositions(Instance const* instances, float3 const* positions,
+        size_t count) noexcept {
+    auto& manager = mManager;
+    for (size_t k = 0; k < count; k++) {
+        Instance i = instances[k];
+        assert(i);
+        manager[i].position = positions[k];
+        mChangeJournal.record(manager.getEntity(i));
+    }
+}
+
+void FLightManager::setColors(Instance const* instances, LinearColor const* colors,
+        size_t count) noexcept {
+    auto& manager = mManager;
+    for (size_t k = 0; k < count; k++) {
+        if (instances[k]) {
+            manager[instances[k]].color = colors[k];
+        }
+    }
+}
+
+void FLightManager::setIntensities(Instance const* instances, float const* intensities,
+        size_t count) noexcept {
+    for (size_t k = 0; k < count; k++) {
+        setIntensity(instances[k], intensities[k]);
+    }
+}
+
 void FLightManager::setSunAngularRadius(Instance i, float angularRadius) noexcept {
     auto& manager = mManager;
     if (i && isSunLight(i)) {
@@ -388,6 +428,21 @@ float LightManager::getIntensity(Instance i) const noexcept {
     return upcast(this)->getIntensity(i);
 }
 
+void LightManager::setPositions(Instance const* instances, float3 const* positions,
+        size_t count) noexcept {
+    upcast(this)->setLocalPositions(instances, positions, count);
+}
+
+void LightManager::setColors(Instance const* instances, LinearColor const* colors,
+        size_t count) noexcept {
+    upcast(this)->setColors(instances, colors, count);
+}
+
+void LightManager::setIntensities(Instance const* instances, float const* intensities,
+        size_t count) noexcept {
+    upcast(this)->setIntensities(instances, intensities, count);
+}
+
 void LightManager::setFalloff(Instance i, float radius) noexcept {
     upcast(this)->setFalloff(i, radius);
 }
@@ -19,6 +19,8 @@
 
 #include "upcast.h"
 
+#include "details/ChangeJournal.h"
+
 #include "driver/DriverApiForward.h"
 
 #include <filament/LightManager.h>
@@ -59,10 +61,22 @@ public:
 
     void prepare(driver::DriverApi& driver) const noexcept;
 
+    size_t getMemorySize() const noexcept {
+        return mManager.getMemorySize();
+    }
+
     void gc(utils::EntityManager& em) noexcept {
+        size_t count = mManager.getComponentCount();
         mManager.gc(em);
+        if (count != mManager.getComponentCount()) {
+            mChangeJournal.invalidate();
+        }
     }
 
+    // entities whose local position, direction or falloff changed
+    ChangeJournal const& getChangeJournal() const noexcept { return mChangeJournal; }
+    void trimChangeJournal() noexcept { mChangeJournal.trim(); }
+
     struct LightType {
         Type type : 3;
         uint8_t shadowMapBits : 4;
@@ -84,6 +98,7 @@ public:
         float shadowFar;
         float shadowNearHint;
         float shadowFarHint;
+        uint32_t shadowCascades;
     };
 
     UTILS_NOINLINE void setLocalPosition(Instance i, const math::float3& position) noexcept;
@@ -96,6 +111,13 @@ public:
     UTILS_NOINLINE void setSunHaloSize(Instance i, float haloSize) noexcept;
     UTILS_NOINLINE void setSunHaloFalloff(Instance i, float haloFalloff) noexcept;
 
+    // batch versions of the setters above, instances[k] is updated with values[k]
+    void setLocalPositions(Instance const* instances, math::float3 const* positions,
+            size_t count) noexcept;
+    void setColors(Instance const* instances, LinearColor const* colors, size_t count) noexcept;
+    void setIntensities(Instance const* instances, float const* intensities,
+            size_t count) noexcept;
+
     constexpr LightType const& getLightType(Instance i) const noexcept {
         return mManager[i].lightType;
     }
@@ -154,6 +176,10 @@ public:
         return getShadowParams(i).shadowFar;
     }
 
+    constexpr uint32_t getShadowCascades(Instance i) const noexcept {
+        return getShadowParams(i).shadowCascades;
+    }
+
     constexpr const math::float3& getColor(Instance i) const noexcept {
         return mManager[i].color;
     }
@@ -219,12 +245,12 @@ private:
         FALLOFF,
     };
 
-    using Base = utils::SingleInstanceComponentManager<  // 120 bytes
+    using Base = utils::ChunkedSingleInstanceComponentManager<  // 120 bytes
             LightType,      //  1
             math::float3,   // 12
             math::float3,   // 12
             math::float3,   // 12
-            ShadowParams,   // 12
+            ShadowParams,   // 24
             SpotParams,     // 24
             float,          //  4
             float,          //  4
@@ -269,6 +295,7 @@ private:
 
     Sim mManager;
     FEngine& mEngine;
+    ChangeJournal mChangeJournal;
 };
 
 FILAMENT_UPCAST(LightManager)
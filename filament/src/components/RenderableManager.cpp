@@ -22,7 +22,9 @@
 #include "details/VertexBuffer.h"
 #include "details/IndexBuffer.h"
 #include "details/Material.h"
+#include "details/MorphTargetBuffer.h"
 #include "details/RenderPrimitive.h"
+#include "details/SkinningBuffer.h"
 
 #include <utils/Log.h>
 #include <utils/Panic.h>
@@ -36,20 +38,29 @@ using namespace details;
 
 struct RenderableManager::BuilderDetails {
     using Entry = RenderableManager::Builder::Entry;
+    // the entries of level L are at mEntries[L * mEntriesCount]
     Entry* mEntries = nullptr;
     size_t mEntriesCount = 0;
+    size_t mLevelCount = 1;
+    float mScreenSizes[MAX_LEVEL_OF_DETAIL_COUNT - 1] = {};
     Box mAABB;
     uint8_t mLayerMask = 0x1;
     uint8_t mPriority = 0x4;
     bool mCulling : 1;
     bool mCastShadows : 1;
     bool mReceiveShadows : 1;
+    bool mStaticShadowCaster : 1;
+    bool mSkinningBounds : 1;
     uint8_t mSkinningBoneCount = 0;
     Bone const* mBones = nullptr;
     math::mat4f const* mBoneMatrices = nullptr;
+    SkinningBuffer* mSkinningBuffer = nullptr;
+    size_t mSkinningOffset = 0;
+    MorphTargetBuffer* mMorphTargetBuffer = nullptr;
 
     explicit BuilderDetails(size_t count)
-            : mEntriesCount(count), mCulling(true), mCastShadows(false), mReceiveShadows(true) {
+            : mEntriesCount(count), mCulling(true), mCastShadows(false), mReceiveShadows(true),
+              mStaticShadowCaster(false), mSkinningBounds(false) {
     }
     // this is only needed for the explicit instantiation below
     BuilderDetails() = default;
@@ -58,7 +69,7 @@ struct RenderableManager::BuilderDetails {
 using BuilderType = RenderableManager;
 BuilderType::Builder::Builder(size_t count) noexcept
         : BuilderBase<RenderableManager::BuilderDetails>(count) {
-    mImpl->mEntries = new Entry[count];
+    mImpl->mEntries = new Entry[count * MAX_LEVEL_OF_DETAIL_COUNT];
 }
 BuilderType::Builder::~Builder() noexcept {
     delete [] mImpl->mEntries;
@@ -83,14 +94,30 @@ RenderableManager::Builder& RenderableManager::Builder::geometry(size_t index,
 RenderableManager::Builder& RenderableManager::Builder::geometry(size_t index,
         PrimitiveType type, VertexBuffer* vertices, IndexBuffer* indices,
         size_t offset, size_t minIndex, size_t maxIndex, size_t count) noexcept {
-    if (index < mImpl->mEntriesCount) {
-        mImpl->mEntries[index].vertices = vertices;
-        mImpl->mEntries[index].indices = indices;
-        mImpl->mEntries[index].offset = offset;
-        mImpl->mEntries[index].minIndex = minIndex;
-        mImpl->mEntries[index].maxIndex = maxIndex;
-        mImpl->mEntries[index].count = count;
-        mImpl->mEntries[index].type = type;
+    return geometry(index, 0, type, vertices, indices, offset, minIndex, maxIndex, count);
+}
+
+RenderableManager::Builder& RenderableManager::Builder::geometry(size_t index, uint8_t level,
+        PrimitiveType type, VertexBuffer* vertices, IndexBuffer* indices,
+        size_t offset, size_t minIndex, size_t maxIndex, size_t count) noexcept {
+    if (index < mImpl->mEntriesCount && level < MAX_LEVEL_OF_DETAIL_COUNT) {
+        Entry& entry = mImpl->mEntries[level * mImpl->mEntriesCount + index];
+        entry.vertices = vertices;
+        entry.indices = indices;
+        entry.offset = offset;
+        entry.minIndex = minIndex;
+        entry.maxIndex = maxIndex;
+        entry.count = count;
+        entry.type = type;
+    }
+    return *this;
+}
+
+RenderableManager::Builder& RenderableManager::Builder::levelOfDetail(
+        uint8_t level, float screenSize) noexcept {
+    if (level > 0 && level < MAX_LEVEL_OF_DETAIL_COUNT) {
+        mImpl->mScreenSizes[level - 1] = screenSize;
+        mImpl->mLevelCount = std::max(mImpl->mLevelCount, size_t(level) + 1);
     }
     return *this;
 }
@@ -133,6 +160,11 @@ RenderableManager::Builder& RenderableManager::Builder::receiveShadows(bool enab
     return *this;
 }
 
+RenderableManager::Builder& RenderableManager::Builder::staticShadowCaster(bool enable) noexcept {
+    mImpl->mStaticShadowCaster = enable;
+    return *this;
+}
+
 RenderableManager::Builder& RenderableManager::Builder::skinning(size_t boneCount) noexcept {
     mImpl->mSkinningBoneCount = (uint8_t)std::min(size_t(255), boneCount);
     return *this;
@@ -152,6 +184,25 @@ RenderableManager::Builder& RenderableManager::Builder::skinning(
     return *this;
 }
 
+RenderableManager::Builder& RenderableManager::Builder::skinning(
+        SkinningBuffer* skinningBuffer, size_t boneCount, size_t offset) noexcept {
+    mImpl->mSkinningBoneCount = (uint8_t)std::min(size_t(255), boneCount);
+    mImpl->mSkinningBuffer = skinningBuffer;
+    mImpl->mSkinningOffset = offset;
+    return *this;
+}
+
+RenderableManager::Builder& RenderableManager::Builder::skinningBounds(bool enable) noexcept {
+    mImpl->mSkinningBounds = enable;
+    return *this;
+}
+
+RenderableManager::Builder& RenderableManager::Builder::morphing(
+        MorphTargetBuffer* morphTargetBuffer) noexcept {
+    mImpl->mMorphTargetBuffer = morphTargetBuffer;
+    return *this;
+}
+
 RenderableManager::Builder& RenderableManager::Builder::blendOrder(size_t index, uint16_t blendOrder) noexcept {
     if (index < mImpl->mEntriesCount) {
         mImpl->mEntries[index].blendOrder = blendOrder;
@@ -160,10 +211,50 @@ RenderableManager::Builder& RenderableManager::Builder::blendOrder(size_t index,
 }
 
 RenderableManager::Builder::Result RenderableManager::Builder::build(Engine& engine, Entity entity) {
+    for (size_t l = 1, c = mImpl->mLevelCount; l < c; l++) {
+        if (!ASSERT_PRECONDITION_NON_FATAL(
+                l == 1 || mImpl->mScreenSizes[l - 1] < mImpl->mScreenSizes[l - 2],
+                "[entity=%u] the screen size of level %u must be smaller than the one of level %u",
+                entity.getId(), l, l - 1)) {
+            return Error;
+        }
+    }
+
+    if (mImpl->mSkinningBuffer && mImpl->mSkinningBoneCount) {
+        FSkinningBuffer const* skinningBuffer = upcast(mImpl->mSkinningBuffer);
+        if (!ASSERT_PRECONDITION_NON_FATAL(
+                mImpl->mSkinningOffset + mImpl->mSkinningBoneCount <=
+                        skinningBuffer->getBoneCount(),
+                "[entity=%u] offset (%u) + boneCount (%u) > skinning buffer boneCount (%u)",
+                entity.getId(), mImpl->mSkinningOffset, mImpl->mSkinningBoneCount,
+                skinningBuffer->getBoneCount())) {
+            return Error;
+        }
+        if (!ASSERT_PRECONDITION_NON_FATAL(
+                mImpl->mSkinningOffset % skinningBuffer->getBoneOffsetAlignment() == 0,
+                "[entity=%u] offset (%u) must be a multiple of %u",
+                entity.getId(), mImpl->mSkinningOffset,
+                skinningBuffer->getBoneOffsetAlignment())) {
+            return Error;
+        }
+    }
+
     bool isEmpty = true;
-    for (size_t i = 0, c = mImpl->mEntriesCount; i < c; i++) {
+    for (size_t i = 0, c = mImpl->mEntriesCount * mImpl->mLevelCount; i < c; i++) {
         auto& entry = mImpl->mEntries[i];
 
+        if (i >= mImpl->mEntriesCount) {
+            // all levels share the material and blend order of level 0, and use the geometry
+            // of the previous level unless they have their own
+            auto const& base = mImpl->mEntries[i % mImpl->mEntriesCount];
+            auto const& previous = mImpl->mEntries[i - mImpl->mEntriesCount];
+            if (!entry.indices || !entry.vertices) {
+                entry = previous;
+            }
+            entry.materialInstance = base.materialInstance;
+            entry.blendOrder = base.blendOrder;
+        }
+
         // entry.materialInstance must be set to something even if indices/vertices are null
         FMaterial const* material = nullptr;
         if (!entry.materialInstance) {
@@ -195,6 +286,18 @@ RenderableManager::Builder::Result RenderableManager::Builder::build(Engine& eng
             return Error;
         }
 
+        // the morph targets are looked up by vertex index
+        if (mImpl->mMorphTargetBuffer) {
+            const size_t vertexCount = upcast(mImpl->mMorphTargetBuffer)->getVertexCount();
+            if (!ASSERT_PRECONDITION_NON_FATAL(entry.vertices->getVertexCount() == vertexCount,
+                    "[entity=%u, primitive @ %u] vertexCount (%u) != morph targets vertexCount (%u)",
+                    entity.getId(), unsigned(i), unsigned(entry.vertices->getVertexCount()),
+                    unsigned(vertexCount))) {
+                entry.vertices = nullptr;
+                return Error;
+            }
+        }
+
 #ifndef NDEBUG
         // this can't be an error because (1) those values are not immutable, so the caller
         // could fix later, and (2) the material's shader will work (i.e. compile), and
@@ -241,6 +344,23 @@ FRenderableManager::~FRenderableManager() {
     assert(mManager.getComponentCount() == 0);
 }
 
+void FRenderableManager::init() noexcept {
+    FEngine::DriverApi& driver = mEngine.getDriverApi();
+
+    // identity bones, for renderables that are morphed but not skinned
+    UniformBuffer bones(CONFIG_MAX_BONE_COUNT * sizeof(Bone));
+    Bone* UTILS_RESTRICT out = (Bone*)bones.invalidateUniforms(0, bones.getSize());
+    std::fill_n(out, CONFIG_MAX_BONE_COUNT, Bone{});
+    mDummyBonesUbh = driver.createUniformBuffer(bones.getSize());
+    driver.updateUniformBuffer(mDummyBonesUbh, std::move(bones));
+
+    // no morph targets, for renderables that are skinned but not morphed
+    UniformBuffer weights(sizeof(FMorphTargetBuffer::MorphingUib));
+    mDummyMorphingUbh = driver.createUniformBuffer(weights.getSize());
+    driver.updateUniformBuffer(mDummyMorphingUbh, std::move(weights));
+    mDummyMorphTargetsSbh = driver.createSamplerBuffer(1);
+}
+
 void FRenderableManager::create(
         const RenderableManager::Builder& UTILS_RESTRICT builder, Entity entity) {
     FEngine& engine = mEngine;
@@ -255,9 +375,19 @@ void FRenderableManager::create(
     if (UTILS_UNLIKELY(ci)) {
         canReuse = true;
         destroyComponentPrimitives(engine, manager[ci].primitives);
-        std::unique_ptr<Bones> const& bones = manager[ci].bones;
-        if (bones && !builder->mSkinningBoneCount) {
-            driver.destroyUniformBuffer(bones->handle);
+        // the bones UBO can be reused only if both the old and new component own their bones
+        std::unique_ptr<Bones>& bones = manager[ci].bones;
+        if (bones && (!builder->mSkinningBoneCount ||
+                builder->mSkinningBuffer || bones->skinningBuffer)) {
+            if (!bones->skinningBuffer) {
+                driver.destroyUniformBuffer(bones->handle);
+            }
+            bones.reset();
+        }
+        std::unique_ptr<Morphing>& morphing = manager[ci].morphing;
+        if (morphing) {
+            driver.destroyUniformBuffer(morphing->handle);
+            morphing.reset();
         }
     }
 
@@ -268,47 +398,97 @@ void FRenderableManager::create(
         // create and initialize all needed RenderPrimitives
         using size_type = Slice<FRenderPrimitive>::size_type;
         Builder::Entry const * const entries = builder->mEntries;
-        FRenderPrimitive* rp = new FRenderPrimitive[builder->mEntriesCount];
-        for (size_t i = 0, c = builder->mEntriesCount; i < c; ++i) {
+        const size_t count = builder->mEntriesCount * builder->mLevelCount;
+        FRenderPrimitive* rp = new FRenderPrimitive[count];
+        for (size_t i = 0; i < count; ++i) {
             rp[i].init(driver, entries[i]);
         }
-        setPrimitives(ci, { rp, size_type(builder->mEntriesCount) });
+        setPrimitives(ci, { rp, size_type(count) });
+
+        // the quantized positions are scaled back by the world transform (see updateLocalUBO()),
+        // which works as long as all the primitives use the same box
+        Box positionBounds;
+        for (size_t i = 0; i < count; ++i) {
+            FVertexBuffer const* const vertices = upcast(entries[i].vertices);
+            Box const* const bounds = vertices ? vertices->getPositionBounds() : nullptr;
+            if (bounds && positionBounds.isEmpty()) {
+                positionBounds = *bounds;
+            }
+#ifndef NDEBUG
+            const bool differs = bounds ?
+                    (bounds->center != positionBounds.center ||
+                     bounds->halfExtent != positionBounds.halfExtent) :
+                    !positionBounds.isEmpty();
+            if (vertices && differs) {
+                slog.w << "[entity=" << entity.getId() << ", primitive @ " << i
+                       << "] the positions of the primitives aren't quantized alike"
+                       << io::endl;
+            }
+#endif
+        }
+        manager[ci].positionBounds = positionBounds;
+        setLevelsOfDetail(ci, builder->mScreenSizes, builder->mLevelCount);
 
         setAxisAlignedBoundingBox(ci, builder->mAABB);
         setLayerMask(ci, builder->mLayerMask);
         setPriority(ci, builder->mPriority);
         setCastShadows(ci, builder->mCastShadows);
         setReceiveShadows(ci, builder->mReceiveShadows);
+        setStaticShadowCaster(ci, builder->mStaticShadowCaster);
         setCulling(ci, builder->mCulling);
-        static_cast<Visibility&>(manager[ci].visibility).skinning = builder->mSkinningBoneCount > 0;
+        setBackground(ci, false);
+        // morphing is done by the skinning variant
+        static_cast<Visibility&>(manager[ci].visibility).skinning =
+                builder->mSkinningBoneCount > 0 || builder->mMorphTargetBuffer;
 
         if (!canReuse) {
             getUniformBuffer(ci) = UniformBuffer(engine.getPerRenderableUib());
-            setUniformHandle(ci, driver.createUniformBuffer(getUniformBuffer(ci).getSize()));
-            if (builder->mSkinningBoneCount) {
-                std::unique_ptr<Bones>& bones = manager[ci].bones;
-
-                bones.reset(new Bones); // FIXME: maybe use a pool allocator
-                bones->bones = UniformBuffer(CONFIG_MAX_BONE_COUNT * sizeof(Bone));
-                bones->handle = driver.createUniformBuffer(CONFIG_MAX_BONE_COUNT * sizeof(Bone));
-            }
         }
         if (builder->mSkinningBoneCount) {
-            std::unique_ptr<Bones> const& bones = manager[ci].bones;
-            assert(bones);
+            std::unique_ptr<Bones>& bones = manager[ci].bones;
+            if (!canReuse || !bones) {
+                bones.reset(new Bones); // FIXME: maybe use a pool allocator
+                if (builder->mSkinningBuffer) {
+                    bones->skinningBuffer = upcast(builder->mSkinningBuffer);
+                    bones->handle = bones->skinningBuffer->getHwHandle();
+                    bones->offset = uint32_t(builder->mSkinningOffset);
+                } else {
+                    bones->bones = UniformBuffer(CONFIG_MAX_BONE_COUNT * sizeof(Bone));
+                    bones->handle = driver.createUniformBuffer(
+                            CONFIG_MAX_BONE_COUNT * sizeof(Bone));
+                }
+            }
             bones->count = builder->mSkinningBoneCount;
+            bones->centers.clear();
+            if (builder->mSkinningBounds && !builder->mAABB.isEmpty()) {
+                bones->center = builder->mAABB.center;
+                bones->radius = length(builder->mAABB.halfExtent);
+                bones->centers.resize(bones->count, bones->center);
+            }
             if (builder->mBones) {
                 setBones(ci, builder->mBones, builder->mSkinningBoneCount);
             } else if (builder->mBoneMatrices) {
                 setBones(ci, builder->mBoneMatrices, builder->mSkinningBoneCount);
-            } else {
-                // initialize the bones to identity
+            } else if (!bones->skinningBuffer) {
+                // initialize the bones to identity, shared bones are left as they are
                 Bone* UTILS_RESTRICT out =
                         (Bone*)bones->bones.invalidateUniforms(0, bones->count * sizeof(Bone));
                 std::fill_n(out, bones->count, Bone{});
             }
         }
+        if (builder->mMorphTargetBuffer) {
+            std::unique_ptr<Morphing>& morphing = manager[ci].morphing;
+            morphing.reset(new Morphing);
+            morphing->buffer = upcast(builder->mMorphTargetBuffer);
+            morphing->weights = UniformBuffer(sizeof(FMorphTargetBuffer::MorphingUib));
+            morphing->weights.setUniform(offsetof(FMorphTargetBuffer::MorphingUib, count),
+                    uint32_t(morphing->buffer->getTargetCount()));
+            morphing->handle = driver.createUniformBuffer(morphing->weights.getSize());
+        }
     }
+
+    // scenes containing this entity must pick-up the new component
+    mChangeJournal.invalidate();
 }
 
 // this destroys a single component from an entity
@@ -317,6 +497,7 @@ void FRenderableManager::destroy(utils::Entity e) noexcept {
     if (ci) {
         destroyComponent(ci);
         mManager.removeComponent(e);
+        mChangeJournal.invalidate();
     }
 }
 
@@ -333,7 +514,13 @@ void FRenderableManager::terminate() noexcept {
             destroyComponent(ci);
             manager.removeComponent(manager.getEntity(ci));
         }
+        mChangeJournal.invalidate();
     }
+
+    FEngine::DriverApi& driver = mEngine.getDriverApi();
+    driver.destroyUniformBuffer(mDummyBonesUbh);
+    driver.destroyUniformBuffer(mDummyMorphingUbh);
+    driver.destroySamplerBuffer(mDummyMorphTargetsSbh);
 }
 
 // This is basically a Renderable's destructor.
@@ -342,16 +529,21 @@ void FRenderableManager::destroyComponent(Instance ci) noexcept {
     FEngine& engine = mEngine;
 
     FEngine::DriverApi& driver = engine.getDriverApi();
-    driver.destroyUniformBuffer(manager[ci].uniformsHandle);
 
     // See create(RenderableManager::Builder&, Entity)
     destroyComponentPrimitives(engine, manager[ci].primitives);
 
-    // destroy the bones structures if any
+    // destroy the bones structures if any, shared bones belong to their SkinningBuffer
     std::unique_ptr<Bones> const& bones = manager[ci].bones;
-    if (bones) {
+    if (bones && !bones->skinningBuffer) {
         driver.destroyUniformBuffer(bones->handle);
     }
+
+    // the morph targets belong to their MorphTargetBuffer
+    std::unique_ptr<Morphing> const& morphing = manager[ci].morphing;
+    if (morphing) {
+        driver.destroyUniformBuffer(morphing->handle);
+    }
 }
 
 void FRenderableManager::destroyComponentPrimitives(
@@ -366,34 +558,54 @@ void FRenderableManager::destroyComponentPrimitives(
 void FRenderableManager::prepare(
         driver::DriverApi& UTILS_RESTRICT driver,
         Instance const* UTILS_RESTRICT instances,
-        utils::Range<uint32_t> list) const noexcept {
+        utils::Range<uint32_t> list, void* UTILS_RESTRICT dst, size_t stride) const noexcept {
     auto& manager = mManager;
-    UniformBuffer           const * const UTILS_RESTRICT uniforms = manager.raw_array<UNIFORMS>();
-    Handle<HwUniformBuffer> const * const UTILS_RESTRICT ubhs     = manager.raw_array<UNIFORMS_HANDLE>();
-    std::unique_ptr<Bones>  const * const UTILS_RESTRICT bones    = manager.raw_array<BONES>();
     for (uint32_t index : list) {
         size_t i = instances[index].asValue();
         assert(i);  // we should never get the null instance here
-        if (uniforms[i].isDirty()) {
-            // update per-renderable uniform buffer
-            driver.updateUniformBuffer(ubhs[i], UniformBuffer(uniforms[i]));
-            uniforms[i].clean(); // clean AFTER we send to the driver
-        }
-        if (UTILS_UNLIKELY(bones[i])) {
-            if (bones[i]->bones.isDirty()) {
-                driver.updateUniformBuffer(bones[i]->handle, UniformBuffer(bones[i]->bones));
-                bones[i]->bones.clean();
+        // the renderables move around in the scene every frame, so we always copy the
+        // uniforms, they're sent to the driver all at once by the caller.
+        UniformBuffer const& uniforms = manager.elementAt<UNIFORMS>(i);
+        memcpy(static_cast<char*>(dst) + index * stride, uniforms.getBuffer(), uniforms.getSize());
+        std::unique_ptr<Bones> const& bones = manager.elementAt<BONES>(i);
+        if (UTILS_UNLIKELY(bones)) {
+            if (bones->skinningBuffer) {
+                // this uploads the bones of all the renderables sharing this buffer at once,
+                // the first time one of them is visible in a frame
+                bones->skinningBuffer->commit(driver);
+            } else {
+                driver.commitUniforms(bones->handle, bones->bones);
             }
         }
+        std::unique_ptr<Morphing> const& morphing = manager.elementAt<MORPHING>(i);
+        if (UTILS_UNLIKELY(morphing)) {
+            // the targets are uploaded once for all the renderables sharing them
+            morphing->buffer->commit(driver);
+            driver.commitUniforms(morphing->handle, morphing->weights);
+        }
     }
 }
 
-void FRenderableManager::updateLocalUBO(Instance instance, const math::mat4f& model) noexcept {
+void FRenderableManager::updateLocalUBO(Instance instance, const AffineTransform& model) noexcept {
     if (instance) {
         auto& uniforms = getUniformBuffer(instance);
 
-        // update our uniform buffer
-        uniforms.setUniform(offsetof(FEngine::PerRenderableUib, worldFromModelMatrix), model);
+        // update our uniform buffer, the world transform is stored as the first 3 rows of the
+        // matrix, see getWorldFromModelMatrix() in the shaders
+        // quantized positions are in [-1, 1] within their box, which is applied first
+        Box const& bounds = mManager[instance].positionBounds;
+        if (UTILS_UNLIKELY(!bounds.isEmpty())) {
+            AffineTransform dequantization;
+            dequantization.rows[0] = { bounds.halfExtent.x, 0, 0, bounds.center.x };
+            dequantization.rows[1] = { 0, bounds.halfExtent.y, 0, bounds.center.y };
+            dequantization.rows[2] = { 0, 0, bounds.halfExtent.z, bounds.center.z };
+            const AffineTransform transform = model * dequantization;
+            uniforms.setUniformArray(offsetof(FEngine::PerRenderableUib, worldFromModelMatrix),
+                    transform.rows, 3);
+        } else {
+            uniforms.setUniformArray(offsetof(FEngine::PerRenderableUib, worldFromModelMatrix),
+                    model.rows, 3);
+        }
 
         // Using the inverse-transpose handles non-uniform scaling, but DOESN'T guarantee that
         // the transformed normals will have unit-length, therefore they need to be normalized
@@ -405,10 +617,20 @@ void FRenderableManager::updateLocalUBO(Instance instance, const math::mat4f& mo
     }
 }
 
+Slice<FRenderPrimitive> FRenderableManager::getRenderPrimitives(
+        Instance instance, uint8_t level) const noexcept {
+    // the primitives of all levels are stored back to back, level 0 first
+    Slice<FRenderPrimitive> const& primitives = mManager[instance].primitives;
+    const size_t count = primitives.size() / getLevelCount(instance);
+    assert(level < getLevelCount(instance));
+    return { const_cast<FRenderPrimitive*>(primitives.begin()) + level * count,
+             Slice<FRenderPrimitive>::size_type(count) };
+}
+
 void FRenderableManager::setMaterialInstanceAt(Instance instance, uint8_t level,
         size_t primitiveIndex, FMaterialInstance const* mi) noexcept {
     if (instance) {
-        Slice<FRenderPrimitive>& primitives = getRenderPrimitives(instance, level);
+        Slice<FRenderPrimitive> primitives = getRenderPrimitives(instance, level);
         if (primitiveIndex < primitives.size()) {
             primitives[primitiveIndex].setMaterialInstance(upcast(mi));
 #ifndef NDEBUG
@@ -427,7 +649,7 @@ void FRenderableManager::setMaterialInstanceAt(Instance instance, uint8_t level,
 MaterialInstance* FRenderableManager::getMaterialInstanceAt(
         Instance instance, uint8_t level, size_t primitiveIndex) const noexcept {
     if (instance) {
-        const Slice<FRenderPrimitive>& primitives = getRenderPrimitives(instance, level);
+        Slice<FRenderPrimitive> primitives = getRenderPrimitives(instance, level);
         if (primitiveIndex < primitives.size()) {
             // We store the material instance as const because we don't want to change it internally
             // but when the user queries it, we want to allow them to call setParameter()
@@ -440,7 +662,7 @@ MaterialInstance* FRenderableManager::getMaterialInstanceAt(
 void FRenderableManager::setBlendOrderAt(Instance instance, uint8_t level,
         size_t primitiveIndex, uint16_t order) noexcept {
     if (instance) {
-        Slice<FRenderPrimitive>& primitives = getRenderPrimitives(instance, level);
+        Slice<FRenderPrimitive> primitives = getRenderPrimitives(instance, level);
         if (primitiveIndex < primitives.size()) {
             primitives[primitiveIndex].setBlendOrder(order);
         }
@@ -450,7 +672,7 @@ void FRenderableManager::setBlendOrderAt(Instance instance, uint8_t level,
 AttributeBitset FRenderableManager::getEnabledAttributesAt(
         Instance instance, uint8_t level, size_t primitiveIndex) const noexcept {
     if (instance) {
-        Slice<FRenderPrimitive> const& primitives = getRenderPrimitives(instance, level);
+        Slice<FRenderPrimitive> primitives = getRenderPrimitives(instance, level);
         if (primitiveIndex < primitives.size()) {
             return primitives[primitiveIndex].getEnabledAttributes();
         }
@@ -462,10 +684,13 @@ void FRenderableManager::setGeometryAt(Instance instance, uint8_t level, size_t
         PrimitiveType type, FVertexBuffer* vertices, FIndexBuffer* indices,
         size_t offset, size_t count) noexcept {
     if (instance) {
-        Slice<FRenderPrimitive>& primitives = getRenderPrimitives(instance, level);
+        Slice<FRenderPrimitive> primitives = getRenderPrimitives(instance, level);
         if (primitiveIndex < primitives.size()) {
             primitives[primitiveIndex].set(mEngine, type, vertices, indices, offset,
                     0, vertices->getVertexCount() - 1, count);
+            // the new buffer's quantization box replaces the previous one, see create()
+            Box const* const bounds = vertices->getPositionBounds();
+            mManager[instance].positionBounds = bounds ? *bounds : Box{};
         }
     }
 }
@@ -473,7 +698,7 @@ void FRenderableManager::setGeometryAt(Instance instance, uint8_t level, size_t
 void FRenderableManager::setGeometryAt(Instance instance, uint8_t level, size_t primitiveIndex,
         PrimitiveType type, size_t offset, size_t count) noexcept {
     if (instance) {
-        Slice<FRenderPrimitive>& primitives = getRenderPrimitives(instance, level);
+        Slice<FRenderPrimitive> primitives = getRenderPrimitives(instance, level);
         if (primitiveIndex < primitives.size()) {
             primitives[primitiveIndex].set(mEngine, type, offset, 0, 0, count);
         }
@@ -486,11 +711,19 @@ void FRenderableManager::setBones(Instance ci,
         std::unique_ptr<Bones> const& bones = mManager[ci].bones;
         if (bones) {
             assert(offset + boneCount <= bones->count);
-            boneCount = std::min(boneCount, bones->count - offset);
-            Bone* UTILS_RESTRICT out = (Bone*)bones->bones.invalidateUniforms(
-                    offset * sizeof(Bone),
-                    boneCount * sizeof(Bone));
-            std::copy_n(transforms, boneCount, out);
+            boneCount = std::min(boneCount, bones->count - std::min(offset, size_t(bones->count)));
+            if (bones->skinningBuffer) {
+                bones->skinningBuffer->setBones(transforms, boneCount, bones->offset + offset);
+            } else {
+                FSkinningBuffer::writeBones(bones->bones, transforms, boneCount, offset);
+            }
+            if (!bones->centers.empty()) {
+                for (size_t i = 0; i < boneCount; i++) {
+                    bones->centers[offset + i] =
+                            transforms[i].unitQuaternion * bones->center + transforms[i].translation;
+                }
+                updateSkinningBounds(ci);
+            }
         }
     }
 }
@@ -501,14 +734,53 @@ void FRenderableManager::setBones(Instance ci,
         std::unique_ptr<Bones> const& bones = mManager[ci].bones;
         if (bones) {
             assert(offset + boneCount <= bones->count);
-            boneCount = std::min(boneCount, bones->count - offset);
-            Bone* UTILS_RESTRICT out = (Bone*)bones->bones.invalidateUniforms(
-                    offset * sizeof(Bone),
-                    boneCount * sizeof(Bone));
-            for (size_t i = 0, c = bones->count; i < c; ++i) {
-                mat4f const& m = transforms[i];
-                out[i].unitQuaternion = m.toQuaternion();
-                out[i].translation = m[3].xyz;
+            boneCount = std::min(boneCount, bones->count - std::min(offset, size_t(bones->count)));
+            if (bones->skinningBuffer) {
+                bones->skinningBuffer->setBones(transforms, boneCount, bones->offset + offset);
+            } else {
+                FSkinningBuffer::writeBones(bones->bones, transforms, boneCount, offset);
+            }
+            if (!bones->centers.empty()) {
+                for (size_t i = 0; i < boneCount; i++) {
+                    mat4f const& m = transforms[i];
+                    bones->centers[offset + i] = m.toQuaternion() * bones->center + m[3].xyz;
+                }
+                updateSkinningBounds(ci);
+            }
+        }
+    }
+}
+
+void FRenderableManager::updateSkinningBounds(Instance ci) noexcept {
+    // The bones are rigid transforms and a skinned vertex is a weighted average of the vertex
+    // moved by its bones, so it lies within the convex hull of the bind pose's sphere moved by
+    // each bone.
+    std::unique_ptr<Bones> const& bones = mManager[ci].bones;
+    float3 lo = bones->centers[0];
+    float3 hi = bones->centers[0];
+    for (float3 const& c : bones->centers) {
+        lo = min(lo, c);
+        hi = max(hi, c);
+    }
+    Box& aabb = mManager[ci].aabb;
+    aabb.center = (hi + lo) * 0.5f;
+    aabb.halfExtent = (hi - lo) * 0.5f + bones->radius;
+    recordChange(ci);
+}
+
+void FRenderableManager::setMorphWeights(Instance ci,
+        float const* UTILS_RESTRICT weights, size_t count, size_t offset) noexcept {
+    if (ci) {
+        std::unique_ptr<Morphing> const& morphing = mManager[ci].morphing;
+        if (morphing) {
+            const size_t targetCount = morphing->buffer->getTargetCount();
+            assert(offset + count <= targetCount);
+            count = std::min(count, targetCount - std::min(offset, targetCount));
+            if (count) {
+                // the weights are tightly packed in an array of float4
+                morphing->weights.setUniformArray(
+                        offsetof(FMorphTargetBuffer::MorphingUib, weights) + offset * sizeof(float),
+                        weights, count);
             }
         }
     }
@@ -564,6 +836,14 @@ bool RenderableManager::isShadowReceiver(Instance instance) const noexcept {
     return upcast(this)->isShadowReceiver(instance);
 }
 
+void RenderableManager::setStaticShadowCaster(Instance instance, bool enable) noexcept {
+    upcast(this)->setStaticShadowCaster(instance, enable);
+}
+
+bool RenderableManager::isStaticShadowCaster(Instance instance) const noexcept {
+    return upcast(this)->isStaticShadowCaster(instance);
+}
+
 const Box& RenderableManager::getAxisAlignedBoundingBox(Instance instance) const noexcept {
     return upcast(this)->getAxisAlignedBoundingBox(instance);
 }
@@ -572,9 +852,17 @@ size_t RenderableManager::getPrimitiveCount(Instance instance) const noexcept {
     return upcast(this)->getPrimitiveCount(instance, 0);
 }
 
+size_t RenderableManager::getLevelOfDetailCount(Instance instance) const noexcept {
+    return upcast(this)->getLevelCount(instance);
+}
+
 void RenderableManager::setMaterialInstanceAt(Instance instance,
         size_t primitiveIndex, MaterialInstance const* materialInstance) noexcept {
-    upcast(this)->setMaterialInstanceAt(instance, 0, primitiveIndex, upcast(materialInstance));
+    // all levels of detail share the same materials
+    for (size_t l = 0, c = upcast(this)->getLevelCount(instance); l < c; l++) {
+        upcast(this)->setMaterialInstanceAt(instance, uint8_t(l), primitiveIndex,
+                upcast(materialInstance));
+    }
 }
 
 MaterialInstance* RenderableManager::getMaterialInstanceAt(
@@ -583,7 +871,9 @@ MaterialInstance* RenderableManager::getMaterialInstanceAt(
 }
 
 void RenderableManager::setBlendOrderAt(Instance instance, size_t primitiveIndex, uint16_t order) noexcept {
-    upcast(this)->setBlendOrderAt(instance, 0, primitiveIndex, order);
+    for (size_t l = 0, c = upcast(this)->getLevelCount(instance); l < c; l++) {
+        upcast(this)->setBlendOrderAt(instance, uint8_t(l), primitiveIndex, order);
+    }
 }
 
 AttributeBitset RenderableManager::getEnabledAttributesAt(Instance instance, size_t primitiveIndex) const noexcept {
@@ -612,4 +902,9 @@ void RenderableManager::setBones(Instance instance,
     upcast(this)->setBones(instance, transforms, boneCount, offset);
 }
 
+void RenderableManager::setMorphWeights(Instance instance,
+        float const* weights, size_t count, size_t offset) noexcept {
+    upcast(this)->setMorphWeights(instance, weights, count, offset);
+}
+
 } // namespace filament
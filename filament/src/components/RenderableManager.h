@@ -17,8 +17,12 @@
 #ifndef TNT_FILAMENT_DETAILS_RENDERABLECOMPONENTMANAGER_H
 #define TNT_FILAMENT_DETAILS_RENDERABLECOMPONENTMANAGER_H
 
+#include "AffineTransform.h"
 #include "upcast.h"
 
+#include "details/ChangeJournal.h"
+#include "details/MorphTargetBuffer.h"
+
 #include "driver/DriverApiForward.h"
 #include "driver/UniformBuffer.h"
 #include "driver/Handle.h"
@@ -31,11 +35,14 @@
 #include <utils/Slice.h>
 #include <utils/Range.h>
 
+#include <vector>
+
 namespace filament {
 namespace details {
 
 class FMaterialInstance;
 class FRenderPrimitive;
+class FSkinningBuffer;
 
 class FRenderableManager : public RenderableManager {
 public:
@@ -47,11 +54,15 @@ public:
         bool receiveShadows : 1;
         bool culling        : 1;
         bool skinning       : 1;
+        bool staticShadowCaster : 1;
+        bool background     : 1;    // drawn after the opaque objects, see FSkybox
     };
 
     FRenderableManager(FEngine& engine) noexcept;
     ~FRenderableManager();
 
+    void init() noexcept;
+
     // free-up all resources
     void terminate() noexcept;
 
@@ -73,23 +84,28 @@ public:
 
     // - instances is a list of Instance (typically the list from a given scene)
     // - list is a list of index in 'instances' (typically the visible ones)
+    // - the per-renderable uniforms of instances[i] are copied to uniforms + i * stride
     void prepare(driver::DriverApi& driver,
             RenderableManager::Instance const* instances,
-            utils::Range<uint32_t> list) const noexcept;
+            utils::Range<uint32_t> list, void* uniforms, size_t stride) const noexcept;
 
-    void gc(utils::EntityManager& em) noexcept {
-        mManager.gc(em);
+    size_t getMemorySize() const noexcept {
+        return mManager.getMemorySize();
     }
 
-    utils::Slice<const UniformBuffer> getUniformBuffers() const noexcept {
-        return mManager.slice<UNIFORMS>();
+    void gc(utils::EntityManager& em) noexcept {
+        size_t count = mManager.getComponentCount();
+        mManager.gc(em);
+        if (count != mManager.getComponentCount()) {
+            mChangeJournal.invalidate();
+        }
     }
 
-    utils::Slice<const Handle<HwUniformBuffer>> getUniformBufferHandles() const noexcept {
-        return mManager.slice<UNIFORMS_HANDLE>();
-    }
+    // entities whose AABB, layers or visibility changed
+    ChangeJournal const& getChangeJournal() const noexcept { return mChangeJournal; }
+    void trimChangeJournal() noexcept { mChangeJournal.trim(); }
 
-    void updateLocalUBO(Instance instance, const math::mat4f& model) noexcept;
+    void updateLocalUBO(Instance instance, const AffineTransform& model) noexcept;
     inline void setAxisAlignedBoundingBox(Instance instance, const Box& aabb) noexcept;
 
     inline void setLayerMask(Instance instance, uint8_t select, uint8_t values) noexcept;
@@ -101,15 +117,19 @@ public:
 
     inline void setLayerMask(Instance instance, uint8_t enable) noexcept;
     inline void setReceiveShadows(Instance instance, bool enable) noexcept;
+    inline void setStaticShadowCaster(Instance instance, bool enable) noexcept;
     inline void setCulling(Instance instance, bool enable) noexcept;
-    inline void setUniformHandle(Instance instance, Handle<HwUniformBuffer> const& handle) noexcept;
+    inline void setBackground(Instance instance, bool enable) noexcept;
     inline void setPrimitives(Instance instance, utils::Slice<FRenderPrimitive> const& primitives) noexcept;
+    inline void setLevelsOfDetail(Instance instance, float const* screenSizes, size_t levelCount) noexcept;
     inline void setBones(Instance instance, Bone const* transforms, size_t boneCount, size_t offset = 0) noexcept;
     inline void setBones(Instance instance, math::mat4f const* transforms, size_t boneCount, size_t offset = 0) noexcept;
+    void setMorphWeights(Instance instance, float const* weights, size_t count, size_t offset = 0) noexcept;
 
 
     inline bool isShadowCaster(Instance instance) const noexcept;
     inline bool isShadowReceiver(Instance instance) const noexcept;
+    inline bool isStaticShadowCaster(Instance instance) const noexcept;
     inline bool isCullingEnabled(Instance instance) const noexcept;
 
     inline Box const& getAABB(Instance instance) const noexcept;
@@ -121,11 +141,18 @@ public:
     inline UniformBuffer const& getUniformBuffer(Instance instance) const noexcept;
     inline UniformBuffer& getUniformBuffer(Instance instance) noexcept;
 
-    inline Handle<HwUniformBuffer> getUbh(Instance instance) const noexcept;
     inline Handle<HwUniformBuffer> getBonesUbh(Instance instance) const noexcept;
+    // offset in bytes of the bones within getBonesUbh()
+    inline uint32_t getBonesOffset(Instance instance) const noexcept;
+    // the skinning variant also morphs, so skinned renderables always need these buffers
+    inline Handle<HwUniformBuffer> getMorphingUbh(Instance instance) const noexcept;
+    inline Handle<HwSamplerBuffer> getMorphTargetsSbh(Instance instance) const noexcept;
 
 
-    inline size_t getLevelCount(Instance instance) const noexcept { return 1; }
+    inline size_t getLevelCount(Instance instance) const noexcept;
+    // returns the level of detail to use when the renderable's bounding sphere covers
+    // screenSize of the viewport's height
+    inline uint8_t getLevelOfDetail(Instance instance, float screenSize) const noexcept;
     inline size_t getPrimitiveCount(Instance instance, uint8_t level) const noexcept;
     void setMaterialInstanceAt(Instance instance, uint8_t level,
             size_t primitiveIndex, FMaterialInstance const* materialInstance) noexcept;
@@ -137,18 +164,37 @@ public:
             PrimitiveType type, size_t offset, size_t count) noexcept;
     void setBlendOrderAt(Instance instance, uint8_t level, size_t primitiveIndex, uint16_t blendOrder) noexcept;
     AttributeBitset getEnabledAttributesAt(Instance instance, uint8_t level, size_t primitiveIndex) const noexcept;
-    inline utils::Slice<FRenderPrimitive> const& getRenderPrimitives(Instance instance, uint8_t level) const noexcept;
-    inline utils::Slice<FRenderPrimitive>& getRenderPrimitives(Instance instance, uint8_t level) noexcept;
+    utils::Slice<FRenderPrimitive> getRenderPrimitives(Instance instance, uint8_t level) const noexcept;
 
 
 private:
     void destroyComponent(Instance ci) noexcept;
     static void destroyComponentPrimitives(FEngine& engine,
             utils::Slice<FRenderPrimitive>& primitives) noexcept;
+    void updateSkinningBounds(Instance ci) noexcept;
 
     struct Bones {
         filament::Handle<HwUniformBuffer> handle;
-        UniformBuffer bones;
+        UniformBuffer bones;                    // unused when the bones are shared
+        FSkinningBuffer* skinningBuffer = nullptr;
+        uint32_t offset = 0;                    // in bones, within skinningBuffer
+        uint8_t count = 0;
+        // with RenderableManager::Builder::skinningBounds(), the bounding sphere of the bind pose
+        // and its center moved by each bone
+        std::vector<math::float3> centers;
+        math::float3 center;
+        float radius = 0;
+    };
+
+    struct Morphing {
+        filament::Handle<HwUniformBuffer> handle;
+        UniformBuffer weights;                  // MorphingUniforms
+        FMorphTargetBuffer* buffer = nullptr;
+    };
+
+    struct LevelsOfDetail {
+        // level i + 1 is used below screenSizes[i], see RenderableManager::Builder::levelOfDetail()
+        float screenSizes[MAX_LEVEL_OF_DETAIL_COUNT - 1];
         uint8_t count;
     };
 
@@ -156,20 +202,24 @@ private:
         AABB,               // user data
         LAYERS,             // user data
         VISIBILITY,         // user data
-        PRIMITIVES,         // user data
+        PRIMITIVES,         // user data, the primitives of all the levels of detail
+        LEVELS_OF_DETAIL,   // user data
         UNIFORMS,           // filament data, UBO data where world-transform is stored
-        UNIFORMS_HANDLE,    // filament data, handle to the driver's UBO
         BONES,              // filament data, UBO storing a pointer to the bones information
+        MORPHING,           // filament data, UBO storing the morph weights
+        POSITION_BOUNDS,    // filament data, box the positions are quantized in (or empty)
     };
 
-    using Base = utils::SingleInstanceComponentManager<
+    using Base = utils::ChunkedSingleInstanceComponentManager<
             Box,
             uint8_t,
             Visibility,
             utils::Slice<FRenderPrimitive>,
+            LevelsOfDetail,
             UniformBuffer,
-            filament::Handle<HwUniformBuffer>,
-            std::unique_ptr<Bones>
+            std::unique_ptr<Bones>,
+            std::unique_ptr<Morphing>,
+            Box
     >;
 
     struct Sim : public Base {
@@ -188,9 +238,11 @@ private:
                 Field<LAYERS>           layers;
                 Field<VISIBILITY>       visibility;
                 Field<PRIMITIVES>       primitives;
+                Field<LEVELS_OF_DETAIL> levelsOfDetail;
                 Field<UNIFORMS>         uniforms;
-                Field<UNIFORMS_HANDLE>  uniformsHandle;
                 Field<BONES>            bones;
+                Field<MORPHING>         morphing;
+                Field<POSITION_BOUNDS>  positionBounds;
             };
         };
 
@@ -202,8 +254,18 @@ private:
         }
     };
 
+    void recordChange(Instance instance) noexcept {
+        mChangeJournal.record(mManager.getEntity(instance));
+    }
+
     Sim mManager;
     FEngine& mEngine;
+    ChangeJournal mChangeJournal;
+
+    // bound for the skinned renderables that don't have bones or morph targets
+    Handle<HwUniformBuffer> mDummyBonesUbh;
+    Handle<HwUniformBuffer> mDummyMorphingUbh;
+    Handle<HwSamplerBuffer> mDummyMorphTargetsSbh;
 };
 
 FILAMENT_UPCAST(RenderableManager)
@@ -211,6 +273,7 @@ FILAMENT_UPCAST(RenderableManager)
 void FRenderableManager::setAxisAlignedBoundingBox(Instance instance, const Box& aabb) noexcept {
     if (instance) {
         mManager[instance].aabb = aabb;
+        recordChange(instance);
     }
 }
 
@@ -219,12 +282,14 @@ void FRenderableManager::setLayerMask(Instance instance,
     if (instance) {
         uint8_t& layers = mManager[instance].layers;
         layers = (layers & ~select) | (values & select);
+        recordChange(instance);
     }
 }
 
 void FRenderableManager::setLayerMask(Instance instance, uint8_t layerMask) noexcept {
     if (instance) {
         mManager[instance].layers = layerMask;
+        recordChange(instance);
     }
 }
 
@@ -232,6 +297,7 @@ void FRenderableManager::setPriority(Instance instance, uint8_t priority) noexce
     if (instance) {
         Visibility& visibility = mManager[instance].visibility;
         visibility.priority = priority;
+        recordChange(instance);
     }
 }
 
@@ -239,6 +305,7 @@ void FRenderableManager::setCastShadows(Instance instance, bool enable) noexcept
     if (instance) {
         Visibility& visibility = mManager[instance].visibility;
         visibility.castShadows = enable;
+        recordChange(instance);
     }
 }
 
@@ -246,6 +313,15 @@ void FRenderableManager::setReceiveShadows(Instance instance, bool enable) noexc
     if (instance) {
         Visibility& visibility = mManager[instance].visibility;
         visibility.receiveShadows = enable;
+        recordChange(instance);
+    }
+}
+
+void FRenderableManager::setStaticShadowCaster(Instance instance, bool enable) noexcept {
+    if (instance) {
+        Visibility& visibility = mManager[instance].visibility;
+        visibility.staticShadowCaster = enable;
+        recordChange(instance);
     }
 }
 
@@ -253,13 +329,15 @@ void FRenderableManager::setCulling(Instance instance, bool enable) noexcept {
     if (instance) {
         Visibility& visibility = mManager[instance].visibility;
         visibility.culling = enable;
+        recordChange(instance);
     }
 }
 
-void FRenderableManager::setUniformHandle(Instance instance,
-        Handle<HwUniformBuffer> const& handle) noexcept {
+void FRenderableManager::setBackground(Instance instance, bool enable) noexcept {
     if (instance) {
-        mManager[instance].uniformsHandle = handle;
+        Visibility& visibility = mManager[instance].visibility;
+        visibility.background = enable;
+        recordChange(instance);
     }
 }
 
@@ -270,6 +348,16 @@ void FRenderableManager::setPrimitives(Instance instance,
     }
 }
 
+void FRenderableManager::setLevelsOfDetail(Instance instance,
+        float const* screenSizes, size_t levelCount) noexcept {
+    if (instance) {
+        LevelsOfDetail& lod = mManager[instance].levelsOfDetail;
+        assert(levelCount >= 1 && levelCount <= MAX_LEVEL_OF_DETAIL_COUNT);
+        std::copy_n(screenSizes, levelCount - 1, lod.screenSizes);
+        lod.count = uint8_t(levelCount);
+    }
+}
+
 FRenderableManager::Visibility
 FRenderableManager::getVisibility(Instance instance) const noexcept {
     return mManager[instance].visibility;
@@ -283,6 +371,10 @@ bool FRenderableManager::isShadowReceiver(Instance instance) const noexcept {
     return getVisibility(instance).receiveShadows;
 }
 
+bool FRenderableManager::isStaticShadowCaster(Instance instance) const noexcept {
+    return getVisibility(instance).staticShadowCaster;
+}
+
 bool FRenderableManager::isCullingEnabled(Instance instance) const noexcept {
     return getVisibility(instance).culling;
 }
@@ -307,23 +399,42 @@ UniformBuffer& FRenderableManager::getUniformBuffer(Instance instance) noexcept
     return mManager[instance].uniforms;
 }
 
-Handle<HwUniformBuffer> FRenderableManager::getUbh(Instance instance) const noexcept {
-    return mManager[instance].uniformsHandle;
+Handle<HwUniformBuffer> FRenderableManager::getBonesUbh(Instance instance) const noexcept {
+    std::unique_ptr<Bones> const& bones = mManager[instance].bones;
+    if (bones) {
+        return bones->handle;
+    }
+    std::unique_ptr<Morphing> const& morphing = mManager[instance].morphing;
+    return morphing ? mDummyBonesUbh : Handle<HwUniformBuffer>{};
 }
 
-Handle<HwUniformBuffer> FRenderableManager::getBonesUbh(Instance instance) const noexcept {
+uint32_t FRenderableManager::getBonesOffset(Instance instance) const noexcept {
     std::unique_ptr<Bones> const& bones = mManager[instance].bones;
-    return bones ? bones->handle : Handle<HwUniformBuffer>{};
+    return bones ? uint32_t(bones->offset * sizeof(Bone)) : 0;
 }
 
-utils::Slice<FRenderPrimitive> const& FRenderableManager::getRenderPrimitives(
-        Instance instance, uint8_t level) const noexcept {
-    return mManager[instance].primitives;
+Handle<HwUniformBuffer> FRenderableManager::getMorphingUbh(Instance instance) const noexcept {
+    std::unique_ptr<Morphing> const& morphing = mManager[instance].morphing;
+    return morphing ? morphing->handle : mDummyMorphingUbh;
 }
 
-utils::Slice<FRenderPrimitive>& FRenderableManager::getRenderPrimitives(
-        Instance instance, uint8_t level) noexcept {
-    return mManager[instance].primitives;
+Handle<HwSamplerBuffer> FRenderableManager::getMorphTargetsSbh(Instance instance) const noexcept {
+    std::unique_ptr<Morphing> const& morphing = mManager[instance].morphing;
+    return morphing ? morphing->buffer->getHwHandle() : mDummyMorphTargetsSbh;
+}
+
+size_t FRenderableManager::getLevelCount(Instance instance) const noexcept {
+    LevelsOfDetail const& lod = mManager[instance].levelsOfDetail;
+    return lod.count;
+}
+
+uint8_t FRenderableManager::getLevelOfDetail(Instance instance, float screenSize) const noexcept {
+    LevelsOfDetail const& lod = mManager[instance].levelsOfDetail;
+    uint8_t level = 0;
+    while (level + 1 < lod.count && screenSize < lod.screenSizes[level]) {
+        level++;
+    }
+    return level;
 }
 
 size_t FRenderableManager::getPrimitiveCount(Instance instance, uint8_t level) const noexcept {
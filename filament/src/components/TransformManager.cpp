@@ -16,13 +16,23 @@
 
 #include "components/TransformManager.h"
 
+#include <utils/JobSystem.h>
+
+#include <algorithm>
+#include <functional>
+
 using namespace utils;
 using namespace math;
 
 namespace filament {
 namespace details {
 
-FTransformManager::FTransformManager() noexcept = default;
+// Below this many components, committing a transaction isn't worth spreading across jobs.
+static constexpr size_t PARALLEL_COMMIT_THRESHOLD = 1024;
+
+FTransformManager::FTransformManager(JobSystem* jobSystem) noexcept
+        : mJobSystem(jobSystem) {
+}
 
 FTransformManager::~FTransformManager() noexcept = default;
 
@@ -53,6 +63,9 @@ void FTransformManager::create(Entity entity, Instance parent, const mat4f& loca
         insertNode(i, parent);
         setTransform(i, localTransform);
     }
+
+    // scenes containing this entity must pick-up the new component
+    mChangeJournal.invalidate();
 }
 
 void FTransformManager::setParent(Instance i, Instance parent) noexcept {
@@ -92,6 +105,8 @@ void FTransformManager::destroy(Entity e) noexcept {
         if (moved != i) {
             updateNode(i);
         }
+
+        mChangeJournal.invalidate();
     }
 }
 
@@ -105,6 +120,44 @@ void FTransformManager::setTransform(Instance ci, const mat4f& model) noexcept {
     }
 }
 
+template<typename T>
+void FTransformManager::setTransforms(Instance const* instances, size_t count, T getTransform)
+        noexcept {
+    if (mLocalTransformTransactionOpen) {
+        // the world transforms are computed by commitLocalTransformTransaction(), so we only
+        // need to store the local transforms
+        auto& soa = mManager.getSoA();
+        for (size_t k = 0; k < count; k++) {
+            Instance ci = instances[k];
+            validateNode(ci);
+            if (ci) {
+                soa.elementAt<LOCAL>(ci) = getTransform(k);
+            }
+        }
+    } else {
+        for (size_t k = 0; k < count; k++) {
+            setTransform(instances[k], getTransform(k));
+        }
+    }
+}
+
+void FTransformManager::setTransforms(Instance const* instances, mat4f const* localTransforms,
+        size_t count) noexcept {
+    setTransforms(instances, count, [localTransforms](size_t k) -> mat4f const& {
+        return localTransforms[k];
+    });
+}
+
+void FTransformManager::setTransforms(Instance const* instances, float3 const* affineTransforms,
+        size_t count) noexcept {
+    setTransforms(instances, count, [affineTransforms](size_t k) {
+        float3 const* columns = affineTransforms + k * 4;
+        return mat4f{
+                float4{ columns[0], 0 }, float4{ columns[1], 0 },
+                float4{ columns[2], 0 }, float4{ columns[3], 1 }};
+    });
+}
+
 void FTransformManager::updateNodeTransform(Instance i) noexcept {
     validateNode(i);
     auto& manager = mManager;
@@ -124,17 +177,19 @@ void FTransformManager::updateNodeTransform(Instance i) noexcept {
     }
 
     // find our parent's world transform, if any
-    // note: by using the raw_array() we don't need to check that parent is valid.
+    // note: by using the SoA directly we don't need to check that parent is valid, the dummy
+    // component at index 0 is the identity.
     Instance parent = manager[i].parent;
-    mat4f const& pt = manager.raw_array<WORLD>()[parent];
+    mat4f const& pt = manager.getSoA().elementAt<WORLD>(parent);
 
     // compute our world transform
     manager[i].world = pt * static_cast<mat4f const&>(manager[i].local);
+    mChangeJournal.record(manager.getEntity(i));
 
     // update our children's world transforms
     Instance child = manager[i].firstChild;
     if (UTILS_UNLIKELY(child)) { // assume we don't have a hierarchy in the common case
-        transformChildren(manager, child);
+        transformChildren(manager, mChangeJournal, child);
     }
 }
 
@@ -151,15 +206,87 @@ void FTransformManager::commitLocalTransformTransaction() noexcept {
         auto& soa = manager.getSoA();
         soa.ensureCapacity(soa.size() + 1);
 
-        mat4f const* const UTILS_RESTRICT world = manager.raw_array<WORLD>();
-        for (Instance i = manager.begin(), e = manager.end(); i != e; ++i) {
-            // Ensure that children are always sorted after their parent.
-            if (UTILS_UNLIKELY(Instance(manager[i].parent) > i)) {
-                swapNode(i, manager[i].parent);
+        if (mJobSystem && manager.getComponentCount() >= PARALLEL_COMMIT_THRESHOLD) {
+            updateWorldTransformsParallel();
+        } else {
+            for (Instance i = manager.begin(), e = manager.end(); i != e; ++i) {
+                // Ensure that children are always sorted after their parent.
+                if (UTILS_UNLIKELY(Instance(manager[i].parent) > i)) {
+                    swapNode(i, manager[i].parent);
+                }
+                Instance parent = manager[i].parent;
+                assert(parent < i);
+                manager[i].world = soa.elementAt<WORLD>(parent) *
+                        static_cast<mat4f const&>(manager[i].local);
             }
-            Instance parent = manager[i].parent;
-            assert(parent < i);
-            manager[i].world = world[parent] * static_cast<mat4f const&>(manager[i].local);
+        }
+
+        // all world transforms have been updated and some instances have moved
+        mChangeJournal.invalidate();
+    }
+}
+
+/*
+ * Same as the serial loop in commitLocalTransformTransaction(), but the world transforms are
+ * computed one level of the hierarchy at a time: all nodes of a level only depend on nodes of the
+ * previous levels, so each level is processed with a parallel_for.
+ */
+void FTransformManager::updateWorldTransformsParallel() noexcept {
+    auto& manager = mManager;
+    auto& soa = manager.getSoA();
+    const size_t end = manager.end();
+
+    // Ensure that children are always sorted after their parent, which lets us compute the
+    // depth of each node in a single pass. The dummy component at index 0 is the root.
+    std::vector<uint32_t>& depth = mDepth;
+    depth.resize(end);
+    depth[0] = 0;
+    uint32_t maxDepth = 0;
+    for (Instance i = manager.begin(), e = manager.end(); i != e; ++i) {
+        if (UTILS_UNLIKELY(Instance(manager[i].parent) > i)) {
+            swapNode(i, manager[i].parent);
+        }
+        Instance parent = manager[i].parent;
+        assert(parent < i);
+        depth[i] = depth[parent] + 1;
+        maxDepth = std::max(maxDepth, depth[i]);
+    }
+
+    // bucket the nodes by depth, keeping them in instance order within a level
+    std::vector<uint32_t> levelStart(maxDepth + 2, 0);
+    for (Instance i = manager.begin(), e = manager.end(); i != e; ++i) {
+        levelStart[depth[i] + 1]++;
+    }
+    for (size_t level = 1; level < levelStart.size(); level++) {
+        levelStart[level] += levelStart[level - 1];
+    }
+    std::vector<Instance>& instances = mInstancesByDepth;
+    instances.resize(end);
+    for (Instance i = manager.begin(), e = manager.end(); i != e; ++i) {
+        instances[levelStart[depth[i]]++] = i;
+    }
+    // levelStart[level] is now the start of the next level
+
+    JobSystem& js = *mJobSystem;
+    Instance const* const levelInstances = instances.data();
+    auto transform = [&soa, levelInstances](uint32_t start, uint32_t count) {
+        for (uint32_t k = start, e = start + count; k < e; k++) {
+            const Instance i = levelInstances[k];
+            const Instance parent = soa.elementAt<PARENT>(i);
+            soa.elementAt<WORLD>(i) = soa.elementAt<WORLD>(parent) * soa.elementAt<LOCAL>(i);
+        }
+    };
+
+    // the root level (depth 0) is the dummy component, it's never in the list
+    for (uint32_t level = 1; level <= maxDepth; level++) {
+        const uint32_t start = levelStart[level - 1];
+        const uint32_t count = levelStart[level] - start;
+        if (count < PARALLEL_COMMIT_THRESHOLD) {
+            transform(start, count);
+        } else {
+            auto job = jobs::parallel_for(js, nullptr, start, count,
+                    std::cref(transform), jobs::CountSplitter<256, 5>());
+            js.runAndWait(job);
         }
     }
 }
@@ -283,18 +410,20 @@ void FTransformManager::updateNode(Instance i) noexcept {
     validateNode(next);
 }
 
-void FTransformManager::transformChildren(Sim& manager, Instance ci) noexcept {
+void FTransformManager::transformChildren(Sim& manager, ChangeJournal& journal,
+        Instance ci) noexcept {
     while (ci) {
         // update child's world transform
         Instance parent = manager[ci].parent;
         mat4f const& pt = manager[parent].world;
         mat4f const& local = manager[ci].local;
         manager[ci].world = pt * local;
+        journal.record(manager.getEntity(ci));
 
         // assume we don't have a deep hierarchy
         Instance child = manager[ci].firstChild;
         if (UTILS_UNLIKELY(child)) {
-            transformChildren(manager, child);
+            transformChildren(manager, journal, child);
         }
 
         // process our next child
@@ -380,6 +509,16 @@ void TransformManager::setTransform(Instance ci, const mat4f& model) noexcept {
     upcast(this)->setTransform(ci, model);
 }
 
+void TransformManager::setTransforms(Instance const* instances, mat4f const* localTransforms,
+        size_t count) noexcept {
+    upcast(this)->setTransforms(instances, localTransforms, count);
+}
+
+void TransformManager::setTransforms(Instance const* instances, float3 const* affineTransforms,
+        size_t count) noexcept {
+    upcast(this)->setTransforms(instances, affineTransforms, count);
+}
+
 const mat4f& TransformManager::getTransform(Instance ci) const noexcept {
     return upcast(this)->getTransform(ci);
 }
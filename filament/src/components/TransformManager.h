@@ -19,6 +19,8 @@
 
 #include "upcast.h"
 
+#include "details/ChangeJournal.h"
+
 #include <filament/TransformManager.h>
 
 #include <utils/compiler.h>
@@ -28,6 +30,12 @@
 
 #include <math/mat4.h>
 
+#include <vector>
+
+namespace utils {
+class JobSystem;
+} // namespace utils
+
 namespace filament {
 namespace details {
 
@@ -35,7 +43,9 @@ class UTILS_PRIVATE FTransformManager : public TransformManager {
 public:
     using Instance = TransformManager::Instance;
 
-    FTransformManager() noexcept;
+    // jobSystem, if provided, is used to compute the world transforms in parallel when a local
+    // transform transaction is committed.
+    explicit FTransformManager(utils::JobSystem* jobSystem = nullptr) noexcept;
     ~FTransformManager() noexcept;
 
     // free-up all resources
@@ -66,14 +76,20 @@ public:
 
     void commitLocalTransformTransaction() noexcept;
 
-    void gc(utils::EntityManager& em) noexcept;
-
-    utils::Slice<const math::mat4f> getWorldTransforms() const noexcept {
-        return mManager.slice<WORLD>();
+    size_t getMemorySize() const noexcept {
+        return mManager.getMemorySize();
     }
 
+    void gc(utils::EntityManager& em) noexcept;
+
     void setTransform(Instance ci, const math::mat4f& model) noexcept;
 
+    void setTransforms(Instance const* instances, math::mat4f const* localTransforms,
+            size_t count) noexcept;
+
+    void setTransforms(Instance const* instances, math::float3 const* affineTransforms,
+            size_t count) noexcept;
+
     const math::mat4f& getTransform(Instance ci) const noexcept {
         return mManager[ci].local;
     }
@@ -82,6 +98,10 @@ public:
         return mManager[ci].world;
     }
 
+    // entities whose world transform changed
+    ChangeJournal const& getChangeJournal() const noexcept { return mChangeJournal; }
+    void trimChangeJournal() noexcept { mChangeJournal.trim(); }
+
 private:
     struct Sim;
 
@@ -91,7 +111,10 @@ private:
     void updateNodeTransform(Instance i) noexcept;
     void insertNode(Instance i, Instance p) noexcept;
     void swapNode(Instance i, Instance j) noexcept;
-    static void transformChildren(Sim& manager, Instance firstChild) noexcept;
+    void updateWorldTransformsParallel() noexcept;
+    template<typename T>
+    void setTransforms(Instance const* instances, size_t count, T getTransform) noexcept;
+    static void transformChildren(Sim& manager, ChangeJournal& journal, Instance firstChild) noexcept;
 
 
     enum {
@@ -103,7 +126,7 @@ private:
         PREV,           // instance to our previous sibling
     };
 
-    using Base = utils::SingleInstanceComponentManager<
+    using Base = utils::ChunkedSingleInstanceComponentManager<
             math::mat4f,
             math::mat4f,
             Instance,
@@ -144,6 +167,10 @@ private:
     };
 
     Sim mManager;
+    ChangeJournal mChangeJournal;
+    utils::JobSystem* mJobSystem = nullptr;
+    std::vector<uint32_t> mDepth;               // scratch for the parallel transaction commit
+    std::vector<Instance> mInstancesByDepth;    // scratch for the parallel transaction commit
     bool mLocalTransformTransactionOpen = false;
 };
 
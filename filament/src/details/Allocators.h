@@ -23,8 +23,9 @@ namespace filament {
 namespace details {
 
 // per render pass allocations
-// Froxelization needs about 1 MiB. Command buffer needs about 1 MiB.
-static constexpr size_t CONFIG_PER_RENDER_PASS_ARENA_SIZE    = 2 * 1024 * 1024;
+// Froxelization needs about 1 MiB. Command buffer needs about 1 MiB, and up to as much again
+// temporarily, for sorting it.
+static constexpr size_t CONFIG_PER_RENDER_PASS_ARENA_SIZE    = 3 * 1024 * 1024;
 
 // size of the high-level draw commands buffer (comes from the per-render pass allocator)
 static constexpr size_t CONFIG_PER_FRAME_COMMANDS_SIZE = 1 * 1024 * 1024;
@@ -33,29 +34,17 @@ static constexpr size_t CONFIG_PER_FRAME_COMMANDS_SIZE = 1 * 1024 * 1024;
 static constexpr size_t CONFIG_MIN_COMMAND_BUFFERS_SIZE = 1 * 1024 * 1024;
 static constexpr size_t CONFIG_COMMAND_BUFFERS_SIZE     = 3 * CONFIG_MIN_COMMAND_BUFFERS_SIZE;
 
-#ifndef NDEBUG
-
 using HeapAllocatorArena = utils::Arena<
         utils::HeapAllocator,
         utils::LockingPolicy::NoLock>;
 
+// The per render pass arena falls back to the heap when it's exhausted, its high watermark is
+// tracked in all builds, it's reported by Renderer::getFrameMemoryStatistics().
 using LinearAllocatorArena = utils::Arena<
-        utils::LinearAllocator,
+        utils::LinearAllocatorWithFallback,
         utils::LockingPolicy::NoLock,
         utils::TrackingPolicy::HighWatermark>;
 
-#else
-
-using HeapAllocatorArena = utils::Arena<
-        utils::HeapAllocator,
-        utils::LockingPolicy::NoLock>;
-
-using LinearAllocatorArena = utils::Arena<
-        utils::LinearAllocator,
-        utils::LockingPolicy::NoLock>;
-
-#endif
-
 using ArenaScope = utils::ArenaScope<LinearAllocatorArena>;
 
 } // namespace details
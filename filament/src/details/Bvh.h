@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DETAILS_BVH_H
+#define TNT_FILAMENT_DETAILS_BVH_H
+
+#include "details/Culler.h"
+
+#include <filament/Box.h>
+
+#include <utils/compiler.h>
+
+#include <math/vec3.h>
+
+#include <vector>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+namespace details {
+
+/*
+ * A bounding volume hierarchy over an array of AABBs (stored as center/half-extent arrays,
+ * like in FScene::RenderableSoa), used to reject whole ranges of boxes during culling.
+ *
+ * Each node covers a contiguous range of boxes, which requires the boxes to be reordered when
+ * the hierarchy is built (see build()). Ranges always start on a multiple of Culler::MODULO, so
+ * the Culler kernels can process the leaves independently.
+ *
+ * When boxes move, the hierarchy is refit (its structure doesn't change), which is cheap but
+ * degrades its quality over time, so it is best suited for boxes that mostly don't move.
+ */
+class Bvh {
+public:
+    // maximum number of boxes in a leaf, must be a multiple of Culler::MODULO
+    static constexpr size_t LEAF_SIZE = Culler::MODULO * 8;
+
+    struct Node {
+        Aabb aabb;
+        uint32_t first;     // first box covered by this node
+        uint32_t count;     // number of boxes covered by this node
+        uint32_t right;     // right child or 0 for leaves (the left child always follows its parent)
+        uint32_t parent;
+    };
+
+    void clear() noexcept;
+
+    /*
+     * Builds the hierarchy over 'count' boxes. On return, 'order' contains the index of the box
+     * that must be stored at each position before calling refit() or traverse().
+     */
+    void build(math::float3 const* center, math::float3 const* extent, size_t count,
+            std::vector<uint32_t>& order);
+
+    // box at 'index' has changed, the hierarchy will be updated on the next refit()
+    void invalidate(size_t index) noexcept;
+
+    // recomputes the bounds of the nodes containing boxes that have changed
+    void refit(math::float3 const* center, math::float3 const* extent) noexcept;
+
+    size_t getBoxCount() const noexcept { return mLeafOf.size(); }
+    bool empty() const noexcept { return mNodes.empty(); }
+
+    /*
+     * Walks the hierarchy, 'intersects(Box)' is called for each visited node, then
+     * 'leaf(first, count)' is called for each leaf which may be visible, and
+     * 'reject(first, count)' for each range of boxes that are not.
+     */
+    template<typename INTERSECTS, typename LEAF, typename REJECT>
+    void traverse(INTERSECTS&& intersects, LEAF&& leaf, REJECT&& reject) const {
+        if (UTILS_UNLIKELY(mNodes.empty())) {
+            return;
+        }
+        // the tree is balanced, so its depth is at most log2 of the box count
+        uint32_t stack[64];
+        size_t top = 0;
+        stack[top++] = 0;
+        Node const* const UTILS_RESTRICT nodes = mNodes.data();
+        while (top) {
+            Node const& node = nodes[stack[--top]];
+            Box box;
+            box.set(node.aabb.min, node.aabb.max);
+            if (!intersects(box)) {
+                reject(node.first, node.count);
+            } else if (node.right == 0) {
+                leaf(node.first, node.count);
+            } else {
+                assert(top + 2 <= sizeof(stack) / sizeof(stack[0]));
+                stack[top++] = node.right;
+                stack[top++] = uint32_t(&node - nodes) + 1;
+            }
+        }
+    }
+
+private:
+    uint32_t build(math::float3 const* center, math::float3 const* extent,
+            uint32_t* order, uint32_t first, uint32_t count, uint32_t parent);
+    static Aabb computeBounds(math::float3 const* center, math::float3 const* extent,
+            uint32_t const* order, size_t count) noexcept;
+
+    std::vector<Node> mNodes;           // nodes in depth-first order
+    std::vector<uint32_t> mLeafOf;      // box index to leaf node index
+    std::vector<bool> mDirty;           // nodes that need to be refit
+    bool mHasDirtyNodes = false;
+};
+
+} // namespace details
+} // namespace filament
+
+#endif // TNT_FILAMENT_DETAILS_BVH_H
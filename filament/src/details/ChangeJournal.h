@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DETAILS_CHANGEJOURNAL_H
+#define TNT_FILAMENT_DETAILS_CHANGEJOURNAL_H
+
+#include <utils/compiler.h>
+#include <utils/Entity.h>
+#include <utils/Slice.h>
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+namespace details {
+
+/*
+ * A ChangeJournal records the entities whose component data changed, so that consumers
+ * (e.g.: FScene) can patch their own copy of that data instead of gathering it again.
+ *
+ * Each entry has a position that increases monotonically, consumers keep track of the position
+ * they have seen last. When entries a consumer hasn't seen yet are dropped (see invalidate()
+ * and trim()), since() fails and the consumer must gather all its data again.
+ */
+class ChangeJournal {
+public:
+    using Position = uint64_t;
+
+    // past this many entries, it's cheaper for consumers to gather everything again
+    static constexpr size_t MAX_ENTRY_COUNT = 65536;
+
+    // records that the data of the given entity changed
+    void record(utils::Entity e) noexcept {
+        if (UTILS_LIKELY(mEntries.size() < MAX_ENTRY_COUNT)) {
+            mEntries.push_back(e);
+        } else {
+            invalidate();
+        }
+    }
+
+    // records a change that can't be expressed per entity, for instance when a component is
+    // added or removed (which can invalidate existing Instances).
+    void invalidate() noexcept {
+        mBase += mEntries.size() + 1;
+        mEntries.clear();
+    }
+
+    // drops all entries, consumers which have seen all of them are not affected.
+    void trim() noexcept {
+        mBase += mEntries.size();
+        mEntries.clear();
+    }
+
+    // position past the last recorded entry
+    Position end() const noexcept {
+        return mBase + mEntries.size();
+    }
+
+    // returns the entities recorded since 'position', or false if some of them were dropped.
+    bool since(Position position, utils::Slice<const utils::Entity>& entities) const noexcept {
+        if (UTILS_UNLIKELY(position < mBase)) {
+            return false;
+        }
+        size_t first = size_t(position - mBase);
+        entities = { mEntries.data() + first, mEntries.data() + mEntries.size() };
+        return true;
+    }
+
+private:
+    std::vector<utils::Entity> mEntries;
+    // starts at 1, so that a new consumer (at position 0) always gathers everything first
+    Position mBase = 1;
+};
+
+} // namespace details
+} // namespace filament
+
+#endif // TNT_FILAMENT_DETAILS_CHANGEJOURNAL_H
@@ -49,7 +49,8 @@ public:
     using result_type = uint8_t;
 
     /*
-     * returns whether each AABB in an array intersects with the furstum
+     * returns whether each AABB in an array intersects with the furstum, the result is stored
+     * in 'bit', all other bits of 'results' are cleared.
      */
     static void intersects(result_type* results,
             Frustum const& frustum,
@@ -57,6 +58,18 @@ public:
             math::float3 const* extent,
             size_t count, size_t bit) noexcept;
 
+    /*
+     * returns whether each AABB in an array intersects with two frustums, in a single pass over
+     * the AABBs. The results are stored in 'bit0' and 'bit1' respectively, all other bits of
+     * 'results' are cleared.
+     */
+    static void intersects(result_type* results,
+            Frustum const& frustum0,
+            Frustum const& frustum1,
+            math::float3 const* center,
+            math::float3 const* extent,
+            size_t count, size_t bit0, size_t bit1) noexcept;
+
     /*
      * returns whether each shpere in an array intersects with the furstum
      */
@@ -19,9 +19,16 @@
 
 #include "details/Texture.h"
 
+#include "SharedResources.h"
+
 #include "driver/Handle.h"
 
+#include <math/vec2.h>
+
 #include <utils/compiler.h>
+#include <utils/JobSystem.h>
+
+#include <memory>
 
 namespace filament {
 namespace details {
@@ -31,19 +38,28 @@ class FTexture;
 
 class DFG {
 public:
-    explicit DFG(FEngine& engine) noexcept;
+    static constexpr size_t DEFAULT_LUT_SIZE = 128;
+    static constexpr size_t MIN_LUT_SIZE = 16;
+    static constexpr size_t MAX_LUT_SIZE = 512;
+
+    // The size is clamped to [MIN_LUT_SIZE, MAX_LUT_SIZE].
+    explicit DFG(FEngine& engine, size_t lutSize = DEFAULT_LUT_SIZE) noexcept;
 
     size_t getLutSize() const noexcept {
-        return DFG_LUT_SIZE;
+        return mLutSize;
     }
 
     bool isValid() const noexcept {
-        return mLUT != nullptr;
+        return mLutSize != 0;
     }
 
-    Handle<HwTexture> getTexture() const noexcept {
-        return mLUT->getHwHandle();
-    }
+    // Starts computing the LUT with the job system, doesn't need the driver. The LUT is shared
+    // with the other engines, only the first one computes it.
+    void prepare() noexcept;
+
+    // The LUT is uploaded the first time it's needed, and computed then if prepare() wasn't
+    // called.
+    Handle<HwTexture> getTexture() noexcept;
 
     void terminate();
 
@@ -53,14 +69,13 @@ public:
     DFG& operator=(DFG&& rhs) = delete;
 
 private:
+    void generate(math::half2* lut) const noexcept;
+
     FEngine& mEngine;
     FTexture* mLUT = nullptr;
-
-    // make sure to use the right size here
-    static constexpr size_t DFG_LUT_SIZE = 128;
-
-    // this lookup table is generated with cmgen
-    static const uint16_t DFG_LUT[];
+    std::shared_ptr<SharedResources::DfgLut> mData; // computed by prepare(), not uploaded yet
+    utils::JobSystem::Job* mJob = nullptr;          // only run to be waited on
+    const size_t mLutSize;
 };
 
 } // namespace details
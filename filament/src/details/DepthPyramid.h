@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DETAILS_DEPTHPYRAMID_H
+#define TNT_FILAMENT_DETAILS_DEPTHPYRAMID_H
+
+#include "RenderTargetPool.h"
+
+#include "details/Culler.h"
+
+#include <filament/Viewport.h>
+
+#include <math/mat4.h>
+#include <math/vec2.h>
+#include <math/vec3.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace filament {
+namespace details {
+
+class FEngine;
+
+/*
+ * The DepthPyramid is a hierarchical-Z buffer of a previous frame, used to cull the renderables
+ * hidden behind the geometry rendered in that frame.
+ *
+ * After the color pass, a post-process pass keeps the farthest depth of each TILE_SIZE x TILE_SIZE
+ * tile of the depth buffer, and the result is read back. When the read-back completes (usually
+ * a frame later), the coarser levels of the pyramid are built on the CPU, each texel keeping the
+ * farthest depth of the four texels below it.
+ *
+ * A box is occluded if it is entirely behind the farthest depth of the (at most four) texels
+ * which cover its projection, in the frame the pyramid comes from. Because the pyramid is always
+ * late, renderables which become visible can be missing for a frame or two.
+ */
+class DepthPyramid {
+public:
+    // must match DEPTH_TILE_SIZE in post_process.fs
+    static constexpr uint32_t TILE_SIZE = 16;
+
+    explicit DepthPyramid(FEngine& engine) noexcept;
+    ~DepthPyramid() noexcept;
+
+    DepthPyramid(DepthPyramid const& rhs) = delete;
+    DepthPyramid& operator=(DepthPyramid const& rhs) = delete;
+
+    // forgets the pending read-backs, their results are ignored
+    void terminate() noexcept;
+
+    // whether the depth can be read back with this backend
+    bool isSupported() const noexcept { return mSupported; }
+
+    // whether a pyramid has been read back, nothing is occluded until then
+    bool isValid() const noexcept { return mLevelCount > 0; }
+
+    // forgets the pyramid and the pending read-backs
+    void clear() noexcept;
+
+    // Reduces the depth buffer of the color pass and starts its read-back. 'source' must be
+    // a DEPTH_TEXTURE target, viewport is the area rendered in its lower-left corner and
+    // clipFromWorld the matrix used to render it.
+    void update(RenderTargetPool::Target const* source, Viewport const& viewport,
+            math::mat4f const& clipFromWorld) noexcept;
+
+    // Tests the boxes whose mask intersects 'testMask', and sets 'bit' in their mask if they
+    // are occluded. The other bits are left unchanged. This can be called from several threads.
+    void cull(Culler::result_type* results,
+            math::float3 const* center, math::float3 const* extent, size_t count,
+            Culler::result_type testMask, size_t bit) const noexcept;
+
+private:
+    // do not let the driver fall behind (the read-back is synchronous on some drivers)
+    static constexpr size_t MAX_PENDING_READBACKS = 2;
+    static constexpr size_t MAX_LEVEL_COUNT = 16;
+
+    // a read-back in flight, followed by its width * height RGBA8 pixels
+    struct Readback {
+        DepthPyramid* owner;
+        math::mat4f clipFromWorld;
+        math::float2 viewportSize;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    struct Level {
+        size_t offset;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    static void onReadback(void* buffer, size_t size, void* user);
+    void build(Readback const& readback, uint8_t const* pixels) noexcept;
+    bool isOccluded(math::float3 const& center, math::float3 const& extent) const noexcept;
+
+    FEngine& mEngine;
+    std::vector<Readback*> mPending;
+    std::vector<float> mDepths;
+    Level mLevels[MAX_LEVEL_COUNT];
+    size_t mLevelCount = 0;
+    math::mat4f mClipFromWorld;
+    math::float2 mViewportSize;
+    const bool mSupported;
+};
+
+} // namespace details
+} // namespace filament
+
+#endif // TNT_FILAMENT_DETAILS_DEPTHPYRAMID_H
@@ -18,8 +18,10 @@
 #define TNT_FILAMENT_DETAILS_ENGINE_H
 
 #include "upcast.h"
+#include "MipmapGenerator.h"
 #include "PostProcessManager.h"
 #include "RenderTargetPool.h"
+#include "TextureStreamer.h"
 
 #include "components/CameraManager.h"
 #include "components/LightManager.h"
@@ -29,7 +31,10 @@
 #include "details/Allocators.h"
 #include "details/Camera.h"
 #include "details/DebugRegistry.h"
+#include "details/IBLPrefilter.h"
+#include "details/LoaderContext.h"
 #include "details/ResourceList.h"
+#include "details/SceneLoader.h"
 #include "details/Skybox.h"
 
 #include "driver/CommandStream.h"
@@ -38,9 +43,13 @@
 
 #include <filament/Engine.h>
 #include <filament/VertexBuffer.h>
+#include <filament/IBLPrefilter.h>
 #include <filament/IndirectLight.h>
 #include <filament/Material.h>
+#include <filament/MorphTargetBuffer.h>
+#include <filament/SceneLoader.h>
 #include <filament/Texture.h>
+#include <filament/SkinningBuffer.h>
 #include <filament/Skybox.h>
 #include <filament/Stream.h>
 
@@ -55,7 +64,9 @@
 #include <math/mat4.h>
 #include <math/quat.h>
 
+#include <atomic>
 #include <chrono>
+#include <deque>
 #include <memory>
 #include <unordered_map>
 
@@ -69,8 +80,10 @@ namespace details {
 
 class FFence;
 class FMaterialInstance;
+class FMorphTargetBuffer;
 class FRenderer;
 class FScene;
+class FSkinningBuffer;
 class FSwapChain;
 class FView;
 
@@ -102,6 +115,8 @@ public:
     static constexpr float  CONFIG_Z_LIGHT_FAR             = 100;
     static constexpr size_t CONFIG_FROXEL_SLICE_COUNT      = 16;
     static constexpr bool   CONFIG_IBL_USE_IRRADIANCE_MAP  = false;
+    // number of frames a View's per-renderable uniform buffer is kept before being reused
+    static constexpr size_t CONFIG_PER_RENDERABLE_UBO_COUNT = 3;
 
     static constexpr size_t CONFIG_PER_RENDER_PASS_ARENA_SIZE   = details::CONFIG_PER_RENDER_PASS_ARENA_SIZE;
     static constexpr size_t CONFIG_PER_FRAME_COMMANDS_SIZE      = details::CONFIG_PER_FRAME_COMMANDS_SIZE;
@@ -117,12 +132,13 @@ public:
         math::mat4f clipFromViewMatrix;
         math::mat4f viewFromClipMatrix;
         math::mat4f clipFromWorldMatrix;
-        math::mat4f lightFromWorldMatrix;
+        math::mat4f lightFromWorldMatrix[CONFIG_MAX_SHADOW_CASCADES];
+        math::mat4f spotLightFromWorldMatrix[CONFIG_MAX_SHADOWED_SPOT_LIGHTS];
 
         math::float4 resolution; // width, height, 1/width, 1/height
 
         math::float3 cameraPosition;
-        float time; // time in seconds, with a 1 second period
+        float padding0;
 
         math::float4 lightColorIntensity; // directional light
 
@@ -131,9 +147,13 @@ public:
         math::float3 lightDirection;
         uint32_t fParamsX; // stride-x
 
-        math::float3 shadowBias; // constant bias, normal bias, unused
+        math::float3 shadowBias; // constant bias, normal bias, cascade count
         float oneOverFroxelDimensionY;
 
+        math::float4 cascadeSplits; // view-space far distance of each cascade
+        math::float4 cascadeConstantBias;
+        math::float4 cascadeNormalBias;
+
         math::float4 zParams; // froxel Z parameters
 
         math::uint2 fParams; // stride-y, stride-z
@@ -145,20 +165,49 @@ public:
         float ev100;
 
         alignas(16) math::float4 iblSH[9]; // actually float3 entries (std140 requires float4 alignment)
+
+        math::float4 spotShadowBias[CONFIG_MAX_SHADOWED_SPOT_LIGHTS]; // constant bias, normal bias scale
+
+        uint32_t lightBinning; // see Froxelizer::froxelizeAssignBins()
+        float iblRGBM; // 1 if the reflections are RGBM encoded, 0 if they're a float format
+
+        alignas(16) math::float4 iblRotation[3]; // environment from world, std140 mat3 layout
+
+        float shadowMoments; // 1 if the shadows are sampled from the EVSM moments, 0 for PCF
+    };
+
+    // the uniforms which change every frame, kept out of PerViewUib so that it's only uploaded
+    // when the view changes
+    struct PerFrameUib {
+        static UniformInterfaceBlock getUib() noexcept;
+        // IMPORTANT NOTE: Respect std140 layout, don't update without updating getUib()
+        float time; // time in seconds, with a 1 second period
     };
 
     struct PerRenderableUib {
         static UniformInterfaceBlock getUib() noexcept;
         // these fields are only used to call offsetof() and make it easy to visualize the UBO
-        math::mat4f worldFromModelMatrix;
+        math::float4 worldFromModelMatrix[3];   // first 3 rows of the (affine) transform
         math::mat3f worldFromModelNormalMatrix;
     };
 
+    struct PerRenderableInstancesUib {
+        static UniformInterfaceBlock getUib() noexcept;
+        // these fields are only used to call offsetof() and make it easy to visualize the UBO
+        math::float4 worldFromModelMatrix[CONFIG_MAX_INSTANCES][3]; // see PerRenderableUib
+        math::float4 worldFromModelNormalMatrix[CONFIG_MAX_INSTANCES][3]; // std140 mat3 layout
+    };
+
     struct PostProcessingUib {
         static UniformInterfaceBlock getUib() noexcept;
         math::float2 uvScale;
         float time;             // time in seconds, with a 1 second period, used for dithering
         float yOffset;
+        // see TemporalUpscaler
+        math::mat4f reprojection;   // previous clip space from current clip space, unjittered
+        math::float4 historyUv;     // scale and offset from the viewport to the history texture
+        math::float4 temporal;      // jitter in pixels, weight of the history, unused
+        math::float4 shadowTile;    // texels of the tile (left, bottom, right, top), see ShadowAtlas
     };
 
     struct PerViewSib {
@@ -169,18 +218,22 @@ public:
         static constexpr size_t FROXELS        = 2;
         static constexpr size_t IBL_DFG_LUT    = 3;
         static constexpr size_t IBL_SPECULAR   = 4;
-        static constexpr size_t IBL_IRRADIANCE = 5;
+        static constexpr size_t SHADOW_MOMENTS = 5;
     };
 
     struct PostProcessSib {
         static SamplerInterfaceBlock getSib() noexcept;
         // indices of each samplers in this SamplerInterfaceBlock (see: getSib())
         static constexpr size_t COLOR_BUFFER   = 0;
+        static constexpr size_t DEPTH_BUFFER   = 1;
+        static constexpr size_t HISTORY_BUFFER = 2;
+        static constexpr size_t REVEALAGE_BUFFER = 3;
     };
 
 public:
     static FEngine* create(Backend backend = Backend::DEFAULT,
-            ExternalContext* externalContext = nullptr, void* sharedGLContext = nullptr);
+            ExternalContext* externalContext = nullptr, void* sharedGLContext = nullptr,
+            BlobCache* blobCache = nullptr, size_t dfgLutSize = 128);
 
     ~FEngine() noexcept;
 
@@ -191,9 +244,19 @@ public:
 
     // Uniforms...
     const UniformInterfaceBlock& getPerViewUib() const noexcept { return mPerViewUib; }
+    const UniformInterfaceBlock& getPerFrameUib() const noexcept { return mPerFrameUib; }
     const UniformInterfaceBlock& getPerRenderableUib() const noexcept { return mPerRenderableUib; }
+    const UniformInterfaceBlock& getPerRenderableInstancesUib() const noexcept {
+        return mPerRenderableInstancesUib;
+    }
     const UniformInterfaceBlock& getPerPostProcessUib() const noexcept { return mPostProcessUib; }
 
+    // whether batches of draws sharing their buffers can be submitted with drawIndirect()
+    bool isDrawIndirectSupported() const noexcept { return mDrawIndirectSupported; }
+
+    // whether the compute post-process stages can be used, see isComputeStage()
+    bool isComputeSupported() const noexcept { return mComputeSupported; }
+
     // Samplers...
     const SamplerInterfaceBlock& getPerViewSib() const noexcept { return mPerViewSib; }
     const SamplerInterfaceBlock& getPostProcessSib() const noexcept { return mPostProcessSib; }
@@ -207,8 +270,15 @@ public:
     uint32_t getMaterialId() const noexcept { return mMaterialId++; }
 
     const FMaterial* getDefaultMaterial() const noexcept { return mDefaultMaterial; }
-    const FMaterial* getSkyboxMaterial(driver::TextureFormat format) const noexcept;
-    const FIndirectLight* getDefaultIndirectLight() const noexcept { return mDefaultIbl; }
+    // the format is ignored when irradiance is true, see Skybox::Builder::irradiance()
+    const FMaterial* getSkyboxMaterial(driver::TextureFormat format,
+            bool irradiance) const noexcept;
+    const FIndirectLight* getDefaultIndirectLight() const noexcept {
+        if (UTILS_UNLIKELY(!mDefaultIbl)) {
+            createDefaultIndirectLight();
+        }
+        return mDefaultIbl;
+    }
 
     Handle <HwProgram> getPostProcessProgramSlow(PostProcessStage stage) const noexcept;
     Handle<HwProgram> getPostProcessProgram(PostProcessStage stage) const noexcept {
@@ -219,15 +289,25 @@ public:
         return program;
     }
 
+    // the full-screen triangle is created the first time it's needed
     Handle<HwRenderPrimitive> getFullScreenRenderPrimitive() const noexcept {
+        if (UTILS_UNLIKELY(!mFullScreenTriangleRph)) {
+            createFullScreenTriangle();
+        }
         return mFullScreenTriangleRph;
     }
 
     FVertexBuffer* getFullScreenVertexBuffer() const noexcept {
+        if (UTILS_UNLIKELY(!mFullScreenTriangleVb)) {
+            createFullScreenTriangle();
+        }
         return mFullScreenTriangleVb;
     }
 
     FIndexBuffer* getFullScreenIndexBuffer() const noexcept {
+        if (UTILS_UNLIKELY(!mFullScreenTriangleIb)) {
+            createFullScreenTriangle();
+        }
         return mFullScreenTriangleIb;
     }
 
@@ -247,6 +327,14 @@ public:
         return mRenderTargetPool;
     }
 
+    TextureStreamer& getTextureStreamer() noexcept {
+        return mTextureStreamer;
+    }
+
+    MipmapGenerator& getMipmapGenerator() noexcept {
+        return mMipmapGenerator;
+    }
+
     FRenderableManager& getRenderableManager() noexcept {
         return mRenderableManager;
     }
@@ -279,8 +367,23 @@ public:
         return clock::now() - getEpoch();
     }
 
+    // incremented by each prepare(), i.e. once per frame
+    uint32_t getFrameCount() const noexcept {
+        return mFrameCount;
+    }
+
     void* streamAlloc(size_t size, size_t alignment) noexcept;
 
+    void setTextureUploadBudget(size_t bytesPerFrame) noexcept;
+
+    void setRenderTargetBudget(size_t bytes) noexcept;
+
+    void setTextureStreamingBudget(size_t bytes) noexcept;
+
+    void setReservedCores(uint32_t cpuMask) noexcept;
+    void warmup(Warmup const* materials, size_t count,
+            WarmupCallback callback, void* user) noexcept;
+
     utils::JobSystem& getJobSystem() noexcept { return mJobSystem; }
 
     Epoch getEpoch() const { return mEpoch; }
@@ -293,10 +396,14 @@ public:
     FVertexBuffer* createVertexBuffer(const VertexBuffer::Builder& builder) noexcept;
     FIndexBuffer* createIndexBuffer(const IndexBuffer::Builder& builder) noexcept;
     FIndirectLight* createIndirectLight(const IndirectLight::Builder& builder) noexcept;
+    FIBLPrefilter* createIBLPrefilter(const IBLPrefilter::Builder& builder) noexcept;
     FMaterial* createMaterial(const Material::Builder& builder) noexcept;
     FTexture* createTexture(const Texture::Builder& builder) noexcept;
     FSkybox* createSkybox(const Skybox::Builder& builder) noexcept;
     FStream* createStream(const Stream::Builder& builder) noexcept;
+    FSkinningBuffer* createSkinningBuffer(const SkinningBuffer::Builder& builder) noexcept;
+    FMorphTargetBuffer* createMorphTargetBuffer(const MorphTargetBuffer::Builder& builder) noexcept;
+    FSceneLoader* createSceneLoader(const SceneLoader::Builder& builder) noexcept;
 
     void createRenderable(const RenderableManager::Builder& builder, utils::Entity entity);
     void createLight(const LightManager::Builder& builder, utils::Entity entity);
@@ -308,26 +415,81 @@ public:
     FView* createView() noexcept;
     FCamera* createCamera(utils::Entity entity) noexcept;
     FFence* createFence(Fence::Type type = Fence::Type::SOFT) noexcept;
+    FLoaderContext* createLoaderContext() noexcept;
     FSwapChain* createSwapChain(void* nativeWindow, uint64_t flags) noexcept;
+    FSwapChain* createSwapChain(uint32_t width, uint32_t height, uint64_t flags) noexcept;
 
     void destroy(const FVertexBuffer* p);
     void destroy(const FFence* p);
     void destroy(const FIndexBuffer* p);
     void destroy(const FIndirectLight* p);
+    void destroy(const FIBLPrefilter* p);
+    void destroy(const FLoaderContext* p);
     void destroy(const FMaterial* p);
     void destroy(const FMaterialInstance* p);
     void destroy(const FRenderer* p);
     void destroy(const FScene* p);
+    void destroy(const FSceneLoader* p);
     void destroy(const FSkybox* p);
     void destroy(const FStream* p);
+    void destroy(const FSkinningBuffer* p);
+    void destroy(const FMorphTargetBuffer* p);
     void destroy(const FTexture* p);
     void destroy(const FSwapChain* p);
     void destroy(const FView* p);
     void destroy(utils::Entity e);
 
-    // flush the current buffer
+    // queues an object destroyed by gc(), within the deferred destroy budget
+    template<typename T>
+    void destroyDeferred(T const* p) {
+        if (p != nullptr) {
+            mDeferredDestroys.push_back({ p, &destroyObject<T> });
+        }
+    }
+    MemoryReport getMemoryReport() noexcept;
+
+    void setDeferredDestroyBudget(uint32_t microseconds) noexcept {
+        mDeferredDestroyBudget = std::chrono::microseconds(microseconds);
+    }
+
+    // destroys the queued objects, within the budget unless all is true. This issues driver
+    // commands, so it can't run in gc(), which runs in parallel with the main thread.
+    void destroyDeferredObjects(bool all) noexcept;
+
+    // flush the current buffer, once the commands recorded in the background are complete
     void flush();
 
+    // The parent of the jobs recording driver commands in the background, in ranges reserved in
+    // the current buffer (see RenderPass::recordDriverCommands()). flush() waits for them.
+    utils::JobSystem::Job* getRecordingJob() noexcept;
+    bool hasPendingRecording() const noexcept { return mRecordingJob != nullptr; }
+
+    // publishes the command buffer statistics of the last frame (see debug.commandbuffer)
+    void updateCommandBufferStatistics() noexcept;
+
+    // bytes flushed to the driver thread, the time it spent executing them and waiting for
+    // them, and the time the main thread waited for room in the command buffer, in ns, since the
+    // engine was created
+    uint64_t getFlushedBytes() const noexcept {
+        return mCommandBufferQueue.getStatistics().flushedBytes;
+    }
+    uint64_t getDriverThreadTime() const noexcept {
+        return mDriverThreadTime.load(std::memory_order_relaxed);
+    }
+    uint64_t getDriverThreadWaitTime() const noexcept {
+        return mDriverThreadWaitTime.load(std::memory_order_relaxed);
+    }
+    uint64_t getFlushStallTime() const noexcept {
+        return mCommandBufferQueue.getStatistics().stallTime;
+    }
+
+    // draws recorded by the render passes, reset by the renderers at the start of a frame
+    struct DrawStatistics {
+        uint32_t drawCount = 0;
+        uint32_t triangleCount = 0;
+    };
+    DrawStatistics& getDrawStatistics() noexcept { return mDrawStatistics; }
+
     void prepare();
     void gc();
 
@@ -344,8 +506,12 @@ public:
     }
 
 private:
-    FEngine(Backend backend, ExternalContext* externalContext, void* sharedGLContext);
+    FEngine(Backend backend, ExternalContext* externalContext, void* sharedGLContext,
+            BlobCache* blobCache, size_t dfgLutSize);
+    void preInit();
     void init();
+    void createFullScreenTriangle() const noexcept;
+    void createDefaultIndirectLight() const noexcept;
 
     int loop();
     void flushCommandBuffer(CommandBufferQueue& commandBufferQueue);
@@ -356,6 +522,11 @@ private:
     template<typename T, typename L>
     void cleanupResourceList(ResourceList<T, L>& list);
 
+    template<typename T>
+    static void destroyObject(FEngine& engine, void const* p) {
+        engine.destroy(static_cast<T const*>(p));
+    }
+
     Handle<HwProgram> createPostProcessProgram(filaflat::MaterialParser& parser,
             driver::ShaderModel model, PostProcessStage stage) const noexcept;
 
@@ -364,13 +535,20 @@ private:
     Backend mBackend;
     ExternalContext* mExternalContext = nullptr;
     void* mSharedGLContext = nullptr;
+    BlobCache* mBlobCache = nullptr;
+    bool mSharesProgramCache = false;   // mBlobCache is SharedResources' program cache
+    size_t mDfgLutSize;
     bool mTerminated = false;
-    Handle<HwRenderPrimitive> mFullScreenTriangleRph;
-    FVertexBuffer* mFullScreenTriangleVb = nullptr;
-    FIndexBuffer* mFullScreenTriangleIb = nullptr;
+    bool mDrawIndirectSupported = false;
+    bool mComputeSupported = false;
+    mutable Handle<HwRenderPrimitive> mFullScreenTriangleRph;
+    mutable FVertexBuffer* mFullScreenTriangleVb = nullptr;
+    mutable FIndexBuffer* mFullScreenTriangleIb = nullptr;
 
     PostProcessManager mPostProcessManager;
     RenderTargetPool mRenderTargetPool;
+    TextureStreamer mTextureStreamer;
+    MipmapGenerator mMipmapGenerator;
 
     utils::EntityManager& mEntityManager;
     FRenderableManager mRenderableManager;
@@ -384,13 +562,25 @@ private:
     ResourceList<FFence, utils::LockingPolicy::SpinLock> mFences{"Fence"};
     ResourceList<FSwapChain> mSwapChains{ "SwapChain" };
     ResourceList<FStream> mStreams{ "Stream" };
+    ResourceList<FSkinningBuffer> mSkinningBuffers{ "SkinningBuffer" };
+    ResourceList<FMorphTargetBuffer> mMorphTargetBuffers{ "MorphTargetBuffer" };
     ResourceList<FIndexBuffer> mIndexBuffers{ "IndexBuffer" };
     ResourceList<FVertexBuffer> mVertexBuffers{ "VertexBuffer" };
     ResourceList<FIndirectLight> mIndirectLights{ "IndirectLight" };
+    ResourceList<FIBLPrefilter> mIBLPrefilters{ "IBLPrefilter" };
+    ResourceList<FLoaderContext> mLoaderContexts{ "LoaderContext" };
+    ResourceList<FSceneLoader> mSceneLoaders{ "SceneLoader" };
     ResourceList<FMaterial> mMaterials{ "Material" };
     ResourceList<FTexture> mTextures{ "Texture" };
     ResourceList<FSkybox> mSkyboxes{ "Skybox" };
 
+    struct DeferredDestroy {
+        void const* object;
+        void (*destroy)(FEngine& engine, void const* object);
+    };
+    std::deque<DeferredDestroy> mDeferredDestroys;
+    std::chrono::microseconds mDeferredDestroyBudget{ 1000 };
+
     mutable uint32_t mMaterialId = 0;
 
     // FMaterialInstance are handled directly by FMaterial
@@ -400,9 +590,11 @@ private:
 
     // Per-view Uniform interface block
     UniformInterfaceBlock mPerViewUib;
+    UniformInterfaceBlock mPerFrameUib;
 
     // Per-Renderable Uniform interface block
     UniformInterfaceBlock mPerRenderableUib;
+    UniformInterfaceBlock mPerRenderableInstancesUib;
 
     // Per-view Sampler interface block
     SamplerInterfaceBlock mPerViewSib;
@@ -419,11 +611,12 @@ private:
     HeapAllocatorArena mHeapAllocator;
 
     utils::JobSystem mJobSystem;
+    utils::JobSystem::Job* mRecordingJob = nullptr;
 
     Epoch mEpoch;
 
     mutable FMaterial const* mDefaultMaterial = nullptr;
-    mutable FMaterial const* mSkyboxMaterials[2] = { nullptr, nullptr };
+    mutable FMaterial const* mSkyboxMaterials[3] = { nullptr, nullptr, nullptr };
 
     mutable FTexture* mDefaultIblTexture = nullptr;
     mutable FIndirectLight* mDefaultIbl = nullptr;
@@ -437,6 +630,12 @@ private:
     filaflat::ShaderBuilder mFragmentShaderBuilder;
     FDebugRegistry mDebugRegistry;
 
+    uint32_t mFrameCount = 0;
+    uint64_t mLastFrameFlushedBytes = 0;
+    std::atomic<uint64_t> mDriverThreadTime = { 0 };
+    std::atomic<uint64_t> mDriverThreadWaitTime = { 0 };
+    DrawStatistics mDrawStatistics;
+
 public:
     // these are the debug properties used by FDebug. They're accessed directly by modules who need them.
     struct {
@@ -447,6 +646,44 @@ public:
             float dzn = -1.0f;
             float dzf =  1.0f;
         } shadowmap;
+        // read-only, to tune the size of the command buffers
+        struct {
+            int high_watermark = 0;     // most KiB used in the circular buffer
+            int frame_size = 0;         // KiB flushed during the last frame
+            int stall_count = 0;        // number of flushes which waited for the driver thread
+            int stall_time = 0;         // total time spent waiting for the driver thread, in ms
+        } commandbuffer;
+        // read-only, state changes issued by the driver during the last finished frame
+        struct {
+            int state_changes_issued = 0;
+            int state_changes_skipped = 0;
+            int program_switches = 0;
+            int texture_switches = 0;
+        } driver;
+        // read-only, see RenderTargetPool::Statistics
+        struct {
+            int size = 0;               // KiB used by all the targets
+            int count = 0;              // number of targets
+            int hits = 0;               // targets reused during the last frame
+            int misses = 0;             // targets created during the last frame
+        } rendertargetpool;
+        // "phases" enables the PhaseProfiler, the other properties are read-only: the thousands of
+        // instructions, cycles, cache misses and stalled cycles of each phase of the last frame,
+        // and the allocations of all the phases (only counted with FILAMENT_TRACK_ALLOCATIONS)
+        struct {
+            bool phases = false;
+            int allocations = 0;
+            math::float4 scene_prepare;
+            math::float4 culling;
+            math::float4 froxelize;
+            math::float4 commands;
+            math::float4 sort;
+            math::float4 record;
+        } profiler;
+        // "compute" runs tone mapping and FXAA as a compute shader, when the driver supports it
+        struct {
+            bool compute = false;
+        } postprocess;
     } debug;
 };
 
@@ -28,17 +28,29 @@ class FEngine;
 
 class FrameSkipper {
 public:
+    // most frames the CPU can be ahead of the GPU, see SwapChain::setFrameLatency()
+    static constexpr size_t MAX_LATENCY = 4;
+
     explicit FrameSkipper(FEngine& engine, size_t latency = 2) noexcept;
     ~FrameSkipper() noexcept;
 
+    // Changes how many frames the GPU can be behind before frames are skipped, clamped to
+    // [1, MAX_LATENCY]. Must be called between frames.
+    void setLatency(size_t latency) noexcept;
+    size_t getLatency() const noexcept { return mLatency; }
+
     void endFrame() noexcept;
 
     bool skipFrameNeeded() const noexcept;
 
+    // Waits for the GPU instead of skipping a frame, for the frames that aren't displayed.
+    void waitForFrame() noexcept;
+
 private:
     FEngine& mEngine;
     mutable std::deque<FFence *> mFences;
     mutable int mExtraSkipCount = 0;
+    size_t mLatency;
 };
 
 } // namespace details
@@ -83,6 +83,10 @@ public:
 // froxels are not used, so we can store more.
 static constexpr size_t FROXEL_BUFFER_ENTRY_COUNT_MAX = 8192;
 
+// The number of froxels actually used is chosen at runtime from the viewport and light count,
+// but is never less than this.
+static constexpr size_t FROXEL_BUFFER_ENTRY_COUNT_MIN = 1024;
+
 class Froxelizer {
 public:
     explicit Froxelizer(FEngine& engine);
@@ -90,14 +94,24 @@ public:
 
     void terminate(driver::DriverApi& driverApi) noexcept;
 
-    // gpu buffer containing records. valid after construction.
+    // gpu buffer containing records. valid after construction. it's a storage buffer on the
+    // backends which support them, a texture otherwise.
     GPUBuffer const& getRecordBuffer() const noexcept { return mRecordsBuffer; }
 
-    // gpu buffer containing froxels. valid after construction.
+    // gpu buffer containing froxels. valid after construction, stored like the records.
     GPUBuffer const& getFroxelBuffer() const noexcept { return mFroxelBuffer; }
 
     void setOptions(float zLightNear, float zLightFar) noexcept;
 
+    // upper bound of the number of froxels, clamped to
+    // [FROXEL_BUFFER_ENTRY_COUNT_MIN, FROXEL_BUFFER_ENTRY_COUNT_MAX]
+    void setMaxFroxelCount(size_t maxFroxelCount) noexcept;
+
+    // per-tile light bitmasks and per-slice light ranges instead of per-froxel light lists,
+    // see froxelizeAssignBins()
+    void setLightBinning(bool enabled) noexcept;
+    bool isLightBinningEnabled() const noexcept { return mLightBinning; }
+
     /*
      * Allocate per-frame data structures for froxelization.
      *
@@ -107,11 +121,13 @@ public:
      * projection        camera projection matrix
      * projectionNear    near plane
      * projectionFar     far plane
+     * lightCount        number of point and spot lights, used to size the froxel grid
      *
      * return true if updateUniforms() needs to be called
      */
     bool prepare(driver::DriverApi& driverApi, ArenaScope& arena, Viewport const& viewport,
-            const math::mat4f& projection, float projectionNear, float projectionFar) noexcept;
+            const math::mat4f& projection, float projectionNear, float projectionFar,
+            size_t lightCount = CONFIG_MAX_LIGHT_COUNT) noexcept;
 
     Froxel getFroxelAt(size_t x, size_t y, size_t z) const noexcept;
     size_t getFroxelCountX() const noexcept { return mFroxelCountX; }
@@ -119,7 +135,9 @@ public:
     size_t getFroxelCountZ() const noexcept { return mFroxelCountZ; }
     size_t getFroxelCount() const noexcept { return mFroxelCount; }
 
-    // update Records and Froxels texture with lights data. this is thread-safe.
+    // Update Records and Froxels texture with lights data. this is thread-safe.
+    // Nothing is done if the lights, the camera and the froxel layout haven't changed since
+    // the last call, in which case the froxel and record buffers of this frame are left empty.
     void froxelizeLights(FEngine& engine, CameraInfo const& camera,
             const FScene::LightSoa& lightData) noexcept;
 
@@ -129,9 +147,10 @@ public:
         u.setUniform(offsetof(FEngine::PerViewUib, fParamsX), mParamsF.x);
         u.setUniform(offsetof(FEngine::PerViewUib, oneOverFroxelDimensionX), mOneOverDimension.x);
         u.setUniform(offsetof(FEngine::PerViewUib, oneOverFroxelDimensionY), mOneOverDimension.y);
+        u.setUniform(offsetof(FEngine::PerViewUib, lightBinning), uint32_t(mLightBinning));
     }
 
-    // send froxel data to GPU
+    // send froxel data to GPU, only the rows which changed since the last commit are sent
     void commit(driver::DriverApi& driverApi);
 
 
@@ -202,8 +221,17 @@ private:
     void froxelizeLoop(FEngine& engine,
             const CameraInfo& camera, const FScene::LightSoa& lightData) noexcept;
 
+    void froxelizeGatherRecords() noexcept;
+
     void froxelizeAssignRecordsCompress() noexcept;
 
+    void froxelizeAssignBins() noexcept;
+
+    size_t getFroxelBufferEntryCount() const noexcept;
+
+    static uint32_t computeInputsHash(CameraInfo const& camera,
+            const FScene::LightSoa& lightData) noexcept;
+
     void froxelizePointAndSpotLight(FroxelThreadData& froxelThread, size_t bit,
             math::mat4f const& projection, const LightParams& light) const noexcept;
 
@@ -219,9 +247,11 @@ private:
 
     std::pair<size_t, size_t> clipToIndices(math::float2 const& clip) const noexcept;
 
+    size_t computeFroxelBudget(Viewport const& viewport, size_t lightCount) const noexcept;
+
     static void computeFroxelLayout(
             math::uint2* dim, uint16_t* countX, uint16_t* countY, uint16_t* countZ,
-            Viewport const& viewport) noexcept;
+            Viewport const& viewport, size_t froxelBudget) noexcept;
 
     // internal state dependant on the viewport and needed for froxelizing
     LinearAllocatorArena mArena;                    // ~256 KiB
@@ -238,10 +268,24 @@ private:
     utils::Slice<RecordBufferType> mRecordBufferUser;   //  64 KiB
     utils::Slice<LightRecord> mLightRecords;            // 256 KiB w/ 256 lights
 
+    // copies of the froxel and record buffers last sent, to find the rows which changed
+    FroxelEntry* mFroxelBufferGpu = nullptr;            //  32 KiB
+    RecordBufferType* mRecordBufferGpu = nullptr;       //  64 KiB
+    uint32_t mFroxelBufferGpuRowCount = 0;              // rows of the copies that are valid
+    uint32_t mRecordBufferGpuRowCount = 0;
+
+    // hash of the lights and camera used for the last froxelization
+    uint32_t mInputsHash = 0;
+    bool mInputsHashValid = false;
+
     uint16_t mFroxelCountX = 0;
     uint16_t mFroxelCountY = 0;
     uint16_t mFroxelCountZ = 0;
     uint16_t mFroxelCount = 0;
+    uint16_t mFroxelBudget = 0;     // number of froxels the layout was computed for
+    uint16_t mMaxFroxelCount = FROXEL_BUFFER_ENTRY_COUNT_MAX;
+    bool mLightBinning = false;
+    uint32_t mRecordBufferEntryCount = 0;
     math::uint2 mFroxelDimension = {};
 
     math::mat4f mProjection;
@@ -20,6 +20,8 @@
 #include <driver/Handle.h>
 #include <driver/UniformBuffer.h>
 
+#include <math/half.h>
+#include <math/vec2.h>
 #include <math/vec4.h>
 
 namespace filament {
@@ -31,13 +33,23 @@ class GpuLightBuffer {
 public:
     using LightIndex = uint16_t;
 
+    // The color and direction are stored as half-floats, the values with a larger range (or which
+    // need the precision) as floats. The shader decodes them in light_punctual.fs.
     struct LightParameters {
         math::float4 positionFalloff;   // { float3(pos), 1/falloff^2 }
-        math::float4 colorIntensity;    // { float3(col), intensity }
-        math::float4 directionIES;      // { float3(dir), IES index }
-        math::float4 spotScaleOffset;   // { scale, offset, unused, unused }
+        math::uint4 colorDirection;     // { half2(col.rg), half2(col.b, dir.x), half2(dir.yz),
+                                        //   shadow map index or NO_SHADOW }
+        math::float4 intensitySpot;     // { intensity, spot scale, spot offset, unused }
     };
 
+    static constexpr uint32_t NO_SHADOW = 0xFFFFFFFFu;
+
+    // same as packHalf2x16() in GLSL
+    static uint32_t packHalf2x16(math::float2 v) noexcept {
+        return uint32_t(math::getBits(math::half(v.x))) |
+               uint32_t(math::getBits(math::half(v.y))) << 16u;
+    }
+
     explicit GpuLightBuffer(FEngine& engine) noexcept;
 
     void commit(FEngine& engine) noexcept;
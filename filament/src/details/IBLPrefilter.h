@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DETAILS_IBLPREFILTER_H
+#define TNT_FILAMENT_DETAILS_IBLPREFILTER_H
+
+#include "upcast.h"
+
+#include <filament/IBLPrefilter.h>
+
+#include <utils/compiler.h>
+
+#include <math/vec3.h>
+
+#include <array>
+#include <vector>
+
+namespace filament {
+namespace details {
+
+class FEngine;
+class FTexture;
+
+/*
+ * The processing is split in small work items (mostly a row of texels), and execute() runs as
+ * many of them as the budget allows. It's called by the engine once per frame.
+ *
+ * This is a port of tools/cmgen's CubemapIBL::roughnessFilter() and
+ * CubemapSH::computeIrradianceSH3Bands(), in single precision. Unlike cmgen, the bilinear
+ * filtering doesn't cross the edges of the faces.
+ */
+class FIBLPrefilter : public IBLPrefilter {
+public:
+    FIBLPrefilter(FEngine& engine, const Builder& builder) noexcept;
+
+    void terminate(FEngine& engine) noexcept;
+
+    void execute(FEngine& engine) noexcept;
+
+    bool isReady() const noexcept { return mStage == Stage::DONE; }
+
+    void getIrradiance(math::float3* sh) const noexcept;
+
+private:
+    enum class Stage : uint8_t {
+        IRRADIANCE,     // one item per row of the environment
+        MIPMAPS,        // one item per mipmap of the environment
+        REFLECTIONS,    // one item per row of each level of the reflections
+        DONE
+    };
+
+    // the six faces of a level, one after the other
+    struct Cubemap {
+        uint32_t size = 0;
+        std::vector<math::float3> texels;
+        math::float3 const* getFace(size_t face) const noexcept {
+            return texels.data() + face * size * size;
+        }
+        math::float3* getFace(size_t face) noexcept {
+            return texels.data() + face * size * size;
+        }
+    };
+
+    // importance sample of the level being prefiltered, in tangent space
+    struct Sample {
+        math::float3 L;
+        float weight;
+        float lod;
+    };
+
+    void runItem(FEngine& engine) noexcept;
+    void accumulateIrradiance(size_t face, uint32_t y) noexcept;
+    void finishIrradiance() noexcept;
+    void downsample(size_t level) noexcept;
+    void prepareSamples(size_t level) noexcept;
+    void filterRow(size_t face, uint32_t y) noexcept;
+    void uploadLevel(FEngine& engine, size_t level) noexcept;
+    math::float3 sample(math::float3 const& direction, float lod) const noexcept;
+
+    // we don't own this one
+    FTexture const* mReflections = nullptr;
+
+    std::vector<Cubemap> mEnvironment;  // the environment and its mipmaps
+    Cubemap mLevel;                     // the level of the reflections being computed
+    std::vector<Sample> mSamples;
+    std::array<math::double3, 9> mSH = {};
+    std::array<math::float3, 9> mIrradiance = {};
+    uint32_t mSampleCount;
+    uint32_t mBudget;
+    Stage mStage = Stage::IRRADIANCE;
+    uint32_t mLevelIndex = 0;
+    uint32_t mItem = 0;
+};
+
+FILAMENT_UPCAST(IBLPrefilter)
+
+} // namespace details
+} // namespace filament
+
+#endif // TNT_FILAMENT_DETAILS_IBLPREFILTER_H
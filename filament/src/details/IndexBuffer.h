@@ -41,6 +41,9 @@ public:
 
     size_t getIndexCount() const noexcept { return mIndexCount; }
 
+    // size of the buffer, in bytes
+    size_t getSize() const noexcept { return mIndexCount * mIndexSize; }
+
     void setBuffer(FEngine& engine,
             BufferDescriptor&& buffer, uint32_t byteOffset = 0, uint32_t byteSize = 0);
 
@@ -48,6 +51,7 @@ private:
     friend class IndexBuffer;
     Handle<HwIndexBuffer> mHandle;
     uint32_t mIndexCount;
+    uint8_t mIndexSize;
 };
 
 FILAMENT_UPCAST(IndexBuffer)
@@ -42,18 +42,22 @@ public:
 
     Handle<HwTexture> getReflectionMap() const noexcept { return mReflectionsMapHandle; }
     Handle<HwTexture> getIrradianceMap() const noexcept { return mIrradianceMapHandle; }
-    math::float3 const* getSH() const noexcept{ return mIrradianceCoefs.data(); }
+    bool isReflectionMapRGBM() const noexcept { return mReflectionsRGBM; }
+    // the spherical harmonics, rotated
+    math::float3 const* getSH() const noexcept{ return mRotatedCoefs.data(); }
     float getIntensity() const noexcept { return mIntensity; }
     void setIntensity(float intensity) noexcept { mIntensity = intensity; }
-    void setRotation(math::mat3f const& rotation) noexcept { mRotation = rotation; }
+    void setRotation(math::mat3f const& rotation) noexcept;
     const math::mat3f& getRotation() const { return mRotation; }
 
 private:
     Handle<HwTexture> mReflectionsMapHandle;
     Handle<HwTexture> mIrradianceMapHandle;
     std::array<math::float3, 9> mIrradianceCoefs;
+    std::array<math::float3, 9> mRotatedCoefs;
     float mIntensity = DEFAULT_INTENSITY;
     math::mat3f mRotation;
+    bool mReflectionsRGBM = true;
 };
 
 FILAMENT_UPCAST(IndirectLight)
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DETAILS_LOADERCONTEXT_H
+#define TNT_FILAMENT_DETAILS_LOADERCONTEXT_H
+
+#include "upcast.h"
+
+#include <filament/LoaderContext.h>
+
+#include <utils/compiler.h>
+
+#include <mutex>
+#include <vector>
+
+namespace filament {
+namespace details {
+
+class FEngine;
+class FIndexBuffer;
+class FTexture;
+class FVertexBuffer;
+
+/*
+ * The uploads are recorded under a lock by the threads of the application, and replayed by
+ * execute() on the engine's thread, once per frame. They're replayed before the callbacks, so
+ * that a callback always follows the uploads recorded before its commit().
+ */
+class FLoaderContext : public LoaderContext {
+public:
+    void terminate(FEngine& engine) noexcept;
+
+    void setBufferAt(FVertexBuffer* vertexBuffer, uint8_t bufferIndex,
+            BufferDescriptor&& buffer, uint32_t byteOffset, uint32_t byteSize) noexcept;
+
+    void setBuffer(FIndexBuffer* indexBuffer,
+            BufferDescriptor&& buffer, uint32_t byteOffset, uint32_t byteSize) noexcept;
+
+    // a width of 0 is the whole level
+    void setImage(FTexture* texture, size_t level,
+            uint32_t xoffset, uint32_t yoffset, uint32_t width, uint32_t height,
+            PixelBufferDescriptor&& buffer) noexcept;
+
+    void commit(BufferDescriptor::Callback callback, void* user) noexcept;
+
+    // issues the uploads recorded since the last call, must be called on the engine's thread
+    void execute(FEngine& engine) noexcept;
+
+private:
+    struct VertexUpload {
+        FVertexBuffer* vertexBuffer;
+        uint8_t bufferIndex;
+        uint32_t byteOffset;
+        uint32_t byteSize;
+        BufferDescriptor buffer;
+    };
+
+    struct IndexUpload {
+        FIndexBuffer* indexBuffer;
+        uint32_t byteOffset;
+        uint32_t byteSize;
+        BufferDescriptor buffer;
+    };
+
+    struct ImageUpload {
+        FTexture* texture;
+        uint32_t level;
+        uint32_t xoffset;
+        uint32_t yoffset;
+        uint32_t width;
+        uint32_t height;
+        PixelBufferDescriptor buffer;
+    };
+
+    struct Uploads {
+        std::vector<VertexUpload> vertices;
+        std::vector<IndexUpload> indices;
+        std::vector<ImageUpload> images;
+        std::vector<BufferDescriptor> callbacks;
+        bool empty() const noexcept {
+            return vertices.empty() && indices.empty() && images.empty() && callbacks.empty();
+        }
+    };
+
+    std::mutex mLock;
+    Uploads mPending;       // guarded by mLock
+    Uploads mExecuting;     // only used by execute(), keeps the vectors' storage
+};
+
+FILAMENT_UPCAST(LoaderContext)
+
+} // namespace details
+} // namespace filament
+
+#endif // TNT_FILAMENT_DETAILS_LOADERCONTEXT_H
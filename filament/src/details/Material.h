@@ -38,6 +38,7 @@ namespace filament {
 namespace details {
 
 class  FEngine;
+class  FFence;
 struct ShaderGenerator;
 
 class FMaterial : public Material {
@@ -66,6 +67,11 @@ public:
     // Create an instance of this material
     FMaterialInstance* createInstance() const noexcept;
 
+    FFence* compile(uint8_t variants) noexcept;
+
+    // the keys of the variants compile() builds for the given VARIANT_* mask, one bit per key
+    uint32_t getVariantsToCompile(uint8_t variants) const noexcept;
+
     bool hasParameter(const char* name) const noexcept;
 
     FMaterialInstance const* getDefaultInstance() const noexcept { return &mDefaultInstance; }
@@ -74,6 +80,7 @@ public:
     FEngine& getEngine() const noexcept  { return mEngine; }
 
     Handle<HwProgram> getProgramSlow(uint8_t variantKey) const noexcept;
+    bool hasVariant(uint8_t variantKey) const noexcept;
     Handle<HwProgram> getProgram(uint8_t variantKey) const noexcept {
 
         // filterVariant() has already been applied in generateCommands(), shouldn't be needed here
@@ -83,6 +90,15 @@ public:
         return UTILS_LIKELY(entry) ? entry : getProgramSlow(variantKey);
     }
 
+    // Same as getProgram(), and records that the variant is used. This must be called from a
+    // single thread, before the programs are used.
+    Handle<HwProgram> prepareProgram(uint8_t variantKey) const noexcept {
+        mUsedVariants |= 1u << variantKey;
+        return getProgram(variantKey);
+    }
+
+    uint32_t getUsedVariants() const noexcept { return mUsedVariants; }
+
     bool isVariantLit() const noexcept { return mIsVariantLit; }
 
     const utils::CString& getName() const noexcept { return mName; }
@@ -103,6 +119,7 @@ public:
     bool isDoubleSided() const noexcept { return mDoubleSided; }
     float getMaskThreshold() const noexcept { return mMaskTreshold; }
     bool hasShadowMultiplier() const noexcept { return mHasShadowMultiplier; }
+    bool isInstancingSupported() const noexcept { return mSupportsInstancing; }
     AttributeBitset getRequiredAttributes() const noexcept { return mRequiredAttributes; }
 
     size_t getParameterCount() const noexcept {
@@ -113,9 +130,14 @@ public:
 
     uint32_t generateMaterialInstanceId() const noexcept { return mMaterialInstanceId++; }
 
+    // size of the package this material was built from
+    size_t getPackageSize() const noexcept { return mPackageSize; }
+
 private:
     // try to order by frequency of use
     mutable std::array<Handle<HwProgram>, VARIANT_COUNT> mCachedPrograms;
+    mutable uint32_t mUsedVariants = 0;
+    static_assert(VARIANT_COUNT <= 32, "mUsedVariants must have a bit per variant");
     Driver::RasterState mRasterState;
     Shading mShading;
     bool mIsVariantLit;
@@ -130,6 +152,7 @@ private:
     bool mHasShadowMultiplier = false;
     bool mHasCustomDepthShader = false;
     bool mIsDefaultMaterial = false;
+    bool mSupportsInstancing = false;
 
     FMaterialInstance mDefaultInstance;
     SamplerInterfaceBlock mSamplerInterfaceBlock;
@@ -141,6 +164,7 @@ private:
     const uint32_t mMaterialId;
     mutable uint32_t mMaterialInstanceId = 0;
     filaflat::MaterialParser* mMaterialParser = nullptr;
+    size_t mPackageSize = 0;
 };
 
 
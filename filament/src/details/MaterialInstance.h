@@ -69,6 +69,20 @@ public:
     void setParameter(const char* name,
             Texture const* texture, TextureSampler const& sampler) noexcept;
 
+    ParameterHandle getParameterHandle(const char* name) const noexcept;
+
+    template <typename T>
+    void setParameter(ParameterHandle handle, T value) noexcept;
+
+    template <typename T>
+    void setParameter(ParameterHandle handle, const T* value, size_t count) noexcept;
+
+    void setParameter(ParameterHandle handle,
+            Texture const* texture, TextureSampler const& sampler) noexcept;
+
+    template <typename T>
+    void setParameters(const ParameterHandle* handles, const T* values, size_t count) noexcept;
+
     FMaterial const* getMaterial() const noexcept { return mMaterial; }
 
     uint64_t getSortingKey() const noexcept { return mMaterialSortingKey; }
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DETAILS_MORPHTARGETBUFFER_H
+#define TNT_FILAMENT_DETAILS_MORPHTARGETBUFFER_H
+
+#include "upcast.h"
+
+#include "driver/DriverApiForward.h"
+#include "driver/Handle.h"
+
+#include <filament/EngineEnums.h>
+#include <filament/MorphTargetBuffer.h>
+
+#include <math/vec3.h>
+#include <math/vec4.h>
+
+#include <utils/compiler.h>
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace filament {
+namespace details {
+
+class FEngine;
+
+class FMorphTargetBuffer : public MorphTargetBuffer {
+public:
+    // The deltas are stored in a 2D texture of this width (the minimum maximum texture size of
+    // ES 3.0), with as many rows as needed. See getMorphTargetsTexel() in getters.vs.
+    static constexpr size_t TEXTURE_WIDTH = 2048;
+    static constexpr size_t MAX_TEXEL_COUNT = TEXTURE_WIDTH * 2048;
+
+    // std140 layout of MorphingUniforms, see UibGenerator::getPerRenderableMorphingUib()
+    struct MorphingUib {
+        math::float4 weights[CONFIG_MAX_MORPH_TARGET_COUNT / 4];
+        uint32_t count;
+        uint32_t padding[3];
+    };
+
+    FMorphTargetBuffer(FEngine& engine, const Builder& builder);
+
+    // frees driver resources, object becomes invalid
+    void terminate(FEngine& engine);
+
+    Handle<HwSamplerBuffer> getHwHandle() const noexcept { return mSbHandle; }
+
+    size_t getVertexCount() const noexcept { return mVertexCount; }
+
+    size_t getTargetCount() const noexcept { return mTargets.size(); }
+
+    void setTarget(size_t target, uint32_t const* indices,
+            math::float3 const* positions, math::float3 const* normals, size_t count);
+
+    // uploads the targets if they changed since the previous call
+    void commit(driver::DriverApi& driver) noexcept;
+
+private:
+    friend class MorphTargetBuffer;
+
+    struct Delta {
+        uint32_t vertex;
+        math::float3 position;
+        math::float3 normal;
+    };
+
+    Handle<HwSamplerBuffer> mSbHandle;
+    Handle<HwTexture> mTexture;
+    uint32_t mTextureWidth = 0;
+    uint32_t mTextureHeight = 0;
+    uint32_t mVertexCount;
+    size_t mDeltaCount = 0;
+    std::vector<std::vector<Delta>> mTargets;
+    bool mDirty = false;
+};
+
+FILAMENT_UPCAST(MorphTargetBuffer)
+
+} // namespace details
+} // namespace filament
+
+#endif // TNT_FILAMENT_DETAILS_MORPHTARGETBUFFER_H
@@ -55,6 +55,12 @@ public:
     AttributeBitset getEnabledAttributes() const noexcept { return mEnabledAttributes; }
     uint16_t getBlendOrder() const noexcept { return mBlendOrder; }
 
+    // primitives drawing ranges of the same buffers can be batched, see RenderPass
+    Handle<HwVertexBuffer> getVertexBufferHandle() const noexcept { return mVertexBuffer; }
+    Handle<HwIndexBuffer> getIndexBufferHandle() const noexcept { return mIndexBuffer; }
+    uint32_t getIndexOffset() const noexcept { return mIndexOffset; }
+    uint32_t getIndexCount() const noexcept { return mIndexCount; }
+
     void setMaterialInstance(FMaterialInstance const* mi) noexcept { mMaterialInstance = mi; }
     void setBlendOrder(uint16_t order) noexcept {
         mBlendOrder = static_cast<uint16_t>(order & 0x7FFF);
@@ -63,6 +69,10 @@ public:
 private:
     FMaterialInstance const* mMaterialInstance = nullptr;
     Handle<HwRenderPrimitive> mHandle;
+    Handle<HwVertexBuffer> mVertexBuffer;
+    Handle<HwIndexBuffer> mIndexBuffer;
+    uint32_t mIndexOffset = 0;
+    uint32_t mIndexCount = 0;
     driver::PrimitiveType mPrimitiveType = driver::PrimitiveType::NONE;
     AttributeBitset mEnabledAttributes;
     uint16_t mBlendOrder = 0;
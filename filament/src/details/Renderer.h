@@ -30,8 +30,11 @@
 #include "driver/Handle.h"
 
 #include <filament/Renderer.h>
+#include <filament/Viewport.h>
 #include <filament/driver/DriverEnums.h>
 
+#include <math/vec4.h>
+
 #include <utils/compiler.h>
 #include <utils/Allocator.h>
 #include <utils/Slice.h>
@@ -45,7 +48,7 @@ namespace details {
 
 class FEngine;
 class FView;
-class ShadowMap;
+class ShadowAtlas;
 
 /*
  * A concrete implementation of the Renderer Interface.
@@ -63,8 +66,18 @@ public:
     void render(FView const* view);
     void renderJob(ArenaScope& arena, FView* view);
 
-    bool beginFrame(FSwapChain* swapChain);
-    void endFrame();
+    bool beginFrame(FSwapChain* swapChain, uint64_t vsyncSteadyClockTimeNano = 0);
+
+    void setDisplayInfo(DisplayInfo const& info) noexcept {
+        mDisplayInfo = info;
+    }
+    void endFrame(Viewport const* damage = nullptr, size_t count = 0);
+
+    FrameMemoryStatistics getFrameMemoryStatistics() const noexcept {
+        return mFrameMemoryStatistics;
+    }
+
+    size_t getFrameInfoHistory(FrameInfo* history, size_t count) const noexcept;
 
     void readPixels(uint32_t xoffset, uint32_t yoffset, uint32_t width, uint32_t height,
             driver::PixelBufferDescriptor&& buffer);
@@ -77,40 +90,80 @@ private:
 
     // this class is defined in RenderPass.cpp
     class ColorPass final : public RenderPass {
+    public:
+        // the eyes of a stereo view are rendered one after the other into the same target
+        enum class Eye : uint8_t { BOTH, LEFT, RIGHT };
+    private:
         using DriverApi = driver::DriverApi;
         utils::JobSystem& js;
         utils::JobSystem::Job* jobFroxelize = nullptr;
+        FEngine& engine;
         FView* const view;
         Handle<HwRenderTarget> const rth;
+        // computed by the FrameGraph, see FRenderer::renderJob()
+        driver::TargetBufferFlags const discardStart;
+        driver::TargetBufferFlags const discardEnd;
+        // when set, drawn in a second subpass reading the color pass output (a SUBPASS target)
+        Handle<HwProgram> const subpassProgram;
+        Eye const eye;
         void beginRenderPass(driver::DriverApi& driver, Viewport const& viewport, const CameraInfo& camera) noexcept override;
         void endRenderPass(DriverApi& driver, Viewport const& viewport) noexcept override;
     public:
-        ColorPass(const char* name, utils::JobSystem& js, utils::JobSystem::Job* jobFroxelize,
-                FView* view, Handle<HwRenderTarget> rth);
-        static void renderColorPass(FEngine& engine, utils::JobSystem& js,
+        ColorPass(const char* name, FEngine& engine, utils::JobSystem& js,
+                utils::JobSystem::Job* jobFroxelize, FView* view, Handle<HwRenderTarget> rth,
+                driver::TargetBufferFlags discardStart, driver::TargetBufferFlags discardEnd,
+                Handle<HwProgram> subpassProgram, Eye eye = Eye::BOTH);
+        // returns the order-independent transparent commands, which are left to OitPass
+        static utils::Slice<Command> renderColorPass(FEngine& engine, utils::JobSystem& js,
+                utils::JobSystem::Job* jobFroxelize, ArenaScope& arena,
                 Handle<HwRenderTarget> rth,
+                driver::TargetBufferFlags discardStart, driver::TargetBufferFlags discardEnd,
                 FView* view, Viewport const& scaledViewport,
-                utils::GrowingSlice<Command>& commands) noexcept;
+                utils::GrowingSlice<Command>& commands,
+                Handle<HwProgram> subpassProgram = {}) noexcept;
+    };
+
+    // this class is defined in RenderPass.cpp
+    // Draws a layer of the order-independent transparent objects, into a target sharing the
+    // depth buffer of the color pass.
+    class OitPass final : public RenderPass {
+        using DriverApi = driver::DriverApi;
+        Handle<HwRenderTarget> const rth;
+        math::float4 const clearColor;
+        void beginRenderPass(driver::DriverApi& driver, Viewport const& viewport, const CameraInfo& camera) noexcept override;
+        void endRenderPass(DriverApi& driver, Viewport const& viewport) noexcept override;
+    public:
+        OitPass(const char* name, Handle<HwRenderTarget> rth, math::float4 clearColor) noexcept;
+        // draws the commands returned by ColorPass::renderColorPass(), right after it: the
+        // accumulation layer into an RGBA16F target and the revealage layer into an R8 target
+        static void renderOitPass(FEngine& engine, utils::JobSystem& js, ArenaScope& arena,
+                FView* view, Viewport const& scaledViewport,
+                utils::Slice<Command> const& commands,
+                Handle<HwRenderTarget> accumulation, Handle<HwRenderTarget> revealage) noexcept;
     };
 
     // this class is defined in RenderPass.cpp
     class ShadowPass final : public RenderPass {
         using DriverApi = driver::DriverApi;
-        ShadowMap const& shadowMap;
+        ShadowAtlas const& atlas;
+        Viewport viewport;
+        bool clear;
+        bool cache;
         void beginRenderPass(driver::DriverApi& driver, Viewport const& viewport, const CameraInfo& camera) noexcept override;
         void endRenderPass(DriverApi& driver, Viewport const& viewport) noexcept override;
     public:
-        ShadowPass(const char* name, ShadowMap const& shadowMap) noexcept;
-        static void renderShadowMap(FEngine& engine, utils::JobSystem& js,
+        // renders a tile of the atlas, or of its cache of static casters
+        ShadowPass(const char* name, ShadowAtlas const& atlas, Viewport const& viewport,
+                bool clear, bool cache = false) noexcept;
+        static void renderShadowMap(FEngine& engine, utils::JobSystem& js, ArenaScope& arena,
                 FView* view, utils::GrowingSlice<Command>& commands) noexcept;
     };
 
     Handle<HwRenderTarget> getRenderTarget() const noexcept { return mRenderTarget; }
 
     void recordHighWatermark(utils::Slice<Command> const& commands) noexcept {
-#ifndef NDEBUG
-        mCommandsHighWatermark = std::max(mCommandsHighWatermark, size_t(commands.size()));
-#endif
+        mFrameCommandsHighWatermark = std::max(mFrameCommandsHighWatermark, size_t(commands.size()));
+        mCommandsHighWatermark = std::max(mCommandsHighWatermark, mFrameCommandsHighWatermark);
     }
 
     size_t getCommandsHighWatermark() const noexcept {
@@ -132,13 +185,25 @@ private:
     // keep a reference to our engine
     FEngine& mEngine;
     FrameSkipper mFrameSkipper;
+    DisplayInfo mDisplayInfo;
+    int64_t mPresentationTime = 0;      // of the last frame scheduled, see beginFrame()
     Handle<HwRenderTarget> mRenderTarget;
     FSwapChain* mSwapChain = nullptr;
     size_t mCommandsHighWatermark = 0;
+    size_t mFrameCommandsHighWatermark = 0;
+    FrameMemoryStatistics mFrameMemoryStatistics;
     uint32_t mFrameId = 0;
     FrameInfoManager mFrameInfoManager;
+    filament::FrameInfo::time_point mBeginFrameTime;
+    uint64_t mBeginFrameStallTime = 0;
+    uint64_t mLastFlushedBytes = 0;     // of the engine, when the previous frame ended
+    uint64_t mLastDriverThreadTime = 0;
+    uint64_t mLastDriverThreadWaitTime = 0;
+    uint64_t mLastWorkerIdleTime = 0;
+    filament::FrameInfo::time_point mLastEndFrameTime;
     bool mIsRGB16FSupported : 1;
     bool mIsRGB8Supported : 1;
+    bool mIsSubpassSupported : 1;
 
     // per-frame arena for this Renderer
     LinearAllocatorArena& mPerRenderPassArena;
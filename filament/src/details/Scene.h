@@ -22,9 +22,11 @@
 #include "components/RenderableManager.h"
 #include "components/TransformManager.h"
 
+#include "details/Bvh.h"
 #include "details/Culler.h"
 #include "details/GpuLightBuffer.h"
 
+#include "AffineTransform.h"
 #include "Allocators.h"
 
 #include <filament/Box.h>
@@ -37,7 +39,9 @@
 #include <utils/Range.h>
 
 #include <cstddef>
-#include <tsl/robin_set.h>
+#include <vector>
+
+#include <tsl/robin_map.h>
 
 namespace filament {
 namespace details {
@@ -47,6 +51,7 @@ class FEngine;
 class FIndirectLight;
 class FRenderer;
 class FSkybox;
+class FView;
 class GpuLightBuffer;
 
 
@@ -69,6 +74,9 @@ public:
     size_t getRenderableCount() const noexcept;
     size_t getLightCount() const noexcept;
 
+    void setHierarchicalCulling(bool enabled) noexcept;
+    bool isHierarchicalCullingEnabled() const noexcept { return mHierarchicalCulling; }
+
 public:
     /*
      * Filaments-scope Public API
@@ -83,7 +91,11 @@ public:
     void terminate(FEngine& engine);
 
     void prepare(const math::mat4f& worldOriginTansform);
-    void prepareDynamicLights(const CameraInfo& camera, ArenaScope& arena) noexcept;
+    // only the maxLightCount lights closest to the camera are kept, shadowedSpotLights are the
+    // spot lights with a shadow map, in the order of their shadow map's index
+    void prepareDynamicLights(const CameraInfo& camera, ArenaScope& arena, size_t maxLightCount,
+            utils::Slice<const FLightManager::Instance> shadowedSpotLights) noexcept;
+    // computes the bounds of the shadow casters and receivers on multiple threads
     void computeBounds(Aabb& castersBox, Aabb& receiversBox, uint32_t visibleLayers) const noexcept;
 
     /*
@@ -92,12 +104,15 @@ public:
 
     enum {
         RENDERABLE_INSTANCE,    //  4 instance of the Renderable component
-        WORLD_TRANSFORM,        // 16 instance of the Transform component
+        WORLD_TRANSFORM,        // 12 instance of the Transform component
         VISIBILITY_STATE,       //  1 visibility data of the component
-        UBH,                    //  4 uniform buffer handle
         BONES_UBH,              //  4 bones uniform buffer handle
+        BONES_OFFSET,           //  4 offset of the bones in the bones uniform buffer
+        MORPHING_UBH,           //  4 morph weights uniform buffer handle
+        MORPH_TARGETS_SBH,      //  4 morph targets sampler buffer handle
         WORLD_AABB_CENTER,      // 12 world-space bounding box center of the renderable
         VISIBLE_MASK,           //  1 each bit represents a visibility in a pass
+        SPOT_SHADOW_MASK,       //  1 each bit represents a visibility in a spot light shadow map
 
         // These are not needed anymore after culling
         LAYERS,                 //  1 layers
@@ -105,20 +120,25 @@ public:
 
         // These are temporaries and should be stored out of line
         PRIMITIVES,             //  8 level-of-detail'ed primitives
+        SCREEN_COVERAGE,        //  4 estimated fraction of the viewport covered by the renderable
         SUMMED_PRIMITIVE_COUNT, //  4 summed visible primitive counts
     };
 
     using RenderableSoa = utils::StructureOfArrays<
             utils::EntityInstance<RenderableManager>,
-            math::mat4f,
+            AffineTransform,
             FRenderableManager::Visibility,
             Handle<HwUniformBuffer>,
+            uint32_t,
             Handle<HwUniformBuffer>,
+            Handle<HwSamplerBuffer>,
             math::float3,
             Culler::result_type,
+            Culler::result_type,
             uint8_t,
             math::float3,
             utils::Slice<FRenderPrimitive>,
+            float,
             uint32_t
     >;
 
@@ -144,6 +164,7 @@ public:
     enum {
         POSITION_RADIUS,
         DIRECTION,
+        SPOT_PARAMS,            // cosOuterSquared, sinInverse: read linearly by the froxelizer
         LIGHT_INSTANCE,
         VISIBILITY,
         SCREEN_SPACE_Z_RANGE
@@ -152,6 +173,7 @@ public:
     using LightSoa = utils::StructureOfArrays<
             math::float4,
             math::float3,
+            math::float2,
             FLightManager::Instance,
             Culler::result_type,
             math::float2
@@ -162,10 +184,55 @@ public:
 
     void updateUBOs(utils::Range<uint32_t> visibleRenderables) const noexcept;
 
+    // Hierarchy over the renderables' world AABBs, or null if hierarchical culling is disabled.
+    // It indexes the RenderableSoa as initialized by prepare(), i.e. before View reorders it.
+    Bvh const* getBvh() const noexcept { return mHierarchicalCulling ? &mBvh : nullptr; }
+
+    // Hierarchy over the bounding spheres of the point and spot lights, or null if hierarchical
+    // culling is disabled. Light i of the hierarchy is at DIRECTIONAL_LIGHTS_COUNT + i in the
+    // LightSoa as initialized by prepare(), i.e. before View reorders it.
+    Bvh const* getLightBvh() const noexcept { return mHierarchicalCulling ? &mLightBvh : nullptr; }
+
+    // For each renderable, the version of its data: it changes whenever the entry of the
+    // RenderableSoa is gathered again, e.g. because the renderable moved. It indexes the
+    // RenderableSoa as initialized by prepare(), like getBvh().
+    uint32_t const* getRenderableVersions() const noexcept { return mRenderableVersions.data(); }
+
+    // The View whose culling results the RenderableSoa and LightSoa hold, see
+    // View::setCullingSource(). It's only compared, never dereferenced.
+    void setCullingView(FView const* view) noexcept { mCullingView = view; }
+    FView const* getCullingView() const noexcept { return mCullingView; }
+
 private:
+    struct DirectionalLight {
+        utils::Entity entity;
+        FLightManager::Instance instance;
+        math::float3 direction;
+    };
+
+    void gatherAll(const math::mat4f& worldOriginTransform);
+    void sortEntities() noexcept;
+    void gather(utils::Entity e, const math::mat4f& worldOriginTransform);
+    void buildBvh();
+    void buildLightBvh();
+    void computeBounds(Aabb& castersBox, Aabb& receiversBox, uint32_t visibleLayers,
+            size_t first, size_t last) const noexcept;
+    void prepareRenderables(uint32_t first, uint32_t count,
+            const math::mat4f& worldOriginTransform) noexcept;
+    void setLightData(size_t index, FLightManager::Instance li,
+            const math::mat4f& worldTransform) noexcept;
+    math::float3 getWorldDirection(FLightManager::Instance li,
+            const math::mat4f& worldTransform) const noexcept;
+
+    static inline void computeWorldAABBs(math::float3* center, math::float3* extent,
+            const AffineTransform* worldTransforms, size_t count) noexcept;
+
     static inline void computeLightRanges(math::float2* zrange,
             CameraInfo const& camera, const math::float4* spheres, size_t count) noexcept;
 
+    static float computeLightImportance(math::float3 const& cameraPosition,
+            math::float4 const& sphere, float intensity) noexcept;
+
     static inline void computeLightCameraPlaneDistances(float* distances,
             const CameraInfo& camera, const math::float4* spheres, size_t count) noexcept;
 
@@ -174,12 +241,48 @@ private:
     FIndirectLight const* mIndirectLight = nullptr;
     GpuLightBuffer mGpuLightData;
 
-    // list of Entities in the scene. We use a robin_set<> so we can do efficient removes
-    // (a vector<> could work, but removes would be O(n)). robin_set<> iterates almost as
-    // nicely as vector<>, which is a good compromise.
-    tsl::robin_set<utils::Entity> mEntities;
+    // Entities in the scene, and their index in mEntities for O(1) removes. gatherAll() sorts
+    // them by component instance, so that it walks the component managers' arrays in order.
+    std::vector<utils::Entity> mEntities;
+    tsl::robin_map<utils::Entity, uint32_t> mEntityIndices;
     RenderableSoa mRenderableData;
     LightSoa mLightData;
+
+    /*
+     * Persistent copy of the gathered data. View reorders mRenderableData and mLightData,
+     * so they're re-initialized from this copy each frame. The copy itself is only gathered
+     * again for the entities recorded in the component managers' change journals, unless the
+     * set of entities (or their components) changed.
+     */
+    RenderableSoa mRenderableCache;
+    LightSoa mLightCache;                       // point and spot lights
+    std::vector<DirectionalLight> mDirectionalLights;
+    std::vector<utils::Entity> mCachedEntities; // entities that have data in the cache
+    tsl::robin_map<utils::Entity, uint32_t> mRenderableSlots;
+    tsl::robin_map<utils::Entity, uint32_t> mLightSlots;
+    std::vector<math::mat4f> mLightTransforms;  // scratch space used by gatherAll()
+    std::vector<std::pair<uint64_t, utils::Entity>> mEntityKeys;    // likewise
+    ChangeJournal::Position mRenderableJournalPosition = 0;
+    ChangeJournal::Position mTransformJournalPosition = 0;
+    ChangeJournal::Position mLightJournalPosition = 0;
+    math::mat4f mWorldOriginTransform;
+    bool mEntitiesChanged = true;
+    std::vector<uint32_t> mRenderableVersions;  // version of each entry of mRenderableCache
+    uint32_t mVersion = 0;                      // incremented by each prepare()
+
+    // when enabled, mRenderableCache is stored in the order of the hierarchy's leaves
+    Bvh mBvh;
+    std::vector<uint32_t> mBvhOrder;            // scratch space used by gatherAll()
+    RenderableSoa mRenderableScratch;           // scratch space used by gatherAll()
+
+    // likewise, mLightCache is stored in the order of mLightBvh's leaves
+    Bvh mLightBvh;
+    std::vector<math::float3> mLightCenters;    // bounding box of each light in mLightCache
+    std::vector<math::float3> mLightExtents;
+    LightSoa mLightScratch;                     // scratch space used by gatherAll()
+    bool mHierarchicalCulling = false;
+
+    FView const* mCullingView = nullptr;
 };
 
 FILAMENT_UPCAST(Scene)
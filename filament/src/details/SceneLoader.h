@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DETAILS_SCENELOADER_H
+#define TNT_FILAMENT_DETAILS_SCENELOADER_H
+
+#include "upcast.h"
+
+#include <filament/SceneLoader.h>
+
+#include <utils/compiler.h>
+#include <utils/Entity.h>
+
+#include <math/vec3.h>
+
+#include <vector>
+
+namespace filament {
+namespace details {
+
+class FCamera;
+class FEngine;
+class FScene;
+
+/*
+ * The queue is kept sorted by decreasing distance to the camera, so that execute() loads the
+ * closest entities by popping the back. It's only sorted again when entities were added or the
+ * camera moved, which is rare once the scene is loading.
+ */
+class FSceneLoader : public SceneLoader {
+public:
+    FSceneLoader(FEngine& engine, const Builder& builder) noexcept;
+
+    void terminate(FEngine& engine) noexcept;
+
+    // loads entities within the budgets, called by the engine once per frame
+    void execute(FEngine& engine) noexcept;
+
+    void add(utils::Entity entity, Box const& aabb, LoadCallback callback, void* user) noexcept;
+    void remove(utils::Entity entity) noexcept;
+
+    void setCamera(FCamera const* camera) noexcept { mCamera = camera; }
+    void setBudget(uint32_t microseconds) noexcept { mBudget = microseconds; }
+    void setUploadBudget(size_t bytes) noexcept { mUploadBudget = bytes; }
+
+    size_t getPendingCount() const noexcept { return mPending.size(); }
+
+private:
+    struct Pending {
+        utils::Entity entity;
+        math::float3 center;    // bounding sphere of the entity
+        float radius;
+        float distance;         // to the camera, when the queue was sorted
+        uint32_t sequence;      // order of the calls to add()
+        LoadCallback callback;
+        void* user;
+    };
+
+    void sort() noexcept;
+
+    // we don't own these
+    FScene* mScene;
+    FCamera const* mCamera;
+
+    std::vector<Pending> mPending;
+    math::float3 mSortPosition = {};    // of the camera, when the queue was sorted
+    uint32_t mSequence = 0;
+    uint32_t mBudget;
+    size_t mUploadBudget;
+    bool mSorted = true;
+};
+
+FILAMENT_UPCAST(SceneLoader)
+
+} // namespace details
+} // namespace filament
+
+#endif // TNT_FILAMENT_DETAILS_SCENELOADER_H
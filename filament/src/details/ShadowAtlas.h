@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DETAILS_SHADOWATLAS_H
+#define TNT_FILAMENT_DETAILS_SHADOWATLAS_H
+
+#include "RenderTargetPool.h"
+
+#include "driver/DriverApiForward.h"
+#include "driver/SamplerBuffer.h"
+
+#include <filament/driver/DriverEnums.h>
+#include <filament/EngineEnums.h>
+#include <filament/Viewport.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+namespace details {
+
+class FEngine;
+
+/*
+ * The ShadowAtlas allocates the shadow maps of a view (the cascades of the directional light
+ * and the shadowed spot lights) as square tiles of a single depth texture, which is obtained
+ * from the engine's RenderTargetPool and kept across frames. The texture is 16-bit when the
+ * driver can render to it, 24-bit otherwise.
+ *
+ * Tiles are requested every frame with add(), then laid out by allocate(). Their dimensions
+ * are powers of two, so that sorting them by size and placing them in Morton order packs them
+ * without any wasted space.
+ *
+ * With caching enabled, a second texture of the same size holds the static shadow casters of
+ * the tiles, in the same layout. Tiles are copied from the cache before the dynamic casters
+ * are rendered.
+ *
+ * With moments enabled, the shadow maps are also resolved, once rendered, into the moments of
+ * exponential variance shadow maps (EVSM): an RGBA16F texture of the same size, blurred by a
+ * separable filter and sampled with a single bilinear fetch, instead of the many comparisons
+ * of PCF at each receiver.
+ */
+class ShadowAtlas {
+public:
+    static constexpr size_t MAX_TILE_COUNT =
+            CONFIG_MAX_SHADOW_CASCADES + CONFIG_MAX_SHADOWED_SPOT_LIGHTS;
+
+    explicit ShadowAtlas(FEngine& engine) noexcept;
+
+    // returns the atlas and its cache to the RenderTargetPool
+    void terminate() noexcept;
+
+    // whether allocate() should also allocate the cache of static shadow casters
+    void setCachingEnabled(bool enabled) noexcept { mCachingEnabled = enabled; }
+
+    // whether allocate() should also allocate the EVSM moments, if the driver can render them.
+    // See resolveMoments().
+    void setMomentsEnabled(bool enabled) noexcept { mMomentsEnabled = enabled; }
+
+    // forgets the tiles of the previous frame
+    void clear() noexcept { mTileCount = 0; }
+
+    // requests a tile, its dimension is rounded up to a power of two. Returns the tile's index.
+    size_t add(uint32_t dimension) noexcept;
+
+    // lays out the tiles and makes sure the atlas is large enough for them. The atlas can't grow
+    // past CONFIG_MAX_SHADOW_ATLAS_DIMENSION, tiles which don't fit are dropped, smallest
+    // first. This sets the atlas as the shadow map sampler of the given SamplerBuffer, and the
+    // moments as its shadow moments sampler.
+    void allocate(SamplerBuffer& sb) noexcept;
+
+    // returns a tile's viewport in the atlas, which is empty if the tile was dropped.
+    // Valid after allocate().
+    Viewport const& getTile(size_t index) const noexcept { return mTiles[index].viewport; }
+
+    // dimensions of the atlas texture, might be larger than needed. Valid after allocate().
+    uint32_t getWidth() const noexcept { return mTarget ? mTarget->w : 0; }
+    uint32_t getHeight() const noexcept { return mTarget ? mTarget->h : 0; }
+
+    // Set-up the render target, call before rendering a tile. The whole atlas is cleared when
+    // 'clear' is set, it must be set for the first tile rendered in a frame.
+    void beginRenderPass(driver::DriverApi& driver, Viewport const& viewport,
+            bool clear) const noexcept;
+
+    // whether the cache of static casters is allocated. Valid after allocate().
+    bool hasCache() const noexcept { return mCacheTarget != nullptr; }
+
+    // changes when the cache is allocated again and its content lost. Valid after allocate().
+    uint32_t getCacheGeneration() const noexcept { return mCacheGeneration; }
+
+    // Set-up the cache as the render target, the tile given by viewport is cleared.
+    void beginCacheRenderPass(driver::DriverApi& driver, Viewport const& viewport) const noexcept;
+
+    // clears the whole atlas, this replaces the 'clear' of the first beginRenderPass() of
+    // a frame when tiles are copied from the cache.
+    void clearTarget(driver::DriverApi& driver) const noexcept;
+
+    // copies a tile from the cache, must be called outside of a render pass.
+    void copyFromCache(driver::DriverApi& driver, Viewport const& viewport) const noexcept;
+
+    // whether the EVSM moments are allocated. Valid after allocate().
+    bool hasMoments() const noexcept { return mMomentsTarget != nullptr; }
+
+    // computes the moments of a rendered tile and blurs them, must be called outside of a
+    // render pass.
+    void resolveMoments(Viewport const& viewport) const noexcept;
+
+private:
+    struct Tile {
+        uint32_t dimension = 0;
+        Viewport viewport;
+    };
+
+    FEngine& mEngine;
+    RenderTargetPool::Target const* mTarget = nullptr;
+    RenderTargetPool::Target const* mCacheTarget = nullptr;
+    RenderTargetPool::Target const* mMomentsTarget = nullptr;
+    RenderTargetPool::Target const* mBlurTarget = nullptr; // horizontally blurred moments
+    Tile mTiles[MAX_TILE_COUNT];
+    size_t mTileCount = 0;
+    uint32_t mCacheGeneration = 0;
+    driver::TextureFormat mDepthFormat = driver::TextureFormat::DEPTH16;
+    bool mFormatsChosen = false;
+    bool mMomentsSupported = false;
+    bool mCachingEnabled = false;
+    bool mMomentsEnabled = false;
+};
+
+} // namespace details
+} // namespace filament
+
+#endif // TNT_FILAMENT_DETAILS_SHADOWATLAS_H
@@ -22,9 +22,7 @@
 #include "details/Camera.h"
 #include "details/Scene.h"
 
-#include "driver/DriverApiForward.h"
-#include "driver/SamplerBuffer.h"
-
+#include <filament/EngineEnums.h>
 #include <filament/Viewport.h>
 
 #include <math/mat4.h>
@@ -33,47 +31,84 @@
 namespace filament {
 namespace details {
 
+/*
+ * A ShadowMap computes the shadow cameras of a light: one per cascade for the directional
+ * light, a single one for spot lights. Each of them is rendered in its own tile of the
+ * view's ShadowAtlas.
+ */
 class ShadowMap {
 public:
     explicit ShadowMap(FEngine& engine) noexcept;
     ~ShadowMap();
 
-    void terminate(driver::DriverApi& driverApi) noexcept;
-
     // Call once per frame if the light, scene (or visible layers) or camera changes.
-    // This computes the light's camera.
+    // This computes the light's cameras.
+    // The bounds of the shadow casters and receivers are given by FScene::computeBounds().
+    // When autoSizeViewport isn't empty, the dimension of the shadow map is chosen from the
+    // area the shadow receivers cover in it, up to the light's shadow map size.
     void update(
-            const FScene::LightSoa& lightData, size_t index, FScene const* scene,
-            details::CameraInfo const& camera, uint8_t visibleLayers) noexcept;
+            const FScene::LightSoa& lightData, size_t index,
+            Aabb const& wsShadowCastersVolume, Aabb const& wsShadowReceiversVolume,
+            details::CameraInfo const& camera, Viewport const& autoSizeViewport = {}) noexcept;
 
     // Do we have visible shadows. Valid after calling update().
     bool hasVisibleShadows() const noexcept { return mHasVisibleShadows; }
 
-    // Allocates shadow texture based on user parameters (e.g. dimensions)
-    void prepare(driver::DriverApi& driver, SamplerBuffer& buffer) noexcept;
+    // Number of cascades of this shadow map, 1 for spot lights. Valid after calling update().
+    size_t getCascadeCount() const noexcept { return mCascadeCount; }
+
+    // Does the given cascade have visible shadows. Valid after calling update().
+    bool hasVisibleShadows(size_t cascade) const noexcept {
+        return mCascades[cascade].hasVisibleShadows;
+    }
+
+    // Dimension of the tile of each cascade. Valid after calling update().
+    uint32_t getDimension() const noexcept { return mShadowMapDimension; }
 
-    // Returns the shadow map's viewport. Valid after prepare().
-    Viewport const& getViewport() const noexcept { return mViewport; }
+    // Sets the tile where a cascade is rendered in the atlas. A cascade whose tile is empty
+    // doesn't have visible shadows. Call after update().
+    void setTile(size_t cascade, Viewport const& tile,
+            uint32_t atlasWidth, uint32_t atlasHeight) noexcept;
+
+    // Returns the viewport of a cascade in the atlas. Valid after setTile().
+    Viewport const& getViewport(size_t cascade) const noexcept {
+        return mCascades[cascade].viewport;
+    }
+
+    // Returns whether the static casters cached for a cascade are still valid: the tile,
+    // the static casters and the cache itself didn't change, and the light's transform moved
+    // by less than a fraction of a texel. Otherwise the new state is recorded, and the static
+    // casters must be rendered in the cache again. Call after setTile().
+    bool updateStaticCache(size_t cascade, uint32_t staticCastersHash,
+            uint32_t cacheGeneration) noexcept;
 
     // Computes the transform to use in the shader to access the shadow map.
-    // Valid after calling update().
-    math::mat4f const& getLightSpaceMatrix() const noexcept { return mLightSpace; }
+    // Valid after calling setTile().
+    math::mat4f const& getLightSpaceMatrix(size_t cascade) const noexcept {
+        return mCascades[cascade].lightSpace;
+    }
 
-    // return the size of a texel in world space (pre-warping)
-    float getTexelSizeWorldSpace() const noexcept { return mTexelSizeWs; }
+    // return the size of a texel in world space (pre-warping), at a distance of 1 from the light
+    // for spot lights.
+    float getTexelSizeWorldSpace(size_t cascade) const noexcept {
+        return mCascades[cascade].texelSizeWs;
+    }
 
     // Returns the shadow map's depth range. Valid after init().
-    float getSceneRange() const noexcept { return mSceneRange; }
+    float getSceneRange(size_t cascade) const noexcept { return mCascades[cascade].sceneRange; }
 
-    // Returns the light's projection. Valid after calling update().
-    FCamera const& getCamera() const noexcept { return *mCamera; }
+    // Returns the view-space distance up to which a cascade is used. Valid after calling update().
+    float getCascadeSplit(size_t cascade) const noexcept { return mCascades[cascade].split; }
 
-    // Set-up the render target, call before rendering the shadow map.
-    void beginRenderPass(driver::DriverApi& driverApi) const noexcept;
+    // Returns the light's projection. Valid after calling update().
+    FCamera const& getCamera(size_t cascade) const noexcept { return *mCascades[cascade].camera; }
 
     // use only for debugging
     FCamera const& getDebugCamera() const noexcept { return *mDebugCamera; }
 
+    // transform of a cascade without visible shadows, everything is lit
+    static math::mat4f getLitLightSpaceMatrix() noexcept;
+
 private:
     struct CameraInfo {
         math::mat4f projection;
@@ -104,9 +139,40 @@ private:
     // 8 corners, 12 segments w/ 2 intersection max -- all of this twice (8 + 12 * 2) * 2 (768 bytes)
     using FrustumBoxIntersection = std::array<math::float3, 64>;
 
+    // what was last rendered in the static casters cache of a cascade
+    struct StaticCache {
+        math::mat4f tileLightSpace;
+        Viewport viewport;
+        uint32_t castersHash = 0;
+        uint32_t generation = 0;
+        bool valid = false;
+    };
+
+    struct Cascade {
+        FCamera* camera = nullptr;
+        math::mat4f tileLightSpace;     // to the texture coordinates of the cascade's own tile
+        math::mat4f lightSpace;         // to the texture coordinates of the atlas
+        float sceneRange = 0.0f;
+        float texelSizeWs = 0.0f;
+        float split = 0.0f;
+        Viewport viewport;
+        StaticCache cache;
+        bool hasVisibleShadows = false;
+    };
+
     void computeShadowCameraDirectional(
-            math::float3 const& direction, FScene const* scene, CameraInfo const& camera,
-            uint8_t visibleLayers) noexcept;
+            math::float3 const& direction,
+            Aabb const& wsShadowCastersVolume, Aabb const& wsShadowReceiversVolume,
+            CameraInfo const& camera, size_t cascade) noexcept;
+
+    void computeShadowCameraSpot(math::float3 const& position, math::float3 const& direction,
+            float cosOuter, float radius,
+            Aabb const& wsShadowCastersVolume, Aabb const& wsShadowReceiversVolume) noexcept;
+
+    // splits [n, f] into 'count' ranges, splits must have room for count + 1 values
+    static void computeCascadeSplits(float* splits, size_t count, float n, float f) noexcept;
+
+    static void setProjectionNearFar(math::mat4f& projection, float n, float f) noexcept;
 
     static math::mat4f applyLISPSM(
             CameraInfo const& camera, float dzn, float dzf, const math::mat4f& LMpMv,
@@ -119,6 +185,12 @@ private:
     static inline void computeFrustumCorners(math::float3* out,
             const math::mat4f& projectionViewInverse) noexcept;
 
+    float computeReceiversDimension(Aabb const& wsShadowReceiversVolume,
+            details::CameraInfo const& camera, Viewport const& viewport) noexcept;
+
+    static uint32_t chooseDimension(float receiversDimension,
+            uint32_t currentDimension, uint32_t maxDimension) noexcept;
+
     static inline math::float2 computeNearFar(math::mat4f const& lightView,
             Aabb const& wsShadowCastersVolume) noexcept;
 
@@ -167,19 +239,13 @@ private:
             { 2, 6, 7, 3 },  // top
     };
 
-    FCamera* mCamera = nullptr;
+    // each cascade is rendered in its own tile of mShadowMapDimension
+    Cascade mCascades[CONFIG_MAX_SHADOW_CASCADES];
     FCamera* mDebugCamera = nullptr;
-    math::mat4f mLightSpace;
-    float mSceneRange = 0.0f;
-    float mTexelSizeWs = 0.0f;
-
-    // set-up in prepare()
-    Viewport mViewport;
-    Handle<HwTexture> mShadowMapHandle;
-    Handle<HwRenderTarget> mShadowMapRenderTarget;
 
     // set-up in update()
     uint32_t mShadowMapDimension = 0;
+    uint32_t mCascadeCount = 1;
     bool mHasVisibleShadows = false;
 
     // use a member here (instead of stack) because we don't want to pay the
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DETAILS_SKINNINGBUFFER_H
+#define TNT_FILAMENT_DETAILS_SKINNINGBUFFER_H
+
+#include "upcast.h"
+
+#include "driver/DriverApiForward.h"
+#include "driver/Handle.h"
+#include "driver/UniformBuffer.h"
+
+#include <filament/EngineEnums.h>
+#include <filament/SkinningBuffer.h>
+
+#include <utils/compiler.h>
+
+#include <stdint.h>
+
+namespace filament {
+namespace details {
+
+class FEngine;
+
+class FSkinningBuffer : public SkinningBuffer {
+public:
+    // UniformBuffer tracks its dirty range in 16 bits of 4-byte words, and the buffer is padded
+    // so that a full range of CONFIG_MAX_BONE_COUNT bones can be bound at any offset
+    static constexpr size_t MAX_BONE_COUNT =
+            (size_t(UINT16_MAX) * 4) / sizeof(Bone) - CONFIG_MAX_BONE_COUNT;
+
+    FSkinningBuffer(FEngine& engine, const Builder& builder);
+
+    // frees driver resources, object becomes invalid
+    void terminate(FEngine& engine);
+
+    Handle<HwUniformBuffer> getHwHandle() const noexcept { return mHandle; }
+
+    size_t getBoneCount() const noexcept { return mBoneCount; }
+
+    size_t getBoneOffsetAlignment() const noexcept { return mBoneOffsetAlignment; }
+
+    void setBones(Bone const* transforms, size_t boneCount, size_t offset) noexcept;
+    void setBones(math::mat4f const* transforms, size_t boneCount, size_t offset) noexcept;
+
+    // uploads all the bones modified since the previous call, if any
+    void commit(driver::DriverApi& driver) const noexcept;
+
+    // these are shared with the renderables that own their bones
+    static void writeBones(UniformBuffer& buffer,
+            Bone const* transforms, size_t boneCount, size_t offset) noexcept;
+    static void writeBones(UniformBuffer& buffer,
+            math::mat4f const* transforms, size_t boneCount, size_t offset) noexcept;
+
+private:
+    friend class SkinningBuffer;
+    Handle<HwUniformBuffer> mHandle;
+    UniformBuffer mBones;
+    uint32_t mBoneCount;
+    uint32_t mBoneOffsetAlignment;
+};
+
+FILAMENT_UPCAST(SkinningBuffer)
+
+} // namespace details
+} // namespace filament
+
+#endif // TNT_FILAMENT_DETAILS_SKINNINGBUFFER_H
@@ -42,7 +42,8 @@ class FSkybox : public Skybox {
 public:
     FSkybox(FEngine& engine, const Builder& builder) noexcept;
 
-    static FMaterial const* createMaterial(FEngine& engine, driver::TextureFormat format);
+    static FMaterial const* createMaterial(FEngine& engine, driver::TextureFormat format,
+            bool irradiance);
 
     void terminate(FEngine& engine) noexcept;
 
@@ -33,6 +33,7 @@ class FEngine;
 class FSwapChain : public SwapChain {
 public:
     FSwapChain(FEngine& engine, void* nativeWindow, uint64_t flags);
+    FSwapChain(FEngine& engine, uint32_t width, uint32_t height, uint64_t flags);
     void terminate(FEngine& engine) noexcept;
 
     void makeCurrent(driver::DriverApi& driverApi) noexcept {
@@ -51,10 +52,22 @@ public:
         return (mConfigFlags & CONFIG_TRANSPARENT) != 0;
     }
 
+    bool isHeadless() const noexcept {
+        return mHeadless;
+    }
+
+    void setFrameLatency(uint8_t latency) noexcept;
+
+    uint8_t getFrameLatency() const noexcept {
+        return mFrameLatency;
+    }
+
 private:
     Handle<HwSwapChain> mSwapChain;
     void* mNativeWindow = nullptr;
     uint64_t mConfigFlags = 0;
+    uint8_t mFrameLatency = 2;
+    bool mHeadless = false;
 };
 
 FILAMENT_UPCAST(SwapChain)
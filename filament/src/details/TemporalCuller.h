@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DETAILS_TEMPORALCULLER_H
+#define TNT_FILAMENT_DETAILS_TEMPORALCULLER_H
+
+#include "details/Culler.h"
+
+#include <filament/Frustum.h>
+
+#include <math/vec3.h>
+#include <math/vec4.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace filament {
+namespace details {
+
+/*
+ * The TemporalCuller culls the renderables of a view against its camera frustum, reusing the
+ * results of the previous frames.
+ *
+ * When a box is tested, the distance by which it passes (or fails) the test is kept: the box
+ * stays visible (or invisible) until a plane of the frustum moved by that distance where the
+ * box is. The motion of each plane is bounded from one frame to the next by its translation at
+ * the camera position, plus its rotation times the distance from the camera, so the results
+ * are always the ones the Culler would give. Boxes which are well inside or well outside the
+ * frustum are only tested again after a few frames of camera motion, or never with a still
+ * camera.
+ *
+ * A renderable is always tested again after its data changed in the scene, see
+ * FScene::getRenderableVersions().
+ */
+class TemporalCuller {
+public:
+    // forgets the previous results, all the renderables are tested by the next cull()
+    void clear() noexcept;
+
+    // Records the culling frustum of this frame, and the position of its camera, for 'count'
+    // renderables. Call once per frame, before cull().
+    void prepare(Frustum const& frustum, math::float3 const& position, size_t count) noexcept;
+
+    // Culls the renderables [first, first + count) of the frame: 'bit' is set in 'results' for
+    // the visible ones, all other bits are cleared. The arrays are indexed from 0. This can be
+    // called from several threads, for disjoint ranges.
+    void cull(Culler::result_type* results,
+            math::float3 const* center, math::float3 const* extent, uint32_t const* versions,
+            size_t first, size_t count, size_t bit) noexcept;
+
+    // forgets the results of the renderables [first, first + count), which cull() skipped this
+    // frame, they're tested the next time they're culled
+    void invalidate(size_t first, size_t count) noexcept;
+
+private:
+    math::float4 mPlanes[6];
+    math::float3 mPosition;
+    bool mHasFrustum = false;
+
+    // bounds of the motion of the planes since the previous frame
+    float mTranslation = 0;     // at the camera position
+    float mRotation = 0;        // per unit of distance from the camera
+    float mMotion = 0;          // of the camera
+
+    // for each renderable, the largest distance of the box to the planes (negative when the
+    // box is visible), minus the motion of the planes since then
+    std::vector<float> mDistances;
+    // a bound of the distance from the box to the camera
+    std::vector<float> mRadii;
+    // the version of the renderable in the scene, when it was tested
+    std::vector<uint32_t> mVersions;
+};
+
+} // namespace details
+} // namespace filament
+
+#endif // TNT_FILAMENT_DETAILS_TEMPORALCULLER_H
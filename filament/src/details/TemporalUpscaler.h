@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DETAILS_TEMPORALUPSCALER_H
+#define TNT_FILAMENT_DETAILS_TEMPORALUPSCALER_H
+
+#include "FrameGraph.h"
+#include "RenderTargetPool.h"
+
+#include "details/Camera.h"
+
+#include <filament/Viewport.h>
+
+#include <math/mat4.h>
+#include <math/vec2.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+namespace details {
+
+class FEngine;
+
+/*
+ * The TemporalUpscaler accumulates the frames of a view, rendered at the scaled viewport, into
+ * a history at the full viewport size. It replaces the bilinear upscaling of the dynamic
+ * resolution, and anti-aliases the image as a side effect.
+ *
+ * Each frame is rendered with its projection offset by a different sub-pixel jitter, so that
+ * consecutive frames sample different points of each pixel. The history is reprojected with the
+ * depth of the current frame and the camera of the previous one (there are no per-object motion
+ * vectors, so moving objects leave a short trail), clamped to the colors around the current
+ * pixel to reject what was disoccluded, and blended with the current frame.
+ */
+class TemporalUpscaler {
+public:
+    // number of jitter positions, cycled through
+    static constexpr size_t JITTER_COUNT = 8;
+
+    // weight of the history in the blended color
+    static constexpr float HISTORY_WEIGHT = 0.9f;
+
+    explicit TemporalUpscaler(FEngine& engine) noexcept;
+    ~TemporalUpscaler() noexcept;
+
+    TemporalUpscaler(TemporalUpscaler const& rhs) = delete;
+    TemporalUpscaler& operator=(TemporalUpscaler const& rhs) = delete;
+
+    // returns the history to the pool
+    void terminate() noexcept;
+
+    // forgets the history, e.g. after a camera cut or when the upscaling is disabled
+    void clear() noexcept;
+
+    // Moves to the next jitter position, and records the camera of this frame rendered at
+    // viewport (the scaled viewport). Call once per frame, before rendering.
+    void prepare(CameraInfo const& camera, Viewport const& viewport) noexcept;
+
+    // the sub-pixel offset of this frame's projection, in pixels of the scaled viewport
+    math::float2 getJitter() const noexcept { return mJitter; }
+
+    // Adds the pass blending color (at svp) with the history into output (at vp). depth must be
+    // the target the color was rendered with, its depth buffer is sampled.
+    void addPass(FrameGraph& fg, FrameGraphResource color, FrameGraphResource depth,
+            FrameGraphResource output, Viewport const& vp, Viewport const& svp) noexcept;
+
+private:
+    void resolve(RenderTargetPool::Target const* color, RenderTargetPool::Target const* depth,
+            Handle<HwRenderTarget> output, Viewport const& vp, Viewport const& svp) noexcept;
+
+    FEngine& mEngine;
+    RenderTargetPool::Target const* mHistory = nullptr;
+    uint32_t mHistoryWidth = 0;
+    uint32_t mHistoryHeight = 0;
+    math::mat4f mClipFromWorld;             // this frame, without the jitter
+    math::mat4f mHistoryClipFromWorld;      // the last frame in the history, without the jitter
+    math::float2 mJitter = 0.0f;
+    uint32_t mFrameIndex = 0;
+};
+
+} // namespace details
+} // namespace filament
+
+#endif // TNT_FILAMENT_DETAILS_TEMPORALUPSCALER_H
@@ -34,6 +34,7 @@ class FStream;
 class FTexture : public Texture {
 public:
     static bool isTextureFormatSupported(FEngine& engine, InternalFormat format) noexcept;
+    static bool isTextureFormatMipmappable(FEngine& engine, InternalFormat format) noexcept;
     static size_t computeTextureDataSize(Texture::Format format, Texture::Type type,
             size_t stride, size_t height, size_t alignment) noexcept;
 
@@ -58,11 +59,29 @@ public:
     void setImage(FEngine& engine, size_t level,
             PixelBufferDescriptor&& buffer, const FaceOffsets& faceOffsets) const noexcept;
 
+    void setImage(FEngine& engine, size_t level,
+            uint32_t xoffset, uint32_t yoffset, uint32_t zoffset,
+            uint32_t width, uint32_t height, uint32_t depth,
+            PixelBufferDescriptor&& buffer) const noexcept;
+
+    void setImage(FEngine& engine, size_t level, Region const* regions, size_t count,
+            PixelBufferDescriptor&& buffer) const noexcept;
+
     void setExternalImage(FEngine& engine, void* image) noexcept;
     void setExternalStream(FEngine& engine, FStream* stream) noexcept;
 
     void generateMipmaps(FEngine& engine) const noexcept;
 
+    void generateMipmaps(FEngine& engine, PixelBufferDescriptor&& buffer) const noexcept;
+
+    void setStreaming(FEngine& engine, StreamingCallback callback, void* user) noexcept;
+
+    // bit i is set when level i was uploaded
+    uint32_t getLoadedLevels() const noexcept { return mLoadedLevels; }
+
+    // the levels finer than the given one are not uploaded anymore, see TextureStreamer
+    void evictLevels(size_t level) noexcept { mLoadedLevels &= ~((1u << level) - 1u); }
+
     void setSampleCount(size_t sampleCount) noexcept { mSampleCount = uint8_t(sampleCount); }
     size_t getSampleCount() const noexcept { return mSampleCount; }
     bool isMultisample() const noexcept { return mSampleCount > 1; }
@@ -73,6 +92,9 @@ public:
 
     static size_t getFormatSize(InternalFormat format) noexcept;
 
+    // estimate of the GPU memory of all the levels, compressed formats count 1 byte per texel
+    size_t getSize() const noexcept;
+
 private:
     friend class Texture;
     Handle<HwTexture> mHandle;
@@ -85,6 +107,8 @@ private:
     uint8_t mSampleCount = 1;
     FStream* mStream = nullptr;
     Usage mUsage = Usage::DEFAULT;
+    mutable uint32_t mLoadedLevels = 0;
+    bool mStreamed = false;
 };
 
 
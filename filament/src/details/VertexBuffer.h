@@ -45,6 +45,9 @@ public:
 
     size_t getVertexCount() const noexcept;
 
+    // size of all the buffers, in bytes
+    size_t getSize() const noexcept;
+
     AttributeBitset getDeclaredAttributes() const noexcept {
         return mDeclaredAttributes;
     }
@@ -54,14 +57,39 @@ public:
             driver::BufferDescriptor&& buffer,
             uint32_t byteOffset = 0, uint32_t byteSize = 0);
 
+    // the box the positions are quantized in, which the renderables drawing this buffer apply
+    // to their transform, or null when the positions are stored as they are
+    Box const* getPositionBounds() const noexcept {
+        return mHasPositionBounds ? &mPositionBounds : nullptr;
+    }
+
 private:
     friend class VertexBuffer;
 
+    // type an attribute is stored as, with Builder::quantized()
+    static AttributeType getQuantizedType(size_t attribute, AttributeType type,
+            bool hasPositionBounds) noexcept;
+
+    // lays out the quantized attributes of each buffer, see Builder::quantized()
+    void quantize(bool hasPositionBounds) noexcept;
+
+    // converts the vertices of a quantized buffer from the layout declared by the builder
+    void quantizeVertices(uint8_t bufferIndex, void* dst, void const* src,
+            size_t count) const noexcept;
+
     Handle<HwVertexBuffer> mHandle;
     std::array<Builder::AttributeData, MAX_ATTRIBUTE_BUFFERS_COUNT> mAttributes;
     AttributeBitset mDeclaredAttributes;
     uint32_t mVertexCount = 0;
     uint8_t mBufferCount = 0;
+
+    // with quantization, the layout given to setBufferAt(), mAttributes being the stored one.
+    // The strides of the buffers which aren't quantized are 0.
+    std::array<Builder::AttributeData, MAX_ATTRIBUTE_BUFFERS_COUNT> mSourceAttributes;
+    std::array<uint8_t, MAX_ATTRIBUTE_BUFFERS_COUNT> mSourceStrides = {};
+    std::array<uint8_t, MAX_ATTRIBUTE_BUFFERS_COUNT> mQuantizedStrides = {};
+    Box mPositionBounds;
+    bool mHasPositionBounds = false;
 };
 
 FILAMENT_UPCAST(VertexBuffer)
@@ -21,11 +21,17 @@
 
 #include "upcast.h"
 
+#include "RenderPass.h"
+
 #include "details/Allocators.h"
 #include "details/Camera.h"
+#include "details/DepthPyramid.h"
 #include "details/Froxelizer.h"
+#include "details/ShadowAtlas.h"
 #include "details/ShadowMap.h"
 #include "details/Scene.h"
+#include "details/TemporalCuller.h"
+#include "details/TemporalUpscaler.h"
 
 #include "driver/DriverApi.h"
 #include "driver/Handle.h"
@@ -37,7 +43,8 @@
 #include <utils/Slice.h>
 #include <utils/Range.h>
 
-#include <deque>
+#include <memory>
+#include <vector>
 
 namespace utils {
 class JobSystem;
@@ -64,7 +71,11 @@ public:
     void prepare(FEngine& engine, driver::DriverApi& driver, ArenaScope& arena,
             Viewport const& viewport) noexcept;
 
-    void setScene(FScene* scene) { mScene = scene; }
+    void setScene(FScene* scene) {
+        // the results of the temporal culling are for the renderables of the previous scene
+        mTemporalCuller.clear();
+        mScene = scene;
+    }
     FScene const* getScene() const noexcept { return mScene; }
     FScene* getScene() noexcept { return mScene; }
 
@@ -73,6 +84,24 @@ public:
 
     CameraInfo const& getCameraInfo() const noexcept { return mViewingCameraInfo; }
 
+    // the frustum the renderables are culled against, valid after prepare()
+    Frustum const& getCullingFrustum() const noexcept { return mCullingFrustum; }
+
+    // stereo rendering, the culling camera is the left eye
+    void setStereoCamera(FCamera* rightEye) noexcept { mStereoCamera = rightEye; }
+    FCamera const* getStereoCamera() const noexcept { return mStereoCamera; }
+    bool isStereo() const noexcept { return mStereoCamera != nullptr; }
+
+    // see View::setCullingSource()
+    void setCullingSource(FView const* view) noexcept { mCullingSource = view; }
+    FView const* getCullingSource() const noexcept { return mCullingSource; }
+
+    // the camera of the right eye, valid after prepare() when isStereo() is true
+    CameraInfo const& getStereoCameraInfo() const noexcept { return mStereoCameraInfo; }
+
+    // the half of viewport an eye renders into, 0 is the left eye
+    static Viewport getEyeViewport(Viewport const& viewport, size_t eye) noexcept;
+
     void setViewport(Viewport const& viewport) noexcept;
     Viewport const& getViewport() const noexcept {
         return mViewport;
@@ -113,34 +142,169 @@ public:
         return mName.c_str();
     }
 
-    void prepareCamera(const CameraInfo& camera, const Viewport& viewport) const noexcept;
+    // jitter offsets the projection, in pixels of the viewport (see TemporalUpscaler)
+    void prepareCamera(const CameraInfo& camera, const Viewport& viewport,
+            math::float2 jitter = 0.0f) const noexcept;
     void prepareShadowing(FEngine& engine, driver::DriverApi& driver,
-            FScene::RenderableSoa& renderableData, FScene::LightSoa const& lightData) noexcept;
-    void prepareLighting(
-            FEngine& engine, FEngine::DriverApi& driver, ArenaScope& arena, Viewport const& viewport) noexcept;
+            FScene::LightSoa const& lightData, Viewport const& viewport) noexcept;
+    // the lights were already culled and sorted when prepareLights is false
+    void prepareLighting(FEngine& engine, FEngine::DriverApi& driver, ArenaScope& arena,
+            Viewport const& viewport, bool prepareLights) noexcept;
+
+    // prepares the scene, then culls and partitions it, the results are left in the scene
+    void prepareScene(FEngine& engine, driver::DriverApi& driver, Viewport const& viewport,
+            math::mat4f const& worldOriginScene) noexcept;
     void froxelize(FEngine& engine) const noexcept;
     void commitUniforms(driver::DriverApi& driverApi) const noexcept;
+    void commitPerRenderableUniforms(FEngine& engine, driver::DriverApi& driverApi,
+            FScene::RenderableSoa const& renderableData, Range range) noexcept;
     void commitFroxels(driver::DriverApi& driverApi) const noexcept;
 
     bool hasDirectionalLight() const noexcept { return mHasDirectionalLight; }
     bool hasDynamicLighting() const noexcept { return mHasDynamicLighting; }
-    bool hasShadowing() const noexcept { return mHasShadowing & mDirectionalShadowMap.hasVisibleShadows(); }
+    bool hasShadowing() const noexcept { return mHasShadowing; }
+    bool hasDirectionalShadowing() const noexcept { return mHasDirectionalShadowing; }
 
-    void prepareVisibleRenderables(utils::JobSystem& js, FScene::RenderableSoa& renderableData) const noexcept;
-
-    void prepareVisibleShadowCasters(utils::JobSystem& js, FScene::RenderableSoa& renderableData,
-                                     Frustum const& lightFrustum) const noexcept;
+    // Launches the culling of the renderables as children of parent, which finishes once
+    // VISIBLE_MASK is complete. Nothing in there waits for other jobs.
+    void prepareVisibleRenderables(utils::JobSystem& js, utils::JobSystem::Job* parent,
+            FScene::RenderableSoa& renderableData) const noexcept;
 
     void updatePrimitivesLod(
             FEngine& engine, const CameraInfo& camera,
             FScene::RenderableSoa& renderableData, Range visibles) noexcept;
 
-    static void cullRenderables(utils::JobSystem& js, FScene::RenderableSoa& renderableData,
-                                Frustum const& frustum, size_t bit) noexcept;
+    // The culling functions below only launch their jobs as children of parent, the frustums
+    // must stay alive until it has finished.
+    static void cullRenderables(utils::JobSystem& js, utils::JobSystem::Job* parent,
+            FScene::RenderableSoa& renderableData, Frustum const& frustum, size_t bit) noexcept;
+
+    // culls against both frustums in a single pass, this sets both VISIBLE_MASK bits
+    static void cullRenderables(utils::JobSystem& js, utils::JobSystem::Job* parent,
+            FScene::RenderableSoa& renderableData,
+            Frustum const& cameraFrustum, Frustum const& lightFrustum) noexcept;
+
+    // same as above, but only the leaves of the hierarchy that intersect either frustum are
+    // tested individually. lightFrustum can be null.
+    void cullRenderables(utils::JobSystem& js, utils::JobSystem::Job* parent,
+            FScene::RenderableSoa& renderableData, Bvh const& bvh,
+            Frustum const& cameraFrustum, Frustum const* lightFrustum) const noexcept;
+
+    // culls against the camera frustum with mTemporalCuller, this sets VISIBLE_RENDERABLE_BIT
+    void cullRenderablesTemporally(utils::JobSystem& js, utils::JobSystem::Job* parent,
+            FScene::RenderableSoa& renderableData) const noexcept;
+
+    // culls the shadow casters of all the shadow maps but the first cascade (which is culled
+    // along with the camera, unless hasTemporalCulling() or hasGpuCulling()) in a single pass.
+    // This adds bits to VISIBLE_MASK and sets SPOT_SHADOW_MASK.
+    void cullShadowMaps(utils::JobSystem& js, utils::JobSystem::Job* parent,
+            FScene::RenderableSoa& renderableData) const noexcept;
+    void cullOccludedRenderables(utils::JobSystem& js, utils::JobSystem::Job* parent,
+            FScene::RenderableSoa& renderableData) const noexcept;
+
+    // bit of the shadow casters of a cascade or a spot light in the mask returned by
+    // getShadowCasterMask(), valid after prepare()
+    static uint32_t getShadowCascadeVisibleMask(size_t cascade) noexcept;
+    static uint32_t getSpotShadowVisibleMask(size_t index) noexcept;
+
+    // bits of the mask returned by getShadowCasterMask() selecting static or dynamic casters
+    static constexpr uint32_t STATIC_SHADOW_CASTERS  = 0x10000u;
+    static constexpr uint32_t DYNAMIC_SHADOW_CASTERS = 0x20000u;
+    static constexpr uint32_t ALL_SHADOW_CASTERS = STATIC_SHADOW_CASTERS | DYNAMIC_SHADOW_CASTERS;
+
+    // combines the VISIBLE_MASK and SPOT_SHADOW_MASK of a renderable
+    static uint32_t getShadowCasterMask(uint8_t visibleMask, uint8_t spotShadowMask,
+            bool staticCaster) noexcept {
+        return visibleMask | (uint32_t(spotShadowMask) << 8u) |
+               (staticCaster ? STATIC_SHADOW_CASTERS : DYNAMIC_SHADOW_CASTERS);
+    }
+
+    // whether a caster is in a shadow map, that is the mask of the shadow map has both one of
+    // the shadow map bits and one of the static/dynamic bits of the caster
+    static bool isInShadowMap(uint32_t casterMask, uint32_t shadowMapMask) noexcept {
+        const uint32_t mask = casterMask & shadowMapMask;
+        return (mask & ~ALL_SHADOW_CASTERS) && (mask & ALL_SHADOW_CASTERS);
+    }
 
     void setShadowsEnabled(bool enabled) noexcept { mShadowingEnabled = enabled; }
 
+    void setShadowCachingEnabled(bool enabled) noexcept { mShadowCachingEnabled = enabled; }
+
+    void setShadowAutoSizingEnabled(bool enabled) noexcept { mShadowAutoSizingEnabled = enabled; }
+
+    void setShadowType(ShadowType type) noexcept { mShadowType = type; }
+    ShadowType getShadowType() const noexcept { return mShadowType; }
+
+    void setOcclusionCullingEnabled(bool enabled) noexcept;
+    bool isOcclusionCullingEnabled() const noexcept { return mOcclusionCullingEnabled; }
+
+    // whether the depth pyramid is built this frame, which needs the color pass depth buffer
+    bool hasOcclusionCulling() const noexcept {
+        return mOcclusionCullingEnabled && mHasPostProcessPass && mSampleCount <= 1 &&
+               mDepthPyramid.isSupported() && !isStereo();
+    }
+
+    // builds the depth pyramid used for the occlusion culling of the next frames, from the
+    // color pass target. Call after the color pass, when hasOcclusionCulling() is true.
+    void updateDepthPyramid(RenderTargetPool::Target const* colorTarget,
+            Viewport const& viewport) noexcept;
+
+    void setTemporalCullingEnabled(bool enabled) noexcept;
+    bool isTemporalCullingEnabled() const noexcept { return mTemporalCullingEnabled; }
+
+    // whether the renderables are culled against the camera with the TemporalCuller this frame
+    bool hasTemporalCulling() const noexcept {
+        return mTemporalCullingEnabled && isCullingEnabled() && !hasGpuCulling();
+    }
+
+    void setGpuCullingEnabled(bool enabled) noexcept { mGpuCullingEnabled = enabled; }
+    bool isGpuCullingEnabled() const noexcept { return mGpuCullingEnabled; }
+
+    // whether the batches of the color pass are culled against the camera by the driver this
+    // frame, instead of the renderables by prepareVisibleRenderables()
+    bool hasGpuCulling() const noexcept {
+        return mGpuCullingEnabled && isCullingEnabled() && mGpuCullingSupported && !isStereo();
+    }
+
+    void setTemporalUpscalingEnabled(bool enabled) noexcept;
+    bool isTemporalUpscalingEnabled() const noexcept { return mTemporalUpscalingEnabled; }
+
+    // whether the temporal upscaler replaces FXAA and the upscaling blit this frame
+    bool hasTemporalUpscaling() const noexcept {
+        return mTemporalUpscalingEnabled && mHasPostProcessPass && mSampleCount <= 1 &&
+               !isStereo();
+    }
+
+    void setOrderIndependentTransparencyEnabled(bool enabled) noexcept {
+        mOrderIndependentTransparencyEnabled = enabled;
+    }
+    bool isOrderIndependentTransparencyEnabled() const noexcept {
+        return mOrderIndependentTransparencyEnabled;
+    }
+
+    // whether the order-independent transparent objects are drawn by their own passes this
+    // frame, which need the color pass depth buffer. Otherwise they're sorted back to front.
+    bool hasOrderIndependentTransparency() const noexcept {
+        return mOrderIndependentTransparencyEnabled && mHasPostProcessPass && mSampleCount <= 1 &&
+               !isStereo();
+    }
+
+    // the jitter of the color pass projection, 0 without temporal upscaling
+    math::float2 getJitter() const noexcept {
+        return hasTemporalUpscaling() ? mTemporalUpscaler.getJitter() : math::float2{ 0.0f };
+    }
+
+    TemporalUpscaler& getTemporalUpscaler() noexcept { return mTemporalUpscaler; }
+
     ShadowMap const& getShadowMap() const { return mDirectionalShadowMap; }
+    ShadowMap& getShadowMap() { return mDirectionalShadowMap; }
+
+    // the shadowed spot lights of this frame, valid after prepare()
+    size_t getSpotShadowCount() const noexcept { return mSpotShadowCount; }
+    ShadowMap const& getSpotShadowMap(size_t index) const { return *mSpotShadowMaps[index]; }
+    ShadowMap& getSpotShadowMap(size_t index) { return *mSpotShadowMaps[index]; }
+
+    ShadowAtlas const& getShadowAtlas() const noexcept { return mShadowAtlas; }
 
     FCamera const* getDirectionalLightCamera() const noexcept {
         return &mDirectionalShadowMap.getDebugCamera();
@@ -172,7 +336,16 @@ public:
         return mHasPostProcessPass;
     }
 
-    math::float2 updateScale(std::chrono::duration<float, std::milli> frameTime) noexcept;
+    // how long a previous frame took to render, see updateScale()
+    struct FrameTiming {
+        uint32_t frame = 0;         // the frame that was measured
+        float fixedMilli = 0;       // the part which doesn't depend on the resolution
+        float scalableMilli = 0;    // the part proportional to the number of pixels rendered
+    };
+
+    // returns the scale of the viewport for the given frame, which tries to bring the frame time
+    // to the target of the DynamicResolutionOptions
+    math::float2 updateScale(uint32_t frame, FrameTiming const& timing) noexcept;
 
     void setDynamicResolutionOptions(View::DynamicResolutionOptions const& options) noexcept;
 
@@ -182,6 +355,10 @@ public:
 
     void setDynamicLightingOptions(float zLightNear, float zLightFar) noexcept;
 
+    void setDynamicLightingLimits(uint32_t maxFroxelCount, uint32_t maxLightCount) noexcept;
+
+    void setLightBinning(bool enabled) noexcept;
+
     void setPostProcessingEnabled(bool enabled) noexcept {
         mHasPostProcessPass = enabled;
     }
@@ -194,6 +371,14 @@ public:
         return mDepthPrepass;
     }
 
+    void setSortOrder(SortOrder order) noexcept {
+        mSortOrder = order;
+    }
+
+    SortOrder getSortOrder() const noexcept {
+        return mSortOrder;
+    }
+
     Range const& getVisibleRenderables() const noexcept {
         return mVisibleRenderables;
     }
@@ -202,21 +387,48 @@ public:
         return mVisibleShadowCasters;
     }
 
+    // per-renderable uniforms of this frame, set by commitPerRenderableUniforms()
+    RenderPass::PerRenderableUniforms const& getPerRenderableUniforms() const noexcept {
+        return mPerRenderableUniforms;
+    }
+
+    // commands of the previous frame, for the color pass or a tile of the shadow atlas
+    RenderPass::CommandCache& getCommandCache(uint32_t commandTypeFlags,
+            size_t tile = 0) const noexcept {
+        return (commandTypeFlags & RenderPass::SHADOW) ?
+               mShadowPassCommandCaches[tile] : mColorPassCommandCache;
+    }
+
     FCamera& getCameraUser() noexcept { return *mCullingCamera; }
     void setCameraUser(FCamera* camera) noexcept { setCullingCamera(camera); }
 
 private:
-    void prepareVisibleLights(
-            FLightManager& lcm, utils::JobSystem& js, FScene::LightSoa& lightData) const;
+    // on average, lights per culling job are JOBS_PARALLEL_FOR_LIGHTS_GROUPS * Culler::MODULO
+    static constexpr size_t JOBS_PARALLEL_FOR_LIGHTS_GROUPS = 4;
+
+    // sets the VISIBILITY of lights [first, last), first must be a multiple of Culler::MODULO
+    void cullLights(FLightManager const& lcm, FScene::LightSoa& lightData,
+            size_t first, size_t last) const noexcept;
+
+    // keeps only the visible lights, once they've all been culled
+    void prepareVisibleLights(FScene::LightSoa& lightData) const noexcept;
 
     void computeVisibilityMasks(
             uint8_t visibleLayers, uint8_t const* layers,
             FRenderableManager::Visibility const* visibility, uint8_t* visibleMask,
-            size_t count) const;
+            uint8_t* spotShadowMask, size_t count) const;
+
+    // picks the shadowed spot lights of this frame and computes their shadow maps
+    void prepareSpotShadows(FEngine& engine, FScene::LightSoa const& lightData,
+            Aabb const& wsShadowCastersVolume, Aabb const& wsShadowReceiversVolume,
+            Viewport const& autoSizeViewport) noexcept;
 
     void bindPerViewUniformsAndSamplers(FEngine::DriverApi& driver) const noexcept {
         driver.bindUniforms(BindingPoints::PER_VIEW, getUbh());
+        driver.bindUniforms(BindingPoints::PER_FRAME, mPerFrameUbh);
         driver.bindSamplers(BindingPoints::PER_VIEW, getUsh());
+        mFroxelizer.getFroxelBuffer().bindStorage(driver, StorageBindingPoints::FROXELS);
+        mFroxelizer.getRecordBuffer().bindStorage(driver, StorageBindingPoints::RECORDS);
     }
 
     // we don't inline this one, because the function is quite large and there is not much to
@@ -228,6 +440,7 @@ private:
     // these are accessed in the render loop, keep together
     Handle<HwSamplerBuffer> mPerViewSbh;
     Handle<HwUniformBuffer> mPerViewUbh;
+    Handle<HwUniformBuffer> mPerFrameUbh;
 
     UniformBuffer& getUb() const noexcept { return mPerViewUb; }
     Handle<HwUniformBuffer> getUbh() const noexcept { return mPerViewUbh; }
@@ -238,8 +451,12 @@ private:
     FScene* mScene = nullptr;
     FCamera* mCullingCamera = nullptr;
     FCamera* mViewingCamera = nullptr;
+    FCamera* mStereoCamera = nullptr;
+    FView const* mCullingSource = nullptr;
+    uint32_t mCulledFrame = 0;  // the engine frame in which prepareScene() last ran
 
     CameraInfo mViewingCameraInfo;
+    CameraInfo mStereoCameraInfo;
     Frustum mCullingFrustum;
 
     mutable Froxelizer mFroxelizer;
@@ -255,18 +472,38 @@ private:
     uint8_t mSampleCount = 1;
     AntiAliasing mAntiAliasing = AntiAliasing::FXAA;
     bool mShadowingEnabled = true;
+    bool mShadowCachingEnabled = false;
+    bool mShadowAutoSizingEnabled = false;
+    ShadowType mShadowType = ShadowType::PCF;
+    bool mOcclusionCullingEnabled = false;
+    bool mTemporalCullingEnabled = false;
+    bool mGpuCullingEnabled = false;
+    bool mGpuCullingSupported = false;
+    bool mTemporalUpscalingEnabled = false;
+    bool mOrderIndependentTransparencyEnabled = false;
+    uint32_t mMaxLightCount = CONFIG_MAX_LIGHT_COUNT;
     bool mHasPostProcessPass = true;
     DepthPrepass mDepthPrepass = DepthPrepass::DEFAULT;
+    SortOrder mSortOrder = SortOrder::DEFAULT;
 
-    using duration = std::chrono::duration<float, std::milli>;
     DynamicResolutionOptions mDynamicResolution;
-    std::deque<duration> mFrameTimeHistory;
+
+    // the measurements are a few frames late, this is the scale each recent frame was rendered at
+    static constexpr size_t SCALE_HISTORY_SIZE = 16;
+    math::float2 mScaleHistory[SCALE_HISTORY_SIZE];
+    // frame time per unit of area of the latest measurements, a ring of options.history entries
+    static constexpr size_t COST_HISTORY_SIZE = 30;
+    float mCostHistory[COST_HISTORY_SIZE];
+    uint32_t mCostHistoryCount = 0;     // measurements in mCostHistory
+    uint32_t mCostHistoryHead = 0;      // where the next measurement goes
+    uint32_t mTimedFrame = 0;           // the frame of the latest measurement
+    float mPidErrors[2] = {};           // the errors of the previous two steps of the controller
 
     math::float2 mScale = 1.0f;
-    float mDynamicWorkloadScale = 1.0f;
     bool mIsDynamicResolutionSupported = false;
 
     mutable UniformBuffer mPerViewUb;
+    mutable UniformBuffer mPerFrameUb;  // the time, so that mPerViewUb stays clean between frames
     mutable SamplerBuffer mPerViewSb;
 
     utils::CString mName;
@@ -278,7 +515,39 @@ private:
     mutable bool mHasDirectionalLight = false;
     mutable bool mHasDynamicLighting = false;
     mutable bool mHasShadowing = false;
+    mutable bool mHasDirectionalShadowing = false;
     mutable ShadowMap mDirectionalShadowMap;
+    // shadow maps are allocated on demand, the first mSpotShadowCount are used this frame
+    std::unique_ptr<ShadowMap> mSpotShadowMaps[CONFIG_MAX_SHADOWED_SPOT_LIGHTS];
+    FLightManager::Instance mSpotShadowLights[CONFIG_MAX_SHADOWED_SPOT_LIGHTS];
+    size_t mSpotShadowCount = 0;
+    ShadowAtlas mShadowAtlas;
+    DepthPyramid mDepthPyramid;
+    mutable TemporalCuller mTemporalCuller;
+    TemporalUpscaler mTemporalUpscaler;
+    std::vector<std::pair<float, size_t>> mSpotShadowCandidates; // scratch space
+    mutable std::vector<Range> mCullingLeaves;  // scratch space used by cullRenderables()
+    // the frustums are kept here while the culling jobs run, see prepareVisibleRenderables()
+    struct ShadowFrustum {
+        Frustum frustum;
+        uint8_t* results;
+        size_t bit;
+    };
+    mutable Frustum mShadowCullingFrustum;
+    mutable ShadowFrustum mShadowCullingFrustums[ShadowAtlas::MAX_TILE_COUNT];
+    std::vector<Range> mCullingLightLeaves;     // scratch space used by prepare()
+    mutable RenderPass::CommandCache mColorPassCommandCache;
+    mutable RenderPass::CommandCache mShadowPassCommandCaches[ShadowAtlas::MAX_TILE_COUNT];
+
+    // The per-renderable uniforms of all visible renderables are uploaded at once, in a buffer
+    // that isn't reused for a few frames to avoid waiting on the GPU.
+    struct PerRenderableUbo {
+        Handle<HwUniformBuffer> handle;
+        size_t capacity = 0;
+    };
+    PerRenderableUbo mPerRenderableUbos[FEngine::CONFIG_PER_RENDERABLE_UBO_COUNT];
+    uint32_t mCurrentPerRenderableUbo = 0;
+    RenderPass::PerRenderableUniforms mPerRenderableUniforms;
 };
 
 FILAMENT_UPCAST(View)
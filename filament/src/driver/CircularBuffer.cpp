@@ -21,6 +21,7 @@
 #    include <unistd.h>
 #endif
 
+#include <assert.h>
 #include <stdio.h>
 
 #include <utils/ashmem.h>
@@ -87,15 +88,16 @@ void* CircularBuffer::alloc(size_t size) noexcept {
         if (reserve_vaddr != MAP_FAILED) {
             munmap(reserve_vaddr, size * 2 + BLOCK_SIZE);
             // map the circular buffer once...
-            vaddr = mmap(reserve_vaddr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            // (the mappings must be shared, so that writes through one are seen by the other)
+            vaddr = mmap(reserve_vaddr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
             if (vaddr != MAP_FAILED) {
                 // and map the circular buffer again, behind the previous copy...
                 vaddr_shadow = mmap((char*)vaddr + size, size,
-                        PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+                        PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
                 if (vaddr_shadow != MAP_FAILED && (vaddr_shadow == (char*)vaddr + size)) {
                     // finally map the guard page, to make sure we never corrupt memory
                     vaddr_guard = mmap((char*)vaddr_shadow + size, BLOCK_SIZE, PROT_NONE,
-                            MAP_PRIVATE, fd, (off_t)size);
+                            MAP_SHARED, fd, (off_t)size);
                     if (vaddr_guard != MAP_FAILED && (vaddr_guard == (char*)vaddr_shadow + size)) {
                         // woo-hoo success!
                         mUsesAshmem = fd;
@@ -120,16 +122,17 @@ void* CircularBuffer::alloc(size_t size) noexcept {
         if (fd >= 0)
             close(fd);
 
-        data = mmap(nullptr, size * 2 + BLOCK_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        data = mmap(nullptr, size * 2 + BLOCK_SIZE,
+                PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
 
-        ASSERT_POSTCONDITION(mData,
+        ASSERT_POSTCONDITION(data != MAP_FAILED,
                 "couldn't allocate %u KiB of memory for the command buffer",
                 (size * 2 / 1024));
 
         slog.d << "WARNING: Using soft CircularBuffer (" << (size*2 / 1024) << " KiB)" << io::endl;
 
         // guard page at the end
-        void* guard = (void*)(uintptr_t(mData) + size * 2);
+        void* guard = (void*)(uintptr_t(data) + size * 2);
         mprotect(guard, BLOCK_SIZE, PROT_NONE);
     }
     return data;
@@ -137,7 +140,8 @@ void* CircularBuffer::alloc(size_t size) noexcept {
 }
 
 void CircularBuffer::circularize() noexcept {
-    if (mUsesAshmem > 0) {
+    assert(mData);
+    if (mUsesAshmem >= 0) {
         intptr_t overflow = intptr_t(mHead) - (intptr_t(mData) + ssize_t(mSize));
         if (overflow >= 0) {
             assert(size_t(overflow) <= mSize);
@@ -37,6 +37,12 @@ public:
     //      to set it to 3*requiredSize to avoid blocking the render thread (usually the UI thread).
     explicit CircularBuffer(size_t bufferSize);
 
+    // Wraps 'size' bytes of memory owned by someone else, typically a range reserved in another
+    // CircularBuffer. Such a buffer can only be allocated from, it can't be circularized.
+    CircularBuffer(void* data, size_t size) noexcept
+            : mSize(size), mTail(data), mHead(data) {
+    }
+
     // can't be moved or copy-constructed
     CircularBuffer(CircularBuffer const& rhs) = delete;
     CircularBuffer(CircularBuffer&& rhs) noexcept = delete;
@@ -23,6 +23,9 @@
 
 #include "driver/CommandStream.h"
 
+#include <algorithm>
+#include <chrono>
+
 using namespace utils;
 
 namespace filament {
@@ -35,85 +38,135 @@ CommandBufferQueue::CommandBufferQueue(size_t requiredSize, size_t bufferSize)
 }
 
 CommandBufferQueue::~CommandBufferQueue() {
-    assert(!mCommandBuffersToExecute.size());
+    assert(mSliceHead.load() == mSliceTail.load());
 }
 
-void CommandBufferQueue::requestExit() {
+void CommandBufferQueue::wakeUp() noexcept {
+    // The other thread increments mWaiting before checking its condition (both are sequentially
+    // consistent), so either it sees our changes or we see that it's (about to be) waiting.
+    if (mWaiting.load()) {
+        std::lock_guard<utils::Mutex> lock(mLock);
+        mCondition.notify_all();
+    }
+}
+
+template<typename P>
+void CommandBufferQueue::waitUntil(P&& predicate) const noexcept {
     std::unique_lock<utils::Mutex> lock(mLock);
-    mExitRequested = true;
-    mCondition.notify_one();
+    mWaiting.fetch_add(1);
+    mCondition.wait(lock, std::forward<P>(predicate));
+    mWaiting.fetch_sub(1);
 }
 
-void CommandBufferQueue::flush() noexcept {
-    SYSTRACE_CALL();
+void CommandBufferQueue::requestExit() {
+    mExitRequested.store(true);
+    std::lock_guard<utils::Mutex> lock(mLock);
+    mCondition.notify_all();
+}
 
-    CircularBuffer& circularBuffer = mCircularBuffer;
-    if (circularBuffer.empty()) {
-        return;
+bool CommandBufferQueue::push(void* tail, void* head) noexcept {
+    const uint32_t index = mSliceHead.load(std::memory_order_relaxed);
+    if (UTILS_UNLIKELY(index - mSliceTail.load(std::memory_order_acquire) == MAX_SLICE_COUNT)) {
+        return false;
     }
+    mSlices[index % MAX_SLICE_COUNT] = { tail, head };
 
-    // add the terminating command
-    // always guaranteed to have enough space for the NoopCommand
-    new(circularBuffer.allocate(sizeof(NoopCommand))) NoopCommand(nullptr);
-
-    // end of this slice
-    void* const head = circularBuffer.getHead();
-
-    // beginning of this slice
-    void* const tail = circularBuffer.getTail();
+    // the slice is published with mSliceHead, the space is accounted for first because the
+    // consumer gives it back as soon as it's done with the slice.
+    const size_t used = size_t(intptr_t(head) - intptr_t(tail));
+    UTILS_UNUSED_IN_RELEASE const size_t freeSpace = mFreeSpace.fetch_sub(used);
+    // circular buffer is too small, we corrupted the stream
+    assert(used <= freeSpace);
+    mSliceHead.store(index + 1);
 
-    // size of this slice
-    uint32_t used = uint32_t(intptr_t(head) - intptr_t(tail));
+    Statistics& stats = mStatistics;
+    stats.flushedBytes += used;
+    stats.highWatermark = std::max(stats.highWatermark, mCircularBuffer.size() - mFreeSpace.load());
+    return true;
+}
 
-    circularBuffer.circularize();
+bool CommandBufferQueue::tryFlush() noexcept {
+    CircularBuffer& circularBuffer = mCircularBuffer;
+    if (!circularBuffer.empty()) {
+        if (UTILS_UNLIKELY(mSliceHead.load(std::memory_order_relaxed) -
+                mSliceTail.load(std::memory_order_acquire) == MAX_SLICE_COUNT)) {
+            // the consumer is too far behind, leave the commands in the buffer for now
+            return false;
+        }
+
+        // add the terminating command
+        // always guaranteed to have enough space for the NoopCommand
+        new(circularBuffer.allocate(sizeof(NoopCommand))) NoopCommand(nullptr);
+
+        // beginning and end of this slice
+        void* const tail = circularBuffer.getTail();
+        void* const head = circularBuffer.getHead();
+
+        circularBuffer.circularize();
+
+        // this is the only producer, so there is room for the slice
+        UTILS_UNUSED_IN_RELEASE bool pushed = push(tail, head);
+        assert(pushed);
+        wakeUp();
+    }
+    return mFreeSpace.load() >= mRequiredSize;
+}
 
-    std::unique_lock<utils::Mutex> lock(mLock);
-    mCommandBuffersToExecute.push_back({ tail, head });
+void CommandBufferQueue::flush() noexcept {
+    SYSTRACE_CALL();
 
-    // circular buffer is too small, we corrupted the stream
-    assert(used <= mFreeSpace);
+    if (UTILS_LIKELY(tryFlush())) {
+        // ideally (and usually) we don't have to wait, this is the common case
+        return;
+    }
 
-    // wait until there is enough space in the buffer
-    mFreeSpace -= used;
+    // Unfortunately, there is not enough space left (or too many slices), we'll have to wait.
+    // The space is given back as the slices are executed, which also makes room in the ring.
     const size_t requiredSize = mRequiredSize;
 
 #ifndef NDEBUG
-    size_t totalUsed = circularBuffer.size() - mFreeSpace;
-    mHighWatermark = std::max(mHighWatermark, totalUsed);
-    if (UTILS_UNLIKELY(totalUsed > requiredSize)) {
-        slog.d << "CommandStream used too much space: " << totalUsed
-            << ", out of " << requiredSize << " (will block)" << io::endl;
-    }
+    size_t totalUsed = mCircularBuffer.size() - mFreeSpace.load();
+    slog.d << "CommandStream used too much space: " << totalUsed
+        << ", out of " << requiredSize << " (will block)" << io::endl;
 #endif
 
-    if (UTILS_LIKELY(mFreeSpace >= requiredSize)) {
-        // ideally (and usually) we don't have to wait, this is the common case, so special case
-        // the unlock-before-notify, optimization.
-        lock.unlock();
-        mCondition.notify_one();
-    } else {
-        // unfortunately, there is not enough space left, we'll have to wait.
-        mCondition.notify_one(); // too bad there isn't a notify-and-wait
+    const auto start = std::chrono::steady_clock::now();
+    { // scope for systrace
         SYSTRACE_NAME("waiting: CircularBuffer::flush()");
-        mCondition.wait(lock, [this, requiredSize]() -> bool {
-            return mFreeSpace >= requiredSize;
-        });
+        while (!tryFlush()) {
+            waitUntil([this, requiredSize]() -> bool {
+                return mFreeSpace.load() >= requiredSize &&
+                       mSliceHead.load(std::memory_order_relaxed) - mSliceTail.load() < MAX_SLICE_COUNT;
+            });
+        }
     }
+    const auto duration = std::chrono::steady_clock::now() - start;
+
+    Statistics& stats = mStatistics;
+    stats.stallCount++;
+    stats.stallTime += uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
 }
 
-std::vector<CommandBufferQueue::Slice> CommandBufferQueue::waitForCommands() const {
-    std::unique_lock<utils::Mutex> lock(mLock);
-    while (mCommandBuffersToExecute.empty() && !mExitRequested) {
-        mCondition.wait(lock);
+void CommandBufferQueue::waitForCommands(std::vector<Slice>& slices) const {
+    waitUntil([this]() -> bool {
+        return mSliceTail.load(std::memory_order_relaxed) != mSliceHead.load() ||
+               mExitRequested.load();
+    });
+
+    // The slices stay in the ring until they're released, so their space can't be reused
+    // by the producer until then (see releaseBuffer()).
+    slices.clear();
+    const uint32_t head = mSliceHead.load(std::memory_order_acquire);
+    const uint32_t tail = mSliceTail.load(std::memory_order_relaxed);
+    for (uint32_t i = tail; i != head; i++) {
+        slices.push_back(mSlices[i % MAX_SLICE_COUNT]);
     }
-    return std::move(mCommandBuffersToExecute);
 }
 
 void CommandBufferQueue::releaseBuffer(CommandBufferQueue::Slice const& buffer) {
-    std::unique_lock<utils::Mutex> lock(mLock);
-    mFreeSpace += uintptr_t(buffer.end) - uintptr_t(buffer.begin);
-    lock.unlock();
-    mCondition.notify_one();
+    mFreeSpace.fetch_add(size_t(uintptr_t(buffer.end) - uintptr_t(buffer.begin)));
+    mSliceTail.store(mSliceTail.load(std::memory_order_relaxed) + 1);
+    wakeUp();
 }
 
 } // namespace filament
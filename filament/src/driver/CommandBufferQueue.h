@@ -23,31 +23,64 @@
 #include <utils/Condition.h>
 #include <utils/Mutex.h>
 
+#include <atomic>
 #include <vector>
 
+#include <stdint.h>
+
 namespace filament {
 
 /*
- * A produdcer-consumer command queue that uses a CircularBuffer as main storage
+ * A producer-consumer command queue that uses a CircularBuffer as main storage
+ *
+ * The Slices are handed from the producer (flush()) to the consumer (waitForCommands()) through
+ * a lock-free single-producer, single-consumer ring. The lock is only taken by a thread which
+ * has to sleep, and by the other thread to wake it up.
  */
 class CommandBufferQueue {
+public:
     struct Slice {
         void* begin;
         void* end;
     };
 
+    struct Statistics {
+        size_t highWatermark = 0;   // most bytes used in the circular buffer (after a flush)
+        uint64_t flushedBytes = 0;  // bytes flushed since the beginning
+        uint32_t stallCount = 0;    // number of flush() which had to wait for the consumer
+        uint64_t stallTime = 0;     // total time spent waiting in flush(), in nanoseconds
+    };
+
+private:
+    // maximum number of slices waiting to be executed, must be a power of two
+    static constexpr uint32_t MAX_SLICE_COUNT = 256;
+
     const size_t mRequiredSize;
 
     CircularBuffer mCircularBuffer;
 
+    // the ring of slices: mSliceHead is only written by the producer, mSliceTail by the consumer
+    Slice mSlices[MAX_SLICE_COUNT];
+    std::atomic<uint32_t> mSliceHead = { 0 };
+    std::atomic<uint32_t> mSliceTail = { 0 };
+
     // space available in the circular buffer
+    std::atomic<size_t> mFreeSpace;
+
+    std::atomic<bool> mExitRequested = { false };
 
+    // number of threads sleeping on mCondition
+    mutable std::atomic<uint32_t> mWaiting = { 0 };
     mutable utils::Mutex mLock;
     mutable utils::Condition mCondition;
-    mutable std::vector<Slice> mCommandBuffersToExecute;
-    size_t mFreeSpace = 0;
-    size_t mHighWatermark = 0;
-    bool mExitRequested = false;
+
+    // only accessed by the producer
+    Statistics mStatistics;
+
+    bool push(void* tail, void* head) noexcept;
+    void wakeUp() noexcept;
+    template<typename P>
+    void waitUntil(P&& predicate) const noexcept;
 
 public:
     // requiredSize: guaranteed available space after flush()
@@ -56,10 +89,15 @@ public:
 
     CircularBuffer& getCircularBuffer() { return mCircularBuffer; }
 
-    size_t getHigWatermark() noexcept { return mHighWatermark; }
+    // statistics about the producer, must be called from the producer thread
+    Statistics const& getStatistics() const noexcept { return mStatistics; }
+
+    // space available in the circular buffer, this can be called from any thread
+    size_t getFreeSpace() const noexcept { return mFreeSpace.load(std::memory_order_relaxed); }
 
-    // wait for commands to be available and returns an array containing these commands
-    std::vector<Slice> waitForCommands() const;
+    // wait for commands to be available and returns them in 'slices', whose storage is reused
+    // from one call to the next
+    void waitForCommands(std::vector<Slice>& slices) const;
 
     // return the memory used by this command buffer to the circular buffer
     // WARNING: releaseBuffer() must be called in sequence of the Slices returned by
@@ -70,6 +108,12 @@ public:
     // call blocks until the CircularBuffer has at least mRequiredSize bytes available.
     void flush() noexcept;
 
+    // Same as flush() but never blocks. Returns true if mRequiredSize bytes are available, like
+    // after flush(). Otherwise, either the commands couldn't be handed to the consumer or there
+    // isn't enough space left, and flush() must be called before writing more than
+    // getFreeSpace() bytes.
+    bool tryFlush() noexcept;
+
     // returns from waitForcommands() immediately.
     void requestExit();
 };
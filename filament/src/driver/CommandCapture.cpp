@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "driver/CommandCapture.h"
+
+#include <utils/Log.h>
+
+#include <algorithm>
+
+#include <assert.h>
+#include <string.h>
+
+using namespace utils;
+
+namespace filament {
+
+constexpr char CommandCapture::MAGIC[8];
+
+CommandCapture* CommandCapture::sCurrent = nullptr;
+
+CommandCapture::CommandCapture(Dispatcher const& dispatcher, const char* path) noexcept {
+#define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)
+#define DECL_DRIVER_API(methodName, paramsDecl, params) \
+    mMethods.push_back(dispatcher.methodName##_);
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params) \
+    mMethods.push_back(dispatcher.methodName##_);
+#include "driver/DriverAPI.inc"
+
+    mFile = path ? fopen(path, "wb") : nullptr;
+    if (!mFile) {
+        slog.e << "CommandCapture: couldn't open " << (path ? path : "(null)") << io::endl;
+        return;
+    }
+    slog.d << "CommandCapture: capturing commands to " << path << io::endl;
+
+    mBuffer.reserve(FLUSH_SIZE);
+    writeBytes(MAGIC, sizeof(MAGIC));
+    write(VERSION);
+    write(uint32_t(mMethods.size()));
+#define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)
+#define DECL_DRIVER_API(methodName, paramsDecl, params) \
+    write(uint8_t(sizeof(#methodName) - 1)); writeBytes(#methodName, sizeof(#methodName) - 1);
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params) \
+    write(uint8_t(sizeof(#methodName) - 1)); writeBytes(#methodName, sizeof(#methodName) - 1);
+#include "driver/DriverAPI.inc"
+}
+
+CommandCapture::~CommandCapture() noexcept {
+    if (mFile) {
+        flush();
+        fclose(mFile);
+    }
+    if (sCurrent == this) {
+        sCurrent = nullptr;
+    }
+}
+
+void CommandCapture::beginParameters() noexcept {
+    auto pos = std::find(mMethods.begin(), mMethods.end(), mExecute);
+    assert(pos != mMethods.end());
+    mRecord = mBuffer.size();
+    // the duration and size are filled by end()
+    write(uint16_t(pos - mMethods.begin()));
+    write(uint16_t(0));
+    write(uint32_t(0));
+    write(uint32_t(0));
+}
+
+void CommandCapture::end() noexcept {
+    if (mRecord == NO_RECORD) {
+        return;
+    }
+    const auto duration = std::chrono::steady_clock::now() - mStart;
+    const uint64_t ns = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    const uint32_t d = uint32_t(std::min(ns, uint64_t(UINT32_MAX)));
+    const uint32_t size = uint32_t(mBuffer.size() - mRecord - RECORD_HEADER_SIZE);
+    memcpy(mBuffer.data() + mRecord + 4, &d, sizeof(d));
+    memcpy(mBuffer.data() + mRecord + 8, &size, sizeof(size));
+    mRecord = NO_RECORD;
+
+    if (mBuffer.size() >= FLUSH_SIZE) {
+        flush();
+    }
+}
+
+void CommandCapture::flush() noexcept {
+    // only whole records are written, a command could be executing
+    const size_t size = mRecord == NO_RECORD ? mBuffer.size() : mRecord;
+    if (mFile && size) {
+        fwrite(mBuffer.data(), 1, size, mFile);
+        fflush(mFile);
+    }
+    mBuffer.erase(mBuffer.begin(), mBuffer.begin() + size);
+    if (mRecord != NO_RECORD) {
+        mRecord = 0;
+    }
+}
+
+void CommandCapture::writeBytes(void const* data, size_t size) noexcept {
+    if (mFile) {
+        uint8_t const* const p = static_cast<uint8_t const*>(data);
+        mBuffer.insert(mBuffer.end(), p, p + size);
+    }
+}
+
+void CommandCapture::writeSized(void const* data, size_t size) noexcept {
+    write(uint32_t(data ? size : 0));
+    if (data) {
+        writeBytes(data, size);
+    }
+}
+
+void CommandCapture::write(Driver::TargetBufferInfo const& info) noexcept {
+    write(info.handle);
+    write(info.level);
+    write(info.layer);
+}
+
+void CommandCapture::write(const char* string) noexcept {
+    writeSized(string, string ? strlen(string) : 0);
+}
+
+void CommandCapture::write(utils::CString const& string) noexcept {
+    writeSized(string.c_str(), string.size());
+}
+
+void CommandCapture::write(driver::BufferDescriptor const& buffer) noexcept {
+    writeSized(buffer.buffer, buffer.size);
+}
+
+void CommandCapture::write(driver::PixelBufferDescriptor const& buffer) noexcept {
+    write(static_cast<driver::BufferDescriptor const&>(buffer));
+    write(buffer.left);
+    write(buffer.top);
+    // this is either the stride or the size of a compressed image
+    write(buffer.stride);
+    write(uint8_t(buffer.format));
+    write(uint8_t(buffer.type));
+    write(uint8_t(buffer.alignment));
+}
+
+void CommandCapture::write(UniformBuffer const& buffer) noexcept {
+    writeSized(buffer.getBuffer(), buffer.getSize());
+}
+
+void CommandCapture::write(SamplerBuffer const& buffer) noexcept {
+    write(uint32_t(buffer.getSize()));
+    for (size_t i = 0, c = buffer.getSize(); i < c; i++) {
+        SamplerBuffer::Sampler const& sampler = buffer.getBuffer()[i];
+        write(sampler.t);
+        write(sampler.s);
+    }
+}
+
+void CommandCapture::write(Program const& program) noexcept {
+    // the interface blocks are only known by the engine, they're not captured
+    write(program.getName());
+    write(program.getVariant());
+    for (utils::CString const& source : program.getShadersSource()) {
+        write(source);
+    }
+}
+
+} // namespace filament
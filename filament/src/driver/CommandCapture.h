@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DRIVER_COMMANDCAPTURE_H
+#define TNT_FILAMENT_DRIVER_COMMANDCAPTURE_H
+
+#include "driver/CommandStream.h"
+
+#include <utils/compiler.h>
+
+#include <chrono>
+#include <type_traits>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+namespace filament {
+
+/*
+ * CommandCapture writes the commands executed by a CommandStream to a binary trace, with their
+ * parameters and how long the driver took to execute them. It's used when CAPTURE_COMMAND_STREAM
+ * is set (see CommandStream.h), and the traces can be inspected with tools/cmdtrace.
+ *
+ * The trace starts with a header, followed by one record per command; all values are little
+ * endian:
+ *
+ *  header:
+ *      char        magic[8]        "FILACMD"
+ *      uint32_t    version         VERSION
+ *      uint32_t    methodCount     number of driver methods, in the order of DriverAPI.inc
+ *      methodCount times:
+ *          uint8_t     length
+ *          char        name[length]
+ *
+ *  record:
+ *      uint16_t    method          index of the method in the header
+ *      uint16_t    reserved        0
+ *      uint32_t    duration        time spent executing the command, in nanoseconds
+ *      uint32_t    size            size of the parameters below
+ *      uint8_t     parameters[size]
+ *
+ * The parameters are written in order. Trivially copyable types are written as-is, buffers and
+ * strings are written as their uint32_t size followed by their content (see write()).
+ */
+class CommandCapture {
+public:
+    static constexpr uint32_t VERSION = 1;
+    static constexpr char MAGIC[8] = "FILACMD";
+
+    // the trace is written to 'path', there is no trace if it can't be opened
+    CommandCapture(Dispatcher const& dispatcher, const char* path) noexcept;
+    ~CommandCapture() noexcept;
+
+    CommandCapture(CommandCapture const& rhs) = delete;
+    CommandCapture& operator=(CommandCapture const& rhs) = delete;
+
+    bool isOpen() const noexcept { return mFile != nullptr; }
+
+    // the capture the executing commands write their parameters to, never null while executing
+    static CommandCapture* get() noexcept { return sCurrent; }
+    static void setCurrent(CommandCapture* capture) noexcept { sCurrent = capture; }
+
+    // Called around the execution of each command. Only the commands which write their
+    // parameters in between are recorded, so NoopCommand and CustomCommand are not.
+    inline void begin(CommandBase const* command) noexcept {
+        mExecute = command->getExecute();
+        mRecord = NO_RECORD;
+        mStart = std::chrono::steady_clock::now();
+    }
+    void end() noexcept;
+
+    // starts the record of the current command, this must be called before its parameters
+    // are written.
+    void beginParameters() noexcept;
+
+    // writes the recorded commands to the file
+    void flush() noexcept;
+
+    // trivially copyable types are written as-is
+    template<typename T,
+            typename = typename std::enable_if<std::is_trivially_copyable<T>::value>::type>
+    inline void write(T const& v) noexcept {
+        writeBytes(&v, sizeof(T));
+    }
+
+    // handles are written as their id (they're not trivially copyable in debug builds)
+    void write(HandleBase const& handle) noexcept { write(handle.getId()); }
+    void write(Driver::TargetBufferInfo const& info) noexcept;
+    void write(driver::FaceOffsets const& offsets) noexcept {
+        writeBytes(offsets.offsets, sizeof(offsets.offsets));
+    }
+
+    void write(const char* string) noexcept;
+    void write(utils::CString const& string) noexcept;
+    void write(driver::BufferDescriptor const& buffer) noexcept;
+    void write(driver::PixelBufferDescriptor const& buffer) noexcept;
+    void write(UniformBuffer const& buffer) noexcept;
+    void write(SamplerBuffer const& buffer) noexcept;
+    void write(Program const& program) noexcept;
+
+private:
+    static constexpr size_t NO_RECORD = size_t(-1);
+    static constexpr size_t RECORD_HEADER_SIZE = 12;
+    static constexpr size_t FLUSH_SIZE = 1024 * 1024;
+
+    void writeBytes(void const* data, size_t size) noexcept;
+    void writeSized(void const* data, size_t size) noexcept;
+
+    static CommandCapture* sCurrent;
+
+    FILE* mFile = nullptr;
+    std::vector<Dispatcher::Execute> mMethods;
+    std::vector<uint8_t> mBuffer;
+    Dispatcher::Execute mExecute = nullptr;
+    size_t mRecord = NO_RECORD;
+    std::chrono::steady_clock::time_point mStart;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_DRIVER_COMMANDCAPTURE_H
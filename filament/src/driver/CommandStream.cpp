@@ -16,6 +16,11 @@
 
 #include "driver/CommandStream.h"
 
+#if CAPTURE_COMMAND_STREAM
+#include "driver/CommandCapture.h"
+#include <stdlib.h>
+#endif
+
 #include <utils/CallStack.h>
 #include <utils/Log.h>
 #include <utils/Profiler.h>
@@ -60,6 +65,16 @@ CommandStream::CommandStream(Driver& driver, CircularBuffer& buffer) noexcept
 {
 }
 
+CommandStream::CommandStream(CommandStream const& stream, CircularBuffer& buffer) noexcept
+        : mDispatcher(stream.mDispatcher),
+          mDriver(stream.mDriver),
+          mCurrentBuffer(&buffer)
+#ifndef NDEBUG
+          , mThreadId(std::this_thread::get_id())
+#endif
+{
+}
+
 void CommandStream::execute(void* buffer) {
     SYSTRACE_CALL();
     Profiler::Counters c0;
@@ -73,9 +88,13 @@ void CommandStream::execute(void* buffer) {
 
     Driver& UTILS_RESTRICT driver = *mDriver;
     CommandBase* UTILS_RESTRICT base = static_cast<CommandBase*>(buffer);
-    UTILS_ALIGN_LOOP
-    while (UTILS_LIKELY(base)) {
-        base = base->execute(driver);
+    if (CAPTURE_COMMAND_STREAM) {
+        executeAndCapture(base);
+    } else {
+        UTILS_ALIGN_LOOP
+        while (UTILS_LIKELY(base)) {
+            base = base->execute(driver);
+        }
     }
 
     if (SYSTRACE_TAG) {
@@ -95,6 +114,22 @@ void CommandStream::execute(void* buffer) {
     }
 }
 
+UTILS_NOINLINE
+void CommandStream::executeAndCapture(CommandBase* base) {
+#if CAPTURE_COMMAND_STREAM
+    // the capture lasts until the process exits, it's written as we go
+    static CommandCapture capture(*mDispatcher, getenv("FILAMENT_COMMAND_CAPTURE"));
+    CommandCapture::setCurrent(&capture);
+    Driver& driver = *mDriver;
+    while (base) {
+        capture.begin(base);
+        base = base->execute(driver);
+        capture.end();
+    }
+    capture.flush();
+#endif
+}
+
 void CommandStream::queueCommand(std::function<void()> command) {
     new(allocateCommand(CustomCommand::align(sizeof(CustomCommand)))) CustomCommand(command);
 }
@@ -132,6 +167,36 @@ void CommandType<void (Driver::*)(ARGS...)>::Command<METHOD>::log() noexcept  {
 #include "driver/DriverAPI.inc"
 #endif
 
+template<typename... ARGS>
+template<void (Driver::*METHOD)(ARGS...)>
+template<std::size_t... I>
+void CommandType<void (Driver::*)(ARGS...)>::Command<METHOD>::capture(std::index_sequence<I...>) noexcept  {
+#if CAPTURE_COMMAND_STREAM
+    CommandCapture* const capture = CommandCapture::get();
+    capture->beginParameters();
+    UTILS_UNUSED int dummy[] = { 0, (capture->write(std::get<I>(mArgs)), 0)... };
+#endif
+}
+
+template<typename... ARGS>
+template<void (Driver::*METHOD)(ARGS...)>
+void CommandType<void (Driver::*)(ARGS...)>::Command<METHOD>::capture() noexcept  {
+    capture(std::make_index_sequence<std::tuple_size<SavedParameters>::value>{});
+}
+
+/*
+ * Likewise, the capture() methods are instantiated here when CAPTURE_COMMAND_STREAM is set
+ */
+
+#if CAPTURE_COMMAND_STREAM
+#define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)
+#define DECL_DRIVER_API(methodName, paramsDecl, params) \
+    template void CommandType<decltype(&Driver::methodName)>::Command<&Driver::methodName>::capture();
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params) \
+    template void CommandType<decltype(&Driver::methodName)>::Command<&Driver::methodName>::capture();
+#include "driver/DriverAPI.inc"
+#endif
+
 // ------------------------------------------------------------------------------------------------
 
 void CustomCommand::execute(Driver&, CommandBase* base, intptr_t* next) noexcept {
@@ -234,6 +299,8 @@ io::ostream& operator<<(io::ostream& out, SamplerType type) {
         CASE(SamplerType, SAMPLER_2D)
         CASE(SamplerType, SAMPLER_CUBEMAP)
         CASE(SamplerType, SAMPLER_EXTERNAL)
+        CASE(SamplerType, SAMPLER_2D_ARRAY)
+        CASE(SamplerType, SAMPLER_3D)
     }
     return out;
 }
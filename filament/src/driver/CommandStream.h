@@ -22,6 +22,7 @@
 
 #include <utils/compiler.h>
 
+#include <algorithm>
 #include <functional>
 #include <tuple>
 #include <thread>
@@ -30,10 +31,15 @@
 #include <assert.h>
 #include <cstddef>
 #include <stdint.h>
+#include <string.h>
 
 // Set to true to print every commands out on log.d. This requires RTTI and DEBUG
 #define DEBUG_COMMAND_STREAM false
 
+// Set to true to capture every command executed, with its parameters and how long it took, to
+// the file named by the FILAMENT_COMMAND_CAPTURE environment variable (see CommandCapture.h)
+#define CAPTURE_COMMAND_STREAM false
+
 namespace filament {
 
 class CommandBase;
@@ -83,6 +89,9 @@ public:
         return reinterpret_cast<CommandBase*>(reinterpret_cast<char*>(this) + next);
     }
 
+    // identifies the type of this command
+    Execute getExecute() const noexcept { return mExecute; }
+
     inline ~CommandBase() noexcept = default;
 
 private:
@@ -127,6 +136,9 @@ struct CommandType<void (Driver::*)(ARGS...)> {
         void log() noexcept;
         template<std::size_t... I> void log(std::index_sequence<I...>) noexcept;
 
+        void capture() noexcept;
+        template<std::size_t... I> void capture(std::index_sequence<I...>) noexcept;
+
     public:
         template<typename M, typename D>
         static inline void execute(M&& method, D&& driver, CommandBase* base, intptr_t* next) noexcept {
@@ -136,6 +148,10 @@ struct CommandType<void (Driver::*)(ARGS...)> {
                 // must call this before invoking the method
                 self->log();
             }
+            if (CAPTURE_COMMAND_STREAM) {
+                // must call this before invoking the method
+                self->capture();
+            }
             apply(method, driver, self->mArgs);
             self->~Command();
         }
@@ -261,6 +277,10 @@ public:
     CommandStream() noexcept { }
     CommandStream(Driver& driver, CircularBuffer& buffer) noexcept;
 
+    // Creates a stream recording into 'buffer' for the same driver as 'stream'. This is used
+    // to record a range reserved with reserve(), possibly from another thread.
+    CommandStream(CommandStream const& stream, CircularBuffer& buffer) noexcept;
+
     // This is for debugging only. Currently CircularBuffer can only be written from a
     // single thread. In debug builds we assert this condition.
     // Call this first in the render loop.
@@ -293,6 +313,35 @@ public:
     inline PodType* allocatePod(
             size_t count = 1, size_t alignment = alignof(PodType)) noexcept;
 
+    /*
+     * Uploads the uniforms changed since 'ub' was last cleaned, and cleans it. They're copied
+     * in the stream, so that no memory is allocated or freed for the update, unlike
+     * updateUniformBuffer().
+     */
+    inline void commitUniforms(Handle<HwUniformBuffer> ubh, UniformBuffer const& ub) noexcept;
+
+    /*
+     * Same as above for the samplers of 'sb', which are all set.
+     */
+    inline void commitSamplers(Handle<HwSamplerBuffer> sbh, SamplerBuffer const& sb) noexcept;
+
+    /*
+     * Reserves 'size' bytes in the stream, which must be a multiple of CommandBase::align().
+     * The reserved range must be filled with commands before the stream is flushed, and end
+     * with a NoopCommand jumping to the end of the range (i.e. where the stream continues).
+     */
+    inline void* reserve(size_t size) noexcept {
+        assert(size == CommandBase::align(size));
+        return allocateCommand(size);
+    }
+
+    // Size a command takes in the stream, e.g.:
+    //      CommandStream::commandSize<decltype(&Driver::draw), &Driver::draw>()
+    template<typename M, M METHOD>
+    static constexpr size_t commandSize() noexcept {
+        return CommandBase::align(sizeof(typename CommandType<M>::template Command<METHOD>));
+    }
+
 private:
     // Dispatcher could be a value (instead of pointer), which saves a load when writing commands
     // at the expense of a larger CommandStream object (about ~400 bytes)
@@ -305,6 +354,8 @@ private:
     std::thread::id mThreadId;
 #endif
 
+    void executeAndCapture(CommandBase* base);
+
     inline void* allocateCommand(size_t size) {
         assert(mThreadId == std::this_thread::get_id());
         return mCurrentBuffer->allocate(size);
@@ -333,6 +384,27 @@ PodType* CommandStream::allocatePod(size_t count, size_t alignment) noexcept {
     return static_cast<PodType*>(allocate(count * sizeof(PodType), alignment));
 }
 
+void CommandStream::commitUniforms(Handle<HwUniformBuffer> ubh, UniformBuffer const& ub) noexcept {
+    if (ub.isDirty()) {
+        const size_t offset = ub.getDirtyOffset();
+        const size_t size = ub.getDirtySize();
+        void* const data = allocate(size, 16);
+        memcpy(data, static_cast<char const*>(ub.getBuffer()) + offset, size);
+        loadUniformBuffer(ubh, data, uint32_t(offset), uint32_t(size));
+        ub.clean();
+    }
+}
+
+void CommandStream::commitSamplers(Handle<HwSamplerBuffer> sbh, SamplerBuffer const& sb) noexcept {
+    if (sb.isDirty()) {
+        const size_t count = sb.getSize();
+        SamplerBuffer::Sampler* const samplers = allocatePod<SamplerBuffer::Sampler>(count);
+        std::copy_n(sb.getBuffer(), count, samplers);
+        loadSamplerBuffer(sbh, samplers, uint32_t(count));
+        sb.clean();
+    }
+}
+
 } // namespace filament
 
 #endif // TNT_FILAMENT_DRIVER_COMMANDSTREAM_H
@@ -79,6 +79,7 @@ public:
     using BufferDescriptor = driver::BufferDescriptor;
     using PixelBufferDescriptor = driver::PixelBufferDescriptor;
     using FaceOffsets = driver::FaceOffsets;
+    using TextureRegion = driver::TextureRegion;
     using FenceStatus = driver::FenceStatus;
     using TargetBufferFlags = driver::TargetBufferFlags;
     using RenderPassParams = driver::RenderPassParams;
@@ -203,6 +204,73 @@ public:
         };
     };
 
+    // the parts of a frame timed on the GPU (see beginTimer())
+    enum Timer : uint8_t {
+        TIMER_SHADOW_PASS,
+        TIMER_COLOR_PASS,
+        TIMER_POST_PROCESS,
+    };
+    static constexpr size_t TIMER_COUNT = 3;
+
+    // state changes issued by the driver during a frame (see getFrameStatistics)
+    struct FrameStatistics {
+        uint32_t stateChangesIssued = 0;    // state changes that reached the backend API
+        uint32_t stateChangesSkipped = 0;   // redundant state changes filtered by the driver
+        uint32_t programSwitches = 0;       // issued program changes
+        uint32_t textureSwitches = 0;       // issued texture bindings
+
+        // GPU time of each Timer, in the latest frame the GPU is done with
+        float gpuTimeMilli[TIMER_COUNT] = {};
+        // number of frames between that frame and this one, GPU_TIME_UNKNOWN if no frame was
+        // timed (e.g. the backend can't time the GPU)
+        uint32_t gpuTimeAge = GPU_TIME_UNKNOWN;
+        static constexpr uint32_t GPU_TIME_UNKNOWN = UINT32_MAX;
+    };
+
+    struct MemoryStatistics {
+        size_t handleArena = 0;             // size of the arena of the handles
+        size_t gpuAllocated = 0;            // GPU memory allocated, 0 if the backend can't tell
+    };
+
+    // one draw of drawIndirect(), laid out like the commands of glMultiDrawElementsIndirect()
+    // and vkCmdDrawIndexedIndirect()
+    struct DrawIndirectCommand {
+        uint32_t count = 0;                 // number of indices
+        uint32_t instanceCount = 1;
+        uint32_t firstIndex = 0;            // in indices, from the start of the index buffer
+        int32_t baseVertex = 0;
+        uint32_t baseInstance = 0;          // added to the instance index seen by the shaders
+    };
+
+    // The world-space box of a draw of drawIndirect(), culled against the 6 planes of a frustum
+    // (normals pointing outward, see Frustum). The padding makes it an array of vec4 in shaders.
+    struct DrawBounds {
+        math::float3 center;
+        float padding0;
+        math::float3 halfExtent;
+        float padding1;
+
+        // same test as the Culler, the box is visible if it's on the inner side of all planes
+        bool isVisible(math::float4 const* planes) const noexcept {
+            for (size_t i = 0; i < 6; i++) {
+                const math::float4 p = planes[i];
+                if (dot(p.xyz, center) - dot(abs(p.xyz), halfExtent) + p.w >= 0) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    // a region of the swap chain that changed since the previous frame, in pixels, from the
+    // bottom-left corner, see setDamageRegions()
+    struct DamageRegion {
+        int32_t left = 0;
+        int32_t bottom = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+    };
+
     static SamplerFormat getSamplerFormat(TextureFormat format) noexcept;
     static SamplerPrecision getSamplerPrecision(TextureFormat format) noexcept;
     static size_t getElementTypeSize(ElementType type) noexcept;
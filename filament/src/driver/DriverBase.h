@@ -135,8 +135,10 @@ struct HwSwapChain : public HwBase {
 
 struct HwStream : public HwBase {
     HwStream() = default;
-    explicit HwStream(driver::ExternalContext::Stream* stream) : stream(stream) { }
+    explicit HwStream(driver::ExternalContext::Stream* stream)
+            : stream(stream), streamType(driver::StreamType::NATIVE) { }
     driver::ExternalContext::Stream* stream = nullptr;
+    driver::StreamType streamType = driver::StreamType::TEXTURE_ID;
     uint32_t width = 0;
     uint32_t height = 0;
 };
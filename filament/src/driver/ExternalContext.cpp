@@ -60,6 +60,8 @@ ContextManagerGL::~ContextManagerGL() noexcept = default;
 
 ContextManagerVk::~ContextManagerVk() noexcept = default;
 
+BlobCache::~BlobCache() noexcept = default;
+
 ExternalContext* ExternalContext::create(Backend* backend) noexcept {
     assert(backend);
     if (*backend == Backend::DEFAULT) {
@@ -57,17 +57,23 @@ static driver::TextureFormat dataTypeToTextureFormat(GPUBuffer::Element element)
     return formats[index][element.size - 1];
 }
 
-GPUBuffer::GPUBuffer(driver::DriverApi& driverApi, Element element, size_t rowSize, size_t rowCount)
-        : mElement(element) {
+GPUBuffer::GPUBuffer(driver::DriverApi& driverApi, Element element, size_t rowSize, size_t rowCount,
+        Storage storage) : mElement(element), mStorage(storage) {
     size_t size = dataTypeToSize(element) * rowSize * rowCount;
     mSize = (uint32_t) size;
     mWidth = (uint16_t) rowSize;
     mHeight = (uint16_t) rowCount;
     mRowSizeInBytes = uint16_t(dataTypeToSize(element) * rowSize);
 
-    driver::TextureFormat format = dataTypeToTextureFormat(element);
-    mTexture = driverApi.createTexture(SamplerType::SAMPLER_2D, 1, format, 1, mWidth, mHeight, 1,
-            TextureUsage::DEFAULT);
+    if (storage == Storage::BUFFER) {
+        // shaders read the buffer as an array of uint
+        assert(size % sizeof(uint32_t) == 0);
+        mBuffer = driverApi.createUniformBuffer(size);
+    } else {
+        driver::TextureFormat format = dataTypeToTextureFormat(element);
+        mTexture = driverApi.createTexture(SamplerType::SAMPLER_2D, 1, format, 1,
+                mWidth, mHeight, 1, TextureUsage::DEFAULT);
+    }
 
 
     switch (mElement.size) {
@@ -106,6 +112,7 @@ GPUBuffer& GPUBuffer::operator=(GPUBuffer&& rhs) noexcept {
 
 void GPUBuffer::swap(GPUBuffer& rhs) noexcept {
     std::swap(mTexture, rhs.mTexture);
+    std::swap(mBuffer, rhs.mBuffer);
     std::swap(mDirtyRanges, rhs.mDirtyRanges);
     std::swap(mSize, rhs.mSize);
     std::swap(mWidth, rhs.mWidth);
@@ -114,23 +121,50 @@ void GPUBuffer::swap(GPUBuffer& rhs) noexcept {
     std::swap(mElement, rhs.mElement);
     std::swap(mFormat, rhs.mFormat);
     std::swap(mType, rhs.mType);
+    std::swap(mStorage, rhs.mStorage);
 }
 
 void GPUBuffer::terminate(driver::DriverApi& driverApi) noexcept {
-    driverApi.destroyTexture(mTexture);
+    if (mStorage == Storage::BUFFER) {
+        driverApi.destroyUniformBuffer(mBuffer);
+    } else {
+        driverApi.destroyTexture(mTexture);
+    }
+}
+
+void GPUBuffer::bindStorage(driver::DriverApi& driverApi, size_t index) const noexcept {
+    if (mStorage == Storage::BUFFER) {
+        driverApi.bindStorage(index, mBuffer);
+    }
 }
 
 void GPUBuffer::commitSlow(driver::DriverApi& driverApi, void const* begin, void const* end) noexcept {
-    const uintptr_t sizeInBytes = uintptr_t(end) - uintptr_t(begin);
+    UTILS_UNUSED const uintptr_t sizeInBytes = uintptr_t(end) - uintptr_t(begin);
     assert(sizeInBytes <= mRowSizeInBytes * mHeight);
 
+    if (mStorage == Storage::BUFFER) {
+        // a plain buffer update of each range, the rows are contiguous
+        for (auto const& range : mDirtyRanges) {
+            assert(range.end * mRowSizeInBytes <= sizeInBytes);
+            driverApi.loadUniformBuffer(mBuffer,
+                    static_cast<uint8_t const*>(begin) + range.start * mRowSizeInBytes,
+                    range.start * mRowSizeInBytes, range.getCount() * mRowSizeInBytes);
+        }
+        mDirtyRanges.clear();
+        return;
+    }
+
     const Handle<HwTexture> texture = mTexture;
     const driver::PixelDataFormat format = mFormat;
     const driver::PixelDataType type = mType;
     const uint32_t w = mWidth;
     for (auto const& range : mDirtyRanges) {
+        // the data of each range starts at its first row
+        assert(range.end * mRowSizeInBytes <= sizeInBytes);
         // we need a new PixelBufferDescriptor for each range (std:move)
-        PixelBufferDescriptor desc(begin, sizeInBytes, format, type);
+        PixelBufferDescriptor desc(
+                static_cast<uint8_t const*>(begin) + range.start * mRowSizeInBytes,
+                range.getCount() * mRowSizeInBytes, format, type);
         driverApi.load2DImage(texture, 0,
                 0, range.start,
                 w, range.getCount(), std::move(desc));
@@ -47,9 +47,18 @@ public:
         uint8_t     size : 3; // 1 to 4 allowed
     };
 
+    // Where the data lives on the GPU. A TEXTURE is bound through a SamplerBuffer and read with
+    // texelFetch(), a BUFFER is bound with bindStorage() and read as an array of uint by shaders
+    // which support storage buffers.
+    enum class Storage : uint8_t {
+        TEXTURE,
+        BUFFER
+    };
+
     GPUBuffer() = default;
 
-    GPUBuffer(driver::DriverApi& driverApi, Element element, size_t rowSize, size_t rowCount);
+    GPUBuffer(driver::DriverApi& driverApi, Element element, size_t rowSize, size_t rowCount,
+            Storage storage = Storage::TEXTURE);
 
     GPUBuffer(const GPUBuffer&) = delete;
     GPUBuffer& operator=(const GPUBuffer&) = delete;
@@ -62,6 +71,11 @@ public:
 
     size_t getSize() const noexcept { return mSize; }
 
+    Storage getStorage() const noexcept { return mStorage; }
+
+    // binds a BUFFER as the storage buffer 'index', nothing is done for a TEXTURE
+    void bindStorage(driver::DriverApi& driverApi, size_t index) const noexcept;
+
     void invalidate() noexcept;
     void invalidate(size_t row, size_t count) noexcept;
 
@@ -85,7 +99,7 @@ public:
 
 private:
     // this is really hidden implementation details (the fact we're using a texture should be
-    // exposed as little as possible)
+    // exposed as little as possible), the handle is null for a BUFFER.
     friend class SamplerBuffer;
     Handle<HwTexture> getHandle() const noexcept { return mTexture; }
     driver::SamplerParams getSamplerParams() const noexcept { return driver::SamplerParams{}; }
@@ -94,6 +108,7 @@ private:
     void commitSlow(driver::DriverApi& driverApi, void const* begin, void const* end) noexcept;
 
     Handle<HwTexture> mTexture;
+    Handle<HwUniformBuffer> mBuffer;
     utils::RangeSet<4> mDirtyRanges;
     uint32_t mSize = 0;
     uint16_t mWidth;
@@ -102,6 +117,7 @@ private:
     Element mElement;
     driver::PixelDataFormat mFormat;
     driver::PixelDataType mType;
+    Storage mStorage = Storage::TEXTURE;
 };
 
 } // namespace filament
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DRIVER_HANDLEALLOCATOR_H
+#define TNT_FILAMENT_DRIVER_HANDLEALLOCATOR_H
+
+#include "driver/Handle.h"
+
+#include <utils/Allocator.h>
+
+#include <stddef.h>
+
+namespace filament {
+
+/*
+ * Allocates the Hw* objects a driver's handles refer to, from three pools of increasing element
+ * size carved out of a single HeapArea. Objects are contiguous in memory and a handle's id is
+ * simply the object's offset in the area, in units of 2^MIN_ALIGNMENT_SHIFT bytes.
+ *
+ * Handles are allocated by the createXSynchronous() calls on the main thread, and freed on the
+ * driver thread, so the pools use an AtomicFreeList; allocating a handle never takes a lock or
+ * calls malloc. This assumes a single allocating thread, which avoids the ABA problem.
+ */
+template<size_t P0, size_t P1, size_t P2>
+class HandleAllocator {
+    utils::PoolAllocator<P0, 16, 0, utils::AtomicFreeList> mPool0;
+    utils::PoolAllocator<P1, 32, 0, utils::AtomicFreeList> mPool1;
+    utils::PoolAllocator<P2, 32, 0, utils::AtomicFreeList> mPool2;
+
+public:
+    static constexpr size_t MIN_ALIGNMENT_SHIFT = 4;
+
+    // the area is split 1/16, 5/16 and 10/16 between the pools
+    explicit HandleAllocator(const utils::HeapArea& area) noexcept
+            : mPool0(area.begin(),
+                      utils::pointermath::add(area.begin(), (1 * area.getSize()) / 16)),
+              mPool1( utils::pointermath::add(area.begin(), (1 * area.getSize()) / 16),
+                      utils::pointermath::add(area.begin(), (6 * area.getSize()) / 16)),
+              mPool2( utils::pointermath::add(area.begin(), (6 * area.getSize()) / 16),
+                      area.end()) {
+    }
+
+    void* alloc(size_t size, size_t alignment, size_t extra = 0) noexcept {
+        assert(size <= mPool2.getSize());
+        if (size <= mPool0.getSize()) return mPool0.alloc(size, 16, extra);
+        if (size <= mPool1.getSize()) return mPool1.alloc(size, 32, extra);
+        if (size <= mPool2.getSize()) return mPool2.alloc(size, 32, extra);
+        return nullptr;
+    }
+
+    void free(void* p, size_t size) noexcept {
+        if (size <= mPool0.getSize()) { mPool0.free(p); return; }
+        if (size <= mPool1.getSize()) { mPool1.free(p); return; }
+        if (size <= mPool2.getSize()) { mPool2.free(p); return; }
+    }
+};
+
+// The pools are lock-free, the lock only protects the high watermark tracking on debug builds.
+#ifndef NDEBUG
+template<typename ALLOCATOR>
+using HandleArena = utils::Arena<ALLOCATOR,
+        utils::LockingPolicy::SpinLock,
+        utils::TrackingPolicy::HighWatermark>;
+#else
+template<typename ALLOCATOR>
+using HandleArena = utils::Arena<ALLOCATOR,
+        utils::LockingPolicy::NoLock>;
+#endif
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_DRIVER_HANDLEALLOCATOR_H
@@ -43,6 +43,11 @@ Program& Program::withSamplerBindings(const SamplerBindingMap* bindings) {
     return *this;
 }
 
+Program& Program::specialization(uint32_t constants) {
+    mSpecialization = constants;
+    return *this;
+}
+
 Program& Program::shader(Program::Shader shader, CString source) {
     std::swap(mShadersSource[size_t(shader)], source);
     return *this;
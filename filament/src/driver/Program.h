@@ -34,13 +34,15 @@ namespace filament {
 class Program {
 public:
 
-    static constexpr size_t NUM_SHADER_TYPES = 2;
+    static constexpr size_t NUM_SHADER_TYPES = 3;
     static constexpr size_t NUM_UNIFORM_BINDINGS = filament::BindingPoints::COUNT;
     static constexpr size_t NUM_SAMPLER_BINDINGS = filament::BindingPoints::COUNT;
 
+    // a program has either a vertex and a fragment shader, or a compute shader
     enum class Shader : uint8_t {
         VERTEX = 0,
-        FRAGMENT = 1
+        FRAGMENT = 1,
+        COMPUTE = 2
     };
 
     Program() noexcept;
@@ -72,9 +74,18 @@ public:
         return shader(Shader::FRAGMENT, std::forward<T>(source));
     }
 
+    template <typename T>
+    Program& withComputeShader(T source) {
+        return shader(Shader::COMPUTE, std::forward<T>(source));
+    }
+
     // sets up sampler bindings for this program
     Program& withSamplerBindings(const SamplerBindingMap* bindings);
 
+    // sets the values of the specialization constants (see SpecializationConstants), bit k
+    // being the value of the constant with id k. Only SPIR-V shaders have such constants.
+    Program& specialization(uint32_t constants);
+
     // in order to workaround certain driver bugs, we need to be able to modify the
     // shader string (this happens in OpenGLProgram.cpp)
     std::array<utils::CString, NUM_SHADER_TYPES>&
@@ -113,6 +124,10 @@ public:
         return mSamplerCount > 0;
     }
 
+    uint32_t getSpecialization() const noexcept {
+        return mSpecialization;
+    }
+
 private:
 #if !defined(NDEBUG)
     friend utils::io::ostream& operator<< (utils::io::ostream& out, const Program& builder);
@@ -123,6 +138,7 @@ private:
     const SamplerBindingMap* mSamplerBindings = nullptr;
     std::array<utils::CString, NUM_SHADER_TYPES> mShadersSource;
     size_t mSamplerCount = 0;
+    uint32_t mSpecialization = 0;
     utils::CString mName;
     uint8_t mVariant;
 };
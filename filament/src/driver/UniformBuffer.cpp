@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <limits>
 #include <mutex>
 #include <type_traits>
 #include <unordered_map>
@@ -97,12 +98,13 @@ static Pool sMemoryPool;
 
 UniformBuffer::UniformBuffer(size_t size) noexcept
     : mBuffer(mStorage),
-      mSize(uint32_t(size)),
-      mSomethingDirty(true) {
+      mSize(uint32_t(size)) {
+    assert(size <= std::numeric_limits<uint16_t>::max() * WORD_SIZE);
     if (UTILS_LIKELY(size > sizeof(mStorage))) {
         mBuffer = UniformBuffer::alloc(size);
     }
     memset(mBuffer, 0, size);
+    invalidate();
 }
 
 UniformBuffer::UniformBuffer(UniformInterfaceBlock const& uib) noexcept
@@ -112,7 +114,8 @@ UniformBuffer::UniformBuffer(UniformInterfaceBlock const& uib) noexcept
 UniformBuffer::UniformBuffer(const UniformBuffer& rhs)
         : mBuffer(mStorage),
           mSize(rhs.mSize),
-          mSomethingDirty(rhs.mSomethingDirty) {
+          mDirtyBegin(rhs.mDirtyBegin),
+          mDirtyEnd(rhs.mDirtyEnd) {
     if (UTILS_LIKELY(mSize > sizeof(mStorage))) {
         mBuffer = UniformBuffer::alloc(rhs.mSize);
     }
@@ -122,7 +125,8 @@ UniformBuffer::UniformBuffer(const UniformBuffer& rhs)
 UniformBuffer::UniformBuffer(UniformBuffer&& rhs) noexcept
         : mBuffer(rhs.mBuffer),
           mSize(rhs.mSize),
-          mSomethingDirty(rhs.mSomethingDirty) {
+          mDirtyBegin(rhs.mDirtyBegin),
+          mDirtyEnd(rhs.mDirtyEnd) {
     if (UTILS_LIKELY(rhs.isLocalStorage())) {
         mBuffer = mStorage;
         memcpy(mBuffer, rhs.mBuffer, mSize);
@@ -133,7 +137,8 @@ UniformBuffer::UniformBuffer(UniformBuffer&& rhs) noexcept
 
 UniformBuffer& UniformBuffer::operator=(UniformBuffer&& rhs) noexcept {
     if (this != &rhs) {
-        mSomethingDirty = rhs.mSomethingDirty;
+        mDirtyBegin = rhs.mDirtyBegin;
+        mDirtyEnd = rhs.mDirtyEnd;
         if (UTILS_LIKELY(rhs.isLocalStorage())) {
             mBuffer = mStorage;
             mSize = rhs.mSize;
@@ -20,6 +20,7 @@
 #include <algorithm>
 
 #include <stddef.h>
+#include <string.h>
 #include <assert.h>
 
 #include <math/mat3.h>
@@ -64,10 +65,35 @@ public:
     // invalidate a range of uniforms and return a pointer to it. offset and size given in bytes
     void* invalidateUniforms(size_t offset, size_t size) {
         assert(offset + size <= mSize);
-        mSomethingDirty = true;
+        // the dirty range grows to include this one, it's tracked in words
+        const uint16_t begin = uint16_t(offset / WORD_SIZE);
+        const uint16_t end = uint16_t((offset + size + WORD_SIZE - 1) / WORD_SIZE);
+        if (UTILS_LIKELY(!isDirty())) {
+            mDirtyBegin = begin;
+            mDirtyEnd = end;
+        } else {
+            mDirtyBegin = std::min(mDirtyBegin, begin);
+            mDirtyEnd = std::max(mDirtyEnd, end);
+        }
         return static_cast<char*>(mBuffer) + offset;
     }
 
+    // copy a range of uniforms, the range is invalidated only if its content changes, so that
+    // uniforms set to the same value every frame don't cause an upload
+    void setUniformsIfChanged(size_t offset, void const* UTILS_RESTRICT data, size_t size) noexcept {
+        assert(offset + size <= mSize);
+        void* const p = static_cast<char*>(mBuffer) + offset;
+        if (memcmp(p, data, size) != 0) {
+            memcpy(invalidateUniforms(offset, size), data, size);
+        }
+    }
+
+    // mark the whole buffer as dirty, e.g. when it's going to be uploaded to a new buffer
+    void invalidate() noexcept {
+        mDirtyBegin = 0;
+        mDirtyEnd = uint16_t((mSize + WORD_SIZE - 1) / WORD_SIZE);
+    }
+
     // pointer to the uniform buffer
     void const* getBuffer() const noexcept { return mBuffer; }
 
@@ -75,10 +101,17 @@ public:
     size_t getSize() const noexcept { return mSize; }
 
     // return if any uniform has been changed
-    bool isDirty() const noexcept { return mSomethingDirty; }
+    bool isDirty() const noexcept { return mDirtyEnd > mDirtyBegin; }
+
+    // the smallest range of bytes which contains all the uniforms changed since the last
+    // call to clean(), only valid if isDirty() is true
+    size_t getDirtyOffset() const noexcept { return mDirtyBegin * WORD_SIZE; }
+    size_t getDirtySize() const noexcept {
+        return std::min(size_t(mDirtyEnd * WORD_SIZE), size_t(mSize)) - getDirtyOffset();
+    }
 
     // mark the whole buffer as clean (no modified uniforms)
-    void clean() const noexcept { mSomethingDirty = false; }
+    void clean() const noexcept { mDirtyBegin = mDirtyEnd = 0; }
 
     /*
      * -----------------------------------------------
@@ -111,20 +144,19 @@ public:
         >::type;
     };
 
-    // invalidate an array of uniforms and return a pointer to the first element
-    // offset in bytes, and count is the number of elements to invalidate
+    // set an array of uniforms, offset in bytes, and count is the number of elements
+    // the array is only invalidated if it changed
     template <typename T, typename = typename is_supported_type<T>::type>
     void setUniformArray(size_t offset, T const* UTILS_RESTRICT begin, size_t count) noexcept {
-        T* UTILS_RESTRICT p = static_cast<T*>(invalidateUniforms(offset, sizeof(T) * count));
-        std::copy_n(begin, count, p);
+        setUniformsIfChanged(offset, begin, sizeof(T) * count);
     }
 
     // set uniform of known types to the proper offset (e.g.: use offsetof())
+    // the uniform is only invalidated if its value changed
     // (see specialization for mat3f below)
     template <typename T, typename = typename is_supported_type<T>::type>
     void setUniform(size_t offset, const T& v) noexcept {
-        T* p = static_cast<T*>(invalidateUniforms(offset, sizeof(T)));
-        *p = v;
+        setUniformsIfChanged(offset, &v, sizeof(T));
     }
 
     // get uniform of known types from the proper offset (e.g.: use offsetof())
@@ -155,25 +187,37 @@ private:
 
     inline bool isLocalStorage() const noexcept { return mBuffer == mStorage; }
 
+    // all std140 members are aligned to 4 bytes, this keeps the dirty range in 16 bits
+    static constexpr size_t WORD_SIZE = 4;
+
     // TODO: we need a better to calculate this local storage.
     // Probably the better thing to do would be to use a special allocator.
     // Local storage is limited by the total size of a handle (128 byte for GL)
     char mStorage[96];
     void *mBuffer = nullptr;
     uint32_t mSize = 0;
-    mutable bool mSomethingDirty = false;
+    // dirty range in words, [begin, end)
+    mutable uint16_t mDirtyBegin = 0;
+    mutable uint16_t mDirtyEnd = 0;
 };
 
 // specialization for float3 (which has a different alignment)
 template<>
 inline void
 UniformBuffer::setUniformArray(size_t offset, math::float3 const* begin, size_t count) noexcept {
-    math::float4* p = static_cast<math::float4*>(invalidateUniforms(offset,
-            sizeof(math::float4) * count));
-    math::float3 const* const end = begin + count;
-    while (begin != end) {
-        p->xyz = *begin++;
-        ++p;
+    math::float4 const* const p = reinterpret_cast<math::float4 const*>(
+            static_cast<char const*>(getBuffer()) + offset);
+    // only the elements from the first one that changed are invalidated
+    size_t first = 0;
+    while (first < count && p[first].xyz == begin[first]) {
+        first++;
+    }
+    if (first < count) {
+        math::float4* const q = static_cast<math::float4*>(invalidateUniforms(
+                offset + sizeof(math::float4) * first, sizeof(math::float4) * (count - first)));
+        for (size_t i = first; i < count; i++) {
+            q[i - first].xyz = begin[i];
+        }
     }
 }
 
@@ -200,7 +244,7 @@ inline void UniformBuffer::setUniform(size_t offset, const math::mat3f& v) noexc
     temp.v[2][3] = 0; // not needed, but doesn't cost anything
 
     // this is like setUniform(), except its not a "supported_type"
-    *static_cast<mat43*>(invalidateUniforms(offset, sizeof(temp))) = temp;
+    setUniformsIfChanged(offset, &temp, sizeof(temp));
 }
 
 } // namespace filament
@@ -17,19 +17,175 @@
 #include "driver/noop/NoopDriver.h"
 #include "driver/CommandStream.h"
 
+#include <chrono>
+
 namespace filament {
 
+static const char* const gCommandNames[] = {
+#define DECL_DRIVER_API(methodName, paramsDecl, params) #methodName,
+#define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params) #methodName,
+#include "driver/DriverAPI.inc"
+};
+
+static_assert(sizeof(gCommandNames) / sizeof(gCommandNames[0]) == size_t(NoopDriver::Command::COUNT),
+        "the names don't match the commands");
+
+const char* NoopDriver::getCommandName(Command command) noexcept {
+    return gCommandNames[size_t(command)];
+}
+
+uint64_t NoopDriver::Stats::getCommandCount() const noexcept {
+    uint64_t count = 0;
+    for (uint64_t c : commands) {
+        count += c;
+    }
+    return count;
+}
 
 std::unique_ptr<Driver> NoopDriver::create() {
-    return std::unique_ptr<Driver>(new NoopDriver());
+    return std::unique_ptr<Driver>(new NoopDriver(nullptr, 0));
 }
 
-NoopDriver::NoopDriver() noexcept
-        : DriverBase(new ConcreteDispatcher<NoopDriver>(this)) {
+std::unique_ptr<Driver> NoopDriver::create(Stats* stats, uint32_t commandCost) {
+    return std::unique_ptr<Driver>(new NoopDriver(stats, commandCost));
+}
+
+NoopDriver::NoopDriver(Stats* stats, uint32_t commandCost) noexcept
+        : DriverBase(new ConcreteDispatcher<NoopDriver>(this)),
+          mStats(stats), mCommandCost(commandCost) {
 }
 
 NoopDriver::~NoopDriver() noexcept = default;
 
+void NoopDriver::execute(Command command) noexcept {
+    mStats->commands[size_t(command)]++;
+    if (mCommandCost) {
+        // spin rather than sleep, so that the cost shows as CPU time of the driver thread
+        using clock = std::chrono::steady_clock;
+        const clock::time_point end = clock::now() + std::chrono::nanoseconds(mCommandCost);
+        while (clock::now() < end) {
+        }
+    }
+}
+
+void NoopDriver::instrument(CommandTag<Command::createProgram>, Program const&) noexcept {
+    mStats->programs++;
+}
+
+void NoopDriver::instrument(CommandTag<Command::loadVertexBuffer>,
+        Driver::VertexBufferHandle const&, size_t const&, Driver::BufferDescriptor const& data,
+        uint32_t const&, uint32_t const&) noexcept {
+    mStats->uploadedBytes += data.size;
+}
+
+void NoopDriver::instrument(CommandTag<Command::loadIndexBuffer>, Driver::IndexBufferHandle const&,
+        Driver::BufferDescriptor const& data, uint32_t const&, uint32_t const&) noexcept {
+    mStats->uploadedBytes += data.size;
+}
+
+void NoopDriver::instrument(CommandTag<Command::load2DImage>, Driver::TextureHandle const&,
+        uint32_t const&, uint32_t const&, uint32_t const&, uint32_t const&, uint32_t const&,
+        Driver::PixelBufferDescriptor const& data) noexcept {
+    mStats->uploadedBytes += data.size;
+}
+
+void NoopDriver::instrument(CommandTag<Command::load3DImage>, Driver::TextureHandle const&,
+        uint32_t const&, uint32_t const&, uint32_t const&, uint32_t const&, uint32_t const&,
+        uint32_t const&, uint32_t const&, Driver::PixelBufferDescriptor const& data) noexcept {
+    mStats->uploadedBytes += data.size;
+}
+
+void NoopDriver::instrument(CommandTag<Command::load2DImageRegions>, Driver::TextureHandle const&,
+        uint32_t const&, Driver::TextureRegion const* const&, uint32_t const&,
+        Driver::PixelBufferDescriptor const& data) noexcept {
+    mStats->uploadedBytes += data.size;
+}
+
+void NoopDriver::instrument(CommandTag<Command::loadCubeImage>, Driver::TextureHandle const&,
+        uint32_t const&, Driver::PixelBufferDescriptor const& data,
+        Driver::FaceOffsets const&) noexcept {
+    mStats->uploadedBytes += data.size;
+}
+
+void NoopDriver::instrument(CommandTag<Command::updateUniformBuffer>,
+        Driver::UniformBufferHandle const&, UniformBuffer const& uniformBuffer) noexcept {
+    mStats->uploadedBytes += uniformBuffer.getSize();
+}
+
+void NoopDriver::instrument(CommandTag<Command::loadUniformBuffer>,
+        Driver::UniformBufferHandle const&, void const* const&, uint32_t const&,
+        uint32_t const& size) noexcept {
+    mStats->uploadedBytes += size;
+}
+
+void NoopDriver::instrument(CommandTag<Command::bindUniforms>, size_t const& index,
+        Driver::UniformBufferHandle const& ubh) noexcept {
+    setBinding(mUniformBindings, index, ubh.getId());
+}
+
+void NoopDriver::instrument(CommandTag<Command::bindUniformsRange>, size_t const& index,
+        Driver::UniformBufferHandle const& ubh, uint32_t const& offset, uint32_t const&) noexcept {
+    setBinding(mUniformBindings, index, (uint64_t(offset) << 32u) | ubh.getId());
+}
+
+void NoopDriver::instrument(CommandTag<Command::bindStorage>, size_t const& index,
+        Driver::UniformBufferHandle const& ubh) noexcept {
+    setBinding(mStorageBindings, index, ubh.getId());
+}
+
+void NoopDriver::instrument(CommandTag<Command::bindSamplers>, size_t const& index,
+        Driver::SamplerBufferHandle const& sbh) noexcept {
+    setBinding(mSamplerBindings, index, sbh.getId());
+}
+
+void NoopDriver::instrument(CommandTag<Command::beginRenderPass>, Driver::RenderTargetHandle const&,
+        Driver::RenderPassParams const&) noexcept {
+    // like a real driver, the pipeline is set again in each render pass, but not the bindings
+    mProgram = HandleBase::nullid;
+    mPrimitive = HandleBase::nullid;
+}
+
+void NoopDriver::instrument(CommandTag<Command::draw>, Driver::ProgramHandle const& ph,
+        Driver::RasterState const& rs, Driver::RenderPrimitiveHandle const& rph,
+        uint32_t const&) noexcept {
+    setPipeline(ph, rs, rph);
+}
+
+void NoopDriver::instrument(CommandTag<Command::drawIndirect>, Driver::ProgramHandle const& ph,
+        Driver::RasterState const& rs, Driver::RenderPrimitiveHandle const& rph,
+        Driver::DrawIndirectCommand const* const&, uint32_t const&,
+        math::float4 const* const&, Driver::DrawBounds const* const&) noexcept {
+    setPipeline(ph, rs, rph);
+}
+
+void NoopDriver::setPipeline(Driver::ProgramHandle ph, Driver::RasterState rs,
+        Driver::RenderPrimitiveHandle rph) noexcept {
+    Stats& stats = *mStats;
+    if (ph.getId() != mProgram) {
+        mProgram = ph.getId();
+        stats.programChanges++;
+    }
+    if (rs.u != mRasterState) {
+        mRasterState = rs.u;
+        stats.rasterStateChanges++;
+    }
+    if (rph.getId() != mPrimitive) {
+        mPrimitive = rph.getId();
+        stats.primitiveChanges++;
+    }
+    if (mPipelines.insert((uint64_t(ph.getId()) << 32u) | rs.u).second) {
+        stats.pipelines++;
+    }
+}
+
+void NoopDriver::setBinding(uint64_t* bindings, size_t index, uint64_t binding) noexcept {
+    if (index < MAX_BINDINGS && bindings[index] != binding) {
+        bindings[index] = binding;
+        mStats->bindingChanges++;
+    }
+}
+
 // explicit instantiation of the Dispatcher
 template class ConcreteDispatcher<NoopDriver>;
 
@@ -22,18 +22,125 @@
 
 #include <utils/compiler.h>
 
+#include <atomic>
+#include <unordered_set>
+
 namespace filament {
 
 class NoopDriver final : public DriverBase {
-    NoopDriver() noexcept;
-    virtual ~NoopDriver() noexcept;
-
 public:
+    // The commands of the driver API that go through the command stream.
+    enum class Command : uint8_t {
+#define DECL_DRIVER_API(methodName, paramsDecl, params) methodName,
+#define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)
+#define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params) methodName,
+#include "driver/DriverAPI.inc"
+        COUNT
+    };
+
+    static const char* getCommandName(Command command) noexcept;
+
+    // What the instrumented driver executed, see create(). The counters are updated by the driver
+    // thread, they must only be read or reset while it's idle, e.g. after waiting on a Fence.
+    struct Stats {
+        uint64_t commands[size_t(Command::COUNT)] = {};
+        uint64_t uploadedBytes = 0;         // of the buffers, textures and uniforms loaded
+        uint64_t programs = 0;              // programs created
+        uint64_t pipelines = 0;             // distinct program and raster state pairs drawn with
+        // the state changes a real driver would issue for the draws and bindings
+        uint64_t programChanges = 0;
+        uint64_t rasterStateChanges = 0;
+        uint64_t primitiveChanges = 0;
+        uint64_t bindingChanges = 0;        // uniform, storage or sampler buffers bound
+
+        uint64_t getCommandCount() const noexcept;
+        uint64_t getStateChanges() const noexcept {
+            return programChanges + rasterStateChanges + primitiveChanges + bindingChanges;
+        }
+        void reset() noexcept { *this = {}; }
+    };
+
     static std::unique_ptr<Driver> create();
 
+    // Creates the driver in instrumented mode: it counts what it executes into 'stats', and spends
+    // commandCost nanoseconds of CPU time on each command, to model the driver thread of a real
+    // backend. The handles it creates are all different, so that the state changes can be told.
+    static std::unique_ptr<Driver> create(Stats* stats, uint32_t commandCost = 0);
+
 private:
+    NoopDriver(Stats* stats, uint32_t commandCost) noexcept;
+    virtual ~NoopDriver() noexcept;
+
     virtual ShaderModel getShaderModel() const noexcept override final { return ShaderModel::UNKNOWN; }
 
+    template<Command C>
+    struct CommandTag { };
+
+    // Counts the command and spends its cost, only in instrumented mode.
+    void execute(Command command) noexcept;
+
+    // The commands which update more than their count, the others go to the template.
+    template<Command C, typename ... ARGS>
+    void instrument(CommandTag<C>, ARGS const& ...) noexcept { }
+    void instrument(CommandTag<Command::createProgram>, Program const&) noexcept;
+    void instrument(CommandTag<Command::loadVertexBuffer>, Driver::VertexBufferHandle const&,
+            size_t const&, Driver::BufferDescriptor const& data, uint32_t const&,
+            uint32_t const&) noexcept;
+    void instrument(CommandTag<Command::loadIndexBuffer>, Driver::IndexBufferHandle const&,
+            Driver::BufferDescriptor const& data, uint32_t const&, uint32_t const&) noexcept;
+    void instrument(CommandTag<Command::load2DImage>, Driver::TextureHandle const&,
+            uint32_t const&, uint32_t const&, uint32_t const&, uint32_t const&, uint32_t const&,
+            Driver::PixelBufferDescriptor const& data) noexcept;
+    void instrument(CommandTag<Command::load3DImage>, Driver::TextureHandle const&,
+            uint32_t const&, uint32_t const&, uint32_t const&, uint32_t const&, uint32_t const&,
+            uint32_t const&, uint32_t const&, Driver::PixelBufferDescriptor const& data) noexcept;
+    void instrument(CommandTag<Command::load2DImageRegions>, Driver::TextureHandle const&,
+            uint32_t const&, Driver::TextureRegion const* const&, uint32_t const&,
+            Driver::PixelBufferDescriptor const& data) noexcept;
+    void instrument(CommandTag<Command::loadCubeImage>, Driver::TextureHandle const&,
+            uint32_t const&, Driver::PixelBufferDescriptor const& data,
+            Driver::FaceOffsets const&) noexcept;
+    void instrument(CommandTag<Command::updateUniformBuffer>, Driver::UniformBufferHandle const&,
+            UniformBuffer const& uniformBuffer) noexcept;
+    void instrument(CommandTag<Command::loadUniformBuffer>, Driver::UniformBufferHandle const&,
+            void const* const&, uint32_t const&, uint32_t const& size) noexcept;
+    void instrument(CommandTag<Command::bindUniforms>, size_t const& index,
+            Driver::UniformBufferHandle const& ubh) noexcept;
+    void instrument(CommandTag<Command::bindUniformsRange>, size_t const& index,
+            Driver::UniformBufferHandle const& ubh, uint32_t const& offset,
+            uint32_t const&) noexcept;
+    void instrument(CommandTag<Command::bindStorage>, size_t const& index,
+            Driver::UniformBufferHandle const& ubh) noexcept;
+    void instrument(CommandTag<Command::bindSamplers>, size_t const& index,
+            Driver::SamplerBufferHandle const& sbh) noexcept;
+    void instrument(CommandTag<Command::beginRenderPass>, Driver::RenderTargetHandle const&,
+            Driver::RenderPassParams const&) noexcept;
+    void instrument(CommandTag<Command::draw>, Driver::ProgramHandle const& ph,
+            Driver::RasterState const& rs, Driver::RenderPrimitiveHandle const& rph,
+            uint32_t const&) noexcept;
+    void instrument(CommandTag<Command::drawIndirect>, Driver::ProgramHandle const& ph,
+            Driver::RasterState const& rs, Driver::RenderPrimitiveHandle const& rph,
+            Driver::DrawIndirectCommand const* const&, uint32_t const&,
+            math::float4 const* const&, Driver::DrawBounds const* const&) noexcept;
+
+    void setPipeline(Driver::ProgramHandle ph, Driver::RasterState rs,
+            Driver::RenderPrimitiveHandle rph) noexcept;
+    void setBinding(uint64_t* bindings, size_t index, uint64_t binding) noexcept;
+
+    Stats* const mStats;
+    const uint32_t mCommandCost;
+    std::atomic<HandleBase::HandleId> mNextHandleId = { 1 };
+
+    // the state a real driver would have, only tracked in instrumented mode
+    static constexpr size_t MAX_BINDINGS = 16;
+    uint64_t mUniformBindings[MAX_BINDINGS] = {};
+    uint64_t mStorageBindings[MAX_BINDINGS] = {};
+    uint64_t mSamplerBindings[MAX_BINDINGS] = {};
+    HandleBase::HandleId mProgram = HandleBase::nullid;
+    uint32_t mRasterState = 0;
+    HandleBase::HandleId mPrimitive = HandleBase::nullid;
+    std::unordered_set<uint64_t> mPipelines;
+
     /*
      * Driver interface
      */
@@ -42,15 +149,21 @@ private:
     friend class ConcreteDispatcher;
 
 #define DECL_DRIVER_API(methodName, paramsDecl, params) \
-    UTILS_ALWAYS_INLINE void methodName(paramsDecl) { }
+    UTILS_ALWAYS_INLINE void methodName(paramsDecl) { \
+        if (UTILS_UNLIKELY(mStats)) { \
+            execute(Command::methodName); \
+            instrument(CommandTag<Command::methodName>{}, params); } }
 
 #define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params) \
     RetType methodName(paramsDecl) override { return RetType(); }
 
 #define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params) \
     RetType methodName##Synchronous() noexcept override { \
-        return RetType((RetType::HandleId)0xDEAD0000); } \
-    UTILS_ALWAYS_INLINE void methodName(RetType, paramsDecl) { }
+        return RetType(mStats ? mNextHandleId++ : (RetType::HandleId)0xDEAD0000); } \
+    UTILS_ALWAYS_INLINE void methodName(RetType, paramsDecl) { \
+        if (UTILS_UNLIKELY(mStats)) { \
+            execute(Command::methodName); \
+            instrument(CommandTag<Command::methodName>{}, params); } }
 
 #include "driver/DriverAPI.inc"
 };
@@ -20,6 +20,9 @@
 
 #include <assert.h>
 #include <dlfcn.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
 
 #include <string>
 #include <unordered_set>
@@ -71,6 +74,9 @@ UTILS_PRIVATE PFNEGLCLIENTWAITSYNCKHRPROC eglClientWaitSyncKHR;
 UTILS_PRIVATE PFNEGLCREATEIMAGEKHRPROC eglCreateImageKHR;
 UTILS_PRIVATE PFNEGLDESTROYIMAGEKHRPROC eglDestroyImageKHR;
 UTILS_PRIVATE PFNEGLGETNATIVECLIENTBUFFERANDROIDPROC eglGetNativeClientBufferANDROID;
+UTILS_PRIVATE PFNEGLPRESENTATIONTIMEANDROIDPROC eglPresentationTimeANDROID;
+UTILS_PRIVATE PFNEGLWAITSYNCKHRPROC eglWaitSyncKHR;
+UTILS_PRIVATE PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC eglSwapBuffersWithDamageKHR;
 }
 using namespace glext;
 
@@ -524,6 +530,18 @@ std::unique_ptr<Driver> ContextManagerEGL::createDriver(void* const sharedGLCont
     eglCreateImageKHR = (PFNEGLCREATEIMAGEKHRPROC) eglGetProcAddress("eglCreateImageKHR");
     eglDestroyImageKHR = (PFNEGLDESTROYIMAGEKHRPROC) eglGetProcAddress("eglDestroyImageKHR");
     eglGetNativeClientBufferANDROID = (PFNEGLGETNATIVECLIENTBUFFERANDROIDPROC) eglGetProcAddress("eglGetNativeClientBufferANDROID");
+    if (extensions.has("EGL_ANDROID_presentation_time")) {
+        eglPresentationTimeANDROID = (PFNEGLPRESENTATIONTIMEANDROIDPROC) eglGetProcAddress("eglPresentationTimeANDROID");
+    }
+    if (extensions.has("EGL_ANDROID_native_fence_sync") && extensions.has("EGL_KHR_wait_sync")) {
+        eglWaitSyncKHR = (PFNEGLWAITSYNCKHRPROC) eglGetProcAddress("eglWaitSyncKHR");
+    }
+    // the EXT version has the same signature
+    if (extensions.has("EGL_KHR_swap_buffers_with_damage")) {
+        eglSwapBuffersWithDamageKHR = (PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC) eglGetProcAddress("eglSwapBuffersWithDamageKHR");
+    } else if (extensions.has("EGL_EXT_swap_buffers_with_damage")) {
+        eglSwapBuffersWithDamageKHR = (PFNEGLSWAPBUFFERSWITHDAMAGEKHRPROC) eglGetProcAddress("eglSwapBuffersWithDamageEXT");
+    }
 
     EGLint configsCount;
     EGLint configAttribs[] = {
@@ -663,6 +681,23 @@ ExternalContext::SwapChain* ContextManagerEGL::createSwapChain(
     return (SwapChain*)sur;
 }
 
+ExternalContext::SwapChain* ContextManagerEGL::createSwapChain(
+        uint32_t width, uint32_t height, uint64_t& flags) noexcept {
+    EGLint attribs[] = {
+            EGL_WIDTH,  EGLint(width),
+            EGL_HEIGHT, EGLint(height),
+            EGL_NONE
+    };
+    EGLSurface sur = eglCreatePbufferSurface(mEGLDisplay,
+            (flags & driver::SWAP_CHAIN_CONFIG_TRANSPARENT) ? mEGLTransparentConfig : mEGLConfig,
+            attribs);
+    if (UTILS_UNLIKELY(sur == EGL_NO_SURFACE)) {
+        logEglError("eglCreatePbufferSurface");
+        return nullptr;
+    }
+    return (SwapChain*)sur;
+}
+
 void ContextManagerEGL::destroySwapChain(ExternalContext::SwapChain* swapChain) noexcept {
     EGLSurface sur = (EGLSurface) swapChain;
     if (sur != EGL_NO_SURFACE) {
@@ -681,10 +716,30 @@ void ContextManagerEGL::makeCurrent(ExternalContext::SwapChain* swapChain) noexc
 void ContextManagerEGL::commit(ExternalContext::SwapChain* swapChain) noexcept {
     EGLSurface sur = (EGLSurface) swapChain;
     if (sur != EGL_NO_SURFACE) {
-        eglSwapBuffers(mEGLDisplay, sur);
+        if (!mDamageRects.empty() && eglSwapBuffersWithDamageKHR) {
+            // the whole frame is still rendered, but only the damage is composited
+            eglSwapBuffersWithDamageKHR(mEGLDisplay, sur,
+                    mDamageRects.data(), EGLint(mDamageRects.size() / 4));
+        } else {
+            eglSwapBuffers(mEGLDisplay, sur);
+        }
+    }
+    mDamageRects.clear();
+}
+
+void ContextManagerEGL::setPresentationTime(int64_t presentationTimeInNanosecond) noexcept {
+    // applies to the next eglSwapBuffers() of the current surface
+    if (eglPresentationTimeANDROID &&
+            mCurrentSurface != EGL_NO_SURFACE && mCurrentSurface != mEGLDummySurface) {
+        eglPresentationTimeANDROID(mEGLDisplay, mCurrentSurface, presentationTimeInNanosecond);
     }
 }
 
+void ContextManagerEGL::setDamageRegions(int32_t const* rects, size_t count) noexcept {
+    // applies to the next commit(), EGL rects are also from the bottom-left corner
+    mDamageRects.assign(rects, rects + count * 4);
+}
+
 ExternalContext::Fence* ContextManagerEGL::createFence() noexcept {
     Fence* f = nullptr;
 #ifdef EGL_KHR_reusable_sync
@@ -761,6 +816,53 @@ void ContextManagerEGL::destroyExternalTextureStorage(
     }
 }
 
+ExternalContext::ExternalTexture* ContextManagerEGL::createExternalImage(void* buffer) noexcept {
+    if (UTILS_UNLIKELY(!eglGetNativeClientBufferANDROID)) {
+        return nullptr;
+    }
+    EGLClientBuffer clientBuffer = eglGetNativeClientBufferANDROID(
+            static_cast<AHardwareBuffer const*>(buffer));
+    if (UTILS_UNLIKELY(!clientBuffer)) {
+        logEglError("eglGetNativeClientBufferANDROID");
+        return nullptr;
+    }
+    const EGLint attr[] = { EGL_IMAGE_PRESERVED_KHR, EGL_TRUE, EGL_NONE };
+    EGLImageKHR image = eglCreateImageKHR(mEGLDisplay,
+            EGL_NO_CONTEXT, EGL_NATIVE_BUFFER_ANDROID, clientBuffer, attr);
+    if (UTILS_UNLIKELY(image == EGL_NO_IMAGE_KHR)) {
+        logEglError("eglCreateImageKHR");
+        return nullptr;
+    }
+    return new ExternalTexture{ (uintptr_t)image };
+}
+
+void ContextManagerEGL::destroyExternalImage(ExternalContext::ExternalTexture* image) noexcept {
+    if (image) {
+        eglDestroyImageKHR(mEGLDisplay, (EGLImageKHR)image->image);
+        delete image;
+    }
+}
+
+void ContextManagerEGL::waitFenceOnGpu(int fence) noexcept {
+    if (fence < 0) {
+        return;
+    }
+    if (eglWaitSyncKHR) {
+        // the sync takes ownership of the file descriptor
+        const EGLint attr[] = { EGL_SYNC_NATIVE_FENCE_FD_ANDROID, fence, EGL_NONE };
+        EGLSyncKHR sync = eglCreateSyncKHR(mEGLDisplay, EGL_SYNC_NATIVE_FENCE_ANDROID, attr);
+        if (sync != EGL_NO_SYNC_KHR) {
+            eglWaitSyncKHR(mEGLDisplay, sync, 0);
+            eglDestroySyncKHR(mEGLDisplay, sync);
+            return;
+        }
+        logEglError("eglCreateSyncKHR");
+    }
+    pollfd fd = { .fd = fence, .events = POLLIN };
+    while (poll(&fd, 1, -1) < 0 && (errno == EINTR || errno == EAGAIN)) { }
+    close(fence);
+}
+
 int ContextManagerEGL::getOSVersion() const noexcept {
     return mOSVersion;
 }
@@ -19,6 +19,8 @@
 
 #include <stdint.h>
 
+#include <vector>
+
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
 
@@ -42,9 +44,12 @@ public:
     void terminate() noexcept override;
 
     SwapChain* createSwapChain(void* nativewindow, uint64_t& flags) noexcept final;
+    SwapChain* createSwapChain(uint32_t width, uint32_t height, uint64_t& flags) noexcept final;
     void destroySwapChain(SwapChain* swapChain) noexcept final;
     void makeCurrent(SwapChain* swapChain) noexcept final;
     void commit(SwapChain* swapChain) noexcept final;
+    void setPresentationTime(int64_t presentationTimeInNanosecond) noexcept final;
+    void setDamageRegions(int32_t const* rects, size_t count) noexcept final;
 
     bool canCreateFence() noexcept final { return true; }
     Fence* createFence() noexcept final;
@@ -62,6 +67,10 @@ public:
             uint32_t w, uint32_t h, driver::TextureFormat format) noexcept final;
     void destroyExternalTextureStorage(ExternalTexture* ets) noexcept final;
 
+    ExternalTexture* createExternalImage(void* buffer) noexcept final;
+    void destroyExternalImage(ExternalTexture* image) noexcept final;
+    void waitFenceOnGpu(int fence) noexcept final;
+
     int getOSVersion() const noexcept final;
 
 private:
@@ -75,6 +84,9 @@ private:
     EGLConfig mEGLTransparentConfig;
     int mOSVersion;
 
+    // the rects of the next eglSwapBuffersWithDamageKHR(), see setDamageRegions()
+    std::vector<EGLint> mDamageRects;
+
     ExternalStreamManagerAndroid& mExternalStreamManager;
     ExternalTextureManagerAndroid& mExternalTextureManager;
 };
@@ -27,6 +27,7 @@
 
 #include <dlfcn.h>
 
+#include <algorithm>
 #include <iostream>
 
 #define LIBRARY_GLX "libGL.so.1"
@@ -167,7 +168,31 @@ ExternalContext::SwapChain* ContextManagerGLX::createSwapChain(
     return (SwapChain*) nativeWindow;
 }
 
-void ContextManagerGLX::destroySwapChain(ExternalContext::SwapChain* /*swapChain*/) noexcept {
+ExternalContext::SwapChain* ContextManagerGLX::createSwapChain(
+        uint32_t width, uint32_t height, uint64_t& flags) noexcept {
+
+    // Transparent swap chain is not supported
+    flags &= ~driver::SWAP_CHAIN_CONFIG_TRANSPARENT;
+    int pbufferAttribs[] = {
+            GLX_PBUFFER_WIDTH,  int(width),
+            GLX_PBUFFER_HEIGHT, int(height),
+            GL_NONE
+    };
+    GLXPbuffer sur = g_glx.createPbuffer(mGLXDisplay, mGLXConfig[0], pbufferAttribs);
+    if (sur) {
+        mPBuffers.push_back(sur);
+    }
+    return (SwapChain*) sur;
+}
+
+void ContextManagerGLX::destroySwapChain(ExternalContext::SwapChain* swapChain) noexcept {
+    // the windows belong to the application, only the pbuffers are ours
+    auto pos = std::find(mPBuffers.begin(), mPBuffers.end(), (GLXPbuffer) swapChain);
+    if (pos != mPBuffers.end()) {
+        g_glx.setCurrentContext(mGLXDisplay, mDummySurface, mDummySurface, mGLXContext);
+        g_glx.destroyPbuffer(mGLXDisplay, *pos);
+        mPBuffers.erase(pos);
+    }
 }
 
 void ContextManagerGLX::makeCurrent(ExternalContext::SwapChain* swapChain) noexcept {
@@ -38,6 +38,7 @@ inline void glClearStencil(GLint) { }
 inline void glClearDepthf(GLfloat) { }
 
 inline void glBindBufferBase(GLenum, GLuint, GLuint) { }
+inline void glBindBufferRange(GLenum, GLuint, GLuint, GLintptr, GLsizeiptr) { }
 inline void glBindVertexArray (GLuint) { }
 inline void glBindTexture (GLenum, GLuint)   { }
 inline void glBindBuffer (GLenum, GLuint) { }
@@ -49,6 +50,8 @@ inline void glBufferData(GLenum, GLsizeiptr, const void *, GLenum) { }
 inline void glBufferSubData(GLenum, GLintptr, GLsizeiptr, const void *) { }
 inline void glCompressedTexSubImage2D(GLenum, GLint, GLint, GLint, GLsizei, GLsizei, GLenum, GLsizei, const void *) { }
 inline void glTexSubImage2D(GLenum, GLint, GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, const void *) { }
+inline void glCompressedTexSubImage3D(GLenum, GLint, GLint, GLint, GLint, GLsizei, GLsizei, GLsizei, GLenum, GLsizei, const void *) { }
+inline void glTexSubImage3D(GLenum, GLint, GLint, GLint, GLint, GLsizei, GLsizei, GLsizei, GLenum, GLenum, const void *) { }
 inline void glGenerateMipmap(GLenum) { }
 
 inline void glVertexAttribPointer(GLuint, GLint, GLenum, GLboolean, GLsizei, const void *) { }
@@ -71,6 +74,7 @@ inline void glRenderbufferStorage (GLenum, GLenum, GLsizei, GLsizei) { }
 
 inline void glClear(GLbitfield) { }
 inline void glDrawRangeElements(GLenum, GLuint, GLuint, GLsizei, GLenum, const void *)  { }
+inline void glDrawElementsInstanced(GLenum, GLsizei, GLenum, const void *, GLsizei)  { }
 inline void glBlitFramebuffer (GLint, GLint, GLint, GLint, GLint, GLint, GLint, GLint, GLbitfield, GLenum) { }
 inline void glReadPixels (GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, void *) { }
 
@@ -16,6 +16,8 @@
 
 #include "driver/opengl/OpenGLDriver.h"
 
+#include <algorithm>
+#include <limits>
 #include <set>
 
 #include <utils/compiler.h>
@@ -98,6 +100,7 @@ OpenGLDriver::OpenGLDriver(ContextManagerGL* externalContext) noexcept
         : DriverBase(new ConcreteDispatcher<OpenGLDriver>(this)),
           mHandleArena("Handles", 2U * 1024U * 1024U), // TODO: set the amount in configuration
           mSamplerMap(32),
+          mStagePool(*this),
           mContextManager(*externalContext) {
     state.enables.caps.set(getIndexForCap(GL_DITHER));
     state.vao.p = &mDefaultVAO;
@@ -113,6 +116,17 @@ OpenGLDriver::OpenGLDriver(ContextManagerGL* externalContext) noexcept
    UTILS_UNUSED char const* const shader   = (char const*) glGetString(GL_SHADING_LANGUAGE_VERSION);
 
 #ifndef NDEBUG
+    slog.d << "HwFence: " << sizeof(HwFence) << io::endl;
+    slog.d << "GLIndexBuffer: " << sizeof(GLIndexBuffer) << io::endl;
+    slog.d << "GLSamplerBuffer: " << sizeof(GLSamplerBuffer) << io::endl;
+    slog.d << "GLRenderPrimitive: " << sizeof(GLRenderPrimitive) << io::endl;
+    slog.d << "GLTexture: " << sizeof(GLTexture) << io::endl;
+    slog.d << "OpenGLProgram: " << sizeof(OpenGLProgram) << io::endl;
+    slog.d << "GLRenderTarget: " << sizeof(GLRenderTarget) << io::endl;
+    slog.d << "GLVertexBuffer: " << sizeof(GLVertexBuffer) << io::endl;
+    slog.d << "GLUniformBuffer: " << sizeof(GLUniformBuffer) << io::endl;
+    slog.d << "GLStream: " << sizeof(GLStream) << io::endl;
+
     slog.i
         << vendor << io::endl
         << renderer << io::endl
@@ -126,6 +140,11 @@ OpenGLDriver::OpenGLDriver(ContextManagerGL* externalContext) noexcept
     glGetIntegerv(GL_MAJOR_VERSION, &major);
     glGetIntegerv(GL_MINOR_VERSION, &minor);
     glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &mMaxRenderBufferSize);
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &mUniformBufferOffsetAlignment);
+    if (mUniformBufferOffsetAlignment <= 0) {
+        // 256 is the largest value allowed by the spec
+        mUniformBufferOffsetAlignment = 256;
+    }
 
     if (strstr(renderer, "Adreno")) {
         bugs.clears_hurt_performance = true;
@@ -170,6 +189,19 @@ OpenGLDriver::OpenGLDriver(ContextManagerGL* externalContext) noexcept
     };
     mShaderModel = shaderModel;
 
+    // The program binaries are only valid for the driver which produced them, the renderer and
+    // version strings identify it.
+    driver::BlobCache* const blobCache = mContextManager.getBlobCache();
+    if (blobCache) {
+        GLint formatCount = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+        if (formatCount > 0) {
+            mBlobCache = blobCache;
+            mProgramBinaryKey = OpenGLProgram::hash(renderer, strlen(renderer));
+            mProgramBinaryKey = OpenGLProgram::hash(version, strlen(version), mProgramBinaryKey);
+        }
+    }
+
     /*
      * Set our default state
      */
@@ -233,6 +265,12 @@ void OpenGLDriver::initExtensionsGLES(GLint major, GLint minor, std::set<StaticS
     ext.OES_EGL_image_external_essl3 = hasExtension(exts, "GL_OES_EGL_image_external_essl3");
     ext.EXT_debug_marker = hasExtension(exts, "GL_EXT_debug_marker");
     ext.EXT_color_buffer_half_float = hasExtension(exts, "GL_EXT_color_buffer_half_float");
+    ext.KHR_parallel_shader_compile = hasExtension(exts, "GL_KHR_parallel_shader_compile");
+    ext.EXT_disjoint_timer_query = hasExtension(exts, "GL_EXT_disjoint_timer_query");
+    ext.timer_query = ext.EXT_disjoint_timer_query;
+    ext.compute_shader = (major == 3 && minor >= 1) || major > 3;
+    ext.EXT_multisampled_render_to_texture =
+            hasExtension(exts, "GL_EXT_multisampled_render_to_texture");
 }
 
 void OpenGLDriver::initExtensionsGL(GLint major, GLint minor, std::set<StaticString> const& exts) {
@@ -242,6 +280,16 @@ void OpenGLDriver::initExtensionsGL(GLint major, GLint minor, std::set<StaticStr
     ext.OES_EGL_image_external_essl3 = hasExtension(exts, "GL_OES_EGL_image_external_essl3");
     ext.EXT_debug_marker = hasExtension(exts, "GL_EXT_debug_marker");
     ext.EXT_color_buffer_half_float = true;  // Assumes core profile.
+    ext.KHR_parallel_shader_compile = hasExtension(exts, "GL_KHR_parallel_shader_compile") ||
+                                      hasExtension(exts, "GL_ARB_parallel_shader_compile");
+    ext.ARB_multi_draw_indirect = (major == 4 && minor >= 3) || major > 4 ||
+                                  hasExtension(exts, "GL_ARB_multi_draw_indirect");
+    ext.ARB_shader_draw_parameters = (major == 4 && minor >= 6) || major > 4 ||
+                                     hasExtension(exts, "GL_ARB_shader_draw_parameters");
+    ext.timer_query = true;  // core since GL 3.3
+    ext.compute_shader = (major == 4 && minor >= 3) || major > 4 ||
+                         (hasExtension(exts, "GL_ARB_compute_shader") &&
+                          hasExtension(exts, "GL_ARB_shader_image_load_store"));
 }
 
 void OpenGLDriver::terminate() {
@@ -250,10 +298,36 @@ void OpenGLDriver::terminate() {
         glDeleteSamplers(1, &item.second);
     }
     mSamplerMap.clear();
+    processReadbacks(true);
+    processReleasedImages(true);
+    for (GLTextureUpload& upload : mPendingTextureUploads) {
+        scheduleDestroy(std::move(upload.p));
+    }
+    mPendingTextureUploads.clear();
+    for (GLTimerQuery const& query : mPendingTimerQueries) {
+        mFreeTimerQueries.push_back(query.query);
+    }
+    mPendingTimerQueries.clear();
+    if (!mFreeTimerQueries.empty()) {
+        glDeleteQueries(GLsizei(mFreeTimerQueries.size()), mFreeTimerQueries.data());
+        mFreeTimerQueries.clear();
+    }
+    mStagePool.reset();
+    for (GLsync& fence : mDynamicBufferFences) {
+        if (fence) {
+            glDeleteSync(fence);
+            fence = 0;
+        }
+    }
+    if (mDrawIndirectBuffer) {
+        glDeleteBuffers(1, &mDrawIndirectBuffer);
+        mDrawIndirectBuffer = 0;
+    }
     if (mOpenGLBlitter) {
         mOpenGLBlitter->terminate();
     }
     terminateClearProgram();
+    terminateDrawCullingProgram();
     mContextManager.terminate();
 }
 
@@ -389,11 +463,11 @@ void OpenGLDriver::bindBuffer(GLenum target, GLuint buffer) noexcept {
         // GL_ELEMENT_ARRAY_BUFFER is a special case, where the currently bound VAO remembers
         // the index buffer, unless there are no VAO bound (see: bindVertexArray)
         assert(state.vao.p);
-        if (state.buffers.targets[targetIndex].genericBinding != buffer
-                || ((state.vao.p != &mDefaultVAO) && (state.vao.p->gl.elementArray != buffer))) {
+        if (countStateChange(state.buffers.targets[targetIndex].genericBinding != buffer
+                || ((state.vao.p != &mDefaultVAO) && (state.vao.p->elementArray != buffer)))) {
             state.buffers.targets[targetIndex].genericBinding = buffer;
             if (state.vao.p != &mDefaultVAO) {
-                state.vao.p->gl.elementArray = buffer;
+                state.vao.p->elementArray = buffer;
             }
             glBindBuffer(target, buffer);
         }
@@ -404,17 +478,39 @@ void OpenGLDriver::bindBuffer(GLenum target, GLuint buffer) noexcept {
     }
 }
 
+void OpenGLDriver::bindUnpackBuffer(GLuint buffer) noexcept {
+    bindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+}
+
 void OpenGLDriver::bindBufferBase(GLenum target, GLuint index, GLuint buffer) noexcept {
     size_t targetIndex = getIndexForBufferTarget(target);
     // this ALSO sets the generic binding
-    if (state.buffers.targets[targetIndex].buffers[index] != buffer
-            || state.buffers.targets[targetIndex].genericBinding != buffer) {
-        state.buffers.targets[targetIndex].buffers[index] = buffer;
-        state.buffers.targets[targetIndex].genericBinding = buffer;
+    auto& t = state.buffers.targets[targetIndex];
+    if (countStateChange(t.buffers[index] != buffer || t.genericBinding != buffer
+            || t.offsets[index] != 0 || t.sizes[index] != 0)) {
+        t.buffers[index] = buffer;
+        t.offsets[index] = 0;
+        t.sizes[index] = 0;
+        t.genericBinding = buffer;
         glBindBufferBase(target, index, buffer);
     }
 }
 
+void OpenGLDriver::bindBufferRange(GLenum target, GLuint index, GLuint buffer,
+        GLintptr offset, GLsizeiptr size) noexcept {
+    size_t targetIndex = getIndexForBufferTarget(target);
+    // this ALSO sets the generic binding
+    auto& t = state.buffers.targets[targetIndex];
+    if (countStateChange(t.buffers[index] != buffer || t.genericBinding != buffer
+            || t.offsets[index] != offset || t.sizes[index] != size)) {
+        t.buffers[index] = buffer;
+        t.offsets[index] = offset;
+        t.sizes[index] = size;
+        t.genericBinding = buffer;
+        glBindBufferRange(target, index, buffer, offset, size);
+    }
+}
+
 void OpenGLDriver::bindFramebuffer(GLenum target, GLuint buffer) noexcept {
     switch (target) {
         case GL_FRAMEBUFFER:
@@ -440,17 +536,17 @@ void OpenGLDriver::bindFramebuffer(GLenum target, GLuint buffer) noexcept {
     }
 }
 
-void OpenGLDriver::bindVertexArray(GLRenderPrimitive const* p) noexcept {
-    GLRenderPrimitive* vao = p ? const_cast<GLRenderPrimitive *>(p) : &mDefaultVAO;
+void OpenGLDriver::bindVertexArray(GLVertexArray const* p) noexcept {
+    GLVertexArray* vao = p ? const_cast<GLVertexArray *>(p) : &mDefaultVAO;
     update_state(state.vao.p, vao, [&]() {
-        glBindVertexArray(vao->gl.vao);
+        glBindVertexArray(vao->vao);
         // update GL_ELEMENT_ARRAY_BUFFER, which is updated by glBindVertexArray
         size_t targetIndex = getIndexForBufferTarget(GL_ELEMENT_ARRAY_BUFFER);
-        state.buffers.targets[targetIndex].genericBinding = vao->gl.elementArray;
+        state.buffers.targets[targetIndex].genericBinding = vao->elementArray;
         if (UTILS_UNLIKELY(bugs.vao_doesnt_store_element_array_buffer_binding)) {
             // This shouldn't be needed, but it looks like some drivers don't do the implicit
             // glBindBuffer().
-            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vao->gl.elementArray);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vao->elementArray);
         }
     });
 }
@@ -459,6 +555,8 @@ void OpenGLDriver::bindTexture(GLuint unit, GLuint target, GLuint texId, size_t
     assert(targetIndex == getIndexForTextureTarget(target));
     assert(targetIndex < TEXTURE_TARGET_COUNT);
     update_state(state.textures.units[unit].targets[targetIndex].texture_id, texId, [&]() {
+        state.stats.textureSwitches++;
+        state.textures.version++;
         activeTexture(unit);
         glBindTexture(target, texId);
     }, (target == GL_TEXTURE_EXTERNAL_OES) && bugs.texture_external_needs_rebind);
@@ -466,6 +564,7 @@ void OpenGLDriver::bindTexture(GLuint unit, GLuint target, GLuint texId, size_t
 
 void OpenGLDriver::useProgram(GLuint program) noexcept {
     update_state(state.program.use, program, [&]() {
+        state.stats.programSwitches++;
         glUseProgram(program);
     });
 }
@@ -478,25 +577,25 @@ void OpenGLDriver::useProgram(OpenGLProgram* p) noexcept {
 
 void OpenGLDriver::enableVertexAttribArray(GLuint index) noexcept {
     assert(state.vao.p);
-    assert(index < state.vao.p->gl.vertexAttribArray.size());
-    if (UTILS_UNLIKELY(!state.vao.p->gl.vertexAttribArray[index])) {
-        state.vao.p->gl.vertexAttribArray.set(index);
+    assert(index < state.vao.p->vertexAttribArray.size());
+    if (UTILS_UNLIKELY(countStateChange(!state.vao.p->vertexAttribArray[index]))) {
+        state.vao.p->vertexAttribArray.set(index);
         glEnableVertexAttribArray(index);
     }
 }
 
 void OpenGLDriver::disableVertexAttribArray(GLuint index) noexcept {
     assert(state.vao.p);
-    assert(index < state.vao.p->gl.vertexAttribArray.size());
-    if (UTILS_UNLIKELY(state.vao.p->gl.vertexAttribArray[index])) {
-        state.vao.p->gl.vertexAttribArray.unset(index);
+    assert(index < state.vao.p->vertexAttribArray.size());
+    if (UTILS_UNLIKELY(countStateChange(state.vao.p->vertexAttribArray[index]))) {
+        state.vao.p->vertexAttribArray.unset(index);
         glDisableVertexAttribArray(index);
     }
 }
 
 void OpenGLDriver::enable(GLenum cap) noexcept {
     size_t index = getIndexForCap(cap);
-    if (UTILS_UNLIKELY(!state.enables.caps[index])) {
+    if (UTILS_UNLIKELY(countStateChange(!state.enables.caps[index]))) {
         state.enables.caps.set(index);
         glEnable(cap);
     }
@@ -504,7 +603,7 @@ void OpenGLDriver::enable(GLenum cap) noexcept {
 
 void OpenGLDriver::disable(GLenum cap) noexcept {
     size_t index = getIndexForCap(cap);
-    if (UTILS_UNLIKELY(state.enables.caps[index])) {
+    if (UTILS_UNLIKELY(countStateChange(state.enables.caps[index]))) {
         state.enables.caps.unset(index);
         glDisable(cap);
     }
@@ -519,8 +618,8 @@ void OpenGLDriver::cullFace(GLenum mode) noexcept {
 
 void OpenGLDriver::blendEquation(GLenum modeRGB, GLenum modeA) noexcept {
     // WARNING: don't call this without updating mRasterState
-    if (UTILS_UNLIKELY(
-            state.raster.blendEquationRGB != modeRGB || state.raster.blendEquationA != modeA)) {
+    if (UTILS_UNLIKELY(countStateChange(
+            state.raster.blendEquationRGB != modeRGB || state.raster.blendEquationA != modeA))) {
         state.raster.blendEquationRGB = modeRGB;
         state.raster.blendEquationA   = modeA;
         glBlendEquationSeparate(modeRGB, modeA);
@@ -529,11 +628,11 @@ void OpenGLDriver::blendEquation(GLenum modeRGB, GLenum modeA) noexcept {
 
 void OpenGLDriver::blendFunction(GLenum srcRGB, GLenum srcA, GLenum dstRGB, GLenum dstA) noexcept {
     // WARNING: don't call this without updating mRasterState
-    if (UTILS_UNLIKELY(
+    if (UTILS_UNLIKELY(countStateChange(
             state.raster.blendFunctionSrcRGB != srcRGB ||
             state.raster.blendFunctionSrcA != srcA ||
             state.raster.blendFunctionDstRGB != dstRGB ||
-            state.raster.blendFunctionDstA != dstA)) {
+            state.raster.blendFunctionDstA != dstA))) {
         state.raster.blendFunctionSrcRGB = srcRGB;
         state.raster.blendFunctionSrcA = srcA;
         state.raster.blendFunctionDstRGB = dstRGB;
@@ -661,67 +760,30 @@ default_case:
 
 // For reference on a 64-bits machine:
 //    GLFence                   :  8
-//    GLIndexBuffer             : 12        moderate
-//    GLSamplerBuffer           : 16        moderate
 // -- less than 16 bytes
 
-//    GLRenderPrimitive         : 40        many
+//    GLIndexBuffer             : 24        moderate
+//    GLSamplerBuffer           : 40        moderate
 //    GLTexture                 : 44        moderate
-//    OpenGLProgram             : 40        moderate
+//    OpenGLProgram             : 48        moderate
+//    GLRenderPrimitive         : 56        many
 //    GLRenderTarget            : 56        few
 // -- less than 64 bytes
 
-//    GLVertexBuffer            : 80        moderate
-//    GLStream                  : 120       few
+//    GLVertexBuffer            : 104       moderate
+//    GLStream                  : 128       few
 //    GLUniformBuffer           : 128       many
 // -- less than 128 bytes
 
 
-OpenGLDriver::HandleAllocator::HandleAllocator(const utils::HeapArea& area)
-        : mPool0(area.begin(),
-                  pointermath::add(area.begin(), (1 * area.getSize()) / 16)),
-          mPool1( pointermath::add(area.begin(), (1 * area.getSize()) / 16),
-                  pointermath::add(area.begin(), (6 * area.getSize()) / 16)),
-          mPool2( pointermath::add(area.begin(), (6 * area.getSize()) / 16),
-                  area.end()) {
-
-#ifndef NDEBUG
-    slog.d << "HwFence: " << sizeof(HwFence) << io::endl;
-    slog.d << "GLIndexBuffer: " << sizeof(GLIndexBuffer) << io::endl;
-    slog.d << "GLSamplerBuffer: " << sizeof(GLSamplerBuffer) << io::endl;
-    slog.d << "GLRenderPrimitive: " << sizeof(GLRenderPrimitive) << io::endl;
-    slog.d << "GLTexture: " << sizeof(GLTexture) << io::endl;
-    slog.d << "OpenGLProgram: " << sizeof(OpenGLProgram) << io::endl;
-    slog.d << "GLRenderTarget: " << sizeof(GLRenderTarget) << io::endl;
-    slog.d << "GLVertexBuffer: " << sizeof(GLVertexBuffer) << io::endl;
-    slog.d << "GLUniformBuffer: " << sizeof(GLUniformBuffer) << io::endl;
-    slog.d << "GLStream: " << sizeof(GLStream) << io::endl;
-#endif
-}
-
-void* OpenGLDriver::HandleAllocator::alloc(size_t size, size_t alignment, size_t extra) noexcept {
-    assert(size <= mPool2.getSize());
-    if (size <= mPool0.getSize()) return mPool0.alloc(size, 16, extra);
-    if (size <= mPool1.getSize()) return mPool1.alloc(size, 32, extra);
-    if (size <= mPool2.getSize()) return mPool2.alloc(size, 32, extra);
-    return nullptr;
-}
-
-void OpenGLDriver::HandleAllocator::free(void* p, size_t size) noexcept {
-    if (size <= mPool0.getSize()) { mPool0.free(p); return; }
-    if (size <= mPool1.getSize()) { mPool1.free(p); return; }
-    if (size <= mPool2.getSize()) { mPool2.free(p); return; }
-}
-
-
-// This is "NOINLINE" because it ends-up generating more code than we'd like because of
-// the locking (unfortunately, mHandleArena is accessed from 2 threads)
+// This is "NOINLINE" because it ends-up generating more code than we'd like (on debug builds
+// mHandleArena is locked, since it's accessed from 2 threads)
 UTILS_NOINLINE
 HandleBase::HandleId OpenGLDriver::allocateHandle(size_t size) noexcept {
     void* addr = mHandleArena.alloc(size);
     char* const base = (char *)mHandleArena.getArea().begin();
     size_t offset = (char*)addr - base;
-    return HandleBase::HandleId(offset >> HandleAllocator::MIN_ALIGNMENT_SHIFT);
+    return HandleBase::HandleId(offset >> HandleAllocatorGL::MIN_ALIGNMENT_SHIFT);
 }
 
 template<typename D, typename B, typename ... ARGS>
@@ -798,16 +860,25 @@ Handle<HwSwapChain> OpenGLDriver::createSwapChainSynchronous() noexcept {
     return Handle<HwSwapChain>( allocateHandle(sizeof(HwSwapChain)) );
 }
 
+Handle<HwSwapChain> OpenGLDriver::createSwapChainHeadlessSynchronous() noexcept {
+    return Handle<HwSwapChain>( allocateHandle(sizeof(HwSwapChain)) );
+}
+
 Handle<HwStream> OpenGLDriver::createStreamFromTextureIdSynchronous() noexcept {
     return Handle<HwStream>( allocateHandle(sizeof(GLStream)) );
 }
 
+Handle<HwStream> OpenGLDriver::createStreamAcquiredSynchronous() noexcept {
+    return Handle<HwStream>( allocateHandle(sizeof(GLStream)) );
+}
+
 void OpenGLDriver::createVertexBuffer(
     Driver::VertexBufferHandle vbh,
     uint8_t bufferCount,
     uint8_t attributeCount,
     uint32_t elementCount,
-    Driver::AttributeArray attributes) {
+    Driver::AttributeArray attributes,
+    Driver::Usage usage) {
     DEBUG_MARKER()
 
     GLVertexBuffer* vb = construct<GLVertexBuffer>(vbh,
@@ -816,6 +887,12 @@ void OpenGLDriver::createVertexBuffer(
     GLsizei n = GLsizei(vb->bufferCount);
     glGenBuffers(n, vb->gl.buffers.data());
 
+    const bool dynamic = usage == Driver::Usage::DYNAMIC;
+    if (dynamic) {
+        vb->dynamic.reset(new GLDynamicBuffer[n]);
+        mDynamicBufferCount++;
+    }
+
     for (GLsizei i = 0; i < n; i++) {
         // figure out the size needed for each buffer
         size_t size = 0;
@@ -826,14 +903,22 @@ void OpenGLDriver::createVertexBuffer(
             }
         }
         bindBuffer(GL_ARRAY_BUFFER, vb->gl.buffers[i]);
-        glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STATIC_DRAW);
+        if (UTILS_UNLIKELY(dynamic)) {
+            GLDynamicBuffer& db = vb->dynamic[i];
+            db.size = uint32_t(size);
+            db.shadow.reset(new uint8_t[size]());
+            glBufferData(GL_ARRAY_BUFFER, size * DYNAMIC_BUFFER_REGION_COUNT, nullptr,
+                    GL_DYNAMIC_DRAW);
+        } else {
+            glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STATIC_DRAW);
+        }
     }
 
     CHECK_GL_ERROR(utils::slog.e)
 }
 
 void OpenGLDriver::createIndexBuffer(Driver::IndexBufferHandle ibh, Driver::ElementType elementType,
-        uint32_t indexCount) {
+        uint32_t indexCount, Driver::Usage usage) {
     DEBUG_MARKER()
 
     uint8_t elementSize = static_cast<uint8_t>(getElementTypeSize(elementType));
@@ -842,16 +927,25 @@ void OpenGLDriver::createIndexBuffer(Driver::IndexBufferHandle ibh, Driver::Elem
     GLsizeiptr size = elementSize * indexCount;
     bindVertexArray(nullptr);
     bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ib->gl.buffer);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, nullptr, GL_STATIC_DRAW);
+    if (UTILS_UNLIKELY(usage == Driver::Usage::DYNAMIC)) {
+        GLDynamicBuffer* db = new GLDynamicBuffer();
+        db->size = uint32_t(size);
+        db->shadow.reset(new uint8_t[size]());
+        ib->dynamic.reset(db);
+        mDynamicBufferCount++;
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, size * DYNAMIC_BUFFER_REGION_COUNT, nullptr,
+                GL_DYNAMIC_DRAW);
+    } else {
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, nullptr, GL_STATIC_DRAW);
+    }
     CHECK_GL_ERROR(utils::slog.e)
 }
 
 void OpenGLDriver::createRenderPrimitive(Driver::RenderPrimitiveHandle rph, int) {
     DEBUG_MARKER()
 
-    GLRenderPrimitive* rp = construct<GLRenderPrimitive>(rph);
-    glGenVertexArrays(1, &rp->gl.vao);
-    CHECK_GL_ERROR(utils::slog.e)
+    // the VAO is set by setRenderPrimitiveBuffer()
+    construct<GLRenderPrimitive>(rph);
 }
 
 void OpenGLDriver::createProgram(Driver::ProgramHandle ph, Program&& program) {
@@ -864,7 +958,21 @@ void OpenGLDriver::createProgram(Driver::ProgramHandle ph, Program&& program) {
 void OpenGLDriver::createSamplerBuffer(Driver::SamplerBufferHandle sbh, size_t size) {
     DEBUG_MARKER()
 
-    construct<GLSamplerBuffer>(sbh, size);
+    GLSamplerBuffer* sb = construct<GLSamplerBuffer>(sbh, size);
+    sb->gl.bindings.resize(size);
+    sb->gl.generation = ++mSamplerBufferGeneration;
+}
+
+void OpenGLDriver::loadSamplerBuffer(Driver::SamplerBufferHandle sbh,
+        SamplerBuffer::Sampler const* samplers, uint32_t count) {
+    DEBUG_MARKER()
+
+    // SamplerBuffer has no heap storage, this doesn't allocate
+    SamplerBuffer buffer(count);
+    for (size_t i = 0; i < count; i++) {
+        buffer.setSampler(i, samplers[i]);
+    }
+    updateSamplerBuffer(sbh, std::move(buffer));
 }
 
 void OpenGLDriver::createUniformBuffer(Driver::UniformBufferHandle ubh, size_t size) {
@@ -891,7 +999,8 @@ void OpenGLDriver::textureStorage(OpenGLDriver::GLTexture* t,
             glTexStorage2D(t->gl.target, GLsizei(t->levels), t->gl.internalFormat,
                     GLsizei(width), GLsizei(height));
             break;
-        case GL_TEXTURE_3D: {
+        case GL_TEXTURE_3D:
+        case GL_TEXTURE_2D_ARRAY: {
             glTexStorage3D(t->gl.target, GLsizei(t->levels), t->gl.internalFormat,
                     GLsizei(width), GLsizei(height), GLsizei(depth));
             break;
@@ -956,6 +1065,14 @@ void OpenGLDriver::createTexture(Driver::TextureHandle th, SamplerType target, u
                 t->gl.targetIndex = (uint8_t)
                         getIndexForTextureTarget(t->gl.target = GL_TEXTURE_CUBE_MAP);
                 break;
+            case SamplerType::SAMPLER_2D_ARRAY:
+                t->gl.targetIndex = (uint8_t)
+                        getIndexForTextureTarget(t->gl.target = GL_TEXTURE_2D_ARRAY);
+                break;
+            case SamplerType::SAMPLER_3D:
+                t->gl.targetIndex = (uint8_t)
+                        getIndexForTextureTarget(t->gl.target = GL_TEXTURE_3D);
+                break;
         }
 
         if (t->samples > 1) {
@@ -977,6 +1094,21 @@ void OpenGLDriver::framebufferTexture(Driver::TargetBufferInfo& binfo,
     assert(t->target != SamplerType::SAMPLER_EXTERNAL);
 
     bindFramebuffer(GL_FRAMEBUFFER, rt->gl.fbo);
+
+#ifdef GL_EXT_multisampled_render_to_texture
+    if (rt->gl.autoResolve) {
+        // the texture is single-sampled, it's rendered multisampled on tile and resolved
+        // into it when the tile is written back
+        assert(t->target == SamplerType::SAMPLER_2D || t->target == SamplerType::SAMPLER_CUBEMAP);
+        GLenum target = t->target == SamplerType::SAMPLER_CUBEMAP ?
+                getCubemapTarget(binfo.face) : t->gl.target;
+        glFramebufferTexture2DMultisampleEXT(GL_FRAMEBUFFER, attachment,
+                target, t->gl.texture_id, binfo.level, rt->gl.samples);
+        CHECK_GL_FRAMEBUFFER_STATUS(utils::slog.e)
+        return;
+    }
+#endif
+
     // NOTE: on GL3.2 / GLES3.1 and above multisample is handled when creating the texture
     switch (t->target) {
         case SamplerType::SAMPLER_2D:
@@ -989,6 +1121,11 @@ void OpenGLDriver::framebufferTexture(Driver::TargetBufferInfo& binfo,
                     target, t->gl.texture_id, binfo.level);
             break;
         }
+        case SamplerType::SAMPLER_2D_ARRAY:
+        case SamplerType::SAMPLER_3D:
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, attachment,
+                    t->gl.texture_id, binfo.level, binfo.layer);
+            break;
         case SamplerType::SAMPLER_EXTERNAL:
             // cannot happen by construction
             break;
@@ -998,8 +1135,15 @@ void OpenGLDriver::framebufferTexture(Driver::TargetBufferInfo& binfo,
 }
 
 void OpenGLDriver::renderBufferStorage(GLuint rbo, GLenum internalformat, uint32_t width,
-        uint32_t height, uint8_t samples) const noexcept {
+        uint32_t height, uint8_t samples, bool autoResolve) const noexcept {
     glBindRenderbuffer(GL_RENDERBUFFER, rbo);
+#ifdef GL_EXT_multisampled_render_to_texture
+    if (autoResolve) {
+        // must match the textures attached with glFramebufferTexture2DMultisampleEXT()
+        glRenderbufferStorageMultisampleEXT(GL_RENDERBUFFER, samples, internalformat, width, height);
+        return;
+    }
+#endif
     if (samples > 1) {
         glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, internalformat, width, height);
     } else {
@@ -1008,17 +1152,19 @@ void OpenGLDriver::renderBufferStorage(GLuint rbo, GLenum internalformat, uint32
 }
 
 void OpenGLDriver::framebufferRenderbuffer(GLRenderTarget::GL::RenderBuffer* rb, GLenum attachment,
-        GLenum internalformat, uint32_t width, uint32_t height, uint8_t samples, GLuint fbo) noexcept {
-    rb->id = framebufferRenderbuffer(width, height, samples, attachment, internalformat, fbo);
+        GLenum internalformat, uint32_t width, uint32_t height, uint8_t samples,
+        bool autoResolve, GLuint fbo) noexcept {
+    rb->id = framebufferRenderbuffer(width, height, samples, autoResolve,
+            attachment, internalformat, fbo);
     rb->internalFormat = internalformat;
 }
 
 GLuint OpenGLDriver::framebufferRenderbuffer(uint32_t width, uint32_t height, uint8_t samples,
-        GLenum attachment, GLenum internalformat, GLuint fbo) noexcept {
+        bool autoResolve, GLenum attachment, GLenum internalformat, GLuint fbo) noexcept {
 
     GLuint rbo;
     glGenRenderbuffers(1, &rbo);
-    renderBufferStorage(rbo, internalformat, width, height, samples);
+    renderBufferStorage(rbo, internalformat, width, height, samples, autoResolve);
 
     bindFramebuffer(GL_FRAMEBUFFER, fbo);
     glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachment, GL_RENDERBUFFER, rbo);
@@ -1055,6 +1201,12 @@ void OpenGLDriver::createRenderTarget(Driver::RenderTargetHandle rth,
     rt->height = height;
     rt->gl.samples = samples;
 
+    // Single-sampled textures rendered with more samples are resolved on tile when possible,
+    // which saves writing the multisampled buffers to memory, and the resolve pass.
+    if (samples > 1 && ext.EXT_multisampled_render_to_texture && color.handle) {
+        rt->gl.autoResolve = handle_cast<GLTexture*>(color.handle)->samples <= 1;
+    }
+
     if (targets & TargetBufferFlags::COLOR) {
         // TODO: handle multiple color attachments
         if (color.handle) {
@@ -1063,7 +1215,7 @@ void OpenGLDriver::createRenderTarget(Driver::RenderTargetHandle rth,
         } else {
             GLenum internalFormat = getInternalFormat(format);
             framebufferRenderbuffer(&rt->gl.color, GL_COLOR_ATTACHMENT0, internalFormat,
-                    width, height, samples, rt->gl.fbo);
+                    width, height, samples, rt->gl.autoResolve, rt->gl.fbo);
         }
     }
 
@@ -1074,7 +1226,7 @@ void OpenGLDriver::createRenderTarget(Driver::RenderTargetHandle rth,
             // special case: depth & stencil requested, but both not provided
             specialCased = true;
             framebufferRenderbuffer(&rt->gl.depth, GL_DEPTH_STENCIL_ATTACHMENT, GL_DEPTH24_STENCIL8,
-                    width, height, samples, rt->gl.fbo);
+                    width, height, samples, rt->gl.autoResolve, rt->gl.fbo);
 
         } else if (depth.handle == stencil.handle) {
             // special case: depth & stencil requested, and both provided as the same texture
@@ -1091,7 +1243,7 @@ void OpenGLDriver::createRenderTarget(Driver::RenderTargetHandle rth,
                 framebufferTexture(depth, rt, GL_DEPTH_ATTACHMENT);
             } else {
                 framebufferRenderbuffer(&rt->gl.depth, GL_DEPTH_ATTACHMENT, GL_DEPTH_COMPONENT24,
-                        width, height, samples, rt->gl.fbo);
+                        width, height, samples, rt->gl.autoResolve, rt->gl.fbo);
             }
         }
         if (targets & TargetBufferFlags::STENCIL) {
@@ -1100,7 +1252,7 @@ void OpenGLDriver::createRenderTarget(Driver::RenderTargetHandle rth,
                 framebufferTexture(stencil, rt, GL_STENCIL_ATTACHMENT);
             } else {
                 framebufferRenderbuffer(&rt->gl.stencil, GL_STENCIL_ATTACHMENT, GL_STENCIL_INDEX8,
-                        width, height, samples, rt->gl.fbo);
+                        width, height, samples, rt->gl.autoResolve, rt->gl.fbo);
             }
         }
     }
@@ -1116,6 +1268,9 @@ void OpenGLDriver::createRenderTarget(Driver::RenderTargetHandle rth,
 void OpenGLDriver::createFence(Driver::FenceHandle fh, int) {
     DEBUG_MARKER()
 
+    // a fence can be used to wait for the read-backs issued before it
+    processReadbacks(true);
+
     HwFence* f = construct<HwFence>(fh);
     f->fence = mContextManager.createFence();
 }
@@ -1127,6 +1282,14 @@ void OpenGLDriver::createSwapChain(Driver::SwapChainHandle sch, void* nativeWind
     sc->swapChain = mContextManager.createSwapChain(nativeWindow, flags);
 }
 
+void OpenGLDriver::createSwapChainHeadless(Driver::SwapChainHandle sch,
+        uint32_t width, uint32_t height, uint64_t flags) {
+    DEBUG_MARKER()
+
+    HwSwapChain* sc = construct<HwSwapChain>(sch);
+    sc->swapChain = mContextManager.createSwapChain(width, height, flags);
+}
+
 void OpenGLDriver::createStreamFromTextureId(Driver::StreamHandle sh,
         intptr_t externalTextureId, uint32_t width, uint32_t height) {
     DEBUG_MARKER()
@@ -1144,6 +1307,13 @@ void OpenGLDriver::createStreamFromTextureId(Driver::StreamHandle sh,
     }
 }
 
+void OpenGLDriver::createStreamAcquired(Driver::StreamHandle sh, int) {
+    DEBUG_MARKER()
+
+    GLStream* s = construct<GLStream>(sh);
+    s->streamType = StreamType::ACQUIRED;
+}
+
 // ------------------------------------------------------------------------------------------------
 // Destroying driver objects
 // ------------------------------------------------------------------------------------------------
@@ -1155,6 +1325,9 @@ void OpenGLDriver::destroyVertexBuffer(Driver::VertexBufferHandle vbh) {
         GLVertexBuffer const* eb = handle_cast<const GLVertexBuffer*>(vbh);
         GLsizei n = GLsizei(eb->bufferCount);
         glDeleteBuffers(n, eb->gl.buffers.data());
+        if (eb->dynamic) {
+            mDynamicBufferCount--;
+        }
         // bindings of bound buffers are reset to 0
         const size_t targetIndex = getIndexForBufferTarget(GL_ARRAY_BUFFER);
         auto& target = state.buffers.targets[targetIndex];
@@ -1163,6 +1336,7 @@ void OpenGLDriver::destroyVertexBuffer(Driver::VertexBufferHandle vbh) {
                 target.genericBinding = 0;
             }
         }
+        forgetVertexArrays(vbh.getId(), HandleBase::nullid);
         destruct(vbh, eb);
     }
 }
@@ -1173,12 +1347,16 @@ void OpenGLDriver::destroyIndexBuffer(Driver::IndexBufferHandle ibh) {
     if (ibh) {
         GLIndexBuffer const* ib = handle_cast<const GLIndexBuffer*>(ibh);
         glDeleteBuffers(1, &ib->gl.buffer);
+        if (ib->dynamic) {
+            mDynamicBufferCount--;
+        }
         // bindings of bound buffers are reset to 0
         const size_t targetIndex = getIndexForBufferTarget(GL_ELEMENT_ARRAY_BUFFER);
         auto& target = state.buffers.targets[targetIndex];
         if (target.genericBinding == ib->gl.buffer) {
             target.genericBinding = 0;
         }
+        forgetVertexArrays(HandleBase::nullid, ibh.getId());
         destruct(ibh, ib);
     }
 }
@@ -1188,10 +1366,8 @@ void OpenGLDriver::destroyRenderPrimitive(Driver::RenderPrimitiveHandle rph) {
 
     if (rph) {
         GLRenderPrimitive const* rp = handle_cast<const GLRenderPrimitive*>(rph);
-        glDeleteVertexArrays(1, &rp->gl.vao);
-        // binding of a bound VAO is reset to 0
-        if (state.vao.p == rp) {
-            state.vao.p = &mDefaultVAO;
+        if (rp->gl.vertexArray) {
+            releaseVertexArray(rp->gl.vertexArray);
         }
         destruct(rph, rp);
     }
@@ -1241,6 +1417,9 @@ void OpenGLDriver::destroyTexture(Driver::TextureHandle th) {
 
     if (th) {
         GLTexture* t = handle_cast<GLTexture*>(th);
+        if (UTILS_UNLIKELY(!mPendingTextureUploads.empty())) {
+            cancelTextureUploads(t);
+        }
         unbindTexture(t->gl.target, t->gl.texture_id);
         if (UTILS_UNLIKELY(t->hwStream)) {
             detachStream(t);
@@ -1307,6 +1486,8 @@ void OpenGLDriver::destroyStream(Driver::StreamHandle sh) {
         }
         if (s->isNativeStream()) {
             mContextManager.destroyStream(s->stream);
+        } else if (s->isAcquired()) {
+            releaseAcquiredImage(s);
         } else {
             glDeleteTextures(GLStream::ROUND_ROBIN_TEXTURE_COUNT, s->user_thread.read);
             glDeleteTextures(GLStream::ROUND_ROBIN_TEXTURE_COUNT, s->user_thread.write);
@@ -1338,7 +1519,7 @@ void OpenGLDriver::updateStreams(driver::DriverApi* driver) {
         OpenGLBlitter::State state;
         for (GLTexture* t : mExternalStreams) {
             assert(t && t->hwStream);
-            if (!static_cast<GLStream*>(t->hwStream)->isNativeStream()) {
+            if (t->hwStream->streamType == StreamType::TEXTURE_ID) {
                 state.setup();
                 updateStream(t, driver);
             }
@@ -1439,9 +1620,62 @@ bool OpenGLDriver::isRenderTargetFormatSupported(Driver::TextureFormat format) {
     }
 }
 
+bool OpenGLDriver::isTextureFormatMipmappable(Driver::TextureFormat format) {
+    // glGenerateMipmap() needs a format both color-renderable and filterable, which excludes the
+    // integer, depth and compressed formats, and the 32-bit float ones (filterable only with
+    // OES_texture_float_linear).
+    switch (format) {
+        case TextureFormat::R8:
+        case TextureFormat::RG8:
+        case TextureFormat::RGB565:
+        case TextureFormat::RGB5_A1:
+        case TextureFormat::RGBA4:
+        case TextureFormat::RGB8:
+        case TextureFormat::RGBA8:
+        case TextureFormat::SRGB8_A8:
+        case TextureFormat::RGBM:
+        case TextureFormat::RGB10_A2:
+        case TextureFormat::R16F:
+        case TextureFormat::RG16F:
+        case TextureFormat::RGBA16F:
+        case TextureFormat::R11F_G11F_B10F:
+            return true;
+        case TextureFormat::RGB16F:
+            return ext.EXT_color_buffer_half_float;
+        default:
+            return false;
+    }
+}
+
 bool OpenGLDriver::isFrameTimeSupported() {
-    // TODO: Measuring the frame time is currently only done using fences
-    return mContextManager.canCreateFence();
+    // the frame time is measured on the GPU with the timers, or with fences
+    return ext.timer_query || mContextManager.canCreateFence();
+}
+
+bool OpenGLDriver::isSubpassInputSupported() {
+    return false;
+}
+
+uint32_t OpenGLDriver::getUniformBufferOffsetAlignment() {
+    return uint32_t(mUniformBufferOffsetAlignment);
+}
+
+bool OpenGLDriver::isDrawIndirectSupported() {
+    // the vertex shaders need gl_BaseInstanceARB to tell the draws apart
+    return ext.ARB_multi_draw_indirect && ext.ARB_shader_draw_parameters;
+}
+
+bool OpenGLDriver::isComputeSupported() {
+#if defined(GL_ES_VERSION_3_1) || defined(GL_VERSION_4_3)
+    return ext.compute_shader;
+#else
+    return false;
+#endif
+}
+
+bool OpenGLDriver::isAutoResolveSupported() {
+    // see createRenderTarget()
+    return ext.EXT_multisampled_render_to_texture;
 }
 
 // ------------------------------------------------------------------------------------------------
@@ -1458,6 +1692,20 @@ void OpenGLDriver::commit(Driver::SwapChainHandle sch) {
     }
 }
 
+void OpenGLDriver::setPresentationTime(int64_t monotonic_clock_ns) {
+    DEBUG_MARKER()
+
+    mContextManager.setPresentationTime(monotonic_clock_ns);
+}
+
+void OpenGLDriver::setDamageRegions(Driver::DamageRegion const* regions, uint32_t count) {
+    DEBUG_MARKER()
+
+    static_assert(sizeof(Driver::DamageRegion) == 4 * sizeof(int32_t),
+            "DamageRegion must be laid out as 4 int32_t");
+    mContextManager.setDamageRegions(reinterpret_cast<int32_t const*>(regions), count);
+}
+
 void OpenGLDriver::makeCurrent(Driver::SwapChainHandle sch) {
     DEBUG_MARKER()
 
@@ -1482,8 +1730,16 @@ void OpenGLDriver::loadVertexBuffer(
 
     GLVertexBuffer* eb = handle_cast<GLVertexBuffer *>(vbh);
 
-    bindBuffer(GL_ARRAY_BUFFER, eb->gl.buffers[index]);
-    glBufferSubData(GL_ARRAY_BUFFER, byteOffset, byteSize, p.buffer);
+    if (UTILS_UNLIKELY(eb->dynamic)) {
+        if (updateDynamicBuffer(GL_ARRAY_BUFFER, eb->gl.buffers[index], eb->dynamic[index],
+                p.buffer, byteOffset, byteSize)) {
+            // the render primitives using this buffer need to update their attribute pointers
+            eb->generation++;
+        }
+    } else {
+        bindBuffer(GL_ARRAY_BUFFER, eb->gl.buffers[index]);
+        glBufferSubData(GL_ARRAY_BUFFER, byteOffset, byteSize, p.buffer);
+    }
 
     scheduleDestroy(std::move(p));
 
@@ -1500,20 +1756,78 @@ void OpenGLDriver::loadIndexBuffer(
     assert(ib->elementSize == 2 || ib->elementSize == 4);
 
     bindVertexArray(nullptr);
-    bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ib->gl.buffer);
-    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, byteOffset, byteSize, p.buffer);
+    if (UTILS_UNLIKELY(ib->dynamic)) {
+        // the render primitives pick up the new region when drawing
+        updateDynamicBuffer(GL_ELEMENT_ARRAY_BUFFER, ib->gl.buffer, *ib->dynamic,
+                p.buffer, byteOffset, byteSize);
+    } else {
+        bindBuffer(GL_ELEMENT_ARRAY_BUFFER, ib->gl.buffer);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, byteOffset, byteSize, p.buffer);
+    }
 
     scheduleDestroy(std::move(p));
 
     CHECK_GL_ERROR(utils::slog.e)
 }
 
+bool OpenGLDriver::updateDynamicBuffer(GLenum target, GLuint buffer, GLDynamicBuffer& db,
+        void const* data, uint32_t byteOffset, uint32_t byteSize) noexcept {
+    assert(byteOffset + byteSize <= db.size);
+    memcpy(db.shadow.get() + byteOffset, data, byteSize);
+    bindBuffer(target, buffer);
+
+    if (db.frame == mFrameCount) {
+        // The GPU could be using the current region for the draws issued since the last update,
+        // so let the driver synchronize. This is only for buffers updated more than once a frame.
+        glBufferSubData(target, db.getOffset() + byteOffset, byteSize, data);
+        return false;
+    }
+
+    // The next region stopped being used when the buffer switched region two updates ago, so
+    // the GPU is done with it once it completes the frame DYNAMIC_BUFFER_REGION_COUNT - 1 frames
+    // ago. Its fence is almost always signaled already.
+    GLsync& fence = mDynamicBufferFences[
+            (mFrameCount + 1) % DYNAMIC_BUFFER_REGION_COUNT];
+    if (fence) {
+        SYSTRACE_NAME("glClientWaitSync");
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, std::numeric_limits<GLuint64>::max());
+        glDeleteSync(fence);
+        fence = 0;
+    }
+
+    db.frame = mFrameCount;
+    db.region = uint8_t((db.region + 1) % DYNAMIC_BUFFER_REGION_COUNT);
+
+    // the new region gets the whole content, not only what was updated
+    void* const p = glMapBufferRange(target, db.getOffset(), db.size,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (UTILS_LIKELY(p)) {
+        memcpy(p, db.shadow.get(), db.size);
+        glUnmapBuffer(target);
+    } else {
+        glBufferSubData(target, db.getOffset(), db.size, db.shadow.get());
+    }
+    return true;
+}
+
 void OpenGLDriver::updateSamplerBuffer(Driver::SamplerBufferHandle sbh,
         SamplerBuffer&& samplerBuffer) {
     DEBUG_MARKER()
 
     GLSamplerBuffer* sb = handle_cast<GLSamplerBuffer *>(sbh);
     *sb->sb = std::move(samplerBuffer);
+
+    // the textures and sampler objects are looked up once here, rather than at each draw
+    SamplerBuffer const& buffer = *sb->sb;
+    sb->gl.bindings.resize(buffer.getSize());
+    for (size_t i = 0, c = buffer.getSize(); i < c; i++) {
+        SamplerBuffer::Sampler const& sampler = buffer.getBuffer()[i];
+        Driver::TextureHandle th = sampler.t;
+        GLSamplerBuffer::Binding& binding = sb->gl.bindings[i];
+        binding.t = th ? handle_cast<const GLTexture*>(th) : nullptr;
+        binding.sampler = th ? getSampler(sampler.s) : 0;
+    }
+    sb->gl.generation = ++mSamplerBufferGeneration;
 }
 
 void OpenGLDriver::beginRenderPass(Driver::RenderTargetHandle rth,
@@ -1665,6 +1979,10 @@ void OpenGLDriver::endRenderPass(int) {
     mRenderPassTarget.clear();
 }
 
+void OpenGLDriver::nextSubpass(int) {
+    // render passes never have a second subpass, see isSubpassInputSupported()
+}
+
 void OpenGLDriver::discardSubRenderTargetBuffers(Driver::RenderTargetHandle rth,
         Driver::TargetBufferFlags buffers,
         uint32_t left, uint32_t bottom, uint32_t width, uint32_t height) {
@@ -1723,7 +2041,8 @@ void OpenGLDriver::resizeRenderTarget(Driver::RenderTargetHandle rth,
 
     if (rt->gl.color.id) {
         // if we have a depth renderbuffer, reallocate it
-        renderBufferStorage(rt->gl.color.id, rt->gl.color.internalFormat, width, height, rt->gl.samples);
+        renderBufferStorage(rt->gl.color.id, rt->gl.color.internalFormat, width, height,
+                rt->gl.samples, rt->gl.autoResolve);
     } else if (rt->gl.color.texture) {
         // if it was a texture, reallocate the texture and discard content
         textureStorage(rt->gl.color.texture, width, height, rt->gl.color.texture->depth);
@@ -1731,7 +2050,8 @@ void OpenGLDriver::resizeRenderTarget(Driver::RenderTargetHandle rth,
 
     if (rt->gl.depth.id) {
         // if we have a depth renderbuffer, reallocate it
-        renderBufferStorage(rt->gl.depth.id, rt->gl.depth.internalFormat, width, height, rt->gl.samples);
+        renderBufferStorage(rt->gl.depth.id, rt->gl.depth.internalFormat, width, height,
+                rt->gl.samples, rt->gl.autoResolve);
     } else if (rt->gl.depth.texture) {
         // if it was a texture, reallocate the texture and discard content
         textureStorage(rt->gl.depth.texture, width, height, rt->gl.depth.texture->depth);
@@ -1739,7 +2059,8 @@ void OpenGLDriver::resizeRenderTarget(Driver::RenderTargetHandle rth,
 
     if (rt->gl.stencil.id) {
         // if we have a stencil renderbuffer, reallocate it
-        renderBufferStorage(rt->gl.stencil.id, rt->gl.stencil.internalFormat, width, height, rt->gl.samples);
+        renderBufferStorage(rt->gl.stencil.id, rt->gl.stencil.internalFormat, width, height,
+                rt->gl.samples, rt->gl.autoResolve);
     } else if (rt->gl.stencil.texture) {
         // if it was a texture, reallocate the texture and discard content
         textureStorage(rt->gl.stencil.texture, width, height, rt->gl.stencil.texture->depth);
@@ -1763,23 +2084,40 @@ void OpenGLDriver::setRenderPrimitiveBuffer(Driver::RenderPrimitiveHandle rph,
 
         assert(ib->elementSize == 2 || ib->elementSize == 4);
 
-        bindVertexArray(rp);
-        CHECK_GL_ERROR(utils::slog.e)
-
         rp->gl.indicesType = ib->elementSize == 4 ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
         rp->maxVertexCount = eb->vertexCount;
+
+        // dynamic buffers move between regions, see updateDynamicRenderPrimitive()
+        rp->gl.dynamic = eb->dynamic || ib->dynamic;
+        rp->gl.vertexBuffer = eb->dynamic ? vbh : Driver::VertexBufferHandle{};
+        rp->gl.indexBuffer = ib->dynamic ? ibh : Driver::IndexBufferHandle{};
+
+        // the primitives drawing from the same buffers share their VAO, which is set-up once
+        const VertexArrayKey key{ vbh.getId(), ibh.getId(), enabledAttributes };
+        GLVertexArray* const previous = rp->gl.vertexArray;
+        GLVertexArray*& va = mVertexArrays[key];
+        const bool created = va == nullptr;
+        if (created) {
+            va = new GLVertexArray;
+            va->key = key;
+            glGenVertexArrays(1, &va->vao);
+        }
+        va->refs++;
+        rp->gl.vertexArray = va;
+        if (previous) {
+            releaseVertexArray(previous);
+        }
+        if (!created) {
+            return;
+        }
+
+        bindVertexArray(rp->gl.vertexArray);
+        CHECK_GL_ERROR(utils::slog.e)
+
+        rp->gl.vertexArray->vertexBufferGeneration = eb->generation;
         for (size_t i = 0, n = eb->attributes.size(); i < n; i++) {
             if (enabledAttributes & (1U << i)) {
-                uint8_t bi = eb->attributes[i].buffer;
-                assert(bi != 0xFF);
-                bindBuffer(GL_ARRAY_BUFFER, eb->gl.buffers[bi]);
-                glVertexAttribPointer(GLuint(i),
-                        getComponentCount(eb->attributes[i].type),
-                        getComponentType(eb->attributes[i].type),
-                        getNormalization(eb->attributes[i].normalized),
-                        eb->attributes[i].stride,
-                        (void*)uintptr_t(eb->attributes[i].offset));
-
+                setVertexAttribPointer(eb, i);
                 enableVertexAttribArray(GLuint(i));
             } else {
                 disableVertexAttribArray(GLuint(i));
@@ -1792,6 +2130,73 @@ void OpenGLDriver::setRenderPrimitiveBuffer(Driver::RenderPrimitiveHandle rph,
     }
 }
 
+void OpenGLDriver::setVertexAttribPointer(GLVertexBuffer const* eb, size_t index) noexcept {
+    Driver::Attribute const& attribute = eb->attributes[index];
+    const uint8_t bi = attribute.buffer;
+    assert(bi != 0xFF);
+    uint32_t offset = attribute.offset;
+    if (UTILS_UNLIKELY(eb->dynamic)) {
+        offset += eb->dynamic[bi].getOffset();
+    }
+    bindBuffer(GL_ARRAY_BUFFER, eb->gl.buffers[bi]);
+    glVertexAttribPointer(GLuint(index),
+            getComponentCount(attribute.type),
+            getComponentType(attribute.type),
+            getNormalization(attribute.normalized),
+            attribute.stride,
+            (void*)uintptr_t(offset));
+}
+
+uint32_t OpenGLDriver::updateDynamicRenderPrimitive(GLRenderPrimitive* rp) noexcept {
+    // the render primitive's VAO must be bound
+    GLVertexArray* const va = rp->gl.vertexArray;
+    assert(state.vao.p == va);
+    if (rp->gl.vertexBuffer) {
+        GLVertexBuffer const* const eb = handle_cast<const GLVertexBuffer*>(rp->gl.vertexBuffer);
+        if (va->vertexBufferGeneration != eb->generation) {
+            va->vertexBufferGeneration = eb->generation;
+            va->vertexAttribArray.forEachSetBit([this, eb](size_t i) {
+                setVertexAttribPointer(eb, i);
+            });
+        }
+    }
+    if (rp->gl.indexBuffer) {
+        GLIndexBuffer const* const ib = handle_cast<const GLIndexBuffer*>(rp->gl.indexBuffer);
+        return ib->dynamic->getOffset();
+    }
+    return 0;
+}
+
+void OpenGLDriver::releaseVertexArray(GLVertexArray* va) noexcept {
+    assert(va->refs > 0);
+    if (--va->refs == 0) {
+        auto pos = mVertexArrays.find(va->key);
+        if (pos != mVertexArrays.end() && pos->second == va) {
+            mVertexArrays.erase(pos);
+        }
+        glDeleteVertexArrays(1, &va->vao);
+        // binding of a bound VAO is reset to 0
+        if (state.vao.p == va) {
+            state.vao.p = &mDefaultVAO;
+        }
+        delete va;
+    }
+}
+
+void OpenGLDriver::forgetVertexArrays(HandleBase::HandleId vertexBuffer,
+        HandleBase::HandleId indexBuffer) noexcept {
+    // the handle of a destroyed buffer can be reused, the VAOs using it can't be shared anymore,
+    // they're destroyed with the last primitive using them
+    for (auto it = mVertexArrays.begin(); it != mVertexArrays.end(); ) {
+        VertexArrayKey const& key = it->first;
+        if (key.vertexBuffer == vertexBuffer || key.indexBuffer == indexBuffer) {
+            it = mVertexArrays.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
 void OpenGLDriver::setRenderPrimitiveRange(Driver::RenderPrimitiveHandle rph,
         Driver::PrimitiveType pt, uint32_t offset,
         uint32_t minIndex, uint32_t maxIndex, uint32_t count) {
@@ -1844,15 +2249,29 @@ void OpenGLDriver::updateUniformBuffer(Driver::UniformBufferHandle ubh,
     assert(ub);
 
     if (UTILS_UNLIKELY(uniformBuffer.isDirty())) {
-        // TODO: upload only the dirty parts
+        // only upload the range that changed since the previous update
         assert(ub->gl.ubo);
+        const size_t offset = uniformBuffer.getDirtyOffset();
         bindBuffer(GL_UNIFORM_BUFFER, ub->gl.ubo);
-        glBufferSubData(GL_UNIFORM_BUFFER, 0, uniformBuffer.getSize(), uniformBuffer.getBuffer());
+        glBufferSubData(GL_UNIFORM_BUFFER, offset, uniformBuffer.getDirtySize(),
+                static_cast<char const*>(uniformBuffer.getBuffer()) + offset);
         CHECK_GL_ERROR(utils::slog.e)
     }
     ub->ub = std::move(uniformBuffer);
 }
 
+void OpenGLDriver::loadUniformBuffer(Driver::UniformBufferHandle ubh,
+        void const* data, uint32_t offset, uint32_t size) {
+    DEBUG_MARKER()
+
+    GLUniformBuffer* ub = handle_cast<GLUniformBuffer *>(ubh);
+    assert(ub && ub->gl.ubo);
+
+    bindBuffer(GL_UNIFORM_BUFFER, ub->gl.ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+    CHECK_GL_ERROR(utils::slog.e)
+}
+
 void OpenGLDriver::load2DImage(Driver::TextureHandle th,
         uint32_t level, uint32_t xoffset, uint32_t yoffset, uint32_t width, uint32_t height,
         PixelBufferDescriptor&& data) {
@@ -1868,6 +2287,76 @@ void OpenGLDriver::load2DImage(Driver::TextureHandle th,
     }
 }
 
+void OpenGLDriver::load3DImage(Driver::TextureHandle th, uint32_t level,
+        uint32_t xoffset, uint32_t yoffset, uint32_t zoffset,
+        uint32_t width, uint32_t height, uint32_t depth,
+        PixelBufferDescriptor&& data) {
+    DEBUG_MARKER()
+
+    GLTexture* t = handle_cast<GLTexture *>(th);
+    if (data.type == driver::PixelDataType::COMPRESSED) {
+        setCompressedTextureData(t,
+                level, xoffset, yoffset, zoffset, width, height, depth, std::move(data), nullptr);
+    } else {
+        setTextureData(t,
+                level, xoffset, yoffset, zoffset, width, height, depth, std::move(data), nullptr);
+    }
+}
+
+void OpenGLDriver::load2DImageRegions(Driver::TextureHandle th, uint32_t level,
+        Driver::TextureRegion const* regions, uint32_t count, PixelBufferDescriptor&& data) {
+    DEBUG_MARKER()
+
+    GLTexture* t = handle_cast<GLTexture *>(th);
+    assert(data.type != driver::PixelDataType::COMPRESSED);
+    assert(t->samples <= 1);
+
+    if (UTILS_UNLIKELY(t->gl.target == GL_TEXTURE_EXTERNAL_OES || !count)) {
+        // this is in fact an external texture, this becomes a no-op.
+        scheduleDestroy(std::move(data));
+        return;
+    }
+
+    if (UTILS_UNLIKELY(!mPendingTextureUploads.empty())) {
+        // the regions go over what was uploaded before
+        flushTextureUploads(t);
+    }
+
+    // The whole buffer is staged at once and each region is a glTexSubImage2D() from it. These
+    // updates are usually small and needed this frame, they're not split by the upload budget.
+    assert(t->gl.target == GL_TEXTURE_2D);
+    bindTexture(MAX_TEXTURE_UNITS - 1, t->gl.target, t);
+    activeTexture(MAX_TEXTURE_UNITS - 1);
+
+    const GLenum glFormat = getFormat(data.format);
+    const GLenum glType = getType(data.type);
+    pixelStore(GL_UNPACK_ALIGNMENT, data.alignment);
+    pixelStore(GL_UNPACK_SKIP_PIXELS, 0);
+    pixelStore(GL_UNPACK_SKIP_ROWS, 0);
+
+    OpenGLStage* stage = mStagePool.acquireStage(uint32_t(data.size));
+    glBufferSubData(GL_PIXEL_UNPACK_BUFFER, 0, GLsizeiptr(data.size), data.buffer);
+    for (uint32_t i = 0; i < count; i++) {
+        Driver::TextureRegion const& region = regions[i];
+        assert(region.xoffset + region.width <= t->width >> level);
+        assert(region.yoffset + region.height <= t->height >> level);
+        pixelStore(GL_UNPACK_ROW_LENGTH, GLint(region.stride));
+        glTexSubImage2D(GL_TEXTURE_2D, GLint(level),
+                GLint(region.xoffset), GLint(region.yoffset), region.width, region.height,
+                glFormat, glType, reinterpret_cast<void const*>(uintptr_t(region.offset)));
+    }
+    mStagePool.releaseStage(stage);
+
+    // other uploads and glReadPixels() use client memory
+    bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    mTextureUploadBytes += data.size;
+
+    updateUploadedLevels(t, level);
+    scheduleDestroy(std::move(data));
+
+    CHECK_GL_ERROR(utils::slog.e)
+}
+
 void OpenGLDriver::loadCubeImage(Driver::TextureHandle th, uint32_t level,
         PixelBufferDescriptor&& data, FaceOffsets faceOffsets) {
     DEBUG_MARKER()
@@ -1885,6 +2374,10 @@ void OpenGLDriver::generateMipmaps(Driver::TextureHandle th) {
 
     GLTexture* t = handle_cast<GLTexture *>(th);
     assert(t->gl.target != GL_TEXTURE_2D_MULTISAMPLE);
+    if (UTILS_UNLIKELY(!mPendingTextureUploads.empty())) {
+        // mipmaps are generated from the base level, which must be complete
+        flushTextureUploads(t);
+    }
     // Note: glGenerateMimap can also fail if the internal format is not both
     // color-renderable and filterable (i.e.: doesn't work for depth)
     bindTexture(MAX_TEXTURE_UNITS - 1, t->gl.target, t, t->gl.targetIndex);
@@ -1893,9 +2386,7 @@ void OpenGLDriver::generateMipmaps(Driver::TextureHandle th) {
 
     t->gl.baseLevel = 0;
     t->gl.maxLevel = static_cast<uint8_t>(t->levels - 1);
-
-    glTexParameteri(t->gl.target, GL_TEXTURE_BASE_LEVEL, t->gl.baseLevel);
-    glTexParameteri(t->gl.target, GL_TEXTURE_MAX_LEVEL, t->gl.maxLevel);
+    updateTextureLevels(t);
 
     CHECK_GL_ERROR(utils::slog.e)
 }
@@ -1917,59 +2408,8 @@ void OpenGLDriver::setTextureData(GLTexture* t,
         return;
     }
 
-    GLenum glFormat = getFormat(p.format);
-    GLenum glType = getType(p.type);
-
-    pixelStore(GL_UNPACK_ROW_LENGTH, p.stride);
-    pixelStore(GL_UNPACK_ALIGNMENT, p.alignment);
-    pixelStore(GL_UNPACK_SKIP_PIXELS, p.left);
-    pixelStore(GL_UNPACK_SKIP_ROWS, p.top);
-
-    switch (t->target) {
-        case SamplerType::SAMPLER_EXTERNAL:
-            // if we get there, it's because the user is trying to use an external texture
-            // but it's not supported, so instead, we behave like a texture2d.
-            // fallthrough...
-        case SamplerType::SAMPLER_2D:
-            // NOTE: GL_TEXTURE_2D_MULTISAMPLE is not allowed
-            assert(t->gl.target == GL_TEXTURE_2D);
-            bindTexture(MAX_TEXTURE_UNITS - 1, GL_TEXTURE_2D, t);
-            activeTexture(MAX_TEXTURE_UNITS - 1);
-            glTexSubImage2D(GL_TEXTURE_2D,
-                    GLint(level), GLint(xoffset), GLint(yoffset),
-                    width, height, glFormat, glType, p.buffer);
-            break;
-        case SamplerType::SAMPLER_CUBEMAP: {
-            assert(t->gl.target == GL_TEXTURE_CUBE_MAP);
-            bindTexture(MAX_TEXTURE_UNITS - 1, GL_TEXTURE_CUBE_MAP, t);
-            activeTexture(MAX_TEXTURE_UNITS - 1);
-            FaceOffsets const& offsets = *faceOffsets;
-            #pragma nounroll
-            for (size_t face = 0; face < 6; face++) {
-                GLenum target = getCubemapTarget(TextureCubemapFace(face));
-                glTexSubImage2D(target, GLint(level), 0, 0,
-                        t->width >> level, t->height >> level, glFormat, glType,
-                        static_cast<uint8_t const*>(p.buffer) + offsets[face]);
-            }
-            break;
-        }
-    }
-
-    // update the base/max LOD so we don't access undefined LOD. this allows the app to
-    // specify levels as they become available.
-
-    if (uint8_t(level) < t->gl.baseLevel) {
-        t->gl.baseLevel = uint8_t(level);
-        glTexParameteri(t->gl.target, GL_TEXTURE_BASE_LEVEL, t->gl.baseLevel);
-    }
-    if (uint8_t(level) > t->gl.maxLevel) {
-        t->gl.maxLevel = uint8_t(level);
-        glTexParameteri(t->gl.target, GL_TEXTURE_MAX_LEVEL, t->gl.maxLevel);
-    }
-
-    scheduleDestroy(std::move(p));
-
-    CHECK_GL_ERROR(utils::slog.e)
+    queueTextureUpload(t, level, xoffset, yoffset, zoffset, width, height, depth,
+            std::move(p), faceOffsets);
 }
 
 void OpenGLDriver::setCompressedTextureData(GLTexture* t,
@@ -1990,57 +2430,221 @@ void OpenGLDriver::setCompressedTextureData(GLTexture* t,
     }
 
     // TODO: maybe assert that the CompressedPixelDataType is the same than the internalFormat
+    //  TODO: maybe assert the size is right (b/c we can compute it ourselves)
 
-    GLsizei imageSize = GLsizei(p.imageSize);
+    queueTextureUpload(t, level, xoffset, yoffset, zoffset, width, height, depth,
+            std::move(p), faceOffsets);
+}
 
-    //  TODO: maybe assert the size is right (b/c we can compute it ourselves)
+void OpenGLDriver::setMinMaxLevels(Driver::TextureHandle th, uint8_t minLevel, uint8_t maxLevel) {
+    DEBUG_MARKER()
 
-    switch (t->target) {
-        case SamplerType::SAMPLER_EXTERNAL:
-            // if we get there, it's because the user is trying to use an external texture
-            // but it's not supported, so instead, we behave like a texture2d.
-            // fallthrough...
-        case SamplerType::SAMPLER_2D:
-            // NOTE: GL_TEXTURE_2D_MULTISAMPLE is not allowed
-            assert(t->gl.target == GL_TEXTURE_2D);
-            bindTexture(MAX_TEXTURE_UNITS-1, GL_TEXTURE_2D, t);
-            activeTexture(MAX_TEXTURE_UNITS - 1);
-            glCompressedTexSubImage2D(GL_TEXTURE_2D,
-                    GLint(level), GLint(xoffset), GLint(yoffset),
-                    width, height, t->gl.internalFormat, imageSize, p.buffer);
+    GLTexture* t = handle_cast<GLTexture *>(th);
+    t->gl.minLevelLimit = minLevel;
+    t->gl.maxLevelLimit = maxLevel;
+    if (t->gl.baseLevel <= t->gl.maxLevel) {
+        // otherwise nothing was uploaded yet, the levels are set by the first upload
+        updateTextureLevels(t);
+    }
+
+    CHECK_GL_ERROR(utils::slog.e)
+}
+
+void OpenGLDriver::setTextureUploadBudget(uint32_t bytesPerFrame) {
+    DEBUG_MARKER()
+
+    mTextureUploadBudget = bytesPerFrame;
+}
+
+void OpenGLDriver::compileProgram(Driver::ProgramHandle ph) {
+    DEBUG_MARKER()
+
+    if (ph) {
+        OpenGLProgram* p = handle_cast<OpenGLProgram*>(ph);
+        p->waitUntilReady(this);
+    }
+}
+
+void OpenGLDriver::queueTextureUpload(GLTexture* t, uint32_t level,
+        uint32_t xoffset, uint32_t yoffset, uint32_t zoffset,
+        uint32_t width, uint32_t height, uint32_t depth,
+        PixelBufferDescriptor&& p, FaceOffsets const* faceOffsets) noexcept {
+    assert(t->gl.target != GL_TEXTURE_CUBE_MAP || faceOffsets);
+    mPendingTextureUploads.push_back({ t, level, xoffset, yoffset, zoffset, width, height, depth,
+            0, 0, faceOffsets ? *faceOffsets : FaceOffsets{}, std::move(p) });
+    processTextureUploads();
+}
+
+void OpenGLDriver::processTextureUploads() noexcept {
+    SYSTRACE_CALL();
+
+    auto& pending = mPendingTextureUploads;
+    auto pos = pending.begin();
+    for (; pos != pending.end(); ++pos) {
+        const size_t budget = !mTextureUploadBudget ? std::numeric_limits<size_t>::max() :
+                mTextureUploadBudget - std::min(mTextureUploadBytes, size_t(mTextureUploadBudget));
+        if (!budget || !uploadTexture(*pos, budget)) {
+            // the rest waits for the next frame
             break;
-        case SamplerType::SAMPLER_CUBEMAP: {
-            assert(faceOffsets);
-            assert(t->gl.target == GL_TEXTURE_CUBE_MAP);
-            bindTexture(MAX_TEXTURE_UNITS - 1, GL_TEXTURE_CUBE_MAP, t);
-            activeTexture(MAX_TEXTURE_UNITS - 1);
-            FaceOffsets const& offsets = *faceOffsets;
-            #pragma nounroll
-            for (size_t face = 0; face < 6; face++) {
-                GLenum target = getCubemapTarget(TextureCubemapFace(face));
-                glCompressedTexSubImage2D(target, GLint(level), 0, 0,
-                        t->width >> level, t->height >> level, t->gl.internalFormat,
-                        imageSize, static_cast<uint8_t const*>(p.buffer) + offsets[face]);
+        }
+        finishTextureUpload(*pos);
+    }
+    pending.erase(pending.begin(), pos);
+}
+
+void OpenGLDriver::flushTextureUploads(GLTexture const* t) noexcept {
+    // this texture's uploads can't wait anymore, they're done regardless of the budget
+    auto& pending = mPendingTextureUploads;
+    auto last = std::remove_if(pending.begin(), pending.end(), [this, t](GLTextureUpload& upload) {
+        if (upload.t != t) {
+            return false;
+        }
+        uploadTexture(upload, std::numeric_limits<size_t>::max());
+        finishTextureUpload(upload);
+        return true;
+    });
+    pending.erase(last, pending.end());
+}
+
+void OpenGLDriver::cancelTextureUploads(GLTexture const* t) noexcept {
+    auto& pending = mPendingTextureUploads;
+    auto last = std::remove_if(pending.begin(), pending.end(), [this, t](GLTextureUpload& upload) {
+        if (upload.t != t) {
+            return false;
+        }
+        scheduleDestroy(std::move(upload.p));
+        return true;
+    });
+    pending.erase(last, pending.end());
+}
+
+bool OpenGLDriver::uploadTexture(GLTextureUpload& upload, size_t budget) noexcept {
+    GLTexture* const t = upload.t;
+    PixelBufferDescriptor const& p = upload.p;
+    const bool cubemap = t->gl.target == GL_TEXTURE_CUBE_MAP;
+    const bool layered = t->gl.target == GL_TEXTURE_3D || t->gl.target == GL_TEXTURE_2D_ARRAY;
+    const bool compressed = p.type == driver::PixelDataType::COMPRESSED;
+    const uint32_t faceCount = cubemap ? 6 : layered ? upload.depth : 1;
+    const uint32_t width  = cubemap ? t->width  >> upload.level : upload.width;
+    const uint32_t height = cubemap ? t->height >> upload.level : upload.height;
+    const uint32_t xoffset = cubemap ? 0 : upload.xoffset;
+    const uint32_t yoffset = cubemap ? 0 : upload.yoffset;
+    const GLenum glFormat = getFormat(p.format);
+    const GLenum glType = getType(p.type);
+    const size_t bpr = compressed ? 0 :
+            PixelBufferDescriptor::computeDataSize(p.format, p.type,
+                    p.stride ? p.stride : width, 1, p.alignment);
+
+    // NOTE: GL_TEXTURE_2D_MULTISAMPLE is not allowed
+    // if the texture is external, it's because the user is trying to use an external texture
+    // but it's not supported, so instead, we behave like a texture2d.
+    assert(cubemap || layered || t->gl.target == GL_TEXTURE_2D);
+    bindTexture(MAX_TEXTURE_UNITS - 1, t->gl.target, t);
+    activeTexture(MAX_TEXTURE_UNITS - 1);
+
+    if (!compressed) {
+        // the rows are staged from the first one we upload, starting at 'left'
+        pixelStore(GL_UNPACK_ROW_LENGTH, p.stride);
+        pixelStore(GL_UNPACK_ALIGNMENT, p.alignment);
+        pixelStore(GL_UNPACK_SKIP_PIXELS, p.left);
+        pixelStore(GL_UNPACK_SKIP_ROWS, 0);
+    }
+
+    size_t uploaded = 0;
+    while (upload.face < faceCount && uploaded < budget) {
+        const GLenum target = cubemap ?
+                getCubemapTarget(TextureCubemapFace(upload.face)) : t->gl.target;
+        if (compressed) {
+            // compressed images are uploaded whole, the slices have the same size
+            const size_t size = layered ? p.imageSize / upload.depth : p.imageSize;
+            uint8_t const* const data = static_cast<uint8_t const*>(p.buffer) +
+                    (cubemap ? upload.faceOffsets[upload.face] : size * upload.face);
+            OpenGLStage* stage = mStagePool.acquireStage(uint32_t(size));
+            glBufferSubData(GL_PIXEL_UNPACK_BUFFER, 0, GLsizeiptr(size), data);
+            if (layered) {
+                glCompressedTexSubImage3D(target, GLint(upload.level),
+                        GLint(xoffset), GLint(yoffset), GLint(upload.zoffset + upload.face),
+                        width, height, 1, t->gl.internalFormat, GLsizei(size), nullptr);
+            } else {
+                glCompressedTexSubImage2D(target, GLint(upload.level),
+                        GLint(xoffset), GLint(yoffset),
+                        width, height, t->gl.internalFormat, GLsizei(size), nullptr);
+            }
+            mStagePool.releaseStage(stage);
+            uploaded += size;
+            upload.face++;
+        } else {
+            // upload as many rows as the budget allows, at least one
+            const uint32_t rows = uint32_t(std::min(size_t(height - upload.row),
+                    std::max(size_t(1), (budget - uploaded) / bpr)));
+            // the slices follow each other, 'top' skips rows before the first one only
+            const size_t offset = (cubemap ? upload.faceOffsets[upload.face] :
+                    bpr * height * upload.face) + bpr * (p.top + upload.row);
+            // the last row doesn't need to be padded to the stride
+            const size_t size = std::min(bpr * rows, p.size - offset);
+            OpenGLStage* stage = mStagePool.acquireStage(uint32_t(size));
+            glBufferSubData(GL_PIXEL_UNPACK_BUFFER, 0, GLsizeiptr(size),
+                    static_cast<uint8_t const*>(p.buffer) + offset);
+            if (layered) {
+                glTexSubImage3D(target, GLint(upload.level),
+                        GLint(xoffset), GLint(yoffset + upload.row),
+                        GLint(upload.zoffset + upload.face),
+                        width, rows, 1, glFormat, glType, nullptr);
+            } else {
+                glTexSubImage2D(target, GLint(upload.level),
+                        GLint(xoffset), GLint(yoffset + upload.row),
+                        width, rows, glFormat, glType, nullptr);
+            }
+            mStagePool.releaseStage(stage);
+            uploaded += size;
+            upload.row += rows;
+            if (upload.row == height) {
+                upload.row = 0;
+                upload.face++;
             }
-            break;
         }
     }
 
+    // other uploads and glReadPixels() use client memory
+    bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    mTextureUploadBytes += uploaded;
+
+    CHECK_GL_ERROR(utils::slog.e)
+
+    return upload.face == faceCount;
+}
+
+void OpenGLDriver::finishTextureUpload(GLTextureUpload& upload) noexcept {
+    updateUploadedLevels(upload.t, upload.level);
+    scheduleDestroy(std::move(upload.p));
+
+    CHECK_GL_ERROR(utils::slog.e)
+}
+
+void OpenGLDriver::updateUploadedLevels(GLTexture* t, uint32_t level) noexcept {
     // update the base/max LOD so we don't access undefined LOD. this allows the app to
     // specify levels as they become available.
 
-    if (uint8_t(level) < t->gl.baseLevel) {
-        t->gl.baseLevel = uint8_t(level);
-        glTexParameteri(t->gl.target, GL_TEXTURE_BASE_LEVEL, t->gl.baseLevel);
+    if (uint8_t(level) < t->gl.baseLevel || uint8_t(level) > t->gl.maxLevel) {
+        t->gl.baseLevel = std::min(t->gl.baseLevel, uint8_t(level));
+        t->gl.maxLevel = std::max(t->gl.maxLevel, uint8_t(level));
+        updateTextureLevels(t);
     }
-    if (uint8_t(level) > t->gl.maxLevel) {
-        t->gl.maxLevel = uint8_t(level);
-        glTexParameteri(t->gl.target, GL_TEXTURE_MAX_LEVEL, t->gl.maxLevel);
-    }
-
-    scheduleDestroy(std::move(p));
+}
 
-    CHECK_GL_ERROR(utils::slog.e)
+void OpenGLDriver::updateTextureLevels(GLTexture* t) noexcept {
+    // the levels sampled are the ones uploaded, within the limits set by setMinMaxLevels()
+    uint8_t baseLevel = std::max(t->gl.baseLevel, t->gl.minLevelLimit);
+    uint8_t maxLevel = std::min(t->gl.maxLevel, t->gl.maxLevelLimit);
+    if (baseLevel > maxLevel) {
+        // the limits exclude all the levels uploaded, ignore them
+        baseLevel = t->gl.baseLevel;
+        maxLevel = t->gl.maxLevel;
+    }
+    bindTexture(MAX_TEXTURE_UNITS - 1, t->gl.target, t);
+    activeTexture(MAX_TEXTURE_UNITS - 1);
+    glTexParameteri(t->gl.target, GL_TEXTURE_BASE_LEVEL, baseLevel);
+    glTexParameteri(t->gl.target, GL_TEXTURE_MAX_LEVEL, maxLevel);
 }
 
 void OpenGLDriver::setExternalImage(Driver::TextureHandle th, void* image) {
@@ -2048,17 +2652,20 @@ void OpenGLDriver::setExternalImage(Driver::TextureHandle th, void* image) {
         DEBUG_MARKER()
 
         GLTexture* t = handle_cast<GLTexture*>(th);
+        bindExternalImage(t, image);
+    }
+}
 
-        assert(t->target == SamplerType::SAMPLER_EXTERNAL);
-        assert(t->gl.target == GL_TEXTURE_EXTERNAL_OES);
+void OpenGLDriver::bindExternalImage(GLTexture* t, void* image) noexcept {
+    assert(t->target == SamplerType::SAMPLER_EXTERNAL);
+    assert(t->gl.target == GL_TEXTURE_EXTERNAL_OES);
 
-        bindTexture(MAX_TEXTURE_UNITS - 1, GL_TEXTURE_EXTERNAL_OES, t);
-        activeTexture(MAX_TEXTURE_UNITS - 1);
+    bindTexture(MAX_TEXTURE_UNITS - 1, GL_TEXTURE_EXTERNAL_OES, t);
+    activeTexture(MAX_TEXTURE_UNITS - 1);
 
 #ifdef GL_OES_EGL_image
-        glEGLImageTargetTexture2DOES(GL_TEXTURE_EXTERNAL_OES, static_cast<GLeglImageOES>(image));
+    glEGLImageTargetTexture2DOES(GL_TEXTURE_EXTERNAL_OES, static_cast<GLeglImageOES>(image));
 #endif
-    }
 }
 
 void OpenGLDriver::setExternalStream(Driver::TextureHandle th, Driver::StreamHandle sh) {
@@ -2084,12 +2691,80 @@ void OpenGLDriver::setExternalStream(Driver::TextureHandle th, Driver::StreamHan
     }
 }
 
+/*
+ * The images of acquired streams are bound to their textures as they're set, without copy. The
+ * image being replaced may still be sampled by the commands issued so far, so it's only given
+ * back to the application once they complete, which is checked at the end of each frame without
+ * waiting.
+ */
+void OpenGLDriver::setAcquiredImage(Driver::StreamHandle sh, int acquireFence,
+        BufferDescriptor&& image) {
+    DEBUG_MARKER()
+
+    GLStream* s = handle_cast<GLStream*>(sh);
+    assert(s->isAcquired());
+
+    ExternalContext::ExternalTexture* ets = nullptr;
+    if (ext.OES_EGL_image_external_essl3) {
+        ets = mContextManager.createExternalImage(image.buffer);
+    }
+
+    // the commands that follow wait until the image is written, the CPU doesn't
+    mContextManager.waitFenceOnGpu(acquireFence);
+
+    if (UTILS_UNLIKELY(!ets)) {
+        slog.e << "setAcquiredImage(): the image can't be imported" << io::endl;
+        scheduleDestroy(std::move(image));
+        return;
+    }
+
+    releaseAcquiredImage(s);
+    s->acquired = new GLStream::AcquiredImage{ ets, std::move(image) };
+    for (GLTexture* t : mExternalStreams) {
+        if (t->hwStream == s) {
+            bindExternalImage(t, reinterpret_cast<void*>(ets->image));
+        }
+    }
+}
+
+void OpenGLDriver::releaseAcquiredImage(GLStream* s) noexcept {
+    if (s->acquired) {
+        mReleasedImages.push_back({ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), s->acquired });
+        s->acquired = nullptr;
+    }
+}
+
+void OpenGLDriver::processReleasedImages(bool wait) noexcept {
+    // the images are released in order
+    auto& images = mReleasedImages;
+    auto pos = images.begin();
+    for (; pos != images.end(); ++pos) {
+        const GLenum status = glClientWaitSync(pos->fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                wait ? std::numeric_limits<GLuint64>::max() : 0);
+        if (status == GL_TIMEOUT_EXPIRED) {
+            break;
+        }
+        glDeleteSync(pos->fence);
+        mContextManager.destroyExternalImage(pos->acquired->image);
+        scheduleDestroy(std::move(pos->acquired->release));
+        delete pos->acquired;
+    }
+    images.erase(images.begin(), pos);
+}
+
 UTILS_NOINLINE
 void OpenGLDriver::attachStream(GLTexture* t, GLStream* hwStream) noexcept {
+    // the texture may change name
+    state.textures.version++;
     mExternalStreams.push_back(t);
 
     if (hwStream->isNativeStream()) {
         mContextManager.attach(hwStream->stream, t->gl.texture_id);
+    } else if (hwStream->isAcquired()) {
+        // the texture keeps its name, the images of the stream are bound to it
+        if (hwStream->acquired) {
+            bindExternalImage(t, reinterpret_cast<void*>(hwStream->acquired->image->image));
+        }
     } else {
         assert(t->target == SamplerType::SAMPLER_EXTERNAL);
         // The texture doesn't need a texture name anymore, get rid of it
@@ -2102,6 +2777,8 @@ void OpenGLDriver::attachStream(GLTexture* t, GLStream* hwStream) noexcept {
 
 UTILS_NOINLINE
 void OpenGLDriver::detachStream(GLTexture* t) noexcept {
+    // the texture may change name
+    state.textures.version++;
     auto& streams = mExternalStreams;
     auto pos = std::find(streams.begin(), streams.end(), t);
     if (pos != streams.end()) {
@@ -2112,6 +2789,10 @@ void OpenGLDriver::detachStream(GLTexture* t) noexcept {
     if (s->isNativeStream()) {
         mContextManager.detach(t->hwStream->stream);
         // this deletes the texture id
+    } else if (s->isAcquired()) {
+        // the texture name still refers to the stream's image
+        unbindTexture(t->gl.target, t->gl.texture_id);
+        glDeleteTextures(1, &t->gl.texture_id);
     }
     glGenTextures(1, &t->gl.texture_id);
     t->hwStream = nullptr;
@@ -2119,15 +2800,25 @@ void OpenGLDriver::detachStream(GLTexture* t) noexcept {
 
 UTILS_NOINLINE
 void OpenGLDriver::replaceStream(GLTexture* t, GLStream* hwStream) noexcept {
+    // the texture may change name
+    state.textures.version++;
     GLStream* s = static_cast<GLStream*>(t->hwStream);
     if (s->isNativeStream()) {
         mContextManager.detach(t->hwStream->stream);
         // this deletes the texture id
+    } else if (s->isAcquired()) {
+        unbindTexture(t->gl.target, t->gl.texture_id);
+        glDeleteTextures(1, &t->gl.texture_id);
     }
 
     if (hwStream->isNativeStream()) {
         glGenTextures(1, &t->gl.texture_id);
         mContextManager.attach(hwStream->stream, t->gl.texture_id);
+    } else if (hwStream->isAcquired()) {
+        glGenTextures(1, &t->gl.texture_id);
+        if (hwStream->acquired) {
+            bindExternalImage(t, reinterpret_cast<void*>(hwStream->acquired->image->image));
+        }
     } else {
         assert(t->target == SamplerType::SAMPLER_EXTERNAL);
         t->gl.texture_id = hwStream->user_thread.read[hwStream->user_thread.cur];
@@ -2149,7 +2840,7 @@ void OpenGLDriver::updateStream(GLTexture* t, driver::DriverApi* driver) noexcep
         return;
     }
 
-    if (UTILS_LIKELY(!s->isNativeStream())) {
+    if (UTILS_LIKELY(s->streamType == StreamType::TEXTURE_ID)) {
         // round-robin to the next texture name
         if (UTILS_UNLIKELY(DEBUG_NO_EXTERNAL_STREAM_COPY ||
                            bugs.disable_shared_context_draws || !mOpenGLBlitter)) {
@@ -2242,7 +2933,7 @@ void OpenGLDriver::readStreamPixels(Driver::StreamHandle sh,
     DEBUG_MARKER()
 
     GLStream* s = handle_cast<GLStream*>(sh);
-    if (UTILS_LIKELY(!s->isNativeStream())) {
+    if (UTILS_LIKELY(s->streamType == StreamType::TEXTURE_ID)) {
         GLuint tid = s->gl.externalTexture2DId;
         if (tid == 0) {
             return;
@@ -2334,6 +3025,20 @@ void OpenGLDriver::bindUniforms(size_t index, Driver::UniformBufferHandle ubh) {
     CHECK_GL_ERROR(utils::slog.e)
 }
 
+void OpenGLDriver::bindUniformsRange(size_t index, Driver::UniformBufferHandle ubh,
+        uint32_t offset, uint32_t size) {
+    DEBUG_MARKER()
+
+    GLUniformBuffer* ub = handle_cast<GLUniformBuffer *>(ubh);
+    assert(offset % mUniformBufferOffsetAlignment == 0);
+    bindBufferRange(GL_UNIFORM_BUFFER, GLuint(index), ub->gl.ubo, offset, size);
+    CHECK_GL_ERROR(utils::slog.e)
+}
+
+void OpenGLDriver::bindStorage(size_t index, Driver::UniformBufferHandle ubh) {
+    // the materials of this backend read the data of the storage buffers from textures
+}
+
 void OpenGLDriver::bindSamplers(size_t index, Driver::SamplerBufferHandle sbh) {
     DEBUG_MARKER()
 
@@ -2403,11 +3108,6 @@ void OpenGLDriver::readPixels(Driver::RenderTargetHandle src,
     GLenum glFormat = getFormat(p.format);
     GLenum glType = getType(p.type);
 
-    pixelStore(GL_PACK_ROW_LENGTH, p.stride);
-    pixelStore(GL_PACK_ALIGNMENT, p.alignment);
-    pixelStore(GL_PACK_SKIP_PIXELS, p.left);
-    pixelStore(GL_PACK_SKIP_ROWS, p.top);
-
     /*
      * glReadPixel() operation...
      *
@@ -2431,27 +3131,151 @@ void OpenGLDriver::readPixels(Driver::RenderTargetHandle src,
      *                                  Image is "flipped" vertically
      *                                  "bottom" is from the "top" (low addresses)
      *                                  of the buffer.
+     *
+     * The pixels are first read, tightly packed, into a pixel pack buffer so that glReadPixels()
+     * doesn't stall. They're copied to the user buffer, and flipped to match our API, by
+     * completeReadback() once the GPU is done.
      */
 
+    pixelStore(GL_PACK_ROW_LENGTH, 0);
+    pixelStore(GL_PACK_ALIGNMENT, p.alignment);
+    pixelStore(GL_PACK_SKIP_PIXELS, 0);
+    pixelStore(GL_PACK_SKIP_ROWS, 0);
+
     GLRenderTarget const* s = handle_cast<GLRenderTarget const*>(src);
     bindFramebuffer(GL_READ_FRAMEBUFFER, s->gl.fbo);
 
-    // TODO: we could use a PBO to make this asynchronous
-    glReadPixels(GLint(x), GLint(y), GLint(width), GLint(height), glFormat, glType, p.buffer);
+    const size_t size = PixelBufferDescriptor::computeDataSize(
+            p.format, p.type, width, height, p.alignment);
+
+    GLuint pbo;
+    glGenBuffers(1, &pbo);
+    bindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+    glBufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(size), nullptr, GL_STREAM_READ);
+    glReadPixels(GLint(x), GLint(y), GLint(width), GLint(height), glFormat, glType, nullptr);
+    bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
 
-    // now we need to flip the buffer vertically to match our API
-    size_t stride = p.stride ? p.stride : width;
-    size_t bpp = PixelBufferDescriptor::computeDataSize(p.format, p.type, 1, 1, 1);
-    size_t bpr = PixelBufferDescriptor::computeDataSize(p.format, p.type, stride, 1, p.alignment);
-    char* head = (char*)p.buffer + p.left * bpp + bpr * p.top;
-    char* tail = (char*)p.buffer + p.left * bpp + bpr * (p.top + height - 1);
-    // clang vectorizes this loop
-    while (head < tail) {
-        std::swap_ranges(head, head + bpp * width, tail);
-        head += bpr;
-        tail -= bpr;
+    GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    mPendingReadbacks.push_back({ pbo, fence, width, height, mFrameCount, std::move(p) });
+
+    CHECK_GL_ERROR(utils::slog.e)
+}
+
+void OpenGLDriver::processReadbacks(bool wait) noexcept {
+    // the read-backs complete in order
+    auto& pending = mPendingReadbacks;
+    auto pos = pending.begin();
+    for (; pos != pending.end(); ++pos) {
+        // don't let a read-back wait for more than a couple frames
+        const bool late = wait || mFrameCount - pos->frame >= MAX_READBACK_LATENCY;
+        const GLenum status = glClientWaitSync(pos->fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                late ? std::numeric_limits<GLuint64>::max() : 0);
+        if (status == GL_TIMEOUT_EXPIRED) {
+            break;
+        }
+        completeReadback(*pos);
+    }
+    pending.erase(pending.begin(), pos);
+}
+
+void OpenGLDriver::beginTimer(uint8_t timer) {
+    assert(!mTimerActive);
+    assert(timer < TIMER_COUNT);
+    if (!ext.timer_query || mPendingTimerQueries.size() >= MAX_PENDING_TIMER_QUERIES) {
+        return;
+    }
+    GLuint query;
+    if (mFreeTimerQueries.empty()) {
+        glGenQueries(1, &query);
+    } else {
+        query = mFreeTimerQueries.back();
+        mFreeTimerQueries.pop_back();
+    }
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    mPendingTimerQueries.push_back({ query, mFrameCount, timer });
+    mTimerActive = true;
+}
+
+void OpenGLDriver::endTimer(int) {
+    if (mTimerActive) {
+        glEndQuery(GL_TIME_ELAPSED);
+        mTimerActive = false;
+    }
+}
+
+void OpenGLDriver::processTimerQueries() noexcept {
+    auto& pending = mPendingTimerQueries;
+
+    if (ext.EXT_disjoint_timer_query) {
+        // the results in flight are meaningless, e.g. the GPU changed its frequency
+        GLint disjoint = 0;
+        glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+        if (disjoint) {
+            for (GLTimerQuery const& query : pending) {
+                mFreeTimerQueries.push_back(query.query);
+            }
+            pending.clear();
+            return;
+        }
     }
 
+    // The queries complete in order, so a frame is done when its last query is. This is called
+    // at the end of a frame, all the frames in the list have issued all their queries.
+    auto first = pending.begin();
+    while (first != pending.end()) {
+        const uint32_t frame = first->frame;
+        auto last = std::find_if(first, pending.end(),
+                [frame](GLTimerQuery const& query) { return query.frame != frame; });
+        GLuint available = 0;
+        glGetQueryObjectuiv((last - 1)->query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            break;
+        }
+        float times[TIMER_COUNT] = {};
+        for (auto it = first; it != last; ++it) {
+            // 32 bits of nanoseconds are enough for any pass
+            GLuint elapsed = 0;
+            glGetQueryObjectuiv(it->query, GL_QUERY_RESULT, &elapsed);
+            times[it->timer] += float(elapsed) * 1e-6f;
+            mFreeTimerQueries.push_back(it->query);
+        }
+        std::copy_n(times, TIMER_COUNT, mGpuTimeMilli);
+        mGpuTimeFrame = frame;
+        mHasGpuTime = true;
+        first = last;
+    }
+    pending.erase(pending.begin(), first);
+}
+
+void OpenGLDriver::completeReadback(GLReadback& readback) noexcept {
+    SYSTRACE_CALL();
+
+    PixelBufferDescriptor& p = readback.p;
+    const uint32_t width = readback.width;
+    const uint32_t height = readback.height;
+    const size_t stride = p.stride ? p.stride : width;
+    const size_t bpp = PixelBufferDescriptor::computeDataSize(p.format, p.type, 1, 1, 1);
+    const size_t bpr = PixelBufferDescriptor::computeDataSize(p.format, p.type, stride, 1, p.alignment);
+    const size_t srcBpr = PixelBufferDescriptor::computeDataSize(p.format, p.type, width, 1, p.alignment);
+    const size_t size = srcBpr * height;
+
+    bindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+    void const* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(size), GL_MAP_READ_BIT);
+    if (pixels) {
+        // flip the buffer vertically to match our API
+        char const* src = static_cast<char const*>(pixels);
+        char* dst = (char*)p.buffer + p.left * bpp + bpr * (p.top + height - 1);
+        for (uint32_t i = 0; i < height; i++) {
+            memcpy(dst, src, bpp * width);
+            src += srcBpr;
+            dst -= bpr;
+        }
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glDeleteBuffers(1, &readback.pbo);
+    glDeleteSync(readback.fence);
+
     scheduleDestroy(std::move(p));
 
     CHECK_GL_ERROR(utils::slog.e)
@@ -2463,6 +3287,11 @@ void OpenGLDriver::readPixels(Driver::RenderTargetHandle src,
 
 void OpenGLDriver::beginFrame(uint64_t monotonic_clock_ns, uint32_t frameId) {
     insertEventMarker("beginFrame");
+    state.stats = {};
+    mTextureUploadBytes = 0;
+    if (UTILS_UNLIKELY(!mPendingTextureUploads.empty())) {
+        processTextureUploads();
+    }
     if (UTILS_UNLIKELY(!mExternalStreams.empty())) {
         driver::ContextManagerGL& contextManager = mContextManager;
         const size_t index = getIndexForTextureTarget(GL_TEXTURE_EXTERNAL_OES);
@@ -2483,6 +3312,47 @@ void OpenGLDriver::endFrame(uint32_t frameId) {
     //SYSTRACE_NAME("glFinish");
     //glFinish();
     insertEventMarker("endFrame");
+
+    if (UTILS_UNLIKELY(mDynamicBufferCount)) {
+        // this tells updateDynamicBuffer() when the GPU is done with the frame
+        GLsync& fence = mDynamicBufferFences[mFrameCount % DYNAMIC_BUFFER_REGION_COUNT];
+        if (fence) {
+            glDeleteSync(fence);
+        }
+        fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+    mFrameCount++;
+
+    if (UTILS_UNLIKELY(!mPendingReadbacks.empty())) {
+        processReadbacks(false);
+    }
+
+    if (UTILS_UNLIKELY(!mReleasedImages.empty())) {
+        processReleasedImages(false);
+    }
+
+    if (!mPendingTimerQueries.empty()) {
+        processTimerQueries();
+    }
+
+    mStagePool.gc();
+}
+
+void OpenGLDriver::getMemoryStatistics(Driver::MemoryStatistics* stats) {
+    // OpenGL doesn't report the memory it allocates
+    stats->handleArena = mHandleArena.getArea().getSize();
+}
+
+void OpenGLDriver::queueCallback(BufferDescriptor&& buffer) {
+    scheduleDestroy(std::move(buffer));
+}
+
+void OpenGLDriver::getFrameStatistics(Driver::FrameStatistics* stats) {
+    *stats = state.stats;
+    if (mHasGpuTime) {
+        std::copy_n(mGpuTimeMilli, TIMER_COUNT, stats->gpuTimeMilli);
+        stats->gpuTimeAge = mFrameCount - mGpuTimeFrame;
+    }
 }
 
 void OpenGLDriver::flush(int) {
@@ -2591,10 +3461,11 @@ void OpenGLDriver::blit(TargetBufferFlags buffers,
         bindFramebuffer(GL_READ_FRAMEBUFFER, s->gl.fbo);
         bindFramebuffer(GL_DRAW_FRAMEBUFFER, d->gl.fbo);
         disable(GL_SCISSOR_TEST);
+        // depth and stencil buffers can only be blitted with GL_NEAREST
         glBlitFramebuffer(
                 srcLeft, srcBottom, srcLeft + srcWidth, srcBottom + srcHeight,
                 dstLeft, dstBottom, dstLeft + dstWidth, dstBottom + dstHeight,
-                mask, GL_LINEAR);
+                mask, (mask == GL_COLOR_BUFFER_BIT) ? GL_LINEAR : GL_NEAREST);
         enable(GL_SCISSOR_TEST);
         CHECK_GL_ERROR(utils::slog.e)
     }
@@ -2603,21 +3474,248 @@ void OpenGLDriver::blit(TargetBufferFlags buffers,
 void OpenGLDriver::draw(
         Driver::ProgramHandle ph,
         Driver::RasterState rs,
-        Driver::RenderPrimitiveHandle rph) {
+        Driver::RenderPrimitiveHandle rph,
+        uint32_t instanceCount) {
     DEBUG_MARKER()
 
     OpenGLProgram* p = handle_cast<OpenGLProgram*>(ph);
+    if (UTILS_UNLIKELY(!p->isReady(this))) {
+        // the program is still being compiled (or failed to), skip this draw
+        return;
+    }
     useProgram(p);
 
-    const GLRenderPrimitive* rp = handle_cast<const GLRenderPrimitive *>(rph);
-    bindVertexArray(rp);
+    GLRenderPrimitive* rp = handle_cast<GLRenderPrimitive *>(rph);
+    bindVertexArray(rp->gl.vertexArray);
+
+    uintptr_t offset = rp->offset;
+    if (UTILS_UNLIKELY(rp->gl.dynamic)) {
+        offset += updateDynamicRenderPrimitive(rp);
+    }
+
+    setRasterState(rs);
+
+    if (UTILS_LIKELY(instanceCount <= 1)) {
+        glDrawRangeElements(GLenum(rp->type), rp->minIndex, rp->maxIndex, rp->count,
+                rp->gl.indicesType, reinterpret_cast<const void*>(offset));
+    } else {
+        glDrawElementsInstanced(GLenum(rp->type), rp->count,
+                rp->gl.indicesType, reinterpret_cast<const void*>(offset),
+                GLsizei(instanceCount));
+    }
+
+    CHECK_GL_ERROR(utils::slog.e)
+}
+
+void OpenGLDriver::drawIndirect(
+        Driver::ProgramHandle ph,
+        Driver::RasterState rs,
+        Driver::RenderPrimitiveHandle rph,
+        Driver::DrawIndirectCommand const* commands,
+        uint32_t count,
+        math::float4 const* planes,
+        Driver::DrawBounds const* bounds) {
+    DEBUG_MARKER()
+
+    // the engine only issues indirect draws when isDrawIndirectSupported()
+    assert(isDrawIndirectSupported());
+
+#if defined(GL_VERSION_4_3)
+    OpenGLProgram* p = handle_cast<OpenGLProgram*>(ph);
+    if (UTILS_UNLIKELY(!p->isReady(this) || !count)) {
+        return;
+    }
+
+    GLRenderPrimitive* rp = handle_cast<GLRenderPrimitive *>(rph);
+    bindVertexArray(rp->gl.vertexArray);
+
+    // the commands index the whole index buffer, which may have moved if it's dynamic
+    const uint32_t indexSize = (rp->gl.indicesType == GL_UNSIGNED_INT) ? 4 : 2;
+    uint32_t firstIndexOffset = 0;
+    if (UTILS_UNLIKELY(rp->gl.dynamic)) {
+        firstIndexOffset = updateDynamicRenderPrimitive(rp) / indexSize;
+    }
+
+    // the draws are culled by a compute shader, or while they're copied without one
+    const bool cullOnGpu = planes && initDrawCullingProgram();
+    const bool cullOnCpu = planes && !cullOnGpu;
+
+    if (UTILS_UNLIKELY(!mDrawIndirectBuffer)) {
+        glGenBuffers(1, &mDrawIndirectBuffer);
+    }
+    bindBuffer(GL_DRAW_INDIRECT_BUFFER, mDrawIndirectBuffer);
+
+    // orphan the previous commands, which the GPU may still be reading
+    const GLsizeiptr size = count * sizeof(Driver::DrawIndirectCommand);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    Driver::DrawIndirectCommand* const UTILS_RESTRICT out =
+            static_cast<Driver::DrawIndirectCommand*>(glMapBufferRange(GL_DRAW_INDIRECT_BUFFER,
+                    0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    if (UTILS_UNLIKELY(!out)) {
+        return;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        out[i] = commands[i];
+        out[i].firstIndex += firstIndexOffset;
+        if (cullOnCpu && !bounds[i].isVisible(planes)) {
+            out[i].instanceCount = 0;
+        }
+    }
+    glUnmapBuffer(GL_DRAW_INDIRECT_BUFFER);
+
+    if (cullOnGpu) {
+        cullDrawsIndirect(planes, bounds, count);
+    }
 
+    useProgram(p);
     setRasterState(rs);
 
-    glDrawRangeElements(GLenum(rp->type), rp->minIndex, rp->maxIndex, rp->count,
-            rp->gl.indicesType, reinterpret_cast<const void*>(rp->offset));
+    glMultiDrawElementsIndirect(GLenum(rp->type), rp->gl.indicesType, nullptr, GLsizei(count), 0);
+
+    CHECK_GL_ERROR(utils::slog.e)
+#endif
+}
+
+bool OpenGLDriver::initDrawCullingProgram() noexcept {
+#if defined(GL_VERSION_4_3)
+    if (UTILS_LIKELY(mDrawCullingInitialized)) {
+        return mDrawCullingProgram != 0;
+    }
+    mDrawCullingInitialized = true;
+    if (!ext.compute_shader) {
+        return false;
+    }
+
+    // zeroes the instance count of the draws outside the frustum, see Driver::DrawBounds
+    const char source[] = R"SHADER(#version 430 core
+        layout(local_size_x = 64) in;
+        struct DrawCommand {
+            uint count;
+            uint instanceCount;
+            uint firstIndex;
+            int baseVertex;
+            uint baseInstance;
+        };
+        layout(std430, binding = 0) buffer Commands { DrawCommand commands[]; };
+        layout(std430, binding = 1) readonly buffer Bounds { vec4 bounds[]; };
+        uniform vec4 planes[6];
+        uniform uint drawCount;
+        void main() {
+            uint i = gl_GlobalInvocationID.x;
+            if (i >= drawCount) {
+                return;
+            }
+            vec3 center = bounds[i * 2u].xyz;
+            vec3 halfExtent = bounds[i * 2u + 1u].xyz;
+            bool visible = true;
+            for (int j = 0; j < 6; j++) {
+                float d = dot(planes[j].xyz, center) - dot(abs(planes[j].xyz), halfExtent);
+                visible = visible && (d + planes[j].w < 0.0);
+            }
+            if (!visible) {
+                commands[i].instanceCount = 0u;
+            }
+        }
+        )SHADER";
+
+    GLint status;
+    char const* const csource = source;
+    GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(shader, 1, &csource, nullptr);
+    glCompileShader(shader);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status != GL_TRUE) {
+        // the draws are culled on the CPU instead
+        glDeleteShader(shader);
+        return false;
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, shader);
+    glLinkProgram(program);
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE) {
+        glDetachShader(program, shader);
+        glDeleteShader(shader);
+        glDeleteProgram(program);
+        return false;
+    }
+
+    mDrawCullingShader = shader;
+    mDrawCullingProgram = program;
+    mDrawCullingPlanesLocation = glGetUniformLocation(program, "planes");
+    mDrawCullingCountLocation = glGetUniformLocation(program, "drawCount");
+    glGenBuffers(1, &mDrawBoundsBuffer);
+
+    CHECK_GL_ERROR(utils::slog.e)
+    return true;
+#else
+    return false;
+#endif
+}
+
+void OpenGLDriver::terminateDrawCullingProgram() noexcept {
+#if defined(GL_VERSION_4_3)
+    if (mDrawCullingProgram) {
+        glDetachShader(mDrawCullingProgram, mDrawCullingShader);
+        glDeleteShader(mDrawCullingShader);
+        glDeleteProgram(mDrawCullingProgram);
+        glDeleteBuffers(1, &mDrawBoundsBuffer);
+        mDrawCullingProgram = 0;
+        mDrawCullingShader = 0;
+        mDrawBoundsBuffer = 0;
+    }
+    mDrawCullingInitialized = false;
+#endif
+}
+
+void OpenGLDriver::cullDrawsIndirect(math::float4 const* planes, Driver::DrawBounds const* bounds,
+        uint32_t count) noexcept {
+#if defined(GL_VERSION_4_3)
+    // the commands are culled in place, in mDrawIndirectBuffer
+    bindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mDrawIndirectBuffer);
+    bindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mDrawBoundsBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(Driver::DrawBounds), bounds,
+            GL_STREAM_DRAW);
+
+    useProgram(mDrawCullingProgram);
+    glUniform4fv(mDrawCullingPlanesLocation, 6, &planes[0].x);
+    glUniform1ui(mDrawCullingCountLocation, count);
+    glDispatchCompute((count + 63) / 64, 1, 1);
+
+    // the commands are then read by the indirect draw
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+#endif
+}
+
+void OpenGLDriver::dispatchCompute(
+        Driver::ProgramHandle ph,
+        Driver::TextureHandle th,
+        uint32_t groupCountX,
+        uint32_t groupCountY) {
+    DEBUG_MARKER()
+
+    // the engine only dispatches compute programs when isComputeSupported()
+    assert(isComputeSupported());
+
+#if defined(GL_ES_VERSION_3_1) || defined(GL_VERSION_4_3)
+    OpenGLProgram* p = handle_cast<OpenGLProgram*>(ph);
+    if (UTILS_UNLIKELY(!p->isReady(this))) {
+        return;
+    }
+    useProgram(p);
+
+    GLTexture const* t = handle_cast<GLTexture const*>(th);
+    assert(t->gl.internalFormat == GL_RGBA8);
+    glBindImageTexture(0, t->gl.texture_id, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+
+    glDispatchCompute(groupCountX, groupCountY, 1);
+
+    // the image is then sampled, or blitted from
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
 
     CHECK_GL_ERROR(utils::slog.e)
+#endif
 }
 
 // explicit instantiation of the Dispatcher
@@ -19,26 +19,29 @@
 
 #include "driver/Driver.h"
 #include "driver/DriverBase.h"
+#include "driver/HandleAllocator.h"
 #include "driver/opengl/GLUtils.h"
+#include "driver/opengl/OpenGLStagePool.h"
+
+#include <filament/driver/PixelBufferDescriptor.h>
 
 #include <utils/compiler.h>
 #include <utils/Allocator.h>
+#include <utils/Hash.h>
 
 #include <math/vec4.h>
 
 #include <tsl/robin_map.h>
 
+#include <memory>
 #include <set>
+#include <vector>
 
 #include <assert.h>
 
 
 namespace filament {
 
-namespace driver {
-class PixelBufferDescriptor;
-} // namespace driver
-
 class OpenGLProgram;
 class OpenGLBlitter;
 
@@ -50,12 +53,29 @@ public:
     static std::unique_ptr<Driver> create(
             driver::ContextManagerGL* externalContext, void* sharedGLContext) noexcept;
 
+    // Driver::Usage::DYNAMIC buffers are allocated DYNAMIC_BUFFER_REGION_COUNT times. The first
+    // update of a frame writes to the next region, which the GPU is done with, so it doesn't need
+    // to synchronize (see updateDynamicBuffer()).
+    static constexpr size_t DYNAMIC_BUFFER_REGION_COUNT = 3;
+
+    struct GLDynamicBuffer {
+        std::unique_ptr<uint8_t[]> shadow;  // CPU copy of the content, to fill the new regions
+        uint32_t size = 0;                  // size of a region
+        uint32_t frame = UINT32_MAX;        // frame of the last region switch
+        uint8_t region = 0;                 // region holding the current content
+        uint32_t getOffset() const noexcept { return region * size; }
+    };
+
     // OpenGLDriver specific fields
     struct GLVertexBuffer : public HwVertexBuffer {
         using HwVertexBuffer::HwVertexBuffer;
         struct {
             std::array<GLuint, MAX_ATTRIBUTE_BUFFER_COUNT> buffers;  // 4*6 bytes
         } gl;
+        // one per buffer for dynamic vertex buffers, null otherwise
+        std::unique_ptr<GLDynamicBuffer[]> dynamic;
+        // incremented each time a buffer switches region
+        uint32_t generation = 0;
     };
 
     struct GLIndexBuffer : public HwIndexBuffer {
@@ -63,15 +83,41 @@ public:
         struct {
             GLuint buffer;
         } gl;
+        // null for static index buffers
+        std::unique_ptr<GLDynamicBuffer> dynamic;
+    };
+
+    // A VAO, shared by the render primitives which use the same vertex and index buffers with
+    // the same enabled attributes (see setRenderPrimitiveBuffer), so that the draws of the
+    // sub-ranges of a mesh don't switch VAOs.
+    struct VertexArrayKey {
+        HandleBase::HandleId vertexBuffer;
+        HandleBase::HandleId indexBuffer;
+        uint32_t enabledAttributes;
+        bool operator==(VertexArrayKey const& rhs) const noexcept {
+            return vertexBuffer == rhs.vertexBuffer && indexBuffer == rhs.indexBuffer &&
+                   enabledAttributes == rhs.enabledAttributes;
+        }
+    };
+
+    struct GLVertexArray {
+        VertexArrayKey key = {};
+        GLuint vao = 0;
+        GLuint elementArray = 0;
+        utils::bitset32 vertexAttribArray;
+        uint32_t vertexBufferGeneration = 0;    // of a dynamic vertex buffer
+        uint32_t refs = 0;                      // render primitives using it
     };
 
     struct GLRenderPrimitive : public HwRenderPrimitive {
         using HwRenderPrimitive::HwRenderPrimitive;
         struct {
-            GLuint vao = 0;
+            GLVertexArray* vertexArray = nullptr;
             GLenum indicesType = GL_UNSIGNED_INT;
-            GLuint elementArray = 0;
-            utils::bitset32 vertexAttribArray;
+            // only set if the vertex or index buffer is dynamic
+            Driver::VertexBufferHandle vertexBuffer;
+            Driver::IndexBufferHandle indexBuffer;
+            bool dynamic = false;
         } gl;
     };
 
@@ -85,8 +131,10 @@ public:
 
             // texture parameters go here too
             GLfloat anisotropy = 1.0;
-            uint8_t baseLevel = 255;
+            uint8_t baseLevel = 255;        // range of levels uploaded
             uint8_t maxLevel = 0;
+            uint8_t minLevelLimit = 0;      // range of levels sampled, see setMinMaxLevels()
+            uint8_t maxLevelLimit = 255;
             uint8_t targetIndex = 0;
         } gl;
     };
@@ -107,7 +155,8 @@ public:
     struct GLStream : public HwStream {
         static constexpr size_t ROUND_ROBIN_TEXTURE_COUNT = 3;      // 3 maximum
         using HwStream::HwStream;
-        bool isNativeStream() const { return gl.externalTextureId == 0; }
+        bool isNativeStream() const { return streamType == driver::StreamType::NATIVE; }
+        bool isAcquired() const { return streamType == driver::StreamType::ACQUIRED; }
         struct Info {
             // storage for the read/write textures below
             driver::ExternalContext::ExternalTexture* ets = nullptr;
@@ -140,11 +189,28 @@ public:
             Info infos[ROUND_ROBIN_TEXTURE_COUNT];
             uint8_t cur = 0;
         } user_thread;
+
+        /*
+         * The image of an acquired stream, bound to its textures, and the callback giving the
+         * buffer back to the application (see setAcquiredImage()).
+         */
+        struct AcquiredImage {
+            driver::ExternalContext::ExternalTexture* image;
+            BufferDescriptor release;
+        };
+        AcquiredImage* acquired = nullptr;
     };
 
     struct GLSamplerBuffer : public HwSamplerBuffer {
         using HwSamplerBuffer::HwSamplerBuffer;
+        // the texture and sampler object of each sampler, resolved by updateSamplerBuffer()
+        struct Binding {
+            GLTexture const* t = nullptr;
+            GLuint sampler = 0;
+        };
         struct {
+            std::vector<Binding> bindings;
+            uint32_t generation = 0;    // changes with the content, unique across sampler buffers
         } gl;
     };
 
@@ -171,10 +237,13 @@ public:
             GLuint fbo = 0;
             uint8_t samples = 1;
             bool useQCOMTiledRendering = false;
+            // the attachments are multisampled on tile only, and resolved into the textures
+            bool autoResolve = false;
         } gl;
     };
 
     void useProgram(GLuint program) noexcept;
+    void bindUnpackBuffer(GLuint buffer) noexcept;
 
 private:
     ShaderModel getShaderModel() const noexcept override final;
@@ -201,26 +270,9 @@ private:
 
     // Memory management...
 
-    class HandleAllocator {
-        utils::PoolAllocator< 16, 16>   mPool0;
-        utils::PoolAllocator< 64, 32>   mPool1;
-        utils::PoolAllocator<128, 32>   mPool2;
-    public:
-        static constexpr size_t MIN_ALIGNMENT_SHIFT = 4;
-        HandleAllocator(const utils::HeapArea& area);
-        void* alloc(size_t size, size_t alignment, size_t extra = 0) noexcept;
-        void free(void* p, size_t size) noexcept;
-    };
-
-    // the arenas for handle allocation needs to be thread-safe
-#ifndef NDEBUG
-    using HandleArena = utils::Arena<HandleAllocator,
-            utils::LockingPolicy::SpinLock,
-            utils::TrackingPolicy::HighWatermark>;
-#else
-    using HandleArena = utils::Arena<HandleAllocator,
-            utils::LockingPolicy::SpinLock>;
-#endif
+    // see the sizes of the handles in OpenGLDriver.cpp
+    using HandleAllocatorGL = HandleAllocator<16, 64, 128>;
+    using HandleArena = filament::HandleArena<HandleAllocatorGL>;
 
     HandleArena mHandleArena;
 
@@ -248,7 +300,7 @@ private:
             std::is_base_of<B, typename std::remove_pointer<Dp>::type>::value, Dp>::type
     handle_cast(Handle<B>& handle) noexcept {
         char* const base = (char *)mHandleArena.getArea().begin();
-        size_t offset = handle.getId() << HandleAllocator::MIN_ALIGNMENT_SHIFT;
+        size_t offset = handle.getId() << HandleAllocatorGL::MIN_ALIGNMENT_SHIFT;
         return static_cast<Dp>(static_cast<void *>(base + offset));
     }
 
@@ -275,10 +327,11 @@ private:
     void framebufferTexture(Driver::TargetBufferInfo& binfo, GLRenderTarget* rt, GLenum attachment) noexcept;
 
     void framebufferRenderbuffer(GLRenderTarget::GL::RenderBuffer* rb, GLenum attachment,
-            GLenum internalformat, uint32_t width, uint32_t height, uint8_t samples, GLuint fbo) noexcept;
+            GLenum internalformat, uint32_t width, uint32_t height, uint8_t samples,
+            bool autoResolve, GLuint fbo) noexcept;
 
     GLuint framebufferRenderbuffer(uint32_t width, uint32_t height, uint8_t samples,
-            GLenum attachment, GLenum internalformat, GLuint fbo) noexcept;
+            bool autoResolve, GLenum attachment, GLenum internalformat, GLuint fbo) noexcept;
 
     void setRasterStateSlow(RasterState rs) noexcept;
     void setRasterState(RasterState rs) noexcept {
@@ -299,7 +352,7 @@ private:
             PixelBufferDescriptor&& data, FaceOffsets const* faceOffsets);
 
     void renderBufferStorage(GLuint rbo, GLenum internalformat, uint32_t width,
-            uint32_t height, uint8_t samples) const noexcept;
+            uint32_t height, uint8_t samples, bool autoResolve) const noexcept;
 
     void textureStorage(GLTexture* t,
             uint32_t width, uint32_t height, uint32_t depth) noexcept;
@@ -325,10 +378,12 @@ private:
 
     inline void bindBuffer(GLenum target, GLuint buffer) noexcept;
     inline void bindBufferBase(GLenum target, GLuint index, GLuint buffer) noexcept;
+    inline void bindBufferRange(GLenum target, GLuint index, GLuint buffer,
+            GLintptr offset, GLsizeiptr size) noexcept;
 
     inline void bindFramebuffer(GLenum target, GLuint buffer) noexcept;
 
-    inline void bindVertexArray(GLRenderPrimitive const* vao) noexcept;
+    inline void bindVertexArray(GLVertexArray const* vao) noexcept;
     inline void enableVertexAttribArray(GLuint index) noexcept;
     inline void disableVertexAttribArray(GLuint index) noexcept;
     inline void enable(GLenum cap) noexcept;
@@ -367,17 +422,42 @@ private:
     static constexpr const size_t MAX_TEXTURE_UNITS = 16;   // All mobile GPUs as of 2016
     static constexpr const size_t MAX_BUFFER_BINDINGS = 32;
 
-    GLRenderPrimitive mDefaultVAO;
+    GLVertexArray mDefaultVAO;
     GLint mMaxRenderBufferSize = 0;
+    GLint mUniformBufferOffsetAlignment = 256;
+    // holds the commands of drawIndirect(), reallocated by each call
+    GLuint mDrawIndirectBuffer = 0;
+
+    // state needed for culling the draws of drawIndirect() with a compute shader, created by
+    // the first draws to cull
+    GLuint mDrawCullingShader = 0;
+    GLuint mDrawCullingProgram = 0;
+    GLint mDrawCullingPlanesLocation = -1;
+    GLint mDrawCullingCountLocation = -1;
+    GLuint mDrawBoundsBuffer = 0;               // the bounds of the draws, reallocated by each call
+    bool mDrawCullingInitialized = false;
+    // returns false if the draws can't be culled on the GPU
+    bool initDrawCullingProgram() noexcept;
+    void terminateDrawCullingProgram() noexcept;
+    // culls the commands in mDrawIndirectBuffer, see drawIndirect()
+    void cullDrawsIndirect(math::float4 const* planes, Driver::DrawBounds const* bounds,
+            uint32_t count) noexcept;
 
     template <typename T, typename F>
-    inline void update_state(T& state, T const& expected, F functor, bool force = false) noexcept {
-        if (UTILS_UNLIKELY(force || state != expected)) {
-            state = expected;
+    inline void update_state(T& field, T const& expected, F functor, bool force = false) noexcept {
+        if (UTILS_UNLIKELY(countStateChange(force || field != expected))) {
+            field = expected;
             functor();
         }
     }
 
+    // keeps track of the redundant state changes, returns 'changed'
+    inline bool countStateChange(bool changed) noexcept {
+        state.stats.stateChangesIssued += changed;
+        state.stats.stateChangesSkipped += !changed;
+        return changed;
+    }
+
     // Try to keep the State structure sorted by data-access patterns
     struct State {
         GLuint draw_fbo = 0;
@@ -388,7 +468,7 @@ private:
         } program;
 
         struct {
-            GLRenderPrimitive* p = nullptr;
+            GLVertexArray* p = nullptr;
         } vao;
 
         struct {
@@ -411,17 +491,21 @@ private:
         struct {
             struct {
                 GLuint buffers[MAX_BUFFER_BINDINGS] = { 0 };
+                // offsets and sizes are 0 when the whole buffer is bound
+                GLintptr offsets[MAX_BUFFER_BINDINGS] = { 0 };
+                GLsizeiptr sizes[MAX_BUFFER_BINDINGS] = { 0 };
                 GLuint genericBinding = 0;
             } targets[13];
         } buffers;
 
         struct {
             GLuint active = 0;      // zero-based
+            uint32_t version = 0;   // changes with any binding, or name of a bound texture
             struct {
                 GLuint sampler = 0;
                 struct {
                     GLuint texture_id = 0;
-                } targets[5];
+                } targets[6];
             } units[MAX_TEXTURE_UNITS];
         } textures;
 
@@ -450,6 +534,8 @@ private:
             GLint stencil = 0;
         } clears;
 
+        // reset at the beginning of each frame
+        Driver::FrameStatistics stats;
     } state;
 
     static constexpr const size_t TEXTURE_TARGET_COUNT =
@@ -484,6 +570,7 @@ private:
     std::array<HwSamplerBuffer*, Program::NUM_SAMPLER_BINDINGS> mSamplerBindings;   // 8 pointers
 
     mutable tsl::robin_map<uint32_t, GLuint> mSamplerMap;
+    uint32_t mSamplerBufferGeneration = 0;
     mutable std::vector<GLTexture*> mExternalStreams;
 
     // supported extensions detected at runtime
@@ -495,6 +582,13 @@ private:
         bool OES_EGL_image_external_essl3 = false;
         bool EXT_debug_marker = false;
         bool EXT_color_buffer_half_float = false;
+        bool KHR_parallel_shader_compile = false;
+        bool ARB_multi_draw_indirect = false;
+        bool ARB_shader_draw_parameters = false;
+        bool timer_query = false;   // ARB_timer_query or EXT_disjoint_timer_query
+        bool EXT_disjoint_timer_query = false;
+        bool compute_shader = false;    // ES 3.1 or ARB_compute_shader + image load/store
+        bool EXT_multisampled_render_to_texture = false;
     } ext;
 
     struct {
@@ -518,12 +612,109 @@ private:
         bool texture_external_needs_rebind = false;
     } bugs;
 
+    bool updateDynamicBuffer(GLenum target, GLuint buffer, GLDynamicBuffer& db,
+            void const* data, uint32_t byteOffset, uint32_t byteSize) noexcept;
+    uint32_t updateDynamicRenderPrimitive(GLRenderPrimitive* rp) noexcept;
+    void setVertexAttribPointer(GLVertexBuffer const* eb, size_t index) noexcept;
+
+    // the VAOs of the render primitives, by buffers and enabled attributes
+    using VertexArrayKeyHashFn = utils::hash::MurmurHashFn<VertexArrayKey>;
+    tsl::robin_map<VertexArrayKey, GLVertexArray*, VertexArrayKeyHashFn> mVertexArrays;
+    void releaseVertexArray(GLVertexArray* va) noexcept;
+    void forgetVertexArrays(HandleBase::HandleId vertexBuffer,
+            HandleBase::HandleId indexBuffer) noexcept;
+
+    // number of dynamic buffers alive, the frames are fenced only when there are some
+    uint32_t mDynamicBufferCount = 0;
+    uint32_t mFrameCount = 0;
+    GLsync mDynamicBufferFences[DYNAMIC_BUFFER_REGION_COUNT] = {};
+
+    // The read-backs are done into a pixel pack buffer, which is copied to the client's buffer
+    // once the GPU is done with it (see readPixels()).
+    static constexpr uint32_t MAX_READBACK_LATENCY = 2;   // in frames
+    struct GLReadback {
+        GLuint pbo;
+        GLsync fence;
+        uint32_t width;
+        uint32_t height;
+        uint32_t frame;
+        driver::PixelBufferDescriptor p;
+    };
+    std::vector<GLReadback> mPendingReadbacks;
+    void processReadbacks(bool wait) noexcept;
+
+    // The images of the acquired streams which were replaced. They're given back once the GPU is
+    // done with the commands issued before, see setAcquiredImage().
+    struct GLReleasedImage {
+        GLsync fence;
+        GLStream::AcquiredImage* acquired;
+    };
+    std::vector<GLReleasedImage> mReleasedImages;
+    void releaseAcquiredImage(GLStream* s) noexcept;
+    void processReleasedImages(bool wait) noexcept;
+
+    // GPU timers, see beginTimer()
+    struct GLTimerQuery {
+        GLuint query;
+        uint32_t frame;
+        uint8_t timer;
+    };
+    // don't let the queries pile up if the GPU never reports them
+    static constexpr size_t MAX_PENDING_TIMER_QUERIES = 64;
+    std::vector<GLuint> mFreeTimerQueries;
+    std::vector<GLTimerQuery> mPendingTimerQueries;     // in the order they were issued
+    float mGpuTimeMilli[Driver::TIMER_COUNT] = {};      // of the latest frame fully timed
+    uint32_t mGpuTimeFrame = 0;
+    bool mHasGpuTime = false;
+    bool mTimerActive = false;
+    void processTimerQueries() noexcept;
+    void completeReadback(GLReadback& readback) noexcept;
+
+    // The texture uploads are staged through pixel unpack buffers and processed in order. They're
+    // split in bands of rows, or faces and slices when compressed, so that no more than
+    // mTextureUploadBudget bytes are uploaded per frame, the rest waits for the next frames.
+    struct GLTextureUpload {
+        GLTexture* t;
+        uint32_t level;
+        uint32_t xoffset;
+        uint32_t yoffset;
+        uint32_t zoffset;
+        uint32_t width;
+        uint32_t height;
+        uint32_t depth;
+        uint32_t face;      // next face, or slice of 3D and array textures, to upload
+        uint32_t row;       // next row of that face to upload
+        FaceOffsets faceOffsets;
+        driver::PixelBufferDescriptor p;
+    };
+    std::vector<GLTextureUpload> mPendingTextureUploads;
+    uint32_t mTextureUploadBudget = 0;      // bytes per frame, 0 means no limit
+    size_t mTextureUploadBytes = 0;         // bytes uploaded during the current frame
+    OpenGLStagePool mStagePool;
+    void queueTextureUpload(GLTexture* t, uint32_t level,
+            uint32_t xoffset, uint32_t yoffset, uint32_t zoffset,
+            uint32_t width, uint32_t height, uint32_t depth,
+            PixelBufferDescriptor&& p, FaceOffsets const* faceOffsets) noexcept;
+    void processTextureUploads() noexcept;
+    void flushTextureUploads(GLTexture const* t) noexcept;
+    void cancelTextureUploads(GLTexture const* t) noexcept;
+    bool uploadTexture(GLTextureUpload& upload, size_t budget) noexcept;
+    void finishTextureUpload(GLTextureUpload& upload) noexcept;
+    void updateUploadedLevels(GLTexture* t, uint32_t level) noexcept;
+    void updateTextureLevels(GLTexture* t) noexcept;
+
     void attachStream(GLTexture* t, GLStream* stream) noexcept;
     void detachStream(GLTexture* t) noexcept;
     void replaceStream(GLTexture* t, GLStream* stream) noexcept;
+    void bindExternalImage(GLTexture* t, void* image) noexcept;
 
     driver::ContextManagerGL& mContextManager;
 
+    // cache for the program binaries, null if there is no cache or if the binaries aren't
+    // supported. The programs are keyed by a hash of the sources and of mProgramBinaryKey.
+    driver::BlobCache* mBlobCache = nullptr;
+    uint64_t mProgramBinaryKey = 0;
+
     OpenGLBlitter* mOpenGLBlitter = nullptr;
     void updateStream(GLTexture* t, driver::DriverApi* driver) noexcept;
 };
@@ -537,6 +728,7 @@ constexpr size_t OpenGLDriver::getIndexForTextureTarget(GLuint target) noexcept
         case GL_TEXTURE_CUBE_MAP:       return 2;
         case GL_TEXTURE_2D_MULTISAMPLE: return 3;
         case GL_TEXTURE_EXTERNAL_OES:   return 4;
+        case GL_TEXTURE_2D_ARRAY:       return 5;
         default:                        return 0;
     }
 }
@@ -609,6 +801,7 @@ void OpenGLDriver::bindTexture(GLuint unit, GLuint target, GLuint texId) noexcep
 void OpenGLDriver::bindSampler(GLuint unit, GLuint sampler) noexcept {
     assert(unit < MAX_TEXTURE_UNITS);
     update_state(state.textures.units[unit].sampler, sampler, [&]() {
+        state.textures.version++;
         glBindSampler(unit, sampler);
     });
 }
@@ -16,9 +16,13 @@
 
 #include "driver/opengl/OpenGLProgram.h"
 
+#include <algorithm>
 #include <cctype>
+#include <memory>
 #include <sstream>
 
+#include <string.h>
+
 #include <utils/Log.h>
 #include <utils/compiler.h>
 #include <utils/Panic.h>
@@ -29,6 +33,13 @@ namespace filament {
 
 using namespace math;
 using namespace utils;
+using namespace driver;
+
+// a program binary in the BlobCache is this header followed by the binary itself
+struct ProgramBinaryHeader {
+    uint32_t format;
+    uint32_t size;
+};
 
 OpenGLProgram::OpenGLProgram(OpenGLDriver* gl, const Program& programBuilder) noexcept
         :  HwProgram(programBuilder.getName()), mIsValid(false) {
@@ -37,163 +48,306 @@ OpenGLProgram::OpenGLProgram(OpenGLDriver* gl, const Program& programBuilder) no
 
     const auto& shadersSource = programBuilder.getShadersSource();
 
-    // build all shaders
-    #pragma nounroll
-    for (size_t i = 0; i < Program::NUM_SHADER_TYPES; i++) {
-        GLenum glShaderType;
-        Shader type = (Shader)i;
-        switch (type) {
-            case Shader::VERTEX:
-                glShaderType = GL_VERTEX_SHADER;
-                break;
-            case Shader::FRAGMENT:
-                glShaderType = GL_FRAGMENT_SHADER;
-                break;
-        }
+    this->gl.program = 0;
+    std::fill(std::begin(this->gl.shaders), std::end(this->gl.shaders), 0);
 
-        if (shadersSource[i].length()) {
-            GLint status;
-            char const* const source = shadersSource[i].c_str();
+    // if we have a binary of this program from a previous run, we don't need to compile it
+    ProgramBinaryKey binaryKey{};
+    const bool useBlobCache = gl->mBlobCache != nullptr;
+    bool loaded = false;
+    if (useBlobCache) {
+        binaryKey.driver = gl->mProgramBinaryKey;
+        for (size_t i = 0; i < Program::NUM_SHADER_TYPES; i++) {
+            binaryKey.sources[i] = hash(shadersSource[i].c_str(), shadersSource[i].length());
+        }
+        loaded = loadBinary(gl, binaryKey);
+    }
 
-            GLuint shaderId = glCreateShader(glShaderType);
-            glShaderSource(shaderId, 1, &source, nullptr);
-            glCompileShader(shaderId);
+    if (!loaded) {
+        // Build all shaders. The compilation status is not checked here, because this would
+        // force the driver to finish compiling immediately, see checkStatus().
+        #pragma nounroll
+        for (size_t i = 0; i < Program::NUM_SHADER_TYPES; i++) {
+            GLenum glShaderType;
+            Shader type = (Shader)i;
+            switch (type) {
+                case Shader::VERTEX:
+                    glShaderType = GL_VERTEX_SHADER;
+                    break;
+                case Shader::FRAGMENT:
+                    glShaderType = GL_FRAGMENT_SHADER;
+                    break;
+                case Shader::COMPUTE:
+                    glShaderType = GL_COMPUTE_SHADER;
+                    break;
+            }
 
-            glGetShaderiv(shaderId, GL_COMPILE_STATUS, &status);
-            if (UTILS_UNLIKELY(status != GL_TRUE)) {
-                logCompilationError(slog.e, shaderId, source);
-                glDeleteShader(shaderId);
-                return;
+            if (shadersSource[i].length()) {
+                char const* const source = shadersSource[i].c_str();
+                GLuint shaderId = glCreateShader(glShaderType);
+                glShaderSource(shaderId, 1, &source, nullptr);
+                glCompileShader(shaderId);
+                this->gl.shaders[i] = shaderId;
+                mValidShaderSet |= 1U << i;
             }
-            this->gl.shaders[i] = shaderId;
-            mValidShaderSet |= 1U << i;
         }
-    }
 
-    // we need at least a vertex and fragment program
-    const uint8_t validShaderSet = mValidShaderSet;
-    const uint8_t mask = VERTEX_SHADER_BIT | FRAGMENT_SHADER_BIT;
-    if (UTILS_LIKELY((mValidShaderSet & mask) == mask)) {
-        GLint status;
+        // we need at least a vertex and fragment program, or a compute program alone
+        const uint8_t validShaderSet = mValidShaderSet;
+        const uint8_t mask = VERTEX_SHADER_BIT | FRAGMENT_SHADER_BIT;
+        if (UTILS_UNLIKELY((validShaderSet & mask) != mask &&
+                validShaderSet != COMPUTE_SHADER_BIT)) {
+            PANIC_LOG("failed to compile glsl program");
+            return;
+        }
+
         GLuint program = glCreateProgram();
         for (size_t i = 0; i < Program::NUM_SHADER_TYPES; i++) {
             if (validShaderSet & (1U << i)) {
                 glAttachShader(program, this->gl.shaders[i]);
             }
         }
+        if (useBlobCache) {
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
         glLinkProgram(program);
+        this->gl.program = program;
+    }
 
-        glGetProgramiv(program, GL_LINK_STATUS, &status);
-        if (UTILS_UNLIKELY(status != GL_TRUE)) {
-            char error[512];
-            glGetProgramInfoLog(program, sizeof(error), nullptr, error);
+    // Keep what we need to finish the initialization once the program is linked. The interface
+    // blocks are owned by the material, so we only keep the names we need.
+    LazyInitializationData* const data = new LazyInitializationData();
+    data->storeBinary = useBlobCache && !loaded;
+    data->binaryKey = binaryKey;
+    data->shadersSource = shadersSource;
 
-            slog.e << "LINKING: " << error << io::endl;
-            glDeleteProgram(program);
-            return;
+    auto const& uniformInterfaceBlocks = programBuilder.getUniformInterfaceBlocks();
+    #pragma nounroll
+    for (size_t binding = 0, n = uniformInterfaceBlocks.size(); binding < n; binding++) {
+        auto const& uib = uniformInterfaceBlocks[binding];
+        if (uib != nullptr) {
+            data->uniformBlockNames[binding] = uib->getName();
         }
-        this->gl.program = program;
+    }
 
-        // Associate each UniformBlock in the program to a known binding.
-        auto const& uniformInterfaceBlocks = programBuilder.getUniformInterfaceBlocks();
-        size_t n = uniformInterfaceBlocks.size();
+    if (programBuilder.hasSamplers()) {
+        auto const& samplerInterfaceBlocks = programBuilder.getSamplerInterfaceBlocks();
         #pragma nounroll
-        for (GLuint binding = 0; binding < n; binding++) {
-            auto const& uib = uniformInterfaceBlocks[binding];
-            if (uib != nullptr) {
-                GLint index = glGetUniformBlockIndex(program, uib->getName().c_str());
-                if (index >= 0) {
-                    glUniformBlockBinding(program, GLuint(index), binding);
-                }
-            }
-        }
-
-        if (programBuilder.hasSamplers()) {
-            // if we have samplers, we need to do a bit of extra work
-            // activate this program so we can set all its samplers once and for all (glUniform1i)
-            gl->useProgram(program);
-
-            auto const& samplerInterfaceBlocks = programBuilder.getSamplerInterfaceBlocks();
-            auto& indicesRun = mIndicesRuns;
-            uint8_t numUsedBindings = 0;
-            uint8_t tmu = 0;
-            #pragma nounroll
-            for (size_t i = 0, c = samplerInterfaceBlocks.size(); i < c; i++) {
-                auto const& sib = samplerInterfaceBlocks[i];
-                if (sib != nullptr) {
-                    // Cache the sampler uniform locations for each interface block
-                    auto const& infos(sib->getSamplerInfoList());
-                    if (!infos.empty()) {
-                        BlockInfo& info = mBlockInfos[numUsedBindings];
-                        info.binding = uint8_t(i);
-
-                        // sampler interface block name
-                        std::string sib_name(sib->getName().c_str());
-                        sib_name.front() = char(std::tolower(sib_name.front()));
-
-                        uint8_t count = 0;
-                        for (uint8_t j = 0, m = uint8_t(infos.size()); j < m; ++j) {
-                            // build unique name for this uniform (sampler)
-                            auto const& e = infos[j];
-                            std::string e_name(e.name.c_str());
-                            std::string uniformSamplerName(sib_name + "_" + e_name);
-
-                            // find its location and associate a TMU to it
-                            GLint loc = glGetUniformLocation(program, uniformSamplerName.c_str());
-                            if (loc >= 0) {
-                                glUniform1i(loc, tmu);
-                                indicesRun[tmu] = j;
-                                count++;
-                                tmu++;
-                            } else {
-                                // glGetUniformLocation could fail if the uniform is not used
-                                // in the program. We should just ignore the error in that case.
-                            }
-                        }
-
-                        if (count > 0) {
-                            numUsedBindings++;
-                            info.count = uint8_t(count - 1);
-                        }
+        for (size_t i = 0, c = samplerInterfaceBlocks.size(); i < c; i++) {
+            auto const& sib = samplerInterfaceBlocks[i];
+            if (sib != nullptr) {
+                auto const& infos(sib->getSamplerInfoList());
+                if (!infos.empty()) {
+                    // sampler interface block name
+                    std::string sib_name(sib->getName().c_str());
+                    sib_name.front() = char(std::tolower(sib_name.front()));
+
+                    // build unique name for each uniform (sampler)
+                    std::vector<std::string>& names = data->samplerNames[i];
+                    names.reserve(infos.size());
+                    for (auto const& e : infos) {
+                        names.push_back(sib_name + "_" + e.name.c_str());
                     }
                 }
             }
-            mUsedBindingsCount = numUsedBindings;
         }
-        mIsValid = true;
     }
 
-    // failing to compile a program can't be fatal, because this will happen a lot in
-    // the material tools. We need to have a better way to handle these errors and
-    // return to the editor.
-    if (UTILS_UNLIKELY(!isValid())) {
-        PANIC_LOG("failed to compile glsl program");
-    }
+    mLazyInitializationData.reset(data);
 }
 
 OpenGLProgram::~OpenGLProgram() noexcept {
     const size_t validShaderSet = mValidShaderSet;
-    const bool isValid = mIsValid;
     GLuint program = gl.program;
     if (validShaderSet) {
         #pragma nounroll
         for (size_t i = 0; i < Program::NUM_SHADER_TYPES; i++) {
             if (validShaderSet & (1U << i)) {
                 const GLuint shader = gl.shaders[i];
-                if (isValid) {
+                if (program) {
                     glDetachShader(program, shader);
                 }
                 glDeleteShader(shader);
             }
         }
     }
-    if (isValid) {
+    if (program) {
+        glDeleteProgram(program);
+    }
+}
+
+bool UTILS_NOINLINE OpenGLProgram::checkStatus(OpenGLDriver* gl, bool wait) noexcept {
+    assert(mLazyInitializationData);
+
+    GLuint program = this->gl.program;
+
+    if (!wait && gl->ext.KHR_parallel_shader_compile) {
+        // this doesn't block, unlike querying the link status
+        GLint completed = GL_FALSE;
+        glGetProgramiv(program, GL_COMPLETION_STATUS_KHR, &completed);
+        if (completed != GL_TRUE) {
+            return false;
+        }
+    }
+
+    GLint status;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (UTILS_LIKELY(status == GL_TRUE)) {
+        if (mLazyInitializationData->storeBinary) {
+            storeBinary(gl, mLazyInitializationData->binaryKey);
+        }
+        initialize(gl);
+        mIsValid = true;
+    } else {
+        // find out if a shader failed to compile, or if it's the link which failed
+        bool compiled = true;
+        auto const& shadersSource = mLazyInitializationData->shadersSource;
+        for (size_t i = 0; i < Program::NUM_SHADER_TYPES; i++) {
+            if (mValidShaderSet & (1U << i)) {
+                glGetShaderiv(this->gl.shaders[i], GL_COMPILE_STATUS, &status);
+                if (UTILS_UNLIKELY(status != GL_TRUE)) {
+                    logCompilationError(slog.e, this->gl.shaders[i], shadersSource[i].c_str());
+                    compiled = false;
+                }
+            }
+        }
+        if (compiled) {
+            char error[512];
+            glGetProgramInfoLog(program, sizeof(error), nullptr, error);
+            slog.e << "LINKING: " << error << io::endl;
+        }
+
+        // failing to compile a program can't be fatal, because this will happen a lot in
+        // the material tools. We need to have a better way to handle these errors and
+        // return to the editor.
+        PANIC_LOG("failed to compile glsl program");
+    }
+
+    mLazyInitializationData.reset();
+    return mIsValid;
+}
+
+bool OpenGLProgram::loadBinary(OpenGLDriver* gl, ProgramBinaryKey const& key) noexcept {
+    BlobCache& cache = *gl->mBlobCache;
+    const size_t size = cache.retrieve(&key, sizeof(key), nullptr, 0);
+    if (size <= sizeof(ProgramBinaryHeader)) {
+        return false;
+    }
+
+    std::unique_ptr<uint8_t[]> blob(new uint8_t[size]);
+    if (cache.retrieve(&key, sizeof(key), blob.get(), size) != size) {
+        return false;
+    }
+    ProgramBinaryHeader header;
+    memcpy(&header, blob.get(), sizeof(header));
+    if (header.size != size - sizeof(header)) {
+        return false;
+    }
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.format, blob.get() + sizeof(header), GLsizei(header.size));
+
+    // this doesn't block, the driver knows right away if it can use the binary
+    GLint status;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (UTILS_UNLIKELY(status != GL_TRUE)) {
+        // The driver was updated or the cache is corrupted, we'll compile the program from
+        // its sources and replace the binary. An invalid format sets an error, clear it.
+        glGetError();
         glDeleteProgram(program);
+        return false;
+    }
+    this->gl.program = program;
+    return true;
+}
+
+void OpenGLProgram::storeBinary(OpenGLDriver* gl, ProgramBinaryKey const& key) noexcept {
+    GLuint program = this->gl.program;
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    std::unique_ptr<uint8_t[]> blob(new uint8_t[sizeof(ProgramBinaryHeader) + length]);
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(program, length, &written, &format,
+            blob.get() + sizeof(ProgramBinaryHeader));
+    if (written <= 0) {
+        return;
+    }
+
+    const ProgramBinaryHeader header{ uint32_t(format), uint32_t(written) };
+    memcpy(blob.get(), &header, sizeof(header));
+    gl->mBlobCache->insert(&key, sizeof(key), blob.get(), sizeof(header) + written);
+}
+
+void OpenGLProgram::initialize(OpenGLDriver* gl) noexcept {
+    LazyInitializationData const& data = *mLazyInitializationData;
+    GLuint program = this->gl.program;
+
+    // Associate each UniformBlock in the program to a known binding.
+    auto const& uniformBlockNames = data.uniformBlockNames;
+    #pragma nounroll
+    for (GLuint binding = 0, n = GLuint(uniformBlockNames.size()); binding < n; binding++) {
+        auto const& name = uniformBlockNames[binding];
+        if (!name.empty()) {
+            GLint index = glGetUniformBlockIndex(program, name.c_str());
+            if (index >= 0) {
+                glUniformBlockBinding(program, GLuint(index), binding);
+            }
+        }
+    }
+
+    // if we have samplers, we need to do a bit of extra work
+    // activate this program so we can set all its samplers once and for all (glUniform1i)
+    bool used = false;
+    auto const& samplerNames = data.samplerNames;
+    auto& indicesRun = mIndicesRuns;
+    uint8_t numUsedBindings = 0;
+    uint8_t tmu = 0;
+    #pragma nounroll
+    for (size_t i = 0, c = samplerNames.size(); i < c; i++) {
+        auto const& names = samplerNames[i];
+        if (names.empty()) {
+            continue;
+        }
+        if (!used) {
+            gl->useProgram(program);
+            used = true;
+        }
+
+        // Cache the sampler uniform locations for each interface block
+        BlockInfo& info = mBlockInfos[numUsedBindings];
+        info.binding = uint8_t(i);
+
+        uint8_t count = 0;
+        for (uint8_t j = 0, m = uint8_t(names.size()); j < m; ++j) {
+            // find its location and associate a TMU to it
+            GLint loc = glGetUniformLocation(program, names[j].c_str());
+            if (loc >= 0) {
+                glUniform1i(loc, tmu);
+                indicesRun[tmu] = j;
+                count++;
+                tmu++;
+            } else {
+                // glGetUniformLocation could fail if the uniform is not used
+                // in the program. We should just ignore the error in that case.
+            }
+        }
+
+        if (count > 0) {
+            numUsedBindings++;
+            info.count = uint8_t(count - 1);
+        }
     }
+    mUsedBindingsCount = numUsedBindings;
 }
 
 void OpenGLProgram::updateSamplers(OpenGLDriver* gl) noexcept {
     using GLTexture = OpenGLDriver::GLTexture;
+    using GLSamplerBuffer = OpenGLDriver::GLSamplerBuffer;
 
     // cache a few member variable locally, outside of the loop
     auto const& UTILS_RESTRICT samplerBindings = gl->getSamplerBindings();
@@ -201,21 +355,35 @@ void OpenGLProgram::updateSamplers(OpenGLDriver* gl) noexcept {
     auto const& UTILS_RESTRICT blockInfos = mBlockInfos;
 
     UTILS_ASSUME(mUsedBindingsCount > 0);
+
+    // Nothing to do if the texture units are as this program left them, and the sampler buffers
+    // didn't change since. The streams rename their textures behind our back, so their textures
+    // are always bound again.
+    bool bound = mTexturesVersion == gl->state.textures.version && gl->mExternalStreams.empty();
+    for (uint8_t i = 0, n = mUsedBindingsCount; i < n; i++) {
+        GLSamplerBuffer const* const hwsb =
+                static_cast<GLSamplerBuffer const*>(samplerBindings[blockInfos[i].binding]);
+        bound = bound && mSamplerGenerations[i] == hwsb->gl.generation;
+        mSamplerGenerations[i] = hwsb->gl.generation;
+    }
+    if (bound) {
+        return;
+    }
+
     for (uint8_t i = 0, tmu = 0, n = mUsedBindingsCount; i < n; i++) {
         BlockInfo blockInfo = blockInfos[i];
-        HwSamplerBuffer const * const UTILS_RESTRICT hwsb = samplerBindings[blockInfo.binding];
-        SamplerBuffer const& UTILS_RESTRICT sb = *(hwsb->sb);
-        SamplerBuffer::Sampler const* const UTILS_RESTRICT samplers = sb.getBuffer();
+        GLSamplerBuffer const * const UTILS_RESTRICT hwsb =
+                static_cast<GLSamplerBuffer const*>(samplerBindings[blockInfo.binding]);
+        GLSamplerBuffer::Binding const* const UTILS_RESTRICT bindings = hwsb->gl.bindings.data();
         for (uint8_t j = 0, m = blockInfo.count ; j <= m; ++j, ++tmu) { // "<=" on purpose here
             const uint8_t index = indicesRun[tmu];
-            assert(index < sb.getSize());
+            assert(index < hwsb->gl.bindings.size());
 
-            Driver::TextureHandle th = samplers[index].t;
-            if (UTILS_UNLIKELY(!th)) {
+            const GLTexture* const UTILS_RESTRICT t = bindings[index].t;
+            if (UTILS_UNLIKELY(!t)) {
                 continue; // this can happen if the SamplerBuffer isn't initialized
             }
 
-            const GLTexture* const UTILS_RESTRICT t = gl->handle_cast<const GLTexture*>(th);
             if (UTILS_UNLIKELY(t->gl.fence)) {
                 glWaitSync(t->gl.fence, 0, GL_TIMEOUT_IGNORED);
                 glDeleteSync(t->gl.fence);
@@ -223,15 +391,22 @@ void OpenGLProgram::updateSamplers(OpenGLDriver* gl) noexcept {
             }
 
             gl->bindTexture(tmu, t->gl.target, t, t->gl.targetIndex);
-
-            // FIXME: getSampler() is expensive because it's a hashmap lookup
-            GLuint sampler = gl->getSampler(samplers[index].s);
-            gl->bindSampler(tmu, sampler);
+            gl->bindSampler(tmu, bindings[index].sampler);
         }
     }
+    mTexturesVersion = gl->state.textures.version;
     CHECK_GL_ERROR(utils::slog.e)
 }
 
+uint64_t OpenGLProgram::hash(void const* data, size_t size, uint64_t seed) noexcept {
+    uint8_t const* p = static_cast<uint8_t const*>(data);
+    uint64_t h = seed;
+    for (size_t i = 0; i < size; i++) {
+        h = (h ^ p[i]) * 0x100000001b3llu;
+    }
+    return h;
+}
+
 void UTILS_NOINLINE OpenGLProgram::logCompilationError(
         io::ostream& out, GLuint shaderId, char const* source) noexcept {
     char error[512];
@@ -20,6 +20,9 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <array>
+#include <memory>
+#include <string>
 #include <vector>
 
 #include <utils/compiler.h>
@@ -43,20 +46,30 @@ public:
 
     bool isValid() const noexcept { return mIsValid; }
 
+    // The compilation and link status are only checked the first time the program is used, so
+    // that the driver can build the programs in the background. When KHR_parallel_shader_compile
+    // is available, this returns false (without blocking) until the program is ready. Commands
+    // using a program which is not ready, or not valid, must be skipped.
+    bool isReady(OpenGLDriver* const gl) noexcept {
+        if (UTILS_LIKELY(!mLazyInitializationData)) {
+            return mIsValid;
+        }
+        return checkStatus(gl);
+    }
+
+    // Same as isReady(), but blocks until the program is built.
+    bool waitUntilReady(OpenGLDriver* const gl) noexcept {
+        if (UTILS_LIKELY(!mLazyInitializationData)) {
+            return mIsValid;
+        }
+        return checkStatus(gl, true);
+    }
+
     void use(OpenGLDriver* const gl) noexcept {
         if (UTILS_UNLIKELY(mUsedBindingsCount)) {
             // We rely on GL state tracking to avoid unnecessary glBindTexture / glBindSampler
-            // calls.
-
-            // we need to do this if:
-            // - the content of mSamplerBindings has changed
-            // - the content of any bound sampler buffer has changed
-            // ... since last time we used this program
-
-            // turns out the former might be relatively cheap to check, the later requires
-            // a bit less. Compared to what updateSamplers() actually does, which is
-            // pretty little, I'm not sure we'll get ahead.
-
+            // calls. The whole update is skipped when the texture units weren't touched since
+            // this program last updated them, and its sampler buffers are the same.
             updateSamplers(gl);
         }
     }
@@ -68,10 +81,15 @@ public:
 
     static void logCompilationError(utils::io::ostream& out, GLuint shaderId, char const* source) noexcept;
 
+    // 64-bits FNV-1a hash, used to key the program binaries
+    static uint64_t hash(void const* data, size_t size,
+            uint64_t seed = 0xcbf29ce484222325llu) noexcept;
+
 private:
     static constexpr uint8_t NUM_TEXTURE_UNITS = OpenGLDriver::MAX_TEXTURE_UNITS;
     static constexpr uint8_t VERTEX_SHADER_BIT   = uint8_t(1) << size_t(Program::Shader::VERTEX);
     static constexpr uint8_t FRAGMENT_SHADER_BIT = uint8_t(1) << size_t(Program::Shader::FRAGMENT);
+    static constexpr uint8_t COMPUTE_SHADER_BIT  = uint8_t(1) << size_t(Program::Shader::COMPUTE);
 
     struct BlockInfo {
         uint8_t binding : 3;    // binding (i.e.: index in mSamplerBindings)
@@ -85,9 +103,27 @@ private:
         static_assert(Program::NUM_SAMPLER_BINDINGS <= 8, "NUM_SAMPLER_BINDINGS must be <= 8");
     };
 
+    // key of a program binary in the BlobCache
+    struct ProgramBinaryKey {
+        uint64_t driver;                                // OpenGLDriver::mProgramBinaryKey
+        uint64_t sources[Program::NUM_SHADER_TYPES];    // hash of each shader's source
+    };
+
+    // what we need to finish initializing the program once it's linked, this is freed afterwards
+    struct LazyInitializationData {
+        // whether the program binary must be added to the BlobCache once it's linked
+        bool storeBinary = false;
+        ProgramBinaryKey binaryKey;
+        std::array<utils::CString, Program::NUM_SHADER_TYPES> shadersSource;
+        std::array<utils::CString, Program::NUM_UNIFORM_BINDINGS> uniformBlockNames;
+        // names of the sampler uniforms of each binding, in the order of the SamplerBuffer
+        std::array<std::vector<std::string>, Program::NUM_SAMPLER_BINDINGS> samplerNames;
+    };
+
     uint8_t mUsedBindingsCount = 0;
     uint8_t mValidShaderSet = 0;
     bool mIsValid = false;
+    std::unique_ptr<LazyInitializationData> mLazyInitializationData;
 
     // information about each USED sampler buffer (no gaps)
     std::array<BlockInfo, Program::NUM_SAMPLER_BINDINGS> mBlockInfos;   // 8 bytes
@@ -95,6 +131,15 @@ private:
     // runs of indices into SamplerBuffer -- run start index and size given by BlockInfo
     std::array<uint8_t, NUM_TEXTURE_UNITS> mIndicesRuns;    // 16 bytes
 
+    // generation of each used sampler buffer, and version of the texture units, as of the last
+    // updateSamplers() which bound them
+    std::array<uint32_t, Program::NUM_SAMPLER_BINDINGS> mSamplerGenerations = {};   // 32 bytes
+    uint32_t mTexturesVersion = 0;
+
+    bool checkStatus(OpenGLDriver* gl, bool wait = false) noexcept;
+    bool loadBinary(OpenGLDriver* gl, ProgramBinaryKey const& key) noexcept;
+    void storeBinary(OpenGLDriver* gl, ProgramBinaryKey const& key) noexcept;
+    void initialize(OpenGLDriver* gl) noexcept;
     void updateSamplers(OpenGLDriver* gl) noexcept;
 };
 
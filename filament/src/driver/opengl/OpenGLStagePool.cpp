@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "driver/opengl/OpenGLStagePool.h"
+
+#include "driver/opengl/OpenGLDriver.h"
+
+#include <assert.h>
+
+namespace filament {
+
+OpenGLStage* OpenGLStagePool::acquireStage(uint32_t numBytes) noexcept {
+    // First check if a stage exists whose capacity is greater than or equal to the requested size
+    // and that the GPU is not reading anymore.
+    for (auto iter = mFreeStages.lower_bound(numBytes); iter != mFreeStages.end(); ++iter) {
+        OpenGLStage* stage = iter->second;
+        if (stage->fence) {
+            if (glClientWaitSync(stage->fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+                continue;
+            }
+            glDeleteSync(stage->fence);
+            stage->fence = 0;
+        }
+        mFreeStages.erase(iter);
+        mDriver.bindUnpackBuffer(stage->buffer);
+        return stage;
+    }
+
+    // We were not able to find a sufficiently large stage, so create a new one.
+    const uint32_t capacity = (numBytes + STAGE_GRANULARITY - 1) & ~(STAGE_GRANULARITY - 1);
+    OpenGLStage* stage = new OpenGLStage{ 0, capacity, 0, mCurrentFrame };
+    glGenBuffers(1, &stage->buffer);
+    mDriver.bindUnpackBuffer(stage->buffer);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, GLsizeiptr(capacity), nullptr, GL_STREAM_DRAW);
+    return stage;
+}
+
+void OpenGLStagePool::releaseStage(OpenGLStage* stage) noexcept {
+    assert(!stage->fence);
+    stage->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    stage->lastAccessed = mCurrentFrame;
+    mFreeStages.insert(std::make_pair(stage->capacity, stage));
+}
+
+void OpenGLStagePool::gc() noexcept {
+    mCurrentFrame++;
+    decltype(mFreeStages) stages;
+    stages.swap(mFreeStages);
+    for (auto pair : stages) {
+        if (pair.second->lastAccessed + TIME_BEFORE_EVICTION < mCurrentFrame) {
+            destroyStage(pair.second);
+        } else {
+            mFreeStages.insert(pair);
+        }
+    }
+}
+
+void OpenGLStagePool::reset() noexcept {
+    for (auto pair : mFreeStages) {
+        destroyStage(pair.second);
+    }
+    mFreeStages.clear();
+}
+
+void OpenGLStagePool::destroyStage(OpenGLStage* stage) noexcept {
+    // deleting a buffer resets its binding
+    mDriver.bindUnpackBuffer(0);
+    glDeleteBuffers(1, &stage->buffer);
+    if (stage->fence) {
+        glDeleteSync(stage->fence);
+    }
+    delete stage;
+}
+
+} // namespace filament
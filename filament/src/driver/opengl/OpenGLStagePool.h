@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DRIVER_OPENGLSTAGEPOOL_H
+#define TNT_FILAMENT_DRIVER_OPENGLSTAGEPOOL_H
+
+#include "driver/opengl/gl_headers.h"
+
+#include <map>
+
+#include <stdint.h>
+
+namespace filament {
+
+class OpenGLDriver;
+
+// A pixel unpack buffer used to stage texture uploads.
+struct OpenGLStage {
+    GLuint buffer;
+    uint32_t capacity;
+    GLsync fence;              // signaled when the GPU is done reading the stage
+    uint64_t lastAccessed;
+};
+
+// Manages a pool of stages, periodically releasing stages that have been unused for a while.
+class OpenGLStagePool {
+public:
+    explicit OpenGLStagePool(OpenGLDriver& driver) noexcept : mDriver(driver) {}
+
+    // Finds or creates a stage whose capacity is at least the given number of bytes and that the
+    // GPU is done with. The stage is bound to GL_PIXEL_UNPACK_BUFFER.
+    OpenGLStage* acquireStage(uint32_t numBytes) noexcept;
+
+    // Returns the given stage back to the pool, this must be called after the commands reading
+    // from it are issued.
+    void releaseStage(OpenGLStage* stage) noexcept;
+
+    // Evicts old unused stages and bumps the current frame number.
+    void gc() noexcept;
+
+    // Destroys all the stages.
+    void reset() noexcept;
+
+private:
+    void destroyStage(OpenGLStage* stage) noexcept;
+
+    OpenGLDriver& mDriver;
+
+    // Use an ordered multimap for quick (capacity => stage) lookups using lower_bound().
+    std::multimap<uint32_t, OpenGLStage*> mFreeStages;
+
+    // Store the current "time" (really just a frame count) and LRU eviction parameters.
+    uint64_t mCurrentFrame = 0;
+    static constexpr uint32_t TIME_BEFORE_EVICTION = 2;
+
+    // stages are allocated in multiples of this size so that they can be reused more often
+    static constexpr uint32_t STAGE_GRANULARITY = 64 * 1024;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_DRIVER_OPENGLSTAGEPOOL_H
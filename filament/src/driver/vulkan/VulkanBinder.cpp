@@ -40,8 +40,25 @@ static constexpr VkAllocationCallbacks* VKALLOC = nullptr;
 // - Allow multiple descriptors to bind simultaneously; organize binding points into groups.
 static constexpr uint32_t MAX_NUM_DESCRIPTORS = 1000;
 
+// Maximum number of descriptor sets of each pool of the per-frame arenas.
+static constexpr uint32_t TRANSIENT_POOL_SIZE = 256;
+
 static VulkanBinder::RasterState createDefaultRasterState();
 
+// The input attachment is declared by the shaders at this binding, right after the samplers.
+static constexpr uint32_t INPUT_ATTACHMENT_BINDING =
+        VulkanBinder::NUM_UBUFFER_BINDINGS + VulkanBinder::NUM_SAMPLER_BINDINGS;
+static_assert(INPUT_ATTACHMENT_BINDING == filament::SUBPASS_INPUT_BINDING,
+        "The input attachment binding doesn't match the shaders.");
+
+// The storage buffers are declared by the shaders right after the input attachment.
+static constexpr uint32_t STORAGE_BUFFER_BINDING = INPUT_ATTACHMENT_BINDING + 1;
+static_assert(STORAGE_BUFFER_BINDING == filament::STORAGE_BINDING,
+        "The storage buffer bindings don't match the shaders.");
+
+static constexpr uint32_t NUM_BINDINGS = VulkanBinder::NUM_UBUFFER_BINDINGS +
+        VulkanBinder::NUM_SAMPLER_BINDINGS + 1 + VulkanBinder::NUM_STORAGE_BINDINGS;
+
 VulkanBinder::VulkanBinder() : mDefaultRasterState(createDefaultRasterState()) {
     mColorBlendState = VkPipelineColorBlendStateCreateInfo{};
     mColorBlendState.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
@@ -55,6 +72,20 @@ VulkanBinder::VulkanBinder() : mDefaultRasterState(createDefaultRasterState()) {
     mShaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     mShaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
     mShaderStages[1].pName = "main";
+    for (uint32_t i = 0; i < SpecializationConstants::COUNT; i++) {
+        mSpecializationEntries[i].constantID = i;
+        mSpecializationEntries[i].offset = i * sizeof(VkBool32);
+        mSpecializationEntries[i].size = sizeof(VkBool32);
+    }
+    mSpecializationInfo = VkSpecializationInfo{};
+    mSpecializationInfo.mapEntryCount = SpecializationConstants::COUNT;
+    mSpecializationInfo.pMapEntries = mSpecializationEntries;
+    mSpecializationInfo.dataSize = sizeof(mSpecializationData);
+    mSpecializationInfo.pData = mSpecializationData;
+    mShaderStages[0].pSpecializationInfo = &mSpecializationInfo;
+    mShaderStages[1].pSpecializationInfo = &mSpecializationInfo;
+    mPipelineKey.specialization = 0;
+    mPipelineKey.padding = 0;
     resetBindings();
 }
 
@@ -71,12 +102,22 @@ bool VulkanBinder::getOrCreateDescriptor(VkDescriptorSet* descriptor,
 
     // If no bindings have been dirtied, update the timestamp (most recent access) and return false
     // to indicate there's no need to re-bind.
+    // Changing only the dynamic offsets requires binding the same descriptor set again.
     if (!mDirtyDescriptor) {
         assert(mCurrentDescriptor && mCurrentDescriptor->bound);
         *descriptor = mCurrentDescriptor->handle;
         mCurrentDescriptor->timestamp = mCurrentTime;
+        if (mDirtyDynamicOffsets) {
+            mDirtyDynamicOffsets = false;
+            *pipelineLayout = mPipelineLayout;
+            if (changes) {
+                *changes = nullptr;
+            }
+            return true;
+        }
         return false;
     }
+    mDirtyDynamicOffsets = false;
 
     // Release the previously bound descriptor and update its time stamp.
     if (mCurrentDescriptor) {
@@ -87,38 +128,49 @@ bool VulkanBinder::getOrCreateDescriptor(VkDescriptorSet* descriptor,
     // If a cached object exists, update the timestamp (most recent access) and return true to
     // indicate that the caller should call vmCmdBind. Note that robin_map iterators proffer a
     // value method for obtaining a stable reference.
+    // A transient set found in the cache is only returned during the frame which allocated it,
+    // because its arena is going to be reset. Otherwise, the set is long-lived and it's allocated
+    // again from the long-lived pool.
+    bool longLived = false;
     auto iter = mDescriptorSets.find(mDescriptorKey);
     if (UTILS_LIKELY(iter != mDescriptorSets.end())) {
-        mCurrentDescriptor = &iter.value();
-        *descriptor = mCurrentDescriptor->handle;
-        mCurrentDescriptor->timestamp = mCurrentTime;
-        mCurrentDescriptor->bound = true;
-        mDirtyDescriptor = false;
-        *pipelineLayout = mPipelineLayout;
-        if (changes) {
-            *changes = nullptr;
+        DescriptorVal& val = iter.value();
+        if (UTILS_LIKELY(!val.transient || val.frame == mCurrentTime)) {
+            mCurrentDescriptor = &val;
+            *descriptor = mCurrentDescriptor->handle;
+            mCurrentDescriptor->timestamp = mCurrentTime;
+            mCurrentDescriptor->bound = true;
+            mDirtyDescriptor = false;
+            *pipelineLayout = mPipelineLayout;
+            if (changes) {
+                *changes = nullptr;
+            }
+            return true;
         }
-        return true;
+        mDescriptorSets.erase(iter);
+        longLived = true;
     }
 
     // If we reach this point, we need to create and stash a brand new descriptor set.
-    ASSERT_POSTCONDITION(mDescriptorSets.size() < MAX_NUM_DESCRIPTORS, "Too many descriptors.");
-
-    // Allocate descriptor (does not need explicit destruction)
-    VkDescriptorSetAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = mDescriptorPool;
-    allocInfo.descriptorSetCount = 1;
-    allocInfo.pSetLayouts = &mDescriptorSetLayout;
-    VkResult err = vkAllocateDescriptorSets(mDevice, &allocInfo, descriptor);
-    ASSERT_POSTCONDITION(!err, "Unable to allocate descriptor set.");
+    if (longLived) {
+        // Allocate descriptor (does not need explicit destruction)
+        VkDescriptorSetAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = mDescriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &mDescriptorSetLayout;
+        VkResult err = vkAllocateDescriptorSets(mDevice, &allocInfo, descriptor);
+        ASSERT_POSTCONDITION(!err, "Unable to allocate descriptor set.");
+    } else {
+        *descriptor = allocateTransientDescriptor();
+    }
     *pipelineLayout = mPipelineLayout;
 
     // Here we construct a DescriptorVal in place, then stash its pointer to allow fast subsequent
     // calls to getOrCreateDescriptor when nothing has been dirtied. Note that the robin_map
     // iterator type proffers a "value" method, which returns a stable reference.
     mCurrentDescriptor = &mDescriptorSets.emplace(std::make_pair(mDescriptorKey, DescriptorVal {
-        *descriptor, mCurrentTime, true })).first.value();
+        *descriptor, mCurrentTime, true, !longLived, mCurrentTime })).first.value();
     mDirtyDescriptor = false;
 
     // Mutate the descriptor by setting all non-null bindings.
@@ -130,7 +182,7 @@ bool VulkanBinder::getOrCreateDescriptor(VkDescriptorSet* descriptor,
             VkDescriptorBufferInfo& bufferInfo = mDescriptorBuffers[binding];
             bufferInfo.buffer = mDescriptorKey.uniformBuffers[binding];
             bufferInfo.offset = 0;
-            bufferInfo.range = VK_WHOLE_SIZE;
+            bufferInfo.range = mDescriptorKey.uniformBufferSizes[binding];
             VkWriteDescriptorSet& writeInfo = writes[nwrites++];
             writeInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
             writeInfo.pNext = nullptr;
@@ -138,7 +190,7 @@ bool VulkanBinder::getOrCreateDescriptor(VkDescriptorSet* descriptor,
             writeInfo.dstBinding = binding;
             writeInfo.dstArrayElement = 0;
             writeInfo.descriptorCount = 1;
-            writeInfo.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            writeInfo.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
             writeInfo.pImageInfo = nullptr;
             writeInfo.pBufferInfo = &bufferInfo;
             writeInfo.pTexelBufferView = nullptr;
@@ -161,6 +213,43 @@ bool VulkanBinder::getOrCreateDescriptor(VkDescriptorSet* descriptor,
             writeInfo.pTexelBufferView = nullptr;
         }
     }
+    if (mDescriptorKey.inputAttachment) {
+        VkDescriptorImageInfo& imageInfo = mDescriptorInputAttachment;
+        imageInfo = {
+            .imageView = mDescriptorKey.inputAttachment,
+            .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+        };
+        VkWriteDescriptorSet& writeInfo = writes[nwrites++];
+        writeInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeInfo.pNext = nullptr;
+        writeInfo.dstSet = mCurrentDescriptor->handle;
+        writeInfo.dstBinding = INPUT_ATTACHMENT_BINDING;
+        writeInfo.dstArrayElement = 0;
+        writeInfo.descriptorCount = 1;
+        writeInfo.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        writeInfo.pImageInfo = &imageInfo;
+        writeInfo.pBufferInfo = nullptr;
+        writeInfo.pTexelBufferView = nullptr;
+    }
+    for (uint32_t binding = 0; binding < NUM_STORAGE_BINDINGS; binding++) {
+        if (mDescriptorKey.storageBuffers[binding]) {
+            VkDescriptorBufferInfo& bufferInfo = mDescriptorStorageBuffers[binding];
+            bufferInfo.buffer = mDescriptorKey.storageBuffers[binding];
+            bufferInfo.offset = 0;
+            bufferInfo.range = VK_WHOLE_SIZE;
+            VkWriteDescriptorSet& writeInfo = writes[nwrites++];
+            writeInfo.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writeInfo.pNext = nullptr;
+            writeInfo.dstSet = mCurrentDescriptor->handle;
+            writeInfo.dstBinding = STORAGE_BUFFER_BINDING + binding;
+            writeInfo.dstArrayElement = 0;
+            writeInfo.descriptorCount = 1;
+            writeInfo.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writeInfo.pImageInfo = nullptr;
+            writeInfo.pBufferInfo = &bufferInfo;
+            writeInfo.pTexelBufferView = nullptr;
+        }
+    }
     if (changes) {
         *changes = &mDescriptorUpdateOp;
     } else {
@@ -205,6 +294,11 @@ bool VulkanBinder::getOrCreatePipeline(VkPipeline* pipeline) noexcept {
     mShaderStages[0].module = mPipelineKey.shaders[0];
     mShaderStages[1].module = mPipelineKey.shaders[1];
 
+    // Both stages see the same constants, the ones a module doesn't declare are ignored.
+    for (uint32_t i = 0; i < SpecializationConstants::COUNT; i++) {
+        mSpecializationData[i] = (mPipelineKey.specialization & (1u << i)) ? VK_TRUE : VK_FALSE;
+    }
+
     // We don't store array sizes to save space, but it's quick to count all non-zero
     // entries because these arrays have a small fixed-size capacity.
     uint32_t numVertexAttribs = 0;
@@ -227,7 +321,7 @@ bool VulkanBinder::getOrCreatePipeline(VkPipeline* pipeline) noexcept {
 
     VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = {};
     inputAssemblyState.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssemblyState.topology = mPipelineKey.topology;
+    inputAssemblyState.topology = (VkPrimitiveTopology) mPipelineKey.topology;
 
     VkPipelineViewportStateCreateInfo viewportState = {};
     viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
@@ -249,6 +343,7 @@ bool VulkanBinder::getOrCreatePipeline(VkPipeline* pipeline) noexcept {
     pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
     pipelineCreateInfo.layout = mPipelineLayout;
     pipelineCreateInfo.renderPass = mPipelineKey.renderPass;
+    pipelineCreateInfo.subpass = mPipelineKey.subpassIndex;
     pipelineCreateInfo.stageCount = hasFragmentShader ? NUM_SHADER_MODULES : 1;
     pipelineCreateInfo.pStages = mShaderStages;
     pipelineCreateInfo.pVertexInputState = &vertexInputState;
@@ -268,12 +363,13 @@ bool VulkanBinder::getOrCreatePipeline(VkPipeline* pipeline) noexcept {
             << mShaderStages[0].module << ", " << mShaderStages[1].module << ")" << utils::io::endl;
     #endif
 
-    VkResult err = vkCreateGraphicsPipelines(mDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo,
+    VkResult err = vkCreateGraphicsPipelines(mDevice, mPipelineCache, 1, &pipelineCreateInfo,
             VKALLOC, pipeline);
     if (err) {
         utils::slog.e << "vkCreateGraphicsPipelines error " << err << utils::io::endl;
         utils::debug_trap();
     }
+    mCreatedPipelineCount++;
 
     // Here we construct a PipelineVal in place, then stash its pointer to allow fast subsequent
     // calls to getOrCreatePipeline when nothing has been dirtied. Note that the robin_map
@@ -292,6 +388,10 @@ void VulkanBinder::bindProgramBundle(const ProgramBundle& bundle) noexcept {
             mPipelineKey.shaders[ssi] = shaders[ssi];
         }
     }
+    if (mPipelineKey.specialization != bundle.specialization) {
+        mDirtyPipeline = true;
+        mPipelineKey.specialization = bundle.specialization;
+    }
 }
 
 void VulkanBinder::bindRasterState(const RasterState& rasterState) noexcept {
@@ -321,17 +421,18 @@ void VulkanBinder::bindRasterState(const RasterState& rasterState) noexcept {
     }
 }
 
-void VulkanBinder::bindRenderPass(VkRenderPass renderPass) noexcept {
-    if (mPipelineKey.renderPass != renderPass) {
+void VulkanBinder::bindRenderPass(VkRenderPass renderPass, uint32_t subpassIndex) noexcept {
+    if (mPipelineKey.renderPass != renderPass || mPipelineKey.subpassIndex != subpassIndex) {
         mDirtyPipeline = true;
         mPipelineKey.renderPass = renderPass;
+        mPipelineKey.subpassIndex = (uint16_t) subpassIndex;
     }
 }
 
 void VulkanBinder::bindPrimitiveTopology(VkPrimitiveTopology topology) noexcept {
     if (mPipelineKey.topology != topology) {
         mDirtyPipeline = true;
-        mPipelineKey.topology = topology;
+        mPipelineKey.topology = (uint16_t) topology;
     }
 }
 
@@ -362,6 +463,14 @@ void VulkanBinder::unbindUniformBuffer(VkBuffer uniformBuffer) noexcept {
     for (uint32_t bindingIndex = 0u; bindingIndex < NUM_UBUFFER_BINDINGS; ++bindingIndex) {
         if (mDescriptorKey.uniformBuffers[bindingIndex] == uniformBuffer) {
             mDescriptorKey.uniformBuffers[bindingIndex] = VK_NULL_HANDLE;
+            mDescriptorKey.uniformBufferSizes[bindingIndex] = VK_WHOLE_SIZE;
+            mDynamicOffsets[bindingIndex] = 0;
+            mDirtyDescriptor = true;
+        }
+    }
+    for (uint32_t bindingIndex = 0u; bindingIndex < NUM_STORAGE_BINDINGS; ++bindingIndex) {
+        if (mDescriptorKey.storageBuffers[bindingIndex] == uniformBuffer) {
+            mDescriptorKey.storageBuffers[bindingIndex] = VK_NULL_HANDLE;
             mDirtyDescriptor = true;
         }
     }
@@ -371,6 +480,11 @@ void VulkanBinder::unbindUniformBuffer(VkBuffer uniformBuffer) noexcept {
                 return true;
             }
         }
+        for (VkBuffer buf : key.storageBuffers) {
+            if (buf == uniformBuffer) {
+                return true;
+            }
+        }
         return false;
     });
 }
@@ -384,26 +498,34 @@ void VulkanBinder::unbindImageView(VkImageView imageView) noexcept {
             mDirtyDescriptor = true;
         }
     }
+    if (mDescriptorKey.inputAttachment == imageView) {
+        mDescriptorKey.inputAttachment = VK_NULL_HANDLE;
+        mDirtyDescriptor = true;
+    }
     evictDescriptors([imageView] (const DescriptorKey& key) {
         for (const auto& binding : key.samplers) {
             if (binding.imageView == imageView) {
                 return true;
             }
         }
-        return false;
+        return key.inputAttachment == imageView;
     });
 }
 
 // Discards all descriptor sets that pass the given filter. Immediately removes the cache entries,
 // but defers calling vkFreeDescriptorSets until the next eviction cycle.
-void VulkanBinder::evictDescriptors(std::function<bool(const DescriptorKey&)> filter) noexcept {
+template<typename Filter>
+void VulkanBinder::evictDescriptors(Filter filter) noexcept {
     // Due to robin_map restrictions, we cannot use auto or a range-based loop.
     decltype(mDescriptorSets)::const_iterator iter;
     for (iter = mDescriptorSets.begin(); iter != mDescriptorSets.end();) {
         auto& pair = *iter;
         if (filter(pair.first)) {
+            // transient sets are reclaimed along with their arena
             auto& cacheEntry = iter->second;
-            mDescriptorGraveyard.push_back({ cacheEntry.handle, cacheEntry.timestamp, false });
+            if (!cacheEntry.transient) {
+                mDescriptorGraveyard.push_back({ cacheEntry.handle, cacheEntry.timestamp, false });
+            }
             iter = mDescriptorSets.erase(iter);
         } else {
             ++iter;
@@ -411,12 +533,19 @@ void VulkanBinder::evictDescriptors(std::function<bool(const DescriptorKey&)> fi
     }
 }
 
-void VulkanBinder::bindUniformBuffer(uint32_t bindingIndex, VkBuffer uniformBuffer) noexcept {
+void VulkanBinder::bindUniformBuffer(uint32_t bindingIndex, VkBuffer uniformBuffer,
+        VkDeviceSize offset, VkDeviceSize size) noexcept {
     assert(bindingIndex < NUM_UBUFFER_BINDINGS);
-    if (mDescriptorKey.uniformBuffers[bindingIndex] != uniformBuffer) {
+    if (mDescriptorKey.uniformBuffers[bindingIndex] != uniformBuffer ||
+        mDescriptorKey.uniformBufferSizes[bindingIndex] != size) {
         mDescriptorKey.uniformBuffers[bindingIndex] = uniformBuffer;
+        mDescriptorKey.uniformBufferSizes[bindingIndex] = size;
         mDirtyDescriptor = true;
     }
+    if (mDynamicOffsets[bindingIndex] != offset) {
+        mDynamicOffsets[bindingIndex] = (uint32_t) offset;
+        mDirtyDynamicOffsets = true;
+    }
 }
 
 void VulkanBinder::bindSampler(uint32_t bindingIndex, VkDescriptorImageInfo samplerInfo) noexcept {
@@ -431,6 +560,21 @@ void VulkanBinder::bindSampler(uint32_t bindingIndex, VkDescriptorImageInfo samp
     }
 }
 
+void VulkanBinder::bindInputAttachment(VkImageView imageView) noexcept {
+    if (mDescriptorKey.inputAttachment != imageView) {
+        mDescriptorKey.inputAttachment = imageView;
+        mDirtyDescriptor = true;
+    }
+}
+
+void VulkanBinder::bindStorageBuffer(uint32_t bindingIndex, VkBuffer storageBuffer) noexcept {
+    assert(bindingIndex < NUM_STORAGE_BINDINGS);
+    if (mDescriptorKey.storageBuffers[bindingIndex] != storageBuffer) {
+        mDescriptorKey.storageBuffers[bindingIndex] = storageBuffer;
+        mDirtyDescriptor = true;
+    }
+}
+
 void VulkanBinder::destroyCache() noexcept {
     // Symmetric to createLayoutsAndDescriptors.
     destroyLayoutsAndDescriptors();
@@ -445,6 +589,7 @@ void VulkanBinder::destroyCache() noexcept {
 void VulkanBinder::resetBindings() noexcept {
     mDirtyPipeline = true;
     mDirtyDescriptor = true;
+    mDirtyDynamicOffsets = true;
 }
 
 // Frees up old descriptor sets and pipelines, then nulls out their key.
@@ -458,11 +603,15 @@ void VulkanBinder::gc() noexcept {
         return;
     }
     const uint32_t evictTime = mCurrentTime - TIME_BEFORE_EVICTION;
+
+    // The frame which last used the arena of this frame is old enough for its sets to be reclaimed.
+    resetDescriptorArena(mCurrentTime - NUM_DESCRIPTOR_ARENAS);
+
     // Due to robin_map restrictions, we cannot use auto or a range-based loop.
     for (decltype(mDescriptorSets)::const_iterator iter = mDescriptorSets.begin();
             iter != mDescriptorSets.end();) {
         auto& cacheEntry = iter->second;
-        if (cacheEntry.timestamp < evictTime && !cacheEntry.bound) {
+        if (cacheEntry.timestamp < evictTime && !cacheEntry.bound && !cacheEntry.transient) {
             vkFreeDescriptorSets(mDevice, mDescriptorPool, 1, &cacheEntry.handle);
             iter = mDescriptorSets.erase(iter);
         } else {
@@ -497,13 +646,13 @@ void VulkanBinder::gc() noexcept {
 }
 
 void VulkanBinder::createLayoutsAndDescriptors() noexcept {
-    VkDescriptorSetLayoutBinding bindings[NUM_UBUFFER_BINDINGS + NUM_SAMPLER_BINDINGS];
+    VkDescriptorSetLayoutBinding bindings[NUM_BINDINGS];
     VkDescriptorSetLayoutBinding binding = {};
     binding.descriptorCount = 1; // NOTE: We never use arrays-of-blocks.
     binding.stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS; // NOTE: This is potentially non-optimal.
 
     // The first range of binding slots is reserved for UBO's.
-    binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     for (uint32_t i = 0; i < NUM_UBUFFER_BINDINGS; i++) {
         binding.binding = i;
         bindings[i] = binding;
@@ -516,10 +665,23 @@ void VulkanBinder::createLayoutsAndDescriptors() noexcept {
         bindings[binding.binding] = binding;
     }
 
+    // The last slot is the input attachment, which can only be read by fragment shaders.
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+    binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    binding.binding = INPUT_ATTACHMENT_BINDING;
+    bindings[binding.binding] = binding;
+
+    // The storage buffers follow, they're also only read by fragment shaders.
+    binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    for (uint32_t i = 0; i < NUM_STORAGE_BINDINGS; i++) {
+        binding.binding = STORAGE_BUFFER_BINDING + i;
+        bindings[binding.binding] = binding;
+    }
+
     // Create the one and only VkDescriptorSetLayout that we'll ever use.
     VkDescriptorSetLayoutCreateInfo dlinfo = {};
     dlinfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    dlinfo.bindingCount = NUM_UBUFFER_BINDINGS + NUM_SAMPLER_BINDINGS;
+    dlinfo.bindingCount = NUM_BINDINGS;
     dlinfo.pBindings = &bindings[0];
     VkResult err = vkCreateDescriptorSetLayout(mDevice, &dlinfo, VKALLOC, &mDescriptorSetLayout);
     ASSERT_POSTCONDITION(!err, "Unable to create descriptor set layout.");
@@ -532,21 +694,82 @@ void VulkanBinder::createLayoutsAndDescriptors() noexcept {
     err = vkCreatePipelineLayout(mDevice, &pPipelineLayoutCreateInfo, VKALLOC, &mPipelineLayout);
     ASSERT_POSTCONDITION(!err, "Unable to create pipeline layout.");
 
-    // Create the VkDescriptorPool.
-    VkDescriptorPoolSize poolSizes[2] = {};
+    // Create the VkDescriptorPool of the long-lived descriptor sets. The pools of the arenas are
+    // created on demand.
+    mDescriptorPool = createDescriptorPool(MAX_NUM_DESCRIPTORS,
+            VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT);
+}
+
+VkDescriptorPool VulkanBinder::createDescriptorPool(uint32_t maxSets,
+        VkDescriptorPoolCreateFlags flags) noexcept {
+    VkDescriptorPoolSize poolSizes[4] = {};
     VkDescriptorPoolCreateInfo poolInfo {
         .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
-        .poolSizeCount = 2,
+        .poolSizeCount = 4,
         .pPoolSizes = &poolSizes[0],
-        .maxSets = MAX_NUM_DESCRIPTORS,
-        .flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT
+        .maxSets = maxSets,
+        .flags = flags
     };
-    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
     poolSizes[0].descriptorCount = poolInfo.maxSets * NUM_UBUFFER_BINDINGS;
     poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     poolSizes[1].descriptorCount = poolInfo.maxSets * NUM_SAMPLER_BINDINGS;
-    err = vkCreateDescriptorPool(mDevice, &poolInfo, VKALLOC, &mDescriptorPool);
+    poolSizes[2].type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+    poolSizes[2].descriptorCount = poolInfo.maxSets;
+    poolSizes[3].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSizes[3].descriptorCount = poolInfo.maxSets * NUM_STORAGE_BINDINGS;
+    VkDescriptorPool pool;
+    VkResult err = vkCreateDescriptorPool(mDevice, &poolInfo, VKALLOC, &pool);
     ASSERT_POSTCONDITION(!err, "Unable to create descriptor pool.");
+    return pool;
+}
+
+// Allocates a descriptor set from the arena of the current frame, adding a pool when it's full.
+VkDescriptorSet VulkanBinder::allocateTransientDescriptor() noexcept {
+    DescriptorArena& arena = mDescriptorArenas[mCurrentTime % NUM_DESCRIPTOR_ARENAS];
+    if (arena.count == TRANSIENT_POOL_SIZE) {
+        arena.current++;
+        arena.count = 0;
+    }
+    if (arena.current == arena.pools.size()) {
+        arena.pools.push_back(createDescriptorPool(TRANSIENT_POOL_SIZE, 0));
+    }
+    VkDescriptorSetAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = arena.pools[arena.current];
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &mDescriptorSetLayout;
+    VkDescriptorSet descriptor;
+    VkResult err = vkAllocateDescriptorSets(mDevice, &allocInfo, &descriptor);
+    ASSERT_POSTCONDITION(!err, "Unable to allocate descriptor set.");
+    arena.count++;
+    return descriptor;
+}
+
+// Removes the transient sets of the given frame from the cache, and resets the pools of its arena.
+void VulkanBinder::resetDescriptorArena(uint32_t frame) noexcept {
+    DescriptorArena& arena = mDescriptorArenas[frame % NUM_DESCRIPTOR_ARENAS];
+    if (arena.current == 0 && arena.count == 0) {
+        return;
+    }
+    for (decltype(mDescriptorSets)::const_iterator iter = mDescriptorSets.begin();
+            iter != mDescriptorSets.end();) {
+        auto& cacheEntry = iter->second;
+        if (cacheEntry.transient && cacheEntry.frame == frame) {
+            if (&cacheEntry == mCurrentDescriptor) {
+                mCurrentDescriptor = nullptr;
+                mDirtyDescriptor = true;
+            }
+            iter = mDescriptorSets.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+    for (uint32_t i = 0; i <= arena.current && i < arena.pools.size(); i++) {
+        vkResetDescriptorPool(mDevice, arena.pools[i], 0);
+    }
+    arena.current = 0;
+    arena.count = 0;
 }
 
 void VulkanBinder::destroyLayoutsAndDescriptors() noexcept {
@@ -568,6 +791,12 @@ void VulkanBinder::destroyLayoutsAndDescriptors() noexcept {
     mDescriptorSetLayout = VK_NULL_HANDLE;
     vkDestroyDescriptorPool(mDevice, mDescriptorPool, VKALLOC);
     mDescriptorPool = VK_NULL_HANDLE;
+    for (DescriptorArena& arena : mDescriptorArenas) {
+        for (VkDescriptorPool pool : arena.pools) {
+            vkDestroyDescriptorPool(mDevice, pool, VKALLOC);
+        }
+        arena = {};
+    }
     mCurrentDescriptor = nullptr;
     mDirtyDescriptor = true;
 }
@@ -580,7 +809,8 @@ bool VulkanBinder::PipelineEqual::operator()(const VulkanBinder::PipelineKey& k1
 bool VulkanBinder::DescEqual::operator()(const VulkanBinder::DescriptorKey& k1,
         const VulkanBinder::DescriptorKey& k2) const {
     for (uint32_t i = 0; i < NUM_UBUFFER_BINDINGS; i++) {
-        if (k1.uniformBuffers[i] != k2.uniformBuffers[i]) {
+        if (k1.uniformBuffers[i] != k2.uniformBuffers[i] ||
+            k1.uniformBufferSizes[i] != k2.uniformBufferSizes[i]) {
             return false;
         }
     }
@@ -591,7 +821,12 @@ bool VulkanBinder::DescEqual::operator()(const VulkanBinder::DescriptorKey& k1,
             return false;
         }
     }
-    return true;
+    for (uint32_t i = 0; i < NUM_STORAGE_BINDINGS; i++) {
+        if (k1.storageBuffers[i] != k2.storageBuffers[i]) {
+            return false;
+        }
+    }
+    return k1.inputAttachment == k2.inputAttachment;
 }
 
 static VulkanBinder::RasterState createDefaultRasterState() {
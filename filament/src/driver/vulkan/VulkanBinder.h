@@ -66,14 +66,24 @@ namespace driver {
 // - Descriptor sets are never mutated using vkUpdateDescriptorSets, except upon creation.
 // - Assumes that viewport and scissor should be dynamic. (not baked into VkPipeline)
 // - Assumes that uniform buffers should be visible across all shader stages.
+// - Uniform buffers are always dynamic, their offsets are not part of the descriptor set and must
+//   be passed to vkCmdBindDescriptorSets (see getDynamicOffsets).
+// - There is at most one input attachment, which follows the samplers.
+// - Storage buffers follow the input attachment, they're read-only and only visible to fragment
+//   shaders. Their offset is always zero.
 //
 class VulkanBinder {
 public:
     static constexpr uint32_t NUM_UBUFFER_BINDINGS = filament::BindingPoints::COUNT;
-    static constexpr uint32_t NUM_SAMPLER_BINDINGS = 8;
+    static constexpr uint32_t NUM_SAMPLER_BINDINGS = 16;
+    static constexpr uint32_t NUM_STORAGE_BINDINGS = filament::StorageBindingPoints::COUNT;
     static constexpr uint32_t NUM_SHADER_MODULES = 2;
     static constexpr uint32_t MAX_VERTEX_ATTRIBUTES = filament::ATTRIBUTE_INDEX_COUNT;
 
+    // Unused descriptor sets and pipelines are evicted after this many frames, which must be at
+    // least the number of frames in flight.
+    static constexpr uint32_t TIME_BEFORE_EVICTION = 3;
+
     // The VertexArray POD is an array of buffer targets and an array of attributes that refer to
     // those targets. It does not include any references to actual buffers, so you can think of it
     // as a vertex assembler configuration. For simplicity it contains fixed-size arrays and does
@@ -83,10 +93,12 @@ public:
         VkVertexInputBindingDescription buffers[MAX_VERTEX_ATTRIBUTES];
     };
 
-    // The ProgramBundle contains weak references to the compiled vertex and fragment shaders.
+    // The ProgramBundle contains weak references to the compiled vertex and fragment shaders,
+    // and the values of their specialization constants (bit k is the value of constant k).
     struct ProgramBundle {
         VkShaderModule vertex;
         VkShaderModule fragment;
+        uint32_t specialization;
     };
 
     // The RasterState POD contains standard graphics-related state like blending, culling, etc.
@@ -103,7 +115,8 @@ public:
     // Encapsulates the arguments passed to vkUpdateDescriptorSets.
     struct DescriptorUpdateOp {
         uint32_t count;
-        VkWriteDescriptorSet writes[NUM_UBUFFER_BINDINGS + NUM_SAMPLER_BINDINGS];
+        VkWriteDescriptorSet writes[
+                NUM_UBUFFER_BINDINGS + NUM_SAMPLER_BINDINGS + 1 + NUM_STORAGE_BINDINGS];
     };
 
     // Upon construction, the binder initializes some internal state but does not make any Vulkan
@@ -114,28 +127,44 @@ public:
     ~VulkanBinder();
     void setDevice(VkDevice device) { mDevice = device; }
 
+    // Sets the cache used to create the pipelines, or VK_NULL_HANDLE for none. Pipelines created
+    // through the binder are counted, so the owner of the cache can tell when it has grown.
+    void setPipelineCache(VkPipelineCache cache) { mPipelineCache = cache; }
+    uint32_t getCreatedPipelineCount() const { return mCreatedPipelineCount; }
+
     // Clients should initialize their copy of the raster state using this method. They can then
     // mutate their copy and pass it back through bindRasterState().
     const RasterState& getDefaultRasterState() const { return mDefaultRasterState; }
 
-    // Returns true if vkCmdBindDescriptorSets is required. Additionally, if mutations to the set
-    // are required (i.e., vkUpdateDescriptorSets) then "changes" is set to non-null.
+    // Returns true if vkCmdBindDescriptorSets is required, either because the descriptor set or
+    // the dynamic offsets changed. Additionally, if mutations to the set are required
+    // (i.e., vkUpdateDescriptorSets) then "changes" is set to non-null.
     bool getOrCreateDescriptor(VkDescriptorSet* descriptor, VkPipelineLayout* pipelineLayout,
             DescriptorUpdateOp** changes = nullptr) noexcept;
 
     // Returns true if any pipeline bindings have changed. (i.e., vkCmdBindPipeline is required)
     bool getOrCreatePipeline(VkPipeline* pipeline) noexcept;
 
+    // The dynamic offsets of all uniform buffer bindings, to be passed to vkCmdBindDescriptorSets.
+    const uint32_t* getDynamicOffsets() const noexcept { return mDynamicOffsets; }
+
+    // The layout of all pipelines and descriptor sets, valid once getOrCreateDescriptor was called.
+    VkPipelineLayout getPipelineLayout() const noexcept { return mPipelineLayout; }
+
     // Each bind method is fast and does not make Vulkan calls.
     void bindProgramBundle(const ProgramBundle& bundle) noexcept;
     void bindRasterState(const RasterState& rasterState) noexcept;
-    void bindRenderPass(VkRenderPass renderPass) noexcept;
+    void bindRenderPass(VkRenderPass renderPass, uint32_t subpassIndex = 0) noexcept;
     void bindPrimitiveTopology(VkPrimitiveTopology topology) noexcept;
-    void bindUniformBuffer(uint32_t bindingIndex, VkBuffer uniformBuffer) noexcept;
+    void bindUniformBuffer(uint32_t bindingIndex, VkBuffer uniformBuffer,
+            VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE) noexcept;
     void bindSampler(uint32_t bindingIndex, VkDescriptorImageInfo imageInfo) noexcept;
+    void bindInputAttachment(VkImageView imageView) noexcept;
+    void bindStorageBuffer(uint32_t bindingIndex, VkBuffer storageBuffer) noexcept;
     void bindVertexArray(const VertexArray& varray) noexcept;
 
-    // Checks if the given uniform is bound to any slot, and if so binds "null" to that slot.
+    // Checks if the given uniform is bound to any slot, and if so binds "null" to that slot. The
+    // storage buffer slots are included, since storage buffers are uniform buffers of the driver.
     // Also invalidates all cached descriptors that refer to the given buffer.
     // This is only necessary when the client knows that the UBO is about to be destroyed.
     void unbindUniformBuffer(VkBuffer uniformBuffer) noexcept;
@@ -167,7 +196,10 @@ private:
         VkShaderModule shaders[NUM_SHADER_MODULES]; // 8*2 bytes
         RasterState rasterState; // 248 bytes
         VkRenderPass renderPass; // 8 bytes
-        VkPrimitiveTopology topology; // 4 bytes
+        uint16_t topology; // 2 bytes, a VkPrimitiveTopology
+        uint16_t subpassIndex; // 2 bytes
+        uint32_t specialization; // 4 bytes, see ProgramBundle
+        uint32_t padding; // 4 bytes, always zero
         VkVertexInputAttributeDescription vertexAttributes[MAX_VERTEX_ATTRIBUTES]; // 16*5 bytes
         VkVertexInputBindingDescription vertexBuffers[MAX_VERTEX_ATTRIBUTES]; // 12*5 bytes
     };
@@ -177,6 +209,9 @@ private:
         sizeof(PipelineKey::rasterState) +
         sizeof(PipelineKey::renderPass) +
         sizeof(PipelineKey::topology) +
+        sizeof(PipelineKey::subpassIndex) +
+        sizeof(PipelineKey::specialization) +
+        sizeof(PipelineKey::padding) +
         sizeof(PipelineKey::vertexAttributes) +
         sizeof(PipelineKey::vertexBuffers),
         "Implicit padding is not allowed for fast hashing");
@@ -205,12 +240,18 @@ private:
     // the previous call to getOrCreateDescriptor.
     struct alignas(8) DescriptorKey {
         VkBuffer uniformBuffers[NUM_UBUFFER_BINDINGS];
+        VkDeviceSize uniformBufferSizes[NUM_UBUFFER_BINDINGS]; // the offsets are dynamic
         VkDescriptorImageInfo samplers[NUM_SAMPLER_BINDINGS];
+        VkImageView inputAttachment;
+        VkBuffer storageBuffers[NUM_STORAGE_BINDINGS];
     };
 
     static_assert(sizeof(DescriptorKey) ==
         sizeof(DescriptorKey::uniformBuffers) +
-        sizeof(DescriptorKey::samplers),
+        sizeof(DescriptorKey::uniformBufferSizes) +
+        sizeof(DescriptorKey::samplers) +
+        sizeof(DescriptorKey::inputAttachment) +
+        sizeof(DescriptorKey::storageBuffers),
         "Implicit padding is not allowed for fast hashing");
 
     static_assert(std::is_pod<DescriptorKey>::value, "DescriptorKey must be a POD.");
@@ -225,6 +266,8 @@ private:
         VkDescriptorSet handle;
         uint32_t timestamp;
         bool bound;
+        bool transient;     // allocated from the arena of its frame, see allocateTransientDescriptor
+        uint32_t frame;     // time of the allocation
         // move-only (disallow copy) to allow keeping a pointer to the "current" value in the map.
         DescriptorVal(DescriptorVal const&) = delete;
         DescriptorVal& operator=(DescriptorVal const&) = delete;
@@ -232,18 +275,38 @@ private:
         DescriptorVal& operator=(DescriptorVal &&) = default;
     };
 
+    // The descriptor sets of a frame are allocated from a set of pools which are reset all at once
+    // when that frame's command buffer has completed.
+    struct DescriptorArena {
+        std::vector<VkDescriptorPool> pools;
+        uint32_t current = 0;   // index of the pool to allocate from
+        uint32_t count = 0;     // number of sets allocated from the current pool
+    };
+
     void createLayoutsAndDescriptors() noexcept;
     void destroyLayoutsAndDescriptors() noexcept;
-    void evictDescriptors(std::function<bool(const DescriptorKey&)> filter) noexcept;
+    VkDescriptorPool createDescriptorPool(uint32_t maxSets, VkDescriptorPoolCreateFlags flags)
+            noexcept;
+    VkDescriptorSet allocateTransientDescriptor() noexcept;
+    void resetDescriptorArena(uint32_t frame) noexcept;
+    template<typename Filter>
+    void evictDescriptors(Filter filter) noexcept;
 
     VkDevice mDevice = nullptr;
+    VkPipelineCache mPipelineCache = VK_NULL_HANDLE;
+    uint32_t mCreatedPipelineCount = 0;
     const RasterState mDefaultRasterState;
 
     // Info structs used only in a transient way but they are stored for convenience.
     VkPipelineShaderStageCreateInfo mShaderStages[NUM_SHADER_MODULES];
+    VkSpecializationMapEntry mSpecializationEntries[filament::SpecializationConstants::COUNT];
+    VkBool32 mSpecializationData[filament::SpecializationConstants::COUNT];
+    VkSpecializationInfo mSpecializationInfo;
     VkPipelineColorBlendStateCreateInfo mColorBlendState;
     VkDescriptorBufferInfo mDescriptorBuffers[NUM_UBUFFER_BINDINGS];
     VkDescriptorImageInfo mDescriptorSamplers[NUM_SAMPLER_BINDINGS];
+    VkDescriptorImageInfo mDescriptorInputAttachment;
+    VkDescriptorBufferInfo mDescriptorStorageBuffers[NUM_STORAGE_BINDINGS];
     DescriptorUpdateOp mDescriptorUpdateOp;
 
     // Current bindings are divided into two "keys" which are composed of a mix of actual values
@@ -261,6 +324,11 @@ private:
     bool mDirtyPipeline = true;
     bool mDirtyDescriptor = true;
 
+    // Offsets of the uniform buffer bindings, these don't require a new descriptor set but the
+    // current one must be bound again when they change.
+    uint32_t mDynamicOffsets[NUM_UBUFFER_BINDINGS] = {};
+    bool mDirtyDynamicOffsets = true;
+
     // Cached Vulkan objects. These objects are owned by the Binder.
     VkDescriptorSetLayout mDescriptorSetLayout = VK_NULL_HANDLE;
     VkPipelineLayout mPipelineLayout = VK_NULL_HANDLE;
@@ -269,9 +337,13 @@ private:
     VkDescriptorPool mDescriptorPool;
     std::vector<DescriptorVal> mDescriptorGraveyard;
 
-    // Store the current "time" (really just a frame count) and LRU eviction parameters.
+    // Store the current "time" (really just a frame count).
     uint32_t mCurrentTime = 0;
-    static constexpr uint32_t TIME_BEFORE_EVICTION = 2;
+
+    // New descriptor sets go to the arena of the current frame. The ones that are still used in a
+    // later frame are long-lived, they move to mDescriptorPool, where they are freed one by one.
+    static constexpr uint32_t NUM_DESCRIPTOR_ARENAS = TIME_BEFORE_EVICTION + 1;
+    DescriptorArena mDescriptorArenas[NUM_DESCRIPTOR_ARENAS];
 };
 
 } // namespace filament
@@ -0,0 +1,272 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "driver/vulkan/VulkanDrawRecorder.h"
+
+#include <utils/Panic.h>
+
+#include <algorithm>
+#include <thread>
+
+#include <string.h>
+
+namespace filament {
+namespace driver {
+
+using utils::JobSystem;
+
+void VulkanDrawRecorder::terminate() noexcept {
+    assert(!mRecording);
+    if (mJobSystem) {
+        mJobSystem->emancipate();
+        mJobSystem.reset();
+    }
+    for (VkCommandPool& pool : mCommandPools) {
+        if (pool) {
+            vkDestroyCommandPool(mContext.device, pool, VKALLOC);
+            pool = VK_NULL_HANDLE;
+        }
+    }
+}
+
+void VulkanDrawRecorder::begin(VkRenderPassBeginInfo const& info) noexcept {
+    assert(!mRecording);
+    assert(info.clearValueCount <= sizeof(mClearValues) / sizeof(mClearValues[0]));
+    mRecording = true;
+    mBeginInfo = info;
+    std::copy_n(info.pClearValues, info.clearValueCount, mClearValues);
+    mBeginInfo.pClearValues = mClearValues;
+}
+
+void VulkanDrawRecorder::draw(Draw const& draw, VkBuffer const* buffers,
+        VkDeviceSize const* offsets) noexcept {
+    assert(mRecording);
+    mCommands.push_back({
+        .type = CommandType::DRAW,
+        .firstVertexBuffer = (uint32_t) mVertexBuffers.size(),
+        .viewport = mViewport,
+        .scissor = mScissor,
+        .draw = draw
+    });
+    mVertexBuffers.insert(mVertexBuffers.end(), buffers, buffers + draw.vertexBufferCount);
+    mVertexOffsets.insert(mVertexOffsets.end(), offsets, offsets + draw.vertexBufferCount);
+}
+
+void VulkanDrawRecorder::nextSubpass() noexcept {
+    assert(mRecording);
+    mCommands.push_back({ .type = CommandType::NEXT_SUBPASS });
+}
+
+void VulkanDrawRecorder::pushMarker(const char* name) noexcept {
+    assert(mRecording);
+    mCommands.push_back({
+        .type = CommandType::PUSH_MARKER,
+        .firstVertexBuffer = (uint32_t) mMarkers.size()
+    });
+    mMarkers.emplace_back(name);
+}
+
+void VulkanDrawRecorder::popMarker() noexcept {
+    assert(mRecording);
+    mCommands.push_back({ .type = CommandType::POP_MARKER });
+}
+
+void VulkanDrawRecorder::end(VkCommandBuffer cmdbuffer) noexcept {
+    assert(mRecording);
+    Command const* first = mCommands.data();
+    Command const* const end = first + mCommands.size();
+    uint32_t subpass = 0;
+    for (Command const* cmd = first; cmd != end; ++cmd) {
+        if (cmd->type == CommandType::NEXT_SUBPASS) {
+            recordSubpass(cmdbuffer, subpass++, first, cmd);
+            first = cmd + 1;
+        }
+    }
+    recordSubpass(cmdbuffer, subpass, first, end);
+    vkCmdEndRenderPass(cmdbuffer);
+
+    mCommands.clear();
+    mVertexBuffers.clear();
+    mVertexOffsets.clear();
+    mMarkers.clear();
+    mRecording = false;
+}
+
+void VulkanDrawRecorder::startThreads() noexcept {
+    const uint32_t hwThreads = std::thread::hardware_concurrency();
+    mThreadCount = std::max(1u, std::min(MAX_RECORDING_THREADS, hwThreads));
+    if (mThreadCount > 1) {
+        // The driver thread must belong to the JobSystem to wait for the recording jobs.
+        mJobSystem.reset(new JobSystem(mThreadCount - 1));
+        mJobSystem->adopt();
+    }
+    VkCommandPoolCreateInfo createInfo {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = mContext.graphicsQueueFamilyIndex,
+    };
+    for (uint32_t i = 0; i < mThreadCount; i++) {
+        VkResult error = vkCreateCommandPool(mContext.device, &createInfo, VKALLOC,
+                &mCommandPools[i]);
+        ASSERT_POSTCONDITION(!error, "vkCreateCommandPool error.");
+    }
+}
+
+void VulkanDrawRecorder::recordSubpass(VkCommandBuffer cmdbuffer, uint32_t subpass,
+        Command const* first, Command const* last) noexcept {
+    // Debug markers must be balanced within a command buffer, so a subpass with markers is
+    // recorded inline.
+    const uint32_t drawCount = uint32_t(last - first);
+    bool parallel = drawCount >= MIN_PARALLEL_DRAW_COUNT;
+    for (Command const* cmd = first; parallel && cmd != last; ++cmd) {
+        parallel = cmd->type == CommandType::DRAW;
+    }
+    if (parallel && !mThreadCount) {
+        startThreads();
+    }
+    parallel = parallel && mThreadCount > 1;
+
+    const VkSubpassContents contents = parallel ?
+            VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE;
+    if (subpass == 0) {
+        vkCmdBeginRenderPass(cmdbuffer, &mBeginInfo, contents);
+    } else {
+        vkCmdNextSubpass(cmdbuffer, contents);
+    }
+
+    if (!parallel) {
+        recordCommands(cmdbuffer, first, last);
+        return;
+    }
+
+    const uint32_t count = std::min(mThreadCount, drawCount / (MIN_PARALLEL_DRAW_COUNT / 2));
+    VkCommandBuffer secondaries[MAX_RECORDING_THREADS];
+    JobSystem& js = *mJobSystem;
+    JobSystem::Job* parent = js.createJob();
+    for (uint32_t i = 0; i < count; i++) {
+        Command const* begin = first + size_t(drawCount) * i / count;
+        Command const* end = first + size_t(drawCount) * (i + 1) / count;
+        js.run(js.createJob(parent, [this, i, subpass, begin, end, &secondaries]
+                (JobSystem&, JobSystem::Job*) {
+            secondaries[i] = recordSecondary(i, subpass, begin, end);
+        }));
+    }
+    js.runAndWait(parent);
+    vkCmdExecuteCommands(cmdbuffer, count, secondaries);
+
+    // The secondary command buffers are freed once the frame has completed, the pools are only
+    // used by the recording jobs, which have all finished by then.
+    VkDevice device = mContext.device;
+    for (uint32_t i = 0; i < count; i++) {
+        VkCommandPool pool = mCommandPools[i];
+        VkCommandBuffer secondary = secondaries[i];
+        deferDisposal(mContext, [device, pool, secondary] (VkCommandBuffer) {
+            vkFreeCommandBuffers(device, pool, 1, &secondary);
+        });
+    }
+}
+
+VkCommandBuffer VulkanDrawRecorder::recordSecondary(uint32_t index, uint32_t subpass,
+        Command const* first, Command const* last) noexcept {
+    VkCommandBufferAllocateInfo allocateInfo {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = mCommandPools[index],
+        .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+        .commandBufferCount = 1
+    };
+    VkCommandBuffer cmdbuffer;
+    VkResult error = vkAllocateCommandBuffers(mContext.device, &allocateInfo, &cmdbuffer);
+    ASSERT_POSTCONDITION(!error, "vkAllocateCommandBuffers error.");
+
+    VkCommandBufferInheritanceInfo inheritanceInfo {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .renderPass = mBeginInfo.renderPass,
+        .subpass = subpass,
+        .framebuffer = mBeginInfo.framebuffer,
+    };
+    VkCommandBufferBeginInfo beginInfo {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+        .pInheritanceInfo = &inheritanceInfo,
+    };
+    error = vkBeginCommandBuffer(cmdbuffer, &beginInfo);
+    ASSERT_POSTCONDITION(!error, "vkBeginCommandBuffer error.");
+    recordCommands(cmdbuffer, first, last);
+    error = vkEndCommandBuffer(cmdbuffer);
+    ASSERT_POSTCONDITION(!error, "vkEndCommandBuffer error.");
+    return cmdbuffer;
+}
+
+void VulkanDrawRecorder::recordCommands(VkCommandBuffer cmdbuffer,
+        Command const* first, Command const* last) const noexcept {
+    // Nothing is bound at the start of a secondary command buffer, and the dynamic state isn't
+    // inherited, so the first draw call binds everything.
+    constexpr float MARKER_COLOR[] = { 0.0f, 1.0f, 0.0f, 1.0f };
+    Draw const* previous = nullptr;
+    VkViewport const* viewport = nullptr;
+    VkRect2D const* scissor = nullptr;
+    for (Command const* cmd = first; cmd != last; ++cmd) {
+        if (cmd->type == CommandType::PUSH_MARKER) {
+            VkDebugMarkerMarkerInfoEXT markerInfo = {};
+            markerInfo.sType = VK_STRUCTURE_TYPE_DEBUG_MARKER_MARKER_INFO_EXT;
+            memcpy(markerInfo.color, &MARKER_COLOR[0], sizeof(MARKER_COLOR));
+            markerInfo.pMarkerName = mMarkers[cmd->firstVertexBuffer].c_str();
+            vkCmdDebugMarkerBeginEXT(cmdbuffer, &markerInfo);
+            continue;
+        }
+        if (cmd->type == CommandType::POP_MARKER) {
+            vkCmdDebugMarkerEndEXT(cmdbuffer);
+            continue;
+        }
+        assert(cmd->type == CommandType::DRAW);
+
+        if (!viewport || memcmp(viewport, &cmd->viewport, sizeof(VkViewport))) {
+            viewport = &cmd->viewport;
+            vkCmdSetViewport(cmdbuffer, 0, 1, viewport);
+        }
+        if (!scissor || memcmp(scissor, &cmd->scissor, sizeof(VkRect2D))) {
+            scissor = &cmd->scissor;
+            vkCmdSetScissor(cmdbuffer, 0, 1, scissor);
+        }
+
+        Draw const& draw = cmd->draw;
+        if (!previous || previous->descriptor != draw.descriptor ||
+                memcmp(previous->dynamicOffsets, draw.dynamicOffsets,
+                        sizeof(draw.dynamicOffsets))) {
+            vkCmdBindDescriptorSets(cmdbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    draw.pipelineLayout, 0, 1, &draw.descriptor,
+                    VulkanBinder::NUM_UBUFFER_BINDINGS, draw.dynamicOffsets);
+        }
+        if (!previous || previous->pipeline != draw.pipeline) {
+            vkCmdBindPipeline(cmdbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, draw.pipeline);
+        }
+        previous = &draw;
+
+        vkCmdBindVertexBuffers(cmdbuffer, 0, draw.vertexBufferCount,
+                mVertexBuffers.data() + cmd->firstVertexBuffer,
+                mVertexOffsets.data() + cmd->firstVertexBuffer);
+        vkCmdBindIndexBuffer(cmdbuffer, draw.indexBuffer, 0, draw.indexType);
+
+        // The instancing variant indexes its transforms with gl_InstanceIndex, which includes the
+        // first instance: it's 0 for instanced draws, and identifies the draws of drawIndirect().
+        vkCmdDrawIndexed(cmdbuffer, draw.indexCount, draw.instanceCount, draw.firstIndex,
+                draw.vertexOffset, draw.firstInstance);
+    }
+}
+
+} // namespace filament
+} // namespace driver
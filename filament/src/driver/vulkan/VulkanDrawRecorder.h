@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DRIVER_VULKANDRAWRECORDER_H
+#define TNT_FILAMENT_DRIVER_VULKANDRAWRECORDER_H
+
+#include "VulkanDriverImpl.h"
+
+#include <utils/CString.h>
+#include <utils/JobSystem.h>
+
+#include <memory>
+#include <vector>
+
+namespace filament {
+namespace driver {
+
+// Collects the commands of a render pass and records them once it ends.
+//
+// The draw calls are resolved into pipelines, descriptor sets and buffers on the driver thread,
+// since this goes through the caches of VulkanBinder. Only the vkCmd* calls are deferred. Those of
+// a subpass with many draw calls are split into secondary command buffers, which are recorded
+// concurrently on worker threads, each with its own VkCommandPool, and executed from the primary
+// command buffer with vkCmdExecuteCommands. Smaller subpasses are recorded inline.
+//
+// The contents of a subpass are either inline or secondary command buffers, which is only known
+// once all of its draw calls are in, so the render pass itself begins in end().
+class VulkanDrawRecorder {
+public:
+    // A draw call with all of its state. The resources it refers to are alive until the frame has
+    // completed, see deferDisposal().
+    struct Draw {
+        VkPipeline pipeline;
+        VkPipelineLayout pipelineLayout;
+        VkDescriptorSet descriptor;
+        uint32_t dynamicOffsets[VulkanBinder::NUM_UBUFFER_BINDINGS];
+        VkBuffer indexBuffer;
+        VkIndexType indexType;
+        uint32_t indexCount;
+        uint32_t firstIndex;
+        int32_t vertexOffset;
+        uint32_t instanceCount;
+        uint32_t firstInstance;
+        uint32_t vertexBufferCount;
+    };
+
+    explicit VulkanDrawRecorder(VulkanContext& context) noexcept : mContext(context) {}
+
+    // Stops the worker threads and destroys their command pools. This must be called from the
+    // driver thread while the context's VkDevice is still alive.
+    void terminate() noexcept;
+
+    // Starts collecting the commands of a render pass. The render pass begins in end().
+    void begin(VkRenderPassBeginInfo const& info) noexcept;
+
+    bool isRecording() const noexcept { return mRecording; }
+
+    // The viewport and scissor apply to the following draw calls, and persist across render passes.
+    void setViewport(VkViewport const& viewport) noexcept { mViewport = viewport; }
+    void setScissor(VkRect2D const& scissor) noexcept { mScissor = scissor; }
+
+    // Adds a draw call. The vertex buffers and their offsets are copied.
+    void draw(Draw const& draw, VkBuffer const* buffers, VkDeviceSize const* offsets) noexcept;
+
+    void nextSubpass() noexcept;
+    void pushMarker(const char* name) noexcept;
+    void popMarker() noexcept;
+
+    // Records the whole render pass into the given primary command buffer.
+    void end(VkCommandBuffer cmdbuffer) noexcept;
+
+private:
+    // Below this many draw calls, a subpass is recorded inline. Each secondary command buffer gets
+    // at least half of that.
+    static constexpr uint32_t MIN_PARALLEL_DRAW_COUNT = 1024;
+    static constexpr uint32_t MAX_RECORDING_THREADS = 4;
+
+    enum class CommandType : uint8_t { DRAW, NEXT_SUBPASS, PUSH_MARKER, POP_MARKER };
+
+    struct Command {
+        CommandType type;
+        uint32_t firstVertexBuffer;     // or index of the marker's name
+        VkViewport viewport;
+        VkRect2D scissor;
+        Draw draw;
+    };
+
+    void startThreads() noexcept;
+    void recordSubpass(VkCommandBuffer cmdbuffer, uint32_t subpass,
+            Command const* first, Command const* last) noexcept;
+    VkCommandBuffer recordSecondary(uint32_t index, uint32_t subpass,
+            Command const* first, Command const* last) noexcept;
+    void recordCommands(VkCommandBuffer cmdbuffer,
+            Command const* first, Command const* last) const noexcept;
+
+    VulkanContext& mContext;
+
+    // State of the render pass being collected.
+    bool mRecording = false;
+    VkRenderPassBeginInfo mBeginInfo = {};
+    VkClearValue mClearValues[3] = {};
+    std::vector<Command> mCommands;
+    std::vector<VkBuffer> mVertexBuffers;
+    std::vector<VkDeviceSize> mVertexOffsets;
+    std::vector<utils::CString> mMarkers;
+    VkViewport mViewport = {};
+    VkRect2D mScissor = {};
+
+    // The driver thread takes part in the recording, along with mThreadCount - 1 workers. The
+    // secondary command buffers of a subpass are recorded concurrently, so each is allocated from
+    // its own pool.
+    std::unique_ptr<utils::JobSystem> mJobSystem;
+    uint32_t mThreadCount = 0;
+    VkCommandPool mCommandPools[MAX_RECORDING_THREADS] = {};
+};
+
+} // namespace filament
+} // namespace driver
+
+#endif // TNT_FILAMENT_DRIVER_VULKANDRAWRECORDER_H
@@ -25,9 +25,13 @@
 #include <utils/CString.h>
 #include <utils/trap.h>
 
+#include <algorithm>
 #include <csignal>
+#include <memory>
 #include <set>
 
+#include <string.h>
+
 // Vulkan functions often immediately dereference pointers, so it's fine to pass in a pointer
 // to a stack-allocated variable.
 #pragma clang diagnostic push
@@ -36,14 +40,19 @@
 
 static constexpr bool SWAPCHAIN_HAS_DEPTH = true;
 
+// Number of frames without any new pipeline after which the pipeline cache is saved.
+static constexpr uint32_t PIPELINE_CACHE_SAVE_DELAY = 120;
+
 namespace filament {
 namespace driver {
 
 VulkanDriver::VulkanDriver(ContextManagerVk* externalContext,
         const char* const* ppEnabledExtensions, uint32_t enabledExtensionCount) noexcept :
         DriverBase(new ConcreteDispatcher<VulkanDriver>(this)),
-        mContextManager(*externalContext), mStagePool(mContext), mFramebufferCache(mContext),
-        mSamplerCache(mContext) {
+        mContextManager(*externalContext),
+        mHandleArena("Handles", 4U * 1024U * 1024U), // TODO: set the amount in configuration
+        mStagePool(mContext), mFramebufferCache(mContext),
+        mSamplerCache(mContext), mDrawRecorder(mContext) {
     mContext.rasterState = mBinder.getDefaultRasterState();
 
     // Load Vulkan entry points.
@@ -148,6 +157,20 @@ VulkanDriver::VulkanDriver(ContextManagerVk* externalContext,
     // Initialize device and graphicsQueue.
     createVirtualDevice(mContext);
     mBinder.setDevice(mContext.device);
+    createPipelineCache();
+
+    // timestamps need to be supported by the graphics queue
+    if (mContext.physicalDeviceProperties.limits.timestampComputeAndGraphics) {
+        VkQueryPoolCreateInfo queryPoolInfo {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = TIMER_FRAME_COUNT * TIMERS_PER_FRAME * 2,
+        };
+        if (vkCreateQueryPool(mContext.device, &queryPoolInfo, VKALLOC,
+                &mTimerQueryPool) != VK_SUCCESS) {
+            mTimerQueryPool = VK_NULL_HANDLE;
+        }
+    }
 
     // Choose a depth format that meets our requirements. Take care not to include stencil formats
     // just yet, since that would require a corollary change to the "aspect" flags for the VkImage.
@@ -158,6 +181,83 @@ VulkanDriver::VulkanDriver(ContextManagerVk* externalContext,
 
 VulkanDriver::~VulkanDriver() noexcept = default;
 
+namespace {
+// key of the pipeline cache in the BlobCache. The cache data is only valid for the device and
+// driver which produced it; drivers validate its header anyway, but this avoids loading stale data.
+struct PipelineCacheKey {
+    char tag[8];
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint8_t uuid[VK_UUID_SIZE];
+};
+
+PipelineCacheKey getPipelineCacheKey(VkPhysicalDeviceProperties const& props) noexcept {
+    PipelineCacheKey key = {};
+    memcpy(key.tag, "VkPSO", sizeof("VkPSO"));
+    key.vendorID = props.vendorID;
+    key.deviceID = props.deviceID;
+    key.driverVersion = props.driverVersion;
+    memcpy(key.uuid, props.pipelineCacheUUID, VK_UUID_SIZE);
+    return key;
+}
+} // anonymous namespace
+
+// Creates the pipeline cache, pre-populated with the data of a previous run if the application
+// provided a BlobCache. Pipelines that were compiled before are then created without compiling
+// their shaders again.
+void VulkanDriver::createPipelineCache() {
+    std::unique_ptr<uint8_t[]> data;
+    size_t size = 0;
+    BlobCache* const blobCache = mContextManager.getBlobCache();
+    if (blobCache) {
+        const PipelineCacheKey key = getPipelineCacheKey(mContext.physicalDeviceProperties);
+        size = blobCache->retrieve(&key, sizeof(key), nullptr, 0);
+        if (size) {
+            data.reset(new uint8_t[size]);
+            if (blobCache->retrieve(&key, sizeof(key), data.get(), size) != size) {
+                size = 0;
+            }
+        }
+    }
+    VkPipelineCacheCreateInfo createInfo {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .initialDataSize = size,
+        .pInitialData = data.get(),
+    };
+    VkResult result = vkCreatePipelineCache(mContext.device, &createInfo, VKALLOC,
+            &mPipelineCache);
+    if (result != VK_SUCCESS && size) {
+        // The data was rejected, start from an empty cache.
+        createInfo.initialDataSize = 0;
+        createInfo.pInitialData = nullptr;
+        result = vkCreatePipelineCache(mContext.device, &createInfo, VKALLOC, &mPipelineCache);
+    }
+    ASSERT_POSTCONDITION(result == VK_SUCCESS, "vkCreatePipelineCache error.");
+    mBinder.setPipelineCache(mPipelineCache);
+}
+
+// Writes the pipeline cache to the application's BlobCache, if any.
+void VulkanDriver::savePipelineCache() {
+    mSavedPipelineCount = mBinder.getCreatedPipelineCount();
+    BlobCache* const blobCache = mContextManager.getBlobCache();
+    if (!blobCache) {
+        return;
+    }
+    size_t size = 0;
+    VkResult result = vkGetPipelineCacheData(mContext.device, mPipelineCache, &size, nullptr);
+    if (result != VK_SUCCESS || !size) {
+        return;
+    }
+    std::unique_ptr<uint8_t[]> data(new uint8_t[size]);
+    result = vkGetPipelineCacheData(mContext.device, mPipelineCache, &size, data.get());
+    if (result != VK_SUCCESS) {
+        return;
+    }
+    const PipelineCacheKey key = getPipelineCacheKey(mContext.physicalDeviceProperties);
+    blobCache->insert(&key, sizeof(key), data.get(), size);
+}
+
 std::unique_ptr<Driver> VulkanDriver::create(ContextManagerVk* const externalContext,
         const char* const* ppEnabledExtensions, uint32_t enabledExtensionCount) noexcept {
     assert(externalContext);
@@ -179,12 +279,21 @@ void VulkanDriver::terminate() {
         return;
     }
     waitForIdle(mContext);
+    mDrawRecorder.terminate();
+    if (mBinder.getCreatedPipelineCount() != mSavedPipelineCount) {
+        savePipelineCache();
+    }
     mBinder.destroyCache();
     mStagePool.reset();
     mFramebufferCache.reset();
     mSamplerCache.reset();
     vmaDestroyAllocator(mContext.allocator);
     vkDestroyCommandPool(mContext.device, mContext.commandPool, VKALLOC);
+    vkDestroyCommandPool(mContext.device, mContext.transferCommandPool, VKALLOC);
+    vkDestroyPipelineCache(mContext.device, mPipelineCache, VKALLOC);
+    if (mTimerQueryPool) {
+        vkDestroyQueryPool(mContext.device, mTimerQueryPool, VKALLOC);
+    }
     vkDestroyDevice(mContext.device, VKALLOC);
     if (mDebugCallback) {
         vkDestroyDebugReportCallbackEXT(mContext.instance, mDebugCallback, VKALLOC);
@@ -222,10 +331,38 @@ void VulkanDriver::beginFrame(uint64_t monotonic_clock_ns, uint32_t frameId) {
     // but not the render pass; we cannot perform arbitrary work during the render pass.
     performPendingWork(mContext, swapContext, swapContext.cmdbuffer);
 
+    // Destroy the objects that were waiting for the frames that have completed.
+    performDisposals(mContext, mContext.completedSerial);
+
+    // Read the timers of the frame that used this range of the query pool before, and reset it.
+    if (mTimerQueryPool) {
+        mTimerFrame++;
+        TimerFrame& timerFrame = mTimerFrames[mTimerFrame % TIMER_FRAME_COUNT];
+        readTimerQueries(timerFrame);
+        timerFrame.frame = mTimerFrame;
+        timerFrame.count = 0;
+        vkCmdResetQueryPool(swapContext.cmdbuffer, mTimerQueryPool,
+                (mTimerFrame % TIMER_FRAME_COUNT) * TIMERS_PER_FRAME * 2, TIMERS_PER_FRAME * 2);
+    }
+
+    // Acquire the texture uploads that the transfer queue has completed since the last frame.
+    acquireTransfers(mContext, mContext.acquiredTransferSerial);
+
     // Free old unused objects.
     mStagePool.gc();
     mFramebufferCache.gc();
     mBinder.gc();
+
+    // Save the pipeline cache once the pipeline creations have settled down, rather than only in
+    // terminate(), which mobile applications seldom reach.
+    const uint32_t pipelineCount = mBinder.getCreatedPipelineCount();
+    if (pipelineCount != mPipelineCount) {
+        mPipelineCount = pipelineCount;
+        mPipelineCacheAge = 0;
+    } else if (pipelineCount != mSavedPipelineCount &&
+            ++mPipelineCacheAge >= PIPELINE_CACHE_SAVE_DELAY) {
+        savePipelineCache();
+    }
 }
 
 void VulkanDriver::endFrame(uint32_t frameId) {
@@ -237,62 +374,77 @@ void VulkanDriver::flush(int) {
 }
 
 void VulkanDriver::createVertexBuffer(Driver::VertexBufferHandle vbh, uint8_t bufferCount,
-        uint8_t attributeCount, uint32_t elementCount, Driver::AttributeArray attributes) {
-    construct_handle<VulkanVertexBuffer>(mHandleMap, vbh, mContext, mStagePool, bufferCount,
+        uint8_t attributeCount, uint32_t elementCount, Driver::AttributeArray attributes,
+        Driver::Usage usage) {
+    // the buffers are always updated through a staging buffer, the usage doesn't matter
+    construct_handle<VulkanVertexBuffer>(vbh, mContext, mStagePool, bufferCount,
             attributeCount, elementCount, attributes);
 }
 
 void VulkanDriver::createIndexBuffer(Driver::IndexBufferHandle ibh, Driver::ElementType elementType,
-        uint32_t indexCount) {
+        uint32_t indexCount, Driver::Usage usage) {
     auto elementSize = (uint8_t) getElementTypeSize(elementType);
-    construct_handle<VulkanIndexBuffer>(mHandleMap, ibh, mContext, mStagePool, elementSize,
+    construct_handle<VulkanIndexBuffer>(ibh, mContext, mStagePool, elementSize,
             indexCount);
 }
 
 void VulkanDriver::createTexture(Driver::TextureHandle th, SamplerType target, uint8_t levels,
         TextureFormat format, uint8_t samples, uint32_t w, uint32_t h, uint32_t depth,
         TextureUsage usage) {
-    construct_handle<VulkanTexture>(mHandleMap, th, mContext, target, levels, format, samples,
+    construct_handle<VulkanTexture>(th, mContext, target, levels, format, samples,
             w, h, depth, usage, mStagePool);
 }
 
 void VulkanDriver::createSamplerBuffer(Driver::SamplerBufferHandle sbh, size_t count) {
-    construct_handle<VulkanSamplerBuffer>(mHandleMap, sbh, mContext, count);
+    auto* sb = construct_handle<VulkanSamplerBuffer>(sbh, mContext, count);
+    sb->generation = ++mSamplerBufferGeneration;
+}
+
+void VulkanDriver::loadSamplerBuffer(Driver::SamplerBufferHandle sbh,
+        SamplerBuffer::Sampler const* samplers, uint32_t count) {
+    // SamplerBuffer has no heap storage, this doesn't allocate
+    SamplerBuffer buffer(count);
+    for (size_t i = 0; i < count; i++) {
+        buffer.setSampler(i, samplers[i]);
+    }
+    updateSamplerBuffer(sbh, std::move(buffer));
 }
 
 void VulkanDriver::createUniformBuffer(Driver::UniformBufferHandle ubh, size_t size) {
-    construct_handle<VulkanUniformBuffer>(mHandleMap, ubh, mContext, mStagePool, size);
+    construct_handle<VulkanUniformBuffer>(ubh, mContext, mStagePool, size);
 }
 
 void VulkanDriver::createRenderPrimitive(Driver::RenderPrimitiveHandle rph, int) {
-    construct_handle<VulkanRenderPrimitive>(mHandleMap, rph, mContext);
+    construct_handle<VulkanRenderPrimitive>(rph, mContext);
 }
 
 void VulkanDriver::createProgram(Driver::ProgramHandle ph, Program&& program) {
-    construct_handle<VulkanProgram>(mHandleMap, ph, mContext, program);
+    construct_handle<VulkanProgram>(ph, mContext, program);
 }
 
 void VulkanDriver::createDefaultRenderTarget(Driver::RenderTargetHandle rth, int) {
-    construct_handle<VulkanRenderTarget>(mHandleMap, rth, mContext);
+    construct_handle<VulkanRenderTarget>(rth, mContext);
 }
 
 void VulkanDriver::createRenderTarget(Driver::RenderTargetHandle rth,
         Driver::TargetBufferFlags targets, uint32_t width, uint32_t height, uint8_t samples,
         TextureFormat format, Driver::TargetBufferInfo color, Driver::TargetBufferInfo depth,
         Driver::TargetBufferInfo stencil) {
-    auto& renderTarget = *construct_handle<VulkanRenderTarget>(mHandleMap, rth, mContext,
+    auto& renderTarget = *construct_handle<VulkanRenderTarget>(rth, mContext,
             width, height);
     if (color.handle) {
-        auto colorTexture = handle_cast<VulkanTexture>(mHandleMap, color.handle);
+        auto colorTexture = handle_cast<VulkanTexture>(color.handle);
         renderTarget.setColorImage({
             .view = colorTexture->imageView,
             .format = colorTexture->format
         });
+        // used only if the target is drawn with two subpasses
+        renderTarget.setSubpassFormat(getVkFormat(format));
     } else if (targets & TargetBufferFlags::COLOR) {
         renderTarget.createColorImage(getVkFormat(format));
     }
     if (depth.handle) {
-        auto depthTexture = handle_cast<VulkanTexture>(mHandleMap, depth.handle);
+        auto depthTexture = handle_cast<VulkanTexture>(depth.handle);
         renderTarget.setDepthImage({
             .view = depthTexture->imageView,
             .format = depthTexture->format
@@ -307,12 +459,15 @@ void VulkanDriver::createFence(Driver::FenceHandle fh, int) {
 
 void VulkanDriver::createSwapChain(Driver::SwapChainHandle sch, void* nativeWindow,
         uint64_t flags) {
-    auto* swapChain = construct_handle<VulkanSwapChain>(mHandleMap, sch);
+    auto* swapChain = construct_handle<VulkanSwapChain>(sch);
     VulkanSurfaceContext& sc = swapChain->surfaceContext;
     sc.surface = (VkSurfaceKHR) mContextManager.createVkSurfaceKHR(nativeWindow,
             mContext.instance, &sc.clientSize.width, &sc.clientSize.height);
     getPresentationQueue(mContext, sc);
     getSurfaceCaps(mContext, sc);
+    sc.presentMode = (flags & SWAP_CHAIN_CONFIG_PRESENT_MAILBOX) ? VK_PRESENT_MODE_MAILBOX_KHR :
+            (flags & SWAP_CHAIN_CONFIG_PRESENT_IMMEDIATE) ? VK_PRESENT_MODE_IMMEDIATE_KHR :
+            VK_PRESENT_MODE_FIFO_KHR;
     createSwapChainAndImages(mContext, sc);
     createCommandBuffersAndFences(mContext, sc);
 
@@ -324,10 +479,26 @@ void VulkanDriver::createSwapChain(Driver::SwapChainHandle sch, void* nativeWind
     }
 }
 
+void VulkanDriver::createSwapChainHeadless(Driver::SwapChainHandle sch,
+        uint32_t width, uint32_t height, uint64_t flags) {
+    auto* swapChain = construct_handle<VulkanSwapChain>(sch);
+    VulkanSurfaceContext& sc = swapChain->surfaceContext;
+    createHeadlessImages(mContext, sc, width, height);
+    createCommandBuffersAndFences(mContext, sc);
+    mContext.currentSurface = &sc;
+
+    if (SWAPCHAIN_HAS_DEPTH) {
+        transitionDepthBuffer(mContext, sc, mContext.depthFormat);
+    }
+}
+
 void VulkanDriver::createStreamFromTextureId(Driver::StreamHandle sh, intptr_t externalTextureId,
         uint32_t width, uint32_t height) {
 }
 
+void VulkanDriver::createStreamAcquired(Driver::StreamHandle sh, int) {
+}
+
 Handle<HwVertexBuffer> VulkanDriver::createVertexBufferSynchronous() noexcept {
     return alloc_handle<VulkanVertexBuffer, HwVertexBuffer>();
 }
@@ -372,35 +543,43 @@ Handle<HwSwapChain> VulkanDriver::createSwapChainSynchronous() noexcept {
     return alloc_handle<VulkanSwapChain, HwSwapChain>();
 }
 
+Handle<HwSwapChain> VulkanDriver::createSwapChainHeadlessSynchronous() noexcept {
+    return alloc_handle<VulkanSwapChain, HwSwapChain>();
+}
+
 Handle<HwStream> VulkanDriver::createStreamFromTextureIdSynchronous() noexcept {
     return {};
 }
 
+Handle<HwStream> VulkanDriver::createStreamAcquiredSynchronous() noexcept {
+    return {};
+}
+
 void VulkanDriver::destroyVertexBuffer(Driver::VertexBufferHandle vbh) {
     if (vbh) {
-        waitForIdle(mContext);
-        destruct_handle<VulkanVertexBuffer>(mHandleMap, vbh);
+        destruct_handle_deferred<VulkanVertexBuffer>(vbh);
     }
 }
 
 void VulkanDriver::destroyIndexBuffer(Driver::IndexBufferHandle ibh) {
     if (ibh) {
-        waitForIdle(mContext);
-        destruct_handle<VulkanIndexBuffer>(mHandleMap, ibh);
+        destruct_handle_deferred<VulkanIndexBuffer>(ibh);
     }
 }
 
 void VulkanDriver::destroyRenderPrimitive(Driver::RenderPrimitiveHandle rph) {
     if (rph) {
-        waitForIdle(mContext);
-        destruct_handle<VulkanRenderPrimitive>(mHandleMap, rph);
+        destruct_handle_deferred<VulkanRenderPrimitive>(rph);
     }
 }
 
 void VulkanDriver::destroyProgram(Driver::ProgramHandle ph) {
     if (ph) {
-        waitForIdle(mContext);
-        destruct_handle<VulkanProgram>(mHandleMap, ph);
+        // another program could be created at the same address
+        if (mBoundSamplers.program == handle_cast<VulkanProgram>(ph)) {
+            mBoundSamplers.program = nullptr;
+        }
+        destruct_handle_deferred<VulkanProgram>(ph);
     }
 }
 
@@ -410,47 +589,54 @@ void VulkanDriver::destroySamplerBuffer(Driver::SamplerBufferHandle sbh) {
         // not map to any Vulkan objects. To handle destruction, the only thing we need to do is
         // ensure that the next draw call doesn't try to access a zombie sampler buffer. Therefore,
         // simply replace all weak references with null.
-        auto* hwsb = handle_cast<VulkanSamplerBuffer>(mHandleMap, sbh);
+        auto* hwsb = handle_cast<VulkanSamplerBuffer>(sbh);
         for (auto& binding : mSamplerBindings) {
             if (binding == hwsb) {
                 binding = nullptr;
             }
         }
-        destruct_handle<VulkanSamplerBuffer>(mHandleMap, sbh);
+        destruct_handle<VulkanSamplerBuffer>(sbh);
     }
 }
 
 void VulkanDriver::destroyUniformBuffer(Driver::UniformBufferHandle ubh) {
     if (ubh) {
-        auto* buffer = handle_cast<VulkanUniformBuffer>(mHandleMap, ubh);
+        auto* buffer = handle_cast<VulkanUniformBuffer>(ubh);
         mBinder.unbindUniformBuffer(buffer->getGpuBuffer());
-        waitForIdle(mContext);
-        destruct_handle<VulkanUniformBuffer>(mHandleMap, ubh);
+        destruct_handle_deferred<VulkanUniformBuffer>(ubh);
     }
 }
 
 void VulkanDriver::destroyTexture(Driver::TextureHandle th) {
     if (th) {
-        auto* tex = handle_cast<VulkanTexture>(mHandleMap, th);
+        auto* tex = handle_cast<VulkanTexture>(th);
         mBinder.unbindImageView(tex->imageView);
-        waitForIdle(mContext);
-        destruct_handle<VulkanTexture>(mHandleMap, th);
+        mBoundSamplers.program = nullptr;
+        // the next frame must wait for the upload still in flight, if any
+        if (tex->transferSerial > mContext.acquiredTransferSerial) {
+            acquireTransfers(mContext, tex->transferSerial);
+        }
+        destruct_handle_deferred<VulkanTexture>(th);
     }
 }
 
 void VulkanDriver::destroyRenderTarget(Driver::RenderTargetHandle rth) {
     if (rth) {
-        waitForIdle(mContext);
-        destruct_handle<VulkanRenderTarget>(mHandleMap, rth);
+        auto* renderTarget = handle_cast<VulkanRenderTarget>(rth);
+        if (renderTarget->getSubpassColorView()) {
+            mBinder.unbindImageView(renderTarget->getSubpassColorView());
+            mBoundSamplers.program = nullptr;
+        }
+        destruct_handle_deferred<VulkanRenderTarget>(rth);
     }
 }
 
 void VulkanDriver::destroySwapChain(Driver::SwapChainHandle sch) {
     if (sch) {
         waitForIdle(mContext);
-        VulkanSurfaceContext& sc = handle_cast<VulkanSwapChain>(mHandleMap, sch)->surfaceContext;
+        VulkanSurfaceContext& sc = handle_cast<VulkanSwapChain>(sch)->surfaceContext;
         destroySurfaceContext(mContext, sc);
-        destruct_handle<VulkanSwapChain>(mHandleMap, sch);
+        destruct_handle<VulkanSwapChain>(sch);
     }
 }
 
@@ -487,6 +673,20 @@ bool VulkanDriver::isTextureFormatSupported(Driver::TextureFormat format) {
     return info.optimalTilingFeatures != 0;
 }
 
+bool VulkanDriver::isTextureFormatMipmappable(Driver::TextureFormat format) {
+    // the levels are blitted from each other with a linear filter, see generateMipmaps()
+    assert(mContext.physicalDevice);
+    VkFormat vkformat = getVkFormat(format);
+    if (vkformat == VK_FORMAT_UNDEFINED) {
+        return false;
+    }
+    const VkFormatFeatureFlags features = VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+            VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    VkFormatProperties info;
+    vkGetPhysicalDeviceFormatProperties(mContext.physicalDevice, vkformat, &info);
+    return (info.optimalTilingFeatures & features) == features;
+}
+
 bool VulkanDriver::isRenderTargetFormatSupported(Driver::TextureFormat format) {
     assert(mContext.physicalDevice);
     VkFormat vkformat = getVkFormat(format);
@@ -495,23 +695,47 @@ bool VulkanDriver::isRenderTargetFormatSupported(Driver::TextureFormat format) {
     }
     VkFormatProperties info;
     vkGetPhysicalDeviceFormatProperties(mContext.physicalDevice, vkformat, &info);
-    return (info.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT) != 0;
+    return (info.optimalTilingFeatures & (VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT |
+            VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT)) != 0;
 }
 
 bool VulkanDriver::isFrameTimeSupported() {
+    return mTimerQueryPool != VK_NULL_HANDLE;
+}
+
+bool VulkanDriver::isSubpassInputSupported() {
+    return true;
+}
+
+uint32_t VulkanDriver::getUniformBufferOffsetAlignment() {
+    return (uint32_t) mContext.physicalDeviceProperties.limits.minUniformBufferOffsetAlignment;
+}
+
+bool VulkanDriver::isDrawIndirectSupported() {
+    // gl_InstanceIndex includes the first instance of direct draws, see drawIndirect()
+    return true;
+}
+
+bool VulkanDriver::isComputeSupported() {
+    // the binder only creates graphics pipelines
+    return false;
+}
+
+bool VulkanDriver::isAutoResolveSupported() {
+    // render passes have no resolve attachments
     return false;
 }
 
 void VulkanDriver::loadVertexBuffer(Driver::VertexBufferHandle vbh, size_t index,
         BufferDescriptor&& p, uint32_t byteOffset, uint32_t byteSize) {
-    auto& vb = *handle_cast<VulkanVertexBuffer>(mHandleMap, vbh);
+    auto& vb = *handle_cast<VulkanVertexBuffer>(vbh);
     vb.buffers[index]->loadFromCpu(p.buffer, byteOffset, byteSize);
     scheduleDestroy(std::move(p));
 }
 
 void VulkanDriver::loadIndexBuffer(Driver::IndexBufferHandle ibh, BufferDescriptor&& p,
         uint32_t byteOffset, uint32_t byteSize) {
-    auto& ib = *handle_cast<VulkanIndexBuffer>(mHandleMap, ibh);
+    auto& ib = *handle_cast<VulkanIndexBuffer>(ibh);
     ib.buffer->loadFromCpu(p.buffer, byteOffset, byteSize);
     scheduleDestroy(std::move(p));
 }
@@ -521,14 +745,33 @@ void VulkanDriver::load2DImage(Driver::TextureHandle th,
         PixelBufferDescriptor&& data) {
     assert(data.type != driver::PixelDataType::COMPRESSED && "Compression not yet supported.");
     assert(xoffset == 0 && yoffset == 0 && "Offsets not yet supported.");
-    handle_cast<VulkanTexture>(mHandleMap, th)->load2DImage(std::move(data), width, height, level);
+    handle_cast<VulkanTexture>(th)->load2DImage(std::move(data), width, height, level);
+    scheduleDestroy(std::move(data));
+}
+
+void VulkanDriver::load3DImage(Driver::TextureHandle th, uint32_t level,
+        uint32_t xoffset, uint32_t yoffset, uint32_t zoffset,
+        uint32_t width, uint32_t height, uint32_t depth,
+        PixelBufferDescriptor&& data) {
+    assert(data.type != driver::PixelDataType::COMPRESSED && "Compression not yet supported.");
+    assert(xoffset == 0 && yoffset == 0 && zoffset == 0 && "Offsets not yet supported.");
+    // the whole level is copied, all its layers or slices, see copyBufferToImage()
+    handle_cast<VulkanTexture>(th)->load2DImage(std::move(data), width, height, level);
+    scheduleDestroy(std::move(data));
+}
+
+void VulkanDriver::load2DImageRegions(Driver::TextureHandle th, uint32_t level,
+        Driver::TextureRegion const* regions, uint32_t count, PixelBufferDescriptor&& data) {
+    // like the offsets of load2DImage(), the regions need the previous content of the level to
+    // be kept, which the layout transitions of VulkanTexture don't do yet.
+    assert(false && "Regions not yet supported.");
     scheduleDestroy(std::move(data));
 }
 
 void VulkanDriver::loadCubeImage(Driver::TextureHandle th, uint32_t level,
         PixelBufferDescriptor&& data, FaceOffsets faceOffsets) {
     assert(data.type != driver::PixelDataType::COMPRESSED && "Compression not yet supported.");
-    handle_cast<VulkanTexture>(mHandleMap, th)->loadCubeImage(std::move(data), faceOffsets, level);
+    handle_cast<VulkanTexture>(th)->loadCubeImage(std::move(data), faceOffsets, level);
     scheduleDestroy(std::move(data));
 }
 
@@ -538,22 +781,79 @@ void VulkanDriver::setExternalImage(Driver::TextureHandle th, void* image) {
 void VulkanDriver::setExternalStream(Driver::TextureHandle th, Driver::StreamHandle sh) {
 }
 
+void VulkanDriver::setAcquiredImage(Driver::StreamHandle sh, int acquireFence,
+        BufferDescriptor&& image) {
+    // streams are not supported, the image is given back right away
+    scheduleDestroy(std::move(image));
+}
+
 void VulkanDriver::generateMipmaps(Driver::TextureHandle th) {
+    auto* texture = handle_cast<VulkanTexture>(th);
+    // the base level must have been acquired from the transfer queue, if it was uploaded there
+    if (texture->transferSerial > mContext.acquiredTransferSerial) {
+        acquireTransfers(mContext, texture->transferSerial);
+    }
+    texture->generateMipmaps();
+}
+
+void VulkanDriver::setMinMaxLevels(Driver::TextureHandle th, uint8_t minLevel,
+        uint8_t maxLevel) {
+    // applied by the samplers, see draw()
+    auto* texture = handle_cast<VulkanTexture>(th);
+    texture->minLevel = minLevel;
+    texture->maxLevel = maxLevel;
+    mBoundSamplers.program = nullptr;
+}
+
+void VulkanDriver::setTextureUploadBudget(uint32_t bytesPerFrame) {
+}
+
+void VulkanDriver::compileProgram(Driver::ProgramHandle ph) {
+    // The shader modules are created with the program, and the pipelines depend on the render
+    // pass and vertex layout, which are only known at draw time.
+}
+
+void VulkanDriver::getMemoryStatistics(Driver::MemoryStatistics* stats) {
+    VmaStats vmaStats;
+    vmaCalculateStats(mContext.allocator, &vmaStats);
+    stats->handleArena = mHandleArena.getArea().getSize();
+    stats->gpuAllocated = size_t(vmaStats.total.usedBytes);
+}
+
+void VulkanDriver::queueCallback(BufferDescriptor&& buffer) {
+    scheduleDestroy(std::move(buffer));
+}
+
+void VulkanDriver::getFrameStatistics(Driver::FrameStatistics* stats) {
+    if (mHasGpuTime) {
+        std::copy_n(mGpuTimeMilli, TIMER_COUNT, stats->gpuTimeMilli);
+        stats->gpuTimeAge = mTimerFrame - mGpuTimeFrame;
+    }
 }
 
 void VulkanDriver::updateUniformBuffer(Driver::UniformBufferHandle ubh,
         UniformBuffer&& uniformBuffer) {
-    auto* buffer = handle_cast<VulkanUniformBuffer>(mHandleMap, ubh);
+    auto* buffer = handle_cast<VulkanUniformBuffer>(ubh);
     if (uniformBuffer.isDirty()) {
-        buffer->loadFromCpu(uniformBuffer.getBuffer(), (uint32_t) uniformBuffer.getSize());
+        // only upload the range that changed since the previous update
+        const size_t offset = uniformBuffer.getDirtyOffset();
+        buffer->loadFromCpu(static_cast<char const*>(uniformBuffer.getBuffer()) + offset,
+                (uint32_t) uniformBuffer.getDirtySize(), (uint32_t) offset);
     }
     buffer->ub = std::move(uniformBuffer);
 }
 
+void VulkanDriver::loadUniformBuffer(Driver::UniformBufferHandle ubh,
+        void const* data, uint32_t offset, uint32_t size) {
+    auto* buffer = handle_cast<VulkanUniformBuffer>(ubh);
+    buffer->loadFromCpu(data, size, offset);
+}
+
 void VulkanDriver::updateSamplerBuffer(Driver::SamplerBufferHandle sbh,
         SamplerBuffer&& samplerBuffer) {
-    auto* sb = handle_cast<VulkanSamplerBuffer>(mHandleMap, sbh);
+    auto* sb = handle_cast<VulkanSamplerBuffer>(sbh);
     *sb->sb = samplerBuffer;
+    sb->generation = ++mSamplerBufferGeneration;
 }
 
 void VulkanDriver::beginRenderPass(Driver::RenderTargetHandle rth,
@@ -561,9 +861,7 @@ void VulkanDriver::beginRenderPass(Driver::RenderTargetHandle rth,
 
     assert(mContext.cmdbuffer);
     assert(mContext.currentSurface);
-    VulkanSurfaceContext& surface = *mContext.currentSurface;
-    const SwapContext& swapContext = surface.swapContexts[surface.currentSwapIndex];
-    mCurrentRenderTarget = handle_cast<VulkanRenderTarget>(mHandleMap, rth);
+    mCurrentRenderTarget = handle_cast<VulkanRenderTarget>(rth);
     VulkanRenderTarget* rt = mCurrentRenderTarget;
     const VkExtent2D extent = rt->getExtent();
     assert(extent.width > 0 && extent.height > 0);
@@ -573,6 +871,9 @@ void VulkanDriver::beginRenderPass(Driver::RenderTargetHandle rth,
     const bool hasColor = color.format != VK_FORMAT_UNDEFINED;
     const bool hasDepth = depth.format != VK_FORMAT_UNDEFINED;
     const bool depthOnly = hasDepth && !hasColor;
+    const bool hasSubpass = params.dependencies & RenderPassParams::DEPENDENCY_SUBPASS_INPUT;
+    assert(!hasSubpass || (rt->isOffscreen() && hasColor));
+    const auto subpassColor = hasSubpass ? rt->getSubpassColor() : VulkanAttachment {};
 
     VkImageLayout finalLayout;
     if (!rt->isOffscreen()) {
@@ -588,11 +889,15 @@ void VulkanDriver::beginRenderPass(Driver::RenderTargetHandle rth,
         .colorFormat = color.format,
         .depthFormat = depth.format,
         .flags.value = params.flags,
+        .subpassFormat = subpassColor.format,
     });
     mBinder.bindRenderPass(renderPass);
 
     VulkanFboCache::FboKey fbo { .renderPass = renderPass };
     int numAttachments = 0;
+    if (hasSubpass) {
+      fbo.attachments[numAttachments++] = subpassColor.view;
+    }
     if (hasColor) {
       fbo.attachments[numAttachments++] = color.view;
     }
@@ -612,7 +917,14 @@ void VulkanDriver::beginRenderPass(Driver::RenderTargetHandle rth,
 
     rt->transformClientRectToPlatform(&renderPassInfo.renderArea);
 
-    VkClearValue clearValues[2] = {};
+    VkClearValue clearValues[3] = {};
+    if (hasSubpass) {
+        VkClearValue& clearValue = clearValues[renderPassInfo.clearValueCount++];
+        clearValue.color.float32[0] = params.clearColor.r;
+        clearValue.color.float32[1] = params.clearColor.g;
+        clearValue.color.float32[2] = params.clearColor.b;
+        clearValue.color.float32[3] = params.clearColor.a;
+    }
     if (hasColor) {
         VkClearValue& clearValue = clearValues[renderPassInfo.clearValueCount++];
         clearValue.color.float32[0] = params.clearColor.r;
@@ -626,7 +938,7 @@ void VulkanDriver::beginRenderPass(Driver::RenderTargetHandle rth,
     }
     renderPassInfo.pClearValues = &clearValues[0];
 
-    vkCmdBeginRenderPass(swapContext.cmdbuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    mDrawRecorder.begin(renderPassInfo);
     if (!(params.clear & RenderPassParams::IGNORE_VIEWPORT)) {
         viewport(params.left, params.bottom, params.width, params.height);
     }
@@ -638,9 +950,18 @@ void VulkanDriver::endRenderPass(int) {
     assert(mContext.cmdbuffer);
     assert(mContext.currentSurface);
     assert(mCurrentRenderTarget);
-    vkCmdEndRenderPass(mContext.cmdbuffer);
+    mDrawRecorder.end(mContext.cmdbuffer);
     mCurrentRenderTarget = VK_NULL_HANDLE;
     mContext.currentRenderPass.renderPass = VK_NULL_HANDLE;
+    mBinder.bindInputAttachment(VK_NULL_HANDLE);
+}
+
+void VulkanDriver::nextSubpass(int) {
+    assert(mContext.cmdbuffer);
+    assert(mCurrentRenderTarget);
+    mDrawRecorder.nextSubpass();
+    mBinder.bindRenderPass(mContext.currentRenderPass.renderPass, 1);
+    mBinder.bindInputAttachment(mCurrentRenderTarget->getSubpassColor().view);
 }
 
 void VulkanDriver::discardSubRenderTargetBuffers(Driver::RenderTargetHandle rth,
@@ -655,15 +976,15 @@ void VulkanDriver::resizeRenderTarget(Driver::RenderTargetHandle rth,
 void VulkanDriver::setRenderPrimitiveBuffer(Driver::RenderPrimitiveHandle rph,
         Driver::VertexBufferHandle vbh, Driver::IndexBufferHandle ibh,
         uint32_t enabledAttributes) {
-    auto primitive = handle_cast<VulkanRenderPrimitive>(mHandleMap, rph);
-    primitive->setBuffers(handle_cast<VulkanVertexBuffer>(mHandleMap, vbh),
-            handle_cast<VulkanIndexBuffer>(mHandleMap, ibh), enabledAttributes);
+    auto primitive = handle_cast<VulkanRenderPrimitive>(rph);
+    primitive->setBuffers(handle_cast<VulkanVertexBuffer>(vbh),
+            handle_cast<VulkanIndexBuffer>(ibh), enabledAttributes);
 }
 
 void VulkanDriver::setRenderPrimitiveRange(Driver::RenderPrimitiveHandle rph,
         Driver::PrimitiveType pt, uint32_t offset,
         uint32_t minIndex, uint32_t maxIndex, uint32_t count) {
-    auto& primitive = *handle_cast<VulkanRenderPrimitive>(mHandleMap, rph);
+    auto& primitive = *handle_cast<VulkanRenderPrimitive>(rph);
     primitive.setPrimitiveType(pt);
     primitive.offset = offset * primitive.indexBuffer->elementSize;
     primitive.count = count;
@@ -687,11 +1008,11 @@ void VulkanDriver::setViewportScissor(
     };
 
     mCurrentRenderTarget->transformClientRectToPlatform(&scissor);
-    vkCmdSetScissor(mContext.cmdbuffer, 0, 1, &scissor);
+    mDrawRecorder.setScissor(scissor);
 }
 
 void VulkanDriver::makeCurrent(Driver::SwapChainHandle sch) {
-    VulkanSurfaceContext& sContext = handle_cast<VulkanSwapChain>(mHandleMap, sch)->surfaceContext;
+    VulkanSurfaceContext& sContext = handle_cast<VulkanSwapChain>(sch)->surfaceContext;
     mContext.currentSurface = &sContext;
 }
 
@@ -701,22 +1022,81 @@ void VulkanDriver::commit(Driver::SwapChainHandle sch) {
             "Vulkan driver requires at least one frame before a commit.");
     releaseCommandBuffer(mContext);
 
-    // Present the backbuffer.
-    VulkanSurfaceContext& surface = handle_cast<VulkanSwapChain>(mHandleMap, sch)->surfaceContext;
+    // Present the backbuffer, unless there's nothing to present it to.
+    VulkanSurfaceContext& surface = handle_cast<VulkanSwapChain>(sch)->surfaceContext;
+    if (!surface.swapchain) {
+        mPresentationTime = 0;
+        mDamageRects.clear();
+        return;
+    }
     VkPresentInfoKHR presentInfo {
         .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
         .waitSemaphoreCount = 1,
-        .pWaitSemaphores = &surface.renderingFinished,
+        .pWaitSemaphores = &getSwapContext(mContext).renderingFinished,
         .swapchainCount = 1,
         .pSwapchains = &surface.swapchain,
         .pImageIndices = &surface.currentSwapIndex,
     };
+
+    // the presentation time applies to this commit only
+    VkPresentTimeGOOGLE presentTime {
+        .presentID = mPresentId++,
+        .desiredPresentTime = mPresentationTime,
+    };
+    VkPresentTimesInfoGOOGLE presentTimesInfo {
+        .sType = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE,
+        .swapchainCount = 1,
+        .pTimes = &presentTime,
+    };
+    if (mContext.displayTimingSupported && mPresentationTime) {
+        presentInfo.pNext = &presentTimesInfo;
+    }
+    mPresentationTime = 0;
+
+    // the damage applies to this commit only as well
+    VkPresentRegionKHR presentRegion {
+        .rectangleCount = uint32_t(mDamageRects.size()),
+        .pRectangles = mDamageRects.data(),
+    };
+    VkPresentRegionsKHR presentRegions {
+        .sType = VK_STRUCTURE_TYPE_PRESENT_REGIONS_KHR,
+        .pNext = presentInfo.pNext,
+        .swapchainCount = 1,
+        .pRegions = &presentRegion,
+    };
+    if (mContext.incrementalPresentSupported && !mDamageRects.empty()) {
+        // the rects are from the top-left corner of the swap chain image
+        const int32_t height = int32_t(surface.surfaceCapabilities.currentExtent.height);
+        for (VkRectLayerKHR& rect : mDamageRects) {
+            rect.offset.y = height - rect.offset.y - int32_t(rect.extent.height);
+        }
+        presentInfo.pNext = &presentRegions;
+    }
+
     VkResult result = vkQueuePresentKHR(surface.presentQueue, &presentInfo);
+    mDamageRects.clear();
     ASSERT_POSTCONDITION(result != VK_ERROR_OUT_OF_DATE_KHR && result != VK_SUBOPTIMAL_KHR,
             "Stale / resized swap chain not yet supported.");
     ASSERT_POSTCONDITION(result == VK_SUCCESS, "vkQueuePresentKHR error.");
 }
 
+void VulkanDriver::setPresentationTime(int64_t monotonic_clock_ns) {
+    // VK_GOOGLE_display_timing uses the same clock, see commit()
+    mPresentationTime = uint64_t(std::max(monotonic_clock_ns, int64_t(0)));
+}
+
+void VulkanDriver::setDamageRegions(Driver::DamageRegion const* regions, uint32_t count) {
+    // kept from the bottom-left corner until commit() knows the swap chain
+    mDamageRects.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        mDamageRects[i] = {
+            .offset = { regions[i].left, regions[i].bottom },
+            .extent = { regions[i].width, regions[i].height },
+            .layer = 0
+        };
+    }
+}
+
 void VulkanDriver::viewport(ssize_t left, ssize_t bottom, size_t width, size_t height) {
     assert(mContext.cmdbuffer && mCurrentRenderTarget);
     VkViewport viewport = mContext.viewport = {
@@ -733,19 +1113,30 @@ void VulkanDriver::viewport(ssize_t left, ssize_t bottom, size_t width, size_t h
     };
 
     mCurrentRenderTarget->transformClientRectToPlatform(&scissor);
-    vkCmdSetScissor(mContext.cmdbuffer, 0, 1, &scissor);
+    mDrawRecorder.setScissor(scissor);
 
     mCurrentRenderTarget->transformClientRectToPlatform(&viewport);
-    vkCmdSetViewport(mContext.cmdbuffer, 0, 1, &viewport);
+    mDrawRecorder.setViewport(viewport);
 }
 
 void VulkanDriver::bindUniforms(size_t index, Driver::UniformBufferHandle ubh) {
-    auto* buffer = handle_cast<VulkanUniformBuffer>(mHandleMap, ubh);
+    auto* buffer = handle_cast<VulkanUniformBuffer>(ubh);
     mBinder.bindUniformBuffer((uint32_t) index, buffer->getGpuBuffer());
 }
 
+void VulkanDriver::bindUniformsRange(size_t index, Driver::UniformBufferHandle ubh,
+        uint32_t offset, uint32_t size) {
+    auto* buffer = handle_cast<VulkanUniformBuffer>(ubh);
+    mBinder.bindUniformBuffer((uint32_t) index, buffer->getGpuBuffer(), offset, size);
+}
+
+void VulkanDriver::bindStorage(size_t index, Driver::UniformBufferHandle ubh) {
+    auto* buffer = handle_cast<VulkanUniformBuffer>(ubh);
+    mBinder.bindStorageBuffer((uint32_t) index, buffer->getGpuBuffer());
+}
+
 void VulkanDriver::bindSamplers(size_t index, Driver::SamplerBufferHandle sbh) {
-    auto* hwsb = handle_cast<VulkanSamplerBuffer>(mHandleMap, sbh);
+    auto* hwsb = handle_cast<VulkanSamplerBuffer>(sbh);
     mSamplerBindings[index] = hwsb;
 }
 
@@ -757,7 +1148,9 @@ void VulkanDriver::pushGroupMarker(char const* string,  size_t len) {
     constexpr float MARKER_COLOR[] = { 0.0f, 1.0f, 0.0f, 1.0f };
     ASSERT_POSTCONDITION(mContext.cmdbuffer,
             "Markers can only be inserted within a beginFrame / endFrame.");
-    if (mContext.debugMarkersSupported) {
+    if (mContext.debugMarkersSupported && mDrawRecorder.isRecording()) {
+        mDrawRecorder.pushMarker(string);
+    } else if (mContext.debugMarkersSupported) {
         VkDebugMarkerMarkerInfoEXT markerInfo = {};
         markerInfo.sType = VK_STRUCTURE_TYPE_DEBUG_MARKER_MARKER_INFO_EXT;
         memcpy(markerInfo.color, &MARKER_COLOR[0], sizeof(MARKER_COLOR));
@@ -769,11 +1162,68 @@ void VulkanDriver::pushGroupMarker(char const* string,  size_t len) {
 void VulkanDriver::popGroupMarker(int) {
     ASSERT_POSTCONDITION(mContext.cmdbuffer,
             "Markers can only be inserted within a beginFrame / endFrame.");
-    if (mContext.debugMarkersSupported) {
+    if (mContext.debugMarkersSupported && mDrawRecorder.isRecording()) {
+        mDrawRecorder.popMarker();
+    } else if (mContext.debugMarkersSupported) {
         vkCmdDebugMarkerEndEXT(mContext.cmdbuffer);
     }
 }
 
+void VulkanDriver::beginTimer(uint8_t timer) {
+    assert(!mTimerActive);
+    assert(timer < TIMER_COUNT);
+    ASSERT_POSTCONDITION(mContext.cmdbuffer,
+            "Timers can only be used within a beginFrame / endFrame.");
+    if (!mTimerQueryPool) {
+        return;
+    }
+    TimerFrame& timerFrame = mTimerFrames[mTimerFrame % TIMER_FRAME_COUNT];
+    if (timerFrame.count >= TIMERS_PER_FRAME) {
+        return;
+    }
+    const uint32_t query = ((mTimerFrame % TIMER_FRAME_COUNT) * TIMERS_PER_FRAME +
+            timerFrame.count) * 2;
+    vkCmdWriteTimestamp(mContext.cmdbuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+            mTimerQueryPool, query);
+    timerFrame.timers[timerFrame.count] = timer;
+    mTimerActive = true;
+}
+
+void VulkanDriver::endTimer(int) {
+    if (!mTimerActive) {
+        return;
+    }
+    TimerFrame& timerFrame = mTimerFrames[mTimerFrame % TIMER_FRAME_COUNT];
+    const uint32_t query = ((mTimerFrame % TIMER_FRAME_COUNT) * TIMERS_PER_FRAME +
+            timerFrame.count) * 2 + 1;
+    vkCmdWriteTimestamp(mContext.cmdbuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            mTimerQueryPool, query);
+    timerFrame.count++;
+    mTimerActive = false;
+}
+
+void VulkanDriver::readTimerQueries(TimerFrame const& timerFrame) noexcept {
+    if (!timerFrame.count) {
+        return;
+    }
+    uint64_t timestamps[TIMERS_PER_FRAME * 2];
+    const VkResult result = vkGetQueryPoolResults(mContext.device, mTimerQueryPool,
+            (timerFrame.frame % TIMER_FRAME_COUNT) * TIMERS_PER_FRAME * 2, timerFrame.count * 2,
+            sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) {
+        // the GPU is more than TIMER_FRAME_COUNT frames late, this frame isn't timed
+        return;
+    }
+    const float period = mContext.physicalDeviceProperties.limits.timestampPeriod * 1e-6f;
+    float times[TIMER_COUNT] = {};
+    for (uint32_t i = 0; i < timerFrame.count; i++) {
+        times[timerFrame.timers[i]] += float(timestamps[i * 2 + 1] - timestamps[i * 2]) * period;
+    }
+    std::copy_n(times, TIMER_COUNT, mGpuTimeMilli);
+    mGpuTimeFrame = timerFrame.frame;
+    mHasGpuTime = true;
+}
+
 void VulkanDriver::readPixels(Driver::RenderTargetHandle src,
         uint32_t x, uint32_t y, uint32_t width, uint32_t height,
         PixelBufferDescriptor&& p) {
@@ -793,13 +1243,59 @@ void VulkanDriver::blit(TargetBufferFlags buffers,
 }
 
 void VulkanDriver::draw(Driver::ProgramHandle ph, Driver::RasterState rasterState,
-        Driver::RenderPrimitiveHandle rph) {
+        Driver::RenderPrimitiveHandle rph, uint32_t instanceCount) {
+    const VulkanRenderPrimitive& prim = *handle_cast<VulkanRenderPrimitive>(rph);
+    VulkanDrawRecorder::Draw command;
+    prepareDraw(ph, rasterState, rph, command);
+
+    // TODO: support subranges
+    command.indexCount = prim.count;
+    command.firstIndex = prim.offset / prim.indexBuffer->elementSize;
+    command.vertexOffset = 0;
+    command.instanceCount = instanceCount;
+    command.firstInstance = 0;
+    mDrawRecorder.draw(command, prim.buffers.data(), prim.offsets.data());
+}
+
+void VulkanDriver::drawIndirect(Driver::ProgramHandle ph, Driver::RasterState rasterState,
+        Driver::RenderPrimitiveHandle rph, Driver::DrawIndirectCommand const* commands,
+        uint32_t count, math::float4 const* planes, Driver::DrawBounds const* bounds) {
+    const VulkanRenderPrimitive& prim = *handle_cast<VulkanRenderPrimitive>(rph);
+    VulkanDrawRecorder::Draw command;
+    prepareDraw(ph, rasterState, rph, command);
+
+    // The commands are recorded as direct draws sharing the state resolved above, which doesn't
+    // need the multiDrawIndirect and drawIndirectFirstInstance features, nor a buffer that lives
+    // until the frame completes. For the same reason, culled draws are skipped here, on the driver
+    // thread, rather than with a compute shader.
+    for (uint32_t i = 0; i < count; i++) {
+        if (planes && !bounds[i].isVisible(planes)) {
+            continue;
+        }
+        Driver::DrawIndirectCommand const& c = commands[i];
+        command.indexCount = c.count;
+        command.firstIndex = c.firstIndex;
+        command.vertexOffset = c.baseVertex;
+        command.instanceCount = c.instanceCount;
+        command.firstInstance = c.baseInstance;
+        mDrawRecorder.draw(command, prim.buffers.data(), prim.offsets.data());
+    }
+}
+
+void VulkanDriver::dispatchCompute(Driver::ProgramHandle ph, Driver::TextureHandle th,
+        uint32_t groupCountX, uint32_t groupCountY) {
+    // never called, see isComputeSupported()
+    assert(false);
+}
+
+void VulkanDriver::prepareDraw(Driver::ProgramHandle ph, Driver::RasterState rasterState,
+        Driver::RenderPrimitiveHandle rph, VulkanDrawRecorder::Draw& command) {
     VkCommandBuffer cmdbuffer = mContext.cmdbuffer;
     ASSERT_POSTCONDITION(cmdbuffer, "Draw calls can occur only within a beginFrame / endFrame.");
-    const VulkanRenderPrimitive& prim = *handle_cast<VulkanRenderPrimitive>(mHandleMap, rph);
+    const VulkanRenderPrimitive& prim = *handle_cast<VulkanRenderPrimitive>(rph);
 
     // If this is a debug build, validate the current shader.
-    auto* program = handle_cast<VulkanProgram>(mHandleMap, ph);
+    auto* program = handle_cast<VulkanProgram>(ph);
 #if !defined(NDEBUG)
     if (program->bundle.vertex == VK_NULL_HANDLE || program->bundle.fragment == VK_NULL_HANDLE) {
         utils::slog.e << "Binding missing shader: " << program->name.c_str() << utils::io::endl;
@@ -844,10 +1340,23 @@ void VulkanDriver::draw(Driver::ProgramHandle ph, Driver::RasterState rasterStat
     mBinder.bindPrimitiveTopology(prim.primitiveTopology);
     mBinder.bindVertexArray(prim.varray);
 
+    // The samplers of the last draw are still bound if nothing they depend on changed since.
+    bool samplersBound = mBoundSamplers.program == program &&
+            mBoundSamplers.transferSerial == mContext.transferSerial;
+    for (uint8_t bufferIdx = 0; bufferIdx < VulkanBinder::NUM_SAMPLER_BINDINGS; bufferIdx++) {
+        VulkanSamplerBuffer const* vksb = mSamplerBindings[bufferIdx];
+        const uint32_t generation = vksb ? vksb->generation : 0;
+        samplersBound = samplersBound && mBoundSamplers.generations[bufferIdx] == generation;
+        mBoundSamplers.generations[bufferIdx] = generation;
+    }
+    mBoundSamplers.program = program;
+    mBoundSamplers.transferSerial = mContext.transferSerial;
+
     // Query the program for the mapping from (SamplerBufferBinding,Offset) to (SamplerBinding),
     // where "SamplerBinding" is the integer in the GLSL, and SamplerBufferBinding is the abstract
     // Filament concept used to form groups of samplers.
-    for (uint8_t bufferIdx = 0; bufferIdx < VulkanBinder::NUM_SAMPLER_BINDINGS; bufferIdx++) {
+    for (uint8_t bufferIdx = 0; !samplersBound && bufferIdx < VulkanBinder::NUM_SAMPLER_BINDINGS;
+            bufferIdx++) {
         VulkanSamplerBuffer* vksb = mSamplerBindings[bufferIdx];
         if (!vksb) {
             continue;
@@ -862,8 +1371,12 @@ void VulkanDriver::draw(Driver::ProgramHandle ph, Driver::RasterState rasterStat
             if (program->samplerBindings.getSamplerBinding(bufferIdx, samplerIndex, &binding,
                     &group)) {
                 const SamplerParams& samplerParams = sampler->s;
-                VkSampler vksampler = mSamplerCache.getSampler(samplerParams);
-                const auto* tex = handle_const_cast<VulkanTexture>(mHandleMap, sampler->t);
+                const auto* tex = handle_const_cast<VulkanTexture>(sampler->t);
+                VkSampler vksampler = mSamplerCache.getSampler(samplerParams,
+                        tex->minLevel, tex->maxLevel);
+                if (tex->transferSerial > mContext.acquiredTransferSerial) {
+                    acquireTransfers(mContext, tex->transferSerial);
+                }
                 mBinder.bindSampler(binding, {
                     .sampler = vksampler,
                     .imageView = tex->imageView,
@@ -875,36 +1388,17 @@ void VulkanDriver::draw(Driver::ProgramHandle ph, Driver::RasterState rasterStat
         }
     }
 
-    // Bind a new descriptor set if it needs to change.
-    VkDescriptorSet descriptor;
-    VkPipelineLayout pipelineLayout;
-    if (mBinder.getOrCreateDescriptor(&descriptor, &pipelineLayout)) {
-        vkCmdBindDescriptorSets(cmdbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1,
-                &descriptor, 0, nullptr);
-    }
-
-    // Bind the pipeline if it changed. This can happen, for example, if the raster state changed.
-    // Creating a new pipeline is slow, so we should consider using pipeline cache objects.
-    VkPipeline pipeline;
-    if (mBinder.getOrCreatePipeline(&pipeline)) {
-        vkCmdBindPipeline(cmdbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-    }
-
-    // Next bind the vertex buffers and index buffer. One potential performance improvement is to
-    // avoid rebinding these if they are already bound, but since we do not (yet) support subranges
-    // it would be rare for a client to make consecutive draw calls with the same render primitive.
-    vkCmdBindVertexBuffers(cmdbuffer, 0, (uint32_t) prim.buffers.size(),
-            prim.buffers.data(), prim.offsets.data());
-    vkCmdBindIndexBuffer(cmdbuffer, prim.indexBuffer->buffer->getGpuBuffer(), 0,
-            prim.indexBuffer->indexType);
-
-    // Finally, make the actual draw call. TODO: support subranges
-    const uint32_t indexCount = prim.count;
-    const uint32_t instanceCount = 1;
-    const uint32_t firstIndex = prim.offset / prim.indexBuffer->elementSize;
-    const int32_t vertexOffset = 0;
-    const uint32_t firstInstId = 1;
-    vkCmdDrawIndexed(cmdbuffer, indexCount, instanceCount, firstIndex, vertexOffset, firstInstId);
+    // Resolve the descriptor set and the pipeline. Both are always returned, the render pass
+    // recorder skips redundant bindings itself since the draw calls may be split across secondary
+    // command buffers.
+    mBinder.getOrCreateDescriptor(&command.descriptor, &command.pipelineLayout);
+    mBinder.getOrCreatePipeline(&command.pipeline);
+    command.pipelineLayout = mBinder.getPipelineLayout();
+    memcpy(command.dynamicOffsets, mBinder.getDynamicOffsets(), sizeof(command.dynamicOffsets));
+
+    command.indexBuffer = prim.indexBuffer->buffer->getGpuBuffer();
+    command.indexType = prim.indexBuffer->indexType;
+    command.vertexBufferCount = (uint32_t) prim.buffers.size();
 }
 
 #ifndef NDEBUG
@@ -19,23 +19,24 @@
 
 #include "VulkanBinder.h"
 #include "VulkanDriverImpl.h"
+#include "VulkanDrawRecorder.h"
 #include "VulkanFboCache.h"
 #include "VulkanSamplerCache.h"
 #include "VulkanStagePool.h"
 
 #include "driver/Driver.h"
 #include "driver/DriverBase.h"
+#include "driver/HandleAllocator.h"
 
 #include <utils/compiler.h>
 #include <utils/Allocator.h>
-
-#include <unordered_map>
-#include <vector>
+#include <utils/Panic.h>
 
 namespace filament {
 namespace driver {
 
 struct VulkanRenderTarget;
+struct VulkanProgram;
 struct VulkanSamplerBuffer;
 
 class VulkanDriver final : public DriverBase {
@@ -75,57 +76,68 @@ private:
     VulkanDriver(VulkanDriver const&) = delete;
     VulkanDriver& operator = (VulkanDriver const&) = delete;
 
+    void createPipelineCache();
+    void savePipelineCache();
+
+    // binds the state of a draw call and fills in all of 'command' but its ranges, see draw()
+    void prepareDraw(Driver::ProgramHandle ph, Driver::RasterState rasterState,
+            Driver::RenderPrimitiveHandle rph, VulkanDrawRecorder::Draw& command);
+
     driver::ContextManagerVk& mContextManager;
 
-    // For now we're not bothering to store handles in pools, just simple on-demand allocation.
-    // We have a little map from integer handles to "blobs" which get replaced with the Hw objects.
-    using Blob = std::vector<uint8_t>;
-    using HandleMap = std::unordered_map<HandleBase::HandleId, Blob>;
-    HandleMap mHandleMap;
-    HandleBase::HandleId mNextId = 1;
+    // The Hw objects are allocated from pools, a handle's id is the offset of its object.
+    //    VulkanSamplerBuffer, VulkanIndexBuffer                                  : <= 64 bytes
+    //    VulkanTexture, VulkanVertexBuffer, VulkanProgram, VulkanRenderTarget,
+    //    VulkanUniformBuffer                                                     : <= 160 bytes
+    //    VulkanRenderPrimitive, VulkanSwapChain                                  : <= 384 bytes
+    using HandleAllocatorVK = HandleAllocator<64, 160, 384>;
+    using HandleArena = filament::HandleArena<HandleAllocatorVK>;
+    HandleArena mHandleArena;
 
     template<typename Dp, typename B>
-    Handle<B> alloc_handle() {
-        mHandleMap[mNextId] = Blob(sizeof(Dp));
-        return Handle<B>(mNextId++);
+    Handle<B> alloc_handle() noexcept {
+        static_assert(sizeof(Dp) <= 384, "Handle<> too large");
+        void* addr = mHandleArena.alloc(sizeof(Dp));
+        ASSERT_POSTCONDITION(addr, "Out of memory for handles.");
+        char* const base = (char *)mHandleArena.getArea().begin();
+        size_t offset = (char*)addr - base;
+        return Handle<B>(HandleBase::HandleId(offset >> HandleAllocatorVK::MIN_ALIGNMENT_SHIFT));
     }
 
     template<typename Dp, typename B>
-    Dp* handle_cast(HandleMap& handleMap, Handle<B>& handle) noexcept {
+    Dp* handle_cast(Handle<B>& handle) noexcept {
         assert(handle);
-        auto iter = handleMap.find(handle.getId());
-        assert(iter != handleMap.end());
-        Blob& blob = iter->second;
-        assert(blob.size() == sizeof(Dp));
-        return reinterpret_cast<Dp*>(blob.data());
+        char* const base = (char *)mHandleArena.getArea().begin();
+        size_t offset = handle.getId() << HandleAllocatorVK::MIN_ALIGNMENT_SHIFT;
+        return reinterpret_cast<Dp*>(base + offset);
     }
 
     template<typename Dp, typename B>
-    const Dp* handle_const_cast(HandleMap& handleMap, const Handle<B>& handle) noexcept {
-        assert(handle);
-        auto iter = handleMap.find(handle.getId());
-        assert(iter != handleMap.end());
-        Blob& blob = iter->second;
-        assert(blob.size() == sizeof(Dp));
-        return reinterpret_cast<const Dp*>(blob.data());
+    const Dp* handle_const_cast(const Handle<B>& handle) noexcept {
+        return handle_cast<Dp>(const_cast<Handle<B>&>(handle));
     }
 
     template<typename Dp, typename B, typename ... ARGS>
-    Dp* construct_handle(HandleMap& handleMap, Handle<B>& handle, ARGS&& ... args) noexcept {
-        auto iter = handleMap.find(handle.getId());
-        assert(iter != handleMap.end());
-        Blob& blob = iter->second;
-        assert(blob.size() == sizeof(Dp));
-        Dp* addr = reinterpret_cast<Dp*>(blob.data());
+    Dp* construct_handle(Handle<B>& handle, ARGS&& ... args) noexcept {
+        Dp* addr = handle_cast<Dp>(handle);
         new(addr) Dp(std::forward<ARGS>(args)...);
         return addr;
     }
 
     template<typename Dp, typename B>
-    void destruct_handle(HandleMap& handleMap, Handle<B>& handle) noexcept {
-        // Call the destructor, remove the blob, don't bother reclaiming the integer id.
-        handle_cast<Dp>(handleMap, handle)->~Dp();
-        handleMap.erase(handle.getId());
+    void destruct_handle(Handle<B>& handle) noexcept {
+        Dp* addr = handle_cast<Dp>(handle);
+        addr->~Dp();
+        mHandleArena.free(addr, sizeof(Dp));
+    }
+
+    // Destroys the object once the frames that may use it have completed, instead of waiting for
+    // the GPU to be idle.
+    template<typename Dp, typename B>
+    void destruct_handle_deferred(Handle<B> handle) noexcept {
+        deferDisposal(mContext, [this, handle] (VkCommandBuffer) mutable {
+            destruct_handle<Dp>(handle);
+        });
     }
 
     VulkanContext mContext = {};
@@ -133,9 +145,53 @@ private:
     VulkanStagePool mStagePool;
     VulkanFboCache mFramebufferCache;
     VulkanSamplerCache mSamplerCache;
+    VulkanDrawRecorder mDrawRecorder;
     VulkanRenderTarget* mCurrentRenderTarget = nullptr;
     VulkanSamplerBuffer* mSamplerBindings[VulkanBinder::NUM_SAMPLER_BINDINGS] = {};
+
+    // The samplers given to the binder by the last draw. They're given again only if the program,
+    // the content of a sampler buffer or a texture changed since, or if a transfer was submitted,
+    // so that the binder keeps the descriptor set of a run of draws with the same material.
+    struct {
+        VulkanProgram const* program = nullptr;     // null when the samplers must be bound again
+        uint32_t generations[VulkanBinder::NUM_SAMPLER_BINDINGS] = {};
+        uint64_t transferSerial = 0;
+    } mBoundSamplers;
+    uint32_t mSamplerBufferGeneration = 0;
     VkDebugReportCallbackEXT mDebugCallback = VK_NULL_HANDLE;
+
+    // the desired presentation time of the next commit (0 when there's none), and its id, see
+    // setPresentationTime()
+    uint64_t mPresentationTime = 0;
+    uint32_t mPresentId = 0;
+
+    // the regions of the next commit that changed, see setDamageRegions()
+    std::vector<VkRectLayerKHR> mDamageRects;
+
+    // The pipeline cache is loaded from, and saved to, the application's BlobCache if there's one.
+    // It is saved once no pipeline has been created for a while.
+    VkPipelineCache mPipelineCache = VK_NULL_HANDLE;
+    uint32_t mPipelineCount = 0;        // pipelines created as of the last beginFrame
+    uint32_t mSavedPipelineCount = 0;   // pipelines created as of the last save
+    uint32_t mPipelineCacheAge = 0;     // frames since a pipeline was created
+
+    // GPU timers, see beginTimer(). Each frame writes its timestamps in its own range of the
+    // query pool, which is read back when the range is reused TIMER_FRAME_COUNT frames later.
+    static constexpr uint32_t TIMER_FRAME_COUNT = 4;
+    static constexpr uint32_t TIMERS_PER_FRAME = 16;
+    struct TimerFrame {
+        uint32_t frame = 0;
+        uint32_t count = 0;                 // number of timed ranges
+        uint8_t timers[TIMERS_PER_FRAME];   // the Timer of each range
+    };
+    void readTimerQueries(TimerFrame const& frame) noexcept;
+    VkQueryPool mTimerQueryPool = VK_NULL_HANDLE;
+    TimerFrame mTimerFrames[TIMER_FRAME_COUNT];
+    uint32_t mTimerFrame = 0;           // frames started
+    float mGpuTimeMilli[TIMER_COUNT] = {};
+    uint32_t mGpuTimeFrame = 0;
+    bool mHasGpuTime = false;
+    bool mTimerActive = false;
 };
 
 } // namespace driver
@@ -33,6 +33,9 @@
 
 #include <utils/Panic.h>
 
+#include <algorithm>
+#include <iterator>
+
 namespace filament {
 namespace driver {
 
@@ -67,6 +70,7 @@ void selectPhysicalDevice(VulkanContext& context) {
         vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamiliesCount,
                 queueFamiliesProperties.data());
         context.graphicsQueueFamilyIndex = 0xffff;
+        context.transferQueueFamilyIndex = 0xffff;
         for (uint32_t j = 0; j < queueFamiliesCount; ++j) {
             VkQueueFamilyProperties props = queueFamiliesProperties[j];
             if (props.queueCount == 0) {
@@ -75,6 +79,15 @@ void selectPhysicalDevice(VulkanContext& context) {
             if (props.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
                 context.graphicsQueueFamilyIndex = j;
             }
+
+            // A transfer-only family is usually backed by a DMA engine that runs concurrently
+            // with rendering. We only use it if it can copy images of any size.
+            const VkExtent3D granularity = props.minImageTransferGranularity;
+            if ((props.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+                    !(props.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) &&
+                    granularity.width == 1 && granularity.height == 1 && granularity.depth == 1) {
+                context.transferQueueFamilyIndex = j;
+            }
         }
         if (context.graphicsQueueFamilyIndex == 0xffff) continue;
 
@@ -89,7 +102,11 @@ void selectPhysicalDevice(VulkanContext& context) {
                 &extensionCount, extensions.data());
         ASSERT_POSTCONDITION(result == VK_SUCCESS, "vkEnumerateDeviceExtensionProperties error.");
         bool supportsSwapchain = false;
+        bool supportsMemoryRequirements2 = false;
+        bool supportsDedicatedAllocation = false;
         context.debugMarkersSupported = false;
+        context.displayTimingSupported = false;
+        context.incrementalPresentSupported = false;
         for (uint32_t k = 0; k < extensionCount; ++k) {
             if (!strcmp(extensions[k].extensionName, VK_KHR_SWAPCHAIN_EXTENSION_NAME)) {
                 supportsSwapchain = true;
@@ -97,8 +114,24 @@ void selectPhysicalDevice(VulkanContext& context) {
             if (!strcmp(extensions[k].extensionName, VK_EXT_DEBUG_MARKER_EXTENSION_NAME)) {
                 context.debugMarkersSupported = true;
             }
+            if (!strcmp(extensions[k].extensionName, VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME)) {
+                context.displayTimingSupported = true;
+            }
+            if (!strcmp(extensions[k].extensionName, VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME)) {
+                context.incrementalPresentSupported = true;
+            }
+            if (!strcmp(extensions[k].extensionName,
+                    VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME)) {
+                supportsMemoryRequirements2 = true;
+            }
+            if (!strcmp(extensions[k].extensionName,
+                    VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME)) {
+                supportsDedicatedAllocation = true;
+            }
         }
         if (!supportsSwapchain) continue;
+        context.dedicatedAllocationSupported =
+                supportsMemoryRequirements2 && supportsDedicatedAllocation;
 
         // Bingo, we finally found a physical device that supports everything we need.
         context.physicalDevice = physicalDevice;
@@ -138,7 +171,7 @@ void selectPhysicalDevice(VulkanContext& context) {
 }
 
 void createVirtualDevice(VulkanContext& context) {
-    VkDeviceQueueCreateInfo deviceQueueCreateInfo[1] = {};
+    VkDeviceQueueCreateInfo deviceQueueCreateInfo[2] = {};
     static const float queuePriority[] = {1.0f};
     VkDeviceCreateInfo deviceCreateInfo = {};
     std::vector<const char*> deviceExtensionNames = {
@@ -147,12 +180,27 @@ void createVirtualDevice(VulkanContext& context) {
     if (context.debugMarkersSupported) {
         deviceExtensionNames.push_back(VK_EXT_DEBUG_MARKER_EXTENSION_NAME);
     }
+    if (context.displayTimingSupported) {
+        deviceExtensionNames.push_back(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+    }
+    if (context.incrementalPresentSupported) {
+        deviceExtensionNames.push_back(VK_KHR_INCREMENTAL_PRESENT_EXTENSION_NAME);
+    }
+    if (context.dedicatedAllocationSupported) {
+        deviceExtensionNames.push_back(VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME);
+        deviceExtensionNames.push_back(VK_KHR_DEDICATED_ALLOCATION_EXTENSION_NAME);
+    }
     deviceQueueCreateInfo->sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
     deviceQueueCreateInfo->queueFamilyIndex = context.graphicsQueueFamilyIndex;
     deviceQueueCreateInfo->queueCount = 1;
     deviceQueueCreateInfo->pQueuePriorities = &queuePriority[0];
+    const bool hasTransferQueue = context.transferQueueFamilyIndex != 0xffff;
+    if (hasTransferQueue) {
+        deviceQueueCreateInfo[1] = deviceQueueCreateInfo[0];
+        deviceQueueCreateInfo[1].queueFamilyIndex = context.transferQueueFamilyIndex;
+    }
     deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    deviceCreateInfo.queueCreateInfoCount = 1;
+    deviceCreateInfo.queueCreateInfoCount = hasTransferQueue ? 2 : 1;
     deviceCreateInfo.pQueueCreateInfos = deviceQueueCreateInfo;
     deviceCreateInfo.pEnabledFeatures = nullptr;
     deviceCreateInfo.enabledExtensionCount = deviceExtensionNames.size();
@@ -170,6 +218,18 @@ void createVirtualDevice(VulkanContext& context) {
     result = vkCreateCommandPool(context.device, &createInfo, VKALLOC, &context.commandPool);
     ASSERT_POSTCONDITION(result == VK_SUCCESS, "vkCreateCommandPool error.");
 
+    // Texture uploads are streamed through the transfer queue when there's a dedicated one. Each
+    // upload gets its own short-lived command buffer.
+    if (hasTransferQueue) {
+        vkGetDeviceQueue(context.device, context.transferQueueFamilyIndex, 0,
+                &context.transferQueue);
+        createInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        createInfo.queueFamilyIndex = context.transferQueueFamilyIndex;
+        result = vkCreateCommandPool(context.device, &createInfo, VKALLOC,
+                &context.transferCommandPool);
+        ASSERT_POSTCONDITION(result == VK_SUCCESS, "vkCreateCommandPool error.");
+    }
+
     const VmaVulkanFunctions funcs {
         .vkGetPhysicalDeviceProperties = vkGetPhysicalDeviceProperties,
         .vkGetPhysicalDeviceMemoryProperties = vkGetPhysicalDeviceMemoryProperties,
@@ -188,7 +248,11 @@ void createVirtualDevice(VulkanContext& context) {
         .vkGetBufferMemoryRequirements2KHR = vkGetBufferMemoryRequirements2KHR,
         .vkGetImageMemoryRequirements2KHR = vkGetImageMemoryRequirements2KHR
     };
+    // With VK_KHR_dedicated_allocation, VMA asks the driver which images and buffers would rather
+    // have their own VkDeviceMemory and sub-allocates everything else.
     const VmaAllocatorCreateInfo allocatorInfo {
+        .flags = context.dedicatedAllocationSupported ?
+                VMA_ALLOCATOR_CREATE_KHR_DEDICATED_ALLOCATION_BIT : 0u,
         .physicalDevice = context.physicalDevice,
         .device = context.device,
         .pVulkanFunctions = &funcs
@@ -263,6 +327,18 @@ void createSwapChainAndImages(VulkanContext& context, VulkanSurfaceContext& surf
             break;
         }
     }
+    // FIFO is the only present mode always supported
+    uint32_t presentModeCount;
+    vkGetPhysicalDeviceSurfacePresentModesKHR(context.physicalDevice, surfaceContext.surface,
+            &presentModeCount, nullptr);
+    std::vector<VkPresentModeKHR> presentModes(presentModeCount);
+    vkGetPhysicalDeviceSurfacePresentModesKHR(context.physicalDevice, surfaceContext.surface,
+            &presentModeCount, presentModes.data());
+    if (std::find(presentModes.begin(), presentModes.end(), surfaceContext.presentMode) ==
+            presentModes.end()) {
+        surfaceContext.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    }
+
     const auto compositionCaps = surfaceContext.surfaceCapabilities.supportedCompositeAlpha;
     const auto compositeAlpha = (compositionCaps & VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR) ?
             VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR : VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
@@ -280,7 +356,7 @@ void createSwapChainAndImages(VulkanContext& context, VulkanSurfaceContext& surf
         .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
         .preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR,
         .compositeAlpha = compositeAlpha,
-        .presentMode = VK_PRESENT_MODE_FIFO_KHR,
+        .presentMode = surfaceContext.presentMode,
         .clipped = VK_TRUE
     };
     VkSwapchainKHR swapchain;
@@ -292,13 +368,13 @@ void createSwapChainAndImages(VulkanContext& context, VulkanSurfaceContext& surf
     uint32_t imageCount;
     result = vkGetSwapchainImagesKHR(context.device, swapchain, &imageCount, nullptr);
     ASSERT_POSTCONDITION(result == VK_SUCCESS, "vkGetSwapchainImagesKHR count error.");
-    surfaceContext.swapContexts.resize(imageCount);
+    surfaceContext.swapImages.resize(imageCount);
     std::vector<VkImage> images(imageCount);
     result = vkGetSwapchainImagesKHR(context.device, swapchain, &imageCount,
             images.data());
     ASSERT_POSTCONDITION(result == VK_SUCCESS, "vkGetSwapchainImagesKHR error.");
     for (size_t i = 0; i < images.size(); ++i) {
-        surfaceContext.swapContexts[i].attachment = {
+        surfaceContext.swapImages[i] = {
             .image = images[i],
             .format = surfaceContext.surfaceFormat.format
         };
@@ -322,12 +398,54 @@ void createSwapChainAndImages(VulkanContext& context, VulkanSurfaceContext& surf
     for (size_t i = 0; i < images.size(); ++i) {
         ivCreateInfo.image = images[i];
         result = vkCreateImageView(context.device, &ivCreateInfo, VKALLOC,
-                &surfaceContext.swapContexts[i].attachment.view);
+                &surfaceContext.swapImages[i].view);
         ASSERT_POSTCONDITION(result == VK_SUCCESS, "vkCreateImageView error.");
     }
 
-    createSemaphore(context.device, &surfaceContext.imageAvailable);
-    createSemaphore(context.device, &surfaceContext.renderingFinished);
+    surfaceContext.depth = {};
+}
+
+void createHeadlessImages(VulkanContext& context, VulkanSurfaceContext& surfaceContext,
+        uint32_t width, uint32_t height) {
+    // The images stand in for the ones of a swap chain, they're rendered into in turn and can be
+    // read back, but aren't presented.
+    surfaceContext.surface = VK_NULL_HANDLE;
+    surfaceContext.swapchain = VK_NULL_HANDLE;
+    surfaceContext.presentQueue = context.graphicsQueue;
+    surfaceContext.surfaceFormat = { VK_FORMAT_R8G8B8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
+    surfaceContext.surfaceCapabilities = {};
+    surfaceContext.surfaceCapabilities.currentExtent = { width, height };
+    surfaceContext.clientSize = { width, height };
+    surfaceContext.swapImages.resize(2);
+    surfaceContext.currentSwapIndex = 0;
+
+    const VkImageCreateInfo imageInfo {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .extent = { width, height, 1 },
+        .format = surfaceContext.surfaceFormat.format,
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+    };
+    VkImageViewCreateInfo ivCreateInfo = {};
+    ivCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    ivCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    ivCreateInfo.format = surfaceContext.surfaceFormat.format;
+    ivCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    ivCreateInfo.subresourceRange.levelCount = 1;
+    ivCreateInfo.subresourceRange.layerCount = 1;
+    for (VulkanAttachment& image : surfaceContext.swapImages) {
+        VkResult result = createImage(context, imageInfo, &image.image, &image.memory);
+        ASSERT_POSTCONDITION(result == VK_SUCCESS, "Unable to create headless image.");
+        image.format = surfaceContext.surfaceFormat.format;
+        ivCreateInfo.image = image.image;
+        result = vkCreateImageView(context.device, &ivCreateInfo, VKALLOC, &image.view);
+        ASSERT_POSTCONDITION(result == VK_SUCCESS, "vkCreateImageView error.");
+    }
+    utils::slog.i << "Headless swap chain: " << width << "x" << height << utils::io::endl;
 
     surfaceContext.depth = {};
 }
@@ -336,37 +454,24 @@ void createDepthBuffer(VulkanContext& context, VulkanSurfaceContext& surfaceCont
         VkFormat depthFormat) {
     assert(context.cmdbuffer);
 
-    // Create an appropriately-sized device-only VkImage.
+    // Create an appropriately-sized device-only VkImage. Like the depth of offscreen targets, it's
+    // transient since it is never sampled.
     const auto size = surfaceContext.surfaceCapabilities.currentExtent;
     VkImage depthImage;
-    VkImageCreateInfo imageInfo {
+    const VkImageCreateInfo imageInfo {
         .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
         .imageType = VK_IMAGE_TYPE_2D,
         .extent = { size.width, size.height, 1 },
         .format = depthFormat,
         .mipLevels = 1,
         .arrayLayers = 1,
-        .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+        .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
         .samples = VK_SAMPLE_COUNT_1_BIT,
     };
-    VkResult error = vkCreateImage(context.device, &imageInfo, VKALLOC, &depthImage);
+    VkResult error = createImage(context, imageInfo, &depthImage, &surfaceContext.depth.memory);
     ASSERT_POSTCONDITION(!error, "Unable to create depth image.");
 
-    // Allocate memory for the VkImage and bind it.
-    VkMemoryRequirements memReqs;
-    vkGetImageMemoryRequirements(context.device, depthImage, &memReqs);
-    VkMemoryAllocateInfo allocInfo {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .allocationSize = memReqs.size,
-        .memoryTypeIndex = selectMemoryType(context, memReqs.memoryTypeBits,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
-    };
-    error = vkAllocateMemory(context.device, &allocInfo, nullptr,
-            &surfaceContext.depth.memory);
-    ASSERT_POSTCONDITION(!error, "Unable to allocate depth memory.");
-    error = vkBindImageMemory(context.device, depthImage, surfaceContext.depth.memory, 0);
-    ASSERT_POSTCONDITION(!error, "Unable to bind depth memory.");
-
     // Create a VkImageView so that we can attach depth to the framebuffer.
     VkImageView depthView;
     VkImageViewCreateInfo viewInfo {
@@ -439,45 +544,54 @@ void transitionDepthBuffer(VulkanContext& context, VulkanSurfaceContext& sc, VkF
 }
 
 void createCommandBuffersAndFences(VulkanContext& context, VulkanSurfaceContext& surfaceContext) {
-    // Allocate command buffers.
+    // Allocate command buffers, one per frame in flight.
     VkCommandBufferAllocateInfo allocateInfo = {};
     allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocateInfo.commandPool = context.commandPool;
     allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocateInfo.commandBufferCount = (uint32_t) surfaceContext.swapContexts.size();
-    std::vector<VkCommandBuffer> cmdbufs(allocateInfo.commandBufferCount);
-    VkResult result = vkAllocateCommandBuffers(context.device, &allocateInfo, cmdbufs.data());
+    allocateInfo.commandBufferCount = VULKAN_FRAMES_IN_FLIGHT;
+    VkCommandBuffer cmdbufs[VULKAN_FRAMES_IN_FLIGHT];
+    VkResult result = vkAllocateCommandBuffers(context.device, &allocateInfo, cmdbufs);
     ASSERT_POSTCONDITION(result == VK_SUCCESS, "vkAllocateCommandBuffers error.");
-    for (uint32_t i = 0; i < allocateInfo.commandBufferCount; ++i) {
+    for (uint32_t i = 0; i < VULKAN_FRAMES_IN_FLIGHT; ++i) {
         surfaceContext.swapContexts[i].cmdbuffer = cmdbufs[i];
     }
 
-    // Create fences.
+    // Create fences and semaphores. The semaphores of a frame can't be reused before its fence is
+    // signaled, so they can't belong to the swap chain images, which are acquired in any order.
     VkFenceCreateInfo fenceCreateInfo = {};
     fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
     fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-    for (uint32_t i = 0; i < allocateInfo.commandBufferCount; i++) {
-        result = vkCreateFence(context.device, &fenceCreateInfo, VKALLOC,
-                &surfaceContext.swapContexts[i].fence);
+    for (SwapContext& swapContext : surfaceContext.swapContexts) {
+        result = vkCreateFence(context.device, &fenceCreateInfo, VKALLOC, &swapContext.fence);
         ASSERT_POSTCONDITION(result == VK_SUCCESS, "vkCreateFence error.");
+        createSemaphore(context.device, &swapContext.imageAvailable);
+        createSemaphore(context.device, &swapContext.renderingFinished);
     }
+    surfaceContext.currentFrameIndex = 0;
 }
 
 void destroySurfaceContext(VulkanContext& context, VulkanSurfaceContext& surfaceContext) {
     for (SwapContext& swapContext : surfaceContext.swapContexts) {
         vkFreeCommandBuffers(context.device, context.commandPool, 1, &swapContext.cmdbuffer);
         vkDestroyFence(context.device, swapContext.fence, VKALLOC);
-        vkDestroyImageView(context.device, swapContext.attachment.view, VKALLOC);
+        vkDestroySemaphore(context.device, swapContext.imageAvailable, VKALLOC);
+        vkDestroySemaphore(context.device, swapContext.renderingFinished, VKALLOC);
         swapContext.fence = VK_NULL_HANDLE;
-        swapContext.attachment.view = VK_NULL_HANDLE;
     }
-    vkDestroySwapchainKHR(context.device, surfaceContext.swapchain, VKALLOC);
-    vkDestroySemaphore(context.device, surfaceContext.imageAvailable, VKALLOC);
-    vkDestroySemaphore(context.device, surfaceContext.renderingFinished, VKALLOC);
-    vkDestroySurfaceKHR(context.instance, surfaceContext.surface, VKALLOC);
+    for (VulkanAttachment& image : surfaceContext.swapImages) {
+        vkDestroyImageView(context.device, image.view, VKALLOC);
+        image.view = VK_NULL_HANDLE;
+        if (!surfaceContext.swapchain) {
+            vmaDestroyImage(context.allocator, image.image, image.memory);
+        }
+    }
+    if (surfaceContext.swapchain) {
+        vkDestroySwapchainKHR(context.device, surfaceContext.swapchain, VKALLOC);
+        vkDestroySurfaceKHR(context.instance, surfaceContext.surface, VKALLOC);
+    }
     vkDestroyImageView(context.device, surfaceContext.depth.view, VKALLOC);
-    vkDestroyImage(context.device, surfaceContext.depth.image, VKALLOC);
-    vkFreeMemory(context.device, surfaceContext.depth.memory, VKALLOC);
+    vmaDestroyImage(context.allocator, surfaceContext.depth.image, surfaceContext.depth.memory);
     if (context.currentSurface == &surfaceContext) {
         context.currentSurface = nullptr;
     }
@@ -496,6 +610,27 @@ uint32_t selectMemoryType(VulkanContext& context, uint32_t flags, VkFlags reqs)
     return (uint32_t) ~0ul;
 }
 
+// Creates a device-local image and binds it to memory sub-allocated by VMA. Attachments get their
+// own VkDeviceMemory since they are large, long-lived and some GPUs handle them better that way;
+// VMA also takes care of dedicating the allocations that the driver asks for, as well as any that
+// are too large to share a block. Transient attachments prefer lazily allocated memory, which tiled
+// GPUs only commit if the attachment has to be spilled out of tile memory.
+VkResult createImage(VulkanContext& context, VkImageCreateInfo const& imageInfo, VkImage* image,
+        VmaAllocation* memory) {
+    const VkImageUsageFlags attachmentUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    VmaAllocationCreateInfo allocInfo {
+        .usage = VMA_MEMORY_USAGE_GPU_ONLY
+    };
+    if (imageInfo.usage & attachmentUsage) {
+        allocInfo.flags |= VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+    }
+    if (imageInfo.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) {
+        allocInfo.preferredFlags |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+    }
+    return vmaCreateImage(context.allocator, &imageInfo, &allocInfo, image, memory, nullptr);
+}
+
 VkFormat getVkFormat(ElementType type, bool normalized) {
     using ElementType = ElementType;
     if (normalized) {
@@ -655,11 +790,16 @@ uint32_t computeSize(TextureFormat format, uint32_t w, uint32_t h, uint32_t d) {
 
 SwapContext& getSwapContext(VulkanContext& context) {
     VulkanSurfaceContext& surface = *context.currentSurface;
-    return surface.swapContexts[surface.currentSwapIndex];
+    return surface.swapContexts[surface.currentFrameIndex];
+}
+
+VulkanAttachment& getSwapChainImage(VulkanContext& context) {
+    VulkanSurfaceContext& surface = *context.currentSurface;
+    return surface.swapImages[surface.currentSwapIndex];
 }
 
 bool hasPendingWork(VulkanContext& context) {
-    if (context.pendingWork.size() > 0) {
+    if (context.pendingWork.size() > 0 || context.uploadCmdbuffer || !context.transfers.empty()) {
         return true;
     }
     if (context.currentSurface) {
@@ -709,28 +849,37 @@ void waitForIdle(VulkanContext& context) {
         return;
     }
 
-    // If there's no surface, then there's no command buffer.
+    // Uploads may have been recorded outside of a frame, so submit them on their own, along with
+    // the acquisition of all the transfers in flight.
+    acquireTransfers(context, context.transferSerial);
+    flushUploadCommandBuffer(context);
+
+    // If there's no surface, then there's no command buffer. Only the frame being recorded, if
+    // any, can still use the objects awaiting disposal.
+    const uint64_t completedSerial = context.cmdbuffer ? context.submittedSerial : UINT64_MAX;
     if (!context.currentSurface) {
+        performDisposals(context, completedSerial);
         return;
     }
 
     // First, wait for submitted command buffer(s) to finish.
-    VkFence fences[2];
+    VkFence fences[VULKAN_FRAMES_IN_FLIGHT];
     uint32_t nfences = 0;
     auto& surfaceContext = *context.currentSurface;
     for (auto& swapContext : surfaceContext.swapContexts) {
-        assert(nfences < 2);
         if (swapContext.submitted && swapContext.fence) {
             fences[nfences++] = swapContext.fence;
             swapContext.submitted = false;
         }
     }
     if (nfences > 0) {
-        vkWaitForFences(context.device, nfences, fences, VK_FALSE, ~0ull);
+        vkWaitForFences(context.device, nfences, fences, VK_TRUE, ~0ull);
     }
+    context.completedSerial = context.submittedSerial;
 
     // If we don't have any pending work, we're done.
     if (!hasPendingWork(context)) {
+        performDisposals(context, completedSerial);
         return;
     }
 
@@ -780,22 +929,37 @@ void waitForIdle(VulkanContext& context) {
     }
     vkFreeCommandBuffers(context.device, context.commandPool, 1, &cmdbuffer);
     vkDestroyFence(context.device, fence, VKALLOC);
+
+    // The pending work may have used the objects awaiting disposal.
+    performDisposals(context, completedSerial);
 }
 
 void acquireCommandBuffer(VulkanContext& context) {
-    // Ask Vulkan for the next image in the swap chain and update the currentSwapIndex.
+    // Move on to the next frame in flight, and ensure that its previous submission has finished.
+    // This is the only place where the CPU waits for the GPU in steady state, once it is
+    // VULKAN_FRAMES_IN_FLIGHT frames ahead.
     VulkanSurfaceContext& surface = *context.currentSurface;
-    VkResult result = vkAcquireNextImageKHR(context.device, surface.swapchain,
-            UINT64_MAX, surface.imageAvailable, VK_NULL_HANDLE, &surface.currentSwapIndex);
-    ASSERT_POSTCONDITION(result != VK_ERROR_OUT_OF_DATE_KHR,
-            "Stale / resized swap chain not yet supported.");
-    ASSERT_POSTCONDITION(result == VK_SUBOPTIMAL_KHR || result == VK_SUCCESS,
-            "vkAcquireNextImageKHR error.");
+    surface.currentFrameIndex = (surface.currentFrameIndex + 1) % VULKAN_FRAMES_IN_FLIGHT;
     SwapContext& swap = getSwapContext(context);
-
-    // Ensure that the previous submission of this command buffer has finished.
-    result = vkWaitForFences(context.device, 1, &swap.fence, VK_FALSE, UINT64_MAX);
+    VkResult result = vkWaitForFences(context.device, 1, &swap.fence, VK_FALSE, UINT64_MAX);
     ASSERT_POSTCONDITION(result == VK_SUCCESS, "vkWaitForFences error.");
+    if (swap.submitted) {
+        context.completedSerial = std::max(context.completedSerial, swap.serial);
+    }
+
+    // Ask Vulkan for the next image in the swap chain and update the currentSwapIndex. The images
+    // of a headless surface are simply used in turn.
+    if (!surface.swapchain) {
+        surface.currentSwapIndex = (surface.currentSwapIndex + 1) %
+                uint32_t(surface.swapImages.size());
+    } else {
+        result = vkAcquireNextImageKHR(context.device, surface.swapchain,
+                UINT64_MAX, swap.imageAvailable, VK_NULL_HANDLE, &surface.currentSwapIndex);
+        ASSERT_POSTCONDITION(result != VK_ERROR_OUT_OF_DATE_KHR,
+                "Stale / resized swap chain not yet supported.");
+        ASSERT_POSTCONDITION(result == VK_SUBOPTIMAL_KHR || result == VK_SUCCESS,
+                "vkAcquireNextImageKHR error.");
+    }
 
     // Restart the command buffer.
     result = vkResetFences(context.device, 1, &swap.fence);
@@ -819,29 +983,50 @@ void releaseCommandBuffer(VulkanContext& context) {
     ASSERT_POSTCONDITION(result == VK_SUCCESS, "vkEndCommandBuffer error.");
     context.cmdbuffer = nullptr;
 
-    // Submit the command buffer.
+    // Submit the uploads of the frame as a first batch, which doesn't need to wait for the swap
+    // chain image, followed by the command buffer. A single fence covers both batches, so the
+    // work waiting for the uploads is deferred until this swap context is used again.
     VkPipelineStageFlags waitDestStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    VulkanSurfaceContext& surfaceContext = *context.currentSurface;
     SwapContext& swapContext = getSwapContext(context);
-    VkSubmitInfo submitInfo {
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .waitSemaphoreCount = 1u,
-        .pWaitSemaphores = &surfaceContext.imageAvailable,
-        .pWaitDstStageMask = &waitDestStageMask,
-        .commandBufferCount = 1,
-        .pCommandBuffers = &swapContext.cmdbuffer,
-        .signalSemaphoreCount = 1u,
-        .pSignalSemaphores = &surfaceContext.renderingFinished,
+    const bool headless = !context.currentSurface->swapchain;
+    VkCommandBuffer uploadCmdbuffer = endUploadCommandBuffer(context, swapContext.pendingWork);
+    std::vector<VkSemaphore> uploadWaitSemaphores;
+    uploadWaitSemaphores.swap(context.uploadWaitSemaphores);
+    std::vector<VkPipelineStageFlags> uploadWaitStages(uploadWaitSemaphores.size(),
+            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    VkSubmitInfo submitInfo[2] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .waitSemaphoreCount = (uint32_t) uploadWaitSemaphores.size(),
+            .pWaitSemaphores = uploadWaitSemaphores.data(),
+            .pWaitDstStageMask = uploadWaitStages.data(),
+            .commandBufferCount = 1,
+            .pCommandBuffers = &uploadCmdbuffer,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .waitSemaphoreCount = headless ? 0u : 1u,
+            .pWaitSemaphores = &swapContext.imageAvailable,
+            .pWaitDstStageMask = &waitDestStageMask,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &swapContext.cmdbuffer,
+            .signalSemaphoreCount = headless ? 0u : 1u,
+            .pSignalSemaphores = &swapContext.renderingFinished,
+        }
     };
-    result = vkQueueSubmit(context.graphicsQueue, 1, &submitInfo, swapContext.fence);
+    result = uploadCmdbuffer ?
+            vkQueueSubmit(context.graphicsQueue, 2, submitInfo, swapContext.fence) :
+            vkQueueSubmit(context.graphicsQueue, 1, submitInfo + 1, swapContext.fence);
     ASSERT_POSTCONDITION(result == VK_SUCCESS, "vkQueueSubmit error.");
+    swapContext.serial = ++context.submittedSerial;
     swapContext.submitted = true;
 }
 
 void performPendingWork(VulkanContext& context, SwapContext& swapContext, VkCommandBuffer cmdbuf) {
-    // First, execute pending tasks that are specific to this swap context. Copy the tasks into a
-    // local queue first, which allows newly added tasks to be deferred until the next frame.
-    decltype(swapContext.pendingWork) tasks;
+    // First, execute pending tasks that are specific to this swap context. Move the tasks into
+    // another queue first, which allows newly added tasks to be deferred until the next frame.
+    // The queues trade their storage, so that they don't allocate once they've grown.
+    VulkanTaskQueue& tasks = context.executingWork;
     tasks.swap(swapContext.pendingWork);
     for (auto& callback : tasks) {
         callback(cmdbuf);
@@ -853,13 +1038,37 @@ void performPendingWork(VulkanContext& context, SwapContext& swapContext, VkComm
     for (auto& callback : tasks) {
         callback(cmdbuf);
     }
+    tasks.clear();
+}
+
+// Defers 'task' until the GPU is done with the commands recorded so far. The next frame to be
+// submitted contains the current commands and the pending uploads, and completes after all the
+// previous frames. This lets objects be destroyed without waiting for the GPU to be idle.
+void deferDisposal(VulkanContext& context, VulkanTask task) {
+    context.disposals.push_back({ context.submittedSerial + 1, std::move(task) });
+}
+
+// Performs the disposals of the frames up to 'serial', which must have completed.
+void performDisposals(VulkanContext& context, uint64_t serial) {
+    auto& disposals = context.disposals;
+    auto last = disposals.begin();
+    while (last != disposals.end() && last->serial <= serial) {
+        ++last;
+    }
+    // A task may defer more work, so move the ready ones out of the queue first.
+    std::vector<VulkanDisposal> tasks(std::make_move_iterator(disposals.begin()),
+            std::make_move_iterator(last));
+    disposals.erase(disposals.begin(), last);
+    for (auto& disposal : tasks) {
+        disposal.task(VK_NULL_HANDLE);
+    }
 }
 
 // Flushes the command buffer and waits for it to finish executing. Useful for diagnosing
 // sychronization issues.
 void flushCommandBuffer(VulkanContext& context) {
-    VulkanSurfaceContext& surface = *context.currentSurface;
-    const SwapContext& sc = surface.swapContexts[surface.currentSwapIndex];
+    const SwapContext& sc = getSwapContext(context);
+    flushUploadCommandBuffer(context);
 
     // Submit the command buffer.
     VkResult error = vkEndCommandBuffer(context.cmdbuffer);
@@ -889,6 +1098,171 @@ void flushCommandBuffer(VulkanContext& context) {
     ASSERT_POSTCONDITION(!error, "vkBeginCommandBuffer error.");
 }
 
+// Returns the command buffer shared by all the buffer uploads until the next submit, beginning it
+// if needed. This batches the uploads of a frame into a single submit and a single fence.
+VkCommandBuffer acquireUploadCommandBuffer(VulkanContext& context) {
+    if (!context.uploadCmdbuffer) {
+        VkCommandBufferAllocateInfo allocateInfo {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = context.commandPool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1
+        };
+        VkCommandBufferBeginInfo beginInfo {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        };
+        VkResult error = vkAllocateCommandBuffers(context.device, &allocateInfo,
+                &context.uploadCmdbuffer);
+        ASSERT_POSTCONDITION(!error, "vkAllocateCommandBuffers error.");
+        error = vkBeginCommandBuffer(context.uploadCmdbuffer, &beginInfo);
+        ASSERT_POSTCONDITION(!error, "vkBeginCommandBuffer error.");
+    }
+    return context.uploadCmdbuffer;
+}
+
+// Finalizes the upload command buffer and returns it, or VK_NULL_HANDLE if nothing was uploaded.
+// The caller must submit it and perform 'completionWork' once it has finished executing, which
+// reclaims the staging areas and frees the command buffer.
+VkCommandBuffer endUploadCommandBuffer(VulkanContext& context, VulkanTaskQueue& completionWork) {
+    VkCommandBuffer cmdbuffer = context.uploadCmdbuffer;
+    if (!cmdbuffer) {
+        return VK_NULL_HANDLE;
+    }
+    context.uploadCmdbuffer = VK_NULL_HANDLE;
+
+    // Ensure that the copies finish before the next draw calls. A single global barrier covers
+    // all the buffers, and the commands of the following batches.
+    VkMemoryBarrier barrier {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+                VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
+    };
+    vkCmdPipelineBarrier(cmdbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    VkResult error = vkEndCommandBuffer(cmdbuffer);
+    ASSERT_POSTCONDITION(!error, "vkEndCommandBuffer error.");
+
+    for (auto& task : context.uploadWork) {
+        completionWork.emplace_back(std::move(task));
+    }
+    context.uploadWork.clear();
+    // the captures fit in the storage of the std::function, this doesn't allocate
+    completionWork.emplace_back([&context, cmdbuffer] (VkCommandBuffer) {
+        vkFreeCommandBuffers(context.device, context.commandPool, 1, &cmdbuffer);
+    });
+    return cmdbuffer;
+}
+
+// Submits the pending uploads on their own and waits for them, for when there's no frame to
+// submit them with.
+void flushUploadCommandBuffer(VulkanContext& context) {
+    VulkanTaskQueue completionWork;
+    VkCommandBuffer cmdbuffer = endUploadCommandBuffer(context, completionWork);
+    if (!cmdbuffer) {
+        return;
+    }
+    std::vector<VkSemaphore> waitSemaphores;
+    waitSemaphores.swap(context.uploadWaitSemaphores);
+    std::vector<VkPipelineStageFlags> waitStages(waitSemaphores.size(),
+            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+    VkFence fence;
+    VkFenceCreateInfo fenceCreateInfo { .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+    vkCreateFence(context.device, &fenceCreateInfo, VKALLOC, &fence);
+    VkSubmitInfo submitInfo {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .waitSemaphoreCount = (uint32_t) waitSemaphores.size(),
+        .pWaitSemaphores = waitSemaphores.data(),
+        .pWaitDstStageMask = waitStages.data(),
+        .commandBufferCount = 1,
+        .pCommandBuffers = &cmdbuffer,
+    };
+    VkResult error = vkQueueSubmit(context.graphicsQueue, 1, &submitInfo, fence);
+    ASSERT_POSTCONDITION(!error, "vkQueueSubmit error.");
+    vkWaitForFences(context.device, 1, &fence, VK_FALSE, UINT64_MAX);
+    vkDestroyFence(context.device, fence, VKALLOC);
+    for (auto& task : completionWork) {
+        task(cmdbuffer);
+    }
+}
+
+// Records an upload into its own command buffer and submits it to the dedicated transfer queue,
+// where it runs concurrently with the frames. Returns the serial of the transfer. The graphics queue
+// must acquire the transfer before using its results, by recording 'acquire' after waiting on the
+// transfer's semaphore, see acquireTransfers(). Vulkan 1.0 has no timeline semaphores, so the
+// timeline of completed uploads is made of serials and fences.
+uint64_t submitTransfer(VulkanContext& context, VulkanTask record, VulkanTask acquire,
+        VulkanTask completionWork) {
+    assert(context.transferQueue);
+    VulkanTransfer transfer {
+        .serial = ++context.transferSerial,
+        .acquire = std::move(acquire),
+        .completionWork = std::move(completionWork)
+    };
+    VkCommandBufferAllocateInfo allocateInfo {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = context.transferCommandPool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1
+    };
+    VkCommandBufferBeginInfo beginInfo {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    VkResult error = vkAllocateCommandBuffers(context.device, &allocateInfo, &transfer.cmdbuffer);
+    ASSERT_POSTCONDITION(!error, "vkAllocateCommandBuffers error.");
+    error = vkBeginCommandBuffer(transfer.cmdbuffer, &beginInfo);
+    ASSERT_POSTCONDITION(!error, "vkBeginCommandBuffer error.");
+    record(transfer.cmdbuffer);
+    error = vkEndCommandBuffer(transfer.cmdbuffer);
+    ASSERT_POSTCONDITION(!error, "vkEndCommandBuffer error.");
+
+    VkFenceCreateInfo fenceCreateInfo { .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+    vkCreateFence(context.device, &fenceCreateInfo, VKALLOC, &transfer.fence);
+    createSemaphore(context.device, &transfer.semaphore);
+    VkSubmitInfo submitInfo {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &transfer.cmdbuffer,
+        .signalSemaphoreCount = 1u,
+        .pSignalSemaphores = &transfer.semaphore,
+    };
+    error = vkQueueSubmit(context.transferQueue, 1, &submitInfo, transfer.fence);
+    ASSERT_POSTCONDITION(!error, "vkQueueSubmit error.");
+    context.transfers.push_back(std::move(transfer));
+    return context.transferSerial;
+}
+
+// Acquires the transfers up to the given serial, along with the following ones that have already
+// completed. Their acquire barriers are recorded into the upload command buffer, which waits on
+// their semaphores, so this never blocks the CPU. The transfer objects are destroyed once the
+// uploads have executed.
+void acquireTransfers(VulkanContext& context, uint64_t serial) {
+    auto& transfers = context.transfers;
+    auto first = transfers.begin();
+    auto last = first;
+    for (; last != transfers.end(); ++last) {
+        if (last->serial > serial && vkGetFenceStatus(context.device, last->fence) != VK_SUCCESS) {
+            break;
+        }
+        last->acquire(acquireUploadCommandBuffer(context));
+        context.uploadWaitSemaphores.push_back(last->semaphore);
+        context.acquiredTransferSerial = last->serial;
+        VkDevice device = context.device;
+        VkCommandPool commandPool = context.transferCommandPool;
+        context.uploadWork.emplace_back([device, commandPool, transfer = std::move(*last)]
+                (VkCommandBuffer cmdbuffer) {
+            vkFreeCommandBuffers(device, commandPool, 1, &transfer.cmdbuffer);
+            vkDestroyFence(device, transfer.fence, VKALLOC);
+            vkDestroySemaphore(device, transfer.semaphore, VKALLOC);
+            transfer.completionWork(cmdbuffer);
+        });
+    }
+    transfers.erase(first, last);
+}
+
 VkFormat findSupportedFormat(VulkanContext& context, const std::vector<VkFormat>& candidates,
         VkImageTiling tiling, VkFormatFeatureFlags features) {
     for (VkFormat format : candidates) {
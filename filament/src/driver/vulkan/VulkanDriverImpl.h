@@ -37,11 +37,40 @@ namespace driver {
 // passing in a null pointer, and we highlight the argument by using the VKALLOC constant.
 static constexpr VkAllocationCallbacks* VKALLOC = nullptr;
 
+// The number of frames that the CPU can record while the GPU is still executing previous ones. It
+// can be set at build time, 2 trades a frame of latency for CPU / GPU overlap, 3 absorbs more
+// variance in the frame times.
+#ifndef FILAMENT_VULKAN_FRAMES_IN_FLIGHT
+#define FILAMENT_VULKAN_FRAMES_IN_FLIGHT 2
+#endif
+static constexpr uint32_t VULKAN_FRAMES_IN_FLIGHT = FILAMENT_VULKAN_FRAMES_IN_FLIGHT;
+static_assert(VULKAN_FRAMES_IN_FLIGHT >= 1 &&
+        VULKAN_FRAMES_IN_FLIGHT <= VulkanBinder::TIME_BEFORE_EVICTION,
+        "The binder could evict objects still used by a frame in flight.");
+
 using VulkanTask = std::function<void(VkCommandBuffer)>;
 using VulkanTaskQueue = std::vector<VulkanTask>;
 
 struct VulkanSurfaceContext;
 
+// An upload in flight on the dedicated transfer queue. Serials increase with each submission, and
+// the graphics queue acquires the transfers in that order, see acquireTransfers().
+struct VulkanTransfer {
+    uint64_t serial;
+    VkCommandBuffer cmdbuffer;
+    VkFence fence;              // polled to learn that the transfer has completed
+    VkSemaphore semaphore;      // waited on by the graphics queue before it acquires the transfer
+    VulkanTask acquire;         // records the ownership acquire barriers on the graphics queue
+    VulkanTask completionWork;  // performed once the graphics queue has acquired the transfer
+};
+
+// Work deferred until the GPU has executed the frame with the given serial, such as the destruction
+// of objects that the frames in flight may still use. See deferDisposal().
+struct VulkanDisposal {
+    uint64_t serial;
+    VulkanTask task;
+};
+
 // For now we only support a single-device, single-instance scenario. Our concept of "context" is a
 // bundle of state containing the Device, the Instance, and various globally-useful Vulkan objects.
 struct VulkanContext {
@@ -54,8 +83,24 @@ struct VulkanContext {
     VkCommandPool commandPool;
     uint32_t graphicsQueueFamilyIndex;
     VkQueue graphicsQueue;
+    uint32_t transferQueueFamilyIndex;  // 0xffff if there is no dedicated transfer queue
+    VkQueue transferQueue;
+    VkCommandPool transferCommandPool;
+    std::vector<VulkanTransfer> transfers;      // in flight on the transfer queue, oldest first
+    uint64_t transferSerial;                    // serial of the last submitted transfer
+    uint64_t acquiredTransferSerial;            // serial of the last transfer acquired
     bool debugMarkersSupported;
+    bool dedicatedAllocationSupported;
+    bool displayTimingSupported;
+    bool incrementalPresentSupported;
     VulkanTaskQueue pendingWork;
+    VulkanTaskQueue executingWork;      // see performPendingWork(), keeps its storage
+    std::vector<VulkanDisposal> disposals;      // oldest first
+    uint64_t submittedSerial;                   // serial of the last submitted frame
+    uint64_t completedSerial;                   // serial of the last frame known to be complete
+    VkCommandBuffer uploadCmdbuffer;    // buffer uploads, see acquireUploadCommandBuffer()
+    VulkanTaskQueue uploadWork;         // work to perform once the uploads have completed
+    std::vector<VkSemaphore> uploadWaitSemaphores;  // transfers the uploads must wait for
     VulkanBinder::RasterState rasterState;
     VkCommandBuffer cmdbuffer;
     VulkanSurfaceContext* currentSurface;
@@ -69,21 +114,24 @@ struct VulkanAttachment {
     VkFormat format;
     VkImage image;
     VkImageView view;
-    VkDeviceMemory memory;
+    VmaAllocation memory;
 };
 
-// The SwapContext is the set of objects that gets "swapped" at each beginFrame().
-// Typically there are only 2 or 3 instances of the SwapContext per SwapChain.
+// The SwapContext is the set of objects that gets "swapped" at each beginFrame(). There is one per
+// frame in flight, independently of the number of images in the swap chain.
 struct SwapContext {
-    VulkanAttachment attachment;
     VkCommandBuffer cmdbuffer;
     VkFence fence;
+    VkSemaphore imageAvailable;     // signaled once the swap chain image can be rendered into
+    VkSemaphore renderingFinished;  // signaled once the frame can be presented
     VulkanTaskQueue pendingWork;
+    uint64_t serial;                // of the last submission
     bool submitted;
 };
 
 // The SurfaceContext stores various state (including the swap chain) that we tightly associate
-// with VkSurfaceKHR, which is basically one-to-one with a platform-specific window.
+// with VkSurfaceKHR, which is basically one-to-one with a platform-specific window. A headless
+// SurfaceContext has neither surface nor swap chain, its images are ours and never presented.
 struct VulkanSurfaceContext {
     VkSurfaceKHR surface;
     VkSwapchainKHR swapchain;
@@ -92,11 +140,12 @@ struct VulkanSurfaceContext {
     VkExtent2D clientSize;
     std::vector<VkSurfaceFormatKHR> surfaceFormats;
     VkQueue presentQueue;
-    std::vector<SwapContext> swapContexts;
+    VkPresentModeKHR presentMode;   // requested, FIFO is used if the surface doesn't support it
+    std::vector<VulkanAttachment> swapImages;
     uint32_t currentSwapIndex;
+    SwapContext swapContexts[VULKAN_FRAMES_IN_FLIGHT];
+    uint32_t currentFrameIndex;
     VulkanAttachment depth;
-    VkSemaphore imageAvailable;
-    VkSemaphore renderingFinished;
 };
 
 void selectPhysicalDevice(VulkanContext& context);
@@ -105,16 +154,21 @@ void createSemaphore(VkDevice device, VkSemaphore* semaphore);
 void getPresentationQueue(VulkanContext& context, VulkanSurfaceContext& sc);
 void getSurfaceCaps(VulkanContext& context, VulkanSurfaceContext& sc);
 void createSwapChainAndImages(VulkanContext& context, VulkanSurfaceContext& sc);
+void createHeadlessImages(VulkanContext& context, VulkanSurfaceContext& sc,
+        uint32_t width, uint32_t height);
 void createDepthBuffer(VulkanContext& context, VulkanSurfaceContext& sc, VkFormat depthFormat);
 void transitionDepthBuffer(VulkanContext& context, VulkanSurfaceContext& sc, VkFormat depthFormat);
 void createCommandBuffersAndFences(VulkanContext& context, VulkanSurfaceContext& sc);
 void destroySurfaceContext(VulkanContext& context, VulkanSurfaceContext& sc);
 uint32_t selectMemoryType(VulkanContext& context, uint32_t flags, VkFlags reqs);
+VkResult createImage(VulkanContext& context, VkImageCreateInfo const& imageInfo, VkImage* image,
+        VmaAllocation* memory);
 VkFormat getVkFormat(ElementType type, bool normalized);
 VkFormat getVkFormat(TextureFormat format);
 uint32_t getBytesPerPixel(TextureFormat format);
 uint32_t computeSize(TextureFormat format, uint32_t w, uint32_t h, uint32_t d);
 SwapContext& getSwapContext(VulkanContext& context);
+VulkanAttachment& getSwapChainImage(VulkanContext& context);
 bool hasPendingWork(VulkanContext& context);
 VkCompareOp getCompareOp(SamplerCompareFunc func);
 VkBlendFactor getBlendFactor(BlendFunction mode);
@@ -122,7 +176,15 @@ void waitForIdle(VulkanContext& context);
 void acquireCommandBuffer(VulkanContext& context);
 void releaseCommandBuffer(VulkanContext& context);
 void performPendingWork(VulkanContext& context, SwapContext& swapContext, VkCommandBuffer cmdbuf);
+void deferDisposal(VulkanContext& context, VulkanTask task);
+void performDisposals(VulkanContext& context, uint64_t serial);
 void flushCommandBuffer(VulkanContext& context);
+VkCommandBuffer acquireUploadCommandBuffer(VulkanContext& context);
+VkCommandBuffer endUploadCommandBuffer(VulkanContext& context, VulkanTaskQueue& completionWork);
+void flushUploadCommandBuffer(VulkanContext& context);
+uint64_t submitTransfer(VulkanContext& context, VulkanTask record, VulkanTask acquire,
+        VulkanTask completionWork);
+void acquireTransfers(VulkanContext& context, uint64_t serial);
 VkFormat findSupportedFormat(VulkanContext& context, const std::vector<VkFormat>& candidates,
         VkImageTiling tiling, VkFormatFeatureFlags features);
 
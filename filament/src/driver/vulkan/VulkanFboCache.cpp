@@ -27,7 +27,8 @@ bool VulkanFboCache::RenderPassEq::operator()(const RenderPassKey& k1,
             k1.finalLayout == k2.finalLayout &&
             k1.colorFormat == k2.colorFormat &&
             k1.depthFormat == k2.depthFormat &&
-            k1.flags.value == k2.flags.value;
+            k1.flags.value == k2.flags.value &&
+            k1.subpassFormat == k2.subpassFormat;
 }
 
 bool VulkanFboCache::FboKeyEqualFn::operator()(const FboKey& k1, const FboKey& k2) const {
@@ -81,6 +82,11 @@ VkRenderPass VulkanFboCache::getRenderPass(RenderPassKey config) noexcept {
         iter.value().timestamp = mCurrentTime;
         return iter->second.handle;
     }
+    if (config.flags.dependencies & RenderPassParams::DEPENDENCY_SUBPASS_INPUT) {
+        VkRenderPass renderPass = createSubpassRenderPass(config);
+        mRenderPassCache[config] = {renderPass, mCurrentTime};
+        return renderPass;
+    }
     const bool hasColor = config.colorFormat != VK_FORMAT_UNDEFINED;
     const bool hasDepth = config.depthFormat != VK_FORMAT_UNDEFINED;
     const bool depthOnly = hasDepth && !hasColor;
@@ -110,7 +116,8 @@ VkRenderPass VulkanFboCache::getRenderPass(RenderPassKey config) noexcept {
         .samples = VK_SAMPLE_COUNT_1_BIT,
         .loadOp = (config.flags.clear & TargetBufferFlags::COLOR) ?
                 VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .storeOp = (config.flags.discardEnd & TargetBufferFlags::COLOR) ?
+                VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE,
         .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
         .finalLayout = config.finalLayout
@@ -120,7 +127,9 @@ VkRenderPass VulkanFboCache::getRenderPass(RenderPassKey config) noexcept {
         .samples = VK_SAMPLE_COUNT_1_BIT,
         .loadOp = (config.flags.clear & TargetBufferFlags::DEPTH) ?
                 VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        // Discarded depth never has to leave tile memory.
+        .storeOp = (config.flags.discardEnd & TargetBufferFlags::DEPTH) ?
+                VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE,
         .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
         .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
         .finalLayout = depthOnly ? config.finalLayout :
@@ -173,6 +182,84 @@ VkRenderPass VulkanFboCache::getRenderPass(RenderPassKey config) noexcept {
     return renderPass;
 }
 
+// The first subpass draws into a transient attachment, which the second subpass reads as an input
+// attachment while drawing into the color attachment. The color of the first subpass is read at
+// the same pixel, so it never has to leave tile memory.
+VkRenderPass VulkanFboCache::createSubpassRenderPass(RenderPassKey const& config) noexcept {
+    assert(config.colorFormat != VK_FORMAT_UNDEFINED);
+    const bool hasDepth = config.depthFormat != VK_FORMAT_UNDEFINED;
+
+    VkAttachmentDescription attachments[3] = {{
+        .format = config.subpassFormat,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .loadOp = (config.flags.clear & TargetBufferFlags::COLOR) ?
+                VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    }, {
+        .format = config.colorFormat,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .finalLayout = config.finalLayout
+    }, {
+        .format = config.depthFormat,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .loadOp = (config.flags.clear & TargetBufferFlags::DEPTH) ?
+                VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .storeOp = (config.flags.discardEnd & TargetBufferFlags::DEPTH) ?
+                VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE,
+        .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+        .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL
+    }};
+
+    const VkAttachmentReference transientRef = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    const VkAttachmentReference inputRef = {0, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    const VkAttachmentReference colorRef = {1, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+    const VkAttachmentReference depthRef = {2, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+    VkSubpassDescription subpasses[2] = {{
+        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .colorAttachmentCount = 1u,
+        .pColorAttachments = &transientRef,
+        .pDepthStencilAttachment = hasDepth ? &depthRef : nullptr
+    }, {
+        .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+        .inputAttachmentCount = 1u,
+        .pInputAttachments = &inputRef,
+        .colorAttachmentCount = 1u,
+        .pColorAttachments = &colorRef
+    }};
+
+    VkSubpassDependency dependency {
+        .srcSubpass = 0,
+        .dstSubpass = 1,
+        .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT,
+        .dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT
+    };
+
+    VkRenderPassCreateInfo renderPassInfo {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .attachmentCount = hasDepth ? 3u : 2u,
+        .pAttachments = attachments,
+        .dependencyCount = 1u,
+        .pDependencies = &dependency,
+        .subpassCount = 2u,
+        .pSubpasses = subpasses
+    };
+    VkRenderPass renderPass;
+    VkResult error = vkCreateRenderPass(mContext.device, &renderPassInfo, VKALLOC, &renderPass);
+    ASSERT_POSTCONDITION(!error, "Unable to create render pass.");
+    return renderPass;
+}
+
 void VulkanFboCache::reset() noexcept {
     for (auto pair : mFramebufferCache) {
         mRenderPassRefCount[pair.first.renderPass]--;
@@ -50,13 +50,15 @@ public:
             };
             uint32_t value; // 4 bytes
         } flags;
+        VkFormat subpassFormat; // 4 bytes, with DEPENDENCY_SUBPASS_INPUT only
+        uint32_t padding; // 4 bytes
     };
     struct RenderPassVal {
         VkRenderPass handle;
         uint32_t timestamp;
     };
     static_assert(sizeof(VkFormat) == 4, "VkFormat has unexpected size.");
-    static_assert(sizeof(RenderPassKey) == 16, "RenderPassKey has unexpected size.");
+    static_assert(sizeof(RenderPassKey) == 24, "RenderPassKey has unexpected size.");
     using RenderPassHash = utils::hash::MurmurHashFn<RenderPassKey>;
     struct RenderPassEq {
         bool operator()(const RenderPassKey& k1, const RenderPassKey& k2) const;
@@ -64,7 +66,8 @@ public:
 
     // FboKey is a small POD representing the immutable state that we wish to configure
     // in VkFramebuffer. It is hashed and used as a lookup key. There are 1-3 attachments, but
-    // rather than storing a count, we simply zero out the unused slots. We do not bother storing
+    // rather than storing a count, we simply zero out the unused slots. With two subpasses, the
+    // attachments are the transient color of the first subpass, the color and the depth. We do not bother storing
     // width and height in the key since they are immutable aspects of the image views.
     struct alignas(8) FboKey {
         VkRenderPass renderPass; // 8 bytes
@@ -99,12 +102,15 @@ public:
     void reset() noexcept;
 
 private:
+    VkRenderPass createSubpassRenderPass(RenderPassKey const& config) noexcept;
+
     VulkanContext& mContext;
     tsl::robin_map<FboKey, FboVal, FboKeyHashFn, FboKeyEqualFn> mFramebufferCache;
     tsl::robin_map<RenderPassKey, RenderPassVal, RenderPassHash, RenderPassEq> mRenderPassCache;
     tsl::robin_map<VkRenderPass, uint32_t> mRenderPassRefCount;
     uint32_t mCurrentTime = 0;
-    static constexpr uint32_t TIME_BEFORE_EVICTION = 2;
+    // a framebuffer can be destroyed once the frames in flight no longer use it
+    static constexpr uint32_t TIME_BEFORE_EVICTION = VULKAN_FRAMES_IN_FLIGHT;
 };
 
 } // namespace filament
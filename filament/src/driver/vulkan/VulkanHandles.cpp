@@ -20,6 +20,8 @@
 
 #include <utils/Panic.h>
 
+#include <algorithm>
+
 #define FILAMENT_VULKAN_VERBOSE 0
 
 namespace filament {
@@ -47,11 +49,16 @@ static void clampToFramebuffer(VkRect2D* rect, uint32_t fbWidth, uint32_t fbHeig
 VulkanProgram::VulkanProgram(VulkanContext& context, const Program& builder) noexcept :
         HwProgram(builder.getName()), context(context) {
     auto const& blobs = builder.getShadersSource();
-    VkShaderModule* modules[2] = { &bundle.vertex, &bundle.fragment };
+    // compute programs are not supported, see VulkanDriver::isComputeSupported()
+    VkShaderModule* modules[Program::NUM_SHADER_TYPES] = { &bundle.vertex, &bundle.fragment };
+    bundle.specialization = builder.getSpecialization();
     bool missing = false;
     for (size_t i = 0; i < Program::NUM_SHADER_TYPES; i++) {
         const auto& blob = blobs[i];
         VkShaderModule* module = modules[i];
+        if (!module) {
+            continue;
+        }
         if (blob.empty()) {
             missing = true;
             continue;
@@ -96,13 +103,15 @@ VulkanProgram::~VulkanProgram() {
 VulkanRenderTarget::~VulkanRenderTarget() {
     if (!mSharedColorImage) {
         vkDestroyImageView(mContext.device, mColor.view, VKALLOC);
-        vkDestroyImage(mContext.device, mColor.image, VKALLOC);
-        vkFreeMemory(mContext.device, mColor.memory, VKALLOC);
+        vmaDestroyImage(mContext.allocator, mColor.image, mColor.memory);
     }
     if (!mSharedDepthImage) {
         vkDestroyImageView(mContext.device, mDepth.view, VKALLOC);
-        vkDestroyImage(mContext.device, mDepth.image, VKALLOC);
-        vkFreeMemory(mContext.device, mDepth.memory, VKALLOC);
+        vmaDestroyImage(mContext.allocator, mDepth.image, mDepth.memory);
+    }
+    if (mSubpassColor.image) {
+        vkDestroyImageView(mContext.device, mSubpassColor.view, VKALLOC);
+        vmaDestroyImage(mContext.allocator, mSubpassColor.image, mSubpassColor.memory);
     }
 }
 
@@ -160,7 +169,7 @@ VulkanAttachment VulkanRenderTarget::getColor() const {
     if (mOffscreen) {
         return mColor;
     }
-    return getSwapContext(mContext).attachment;
+    return getSwapChainImage(mContext);
 }
 
 VulkanAttachment VulkanRenderTarget::getDepth() const {
@@ -185,23 +194,9 @@ void VulkanRenderTarget::createColorImage(VkFormat format) {
         .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
         .samples = VK_SAMPLE_COUNT_1_BIT,
     };
-    VkResult error = vkCreateImage(mContext.device, &colorImageInfo, VKALLOC, &mColor.image);
+    VkResult error = createImage(mContext, colorImageInfo, &mColor.image, &mColor.memory);
     ASSERT_POSTCONDITION(!error, "Unable to create color attachment.");
 
-    // Allocate memory for the color image and bind it.
-    VkMemoryRequirements memReqs;
-    vkGetImageMemoryRequirements(mContext.device, mColor.image, &memReqs);
-    VkMemoryAllocateInfo allocInfo {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .allocationSize = memReqs.size,
-        .memoryTypeIndex = selectMemoryType(mContext, memReqs.memoryTypeBits,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
-    };
-    error = vkAllocateMemory(mContext.device, &allocInfo, nullptr, &mColor.memory);
-    ASSERT_POSTCONDITION(!error, "Unable to allocate color memory.");
-    error = vkBindImageMemory(mContext.device, mColor.image, mColor.memory, 0);
-    ASSERT_POSTCONDITION(!error, "Unable to bind color memory.");
-
     // Transition the color image into an optimal layout.
     VkImageMemoryBarrier barrier {
         .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
@@ -237,6 +232,8 @@ void VulkanRenderTarget::createDepthImage(VkFormat format) {
     mSharedDepthImage = false;
     // Create an appropriately-sized device-only VkImage for the depth attachment.
     // TODO: for depth, can we re-use the image associated with the swap chain?
+    // This image can't be sampled and the renderer discards it at the end of the pass, so it is
+    // transient: on tiled GPUs it can be backed by lazily allocated memory and stay on chip.
     VkImageCreateInfo depthImageInfo {
         .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
         .imageType = VK_IMAGE_TYPE_2D,
@@ -244,26 +241,13 @@ void VulkanRenderTarget::createDepthImage(VkFormat format) {
         .format = mDepth.format,
         .mipLevels = 1,
         .arrayLayers = 1,
-        .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+        .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+                VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
         .samples = VK_SAMPLE_COUNT_1_BIT,
     };
-    VkResult error = vkCreateImage(mContext.device, &depthImageInfo, VKALLOC, &mDepth.image);
+    VkResult error = createImage(mContext, depthImageInfo, &mDepth.image, &mDepth.memory);
     ASSERT_POSTCONDITION(!error, "Unable to create depth attachment.");
 
-    // Allocate memory for the depth image and bind it.
-    VkMemoryRequirements memReqs;
-    vkGetImageMemoryRequirements(mContext.device, mDepth.image, &memReqs);
-    VkMemoryAllocateInfo depthAllocInfo {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .allocationSize = memReqs.size,
-        .memoryTypeIndex = selectMemoryType(mContext, memReqs.memoryTypeBits,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
-    };
-    error = vkAllocateMemory(mContext.device, &depthAllocInfo, nullptr, &mDepth.memory);
-    ASSERT_POSTCONDITION(!error, "Unable to allocate depth memory.");
-    error = vkBindImageMemory(mContext.device, mDepth.image, mDepth.memory, 0);
-    ASSERT_POSTCONDITION(!error, "Unable to bind depth memory.");
-
     // Transition the depth image into an optimal layout and assume there's no need to read from it.
     VkImageMemoryBarrier depthBarrier {
         .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
@@ -294,6 +278,42 @@ void VulkanRenderTarget::createDepthImage(VkFormat format) {
     ASSERT_POSTCONDITION(!error, "Unable to create depth attachment view.");
 }
 
+// The color of the first subpass is only ever read by the second one, as an input attachment, so
+// it is transient and can live in tile memory only.
+VulkanAttachment VulkanRenderTarget::getSubpassColor() {
+    assert(mOffscreen);
+    assert(mSubpassColor.format != VK_FORMAT_UNDEFINED);
+    if (mSubpassColor.image) {
+        return mSubpassColor;
+    }
+    VkImageCreateInfo imageInfo {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .extent = { width, height, 1 },
+        .format = mSubpassColor.format,
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT |
+                VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+    };
+    VkResult error = createImage(mContext, imageInfo, &mSubpassColor.image, &mSubpassColor.memory);
+    ASSERT_POSTCONDITION(!error, "Unable to create subpass attachment.");
+
+    VkImageViewCreateInfo viewInfo {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = mSubpassColor.image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = mSubpassColor.format,
+        .subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .subresourceRange.levelCount = 1,
+        .subresourceRange.layerCount = 1,
+    };
+    error = vkCreateImageView(mContext.device, &viewInfo, VKALLOC, &mSubpassColor.view);
+    ASSERT_POSTCONDITION(!error, "Unable to create subpass attachment view.");
+    return mSubpassColor;
+}
+
 void VulkanRenderTarget::setColorImage(VulkanAttachment c) {
     assert(mOffscreen);
     mColor = c;
@@ -324,11 +344,12 @@ VulkanVertexBuffer::VulkanVertexBuffer(VulkanContext& context, VulkanStagePool&
 
 VulkanUniformBuffer::VulkanUniformBuffer(VulkanContext& context, VulkanStagePool& stagePool,
         uint32_t numBytes) : HwUniformBuffer(numBytes), mContext(context), mStagePool(stagePool) {
-    // Create the VkBuffer.
+    // Create the VkBuffer, which can also be bound as a storage buffer (see bindStorage).
     VkBufferCreateInfo bufferInfo {
         .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
         .size = numBytes,
-        .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT,
     };
     VmaAllocationCreateInfo allocInfo {
         .usage = VMA_MEMORY_USAGE_GPU_ONLY
@@ -336,65 +357,21 @@ VulkanUniformBuffer::VulkanUniformBuffer(VulkanContext& context, VulkanStagePool
     vmaCreateBuffer(mContext.allocator, &bufferInfo, &allocInfo, &mGpuBuffer, &mGpuMemory, 0);
 }
 
-void VulkanUniformBuffer::loadFromCpu(const void* cpuData, uint32_t numBytes) {
-    VkDevice device = mContext.device;
-    VulkanStage const* stage = mStagePool.acquireStage(numBytes);
-    void* mapped;
-    vmaMapMemory(mContext.allocator, stage->memory, &mapped);
-    memcpy(mapped, cpuData, numBytes);
-    vmaUnmapMemory(mContext.allocator, stage->memory);
-    vmaFlushAllocation(mContext.allocator, stage->memory, 0, numBytes);
-
-    // Create and submit a one-off command buffer to allow uploading outside a frame.
-    VkCommandBuffer cmdbuffer;
-    VkFence fence;
-    VkCommandBufferBeginInfo beginInfo { .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
-    VkCommandBufferAllocateInfo allocateInfo {
-        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-        .commandPool = mContext.commandPool,
-        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-        .commandBufferCount = 1
-    };
-    VkFenceCreateInfo fenceCreateInfo { .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
-    VkBufferCopy region { .size = numBytes };
-    vkAllocateCommandBuffers(device, &allocateInfo, &cmdbuffer);
-    vkCreateFence(device, &fenceCreateInfo, VKALLOC, &fence);
-    vkBeginCommandBuffer(cmdbuffer, &beginInfo);
-    vkCmdCopyBuffer(cmdbuffer, stage->buffer, mGpuBuffer, 1, &region);
-
-    // Ensure that the copy finishes before the next draw call.
-    VkBufferMemoryBarrier barrier {
-        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
-        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-        .dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT,
-        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .buffer = mGpuBuffer,
-        .size = VK_WHOLE_SIZE
-    };
-    vkCmdPipelineBarrier(cmdbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
-            VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
-    vkEndCommandBuffer(cmdbuffer);
-    VkSubmitInfo submitInfo {
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .commandBufferCount = 1,
-        .pCommandBuffers = &cmdbuffer,
-    };
-    vkQueueSubmit(mContext.graphicsQueue, 1, &submitInfo, fence);
-
-    // Enqueue some work to reclaim the staging area and free the command buffer. The pipeline
-    // barrier we already placed is a GPU-to-GPU sync point, but reclaimation of the staging area
-    // needs GPU-CPU synchronization. That's what the fence is for.
-    mContext.pendingWork.emplace_back([this, fence, device, cmdbuffer, stage] (VkCommandBuffer)  {
-        vkWaitForFences(device, 1, &fence, VK_FALSE, UINT64_MAX);
-        vkFreeCommandBuffers(device, mContext.commandPool, 1, &cmdbuffer);
-        vkDestroyFence(device, fence, VKALLOC);
-        mStagePool.releaseStage(stage);
+void VulkanUniformBuffer::loadFromCpu(const void* cpuData, uint32_t numBytes,
+        uint32_t dstOffset) {
+    const VulkanStage stage = mStagePool.acquireStage(numBytes);
+    memcpy(stage.mapped, cpuData, numBytes);
+    mStagePool.flushStage(stage, numBytes);
+
+    // Batch the copy with the other uploads of the frame, see VulkanBuffer::loadFromCpu().
+    VkBufferCopy region { .srcOffset = stage.offset, .dstOffset = dstOffset, .size = numBytes };
+    vkCmdCopyBuffer(acquireUploadCommandBuffer(mContext), stage.buffer, mGpuBuffer, 1, &region);
+    mContext.uploadWork.emplace_back([this, owner = stage.owner] (VkCommandBuffer) {
+        mStagePool.releaseStage(owner);
     });
 }
 
 VulkanUniformBuffer::~VulkanUniformBuffer() {
-    assert(!hasPendingWork(mContext) && "Buffer destroyed while work is pending.");
     vmaDestroyBuffer(mContext.allocator, mGpuBuffer, mGpuMemory);
 }
 
@@ -422,6 +399,11 @@ VulkanTexture::VulkanTexture(VulkanContext& context, SamplerType target, uint8_t
     if (target == SamplerType::SAMPLER_CUBEMAP) {
         imageInfo.arrayLayers = 6;
         imageInfo.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
+    } else if (target == SamplerType::SAMPLER_2D_ARRAY) {
+        imageInfo.arrayLayers = depth;
+        imageInfo.extent.depth = 1;
+    } else if (target == SamplerType::SAMPLER_3D) {
+        imageInfo.imageType = VK_IMAGE_TYPE_3D;
     }
     if (usage == TextureUsage::COLOR_ATTACHMENT) {
         imageInfo.usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
@@ -430,7 +412,11 @@ VulkanTexture::VulkanTexture(VulkanContext& context, SamplerType target, uint8_t
     } else {
         imageInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
     }
-    VkResult error = vkCreateImage(context.device, &imageInfo, VKALLOC, &textureImage);
+    if (levels > 1) {
+        // the levels can be blitted from each other, see generateMipmaps()
+        imageInfo.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    }
+    VkResult error = createImage(context, imageInfo, &textureImage, &textureImageMemory);
     if (error) {
         utils::slog.d << "vkCreateImage: "
             << "result = " << error << ", "
@@ -440,20 +426,6 @@ VulkanTexture::VulkanTexture(VulkanContext& context, SamplerType target, uint8_t
     }
     ASSERT_POSTCONDITION(!error, "Unable to create image.");
 
-    // Allocate memory for the VkImage and bind it.
-    VkMemoryRequirements memReqs = {};
-    vkGetImageMemoryRequirements(context.device, textureImage, &memReqs);
-    VkMemoryAllocateInfo allocInfo = {
-        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
-        .allocationSize = memReqs.size,
-        .memoryTypeIndex = selectMemoryType(context, memReqs.memoryTypeBits,
-                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
-    };
-    error = vkAllocateMemory(context.device, &allocInfo, nullptr, &textureImageMemory);
-    ASSERT_POSTCONDITION(!error, "Unable to allocate image memory.");
-    error = vkBindImageMemory(context.device, textureImage, textureImageMemory, 0);
-    ASSERT_POSTCONDITION(!error, "Unable to bind image.");
-
     // Create a VkImageView so that shaders can sample from the image.
     VkImageViewCreateInfo viewInfo = {};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -467,8 +439,12 @@ VulkanTexture::VulkanTexture(VulkanContext& context, SamplerType target, uint8_t
     viewInfo.subresourceRange.layerCount = 1;
     if (target == SamplerType::SAMPLER_CUBEMAP) {
         viewInfo.viewType = VK_IMAGE_VIEW_TYPE_CUBE;
-        viewInfo.subresourceRange.layerCount = 6;
+    } else if (target == SamplerType::SAMPLER_2D_ARRAY) {
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    } else if (target == SamplerType::SAMPLER_3D) {
+        viewInfo.viewType = VK_IMAGE_VIEW_TYPE_3D;
     }
+    viewInfo.subresourceRange.layerCount = getLayerCount();
     if (usage == TextureUsage::DEPTH_ATTACHMENT) {
         viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
     }
@@ -477,10 +453,8 @@ VulkanTexture::VulkanTexture(VulkanContext& context, SamplerType target, uint8_t
 }
 
 VulkanTexture::~VulkanTexture() {
-    assert(!hasPendingWork(mContext) && "Texture destroyed while work is pending.");
-    vkDestroyImage(mContext.device, textureImage, VKALLOC);
     vkDestroyImageView(mContext.device, imageView, VKALLOC);
-    vkFreeMemory(mContext.device, textureImageMemory, VKALLOC);
+    vmaDestroyImage(mContext.allocator, textureImage, textureImageMemory);
 }
 
 void VulkanTexture::load2DImage(PixelBufferDescriptor&& data, uint32_t width, uint32_t height,
@@ -493,31 +467,11 @@ void VulkanTexture::load2DImage(PixelBufferDescriptor&& data, uint32_t width, ui
     // alpha) if format conversion is required. Currently we are not honoring left / top / stride.
 
     // Create and populate the staging buffer.
-    VulkanStage const* stage = mStagePool.acquireStage(numBytes);
-    void* mapped;
-    vmaMapMemory(mContext.allocator, stage->memory, &mapped);
-    memcpy(mapped, cpuData, numBytes);
-    vmaUnmapMemory(mContext.allocator, stage->memory);
-    vmaFlushAllocation(mContext.allocator, stage->memory, 0, numBytes);
-
-    // Create a copy-to-device functor because we might need to defer it.
-    auto copyToDevice = [this, stage, width, height, miplevel] (VkCommandBuffer cmd) {
-        transitionImageLayout(cmd, textureImage, VK_IMAGE_LAYOUT_UNDEFINED,
-                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, miplevel);
-        copyBufferToImage(cmd, stage->buffer, textureImage, width, height, nullptr, miplevel);
-        transitionImageLayout(cmd, textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, miplevel);
-        getSwapContext(mContext).pendingWork.emplace_back([this, stage] (VkCommandBuffer) {
-            mStagePool.releaseStage(stage);
-        });
-    };
+    const VulkanStage stage = mStagePool.acquireStage(numBytes);
+    memcpy(stage.mapped, cpuData, numBytes);
+    mStagePool.flushStage(stage, numBytes);
 
-    // If possible, perform the upload immediately, otherwise queue up the work.
-    if (mContext.cmdbuffer) {
-        copyToDevice(mContext.cmdbuffer);
-    } else {
-        mContext.pendingWork.emplace_back(copyToDevice);
-    }
+    copyToDevice(stage, width, height, nullptr, miplevel);
 }
 
 void VulkanTexture::loadCubeImage(PixelBufferDescriptor&& data,  const FaceOffsets& faceOffsets,
@@ -526,22 +480,48 @@ void VulkanTexture::loadCubeImage(PixelBufferDescriptor&& data,  const FaceOffse
     const uint32_t numBytes = data.size;
     assert(this->target == SamplerType::SAMPLER_CUBEMAP);
     // Create and populate the staging buffer.
-    VulkanStage const* stage = mStagePool.acquireStage(numBytes);
-    void* mapped;
-    vmaMapMemory(mContext.allocator, stage->memory, &mapped);
-    memcpy(mapped, cpuData, numBytes);
-    vmaUnmapMemory(mContext.allocator, stage->memory);
-    vmaFlushAllocation(mContext.allocator, stage->memory, 0, numBytes);
-
-    // Create a copy-to-device functor because we might need to defer it.
-    auto copyToDevice = [this, faceOffsets, stage, miplevel] (VkCommandBuffer cmd) {
+    const VulkanStage stage = mStagePool.acquireStage(numBytes);
+    memcpy(stage.mapped, cpuData, numBytes);
+    mStagePool.flushStage(stage, numBytes);
+
+    copyToDevice(stage, width, height, &faceOffsets, miplevel);
+}
+
+void VulkanTexture::copyToDevice(VulkanStage const& stage, uint32_t width, uint32_t height,
+        FaceOffsets const* faceOffsets, uint32_t miplevel) {
+    // With a dedicated transfer queue, the copy runs concurrently with the frames and the graphics
+    // queue takes ownership of the miplevel before sampling it. The copy is recorded right away.
+    if (mContext.transferQueue) {
+        transferSerial = submitTransfer(mContext,
+                [this, stage, width, height, faceOffsets, miplevel] (VkCommandBuffer cmd) {
+            transitionImageLayout(cmd, textureImage, VK_IMAGE_LAYOUT_UNDEFINED,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, miplevel);
+            copyBufferToImage(cmd, stage.buffer, stage.offset, textureImage, width, height,
+                    faceOffsets, miplevel);
+            transferOwnership(cmd, miplevel, false);
+        }, [this, miplevel] (VkCommandBuffer cmd) {
+            transferOwnership(cmd, miplevel, true);
+        }, [this, owner = stage.owner] (VkCommandBuffer) {
+            mStagePool.releaseStage(owner);
+        });
+        return;
+    }
+
+    // Otherwise, create a copy-to-device functor for the graphics queue because we might need to
+    // defer it.
+    const bool hasFaceOffsets = faceOffsets != nullptr;
+    const FaceOffsets offsets = hasFaceOffsets ? *faceOffsets : FaceOffsets();
+    auto copyToDevice = [this, stage, width, height, hasFaceOffsets, offsets, miplevel]
+            (VkCommandBuffer cmd) {
         transitionImageLayout(cmd, textureImage, VK_IMAGE_LAYOUT_UNDEFINED,
                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, miplevel);
-        copyBufferToImage(cmd, stage->buffer, textureImage, width, height, &faceOffsets, miplevel);
+        copyBufferToImage(cmd, stage.buffer, stage.offset, textureImage, width, height,
+                hasFaceOffsets ? &offsets : nullptr, miplevel);
         transitionImageLayout(cmd, textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                 VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, miplevel);
-        getSwapContext(mContext).pendingWork.emplace_back([this, stage] (VkCommandBuffer) {
-            mStagePool.releaseStage(stage);
+        getSwapContext(mContext).pendingWork.emplace_back(
+                [this, owner = stage.owner] (VkCommandBuffer) {
+            mStagePool.releaseStage(owner);
         });
     };
 
@@ -553,6 +533,80 @@ void VulkanTexture::loadCubeImage(PixelBufferDescriptor&& data,  const FaceOffse
     }
 }
 
+void VulkanTexture::generateMipmaps() {
+    // Each level is blitted from the previous one, which is then read by the shaders again. The
+    // base level is expected to have been uploaded, i.e. read by the shaders.
+    auto generate = [this] (VkCommandBuffer cmd) {
+        auto barrier = [this, cmd](uint32_t miplevel, uint32_t levelCount,
+                VkImageLayout oldLayout, VkImageLayout newLayout,
+                VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask,
+                VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage) {
+            VkImageMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = srcAccessMask;
+            barrier.dstAccessMask = dstAccessMask;
+            barrier.oldLayout = oldLayout;
+            barrier.newLayout = newLayout;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = textureImage;
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.baseMipLevel = miplevel;
+            barrier.subresourceRange.levelCount = levelCount;
+            barrier.subresourceRange.baseArrayLayer = 0;
+            barrier.subresourceRange.layerCount = getLayerCount();
+            vkCmdPipelineBarrier(cmd, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        };
+
+        barrier(0, 1,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        int32_t w = int32_t(width);
+        int32_t h = int32_t(height);
+        int32_t d = target == SamplerType::SAMPLER_3D ? int32_t(depth) : 1;
+        for (uint32_t level = 1; level < levels; level++) {
+            barrier(level, 1,
+                    VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+            VkImageBlit blit = {};
+            blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            blit.srcSubresource.mipLevel = level - 1;
+            blit.srcSubresource.layerCount = getLayerCount();
+            blit.srcOffsets[1] = { w, h, d };
+            w = std::max(1, w / 2);
+            h = std::max(1, h / 2);
+            d = std::max(1, d / 2);
+            blit.dstSubresource = blit.srcSubresource;
+            blit.dstSubresource.mipLevel = level;
+            blit.dstOffsets[1] = { w, h, d };
+            vkCmdBlitImage(cmd, textureImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    textureImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+            // this level is the source of the next one
+            barrier(level, 1,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        }
+
+        barrier(0, levels,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+    };
+
+    // like the uploads, the blits are recorded right away if possible, otherwise queued up
+    if (mContext.cmdbuffer) {
+        generate(mContext.cmdbuffer);
+    } else {
+        mContext.pendingWork.emplace_back(generate);
+    }
+}
+
 void VulkanTexture::transitionImageLayout(VkCommandBuffer cmd, VkImage image,
         VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t miplevel) {
     VkImageMemoryBarrier barrier = {};
@@ -566,7 +620,7 @@ void VulkanTexture::transitionImageLayout(VkCommandBuffer cmd, VkImage image,
     barrier.subresourceRange.baseMipLevel = miplevel;
     barrier.subresourceRange.levelCount = 1;
     barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = this->target == SamplerType::SAMPLER_CUBEMAP ? 6 : 1;
+    barrier.subresourceRange.layerCount = getLayerCount();
     VkPipelineStageFlags sourceStage;
     VkPipelineStageFlags destinationStage;
     if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED &&
@@ -588,8 +642,33 @@ void VulkanTexture::transitionImageLayout(VkCommandBuffer cmd, VkImage image,
             &barrier);
 }
 
-void VulkanTexture::copyBufferToImage(VkCommandBuffer cmd, VkBuffer buffer, VkImage image,
-        uint32_t width, uint32_t height, FaceOffsets const* faceOffsets, uint32_t miplevel) {
+// Records one half of the ownership transfer of a miplevel from the transfer queue family to the
+// graphics queue family, which also moves it to the layout read by the shaders. The release half
+// goes to the transfer queue, and the acquire half to the graphics queue.
+void VulkanTexture::transferOwnership(VkCommandBuffer cmd, uint32_t miplevel, bool acquire) {
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = acquire ? 0 : VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = acquire ? VK_ACCESS_SHADER_READ_BIT : 0;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcQueueFamilyIndex = mContext.transferQueueFamilyIndex;
+    barrier.dstQueueFamilyIndex = mContext.graphicsQueueFamilyIndex;
+    barrier.image = textureImage;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = miplevel;
+    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = getLayerCount();
+    vkCmdPipelineBarrier(cmd,
+            acquire ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : VK_PIPELINE_STAGE_TRANSFER_BIT,
+            acquire ? VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+void VulkanTexture::copyBufferToImage(VkCommandBuffer cmd, VkBuffer buffer, uint32_t bufferOffset,
+        VkImage image, uint32_t width, uint32_t height, FaceOffsets const* faceOffsets,
+        uint32_t miplevel) {
     if (target == SamplerType::SAMPLER_CUBEMAP) {
         assert(faceOffsets);
         VkBufferImageCopy regions[6] = {{}};
@@ -602,20 +681,22 @@ void VulkanTexture::copyBufferToImage(VkCommandBuffer cmd, VkBuffer buffer, VkIm
             region.imageExtent.width = width >> miplevel;
             region.imageExtent.height = height >> miplevel;
             region.imageExtent.depth = 1;
-            region.bufferOffset = faceOffsets->offsets[face];
+            region.bufferOffset = bufferOffset + faceOffsets->offsets[face];
         }
         vkCmdCopyBufferToImage(cmd, buffer, image,
                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 6, regions);
         return;
     }
+    // the layers of an array, or the slices of a 3D texture, follow each other in the buffer
     VkBufferImageCopy region = {};
+    region.bufferOffset = bufferOffset;
     region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     region.imageSubresource.mipLevel = miplevel;
-    region.imageSubresource.layerCount = 1;
+    region.imageSubresource.layerCount = getLayerCount();
     region.imageExtent = {
         .width = width >> miplevel,
         .height = height >> miplevel,
-        .depth = 1,
+        .depth = target == SamplerType::SAMPLER_3D ? std::max(1u, depth >> miplevel) : 1,
     };
     vkCmdCopyBufferToImage(cmd, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 }
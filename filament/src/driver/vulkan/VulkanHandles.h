@@ -45,6 +45,9 @@ struct VulkanTexture;
 // - The attachment's VkImage is shared and the owner is VulkanSwapChain.
 // - The attachment's VkImage is shared and the owner is VulkanTexture.
 //
+// Render targets with a color texture can also have a transient color attachment owned by
+// VulkanRenderTarget, which is drawn by the first subpass of DEPENDENCY_SUBPASS_INPUT render passes.
+//
 // We use private inheritence to shield clients from the width / height fields in HwRenderTarget,
 // which are not representative when this is the default render target.
 struct VulkanRenderTarget : private HwRenderTarget {
@@ -68,9 +71,14 @@ struct VulkanRenderTarget : private HwRenderTarget {
     void createDepthImage(VkFormat format);
     void setColorImage(VulkanAttachment c);
     void setDepthImage(VulkanAttachment d);
+    void setSubpassFormat(VkFormat format) { mSubpassColor.format = format; }
+    VulkanAttachment getSubpassColor();
+    VkImageView getSubpassColorView() const { return mSubpassColor.view; }
 private:
     VulkanAttachment mColor = {};
     VulkanAttachment mDepth = {};
+    VulkanAttachment mSubpassColor = {}; // created on first use
+
     VulkanContext& mContext;
     bool mOffscreen;
     bool mSharedColorImage = true;
@@ -101,7 +109,8 @@ struct VulkanIndexBuffer : public HwIndexBuffer {
 struct VulkanUniformBuffer : public HwUniformBuffer {
     VulkanUniformBuffer(VulkanContext& context, VulkanStagePool& stagePool, uint32_t numBytes);
     ~VulkanUniformBuffer();
-    void loadFromCpu(const void* cpuData, uint32_t numBytes);
+    // dstOffset is the offset in bytes of the data in the buffer
+    void loadFromCpu(const void* cpuData, uint32_t numBytes, uint32_t dstOffset = 0);
     VkBuffer getGpuBuffer() const { return mGpuBuffer; }
 private:
     VulkanContext& mContext;
@@ -112,6 +121,7 @@ private:
 
 struct VulkanSamplerBuffer : public HwSamplerBuffer {
     VulkanSamplerBuffer(VulkanContext& context, uint32_t count) : HwSamplerBuffer(count) {}
+    uint32_t generation = 0; // changes with the content, unique across sampler buffers
 };
 
 struct VulkanTexture : public HwTexture {
@@ -121,15 +131,27 @@ struct VulkanTexture : public HwTexture {
     ~VulkanTexture();
     void load2DImage(PixelBufferDescriptor&& data, uint32_t width, uint32_t height, int miplevel);
     void loadCubeImage(PixelBufferDescriptor&& data, const FaceOffsets& faceOffsets, int miplevel);
+    void generateMipmaps();
     VkFormat format;
     VkImageView imageView = VK_NULL_HANDLE;
     VkImage textureImage = VK_NULL_HANDLE;
-    VkDeviceMemory textureImageMemory = VK_NULL_HANDLE;
+    VmaAllocation textureImageMemory = VK_NULL_HANDLE;
+    uint64_t transferSerial = 0; // last upload through the transfer queue, see acquireTransfers()
+    uint8_t minLevel = 0;       // levels sampled, see setMinMaxLevels()
+    uint8_t maxLevel = 255;
 private:
+    uint32_t getLayerCount() const noexcept {
+        return target == SamplerType::SAMPLER_CUBEMAP ? 6 :
+                target == SamplerType::SAMPLER_2D_ARRAY ? depth : 1;
+    }
+    void copyToDevice(VulkanStage const& stage, uint32_t width, uint32_t height,
+            FaceOffsets const* faceOffsets, uint32_t miplevel);
     void transitionImageLayout(VkCommandBuffer cmdbuffer, VkImage image,
             VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t miplevel);
-    void copyBufferToImage(VkCommandBuffer cmdbuffer, VkBuffer buffer, VkImage image,
-            uint32_t width, uint32_t height, FaceOffsets const* faceOffsets, uint32_t miplevel);
+    void transferOwnership(VkCommandBuffer cmdbuffer, uint32_t miplevel, bool acquire);
+    void copyBufferToImage(VkCommandBuffer cmdbuffer, VkBuffer buffer, uint32_t bufferOffset,
+            VkImage image, uint32_t width, uint32_t height, FaceOffsets const* faceOffsets,
+            uint32_t miplevel);
     VulkanContext& mContext;
     VulkanStagePool& mStagePool;
     uint32_t mByteCount;
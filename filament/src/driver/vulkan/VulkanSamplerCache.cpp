@@ -18,6 +18,8 @@
 
 #include <utils/Panic.h>
 
+#include <algorithm>
+
 namespace filament {
 namespace driver {
 
@@ -97,8 +99,17 @@ constexpr inline VkBool32 getCompareEnable(SamplerCompareMode mode) noexcept {
 
 VulkanSamplerCache::VulkanSamplerCache(VulkanContext& context) : mContext(context) {}
 
-VkSampler VulkanSamplerCache::getSampler(driver::SamplerParams params) noexcept {
-    auto iter = mCache.find(params.u);
+VkSampler VulkanSamplerCache::getSampler(driver::SamplerParams params,
+        uint8_t minLevel, uint8_t maxLevel) noexcept {
+    const float maxLod = getMaxLod(params.filterMin);
+    if (maxLod < 1.0f) {
+        // no mipmapping, only the first level is read
+        minLevel = 0;
+        maxLevel = 255;
+    }
+    const uint64_t key = uint64_t(params.u) | (uint64_t(minLevel) << 32u) |
+            (uint64_t(maxLevel) << 40u);
+    auto iter = mCache.find(key);
     if (UTILS_LIKELY(iter != mCache.end())) {
         return iter->second;
     }
@@ -116,13 +127,13 @@ VkSampler VulkanSamplerCache::getSampler(driver::SamplerParams params) noexcept
         .compareEnable = getCompareEnable(params.compareMode),
         .compareOp = getCompareOp(params.compareFunc),
         .mipmapMode = getMipmapMode(params.filterMin),
-        .minLod = 0.0f,
-        .maxLod = getMaxLod(params.filterMin),
+        .minLod = float(minLevel),
+        .maxLod = std::min(maxLod, float(maxLevel)),
     };
     VkSampler sampler;
     VkResult error = vkCreateSampler(mContext.device, &samplerInfo, VKALLOC, &sampler);
     ASSERT_POSTCONDITION(!error, "Unable to create sampler.");
-    mCache.insert({params.u, sampler});
+    mCache.insert({key, sampler});
     return sampler;
 }
 
@@ -28,11 +28,13 @@ namespace driver {
 class VulkanSamplerCache {
 public:
     explicit VulkanSamplerCache(VulkanContext&);
-    VkSampler getSampler(driver::SamplerParams params) noexcept;
+    // the sampler only reads the levels [minLevel, maxLevel] of the textures, when it mipmaps
+    VkSampler getSampler(driver::SamplerParams params,
+            uint8_t minLevel = 0, uint8_t maxLevel = 255) noexcept;
     void reset() noexcept;
 private:
     VulkanContext& mContext;
-    tsl::robin_map<uint32_t, VkSampler> mCache;
+    tsl::robin_map<uint64_t, VkSampler> mCache;
 };
 
 } // namespace filament
@@ -18,70 +18,151 @@
 
 #include <utils/Panic.h>
 
+#include <algorithm>
+
 namespace filament {
 namespace driver {
 
-VulkanStage const* VulkanStagePool::acquireStage(uint32_t numBytes) noexcept {
-    // First check if a stage exists whose capacity is greater than or equal to the requested size.
-    auto iter = mFreeStages.lower_bound(numBytes);
-    if (iter != mFreeStages.end()) {
-        auto stage = iter->second;
-        mFreeStages.erase(iter);
+VulkanStage VulkanStagePool::acquireStage(uint32_t numBytes) noexcept {
+    if (numBytes > MAX_BLOCK_STAGE_SIZE) {
+        // First check if a dedicated stage exists whose capacity is greater than or equal to the
+        // requested size.
+        VulkanStageBuffer* stage;
+        auto iter = mFreeStages.lower_bound(numBytes);
+        if (iter != mFreeStages.end()) {
+            stage = iter->second;
+            mFreeStages.erase(iter);
+        } else {
+            // We were not able to find a sufficiently large stage, so create a new one.
+            stage = createBuffer(numBytes, false);
+        }
         mUsedStages.insert(stage);
-        return stage;
+        return { stage, stage->memory, stage->buffer, 0, stage->mapped };
     }
-    // We were not able to find a sufficiently large stage, so create a new one.
-    VulkanStage* stage = new VulkanStage({
-        .memory = VK_NULL_HANDLE,
-        .buffer = VK_NULL_HANDLE,
-        .lastAccessed = mCurrentFrame,
-        .capacity = numBytes,
-    });
-    // Create the VkBuffer.
-    mUsedStages.insert(stage);
-    VkBufferCreateInfo bufferInfo {
-        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
-        .size = numBytes,
-        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-    };
-    VmaAllocationCreateInfo allocInfo {
-        .usage = VMA_MEMORY_USAGE_CPU_ONLY
-    };
-    vmaCreateBuffer(mContext.allocator, &bufferInfo, &allocInfo, &stage->buffer, &stage->memory, 0);
-    return stage;
+
+    // Sub-allocate from the current block, or else from the next block whose stages have all been
+    // released, or else from a new block.
+    const uint32_t size = (numBytes + STAGE_ALIGNMENT - 1) / STAGE_ALIGNMENT * STAGE_ALIGNMENT;
+    VulkanStageBuffer* block = mBlocks.empty() ? nullptr : mBlocks[mCurrentBlock];
+    if (!block || block->head + size > block->capacity) {
+        block = nullptr;
+        for (size_t i = 1, c = mBlocks.size(); i <= c; i++) {
+            const size_t index = (mCurrentBlock + i) % c;
+            if (mBlocks[index]->users == 0) {
+                mCurrentBlock = index;
+                block = mBlocks[index];
+                block->head = 0;
+                break;
+            }
+        }
+        if (!block) {
+            block = createBuffer(BLOCK_SIZE, true);
+            mCurrentBlock = mBlocks.size();
+            mBlocks.push_back(block);
+        }
+    }
+    const uint32_t offset = block->head;
+    block->head += size;
+    block->users++;
+    block->lastAccessed = mCurrentFrame;
+    return { block, block->memory, block->buffer, offset, block->mapped + offset };
 }
 
-void VulkanStagePool::releaseStage(VulkanStage const* stage) noexcept {
-    auto iter = mUsedStages.find(stage);
+void VulkanStagePool::releaseStage(VulkanStageBuffer* owner) noexcept {
+    owner->lastAccessed = mCurrentFrame;
+    if (owner->block) {
+        assert(owner->users > 0);
+        owner->users--;
+        return;
+    }
+    auto iter = mUsedStages.find(owner);
     if (iter == mUsedStages.end()) {
-        utils::slog.e << "Unknown stage: " << stage->capacity << " bytes" << utils::io::endl;
+        utils::slog.e << "Unknown stage: " << owner->capacity << " bytes" << utils::io::endl;
         return;
     }
-    stage->lastAccessed = mCurrentFrame;
     mUsedStages.erase(iter);
-    mFreeStages.insert(std::make_pair(stage->capacity, stage));
+    mFreeStages.insert(std::make_pair(owner->capacity, owner));
+}
+
+void VulkanStagePool::flushStage(VulkanStage const& stage, uint32_t numBytes) noexcept {
+    vmaFlushAllocation(mContext.allocator, stage.memory, stage.offset, numBytes);
 }
 
 void VulkanStagePool::gc() noexcept {
     mCurrentFrame++;
+    const uint64_t evictionTime = mCurrentFrame - TIME_BEFORE_EVICTION;
+
     decltype(mFreeStages) stages;
     stages.swap(mFreeStages);
-    const uint64_t evictionTime = mCurrentFrame - TIME_BEFORE_EVICTION;
     for (auto pair : stages) {
         if (pair.second->lastAccessed < evictionTime) {
-            vmaDestroyBuffer(mContext.allocator, pair.second->buffer, pair.second->memory);
+            destroyBuffer(pair.second);
         } else {
             mFreeStages.insert(pair);
         }
     }
+
+    // The current block is kept, so that the small uploads of the next frames don't create one.
+    VulkanStageBuffer* current = mBlocks.empty() ? nullptr : mBlocks[mCurrentBlock];
+    auto last = std::remove_if(mBlocks.begin(), mBlocks.end(), [=](VulkanStageBuffer* block) {
+        if (block != current && block->users == 0 && block->lastAccessed < evictionTime) {
+            destroyBuffer(block);
+            return true;
+        }
+        return false;
+    });
+    mBlocks.erase(last, mBlocks.end());
+    mCurrentBlock = std::find(mBlocks.begin(), mBlocks.end(), current) - mBlocks.begin();
+    if (mCurrentBlock == mBlocks.size()) {
+        mCurrentBlock = 0;
+    }
 }
 
 void VulkanStagePool::reset() noexcept {
     assert(mUsedStages.empty());
     for (auto pair : mFreeStages) {
-        vmaDestroyBuffer(mContext.allocator, pair.second->buffer, pair.second->memory);
+        destroyBuffer(pair.second);
     }
     mFreeStages.clear();
+    for (VulkanStageBuffer* block : mBlocks) {
+        assert(block->users == 0);
+        destroyBuffer(block);
+    }
+    mBlocks.clear();
+    mCurrentBlock = 0;
+}
+
+VulkanStageBuffer* VulkanStagePool::createBuffer(uint32_t capacity, bool block) noexcept {
+    VulkanStageBuffer* stage = new VulkanStageBuffer({
+        .memory = VK_NULL_HANDLE,
+        .buffer = VK_NULL_HANDLE,
+        .mapped = nullptr,
+        .capacity = capacity,
+        .head = 0,
+        .users = 0,
+        .lastAccessed = mCurrentFrame,
+        .block = block,
+    });
+    VkBufferCreateInfo bufferInfo {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = capacity,
+        .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+    };
+    // The stages stay mapped for their whole lifetime, rather than being mapped for each upload.
+    VmaAllocationCreateInfo allocInfo {
+        .flags = VMA_ALLOCATION_CREATE_MAPPED_BIT,
+        .usage = VMA_MEMORY_USAGE_CPU_ONLY
+    };
+    VmaAllocationInfo info;
+    vmaCreateBuffer(mContext.allocator, &bufferInfo, &allocInfo, &stage->buffer, &stage->memory,
+            &info);
+    stage->mapped = (uint8_t*) info.pMappedData;
+    return stage;
+}
+
+void VulkanStagePool::destroyBuffer(VulkanStageBuffer* stage) noexcept {
+    vmaDestroyBuffer(mContext.allocator, stage->buffer, stage->memory);
+    delete stage;
 }
 
 } // namespace filament
@@ -21,28 +21,52 @@
 
 #include <map>
 #include <unordered_set>
+#include <vector>
 
 namespace filament {
 namespace driver {
 
-// Immutable POD representing a shared CPU-GPU staging area.
-struct VulkanStage {
+// Persistently mapped CPU-GPU staging buffer, either one of the pool's blocks, which are shared by
+// the small uploads, or dedicated to a large upload.
+struct VulkanStageBuffer {
     VmaAllocation memory;
     VkBuffer buffer;
+    uint8_t* mapped;
     uint32_t capacity;
-    mutable uint64_t lastAccessed;
+    uint32_t head;          // end of the sub-allocations of a block
+    uint32_t users;         // stages of a block which haven't been released
+    uint64_t lastAccessed;
+    bool block;
+};
+
+// Immutable POD representing a staging area: a range of a block, or a whole dedicated buffer.
+// The data is written at the mapped address, then flushed before the GPU copies it from
+// [offset, offset + size) of the buffer.
+struct VulkanStage {
+    VulkanStageBuffer* owner;
+    VmaAllocation memory;
+    VkBuffer buffer;
+    uint32_t offset;
+    void* mapped;
 };
 
-// Manages a pool of stages, periodically releasing stages that have been unused for a while.
+// Manages a ring of persistently mapped blocks that the uploads sub-allocate linearly, and a pool
+// of dedicated stages for the uploads which are too large for the blocks. A block is reused once
+// all the stages allocated from it have been released, i.e. once the GPU has completed their
+// copies, and the blocks or dedicated stages that have been unused for a while are released.
 class VulkanStagePool {
 public:
     explicit VulkanStagePool(VulkanContext& context) noexcept : mContext(context) {}
 
-    // Finds or creates a stage whose capacity is at least the given number of bytes.
-    VulkanStage const* acquireStage(uint32_t numBytes) noexcept;
+    // Returns a stage whose capacity is at least the given number of bytes.
+    VulkanStage acquireStage(uint32_t numBytes) noexcept;
 
-    // Returns the given stage back to the pool.
-    void releaseStage(VulkanStage const* stage) noexcept;
+    // Returns the given stage back to the pool, after the GPU has completed its copies. Only the
+    // owner is needed, so that the completion tasks capturing it stay small.
+    void releaseStage(VulkanStageBuffer* owner) noexcept;
+
+    // Flushes the given number of bytes written to the stage, for non-coherent memory.
+    void flushStage(VulkanStage const& stage, uint32_t numBytes) noexcept;
 
     // Evicts old unused stages and bumps the current frame number.
     void gc() noexcept;
@@ -51,18 +75,34 @@ public:
     // This should be called while the context's VkDevice is still alive.
     void reset() noexcept;
 private:
+    VulkanStageBuffer* createBuffer(uint32_t capacity, bool block) noexcept;
+    void destroyBuffer(VulkanStageBuffer* buffer) noexcept;
+
     VulkanContext& mContext;
 
+    // The blocks, the uploads are sub-allocated from the current one until it's full, and then
+    // from the next one which has no users, or a new one.
+    std::vector<VulkanStageBuffer*> mBlocks;
+    size_t mCurrentBlock = 0;
+
     // Use an ordered multimap for quick (capacity => stage) lookups using lower_bound().
-    std::multimap<uint32_t, VulkanStage const*> mFreeStages;
+    std::multimap<uint32_t, VulkanStageBuffer*> mFreeStages;
 
     // Simple unordered set for stashing a list of in-use stages that can be reclaimed later.
     // In theory this need not exist, but is useful for validation and ensuring no leaks.
-    std::unordered_set<VulkanStage const*> mUsedStages;
+    std::unordered_set<VulkanStageBuffer*> mUsedStages;
 
     // Store the current "time" (really just a frame count) and LRU eviction parameters.
     uint64_t mCurrentFrame = 0;
     static constexpr uint32_t TIME_BEFORE_EVICTION = 2;
+
+    // The size of the blocks, and the largest upload sub-allocated from a block.
+    static constexpr uint32_t BLOCK_SIZE = 4u * 1024u * 1024u;
+    static constexpr uint32_t MAX_BLOCK_STAGE_SIZE = BLOCK_SIZE / 4u;
+
+    // The alignment of the stages in a block. The buffer offsets of vkCmdCopyBufferToImage must
+    // be multiples of 4 and of the texel or block size, which 48 is for all the formats.
+    static constexpr uint32_t STAGE_ALIGNMENT = 48u;
 };
 
 } // namespace filament
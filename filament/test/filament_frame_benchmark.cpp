@@ -0,0 +1,348 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Measures the CPU side of whole frames, stage by stage, on synthetic scenes.
+ *
+ * The frames are rendered with the instrumented noop driver, so only filament's own work is
+ * measured. The stages are the phases of the PhaseProfiler (scene preparation, culling,
+ * froxelization, command generation, sort and recording), plus "execute", the time the driver
+ * thread takes to execute the frame's command stream, and "frame", the time spent in
+ * Renderer::render(). "execute" also reports what the driver executed per frame: the commands,
+ * the bytes uploaded, the programs created, the pipelines and the state changes. In builds with
+ * FILAMENT_TRACK_ALLOCATIONS, the phases report their allocations per frame too.
+ *
+ * The driver can spend a CPU cost on each command, to model the driver thread of a real backend,
+ * and see how the main thread copes with it.
+ *
+ * Each scene is measured with the Engine's threads on 1, 2, 4... cores (see
+ * Engine::setReservedCores()), and the results are printed as JSON, in the format of google
+ * benchmark, so they can be compared across runs with its tools.
+ *
+ * usage: filament_frame_benchmark [frames] [nanoseconds per command]
+ */
+
+#include "PhaseProfiler.h"
+
+#include "driver/noop/NoopDriver.h"
+
+#include <filament/Box.h>
+#include <filament/Camera.h>
+#include <filament/DebugRegistry.h>
+#include <filament/Engine.h>
+#include <filament/Fence.h>
+#include <filament/IndexBuffer.h>
+#include <filament/LightManager.h>
+#include <filament/Material.h>
+#include <filament/MaterialInstance.h>
+#include <filament/RenderableManager.h>
+#include <filament/Renderer.h>
+#include <filament/Scene.h>
+#include <filament/TransformManager.h>
+#include <filament/VertexBuffer.h>
+#include <filament/View.h>
+#include <filament/Viewport.h>
+#include <filament/driver/ExternalContext.h>
+
+#include <utils/EntityManager.h>
+
+#include <math/mat4.h>
+#include <math/vec3.h>
+#include <math/vec4.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <math.h>
+#include <stdlib.h>
+
+using namespace filament;
+using namespace math;
+using namespace utils;
+
+using clock_type = std::chrono::steady_clock;
+
+// creates the instrumented noop driver, instead of the platform's
+class NoopContext final : public driver::ExternalContext {
+public:
+    explicit NoopContext(uint32_t commandCost) noexcept : mCommandCost(commandCost) { }
+    std::unique_ptr<Driver> createDriver(void* sharedGLContext) noexcept override {
+        return NoopDriver::create(&mStats, mCommandCost);
+    }
+    int getOSVersion() const noexcept override { return 0; }
+    NoopDriver::Stats& getStats() noexcept { return mStats; }
+private:
+    NoopDriver::Stats mStats;
+    const uint32_t mCommandCost;
+};
+
+struct SceneConfig {
+    size_t renderables;
+    size_t lights;
+    size_t materials;
+};
+
+static const SceneConfig SCENES[] = {
+        {   1000,   16,  4 },
+        {  10000,  128, 16 },
+        {  50000,  256, 64 },
+};
+
+// the stages of a frame, accumulated over all the frames of a run, in ns
+struct Stages {
+    double phases[PhaseProfiler::PHASE_COUNT] = {};
+    uint64_t allocations[PhaseProfiler::PHASE_COUNT] = {};
+    double execute = 0;
+    double frame = 0;
+    NoopDriver::Stats driver;
+};
+
+class SyntheticScene {
+public:
+    SyntheticScene(Engine& engine, SceneConfig const& config) : mEngine(engine) {
+        std::mt19937 gen;
+        std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+        std::uniform_real_distribution<float> depth(-200.0f, 0.0f);
+        EntityManager& em = EntityManager::get();
+
+        mScene = engine.createScene();
+        mView = engine.createView();
+        mCamera = engine.createCamera();
+        mCamera->setProjection(60.0, 16.0 / 9.0, 0.1, 500.0);
+        mView->setCamera(mCamera);
+        mView->setScene(mScene);
+        mView->setViewport({ 0, 0, 1920, 1080 });
+
+        // a cube, its content doesn't matter to the noop driver
+        mVertexBuffer = VertexBuffer::Builder()
+                .vertexCount(8)
+                .bufferCount(1)
+                .attribute(VertexAttribute::POSITION, 0, VertexBuffer::AttributeType::FLOAT3)
+                .build(engine);
+        mIndexBuffer = IndexBuffer::Builder()
+                .indexCount(36)
+                .bufferType(IndexBuffer::IndexType::USHORT)
+                .build(engine);
+
+        Material const* material = engine.getDefaultMaterial();
+        for (size_t i = 0; i < config.materials; i++) {
+            mMaterialInstances.push_back(material->createInstance());
+        }
+
+        TransformManager& tcm = engine.getTransformManager();
+        for (size_t i = 0; i < config.renderables; i++) {
+            Entity e = em.create();
+            RenderableManager::Builder(1)
+                    .boundingBox({{ 0, 0, 0 }, { 1, 1, 1 }})
+                    .material(0, mMaterialInstances[i % config.materials])
+                    .geometry(0, RenderableManager::PrimitiveType::TRIANGLES,
+                            mVertexBuffer, mIndexBuffer, 0, 36)
+                    .castShadows(true)
+                    .receiveShadows(true)
+                    .build(engine, e);
+            tcm.create(e, {}, mat4f::translate(
+                    float4{ position(gen), position(gen), depth(gen), 1 }));
+            mScene->addEntity(e);
+            mEntities.push_back(e);
+        }
+
+        Entity sun = em.create();
+        LightManager::Builder(LightManager::Type::SUN)
+                .direction({ 0, -1, -1 })
+                .castShadows(true)
+                .build(engine, sun);
+        mScene->addEntity(sun);
+        mEntities.push_back(sun);
+
+        for (size_t i = 0; i < config.lights; i++) {
+            Entity e = em.create();
+            LightManager::Builder(LightManager::Type::POINT)
+                    .position({ position(gen), position(gen), depth(gen) })
+                    .falloff(20.0f)
+                    .intensity(1000.0f)
+                    .build(engine, e);
+            mScene->addEntity(e);
+            mEntities.push_back(e);
+        }
+    }
+
+    ~SyntheticScene() {
+        for (Entity e : mEntities) {
+            mEngine.destroy(e);
+        }
+        for (MaterialInstance* mi : mMaterialInstances) {
+            mEngine.destroy(mi);
+        }
+        mEngine.destroy(mVertexBuffer);
+        mEngine.destroy(mIndexBuffer);
+        mEngine.destroy(mView);
+        mEngine.destroy(mScene);
+        mEngine.destroy(mCamera);
+    }
+
+    View* getView() const noexcept { return mView; }
+
+    // orbits the camera, so that nothing is cached from one frame to the next
+    void setFrame(size_t frame) noexcept {
+        const float a = float(frame) * 0.01f;
+        mCamera->lookAt({ 10.0f * std::sin(a), 10.0f, 50.0f + 10.0f * std::cos(a) },
+                { 0, 0, -100 }, { 0, 1, 0 });
+    }
+
+private:
+    Engine& mEngine;
+    Scene* mScene = nullptr;
+    View* mView = nullptr;
+    Camera* mCamera = nullptr;
+    VertexBuffer* mVertexBuffer = nullptr;
+    IndexBuffer* mIndexBuffer = nullptr;
+    std::vector<MaterialInstance*> mMaterialInstances;
+    std::vector<Entity> mEntities;
+};
+
+static Stages run(Engine& engine, NoopContext& context, SceneConfig const& config,
+        size_t frames) {
+    SyntheticScene scene(engine, config);
+    Renderer* renderer = engine.createRenderer();
+    SwapChain* swapChain = engine.createSwapChain(nullptr);
+    PhaseProfiler& profiler = PhaseProfiler::get();
+
+    Stages stages;
+    // the first frames create the programs, render targets, etc...
+    const size_t warmup = 4;
+    for (size_t i = 0; i < warmup + frames; i++) {
+        scene.setFrame(i);
+        if (i == warmup) {
+            // the driver is idle, after the fence of the previous frame
+            context.getStats().reset();
+        }
+        if (!renderer->beginFrame(swapChain)) {
+            continue;
+        }
+
+        clock_type::time_point start = clock_type::now();
+        renderer->render(scene.getView());
+        clock_type::time_point end = clock_type::now();
+
+        // endFrame() collects the counters too, they're only read here
+        PhaseProfiler::FrameCounters counters = profiler.collect();
+        renderer->endFrame();
+
+        clock_type::time_point executeStart = clock_type::now();
+        Fence::waitAndDestroy(engine.createFence());
+        clock_type::time_point executeEnd = clock_type::now();
+
+        if (i >= warmup) {
+            for (size_t p = 0; p < PhaseProfiler::PHASE_COUNT; p++) {
+                stages.phases[p] += double(counters[p].time);
+                stages.allocations[p] += counters[p].allocations;
+            }
+            stages.frame += std::chrono::duration<double, std::nano>(end - start).count();
+            stages.execute +=
+                    std::chrono::duration<double, std::nano>(executeEnd - executeStart).count();
+        }
+    }
+
+    stages.driver = context.getStats();
+    engine.destroy(swapChain);
+    engine.destroy(renderer);
+    return stages;
+}
+
+// the counters are printed per frame, as google benchmark's user counters
+using Counter = std::pair<const char*, uint64_t>;
+static void printResult(std::string const& name, size_t frames, double ns, bool last,
+        std::vector<Counter> const& counters = {}) {
+    std::cout << "    {" << std::endl;
+    std::cout << "      \"name\": \"" << name << "\"," << std::endl;
+    std::cout << "      \"iterations\": " << frames << "," << std::endl;
+    std::cout << "      \"real_time\": " << ns / double(frames) << "," << std::endl;
+    std::cout << "      \"cpu_time\": " << ns / double(frames) << "," << std::endl;
+    for (Counter const& counter : counters) {
+        std::cout << "      \"" << counter.first << "\": "
+                << double(counter.second) / double(frames) << "," << std::endl;
+    }
+    std::cout << "      \"time_unit\": \"ns\"" << std::endl;
+    std::cout << "    }" << (last ? "" : ",") << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    const size_t frames = argc > 1 ? size_t(std::max(1, atoi(argv[1]))) : 64;
+    const uint32_t commandCost = argc > 2 ? uint32_t(std::max(0, atoi(argv[2]))) : 0;
+    const uint32_t cpuCount = std::min(32u, std::max(1u, std::thread::hardware_concurrency()));
+
+    std::vector<uint32_t> coreCounts;
+    for (uint32_t cores = 1; cores < cpuCount; cores *= 2) {
+        coreCounts.push_back(cores);
+    }
+    coreCounts.push_back(cpuCount);
+
+    std::cout << "{" << std::endl;
+    std::cout << "  \"context\": {" << std::endl;
+    std::cout << "    \"executable\": \"" << argv[0] << "\"," << std::endl;
+    std::cout << "    \"num_cpus\": " << cpuCount << "," << std::endl;
+    std::cout << "    \"frames\": " << frames << "," << std::endl;
+    std::cout << "    \"command_cost_ns\": " << commandCost << std::endl;
+    std::cout << "  }," << std::endl;
+    std::cout << "  \"benchmarks\": [" << std::endl;
+
+    NoopContext context(commandCost);
+    Engine* engine = Engine::create(Engine::Backend::DEFAULT, &context);
+    engine->getDebugRegistry().setProperty("d.profiler.phases", true);
+
+    for (size_t s = 0, c = sizeof(SCENES) / sizeof(SCENES[0]); s < c; s++) {
+        SceneConfig const& config = SCENES[s];
+        for (size_t k = 0; k < coreCounts.size(); k++) {
+            const uint32_t cores = coreCounts[k];
+            // keep the engine's threads on the first 'cores' CPUs
+            engine->setReservedCores(cores < 32 ? ~((1u << cores) - 1u) : 0u);
+
+            Stages stages = run(*engine, context, config, frames);
+
+            std::string prefix = "/renderables:" + std::to_string(config.renderables) +
+                    "/lights:" + std::to_string(config.lights) +
+                    "/materials:" + std::to_string(config.materials) +
+                    "/cores:" + std::to_string(cores);
+            for (size_t p = 0; p < PhaseProfiler::PHASE_COUNT; p++) {
+                printResult(PhaseProfiler::getPhaseName(PhaseProfiler::Phase(p)) + prefix,
+                        frames, stages.phases[p], false,
+                        {{ "allocations", stages.allocations[p] }});
+            }
+            NoopDriver::Stats const& driver = stages.driver;
+            printResult("execute" + prefix, frames, stages.execute, false, {
+                    { "commands", driver.getCommandCount() },
+                    { "uploaded_bytes", driver.uploadedBytes },
+                    { "programs", driver.programs },
+                    { "pipelines", driver.pipelines },
+                    { "state_changes", driver.getStateChanges() }});
+            printResult("frame" + prefix, frames, stages.frame,
+                    s == c - 1 && k == coreCounts.size() - 1);
+        }
+    }
+
+    std::cout << "  ]" << std::endl;
+    std::cout << "}" << std::endl;
+
+    engine->setReservedCores(0);
+    Engine::destroy(&engine);
+    return 0;
+}
@@ -14,7 +14,9 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <iostream>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -31,10 +33,14 @@
 #include "driver/UniformBuffer.h"
 #include <filament/UniformInterfaceBlock.h>
 
+#include "AffineTransform.h"
 #include "details/Allocators.h"
+#include "FrameGraph.h"
+#include "details/Bvh.h"
 #include "details/Material.h"
 #include "details/Camera.h"
 #include "details/Froxelizer.h"
+#include "details/TemporalCuller.h"
 #include "details/Engine.h"
 #include "components/TransformManager.h"
 #include "utils/RangeSet.h"
@@ -144,6 +150,132 @@ TEST(FilamentTest, TransformManager) {
     EXPECT_EQ(tcm.getWorldTransform(child), mat4f{ float4{ 8 }});
 }
 
+TEST(FilamentTest, TransformManagerParallelCommit) {
+    JobSystem js;
+    js.adopt();
+
+    // enough components for the parallel path, most of them sorted before their parent
+    constexpr size_t count = 4096;
+    filament::details::FTransformManager serial;
+    filament::details::FTransformManager parallel(&js);
+    EntityManager& em = EntityManager::get();
+    std::vector<Entity> entities(count);
+    em.create(entities.size(), entities.data());
+
+    for (filament::details::FTransformManager* tcm : { &serial, &parallel }) {
+        for (Entity e : entities) {
+            tcm->create(e);
+        }
+        for (size_t k = 0; k < count; k++) {
+            if (k < count / 2 || k >= count / 2 + 64) {
+                Entity parent = entities[count / 2 + k % 64];
+                tcm->setParent(tcm->getInstance(entities[k]), tcm->getInstance(parent));
+            }
+        }
+        tcm->openLocalTransformTransaction();
+        for (size_t k = 0; k < count; k++) {
+            mat4f local{ float4{ float(1 + k % 3) }};
+            local[3] = float4{ float(k), 1, 2, 1 };
+            tcm->setTransform(tcm->getInstance(entities[k]), local);
+        }
+        tcm->commitLocalTransformTransaction();
+    }
+
+    for (Entity e : entities) {
+        auto si = serial.getInstance(e);
+        auto pi = parallel.getInstance(e);
+        EXPECT_EQ(serial.getWorldTransform(si), parallel.getWorldTransform(pi));
+    }
+
+    for (Entity e : entities) {
+        serial.destroy(e);
+        parallel.destroy(e);
+    }
+    em.destroy(entities.size(), entities.data());
+}
+
+TEST(FilamentTest, TransformManagerSetTransforms) {
+    filament::details::FTransformManager tcm;
+    EntityManager& em = EntityManager::get();
+    std::array<Entity, 2> entities;
+    em.create(entities.size(), entities.data());
+
+    tcm.create(entities[0]);
+    tcm.create(entities[1], tcm.getInstance(entities[0]), mat4f{});
+    TransformManager::Instance instances[2] = {
+            tcm.getInstance(entities[0]), tcm.getInstance(entities[1]) };
+
+    // outside of a transaction, world transforms are updated right away
+    const mat4f transforms[2] = { mat4f{ float4{ 2 }}, mat4f{ float4{ 3 }} };
+    tcm.setTransforms(instances, transforms, 2);
+    EXPECT_EQ(tcm.getTransform(instances[1]), mat4f{ float4{ 3 }});
+    EXPECT_EQ(tcm.getWorldTransform(instances[1]), mat4f{ float4{ 6 }});
+
+    // within a transaction, world transforms are updated by the commit
+    const float3 affine[8] = {
+            { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 }, { 1, 2, 3 },
+            { 2, 0, 0 }, { 0, 2, 0 }, { 0, 0, 2 }, { 4, 5, 6 } };
+    tcm.openLocalTransformTransaction();
+    tcm.setTransforms(instances, affine, 2);
+    EXPECT_EQ(tcm.getWorldTransform(instances[1]), mat4f{ float4{ 6 }});
+    tcm.commitLocalTransformTransaction();
+
+    instances[0] = tcm.getInstance(entities[0]);
+    instances[1] = tcm.getInstance(entities[1]);
+    EXPECT_EQ(tcm.getTransform(instances[1]), mat4f(
+            float4{ 2, 0, 0, 0 }, float4{ 0, 2, 0, 0 }, float4{ 0, 0, 2, 0 }, float4{ 4, 5, 6, 1 }));
+    EXPECT_EQ(tcm.getWorldTransform(instances[1]), mat4f(
+            float4{ 2, 0, 0, 0 }, float4{ 0, 2, 0, 0 }, float4{ 0, 0, 2, 0 }, float4{ 5, 7, 9, 1 }));
+
+    tcm.destroy(entities[1]);
+    tcm.destroy(entities[0]);
+    em.destroy(entities.size(), entities.data());
+}
+
+TEST(FilamentTest, TransformManagerChangeJournal) {
+    filament::details::FTransformManager tcm;
+    EntityManager& em = EntityManager::get();
+    std::array<Entity, 3> entities;
+    em.create(entities.size(), entities.data());
+
+    Slice<const Entity> changes;
+    filament::details::ChangeJournal::Position position = 0;
+
+    // a new consumer must gather everything
+    EXPECT_FALSE(tcm.getChangeJournal().since(position, changes));
+
+    tcm.create(entities[0]);
+    TransformManager::Instance parent = tcm.getInstance(entities[0]);
+    tcm.create(entities[1], parent, mat4f{});
+    tcm.create(entities[2]);
+    position = tcm.getChangeJournal().end();
+
+    // nothing changed
+    EXPECT_TRUE(tcm.getChangeJournal().since(position, changes));
+    EXPECT_EQ(changes.size(), 0u);
+
+    // changing the parent's transform records the parent and its child
+    tcm.setTransform(parent, mat4f{ float4{ 2 }});
+    EXPECT_TRUE(tcm.getChangeJournal().since(position, changes));
+    ASSERT_EQ(changes.size(), 2u);
+    EXPECT_EQ(changes[0], entities[0]);
+    EXPECT_EQ(changes[1], entities[1]);
+    position = tcm.getChangeJournal().end();
+
+    // trimming doesn't affect consumers that are up-to-date
+    tcm.trimChangeJournal();
+    EXPECT_TRUE(tcm.getChangeJournal().since(position, changes));
+    EXPECT_EQ(changes.size(), 0u);
+
+    // destroying a component forces consumers to gather everything again
+    tcm.destroy(entities[2]);
+    EXPECT_FALSE(tcm.getChangeJournal().since(position, changes));
+
+    tcm.destroy(entities[1]);
+    tcm.destroy(entities[0]);
+    em.destroy(entities.size(), entities.data());
+}
+
 TEST(FilamentTest, UniformInterfaceBlock) {
 
     UniformInterfaceBlock::Builder b;
@@ -328,6 +460,37 @@ TEST(FilamentTest, UniformBuffer) {
     //buffer.log(std::cout, ib);
 }
 
+TEST(FilamentTest, UniformBufferDirtyRange) {
+    UniformBuffer buffer(64);
+
+    // a new buffer needs to be uploaded entirely
+    EXPECT_TRUE(buffer.isDirty());
+    EXPECT_EQ(0, buffer.getDirtyOffset());
+    EXPECT_EQ(64, buffer.getDirtySize());
+
+    buffer.clean();
+    EXPECT_FALSE(buffer.isDirty());
+
+    buffer.setUniform(16, 1.0f);
+    EXPECT_TRUE(buffer.isDirty());
+    EXPECT_EQ(16, buffer.getDirtyOffset());
+    EXPECT_EQ(4, buffer.getDirtySize());
+
+    // the range grows to cover all the modified uniforms
+    buffer.setUniform(32, float4{ 1, 2, 3, 4 });
+    EXPECT_EQ(16, buffer.getDirtyOffset());
+    EXPECT_EQ(32, buffer.getDirtySize());
+
+    buffer.setUniform(4, 2.0f);
+    EXPECT_EQ(4, buffer.getDirtyOffset());
+    EXPECT_EQ(44, buffer.getDirtySize());
+
+    buffer.clean();
+    buffer.invalidate();
+    EXPECT_EQ(0, buffer.getDirtyOffset());
+    EXPECT_EQ(64, buffer.getDirtySize());
+}
+
 TEST(FilamentTest, BoxCulling) {
     Frustum frustum(mat4f::frustum(-1, 1, -1, 1, 1, 100));
 
@@ -371,6 +534,23 @@ TEST(FilamentTest, BoxCulling) {
     EXPECT_TRUE( frustum.intersects( { 0, 200 }) );
 }
 
+TEST(FilamentTest, AffineTransformBox) {
+    // transformBox() is the SoA version of rigidTransform()
+    const mat4f m = mat4f::translate(float4{ 1, -2, 3, 1 }) *
+            mat4f::rotate(0.5f, normalize(float3{ 1, 2, 3 })) * mat4f::scale(float4{ 2, 1, 0.5f, 1 });
+    const Box box = { { 0.5f, 1, -4 }, { 1, 2, 3 } };
+
+    float3 center = box.center;
+    float3 extent = box.halfExtent;
+    AffineTransform(m).transformBox(center, extent);
+
+    const Box expected = rigidTransform(box, m);
+    for (size_t i = 0; i < 3; i++) {
+        EXPECT_FLOAT_EQ(expected.center[i], center[i]);
+        EXPECT_FLOAT_EQ(expected.halfExtent[i], extent[i]);
+    }
+}
+
 TEST(FilamentTest, SphereCulling) {
     Frustum frustum(mat4f::frustum(-1, 1, -1, 1, 1, 100));
 
@@ -408,6 +588,101 @@ TEST(FilamentTest, SphereCulling) {
     EXPECT_TRUE(frustum.intersects({ 0, 200 }));
 }
 
+TEST(FilamentTest, BvhCulling) {
+    Frustum frustum(mat4f::frustum(-1, 1, -1, 1, 1, 100));
+
+    // a row of boxes along x, only the ones near the origin are in the frustum
+    const size_t count = 1000;
+    std::vector<float3> center(count);
+    std::vector<float3> extent(count, float3{ 0.5f });
+    for (size_t i = 0; i < count; i++) {
+        center[i] = { float(i) - 500.0f, 0, -10 };
+    }
+
+    filament::details::Bvh bvh;
+    std::vector<uint32_t> order;
+    bvh.build(center.data(), extent.data(), count, order);
+    EXPECT_EQ(count, bvh.getBoxCount());
+
+    // the boxes must be stored in the hierarchy's order
+    std::vector<float3> sortedCenter(count);
+    for (size_t i = 0; i < count; i++) {
+        sortedCenter[i] = center[order[i]];
+    }
+
+    auto visible = [&](std::vector<bool>& covered) {
+        size_t visibleCount = 0;
+        bvh.traverse(
+                [&frustum](Box const& box) { return frustum.intersects(box); },
+                [&](uint32_t first, uint32_t c) {
+                    EXPECT_EQ(0u, first % filament::details::Culler::MODULO);
+                    for (uint32_t i = first; i < first + c; i++) {
+                        EXPECT_FALSE(covered[i]);
+                        covered[i] = true;
+                        visibleCount += frustum.intersects(Box{ sortedCenter[i], extent[i] });
+                    }
+                },
+                [&](uint32_t first, uint32_t c) {
+                    for (uint32_t i = first; i < first + c; i++) {
+                        EXPECT_FALSE(covered[i]);
+                        EXPECT_FALSE(frustum.intersects(Box{ sortedCenter[i], extent[i] }));
+                        covered[i] = true;
+                    }
+                });
+        return visibleCount;
+    };
+
+    // each box is visited exactly once, and only the visible ones are in accepted leaves
+    std::vector<bool> covered(count, false);
+    size_t visibleCount = visible(covered);
+    EXPECT_EQ(count, size_t(std::count(covered.begin(), covered.end(), true)));
+    EXPECT_GT(visibleCount, 0u);
+
+    // move all the boxes out of the frustum, everything must be rejected after refit
+    for (size_t i = 0; i < count; i++) {
+        sortedCenter[i].z = 10;
+        bvh.invalidate(i);
+    }
+    bvh.refit(sortedCenter.data(), extent.data());
+    covered.assign(count, false);
+    EXPECT_EQ(0u, visible(covered));
+    EXPECT_EQ(count, size_t(std::count(covered.begin(), covered.end(), true)));
+}
+
+TEST(FilamentTest, TemporalCulling) {
+    using filament::details::Culler;
+
+    // a grid of boxes around the camera
+    const size_t count = 32 * 32;
+    std::vector<float3> center(count);
+    std::vector<float3> extent(count, float3{ 0.5f });
+    std::vector<uint32_t> versions(count, 1);
+    for (size_t i = 0; i < count; i++) {
+        center[i] = { float(i % 32) * 4.0f - 64.0f, 0, float(i / 32) * 4.0f - 64.0f };
+    }
+
+    // the camera turns and moves slowly, the results must always be the Culler's
+    filament::details::TemporalCuller culler;
+    std::vector<Culler::result_type> expected(count);
+    std::vector<Culler::result_type> results(count);
+    for (size_t frame = 0; frame < 120; frame++) {
+        const mat4f model = mat4f::translate(float4{ float(frame) * 0.1f, 0, 0, 1 }) *
+                mat4f::rotate(float(frame) * 0.01f, float3{ 0, 1, 0 });
+        const Frustum frustum(mat4f::frustum(-1, 1, -1, 1, 1, 100) * inverse(model));
+        if (frame == 60) {
+            // a box which changed in the scene is tested again
+            center[0] = model[3].xyz - float3{ 0, 0, 10 };
+            versions[0]++;
+        }
+
+        culler.prepare(frustum, model[3].xyz, count);
+        culler.cull(results.data(), center.data(), extent.data(), versions.data(), 0, count, 0);
+        Culler::intersects(expected.data(), frustum, center.data(), extent.data(), count, 0);
+        EXPECT_EQ(expected, results);
+    }
+    EXPECT_TRUE(results[0]);
+}
+
 TEST(FilamentTest, ColorConversion) {
     // Linear to Gamma
     // 0.0 stays 0.0
@@ -558,6 +833,84 @@ TEST(FilamentTest, FroxelData) {
     delete engine;
 }
 
+TEST(FilamentTest, FrameGraph) {
+    using namespace filament::details;
+    using namespace filament::driver;
+
+    LinearAllocatorArena arena("FrameGraph", 65536);
+    filament::details::ArenaScope scope(arena);
+    RenderTargetPool pool;  // unused by compile()
+
+    struct Data {
+        FrameGraphResource in;
+        FrameGraphResource out;
+    };
+    auto noop = [](FrameGraph::Resources const&, Data const&) { };
+
+    FrameGraph fg(scope, pool);
+    FrameGraph::Descriptor desc;
+    desc.width = 640;
+    desc.height = 480;
+
+    FrameGraphResource output = fg.import("Output", desc, {}, TargetBufferFlags::COLOR);
+    fg.present(output);
+
+    auto const& color = fg.addPass<Data>("Color",
+            [&](FrameGraph::Builder& builder, Data& data) {
+                FrameGraph::Descriptor colorDesc = desc;
+                colorDesc.attachments = TargetBufferFlags::COLOR_AND_DEPTH;
+                data.out = builder.write(builder.create("Color Buffer", colorDesc));
+            }, noop);
+
+    // nothing uses what these two write
+    auto const& chain = fg.addPass<Data>("Chain 1",
+            [&](FrameGraph::Builder& builder, Data& data) {
+                data.in = builder.read(color.out);
+                data.out = builder.write(builder.create("Chain Buffer", desc));
+            }, noop);
+    fg.addPass<Data>("Chain 2",
+            [&](FrameGraph::Builder& builder, Data& data) {
+                data.in = builder.read(chain.out);
+                data.out = builder.write(builder.create("Unused", desc));
+            }, noop);
+
+    fg.addPass<Data>("Depth",
+            [&](FrameGraph::Builder& builder, Data& data) {
+                data.in = builder.read(color.out, TargetBufferFlags::DEPTH);
+                builder.sideEffect();
+            }, noop);
+
+    auto const& resolve = fg.addPass<Data>("Resolve",
+            [&](FrameGraph::Builder& builder, Data& data) {
+                data.in = builder.read(color.out);
+                data.out = builder.write(builder.create("Resolved", desc));
+            }, noop);
+    fg.addPass<Data>("Blit",
+            [&](FrameGraph::Builder& builder, Data& data) {
+                data.in = builder.blit(resolve.out);
+                data.out = builder.write(output);
+            }, noop);
+
+    fg.compile();
+
+    EXPECT_FALSE(fg.isCulled("Color"));
+    EXPECT_TRUE(fg.isCulled("Chain 1"));
+    EXPECT_TRUE(fg.isCulled("Chain 2"));
+    EXPECT_FALSE(fg.isCulled("Depth"));
+    EXPECT_FALSE(fg.isCulled("Resolve"));
+    EXPECT_FALSE(fg.isCulled("Blit"));
+
+    // the depth is sampled later, the stencil isn't
+    EXPECT_EQ(TargetBufferFlags::STENCIL, fg.getDiscardEnd("Color", color.out));
+    EXPECT_EQ(TargetBufferFlags::ALL, fg.getDiscardEnd("Blit", resolve.out));
+    EXPECT_EQ(TargetBufferFlags::DEPTH_AND_STENCIL, fg.getDiscardEnd("Blit", output));
+
+    EXPECT_TRUE(fg.getDescriptor(color.out).flags & RenderTargetPool::Target::DEPTH_TEXTURE);
+    EXPECT_FALSE(fg.getDescriptor(color.out).flags & RenderTargetPool::Target::NO_TEXTURE);
+    // only blitted from
+    EXPECT_TRUE(fg.getDescriptor(resolve.out).flags & RenderTargetPool::Target::NO_TEXTURE);
+}
+
 TEST(FilamentTest, RangeSet) {
 
     utils::RangeSet<4> rs;
@@ -27,6 +27,7 @@ import java.util.concurrent.ConcurrentLinkedDeque;
 import java.util.concurrent.Executors;
 import java.util.concurrent.ExecutorService;
 import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
 
 import android.support.annotation.NonNull;
 
@@ -34,7 +35,8 @@ import android.support.annotation.NonNull;
 /**
  * A Swing friendly component which can be used if an AWT based FilamentCanvas object results in
  * issues due to interactions with Swing lightweight pop-ups and tooltips. However keep in mind
- * it carries a much higher cost of operation.
+ * it carries a much higher cost of operation: FilamentCanvas presents the native surface
+ * directly and should be preferred wherever AWT heavyweight components are usable.
  */
 public class FilamentPanel extends JPanel implements FilamentTarget {
 
@@ -42,6 +44,10 @@ public class FilamentPanel extends JPanel implements FilamentTarget {
      * A Slot contains a buffer for Filament to write and an Image for Swing to read.
      * It is ok for the buffer capacity to be > height * width. The image however MUST
      * be exactly of dimension height * width.
+     *
+     * The RGBA bytes read back are 0xAABBGGRR as little endian ints, which is the layout of
+     * TYPE_INT_BGR once the alpha is ignored, so the pixels are copied as they are. Ignoring the
+     * alpha is the same as drawing the premultiplied pixels over black.
      */
     class Slot {
 
@@ -49,11 +55,16 @@ public class FilamentPanel extends JPanel implements FilamentTarget {
         BufferedImage image;
 
         Slot(int width, int height) {
-            buffer = ByteBuffer.allocateDirect(4 * width * height).asIntBuffer();
-            image = new BufferedImage(width, height, BufferedImage.TYPE_INT_ARGB);
+            buffer = allocateBuffer(width, height);
+            image = new BufferedImage(width, height, BufferedImage.TYPE_INT_BGR);
         }
     }
 
+    private static IntBuffer allocateBuffer(int width, int height) {
+        return ByteBuffer.allocateDirect(4 * width * height)
+                .order(ByteOrder.LITTLE_ENDIAN).asIntBuffer();
+    }
+
     /**
      * SlotPool is a circular buffer which provide "Slot"s where ExecutorService thread can write
      * pixels and Swing can read from. Its purpose it to reuse memory and avoid allocation. During
@@ -88,12 +99,12 @@ public class FilamentPanel extends JPanel implements FilamentTarget {
             // The slot can avoid an allocation and reuse the same BufferedImage if dimensions have
             // not changed.
             if (slot.image.getWidth() != width || slot.image.getHeight() != height) {
-                slot.image = new BufferedImage(width, height, BufferedImage.TYPE_INT_ARGB);
+                slot.image = new BufferedImage(width, height, BufferedImage.TYPE_INT_BGR);
             }
 
             // The slot can avoid an allocation and reuse the same IntBuffer if it has the capacity.
             if (slot.buffer.capacity() < width * height) {
-                slot.buffer = ByteBuffer.allocateDirect(4 * width * height).asIntBuffer();
+                slot.buffer = allocateBuffer(width, height);
             } else {
                 // Reuse the buffer, just reset position
                 slot.buffer.rewind();
@@ -111,7 +122,7 @@ public class FilamentPanel extends JPanel implements FilamentTarget {
 
     private NativeSurface mNativeSurface;
     private SwapChain mSwapChain;
-    private BufferedImage mImage = new BufferedImage(1, 1, BufferedImage.TYPE_INT_ARGB);
+    private BufferedImage mImage = new BufferedImage(1, 1, BufferedImage.TYPE_INT_BGR);
     private final Object mImageLock = new Object();
     private int mHeight;
     private int mWidth;
@@ -142,10 +153,10 @@ public class FilamentPanel extends JPanel implements FilamentTarget {
 
     /**
      * This must be called on Filament thread.
-     * Pixels are read from the Gl (located in VRAM) and copied to the JVM (in RAM).
-     * Colors are converted from ABGR to RGBA. A BufferedImage is created (copy RAM to RAM
-     * of all pixels). Finally the image is drawn to screen via Graphics.drawImage (one more trip
-     * from RAM to VRAM).
+     * Pixels are read asynchronously from the GL (located in VRAM) into a direct buffer (in RAM),
+     * the frames that follow don't wait for them. Up to NUM_SLOTS frames are in flight. The
+     * buffer is copied as is into the BufferedImage, which is finally drawn to screen via
+     * Graphics.drawImage (one more trip from RAM to VRAM).
      */
     public void endFrame(@NonNull Renderer renderer) {
         // By the time readPixel callback is invoked, the dimension of the Panel may have changed.
@@ -168,14 +179,10 @@ public class FilamentPanel extends JPanel implements FilamentTarget {
             @Override
             public void run() {
                 synchronized (mImageLock) {
-                    // Copy pixels read from the GL into the BufferedImage. Then convert from RGBA
-                    // to ARGB because that is what the BufferedImage expects.
+                    // Copy pixels read from the GL into the BufferedImage, whose layout they
+                    // already have, see Slot.
                     int[] data = ((DataBufferInt) slot.image.getRaster().getDataBuffer()).getData();
                     slot.buffer.get(data, 0, capturedHeight * capturedWidth);
-                    for (int i = 0; i < capturedHeight * capturedWidth; i++) {
-                        int rgba = data[i];
-                        data[i] = (rgba >>> 8) | (rgba << 24);
-                    }
                     mImage = slot.image;
                     repaint();
                     mSlotPool.putSlot(slot);
@@ -42,13 +42,37 @@ namespace BindingPoints {
     constexpr uint8_t PER_RENDERABLE_BONES    = 2;    // bones data, per renderable
     constexpr uint8_t LIGHTS                  = 3;    // lights data array
     constexpr uint8_t POST_PROCESS            = 4;    // samplers for the post process pass
-    constexpr uint8_t PER_MATERIAL_INSTANCE   = 5;    // uniforms/samplers updates per material
-    constexpr uint8_t COUNT                   = 6;
+    constexpr uint8_t PER_RENDERABLE_MORPHING = 5;    // morph weights and targets, per renderable
+    constexpr uint8_t PER_FRAME               = 6;    // uniforms updated every frame, e.g. time
+    constexpr uint8_t PER_MATERIAL_INSTANCE   = 7;    // uniforms/samplers updates per material
+    constexpr uint8_t COUNT                   = 8;
 }
 
 static_assert(BindingPoints::PER_MATERIAL_INSTANCE == BindingPoints::COUNT - 1,
         "Dynamically sized sampler buffer must be the last binding point.");
 
+// Vulkan binding of the input attachment read by the subpass post-process stages. It follows the
+// uniform buffers and the (at most 16) samplers.
+constexpr uint8_t SUBPASS_INPUT_BINDING = BindingPoints::COUNT + 16;
+
+// Read-only storage buffers, only declared by the shaders of the Vulkan backend. The other
+// backends read the same data from textures.
+namespace StorageBindingPoints {
+    constexpr uint8_t FROXELS                 = 0;    // per-froxel light lists, see Froxelizer
+    constexpr uint8_t RECORDS                 = 1;    // light indices of the froxels
+    constexpr uint8_t COUNT                   = 2;
+}
+
+// Vulkan binding of the first storage buffer, they follow the input attachment.
+constexpr uint8_t STORAGE_BINDING = SUBPASS_INPUT_BINDING + 1;
+
+// SPIR-V specialization constants, all booleans. The Vulkan backend sets them when it creates
+// a pipeline, from Program::getSpecialization().
+namespace SpecializationConstants {
+    constexpr uint32_t DYNAMIC_LIGHTING        = 0;    // see Variant::SPECIALIZED_MASK
+    constexpr uint32_t COUNT                   = 1;
+}
+
 constexpr size_t MAX_ATTRIBUTE_BUFFERS_COUNT = 8;   // FIXME: should match Driver::MAX_ATTRIBUTE_BUFFER_COUNT
 
 // This value is limited by UBO size, ES3.0 only guarantees 16 KiB.
@@ -60,6 +84,25 @@ constexpr size_t CONFIG_MAX_LIGHT_INDEX = CONFIG_MAX_LIGHT_COUNT - 1;
 // 256 is enough, but we could use 512 if needed
 constexpr size_t CONFIG_MAX_BONE_COUNT = 256;
 
+// Maximum number of morph targets of a renderable, a multiple of 4 since the weights are
+// stored in float4s.
+constexpr size_t CONFIG_MAX_MORPH_TARGET_COUNT = 64;
+
+// Maximum number of instances per (automatically) instanced draw call, also limited by UBO size.
+// Each instance uses 112 bytes.
+constexpr size_t CONFIG_MAX_INSTANCES = 64;
+
+// Maximum number of shadow cascades of the directional light.
+constexpr size_t CONFIG_MAX_SHADOW_CASCADES = 4;
+
+// Maximum number of spot lights casting shadows in a view, also limited by the number of bits
+// of the renderables' shadow caster mask (8).
+constexpr size_t CONFIG_MAX_SHADOWED_SPOT_LIGHTS = 8;
+
+// All shadow maps (cascades and spot lights) are tiles of a single depth texture, the atlas,
+// which can't be larger than this.
+constexpr uint32_t CONFIG_MAX_SHADOW_ATLAS_DIMENSION = 4096;
+
 // can't really use std::underlying_type<AttributeIndex>::type because the driver takes a uint32_t
 using AttributeBitset = utils::bitset32;
 
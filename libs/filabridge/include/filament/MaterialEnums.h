@@ -69,9 +69,11 @@ namespace filament {
         TWO_PASSES_ONE_SIDE,    // the transparent object is first drawn in the depth buffer,
                                 // then in the color buffer, honoring the culling mode, but
                                 // ignoring the depth test function
-        TWO_PASSES_TWO_SIDES    // the transparent object is drawn twice in the color buffer,
+        TWO_PASSES_TWO_SIDES,   // the transparent object is drawn twice in the color buffer,
                                 // first with back faces only, then with front faces; the culling
                                 // mode is ignored. Can be combined with two-sided lighting
+        ORDER_INDEPENDENT       // the transparent object is blended in any order when the view
+                                // enables order-independent transparency, DEFAULT otherwise
     };
 
     static constexpr size_t VERTEX_DOMAIN_COUNT = 4;
@@ -83,14 +85,32 @@ namespace filament {
         // when adding more entries, make sure to update VERTEX_DOMAIN_COUNT
     };
 
-    static constexpr size_t POST_PROCESS_STAGES_COUNT = 4;
+    static constexpr size_t POST_PROCESS_STAGES_COUNT = 15;
     enum class PostProcessStage : uint8_t {
         TONE_MAPPING_OPAQUE,           // Tone mapping post-process
         TONE_MAPPING_TRANSLUCENT,      // Tone mapping post-process
         ANTI_ALIASING_OPAQUE,          // Anti-aliasing stage
         ANTI_ALIASING_TRANSLUCENT,     // Anti-aliasing stage
+        DEPTH_DOWNSAMPLE,              // Farthest depth of each tile, for occlusion culling
+        TONE_MAPPING_SUBPASS_OPAQUE,        // Tone mapping in a subpass of the color pass
+        TONE_MAPPING_SUBPASS_TRANSLUCENT,   // Tone mapping in a subpass of the color pass
+        TEMPORAL_UPSCALE,              // Temporal anti-aliasing and upscaling
+        FUSED_OPAQUE,                  // Tone mapping, anti-aliasing and scaling in one pass
+        FUSED_TRANSLUCENT,             // Tone mapping, anti-aliasing and scaling in one pass
+        FUSED_COMPUTE_OPAQUE,          // Tone mapping and anti-aliasing in a compute shader
+        FUSED_COMPUTE_TRANSLUCENT,     // Tone mapping and anti-aliasing in a compute shader
+        OIT_COMPOSITE,                 // Blends the order-independent transparent objects
+        SHADOW_MOMENTS,                // EVSM moments of the shadow atlas, blurred horizontally
+        SHADOW_BLUR,                   // Vertical blur of the EVSM moments
     };
 
+    // The stages made of a single compute shader, instead of a vertex and a fragment shader.
+    // They're only generated for OpenGL (ES 3.1 or GL 4.3).
+    constexpr bool isComputeStage(PostProcessStage stage) noexcept {
+        return stage == PostProcessStage::FUSED_COMPUTE_OPAQUE ||
+               stage == PostProcessStage::FUSED_COMPUTE_TRANSLUCENT;
+    }
+
     static constexpr size_t MATERIAL_VARIABLES_COUNT = 4;
     enum class Variable : uint8_t {
         CUSTOM0,
@@ -76,6 +76,9 @@ struct RenderPassParams {
         uint32_t flags = 0;
     };
     static constexpr uint8_t DEPENDENCY_BY_REGION = 1; // see "framebuffer-local" in Vulkan spec.
+    // The color is drawn by two subpasses, the second one reads the color of the first as an input
+    // attachment. See DriverApi::nextSubpass().
+    static constexpr uint8_t DEPENDENCY_SUBPASS_INPUT = 2;
     // Viewport (16 bytes)
     int32_t left;
     int32_t bottom;
@@ -103,6 +106,16 @@ enum class FenceStatus : int8_t {
 
 static constexpr uint64_t FENCE_WAIT_FOR_EVER = uint64_t(-1);
 
+/**
+ * Where the frames of a Stream come from
+ * @see Stream
+ */
+enum class StreamType : uint8_t {
+    NATIVE,     //!< a native stream, e.g. a SurfaceTexture on Android
+    TEXTURE_ID, //!< an external texture, copied into a private texture
+    ACQUIRED,   //!< images given with Stream::setAcquiredImage(), sampled without copy
+};
+
 static constexpr size_t SHADER_MODEL_COUNT = 3;
 enum class ShaderModel : uint8_t {
     // For testing
@@ -154,6 +167,8 @@ enum class SamplerType : uint8_t {
     SAMPLER_2D,         //!< 2D texture
     SAMPLER_CUBEMAP,    //!< Cube map texture
     SAMPLER_EXTERNAL,   //!< External texture
+    SAMPLER_2D_ARRAY,   //!< Array of 2D textures, the depth is the number of layers
+    SAMPLER_3D,         //!< 3D texture
 };
 
 enum class SamplerFormat : uint8_t {
@@ -193,9 +208,10 @@ enum class ElementType : uint8_t {
     HALF4,
 };
 
+//! How often the content of a buffer is updated
 enum class Usage : uint8_t {
-    STATIC,
-    DYNAMIC
+    STATIC,     //!< the content is set once, or rarely
+    DYNAMIC     //!< the content is updated often, e.g. every frame
 };
 
 enum class CullingMode : uint8_t {
@@ -426,6 +442,16 @@ struct FaceOffsets {
     }
 };
 
+//! A rectangle of a texture level, and where its pixels are in a pixel buffer
+struct TextureRegion {
+    uint32_t xoffset = 0;   //!< left offset of the rectangle in the level, in texels
+    uint32_t yoffset = 0;   //!< bottom offset of the rectangle in the level, in texels
+    uint32_t width = 0;     //!< width of the rectangle, in texels
+    uint32_t height = 0;    //!< height of the rectangle, in texels
+    uint32_t offset = 0;    //!< offset in bytes of the rectangle's first row in the buffer
+    uint32_t stride = 0;    //!< length of the rows in the buffer, in pixels, 0 means width
+};
+
 enum class SamplerWrapMode : uint8_t {
     CLAMP_TO_EDGE,
     REPEAT,
@@ -507,13 +533,18 @@ enum class BlendFunction : uint8_t {
     SRC_ALPHA_SATURATE
 };
 
-static constexpr size_t PIPELINE_STAGE_COUNT= 2;
+static constexpr size_t PIPELINE_STAGE_COUNT= 3;
 enum ShaderType : uint8_t {
     VERTEX = 0,
-    FRAGMENT = 1
+    FRAGMENT = 1,
+    COMPUTE = 2     // only used by post-process stages, see isComputeStage()
 };
 
 static constexpr uint64_t SWAP_CHAIN_CONFIG_TRANSPARENT = 0x1;
+// the frames are presented without waiting for the vsync, the last one replacing the pending
+// one (MAILBOX), or right away, possibly tearing (IMMEDIATE)
+static constexpr uint64_t SWAP_CHAIN_CONFIG_PRESENT_MAILBOX = 0x2;
+static constexpr uint64_t SWAP_CHAIN_CONFIG_PRESENT_IMMEDIATE = 0x4;
 
 } // namespace driver
 } // namespace filament
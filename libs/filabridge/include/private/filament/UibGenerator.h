@@ -24,10 +24,13 @@ namespace filament {
 class UibGenerator {
 public:
     static UniformInterfaceBlock& getPerViewUib() noexcept;
+    static UniformInterfaceBlock& getPerFrameUib() noexcept;
     static UniformInterfaceBlock& getPerRenderableUib() noexcept;
+    static UniformInterfaceBlock& getPerRenderableInstancesUib() noexcept;
     static UniformInterfaceBlock& getLightsUib() noexcept;
     static UniformInterfaceBlock& getPostProcessingUib() noexcept;
     static UniformInterfaceBlock& getPerRenderableBonesUib() noexcept;
+    static UniformInterfaceBlock& getPerRenderableMorphingUib() noexcept;
 };
 
 }
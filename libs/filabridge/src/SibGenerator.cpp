@@ -31,6 +31,7 @@ SamplerInterfaceBlock& SibGenerator::getPerViewSib() noexcept {
             .add("froxels",       Type::SAMPLER_2D,      Format::UINT,  Precision::MEDIUM)
             .add("iblDFG",        Type::SAMPLER_2D,      Format::FLOAT, Precision::MEDIUM)
             .add("iblSpecular",   Type::SAMPLER_CUBEMAP, Format::FLOAT, Precision::MEDIUM)
+            .add("shadowMoments", Type::SAMPLER_2D,      Format::FLOAT, Precision::HIGH)
             .build();
     return sib;
 }
@@ -42,6 +43,20 @@ SamplerInterfaceBlock& SibGenerator::getPostProcessSib() noexcept {
     static SamplerInterfaceBlock sib = SamplerInterfaceBlock::Builder()
             .name("PostProcess")
             .add("colorBuffer", Type::SAMPLER_2D, Format::FLOAT, Precision::MEDIUM, false)
+            .add("depthBuffer", Type::SAMPLER_2D, Format::FLOAT, Precision::HIGH,   false)
+            .add("historyBuffer", Type::SAMPLER_2D, Format::FLOAT, Precision::MEDIUM, false)
+            .add("revealageBuffer", Type::SAMPLER_2D, Format::FLOAT, Precision::MEDIUM, false)
+            .build();
+    return sib;
+}
+
+SamplerInterfaceBlock& SibGenerator::getPerRenderableMorphingSib() noexcept {
+    using Type = SamplerInterfaceBlock::Type;
+    using Format = SamplerInterfaceBlock::Format;
+    using Precision = SamplerInterfaceBlock::Precision;
+    static SamplerInterfaceBlock sib = SamplerInterfaceBlock::Builder()
+            .name("MorphTargets")
+            .add("deltas", Type::SAMPLER_2D, Format::FLOAT, Precision::HIGH, false)
             .build();
     return sib;
 }
@@ -56,6 +71,8 @@ SamplerInterfaceBlock* SibGenerator::getSib(uint8_t bindingPoint) noexcept {
             return nullptr;
         case BindingPoints::POST_PROCESS:
             return &getPostProcessSib();
+        case BindingPoints::PER_RENDERABLE_MORPHING:
+            return &getPerRenderableMorphingSib();
         default:
             return nullptr;
     }
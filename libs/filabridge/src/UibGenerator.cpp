@@ -32,13 +32,12 @@ UniformInterfaceBlock& UibGenerator::getPerViewUib() noexcept  {
             .add("clipFromViewMatrix",      1, UniformInterfaceBlock::Type::MAT4, Precision::HIGH)
             .add("viewFromClipMatrix",      1, UniformInterfaceBlock::Type::MAT4, Precision::HIGH)
             .add("clipFromWorldMatrix",     1, UniformInterfaceBlock::Type::MAT4, Precision::HIGH)
-            .add("lightFromWorldMatrix",    1, UniformInterfaceBlock::Type::MAT4, Precision::HIGH)
+            .add("lightFromWorldMatrix",    CONFIG_MAX_SHADOW_CASCADES, UniformInterfaceBlock::Type::MAT4, Precision::HIGH)
+            .add("spotLightFromWorldMatrix", CONFIG_MAX_SHADOWED_SPOT_LIGHTS, UniformInterfaceBlock::Type::MAT4, Precision::HIGH)
             // view
             .add("resolution",              1, UniformInterfaceBlock::Type::FLOAT4, Precision::HIGH)
             // camera
             .add("cameraPosition",          1, UniformInterfaceBlock::Type::FLOAT3, Precision::HIGH)
-            // time
-            .add("time",                    1, UniformInterfaceBlock::Type::FLOAT, Precision::HIGH)
             // directional light
             .add("lightColorIntensity",     1, UniformInterfaceBlock::Type::FLOAT4)
             .add("sun",                     1, UniformInterfaceBlock::Type::FLOAT4)
@@ -47,6 +46,10 @@ UniformInterfaceBlock& UibGenerator::getPerViewUib() noexcept  {
             // shadow
             .add("shadowBias",              1, UniformInterfaceBlock::Type::FLOAT3)
             .add("oneOverFroxelDimensionY", 1, UniformInterfaceBlock::Type::FLOAT)
+            // shadow cascades
+            .add("cascadeSplits",           1, UniformInterfaceBlock::Type::FLOAT4, Precision::HIGH)
+            .add("cascadeConstantBias",     1, UniformInterfaceBlock::Type::FLOAT4)
+            .add("cascadeNormalBias",       1, UniformInterfaceBlock::Type::FLOAT4)
             // froxels
             .add("zParams",                 1, UniformInterfaceBlock::Type::FLOAT4)
             .add("fParams",                 1, UniformInterfaceBlock::Type::UINT2)
@@ -60,6 +63,15 @@ UniformInterfaceBlock& UibGenerator::getPerViewUib() noexcept  {
             .add("ev100",                   1, UniformInterfaceBlock::Type::FLOAT)
             // ibl
             .add("iblSH",                   9, UniformInterfaceBlock::Type::FLOAT3)
+            // spot light shadows
+            .add("spotShadowBias",          CONFIG_MAX_SHADOWED_SPOT_LIGHTS, UniformInterfaceBlock::Type::FLOAT4)
+            // froxels
+            .add("lightBinning",            1, UniformInterfaceBlock::Type::UINT)
+            // ibl
+            .add("iblRGBM",                 1, UniformInterfaceBlock::Type::FLOAT)
+            .add("iblRotation",             1, UniformInterfaceBlock::Type::MAT3, Precision::HIGH)
+            // shadows
+            .add("shadowMoments",           1, UniformInterfaceBlock::Type::FLOAT)
             .build();
     return uib;
 }
@@ -67,16 +79,38 @@ UniformInterfaceBlock& UibGenerator::getPerViewUib() noexcept  {
 UniformInterfaceBlock& UibGenerator::getPerRenderableUib() noexcept {
     static UniformInterfaceBlock uib =  UniformInterfaceBlock::Builder()
             .name("ObjectUniforms")
-            .add("worldFromModelMatrix",       1, UniformInterfaceBlock::Type::MAT4, Precision::HIGH)
+            // rows of an affine transform, see getWorldFromModelMatrix()
+            .add("worldFromModelMatrix",       3, UniformInterfaceBlock::Type::FLOAT4, Precision::HIGH)
             .add("worldFromModelNormalMatrix", 1, UniformInterfaceBlock::Type::MAT3, Precision::HIGH)
             .build();
     return uib;
 }
 
+UniformInterfaceBlock& UibGenerator::getPerRenderableInstancesUib() noexcept {
+    // used instead of getPerRenderableUib() by the instancing variant
+    static UniformInterfaceBlock uib =  UniformInterfaceBlock::Builder()
+            .name("InstancesUniforms")
+            .add("worldFromModelMatrix",       CONFIG_MAX_INSTANCES * 3, UniformInterfaceBlock::Type::FLOAT4, Precision::HIGH)
+            .add("worldFromModelNormalMatrix", CONFIG_MAX_INSTANCES, UniformInterfaceBlock::Type::MAT3, Precision::HIGH)
+            .build();
+    return uib;
+}
+
+UniformInterfaceBlock& UibGenerator::getPerFrameUib() noexcept  {
+    // the uniforms which change every frame, so that they don't dirty the per-view buffer
+    // IMPORTANT NOTE: Respect std140 layout, don't update without updating Engine::PerFrameUib
+    static UniformInterfaceBlock uib = UniformInterfaceBlock::Builder()
+            .name("TimeUniforms")
+            .add("time",                    1, UniformInterfaceBlock::Type::FLOAT, Precision::HIGH)
+            .build();
+    return uib;
+}
+
 UniformInterfaceBlock& UibGenerator::getLightsUib() noexcept {
     static UniformInterfaceBlock uib = UniformInterfaceBlock::Builder()
             .name("LightsUniforms")
-            .add("lights", CONFIG_MAX_LIGHT_COUNT, UniformInterfaceBlock::Type::MAT4, Precision::HIGH)
+            // 3 per light, see GpuLightBuffer::LightParameters
+            .add("lights", CONFIG_MAX_LIGHT_COUNT * 3, UniformInterfaceBlock::Type::UINT4, Precision::HIGH)
             .build();
     return uib;
 }
@@ -87,6 +121,10 @@ UniformInterfaceBlock& UibGenerator::getPostProcessingUib() noexcept {
             .add("uvScale", 1, UniformInterfaceBlock::Type::FLOAT2)
             .add("time",    1, UniformInterfaceBlock::Type::FLOAT)
             .add("yOffset", 1, UniformInterfaceBlock::Type::FLOAT)
+            .add("reprojection", 1, UniformInterfaceBlock::Type::MAT4, Precision::HIGH)
+            .add("historyUv",    1, UniformInterfaceBlock::Type::FLOAT4, Precision::HIGH)
+            .add("temporal",     1, UniformInterfaceBlock::Type::FLOAT4, Precision::HIGH)
+            .add("shadowTile",   1, UniformInterfaceBlock::Type::FLOAT4, Precision::HIGH)
             .build();
     return uib;
 }
@@ -99,4 +137,14 @@ UniformInterfaceBlock& UibGenerator::getPerRenderableBonesUib() noexcept {
     return uib;
 }
 
+UniformInterfaceBlock& UibGenerator::getPerRenderableMorphingUib() noexcept {
+    // IMPORTANT NOTE: Respect std140 layout, don't update without updating FMorphTargetBuffer
+    static UniformInterfaceBlock uib = UniformInterfaceBlock::Builder()
+            .name("MorphingUniforms")
+            .add("weights", CONFIG_MAX_MORPH_TARGET_COUNT / 4, UniformInterfaceBlock::Type::FLOAT4, Precision::MEDIUM)
+            .add("count",   1, UniformInterfaceBlock::Type::UINT)
+            .build();
+    return uib;
+}
+
 } // namespace filament
@@ -84,9 +84,18 @@ enum UTILS_PUBLIC ChunkType : uint64_t {
     PostProcessVersion = charTo64bitNum("POSP_VER"),
 
     DictionaryGlsl = charTo64bitNum("DIC_GLSL"),
+    DictionaryGlslCompressed = charTo64bitNum("DIC_GLSZ"),
     DictionarySpirv = charTo64bitNum("DIC_SPIR"),
 };
 
+// Compression of the shaders in the dictionary chunks.
+// DictionaryGlslCompressed is a DictionaryGlsl chunk compressed as a whole, DictionarySpirv
+// compresses each blob (i.e. each unique shader) separately so they can be decoded on demand.
+enum UTILS_PUBLIC CompressionScheme : uint32_t {
+    COMPRESSION_NONE = 0,
+    COMPRESSION_ZLIB = 1,
+};
+
 } // namespace filamat
 
 // Custom specialization of std::hash can be injected in namespace std.
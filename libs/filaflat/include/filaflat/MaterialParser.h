@@ -42,7 +42,10 @@ struct MaterialParserDetails;
 
 class UTILS_PUBLIC MaterialParser {
 public:
-    MaterialParser(filament::driver::Backend backend, const void* data, size_t size);
+    // The package is copied, unless copy is false in which case the parser references it directly
+    // (e.g. a memory-mapped file) and it must stay valid until the parser is destroyed.
+    MaterialParser(filament::driver::Backend backend, const void* data, size_t size,
+            bool copy = true);
     ~MaterialParser();
 
     MaterialParser(MaterialParser const& rhs) noexcept = delete;
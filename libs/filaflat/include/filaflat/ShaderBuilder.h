@@ -17,10 +17,14 @@
 #ifndef TNT_FILAFLAT_SHADERBUILDER_H
 #define TNT_FILAFLAT_SHADERBUILDER_H
 
+#include <utils/CString.h>
+
 #include <cstddef>
 
 namespace filaflat {
 
+// Assembles a shader directly into the string that is handed over to the driver's Program, so
+// its content is copied only once out of the material package.
 class ShaderBuilder {
 public:
     ShaderBuilder();
@@ -36,15 +40,17 @@ public:
     bool appendPart(const char* data, size_t size);
 
     const char* getShader() const {
-        return mShader;
+        return mShader.c_str();
     }
 
     size_t size() const { return mCursor; }
 
+    // Hands over the shader, the builder must be reset before it's used again.
+    utils::CString release() noexcept;
+
 private:
-    size_t mCapacity;
     size_t mCursor;
-    char* mShader;
+    utils::CString mShader;
 };
 
 } // namespace filaflat
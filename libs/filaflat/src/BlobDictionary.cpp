@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BlobDictionary.h"
+
+#include <zlib.h>
+
+namespace filaflat {
+
+const char* BlobDictionary::decode(const char* data, size_t size, size_t decodedSize) noexcept {
+    std::unique_ptr<char[]> decoded(new char[decodedSize]);
+    uLongf length = decodedSize;
+    int result = uncompress(reinterpret_cast<Bytef*>(decoded.get()), &length,
+            reinterpret_cast<const Bytef*>(data), size);
+    if (result != Z_OK || length != decodedSize) {
+        return nullptr;
+    }
+    mDecoded.push_back(std::move(decoded));
+    return mDecoded.back().get();
+}
+
+} // namespace filaflat
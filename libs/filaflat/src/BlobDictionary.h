@@ -17,20 +17,29 @@
 #ifndef TNT_FILAFLAT_BLOBDICTIONARY_H
 #define TNT_FILAFLAT_BLOBDICTIONARY_H
 
+#include <utils/compiler.h>
+
+#include <memory>
 #include <vector>
 
 #include <stddef.h>
+#include <stdint.h>
 
 namespace filaflat {
 
 // Flat list of blobs that can be referenced by index.
+// Blobs can be compressed, they are then decoded the first time they're accessed.
 class BlobDictionary {
 public:
     BlobDictionary() = default;
     ~BlobDictionary() = default;
 
     inline void addBlob(const char* blob, size_t len) noexcept {
-        mBlobs.push_back({ blob, len });
+        mBlobs.push_back({ blob, len, 0 });
+    }
+
+    inline void addCompressedBlob(const char* blob, size_t len, uint32_t decodedSize) noexcept {
+        mBlobs.push_back({ blob, len, decodedSize });
     }
 
     inline bool isEmpty() const noexcept {
@@ -41,23 +50,34 @@ public:
         mBlobs.reserve(size);
     }
 
-    inline const char* getBlob(size_t index, size_t* size) const noexcept {
-        *size = mBlobs[index].size;
-        return mBlobs[index].data;
+    // Returns nullptr if the blob can't be decoded.
+    inline const char* getBlob(size_t index, size_t* size) noexcept {
+        Blob& blob = mBlobs[index];
+        if (UTILS_UNLIKELY(blob.decodedSize)) {
+            blob.data = decode(blob.data, blob.size, blob.decodedSize);
+            blob.size = blob.data ? blob.decodedSize : 0;
+            blob.decodedSize = 0;
+        }
+        *size = blob.size;
+        return blob.data;
     }
 
-    inline const char* getString(size_t index) const noexcept {
+    inline const char* getString(size_t index) noexcept {
         size_t size;
         return getBlob(index, &size);
     }
 
+    // Decompresses data into a buffer owned by the dictionary, returns nullptr on failure.
+    const char* decode(const char* data, size_t size, size_t decodedSize) noexcept;
 
 private:
     struct Blob {
         const char* data;
         size_t size;
+        uint32_t decodedSize;   // 0 if the blob isn't compressed
     };
     std::vector<Blob> mBlobs;
+    std::vector<std::unique_ptr<char[]>> mDecoded;
 };
 
 } // namespace filaflat
@@ -152,7 +152,11 @@ bool MaterialChunk::getSpirvShader(Unflattener unflattener, BlobDictionary& dict
 
     size_t index = pos->second;
     size_t shaderSize;
+    // compressed shaders are decoded here, the first time they're needed
     const char* shaderContent = dictionary.getBlob(index, &shaderSize);
+    if (!shaderContent) {
+        return false;
+    }
     builder.reset();
     builder.announce(shaderSize);
     builder.appendPart(shaderContent, shaderSize);
@@ -42,14 +42,21 @@ using namespace filamat;
 
 namespace filaflat {
 
-// Make a copy of content and own the allocated memory.
+// Make a copy of content and own the allocated memory, or reference it when it outlives us.
 class ManagedBuffer  {
     void* mStart = nullptr;
     size_t mSize = 0;
+    bool mOwned = true;
 public:
-    explicit ManagedBuffer(const void* start, size_t size)
-            : mStart(malloc(size)), mSize(size) {
-        memcpy(mStart, start, size);
+    explicit ManagedBuffer(const void* start, size_t size, bool copy)
+            : mSize(size), mOwned(copy) {
+        if (copy) {
+            mStart = malloc(size);
+            memcpy(mStart, start, size);
+        } else {
+            // the package is only ever read
+            mStart = const_cast<void*>(start);
+        }
     }
 
     void* begin() const noexcept { return mStart; }
@@ -57,13 +64,16 @@ public:
     size_t size() const noexcept { return mSize; }
 
     ~ManagedBuffer() noexcept {
-        free(mStart);
+        if (mOwned) {
+            free(mStart);
+        }
     }
 };
 
 struct MaterialParserDetails {
-    MaterialParserDetails(filament::driver::Backend backend, const void* data, size_t size)
-            : mUnflattenable(data, size),
+    MaterialParserDetails(filament::driver::Backend backend, const void* data, size_t size,
+            bool copy)
+            : mUnflattenable(data, size, copy),
               mChunkContainer(mUnflattenable.begin(), mUnflattenable.size()),
               mBackend(backend) {
     }
@@ -96,8 +106,9 @@ bool MaterialParserDetails::getFromSimpleChunk(filamat::ChunkType type, T* value
     return unflattener.read(value);
 }
 
-MaterialParser::MaterialParser(filament::driver::Backend backend, const void* data, size_t size)
-        : mImpl(new MaterialParserDetails(backend, data, size)) {
+MaterialParser::MaterialParser(filament::driver::Backend backend, const void* data, size_t size,
+        bool copy)
+        : mImpl(new MaterialParserDetails(backend, data, size, copy)) {
 }
 
 MaterialParser::~MaterialParser() {
@@ -131,7 +142,8 @@ bool MaterialParser::isPostProcessMaterial() const noexcept {
     ChunkContainer const& cc = getChunkContainer();
     return cc.hasChunk(PostProcessVersion) &&
            ((cc.hasChunk(MaterialSpirv) && cc.hasChunk(DictionarySpirv)) ||
-            (cc.hasChunk(MaterialGlsl) && cc.hasChunk(DictionaryGlsl)));
+            (cc.hasChunk(MaterialGlsl) &&
+                    (cc.hasChunk(DictionaryGlsl) || cc.hasChunk(DictionaryGlslCompressed))));
 }
 
 // Accessors
@@ -301,11 +313,12 @@ bool MaterialParserDetails::getGlShader(filament::driver::ShaderModel shaderMode
 
     ChunkContainer const& container = mChunkContainer;
     if (!container.hasChunk(ChunkType::MaterialGlsl) ||
-        !container.hasChunk(ChunkType::DictionaryGlsl)) {
+        !(container.hasChunk(ChunkType::DictionaryGlsl) ||
+          container.hasChunk(ChunkType::DictionaryGlslCompressed))) {
         return false;
     }
 
-    // Read the dictionary only if it has not been read yet.
+    // Read (and decompress) the dictionary only if it has not been read yet.
     if (UTILS_UNLIKELY(mBlobDictionary.isEmpty())) {
         if (!TextDictionaryReader::unflatten(container, mBlobDictionary)) {
             return false;
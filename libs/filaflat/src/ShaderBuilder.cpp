@@ -19,40 +19,51 @@
 #include <assert.h>
 #include <cstdlib>
 #include <cstring>
+#include <utility>
 
+#include <utils/compiler.h>
 #include <utils/Log.h>
 
 namespace filaflat {
 
-ShaderBuilder::ShaderBuilder() : mCursor(0), mCapacity(16384) {
-    mShader = static_cast<char*>(malloc(mCapacity));
+ShaderBuilder::ShaderBuilder() : mCursor(0) {
 }
 
-ShaderBuilder::~ShaderBuilder() {
-    free(mShader);
-}
+ShaderBuilder::~ShaderBuilder() = default;
 
 void ShaderBuilder::reset() {
     mCursor = 0;
-    mShader[mCursor] = '\0';
+    mShader = utils::CString();
 }
 
 void ShaderBuilder::announce(size_t size) {
-    if (size > mCapacity) {
-        mShader = (char*)realloc(mShader, size);
-        mCapacity = size;
-    }
+    // the string is allocated at the exact size of the shader, so it can be handed over as is
+    mCursor = 0;
+    mShader = utils::CString(utils::CString::size_type(size));
 }
 
 bool ShaderBuilder::appendPart(const char *data, size_t size) {
-    size_t available = mCapacity - mCursor;
+    size_t available = mShader.size() - mCursor;
     if (size > available) {
         assert(!"Not enough capacity in ShaderBuilder.");
         return false;
     }
-    memcpy(mShader + mCursor, data, size);
+    memcpy(mShader.data() + mCursor, data, size);
     mCursor += size;
     return true;
 }
 
+utils::CString ShaderBuilder::release() noexcept {
+    utils::CString shader;
+    if (UTILS_LIKELY(mCursor == mShader.size())) {
+        shader = std::move(mShader);
+    } else {
+        // less than announced was appended
+        mShader.data()[mCursor] = '\0';
+        shader = utils::CString(mShader.c_str(), utils::CString::size_type(mCursor));
+    }
+    reset();
+    return shader;
+}
+
 }
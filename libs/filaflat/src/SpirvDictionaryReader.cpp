@@ -16,8 +16,6 @@
 
 #include "SpirvDictionaryReader.h"
 
-#include <assert.h>
-
 namespace filaflat {
 
 bool SpirvDictionaryReader::unflatten(Unflattener& f, BlobDictionary& dictionary) {
@@ -26,8 +24,10 @@ bool SpirvDictionaryReader::unflatten(Unflattener& f, BlobDictionary& dictionary
         return false;
     }
 
-    // TODO: support compression
-    assert(compressionScheme == 0);
+    if (compressionScheme != filamat::COMPRESSION_NONE &&
+            compressionScheme != filamat::COMPRESSION_ZLIB) {
+        return false;
+    }
 
     uint32_t numBlobs;
     if (!f.read(&numBlobs)) {
@@ -36,12 +36,21 @@ bool SpirvDictionaryReader::unflatten(Unflattener& f, BlobDictionary& dictionary
 
     dictionary.reserve(numBlobs);
     for (uint32_t i = 0; i < numBlobs; i++) {
+        // compressed blobs are preceded by their decoded size, they're decoded on first use
+        uint32_t decodedSize = 0;
+        if (compressionScheme == filamat::COMPRESSION_ZLIB && !f.read(&decodedSize)) {
+            return false;
+        }
         const char* blob;
         size_t size;
         if (!f.read(&blob, &size)) {
             return false;
         }
-        dictionary.addBlob(blob, size);
+        if (decodedSize) {
+            dictionary.addCompressedBlob(blob, size, decodedSize);
+        } else {
+            dictionary.addBlob(blob, size);
+        }
     }
     return true;
 }
@@ -37,4 +37,34 @@ bool TextDictionaryReader::unflatten(Unflattener& f, BlobDictionary& dictionary)
     return true;
 }
 
+bool TextDictionaryReader::unflatten(ChunkContainer const& container,
+        BlobDictionary& blobDictionary) {
+    TextDictionaryReader dictionary;
+    if (container.hasChunk(filamat::ChunkType::DictionaryGlsl)) {
+        Unflattener dictionaryUnflattener(container, filamat::ChunkType::DictionaryGlsl);
+        return dictionary.unflatten(dictionaryUnflattener, blobDictionary);
+    }
+
+    if (!container.hasChunk(filamat::ChunkType::DictionaryGlslCompressed)) {
+        return false;
+    }
+
+    // the lines reference the decoded chunk, so it must live as long as the dictionary
+    Unflattener compressed(container, filamat::ChunkType::DictionaryGlslCompressed);
+    uint32_t decodedSize = 0;
+    const char* data;
+    size_t size;
+    if (!compressed.read(&decodedSize) || !compressed.read(&data, &size)) {
+        return false;
+    }
+    const char* decoded = blobDictionary.decode(data, size, decodedSize);
+    if (!decoded) {
+        return false;
+    }
+    Unflattener dictionaryUnflattener(
+            reinterpret_cast<const uint8_t*>(decoded),
+            reinterpret_cast<const uint8_t*>(decoded) + decodedSize);
+    return dictionary.unflatten(dictionaryUnflattener, blobDictionary);
+}
+
 }
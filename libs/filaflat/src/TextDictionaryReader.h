@@ -31,11 +31,9 @@ namespace filaflat {
 struct TextDictionaryReader {
     bool unflatten(Unflattener& unflattener, BlobDictionary& dictionary);
 
-    static bool unflatten(ChunkContainer const& container, BlobDictionary& blobDictionary) {
-        Unflattener dictionaryUnflattener(container, filamat::ChunkType::DictionaryGlsl);
-        TextDictionaryReader dictionary;
-        return dictionary.unflatten(dictionaryUnflattener, blobDictionary);
-    }
+    // Reads the DictionaryGlsl chunk, or decodes the DictionaryGlslCompressed chunk into storage
+    // owned by blobDictionary.
+    static bool unflatten(ChunkContainer const& container, BlobDictionary& blobDictionary);
 };
 
 } // namespace filaflat
@@ -58,17 +58,17 @@ public:
 
   private:
       void renderDrawData(ImDrawData* imguiData);
-      void createBuffers(int numRequiredBuffers);
-      void populateVertexData(size_t bufferIndex, size_t vbSizeInBytes, void* vbData,
-                  size_t ibSizeInBytes, void* ibData);
-      void createVertexBuffer(size_t bufferIndex, size_t capacity);
-      void createIndexBuffer(size_t bufferIndex, size_t capacity);
+      void createBuffers(size_t vertexCount, size_t indexCount);
+      void populateVertexData(ImDrawData* imguiData, size_t vertexCount, size_t indexCount);
+      void createVertexBuffer(size_t capacity);
+      void createIndexBuffer(size_t capacity);
       void syncThreads();
       filament::Engine* mEngine;
       filament::View* mView;
       filament::Material const* mMaterial = nullptr;
-      std::vector<filament::VertexBuffer*> mVertexBuffers;
-      std::vector<filament::IndexBuffer*> mIndexBuffers;
+      // all the draw lists of a frame share one vertex buffer and one index buffer
+      filament::VertexBuffer* mVertexBuffer = nullptr;
+      filament::IndexBuffer* mIndexBuffer = nullptr;
       std::vector<filament::MaterialInstance*> mMaterialInstances;
       utils::Entity mRenderable;
       filament::Texture* mTexture = nullptr;
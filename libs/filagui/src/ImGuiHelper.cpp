@@ -16,6 +16,7 @@
 
 #include <filagui/ImGuiHelper.h>
 
+#include <algorithm>
 #include <vector>
 #include <unordered_map>
 
@@ -94,12 +95,8 @@ ImGuiHelper::~ImGuiHelper() {
     }
     mEngine->destroy(mMaterial);
     mEngine->destroy(mTexture);
-    for (auto& vb : mVertexBuffers) {
-        mEngine->destroy(vb);
-    }
-    for (auto& ib : mIndexBuffers) {
-        mEngine->destroy(ib);
-    }
+    mEngine->destroy(mVertexBuffer);
+    mEngine->destroy(mIndexBuffer);
     ImGui::DestroyContext();
 }
 
@@ -151,16 +148,18 @@ void ImGuiHelper::renderDrawData(ImDrawData* imguiData) {
         return;
     imguiData->ScaleClipRects(io.DisplayFramebufferScale);
 
-    // Ensure that we have enough vertex buffers and index buffers.
-    createBuffers(imguiData->CmdListsCount);
-
     // Count how many primitives we'll need, then create a Renderable builder.
-    // Also count how many unique scissor rectangles are required.
+    // Also count how many unique scissor rectangles are required, and how many vertices and
+    // indices all the draw lists have.
     size_t nPrims = 0;
+    size_t nVertices = 0;
+    size_t nIndices = 0;
     std::unordered_map<uint64_t, filament::MaterialInstance*> scissorRects;
     for (int cmdListIndex = 0; cmdListIndex < imguiData->CmdListsCount; cmdListIndex++) {
         const ImDrawList* cmds = imguiData->CmdLists[cmdListIndex];
         nPrims += cmds->CmdBuffer.size();
+        nVertices += cmds->VtxBuffer.Size;
+        nIndices += cmds->IdxBuffer.Size;
         for (const auto& pcmd : cmds->CmdBuffer) {
             scissorRects[makeScissorKey(fbheight, pcmd.ClipRect)] = nullptr;
         }
@@ -188,20 +187,18 @@ void ImGuiHelper::renderDrawData(ImDrawData* imguiData) {
         pair.second->setScissor(left, bottom, width, height);
     }
 
+    // Upload all the draw lists at once, growing the buffers if they aren't large enough.
+    createBuffers(nVertices, nIndices);
+    populateVertexData(imguiData, nVertices, nIndices);
+
     // Recreate the Renderable component and point it to the vertex buffers.
     rcm.destroy(mRenderable);
-    int bufferIndex = 0;
     int primIndex = 0;
+    size_t indexOffset = 0;
     for (int cmdListIndex = 0; cmdListIndex < imguiData->CmdListsCount; cmdListIndex++) {
         const ImDrawList* cmds = imguiData->CmdLists[cmdListIndex];
-        size_t indexOffset = 0;
-        populateVertexData(bufferIndex,
-                cmds->VtxBuffer.Size * sizeof(ImDrawVert), cmds->VtxBuffer.Data,
-                cmds->IdxBuffer.Size * sizeof(ImDrawIdx), cmds->IdxBuffer.Data);
         for (const auto& pcmd : cmds->CmdBuffer) {
-            const size_t capacity = mIndexBuffers[bufferIndex]->getIndexCount();
-            const size_t required = indexOffset + pcmd.ElemCount;
-            assert(required <= capacity);
+            assert(indexOffset + pcmd.ElemCount <= nIndices);
             if (pcmd.UserCallback) {
                 pcmd.UserCallback(cmds, &pcmd);
             } else {
@@ -210,25 +207,23 @@ void ImGuiHelper::renderDrawData(ImDrawData* imguiData) {
                 assert(miter != scissorRects.end());
                 rbuilder
                         .geometry(primIndex, RenderableManager::PrimitiveType::TRIANGLES,
-                                mVertexBuffers[bufferIndex], mIndexBuffers[bufferIndex],
-                                indexOffset, pcmd.ElemCount)
+                                mVertexBuffer, mIndexBuffer, indexOffset, pcmd.ElemCount)
                         .blendOrder(primIndex, primIndex)
                         .material(primIndex, miter->second);
                 primIndex++;
             }
             indexOffset += pcmd.ElemCount;
         }
-        bufferIndex++;
     }
     if (imguiData->CmdListsCount > 0) {
         rbuilder.build(*mEngine, mRenderable);
     }
 }
 
-void ImGuiHelper::createVertexBuffer(size_t bufferIndex, size_t capacity) {
+void ImGuiHelper::createVertexBuffer(size_t capacity) {
     syncThreads();
-    mEngine->destroy(mVertexBuffers[bufferIndex]);
-    mVertexBuffers[bufferIndex] = VertexBuffer::Builder()
+    mEngine->destroy(mVertexBuffer);
+    mVertexBuffer = VertexBuffer::Builder()
             .vertexCount(capacity)
             .bufferCount(1)
             .attribute(VertexAttribute::POSITION, 0, VertexBuffer::AttributeType::FLOAT2, 0,
@@ -238,65 +233,64 @@ void ImGuiHelper::createVertexBuffer(size_t bufferIndex, size_t capacity) {
             .attribute(VertexAttribute::COLOR, 0, VertexBuffer::AttributeType::UBYTE4,
                     2 * sizeof(math::float2), sizeof(ImDrawVert))
             .normalized(VertexAttribute::COLOR)
+            .usage(VertexBuffer::Usage::DYNAMIC)
             .build(*mEngine);
 }
 
-void ImGuiHelper::createIndexBuffer(size_t bufferIndex, size_t capacity) {
+void ImGuiHelper::createIndexBuffer(size_t capacity) {
     syncThreads();
-    mEngine->destroy(mIndexBuffers[bufferIndex]);
-    mIndexBuffers[bufferIndex] = IndexBuffer::Builder()
+    mEngine->destroy(mIndexBuffer);
+    mIndexBuffer = IndexBuffer::Builder()
             .indexCount(capacity)
-            .bufferType(IndexBuffer::IndexType::USHORT)
+            .bufferType(IndexBuffer::IndexType::UINT)
+            .usage(IndexBuffer::Usage::DYNAMIC)
             .build(*mEngine);
 }
 
-void ImGuiHelper::createBuffers(int numRequiredBuffers) {
-    if (numRequiredBuffers > mVertexBuffers.size()) {
-        size_t previousSize = mVertexBuffers.size();
-        mVertexBuffers.resize(numRequiredBuffers, nullptr);
-        for (size_t i = previousSize; i < mVertexBuffers.size(); i++) {
-            // Pick a reasonable starting capacity; it will grow if needed.
-            createVertexBuffer(i, 1000);
-        }
+void ImGuiHelper::createBuffers(size_t vertexCount, size_t indexCount) {
+    // The buffers at least double when they grow, so that they're rarely recreated. Pick a
+    // reasonable starting capacity.
+    const size_t vertexCapacity = mVertexBuffer ? mVertexBuffer->getVertexCount() : 0;
+    if (vertexCount > vertexCapacity) {
+        createVertexBuffer(std::max({ vertexCount, 2 * vertexCapacity, size_t(1000) }));
     }
-    if (numRequiredBuffers > mIndexBuffers.size()) {
-        size_t previousSize = mIndexBuffers.size();
-        mIndexBuffers.resize(numRequiredBuffers, nullptr);
-        for (size_t i = previousSize; i < mIndexBuffers.size(); i++) {
-            // Pick a reasonable starting capacity; it will grow if needed.
-            createIndexBuffer(i, 5000);
-        }
+    const size_t indexCapacity = mIndexBuffer ? mIndexBuffer->getIndexCount() : 0;
+    if (indexCount > indexCapacity) {
+        createIndexBuffer(std::max({ indexCount, 2 * indexCapacity, size_t(5000) }));
     }
 }
 
-void ImGuiHelper::populateVertexData(size_t bufferIndex, size_t vbSizeInBytes, void* vbImguiData,
-        size_t ibSizeInBytes, void* ibImguiData)
-{
-    // Create a new vertex buffer if the size isn't large enough, then copy the ImGui data into
-    // a staging area since Filament's render thread might consume the data at any time.
-    size_t requiredVertCount = vbSizeInBytes / sizeof(ImDrawVert);
-    size_t capacityVertCount = mVertexBuffers[bufferIndex]->getVertexCount();
-    if (requiredVertCount > capacityVertCount) {
-        createVertexBuffer(bufferIndex, requiredVertCount);
+void ImGuiHelper::populateVertexData(ImDrawData* imguiData, size_t vertexCount,
+        size_t indexCount) {
+    if (vertexCount == 0 || indexCount == 0) {
+        return;
     }
-    size_t nVbBytes = requiredVertCount * sizeof(ImDrawVert);
-    void* vbFilamentData = malloc(nVbBytes);
-    memcpy(vbFilamentData, vbImguiData, nVbBytes);
-    mVertexBuffers[bufferIndex]->setBufferAt(*mEngine, 0,
-            VertexBuffer::BufferDescriptor(vbFilamentData, nVbBytes,
-            (VertexBuffer::BufferDescriptor::Callback) free));
 
-    // Create a new index buffer if the size isn't large enough, then copy the ImGui data into
-    // a staging area since Filament's render thread might consume the data at any time.
-    size_t requiredIndexCount = ibSizeInBytes / 2;
-    size_t capacityIndexCount = mIndexBuffers[bufferIndex]->getIndexCount();
-    if (requiredIndexCount > capacityIndexCount) {
-        createIndexBuffer(bufferIndex, requiredIndexCount);
+    // Copy the ImGui data of all the draw lists into a staging area since Filament's render
+    // thread might consume the data at any time. The indices of each draw list are relative to
+    // its first vertex, they're rebased on the vertices of the whole frame, which don't fit in
+    // 16 bits.
+    size_t nVbBytes = vertexCount * sizeof(ImDrawVert);
+    size_t nIbBytes = indexCount * sizeof(uint32_t);
+    ImDrawVert* vbFilamentData = (ImDrawVert*) malloc(nVbBytes);
+    uint32_t* ibFilamentData = (uint32_t*) malloc(nIbBytes);
+    ImDrawVert* vertices = vbFilamentData;
+    uint32_t* indices = ibFilamentData;
+    uint32_t vertexOffset = 0;
+    for (int cmdListIndex = 0; cmdListIndex < imguiData->CmdListsCount; cmdListIndex++) {
+        const ImDrawList* cmds = imguiData->CmdLists[cmdListIndex];
+        memcpy(vertices, cmds->VtxBuffer.Data, cmds->VtxBuffer.Size * sizeof(ImDrawVert));
+        vertices += cmds->VtxBuffer.Size;
+        for (const ImDrawIdx index : cmds->IdxBuffer) {
+            *indices++ = vertexOffset + index;
+        }
+        vertexOffset += cmds->VtxBuffer.Size;
     }
-    size_t nIbBytes = requiredIndexCount * 2;
-    void* ibFilamentData = malloc(nIbBytes);
-    memcpy(ibFilamentData, ibImguiData, nIbBytes);
-    mIndexBuffers[bufferIndex]->setBuffer(*mEngine,
+
+    mVertexBuffer->setBufferAt(*mEngine, 0,
+            VertexBuffer::BufferDescriptor(vbFilamentData, nVbBytes,
+            (VertexBuffer::BufferDescriptor::Callback) free));
+    mIndexBuffer->setBuffer(*mEngine,
             IndexBuffer::BufferDescriptor(ibFilamentData, nIbBytes,
             (IndexBuffer::BufferDescriptor::Callback) free));
 }
@@ -21,6 +21,7 @@
 #include <cstdint>
 
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <filament/driver/DriverEnums.h>
@@ -79,6 +80,9 @@ protected:
     };
     std::vector<CodeGenParams> mCodeGenPermutations;
     uint8_t mVariantFilter = 0;
+    bool mCompressShaders = false;
+    bool mOptimizeShaders = false;
+    uint32_t mUsedVariants = 0xFFFFFFFF;
 };
 
 class UTILS_PUBLIC MaterialBuilder : public MaterialBuilderBase {
@@ -100,7 +104,8 @@ public:
     using CullingMode = filament::driver::CullingMode;
 
     // Each shader generated while building the package content can be post-processed via this
-    // callback.
+    // callback. The shaders are generated in parallel: build() copies the callback for each
+    // thread it uses, so the copies are called concurrently.
     MaterialBuilder& postProcessor(PostProcessCallBack callback);
 
     // set name of this material
@@ -194,6 +199,26 @@ public:
     // specifies a list of variants that should be filtered out during code generation.
     MaterialBuilder& variantFilter(uint8_t variantFilter) noexcept;
 
+    // compresses the shaders in the package, they are decompressed when first used at runtime.
+    MaterialBuilder& compressShaders(bool enabled) noexcept;
+
+    // requests that the shaders of this material be optimized and minified. This is a hint for
+    // the post-processor (see postProcessor()), filamat doesn't optimize shaders by itself.
+    MaterialBuilder& optimizeShaders(bool enabled) noexcept;
+
+    // only generates the shaders of the specified variants, bit k being set if the variant with
+    // key k is used (see filament::Material::getUsedVariants()). All variants by default.
+    // Drawing with another variant at runtime is an error.
+    MaterialBuilder& usedVariants(uint32_t variants) noexcept;
+
+    // keeps the post-processed shaders of the builds of this builder, a shader is then only
+    // post-processed again when its generated source changes. This makes the builds of an
+    // edited material incremental, e.g. an editor can build the variants its preview needs
+    // right away with usedVariants(), and the full set later: only the remaining variants are
+    // post-processed. The shaders not used by the last two builds are dropped. Changing the
+    // post-processor clears the cache. Disabled by default.
+    MaterialBuilder& shaderCaching(bool enabled) noexcept;
+
     // build the material
     Package build() noexcept;
 
@@ -246,6 +271,10 @@ public:
 
     uint8_t getVariantFilter() const { return mVariantFilter; }
 
+    bool getOptimizeShaders() const noexcept { return mOptimizeShaders; }
+
+    const utils::CString& getName() const noexcept { return mMaterialName; }
+
 private:
     void prepareToBuild(MaterialInfo& info) noexcept;
 
@@ -284,6 +313,17 @@ private:
     bool mDepthWriteSet = false;
 
     PostProcessCallBack mPostprocessorCallback = nullptr;
+
+    // see shaderCaching(), the key is the shader model, target APIs, stage and source
+    struct CachedShader {
+        std::string shader;
+        std::vector<uint32_t> spirv;
+        bool ok;
+        uint32_t build;     // the last build which used this shader
+    };
+    std::unordered_map<std::string, CachedShader> mShaderCache;
+    uint32_t mBuildCount = 0;
+    bool mShaderCaching = false;
 };
 
 } // namespace filamat
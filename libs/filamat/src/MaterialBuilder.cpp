@@ -16,8 +16,12 @@
 
 #include "filamat/MaterialBuilder.h"
 
+#include <algorithm>
+#include <iterator>
+#include <mutex>
 #include <vector>
 
+#include <utils/JobSystem.h>
 #include <utils/Panic.h>
 #include <utils/Log.h>
 
@@ -264,6 +268,29 @@ MaterialBuilder& MaterialBuilder::variantFilter(uint8_t variantFilter) noexcept
     return *this;
 }
 
+MaterialBuilder& MaterialBuilder::compressShaders(bool enabled) noexcept {
+    mCompressShaders = enabled;
+    return *this;
+}
+
+MaterialBuilder& MaterialBuilder::optimizeShaders(bool enabled) noexcept {
+    mOptimizeShaders = enabled;
+    return *this;
+}
+
+MaterialBuilder& MaterialBuilder::usedVariants(uint32_t variants) noexcept {
+    mUsedVariants = variants;
+    return *this;
+}
+
+MaterialBuilder& MaterialBuilder::shaderCaching(bool enabled) noexcept {
+    mShaderCaching = enabled;
+    if (!enabled) {
+        mShaderCache.clear();
+    }
+    return *this;
+}
+
 bool MaterialBuilder::hasExternalSampler() const noexcept {
     for (size_t i = 0, c = mParameterCount; i < c; i++) {
         auto const& param = mParameters[i];
@@ -313,6 +340,33 @@ void MaterialBuilder::prepareToBuild(MaterialInfo& info) noexcept {
     info.samplerBindings.populate(&info.sib);
 }
 
+namespace {
+
+// A shader to generate, and the result
+struct ShaderJob {
+    size_t permutation;     // index in mCodeGenPermutations
+    uint8_t variant;
+    filament::driver::ShaderType stage;
+    std::string shader;
+    std::vector<uint32_t> spirv;
+    bool ok = true;
+    bool shared = false;    // uses the SPIR-V of the variant without Variant::SPECIALIZED_MASK
+};
+
+// Shaders are generated in parallel with the JobSystem of the calling thread if there is one
+// (e.g. when materials are built at runtime), or else with one shared by all the builders.
+JobSystem& getJobSystem() noexcept {
+    JobSystem* js = JobSystem::getJobSystem();
+    if (!js) {
+        static JobSystem sJobSystem(0, 8);
+        sJobSystem.adopt();
+        js = &sJobSystem;
+    }
+    return *js;
+}
+
+} // anonymous namespace
+
 static void showErrorMessage(const char* materialName, uint8_t variant,
         MaterialBuilder::TargetApi targetApi, filament::driver::ShaderType shaderType,
         const std::string& shaderCode) {
@@ -425,7 +479,6 @@ Package MaterialBuilder::build() noexcept {
     std::vector<SpirvEntry> spirvEntries;
     LineDictionary glslDictionary;
     BlobDictionary spirvDictionary;
-    std::vector<uint32_t> spirv;
 
     ShaderGenerator sg(mProperties, mVariables,
             mMaterialCode, mMaterialLineOffset, mMaterialVertexCode, mMaterialVertexLineOffset);
@@ -436,101 +489,180 @@ Package MaterialBuilder::build() noexcept {
     SimpleFieldChunk<bool> hasCustomDepth(ChunkType::MaterialHasCustomDepthShader, customDepth);
     container.addChild(&hasCustomDepth);
 
-    bool errorOccured = false;
-    for (const auto& params : mCodeGenPermutations) {
-        const ShaderModel shaderModel = ShaderModel(params.shaderModel);
-        const TargetApi targetApi = params.targetApi;
-        const TargetApi codeGenTargetApi = params.codeGenTargetApi;
-        std::vector<uint32_t>* pSpirv = (targetApi == TargetApi::VULKAN) ? &spirv : nullptr;
-
-        GlslEntry glslEntry;
-        SpirvEntry spirvEntry;
-
-        glslEntry.shaderModel = static_cast<uint8_t>(params.shaderModel);
-        spirvEntry.shaderModel = static_cast<uint8_t>(params.shaderModel);
+    // The vertex and fragment shaders the used variants need.
+    uint32_t usedVertexVariants = 0;
+    uint32_t usedFragmentVariants = 0;
+    for (uint8_t k = 0; k < filament::VARIANT_COUNT; k++) {
+        if (mUsedVariants & (1u << k)) {
+            usedVertexVariants |= 1u << filament::Variant::filterVariantVertex(k);
+            usedFragmentVariants |= 1u << filament::Variant::filterVariantFragment(k);
+        }
+    }
 
+    // List all the shaders to generate, in the order they're stored in the package.
+    std::vector<ShaderJob> shaderJobs;
+    for (size_t i = 0; i < mCodeGenPermutations.size(); i++) {
         // apply custom variants filters
         uint8_t variantMask = ~mVariantFilter;
 
+        // see ShaderGenerator::createFragmentProgram()
+        const bool specialized = mCodeGenPermutations[i].targetApi == TargetApi::VULKAN && isLit();
+
         for (uint8_t k = 0; k < filament::VARIANT_COUNT; k++) {
 
             if (filament::Variant::isReserved(k)) {
                 continue;
             }
 
-            glslEntry.variant = k;
-            spirvEntry.variant = k;
-
             // Remove variants for unlit materials
             uint8_t v = filament::Variant::filterVariant(k & variantMask, isLit() || mShadowMultiplier);
 
-            if (filament::Variant::filterVariantVertex(v) == k) {
-                // Vertex Shader
-                std::string vs = sg.createVertexProgram(
-                        shaderModel, targetApi, codeGenTargetApi, info, k,
-                        mInterpolation, mVertexDomain);
-                if (mPostprocessorCallback != nullptr) {
-                    bool ok = mPostprocessorCallback(vs, filament::driver::ShaderType::VERTEX,
-                            shaderModel, &vs, pSpirv);
-                    if (!ok) {
-                        showErrorMessage(mMaterialName.c_str_safe(), k, targetApi,
-                                filament::driver::ShaderType::VERTEX, vs);
-                        errorOccured = true;
-                        break;
-                    }
-                }
-                if (targetApi == TargetApi::OPENGL) {
-                    glslEntry.stage = filament::driver::ShaderType::VERTEX;
-                    glslEntry.shaderSize = vs.size();
-                    glslEntry.shader = (char*)malloc(glslEntry.shaderSize + 1);
-                    strcpy(glslEntry.shader, vs.c_str());
-                    glslDictionary.addText(glslEntry.shader);
-                    glslEntries.push_back(glslEntry);
-                }
-                if (targetApi == TargetApi::VULKAN) {
-                    assert(spirv.size() > 0);
-                    spirvEntry.stage = filament::driver::ShaderType::VERTEX;
-                    spirvEntry.dictionaryIndex = spirvDictionary.addBlob(spirv);
-                    spirv.clear();
-                    spirvEntries.push_back(spirvEntry);
-                }
+            if (filament::Variant::filterVariantVertex(v) == k &&
+                    (usedVertexVariants & (1u << k))) {
+                shaderJobs.push_back({ i, k, filament::driver::ShaderType::VERTEX });
             }
-
             if (filament::Variant::filterVariantFragment(v) == k) {
-                // Fragment Shader
-                std::string fs = sg.createFragmentProgram(
-                        shaderModel, targetApi, codeGenTargetApi, info, k, mInterpolation);
-                if (mPostprocessorCallback != nullptr) {
-                    bool ok = mPostprocessorCallback(fs, filament::driver::ShaderType::FRAGMENT,
-                            shaderModel, &fs, pSpirv);
-                    if (!ok) {
-                        showErrorMessage(mMaterialName.c_str_safe(), k, targetApi,
-                                filament::driver::ShaderType::FRAGMENT, fs);
-                        errorOccured = true;
-                        break;
+                const uint8_t base = k & ~filament::Variant::SPECIALIZED_MASK;
+                const uint8_t specializations = k | filament::Variant::SPECIALIZED_MASK;
+                if (specialized && base != k) {
+                    if (usedFragmentVariants & (1u << k)) {
+                        ShaderJob job = { i, k, filament::driver::ShaderType::FRAGMENT };
+                        job.shared = true;
+                        shaderJobs.push_back(std::move(job));
                     }
+                } else if ((usedFragmentVariants & (1u << k)) || (specialized &&
+                        !filament::Variant::isReserved(specializations) &&
+                        (usedFragmentVariants & (1u << specializations)))) {
+                    shaderJobs.push_back({ i, k, filament::driver::ShaderType::FRAGMENT });
                 }
-                if (targetApi == TargetApi::OPENGL) {
-                    glslEntry.stage = filament::driver::ShaderType::FRAGMENT;
-                    glslEntry.shaderSize = fs.size();
-                    glslEntry.shader = (char*)malloc(glslEntry.shaderSize + 1);
-                    strcpy(glslEntry.shader, fs.c_str());
-                    glslDictionary.addText(glslEntry.shader);
-                    glslEntries.push_back(glslEntry);
+            }
+        }
+    }
+
+    // Generate and post-process the shaders in parallel. Each job only writes its own entry.
+    const uint32_t build = ++mBuildCount;
+    const bool caching = mShaderCaching && mPostprocessorCallback != nullptr;
+    std::mutex cacheLock;
+    auto generate = [this, &sg, &info, &shaderJobs, build, caching, &cacheLock]
+            (uint32_t first, uint32_t count) {
+        // the post-processor can keep state between calls, each thread uses its own copy
+        PostProcessCallBack postProcessor = mPostprocessorCallback;
+        std::string key;
+        for (uint32_t j = first; j < first + count; j++) {
+            ShaderJob& job = shaderJobs[j];
+            if (job.shared) {
+                continue;
+            }
+            const auto& params = mCodeGenPermutations[job.permutation];
+            const ShaderModel shaderModel = ShaderModel(params.shaderModel);
+            const TargetApi targetApi = params.targetApi;
+            const TargetApi codeGenTargetApi = params.codeGenTargetApi;
+            std::vector<uint32_t>* pSpirv =
+                    (targetApi == TargetApi::VULKAN) ? &job.spirv : nullptr;
+
+            if (job.stage == filament::driver::ShaderType::VERTEX) {
+                job.shader = sg.createVertexProgram(
+                        shaderModel, targetApi, codeGenTargetApi, info, job.variant,
+                        mInterpolation, mVertexDomain);
+            } else {
+                job.shader = sg.createFragmentProgram(
+                        shaderModel, targetApi, codeGenTargetApi, info, job.variant,
+                        mInterpolation);
+            }
+            if (caching) {
+                key.assign({ char(shaderModel), char(targetApi), char(codeGenTargetApi),
+                        char(job.stage) });
+                key += job.shader;
+                std::lock_guard<std::mutex> guard(cacheLock);
+                auto pos = mShaderCache.find(key);
+                if (pos != mShaderCache.end()) {
+                    pos->second.build = build;
+                    job.shader = pos->second.shader;
+                    job.spirv = pos->second.spirv;
+                    job.ok = pos->second.ok;
+                    continue;
                 }
-                if (targetApi == TargetApi::VULKAN) {
-                    assert(spirv.size() > 0);
-                    spirvEntry.stage = filament::driver::ShaderType::FRAGMENT;
-                    spirvEntry.dictionaryIndex = spirvDictionary.addBlob(spirv);
-                    spirv.clear();
-                    spirvEntries.push_back(spirvEntry);
+            }
+            if (postProcessor != nullptr) {
+                job.ok = postProcessor(job.shader, job.stage, shaderModel, &job.shader, pSpirv);
+            }
+            if (caching) {
+                std::lock_guard<std::mutex> guard(cacheLock);
+                mShaderCache[std::move(key)] = { job.shader, job.spirv, job.ok, build };
+            }
+        }
+    };
+
+    JobSystem& js = getJobSystem();
+    js.runAndWait(jobs::parallel_for(js, nullptr, 0, uint32_t(shaderJobs.size()),
+            std::cref(generate), jobs::CountSplitter<1, 8>()));
+
+    // only keep the shaders of this build and the previous one, e.g. a preview and a full build
+    for (auto it = mShaderCache.begin(); it != mShaderCache.end();) {
+        it = (build - it->second.build > 1) ? mShaderCache.erase(it) : std::next(it);
+    }
+
+    // Merge the shaders into the dictionaries sequentially, so the package doesn't depend on the
+    // order the jobs ran in. After an error, the rest of the variants of the same code gen
+    // permutation are skipped.
+    bool errorOccured = false;
+    size_t failedPermutation = size_t(-1);
+    size_t currentPermutation = size_t(-1);
+    size_t fragmentBlobs[filament::VARIANT_COUNT];   // dictionary index, by variant
+    for (ShaderJob& job : shaderJobs) {
+        if (job.permutation == failedPermutation) {
+            continue;
+        }
+        if (job.permutation != currentPermutation) {
+            currentPermutation = job.permutation;
+            std::fill(std::begin(fragmentBlobs), std::end(fragmentBlobs), size_t(-1));
+        }
+
+        const auto& params = mCodeGenPermutations[job.permutation];
+        const TargetApi targetApi = params.targetApi;
+
+        if (!job.ok) {
+            showErrorMessage(mMaterialName.c_str_safe(), job.variant, targetApi,
+                    job.stage, job.shader);
+            errorOccured = true;
+            failedPermutation = job.permutation;
+            continue;
+        }
+
+        if (targetApi == TargetApi::OPENGL) {
+            GlslEntry glslEntry;
+            glslEntry.shaderModel = static_cast<uint8_t>(params.shaderModel);
+            glslEntry.variant = job.variant;
+            glslEntry.stage = job.stage;
+            glslEntry.shaderSize = job.shader.size();
+            glslEntry.shader = (char*)malloc(glslEntry.shaderSize + 1);
+            strcpy(glslEntry.shader, job.shader.c_str());
+            glslDictionary.addText(glslEntry.shader);
+            glslEntries.push_back(glslEntry);
+        }
+        if (targetApi == TargetApi::VULKAN) {
+            SpirvEntry spirvEntry;
+            spirvEntry.shaderModel = static_cast<uint8_t>(params.shaderModel);
+            spirvEntry.variant = job.variant;
+            spirvEntry.stage = job.stage;
+            if (job.shared) {
+                // the variant without the specialized bits comes first
+                spirvEntry.dictionaryIndex = fragmentBlobs[
+                        job.variant & ~filament::Variant::SPECIALIZED_MASK];
+                assert(spirvEntry.dictionaryIndex != size_t(-1));
+            } else {
+                assert(job.spirv.size() > 0);
+                spirvEntry.dictionaryIndex = spirvDictionary.addBlob(job.spirv);
+                if (job.stage == filament::driver::ShaderType::FRAGMENT) {
+                    fragmentBlobs[job.variant] = spirvEntry.dictionaryIndex;
                 }
             }
+            spirvEntries.push_back(spirvEntry);
         }
     }
 
     // Emit GLSL chunks (TextDictionaryReader and MaterialGlslChunk).
-    filamat::DictionaryGlslChunk dicGlslChunk(glslDictionary);
+    filamat::DictionaryGlslChunk dicGlslChunk(glslDictionary, mCompressShaders);
     MaterialGlslChunk glslChunk(glslEntries, glslDictionary);
     if (!glslEntries.empty()) {
         container.addChild(&dicGlslChunk);
@@ -538,7 +670,7 @@ Package MaterialBuilder::build() noexcept {
     }
 
     // Emit SPIRV chunks (SpirvDictionaryReader and MaterialSpirvChunk).
-    filamat::DictionarySpirvChunk dicSpirvChunk(spirvDictionary);
+    filamat::DictionarySpirvChunk dicSpirvChunk(spirvDictionary, mCompressShaders);
     MaterialSpirvChunk spirvChunk(spirvEntries);
     if (!spirvEntries.empty()) {
         container.addChild(&dicSpirvChunk);
@@ -561,6 +693,8 @@ Package MaterialBuilder::build() noexcept {
 
 MaterialBuilder& MaterialBuilder::postProcessor(PostProcessCallBack callback) {
     mPostprocessorCallback = callback;
+    // the cached shaders were post-processed by the previous one
+    mShaderCache.clear();
     return *this;
 }
 
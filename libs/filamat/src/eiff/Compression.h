@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMAT_COMPRESSION_H
+#define TNT_FILAMAT_COMPRESSION_H
+
+#include <zlib.h>
+
+#include <string>
+
+#include <stddef.h>
+
+namespace filamat {
+
+// Compresses data with zlib at the best compression level, materials are compressed once and
+// decompressed many times.
+inline std::string compress(const char* data, size_t size) {
+    uLongf length = compressBound(size);
+    std::string compressed(length, '\0');
+    int result = compress2(reinterpret_cast<Bytef*>(&compressed[0]), &length,
+            reinterpret_cast<const Bytef*>(data), size, Z_BEST_COMPRESSION);
+    compressed.resize(result == Z_OK ? length : 0);
+    return compressed;
+}
+
+} // namespace filamat
+
+#endif // TNT_FILAMAT_COMPRESSION_H
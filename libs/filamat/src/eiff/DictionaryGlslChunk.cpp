@@ -16,13 +16,39 @@
 
 #include "DictionaryGlslChunk.h"
 
+#include "Compression.h"
+
 namespace filamat {
 
-DictionaryGlslChunk::DictionaryGlslChunk(LineDictionary& dictionary) :
-        Chunk(ChunkType::DictionaryGlsl), mDictionary(dictionary){
+DictionaryGlslChunk::DictionaryGlslChunk(LineDictionary& dictionary, bool compressed) :
+        Chunk(compressed ? ChunkType::DictionaryGlslCompressed : ChunkType::DictionaryGlsl),
+        mDictionary(dictionary), mCompressed(compressed) {
 }
 
 void DictionaryGlslChunk::flatten(Flattener& f) {
+    if (!mCompressed) {
+        flattenLines(f);
+        return;
+    }
+
+    // flatten() is called once to measure the chunk and once to write it
+    if (mCompressedLines.empty()) {
+        // not the shared dry runner, which may be the one measuring this chunk
+        Flattener dryRunner(nullptr);
+        flattenLines(dryRunner);
+        std::string lines(dryRunner.getBytesWritten(), '\0');
+        Flattener linesFlattener(reinterpret_cast<uint8_t*>(&lines[0]));
+        flattenLines(linesFlattener);
+        mLinesSize = uint32_t(lines.size());
+        mCompressedLines = compress(lines.data(), lines.size());
+    }
+
+    // Decoded size, then the compressed DictionaryGlsl chunk
+    f.writeUint32(mLinesSize);
+    f.writeBlob(mCompressedLines.data(), mCompressedLines.size());
+}
+
+void DictionaryGlslChunk::flattenLines(Flattener& f) {
     // NumStrings
     f.writeUint32(mDictionary.getLineCount());
 
@@ -18,6 +18,7 @@
 #define TNT_FILAMAT_DIC_GLSL_CHUNK_H
 
 #include <stdint.h>
+#include <string>
 #include <vector>
 
 #include "Chunk.h"
@@ -28,11 +29,17 @@ namespace filamat {
 
 class DictionaryGlslChunk : public Chunk {
 public:
-    DictionaryGlslChunk(LineDictionary& dictionary);
+    // a compressed dictionary is emitted as a DictionaryGlslCompressed chunk
+    DictionaryGlslChunk(LineDictionary& dictionary, bool compressed = false);
     ~DictionaryGlslChunk() = default;
     virtual void flatten(Flattener& f);
 private:
+    void flattenLines(Flattener& f);
+
     LineDictionary& mDictionary;
+    bool mCompressed;
+    std::string mCompressedLines;   // computed on the first flatten()
+    uint32_t mLinesSize = 0;
 };
 
 } // namespace filamat
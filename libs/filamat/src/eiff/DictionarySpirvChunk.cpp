@@ -16,19 +16,41 @@
 
 #include "DictionarySpirvChunk.h"
 
+#include "Compression.h"
+
 namespace filamat {
 
-DictionarySpirvChunk::DictionarySpirvChunk(BlobDictionary& dictionary) :
-        Chunk(ChunkType::DictionarySpirv), mDictionary(dictionary){
+DictionarySpirvChunk::DictionarySpirvChunk(BlobDictionary& dictionary, bool compressed) :
+        Chunk(ChunkType::DictionarySpirv), mDictionary(dictionary), mCompressed(compressed) {
 }
 
 void DictionarySpirvChunk::flatten(Flattener& f) {
-    // TODO: for now the compression option is always 0, fix this.
-    f.writeUint32(0);
+    if (!mCompressed) {
+        f.writeUint32(COMPRESSION_NONE);
+        f.writeUint32(mDictionary.getBlobCount());
+        for (size_t i = 0 ; i < mDictionary.getBlobCount() ; i++) {
+            const std::string& blob = mDictionary.getBlob(i);
+            f.writeBlob(blob.data(), blob.size());
+        }
+        return;
+    }
+
+    // flatten() is called once to measure the chunk and once to write it
+    if (mCompressedBlobs.size() != mDictionary.getBlobCount()) {
+        mCompressedBlobs.clear();
+        for (size_t i = 0 ; i < mDictionary.getBlobCount() ; i++) {
+            const std::string& blob = mDictionary.getBlob(i);
+            mCompressedBlobs.push_back(blob.empty() ? std::string() :
+                    compress(blob.data(), blob.size()));
+        }
+    }
+
+    // Each blob is preceded by its decoded size
+    f.writeUint32(COMPRESSION_ZLIB);
     f.writeUint32(mDictionary.getBlobCount());
     for (size_t i = 0 ; i < mDictionary.getBlobCount() ; i++) {
-        const std::string& blob = mDictionary.getBlob(i);
-        f.writeBlob(blob.data(), blob.size());
+        f.writeUint32(uint32_t(mDictionary.getBlob(i).size()));
+        f.writeBlob(mCompressedBlobs[i].data(), mCompressedBlobs[i].size());
     }
 }
 
@@ -18,6 +18,7 @@
 #define TNT_FILAMAT_DIC_SPIRV_CHUNK_H
 
 #include <stdint.h>
+#include <string>
 #include <vector>
 
 #include "Chunk.h"
@@ -28,11 +29,14 @@ namespace filamat {
 
 class DictionarySpirvChunk : public Chunk {
 public:
-    DictionarySpirvChunk(BlobDictionary& dictionary);
+    // compressed blobs are decoded independently, when a shader is first needed
+    DictionarySpirvChunk(BlobDictionary& dictionary, bool compressed = false);
     ~DictionarySpirvChunk() = default;
     virtual void flatten(Flattener& f);
 private:
     BlobDictionary& mDictionary;
+    bool mCompressed;
+    std::vector<std::string> mCompressedBlobs;  // computed on the first flatten()
 };
 
 } // namespace filamat
@@ -41,9 +41,9 @@ std::ostream& CodeGenerator::generateProlog(std::ostream& out, ShaderType type,
             break;
         case ShaderModel::GL_ES_30:
             // Vulkan requires version 310 or higher
-            if (mCodeGenTargetApi == TargetApi::VULKAN) {
+            if (mCodeGenTargetApi == TargetApi::VULKAN || type == ShaderType::COMPUTE) {
                 // Vulkan requires layout locations on ins and outs, which were not supported
-                // in the OpenGL 4.1 GLSL profile.
+                // in the OpenGL 4.1 GLSL profile. Compute shaders need ES 3.1.
                 out << "#version 310 es\n\n";
             } else {
                 out << "#version 300 es\n\n";
@@ -58,8 +58,16 @@ std::ostream& CodeGenerator::generateProlog(std::ostream& out, ShaderType type,
                 // Vulkan requires binding specifiers on uniforms and samplers, which were not
                 // supported in the OpenGL 4.1 GLSL profile.
                 out << "#version 450 core\n\n";
+            } else if (type == ShaderType::COMPUTE) {
+                out << "#version 430 core\n\n";
             } else {
                 out << "#version 410 core\n\n";
+                if (type == ShaderType::VERTEX) {
+                    // used by getInstanceIndex() when available
+                    out << "#if defined(GL_ARB_shader_draw_parameters)\n";
+                    out << "#extension GL_ARB_shader_draw_parameters : enable\n";
+                    out << "#endif\n\n";
+                }
             }
             break;
     }
@@ -90,7 +98,7 @@ std::ostream& CodeGenerator::generateProlog(std::ostream& out, ShaderType type,
 Precision CodeGenerator::getDefaultPrecision(ShaderType type) const {
     if (type == ShaderType::VERTEX) {
         return Precision::HIGH;
-    } else if (type == ShaderType::FRAGMENT) {
+    } else if (type == ShaderType::FRAGMENT || type == ShaderType::COMPUTE) {
         if (mShaderModel < ShaderModel::GL_CORE_41) {
             return Precision::MEDIUM;
         } else {
@@ -131,6 +139,8 @@ std::ostream& CodeGenerator::generatePostProcessMain(std::ostream& out,
         switch (variant) {
             case PostProcessStage::TONE_MAPPING_OPAQUE:
             case PostProcessStage::TONE_MAPPING_TRANSLUCENT:
+            case PostProcessStage::TONE_MAPPING_SUBPASS_OPAQUE:
+            case PostProcessStage::TONE_MAPPING_SUBPASS_TRANSLUCENT:
                 out << filament::shaders::tone_mapping_fs;
                 out << filament::shaders::conversion_functions_fs;
                 out << filament::shaders::dithering_fs;
@@ -139,8 +149,29 @@ std::ostream& CodeGenerator::generatePostProcessMain(std::ostream& out,
             case PostProcessStage::ANTI_ALIASING_TRANSLUCENT:
                 out << filament::shaders::fxaa_fs;
                 break;
+            case PostProcessStage::FUSED_OPAQUE:
+            case PostProcessStage::FUSED_TRANSLUCENT:
+                out << filament::shaders::tone_mapping_fs;
+                out << filament::shaders::conversion_functions_fs;
+                out << filament::shaders::dithering_fs;
+                out << filament::shaders::fxaa_fs;
+                break;
+            case PostProcessStage::DEPTH_DOWNSAMPLE:
+            case PostProcessStage::TEMPORAL_UPSCALE:
+            case PostProcessStage::FUSED_COMPUTE_OPAQUE:
+            case PostProcessStage::FUSED_COMPUTE_TRANSLUCENT:
+            case PostProcessStage::OIT_COMPOSITE:
+            case PostProcessStage::SHADOW_MOMENTS:
+            case PostProcessStage::SHADOW_BLUR:
+                break;
         }
         out << filament::shaders::post_process_fs;
+    } else if (type == ShaderType::COMPUTE) {
+        // only the FUSED_COMPUTE stages are compute shaders
+        out << filament::shaders::tone_mapping_fs;
+        out << filament::shaders::conversion_functions_fs;
+        out << filament::shaders::dithering_fs;
+        out << filament::shaders::post_process_cs;
     }
     return out;
 }
@@ -325,6 +356,14 @@ std::ostream& CodeGenerator::generateDefine(std::ostream& out, const char* name,
     return out;
 }
 
+std::ostream& CodeGenerator::generateSpecializationConstant(std::ostream& out,
+        const char* name, uint32_t id, bool value) const {
+    assert(mTargetApi == TargetApi::VULKAN);
+    out << "layout (constant_id = " << id << ") const bool " << name << " = "
+            << (value ? "true" : "false") << ";\n";
+    return out;
+}
+
 std::ostream& CodeGenerator::generateFunction(std::ostream& out, const char* returnType,
         const char* name, const char* body) const {
     out << "\n" << returnType << " " << name << "()";
@@ -344,7 +383,7 @@ std::ostream& CodeGenerator::generateMaterialProperty(std::ostream& out,
 std::ostream& CodeGenerator::generateCommon(std::ostream& out, ShaderType type) const {
     out << filament::shaders::common_math_fs;
     if (type == ShaderType::VERTEX) {
-    } else if (type == ShaderType::FRAGMENT) {
+    } else if (type == ShaderType::FRAGMENT || type == ShaderType::COMPUTE) {
         out << filament::shaders::common_graphics_fs;
     }
     return out;
@@ -511,6 +550,23 @@ char const* CodeGenerator::getSamplerTypeName(SamplerType type, SamplerFormat fo
             // are created via VK_ANDROID_external_memory_android_hardware_buffer, but they are
             // backed by VkImage just like a normal texture, and sampled from normally.
             return (mCodeGenTargetApi == TargetApi::VULKAN) ? "sampler2D" : "samplerExternalOES";
+        case SamplerType::SAMPLER_2D_ARRAY:
+            assert(!multisample);
+            switch (format) {
+                case SamplerFormat::INT:    return "isampler2DArray";
+                case SamplerFormat::UINT:   return "usampler2DArray";
+                case SamplerFormat::FLOAT:  return "sampler2DArray";
+                case SamplerFormat::SHADOW: return "sampler2DArrayShadow";
+            }
+        case SamplerType::SAMPLER_3D:
+            assert(!multisample);
+            assert(format != SamplerFormat::SHADOW);
+            switch (format) {
+                case SamplerFormat::INT:    return "isampler3D";
+                case SamplerFormat::UINT:   return "usampler3D";
+                case SamplerFormat::FLOAT:  return "sampler3D";
+                case SamplerFormat::SHADOW: return "sampler3D";     // should not happen
+            }
     }
 }
 
@@ -106,6 +106,10 @@ public:
     std::ostream& generateDefine(std::ostream& out, const char* name, uint32_t value) const;
     std::ostream& generateDefine(std::ostream& out, const char* name, const char* string) const;
 
+    // generates a boolean specialization constant, only valid for SPIR-V
+    std::ostream& generateSpecializationConstant(std::ostream& out, const char* name,
+            uint32_t id, bool value) const;
+
     std::ostream& generateGetters(std::ostream& out, ShaderType type) const;
     std::ostream& generateParameters(std::ostream& out, ShaderType type) const;
 
@@ -160,6 +160,7 @@ const std::string ShaderGenerator::createVertexProgram(filament::driver::ShaderM
     cg.generateDefine(vs, "HAS_DIRECTIONAL_LIGHTING", litVariants && variant.hasDirectionalLighting());
     cg.generateDefine(vs, "HAS_SHADOWING", litVariants && variant.hasShadowReceiver());
     cg.generateDefine(vs, "HAS_SKINNING", variant.hasSkinning());
+    cg.generateDefine(vs, "HAS_INSTANCING", variant.hasInstancing());
     cg.generateDefine(vs, getShadingDefine(material.shading), true);
     generateMaterialDefines(vs, cg, mProperties);
 
@@ -183,16 +184,28 @@ const std::string ShaderGenerator::createVertexProgram(filament::driver::ShaderM
     cg.generateUniforms(vs, ShaderType::VERTEX,
             BindingPoints::PER_VIEW, UibGenerator::getPerViewUib());
     cg.generateUniforms(vs, ShaderType::VERTEX,
-            BindingPoints::PER_RENDERABLE, UibGenerator::getPerRenderableUib());
+            BindingPoints::PER_FRAME, UibGenerator::getPerFrameUib());
+    cg.generateUniforms(vs, ShaderType::VERTEX,
+            BindingPoints::PER_RENDERABLE, variant.hasInstancing() ?
+                    UibGenerator::getPerRenderableInstancesUib() :
+                    UibGenerator::getPerRenderableUib());
     if (variant.hasSkinning()) {
         cg.generateUniforms(vs, ShaderType::VERTEX,
                 BindingPoints::PER_RENDERABLE_BONES,
                 UibGenerator::getPerRenderableBonesUib());
+        cg.generateUniforms(vs, ShaderType::VERTEX,
+                BindingPoints::PER_RENDERABLE_MORPHING,
+                UibGenerator::getPerRenderableMorphingUib());
     }
     cg.generateUniforms(vs, ShaderType::VERTEX,
             BindingPoints::PER_MATERIAL_INSTANCE, material.uib);
     cg.generateSeparator(vs);
     // TODO: should we generate per-view SIB in the vertex shader?
+    if (variant.hasSkinning()) {
+        cg.generateSamplers(vs,
+                material.samplerBindings.getBlockOffset(BindingPoints::PER_RENDERABLE_MORPHING),
+                SibGenerator::getPerRenderableMorphingSib());
+    }
     cg.generateSamplers(vs,
             material.samplerBindings.getBlockOffset(BindingPoints::PER_MATERIAL_INSTANCE),
             material.sib);
@@ -235,7 +248,15 @@ const std::string ShaderGenerator::createFragmentProgram(filament::driver::Shade
 
     const CodeGenerator cg(shaderModel, targetApi, codeGenTargetApi);
     const bool lit = material.isLit;
-    const filament::Variant variant(variantKey);
+    filament::Variant variant(variantKey);
+
+    // In SPIR-V, the specialized variants of lit materials are selected when the pipeline is
+    // created, the shader includes their code (see Variant::SPECIALIZED_MASK).
+    const bool specialized = targetApi == MaterialBuilder::TargetApi::VULKAN && lit &&
+            !variant.isDepthPass();
+    if (specialized) {
+        variant.setDynamicLighting(true);
+    }
 
     std::stringstream fs;
     cg.generateProlog(fs, ShaderType::FRAGMENT, material.hasExternalSamplers);
@@ -251,6 +272,18 @@ const std::string ShaderGenerator::createFragmentProgram(filament::driver::Shade
     cg.generateDefine(fs, "HAS_DIRECTIONAL_LIGHTING", litVariants && variant.hasDirectionalLighting());
     cg.generateDefine(fs, "HAS_DYNAMIC_LIGHTING", litVariants && variant.hasDynamicLighting());
     cg.generateDefine(fs, "HAS_SHADOWING", litVariants && variant.hasShadowReceiver());
+    if (specialized) {
+        cg.generateDefine(fs, "HAS_SPECIALIZED_DYNAMIC_LIGHTING", true);
+        cg.generateSpecializationConstant(fs, "SPECIALIZATION_DYNAMIC_LIGHTING",
+                filament::SpecializationConstants::DYNAMIC_LIGHTING, false);
+    }
+    if (targetApi == MaterialBuilder::TargetApi::VULKAN) {
+        // the froxel data is read from storage buffers, see light_punctual.fs
+        cg.generateDefine(fs, "FROXELS_STORAGE_BINDING",
+                uint32_t(STORAGE_BINDING + StorageBindingPoints::FROXELS));
+        cg.generateDefine(fs, "RECORDS_STORAGE_BINDING",
+                uint32_t(STORAGE_BINDING + StorageBindingPoints::RECORDS));
+    }
 
     // material defines
     cg.generateDefine(fs, "MATERIAL_IS_DOUBLE_SIDED", material.isDoubleSided);
@@ -287,6 +320,8 @@ const std::string ShaderGenerator::createFragmentProgram(filament::driver::Shade
     // uniforms and samplers
     cg.generateUniforms(fs, ShaderType::FRAGMENT,
             BindingPoints::PER_VIEW, UibGenerator::getPerViewUib());
+    cg.generateUniforms(fs, ShaderType::FRAGMENT,
+            BindingPoints::PER_FRAME, UibGenerator::getPerFrameUib());
     cg.generateUniforms(fs, ShaderType::FRAGMENT,
             BindingPoints::LIGHTS, UibGenerator::getLightsUib());
     cg.generateUniforms(fs, ShaderType::FRAGMENT,
@@ -346,6 +381,8 @@ const std::string ShaderPostProcessGenerator::createPostProcessVertexProgram(
 
     cg.generateUniforms(vs, ShaderType::VERTEX,
             BindingPoints::PER_VIEW, UibGenerator::getPerViewUib());
+    cg.generateUniforms(vs, ShaderType::VERTEX,
+            BindingPoints::PER_FRAME, UibGenerator::getPerFrameUib());
     cg.generateUniforms(vs, ShaderType::VERTEX,
             BindingPoints::POST_PROCESS, UibGenerator::getPostProcessingUib());
     cg.generateSamplers(vs,
@@ -368,6 +405,8 @@ const std::string ShaderPostProcessGenerator::createPostProcessFragmentProgram(
 
     cg.generateUniforms(fs, ShaderType::FRAGMENT,
             BindingPoints::PER_VIEW, UibGenerator::getPerViewUib());
+    cg.generateUniforms(fs, ShaderType::FRAGMENT,
+            BindingPoints::PER_FRAME, UibGenerator::getPerFrameUib());
     cg.generateUniforms(fs, ShaderType::FRAGMENT,
             BindingPoints::POST_PROCESS, UibGenerator::getPostProcessingUib());
     cg.generateSamplers(fs,
@@ -379,6 +418,31 @@ const std::string ShaderPostProcessGenerator::createPostProcessFragmentProgram(
     return fs.str();
 }
 
+const std::string ShaderPostProcessGenerator::createPostProcessComputeProgram(
+        filament::driver::ShaderModel sm, MaterialBuilder::TargetApi targetApi,
+        MaterialBuilder::TargetApi codeGenTargetApi, filament::PostProcessStage variant,
+        uint8_t firstSampler) noexcept {
+    assert(isComputeStage(variant));
+    const CodeGenerator cg(sm, targetApi, codeGenTargetApi);
+    std::stringstream cs;
+    cg.generateProlog(cs, ShaderType::COMPUTE, false);
+    generatePostProcessStageDefines(cs, cg, variant);
+
+    cg.generateUniforms(cs, ShaderType::COMPUTE,
+            BindingPoints::PER_VIEW, UibGenerator::getPerViewUib());
+    cg.generateUniforms(cs, ShaderType::COMPUTE,
+            BindingPoints::PER_FRAME, UibGenerator::getPerFrameUib());
+    cg.generateUniforms(cs, ShaderType::COMPUTE,
+            BindingPoints::POST_PROCESS, UibGenerator::getPostProcessingUib());
+    cg.generateSamplers(cs,
+            firstSampler, SibGenerator::getPostProcessSib());
+
+    cg.generateCommon(cs, ShaderType::COMPUTE);
+    cg.generatePostProcessMain(cs, ShaderType::COMPUTE, variant);
+    cg.generateEpilog(cs);
+    return cs.str();
+}
+
 void ShaderPostProcessGenerator::generatePostProcessStageDefines(std::stringstream& vs,
         CodeGenerator const& cg, PostProcessStage variant) noexcept {
     cg.generateDefine(vs, "POST_PROCESS_TONE_MAPPING_OPAQUE",
@@ -389,31 +453,200 @@ void ShaderPostProcessGenerator::generatePostProcessStageDefines(std::stringstre
             uint32_t(PostProcessStage::ANTI_ALIASING_OPAQUE));
     cg.generateDefine(vs, "POST_PROCESS_ANTI_ALIASING_TRANSLUCENT",
             uint32_t(PostProcessStage::ANTI_ALIASING_TRANSLUCENT));
+    cg.generateDefine(vs, "POST_PROCESS_DEPTH_DOWNSAMPLE",
+            uint32_t(PostProcessStage::DEPTH_DOWNSAMPLE));
+    cg.generateDefine(vs, "POST_PROCESS_TONE_MAPPING_SUBPASS_OPAQUE",
+            uint32_t(PostProcessStage::TONE_MAPPING_SUBPASS_OPAQUE));
+    cg.generateDefine(vs, "POST_PROCESS_TONE_MAPPING_SUBPASS_TRANSLUCENT",
+            uint32_t(PostProcessStage::TONE_MAPPING_SUBPASS_TRANSLUCENT));
+    cg.generateDefine(vs, "POST_PROCESS_TEMPORAL_UPSCALE",
+            uint32_t(PostProcessStage::TEMPORAL_UPSCALE));
+    cg.generateDefine(vs, "POST_PROCESS_FUSED_OPAQUE",
+            uint32_t(PostProcessStage::FUSED_OPAQUE));
+    cg.generateDefine(vs, "POST_PROCESS_FUSED_TRANSLUCENT",
+            uint32_t(PostProcessStage::FUSED_TRANSLUCENT));
+    cg.generateDefine(vs, "POST_PROCESS_FUSED_COMPUTE_OPAQUE",
+            uint32_t(PostProcessStage::FUSED_COMPUTE_OPAQUE));
+    cg.generateDefine(vs, "POST_PROCESS_FUSED_COMPUTE_TRANSLUCENT",
+            uint32_t(PostProcessStage::FUSED_COMPUTE_TRANSLUCENT));
+    cg.generateDefine(vs, "POST_PROCESS_OIT_COMPOSITE",
+            uint32_t(PostProcessStage::OIT_COMPOSITE));
+    cg.generateDefine(vs, "POST_PROCESS_SHADOW_MOMENTS",
+            uint32_t(PostProcessStage::SHADOW_MOMENTS));
+    cg.generateDefine(vs, "POST_PROCESS_SHADOW_BLUR",
+            uint32_t(PostProcessStage::SHADOW_BLUR));
+    cg.generateDefine(vs, "SUBPASS_INPUT_BINDING", uint32_t(SUBPASS_INPUT_BINDING));
+    const bool subpass = variant == PostProcessStage::TONE_MAPPING_SUBPASS_OPAQUE ||
+            variant == PostProcessStage::TONE_MAPPING_SUBPASS_TRANSLUCENT;
+    cg.generateDefine(vs, "POST_PROCESS_SUBPASS", uint32_t(subpass));
+    cg.generateDefine(vs, "POST_PROCESS_COMPUTE", uint32_t(isComputeStage(variant)));
     switch (variant) {
         case PostProcessStage::TONE_MAPPING_OPAQUE:
             cg.generateDefine(vs, "POST_PROCESS_STAGE", "POST_PROCESS_TONE_MAPPING_OPAQUE");
             cg.generateDefine(vs, "POST_PROCESS_TONE_MAPPING",  1u);
             cg.generateDefine(vs, "POST_PROCESS_ANTI_ALIASING", 0u);
+            cg.generateDefine(vs, "POST_PROCESS_DEPTH",         0u);
+            cg.generateDefine(vs, "POST_PROCESS_TEMPORAL",      0u);
+            cg.generateDefine(vs, "POST_PROCESS_FUSED",         0u);
+            cg.generateDefine(vs, "POST_PROCESS_OIT",           0u);
+            cg.generateDefine(vs, "POST_PROCESS_SHADOW",        0u);
             cg.generateDefine(vs, "POST_PROCESS_OPAQUE",        1u);
             break;
         case PostProcessStage::TONE_MAPPING_TRANSLUCENT:
             cg.generateDefine(vs, "POST_PROCESS_STAGE", "POST_PROCESS_TONE_MAPPING_TRANSLUCENT");
             cg.generateDefine(vs, "POST_PROCESS_TONE_MAPPING",  1u);
             cg.generateDefine(vs, "POST_PROCESS_ANTI_ALIASING", 0u);
+            cg.generateDefine(vs, "POST_PROCESS_DEPTH",         0u);
+            cg.generateDefine(vs, "POST_PROCESS_TEMPORAL",      0u);
+            cg.generateDefine(vs, "POST_PROCESS_FUSED",         0u);
+            cg.generateDefine(vs, "POST_PROCESS_OIT",           0u);
+            cg.generateDefine(vs, "POST_PROCESS_SHADOW",        0u);
             cg.generateDefine(vs, "POST_PROCESS_OPAQUE",        0u);
             break;
         case PostProcessStage::ANTI_ALIASING_OPAQUE:
             cg.generateDefine(vs, "POST_PROCESS_STAGE", "POST_PROCESS_ANTI_ALIASING_OPAQUE");
             cg.generateDefine(vs, "POST_PROCESS_TONE_MAPPING",  0u);
             cg.generateDefine(vs, "POST_PROCESS_ANTI_ALIASING", 1u);
+            cg.generateDefine(vs, "POST_PROCESS_DEPTH",         0u);
+            cg.generateDefine(vs, "POST_PROCESS_TEMPORAL",      0u);
+            cg.generateDefine(vs, "POST_PROCESS_FUSED",         0u);
+            cg.generateDefine(vs, "POST_PROCESS_OIT",           0u);
+            cg.generateDefine(vs, "POST_PROCESS_SHADOW",        0u);
             cg.generateDefine(vs, "POST_PROCESS_OPAQUE",        1u);
             break;
         case PostProcessStage::ANTI_ALIASING_TRANSLUCENT:
             cg.generateDefine(vs, "POST_PROCESS_STAGE", "POST_PROCESS_ANTI_ALIASING_TRANSLUCENT");
             cg.generateDefine(vs, "POST_PROCESS_TONE_MAPPING",  0u);
             cg.generateDefine(vs, "POST_PROCESS_ANTI_ALIASING", 1u);
+            cg.generateDefine(vs, "POST_PROCESS_DEPTH",         0u);
+            cg.generateDefine(vs, "POST_PROCESS_TEMPORAL",      0u);
+            cg.generateDefine(vs, "POST_PROCESS_FUSED",         0u);
+            cg.generateDefine(vs, "POST_PROCESS_OIT",           0u);
+            cg.generateDefine(vs, "POST_PROCESS_SHADOW",        0u);
+            cg.generateDefine(vs, "POST_PROCESS_OPAQUE",        0u);
+            break;
+        case PostProcessStage::DEPTH_DOWNSAMPLE:
+            cg.generateDefine(vs, "POST_PROCESS_STAGE", "POST_PROCESS_DEPTH_DOWNSAMPLE");
+            cg.generateDefine(vs, "POST_PROCESS_TONE_MAPPING",  0u);
+            cg.generateDefine(vs, "POST_PROCESS_ANTI_ALIASING", 0u);
+            cg.generateDefine(vs, "POST_PROCESS_DEPTH",         1u);
+            cg.generateDefine(vs, "POST_PROCESS_TEMPORAL",      0u);
+            cg.generateDefine(vs, "POST_PROCESS_FUSED",         0u);
+            cg.generateDefine(vs, "POST_PROCESS_OIT",           0u);
+            cg.generateDefine(vs, "POST_PROCESS_SHADOW",        0u);
+            cg.generateDefine(vs, "POST_PROCESS_OPAQUE",        1u);
+            break;
+        case PostProcessStage::TONE_MAPPING_SUBPASS_OPAQUE:
+            cg.generateDefine(vs, "POST_PROCESS_STAGE", "POST_PROCESS_TONE_MAPPING_SUBPASS_OPAQUE");
+            cg.generateDefine(vs, "POST_PROCESS_TONE_MAPPING",  1u);
+            cg.generateDefine(vs, "POST_PROCESS_ANTI_ALIASING", 0u);
+            cg.generateDefine(vs, "POST_PROCESS_DEPTH",         0u);
+            cg.generateDefine(vs, "POST_PROCESS_TEMPORAL",      0u);
+            cg.generateDefine(vs, "POST_PROCESS_FUSED",         0u);
+            cg.generateDefine(vs, "POST_PROCESS_OIT",           0u);
+            cg.generateDefine(vs, "POST_PROCESS_SHADOW",        0u);
+            cg.generateDefine(vs, "POST_PROCESS_OPAQUE",        1u);
+            break;
+        case PostProcessStage::TONE_MAPPING_SUBPASS_TRANSLUCENT:
+            cg.generateDefine(vs, "POST_PROCESS_STAGE",
+                    "POST_PROCESS_TONE_MAPPING_SUBPASS_TRANSLUCENT");
+            cg.generateDefine(vs, "POST_PROCESS_TONE_MAPPING",  1u);
+            cg.generateDefine(vs, "POST_PROCESS_ANTI_ALIASING", 0u);
+            cg.generateDefine(vs, "POST_PROCESS_DEPTH",         0u);
+            cg.generateDefine(vs, "POST_PROCESS_TEMPORAL",      0u);
+            cg.generateDefine(vs, "POST_PROCESS_FUSED",         0u);
+            cg.generateDefine(vs, "POST_PROCESS_OIT",           0u);
+            cg.generateDefine(vs, "POST_PROCESS_SHADOW",        0u);
+            cg.generateDefine(vs, "POST_PROCESS_OPAQUE",        0u);
+            break;
+        case PostProcessStage::TEMPORAL_UPSCALE:
+            cg.generateDefine(vs, "POST_PROCESS_STAGE", "POST_PROCESS_TEMPORAL_UPSCALE");
+            cg.generateDefine(vs, "POST_PROCESS_TONE_MAPPING",  0u);
+            cg.generateDefine(vs, "POST_PROCESS_ANTI_ALIASING", 0u);
+            cg.generateDefine(vs, "POST_PROCESS_DEPTH",         0u);
+            cg.generateDefine(vs, "POST_PROCESS_TEMPORAL",      1u);
+            cg.generateDefine(vs, "POST_PROCESS_FUSED",         0u);
+            cg.generateDefine(vs, "POST_PROCESS_OIT",           0u);
+            cg.generateDefine(vs, "POST_PROCESS_SHADOW",        0u);
+            cg.generateDefine(vs, "POST_PROCESS_OPAQUE",        0u);
+            break;
+        case PostProcessStage::FUSED_OPAQUE:
+            cg.generateDefine(vs, "POST_PROCESS_STAGE", "POST_PROCESS_FUSED_OPAQUE");
+            cg.generateDefine(vs, "POST_PROCESS_TONE_MAPPING",  0u);
+            cg.generateDefine(vs, "POST_PROCESS_ANTI_ALIASING", 1u);
+            cg.generateDefine(vs, "POST_PROCESS_DEPTH",         0u);
+            cg.generateDefine(vs, "POST_PROCESS_TEMPORAL",      0u);
+            cg.generateDefine(vs, "POST_PROCESS_FUSED",         1u);
+            cg.generateDefine(vs, "POST_PROCESS_OIT",           0u);
+            cg.generateDefine(vs, "POST_PROCESS_SHADOW",        0u);
+            cg.generateDefine(vs, "POST_PROCESS_OPAQUE",        1u);
+            break;
+        case PostProcessStage::FUSED_TRANSLUCENT:
+            cg.generateDefine(vs, "POST_PROCESS_STAGE", "POST_PROCESS_FUSED_TRANSLUCENT");
+            cg.generateDefine(vs, "POST_PROCESS_TONE_MAPPING",  0u);
+            cg.generateDefine(vs, "POST_PROCESS_ANTI_ALIASING", 1u);
+            cg.generateDefine(vs, "POST_PROCESS_DEPTH",         0u);
+            cg.generateDefine(vs, "POST_PROCESS_TEMPORAL",      0u);
+            cg.generateDefine(vs, "POST_PROCESS_FUSED",         1u);
+            cg.generateDefine(vs, "POST_PROCESS_OIT",           0u);
+            cg.generateDefine(vs, "POST_PROCESS_SHADOW",        0u);
             cg.generateDefine(vs, "POST_PROCESS_OPAQUE",        0u);
             break;
+        case PostProcessStage::FUSED_COMPUTE_OPAQUE:
+            cg.generateDefine(vs, "POST_PROCESS_STAGE", "POST_PROCESS_FUSED_COMPUTE_OPAQUE");
+            cg.generateDefine(vs, "POST_PROCESS_TONE_MAPPING",  0u);
+            cg.generateDefine(vs, "POST_PROCESS_ANTI_ALIASING", 0u);
+            cg.generateDefine(vs, "POST_PROCESS_DEPTH",         0u);
+            cg.generateDefine(vs, "POST_PROCESS_TEMPORAL",      0u);
+            cg.generateDefine(vs, "POST_PROCESS_FUSED",         0u);
+            cg.generateDefine(vs, "POST_PROCESS_OIT",           0u);
+            cg.generateDefine(vs, "POST_PROCESS_SHADOW",        0u);
+            cg.generateDefine(vs, "POST_PROCESS_OPAQUE",        1u);
+            break;
+        case PostProcessStage::FUSED_COMPUTE_TRANSLUCENT:
+            cg.generateDefine(vs, "POST_PROCESS_STAGE", "POST_PROCESS_FUSED_COMPUTE_TRANSLUCENT");
+            cg.generateDefine(vs, "POST_PROCESS_TONE_MAPPING",  0u);
+            cg.generateDefine(vs, "POST_PROCESS_ANTI_ALIASING", 0u);
+            cg.generateDefine(vs, "POST_PROCESS_DEPTH",         0u);
+            cg.generateDefine(vs, "POST_PROCESS_TEMPORAL",      0u);
+            cg.generateDefine(vs, "POST_PROCESS_FUSED",         0u);
+            cg.generateDefine(vs, "POST_PROCESS_OIT",           0u);
+            cg.generateDefine(vs, "POST_PROCESS_SHADOW",        0u);
+            cg.generateDefine(vs, "POST_PROCESS_OPAQUE",        0u);
+            break;
+        case PostProcessStage::OIT_COMPOSITE:
+            cg.generateDefine(vs, "POST_PROCESS_STAGE", "POST_PROCESS_OIT_COMPOSITE");
+            cg.generateDefine(vs, "POST_PROCESS_TONE_MAPPING",  0u);
+            cg.generateDefine(vs, "POST_PROCESS_ANTI_ALIASING", 0u);
+            cg.generateDefine(vs, "POST_PROCESS_DEPTH",         0u);
+            cg.generateDefine(vs, "POST_PROCESS_TEMPORAL",      0u);
+            cg.generateDefine(vs, "POST_PROCESS_FUSED",         0u);
+            cg.generateDefine(vs, "POST_PROCESS_OIT",           1u);
+            cg.generateDefine(vs, "POST_PROCESS_SHADOW",        0u);
+            cg.generateDefine(vs, "POST_PROCESS_OPAQUE",        0u);
+            break;
+        case PostProcessStage::SHADOW_MOMENTS:
+            cg.generateDefine(vs, "POST_PROCESS_STAGE", "POST_PROCESS_SHADOW_MOMENTS");
+            cg.generateDefine(vs, "POST_PROCESS_TONE_MAPPING",  0u);
+            cg.generateDefine(vs, "POST_PROCESS_ANTI_ALIASING", 0u);
+            cg.generateDefine(vs, "POST_PROCESS_DEPTH",         0u);
+            cg.generateDefine(vs, "POST_PROCESS_TEMPORAL",      0u);
+            cg.generateDefine(vs, "POST_PROCESS_FUSED",         0u);
+            cg.generateDefine(vs, "POST_PROCESS_OIT",           0u);
+            cg.generateDefine(vs, "POST_PROCESS_SHADOW",        1u);
+            cg.generateDefine(vs, "POST_PROCESS_OPAQUE",        1u);
+            break;
+        case PostProcessStage::SHADOW_BLUR:
+            cg.generateDefine(vs, "POST_PROCESS_STAGE", "POST_PROCESS_SHADOW_BLUR");
+            cg.generateDefine(vs, "POST_PROCESS_TONE_MAPPING",  0u);
+            cg.generateDefine(vs, "POST_PROCESS_ANTI_ALIASING", 0u);
+            cg.generateDefine(vs, "POST_PROCESS_DEPTH",         0u);
+            cg.generateDefine(vs, "POST_PROCESS_TEMPORAL",      0u);
+            cg.generateDefine(vs, "POST_PROCESS_FUSED",         0u);
+            cg.generateDefine(vs, "POST_PROCESS_OIT",           0u);
+            cg.generateDefine(vs, "POST_PROCESS_SHADOW",        1u);
+            cg.generateDefine(vs, "POST_PROCESS_OPAQUE",        1u);
+            break;
     }
 }
 
@@ -69,6 +69,10 @@ struct ShaderPostProcessGenerator {
     static const std::string createPostProcessFragmentProgram(filament::driver::ShaderModel sm,
             MaterialBuilder::TargetApi targetApi, MaterialBuilder::TargetApi codeGenTargetApi,
             filament::PostProcessStage variant, uint8_t firstSampler) noexcept;
+    // only for the stages where isComputeStage() is true
+    static const std::string createPostProcessComputeProgram(filament::driver::ShaderModel sm,
+            MaterialBuilder::TargetApi targetApi, MaterialBuilder::TargetApi codeGenTargetApi,
+            filament::PostProcessStage variant, uint8_t firstSampler) noexcept;
     static void generatePostProcessStageDefines(std::stringstream& vs, CodeGenerator const& cg,
             filament::PostProcessStage variant) noexcept;
 };
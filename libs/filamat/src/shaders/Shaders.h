@@ -42,6 +42,7 @@ extern const char main_fs[];
 extern const char main_vs[];
 extern const char post_process_fs[];
 extern const char post_process_vs[];
+extern const char post_process_cs[];
 extern const char shading_lit_fs[];
 extern const char shading_model_cloth_fs[];
 extern const char shading_model_standard_fs[];
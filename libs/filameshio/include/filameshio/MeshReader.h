@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMESHIO_MESHREADER_H
+#define TNT_FILAMESHIO_MESHREADER_H
+
+#include <utils/Entity.h>
+
+#include <stddef.h>
+
+#include <map>
+#include <string>
+
+namespace filament {
+    class Engine;
+    class VertexBuffer;
+    class IndexBuffer;
+    class MaterialInstance;
+}
+
+namespace utils {
+    class Path;
+}
+
+namespace filamesh {
+
+/**
+ * Loads the meshes produced by the filamesh tool (see tools/filamesh/README.md) into a
+ * renderable, a vertex buffer and an index buffer.
+ */
+class MeshReader {
+public:
+    struct Mesh {
+        utils::Entity renderable;
+        filament::VertexBuffer* vertexBuffer = nullptr;
+        filament::IndexBuffer* indexBuffer = nullptr;
+    };
+
+    // maps the material names found in the mesh to material instances, the parts whose
+    // material isn't in the map use the "DefaultMaterial" entry
+    using MaterialRegistry = std::map<std::string, filament::MaterialInstance*>;
+
+    using Callback = void(*)(void* buffer, size_t size, void* user);
+
+    /**
+     * Loads a mesh file. The file is memory-mapped, and its vertex and index data are given to
+     * the engine directly from the mapping: nothing is copied on the heap. The mapping is
+     * released once the driver has consumed both buffers.
+     *
+     * On failure, the returned mesh has a null renderable.
+     */
+    static Mesh loadMeshFromFile(filament::Engine* engine, const utils::Path& path,
+            const MaterialRegistry& materials);
+
+    /**
+     * Loads a mesh from a buffer that holds the content of a mesh file. The vertex and index data
+     * are given to the engine without copy, and destructor is called with (data, size, user)
+     * once the driver doesn't need them anymore, or before this returns on failure.
+     */
+    static Mesh loadMeshFromBuffer(filament::Engine* engine, void const* data, size_t size,
+            Callback destructor, void* user, const MaterialRegistry& materials);
+};
+
+} // namespace filamesh
+
+#endif // TNT_FILAMESHIO_MESHREADER_H
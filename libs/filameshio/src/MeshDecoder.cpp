@@ -0,0 +1,200 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MeshDecoder.h"
+
+#include <math/half.h>
+#include <math/vec4.h>
+
+#include <utils/compiler.h>
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <string.h>
+
+using namespace math;
+
+namespace filamesh {
+
+namespace {
+
+// inflates exactly size bytes
+bool inflate(void const* src, size_t srcSize, std::vector<uint8_t>& dst, size_t size) {
+    dst.resize(size);
+    uLongf dstSize = uLongf(size);
+    return uncompress(dst.data(), &dstSize, static_cast<Bytef const*>(src), uLong(srcSize)) == Z_OK
+            && dstSize == size;
+}
+
+// Undoes the byte planes and delta coding of N 16-bit words per element (see MeshEncoder).
+// The loops over planes don't depend on each other and are simple enough to be vectorized,
+// only the final prefix sum is sequential.
+template<size_t N>
+void decodeDeltas(uint8_t const* planes, size_t count, uint16_t* words) {
+    for (size_t c = 0; c < N; c++) {
+        uint8_t const* UTILS_RESTRICT lo = planes + count * c * 2;
+        uint8_t const* UTILS_RESTRICT hi = lo + count;
+        uint16_t* UTILS_RESTRICT out = words + count * c;
+        for (size_t i = 0; i < count; i++) {
+            const uint16_t z = uint16_t(lo[i] | (hi[i] << 8u));
+            out[i] = uint16_t((z >> 1u) ^ -(z & 1u));
+        }
+        uint16_t previous = 0;
+        for (size_t i = 0; i < count; i++) {
+            previous = out[i] = uint16_t(previous + out[i]);
+        }
+    }
+}
+
+template<size_t N>
+void decodePlanes(uint8_t const* planes, size_t count, uint8_t* dst, size_t stride) {
+    for (size_t b = 0; b < N; b++) {
+        uint8_t const* UTILS_RESTRICT in = planes + b * count;
+        uint8_t* UTILS_RESTRICT out = dst + b;
+        for (size_t i = 0; i < count; i++) {
+            out[i * stride] = in[i];
+        }
+    }
+}
+
+} // anonymous namespace
+
+bool MeshDecoder::decodePositions(void const* src, size_t size, size_t count,
+        float3 origin, float3 scale, void* dst, size_t stride) {
+    std::vector<uint8_t> planes;
+    if (!inflate(src, size, planes, count * 3 * sizeof(uint16_t))) {
+        return false;
+    }
+    std::vector<uint16_t> words(count * 3);
+    decodeDeltas<3>(planes.data(), count, words.data());
+    for (size_t c = 0; c < 3; c++) {
+        uint16_t const* UTILS_RESTRICT in = words.data() + count * c;
+        uint8_t* UTILS_RESTRICT out = static_cast<uint8_t*>(dst) + c * sizeof(half);
+        const float o = origin[c];
+        const float s = scale[c];
+        for (size_t i = 0; i < count; i++) {
+            *reinterpret_cast<half*>(out + i * stride) = half(o + float(in[i]) * s);
+        }
+    }
+    uint8_t* out = static_cast<uint8_t*>(dst) + 3 * sizeof(half);
+    for (size_t i = 0; i < count; i++) {
+        *reinterpret_cast<half*>(out + i * stride) = half(1.0f);
+    }
+    return true;
+}
+
+bool MeshDecoder::decodeTangents(void const* src, size_t size, size_t count,
+        void* dst, size_t stride) {
+    std::vector<uint8_t> planes;
+    if (!inflate(src, size, planes, count * sizeof(uint32_t))) {
+        return false;
+    }
+    std::vector<uint32_t> packed(count);
+    decodePlanes<4>(planes.data(), count, reinterpret_cast<uint8_t*>(packed.data()),
+            sizeof(uint32_t));
+
+    const float invSqrt2 = 1.0f / std::sqrt(2.0f);
+    for (size_t i = 0; i < count; i++) {
+        const uint32_t bits = packed[i];
+        const size_t largest = (bits >> 27u) & 0x3u;
+        const bool reflection = ((bits >> 29u) & 0x1u) != 0;
+        float4 q;
+        float sum = 0;
+        for (size_t c = 0, k = 0; c < 4; c++) {
+            if (c != largest) {
+                const float u = float((bits >> (k * 9u)) & 0x1FFu);
+                q[c] = (u * (2.0f / 511.0f) - 1.0f) * invSqrt2;
+                sum += q[c] * q[c];
+                k++;
+            }
+        }
+        q[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+        // restore the handedness of the tangent frame, stored in the sign of w
+        if ((q.w < 0) != reflection) {
+            q = -q;
+        }
+        short4* out = reinterpret_cast<short4*>(static_cast<uint8_t*>(dst) + i * stride);
+        *out = short4(round(clamp(q, -1.0f, 1.0f) * 32767.0f));
+    }
+    return true;
+}
+
+bool MeshDecoder::decodeColors(void const* src, size_t size, size_t count,
+        void* dst, size_t stride) {
+    std::vector<uint8_t> planes;
+    if (!inflate(src, size, planes, count * 4)) {
+        return false;
+    }
+    decodePlanes<4>(planes.data(), count, static_cast<uint8_t*>(dst), stride);
+    return true;
+}
+
+bool MeshDecoder::decodeUVs(void const* src, size_t size, size_t count,
+        void* dst, size_t stride) {
+    std::vector<uint8_t> planes;
+    if (!inflate(src, size, planes, count * 2 * sizeof(uint16_t))) {
+        return false;
+    }
+    std::vector<uint16_t> words(count * 2);
+    decodeDeltas<2>(planes.data(), count, words.data());
+    for (size_t c = 0; c < 2; c++) {
+        uint16_t const* UTILS_RESTRICT in = words.data() + count * c;
+        uint8_t* UTILS_RESTRICT out = static_cast<uint8_t*>(dst) + c * sizeof(uint16_t);
+        for (size_t i = 0; i < count; i++) {
+            memcpy(out + i * stride, &in[i], sizeof(uint16_t));
+        }
+    }
+    return true;
+}
+
+bool MeshDecoder::decodeIndices(void const* src, size_t size, size_t count,
+        void* dst, bool index16) {
+    // each index takes at most 5 bytes, see MeshEncoder::encodeIndices()
+    std::vector<uint8_t> bytes(count * 5);
+    uLongf length = uLongf(bytes.size());
+    if (uncompress(bytes.data(), &length, static_cast<Bytef const*>(src), uLong(size)) != Z_OK) {
+        return false;
+    }
+    uint8_t const* p = bytes.data();
+    uint8_t const* const end = p + length;
+    uint32_t previous = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t z = 0;
+        for (uint32_t shift = 0; ; shift += 7) {
+            if (p == end || shift > 28) {
+                return false;
+            }
+            const uint8_t b = *p++;
+            z |= uint32_t(b & 0x7Fu) << shift;
+            if (!(b & 0x80u)) {
+                break;
+            }
+        }
+        previous += (z >> 1u) ^ -(z & 1u);
+        if (index16) {
+            static_cast<uint16_t*>(dst)[i] = uint16_t(previous);
+        } else {
+            static_cast<uint32_t*>(dst)[i] = previous;
+        }
+    }
+    return true;
+}
+
+} // namespace filamesh
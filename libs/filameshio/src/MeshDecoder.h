@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMESHIO_MESHDECODER_H
+#define TNT_FILAMESHIO_MESHDECODER_H
+
+#include <math/vec3.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filamesh {
+
+/*
+ * Decodes the streams of the compressed mesh format, see tools/filamesh/README.md and the
+ * encoder in tools/filamesh/src/MeshEncoder.cpp. Each function decodes count elements from
+ * a zlib-compressed stream to dst, with the given stride between elements, and returns false
+ * if the stream is invalid. Streams are independent and can be decoded in parallel.
+ */
+class MeshDecoder {
+public:
+    enum Stream : uint32_t {
+        POSITIONS,
+        TANGENTS,
+        COLORS,
+        UV0,
+        UV1,
+        INDICES,
+        STREAM_COUNT
+    };
+
+    // to half4, with w = 1
+    static bool decodePositions(void const* src, size_t size, size_t count,
+            math::float3 origin, math::float3 scale, void* dst, size_t stride);
+
+    // to short4 (snorm16) quaternions
+    static bool decodeTangents(void const* src, size_t size, size_t count,
+            void* dst, size_t stride);
+
+    // to ubyte4
+    static bool decodeColors(void const* src, size_t size, size_t count,
+            void* dst, size_t stride);
+
+    // to half2
+    static bool decodeUVs(void const* src, size_t size, size_t count,
+            void* dst, size_t stride);
+
+    // to uint16 or uint32 indices
+    static bool decodeIndices(void const* src, size_t size, size_t count,
+            void* dst, bool index16);
+};
+
+} // namespace filamesh
+
+#endif // TNT_FILAMESHIO_MESHDECODER_H
@@ -0,0 +1,481 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <filameshio/MeshReader.h>
+
+#include "MeshDecoder.h"
+
+#include <filament/Box.h>
+#include <filament/Engine.h>
+#include <filament/IndexBuffer.h>
+#include <filament/MaterialInstance.h>
+#include <filament/RenderableManager.h>
+#include <filament/VertexBuffer.h>
+
+#include <utils/EntityManager.h>
+#include <utils/JobSystem.h>
+#include <utils/Log.h>
+#include <utils/Path.h>
+
+#include <math/half.h>
+#include <math/vec4.h>
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(WIN32)
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#else
+#    include <windows.h>
+#endif
+
+using namespace filament;
+using namespace math;
+using namespace utils;
+
+namespace filamesh {
+
+namespace {
+
+struct Header {
+    uint32_t version;
+    uint32_t parts;
+    Box      aabb;
+    uint32_t interleaved;
+    uint32_t offsetPosition;
+    uint32_t stridePosition;
+    uint32_t offsetTangents;
+    uint32_t strideTangents;
+    uint32_t offsetColor;
+    uint32_t strideColor;
+    uint32_t offsetUV0;
+    uint32_t strideUV0;
+    uint32_t offsetUV1;
+    uint32_t strideUV1;
+    uint32_t vertexCount;
+    uint32_t vertexSize;
+    uint32_t indexType;
+    uint32_t indexCount;
+    uint32_t indexSize;
+};
+
+struct Part {
+    uint32_t offset;
+    uint32_t indexCount;
+    uint32_t minIndex;
+    uint32_t maxIndex;
+    uint32_t materialID;
+    Box      aabb;
+};
+
+struct PartLevel {
+    uint32_t offset;
+    uint32_t indexCount;
+};
+
+// The vertex and index buffer descriptors both point into the same buffer, which is released
+// when the driver is done with the last one. The driver calls back from its own thread.
+struct SharedBuffer {
+    void const* data;
+    size_t size;
+    MeshReader::Callback destructor;
+    void* user;
+    std::atomic<uint32_t> references;
+
+    static void release(void*, size_t, void* user) {
+        SharedBuffer* buffer = static_cast<SharedBuffer*>(user);
+        if (buffer->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            if (buffer->destructor) {
+                buffer->destructor(const_cast<void*>(buffer->data), buffer->size, buffer->user);
+            }
+            delete buffer;
+        }
+    }
+};
+
+// reads a T at p and advances p, or returns false if that would read past end
+template<typename T>
+bool read(char const*& p, char const* end, T& value) {
+    if (size_t(end - p) < sizeof(T)) {
+        return false;
+    }
+    memcpy(&value, p, sizeof(T));
+    p += sizeof(T);
+    return true;
+}
+
+bool skip(char const*& p, char const* end, size_t size) {
+    if (size_t(end - p) < size) {
+        return false;
+    }
+    p += size;
+    return true;
+}
+
+bool hasUV1(Header const& header) {
+    return header.offsetUV1 != std::numeric_limits<uint32_t>::max() &&
+            header.strideUV1 != std::numeric_limits<uint32_t>::max();
+}
+
+struct CompressedStreams {
+    float3 origin;
+    float3 scale;
+    uint32_t sizes[MeshDecoder::STREAM_COUNT];
+    char const* data[MeshDecoder::STREAM_COUNT];
+};
+
+bool readCompressedStreams(char const*& p, char const* end, CompressedStreams& streams) {
+    if (!read(p, end, streams.origin) || !read(p, end, streams.scale)) {
+        return false;
+    }
+    for (uint32_t& size : streams.sizes) {
+        if (!read(p, end, size)) {
+            return false;
+        }
+    }
+    for (size_t s = 0; s < MeshDecoder::STREAM_COUNT; s++) {
+        streams.data[s] = p;
+        if (!skip(p, end, streams.sizes[s])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Decodes the streams in parallel, on the engine's job system, to buffers allocated with malloc
+bool decodeCompressedStreams(Engine& engine, Header const& header,
+        CompressedStreams const& streams, void** vertices, void** indices) {
+    const size_t count = header.vertexCount;
+    const bool index16 = header.indexType != 0;
+
+    // in non-interleaved mode the stride is 0 and the attributes are tightly packed
+    struct Attribute {
+        uint32_t offset;
+        uint32_t stride;
+        size_t size;
+    };
+    const Attribute attributes[] = {
+            { header.offsetPosition, header.stridePosition, sizeof(half4)  },
+            { header.offsetTangents, header.strideTangents, sizeof(short4) },
+            { header.offsetColor,    header.strideColor,    sizeof(ubyte4) },
+            { header.offsetUV0,      header.strideUV0,      sizeof(half2)  },
+            { header.offsetUV1,      header.strideUV1,      sizeof(half2)  },
+    };
+    for (size_t s = 0; s < MeshDecoder::UV1 + size_t(hasUV1(header)); s++) {
+        Attribute const& attribute = attributes[s];
+        const size_t stride = attribute.stride ? attribute.stride : attribute.size;
+        if (count && attribute.offset + (count - 1) * stride + attribute.size > header.vertexSize) {
+            return false;
+        }
+    }
+    if (header.indexSize != header.indexCount * (index16 ? sizeof(uint16_t) : sizeof(uint32_t))) {
+        return false;
+    }
+
+    uint8_t* vertexData = static_cast<uint8_t*>(malloc(header.vertexSize));
+    void* indexData = malloc(header.indexSize);
+
+    bool success[MeshDecoder::STREAM_COUNT] = { true, true, true, true, true, true };
+    auto decode = [&](size_t s) {
+        void const* src = streams.data[s];
+        const size_t size = streams.sizes[s];
+        if (s == MeshDecoder::INDICES) {
+            success[s] = MeshDecoder::decodeIndices(src, size, header.indexCount, indexData,
+                    index16);
+            return;
+        }
+        Attribute const& attribute = attributes[s];
+        uint8_t* dst = vertexData + attribute.offset;
+        const size_t stride = attribute.stride ? attribute.stride : attribute.size;
+        switch (s) {
+            case MeshDecoder::POSITIONS:
+                success[s] = MeshDecoder::decodePositions(src, size, count,
+                        streams.origin, streams.scale, dst, stride);
+                break;
+            case MeshDecoder::TANGENTS:
+                success[s] = MeshDecoder::decodeTangents(src, size, count, dst, stride);
+                break;
+            case MeshDecoder::COLORS:
+                success[s] = MeshDecoder::decodeColors(src, size, count, dst, stride);
+                break;
+            default:
+                success[s] = MeshDecoder::decodeUVs(src, size, count, dst, stride);
+                break;
+        }
+    };
+
+    JobSystem& js = engine.getJobSystem();
+    JobSystem::Job* root = js.createJob();
+    for (size_t s = 0; s < MeshDecoder::STREAM_COUNT; s++) {
+        if (s != MeshDecoder::UV1 || hasUV1(header)) {
+            js.run(jobs::createJob(js, root, std::cref(decode), s));
+        }
+    }
+    js.runAndWait(root);
+
+    if (std::find(std::begin(success), std::end(success), false) != std::end(success)) {
+        free(vertexData);
+        free(indexData);
+        return false;
+    }
+    *vertices = vertexData;
+    *indices = indexData;
+    return true;
+}
+
+#if !defined(WIN32)
+
+void unmapFile(void* data, size_t size, void*) {
+    munmap(data, size);
+}
+
+void const* mapFile(const Path& path, size_t* size) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat st;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        *size = size_t(st.st_size);
+        data = mmap(nullptr, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    // the mapping stays valid after the file is closed
+    close(fd);
+    return data != MAP_FAILED ? data : nullptr;
+}
+
+#else
+
+void unmapFile(void* data, size_t, void*) {
+    UnmapViewOfFile(data);
+}
+
+void const* mapFile(const Path& path, size_t* size) {
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return nullptr;
+    }
+    void const* data = nullptr;
+    LARGE_INTEGER fileSize;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping) {
+            *size = size_t(fileSize.QuadPart);
+            data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            // the view keeps the mapping alive
+            CloseHandle(mapping);
+        }
+    }
+    CloseHandle(file);
+    return data;
+}
+
+#endif
+
+} // anonymous namespace
+
+MeshReader::Mesh MeshReader::loadMeshFromFile(Engine* engine, const Path& path,
+        const MaterialRegistry& materials) {
+    size_t size = 0;
+    void const* data = mapFile(path, &size);
+    if (!data) {
+        slog.e << "Could not map the mesh file " << path << io::endl;
+        return {};
+    }
+    return loadMeshFromBuffer(engine, data, size, unmapFile, nullptr, materials);
+}
+
+MeshReader::Mesh MeshReader::loadMeshFromBuffer(Engine* engine, void const* data, size_t size,
+        Callback destructor, void* user, const MaterialRegistry& materials) {
+    Mesh mesh;
+
+    char const* p = static_cast<char const*>(data);
+    char const* const end = p + size;
+
+    auto fail = [&](const char* reason) {
+        slog.e << "Invalid mesh: " << reason << io::endl;
+        if (destructor) {
+            destructor(const_cast<void*>(data), size, user);
+        }
+        return Mesh{};
+    };
+
+    char magic[8];
+    if (!read(p, end, magic)) {
+        return fail("not a filamesh file");
+    }
+    const bool compressed = memcmp(magic, "FILAMESZ", sizeof(magic)) == 0;
+    if (!compressed && memcmp(magic, "FILAMESH", sizeof(magic)) != 0) {
+        return fail("not a filamesh file");
+    }
+
+    Header header;
+    if (!read(p, end, header)) {
+        return fail("truncated header");
+    }
+
+    char const* vertexData = p;
+    char const* indices = vertexData + header.vertexSize;
+    CompressedStreams streams;
+    if (compressed) {
+        if (!readCompressedStreams(p, end, streams)) {
+            return fail("truncated compressed streams");
+        }
+    } else if (!skip(p, end, header.vertexSize) || !skip(p, end, header.indexSize)) {
+        return fail("truncated vertex or index data");
+    }
+
+    std::vector<Part> parts(header.parts);
+    for (Part& part : parts) {
+        if (!read(p, end, part)) {
+            return fail("truncated parts");
+        }
+    }
+
+    uint32_t materialCount;
+    if (!read(p, end, materialCount)) {
+        return fail("truncated materials");
+    }
+    std::vector<std::string> partsMaterial(materialCount);
+    for (std::string& name : partsMaterial) {
+        uint32_t nameLength;
+        if (!read(p, end, nameLength) || size_t(end - p) <= nameLength) {
+            return fail("truncated material name");
+        }
+        name.assign(p, nameLength);
+        p += nameLength + 1; // null terminated
+    }
+
+    // levels of detail were added in version 2
+    uint32_t levelCount = 1;
+    if (header.version >= 2) {
+        if (!read(p, end, levelCount) || levelCount == 0) {
+            return fail("truncated levels of detail");
+        }
+        levelCount = std::min(levelCount,
+                uint32_t(RenderableManager::MAX_LEVEL_OF_DETAIL_COUNT));
+    }
+    std::vector<float> screenSizes(levelCount);
+    std::vector<PartLevel> partLevels((levelCount - 1) * header.parts);
+    for (size_t l = 1; l < levelCount; l++) {
+        if (!read(p, end, screenSizes[l])) {
+            return fail("truncated levels of detail");
+        }
+        for (size_t i = 0; i < header.parts; i++) {
+            if (!read(p, end, partLevels[(l - 1) * header.parts + i])) {
+                return fail("truncated levels of detail");
+            }
+        }
+    }
+
+    IndexBuffer::BufferDescriptor indexBuffer;
+    VertexBuffer::BufferDescriptor vertexBuffer;
+    if (compressed) {
+        // the decoded data is the only copy we make, the compressed data is released right away
+        void* decodedVertices = nullptr;
+        void* decodedIndices = nullptr;
+        if (!decodeCompressedStreams(*engine, header, streams,
+                &decodedVertices, &decodedIndices)) {
+            return fail("invalid compressed streams");
+        }
+        if (destructor) {
+            destructor(const_cast<void*>(data), size, user);
+        }
+        auto freeBuffer = [](void* buffer, size_t, void*) { free(buffer); };
+        indexBuffer = { decodedIndices, header.indexSize, freeBuffer };
+        vertexBuffer = { decodedVertices, header.vertexSize, freeBuffer };
+    } else {
+        // nothing can fail past this point, the buffer is now released by the driver
+        SharedBuffer* buffer = new SharedBuffer{ data, size, destructor, user, { 2 } };
+        indexBuffer = { indices, header.indexSize, SharedBuffer::release, buffer };
+        vertexBuffer = { vertexData, header.vertexSize, SharedBuffer::release, buffer };
+    }
+
+    mesh.indexBuffer = IndexBuffer::Builder()
+            .indexCount(header.indexCount)
+            .bufferType(header.indexType ? IndexBuffer::IndexType::USHORT
+                                         : IndexBuffer::IndexType::UINT)
+            .build(*engine);
+
+    mesh.indexBuffer->setBuffer(*engine, std::move(indexBuffer));
+
+    VertexBuffer::Builder vbb;
+    vbb.vertexCount(header.vertexCount)
+        .bufferCount(1)
+        .normalized(VertexAttribute::TANGENTS)
+        .normalized(VertexAttribute::COLOR)
+        .attribute(VertexAttribute::POSITION, 0, VertexBuffer::AttributeType::HALF4,
+                header.offsetPosition, uint8_t(header.stridePosition))
+        .attribute(VertexAttribute::TANGENTS, 0, VertexBuffer::AttributeType::SHORT4,
+                header.offsetTangents, uint8_t(header.strideTangents))
+        .attribute(VertexAttribute::COLOR,    0, VertexBuffer::AttributeType::UBYTE4,
+                header.offsetColor, uint8_t(header.strideColor))
+        .attribute(VertexAttribute::UV0,      0, VertexBuffer::AttributeType::HALF2,
+                header.offsetUV0, uint8_t(header.strideUV0));
+
+    if (hasUV1(header)) {
+        vbb.attribute(VertexAttribute::UV1,   0, VertexBuffer::AttributeType::HALF2,
+                header.offsetUV1, uint8_t(header.strideUV1));
+    }
+
+    mesh.vertexBuffer = vbb.build(*engine);
+
+    mesh.vertexBuffer->setBufferAt(*engine, 0, std::move(vertexBuffer));
+
+    RenderableManager::Builder builder(header.parts);
+    builder.boundingBox(header.aabb);
+
+    for (size_t i = 0; i < header.parts; i++) {
+        builder.geometry(i, RenderableManager::PrimitiveType::TRIANGLES,
+                mesh.vertexBuffer, mesh.indexBuffer, parts[i].offset,
+                parts[i].minIndex, parts[i].maxIndex, parts[i].indexCount);
+        const uint32_t materialID = parts[i].materialID;
+        auto m = materialID < partsMaterial.size() ?
+                materials.find(partsMaterial[materialID]) : materials.end();
+        if (m != materials.end()) {
+            builder.material(i, m->second);
+        } else {
+            builder.material(i, materials.at("DefaultMaterial"));
+        }
+    }
+
+    for (uint8_t level = 1; level < levelCount; level++) {
+        builder.levelOfDetail(level, screenSizes[level]);
+        for (size_t i = 0; i < header.parts; i++) {
+            PartLevel const& partLevel = partLevels[(level - 1) * header.parts + i];
+            builder.geometry(i, level, RenderableManager::PrimitiveType::TRIANGLES,
+                    mesh.vertexBuffer, mesh.indexBuffer, partLevel.offset,
+                    parts[i].minIndex, parts[i].maxIndex, partLevel.indexCount);
+        }
+    }
+
+    mesh.renderable = EntityManager::get().create();
+    builder.build(*engine, mesh.renderable);
+
+    return mesh;
+}
+
+} // namespace filamesh
@@ -18,9 +18,15 @@
 #define IMAGE_IMAGEOPS_H
 
 #include <image/LinearImage.h>
+#include <image/PackedImage.h>
 
+#include <functional>
 #include <initializer_list>
 
+namespace utils {
+class JobSystem;
+} // namespace utils
+
 namespace image {
 
 // Concatenates images horizontally to create a filmstrip atlas, similar to numpy's hstack.
@@ -34,6 +40,8 @@ LinearImage verticalStack(LinearImage const* img, size_t count);
 // Horizontally or vertically mirror the given image.
 LinearImage horizontalFlip(const LinearImage& image);
 LinearImage verticalFlip(const LinearImage& image);
+PackedImage horizontalFlip(const PackedImage& image);
+PackedImage verticalFlip(const PackedImage& image);
 
 // Transforms normals (components live in [-1,+1]) into colors (components live in [0,+1]).
 LinearImage vectorsToColors(const LinearImage& image);
@@ -51,10 +59,42 @@ LinearImage transpose(const LinearImage& image);
 // Extracts pixels by specifying a crop window where (0,0) is the top-left corner of the image.
 // The boundary is specified as Left Top Right Bottom.
 LinearImage cropRegion(const LinearImage& image, uint32_t l, uint32_t t, uint32_t r, uint32_t b);
+PackedImage cropRegion(const PackedImage& image, uint32_t l, uint32_t t, uint32_t r, uint32_t b);
 
 // Lexicographically compares two images, similar to memcmp.
 int compare(const LinearImage& a, const LinearImage& b, float epsilon = 0.0f);
 
+// Options of diff().
+struct DiffOptions {
+    float epsilon = 0.0f;       // channels which differ by no more than this are the same
+    uint32_t tileSize = 0;      // width and height of the tiles of ImageDiff::tiles, 0 for none
+    bool mask = false;          // whether to produce ImageDiff::mask
+    bool earlyOut = false;      // whether to stop at the first rows containing a difference
+};
+
+// Differences between two images, see diff().
+struct ImageDiff {
+    size_t count = 0;           // the pixels with a channel differing by more than epsilon
+    float maxError = 0.0f;      // the largest absolute difference of a channel
+    double meanSquaredError = 0.0;
+    float psnr = 0.0f;          // peak signal-to-noise ratio in dB for a peak of 1, or infinity
+    LinearImage mask;           // single-channel, 1 for the differing pixels and 0 elsewhere
+    LinearImage tiles;          // single-channel, the largest absolute difference in each tile
+};
+
+// Measures the differences between two images of the same dimensions, the images must not be
+// empty. With earlyOut, the comparison stops as soon as a difference is found: count is then
+// non-zero, but the other results only cover the rows compared so far. The rows are compared
+// in parallel on the JobSystem, when one is given.
+ImageDiff diff(const LinearImage& a, const LinearImage& b, DiffOptions const& options = {},
+        utils::JobSystem* jobSystem = nullptr);
+
+// Calls rows(start, count) for ranges of rows which cover [0, height) once. The ranges are
+// processed in parallel on the JobSystem, which must have adopted the calling thread, or all at
+// once on the calling thread without one.
+void processRows(size_t height, std::function<void(uint32_t start, uint32_t count)> const& rows,
+        utils::JobSystem* jobSystem);
+
 } // namespace image
 
 #endif /* IMAGE_LINEARIMAGE_H */
@@ -18,6 +18,11 @@
 #define IMAGE_IMAGESAMPLER_H
 
 #include <image/LinearImage.h>
+#include <image/PackedImage.h>
+
+namespace utils {
+class JobSystem;
+} // namespace utils
 
 namespace image {
 
@@ -96,6 +101,9 @@ struct ImageSampler {
     Boundary north;
     Boundary west;
     Boundary south;
+    // If set, the rows are resampled in parallel on this JobSystem, which must have adopted the
+    // calling thread.
+    utils::JobSystem* jobSystem = nullptr;
 };
 
 /**
@@ -108,7 +116,16 @@ LinearImage resampleImage(const LinearImage& source, uint32_t width, uint32_t he
  * Resizes the given linear image using a simplified API that takes target dimensions and filter.
  */
 LinearImage resampleImage(const LinearImage& source, uint32_t width, uint32_t height,
-        Filter filter = Filter::DEFAULT);
+        Filter filter = Filter::DEFAULT, utils::JobSystem* jobSystem = nullptr);
+
+/**
+ * Resizes a packed image. Its rows are unpacked as they're read, the result holds floats.
+ */
+LinearImage resampleImage(const PackedImage& source, uint32_t width, uint32_t height,
+        const ImageSampler& sampler);
+
+LinearImage resampleImage(const PackedImage& source, uint32_t width, uint32_t height,
+        Filter filter = Filter::DEFAULT, utils::JobSystem* jobSystem = nullptr);
 
 /**
  * Computes a single sample for the given texture coordinate and writes the resulting color
@@ -137,13 +154,21 @@ void computeSingleSample(const LinearImage& source, float x, float y, SingleSamp
  * index 0, the quarter-size image is at index 1, etc. Please note that the original-sized image is
  * not included.
  */
-void generateMipmaps(const LinearImage& source, Filter, LinearImage* result, uint32_t mipCount);
+void generateMipmaps(const LinearImage& source, Filter, LinearImage* result, uint32_t mipCount,
+        utils::JobSystem* jobSystem = nullptr);
+
+/**
+ * Generates the miplevels of a packed image, they're stored like the source image.
+ */
+void generateMipmaps(const PackedImage& source, Filter, PackedImage* result, uint32_t mipCount,
+        utils::JobSystem* jobSystem = nullptr);
 
 /**
  * Returns the number of miplevels it would take to downsample the given image down to 1x1. This
  * number does not include the original image (i.e. mip 0).
  */
 uint32_t getMipmapCount(const LinearImage& source);
+uint32_t getMipmapCount(uint32_t width, uint32_t height);
 
 /**
  * Given the string name of a filter, converts it to uppercase and returns the corresponding
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGE_PACKEDIMAGE_H
+#define IMAGE_PACKEDIMAGE_H
+
+#include <image/LinearImage.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace image {
+
+/**
+ * PackedImage is a handle to a row-major grid of pixels like LinearImage, but each channel is
+ * stored as an 8-bit normalized integer, a half float or a float. It takes a quarter or half the
+ * memory of a LinearImage, which matters for large source images that are only read.
+ *
+ * Pixels are converted to and from floats one row at a time, so that algorithms can work on
+ * packed images without ever unpacking them entirely. 8-bit channels are clamped to [0, 1] and
+ * half float channels to the half float range.
+ *
+ * The pixel data has the same shared ownership semantics as LinearImage.
+ */
+class PackedImage {
+public:
+    enum class Storage : uint8_t {
+        U8,     // 8-bit unsigned normalized
+        F16,    // half float
+        F32     // float
+    };
+
+    /**
+     * Allocates a zeroed-out image.
+     */
+    PackedImage(uint32_t width, uint32_t height, uint32_t channels, Storage storage);
+
+    /**
+     * Converts a LinearImage.
+     */
+    PackedImage(const LinearImage& image, Storage storage);
+
+    /**
+     * Creates an empty (invalid) image.
+     */
+    PackedImage() = default;
+
+    /**
+     * Converts the whole image to a LinearImage.
+     */
+    LinearImage unpack() const;
+
+    /**
+     * Converts a row to width * channels floats, or from width * channels floats.
+     */
+    void unpackRow(uint32_t row, float* dst) const;
+    void packRow(uint32_t row, float const* src);
+
+    /**
+     * Gets a pointer to the pixel data at the given column and row. (not bounds checked)
+     */
+    void* getPixelRef(uint32_t column = 0, uint32_t row = 0) {
+        return mData.get() + (column + size_t(row) * mWidth) * getBytesPerPixel();
+    }
+
+    void const* getPixelRef(uint32_t column = 0, uint32_t row = 0) const {
+        return mData.get() + (column + size_t(row) * mWidth) * getBytesPerPixel();
+    }
+
+    uint32_t getWidth() const { return mWidth; }
+    uint32_t getHeight() const { return mHeight; }
+    uint32_t getChannels() const { return mChannels; }
+    Storage getStorage() const { return mStorage; }
+    size_t getBytesPerPixel() const { return mChannels * getBytesPerChannel(mStorage); }
+    size_t getBytesPerRow() const { return mWidth * getBytesPerPixel(); }
+    void reset() { *this = PackedImage(); }
+    bool isValid() const { return bool(mData); }
+
+    static size_t getBytesPerChannel(Storage storage) {
+        return storage == Storage::U8 ? 1 : (storage == Storage::F16 ? 2 : 4);
+    }
+
+private:
+    std::shared_ptr<uint8_t> mData;
+    uint32_t mWidth = 0;
+    uint32_t mHeight = 0;
+    uint32_t mChannels = 0;
+    Storage mStorage = Storage::F32;
+};
+
+} // namespace image
+
+#endif /* IMAGE_PACKEDIMAGE_H */
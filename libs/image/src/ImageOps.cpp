@@ -17,9 +17,14 @@
 #include <image/ImageOps.h>
 
 #include <math/vec3.h>
+#include <utils/JobSystem.h>
 #include <utils/Panic.h>
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <mutex>
 
 using namespace math;
 
@@ -116,6 +121,29 @@ LinearImage verticalFlip(const LinearImage& image) {
     return result;
 }
 
+PackedImage horizontalFlip(const PackedImage& image) {
+    const uint32_t width = image.getWidth();
+    const uint32_t height = image.getHeight();
+    const size_t bpp = image.getBytesPerPixel();
+    PackedImage result(width, height, image.getChannels(), image.getStorage());
+    for (uint32_t row = 0; row < height; ++row) {
+        for (uint32_t col = 0; col < width; ++col) {
+            memcpy(result.getPixelRef(width - 1 - col, row), image.getPixelRef(col, row), bpp);
+        }
+    }
+    return result;
+}
+
+PackedImage verticalFlip(const PackedImage& image) {
+    const uint32_t height = image.getHeight();
+    PackedImage result(image.getWidth(), height, image.getChannels(), image.getStorage());
+    for (uint32_t row = 0; row < height; ++row) {
+        memcpy(result.getPixelRef(0, height - 1 - row), image.getPixelRef(0, row),
+                image.getBytesPerRow());
+    }
+    return result;
+}
+
 LinearImage vectorsToColors(const LinearImage& image) {
     ASSERT_PRECONDITION(image.getChannels() == 3, "Must be a 3-channel image.");
     const uint32_t width = image.getWidth(), height = image.getHeight();
@@ -210,6 +238,18 @@ LinearImage cropRegion(const LinearImage& image, uint32_t left, uint32_t top, ui
     return result;
 }
 
+PackedImage cropRegion(const PackedImage& image, uint32_t left, uint32_t top, uint32_t right,
+        uint32_t bottom) {
+    uint32_t width = right - left;
+    uint32_t height = bottom - top;
+    PackedImage result(width, height, image.getChannels(), image.getStorage());
+    for (uint32_t row = 0; row < height; ++row) {
+        memcpy(result.getPixelRef(0, row), image.getPixelRef(left, top + row),
+                result.getBytesPerRow());
+    }
+    return result;
+}
+
 int compare(const LinearImage& a, const LinearImage& b, float epsilon) {
     auto w = a.getWidth();
     auto h = a.getHeight();
@@ -223,4 +263,119 @@ int compare(const LinearImage& a, const LinearImage& b, float epsilon) {
             [epsilon](float x, float y) { return x < y - epsilon; });
 }
 
+// Returns the largest absolute difference of the n floats, and adds their squares to squares.
+// This is the inner loop of diff(), written to be vectorized.
+static float diffFloats(float const* UTILS_RESTRICT a, float const* UTILS_RESTRICT b, size_t n,
+        float& squares) {
+    float error = 0.0f;
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        const float d = std::abs(a[i] - b[i]);
+        error = std::max(error, d);
+        sum += d * d;
+    }
+    squares += sum;
+    return error;
+}
+
+ImageDiff diff(const LinearImage& a, const LinearImage& b, DiffOptions const& options,
+        utils::JobSystem* jobSystem) {
+    const uint32_t width = a.getWidth();
+    const uint32_t height = a.getHeight();
+    const uint32_t channels = a.getChannels();
+    ASSERT_PRECONDITION(width && height && channels, "Empty image.");
+    ASSERT_PRECONDITION(b.getWidth() == width && b.getHeight() == height &&
+            b.getChannels() == channels, "Images of different dimensions.");
+
+    ImageDiff result;
+    const float epsilon = options.epsilon;
+    const uint32_t tileSize = options.tileSize;
+    if (options.mask) {
+        result.mask = LinearImage(width, height, 1);
+    }
+    if (tileSize) {
+        result.tiles = LinearImage((width + tileSize - 1) / tileSize,
+                (height + tileSize - 1) / tileSize, 1);
+    }
+
+    // The rows are processed by bands of the height of a tile, so that each tile is only written
+    // by one job, and by segments of the width of a tile.
+    const uint32_t bandHeight = tileSize ? tileSize : 1;
+    const uint32_t segmentWidth = tileSize ? tileSize : width;
+    const uint32_t bands = (height + bandHeight - 1) / bandHeight;
+
+    std::mutex lock;
+    std::atomic<bool> stop = { false };
+    processRows(bands, [&](uint32_t start, uint32_t count) {
+        size_t differences = 0;
+        float maxError = 0.0f;
+        double squares = 0.0;
+        for (uint32_t band = start; band < start + count; ++band) {
+            if (stop.load(std::memory_order_relaxed)) {
+                break;
+            }
+            float* const tiles = tileSize ? result.tiles.getPixelRef(0, band) : nullptr;
+            const uint32_t end = std::min((band + 1) * bandHeight, height);
+            for (uint32_t y = band * bandHeight; y < end; ++y) {
+                float const* const pa = a.getPixelRef(0, y);
+                float const* const pb = b.getPixelRef(0, y);
+                float rowError = 0.0f;
+                float rowSquares = 0.0f;
+                for (uint32_t x = 0, tile = 0; x < width; x += segmentWidth, ++tile) {
+                    const uint32_t n = std::min(segmentWidth, width - x) * channels;
+                    const float error = diffFloats(pa + x * channels, pb + x * channels, n,
+                            rowSquares);
+                    if (tiles) {
+                        tiles[tile] = std::max(tiles[tile], error);
+                    }
+                    rowError = std::max(rowError, error);
+                }
+                squares += rowSquares;
+                maxError = std::max(maxError, rowError);
+
+                // the pixels are only looked at when the row has differences
+                if (rowError > epsilon) {
+                    float* const mask = options.mask ? result.mask.getPixelRef(0, y) : nullptr;
+                    for (uint32_t x = 0; x < width; ++x) {
+                        bool different = false;
+                        for (uint32_t c = 0; c < channels; ++c) {
+                            const size_t i = x * channels + c;
+                            different |= std::abs(pa[i] - pb[i]) > epsilon;
+                        }
+                        differences += different;
+                        if (mask) {
+                            mask[x] = different ? 1.0f : 0.0f;
+                        }
+                    }
+                }
+            }
+            if (options.earlyOut && differences) {
+                stop.store(true, std::memory_order_relaxed);
+            }
+        }
+        std::lock_guard<std::mutex> guard(lock);
+        result.count += differences;
+        result.maxError = std::max(result.maxError, maxError);
+        result.meanSquaredError += squares;
+    }, jobSystem);
+
+    result.meanSquaredError /= double(width) * height * channels;
+    result.psnr = result.meanSquaredError > 0.0 ?
+            float(-10.0 * std::log10(result.meanSquaredError)) :
+            std::numeric_limits<float>::infinity();
+    return result;
+}
+
+void processRows(size_t height, std::function<void(uint32_t start, uint32_t count)> const& rows,
+        utils::JobSystem* jobSystem) {
+    if (jobSystem && height > 1) {
+        // the jobs only hold a reference to the functor, it outlives them
+        auto job = utils::jobs::parallel_for(*jobSystem, nullptr, 0, uint32_t(height),
+                std::cref(rows), utils::jobs::CountSplitter<4, 8>());
+        jobSystem->runAndWait(job);
+    } else {
+        rows(0, uint32_t(height));
+    }
+}
+
 } // namespace image
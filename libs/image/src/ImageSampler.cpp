@@ -16,12 +16,18 @@
 
 #include <image/ImageSampler.h>
 #include <image/ImageOps.h>
+#include <image/PackedImage.h>
 
 #include <math/vec3.h>
-#include <utils/Panic.h>
+#include <utils/compiler.h>
 #include <utils/CString.h>
+#include <utils/Panic.h>
+#include <utils/JobSystem.h>
 
+#include <algorithm>
+#include <limits>
 #include <memory>
+#include <type_traits>
 #include <vector>
 #include <unordered_map>
 
@@ -169,22 +175,41 @@ void generateMadProgram(uint32_t ntarget, uint32_t nsource, float left, float ri
     }
 }
 
-// Transforms a MAD program intended for single-channel data into a program intended for
-// multi-channel data.
-void expandMadProgram(uint32_t nchannels, MadProgram* program) {
-    if (nchannels == 1) {
-        return;
+// Executes a MAD program over a row of N-channel samples. The instructions of a target sample are
+// contiguous, so each target is accumulated in registers and written once. With N known at compile
+// time, the channels are vectorized by the compiler.
+template<uint32_t N>
+void executeMadProgram(MadProgram const& program, float const* UTILS_RESTRICT source,
+        float* UTILS_RESTRICT target) {
+    MadInstruction const* mad = program.data();
+    MadInstruction const* const end = mad + program.size();
+    while (mad != end) {
+        const uint32_t targetIndex = mad->targetIndex;
+        float sum[N] = {};
+        do {
+            float const* src = source + mad->sourceIndex * int32_t(N);
+            const float weight = mad->weight;
+            for (uint32_t c = 0; c < N; ++c) {
+                sum[c] += src[c] * weight;
+            }
+        } while (++mad != end && mad->targetIndex == targetIndex);
+        float* dst = target + targetIndex * N;
+        for (uint32_t c = 0; c < N; ++c) {
+            dst[c] = sum[c];
+        }
     }
-    MadProgram result;
-    result.reserve(program->size() * nchannels);
-    for (auto mad : *program) {
-        mad.sourceIndex *= nchannels;
-        mad.targetIndex *= nchannels;
-        for (uint32_t j = 0; j < nchannels; ++j, ++mad.sourceIndex, ++mad.targetIndex) {
-            result.push_back(mad);
+}
+
+// Same as above for any number of channels, target must be zero-initialized.
+void executeMadProgram(MadProgram const& program, float const* UTILS_RESTRICT source,
+        float* UTILS_RESTRICT target, uint32_t nchan) {
+    for (auto mad : program) {
+        float const* src = source + mad.sourceIndex * int32_t(nchan);
+        float* dst = target + mad.targetIndex * nchan;
+        for (uint32_t c = 0; c < nchan; ++c) {
+            dst[c] += src[c] * mad.weight;
         }
     }
-    program->swap(result);
 }
 
 FilterFunction createFilterFunction(Filter ftype) {
@@ -213,8 +238,24 @@ void normalize(LinearImage& image) {
     }
 }
 
-LinearImage resampleImage1D(const LinearImage& source, MadProgram* program,
-        uint32_t twidth, Filter filter, float left, float right, float filterRadiusMultiplier) {
+// Gives access to the rows of the source of a resampling pass. Packed rows are converted into
+// the given scratch buffer as they're loaded, so the source never needs to be entirely unpacked.
+float const* getSourceRow(const LinearImage& image, uint32_t row, float*) {
+    return image.getPixelRef(0, row);
+}
+
+float const* getSourceRow(const PackedImage& image, uint32_t row, float* scratch) {
+    if (image.getStorage() == PackedImage::Storage::F32) {
+        return static_cast<float const*>(image.getPixelRef(0, row));
+    }
+    image.unpackRow(row, scratch);
+    return scratch;
+}
+
+template<typename SOURCE>
+LinearImage resampleImage1D(const SOURCE& source, MadProgram* program,
+        uint32_t twidth, Filter filter, float left, float right, float filterRadiusMultiplier,
+        utils::JobSystem* js = nullptr) {
     const uint32_t swidth = source.getWidth();
     const uint32_t sheight = source.getHeight();
     const uint32_t nchan = source.getChannels();
@@ -222,40 +263,55 @@ LinearImage resampleImage1D(const LinearImage& source, MadProgram* program,
     if (filter == Filter::DEFAULT) filter = mag ? Filter::MITCHELL : Filter::LANCZOS;
     const FilterFunction hfn = createFilterFunction(filter);
 
-    // Generate a flat list of multiply-add (MAD) instructions.
+    // Generate a flat list of multiply-add (MAD) instructions, they apply to all the channels.
     program->clear();
     generateMadProgram(twidth, swidth, left, right, hfn, filterRadiusMultiplier, program);
-    expandMadProgram(nchan, program);
 
     // Allocate the target image.
     LinearImage result(twidth, sheight, nchan);
-    float const* sourceRow = source.getPixelRef();
-    float* targetRow = result.getPixelRef();
-
-    // The MIN filter is special because it starts with non-zero values and ignores filter weights.
-    if (filter == Filter::MINIMUM) {
-        for (uint32_t n = 0; n < twidth * sheight * nchan; ++n) {
-            targetRow[n] = std::numeric_limits<float>::max();
+    float* const target0 = result.getPixelRef();
+    MadProgram const& mads = *program;
+
+    // Resize the rows [start, start + count) horizontally by executing the MAD instructions.
+    auto resizeRows = [=, &source, &mads](uint32_t start, uint32_t count) {
+        std::unique_ptr<float[]> scratch;
+        if (std::is_same<SOURCE, PackedImage>::value) {
+            scratch.reset(new float[size_t(swidth) * nchan]);
         }
-        for (uint32_t row = 0; row < sheight; ++row) {
-            for (auto mad : *program) {
-                const float a = sourceRow[mad.sourceIndex];
-                const float b = targetRow[mad.targetIndex];
-                targetRow[mad.targetIndex] = std::min(a, b);
+        for (uint32_t row = start; row < start + count; ++row) {
+            float const* sourceRow = getSourceRow(source, row, scratch.get());
+            float* targetRow = target0 + size_t(row) * twidth * nchan;
+
+            // The MIN filter is special because it starts with non-zero values and ignores
+            // filter weights.
+            if (filter == Filter::MINIMUM) {
+                std::fill_n(targetRow, twidth * nchan, std::numeric_limits<float>::max());
+                for (auto mad : mads) {
+                    float const* src = sourceRow + mad.sourceIndex * int32_t(nchan);
+                    float* dst = targetRow + mad.targetIndex * nchan;
+                    for (uint32_t c = 0; c < nchan; ++c) {
+                        dst[c] = std::min(src[c], dst[c]);
+                    }
+                }
+                continue;
             }
-            targetRow += twidth * nchan;
-            sourceRow += swidth * nchan;
-        }
-        return result;
-    }
 
-    // Resize the image horizontally by executing the MAD instructions over each row.
-    for (uint32_t row = 0; row < sheight; ++row) {
-        for (auto mad : *program) {
-            targetRow[mad.targetIndex] += sourceRow[mad.sourceIndex] * mad.weight;
+            switch (nchan) {
+                case 1: executeMadProgram<1>(mads, sourceRow, targetRow); break;
+                case 2: executeMadProgram<2>(mads, sourceRow, targetRow); break;
+                case 3: executeMadProgram<3>(mads, sourceRow, targetRow); break;
+                case 4: executeMadProgram<4>(mads, sourceRow, targetRow); break;
+                default: executeMadProgram(mads, sourceRow, targetRow, nchan); break;
+            }
         }
-        targetRow += twidth * nchan;
-        sourceRow += swidth * nchan;
+    };
+
+    if (js && sheight > 1) {
+        auto job = utils::jobs::parallel_for(*js, nullptr, 0, sheight,
+                std::cref(resizeRows), utils::jobs::CountSplitter<16, 8>());
+        js->runAndWait(job);
+    } else {
+        resizeRows(0, sheight);
     }
 
     // Perform post processing for the current pass.
@@ -273,7 +329,8 @@ SingleSample::~SingleSample() {
     delete[] data;
 }
 
-LinearImage resampleImage(const LinearImage& source, uint32_t width, uint32_t height,
+template<typename SOURCE>
+static LinearImage resampleImageImpl(const SOURCE& source, uint32_t width, uint32_t height,
         const ImageSampler& sampler) {
     ASSERT_PRECONDITION(
         sampler.east.mode == Boundary::EXCLUDE &&
@@ -289,16 +346,37 @@ LinearImage resampleImage(const LinearImage& source, uint32_t width, uint32_t he
     const float bottom = sampler.sourceRegion.bottom;
     MadProgram program;
     LinearImage result;
-    result = transpose(resampleImage1D(source, &program, width, hfilter, left, right, radius));
-    result = transpose(resampleImage1D(result, &program, height, vfilter, top, bottom, radius));
+    utils::JobSystem* const js = sampler.jobSystem;
+    result = transpose(resampleImage1D(source, &program, width, hfilter, left, right, radius, js));
+    result = transpose(resampleImage1D(result, &program, height, vfilter, top, bottom, radius, js));
     return result;
 }
 
 LinearImage resampleImage(const LinearImage& source, uint32_t width, uint32_t height,
-        Filter filter) {
+        const ImageSampler& sampler) {
+    return resampleImageImpl(source, width, height, sampler);
+}
+
+LinearImage resampleImage(const PackedImage& source, uint32_t width, uint32_t height,
+        const ImageSampler& sampler) {
+    return resampleImageImpl(source, width, height, sampler);
+}
+
+LinearImage resampleImage(const PackedImage& source, uint32_t width, uint32_t height,
+        Filter filter, utils::JobSystem* jobSystem) {
+    return resampleImage(source, width, height, ImageSampler {
+        .horizontalFilter = filter,
+        .verticalFilter = filter,
+        .jobSystem = jobSystem
+    });
+}
+
+LinearImage resampleImage(const LinearImage& source, uint32_t width, uint32_t height,
+        Filter filter, utils::JobSystem* jobSystem) {
     return resampleImage(source, width, height, ImageSampler {
         .horizontalFilter = filter,
-        .verticalFilter = filter
+        .verticalFilter = filter,
+        .jobSystem = jobSystem
     });
 }
 
@@ -324,20 +402,36 @@ void computeSingleSample(const LinearImage& source, float x, float y, SingleSamp
 
 // Unlike traditional mipmap generation, our implementation generates all levels from the original
 // image, under the premise that this produces a higher quality result.
-void generateMipmaps(const LinearImage& source, Filter filter, LinearImage* result, uint32_t mips) {
+void generateMipmaps(const LinearImage& source, Filter filter, LinearImage* result, uint32_t mips,
+        utils::JobSystem* jobSystem) {
     mips = std::min(mips, getMipmapCount(source));
     uint32_t width = source.getWidth();
     uint32_t height = source.getHeight();
     for (uint32_t n = 0; n < mips; ++n) {
        width = std::max(width >> 1, 1u);
        height = std::max(height >> 1, 1u);
-       result[n] = resampleImage(source, width, height, filter);
+       result[n] = resampleImage(source, width, height, filter, jobSystem);
     }
 }
 
-uint32_t getMipmapCount(const LinearImage& source) {
+void generateMipmaps(const PackedImage& source, Filter filter, PackedImage* result,
+        uint32_t mips, utils::JobSystem* jobSystem) {
+    mips = std::min(mips, getMipmapCount(source.getWidth(), source.getHeight()));
     uint32_t width = source.getWidth();
     uint32_t height = source.getHeight();
+    for (uint32_t n = 0; n < mips; ++n) {
+       width = std::max(width >> 1, 1u);
+       height = std::max(height >> 1, 1u);
+       result[n] = PackedImage(resampleImage(source, width, height, filter, jobSystem),
+               source.getStorage());
+    }
+}
+
+uint32_t getMipmapCount(const LinearImage& source) {
+    return getMipmapCount(source.getWidth(), source.getHeight());
+}
+
+uint32_t getMipmapCount(uint32_t width, uint32_t height) {
     uint32_t count = 0;
     while (width > 1 || height > 1) {
         ++count;
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <image/PackedImage.h>
+
+#include <math/half.h>
+
+#include <algorithm>
+#include <cstring> // for memset
+
+namespace image {
+
+namespace {
+
+struct U8ToFloat {
+    float table[256];
+    U8ToFloat() {
+        for (int i = 0; i < 256; ++i) {
+            table[i] = i / 255.0f;
+        }
+    }
+};
+
+const U8ToFloat sU8ToFloat;
+
+} // anonymous namespace
+
+PackedImage::PackedImage(uint32_t width, uint32_t height, uint32_t channels, Storage storage) :
+        mWidth(width), mHeight(height), mChannels(channels), mStorage(storage) {
+    const size_t size = getBytesPerRow() * height;
+    uint8_t* bytes = new uint8_t[size];
+    memset(bytes, 0, size);
+    mData = std::shared_ptr<uint8_t>(bytes, std::default_delete<uint8_t[]>());
+}
+
+PackedImage::PackedImage(const LinearImage& image, Storage storage) :
+        PackedImage(image.getWidth(), image.getHeight(), image.getChannels(), storage) {
+    for (uint32_t row = 0; row < mHeight; ++row) {
+        packRow(row, image.getPixelRef(0, row));
+    }
+}
+
+LinearImage PackedImage::unpack() const {
+    LinearImage result(mWidth, mHeight, mChannels);
+    for (uint32_t row = 0; row < mHeight; ++row) {
+        unpackRow(row, result.getPixelRef(0, row));
+    }
+    return result;
+}
+
+void PackedImage::unpackRow(uint32_t row, float* dst) const {
+    const size_t count = size_t(mWidth) * mChannels;
+    switch (mStorage) {
+        case Storage::U8: {
+            uint8_t const* src = static_cast<uint8_t const*>(getPixelRef(0, row));
+            for (size_t i = 0; i < count; ++i) {
+                dst[i] = sU8ToFloat.table[src[i]];
+            }
+            break;
+        }
+        case Storage::F16: {
+            math::half const* src = static_cast<math::half const*>(getPixelRef(0, row));
+            for (size_t i = 0; i < count; ++i) {
+                dst[i] = src[i];
+            }
+            break;
+        }
+        case Storage::F32:
+            memcpy(dst, getPixelRef(0, row), count * sizeof(float));
+            break;
+    }
+}
+
+void PackedImage::packRow(uint32_t row, float const* src) {
+    const size_t count = size_t(mWidth) * mChannels;
+    switch (mStorage) {
+        case Storage::U8: {
+            uint8_t* dst = static_cast<uint8_t*>(getPixelRef(0, row));
+            for (size_t i = 0; i < count; ++i) {
+                dst[i] = uint8_t(std::min(std::max(src[i], 0.0f), 1.0f) * 255.0f + 0.5f);
+            }
+            break;
+        }
+        case Storage::F16: {
+            math::half* dst = static_cast<math::half*>(getPixelRef(0, row));
+            for (size_t i = 0; i < count; ++i) {
+                dst[i] = math::half(std::min(std::max(src[i], -65504.0f), 65504.0f));
+            }
+            break;
+        }
+        case Storage::F32:
+            memcpy(getPixelRef(0, row), src, count * sizeof(float));
+            break;
+    }
+}
+
+} // namespace image
@@ -18,6 +18,7 @@
 #include <image/ImageOps.h>
 #include <image/ImageSampler.h>
 #include <image/LinearImage.h>
+#include <image/PackedImage.h>
 
 #include <imageio/ImageDecoder.h>
 #include <imageio/ImageDiffer.h>
@@ -25,16 +26,21 @@
 
 #include <gtest/gtest.h>
 
+#include <utils/JobSystem.h>
 #include <utils/Panic.h>
 #include <utils/Path.h>
 
 #include <math/vec3.h>
 #include <math/vec4.h>
 
+#include <cmath>
 #include <fstream>
+#include <initializer_list>
 #include <string>
 #include <sstream>
 
+#include <string.h>
+
 using std::istringstream;
 using std::string;
 using std::swap;
@@ -307,6 +313,160 @@ TEST_F(ImageTest, Mipmaps) { // NOLINT
     }
 }
 
+TEST_F(ImageTest, ParallelResampling) { // NOLINT
+    utils::JobSystem js;
+    js.adopt();
+
+    // Cover the specialized channel counts and the generic fallback.
+    LinearImage color = resampleImage(createColorFromAscii("44444 41014 40704 41014 44444"),
+            50, 40, Filter::NEAREST);
+    LinearImage gray = resampleImage(createGrayFromAscii("01 10"), 50, 40, Filter::NEAREST);
+    LinearImage wide(50, 40, 5);
+    for (uint32_t n = 0; n < 50 * 40 * 5; ++n) {
+        wide.getPixelRef()[n] = float(n % 7) / 7.0f;
+    }
+
+    const Filter filters[] = { Filter::BOX, Filter::MITCHELL, Filter::LANCZOS, Filter::MINIMUM };
+    for (const LinearImage& src : { color, gray, wide }) {
+        for (Filter filter : filters) {
+            for (uint32_t width : { 17u, 123u }) {
+                LinearImage serial = resampleImage(src, width, 77, filter);
+                LinearImage parallel = resampleImage(src, width, 77, filter, &js);
+                const uint32_t nfloats = width * 77 * src.getChannels();
+                ASSERT_EQ(memcmp(serial.getPixelRef(), parallel.getPixelRef(),
+                        nfloats * sizeof(float)), 0);
+            }
+        }
+    }
+
+    js.emancipate();
+}
+
+TEST_F(ImageTest, ProcessRows) { // NOLINT
+    utils::JobSystem js;
+    js.adopt();
+
+    // Each row must be processed exactly once, with or without a JobSystem.
+    for (utils::JobSystem* jobSystem : { (utils::JobSystem*) nullptr, &js }) {
+        for (uint32_t height : { 0u, 1u, 7u, 1000u }) {
+            LinearImage image(3, height, 1);
+            processRows(height, [&image](uint32_t start, uint32_t count) {
+                for (uint32_t y = start; y < start + count; ++y) {
+                    image.getPixelRef(0, y)[0] += 1.0f;
+                }
+            }, jobSystem);
+            for (uint32_t y = 0; y < height; ++y) {
+                ASSERT_EQ(image.getPixelRef(0, y)[0], 1.0f);
+            }
+        }
+    }
+
+    js.emancipate();
+}
+
+TEST_F(ImageTest, Diff) { // NOLINT
+    utils::JobSystem js;
+    js.adopt();
+
+    LinearImage a(37, 23, 3);
+    for (uint32_t n = 0; n < 37 * 23 * 3; ++n) {
+        a.getPixelRef()[n] = float(n % 11) / 10.0f;
+    }
+    LinearImage b(37, 23, 3);
+    memcpy(b.getPixelRef(), a.getPixelRef(), 37 * 23 * 3 * sizeof(float));
+
+    DiffOptions options;
+    options.tileSize = 8;
+    options.mask = true;
+
+    // Identical images have no differences, and an infinite PSNR.
+    ImageDiff same = diff(a, b, options, &js);
+    ASSERT_EQ(same.count, 0u);
+    ASSERT_EQ(same.maxError, 0.0f);
+    ASSERT_EQ(same.meanSquaredError, 0.0);
+    ASSERT_TRUE(std::isinf(same.psnr));
+    ASSERT_EQ(same.tiles.getWidth(), 5u);
+    ASSERT_EQ(same.tiles.getHeight(), 3u);
+
+    // Two pixels differ, one of them by less than epsilon, in different tiles.
+    b.getPixelRef(3, 2)[1] += 0.5f;
+    b.getPixelRef(36, 22)[2] -= 0.25f;
+    options.epsilon = 0.3f;
+    for (utils::JobSystem* jobSystem : { (utils::JobSystem*) nullptr, &js }) {
+        ImageDiff result = diff(a, b, options, jobSystem);
+        ASSERT_EQ(result.count, 1u);
+        ASSERT_FLOAT_EQ(result.maxError, 0.5f);
+        ASSERT_NEAR(result.meanSquaredError, (0.25 + 0.0625) / (37 * 23 * 3), 1e-9);
+        ASSERT_EQ(result.mask.getPixelRef(3, 2)[0], 1.0f);
+        ASSERT_EQ(result.mask.getPixelRef(36, 22)[0], 0.0f);
+        ASSERT_FLOAT_EQ(result.tiles.getPixelRef(0, 0)[0], 0.5f);
+        ASSERT_FLOAT_EQ(result.tiles.getPixelRef(4, 2)[0], 0.25f);
+        ASSERT_EQ(result.tiles.getPixelRef(1, 1)[0], 0.0f);
+    }
+
+    // The early out still reports the difference.
+    options = {};
+    options.earlyOut = true;
+    ASSERT_GT(diff(a, b, options, &js).count, 0u);
+
+    js.emancipate();
+}
+
+TEST_F(ImageTest, PackedImages) { // NOLINT
+    LinearImage src(37, 23, 3);
+    for (uint32_t n = 0; n < 37 * 23 * 3; ++n) {
+        src.getPixelRef()[n] = float(n % 11) / 10.0f;
+    }
+
+    // 8-bit and half float storage round-trip within their precision.
+    const PackedImage::Storage storages[] = {
+        PackedImage::Storage::U8, PackedImage::Storage::F16, PackedImage::Storage::F32 };
+    const float epsilons[] = { 0.5f / 255.0f, 1.0f / 1024.0f, 0.0f };
+    for (int i = 0; i < 3; ++i) {
+        PackedImage packed(src, storages[i]);
+        ASSERT_EQ(packed.getBytesPerPixel(),
+                3 * PackedImage::getBytesPerChannel(storages[i]));
+        ASSERT_EQ(compare(packed.unpack(), src, epsilons[i]), 0);
+        ASSERT_EQ(compare(src, packed.unpack(), epsilons[i]), 0);
+    }
+
+    // Values out of the 8-bit range are clamped.
+    LinearImage hdr(1, 1, 2);
+    hdr.getPixelRef()[0] = -1.0f;
+    hdr.getPixelRef()[1] = 2.0f;
+    LinearImage clamped = PackedImage(hdr, PackedImage::Storage::U8).unpack();
+    ASSERT_EQ(clamped.getPixelRef()[0], 0.0f);
+    ASSERT_EQ(clamped.getPixelRef()[1], 1.0f);
+
+    // Resampling a packed image is the same as resampling its unpacked pixels.
+    for (PackedImage::Storage storage : storages) {
+        PackedImage packed(src, storage);
+        LinearImage expected = resampleImage(packed.unpack(), 17, 41, Filter::MITCHELL);
+        LinearImage result = resampleImage(packed, 17, 41, Filter::MITCHELL);
+        ASSERT_EQ(memcmp(result.getPixelRef(), expected.getPixelRef(),
+                17 * 41 * 3 * sizeof(float)), 0);
+    }
+
+    // Packed image ops match their LinearImage counterparts.
+    PackedImage packed(src, PackedImage::Storage::U8);
+    LinearImage unpacked = packed.unpack();
+    auto same = [](const LinearImage& a, const LinearImage& b) {
+        return a.getWidth() == b.getWidth() && a.getHeight() == b.getHeight() &&
+                !memcmp(a.getPixelRef(), b.getPixelRef(),
+                        a.getWidth() * a.getHeight() * a.getChannels() * sizeof(float));
+    };
+    ASSERT_TRUE(same(horizontalFlip(packed).unpack(), horizontalFlip(unpacked)));
+    ASSERT_TRUE(same(verticalFlip(packed).unpack(), verticalFlip(unpacked)));
+    ASSERT_TRUE(same(cropRegion(packed, 3, 4, 20, 21).unpack(),
+            cropRegion(unpacked, 3, 4, 20, 21)));
+
+    PackedImage mips[5];
+    generateMipmaps(packed, Filter::BOX, mips, 5);
+    ASSERT_EQ(mips[4].getWidth(), 1u);
+    ASSERT_EQ(mips[4].getHeight(), 1u);
+    ASSERT_EQ(mips[0].getStorage(), PackedImage::Storage::U8);
+}
+
 static void printUsage(const char* name) {
     string exec_name(utils::Path(name).getName());
     string usage(
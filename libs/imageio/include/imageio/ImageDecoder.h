@@ -18,8 +18,11 @@
 #define IMAGE_IMAGEDECODER_H_
 
 #include <iosfwd>
+#include <memory>
 #include <string>
 
+#include <stdint.h>
+
 #include <image/LinearImage.h>
 
 namespace image {
@@ -34,11 +37,33 @@ public:
     static LinearImage decode(std::istream& stream, const std::string& sourceName,
             ColorSpace sourceSpace = ColorSpace::SRGB);
 
+    // Receives the rows of an image as they're decoded, so that large images can be processed
+    // without ever being entirely in memory.
+    class RowHandler {
+    public:
+        virtual ~RowHandler() = default;
+
+        // Called once before any row, returning false aborts the decoding.
+        virtual bool begin(uint32_t width, uint32_t height, uint32_t channels) = 0;
+
+        // Called once per row, not necessarily in order. The row holds width * channels linear
+        // floats and is only valid for the duration of the call.
+        virtual void row(uint32_t y, float const* data) = 0;
+    };
+
+    // Decodes an image row by row. Non-interlaced PNGs and HDRs are decoded one row at a time,
+    // the other formats are decoded entirely first. Returns false if the image can't be decoded.
+    static bool decode(std::istream& stream, const std::string& sourceName, RowHandler& handler,
+            ColorSpace sourceSpace = ColorSpace::SRGB);
+
     class Decoder {
     public:
         virtual LinearImage decode() = 0;
         virtual ~Decoder() = default;
 
+        // By default, decodes the whole image and then hands its rows over.
+        virtual bool decodeRows(RowHandler& handler);
+
         ColorSpace getColorSpace() const noexcept {
             return mColorSpace;
         }
@@ -52,6 +77,9 @@ public:
     };
 
 private:
+    static std::unique_ptr<Decoder> createDecoder(std::istream& stream,
+            const std::string& sourceName, ColorSpace sourceSpace);
+
     enum class Format {
         NONE,
         PNG,
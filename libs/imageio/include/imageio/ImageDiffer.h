@@ -18,6 +18,10 @@
 
 #include <utils/Path.h>
 
+namespace utils {
+class JobSystem;
+} // namespace utils
+
 namespace image {
 
 enum class ComparisonMode {
@@ -29,6 +33,8 @@ enum class ComparisonMode {
 // Saves an image to disk or does a load-and-compare, depending on comparison mode.
 // This makes it easy for unit tests to have compare / update commands.
 // The passed-in image is the "result image" and the expected image is the "golden image".
-void updateOrCompare(LinearImage result, const utils::Path& golden, ComparisonMode, float epsilon);
+// The images are compared in parallel on the JobSystem, when one is given.
+void updateOrCompare(LinearImage result, const utils::Path& golden, ComparisonMode, float epsilon,
+        utils::JobSystem* jobSystem = nullptr);
 
 }  // namespace image
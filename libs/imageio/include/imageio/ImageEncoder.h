@@ -22,6 +22,8 @@
 
 #include <image/LinearImage.h>
 
+#include <utils/JobSystem.h>
+
 namespace image {
 
 class ImageEncoder {
@@ -40,12 +42,24 @@ public:
                     // Default: 16 bit
         DDS_LINEAR, // 8-bit, 16-bit or 32-bit linear RGB, 1, 2 or 3 channels
                     // Default: 16 bit
+        KTX,        // ETC2 or DXT1 compressed sRGB, 1 or 3 channels
+                    // Default: ETC2
+        KTX_LINEAR, // ETC2 or DXT1 compressed linear RGB, 1 or 3 channels
+                    // Default: ETC2
     };
 
     // the encode function only expects images that store pixels as floats
     static void encode(std::ostream& stream, Format format, const LinearImage& image,
             const std::string& compression, const std::string& destName);
 
+    // Encodes the image into the file at path, on a job run as a child of parent: the file is
+    // written once parent is waited for. This lets many images be encoded at once, the files
+    // being the same as the ones written by encode(). The pixels of the image must not change
+    // until then. Errors are reported to stderr.
+    static void encode(utils::JobSystem& js, utils::JobSystem::Job* parent,
+            const std::string& path, Format format, const LinearImage& image,
+            const std::string& compression);
+
     static Format chooseFormat(const std::string& name, bool forceLinear = false);
     static std::string chooseExtension(Format format);
 
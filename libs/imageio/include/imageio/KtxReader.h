@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGE_KTXREADER_H_
+#define IMAGE_KTXREADER_H_
+
+#include <memory>
+#include <string>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace image {
+
+/**
+ * KtxReader gives access to the texels of a KTX 1.1 or KTX 2.0 file as they're stored on disk,
+ * without decoding them. The file is memory-mapped, so the levels can be handed to the GPU
+ * without being copied or converted.
+ *
+ * Array textures, 3D textures and supercompressed KTX 2.0 files are not supported.
+ */
+class KtxReader {
+public:
+    // The faces of a mipmap level. They're stored one after the other, faceStride bytes apart.
+    struct Level {
+        uint8_t const* data;
+        size_t faceSize;
+        size_t faceStride;
+    };
+
+    // Memory-maps a KTX file, returns nullptr if it can't be read or isn't supported. The data
+    // stays mapped as long as a reference to the returned object exists.
+    static std::shared_ptr<KtxReader> open(const std::string& path);
+
+    ~KtxReader();
+
+    KtxReader(const KtxReader&) = delete;
+    KtxReader& operator=(const KtxReader&) = delete;
+
+    uint32_t getWidth() const noexcept { return mWidth; }
+    uint32_t getHeight() const noexcept { return mHeight; }
+    uint32_t getLevelCount() const noexcept { return mLevelCount; }
+    uint32_t getFaceCount() const noexcept { return mFaceCount; }
+
+    // The OpenGL internal format of the texels. The Vulkan format of KTX 2.0 files is translated,
+    // 0 is returned if there's no equivalent.
+    uint32_t getGlInternalFormat() const noexcept { return mGlInternalFormat; }
+
+    // The rows of uncompressed levels are padded to this alignment.
+    uint32_t getRowAlignment() const noexcept { return mRowAlignment; }
+
+    Level getLevel(uint32_t level) const noexcept { return mLevels[level]; }
+
+private:
+    KtxReader() noexcept = default;
+
+    bool parseKtx1() noexcept;
+    bool parseKtx2() noexcept;
+
+    uint8_t const* mData = nullptr;
+    size_t mSize = 0;
+    bool mMapped = false;
+
+    uint32_t mWidth = 0;
+    uint32_t mHeight = 0;
+    uint32_t mLevelCount = 0;
+    uint32_t mFaceCount = 0;
+    uint32_t mGlInternalFormat = 0;
+    uint32_t mRowAlignment = 1;
+    std::unique_ptr<Level[]> mLevels;
+};
+
+} // namespace image
+
+#endif /* IMAGE_KTXREADER_H_ */
@@ -0,0 +1,314 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BlockCompression.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <math/vec3.h>
+
+using namespace math;
+
+namespace image {
+
+namespace {
+
+// ------------------------------------------------------------------------------------------------
+// ETC2
+// ------------------------------------------------------------------------------------------------
+
+// The 8 modifier tables of ETC1/ETC2, the selectors pick +small, +large, -small or -large.
+const int ETC_MODIFIERS[8][2] = {
+        {  2,   8 }, {  5,  17 }, {  9,  29 }, { 13,  42 },
+        { 18,  60 }, { 24,  80 }, { 33, 106 }, { 47, 183 }
+};
+
+struct EtcSubblock {
+    uint32_t table;
+    uint8_t selectors[8];
+    uint32_t error;
+};
+
+// Returns the texel indices (y * 4 + x) of a subblock. Without flip the block is split in two
+// 2x4 subblocks side by side, with flip it's split in two 4x2 subblocks on top of each other.
+void getSubblockTexels(bool flip, uint32_t subblock, uint8_t* texels) noexcept {
+    for (uint32_t i = 0; i < 8; i++) {
+        const uint32_t u = subblock * 2 + (i & 1);
+        const uint32_t v = i >> 1;
+        texels[i] = uint8_t(flip ? u * 4 + v : v * 4 + u);
+    }
+}
+
+// Finds the modifier table and the selectors that best approximate a subblock around a base color.
+EtcSubblock fitEtcSubblock(uint8_t const* texels, uint8_t const* indices, int3 base) noexcept {
+    EtcSubblock best = { 0, {}, std::numeric_limits<uint32_t>::max() };
+    for (uint32_t t = 0; t < 8; t++) {
+        EtcSubblock candidate = { t, {}, 0 };
+        for (uint32_t i = 0; i < 8 && candidate.error < best.error; i++) {
+            uint8_t const* texel = texels + indices[i] * 3;
+            uint32_t bestError = std::numeric_limits<uint32_t>::max();
+            for (uint8_t s = 0; s < 4; s++) {
+                // bit 0 of the selector picks the large modifier, bit 1 negates it
+                const int modifier = (s & 2) ? -ETC_MODIFIERS[t][s & 1] : ETC_MODIFIERS[t][s & 1];
+                uint32_t error = 0;
+                for (uint32_t c = 0; c < 3; c++) {
+                    const int d = std::min(std::max(base[c] + modifier, 0), 255) - texel[c];
+                    error += uint32_t(d * d);
+                }
+                if (error < bestError) {
+                    bestError = error;
+                    candidate.selectors[i] = s;
+                }
+            }
+            candidate.error += bestError;
+        }
+        if (candidate.error < best.error) {
+            best = candidate;
+        }
+    }
+    return best;
+}
+
+float3 getAverage(uint8_t const* texels, uint8_t const* indices) noexcept {
+    float3 sum = 0;
+    for (uint32_t i = 0; i < 8; i++) {
+        uint8_t const* texel = texels + indices[i] * 3;
+        sum += float3{ texel[0], texel[1], texel[2] };
+    }
+    return sum / 8.0f;
+}
+
+int3 quantize(float3 color, int maxValue) noexcept {
+    const float3 q = color * (maxValue / 255.0f) + 0.5f;
+    return clamp(int3{ int(q.x), int(q.y), int(q.z) }, 0, maxValue);
+}
+
+// Expands colors quantized to 4 or 5 bits back to 8 bits, by replicating the high bits.
+int3 expand(int3 c, int bits) noexcept {
+    const int shift = 8 - bits;
+    const int rshift = bits - shift;
+    return int3{ c.r << shift | c.r >> rshift, c.g << shift | c.g >> rshift,
+            c.b << shift | c.b >> rshift };
+}
+
+struct EtcCandidate {
+    bool flip;
+    bool differential;
+    int3 colors[2];     // quantized to 4 bits (individual mode) or 5 bits (differential mode)
+    EtcSubblock subblocks[2];
+
+    uint32_t getError() const noexcept { return subblocks[0].error + subblocks[1].error; }
+
+    void write(uint8_t* block) const noexcept {
+        uint64_t bits = 0;
+        if (differential) {
+            const int3 delta = colors[1] - colors[0];
+            bits |= uint64_t(colors[0].r) << 59 | uint64_t(delta.r & 7) << 56;
+            bits |= uint64_t(colors[0].g) << 51 | uint64_t(delta.g & 7) << 48;
+            bits |= uint64_t(colors[0].b) << 43 | uint64_t(delta.b & 7) << 40;
+        } else {
+            bits |= uint64_t(colors[0].r) << 60 | uint64_t(colors[1].r) << 56;
+            bits |= uint64_t(colors[0].g) << 52 | uint64_t(colors[1].g) << 48;
+            bits |= uint64_t(colors[0].b) << 44 | uint64_t(colors[1].b) << 40;
+        }
+        bits |= uint64_t(subblocks[0].table) << 37 | uint64_t(subblocks[1].table) << 34;
+        bits |= uint64_t(differential) << 33 | uint64_t(flip) << 32;
+
+        // the selectors are stored column after column, msb and lsb in separate halves
+        for (uint32_t s = 0; s < 2; s++) {
+            uint8_t indices[8];
+            getSubblockTexels(flip, s, indices);
+            for (uint32_t i = 0; i < 8; i++) {
+                const uint32_t x = indices[i] & 3u;
+                const uint32_t y = indices[i] >> 2u;
+                const uint32_t bit = x * 4 + y;
+                const uint8_t selector = subblocks[s].selectors[i];
+                bits |= uint64_t(selector >> 1) << (16 + bit) | uint64_t(selector & 1) << bit;
+            }
+        }
+
+        for (uint32_t i = 0; i < 8; i++) {
+            block[i] = uint8_t(bits >> (56 - i * 8));
+        }
+    }
+};
+
+// ------------------------------------------------------------------------------------------------
+// DXT1
+// ------------------------------------------------------------------------------------------------
+
+uint16_t to565(float3 color) noexcept {
+    const int3 c = int3{ quantize(color, 31).r, quantize(color, 63).g, quantize(color, 31).b };
+    return uint16_t(c.r << 11 | c.g << 5 | c.b);
+}
+
+int3 from565(uint16_t c) noexcept {
+    const int r = c >> 11, g = (c >> 5) & 0x3f, b = c & 0x1f;
+    return int3{ r << 3 | r >> 2, g << 2 | g >> 4, b << 3 | b >> 2 };
+}
+
+struct DxtCandidate {
+    uint16_t colors[2];
+    uint8_t indices[16];
+    uint32_t error;
+
+    void write(uint8_t* block) const noexcept {
+        uint32_t bits = 0;
+        for (uint32_t i = 0; i < 16; i++) {
+            bits |= uint32_t(indices[i]) << (i * 2);
+        }
+        block[0] = uint8_t(colors[0]);
+        block[1] = uint8_t(colors[0] >> 8);
+        block[2] = uint8_t(colors[1]);
+        block[3] = uint8_t(colors[1] >> 8);
+        for (uint32_t i = 0; i < 4; i++) {
+            block[4 + i] = uint8_t(bits >> (i * 8));
+        }
+    }
+};
+
+// Weight of the first endpoint for each index, in the 4 colors mode.
+const float DXT_WEIGHTS[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+DxtCandidate fitDxtEndpoints(uint8_t const* texels, uint16_t c0, uint16_t c1) noexcept {
+    // the 4 colors mode requires the first endpoint to be greater, when they're equal all the
+    // texels use index 0 in the 3 colors mode, which is the same color
+    DxtCandidate result = { { std::max(c0, c1), std::min(c0, c1) }, {}, 0 };
+    const int3 e0 = from565(result.colors[0]);
+    const int3 e1 = from565(result.colors[1]);
+    const int3 palette[4] = { e0, e1, (e0 * 2 + e1) / 3, (e0 + e1 * 2) / 3 };
+    const uint32_t paletteSize = result.colors[0] == result.colors[1] ? 1 : 4;
+    for (uint32_t i = 0; i < 16; i++) {
+        const int3 texel = int3{ texels[i * 3], texels[i * 3 + 1], texels[i * 3 + 2] };
+        uint32_t bestError = std::numeric_limits<uint32_t>::max();
+        for (uint8_t k = 0; k < paletteSize; k++) {
+            const int3 d = palette[k] - texel;
+            const uint32_t error = uint32_t(dot(d, d));
+            if (error < bestError) {
+                bestError = error;
+                result.indices[i] = k;
+            }
+        }
+        result.error += bestError;
+    }
+    return result;
+}
+
+} // anonymous namespace
+
+void compressBlockETC2(uint8_t const* texels, uint8_t* block) noexcept {
+    EtcCandidate best;
+    uint32_t bestError = std::numeric_limits<uint32_t>::max();
+    for (bool flip : { false, true }) {
+        uint8_t indices[2][8];
+        getSubblockTexels(flip, 0, indices[0]);
+        getSubblockTexels(flip, 1, indices[1]);
+        const float3 averages[2] = {
+                getAverage(texels, indices[0]), getAverage(texels, indices[1]) };
+
+        for (bool differential : { false, true }) {
+            EtcCandidate candidate;
+            candidate.flip = flip;
+            candidate.differential = differential;
+            int3 bases[2];
+            if (differential) {
+                // the second color is a 3 bits signed delta from the first one, it must not
+                // overflow, or the block would be decoded in one of the other ETC2 modes
+                const int3 c0 = quantize(averages[0], 31);
+                const int3 c1 = c0 + clamp(quantize(averages[1], 31) - c0, -4, 3);
+                candidate.colors[0] = c0;
+                candidate.colors[1] = c1;
+                bases[0] = expand(c0, 5);
+                bases[1] = expand(c1, 5);
+            } else {
+                const int3 c0 = quantize(averages[0], 15);
+                const int3 c1 = quantize(averages[1], 15);
+                candidate.colors[0] = c0;
+                candidate.colors[1] = c1;
+                bases[0] = expand(c0, 4);
+                bases[1] = expand(c1, 4);
+            }
+            candidate.subblocks[0] = fitEtcSubblock(texels, indices[0], bases[0]);
+            candidate.subblocks[1] = fitEtcSubblock(texels, indices[1], bases[1]);
+            if (candidate.getError() < bestError) {
+                bestError = candidate.getError();
+                best = candidate;
+            }
+        }
+    }
+    best.write(block);
+}
+
+void compressBlockDXT1(uint8_t const* texels, uint8_t* block) noexcept {
+    float3 colors[16];
+    float3 mean = 0;
+    for (uint32_t i = 0; i < 16; i++) {
+        colors[i] = float3{ texels[i * 3], texels[i * 3 + 1], texels[i * 3 + 2] };
+        mean += colors[i];
+    }
+    mean /= 16.0f;
+
+    // the endpoints are the extent of the texels along their principal axis
+    float3 cov[3] = {};
+    for (uint32_t i = 0; i < 16; i++) {
+        const float3 d = colors[i] - mean;
+        cov[0] += d.x * d;
+        cov[1] += d.y * d;
+        cov[2] += d.z * d;
+    }
+    float3 axis = { 1, 1, 1 };
+    for (uint32_t i = 0; i < 4; i++) {
+        axis = cov[0] * axis.x + cov[1] * axis.y + cov[2] * axis.z;
+        const float l = length(axis);
+        axis = l > 0 ? axis / l : float3{ 0 };
+    }
+    float tmin = 0, tmax = 0;
+    for (uint32_t i = 0; i < 16; i++) {
+        const float t = dot(colors[i] - mean, axis);
+        tmin = std::min(tmin, t);
+        tmax = std::max(tmax, t);
+    }
+    DxtCandidate best = fitDxtEndpoints(texels,
+            to565(mean + axis * tmax), to565(mean + axis * tmin));
+
+    // refine the endpoints once, with a least-squares fit of the texels to the chosen indices
+    if (best.colors[0] != best.colors[1]) {
+        float aa = 0, bb = 0, ab = 0;
+        float3 ax = 0, bx = 0;
+        for (uint32_t i = 0; i < 16; i++) {
+            const float w = DXT_WEIGHTS[best.indices[i]];
+            aa += w * w;
+            bb += (1 - w) * (1 - w);
+            ab += w * (1 - w);
+            ax += w * colors[i];
+            bx += (1 - w) * colors[i];
+        }
+        const float det = aa * bb - ab * ab;
+        if (std::abs(det) > std::numeric_limits<float>::epsilon()) {
+            const float3 e0 = clamp((ax * bb - bx * ab) / det, 0.0f, 255.0f);
+            const float3 e1 = clamp((bx * aa - ax * ab) / det, 0.0f, 255.0f);
+            DxtCandidate refined = fitDxtEndpoints(texels, to565(e0), to565(e1));
+            if (refined.error < best.error) {
+                best = refined;
+            }
+        }
+    }
+    best.write(block);
+}
+
+} // namespace image
@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IMAGE_BLOCKCOMPRESSION_H_
+#define IMAGE_BLOCKCOMPRESSION_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace image {
+
+// Size in bytes of a compressed 4x4 block, for both formats below.
+constexpr size_t BLOCK_COMPRESSION_BLOCK_SIZE = 8;
+
+// Compresses a 4x4 block of 8-bit RGB texels, stored row after row, to ETC2 RGB8. Only the
+// modes shared with ETC1 are used, so the result is also a valid ETC1 block.
+void compressBlockETC2(uint8_t const* texels, uint8_t* block) noexcept;
+
+// Compresses a 4x4 block of 8-bit RGB texels, stored row after row, to DXT1 (BC1) without alpha.
+void compressBlockDXT1(uint8_t const* texels, uint8_t* block) noexcept;
+
+} // namespace image
+
+#endif /* IMAGE_BLOCKCOMPRESSION_H_ */
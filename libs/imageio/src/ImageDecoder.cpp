@@ -19,6 +19,7 @@
 #include <imageio/ImageDecoder.h>
 
 #include <cstdint>
+#include <cstdlib> // for free
 #include <cstring> // for memcmp
 #include <istream>
 #include <limits>
@@ -62,6 +63,10 @@ private:
 
     // ImageDecoder::Decoder interface
     virtual LinearImage decode() override;
+    virtual bool decodeRows(ImageDecoder::RowHandler& handler) override;
+
+    void readInfo();
+    void convertRow(uint8_t const* src, float* dst) const;
 
     static void cb_error(png_structp, png_const_charp);
     static void cb_stream(png_structp png, png_bytep buffer, png_size_t size);
@@ -73,6 +78,12 @@ private:
     png_infop mInfo = nullptr;
     std::istream& mStream;
     std::streampos mStreamStartPos;
+
+    // set by readInfo()
+    int mColorType = 0;
+    uint32_t mWidth = 0;
+    uint32_t mHeight = 0;
+    size_t mRowBytes = 0;
 };
 
 // -----------------------------------------------------------------------------------------------
@@ -91,6 +102,7 @@ private:
 
     // ImageDecoder::Decoder interface
     virtual LinearImage decode() override;
+    virtual bool decodeRows(ImageDecoder::RowHandler& handler) override;
 
     static const char sigRadiance[];
     static const char sigRGBE[];
@@ -136,6 +148,7 @@ private:
 
     // ImageDecoder::Decoder interface
     virtual LinearImage decode() override;
+    virtual bool decodeRows(ImageDecoder::RowHandler& handler) override;
 
     static const char sig[];
     std::istream& mStream;
@@ -145,8 +158,8 @@ private:
 
 // -----------------------------------------------------------------------------------------------
 
-LinearImage ImageDecoder::decode(std::istream& stream, const std::string& sourceName,
-        ColorSpace sourceSpace) {
+std::unique_ptr<ImageDecoder::Decoder> ImageDecoder::createDecoder(std::istream& stream,
+        const std::string& sourceName, ColorSpace sourceSpace) {
 
     Format format = Format::NONE;
 
@@ -169,7 +182,7 @@ LinearImage ImageDecoder::decode(std::istream& stream, const std::string& source
     std::unique_ptr<Decoder> decoder;
     switch (format) {
         case Format::NONE:
-            return LinearImage();
+            break;
         case Format::PNG:
             decoder.reset(PNGDecoder::create(stream));
             decoder->setColorSpace(sourceSpace);
@@ -187,10 +200,53 @@ LinearImage ImageDecoder::decode(std::istream& stream, const std::string& source
             decoder->setColorSpace(ColorSpace::LINEAR);
             break;
     }
+    return decoder;
+}
 
-    return decoder->decode();
+LinearImage ImageDecoder::decode(std::istream& stream, const std::string& sourceName,
+        ColorSpace sourceSpace) {
+    std::unique_ptr<Decoder> decoder = createDecoder(stream, sourceName, sourceSpace);
+    return decoder ? decoder->decode() : LinearImage();
 }
 
+bool ImageDecoder::decode(std::istream& stream, const std::string& sourceName,
+        RowHandler& handler, ColorSpace sourceSpace) {
+    std::unique_ptr<Decoder> decoder = createDecoder(stream, sourceName, sourceSpace);
+    return decoder && decoder->decodeRows(handler);
+}
+
+bool ImageDecoder::Decoder::decodeRows(RowHandler& handler) {
+    LinearImage image = decode();
+    if (!image.isValid() ||
+            !handler.begin(image.getWidth(), image.getHeight(), image.getChannels())) {
+        return false;
+    }
+    for (uint32_t y = 0; y < image.getHeight(); y++) {
+        handler.row(y, image.getPixelRef(0, y));
+    }
+    return true;
+}
+
+namespace {
+
+// Collects the rows of an image in a LinearImage.
+class LinearImageRowHandler : public ImageDecoder::RowHandler {
+public:
+    LinearImage image;
+
+    bool begin(uint32_t width, uint32_t height, uint32_t channels) override {
+        image = LinearImage(width, height, channels);
+        return true;
+    }
+
+    void row(uint32_t y, float const* data) override {
+        memcpy(image.getPixelRef(0, y), data,
+                sizeof(float) * image.getWidth() * image.getChannels());
+    }
+};
+
+} // anonymous namespace
+
 // -----------------------------------------------------------------------------------------------
 
 static inline float read32(std::istream& istream) {
@@ -232,34 +288,62 @@ PNGDecoder::~PNGDecoder() {
     png_destroy_read_struct(&mPNG, &mInfo, NULL);
 }
 
-LinearImage PNGDecoder::decode() {
-    std::unique_ptr<uint8_t[]> imageData;
-    try {
-        mInfo = png_create_info_struct(mPNG);
-        png_read_info(mPNG, mInfo);
+void PNGDecoder::readInfo() {
+    mInfo = png_create_info_struct(mPNG);
+    png_read_info(mPNG, mInfo);
 
-        int colorType = png_get_color_type(mPNG, mInfo);
-        int bitDepth = png_get_bit_depth(mPNG, mInfo);
+    mColorType = png_get_color_type(mPNG, mInfo);
+    int bitDepth = png_get_bit_depth(mPNG, mInfo);
 
-        if (colorType == PNG_COLOR_TYPE_PALETTE) {
-            png_set_palette_to_rgb(mPNG);
-        }
-        if (colorType == PNG_COLOR_TYPE_GRAY) {
-            png_set_gray_to_rgb(mPNG);
-        }
-        if (getColorSpace() == ImageDecoder::ColorSpace::SRGB) {
-            png_set_alpha_mode(mPNG, PNG_ALPHA_PNG, PNG_DEFAULT_sRGB);
-        } else {
-            png_set_alpha_mode(mPNG, PNG_ALPHA_PNG, PNG_GAMMA_LINEAR);
+    if (mColorType == PNG_COLOR_TYPE_PALETTE) {
+        png_set_palette_to_rgb(mPNG);
+    }
+    if (mColorType == PNG_COLOR_TYPE_GRAY) {
+        png_set_gray_to_rgb(mPNG);
+    }
+    if (getColorSpace() == ImageDecoder::ColorSpace::SRGB) {
+        png_set_alpha_mode(mPNG, PNG_ALPHA_PNG, PNG_DEFAULT_sRGB);
+    } else {
+        png_set_alpha_mode(mPNG, PNG_ALPHA_PNG, PNG_GAMMA_LINEAR);
+    }
+    if (bitDepth < 16) {
+        png_set_expand_16(mPNG);
+    }
+
+    png_read_update_info(mPNG, mInfo);
+    mWidth  = png_get_image_width(mPNG, mInfo);
+    mHeight = png_get_image_height(mPNG, mInfo);
+    mRowBytes = png_get_rowbytes(mPNG, mInfo);
+}
+
+// Same conversion as the toLinear() and toLinearWithAlpha() calls in decode(), for a single row.
+void PNGDecoder::convertRow(uint8_t const* src, float* dst) const {
+    const bool srgb = getColorSpace() == ImageDecoder::ColorSpace::SRGB;
+    uint16_t const* p = reinterpret_cast<uint16_t const*>(src);
+    if (mColorType == PNG_COLOR_TYPE_RGBA) {
+        math::float4* d = reinterpret_cast<math::float4*>(dst);
+        for (uint32_t x = 0; x < mWidth; ++x, p += 4) {
+            math::float4 c(ntohs(p[0]), ntohs(p[1]), ntohs(p[2]), ntohs(p[3]));
+            c /= std::numeric_limits<uint16_t>::max();
+            d[x] = srgb ? sRGBToLinear(c) : c;
         }
-        if (bitDepth < 16) {
-            png_set_expand_16(mPNG);
+    } else {
+        math::float3* d = reinterpret_cast<math::float3*>(dst);
+        for (uint32_t x = 0; x < mWidth; ++x, p += 3) {
+            math::float3 c(ntohs(p[0]), ntohs(p[1]), ntohs(p[2]));
+            c /= std::numeric_limits<uint16_t>::max();
+            d[x] = srgb ? sRGBToLinear(c) : c;
         }
+    }
+}
 
-        png_read_update_info(mPNG, mInfo);
-        uint32_t width  = png_get_image_width(mPNG, mInfo);
-        uint32_t height = png_get_image_height(mPNG, mInfo);
-        size_t rowBytes = png_get_rowbytes(mPNG, mInfo);
+LinearImage PNGDecoder::decode() {
+    std::unique_ptr<uint8_t[]> imageData;
+    try {
+        readInfo();
+        const uint32_t width = mWidth;
+        const uint32_t height = mHeight;
+        const size_t rowBytes = mRowBytes;
 
         imageData = std::make_unique<uint8_t[]>(height * rowBytes);
         std::unique_ptr<png_bytep[]> rowPointers(new png_bytep[height]);
@@ -269,7 +353,7 @@ LinearImage PNGDecoder::decode() {
         png_read_image(mPNG, rowPointers.get());
         png_read_end(mPNG, mInfo);
 
-        if (colorType == PNG_COLOR_TYPE_RGBA) {
+        if (mColorType == PNG_COLOR_TYPE_RGBA) {
             if (getColorSpace() == ImageDecoder::ColorSpace::SRGB) {
                 return toLinearWithAlpha<uint16_t>(width, height, rowBytes, imageData,
                         [ ](uint16_t v) -> uint16_t { return ntohs(v); },
@@ -300,6 +384,39 @@ LinearImage PNGDecoder::decode() {
     return LinearImage();
 }
 
+bool PNGDecoder::decodeRows(ImageDecoder::RowHandler& handler) {
+    try {
+        readInfo();
+        if (png_get_interlace_type(mPNG, mInfo) != PNG_INTERLACE_NONE) {
+            // interlaced images can't be read one row at a time, start over with the whole image
+            png_destroy_read_struct(&mPNG, &mInfo, NULL);
+            mStream.seekg(mStreamStartPos);
+            mPNG = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+            init();
+            return ImageDecoder::Decoder::decodeRows(handler);
+        }
+
+        const uint32_t channels = mColorType == PNG_COLOR_TYPE_RGBA ? 4 : 3;
+        if (!handler.begin(mWidth, mHeight, channels)) {
+            return false;
+        }
+        std::unique_ptr<uint8_t[]> rowData(new uint8_t[mRowBytes]);
+        std::unique_ptr<float[]> row(new float[mWidth * channels]);
+        for (uint32_t y = 0; y < mHeight; y++) {
+            png_read_row(mPNG, rowData.get(), NULL);
+            convertRow(rowData.get(), row.get());
+            handler.row(y, row.get());
+        }
+        png_read_end(mPNG, mInfo);
+        return true;
+    } catch(std::runtime_error& e) {
+        // reset the stream, like we found it
+        std::cerr << "Runtime error while decoding PNG: " << e.what() << std::endl;
+        mStream.seekg(mStreamStartPos);
+    }
+    return false;
+}
+
 void PNGDecoder::cb_stream(png_structp png, png_bytep buffer, png_size_t size) {
     PNGDecoder* that = static_cast<PNGDecoder*>(png_get_io_ptr(png));
     that->stream(buffer, size);
@@ -343,6 +460,11 @@ HDRDecoder::HDRDecoder(std::istream& stream)
 HDRDecoder::~HDRDecoder() = default;
 
 LinearImage HDRDecoder::decode() {
+    LinearImageRowHandler handler;
+    return decodeRows(handler) ? handler.image : LinearImage();
+}
+
+bool HDRDecoder::decodeRows(ImageDecoder::RowHandler& handler) {
     try {
         float gamma;
         float exposure;
@@ -354,6 +476,9 @@ LinearImage HDRDecoder::decode() {
             do {
                 char format[128];
                 mStream.getline(buf, sizeof(buf), 0xa);
+                if (!mStream.good()) {
+                    throw std::runtime_error("invalid header");
+                }
                 if (buf[0] == '#') continue;
                 sscanf(buf, "FORMAT=%127s", format);
                 sscanf(buf, "GAMMA=%f", &gamma);
@@ -365,17 +490,15 @@ LinearImage HDRDecoder::decode() {
             } while (true);
         }
 
-        LinearImage image(width, height, 3);
-
-        uint32_t flags = 0;
-        if (sx == '-') image = horizontalFlip(image);
-        if (sy == '+') image = verticalFlip(image);
+        if (!handler.begin(width, height, 3)) {
+            return false;
+        }
 
         uint16_t w;
         uint16_t magic;
         std::unique_ptr<uint8_t[]> rgbe(new uint8_t[width*4]);
+        std::unique_ptr<math::float3[]> row(new math::float3[width]);
         for (size_t y=0 ; y<height ; y++) {
-            //std::cout << "line: " << y << std::endl;
             mStream.read((char*)&magic, 2);
             if (magic != 0x0202) {
                 throw std::runtime_error("invalid scanline (magic)");
@@ -391,6 +514,9 @@ LinearImage HDRDecoder::decode() {
                 while (num_bytes < width) {
                     uint8_t rle_count;
                     mStream.read((char*)&rle_count, 1);
+                    if (!mStream.good()) {
+                        throw std::runtime_error("truncated scanline");
+                    }
                     if (rle_count > 128) {
                         char v;
                         mStream.read(&v, 1);
@@ -412,21 +538,30 @@ LinearImage HDRDecoder::decode() {
             uint8_t const* g = &rgbe[width];
             uint8_t const* b = &rgbe[2*width];
             uint8_t const* e = &rgbe[3*width];
-            math::float3* i = reinterpret_cast<math::float3*>(image.getPixelRef(0, y));
+            // "-X" scanlines go right to left
+            math::float3* i = row.get();
+            ptrdiff_t step = 1;
+            if (sx == '-') {
+                i += width - 1;
+                step = -1;
+            }
             // (rgb/256) * 2^(e-128)
-            for (size_t x=0 ; x<width ; x++, r++, g++, b++, e++) {
+            for (size_t x=0 ; x<width ; x++, r++, g++, b++, e++, i += step) {
                 math::float3 v(r[0], g[0], b[0]);
-                i[x] = v * std::ldexp(1.0f, e[0]-(128+8));
+                *i = v * std::ldexp(1.0f, e[0]-(128+8));
             }
+
+            // "+Y" images are stored bottom to top
+            handler.row(uint32_t(sy == '+' ? height - 1 - y : y), &row[0].r);
         }
-        return image;
+        return true;
 
     } catch(std::runtime_error& e) {
         // reset the stream, like we found it
         std::cerr << "Runtime error while decoding HDR: " << e.what() << std::endl;
         mStream.seekg(mStreamStartPos);
     }
-    return LinearImage();
+    return false;
 }
 
 // -----------------------------------------------------------------------------------------------
@@ -559,8 +694,13 @@ EXRDecoder::EXRDecoder(std::istream& stream, const std::string& sourceName)
 EXRDecoder::~EXRDecoder() = default;
 
 LinearImage EXRDecoder::decode() {
+    LinearImageRowHandler handler;
+    return decodeRows(handler) ? handler.image : LinearImage();
+}
+
+bool EXRDecoder::decodeRows(ImageDecoder::RowHandler& handler) {
     try {
-        // copy the EXR data in memory
+        // copy the EXR data in memory, tinyexr can't decode from a stream
         std::vector<unsigned char> src;
         unsigned char buffer[4096];
         while (mStream.read(reinterpret_cast<char*>(buffer), sizeof(buffer))) {
@@ -577,33 +717,33 @@ LinearImage EXRDecoder::decode() {
         if (ret != TINYEXR_SUCCESS) {
             std::cerr << "Could not decode OpenEXR: " << error << std::endl;
             mStream.seekg(mStreamStartPos);
-            return LinearImage();
+            return false;
         }
 
-        src.resize(0);
+        std::vector<unsigned char>().swap(src);
+        std::unique_ptr<float, decltype(&free)> pixels(rgba, &free);
 
-        LinearImage image(width, height, 3);
+        if (!handler.begin(uint32_t(width), uint32_t(height), 3)) {
+            return false;
+        }
 
-        size_t i = 0;
+        std::unique_ptr<math::float3[]> row(new math::float3[width]);
+        float const* p = pixels.get();
         for (size_t y = 0; y < height; y++) {
-            for (size_t x = 0; x < width; x++) {
-                math::float3& pixel = *reinterpret_cast<math::float3*>(image.getPixelRef(x, y));
-                pixel.r = rgba[i++];
-                pixel.g = rgba[i++];
-                pixel.b = rgba[i++];
+            for (size_t x = 0; x < width; x++, p += 4) {
                 // skip alpha
-                i++;
+                row[x] = math::float3(p[0], p[1], p[2]);
             }
+            handler.row(uint32_t(y), &row[0].r);
         }
-
-        return image;
+        return true;
     } catch(std::runtime_error& e) {
         // reset the stream, like we found it
         std::cerr << "Runtime error while decoding OpenEXR: " << e.what() << std::endl;
         mStream.seekg(mStreamStartPos);
     }
 
-    return LinearImage();
+    return false;
 }
 
 } // namespace image
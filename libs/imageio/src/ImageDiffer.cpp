@@ -28,7 +28,7 @@ namespace image {
 
 // TODO: Remove special treatment of 1-channel data.
 void updateOrCompare(LinearImage limgResult, const utils::Path& fnameGolden,
-        ComparisonMode mode, float epsilon) {
+        ComparisonMode mode, float epsilon, utils::JobSystem* jobSystem) {
     if (mode == ComparisonMode::SKIP) {
         return;
     }
@@ -66,8 +66,22 @@ void updateOrCompare(LinearImage limgResult, const utils::Path& fnameGolden,
         limgResult = combineChannels({limgResult, limgResult, limgResult});
     }
 
-    // Perform a simple comparison of the two images.
-    ASSERT_PRECONDITION(compare(limgResult, limgGolden, epsilon) == 0, "Image mismatch.");
+    // Compare the two images in parallel, the images which match are done with.
+    ASSERT_PRECONDITION(limgResult.getWidth() == limgGolden.getWidth() &&
+            limgResult.getHeight() == limgGolden.getHeight() &&
+            limgResult.getChannels() == limgGolden.getChannels(),
+            "Image mismatch: the dimensions differ from %s", fnameGolden.c_str());
+    DiffOptions options;
+    options.epsilon = epsilon;
+    ImageDiff result = diff(limgResult, limgGolden, options, jobSystem);
+    if (result.count == 0) {
+        return;
+    }
+
+    // Otherwise the verdict is still the one of compare(), with a summary of the differences.
+    ASSERT_PRECONDITION(compare(limgResult, limgGolden, epsilon) == 0,
+            "Image mismatch: %zu pixels differ from %s, max error %g, PSNR %.2f dB",
+            result.count, fnameGolden.c_str(), result.maxError, result.psnr);
 }
 
 }
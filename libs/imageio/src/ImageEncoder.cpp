@@ -16,9 +16,12 @@
 
 #include <imageio/ImageEncoder.h>
 
+#include "BlockCompression.h"
+
 #include <algorithm>
 #include <cstdint>
 #include <cstring> // for memset
+#include <fstream>
 #include <functional>
 #include <limits>
 #include <memory>
@@ -40,6 +43,9 @@
 #include <math/vec4.h>
 
 #include <image/ColorTransform.h>
+#include <image/ImageOps.h>
+
+#include <utils/JobSystem.h>
 
 using namespace math;
 
@@ -185,6 +191,48 @@ private:
 
 // ------------------------------------------------------------------------------------------------
 
+class KTXEncoder : public ImageEncoder::Encoder {
+public:
+    enum class PixelFormat {
+        sRGB,        // sRGB
+        LINEAR_RGB,  // RGB
+    };
+
+    static KTXEncoder* create(std::ostream& stream, const std::string& compression,
+                              PixelFormat format = PixelFormat::sRGB);
+
+private:
+    KTXEncoder(std::ostream& stream, const std::string& compression, PixelFormat format);
+    KTXEncoder(const KTXEncoder&) = delete;
+    ~KTXEncoder();
+
+    KTXEncoder& operator = (const KTXEncoder&) = delete;
+
+    // ImageEncoder::Encoder interface
+    virtual void encode(const LinearImage& image) override;
+
+    std::ostream& mStream;
+    std::streampos mStreamStartPos;
+    std::string mCompression;
+    PixelFormat mFormat;
+};
+
+// ------------------------------------------------------------------------------------------------
+
+void ImageEncoder::encode(utils::JobSystem& js, utils::JobSystem::Job* parent,
+        const std::string& path, Format format, const LinearImage& image,
+        const std::string& compression) {
+    // the job holds a reference to the pixels of the image
+    js.run(utils::jobs::createJob(js, parent, [path, format, image, compression]() {
+        std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+        if (!stream) {
+            std::cerr << "The output file cannot be opened: " << path << std::endl;
+            return;
+        }
+        encode(stream, format, image, compression, path);
+    }));
+}
+
 void ImageEncoder::encode(std::ostream& stream, Format format, const LinearImage& image,
         const std::string& compression, const std::string& destName) {
     std::unique_ptr<Encoder> encoder;
@@ -213,6 +261,12 @@ void ImageEncoder::encode(std::ostream& stream, Format format, const LinearImage
         case Format::DDS_LINEAR:
             encoder.reset(DDSEncoder::create(stream, compression, DDSEncoder::PixelFormat::LINEAR_RGB));
             break;
+        case Format::KTX:
+            encoder.reset(KTXEncoder::create(stream, compression));
+            break;
+        case Format::KTX_LINEAR:
+            encoder.reset(KTXEncoder::create(stream, compression, KTXEncoder::PixelFormat::LINEAR_RGB));
+            break;
     }
     return encoder->encode(image);
 }
@@ -238,6 +292,8 @@ ImageEncoder::Format ImageEncoder::chooseFormat(const std::string& name, bool fo
 
     if (ext == "dds") return forceLinear ? Format::DDS_LINEAR : Format::DDS;
 
+    if (ext == "ktx") return forceLinear ? Format::KTX_LINEAR : Format::KTX;
+
     // PNG by default
     return forceLinear ? Format::PNG_LINEAR : Format::PNG;
 }
@@ -258,6 +314,9 @@ std::string ImageEncoder::chooseExtension(ImageEncoder::Format format) {
         case Format::DDS:
         case Format::DDS_LINEAR:
             return ".dds";
+        case Format::KTX:
+        case Format::KTX_LINEAR:
+            return ".ktx";
     }
 }
 
@@ -548,9 +607,14 @@ static inline void write32(std::ostream& stream, float f) {
     stream.write(reinterpret_cast<char*>(&data), sizeof(uint32_t));
 }
 
-static inline void write16(std::ostream& stream, float f) {
+static inline void store32(uint8_t* p, float f) {
+    uint32_t data = htonl(*reinterpret_cast<uint32_t*>(&f));
+    memcpy(p, &data, sizeof(uint32_t));
+}
+
+static inline void store16(uint8_t* p, float f) {
     uint16_t data = htons(static_cast<uint16_t>(std::min(std::max(0.0f, f), 1.0f) * 65535.0f));
-    stream.write(reinterpret_cast<char*>(&data), sizeof(uint16_t));
+    memcpy(p, &data, sizeof(uint16_t));
 }
 
 static inline void write32i(std::ostream& stream, uint32_t v) {
@@ -657,27 +721,29 @@ void PSDEncoder::encode(const LinearImage& image) {
         // compression format
         write16i(mStream, kCompressionRAW);
 
-        if (depth == 32) {
-            for (size_t channel = 0; channel < 3; channel++) {
-                for (size_t y = 0; y < height; y++) {
-                    auto data = image.get<float3>(0, y);
-                    for (size_t x = 0; x < width; x++) {
-                        write32(mStream, (*data)[channel]);
-                        data++;
-                    }
-                }
-            }
-        } else {
-            for (size_t channel = 0; channel < 3; channel++) {
-                for (size_t y = 0; y < height; y++) {
-                    auto data = image.get<float3>(0, y);
-                    for (size_t x = 0; x < width; x++) {
-                        write16(mStream, linearTosRGB((*data)[channel]));
-                        data++;
+        // The channels are stored one after the other. They're converted by rows, in parallel
+        // if the calling thread has a JobSystem, and written at once.
+        const size_t sampleSize = depth / 8u;
+        const size_t channelSize = width * height * sampleSize;
+        std::unique_ptr<uint8_t[]> samples(new uint8_t[channelSize * 3]);
+        processRows(height, [&](uint32_t start, uint32_t count) {
+            for (size_t y = start; y < start + count; y++) {
+                float3 const* data = image.get<float3>(0, uint32_t(y));
+                for (size_t channel = 0; channel < 3; channel++) {
+                    uint8_t* p = samples.get() + channel * channelSize + y * width * sampleSize;
+                    if (depth == 32) {
+                        for (size_t x = 0; x < width; x++, p += 4) {
+                            store32(p, data[x][channel]);
+                        }
+                    } else {
+                        for (size_t x = 0; x < width; x++, p += 2) {
+                            store16(p, linearTosRGB(data[x][channel]));
+                        }
                     }
                 }
             }
-        }
+        }, utils::JobSystem::getJobSystem());
+        mStream.write(reinterpret_cast<const char*>(samples.get()), channelSize * 3);
 
         mStream.flush();
     } catch(std::runtime_error& e) {
@@ -744,16 +810,16 @@ void EXREncoder::encode(const LinearImage& image) {
         std::unique_ptr<float[]> g(new float[width * height]);
         std::unique_ptr<float[]> b(new float[width * height]);
 
-        size_t i = 0;
-        for (size_t y = 0; y < height; y++) {
-            auto data = image.get<float3>(0, y);
-            for (size_t x = 0; x < width; x++, data++) {
-                r[i] = data->r;
-                g[i] = data->g;
-                b[i] = data->b;
-                i++;
+        processRows(height, [&](uint32_t start, uint32_t count) {
+            for (size_t y = start; y < start + count; y++) {
+                auto data = image.get<float3>(0, uint32_t(y));
+                for (size_t x = 0, i = y * width; x < width; x++, i++, data++) {
+                    r[i] = data->r;
+                    g[i] = data->g;
+                    b[i] = data->b;
+                }
             }
-        }
+        }, utils::JobSystem::getJobSystem());
 
         float* imageData[3];
         imageData[0] = &b[0];
@@ -775,7 +841,7 @@ void EXREncoder::encode(const LinearImage& image) {
 
         header.pixel_types = (int*) malloc(sizeof(int) * header.num_channels);
         header.requested_pixel_types = (int*) malloc(sizeof(int) * header.num_channels);
-        for (i = 0; i < header.num_channels; i++) {
+        for (int i = 0; i < header.num_channels; i++) {
             header.pixel_types[i] = TINYEXR_PIXELTYPE_FLOAT;
             header.requested_pixel_types[i] = TINYEXR_PIXELTYPE_HALF;
         }
@@ -1108,4 +1174,127 @@ void DDSEncoder::encode(const LinearImage& image) {
     }
 }
 
+//-------------------------------------------------------------------------------------------------
+
+const uint8_t KTX_IDENTIFIER[12] = {
+        0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A // "«KTX 11»\r\n\x1A\n"
+};
+const uint32_t KTX_ENDIANNESS = 0x04030201;
+
+struct KTX_HEADER {
+    uint32_t glType;
+    uint32_t glTypeSize;
+    uint32_t glFormat;
+    uint32_t glInternalFormat;
+    uint32_t glBaseInternalFormat;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t numberOfArrayElements;
+    uint32_t numberOfFaces;
+    uint32_t numberOfMipmapLevels;
+    uint32_t bytesOfKeyValueData;
+};
+
+#define GL_RGB                              0x1907
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT     0x83F0
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT    0x8C4C
+#define GL_COMPRESSED_RGB8_ETC2             0x9274
+#define GL_COMPRESSED_SRGB8_ETC2            0x9275
+
+KTXEncoder* KTXEncoder::create(std::ostream& stream, const std::string& compression,
+                               PixelFormat format) {
+    KTXEncoder* encoder = new KTXEncoder(stream, compression, format);
+    return encoder;
+}
+
+KTXEncoder::KTXEncoder(std::ostream& stream, const std::string& compression, PixelFormat format)
+        : mStream(stream), mStreamStartPos(stream.tellp()),
+          mCompression(compression), mFormat(format) {
+}
+
+KTXEncoder::~KTXEncoder() {
+}
+
+void KTXEncoder::encode(const LinearImage& image) {
+    try {
+        const uint32_t channels = image.getChannels();
+        if (channels != 1 && channels != 3) {
+            throw std::runtime_error("only 1 or 3 channels are supported");
+        }
+
+        const bool dxt = mCompression == "dxt1";
+        if (!dxt && !mCompression.empty() && mCompression != "etc2") {
+            throw std::runtime_error("unknown compression scheme " + mCompression);
+        }
+        const bool srgb = mFormat == PixelFormat::sRGB;
+
+        const uint32_t width = image.getWidth();
+        const uint32_t height = image.getHeight();
+        const uint32_t blocksX = (width + 3) / 4;
+        const uint32_t blocksY = (height + 3) / 4;
+
+        KTX_HEADER header;
+        memset(&header, 0, sizeof(header));
+        header.glTypeSize           = 1;
+        header.glInternalFormat     = dxt ?
+                (srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT) :
+                (srgb ? GL_COMPRESSED_SRGB8_ETC2 : GL_COMPRESSED_RGB8_ETC2);
+        header.glBaseInternalFormat = GL_RGB;
+        header.pixelWidth           = width;
+        header.pixelHeight          = height;
+        header.numberOfFaces        = 1;
+        header.numberOfMipmapLevels = 1;
+
+        const uint32_t imageSize = blocksX * blocksY * BLOCK_COMPRESSION_BLOCK_SIZE;
+        std::unique_ptr<uint8_t[]> blocks(new uint8_t[imageSize]);
+
+        // Compresses a range of rows of blocks. The texels outside of the image are clamped to
+        // the edges.
+        auto compress = [&](uint32_t start, uint32_t count) {
+            uint8_t texels[16 * 3];
+            for (uint32_t by = start; by < start + count; by++) {
+                for (uint32_t bx = 0; bx < blocksX; bx++) {
+                    for (uint32_t i = 0; i < 16; i++) {
+                        const uint32_t x = std::min(bx * 4 + (i & 3), width - 1);
+                        const uint32_t y = std::min(by * 4 + (i >> 2), height - 1);
+                        float const* texel = image.getPixelRef(x, y);
+                        for (uint32_t c = 0; c < 3; c++) {
+                            const float v = saturate(texel[channels == 3 ? c : 0]);
+                            texels[i * 3 + c] = uint8_t((srgb ? linearTosRGB(v) : v) * 255 + 0.5f);
+                        }
+                    }
+                    uint8_t* block = blocks.get() +
+                            (by * blocksX + bx) * BLOCK_COMPRESSION_BLOCK_SIZE;
+                    if (dxt) {
+                        compressBlockDXT1(texels, block);
+                    } else {
+                        compressBlockETC2(texels, block);
+                    }
+                }
+            }
+        };
+
+        // Compressing is slow, use the JobSystem of the calling thread if it has one.
+        utils::JobSystem* js = utils::JobSystem::getJobSystem();
+        if (js) {
+            js->runAndWait(utils::jobs::parallel_for(*js, nullptr, 0, blocksY,
+                    std::cref(compress), utils::jobs::CountSplitter<4, 8>()));
+        } else {
+            compress(0, blocksY);
+        }
+
+        mStream.write((const char*) KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER));
+        mStream.write((const char*) &KTX_ENDIANNESS, sizeof(KTX_ENDIANNESS));
+        mStream.write((const char*) &header, sizeof(header));
+        mStream.write((const char*) &imageSize, sizeof(imageSize));
+        mStream.write((const char*) blocks.get(), imageSize);
+        mStream.flush();
+    } catch(std::runtime_error& e) {
+        // reset the stream, like we found it
+        std::cerr << "Runtime error while encoding KTX: " << e.what() << std::endl;
+        mStream.seekp(mStreamStartPos);
+    }
+}
+
 } // namespace image
@@ -0,0 +1,251 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <imageio/KtxReader.h>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#if !defined(WIN32)
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace image {
+
+namespace {
+
+const uint8_t KTX1_IDENTIFIER[12] = {
+        0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A // "«KTX 11»\r\n\x1A\n"
+};
+const uint8_t KTX2_IDENTIFIER[12] = {
+        0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A // "«KTX 20»\r\n\x1A\n"
+};
+const uint32_t KTX1_ENDIANNESS = 0x04030201;
+const size_t KTX1_HEADER_SIZE = 64;
+const size_t KTX2_HEADER_SIZE = 80;
+const size_t KTX2_LEVEL_INDEX_SIZE = 24;
+
+// The Vulkan formats of KTX 2.0 files that have an OpenGL equivalent.
+const struct {
+    uint32_t vkFormat;
+    uint32_t glInternalFormat;
+} VK_TO_GL_FORMATS[] = {
+        {   9, 0x8229 },    // R8_UNORM                     GL_R8
+        {  16, 0x822B },    // R8G8_UNORM                   GL_RG8
+        {  23, 0x8051 },    // R8G8B8_UNORM                 GL_RGB8
+        {  29, 0x8C41 },    // R8G8B8_SRGB                  GL_SRGB8
+        {  37, 0x8058 },    // R8G8B8A8_UNORM               GL_RGBA8
+        {  43, 0x8C43 },    // R8G8B8A8_SRGB                GL_SRGB8_ALPHA8
+        {  76, 0x822D },    // R16_SFLOAT                   GL_R16F
+        {  83, 0x822F },    // R16G16_SFLOAT                GL_RG16F
+        {  90, 0x881B },    // R16G16B16_SFLOAT             GL_RGB16F
+        {  97, 0x881A },    // R16G16B16A16_SFLOAT          GL_RGBA16F
+        { 100, 0x822E },    // R32_SFLOAT                   GL_R32F
+        { 122, 0x8C3A },    // B10G11R11_UFLOAT_PACK32      GL_R11F_G11F_B10F
+        { 131, 0x83F0 },    // BC1_RGB_UNORM_BLOCK          GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+        { 133, 0x83F1 },    // BC1_RGBA_UNORM_BLOCK         GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+        { 135, 0x83F2 },    // BC2_UNORM_BLOCK              GL_COMPRESSED_RGBA_S3TC_DXT3_EXT
+        { 137, 0x83F3 },    // BC3_UNORM_BLOCK              GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+        { 147, 0x9274 },    // ETC2_R8G8B8_UNORM_BLOCK      GL_COMPRESSED_RGB8_ETC2
+        { 148, 0x9275 },    // ETC2_R8G8B8_SRGB_BLOCK       GL_COMPRESSED_SRGB8_ETC2
+        { 149, 0x9276 },    // ETC2_R8G8B8A1_UNORM_BLOCK    GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2
+        { 150, 0x9277 },    // ETC2_R8G8B8A1_SRGB_BLOCK     GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2
+        { 151, 0x9278 },    // ETC2_R8G8B8A8_UNORM_BLOCK    GL_COMPRESSED_RGBA8_ETC2_EAC
+        { 152, 0x9279 },    // ETC2_R8G8B8A8_SRGB_BLOCK     GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC
+        { 153, 0x9270 },    // EAC_R11_UNORM_BLOCK          GL_COMPRESSED_R11_EAC
+        { 154, 0x9271 },    // EAC_R11_SNORM_BLOCK          GL_COMPRESSED_SIGNED_R11_EAC
+        { 155, 0x9272 },    // EAC_R11G11_UNORM_BLOCK       GL_COMPRESSED_RG11_EAC
+        { 156, 0x9273 },    // EAC_R11G11_SNORM_BLOCK       GL_COMPRESSED_SIGNED_RG11_EAC
+};
+
+// the data is not necessarily aligned
+template<typename T>
+T read(uint8_t const* p) noexcept {
+    T value;
+    memcpy(&value, p, sizeof(T));
+    return value;
+}
+
+size_t align4(size_t size) noexcept {
+    return (size + 3) & ~size_t(3);
+}
+
+} // anonymous namespace
+
+std::shared_ptr<KtxReader> KtxReader::open(const std::string& path) {
+    std::shared_ptr<KtxReader> reader(new KtxReader());
+
+#if !defined(WIN32)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "Unable to open KTX file: " << path << std::endl;
+        return nullptr;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            reader->mData = static_cast<uint8_t const*>(data);
+            reader->mSize = size_t(st.st_size);
+            reader->mMapped = true;
+        }
+    }
+    ::close(fd);
+    if (!reader->mMapped) {
+        std::cerr << "Unable to map KTX file: " << path << std::endl;
+        return nullptr;
+    }
+#else
+    // no memory-mapping here, read the whole file instead
+    std::ifstream file(path.c_str(), std::ifstream::binary | std::ios::ate);
+    if (!file) {
+        std::cerr << "Unable to open KTX file: " << path << std::endl;
+        return nullptr;
+    }
+    const size_t size = size_t(file.tellg());
+    std::unique_ptr<uint8_t[]> data(new uint8_t[size]);
+    file.seekg(0, std::ios::beg);
+    if (!file.read(reinterpret_cast<char*>(data.get()), size)) {
+        std::cerr << "Unable to read KTX file: " << path << std::endl;
+        return nullptr;
+    }
+    reader->mData = data.release();
+    reader->mSize = size;
+#endif
+
+    const bool valid = reader->mSize >= sizeof(KTX1_IDENTIFIER) && (
+            (!memcmp(reader->mData, KTX1_IDENTIFIER, sizeof(KTX1_IDENTIFIER)) &&
+                    reader->parseKtx1()) ||
+            (!memcmp(reader->mData, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) &&
+                    reader->parseKtx2()));
+    if (!valid) {
+        std::cerr << "Invalid or unsupported KTX file: " << path << std::endl;
+        return nullptr;
+    }
+    return reader;
+}
+
+KtxReader::~KtxReader() {
+#if !defined(WIN32)
+    if (mMapped) {
+        munmap(const_cast<uint8_t*>(mData), mSize);
+    }
+#else
+    delete [] mData;
+#endif
+}
+
+bool KtxReader::parseKtx1() noexcept {
+    if (mSize < KTX1_HEADER_SIZE || read<uint32_t>(mData + 12) != KTX1_ENDIANNESS) {
+        return false;
+    }
+    uint8_t const* header = mData + 16;
+    const uint32_t glInternalFormat      = read<uint32_t>(header + 12);
+    const uint32_t pixelWidth            = read<uint32_t>(header + 20);
+    const uint32_t pixelHeight           = read<uint32_t>(header + 24);
+    const uint32_t pixelDepth            = read<uint32_t>(header + 28);
+    const uint32_t numberOfArrayElements = read<uint32_t>(header + 32);
+    const uint32_t numberOfFaces         = read<uint32_t>(header + 36);
+    const uint32_t numberOfMipmapLevels  = read<uint32_t>(header + 40);
+    const uint32_t bytesOfKeyValueData   = read<uint32_t>(header + 44);
+    if (pixelDepth > 1 || numberOfArrayElements > 0 ||
+            (numberOfFaces != 1 && numberOfFaces != 6)) {
+        return false;
+    }
+
+    mWidth = pixelWidth;
+    mHeight = std::max(pixelHeight, 1u);
+    mFaceCount = numberOfFaces;
+    mLevelCount = std::max(numberOfMipmapLevels, 1u);
+    mGlInternalFormat = glInternalFormat;
+    mRowAlignment = 4;
+    mLevels.reset(new Level[mLevelCount]);
+
+    // each level starts with its size, which is the size of one face for cubemaps
+    size_t offset = KTX1_HEADER_SIZE + size_t(bytesOfKeyValueData);
+    for (uint32_t i = 0; i < mLevelCount; i++) {
+        if (offset + sizeof(uint32_t) > mSize) {
+            return false;
+        }
+        const size_t imageSize = read<uint32_t>(mData + offset);
+        offset += sizeof(uint32_t);
+
+        Level& level = mLevels[i];
+        level.data = mData + offset;
+        level.faceSize = imageSize;
+        level.faceStride = align4(imageSize);
+        if (offset + level.faceStride * (mFaceCount - 1) + level.faceSize > mSize) {
+            return false;
+        }
+        offset += level.faceStride * mFaceCount;
+    }
+    return true;
+}
+
+bool KtxReader::parseKtx2() noexcept {
+    if (mSize < KTX2_HEADER_SIZE) {
+        return false;
+    }
+    uint8_t const* header = mData + 12;
+    const uint32_t vkFormat               = read<uint32_t>(header);
+    const uint32_t pixelWidth             = read<uint32_t>(header + 8);
+    const uint32_t pixelHeight            = read<uint32_t>(header + 12);
+    const uint32_t pixelDepth             = read<uint32_t>(header + 16);
+    const uint32_t layerCount             = read<uint32_t>(header + 20);
+    const uint32_t faceCount              = read<uint32_t>(header + 24);
+    const uint32_t levelCount             = read<uint32_t>(header + 28);
+    const uint32_t supercompressionScheme = read<uint32_t>(header + 32);
+    if (pixelDepth > 1 || layerCount > 0 || (faceCount != 1 && faceCount != 6) ||
+            supercompressionScheme != 0) {
+        return false;
+    }
+
+    mWidth = pixelWidth;
+    mHeight = std::max(pixelHeight, 1u);
+    mFaceCount = faceCount;
+    mLevelCount = std::max(levelCount, 1u);
+    mRowAlignment = 1;
+    for (auto const& entry : VK_TO_GL_FORMATS) {
+        if (entry.vkFormat == vkFormat) {
+            mGlInternalFormat = entry.glInternalFormat;
+        }
+    }
+    mLevels.reset(new Level[mLevelCount]);
+
+    if (KTX2_HEADER_SIZE + mLevelCount * KTX2_LEVEL_INDEX_SIZE > mSize) {
+        return false;
+    }
+    for (uint32_t i = 0; i < mLevelCount; i++) {
+        uint8_t const* index = mData + KTX2_HEADER_SIZE + i * KTX2_LEVEL_INDEX_SIZE;
+        const uint64_t byteOffset = read<uint64_t>(index);
+        const uint64_t byteLength = read<uint64_t>(index + 8);
+        if (byteOffset > mSize || byteLength > mSize - byteOffset) {
+            return false;
+        }
+        Level& level = mLevels[i];
+        level.data = mData + byteOffset;
+        level.faceSize = size_t(byteLength) / mFaceCount;
+        level.faceStride = level.faceSize;
+    }
+    return true;
+}
+
+} // namespace image
@@ -90,7 +90,8 @@ inline double MATH_PURE isqrt(double x) noexcept {
 inline int signbit(float x) noexcept {
 #if __has_builtin(__builtin_signbitf)
     // Note: on Android NDK, signbit() is a function call -- not what we want.
-    return __builtin_signbitf(x);
+    // GCC's builtin returns the sign bit in place, callers expect 0 or 1 like std::signbit()
+    return __builtin_signbitf(x) != 0;
 #else
     return std::signbit(x);
 #endif
@@ -110,6 +110,8 @@ private:
     fp16 mBits;
 };
 
+constexpr uint16_t getBits(half const& h) noexcept;
+
 constexpr inline half makeHalf(uint16_t bits) noexcept {
     return half(math::half::binary, bits);
 }
@@ -19,6 +19,7 @@
 
 #include <math/mat3.h>
 #include <math/quat.h>
+#include <math/simd.h>
 #include <math/TMatHelpers.h>
 #include <math/vec3.h>
 #include <math/vec4.h>
@@ -571,6 +572,72 @@ constexpr typename TMat44<T>::col_type PURE diag(const TMat44<T>& m) {
     return matrix::diag(m);
 }
 
+// ----------------------------------------------------------------------------------------
+
+#if MATH_SIMD
+namespace matrix {
+
+// 4-wide versions of the scalar templates for mat4f, which give the same results
+
+template<>
+inline TMat44<float> MATH_PURE multiply<TMat44<float>, TMat44<float>, TMat44<float>>(
+        const TMat44<float>& lhs, const TMat44<float>& rhs) {
+    const simd::float4 c[4] = {
+            simd::load(&lhs[0][0]), simd::load(&lhs[1][0]),
+            simd::load(&lhs[2][0]), simd::load(&lhs[3][0]) };
+    TMat44<float> res(TMat44<float>::NO_INIT);
+    for (size_t col = 0; col < 4; ++col) {
+        simd::store(&res[col][0], simd::transform(c, &rhs[col][0], 4));
+    }
+    return res;
+}
+
+template<>
+inline TMat44<float> MATH_PURE gaussJordanInverse<TMat44<float>>(const TMat44<float>& src) {
+    TMat44<float> tmp(src);
+    TMat44<float> inverted(1);
+
+    for (size_t i = 0; i < 4; ++i) {
+        // look for largest element in i'th column
+        size_t swap = i;
+        float t = std::abs(tmp[i][i]);
+        for (size_t j = i + 1; j < 4; ++j) {
+            const float t2 = std::abs(tmp[j][i]);
+            if (t2 > t) {
+                swap = j;
+                t = t2;
+            }
+        }
+
+        if (swap != i) {
+            // swap columns.
+            std::swap(tmp[i], tmp[swap]);
+            std::swap(inverted[i], inverted[swap]);
+        }
+
+        const simd::float4 denom = simd::splat(tmp[i][i]);
+        const simd::float4 ti = simd::div(simd::load(&tmp[i][0]), denom);
+        const simd::float4 ii = simd::div(simd::load(&inverted[i][0]), denom);
+        simd::store(&tmp[i][0], ti);
+        simd::store(&inverted[i][0], ii);
+
+        // Factor out the lower triangle
+        for (size_t j = 0; j < 4; ++j) {
+            if (j != i) {
+                const simd::float4 s = simd::splat(tmp[j][i]);
+                simd::store(&tmp[j][0], simd::sub(simd::load(&tmp[j][0]), simd::mul(ti, s)));
+                simd::store(&inverted[j][0],
+                        simd::sub(simd::load(&inverted[j][0]), simd::mul(ii, s)));
+            }
+        }
+    }
+
+    return inverted;
+}
+
+} // namespace matrix
+#endif // MATH_SIMD
+
 } // namespace details
 
 // ----------------------------------------------------------------------------------------
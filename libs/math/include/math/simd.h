@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_MATH_SIMD_H
+#define TNT_MATH_SIMD_H
+
+#include <math/compiler.h>
+
+#include <stddef.h>
+
+/*
+ * No user serviceable parts here.
+ *
+ * The few 4-wide float operations used by the float specializations of the matrix functions
+ * (see mat4.h). They're selected at compile time, MATH_SIMD is 0 when there are none, and the
+ * scalar templates are used.
+ *
+ * The specializations must perform the same IEEE operations, in the same order, as the scalar
+ * templates, so that the results are identical. This excludes ARMv7 NEON, which flushes
+ * denormals and has no division, and fused multiply-adds.
+ */
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#   include <arm_neon.h>
+#   define MATH_SIMD 1
+#elif defined(__SSE2__) || defined(_M_X64)
+#   include <xmmintrin.h>
+#   define MATH_SIMD 1
+#else
+#   define MATH_SIMD 0
+#endif
+
+#if MATH_SIMD
+
+namespace math {
+namespace simd {
+
+#if defined(__ARM_NEON)
+
+using float4 = float32x4_t;
+
+inline float4 load(float const* p) noexcept { return vld1q_f32(p); }
+inline void store(float* p, float4 v) noexcept { vst1q_f32(p, v); }
+inline float4 splat(float s) noexcept { return vdupq_n_f32(s); }
+inline float4 zero() noexcept { return vdupq_n_f32(0.0f); }
+inline float4 add(float4 a, float4 b) noexcept { return vaddq_f32(a, b); }
+inline float4 sub(float4 a, float4 b) noexcept { return vsubq_f32(a, b); }
+inline float4 mul(float4 a, float4 b) noexcept { return vmulq_f32(a, b); }
+inline float4 div(float4 a, float4 b) noexcept { return vdivq_f32(a, b); }
+inline float4 abs(float4 a) noexcept { return vabsq_f32(a); }
+
+#else
+
+using float4 = __m128;
+
+inline float4 load(float const* p) noexcept { return _mm_loadu_ps(p); }
+inline void store(float* p, float4 v) noexcept { _mm_storeu_ps(p, v); }
+inline float4 splat(float s) noexcept { return _mm_set1_ps(s); }
+inline float4 zero() noexcept { return _mm_setzero_ps(); }
+inline float4 add(float4 a, float4 b) noexcept { return _mm_add_ps(a, b); }
+inline float4 sub(float4 a, float4 b) noexcept { return _mm_sub_ps(a, b); }
+inline float4 mul(float4 a, float4 b) noexcept { return _mm_mul_ps(a, b); }
+inline float4 div(float4 a, float4 b) noexcept { return _mm_div_ps(a, b); }
+inline float4 abs(float4 a) noexcept { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+
+#endif
+
+// c[0] * s.x + c[1] * s.y + ... accumulated from 0 like the matrix * vector templates, c are
+// the columns of a matrix
+inline float4 transform(float4 const* c, float const* s, size_t n) noexcept {
+    float4 r = zero();
+    for (size_t i = 0; i < n; i++) {
+        r = add(r, mul(c[i], splat(s[i])));
+    }
+    return r;
+}
+
+} // namespace simd
+} // namespace math
+
+#endif // MATH_SIMD
+
+#endif // TNT_MATH_SIMD_H
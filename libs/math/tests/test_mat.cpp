@@ -160,6 +160,32 @@ TEST_F(MatTest, ElementAccess) {
     EXPECT_FLOAT_EQ(m(3, 2), 100);
 }
 
+TEST_F(MatTest, MultiplyFloat) {
+    // mat4f has its own (possibly SIMD) multiply, it must match the scalar one exactly
+    std::default_random_engine generator(82828);
+    std::uniform_real_distribution<float> distribution(-100.0f, 100.0f);
+    auto rand_gen = std::bind(distribution, generator);
+
+    for (size_t i = 0; i < 100; i++) {
+        mat4f a, b;
+        for (size_t c = 0; c < 4; c++) {
+            for (size_t r = 0; r < 4; r++) {
+                a[c][r] = rand_gen();
+                b[c][r] = rand_gen();
+            }
+        }
+        mat4f expected;
+        for (size_t c = 0; c < 4; c++) {
+            float4 col = {};
+            for (size_t k = 0; k < 4; k++) {
+                col += a[k] * b[c][k];
+            }
+            expected[c] = col;
+        }
+        EXPECT_EQ(expected, a * b);
+    }
+}
+
 //------------------------------------------------------------------------------
 // MAT 3
 //------------------------------------------------------------------------------
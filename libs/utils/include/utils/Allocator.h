@@ -130,6 +130,87 @@ private:
     void* mCurrent = nullptr;
 };
 
+/* ------------------------------------------------------------------------------------------------
+ * LinearAllocatorWithFallback
+ *
+ * + Same as LinearAllocator
+ * + When the memory area is exhausted, allocates blocks from the heap instead of failing, these
+ *   blocks are chained and freed by rewind() / reset()
+ * ------------------------------------------------------------------------------------------------
+ */
+
+class LinearAllocatorWithFallback {
+public:
+    // use memory area provided
+    LinearAllocatorWithFallback(void* begin, void* end) noexcept
+            : mAllocator(begin, end), mBegin(begin) { }
+
+    template <typename AREA>
+    explicit LinearAllocatorWithFallback(const AREA& area)
+            : LinearAllocatorWithFallback(area.begin(), area.end()) { }
+
+    // Allocators can't be copied or moved
+    LinearAllocatorWithFallback(const LinearAllocatorWithFallback& rhs) = delete;
+    LinearAllocatorWithFallback& operator=(const LinearAllocatorWithFallback& rhs) = delete;
+
+    ~LinearAllocatorWithFallback() noexcept {
+        reset();
+    }
+
+    // our allocator concept
+    void* alloc(size_t size, size_t alignment = alignof(std::max_align_t), size_t extra = 0) UTILS_RESTRICT {
+        void* p = mAllocator.alloc(size, alignment, extra);
+        if (UTILS_UNLIKELY(!p)) {
+            p = allocFromHeap(size, alignment, extra);
+        }
+        return p;
+    }
+
+    // API specific to this allocator
+
+    void *getCurrent() UTILS_RESTRICT noexcept {
+        return mAllocator.getCurrent();
+    }
+
+    // free memory back to the specified point, this frees the heap blocks allocated after it
+    void rewind(void* p) UTILS_RESTRICT noexcept {
+        if (UTILS_UNLIKELY(mHeapBlocks)) {
+            rewindHeapBlocks(p);
+        }
+        mAllocator.rewind(p);
+    }
+
+    // frees all allocated blocks
+    void reset() UTILS_RESTRICT noexcept {
+        rewind(mBegin);
+    }
+
+    // number of bytes currently allocated from the heap, because the memory area was exhausted
+    size_t getHeapAllocated() const noexcept {
+        return mHeapAllocated;
+    }
+
+    // LinearAllocatorWithFallback shouldn't have a free() method
+    // it's only needed to be compatible with STLAllocator<> below
+    void free(void*) UTILS_RESTRICT noexcept { }
+
+private:
+    // header of a heap block, it saves the allocator of the previous block
+    struct HeapBlock {
+        HeapBlock* previous;
+        LinearAllocator allocator;
+        size_t size;
+    };
+
+    void* allocFromHeap(size_t size, size_t alignment, size_t extra) noexcept;
+    void rewindHeapBlocks(void* p) noexcept;
+
+    LinearAllocator mAllocator;
+    void* mBegin = nullptr;
+    HeapBlock* mHeapBlocks = nullptr;
+    size_t mHeapAllocated = 0;
+};
+
 /* ------------------------------------------------------------------------------------------------
  * HeapAllocator
  *
@@ -249,7 +330,7 @@ public:
     }
 
 private:
-    std::atomic<Node*> mHead;
+    std::atomic<Node*> mHead = { nullptr };
 };
 
 // ------------------------------------------------------------------------------------------------
@@ -437,7 +518,20 @@ struct HighWatermark {
     }
     void onFree(void* p, size_t size) noexcept { mCurrent -= uint32_t(size); }
     void onReset() noexcept {  mCurrent = 0; }
-    void onRewind(void const* addr) noexcept { mCurrent = uint32_t(uintptr_t(addr) - uintptr_t(mBase)); }
+    void onRewind(void const* addr) noexcept {
+        // addresses outside of the area come from heap blocks of LinearAllocatorWithFallback,
+        // in that case we don't know how much is freed and keep counting the whole allocation.
+        if (addr >= mBase && uintptr_t(addr) - uintptr_t(mBase) <= mSize) {
+            mCurrent = uint32_t(uintptr_t(addr) - uintptr_t(mBase));
+        }
+    }
+
+    size_t getSize() const noexcept { return mSize; }
+    size_t getCurrent() const noexcept { return mCurrent; }
+    size_t getHighWatermark() const noexcept { return mHighWaterMark; }
+
+    // starts a new measurement period, e.g. a frame
+    void resetHighWatermark() noexcept { mHighWaterMark = mCurrent; }
 
 private:
     const char* mName = nullptr;
@@ -182,6 +182,10 @@ public:
     // its content. this is explicit because this operation is costly.
     explicit CString(const char* cstr);
 
+    // this allocates a CString of the given length, to be filled in through data(). Its
+    // content is uninitialized but it is null-terminated.
+    explicit CString(size_type length);
+
     CString& operator=(const CString& rhs);
 
     CString& operator=(CString&& rhs) noexcept {
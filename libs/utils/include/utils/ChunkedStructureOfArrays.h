@@ -0,0 +1,281 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_UTILS_CHUNKEDSTRUCTUREOFARRAYS_H
+#define TNT_UTILS_CHUNKEDSTRUCTUREOFARRAYS_H
+
+#include <algorithm>
+#include <tuple>
+#include <utility>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <utils/Allocator.h>
+#include <utils/compiler.h>
+#include <utils/StructureOfArrays.h>
+
+namespace utils {
+
+/*
+ * A structure-of-arrays stored in chunks of 2^CHUNK_SHIFT elements. Each chunk holds a slice of
+ * every array.
+ *
+ * Growing only allocates new chunks, the existing elements are never moved, so their addresses
+ * stay valid until they're removed, and there is no spike of copies and memory when the capacity
+ * increases. The price is that the arrays aren't contiguous, they can only be accessed an
+ * element at a time with elementAt<>().
+ */
+template <size_t CHUNK_SHIFT, typename Allocator, typename ... Elements>
+class ChunkedStructureOfArraysBase {
+    // number of elements
+    static constexpr const size_t kArrayCount = sizeof...(Elements);
+
+public:
+    using SoA = ChunkedStructureOfArraysBase<CHUNK_SHIFT, Allocator, Elements ...>;
+
+    // Type of the Nth array
+    template<size_t N>
+    using TypeAt = typename std::tuple_element<N, std::tuple<Elements...>>::type;
+
+    // Number of elements of each array in a chunk
+    static constexpr size_t CHUNK_SIZE = size_t(1) << CHUNK_SHIFT;
+
+    // Number of arrays
+    static constexpr size_t getArrayCount() noexcept { return kArrayCount; }
+
+    // a reference to the field E of an element
+    template <size_t E>
+    using Field = details::StructureOfArraysField<SoA, E>;
+
+    // --------------------------------------------------------------------------------------------
+
+    ChunkedStructureOfArraysBase() = default;
+
+    // not copiable for now
+    ChunkedStructureOfArraysBase(ChunkedStructureOfArraysBase const& rhs) = delete;
+    ChunkedStructureOfArraysBase& operator=(ChunkedStructureOfArraysBase const& rhs) = delete;
+
+    // movability is trivial, so support it
+    ChunkedStructureOfArraysBase(ChunkedStructureOfArraysBase&& rhs) noexcept {
+        using std::swap;
+        swap(mChunks, rhs.mChunks);
+        swap(mChunkCount, rhs.mChunkCount);
+        swap(mChunkTableSize, rhs.mChunkTableSize);
+        swap(mSize, rhs.mSize);
+        swap(mAllocator, rhs.mAllocator);
+    }
+
+    ChunkedStructureOfArraysBase& operator=(ChunkedStructureOfArraysBase&& rhs) noexcept {
+        if (this != &rhs) {
+            using std::swap;
+            swap(mChunks, rhs.mChunks);
+            swap(mChunkCount, rhs.mChunkCount);
+            swap(mChunkTableSize, rhs.mChunkTableSize);
+            swap(mSize, rhs.mSize);
+            swap(mAllocator, rhs.mAllocator);
+        }
+        return *this;
+    }
+
+    ~ChunkedStructureOfArraysBase() {
+        destroy_each(0, mSize);
+        for (size_t i = 0; i < mChunkCount; i++) {
+            mAllocator.free(mChunks[i]);
+        }
+        ::free(mChunks);
+    }
+
+    // --------------------------------------------------------------------------------------------
+
+    // return the size the array
+    size_t size() const noexcept {
+        return mSize;
+    }
+
+    // return the capacity of the array, this is always a multiple of CHUNK_SIZE
+    size_t capacity() const noexcept {
+        return mChunkCount * CHUNK_SIZE;
+    }
+
+    // return the number of bytes allocated for the chunks
+    size_t getMemorySize() const noexcept {
+        return mChunkCount * (getOffset<kArrayCount - 1>() +
+                sizeof(TypeAt<kArrayCount - 1>) * CHUNK_SIZE);
+    }
+
+    // allocates chunks until there is room for "needed" elements. Existing elements don't move.
+    void ensureCapacity(size_t needed) {
+        while (UTILS_UNLIKELY(needed > capacity())) {
+            addChunk();
+        }
+    }
+
+    // grow or shrink the array to the given size. When growing, new elements are constructed
+    // with their default constructor. when shrinking, discarded elements are destroyed.
+    // Chunks are never freed.
+    UTILS_NOINLINE
+    void resize(size_t needed) {
+        ensureCapacity(needed);
+        if (needed < mSize) {
+            destroy_each(needed, mSize);
+        } else if (needed > mSize) {
+            construct_each(mSize, needed);
+        }
+        mSize = needed;
+    }
+
+    void clear() noexcept {
+        destroy_each(0, mSize);
+        mSize = 0;
+    }
+
+    inline void swap(size_t i, size_t j) noexcept {
+        swap(i, j, std::make_index_sequence<kArrayCount>());
+    }
+
+    // remove and destroy the last element of each array
+    inline void pop_back() noexcept {
+        if (mSize) {
+            destroy_each(mSize - 1, mSize);
+            mSize--;
+        }
+    }
+
+    // create an element at the end of each array
+    ChunkedStructureOfArraysBase& push_back() noexcept {
+        resize(mSize + 1);
+        return *this;
+    }
+
+    // return a reference to the index'th element of the ElementIndex'th array
+    template<size_t ElementIndex>
+    UTILS_ALWAYS_INLINE TypeAt<ElementIndex>& elementAt(size_t index) noexcept {
+        assert(index < capacity());
+        return getArray<ElementIndex>(index >> CHUNK_SHIFT)[index & (CHUNK_SIZE - 1)];
+    }
+
+    template<size_t ElementIndex>
+    UTILS_ALWAYS_INLINE TypeAt<ElementIndex> const& elementAt(size_t index) const noexcept {
+        assert(index < capacity());
+        return getArray<ElementIndex>(index >> CHUNK_SHIFT)[index & (CHUNK_SIZE - 1)];
+    }
+
+    // return a reference to the last element of the ElementIndex'th array
+    template<size_t ElementIndex>
+    TypeAt<ElementIndex>& back() noexcept {
+        return elementAt<ElementIndex>(size() - 1);
+    }
+
+    template<size_t ElementIndex>
+    TypeAt<ElementIndex> const& back() const noexcept {
+        return elementAt<ElementIndex>(size() - 1);
+    }
+
+private:
+    // offset of the ElementIndex'th array in a chunk
+    template<size_t ElementIndex>
+    static constexpr size_t getOffset() noexcept {
+        // we align each array to the same alignment guaranteed by malloc
+        constexpr size_t align = alignof(std::max_align_t);
+        constexpr size_t sizes[] = { sizeof(Elements)... };
+        size_t offset = 0;
+        for (size_t i = 0; i < ElementIndex; i++) {
+            offset += (sizes[i] * CHUNK_SIZE + align - 1) & ~(align - 1);
+        }
+        return offset;
+    }
+
+    template<size_t ElementIndex>
+    TypeAt<ElementIndex>* getArray(size_t chunk) const noexcept {
+        constexpr size_t offset = getOffset<ElementIndex>();
+        return reinterpret_cast<TypeAt<ElementIndex>*>(static_cast<char*>(mChunks[chunk]) + offset);
+    }
+
+    UTILS_NOINLINE
+    void addChunk() {
+        if (mChunkCount == mChunkTableSize) {
+            // only the table of chunks is reallocated, it's small
+            mChunkTableSize = mChunkTableSize ? mChunkTableSize * 2 : 8;
+            mChunks = static_cast<void**>(::realloc(mChunks, mChunkTableSize * sizeof(void*)));
+        }
+        mChunks[mChunkCount++] = mAllocator.alloc(getOffset<kArrayCount - 1>() +
+                sizeof(TypeAt<kArrayCount - 1>) * CHUNK_SIZE);
+    }
+
+    // calls f(p, first, last) on each array of the chunks overlapping [from, to), with the range
+    // of elements in that chunk.
+    template<typename F>
+    void forEachRange(size_t from, size_t to, F f) const noexcept {
+        while (from < to) {
+            const size_t chunk = from >> CHUNK_SHIFT;
+            const size_t first = from & (CHUNK_SIZE - 1);
+            const size_t last = std::min(to - (chunk << CHUNK_SHIFT), size_t(CHUNK_SIZE));
+            forEachArray(chunk, f, first, last, std::make_index_sequence<kArrayCount>());
+            from = (chunk + 1) << CHUNK_SHIFT;
+        }
+    }
+
+    template<typename F, size_t ... Is>
+    void forEachArray(size_t chunk, F& f, size_t first, size_t last,
+            std::index_sequence<Is...>) const noexcept {
+        int UTILS_UNUSED dummy[] = { (f(getArray<Is>(chunk), first, last), 0)... };
+    }
+
+    template<size_t ... Is>
+    void swap(size_t i, size_t j, std::index_sequence<Is...>) noexcept {
+        using std::swap;
+        int UTILS_UNUSED dummy[] = { (swap(elementAt<Is>(i), elementAt<Is>(j)), 0)... };
+    }
+
+    void construct_each(size_t from, size_t to) noexcept {
+        forEachRange(from, to, [](auto p, size_t first, size_t last) {
+            using T = typename std::decay<decltype(*p)>::type;
+            // note: scalar types like int/float get initialized to zero
+            for (size_t i = first; i < last; i++) {
+                new(p + i) T();
+            }
+        });
+    }
+
+    void destroy_each(size_t from, size_t to) noexcept {
+        forEachRange(from, to, [](auto p, size_t first, size_t last) {
+            using T = typename std::decay<decltype(*p)>::type;
+            for (size_t i = first; i < last; i++) {
+                p[i].~T();
+            }
+        });
+    }
+
+    // table of chunks, it grows by doubling
+    void** mChunks = nullptr;
+    size_t mChunkCount = 0;
+    size_t mChunkTableSize = 0;
+    // size in array elements
+    size_t mSize = 0;
+    Allocator mAllocator;
+};
+
+// 256 elements per chunk by default, the chunks of the larger component managers are a few dozen
+// KiB.
+template <typename ... Elements>
+using ChunkedStructureOfArrays = ChunkedStructureOfArraysBase<8, HeapArena<>, Elements ...>;
+
+} // namespace utils
+
+#endif // TNT_UTILS_CHUNKEDSTRUCTUREOFARRAYS_H
@@ -45,8 +45,13 @@
 namespace utils {
 
 class JobSystem {
-    static constexpr size_t MAX_JOB_COUNT = 4096;
+    // Jobs are allocated in chunks of JOB_CHUNK_SIZE. The first chunk is allocated upfront and the
+    // others when the pool runs out of jobs, up to MAX_JOB_CHUNK_COUNT.
+    static constexpr size_t JOB_CHUNK_SIZE = 4096;
+    static constexpr size_t MAX_JOB_CHUNK_COUNT = 4;
+    static constexpr size_t MAX_JOB_COUNT = JOB_CHUNK_SIZE * MAX_JOB_CHUNK_COUNT;
     static_assert(MAX_JOB_COUNT <= 0x7FFE, "MAX_JOB_COUNT must be <= 0x7FFE");
+    static constexpr uint32_t DEFAULT_IDLE_SPIN_DURATION = 50; // microseconds
     using WorkQueue = WorkStealingDequeue<uint16_t, MAX_JOB_COUNT>;
 
 public:
@@ -67,7 +72,8 @@ public:
         JobFunc function;
         uint16_t parent;
         std::atomic<uint16_t> runningJobCount = { 0 };
-        // on 64-bits systems, there is an extra 32-bits lost here
+        uint16_t id;    // index of this job in the pool, it survives the job's destruction
+        uint16_t links; // index of the job holding this job's Links, see addDependency()
         void* padding[JOB_PADDING];
     };
 
@@ -101,6 +107,13 @@ public:
     // Clears the master job
     void reset() noexcept { mMasterJob = nullptr; }
 
+    // Idle worker threads poll for new jobs up to this long before going to sleep, because waking
+    // a sleeping thread up is slow compared to the small jobs of a frame. The polling gets shorter
+    // each time it doesn't find any work, down to 1/8th of this duration. 0 disables polling.
+    void setIdleSpinDuration(uint32_t microseconds) noexcept {
+        mIdleSpinDuration.store(microseconds, std::memory_order_relaxed);
+    }
+
 
     // NOTE: All methods below must be called from the same thread and that thread must be
     // owned by JobSystem's thread pool.
@@ -232,6 +245,15 @@ public:
         wait(job);
     }
 
+    // Makes successor wait for predecessor, including its children, to finish before it runs.
+    // run() can be called on successor at any time, it's only executed once all its predecessors
+    // have finished, without blocking any thread. This allows expressing a graph of jobs where
+    // only the root is waited on.
+    // Neither job can have been run yet, and successor can't be canceled with finish(). A job can
+    // have up to MAX_SUCCESSOR_COUNT successors and any number of predecessors.
+    static constexpr size_t MAX_SUCCESSOR_COUNT = 8;
+    void addDependency(Job* predecessor, Job* successor) noexcept;
+
     // jobs are normally finished automatically, this can be used to cancel a job
     // before it is run.
     void finish(Job* job) noexcept;
@@ -254,10 +276,49 @@ public:
     static void setThreadPriority(Priority priority) noexcept;
     static void setThreadAffinity(uint32_t mask) noexcept;
 
+    // Returns the mask of the CPUs that are faster than the slowest ones, i.e.: the "big" cores of
+    // a big.LITTLE system, based on their maximum frequency. Returns 0 if all CPUs are the same or
+    // if the topology can't be determined (only Linux and Android are supported).
+    static uint32_t getBigCoreMask() noexcept;
+
+    // Prevents the worker threads from running on the given CPUs, e.g. so the application can
+    // dedicate them to its own threads. The workers move off these CPUs the next time they
+    // wake up. 0 (the default) lets them run on any CPU.
+    void setReservedCoreMask(uint32_t mask) noexcept {
+        mReservedCoreMask.store(mask, std::memory_order_relaxed);
+    }
+
+    uint32_t getReservedCoreMask() const noexcept {
+        return mReservedCoreMask.load(std::memory_order_relaxed);
+    }
+
     size_t getParallelSplitCount() const noexcept {
         return mParallelSplitCount;
     }
 
+    // Number of jobs that can exist at the same time, this grows with the demand.
+    size_t getJobCapacity() const noexcept {
+        return mJobChunkCount.load(std::memory_order_relaxed) * JOB_CHUNK_SIZE;
+    }
+
+    // Number of times a job couldn't be created because the pool was at its maximum size. When
+    // this happens, parallel_for() executes the remaining work on the calling thread.
+    uint32_t getJobPoolExhaustedCount() const noexcept {
+        return mJobPoolExhaustedCount.load(std::memory_order_relaxed);
+    }
+
+    // Number of worker threads, not counting the adopted threads.
+    size_t getWorkerCount() const noexcept {
+        return mThreadCount;
+    }
+
+    // Time the worker threads spent without a job to execute, spinning or sleeping, in
+    // nanoseconds, summed over all the workers since the JobSystem was created. The rest of the
+    // workers' time is spent executing jobs.
+    uint64_t getWorkerIdleTime() const noexcept {
+        return mWorkerIdleTime.load(std::memory_order_relaxed);
+    }
+
 private:
     // this is just to avoid using std::default_random_engine, since we're in a public header.
     class default_random_engine {
@@ -282,6 +343,7 @@ private:
         std::thread thread;
         default_random_engine rndGen;
         uint32_t mask;
+        uint32_t spinDuration;  // in microseconds, adapted by spin()
     };
 
     static_assert(sizeof(ThreadState) % CACHELINE_SIZE == 0,
@@ -289,8 +351,24 @@ private:
 
     static ThreadState& getState() noexcept;
 
+    // The dependencies of a job are stored in the padding of another job of the pool, which
+    // is allocated by the first call to addDependency() involving it.
+    struct Links {
+        std::atomic<uint16_t> pendingCount; // unfinished predecessors, +1 until the job is run
+        uint16_t successorCount;
+        uint16_t successors[MAX_SUCCESSOR_COUNT];
+    };
+    static constexpr uint16_t NO_LINKS = 0x7FFF;
+
+    Links& getLinks(Job* job) noexcept;
+    bool releaseDependency(Job* job) noexcept;
+    void runSuccessors(Job* job) noexcept;
+    void schedule(Job* job, uint32_t flags) noexcept;
+
     Job* create(Job* parent, JobFunc func) noexcept;
     Job* allocateJob() noexcept;
+    Job* growJobPool() noexcept;
+    bool addJobChunk() noexcept;
     JobSystem::ThreadState& getStateToStealFrom(JobSystem::ThreadState& state) noexcept;
     bool hasJobCompleted(Job const* job) noexcept;
 
@@ -299,30 +377,39 @@ private:
 
     void loop(ThreadState* threadState) noexcept;
     bool execute(JobSystem::ThreadState& state) noexcept;
+    bool spin(JobSystem::ThreadState& state) noexcept;
+
+    Job* getJob(size_t index) const noexcept {
+        assert(index < MAX_JOB_COUNT);
+        Job* const chunk = mJobChunks[index / JOB_CHUNK_SIZE].load(std::memory_order_relaxed);
+        return chunk + index % JOB_CHUNK_SIZE;
+    }
 
     void put(WorkQueue& workQueue, Job* job) noexcept {
-        size_t index = job - mJobStorageBase;
-        assert(index >= 0 && index < MAX_JOB_COUNT);
+        size_t index = job->id;
+        assert(index < MAX_JOB_COUNT);
         workQueue.push(uint16_t(index + 1));
     }
 
     Job* pop(WorkQueue& workQueue) noexcept {
         size_t index = workQueue.pop();
         assert(index <= MAX_JOB_COUNT);
-        return !index ? nullptr : (mJobStorageBase - 1) + index;
+        return !index ? nullptr : getJob(index - 1);
     }
 
     Job* steal(WorkQueue& workQueue) noexcept {
         size_t index = workQueue.steal();
         assert(index <= MAX_JOB_COUNT);
-        return !index ? nullptr : (mJobStorageBase - 1) + index;
+        return !index ? nullptr : getJob(index - 1);
     }
 
     // these have thread contention, keep them together
     utils::Mutex mLock;
     utils::Condition mCondition;
     std::atomic<uint32_t> mActiveJobs = { 0 };
-    utils::Arena<utils::ThreadSafeObjectPoolAllocator<Job>, LockingPolicy::NoLock> mJobPool;
+    std::atomic<uint32_t> mSleepingThreads = { 0 };     // avoids taking mLock in run()
+    std::atomic<uint64_t> mWorkerIdleTime = { 0 };      // only written by idle workers
+    AtomicFreeList mJobFreeList;
 
     template <typename T>
     using aligned_vector = std::vector<T, utils::STLAlignedAllocator<T>>;
@@ -337,7 +424,12 @@ private:
     aligned_vector<ThreadState> mThreadStates;          // actual data is stored offline
     std::atomic<bool> mExitRequested = { 0 };           // this one is almost never written
     std::atomic<uint16_t> mAdoptedThreads = { 0 };      // this one is almost never written
-    Job* const mJobStorageBase;                         // Base for conversion to indices
+    std::atomic<Job*> mJobChunks[MAX_JOB_CHUNK_COUNT] = {}; // written only when the pool grows
+    std::atomic<uint32_t> mJobChunkCount = { 0 };       // written only when the pool grows
+    std::atomic<uint32_t> mJobPoolExhaustedCount = { 0 };
+    std::atomic<uint32_t> mIdleSpinDuration = { DEFAULT_IDLE_SPIN_DURATION };
+    std::atomic<uint32_t> mReservedCoreMask = { 0 };
+    utils::Mutex mJobPoolLock;                          // serializes the growth of the pool
     uint16_t mThreadCount = 0;                          // total # of threads in the pool
     uint8_t mParallelSplitCount = 0;                    // # of split allowable in parallel_for
     Job* mMasterJob = nullptr;
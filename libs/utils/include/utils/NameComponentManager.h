@@ -20,36 +20,27 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <utils/Allocator.h>
 #include <utils/compiler.h>
+#include <utils/CString.h>
 #include <utils/Entity.h>
 #include <utils/EntityInstance.h>
 #include <utils/SingleInstanceComponentManager.h>
 
-namespace utils {
+#include <tsl/robin_set.h>
 
-class EntityManager;
+#include <unordered_map>
 
-namespace details {
-class SafeString {
-public:
-    SafeString() noexcept = default;
-    explicit SafeString(const char* str) noexcept : mCStr(strdup(str)) { }
-    SafeString(SafeString&& rhs) noexcept : mCStr(rhs.mCStr) { rhs.mCStr = nullptr; }
-    SafeString& operator=(SafeString&& rhs) noexcept {
-        mCStr = rhs.mCStr;
-        rhs.mCStr = nullptr;
-        return *this;
-    }
-    ~SafeString() { free((void*)mCStr); }
-    const char* c_str() const noexcept { return mCStr; }
-
-private:
-    char const* mCStr = nullptr;
-};
-} // namespace details
+namespace utils {
 
+class EntityManager;
 
-class NameComponentManager : public SingleInstanceComponentManager<details::SafeString> {
+/*
+ * The names are interned: the components with the same name share a single copy of it, which
+ * is allocated in an arena owned by the manager and lives as long as the manager. An index
+ * maps the names to their entities.
+ */
+class NameComponentManager : public SingleInstanceComponentManager<char const*> {
 public:
     using Instance = EntityInstance<NameComponentManager>;
 
@@ -71,8 +62,24 @@ public:
     void removeComponent(Entity e);
     void gc(const EntityManager& em, size_t ratio = 4) noexcept;
 
+    // a null name removes the name of the component
     void setName(Instance instance, const char* name) noexcept;
     const char* getName(Instance instance) const noexcept;
+
+    // returns an entity with the given name, any of them if several have it, or the null
+    // entity if none has it. The entities destroyed since the last gc() can be returned.
+    Entity getEntityByName(const char* name) const noexcept;
+
+private:
+    char const* intern(const char* name) noexcept;
+    void removeFromIndex(char const* name, Entity e) noexcept;
+
+    // the heap blocks allocated once the area is full are as large
+    static constexpr size_t NAMES_AREA_SIZE = 64 * 1024;
+    HeapArea mArea;
+    LinearAllocatorWithFallback mAllocator;
+    tsl::robin_set<char const*, hashCStrings, equalCStrings> mNames;
+    std::unordered_multimap<char const*, Entity> mEntities;  // keyed by the interned names
 };
 
 } // namespace utils
@@ -41,6 +41,7 @@ class Profiler {
         BRANCH_MISSES   = 5,
         ICACHE_REFS     = 6,
         ICACHE_MISSES   = 7,
+        STALLED_CYCLES  = 8,
 
         // Must be last one
         EVENT_COUNT
@@ -56,14 +57,19 @@ public:
         EV_BPU_MISSES = 1 << BRANCH_MISSES,
         EV_L1I_REFS   = 1 << ICACHE_REFS,
         EV_L1I_MISSES = 1 << ICACHE_MISSES,
+        EV_STALLED_CYCLES = 1 << STALLED_CYCLES,
         // helpers
         EV_L1D_RATES = EV_L1D_REFS | EV_L1D_MISSES,
         EV_L1I_RATES = EV_L1I_REFS | EV_L1I_MISSES,
         EV_BPU_RATES = EV_BPU_REFS | EV_BPU_MISSES,
     };
 
+    // The counters only count the events of the thread that created the Profiler. get() returns
+    // a Profiler for the first thread that calls it, other threads can create their own.
     static Profiler& get() noexcept;
 
+    Profiler() noexcept;
+    ~Profiler() noexcept;
 
     Profiler(const Profiler& rhs) = delete;
     Profiler(Profiler&& rhs) = delete;
@@ -108,6 +114,7 @@ public:
         uint64_t getL1IMisses() const           { return counters[ICACHE_MISSES].value; }
         uint64_t getBranchInstructions() const  { return counters[BRANCHES].value; }
         uint64_t getBranchMisses() const        { return counters[BRANCH_MISSES].value; }
+        uint64_t getStalledCycles() const       { return counters[STALLED_CYCLES].value; }
 
         std::chrono::duration<uint64_t, std::nano> getWallTime() const {
             return std::chrono::duration<uint64_t, std::nano>(time_enabled);
@@ -162,6 +169,12 @@ public:
         double getMPKI(uint64_t misses) const noexcept {
             return (misses * 1000.0) / getInstructions();
         }
+
+        // When there are more events than hardware counters, the kernel multiplexes them and
+        // they only count part of the time. Multiply the counts by this to estimate their values.
+        double getMultiplexingScale() const noexcept {
+            return time_running ? double(time_enabled) / double(time_running) : 0.0;
+        }
     };
 
 #if defined(__linux__)
@@ -214,10 +227,11 @@ public:
         return (mCountersFd[ICACHE_REFS] >= 0) && (mCountersFd[ICACHE_MISSES] >= 0);
     }
 
-private:
-    Profiler() noexcept;
-    ~Profiler() noexcept;
+    bool hasStalledCycles() const noexcept {
+        return mCountersFd[STALLED_CYCLES] >= 0;
+    }
 
+private:
     __attribute__((unused)) uint8_t mIds[EVENT_COUNT];
     int mCountersFd[EVENT_COUNT];
     uint32_t mEnabledEvents = 0;
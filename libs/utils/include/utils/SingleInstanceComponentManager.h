@@ -24,6 +24,7 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include <utils/ChunkedStructureOfArrays.h>
 #include <utils/compiler.h>
 #include <utils/Entity.h>
 #include <utils/EntityManager.h>
@@ -43,9 +44,13 @@ class EntityManager;
  * and the real component manager is a public API, make sure to forward the public methods
  * to the implementation.
  *
+ * STORAGE is the structure-of-arrays of the components followed by their Entity, either
+ * StructureOfArrays<> (see SingleInstanceComponentManager) or ChunkedStructureOfArrays<>
+ * (see ChunkedSingleInstanceComponentManager). The methods returning pointers to the arrays
+ * are only available with the former.
  */
-template <typename ... Elements>
-class SingleInstanceComponentManager {
+template <typename STORAGE>
+class SingleInstanceComponentManagerBase {
 private:
 
     // this is just to avoid using std::default_random_engine, since we're in a public header.
@@ -58,27 +63,27 @@ private:
     };
 
 protected:
-    static constexpr size_t ENTITY_INDEX = sizeof ... (Elements);
+    static constexpr size_t ENTITY_INDEX = STORAGE::getArrayCount() - 1;
 
 public:
-    using SoA = StructureOfArrays<Elements ..., Entity>;
+    using SoA = STORAGE;
 
     using Instance = EntityInstanceBase::Type;
 
-    SingleInstanceComponentManager() noexcept {
+    SingleInstanceComponentManagerBase() noexcept {
         // We always start with a dummy entry because index=0 is reserved. The component
         // at index = 0, is guaranteed to be default-initialized.
         // Sub-classes can use this to their advantage.
         mData.push_back();
     }
 
-    SingleInstanceComponentManager(SingleInstanceComponentManager&& rhs) noexcept {/* = default */}
-    SingleInstanceComponentManager& operator=(SingleInstanceComponentManager&& rhs) noexcept {/* = default */}
-    ~SingleInstanceComponentManager() noexcept = default;
+    SingleInstanceComponentManagerBase(SingleInstanceComponentManagerBase&& rhs) noexcept {/* = default */}
+    SingleInstanceComponentManagerBase& operator=(SingleInstanceComponentManagerBase&& rhs) noexcept {/* = default */}
+    ~SingleInstanceComponentManagerBase() noexcept = default;
 
     // not copyable
-    SingleInstanceComponentManager(SingleInstanceComponentManager const& rhs) = delete;
-    SingleInstanceComponentManager& operator=(SingleInstanceComponentManager const& rhs) = delete;
+    SingleInstanceComponentManagerBase(SingleInstanceComponentManagerBase const& rhs) = delete;
+    SingleInstanceComponentManagerBase& operator=(SingleInstanceComponentManagerBase const& rhs) = delete;
 
 
     // returns true if the given Entity has a component of this Manager
@@ -105,6 +110,11 @@ public:
         return getComponentCount() == 0;
     }
 
+    // returns the number of bytes allocated for the components, the entity map excluded
+    size_t getMemorySize() const noexcept {
+        return mData.getMemorySize();
+    }
+
     // returns a pointer to the Entity array. This is basically the list
     // of entities this component manager handles.
     // The pointer becomes invalid when adding or removing a component.
@@ -176,13 +186,13 @@ public:
     template<size_t ElementIndex>
     constexpr typename SoA::template TypeAt<ElementIndex>& elementAt(Instance index) noexcept {
         assert(index);
-        return data<ElementIndex>()[index];
+        return mData.template elementAt<ElementIndex>(index);
     }
 
     template<size_t ElementIndex>
     constexpr typename SoA::template TypeAt<ElementIndex> const& elementAt(Instance index) const noexcept {
         assert(index);
-        return data<ElementIndex>()[index];
+        return mData.template elementAt<ElementIndex>(index);
     }
 
     // returns a pointer to the RAW ARRAY of components including the first dummy component
@@ -195,7 +205,7 @@ public:
     // We need our own version of Field because mData is private
     template<size_t E>
     struct Field : public SoA::template Field<E> {
-        constexpr Field(SingleInstanceComponentManager& soa, EntityInstanceBase::Type i) noexcept
+        constexpr Field(SingleInstanceComponentManagerBase& soa, EntityInstanceBase::Type i) noexcept
                 : SoA::template Field<E>{ soa.mData, i } {
         }
         using SoA::template Field<E>::operator =;
@@ -234,24 +244,31 @@ protected:
     template<typename REMOVE>
     void gc(const EntityManager& em, size_t ratio,
             REMOVE removeComponent) noexcept {
-        Entity const* entities = getEntities();
         size_t count = getComponentCount();
         size_t aliveInARow = 0;
         default_random_engine& rng = mRng;
         #pragma nounroll
         while (count && aliveInARow < ratio) {
             // note: using the modulo favorizes lower number
-            size_t i = rng() % count;
-            if (UTILS_LIKELY(em.isAlive(entities[i]))) {
+            Entity e = getEntity(Instance(begin() + rng() % count));
+            if (UTILS_LIKELY(em.isAlive(e))) {
                 ++aliveInARow;
                 continue;
             }
             aliveInARow = 0;
             count--;
-            removeComponent(entities[i]);
+            removeComponent(e);
         }
     }
 
+private:
+    template<size_t ... Is>
+    void moveComponent(size_t from, size_t to, std::index_sequence<Is...>) noexcept {
+        SoA& soa = mData;
+        int UTILS_UNUSED dummy[] = {
+                (soa.template elementAt<Is>(to) = std::move(soa.template elementAt<Is>(from)), 0)... };
+    }
+
 protected:
     SoA mData;
 
@@ -262,9 +279,9 @@ private:
 };
 
 // Keep these outside of the class because CLion has trouble parsing them
-template<typename ... Elements>
-typename SingleInstanceComponentManager<Elements ...>::Instance
-SingleInstanceComponentManager<Elements ...>::addComponent(Entity e) {
+template<typename STORAGE>
+typename SingleInstanceComponentManagerBase<STORAGE>::Instance
+SingleInstanceComponentManagerBase<STORAGE>::addComponent(Entity e) {
     Instance ci = 0;
     if (!e.isNull()) {
         if (!hasComponent(e)) {
@@ -283,9 +300,9 @@ SingleInstanceComponentManager<Elements ...>::addComponent(Entity e) {
 }
 
 // Keep these outside of the class because CLion has trouble parsing them
-template <typename ... Elements>
-typename SingleInstanceComponentManager<Elements ...>::Instance
-SingleInstanceComponentManager<Elements ... >::removeComponent(Entity e) {
+template <typename STORAGE>
+typename SingleInstanceComponentManagerBase<STORAGE>::Instance
+SingleInstanceComponentManagerBase<STORAGE>::removeComponent(Entity e) {
     auto& map = mInstanceMap;
     auto pos = map.find(e);
     if (UTILS_LIKELY(pos != map.end())) {
@@ -295,9 +312,7 @@ SingleInstanceComponentManager<Elements ... >::removeComponent(Entity e) {
         if (last != index) {
             // move the last item to where we removed this component, as to keep
             // the array tightly packed.
-            mData.forEach([index, last](auto* p) {
-                p[index] = std::move(p[last]);
-            });
+            moveComponent(last, index, std::make_index_sequence<SoA::getArrayCount()>());
 
             Entity lastEntity = mData.template elementAt<ENTITY_INDEX>(index);
             map[lastEntity] = index;
@@ -309,6 +324,18 @@ SingleInstanceComponentManager<Elements ... >::removeComponent(Entity e) {
     return 0;
 }
 
+// Single instance component manager storing its components in contiguous arrays.
+template <typename ... Elements>
+class SingleInstanceComponentManager :
+        public SingleInstanceComponentManagerBase<StructureOfArrays<Elements ..., Entity>> {
+};
+
+// Single instance component manager storing its components in chunks, adding components never
+// moves the existing ones. Only elementAt<>() and Field<> can access the components.
+template <typename ... Elements>
+class ChunkedSingleInstanceComponentManager :
+        public SingleInstanceComponentManagerBase<ChunkedStructureOfArrays<Elements ..., Entity>> {
+};
 
 } // namespace filament
 
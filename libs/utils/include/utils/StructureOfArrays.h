@@ -33,6 +33,69 @@
 
 namespace utils {
 
+namespace details {
+
+// Acts like a reference to the field E of the element i of a SoA. SoA can be any container
+// providing TypeAt<> and elementAt<>(), e.g. StructureOfArraysBase.
+template <typename SoA, size_t E>
+struct StructureOfArraysField {
+    SoA& soa;
+    EntityInstanceBase::Type i;
+    using Type = typename SoA::template TypeAt<E>;
+
+    UTILS_ALWAYS_INLINE StructureOfArraysField& operator = (StructureOfArraysField&& rhs) noexcept {
+        soa.template elementAt<E>(i) = soa.template elementAt<E>(rhs.i);
+        return *this;
+    }
+
+    // auto-conversion to the field's type
+    UTILS_ALWAYS_INLINE constexpr operator Type&() noexcept {
+        return soa.template elementAt<E>(i);
+    }
+    UTILS_ALWAYS_INLINE constexpr operator Type const&() const noexcept {
+        return soa.template elementAt<E>(i);
+    }
+    // dereferencing the selected field
+    UTILS_ALWAYS_INLINE constexpr Type& operator ->() noexcept {
+        return soa.template elementAt<E>(i);
+    }
+    UTILS_ALWAYS_INLINE constexpr Type const& operator ->() const noexcept {
+        return soa.template elementAt<E>(i);
+    }
+    // address-of the selected field
+    UTILS_ALWAYS_INLINE constexpr Type* operator &() noexcept {
+        return &soa.template elementAt<E>(i);
+    }
+    UTILS_ALWAYS_INLINE constexpr Type const* operator &() const noexcept {
+        return &soa.template elementAt<E>(i);
+    }
+    // assignment to the field
+    UTILS_ALWAYS_INLINE constexpr Type const& operator = (Type const& other) noexcept {
+        return (soa.template elementAt<E>(i) = other);
+    }
+    UTILS_ALWAYS_INLINE constexpr Type const& operator = (Type&& other) noexcept {
+        return (soa.template elementAt<E>(i) = other);
+    }
+    // comparisons
+    UTILS_ALWAYS_INLINE constexpr bool operator==(Type const& other) const {
+        return (soa.template elementAt<E>(i) == other);
+    }
+    UTILS_ALWAYS_INLINE constexpr bool operator!=(Type const& other) const {
+        return (soa.template elementAt<E>(i) != other);
+    }
+    // calling the field
+    template <typename ... ARGS>
+    UTILS_ALWAYS_INLINE constexpr decltype(auto) operator()(ARGS&& ... args) noexcept {
+        return soa.template elementAt<E>(i)(std::forward<ARGS>(args)...);
+    }
+    template <typename ... ARGS>
+    UTILS_ALWAYS_INLINE constexpr decltype(auto) operator()(ARGS&& ... args) const noexcept {
+        return soa.template elementAt<E>(i)(std::forward<ARGS>(args)...);
+    }
+};
+
+} // namespace details
+
 template <typename Allocator, typename ... Elements>
 class StructureOfArraysBase {
     // number of elements
@@ -261,6 +324,11 @@ public:
         return mCapacity;
     }
 
+    // return the number of bytes allocated for the arrays
+    size_t getMemorySize() const noexcept {
+        return mCapacity ? getNeededSize(mCapacity) : 0;
+    }
+
     // set the capacity of the array. the capacity cannot be smaller than the current size,
     // the call is a no-op in that case.
     UTILS_NOINLINE
@@ -427,62 +495,9 @@ public:
         return data<ElementIndex>()[size() - 1];
     }
 
+    // a reference to the field E of an element
     template <size_t E>
-    struct Field {
-        SoA& soa;
-        EntityInstanceBase::Type i;
-        using Type = typename SoA::template TypeAt<E>;
-
-        UTILS_ALWAYS_INLINE Field& operator = (Field&& rhs) noexcept {
-            soa.elementAt<E>(i) = soa.elementAt<E>(rhs.i);
-            return *this;
-        }
-
-        // auto-conversion to the field's type
-        UTILS_ALWAYS_INLINE constexpr operator Type&() noexcept {
-            return soa.elementAt<E>(i);
-        }
-        UTILS_ALWAYS_INLINE constexpr operator Type const&() const noexcept {
-            return soa.elementAt<E>(i);
-        }
-        // dereferencing the selected field
-        UTILS_ALWAYS_INLINE constexpr Type& operator ->() noexcept {
-            return soa.elementAt<E>(i);
-        }
-        UTILS_ALWAYS_INLINE constexpr Type const& operator ->() const noexcept {
-            return soa.elementAt<E>(i);
-        }
-        // address-of the selected field
-        UTILS_ALWAYS_INLINE constexpr Type* operator &() noexcept {
-            return &soa.elementAt<E>(i);
-        }
-        UTILS_ALWAYS_INLINE constexpr Type const* operator &() const noexcept {
-            return &soa.elementAt<E>(i);
-        }
-        // assignment to the field
-        UTILS_ALWAYS_INLINE constexpr Type const& operator = (Type const& other) noexcept {
-            return (soa.elementAt<E>(i) = other);
-        }
-        UTILS_ALWAYS_INLINE constexpr Type const& operator = (Type&& other) noexcept {
-            return (soa.elementAt<E>(i) = other);
-        }
-        // comparisons
-        UTILS_ALWAYS_INLINE constexpr bool operator==(Type const& other) const {
-            return (soa.elementAt<E>(i) == other);
-        }
-        UTILS_ALWAYS_INLINE constexpr bool operator!=(Type const& other) const {
-            return (soa.elementAt<E>(i) != other);
-        }
-        // calling the field
-        template <typename ... ARGS>
-        UTILS_ALWAYS_INLINE constexpr decltype(auto) operator()(ARGS&& ... args) noexcept {
-            return soa.elementAt<E>(i)(std::forward<ARGS>(args)...);
-        }
-        template <typename ... ARGS>
-        UTILS_ALWAYS_INLINE constexpr decltype(auto) operator()(ARGS&& ... args) const noexcept {
-            return soa.elementAt<E>(i)(std::forward<ARGS>(args)...);
-        }
-    };
+    using Field = details::StructureOfArraysField<SoA, E>;
 
 private:
     template<typename T>
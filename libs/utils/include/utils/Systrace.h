@@ -94,6 +94,12 @@
 #define SYSTRACE_VALUE64(name, val) \
         ___tracer.value(SYSTRACE_TAG, name, int64_t(val))
 
+// recording is only needed on platforms without atrace, see below
+#define SYSTRACE_START_RECORDING()
+#define SYSTRACE_STOP_RECORDING()
+#define SYSTRACE_DUMP(path) false
+#define SYSTRACE_THREAD_NAME(name)
+
 // ------------------------------------------------------------------------------------------------
 // No user serviceable code below...
 // ------------------------------------------------------------------------------------------------
@@ -222,15 +228,160 @@ private:
 #else // !ANDROID
 // ------------------------------------------------------------------------------------------------
 
-#define SYSTRACE_ENABLE()
-#define SYSTRACE_DISABLE()
-#define SYSTRACE_CONTEXT()
-#define SYSTRACE_NAME(name)
-#define SYSTRACE_CALL()
-#define SYSTRACE_ASYNC_BEGIN(name, cookie)
-#define SYSTRACE_ASYNC_END(name, cookie)
-#define SYSTRACE_VALUE32(name, val)
-#define SYSTRACE_VALUE64(name, val)
+/*
+ * There is no atrace outside of Android, instead, while recording is on, the SYSTRACE_ events are
+ * recorded into per-thread ring buffers which can be written as a Chrome trace (JSON), to be
+ * viewed with chrome://tracing or https://ui.perfetto.dev.
+ *
+ * SYSTRACE_START_RECORDING() / SYSTRACE_STOP_RECORDING() start and stop recording for all the
+ * enabled tags, and SYSTRACE_DUMP(path) writes the recorded events to the file at path.
+ */
+
+#include <atomic>
+
+#include <stdint.h>
+
+#include <utils/compiler.h>
+
+#ifndef SYSTRACE_TAG
+#define SYSTRACE_TAG (SYSTRACE_TAG_ALWAYS)
+#endif
+
+#define SYSTRACE_ENABLE() utils::details::Systrace::enable(SYSTRACE_TAG)
+#define SYSTRACE_DISABLE() utils::details::Systrace::disable(SYSTRACE_TAG)
+#define SYSTRACE_CONTEXT() utils::details::Systrace ___tracer(SYSTRACE_TAG)
+#define SYSTRACE_NAME(name) utils::details::ScopedTrace ___tracer(SYSTRACE_TAG, name)
+#define SYSTRACE_CALL() SYSTRACE_NAME(__FUNCTION__)
+#define SYSTRACE_ASYNC_BEGIN(name, cookie) ___tracer.asyncBegin(SYSTRACE_TAG, name, cookie)
+#define SYSTRACE_ASYNC_END(name, cookie) ___tracer.asyncEnd(SYSTRACE_TAG, name, cookie)
+#define SYSTRACE_VALUE32(name, val) ___tracer.value(SYSTRACE_TAG, name, int32_t(val))
+#define SYSTRACE_VALUE64(name, val) ___tracer.value(SYSTRACE_TAG, name, int64_t(val))
+
+#define SYSTRACE_START_RECORDING() utils::details::Systrace::startRecording()
+#define SYSTRACE_STOP_RECORDING() utils::details::Systrace::stopRecording()
+#define SYSTRACE_DUMP(path) utils::details::Systrace::dump(path)
+
+// names the calling thread in the recorded traces, the name is copied
+#define SYSTRACE_THREAD_NAME(name) utils::details::Systrace::setThreadName(name)
+
+// ------------------------------------------------------------------------------------------------
+// No user serviceable code below...
+// ------------------------------------------------------------------------------------------------
+
+namespace utils {
+namespace details {
+
+class Systrace {
+public:
+
+    enum tags {
+        NEVER       = SYSTRACE_TAG_NEVER,
+        ALWAYS      = SYSTRACE_TAG_ALWAYS,
+        FILAMENT    = SYSTRACE_TAG_FILAMENT,
+        JOBSYSTEM   = SYSTRACE_TAG_JOBSYSTEM
+    };
+
+    Systrace(uint32_t tag) noexcept {
+        if (tag) init(tag);
+    }
+
+    static void enable(uint32_t tags) noexcept;
+    static void disable(uint32_t tags) noexcept;
+
+    static void startRecording() noexcept;
+    static void stopRecording() noexcept;
+
+    // writes the events recorded so far as a Chrome trace, returns false if the file couldn't be
+    // written. Events recorded concurrently may be missing, stop recording first.
+    static bool dump(const char* path) noexcept;
+
+    static void setThreadName(const char* name) noexcept;
+
+    inline void asyncBegin(uint32_t tag, const char* name, int32_t cookie) noexcept {
+        if (tag && UTILS_UNLIKELY(mIsTracingEnabled)) {
+            record('b', name, cookie);
+        }
+    }
+
+    inline void asyncEnd(uint32_t tag, const char* name, int32_t cookie) noexcept {
+        if (tag && UTILS_UNLIKELY(mIsTracingEnabled)) {
+            record('e', name, cookie);
+        }
+    }
+
+    inline void value(uint32_t tag, const char* name, int32_t value) noexcept {
+        if (tag && UTILS_UNLIKELY(mIsTracingEnabled)) {
+            record('C', name, value);
+        }
+    }
+
+    inline void value(uint32_t tag, const char* name, int64_t value) noexcept {
+        if (tag && UTILS_UNLIKELY(mIsTracingEnabled)) {
+            record('C', name, value);
+        }
+    }
+
+private:
+    friend class ScopedTrace;
+
+    // a scope is always closed if it was opened, even if recording stopped in between
+    inline void traceBegin(uint32_t tag, const char* name) noexcept {
+        if (tag && UTILS_UNLIKELY(mIsTracingEnabled)) {
+            record('B', name, 0);
+        }
+    }
+
+    inline void traceEnd(uint32_t tag) noexcept {
+        if (tag && UTILS_UNLIKELY(mIsTracingEnabled)) {
+            record('E', nullptr, 0);
+        }
+    }
+
+    inline void init(uint32_t tag) noexcept {
+        mIsTracingEnabled = isTracingEnabled(tag);
+    }
+
+    static bool isTracingEnabled(uint32_t tag) noexcept {
+        // tracing is enabled only while recording
+        return bool(sIsTracingEnabled.load(std::memory_order_relaxed) & tag);
+    }
+
+    static void record(char type, const char* name, int64_t value) noexcept;
+
+    // the enabled tags, or 0 when not recording
+    static std::atomic<uint32_t> sIsTracingEnabled;
+
+    // cached value for faster access, no need to be initialized
+    bool mIsTracingEnabled;
+};
+
+// ------------------------------------------------------------------------------------------------
+
+class ScopedTrace {
+public:
+    ScopedTrace(uint32_t tag, const char* name) noexcept : mTrace(tag), mTag(tag) {
+        mTrace.traceBegin(tag, name);
+    }
+
+    inline ~ScopedTrace() noexcept {
+        mTrace.traceEnd(mTag);
+    }
+
+    inline void value(uint32_t tag, const char* name, int32_t v) noexcept {
+        mTrace.value(tag, name, v);
+    }
+
+    inline void value(uint32_t tag, const char* name, int64_t v) noexcept {
+        mTrace.value(tag, name, v);
+    }
+
+private:
+    Systrace mTrace;
+    const uint32_t mTag;
+};
+
+} // namespace details
+} // namespace utils
 
 #endif // ANDROID
 
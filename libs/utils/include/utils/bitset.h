@@ -31,6 +31,17 @@
 #       include <arm_neon.h>
 #       define TNT_UTILS_BITSET_USE_NEON 1
 #   endif
+#elif defined(__SSE2__) || defined(_M_X64)
+#   include <emmintrin.h>
+#   define TNT_UTILS_BITSET_USE_SSE2 1
+#   if defined(__SSSE3__)
+#       include <tmmintrin.h>
+#       define TNT_UTILS_BITSET_USE_SSSE3 1
+#   endif
+#   if defined(__AVX2__)
+#       include <immintrin.h>
+#       define TNT_UTILS_BITSET_USE_AVX2 1
+#   endif
 #endif
 
 namespace utils {
@@ -39,6 +50,10 @@ namespace utils {
  * This bitset<> class is different from std::bitset<> in that it allows us to control
  * the exact storage size. This is useful for small bitset (e.g. < 64, on 64-bits machines).
  * It also allows for lexicographical compares (i.e. sorting).
+ *
+ * The operations on whole bitsets use NEON, SSE2 or AVX2 when the bitset is a multiple of their
+ * register size, e.g. for the light masks of the froxelizer. The storage isn't aligned to the
+ * registers, so the x86 paths use unaligned loads and stores.
  */
 
 template<typename T, size_t N = 1,
@@ -130,6 +145,44 @@ public:
             }
             return vaddlvq_u8(counts);
         } else
+#endif
+#if defined(TNT_UTILS_BITSET_USE_AVX2)
+        if (BIT_COUNT % 256 == 0) {
+            // count the bits of each nibble with a lookup, and sum the bytes of each 64-bits lane
+            __m256i const* const p = (__m256i const*) storage;
+            const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+            const __m256i low = _mm256_set1_epi8(0x0F);
+            __m256i counts = _mm256_setzero_si256();
+            for (size_t i = 0; i < BIT_COUNT / 256; ++i) {
+                const __m256i v = _mm256_loadu_si256(p + i);
+                const __m256i c = _mm256_add_epi8(
+                        _mm256_shuffle_epi8(lut, _mm256_and_si256(v, low)),
+                        _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), low)));
+                counts = _mm256_add_epi64(counts, _mm256_sad_epu8(c, _mm256_setzero_si256()));
+            }
+            uint64_t lanes[4];
+            _mm256_storeu_si256((__m256i*) lanes, counts);
+            return size_t(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+        } else
+#endif
+#if defined(TNT_UTILS_BITSET_USE_SSSE3)
+        if (BIT_COUNT % 128 == 0) {
+            __m128i const* const p = (__m128i const*) storage;
+            const __m128i lut = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+            const __m128i low = _mm_set1_epi8(0x0F);
+            __m128i counts = _mm_setzero_si128();
+            for (size_t i = 0; i < BIT_COUNT / 128; ++i) {
+                const __m128i v = _mm_loadu_si128(p + i);
+                const __m128i c = _mm_add_epi8(
+                        _mm_shuffle_epi8(lut, _mm_and_si128(v, low)),
+                        _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), low)));
+                counts = _mm_add_epi64(counts, _mm_sad_epu8(c, _mm_setzero_si128()));
+            }
+            uint64_t lanes[2];
+            _mm_storeu_si128((__m128i*) lanes, counts);
+            return size_t(lanes[0] + lanes[1]);
+        } else
 #endif
         {
             T r = utils::popcount(storage[0]);
@@ -150,6 +203,26 @@ public:
             }
             return bool(r[0] | r[1]);
         } else
+#endif
+#if defined(TNT_UTILS_BITSET_USE_AVX2)
+        if (BIT_COUNT % 256 == 0) {
+            __m256i const* const p = (__m256i const*) storage;
+            __m256i r = _mm256_loadu_si256(p);
+            for (size_t i = 1; i < BIT_COUNT / 256; ++i) {
+                r = _mm256_or_si256(r, _mm256_loadu_si256(p + i));
+            }
+            return !_mm256_testz_si256(r, r);
+        } else
+#endif
+#if defined(TNT_UTILS_BITSET_USE_SSE2)
+        if (BIT_COUNT % 128 == 0) {
+            __m128i const* const p = (__m128i const*) storage;
+            __m128i r = _mm_loadu_si128(p);
+            for (size_t i = 1; i < BIT_COUNT / 128; ++i) {
+                r = _mm_or_si128(r, _mm_loadu_si128(p + i));
+            }
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(r, _mm_setzero_si128())) != 0xFFFF;
+        } else
 #endif
         {
             T r = storage[0];
@@ -174,6 +247,26 @@ public:
             }
             return T(~(r[0] & r[1])) == T(0);
         } else
+#endif
+#if defined(TNT_UTILS_BITSET_USE_AVX2)
+        if (BIT_COUNT % 256 == 0) {
+            __m256i const* const p = (__m256i const*) storage;
+            __m256i r = _mm256_loadu_si256(p);
+            for (size_t i = 1; i < BIT_COUNT / 256; ++i) {
+                r = _mm256_and_si256(r, _mm256_loadu_si256(p + i));
+            }
+            return _mm256_testc_si256(r, _mm256_set1_epi8(-1));
+        } else
+#endif
+#if defined(TNT_UTILS_BITSET_USE_SSE2)
+        if (BIT_COUNT % 128 == 0) {
+            __m128i const* const p = (__m128i const*) storage;
+            __m128i r = _mm_loadu_si128(p);
+            for (size_t i = 1; i < BIT_COUNT / 128; ++i) {
+                r = _mm_and_si128(r, _mm_loadu_si128(p + i));
+            }
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(r, _mm_set1_epi8(-1))) == 0xFFFF;
+        } else
 #endif
         {
             T r = storage[0];
@@ -195,6 +288,29 @@ public:
             }
             return bool(r[0] | r[1]);
         } else
+#endif
+#if defined(TNT_UTILS_BITSET_USE_AVX2)
+        if (BIT_COUNT % 256 == 0) {
+            __m256i const* const p = (__m256i const*) storage;
+            __m256i const* const q = (__m256i const*) b.storage;
+            __m256i r = _mm256_setzero_si256();
+            for (size_t i = 0; i < BIT_COUNT / 256; ++i) {
+                r = _mm256_or_si256(r,
+                        _mm256_xor_si256(_mm256_loadu_si256(p + i), _mm256_loadu_si256(q + i)));
+            }
+            return !_mm256_testz_si256(r, r);
+        } else
+#endif
+#if defined(TNT_UTILS_BITSET_USE_SSE2)
+        if (BIT_COUNT % 128 == 0) {
+            __m128i const* const p = (__m128i const*) storage;
+            __m128i const* const q = (__m128i const*) b.storage;
+            __m128i r = _mm_setzero_si128();
+            for (size_t i = 0; i < BIT_COUNT / 128; ++i) {
+                r = _mm_or_si128(r, _mm_xor_si128(_mm_loadu_si128(p + i), _mm_loadu_si128(q + i)));
+            }
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(r, _mm_setzero_si128())) != 0xFFFF;
+        } else
 #endif
         {
             T r = storage[0] ^ b.storage[0];
@@ -218,6 +334,26 @@ public:
                 p[i] &= q[i];
             }
         } else
+#endif
+#if defined(TNT_UTILS_BITSET_USE_AVX2)
+        if (BIT_COUNT % 256 == 0) {
+            __m256i* const p = (__m256i*) storage;
+            __m256i const* const q = (__m256i const*) b.storage;
+            for (size_t i = 0; i < BIT_COUNT / 256; ++i) {
+                _mm256_storeu_si256(p + i,
+                        _mm256_and_si256(_mm256_loadu_si256(p + i), _mm256_loadu_si256(q + i)));
+            }
+        } else
+#endif
+#if defined(TNT_UTILS_BITSET_USE_SSE2)
+        if (BIT_COUNT % 128 == 0) {
+            __m128i* const p = (__m128i*) storage;
+            __m128i const* const q = (__m128i const*) b.storage;
+            for (size_t i = 0; i < BIT_COUNT / 128; ++i) {
+                _mm_storeu_si128(p + i,
+                        _mm_and_si128(_mm_loadu_si128(p + i), _mm_loadu_si128(q + i)));
+            }
+        } else
 #endif
         {
             for (size_t i = 0; i < N; ++i) {
@@ -236,6 +372,26 @@ public:
                 p[i] |= q[i];
             }
         } else
+#endif
+#if defined(TNT_UTILS_BITSET_USE_AVX2)
+        if (BIT_COUNT % 256 == 0) {
+            __m256i* const p = (__m256i*) storage;
+            __m256i const* const q = (__m256i const*) b.storage;
+            for (size_t i = 0; i < BIT_COUNT / 256; ++i) {
+                _mm256_storeu_si256(p + i,
+                        _mm256_or_si256(_mm256_loadu_si256(p + i), _mm256_loadu_si256(q + i)));
+            }
+        } else
+#endif
+#if defined(TNT_UTILS_BITSET_USE_SSE2)
+        if (BIT_COUNT % 128 == 0) {
+            __m128i* const p = (__m128i*) storage;
+            __m128i const* const q = (__m128i const*) b.storage;
+            for (size_t i = 0; i < BIT_COUNT / 128; ++i) {
+                _mm_storeu_si128(p + i,
+                        _mm_or_si128(_mm_loadu_si128(p + i), _mm_loadu_si128(q + i)));
+            }
+        } else
 #endif
         {
             for (size_t i = 0; i < N; ++i) {
@@ -254,6 +410,26 @@ public:
                 p[i] ^= q[i];
             }
         } else
+#endif
+#if defined(TNT_UTILS_BITSET_USE_AVX2)
+        if (BIT_COUNT % 256 == 0) {
+            __m256i* const p = (__m256i*) storage;
+            __m256i const* const q = (__m256i const*) b.storage;
+            for (size_t i = 0; i < BIT_COUNT / 256; ++i) {
+                _mm256_storeu_si256(p + i,
+                        _mm256_xor_si256(_mm256_loadu_si256(p + i), _mm256_loadu_si256(q + i)));
+            }
+        } else
+#endif
+#if defined(TNT_UTILS_BITSET_USE_SSE2)
+        if (BIT_COUNT % 128 == 0) {
+            __m128i* const p = (__m128i*) storage;
+            __m128i const* const q = (__m128i const*) b.storage;
+            for (size_t i = 0; i < BIT_COUNT / 128; ++i) {
+                _mm_storeu_si128(p + i,
+                        _mm_xor_si128(_mm_loadu_si128(p + i), _mm_loadu_si128(q + i)));
+            }
+        } else
 #endif
         {
             for (size_t i = 0; i < N; ++i) {
@@ -273,6 +449,26 @@ public:
                 p[i] = ~q[i];
             }
         } else
+#endif
+#if defined(TNT_UTILS_BITSET_USE_AVX2)
+        if (BIT_COUNT % 256 == 0) {
+            __m256i* const p = (__m256i*) r.storage;
+            __m256i const* const q = (__m256i const*) storage;
+            const __m256i ones = _mm256_set1_epi8(-1);
+            for (size_t i = 0; i < BIT_COUNT / 256; ++i) {
+                _mm256_storeu_si256(p + i, _mm256_xor_si256(_mm256_loadu_si256(q + i), ones));
+            }
+        } else
+#endif
+#if defined(TNT_UTILS_BITSET_USE_SSE2)
+        if (BIT_COUNT % 128 == 0) {
+            __m128i* const p = (__m128i*) r.storage;
+            __m128i const* const q = (__m128i const*) storage;
+            const __m128i ones = _mm_set1_epi8(-1);
+            for (size_t i = 0; i < BIT_COUNT / 128; ++i) {
+                _mm_storeu_si128(p + i, _mm_xor_si128(_mm_loadu_si128(q + i), ones));
+            }
+        } else
 #endif
         {
             for (size_t i = 0; i < N; ++i) {
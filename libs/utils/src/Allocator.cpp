@@ -51,6 +51,46 @@ void LinearAllocator::swap(LinearAllocator& rhs) noexcept {
     std::swap(mCurrent, rhs.mCurrent);
 }
 
+// ------------------------------------------------------------------------------------------------
+// LinearAllocatorWithFallback
+// ------------------------------------------------------------------------------------------------
+
+void* LinearAllocatorWithFallback::allocFromHeap(size_t size, size_t alignment, size_t extra) noexcept {
+    // the new block is at least as large as the current one, so that we don't chain lots of
+    // small blocks when the area is too small.
+    const size_t capacity = mAllocator.allocated() + mAllocator.available();
+    const size_t blockSize = std::max(capacity, sizeof(HeapBlock) + size + alignment + extra);
+    void* const p = ::malloc(blockSize);
+    if (UTILS_UNLIKELY(!p)) {
+        return nullptr;
+    }
+
+    // the block's header saves the current allocator, which is restored by rewind()
+    HeapBlock* const block = new(p) HeapBlock{ mHeapBlocks, std::move(mAllocator), blockSize };
+    mAllocator = LinearAllocator(pointermath::add(block, sizeof(HeapBlock)),
+            pointermath::add(p, blockSize));
+    mHeapBlocks = block;
+    mHeapAllocated += blockSize;
+    return mAllocator.alloc(size, alignment, extra);
+}
+
+void LinearAllocatorWithFallback::rewindHeapBlocks(void* p) noexcept {
+    // free the blocks allocated after p, p is either in the area or in one of the heap blocks
+    while (mHeapBlocks) {
+        void* const begin = mAllocator.base();
+        void* const end = pointermath::add(begin, mAllocator.allocated() + mAllocator.available());
+        if (p >= begin && p <= end) {
+            break;
+        }
+        HeapBlock* const block = mHeapBlocks;
+        mAllocator = std::move(block->allocator);
+        mHeapBlocks = block->previous;
+        mHeapAllocated -= block->size;
+        block->~HeapBlock();
+        ::free(block);
+    }
+}
+
 // ------------------------------------------------------------------------------------------------
 // FreeList
 // ------------------------------------------------------------------------------------------------
@@ -44,6 +44,15 @@ CString::CString(const char* cstr)
         : CString(cstr, size_type(cstr ? strlen(cstr) : 0)) {
 }
 
+CString::CString(size_type length) {
+    if (length) {
+        Data* p = (Data*)malloc(sizeof(Data) + length + 1);
+        p->length = length;
+        mCStr = (value_type*)(p + 1);
+        mCStr[length] = '\0';
+    }
+}
+
 CString::CString(const CString& rhs)
         : CString(rhs.c_str(), rhs.size()) {
 }
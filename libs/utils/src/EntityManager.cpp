@@ -16,6 +16,8 @@
 
 #include "EntityManagerImpl.h"
 
+#include <utils/ThreadLocal.h>
+
 namespace utils {
 
 EntityManager::EntityManager()
@@ -35,6 +37,19 @@ EntityManager& EntityManager::get() noexcept {
     return *instance;
 }
 
+size_t EntityManagerImpl::getThreadCacheIndex() noexcept {
+    // threads are given a cache in turn the first time they need one, the cache is only shared
+    // when there are more than CACHE_COUNT threads.
+    static std::atomic<uint32_t> sThreadCount = { 0 };
+    static UTILS_DEFINE_TLS(uint32_t) sCacheIndex;  // 0 until the thread has a cache
+    uint32_t index = sCacheIndex;
+    if (UTILS_UNLIKELY(!index)) {
+        index = sThreadCount.fetch_add(1, std::memory_order_relaxed) % CACHE_COUNT + 1;
+        sCacheIndex = index;
+    }
+    return index - 1;
+}
+
 void EntityManager::create(size_t n, Entity* entities) {
     static_cast<EntityManagerImpl *>(this)->create(n, entities);
 }
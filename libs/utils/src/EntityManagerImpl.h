@@ -19,6 +19,8 @@
 
 #include <utils/EntityManager.h>
 
+#include <algorithm>
+#include <atomic>
 #include <deque>
 #include <mutex>
 #include <set>
@@ -33,6 +35,11 @@ namespace utils {
 
 static constexpr const size_t MIN_FREE_INDICES = 1024;
 
+// Entities are created and destroyed through per-thread caches, which exchange indices with the
+// free list in batches of CACHE_BATCH_SIZE. Larger requests go to the free list directly.
+static constexpr const size_t CACHE_COUNT = 16;
+static constexpr const size_t CACHE_BATCH_SIZE = 64;
+
 class UTILS_PRIVATE EntityManagerImpl : public EntityManager {
 public:
 
@@ -43,74 +50,66 @@ public:
     using EntityManager::destroy;
 
     void create(size_t n, Entity* entities) {
-        Entity::Type index;
-        auto& freeList = mFreeList;
         uint8_t* const gens = mGens;
 
-        // this must be thread-safe, acquire the free-list mutex
-        std::lock_guard<Mutex> lock(mFreeListLock);
-        Entity::Type currentIndex = mCurrentIndex;
+        if (n >= CACHE_BATCH_SIZE) {
+            // this must be thread-safe, acquire the free-list mutex
+            std::lock_guard<Mutex> lock(mFreeListLock);
+            for (size_t i = 0; i < n; i++) {
+                Entity::Type index = allocateIndex();
+                entities[i] = index ? Entity{ makeIdentity(gens[index], index) } : Entity{};
+            }
+            return;
+        }
+
+        // the cache is normally only used by this thread, so this lock is uncontended
+        Cache& cache = getCache();
+        std::lock_guard<Mutex> lock(cache.lock);
         for (size_t i = 0; i < n; i++) {
-            // If we have more than a certain number of freed indices, get one from the list.
-            // this is a trade-off between how often we recycle indices and how large the free list
-            // can grow.
-            if (UTILS_UNLIKELY(currentIndex >= RAW_INDEX_COUNT || freeList.size() >= MIN_FREE_INDICES)) {
-
-                // this could only happen if we had gone through all the indices at least once
-                if (UTILS_UNLIKELY(freeList.empty())) {
-                    // return the null entity
+            if (UTILS_UNLIKELY(!cache.freeCount)) {
+                refill(cache);
+                if (UTILS_UNLIKELY(!cache.freeCount)) {
+                    // we're out of indices, return the null entity
                     entities[i] = {};
                     continue;
                 }
-
-                index = freeList.front();
-                freeList.pop_front();
-            } else {
-                // In the common case, we just grab the next index.
-                // This works only until all indices have been used once, at which point
-                // we're always in the slower case above. The idea is that we have enough indices
-                // that it doesn't happen in practice.
-                index = currentIndex++;
             }
+            Entity::Type index = cache.free[--cache.freeCount];
             entities[i] = Entity{ makeIdentity(gens[index], index) };
         }
-        mCurrentIndex = currentIndex;
     }
 
     void destroy(size_t n, Entity* entities) noexcept {
-        auto& freeList = mFreeList;
         uint8_t* const gens = mGens;
 
-        std::unique_lock<Mutex> lock(mFreeListLock);
-        for (size_t i = 0; i < n; i++) {
-            if (!entities[i]) {
-                // behave like free(), ok to free null Entity.
-                continue;
+        if (n >= CACHE_BATCH_SIZE) {
+            std::unique_lock<Mutex> lock(mFreeListLock);
+            for (size_t i = 0; i < n; i++) {
+                if (release(entities[i])) {
+                    mFreeList.push_back(getIndex(entities[i]));
+                }
             }
-
-            // it's an error to delete an Entity twice...
-            assert(isAlive(entities[i]));
-
-            // ... deleting a dead Entity will corrupt the internal state, so we protect ourselves
-            // against it. We don't guarantee anything about external state -- e.g. the listeners
-            // will be called.
-            if (isAlive(entities[i])) {
-                Entity::Type index = getIndex(entities[i]);
-                freeList.push_back(index);
-
-                // The generation update doesn't require the lock because it's only used for isAlive()
-                // and entities work as weak references -- it just means that isAlive() could return
-                // true a little longer than expected in some other threads.
-                // We do need a memory fence though, it is provided by the mFreeListLock.unlock() below.
-                gens[index]++;
+        } else {
+            Cache& cache = getCache();
+            std::lock_guard<Mutex> lock(cache.lock);
+            for (size_t i = 0; i < n; i++) {
+                if (release(entities[i])) {
+                    if (UTILS_UNLIKELY(cache.destroyedCount == CACHE_BATCH_SIZE)) {
+                        std::lock_guard<Mutex> freeListLock(mFreeListLock);
+                        flush(cache);
+                    }
+                    cache.destroyed[cache.destroyedCount++] = getIndex(entities[i]);
+                }
             }
         }
-        lock.unlock();
 
-        // notify our listeners that some entities are being destroyed
-        std::set<Listener*> listeners = getListeners();
-        for (auto const& l : listeners) {
-            l->onEntitiesDestroyed(n, entities);
+        // notify our listeners that some entities are being destroyed, they get the whole batch
+        // at once.
+        if (mListenerCount.load(std::memory_order_relaxed)) {
+            std::set<Listener*> listeners = getListeners();
+            for (auto const& l : listeners) {
+                l->onEntitiesDestroyed(n, entities);
+            }
         }
     }
 
@@ -118,6 +117,9 @@ public:
     void clear() noexcept {
         uint8_t* const gens = mGens;
 
+        for (Cache& cache : mCaches) {
+            cache.lock.lock();
+        }
         std::unique_lock<Mutex> lock(mFreeListLock);
 
         // make all indices that were ever used invalid
@@ -125,11 +127,16 @@ public:
             gens[i]++;
         }
 
-        // clear the free-list entirely.
+        // clear the free-list and the caches entirely.
         mCurrentIndex = 1;
         mFreeList.clear();
         mFreeList.shrink_to_fit();
         lock.unlock();
+        for (Cache& cache : mCaches) {
+            cache.freeCount = 0;
+            cache.destroyedCount = 0;
+            cache.lock.unlock();
+        }
 
         // notify our listeners that all entities are being destroyed
         std::set<Listener*> listeners = getListeners();
@@ -141,11 +148,13 @@ public:
     void registerListener(EntityManager::Listener* l) noexcept {
         std::lock_guard<Mutex> lock(mListenerLock);
         mListeners.insert(l);
+        mListenerCount.store(uint32_t(mListeners.size()), std::memory_order_relaxed);
     }
 
     void unregisterListener(EntityManager::Listener* l) noexcept {
         std::lock_guard<Mutex> lock(mListenerLock);
         mListeners.erase(l);
+        mListenerCount.store(uint32_t(mListeners.size()), std::memory_order_relaxed);
     }
 
     std::set<EntityManager::Listener*> getListeners() noexcept {
@@ -154,14 +163,103 @@ public:
     }
 
 private:
+    struct Cache {
+        Mutex lock;
+        uint32_t freeCount = 0;
+        uint32_t destroyedCount = 0;
+        Entity::Type free[CACHE_BATCH_SIZE];        // handed out from the back
+        Entity::Type destroyed[CACHE_BATCH_SIZE];   // not in the free list yet
+    };
+
+    // index of the cache of the calling thread
+    static size_t getThreadCacheIndex() noexcept;
+
+    Cache& getCache() noexcept {
+        return mCaches[getThreadCacheIndex()];
+    }
+
+    // returns 0 when we're out of indices. mFreeListLock must be held.
+    Entity::Type allocateIndex() noexcept {
+        auto& freeList = mFreeList;
+        // If we have more than a certain number of freed indices, get one from the list.
+        // this is a trade-off between how often we recycle indices and how large the free list
+        // can grow.
+        if (UTILS_UNLIKELY(mCurrentIndex >= RAW_INDEX_COUNT || freeList.size() >= MIN_FREE_INDICES)) {
+            // this could only happen if we had gone through all the indices at least once
+            if (UTILS_UNLIKELY(freeList.empty())) {
+                return 0;
+            }
+            Entity::Type index = freeList.front();
+            freeList.pop_front();
+            return index;
+        }
+        // In the common case, we just grab the next index.
+        // This works only until all indices have been used once, at which point
+        // we're always in the slower case above. The idea is that we have enough indices
+        // that it doesn't happen in practice.
+        return mCurrentIndex++;
+    }
+
+    // returns whether the entity's index can go back to the free list
+    bool release(Entity e) noexcept {
+        if (!e) {
+            // behave like free(), ok to free null Entity.
+            return false;
+        }
+
+        // it's an error to delete an Entity twice...
+        assert(isAlive(e));
+
+        // ... deleting a dead Entity will corrupt the internal state, so we protect ourselves
+        // against it. We don't guarantee anything about external state -- e.g. the listeners
+        // will be called.
+        if (!isAlive(e)) {
+            return false;
+        }
+
+        // The generation update doesn't require the free-list lock because it's only used for
+        // isAlive() and entities work as weak references -- it just means that isAlive() could
+        // return true a little longer than expected in some other threads.
+        // We do need a memory fence though, it is provided by the caller's unlock().
+        mGens[getIndex(e)]++;
+        return true;
+    }
+
+    // moves the destroyed indices of the cache to the free list. mFreeListLock must be held.
+    void flush(Cache& cache) noexcept {
+        mFreeList.insert(mFreeList.end(), cache.destroyed, cache.destroyed + cache.destroyedCount);
+        cache.destroyedCount = 0;
+    }
+
+    // gets a batch of indices for the cache, the destroyed ones go back to the free list first
+    // so they can be recycled.
+    void refill(Cache& cache) noexcept {
+        std::lock_guard<Mutex> lock(mFreeListLock);
+        flush(cache);
+        size_t count = 0;
+        while (count < CACHE_BATCH_SIZE) {
+            Entity::Type index = allocateIndex();
+            if (UTILS_UNLIKELY(!index)) {
+                break;
+            }
+            // indices are handed out in the order we got them
+            cache.free[CACHE_BATCH_SIZE - 1 - count++] = index;
+        }
+        std::copy_n(cache.free + CACHE_BATCH_SIZE - count, count, cache.free);
+        cache.freeCount = uint32_t(count);
+    }
+
     uint32_t mCurrentIndex = 1;
 
     // stores indices that got freed
     mutable Mutex mFreeListLock;
     std::deque<Entity::Type> mFreeList;
 
+    Cache mCaches[CACHE_COUNT];
+
     mutable Mutex mListenerLock;
     std::set<Listener*> mListeners;
+    std::atomic<uint32_t> mListenerCount = { 0 };
 };
 
 } // namespace utils
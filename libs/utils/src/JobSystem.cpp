@@ -24,9 +24,13 @@
 
 #include <utils/JobSystem.h>
 
+#include <chrono>
 #include <cmath>
+#include <limits>
 #include <random>
 
+#include <stdio.h>
+
 #include <utils/compiler.h>
 #include <utils/memalign.h>
 #include <utils/Panic.h>
@@ -103,12 +107,38 @@ void JobSystem::setThreadAffinity(uint32_t mask) noexcept {
 #endif
 }
 
-JobSystem::JobSystem(size_t threadCount, size_t adoptableThreadsCount) noexcept
-    : mJobPool("JobSystem Job pool", MAX_JOB_COUNT * sizeof(Job)),
-      mJobStorageBase(static_cast<Job *>(mJobPool.getAllocator().getCurrent()))
-{
+uint32_t JobSystem::getBigCoreMask() noexcept {
+    uint32_t mask = 0;
+#if defined(__linux__)
+    // offline CPUs don't report their frequency and are left out
+    uint32_t frequencies[32] = {};
+    uint32_t lowest = std::numeric_limits<uint32_t>::max();
+    for (uint32_t cpu = 0; cpu < 32; cpu++) {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%u/cpufreq/cpuinfo_max_freq", cpu);
+        FILE* file = fopen(path, "r");
+        if (file) {
+            if (fscanf(file, "%u", &frequencies[cpu]) == 1 && frequencies[cpu]) {
+                lowest = std::min(lowest, frequencies[cpu]);
+            }
+            fclose(file);
+        }
+    }
+    for (uint32_t cpu = 0; cpu < 32; cpu++) {
+        if (frequencies[cpu] > lowest) {
+            mask |= 1u << cpu;
+        }
+    }
+#endif
+    return mask;
+}
+
+JobSystem::JobSystem(size_t threadCount, size_t adoptableThreadsCount) noexcept {
     SYSTRACE_ENABLE();
 
+    UTILS_UNUSED bool added = addJobChunk();
+    assert(added);
+
     if (threadCount == 0) {
         // default value, system dependant
         size_t hwThreads = std::thread::hardware_concurrency();
@@ -139,6 +169,7 @@ JobSystem::JobSystem(size_t threadCount, size_t adoptableThreadsCount) noexcept
         auto& state = states[i];
         state.rndGen = default_random_engine(rd());
         state.mask = uint32_t(1UL << i);
+        state.spinDuration = DEFAULT_IDLE_SPIN_DURATION;
         state.js = this;
         if (i < hardwareThreadCount) {
             // don't start a thread of adoptable thread slots
@@ -157,6 +188,10 @@ JobSystem::~JobSystem() {
             state.thread.join();
         }
     }
+
+    for (auto& chunk : mJobChunks) {
+        aligned_free(chunk.load(std::memory_order_relaxed));
+    }
 }
 
 JobSystem* JobSystem::getJobSystem() noexcept {
@@ -191,7 +226,48 @@ inline JobSystem::ThreadState& JobSystem::getState() noexcept {
 }
 
 JobSystem::Job* JobSystem::allocateJob() noexcept {
-    return mJobPool.make<Job>();
+    Job* const job = static_cast<Job*>(mJobFreeList.get());
+    return UTILS_LIKELY(job) ? job : growJobPool();
+}
+
+UTILS_NOINLINE
+JobSystem::Job* JobSystem::growJobPool() noexcept {
+    SYSTRACE_CALL();
+    std::lock_guard<Mutex> lock(mJobPoolLock);
+    // another thread may have grown the pool, or released jobs, while we were waiting
+    Job* job = static_cast<Job*>(mJobFreeList.get());
+    if (!job && addJobChunk()) {
+        job = static_cast<Job*>(mJobFreeList.get());
+    }
+    if (UTILS_UNLIKELY(!job)) {
+        mJobPoolExhaustedCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+bool JobSystem::addJobChunk() noexcept {
+    const uint32_t index = mJobChunkCount.load(std::memory_order_relaxed);
+    if (index == MAX_JOB_CHUNK_COUNT) {
+        return false;
+    }
+    Job* const chunk = static_cast<Job*>(aligned_alloc(JOB_CHUNK_SIZE * sizeof(Job), alignof(Job)));
+    if (!chunk) {
+        return false;
+    }
+
+    // The chunk must be visible before any of its jobs can be found in a work queue.
+    mJobChunks[index].store(chunk, std::memory_order_release);
+    mJobChunkCount.store(index + 1, std::memory_order_relaxed);
+
+    // Jobs are constructed only once, their id is preserved while they're in the free list.
+    // They're added in reverse order, so they're handed out in memory order.
+    static_assert(offsetof(Job, id) >= sizeof(void*), "Job::id is overwritten by the free list");
+    for (size_t i = JOB_CHUNK_SIZE; i-- > 0;) {
+        Job* const job = new(chunk + i) Job();
+        job->id = uint16_t(index * JOB_CHUNK_SIZE + i);
+        mJobFreeList.put(job);
+    }
+    return true;
 }
 
 inline JobSystem::ThreadState& JobSystem::getStateToStealFrom(JobSystem::ThreadState& state) noexcept {
@@ -236,20 +312,69 @@ void JobSystem::loop(ThreadState* threadState) noexcept {
     setThreadName("JobSystem::loop");
     setThreadPriority(Priority::DISPLAY);
 
+    // the workers are told apart by their index in the recorded traces
+    char name[32];
+    snprintf(name, sizeof(name), "JobSystem::loop %u",
+            unsigned(threadState - mThreadStates.data()));
+    SYSTRACE_THREAD_NAME(name);
+
     // record our work queue to thread-local storage
     sThreadState = threadState;
 
+    uint32_t reservedCoreMask = 0;
+
     // run our main loop...
     do {
+        const uint32_t newReservedCoreMask = getReservedCoreMask();
+        if (UTILS_UNLIKELY(newReservedCoreMask != reservedCoreMask)) {
+            reservedCoreMask = newReservedCoreMask;
+            setThreadAffinity(~reservedCoreMask);
+        }
         if (!execute(*threadState)) {
-            std::unique_lock<Mutex> lock(mLock);
-            while (!exitRequested() && !(mActiveJobs.load(std::memory_order_relaxed))) {
-                mCondition.wait(lock);
+            // the clock is only read when there is nothing to do
+            const auto start = std::chrono::steady_clock::now();
+            if (!spin(*threadState)) {
+                std::unique_lock<Mutex> lock(mLock);
+                // mSleepingThreads must be incremented before mActiveJobs is checked, and run()
+                // does the opposite, so that either we see the new job or run() sees a sleeping
+                // thread.
+                mSleepingThreads.fetch_add(1, std::memory_order_seq_cst);
+                while (!exitRequested() && !(mActiveJobs.load(std::memory_order_seq_cst))) {
+                    mCondition.wait(lock);
+                }
+                mSleepingThreads.fetch_sub(1, std::memory_order_relaxed);
             }
+            const std::chrono::nanoseconds idle = std::chrono::steady_clock::now() - start;
+            mWorkerIdleTime.fetch_add(uint64_t(idle.count()), std::memory_order_relaxed);
         }
     } while (!exitRequested());
 }
 
+bool JobSystem::spin(JobSystem::ThreadState& state) noexcept {
+    using clock = std::chrono::steady_clock;
+    const uint32_t maxDuration = mIdleSpinDuration.load(std::memory_order_relaxed);
+    const uint32_t duration = std::min(state.spinDuration, maxDuration);
+    if (!duration) {
+        return false;
+    }
+
+    // the clock is only read every few iterations, it's more expensive than a pause
+    const clock::time_point deadline = clock::now() + std::chrono::microseconds(duration);
+    do {
+        for (size_t i = 0; i < 64; i++) {
+            if (mActiveJobs.load(std::memory_order_relaxed) || exitRequested()) {
+                state.spinDuration = maxDuration;
+                return true;
+            }
+            UTILS_PAUSE();
+        }
+    } while (clock::now() < deadline);
+
+    // we didn't find any work, poll for less time next time
+    state.spinDuration = std::max(duration / 2, maxDuration / 8);
+    return false;
+}
+
 // -----------------------------------------------------------------------------------------------
 // public API...
 
@@ -264,11 +389,12 @@ JobSystem::Job* JobSystem::create(JobSystem::Job* parent, JobFunc func) noexcept
             assert(parent->runningJobCount.load(std::memory_order_relaxed) > 0);
 
             parent->runningJobCount.fetch_add(1, std::memory_order_relaxed);
-            index = parent - mJobStorageBase;
+            index = parent->id;
             assert(index < MAX_JOB_COUNT);
         }
         job->function = func;
         job->parent = uint16_t(index);
+        job->links = NO_LINKS;
         job->runningJobCount.store(1, std::memory_order_relaxed);
     }
     return job;
@@ -278,8 +404,6 @@ void JobSystem::finish(Job* job) noexcept {
     SYSTRACE_CALL();
 
     // terminate this job and notify its parent
-    auto& jobPool = mJobPool;
-    Job* const storage = mJobStorageBase;
     do {
         // std::memory_order_release here is needed to synchronize with JobSystem::wait()
         // which needs to "see" all changes that happened before the job terminated.
@@ -289,9 +413,13 @@ void JobSystem::finish(Job* job) noexcept {
             // there is still work (e.g.: children), we're done.
             break;
         }
-        Job* const parent = job->parent == 0x7FFF ? nullptr : &storage[job->parent];
+        Job* const parent = job->parent == 0x7FFF ? nullptr : getJob(job->parent);
+        // run the jobs waiting on this one...
+        if (job->links != NO_LINKS) {
+            runSuccessors(job);
+        }
         // destroy this job...
-        jobPool.destroy(job);
+        mJobFreeList.put(job);
         // ... and check the parent
         job = parent;
     } while (job);
@@ -304,6 +432,15 @@ void JobSystem::finish(Job* job) noexcept {
 }
 
 void JobSystem::run(JobSystem::Job* job, uint32_t flags) noexcept {
+    // a job with predecessors is scheduled by whichever of run() and its last predecessor
+    // comes last.
+    if (job->links != NO_LINKS && !releaseDependency(job)) {
+        return;
+    }
+    schedule(job, flags);
+}
+
+void JobSystem::schedule(JobSystem::Job* job, uint32_t flags) noexcept {
 #if HEAVY_SYSTRACE
     SYSTRACE_CALL();
 #endif
@@ -313,7 +450,7 @@ void JobSystem::run(JobSystem::Job* job, uint32_t flags) noexcept {
     // increase the active job count before we add the job to the queue, because otherwise
     // the job could run and finish before the counter is incremented, which would trigger
     // an assert() in execute(). Either way, it's not "wrong", but the assert() is useful.
-    uint32_t activeJobs = mActiveJobs.fetch_add(1, std::memory_order_relaxed);
+    uint32_t activeJobs = mActiveJobs.fetch_add(1, std::memory_order_seq_cst);
 
     put(state.workQueue, job);
 
@@ -322,8 +459,9 @@ void JobSystem::run(JobSystem::Job* job, uint32_t flags) noexcept {
 
     // wake-up a thread if needed...
     if (!(flags & DONT_SIGNAL)) {
-        // if it was busy before, try to wake-up another sleeping thread
-        if (activeJobs) {
+        // if it was busy before, try to wake-up another sleeping thread. Threads that are still
+        // polling for work don't need to be woken up.
+        if (activeJobs && mSleepingThreads.load(std::memory_order_seq_cst)) {
             // wake-up a queue
             { std::lock_guard<Mutex> lock(mLock); }
             mCondition.notify_one();
@@ -331,6 +469,47 @@ void JobSystem::run(JobSystem::Job* job, uint32_t flags) noexcept {
     }
 }
 
+void JobSystem::addDependency(Job* predecessor, Job* successor) noexcept {
+    assert(predecessor && successor && predecessor != successor);
+    Links& links = getLinks(predecessor);
+    ASSERT_PRECONDITION(links.successorCount < MAX_SUCCESSOR_COUNT,
+            "A job can't have more than %u successors", unsigned(MAX_SUCCESSOR_COUNT));
+    links.successors[links.successorCount++] = successor->id;
+    getLinks(successor).pendingCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+JobSystem::Links& JobSystem::getLinks(Job* job) noexcept {
+    if (job->links == NO_LINKS) {
+        Job* const storage = allocateJob();
+        ASSERT_POSTCONDITION(storage, "No more jobs available to hold the job's dependencies");
+        static_assert(sizeof(Links) <= sizeof(Job::padding), "Links don't fit in a job");
+        Links* const links = new(storage->padding) Links();
+        links->pendingCount.store(1, std::memory_order_relaxed);
+        links->successorCount = 0;
+        job->links = storage->id;
+    }
+    return *static_cast<Links*>(getJob(job->links)->getData());
+}
+
+bool JobSystem::releaseDependency(Job* job) noexcept {
+    // std::memory_order_acq_rel here makes the work of all the predecessors visible to the job
+    Links& links = *static_cast<Links*>(getJob(job->links)->getData());
+    return links.pendingCount.fetch_sub(1, std::memory_order_acq_rel) == 1;
+}
+
+void JobSystem::runSuccessors(Job* job) noexcept {
+    Job* const storage = getJob(job->links);
+    Links& links = *static_cast<Links*>(storage->getData());
+    for (size_t i = 0, c = links.successorCount; i < c; i++) {
+        Job* const successor = getJob(links.successors[i]);
+        if (releaseDependency(successor)) {
+            schedule(successor, 0);
+        }
+    }
+    links.~Links();
+    mJobFreeList.put(storage);
+}
+
 void JobSystem::wait(JobSystem::Job const* job) noexcept {
     SYSTRACE_CALL();
 
@@ -385,6 +564,8 @@ io::ostream& operator<<(io::ostream& out, JobSystem const& js) {
     for (auto const& item : js.mThreadStates) {
         out << size_t(std::log2f(item.mask)) << ": " << item.workQueue.getCount() << io::endl;
     }
+    out << "job capacity: " << js.getJobCapacity()
+        << ", exhausted: " << js.getJobPoolExhaustedCount() << io::endl;
     return out;
 }
 
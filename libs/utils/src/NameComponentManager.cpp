@@ -17,23 +17,68 @@
 #include <utils/NameComponentManager.h>
 #include <utils/EntityManager.h>
 
+#include <string.h>
+
 namespace utils {
 
 static constexpr size_t NAME = 0;
 
-NameComponentManager::NameComponentManager(EntityManager& em) {
+NameComponentManager::NameComponentManager(EntityManager& em)
+        : mArea(NAMES_AREA_SIZE), mAllocator(mArea) {
 }
 
 NameComponentManager::~NameComponentManager() = default;
 
+char const* NameComponentManager::intern(const char* name) noexcept {
+    auto pos = mNames.find(name);
+    if (pos != mNames.end()) {
+        return *pos;
+    }
+    const size_t size = strlen(name) + 1;
+    char* const copy = (char*)mAllocator.alloc(size, 1);
+    memcpy(copy, name, size);
+    mNames.insert(copy);
+    return copy;
+}
+
+void NameComponentManager::removeFromIndex(char const* name, Entity e) noexcept {
+    auto range = mEntities.equal_range(name);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == e) {
+            mEntities.erase(it);
+            return;
+        }
+    }
+}
+
 void NameComponentManager::setName(Instance instance, const char* name) noexcept {
     if (instance) {
-        elementAt<NAME>(instance) = details::SafeString{ name };
+        char const*& current = elementAt<NAME>(instance);
+        const Entity e = getEntity(instance);
+        if (current) {
+            removeFromIndex(current, e);
+        }
+        current = name ? intern(name) : nullptr;
+        if (current) {
+            mEntities.emplace(current, e);
+        }
     }
 }
 
 const char* NameComponentManager::getName(Instance instance) const noexcept {
-    return elementAt<NAME>(instance).c_str();
+    return elementAt<NAME>(instance);
+}
+
+Entity NameComponentManager::getEntityByName(const char* name) const noexcept {
+    // the index is keyed by the interned copies of the names
+    auto interned = mNames.find(name);
+    if (interned != mNames.end()) {
+        auto pos = mEntities.find(*interned);
+        if (pos != mEntities.end()) {
+            return pos->second;
+        }
+    }
+    return {};
 }
 
 size_t NameComponentManager::getComponentCount() const noexcept {
@@ -49,11 +94,21 @@ void NameComponentManager::addComponent(Entity e) {
 }
 
 void NameComponentManager::removeComponent(Entity e) {
-    SingleInstanceComponentManager::removeComponent(e);
+    Instance instance = getInstance(e);
+    if (instance) {
+        char const* name = elementAt<NAME>(instance);
+        if (name) {
+            removeFromIndex(name, e);
+        }
+        SingleInstanceComponentManager::removeComponent(e);
+    }
 }
 
 void NameComponentManager::gc(const EntityManager& em, size_t ratio) noexcept {
-    SingleInstanceComponentManager::gc(em, ratio);
+    // the components are removed by our removeComponent(), which keeps the index up to date
+    SingleInstanceComponentManager::gc(em, ratio, [this](Entity e) {
+        removeComponent(e);
+    });
 }
 
 } // namespace utils
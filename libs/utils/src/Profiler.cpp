@@ -154,6 +154,16 @@ uint32_t Profiler::resetEvents(uint32_t eventMask) noexcept {
             }
         }
     
+        if (eventMask & EV_STALLED_CYCLES) {
+            pe.type = PERF_TYPE_HARDWARE;
+            pe.config = PERF_COUNT_HW_STALLED_CYCLES_BACKEND;
+            mCountersFd[STALLED_CYCLES] = perf_event_open(&pe, 0, -1, groupFd, 0);
+            if (mCountersFd[STALLED_CYCLES] > 0) {
+                mIds[STALLED_CYCLES] = count++;
+                mEnabledEvents |= EV_STALLED_CYCLES;
+            }
+        }
+
 #ifdef __ARM_ARCH
         if (eventMask & EV_L1I_REFS) {
             pe.type = PERF_TYPE_RAW;
@@ -137,4 +137,207 @@ void Systrace::init(uint32_t tag) noexcept {
 } // namespace details
 } // namespace utils
 
+#else // !ANDROID
+
+#include <utils/ThreadLocal.h>
+
+#include <chrono>
+#include <mutex>
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(WIN32)
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+namespace utils {
+namespace details {
+
+namespace {
+
+// names are copied, they're not always literals
+struct TraceEvent {
+    uint64_t time;      // in nanoseconds
+    int64_t value;      // counter value or async cookie
+    char type;          // Chrome trace event phase
+    char name[47];
+};
+
+static_assert(sizeof(TraceEvent) == 64, "TraceEvent should be 64 bytes");
+
+// The events of a thread. Only that thread writes to it, and it's never freed, so that the events
+// of threads that have exited can be written.
+struct ThreadTraceBuffer {
+    // 256 KiB, allocated with the thread's first event
+    static constexpr size_t CAPACITY = 4096;
+    std::atomic<uint64_t> count = { 0 };    // only the last CAPACITY events are kept
+    TraceEvent* events = nullptr;
+    ThreadTraceBuffer* next = nullptr;
+    uint32_t tid = 0;
+    char threadName[32] = {};
+};
+
+std::atomic<ThreadTraceBuffer*> sBuffers = { nullptr };
+std::atomic<uint32_t> sThreadCount = { 0 };
+UTILS_DEFINE_TLS(ThreadTraceBuffer*) sThreadBuffer(nullptr);
+
+// protects the state below, which is only changed by the enable/disable/recording calls
+std::mutex sLock;
+uint32_t sEnabledTags = 0;
+bool sIsRecording = false;
+uint64_t sRecordingStart = 0;
+
+uint64_t now() noexcept {
+    using namespace std::chrono;
+    return uint64_t(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+}
+
+ThreadTraceBuffer* getThreadBuffer() noexcept {
+    ThreadTraceBuffer* buffer = sThreadBuffer;
+    if (UTILS_UNLIKELY(!buffer)) {
+        buffer = new ThreadTraceBuffer;
+        buffer->tid = sThreadCount.fetch_add(1, std::memory_order_relaxed) + 1;
+        buffer->next = sBuffers.load(std::memory_order_relaxed);
+        while (!sBuffers.compare_exchange_weak(buffer->next, buffer,
+                std::memory_order_release, std::memory_order_relaxed)) {
+        }
+        sThreadBuffer = buffer;
+    }
+    return buffer;
+}
+
+void writeString(FILE* file, const char* s) noexcept {
+    fputc('"', file);
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            fputc('\\', file);
+        }
+        if (uint8_t(*s) >= 0x20) {
+            fputc(*s, file);
+        }
+    }
+    fputc('"', file);
+}
+
+} // anonymous namespace
+
+std::atomic<uint32_t> Systrace::sIsTracingEnabled = { 0 };
+
+// must be called with sLock held
+static uint32_t getTracingEnabledTags() noexcept {
+    return sIsRecording ? (sEnabledTags | SYSTRACE_TAG_ALWAYS) : 0;
+}
+
+void Systrace::enable(uint32_t tags) noexcept {
+    std::lock_guard<std::mutex> guard(sLock);
+    sEnabledTags |= tags;
+    sIsTracingEnabled.store(getTracingEnabledTags(), std::memory_order_relaxed);
+}
+
+void Systrace::disable(uint32_t tags) noexcept {
+    std::lock_guard<std::mutex> guard(sLock);
+    sEnabledTags &= ~tags;
+    sIsTracingEnabled.store(getTracingEnabledTags(), std::memory_order_relaxed);
+}
+
+void Systrace::startRecording() noexcept {
+    std::lock_guard<std::mutex> guard(sLock);
+    if (!sIsRecording) {
+        // the events of previous recordings are ignored
+        sIsRecording = true;
+        sRecordingStart = now();
+        sIsTracingEnabled.store(getTracingEnabledTags(), std::memory_order_relaxed);
+    }
+}
+
+void Systrace::stopRecording() noexcept {
+    std::lock_guard<std::mutex> guard(sLock);
+    sIsRecording = false;
+    sIsTracingEnabled.store(getTracingEnabledTags(), std::memory_order_relaxed);
+}
+
+void Systrace::setThreadName(const char* name) noexcept {
+    ThreadTraceBuffer* const buffer = getThreadBuffer();
+    strncpy(buffer->threadName, name, sizeof(buffer->threadName) - 1);
+}
+
+void Systrace::record(char type, const char* name, int64_t value) noexcept {
+    ThreadTraceBuffer* const buffer = getThreadBuffer();
+    if (UTILS_UNLIKELY(!buffer->events)) {
+        buffer->events = new TraceEvent[ThreadTraceBuffer::CAPACITY];
+    }
+    // the event is published by the update of count
+    const uint64_t count = buffer->count.load(std::memory_order_relaxed);
+    TraceEvent& event = buffer->events[count % ThreadTraceBuffer::CAPACITY];
+    event.time = now();
+    event.value = value;
+    event.type = type;
+    if (name) {
+        strncpy(event.name, name, sizeof(event.name) - 1);
+        event.name[sizeof(event.name) - 1] = 0;
+    } else {
+        event.name[0] = 0;
+    }
+    buffer->count.store(count + 1, std::memory_order_release);
+}
+
+bool Systrace::dump(const char* path) noexcept {
+    uint64_t start;
+    {
+        std::lock_guard<std::mutex> guard(sLock);
+        start = sRecordingStart;
+    }
+
+    FILE* const file = fopen(path, "w");
+    if (!file) {
+        return false;
+    }
+
+    const int pid = getpid();
+    const char* separator = "";
+    fprintf(file, "{\"traceEvents\":[");
+    for (ThreadTraceBuffer* buffer = sBuffers.load(std::memory_order_acquire);
+            buffer; buffer = buffer->next) {
+        if (buffer->threadName[0]) {
+            fprintf(file, "%s\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":%d,\"tid\":%u,"
+                    "\"args\":{\"name\":", separator, pid, buffer->tid);
+            writeString(file, buffer->threadName);
+            fprintf(file, "}}");
+            separator = ",";
+        }
+
+        const uint64_t count = buffer->count.load(std::memory_order_acquire);
+        const uint64_t first = count > ThreadTraceBuffer::CAPACITY ?
+                count - ThreadTraceBuffer::CAPACITY : 0;
+        for (uint64_t i = first; i < count; i++) {
+            TraceEvent const& event = buffer->events[i % ThreadTraceBuffer::CAPACITY];
+            if (event.time < start) {
+                continue;
+            }
+            fprintf(file, "%s\n{\"ph\":\"%c\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f",
+                    separator, event.type, pid, buffer->tid, double(event.time) / 1000.0);
+            if (event.type != 'E') {
+                fprintf(file, ",\"name\":");
+                writeString(file, event.name);
+            }
+            if (event.type == 'C') {
+                fprintf(file, ",\"args\":{\"value\":%lld}", (long long)event.value);
+            } else if (event.type == 'b' || event.type == 'e') {
+                fprintf(file, ",\"cat\":\"async\",\"id\":%lld", (long long)event.value);
+            }
+            fprintf(file, "}");
+            separator = ",";
+        }
+    }
+    fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    return fclose(file) == 0;
+}
+
+} // namespace details
+} // namespace utils
+
 #endif // ANDROID
@@ -26,6 +26,10 @@
 #   include <unistd.h>
 #endif
 
+#if defined(__linux__) && !defined(ANDROID)
+#   include <sys/syscall.h>
+#endif
+
 #if defined(WIN32)
 #include <io.h>
 #include <Windows.h>
@@ -107,7 +111,20 @@ error:
 
 #elif defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
 
-int ashmem_create_region(const char*, size_t size) {
+int ashmem_create_region(const char* name, size_t size) {
+#if defined(__linux__) && defined(SYS_memfd_create)
+    // memfd doesn't need a file system, but it's only available since Linux 3.17
+    constexpr unsigned int MFD_CLOEXEC_FLAG = 0x0001U;
+    int memfd = int(syscall(SYS_memfd_create, name ? name : "filament", MFD_CLOEXEC_FLAG));
+    if (memfd >= 0) {
+        if (ftruncate(memfd, (off_t)size) == -1) {
+            close(memfd);
+            return -1;
+        }
+        return memfd;
+    }
+#endif
+
     char template_path[512];
     snprintf(template_path, sizeof(template_path), "/tmp/filament-ashmem-%d-XXXXXXXXX", getpid());
     int fd = mkstemp(template_path);
@@ -19,6 +19,8 @@
 #include <functional>
 #include <bitset>
 
+#include <string.h>
+
 #include <gtest/gtest.h>
 
 #include <utils/Allocator.h>
@@ -85,6 +87,50 @@ TEST(AllocatorTest, LinearAllocator) {
 }
 
 
+TEST(AllocatorTest, LinearAllocatorWithFallback) {
+    char scratch[1024];
+    void* p = nullptr;
+
+    LinearAllocatorWithFallback la(scratch, scratch+sizeof(scratch));
+    p = la.alloc(1000, 1, 0);
+    EXPECT_EQ(scratch, p);
+    EXPECT_EQ(0, la.getHeapAllocated());
+
+    // check that we get heap memory when the area is exhausted
+    void* const mark = la.getCurrent();
+    p = la.alloc(512, 1, 0);
+    EXPECT_NE(nullptr, p);
+    EXPECT_TRUE(p < scratch || p >= scratch + sizeof(scratch));
+    EXPECT_NE(0, la.getHeapAllocated());
+    memset(p, 0, 512);
+
+    // check that large allocations chain another block
+    void* const mark2 = la.getCurrent();
+    p = la.alloc(4096, 32, 0);
+    EXPECT_NE(nullptr, p);
+    EXPECT_EQ(0, uintptr_t(p) & 31);
+    memset(p, 0, 4096);
+
+    // check that rewinding into a heap block keeps it
+    la.rewind(mark2);
+    EXPECT_EQ(mark2, la.getCurrent());
+    EXPECT_NE(0, la.getHeapAllocated());
+
+    // check that rewinding into the area frees the heap blocks
+    la.rewind(mark);
+    EXPECT_EQ(mark, la.getCurrent());
+    EXPECT_EQ(0, la.getHeapAllocated());
+    p = la.alloc(24, 1, 0);
+    EXPECT_EQ(scratch + 1000, p);
+
+    // check reset
+    la.alloc(2048, 1, 0);
+    la.reset();
+    EXPECT_EQ(0, la.getHeapAllocated());
+    p = la.alloc(1024, 1, 0);
+    EXPECT_EQ(scratch, p);
+}
+
 TEST(AllocatorTest, PoolAllocator) {
     char scratch[1024 + 31];
     void* p = nullptr;
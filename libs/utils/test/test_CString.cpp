@@ -24,3 +24,14 @@ TEST(CString, EmptyString) {
     CString emptyString("");
     EXPECT_STREQ("", emptyString.c_str_safe());
 }
+
+TEST(CString, Allocated) {
+    CString empty(CString::size_type(0));
+    EXPECT_TRUE(empty.empty());
+    EXPECT_STREQ("", empty.c_str_safe());
+
+    CString string(CString::size_type(5));
+    EXPECT_EQ(5, string.size());
+    memcpy(string.data(), "hello", 5);
+    EXPECT_STREQ("hello", string.c_str());
+}
@@ -17,6 +17,9 @@
 #include <gtest/gtest.h>
 
 #include <memory>
+#include <set>
+#include <thread>
+#include <vector>
 
 #include "../src/EntityManagerImpl.h"
 #include <utils/NameComponentManager.h>
@@ -171,8 +174,54 @@ TEST(EntityTest, NameComponent) {
     EXPECT_EQ(0, i0.asValue());
 
     EXPECT_STREQ("i1", cm.getName(i1));
+    EXPECT_TRUE(cm.getEntityByName("i0").isNull());
+    EXPECT_EQ(entities[1], cm.getEntityByName("i1"));
+
+    // the names are interned
+    cm.addComponent(entities[3]);
+    auto i3 = cm.getInstance(entities[3]);
+    cm.setName(i3, "i1");
+    EXPECT_EQ(cm.getName(i1), cm.getName(i3));
+
+    cm.setName(i1, "renamed");
+    EXPECT_EQ(entities[3], cm.getEntityByName("i1"));
+    EXPECT_EQ(entities[1], cm.getEntityByName("renamed"));
 
     em.destroy(8, entities);
 
     cm.gc(em);
 }
+
+TEST(EntityTest, Threads) {
+    EntityManagerImpl em;
+    constexpr size_t THREAD_COUNT = 8;
+    constexpr size_t ENTITY_COUNT = 1000;
+    std::vector<Entity> created[THREAD_COUNT];
+
+    // each thread keeps half of its entities alive, so their indices can't be reused
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < THREAD_COUNT; t++) {
+        threads.emplace_back([&em, &entities = created[t]]() {
+            for (size_t i = 0; i < ENTITY_COUNT; i++) {
+                Entity e = em.create();
+                if (i & 1) {
+                    em.destroy(e);
+                } else {
+                    entities.push_back(e);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    std::set<uint32_t> indices;
+    for (auto const& entities : created) {
+        for (Entity e : entities) {
+            EXPECT_TRUE(em.isAlive(e));
+            EXPECT_TRUE(indices.insert(EntityManagerImpl::getIndex(e)).second);
+        }
+    }
+    EXPECT_EQ(THREAD_COUNT * ENTITY_COUNT / 2, indices.size());
+}
@@ -341,5 +341,82 @@ TEST(JobSystem, JobSystemDelegates) {
     EXPECT_EQ(4, functor.result);
 
 
+    js.emancipate();
+}
+
+TEST(JobSystem, JobSystemGrowJobPool) {
+    JobSystem js;
+    js.adopt();
+
+    const size_t capacity = js.getJobCapacity();
+
+    // create more jobs than the initial capacity before running any of them
+    std::atomic_int calls = { 0 };
+    JobSystem::Job* root = js.createJob();
+    std::vector<JobSystem::Job*> jobs;
+    for (size_t i = 0; i < capacity + 256; i++) {
+        JobSystem::Job* job = js.createJob(root, [&calls](JobSystem&, JobSystem::Job*) {
+            calls++;
+        });
+        ASSERT_NE(nullptr, job);
+        jobs.push_back(job);
+    }
+    EXPECT_LT(capacity, js.getJobCapacity());
+    EXPECT_EQ(0, js.getJobPoolExhaustedCount());
+
+    for (JobSystem::Job* job : jobs) {
+        js.run(job);
+    }
+    js.runAndWait(root);
+    EXPECT_EQ(int(jobs.size()), calls.load());
+
+    js.emancipate();
+}
+
+TEST(JobSystem, JobSystemDependencies) {
+    JobSystem js;
+    js.adopt();
+
+    // a -> (b, c) -> d, where b has children
+    std::atomic_int order = { 0 };
+    int a = -1, b = -1, c = -1, d = -1;
+    std::atomic_int children = { 0 };
+
+    JobSystem::Job* root = js.createJob();
+    JobSystem::Job* ja = js.createJob(root, [&](JobSystem&, JobSystem::Job*) {
+        a = order++;
+    });
+    JobSystem::Job* jb = js.createJob(root, [&](JobSystem& js, JobSystem::Job* job) {
+        b = order++;
+        for (int i = 0; i < 64; i++) {
+            js.run(js.createJob(job, [&children](JobSystem&, JobSystem::Job*) {
+                children++;
+            }));
+        }
+    });
+    JobSystem::Job* jc = js.createJob(root, [&](JobSystem&, JobSystem::Job*) {
+        c = order++;
+    });
+    JobSystem::Job* jd = js.createJob(root, [&](JobSystem&, JobSystem::Job*) {
+        EXPECT_EQ(64, children.load());
+        d = order++;
+    });
+    js.addDependency(ja, jb);
+    js.addDependency(ja, jc);
+    js.addDependency(jb, jd);
+    js.addDependency(jc, jd);
+
+    // successors are run first, they must wait for their predecessors
+    js.run(jd);
+    js.run(jc);
+    js.run(jb);
+    js.run(ja);
+    js.runAndWait(root);
+
+    EXPECT_EQ(0, a);
+    EXPECT_LT(a, b);
+    EXPECT_LT(a, c);
+    EXPECT_EQ(3, d);
+
     js.emancipate();
 }
@@ -16,6 +16,8 @@
 
 #include <gtest/gtest.h>
 
+#include <utils/ChunkedStructureOfArrays.h>
+#include <utils/SingleInstanceComponentManager.h>
 #include <utils/StructureOfArrays.h>
 #include <math/vec4.h>
 
@@ -170,3 +172,73 @@ TEST(StructureOfArraysTest, Simple) {
     soa.push_back(0.0f, 1.0, std::move(destroyedFloat4));
 }
 
+
+TEST(StructureOfArraysTest, Chunked) {
+    // 4 elements per chunk
+    ChunkedStructureOfArraysBase<2, HeapArena<>, float, double, TestFloat4> soa;
+
+    soa.resize(10);
+    EXPECT_EQ(10, soa.size());
+    EXPECT_EQ(12, soa.capacity());
+
+    for (size_t i = 0; i < 10; i++) {
+        soa.elementAt<0>(i) = i;
+        soa.elementAt<1>(i) = i * 2;
+        soa.elementAt<2>(i) = i * 4;
+    }
+
+    // check that each array is aligned properly
+    EXPECT_EQ(0, uintptr_t(&soa.elementAt<1>(4)) % alignof(double));
+    EXPECT_EQ(0, uintptr_t(&soa.elementAt<2>(4)) % alignof(float4));
+
+    // growing doesn't move the existing elements
+    TestFloat4 const* first = &soa.elementAt<2>(0);
+    TestFloat4 const* last = &soa.elementAt<2>(9);
+    soa.resize(100);
+    EXPECT_EQ(first, &soa.elementAt<2>(0));
+    EXPECT_EQ(last, &soa.elementAt<2>(9));
+
+    // check the constructor was called
+    EXPECT_TRUE(soa.elementAt<2>(99) == TestFloat4());
+
+    // check we can remove elements, across chunks
+    soa.resize(6);
+    EXPECT_EQ(6, soa.size());
+    soa.pop_back();
+    EXPECT_EQ(5, soa.size());
+
+    // check the content hasn't changed
+    soa.swap(0, 4);
+    for (size_t i = 0; i < 5; i++) {
+        size_t j = i == 0 ? 4 : i == 4 ? 0 : i;
+        EXPECT_EQ(j    , soa.elementAt<0>(i));
+        EXPECT_EQ(j * 2, soa.elementAt<1>(i));
+        EXPECT_EQ(j * 4, soa.elementAt<2>(i));
+    }
+}
+
+TEST(StructureOfArraysTest, ChunkedComponentManager) {
+    EntityManager& em = EntityManager::get();
+    ChunkedSingleInstanceComponentManager<float, TestFloat4> cm;
+
+    Entity entities[1000];
+    em.create(1000, entities);
+    for (size_t i = 0; i < 1000; i++) {
+        auto ci = cm.addComponent(entities[i]);
+        cm.elementAt<0>(ci) = i;
+    }
+    EXPECT_EQ(1000, cm.getComponentCount());
+
+    // removing a component moves the last one in its place
+    cm.removeComponent(entities[10]);
+    EXPECT_EQ(999, cm.getComponentCount());
+    EXPECT_FALSE(cm.hasComponent(entities[10]));
+    auto ci = cm.getInstance(entities[999]);
+    EXPECT_EQ(999.0f, cm.elementAt<0>(ci));
+    EXPECT_EQ(entities[999], cm.getEntity(ci));
+
+    em.destroy(1000, entities);
+    while (!cm.empty()) {
+        cm.gc(em);
+    }
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <gtest/gtest.h>
+
+#define SYSTRACE_TAG SYSTRACE_TAG_JOBSYSTEM
+#include <utils/Systrace.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <stdio.h>
+
+#if !defined(ANDROID)
+
+static std::string readFile(const char* path) {
+    std::ifstream in(path);
+    std::stringstream content;
+    content << in.rdbuf();
+    return content.str();
+}
+
+static void traced(const char* name) {
+    SYSTRACE_NAME(name);
+    SYSTRACE_VALUE32("counter", 42);
+}
+
+TEST(SystraceTest, Recording) {
+    const char* path = "test_systrace.json";
+
+    SYSTRACE_ENABLE();
+
+    // nothing is recorded until recording starts
+    traced("before");
+
+    SYSTRACE_START_RECORDING();
+    traced("main");
+    std::thread worker([]() {
+        SYSTRACE_THREAD_NAME("worker");
+        traced("other \"thread\"");
+    });
+    worker.join();
+    SYSTRACE_STOP_RECORDING();
+
+    // nor after it stops
+    traced("after");
+
+    ASSERT_TRUE(SYSTRACE_DUMP(path));
+    std::string trace = readFile(path);
+    remove(path);
+
+    EXPECT_EQ(0, trace.find("{\"traceEvents\":["));
+    EXPECT_NE(std::string::npos, trace.find("\"name\":\"main\""));
+    EXPECT_NE(std::string::npos, trace.find("\"name\":\"other \\\"thread\\\"\""));
+    EXPECT_NE(std::string::npos, trace.find("\"args\":{\"name\":\"worker\"}"));
+    EXPECT_NE(std::string::npos, trace.find("\"args\":{\"value\":42}"));
+    EXPECT_NE(std::string::npos, trace.find("\"ph\":\"E\""));
+    EXPECT_EQ(std::string::npos, trace.find("before"));
+    EXPECT_EQ(std::string::npos, trace.find("after"));
+
+    SYSTRACE_DISABLE();
+}
+
+#endif
@@ -205,3 +205,62 @@ TEST(BitSetTest, NotOperator) {
     EXPECT_TRUE(b3[0]);
     EXPECT_TRUE(b3[2]);
 }
+
+// checks the operations against the words, for the sizes of the vectorized and scalar paths
+template<size_t N>
+static void testWideOperations() {
+    const uint64_t words[] = {
+            0, ~uint64_t(0), 0x8000000000000001, 0x0123456789ABCDEF, 0xF0F0F0F0F0F0F0F0 };
+    const size_t count = sizeof(words) / sizeof(words[0]);
+    for (size_t k = 0; k < count * count; k++) {
+        bitset<uint64_t, N> a;
+        bitset<uint64_t, N> b;
+        for (size_t i = 0; i < N; i++) {
+            a.getBitsAt(i) = words[(k + i) % count];
+            b.getBitsAt(i) = words[(k / count + i * 3) % count];
+        }
+        size_t bits = 0;
+        bool any = false;
+        bool all = true;
+        bool equal = true;
+        for (size_t i = 0; i < N; i++) {
+            for (size_t bit = 0; bit < 64; bit++) {
+                bits += (a.getBitsAt(i) >> bit) & 1u;
+            }
+            any = any || a.getBitsAt(i);
+            all = all && a.getBitsAt(i) == ~uint64_t(0);
+            equal = equal && a.getBitsAt(i) == b.getBitsAt(i);
+        }
+        EXPECT_EQ(bits, a.count());
+        EXPECT_EQ(any, a.any());
+        EXPECT_EQ(all, a.all());
+        EXPECT_EQ(equal, a == b);
+        EXPECT_EQ(!equal, a != b);
+
+        bitset<uint64_t, N> andBits = a & b;
+        bitset<uint64_t, N> orBits = a | b;
+        bitset<uint64_t, N> xorBits = a ^ b;
+        bitset<uint64_t, N> notBits = ~a;
+        for (size_t i = 0; i < N; i++) {
+            EXPECT_EQ(a.getBitsAt(i) & b.getBitsAt(i), andBits.getBitsAt(i));
+            EXPECT_EQ(a.getBitsAt(i) | b.getBitsAt(i), orBits.getBitsAt(i));
+            EXPECT_EQ(a.getBitsAt(i) ^ b.getBitsAt(i), xorBits.getBitsAt(i));
+            EXPECT_EQ(~a.getBitsAt(i), notBits.getBitsAt(i));
+        }
+
+        size_t visited = 0;
+        a.forEachSetBit([&](size_t bit) {
+            EXPECT_TRUE(a[bit]);
+            visited++;
+        });
+        EXPECT_EQ(bits, visited);
+    }
+}
+
+TEST(BitSetTest, WideOperations) {
+    testWideOperations<1>();
+    testWideOperations<2>();
+    testWideOperations<3>();
+    testWideOperations<4>();
+    testWideOperations<8>();
+}
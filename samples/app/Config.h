@@ -27,6 +27,13 @@ struct Config {
     float scale = 1.0f;
     bool splitView = false;
     filament::Engine::Backend backend = filament::Engine::Backend::OPENGL;
+
+    // When not 0, the sample renders this many frames along a fixed camera path in a hidden
+    // window, then exits. The timings of the frames are written as CSV to replayOutput (stdout
+    // if empty), and compared with the CSV of a previous replay, replayBaseline, if set.
+    size_t replayFrames = 0;
+    std::string replayOutput;
+    std::string replayBaseline;
 };
 
 #endif // TNT_FILAMENT_SAMPLE_CONFIG_H
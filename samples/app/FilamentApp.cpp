@@ -42,6 +42,7 @@
 #include <filagui/ImGuiHelper.h>
 
 #include "Cube.h"
+#include "FrameReplay.h"
 #include "NativeWindowHelper.h"
 
 using namespace filament;
@@ -74,7 +75,7 @@ FilamentApp::~FilamentApp() {
     SDL_Quit();
 }
 
-void FilamentApp::run(const Config& config,SetupCallback setupCallback,
+int FilamentApp::run(const Config& config,SetupCallback setupCallback,
         CleanupCallback cleanupCallback, ImGuiCallback imguiCallback,
         PreRenderCallback preRender, PostRenderCallback postRender,
         size_t width, size_t height) {
@@ -204,11 +205,20 @@ void FilamentApp::run(const Config& config,SetupCallback setupCallback,
 
     bool mousePressed[3] = { false };
 
+    std::unique_ptr<FrameReplay> replay;
+    if (config.replayFrames) {
+        replay = std::make_unique<FrameReplay>(config);
+    }
+    size_t frame = 0;
+
     while (!mClosed) {
 
         // Allow the app to animate the scene if desired.
         if (mAnimation) {
             double now = (double) SDL_GetPerformanceCounter() / SDL_GetPerformanceFrequency();
+            if (replay) {
+                now = replay->getTime(frame);
+            }
             mAnimation(mEngine, window->mMainView->getView(), now);
         }
 
@@ -338,10 +348,16 @@ void FilamentApp::run(const Config& config,SetupCallback setupCallback,
             mImGuiHelper->render(timeStep, imguiCallback);
         }
 
+        if (replay) {
+            double3 at(0, 0, -4);
+            window->mMainCameraMan.lookAt(replay->getEye(frame, at, 4.0), at);
+        }
         window->mMainCameraMan.updateCameraTransform();
 
         // TODO: we need better timing or use SDL_GL_SetSwapInterval
-        SDL_Delay(16);
+        if (!replay) {
+            SDL_Delay(16);
+        }
 
         Renderer* renderer = window->getRenderer();
 
@@ -367,8 +383,18 @@ void FilamentApp::run(const Config& config,SetupCallback setupCallback,
                 }
             }
         }
+
+        frame++;
+        if (replay) {
+            replay->record(renderer);
+            // gives up if the frames aren't reported, e.g. when they're all skipped
+            mClosed = mClosed || replay->isDone() ||
+                    frame >= 2 * (FrameReplay::WARMUP_FRAMES + config.replayFrames);
+        }
     }
 
+    const bool passed = !replay || replay->finish();
+
     if (mImGuiHelper) {
         mImGuiHelper.reset();
     }
@@ -387,6 +413,7 @@ void FilamentApp::run(const Config& config,SetupCallback setupCallback,
     mEngine->destroy(mScene);
     Engine::destroy(&mEngine);
     mEngine = nullptr;
+    return passed ? 0 : 1;
 }
 
 void FilamentApp::loadIBL(const Config& config) {
@@ -423,8 +450,9 @@ FilamentApp::Window::Window(FilamentApp* filamentApp,
         : mFilamentApp(filamentApp) {
     const int x = SDL_WINDOWPOS_CENTERED;
     const int y = SDL_WINDOWPOS_CENTERED;
-    const uint32_t windowFlags = SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE
-            | SDL_WINDOW_ALLOW_HIGHDPI | SDL_WINDOW_OPENGL;
+    // replays render offscreen, in a window that's never shown
+    const uint32_t windowFlags = (config.replayFrames ? SDL_WINDOW_HIDDEN : SDL_WINDOW_SHOWN)
+            | SDL_WINDOW_RESIZABLE | SDL_WINDOW_ALLOW_HIGHDPI | SDL_WINDOW_OPENGL;
     mWindow = SDL_CreateWindow(title.c_str(), x, y, (int) w, (int) h, windowFlags);
 
     // HACK: We don't use SDL's 2D rendering functionality, but by invoking it we cause
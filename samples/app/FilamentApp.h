@@ -64,7 +64,8 @@ public:
 
     void animate(AnimCallback animation) { mAnimation = animation; }
 
-    void run(const Config& config, SetupCallback setup, CleanupCallback cleanup,
+    // returns 1 if a replay regressed compared to its baseline, 0 otherwise, see Config
+    int run(const Config& config, SetupCallback setup, CleanupCallback cleanup,
             ImGuiCallback imgui = ImGuiCallback(), PreRenderCallback preRender = PreRenderCallback(),
             PostRenderCallback postRender = PostRenderCallback(),
             size_t width = 1024, size_t height = 640);
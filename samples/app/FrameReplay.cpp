@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "FrameReplay.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <math.h>
+
+using namespace filament;
+using namespace math;
+
+static const char* const COLUMNS[] = {
+        "frameTime", "gpuTime", "shadowPassGpuTime", "colorPassGpuTime", "postProcessGpuTime",
+        "mainThreadTime", "mainThreadWaitTime", "driverThreadTime", "driverThreadWaitTime",
+        "workerBusyTime", "workerIdleTime", "drawCount", "triangleCount"
+};
+
+// the columns compared with the baseline
+static const size_t COMPARED_COLUMNS[] = { 0, 1, 5, 7 };
+
+FrameReplay::FrameReplay(Config const& config)
+        : mFrameCount(config.replayFrames),
+          mOutput(config.replayOutput),
+          mBaseline(config.replayBaseline) {
+    static_assert(sizeof(COLUMNS) / sizeof(COLUMNS[0]) == COLUMN_COUNT, "missing column names");
+    mFrames.reserve(mFrameCount);
+}
+
+double3 FrameReplay::getEye(size_t frame, double3 const& at, double distance) const noexcept {
+    const double a = 2.0 * M_PI * double(frame) / double(WARMUP_FRAMES + mFrameCount);
+    return at + double3{ distance * std::sin(a), 0.25 * distance, distance * std::cos(a) };
+}
+
+void FrameReplay::record(Renderer const* renderer) {
+    Renderer::FrameInfo history[Renderer::FRAME_INFO_HISTORY_SIZE];
+    const size_t count = renderer->getFrameInfoHistory(history, Renderer::FRAME_INFO_HISTORY_SIZE);
+    for (size_t i = 0; i < count && !isDone(); i++) {
+        Renderer::FrameInfo const& info = history[i];
+        if (mHasFrameId && info.frameId <= mLastFrameId) {
+            continue;
+        }
+        mHasFrameId = true;
+        mLastFrameId = info.frameId;
+        if (mSkipped < WARMUP_FRAMES) {
+            mSkipped++;
+            continue;
+        }
+        mFrames.push_back(toRow(info));
+    }
+}
+
+FrameReplay::Row FrameReplay::toRow(Renderer::FrameInfo const& info) {
+    return {
+            info.frameTime, info.gpuTime, info.shadowPassGpuTime, info.colorPassGpuTime,
+            info.postProcessGpuTime, info.mainThreadTime, info.mainThreadWaitTime,
+            info.driverThreadTime, info.driverThreadWaitTime, info.workerBusyTime,
+            info.workerIdleTime, double(info.drawCount), double(info.triangleCount)
+    };
+}
+
+std::vector<FrameReplay::Row> FrameReplay::read(std::string const& path) {
+    std::vector<Row> rows;
+    std::ifstream in(path);
+    std::string line;
+    // the first line holds the column names, the first column the frame number
+    for (std::getline(in, line); std::getline(in, line); ) {
+        std::istringstream fields(line);
+        std::string field;
+        Row row;
+        for (std::getline(fields, field, ','); std::getline(fields, field, ','); ) {
+            row.push_back(std::strtod(field.c_str(), nullptr));
+        }
+        if (row.size() == COLUMN_COUNT) {
+            rows.push_back(std::move(row));
+        }
+    }
+    return rows;
+}
+
+double FrameReplay::median(std::vector<Row> const& rows, size_t column) {
+    // negative values are unknown, e.g. the GPU times on a backend that can't measure them
+    std::vector<double> values;
+    for (Row const& row : rows) {
+        if (row[column] >= 0) {
+            values.push_back(row[column]);
+        }
+    }
+    if (values.empty()) {
+        return -1;
+    }
+    auto middle = values.begin() + values.size() / 2;
+    std::nth_element(values.begin(), middle, values.end());
+    return *middle;
+}
+
+bool FrameReplay::finish() const {
+    std::ofstream file;
+    if (!mOutput.empty()) {
+        file.open(mOutput);
+        if (!file) {
+            std::cerr << "Could not write the replay to " << mOutput << std::endl;
+        }
+    }
+    std::ostream& out = file.is_open() ? file : std::cout;
+    out << "frame";
+    for (const char* column : COLUMNS) {
+        out << "," << column;
+    }
+    out << std::endl;
+    for (size_t i = 0, c = mFrames.size(); i < c; i++) {
+        out << i;
+        for (double value : mFrames[i]) {
+            out << "," << value;
+        }
+        out << std::endl;
+    }
+
+    if (mBaseline.empty()) {
+        return true;
+    }
+    const std::vector<Row> baseline = read(mBaseline);
+    if (baseline.empty()) {
+        std::cerr << "Could not read the replay baseline " << mBaseline << std::endl;
+        return true;
+    }
+
+    bool passed = true;
+    std::cerr << "median (ms): baseline -> replay" << std::endl;
+    for (size_t column : COMPARED_COLUMNS) {
+        const double before = median(baseline, column);
+        const double after = median(mFrames, column);
+        if (before <= 0 || after < 0) {
+            continue;
+        }
+        const double change = (after - before) / before;
+        const bool regressed = change > REGRESSION_THRESHOLD;
+        passed = passed && !regressed;
+        std::cerr << "    " << COLUMNS[column] << ": " << before << " -> " << after
+                << " (" << (change >= 0 ? "+" : "") << change * 100.0 << "%)"
+                << (regressed ? " REGRESSION" : "") << std::endl;
+    }
+    return passed;
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_SAMPLE_FRAME_REPLAY_H
+#define TNT_FILAMENT_SAMPLE_FRAME_REPLAY_H
+
+#include <string>
+#include <vector>
+
+#include <math/vec3.h>
+
+#include <filament/Renderer.h>
+
+#include "Config.h"
+
+/*
+ * Records the timings of the frames of a replay, see Config::replayFrames.
+ *
+ * The frames follow a fixed camera path and animation clock, so that two replays of the same
+ * sample render the same frames. Their FrameInfo are written as CSV, one line per frame, and
+ * compared against the CSV of a previous replay, if any.
+ */
+class FrameReplay {
+public:
+    // frames rendered before the recording starts, while the programs are built
+    static constexpr size_t WARMUP_FRAMES = 16;
+
+    // relative change of a median beyond which it's reported as a regression
+    static constexpr double REGRESSION_THRESHOLD = 0.05;
+
+    explicit FrameReplay(Config const& config);
+
+    // the camera orbits around the target, once over the replay, at the given distance
+    math::double3 getEye(size_t frame, math::double3 const& at, double distance) const noexcept;
+
+    // the animation clock, in seconds, 60 frames per second
+    double getTime(size_t frame) const noexcept { return double(frame) / 60.0; }
+
+    // collects the frames the GPU finished since the last call
+    void record(filament::Renderer const* renderer);
+
+    bool isDone() const noexcept { return mFrames.size() >= mFrameCount; }
+
+    // writes the CSV, and compares it with the baseline, returns false on a regression
+    bool finish() const;
+
+private:
+    static constexpr size_t COLUMN_COUNT = 13;
+    using Row = std::vector<double>;
+
+    static Row toRow(filament::Renderer::FrameInfo const& info);
+    static std::vector<Row> read(std::string const& path);
+    static double median(std::vector<Row> const& rows, size_t column);
+
+    size_t mFrameCount;
+    std::string mOutput;
+    std::string mBaseline;
+    std::vector<Row> mFrames;
+    size_t mSkipped = 0;
+    uint32_t mLastFrameId = 0;
+    bool mHasFrameId = false;
+};
+
+#endif // TNT_FILAMENT_SAMPLE_FRAME_REPLAY_H
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "KtxTexture.h"
+
+#include <filament/Engine.h>
+#include <filament/Texture.h>
+
+#include <imageio/KtxReader.h>
+
+#include <utils/Path.h>
+
+#include <iostream>
+#include <memory>
+
+using namespace filament;
+using namespace image;
+
+namespace {
+
+using CompressedType = driver::CompressedPixelDataType;
+
+struct KtxFormat {
+    uint32_t glInternalFormat;
+    Texture::InternalFormat internalFormat;
+    Texture::Format format;         // ignored when compressed
+    Texture::Type type;             // COMPRESSED for compressed formats
+    CompressedType compressedType;  // ignored when not compressed
+};
+
+const KtxFormat KTX_FORMATS[] = {
+    { 0x8229, Texture::InternalFormat::R8,      Texture::Format::R,    Texture::Type::UBYTE },
+    { 0x822B, Texture::InternalFormat::RG8,     Texture::Format::RG,   Texture::Type::UBYTE },
+    { 0x8051, Texture::InternalFormat::RGB8,    Texture::Format::RGB,  Texture::Type::UBYTE },
+    { 0x8C41, Texture::InternalFormat::SRGB8,   Texture::Format::RGB,  Texture::Type::UBYTE },
+    { 0x8058, Texture::InternalFormat::RGBA8,   Texture::Format::RGBA, Texture::Type::UBYTE },
+    { 0x8C43, Texture::InternalFormat::SRGB8_A8,Texture::Format::RGBA, Texture::Type::UBYTE },
+    { 0x822D, Texture::InternalFormat::R16F,    Texture::Format::R,    Texture::Type::HALF },
+    { 0x822F, Texture::InternalFormat::RG16F,   Texture::Format::RG,   Texture::Type::HALF },
+    { 0x881B, Texture::InternalFormat::RGB16F,  Texture::Format::RGB,  Texture::Type::HALF },
+    { 0x881A, Texture::InternalFormat::RGBA16F, Texture::Format::RGBA, Texture::Type::HALF },
+    { 0x822E, Texture::InternalFormat::R32F,    Texture::Format::R,    Texture::Type::FLOAT },
+
+#define COMPRESSED(GL, FORMAT) \
+    { GL, Texture::InternalFormat::FORMAT, Texture::Format::RGBA, Texture::Type::COMPRESSED, \
+            CompressedType::FORMAT }
+
+    COMPRESSED(0x9270, EAC_R11),
+    COMPRESSED(0x9271, EAC_R11_SIGNED),
+    COMPRESSED(0x9272, EAC_RG11),
+    COMPRESSED(0x9273, EAC_RG11_SIGNED),
+    COMPRESSED(0x9274, ETC2_RGB8),
+    COMPRESSED(0x9275, ETC2_SRGB8),
+    COMPRESSED(0x9276, ETC2_RGB8_A1),
+    COMPRESSED(0x9277, ETC2_SRGB8_A1),
+    COMPRESSED(0x9278, ETC2_EAC_RGBA8),
+    COMPRESSED(0x9279, ETC2_EAC_SRGBA8),
+    COMPRESSED(0x83F0, DXT1_RGB),
+    COMPRESSED(0x83F1, DXT1_RGBA),
+    COMPRESSED(0x83F2, DXT3_RGBA),
+    COMPRESSED(0x83F3, DXT5_RGBA),
+
+#undef COMPRESSED
+};
+
+} // anonymous namespace
+
+Texture* createKtxTexture(Engine& engine, const utils::Path& path) {
+    std::shared_ptr<KtxReader> reader = KtxReader::open(path.getPath());
+    if (!reader) {
+        return nullptr;
+    }
+
+    KtxFormat const* format = nullptr;
+    for (auto const& entry : KTX_FORMATS) {
+        if (entry.glInternalFormat == reader->getGlInternalFormat()) {
+            format = &entry;
+        }
+    }
+    if (!format || !Texture::isTextureFormatSupported(engine, format->internalFormat)) {
+        std::cerr << "The format of " << path << " is not supported" << std::endl;
+        return nullptr;
+    }
+
+    const bool cubemap = reader->getFaceCount() == 6;
+    Texture* texture = Texture::Builder()
+            .width(reader->getWidth())
+            .height(reader->getHeight())
+            .levels(uint8_t(reader->getLevelCount()))
+            .sampler(cubemap ? Texture::Sampler::SAMPLER_CUBEMAP : Texture::Sampler::SAMPLER_2D)
+            .format(format->internalFormat)
+            .build(engine);
+
+    // each buffer holds a reference to the reader, which unmaps the file when the last one is
+    // released by the driver
+    auto release = [](void*, size_t, void* user) {
+        delete static_cast<std::shared_ptr<KtxReader>*>(user);
+    };
+
+    for (uint32_t i = 0; i < reader->getLevelCount(); i++) {
+        const KtxReader::Level level = reader->getLevel(i);
+        const size_t size = level.faceStride * (reader->getFaceCount() - 1) + level.faceSize;
+        void* user = new std::shared_ptr<KtxReader>(reader);
+
+        Texture::PixelBufferDescriptor buffer = format->type == Texture::Type::COMPRESSED ?
+                Texture::PixelBufferDescriptor(level.data, size, format->compressedType,
+                        uint32_t(level.faceSize), release, user) :
+                Texture::PixelBufferDescriptor(level.data, size, format->format, format->type,
+                        uint8_t(reader->getRowAlignment()), 0, 0, 0, release, user);
+
+        if (cubemap) {
+            Texture::FaceOffsets offsets;
+            for (size_t face = 0; face < 6; face++) {
+                offsets[face] = face * level.faceStride;
+            }
+            texture->setImage(engine, i, std::move(buffer), offsets);
+        } else {
+            texture->setImage(engine, i, std::move(buffer));
+        }
+    }
+    return texture;
+}
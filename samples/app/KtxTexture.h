@@ -0,0 +1,38 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_SAMPLE_KTXTEXTURE_H
+#define TNT_FILAMENT_SAMPLE_KTXTEXTURE_H
+
+namespace filament {
+    class Engine;
+    class Texture;
+}
+
+namespace utils {
+    class Path;
+}
+
+/**
+ * Creates a 2D texture or a cubemap from a KTX file. Every level stored in the file is uploaded
+ * straight from the memory-mapped file, without being copied or converted, the mapping is
+ * released once the driver is done with all the levels.
+ *
+ * Returns nullptr if the file can't be read or its format isn't supported by the engine.
+ */
+filament::Texture* createKtxTexture(filament::Engine& engine, const utils::Path& path);
+
+#endif // TNT_FILAMENT_SAMPLE_KTXTEXTURE_H
@@ -153,6 +153,14 @@ static void printUsage(char* name) {
             "       Applies uniform scale\n\n"
             "   --shadow-plane, -p\n"
             "       Enable shadow plane\n\n"
+            "   --replay=<frames>, -R <frames>\n"
+            "       Renders the given number of frames along a fixed camera path, offscreen,\n"
+            "       and prints their timings as CSV\n\n"
+            "   --replay-output=<path>, -O <path>\n"
+            "       Writes the timings of the replay to a file instead\n\n"
+            "   --replay-baseline=<path>, -B <path>\n"
+            "       Compares the replay with the timings of a previous one, the exit code is 1\n"
+            "       on a regression\n\n"
     );
     const std::string from("SAMPLE_MATERIAL");
     for (size_t pos = usage.find(from); pos != std::string::npos; pos = usage.find(from, pos)) {
@@ -162,7 +170,7 @@ static void printUsage(char* name) {
 }
 
 static int handleCommandLineArgments(int argc, char* argv[], Config* config) {
-    static constexpr const char* OPTSTR = "ha:vps:i:";
+    static constexpr const char* OPTSTR = "ha:vps:i:R:O:B:";
     static const struct option OPTIONS[] = {
             { "help",       no_argument,       nullptr, 'h' },
             { "api",        required_argument, nullptr, 'a' },
@@ -170,6 +178,9 @@ static int handleCommandLineArgments(int argc, char* argv[], Config* config) {
             { "split-view", no_argument,       nullptr, 'v' },
             { "scale",      required_argument, nullptr, 's' },
             { "shadow-plane", no_argument,     nullptr, 'p' },
+            { "replay",     required_argument, nullptr, 'R' },
+            { "replay-output", required_argument, nullptr, 'O' },
+            { "replay-baseline", required_argument, nullptr, 'B' },
             { nullptr, 0, nullptr, 0 }  // termination of the option list
     };
     int opt;
@@ -208,6 +219,21 @@ static int handleCommandLineArgments(int argc, char* argv[], Config* config) {
             case 'p':
                 g_shadowPlane = true;
                 break;
+            case 'R':
+                try {
+                    config->replayFrames = std::stoul(arg);
+                } catch (std::invalid_argument& e) {
+                    // no replay
+                } catch (std::out_of_range& e) {
+                    // no replay
+                }
+                break;
+            case 'O':
+                config->replayOutput = arg;
+                break;
+            case 'B':
+                config->replayBaseline = arg;
+                break;
         }
     }
 
@@ -542,7 +568,5 @@ int main(int argc, char* argv[]) {
 
     g_config.title = "Material Sandbox";
     FilamentApp& filamentApp = FilamentApp::get();
-    filamentApp.run(g_config, setup, cleanup, gui);
-
-    return 0;
+    return filamentApp.run(g_config, setup, cleanup, gui);
 }
@@ -97,6 +97,14 @@ static void printUsage(char* name) {
             "       Add a clear coat layer to the material\n\n"
             "   --anisotropy, -a\n"
             "       Enable anisotropy on the material\n\n"
+            "   --replay=<frames>, -R <frames>\n"
+            "       Renders the given number of frames along a fixed camera path, offscreen,\n"
+            "       and prints their timings as CSV\n\n"
+            "   --replay-output=<path>, -O <path>\n"
+            "       Writes the timings of the replay to a file instead\n\n"
+            "   --replay-baseline=<path>, -B <path>\n"
+            "       Compares the replay with the timings of a previous one, the exit code is 1\n"
+            "       on a regression\n\n"
     );
     const std::string from("SAMPLE_PBR");
     for (size_t pos = usage.find(from); pos != std::string::npos; pos = usage.find(from, pos)) {
@@ -106,7 +114,7 @@ static void printUsage(char* name) {
 }
 
 static int handleCommandLineArgments(int argc, char* argv[], Config* config) {
-    static constexpr const char* OPTSTR = "hi:vs:m:ca";
+    static constexpr const char* OPTSTR = "hi:vs:m:caR:O:B:";
     static const struct option OPTIONS[] = {
             { "help",           no_argument,       nullptr, 'h' },
             { "ibl",            required_argument, nullptr, 'i' },
@@ -115,6 +123,9 @@ static int handleCommandLineArgments(int argc, char* argv[], Config* config) {
             { "material",       required_argument, nullptr, 'm' },
             { "clear-coat",     no_argument,       nullptr, 'c' },
             { "anisotropy",     no_argument,       nullptr, 'a' },
+            { "replay",         required_argument, nullptr, 'R' },
+            { "replay-output",  required_argument, nullptr, 'O' },
+            { "replay-baseline", required_argument, nullptr, 'B' },
             { 0, 0, 0, 0 }  // termination of the option list
     };
     int opt;
@@ -150,6 +161,21 @@ static int handleCommandLineArgments(int argc, char* argv[], Config* config) {
             case 'a':
                 g_pbrConfig.anisotropy = true;
                 break;
+            case 'R':
+                try {
+                    config->replayFrames = std::stoul(arg);
+                } catch (std::invalid_argument& e) {
+                    // no replay
+                } catch (std::out_of_range& e) {
+                    // no replay
+                }
+                break;
+            case 'O':
+                config->replayOutput = arg;
+                break;
+            case 'B':
+                config->replayBaseline = arg;
+                break;
         }
     }
 
@@ -397,7 +423,5 @@ int main(int argc, char* argv[]) {
 
     g_config.title = "PBR";
     FilamentApp& filamentApp = FilamentApp::get();
-    filamentApp.run(g_config, setup, cleanup);
-
-    return 0;
+    return filamentApp.run(g_config, setup, cleanup);
 }
@@ -37,7 +37,6 @@
 
 #include "app/Config.h"
 #include "app/FilamentApp.h"
-#include "app/MeshIO.h"
 
 #include <stb_image.h>
 
@@ -45,15 +44,18 @@
 
 #include <filamat/MaterialBuilder.h>
 
+#include <filameshio/MeshReader.h>
+
 using namespace math;
 using namespace filament;
 using namespace filamat;
+using namespace filamesh;
 using namespace utils;
 
 static std::vector<Path> g_filenames;
 
 static std::map<std::string, MaterialInstance*> g_materialInstances;
-static std::vector<MeshIO::Mesh> g_meshes;
+static std::vector<MeshReader::Mesh> g_meshes;
 static const Material* g_material;
 static Entity g_light;
 static Texture* g_normalMap = nullptr;
@@ -280,7 +282,7 @@ static void setup(Engine* engine, View* view, Scene* scene) {
 
     auto& tcm = engine->getTransformManager();
     for (auto filename : g_filenames) {
-        MeshIO::Mesh mesh  = MeshIO::loadMeshFromFile(engine, filename, g_materialInstances);
+        MeshReader::Mesh mesh = MeshReader::loadMeshFromFile(engine, filename, g_materialInstances);
         if (mesh.renderable) {
             auto ei = tcm.getInstance(mesh.renderable);
             tcm.setTransform(ei, mat4f{ mat3f(g_config.scale), float3(0.0f, 0.0f, -4.0f) } *
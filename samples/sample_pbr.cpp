@@ -38,6 +38,7 @@
 
 #include "app/Config.h"
 #include "app/FilamentApp.h"
+#include "app/KtxTexture.h"
 #include "app/MeshAssimp.h"
 
 #include <stb_image.h>
@@ -158,7 +159,13 @@ static void cleanup(Engine* engine, View* view, Scene* scene) {
 void loadTexture(Engine* engine, const std::string& filePath, Texture** map, bool sRGB = true) {
     if (!filePath.empty()) {
         Path path(filePath);
-        if (path.exists()) {
+        if (path.exists() && path.getExtension() == "ktx") {
+            // the KTX file provides the format and the mipmaps
+            *map = createKtxTexture(*engine, path);
+            if (*map == nullptr) {
+                std::cout << "The texture " << path << " could not be loaded" << std::endl;
+            }
+        } else if (path.exists()) {
             int w, h, n;
             unsigned char* data = stbi_load(path.getAbsolutePath().c_str(), &w, &h, &n, 3);
             if (data != nullptr) {
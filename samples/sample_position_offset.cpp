@@ -140,7 +140,7 @@ static void setup(Engine* engine, View* view, Scene* scene) {
             )SHADER")
             .materialVertex(R"SHADER(
                 void materialVertex(inout MaterialVertexInputs material) {
-                    material.worldPosition.x += sin(getPosition().y * 3.0 + frameUniforms.time * 5.0) * 0.1;
+                    material.worldPosition.x += sin(getPosition().y * 3.0 + getTime() * 5.0) * 0.1;
                 }
             )SHADER")
             .build();
@@ -39,7 +39,7 @@ vec3 getWorldCameraPosition() {
 
 /** @public-api */
 float getTime() {
-    return frameUniforms.time;
+    return timeUniforms.time;
 }
 
 /** @public-api */
@@ -69,6 +69,22 @@ vec3 decodeRGBM(vec4 c) {
     return c.rgb * c.rgb;
 }
 
+//------------------------------------------------------------------------------
+// Common shadow operations
+//------------------------------------------------------------------------------
+
+// The largest exponent whose squared warp still fits in the RGBA16F moments texture
+#define EVSM_EXPONENT 5.54
+
+/**
+ * Warps a depth of the shadow map, in [0, 1], with the positive and negative exponentials of
+ * exponential variance shadow maps (see ShadowAtlas).
+ */
+HIGHP vec2 evsmWarp(const HIGHP float depth) {
+    HIGHP float d = depth * 2.0 - 1.0;
+    return vec2(exp(EVSM_EXPONENT * d), -exp(-EVSM_EXPONENT * d));
+}
+
 //------------------------------------------------------------------------------
 // Common debug
 //------------------------------------------------------------------------------
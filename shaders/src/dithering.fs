@@ -38,31 +38,31 @@ float interleavedGradientNoise(const HIGHP vec2 n) {
 // Dithering
 //------------------------------------------------------------------------------
 
-vec4 Dither_InterleavedGradientNoise(vec4 rgba) {
+vec4 Dither_InterleavedGradientNoise(vec4 rgba, const HIGHP vec2 fragCoord) {
     // Jimenez 2014, "Next Generation Post-Processing in Call of Duty"
-    float noise = interleavedGradientNoise(gl_FragCoord.xy + postProcessUniforms.time);
+    float noise = interleavedGradientNoise(fragCoord + postProcessUniforms.time);
     // remap from [0..1[ to [-1..1[
     noise = (noise * 2.0) - 1.0;
     return vec4(rgba.rgb + noise / 255.0, rgba.a);
 }
 
-vec4 Dither_Vlachos(vec4 rgba) {
+vec4 Dither_Vlachos(vec4 rgba, const HIGHP vec2 fragCoord) {
     // Vlachos 2016, "Advanced VR Rendering"
-    HIGHP vec3 noise = vec3(dot(vec2(171.0, 231.0), gl_FragCoord.xy + postProcessUniforms.time));
+    HIGHP vec3 noise = vec3(dot(vec2(171.0, 231.0), fragCoord + postProcessUniforms.time));
     noise = fract(noise / vec3(103.0, 71.0, 97.0));
     // remap from [0..1[ to [-1..1[
     noise = (noise * 2.0) - 1.0;
     return vec4(rgba.rgb + (noise / 255.0), rgba.a);
 }
 
-vec4 Dither_TriangleNoise(vec4 rgba) {
+vec4 Dither_TriangleNoise(vec4 rgba, const HIGHP vec2 fragCoord) {
     // Gjøl 2016, "Banding in Games: A Noisy Rant"
-    return rgba + triangleNoise(gl_FragCoord.xy * frameUniforms.resolution.zw) / 255.0;
+    return rgba + triangleNoise(fragCoord * frameUniforms.resolution.zw) / 255.0;
 }
 
-vec4 Dither_TriangleNoiseRGB(vec4 rgba) {
+vec4 Dither_TriangleNoiseRGB(vec4 rgba, const HIGHP vec2 fragCoord) {
     // Gjøl 2016, "Banding in Games: A Noisy Rant"
-    vec2 uv = gl_FragCoord.xy * frameUniforms.resolution.zw;
+    vec2 uv = fragCoord * frameUniforms.resolution.zw;
     vec3 dither = vec3(
             triangleNoise(uv),
             triangleNoise(uv + 0.1337),
@@ -80,16 +80,22 @@ vec4 Dither_TriangleNoiseRGB(vec4 rgba) {
  * This dithering function assumes we are dithering to an 8-bit target.
  * This function dithers the alpha channel assuming premultiplied output
  */
-vec4 dither(vec4 rgba) {
+vec4 dither(vec4 rgba, const HIGHP vec2 fragCoord) {
 #if DITHERING_OPERATOR == DITHERING_NONE
     return rgba;
 #elif DITHERING_OPERATOR == DITHERING_INTERLEAVED_NOISE
-    return Dither_InterleavedGradientNoise(rgba);
+    return Dither_InterleavedGradientNoise(rgba, fragCoord);
 #elif DITHERING_OPERATOR == DITHERING_VLACHOS
-    return Dither_Vlachos(rgba);
+    return Dither_Vlachos(rgba, fragCoord);
 #elif DITHERING_OPERATOR  == DITHERING_TRIANGLE_NOISE
-    return Dither_TriangleNoise(rgba);
+    return Dither_TriangleNoise(rgba, fragCoord);
 #elif DITHERING_OPERATOR  == DITHERING_TRIANGLE_NOISE_RGB
-    return Dither_TriangleNoiseRGB(rgba);
+    return Dither_TriangleNoiseRGB(rgba, fragCoord);
 #endif
 }
+
+#if !POST_PROCESS_COMPUTE
+vec4 dither(vec4 rgba) {
+    return dither(rgba, gl_FragCoord.xy);
+}
+#endif
@@ -1,7 +1,7 @@
 // ES 3.0/3.1 gives us the ARB_gpu_shader5 bits we need
 #define gpu_shader5        1
-// ES 3.0 does not have gather though
-#if defined(TARGET_VULKAN_ENVIRONMENT) || !defined(TARGET_MOBILE)
+// ES 3.0 does not have gather though, and gathered samples can't be tone mapped (see below)
+#if (defined(TARGET_VULKAN_ENVIRONMENT) || !defined(TARGET_MOBILE)) && !POST_PROCESS_FUSED
 #define FXAA_GATHER4_ALPHA 1
 #else
 #define FXAA_GATHER4_ALPHA 0
@@ -16,6 +16,24 @@
 #   define FXAA_GREEN_AS_LUMA 1
 #endif
 
+#if POST_PROCESS_FUSED
+// The fused pass reads the HDR color buffer: each sample is tone mapped as it's read, into
+// what the tone mapping pass would have written (see resolve() in post_process.fs). The
+// samples are filtered before they're tone mapped, which only matters across high contrast
+// edges.
+vec4 fxaaToneMap(vec4 color) {
+#if POST_PROCESS_OPAQUE
+    color.rgb = OECF(tonemap(color.rgb));
+    color.a   = luminance(color.rgb);
+#else
+    color.rgb /= color.a + FLT_EPS;
+    color.rgb  = OECF(tonemap(color.rgb));
+    color.rgb *= color.a + FLT_EPS;
+#endif
+    return color;
+}
+#endif
+
 /**
   G3D version of FXAA. See copyright and warranty statement below.
 
@@ -417,8 +435,13 @@ NOTE the other tuning knobs are now in the shader function inputs!
 /*--------------------------------------------------------------------------*/
 #if (FXAA_GLSL_130 == 1)
     // Requires "#version 130" or better
+#if POST_PROCESS_FUSED
+    #define FxaaTexTop(t, p) fxaaToneMap(textureLod(t, p, 0.0))
+    #define FxaaTexOff(t, p, o, r) fxaaToneMap(textureLodOffset(t, p, 0.0, o))
+#else
     #define FxaaTexTop(t, p) textureLod(t, p, 0.0)
     #define FxaaTexOff(t, p, o, r) textureLodOffset(t, p, 0.0, o)
+#endif
     #if (FXAA_GATHER4_ALPHA == 1)
         // use #extension gpu_shader5 : enable
         #define FxaaTexAlpha4(t, p) textureGather(t, p, 3)
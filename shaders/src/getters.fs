@@ -24,7 +24,30 @@ vec2 getUV1() {
 #endif
 
 #if defined(HAS_SHADOWING) && defined(HAS_DIRECTIONAL_LIGHTING)
+/**
+ * Returns the light space position of the fragment in the shadow cascade that covers it.
+ * The first cascade is interpolated from the vertex shader, the other cascades are computed
+ * here. Fragments beyond the last cascade return a position that is never in shadow.
+ */
 HIGHP vec3 getLightSpacePosition() {
-    return vertex_lightSpacePosition.xyz * (1.0 / vertex_lightSpacePosition.w);
+    HIGHP vec4 p = vertex_lightSpacePosition;
+    if (frameUniforms.shadowBias.z > 1.0) {
+        HIGHP float z = -(frameUniforms.viewFromWorldMatrix * vec4(vertex_worldPosition, 1.0)).z;
+        int cascade = int(dot(vec4(greaterThan(vec4(z), frameUniforms.cascadeSplits)), vec4(1.0)));
+        if (float(cascade) >= frameUniforms.shadowBias.z) {
+            return vec3(0.0);
+        }
+        if (cascade > 0) {
+            // geometric normal, facing the camera, for the normal bias
+            HIGHP vec3 n = normalize(cross(dFdx(vertex_worldPosition), dFdy(vertex_worldPosition)));
+            n *= sign(dot(n, frameUniforms.cameraPosition - vertex_worldPosition));
+            float NoL = saturate(dot(n, frameUniforms.lightDirection));
+            float normalBias = sqrt(1.0 - NoL * NoL) * frameUniforms.cascadeNormalBias[cascade];
+            p = frameUniforms.lightFromWorldMatrix[cascade] *
+                    vec4(vertex_worldPosition + n * normalBias, 1.0);
+            p.z -= frameUniforms.cascadeConstantBias[cascade];
+        }
+    }
+    return p.xyz * (1.0 / p.w);
 }
 #endif
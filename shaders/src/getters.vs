@@ -3,17 +3,46 @@
 //------------------------------------------------------------------------------
 
 mat4 getLightFromWorldMatrix() {
-    return frameUniforms.lightFromWorldMatrix;
+    // the other shadow cascades are computed in the fragment shader
+    return frameUniforms.lightFromWorldMatrix[0];
 }
 
+#if defined(HAS_INSTANCING)
+int getInstanceIndex() {
+#if defined(CODEGEN_TARGET_VULKAN_ENVIRONMENT)
+    return gl_InstanceIndex;
+#elif defined(GL_ARB_shader_draw_parameters)
+    // the base instance of indirect draws identifies each draw, see RenderPass
+    return gl_InstanceID + gl_BaseInstanceARB;
+#else
+    return gl_InstanceID;
+#endif
+}
+#endif
+
 /** @public-api */
 mat4 getWorldFromModelMatrix() {
-    return objectUniforms.worldFromModelMatrix;
+    // the transform is affine and only its first 3 rows are stored
+#if defined(HAS_INSTANCING)
+    int index = getInstanceIndex() * 3;
+    vec4 r0 = instancesUniforms.worldFromModelMatrix[index];
+    vec4 r1 = instancesUniforms.worldFromModelMatrix[index + 1];
+    vec4 r2 = instancesUniforms.worldFromModelMatrix[index + 2];
+#else
+    vec4 r0 = objectUniforms.worldFromModelMatrix[0];
+    vec4 r1 = objectUniforms.worldFromModelMatrix[1];
+    vec4 r2 = objectUniforms.worldFromModelMatrix[2];
+#endif
+    return transpose(mat4(r0, r1, r2, vec4(0.0, 0.0, 0.0, 1.0)));
 }
 
 /** @public-api */
 mat3 getWorldFromModelNormalMatrix() {
+#if defined(HAS_INSTANCING)
+    return instancesUniforms.worldFromModelNormalMatrix[getInstanceIndex()];
+#else
     return objectUniforms.worldFromModelNormalMatrix;
+#endif
 }
 
 //------------------------------------------------------------------------------
@@ -36,6 +65,52 @@ void skinPosition(inout vec3 p, const uvec4 ids, const vec4 weights) {
         + partialTransformVertexUnitQT(p, bonesUniforms.bones[ids.z * 2u], bonesUniforms.bones[ids.z * 2u + 1u].xyz) * weights.z
         + partialTransformVertexUnitQT(p, bonesUniforms.bones[ids.w * 2u], bonesUniforms.bones[ids.w * 2u + 1u].xyz) * weights.w;
 }
+
+int getVertexIndex() {
+#if defined(CODEGEN_TARGET_VULKAN_ENVIRONMENT)
+    return gl_VertexIndex;
+#else
+    return gl_VertexID;
+#endif
+}
+
+/*
+ * The morph targets texture starts with a texel per vertex, which holds the index of the first
+ * texel of the vertex's deltas and their count. Each delta then takes two texels: the position
+ * delta with the index of its target in w, and the normal delta.
+ */
+vec4 getMorphTargetsTexel(int index) {
+    int width = textureSize(morphTargets_deltas, 0).x;
+    return texelFetch(morphTargets_deltas, ivec2(index % width, index / width), 0);
+}
+
+float getMorphWeight(int target) {
+    return morphingUniforms.weights[target >> 2][target & 3];
+}
+
+void morphPosition(inout vec3 p) {
+    if (morphingUniforms.count == 0u) {
+        return;
+    }
+    vec2 deltas = getMorphTargetsTexel(getVertexIndex()).xy;
+    int end = int(deltas.x) + int(deltas.y) * 2;
+    for (int i = int(deltas.x); i < end; i += 2) {
+        vec4 delta = getMorphTargetsTexel(i);
+        p += delta.xyz * getMorphWeight(int(delta.w));
+    }
+}
+
+void morphNormal(inout vec3 n) {
+    if (morphingUniforms.count == 0u) {
+        return;
+    }
+    vec2 deltas = getMorphTargetsTexel(getVertexIndex()).xy;
+    int end = int(deltas.x) + int(deltas.y) * 2;
+    for (int i = int(deltas.x); i < end; i += 2) {
+        float weight = getMorphWeight(int(getMorphTargetsTexel(i).w));
+        n += getMorphTargetsTexel(i + 1).xyz * weight;
+    }
+}
 #endif
 
 /** @public-api */
@@ -46,6 +121,7 @@ vec4 getPosition() {
 vec4 getSkinnedPosition() {
     vec4 pos = getPosition();
 #if defined(HAS_SKINNING)
+    morphPosition(pos.xyz);
     skinPosition(pos.xyz, mesh_bone_indices, mesh_bone_weights);
 #endif
     return pos;
@@ -58,7 +134,7 @@ vec4 getSkinnedPosition() {
 /**
  * Computes and returns the position in world space of the current vertex.
  * The world position computation depends on the current vertex domain. This
- * function optionally applies vertex skinning if needed.
+ * function optionally applies morphing and vertex skinning if needed.
  *
  * NOTE: the "transform" and "position" temporaries are necessary to work around
  * an issue with Adreno drivers (b/110851741).
@@ -35,7 +35,8 @@
 
 vec3 decodeDataForIBL(const vec4 data) {
 #if defined(IBL_USE_RGBM)
-    return decodeRGBM(data);
+    // the float formats (e.g. RGB9_E5, R11F_G11F_B10F) aren't encoded
+    return frameUniforms.iblRGBM > 0.0 ? decodeRGBM(data) : data.rgb;
 #else
     return data.rgb;
 #endif
@@ -154,13 +155,15 @@ vec3 specularIrradiance(const vec3 r, float roughness) {
     // lod = nb_mips * sqrt(linear_roughness)
     // where linear_roughness = roughness^2
     // using all the mip levels requires seamless cubemap sampling
+    // the environment is rotated by looking it up in its own space, see IndirectLight::setRotation()
     float lod = IBL_MAX_MIP_LEVEL * roughness;
-    return decodeDataForIBL(textureLod(light_iblSpecular, r, lod));
+    return decodeDataForIBL(textureLod(light_iblSpecular, frameUniforms.iblRotation * r, lod));
 }
 
 vec3 specularIrradiance(const vec3 r, float roughness, float offset) {
     float lod = IBL_MAX_MIP_LEVEL * roughness;
-    return decodeDataForIBL(textureLod(light_iblSpecular, r, lod + offset));
+    return decodeDataForIBL(
+            textureLod(light_iblSpecular, frameUniforms.iblRotation * r, lod + offset));
 }
 
 vec3 getSpecularDominantDirection(vec3 n, vec3 r, float linearRoughness) {
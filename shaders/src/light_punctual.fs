@@ -11,6 +11,21 @@
 #define RECORD_BUFFER_WIDTH         (1u << RECORD_BUFFER_WIDTH_SHIFT)
 #define RECORD_BUFFER_WIDTH_MASK    (RECORD_BUFFER_WIDTH - 1u)
 
+#define LIGHT_BIN_TILE_OFFSET       FROXEL_BUFFER_WIDTH
+#define LIGHT_BIN_WORD_COUNT        8u
+
+#if defined(TARGET_VULKAN_ENVIRONMENT)
+// The froxel data is read from storage buffers instead of the light_froxels and light_records
+// textures: one uint per froxel entry, 4 records of 8 bits per uint
+layout(std430, binding = FROXELS_STORAGE_BINDING) readonly buffer FroxelsStorage {
+    uint entries[];
+} froxelsStorage;
+
+layout(std430, binding = RECORDS_STORAGE_BINDING) readonly buffer RecordsStorage {
+    uint entries[];
+} recordsStorage;
+#endif
+
 struct FroxelParams {
     uint recordOffset; // offset at which the list of lights for this froxel starts
     uint pointCount;   // number of point lights in this froxel
@@ -54,13 +69,25 @@ ivec2 getFroxelTexCoord(uint froxelIndex) {
     return ivec2(froxelIndex & FROXEL_BUFFER_WIDTH_MASK, froxelIndex >> FROXEL_BUFFER_WIDTH_SHIFT);
 }
 
+/**
+ * Returns the raw entry of the froxel buffer at the specified index, as the
+ * two 16 bits halves of the entry.
+ */
+uvec2 getFroxelEntry(uint index) {
+#if defined(TARGET_VULKAN_ENVIRONMENT)
+    uint entry = froxelsStorage.entries[index];
+    return uvec2(entry & 0xFFFFu, entry >> 16u);
+#else
+    return texelFetch(light_froxels, getFroxelTexCoord(index), 0).rg;
+#endif
+}
+
 /**
  * Returns the froxel data for the given froxel index. The data is fetched
- * from the light_froxels texture.
+ * from the froxel buffer.
  */
 FroxelParams getFroxelParams(uint froxelIndex) {
-    ivec2 texCoord = getFroxelTexCoord(froxelIndex);
-    uvec2 entry = texelFetch(light_froxels, texCoord, 0).rg;
+    uvec2 entry = getFroxelEntry(froxelIndex);
 
     FroxelParams froxel;
     froxel.recordOffset = entry.r;
@@ -78,6 +105,17 @@ ivec2 getRecordTexCoord(uint index) {
     return ivec2(index & RECORD_BUFFER_WIDTH_MASK, index >> RECORD_BUFFER_WIDTH_SHIFT);
 }
 
+/**
+ * Returns the light record at the specified index of the record buffer.
+ */
+uint getLightRecord(uint index) {
+#if defined(TARGET_VULKAN_ENVIRONMENT)
+    return (recordsStorage.entries[index >> 2u] >> ((index & 3u) << 3u)) & 0xFFu;
+#else
+    return texelFetch(light_records, getRecordTexCoord(index), 0).r;
+#endif
+}
+
 float getSquareFalloffAttenuation(float distanceSquare, float falloff) {
     float factor = distanceSquare * falloff;
     float smoothFactor = saturate(1.0 - factor * factor);
@@ -99,6 +137,32 @@ float getAngleAttenuation(const vec3 lightDir, const vec3 l, const vec2 scaleOff
     return attenuation * attenuation;
 }
 
+// Make sure this matches GpuLightBuffer::NO_SHADOW
+#define NO_SHADOW 0xFFFFFFFFu
+
+/**
+ * The parameters of a light in the lightsUniforms UBO, see GpuLightBuffer::LightParameters.
+ * The color and direction are stored as half-floats.
+ */
+HIGHP vec4 getLightPositionFalloff(uint lightIndex) {
+    return uintBitsToFloat(lightsUniforms.lights[lightIndex * 3u]);
+}
+
+HIGHP uvec4 getLightColorDirection(uint lightIndex) {
+    return lightsUniforms.lights[lightIndex * 3u + 1u];
+}
+
+HIGHP vec4 getLightIntensitySpot(uint lightIndex) {
+    return uintBitsToFloat(lightsUniforms.lights[lightIndex * 3u + 2u]);
+}
+
+void setupPunctualLightColor(inout Light light, const HIGHP uvec4 colorDirection,
+        const HIGHP float intensity) {
+    light.colorIntensity.rg = unpackHalf2x16(colorDirection.x);
+    light.colorIntensity.b = unpackHalf2x16(colorDirection.y).x;
+    light.colorIntensity.w = computePreExposedIntensity(intensity, frameUniforms.exposure);
+}
+
 /**
  * Light setup common to point and spot light. This function sets the light vector
  * "l" and the attenuation factor in the Light structure. The attenuation factor
@@ -112,34 +176,63 @@ void setupPunctualLight(inout Light light, const HIGHP vec4 positionFalloff) {
     light.attenuation = getDistanceAttenuation(posToLight, positionFalloff.w);
 }
 
+#if defined(HAS_SHADOWING)
 /**
- * Returns a Light structure (see common_lighting.fs) describing a spot light.
- * The colorIntensity field will store the *pre-exposed* intensity of the light
- * in the w component.
+ * Returns the visibility of the fragment from a spot light which has a shadow map. The
+ * position is moved towards the light by the constant bias, and along the normal by an
+ * amount that grows with the distance to the light, like the texels of the shadow map.
+ */
+float getSpotLightVisibility(uint shadowIndex, const vec3 l, const HIGHP vec3 posToLight) {
+    vec2 bias = frameUniforms.spotShadowBias[shadowIndex].xy;
+    vec3 n = normalize(vertex_worldNormal);
+    float NoL = saturate(dot(n, l));
+    float normalBias = sqrt(1.0 - NoL * NoL) * bias.y * length(posToLight);
+    HIGHP vec3 p = vertex_worldPosition + l * bias.x + n * normalBias;
+    HIGHP vec4 shadowPosition = frameUniforms.spotLightFromWorldMatrix[shadowIndex] * vec4(p, 1.0);
+    return shadow(light_shadowMap, shadowPosition.xyz * (1.0 / shadowPosition.w));
+}
+#endif
+
+/**
+ * Returns a Light structure (see common_lighting.fs) describing a spot light, or a point
+ * light, which has no angle attenuation. The colorIntensity field will store the
+ * *pre-exposed* intensity of the light in the w component.
  *
  * The light parameters used to compute the Light structure are fetched from the
- * lightsUniforms uniform buffer.
+ * lightsUniforms uniform buffer, at the specified light index.
  */
-Light getSpotLight(uint index) {
+Light getSpotLightAt(uint lightIndex) {
     Light light;
-    ivec2 texCoord = getRecordTexCoord(index);
-    uint lightIndex = texelFetch(light_records, texCoord, 0).r;
-
-    HIGHP vec4 positionFalloff = lightsUniforms.lights[lightIndex][0];
-    HIGHP vec4 colorIntensity  = lightsUniforms.lights[lightIndex][1];
-          vec4 directionIES    = lightsUniforms.lights[lightIndex][2];
-          vec2 scaleOffset     = lightsUniforms.lights[lightIndex][3].xy;
 
-    light.colorIntensity.rgb = colorIntensity.rgb;
-    light.colorIntensity.w = computePreExposedIntensity(colorIntensity.w, frameUniforms.exposure);
+    HIGHP vec4 positionFalloff = getLightPositionFalloff(lightIndex);
+    HIGHP uvec4 colorDirection = getLightColorDirection(lightIndex);
+    HIGHP vec4 intensitySpot   = getLightIntensitySpot(lightIndex);
 
+    setupPunctualLightColor(light, colorDirection, intensitySpot.x);
     setupPunctualLight(light, positionFalloff);
 
-    light.attenuation *= getAngleAttenuation(-directionIES.xyz, light.l, scaleOffset);
+    vec2 directionYZ = unpackHalf2x16(colorDirection.z);
+    vec3 direction = vec3(unpackHalf2x16(colorDirection.y).y, directionYZ);
+    light.attenuation *= getAngleAttenuation(-direction, light.l, intensitySpot.yz);
+
+#if defined(HAS_SHADOWING)
+    if (colorDirection.w != NO_SHADOW) {
+        light.attenuation *= getSpotLightVisibility(colorDirection.w, light.l,
+                positionFalloff.xyz - vertex_worldPosition);
+    }
+#endif
 
     return light;
 }
 
+/**
+ * Returns a Light structure describing the spot light of the specified entry of the
+ * record buffer.
+ */
+Light getSpotLight(uint index) {
+    return getSpotLightAt(getLightRecord(index));
+}
+
 /**
  * Returns a Light structure (see common_lighting.fs) describing a point light.
  * The colorIntensity field will store the *pre-exposed* intensity of the light
@@ -150,26 +243,77 @@ Light getSpotLight(uint index) {
  */
 Light getPointLight(uint index) {
     Light light;
-    ivec2 texCoord = getRecordTexCoord(index);
-    uint lightIndex = texelFetch(light_records, texCoord, 0).r;
-
-    HIGHP vec4 positionFalloff = lightsUniforms.lights[lightIndex][0];
-    HIGHP vec4 colorIntensity  = lightsUniforms.lights[lightIndex][1];
+    uint lightIndex = getLightRecord(index);
 
-    light.colorIntensity.rgb = colorIntensity.rgb;
-    light.colorIntensity.w = computePreExposedIntensity(colorIntensity.w, frameUniforms.exposure);
+    HIGHP vec4 positionFalloff = getLightPositionFalloff(lightIndex);
+    HIGHP uvec4 colorDirection = getLightColorDirection(lightIndex);
+    HIGHP vec4 intensitySpot   = getLightIntensitySpot(lightIndex);
 
+    setupPunctualLightColor(light, colorDirection, intensitySpot.x);
     setupPunctualLight(light, positionFalloff);
 
     return light;
 }
 
+#if defined(GL_ES) && __VERSION__ < 310
+// findLSB() needs ESSL 3.10, the lowest set bit is a power of two, which log2() returns exactly
+uint lowestSetBit(const uint mask) {
+    return uint(log2(float(mask & (~mask + 1u))));
+}
+#else
+uint lowestSetBit(const uint mask) {
+    return uint(findLSB(mask));
+}
+#endif
+
+/**
+ * Evaluates the punctual lights of the current fragment's tile, within the light range of its
+ * slice, with light binning (see Froxelizer::froxelizeAssignBins()). The light range of each
+ * slice is stored in the first row of the light_froxels texture, the 256 bits mask of the
+ * lights of each tile after that, 32 bits per texel.
+ */
+void evaluatePunctualLightsBinned(const PixelParams pixel, inout vec3 color) {
+    uvec3 froxelCoord = getFroxelCoords(gl_FragCoord.xyz);
+    // the slices past the last one have no lights, up to the end of the first row
+    uint slice = min(froxelCoord.z, LIGHT_BIN_TILE_OFFSET - 1u);
+    uvec2 range = getFroxelEntry(slice);
+    uint tile = froxelCoord.x + froxelCoord.y * frameUniforms.fParams.x;
+    uint tileOffset = LIGHT_BIN_TILE_OFFSET + tile * LIGHT_BIN_WORD_COUNT;
+
+    uint wordEnd = (range.y + 31u) >> 5u;
+    for (uint word = range.x >> 5u; word < wordEnd; word++) {
+        uvec2 bits = getFroxelEntry(tileOffset + word);
+        uint mask = bits.r | (bits.g << 16u);
+
+        // only keep the lights in the range of the slice
+        uint first = word << 5u;
+        if (range.x > first) {
+            mask &= ~0u << (range.x - first);
+        }
+        if (range.y < first + 32u) {
+            mask &= (1u << (range.y - first)) - 1u;
+        }
+
+        while (mask != 0u) {
+            uint bit = lowestSetBit(mask);
+            mask &= mask - 1u;
+            Light light = getSpotLightAt(first + bit);
+            color.rgb += surfaceShading(pixel, light, 1.0);
+        }
+    }
+}
+
 /**
  * Evaluates all punctual lights that my affect the current fragment.
  * The result of the lighting computations is accumulated in the color
  * parameter, as linear HDR RGB.
  */
 void evaluatePunctualLights(const PixelParams pixel, inout vec3 color) {
+    if (frameUniforms.lightBinning != 0u) {
+        evaluatePunctualLightsBinned(pixel, color);
+        return;
+    }
+
     // Fetch the light information stored in the froxel that contains the
     // current fragment
     FroxelParams froxel = getFroxelParams(getFroxelIndex(gl_FragCoord.xyz));
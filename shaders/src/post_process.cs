@@ -0,0 +1,136 @@
+//------------------------------------------------------------------------------
+// Post-process stages running as compute shaders, see PostProcessManager::computePass()
+//------------------------------------------------------------------------------
+
+// must match PostProcessManager::COMPUTE_GROUP_SIZE
+#define GROUP_SIZE 8
+
+// the pixels of a group and a border of one pixel
+#define TILE_SIZE (GROUP_SIZE + 2)
+
+layout(local_size_x = GROUP_SIZE, local_size_y = GROUP_SIZE) in;
+
+layout(binding = 0, rgba8) uniform writeonly mediump image2D postProcess_output;
+
+// The tone mapped colors around the group, loaded once and shared by its invocations, which read
+// each of them up to 9 times.
+shared vec4 tile[TILE_SIZE * TILE_SIZE];
+
+// what the tone mapping pass would write, see resolve() in post_process.fs
+vec4 toneMap(vec4 color) {
+#if POST_PROCESS_OPAQUE
+    color.rgb = OECF(tonemap(color.rgb));
+    color.a   = luminance(color.rgb);
+#else
+    color.rgb /= color.a + FLT_EPS;
+    color.rgb  = OECF(tonemap(color.rgb));
+    color.rgb *= color.a + FLT_EPS;
+#endif
+    return color;
+}
+
+float luma(const vec4 color) {
+#if POST_PROCESS_OPAQUE
+    return color.a;
+#else
+    return color.g;
+#endif
+}
+
+vec4 tileTexel(const ivec2 p) {
+    return tile[p.y * TILE_SIZE + p.x];
+}
+
+// bilinear filtering of the tile, p is in texels of the tile (texel centers are at .5)
+vec4 tileSample(const vec2 p) {
+    vec2 q = p - 0.5;
+    ivec2 i = clamp(ivec2(floor(q)), ivec2(0), ivec2(TILE_SIZE - 2));
+    vec2 f = clamp(q - vec2(i), 0.0, 1.0);
+    return mix(
+            mix(tileTexel(i),               tileTexel(i + ivec2(1, 0)), f.x),
+            mix(tileTexel(i + ivec2(0, 1)), tileTexel(i + ivec2(1, 1)), f.x), f.y);
+}
+
+// bilinear filtering of the color buffer, tone mapped, p is in texels of the viewport
+vec4 colorSample(const HIGHP vec2 p) {
+    HIGHP vec2 size = vec2(textureSize(postProcess_colorBuffer, 0));
+    return toneMap(textureLod(postProcess_colorBuffer, p / size, 0.0));
+}
+
+// FXAA console with the G3D patches, like PostProcess_AntiAliasing() in post_process.fs: the
+// 3x3 neighborhood and the first taps along the edge are read from the tile, only the far taps
+// are read from the color buffer. t is the pixel in the tile, p its center in the viewport.
+vec4 fxaaTile(const ivec2 t, const HIGHP vec2 p) {
+    const float edgeSharpness = 8.0;
+    const float edgeThreshold = 0.08;
+    const float edgeThresholdMin = 0.04;
+
+    vec4 rgbyM = tileTexel(t);
+    float lumaM = luma(rgbyM);
+
+    // the corners of the pixel, where 4 texels are averaged
+    vec4 n  = tileTexel(t + ivec2( 0, -1));
+    vec4 s  = tileTexel(t + ivec2( 0,  1));
+    vec4 w  = tileTexel(t + ivec2(-1,  0));
+    vec4 e  = tileTexel(t + ivec2( 1,  0));
+    float lumaNw = luma(tileTexel(t + ivec2(-1, -1)) + n + w + rgbyM) * 0.25;
+    float lumaNe = luma(tileTexel(t + ivec2( 1, -1)) + n + e + rgbyM) * 0.25;
+    float lumaSw = luma(tileTexel(t + ivec2(-1,  1)) + s + w + rgbyM) * 0.25;
+    float lumaSe = luma(tileTexel(t + ivec2( 1,  1)) + s + e + rgbyM) * 0.25;
+
+    float lumaMax = max(max(lumaNw, lumaSw), max(lumaNe, lumaSe));
+    float lumaMin = min(min(lumaNw, lumaSw), min(lumaNe, lumaSe));
+    float lumaMaxSubMinM = max(lumaMax, lumaM) - min(lumaMin, lumaM);
+    if (lumaMaxSubMinM < max(edgeThresholdMin, lumaMax * edgeThreshold)) {
+        return rgbyM;
+    }
+
+    // tangent to the edge
+    float dirSwMinusNe = lumaSw - lumaNe + 1.0 / 512.0;
+    float dirSeMinusNw = lumaSe - lumaNw;
+    vec2 dir1 = normalize(vec2(dirSwMinusNe + dirSeMinusNw, dirSwMinusNe - dirSeMinusNw));
+
+    // one pixel away on each side, always within the tile
+    vec2 center = vec2(t) + 0.5;
+    vec4 rgbyN1 = tileSample(center - dir1);
+    vec4 rgbyP1 = tileSample(center + dir1);
+
+    // up to 6 pixels away, farther as the contrast increases
+    float dirAbsMinTimesC = max(abs(dir1.x), abs(dir1.y)) * edgeSharpness * 0.015;
+    vec2 dir2 = dir1 * min(lumaMaxSubMinM / dirAbsMinTimesC, 3.0);
+    vec4 rgbyN2 = colorSample(p - dir2 * 2.0);
+    vec4 rgbyP2 = colorSample(p + dir2 * 2.0);
+
+    vec4 rgbyA = rgbyN1 + rgbyP1;
+    vec4 rgbyB = ((rgbyN2 + rgbyP2) * 0.25) + (rgbyA * 0.25);
+    if (luma(rgbyB) < lumaMin || luma(rgbyB) > lumaMax) {
+        rgbyB.xyz = rgbyA.xyz * 0.5;
+    }
+    return mix(rgbyB, rgbyM, 0.25);
+}
+
+void main() {
+    ivec2 size = ivec2(frameUniforms.resolution.xy);
+
+    // the invocations of the group load the tile together, the pixels out of the viewport are
+    // clamped to its edges, like the color buffer's sampler does
+    ivec2 origin = ivec2(gl_WorkGroupID.xy) * GROUP_SIZE - 1;
+    for (int i = int(gl_LocalInvocationIndex); i < TILE_SIZE * TILE_SIZE;
+            i += GROUP_SIZE * GROUP_SIZE) {
+        ivec2 texel = clamp(origin + ivec2(i % TILE_SIZE, i / TILE_SIZE), ivec2(0), size - 1);
+        tile[i] = toneMap(texelFetch(postProcess_colorBuffer, texel, 0));
+    }
+    barrier();
+
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(pixel, size))) {
+        return;
+    }
+
+    HIGHP vec2 p = vec2(pixel) + 0.5;
+    vec4 color = fxaaTile(ivec2(gl_LocalInvocationID.xy) + 1, p);
+#if POST_PROCESS_OPAQUE
+    color.a = 1.0;
+#endif
+    imageStore(postProcess_output, pixel, dither(color, p));
+}
@@ -3,6 +3,19 @@ LAYOUT_LOCATION(0) in HIGHP vec2 vertex_uv;
 LAYOUT_LOCATION(0) out vec4 fragColor;
 
 #if POST_PROCESS_TONE_MAPPING
+#if POST_PROCESS_SUBPASS && defined(CODEGEN_TARGET_VULKAN_ENVIRONMENT)
+// the color pass is the first subpass of the render pass, its color is read at this fragment
+layout(input_attachment_index = 0, binding = SUBPASS_INPUT_BINDING)
+        uniform mediump subpassInput postProcess_subpassColor;
+
+vec3 resolveFragment(const ivec2 uv) {
+    return subpassLoad(postProcess_subpassColor).rgb;
+}
+
+vec4 resolveAlphaFragment(const ivec2 uv) {
+    return subpassLoad(postProcess_subpassColor);
+}
+#else
 vec3 resolveFragment(const ivec2 uv) {
     return texelFetch(postProcess_colorBuffer, uv, 0).rgb;
 }
@@ -10,6 +23,7 @@ vec3 resolveFragment(const ivec2 uv) {
 vec4 resolveAlphaFragment(const ivec2 uv) {
     return texelFetch(postProcess_colorBuffer, uv, 0);
 }
+#endif
 
 vec4 resolve() {
 #if POST_PROCESS_OPAQUE
@@ -60,11 +74,169 @@ vec4 PostProcess_AntiAliasing() {
 }
 #endif
 
+#if POST_PROCESS_FUSED
+// Tone mapping, FXAA and the scaling to the view's viewport in a single pass: FXAA tone maps the
+// HDR samples it reads (see fxaa.fs), which are bilinearly filtered at the output pixels.
+vec4 PostProcess_Fused() {
+    vec4 color = PostProcess_AntiAliasing();
+    return dither(color);
+}
+#endif
+
+#if POST_PROCESS_DEPTH
+// must match DepthPyramid::TILE_SIZE
+const int DEPTH_TILE_SIZE = 16;
+
+vec4 PostProcess_DepthDownsample() {
+    // each fragment keeps the farthest depth of a tile of the depth buffer
+    ivec2 size = ivec2(frameUniforms.resolution.xy);
+    ivec2 base = ivec2(gl_FragCoord.xy) * DEPTH_TILE_SIZE;
+#if defined(TARGET_VULKAN_ENVIRONMENT)
+    base.y += int(postProcessUniforms.yOffset);
+#endif
+    HIGHP float depth = 0.0;
+    for (int y = 0; y < DEPTH_TILE_SIZE; y++) {
+        for (int x = 0; x < DEPTH_TILE_SIZE; x++) {
+            ivec2 uv = min(base + ivec2(x, y), size - 1);
+            depth = max(depth, texelFetch(postProcess_depthBuffer, uv, 0).r);
+        }
+    }
+    // encoded as 24-bits fixed point, rounded up so the depth is never underestimated
+    HIGHP uint d = uint(ceil(depth * 16777215.0));
+    return vec4(uvec4(d >> 16u, d >> 8u, d, 255u) & 0xFFu) * (1.0 / 255.0);
+}
+#endif
+
+#if POST_PROCESS_TEMPORAL
+// see TemporalUpscaler
+vec4 PostProcess_TemporalUpscale() {
+    vec4 resolution = frameUniforms.resolution;
+    vec4 temporal = postProcessUniforms.temporal;
+
+    // the current frame was rendered with its projection offset by the jitter
+    HIGHP vec2 jitter = temporal.xy;
+#if defined(TARGET_VULKAN_ENVIRONMENT)
+    jitter.y = -jitter.y;
+#endif
+    HIGHP vec2 p = vertex_uv + jitter;
+    vec4 color = texture(postProcess_colorBuffer, p * resolution.zw * postProcessUniforms.uvScale);
+
+    // the rendered area of the color and depth buffers, in texels
+    ivec2 lo = ivec2(0);
+#if defined(TARGET_VULKAN_ENVIRONMENT)
+    lo.y = int(postProcessUniforms.yOffset);
+#endif
+    ivec2 hi = lo + ivec2(resolution.xy) - 1;
+
+    // the history is clamped to the colors around the pixel, to reject what was disoccluded
+    ivec2 center = ivec2(p);
+    vec4 minColor = color;
+    vec4 maxColor = color;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            vec4 c = texelFetch(postProcess_colorBuffer, clamp(center + ivec2(x, y), lo, hi), 0);
+            minColor = min(minColor, c);
+            maxColor = max(maxColor, c);
+        }
+    }
+
+    // position of the pixel in the clip space of this frame (without the jitter), and of the
+    // previous frame. reprojection uses the OpenGL conventions.
+    HIGHP float depth = texelFetch(postProcess_depthBuffer, clamp(center, lo, hi), 0).r;
+    HIGHP vec2 uv = vertex_uv * resolution.zw;
+#if defined(TARGET_VULKAN_ENVIRONMENT)
+    // the rows are from top to bottom
+    uv.y = 1.0 - (vertex_uv.y - postProcessUniforms.yOffset) * resolution.w;
+#endif
+    HIGHP vec4 previous = postProcessUniforms.reprojection *
+            vec4(uv * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    HIGHP vec2 previousUv = (previous.xy * (1.0 / previous.w)) * 0.5 + 0.5;
+#if defined(TARGET_VULKAN_ENVIRONMENT)
+    previousUv.y = 1.0 - previousUv.y;
+#endif
+
+    float weight = temporal.z;
+    if (any(lessThan(previousUv, vec2(0.0))) || any(greaterThan(previousUv, vec2(1.0)))) {
+        // the pixel was outside of the previous frame
+        weight = 0.0;
+    }
+
+    vec4 history = texture(postProcess_historyBuffer,
+            previousUv * postProcessUniforms.historyUv.xy + postProcessUniforms.historyUv.zw);
+    history = clamp(history, minColor, maxColor);
+    return mix(color, history, weight);
+}
+#endif
+
+#if POST_PROCESS_OIT
+// see FRenderer::OitPass, the premultiplied colors and the alphas of the layers were summed, and
+// their transparencies multiplied
+vec4 PostProcess_OitComposite() {
+    ivec2 uv = ivec2(vertex_uv);
+    vec4 accumulation = texelFetch(postProcess_colorBuffer, uv, 0);
+    float revealage = texelFetch(postProcess_revealageBuffer, uv, 0).r;
+    // the average color of the layers, weighted by their alpha, covers what they don't reveal
+    // of the opaque objects (blended with SRC_ALPHA, ONE_MINUS_SRC_ALPHA)
+    vec3 color = accumulation.rgb / max(accumulation.a, 1e-5);
+    return vec4(color, 1.0 - revealage);
+}
+#endif
+
+#if POST_PROCESS_SHADOW
+// see ShadowAtlas::resolveMoments(), the moments are blurred with a separable binomial filter
+// which doesn't sample outside of the tile
+const int EVSM_BLUR_RADIUS = 2;
+const float EVSM_BLUR_WEIGHTS[5] =
+        float[5](1.0 / 16.0, 4.0 / 16.0, 6.0 / 16.0, 4.0 / 16.0, 1.0 / 16.0);
+
+HIGHP vec4 evsmMoments(const ivec2 uv) {
+    HIGHP vec2 warp = evsmWarp(texelFetch(postProcess_depthBuffer, uv, 0).r);
+    return vec4(warp.x, warp.x * warp.x, warp.y, warp.y * warp.y);
+}
+
+vec4 PostProcess_ShadowMoments() {
+    // the texels of the tile, inclusive
+    ivec4 tile = ivec4(postProcessUniforms.shadowTile);
+#if defined(TARGET_VULKAN_ENVIRONMENT)
+    // the rows are from top to bottom
+#if POST_PROCESS_STAGE == POST_PROCESS_SHADOW_MOMENTS
+    int height = textureSize(postProcess_depthBuffer, 0).y;
+#else
+    int height = textureSize(postProcess_colorBuffer, 0).y;
+#endif
+    tile.yw = height - 1 - tile.wy;
+#endif
+    ivec2 center = ivec2(gl_FragCoord.xy);
+    HIGHP vec4 sum = vec4(0.0);
+    for (int i = -EVSM_BLUR_RADIUS; i <= EVSM_BLUR_RADIUS; i++) {
+        float weight = EVSM_BLUR_WEIGHTS[i + EVSM_BLUR_RADIUS];
+#if POST_PROCESS_STAGE == POST_PROCESS_SHADOW_MOMENTS
+        ivec2 uv = ivec2(clamp(center.x + i, tile.x, tile.z), center.y);
+        sum += weight * evsmMoments(uv);
+#else
+        ivec2 uv = ivec2(center.x, clamp(center.y + i, tile.y, tile.w));
+        sum += weight * texelFetch(postProcess_colorBuffer, uv, 0);
+#endif
+    }
+    return sum;
+}
+#endif
+
 vec4 postProcess() {
-#if POST_PROCESS_TONE_MAPPING
+#if POST_PROCESS_FUSED
+    return PostProcess_Fused();
+#elif POST_PROCESS_TONE_MAPPING
     return PostProcess_ToneMapping();
 #elif POST_PROCESS_ANTI_ALIASING
     return PostProcess_AntiAliasing();
+#elif POST_PROCESS_DEPTH
+    return PostProcess_DepthDownsample();
+#elif POST_PROCESS_TEMPORAL
+    return PostProcess_TemporalUpscale();
+#elif POST_PROCESS_OIT
+    return PostProcess_OitComposite();
+#elif POST_PROCESS_SHADOW
+    return PostProcess_ShadowMoments();
 #endif
 }
 
@@ -142,6 +142,9 @@ vec4 evaluateLights(const MaterialInputs material) {
 #endif
 
 #if defined(HAS_DYNAMIC_LIGHTING)
+#if defined(HAS_SPECIALIZED_DYNAMIC_LIGHTING)
+    if (SPECIALIZATION_DYNAMIC_LIGHTING)
+#endif
     evaluatePunctualLights(pixel, color);
 #endif
 
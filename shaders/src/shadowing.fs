@@ -214,6 +214,27 @@ float ShadowSample_PCF_High(const lowp sampler2DShadow map, const vec2 size, con
 }
 #endif
 
+// Amount of light bleeding removed by ShadowSample_EVSM, in [0, 1)
+#define EVSM_LIGHT_BLEEDING_REDUCTION 0.2
+
+float chebyshevUpperBound(const HIGHP vec2 moments, const HIGHP float mean) {
+    // the variance is clamped to hide the precision issues of the moments
+    HIGHP float variance = max(moments.y - moments.x * moments.x, 1e-4 * mean * mean);
+    HIGHP float d = mean - moments.x;
+    float pMax = variance / (variance + d * d);
+    const float reduction = EVSM_LIGHT_BLEEDING_REDUCTION;
+    pMax = saturate((pMax - reduction) / (1.0 - reduction));
+    return mean <= moments.x ? 1.0 : pMax;
+}
+
+float ShadowSample_EVSM(const HIGHP sampler2D moments, const vec3 position) {
+    // Exponential variance shadow maps, see ShadowAtlas: the moments were filtered once per
+    // texel, a single bilinear fetch filters them at the receiver.
+    HIGHP vec4 m = texture(moments, position.xy);
+    HIGHP vec2 warp = evsmWarp(position.z);
+    return min(chebyshevUpperBound(m.xy, warp.x), chebyshevUpperBound(m.zw, warp.y));
+}
+
 //------------------------------------------------------------------------------
 // Shadow sampling dispatch
 //------------------------------------------------------------------------------
@@ -224,6 +245,9 @@ float ShadowSample_PCF_High(const lowp sampler2DShadow map, const vec2 size, con
  * the light intensity.
  */
 float shadow(const lowp sampler2DShadow shadowMap, const vec3 shadowPosition) {
+    if (frameUniforms.shadowMoments > 0.0) {
+        return ShadowSample_EVSM(light_shadowMoments, shadowPosition);
+    }
     vec2 size = vec2(textureSize(shadowMap, 0));
 #if SHADOW_SAMPLING_METHOD == SHADOW_SAMPLING_HARD
     return ShadowSample_Hard(shadowMap, size, shadowPosition);
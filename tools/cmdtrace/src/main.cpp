@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <utils/Path.h>
+
+#include <getopt/getopt.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <string.h>
+
+using namespace std;
+using namespace utils;
+
+// The format of the traces is described in filament/src/driver/CommandCapture.h
+static constexpr char MAGIC[8] = "FILACMD";
+static constexpr uint32_t VERSION = 1;
+
+static bool g_listCommands = false;
+
+static const char* USAGE = R"TXT(
+CMDTRACE prints statistics about a command stream captured by Filament.
+
+To capture a trace, build Filament with CAPTURE_COMMAND_STREAM set to true (see
+filament/src/driver/CommandStream.h) and set the FILAMENT_COMMAND_CAPTURE environment
+variable to the path of the trace.
+
+Usage:
+    CMDTRACE [options] <trace file>
+
+Options:
+   --help, -h
+       print this message
+   --license
+       print copyright and license information
+   --list, -l
+       print every command, with its duration and the size of its parameters
+)TXT";
+
+static void printUsage(const char* name) {
+    string execName(Path(name).getName());
+    const string from("CMDTRACE");
+    string usage(USAGE);
+    for (size_t pos = usage.find(from); pos != string::npos; pos = usage.find(from, pos)) {
+        usage.replace(pos, from.length(), execName);
+    }
+    puts(usage.c_str());
+}
+
+static void license() {
+    cout <<
+    #include "licenses/licenses.inc"
+    ;
+}
+
+static int handleArguments(int argc, char* argv[]) {
+    static constexpr const char* OPTSTR = "hl";
+    static const struct option OPTIONS[] = {
+            { "help",                 no_argument, 0, 'h' },
+            { "license",              no_argument, 0, 'L' },
+            { "list",                 no_argument, 0, 'l' },
+            { 0, 0, 0, 0 }  // termination of the option list
+    };
+
+    int opt;
+    int optionIndex = 0;
+
+    while ((opt = getopt_long(argc, argv, OPTSTR, OPTIONS, &optionIndex)) >= 0) {
+        switch (opt) {
+            default:
+            case 'h':
+                printUsage(argv[0]);
+                exit(0);
+            case 'L':
+                license();
+                exit(0);
+            case 'l':
+                g_listCommands = true;
+                break;
+        }
+    }
+
+    return optind;
+}
+
+template<typename T>
+static bool read(istream& in, T* v) {
+    return bool(in.read(reinterpret_cast<char*>(v), sizeof(T)));
+}
+
+struct Method {
+    string name;
+    uint64_t count = 0;
+    uint64_t totalTime = 0;   // ns
+    uint32_t maxTime = 0;     // ns
+    uint64_t totalSize = 0;   // bytes
+};
+
+int main(int argc, char* argv[]) {
+    int optionIndex = handleArguments(argc, argv);
+    int numArgs = argc - optionIndex;
+    if (numArgs < 1) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    Path tracePath(argv[optionIndex]);
+    ifstream in(tracePath.getPath(), ios::binary);
+    if (!in) {
+        cerr << "Unable to open trace: " << tracePath.getPath() << endl;
+        return 1;
+    }
+
+    char magic[sizeof(MAGIC)];
+    uint32_t version = 0;
+    uint32_t methodCount = 0;
+    if (!read(in, &magic) || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 ||
+        !read(in, &version) || !read(in, &methodCount)) {
+        cerr << "Not a command stream trace: " << tracePath.getPath() << endl;
+        return 1;
+    }
+    if (version != VERSION) {
+        cerr << "Unsupported trace version " << version << " (expected " << VERSION << ")" << endl;
+        return 1;
+    }
+
+    vector<Method> methods(methodCount);
+    for (Method& method : methods) {
+        uint8_t length = 0;
+        char name[256];
+        if (!read(in, &length) || !in.read(name, length)) {
+            cerr << "Truncated trace header" << endl;
+            return 1;
+        }
+        method.name.assign(name, length);
+    }
+
+    uint64_t commandCount = 0;
+    uint64_t totalTime = 0;
+    vector<char> parameters;
+    while (true) {
+        uint16_t index;
+        uint16_t reserved;
+        uint32_t duration;
+        uint32_t size;
+        if (!read(in, &index)) {
+            break;
+        }
+        if (!read(in, &reserved) || !read(in, &duration) || !read(in, &size) ||
+            index >= methods.size()) {
+            cerr << "Truncated or corrupted trace after " << commandCount << " commands" << endl;
+            break;
+        }
+        parameters.resize(size);
+        if (size && !in.read(parameters.data(), size)) {
+            cerr << "Truncated trace after " << commandCount << " commands" << endl;
+            break;
+        }
+
+        Method& method = methods[index];
+        method.count++;
+        method.totalTime += duration;
+        method.maxTime = std::max(method.maxTime, duration);
+        method.totalSize += size;
+        commandCount++;
+        totalTime += duration;
+
+        if (g_listCommands) {
+            cout << setw(10) << commandCount << "  " << left << setw(32) << method.name << right
+                 << setw(12) << duration << " ns" << setw(10) << size << " bytes" << endl;
+        }
+    }
+
+    // most expensive commands first
+    sort(methods.begin(), methods.end(), [](Method const& lhs, Method const& rhs) {
+        return lhs.totalTime > rhs.totalTime;
+    });
+
+    cout << endl << commandCount << " commands, " << totalTime / 1000 << " us" << endl << endl;
+    cout << left << setw(32) << "command" << right
+         << setw(10) << "count"
+         << setw(12) << "total (us)"
+         << setw(10) << "%"
+         << setw(12) << "avg (ns)"
+         << setw(12) << "max (ns)"
+         << setw(14) << "params (KiB)" << endl;
+    cout << fixed << setprecision(1);
+    for (Method const& method : methods) {
+        if (!method.count) {
+            continue;
+        }
+        cout << left << setw(32) << method.name << right
+             << setw(10) << method.count
+             << setw(12) << method.totalTime / 1000
+             << setw(10) << (totalTime ? 100.0 * method.totalTime / totalTime : 0.0)
+             << setw(12) << method.totalTime / method.count
+             << setw(12) << method.maxTime
+             << setw(14) << method.totalSize / 1024.0 << endl;
+    }
+
+    return 0;
+}
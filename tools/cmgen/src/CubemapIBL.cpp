@@ -98,7 +98,8 @@ static double __UNUSED VisibilityAshikhmin(double NoV, double NoL, double a) {
 }
 
 void CubemapIBL::roughnessFilter(Cubemap& dst,
-        const std::vector<Cubemap>& levels, double linearRoughness, size_t maxNumSamples)
+        const std::vector<Cubemap>& levels, double linearRoughness, size_t maxNumSamples,
+        bool fast)
 {
     const float numSamples = maxNumSamples;
     const float inumSamples = 1.0f / numSamples;
@@ -214,6 +215,23 @@ void CubemapIBL::roughnessFilter(Cubemap& dst,
         return lhs.brdf_NoL < rhs.brdf_NoL;
     });
 
+    // same as above, for the single precision integration
+    struct FastCacheEntry {
+        float3 L;
+        float brdf_NoL;
+        float lerp;
+        uint8_t l0;
+        uint8_t l1;
+    };
+
+    std::vector<FastCacheEntry> fastCache;
+    if (fast) {
+        fastCache.reserve(cache.size());
+        for (CacheEntry const& e : cache) {
+            fastCache.push_back({ float3(e.L), e.brdf_NoL, e.lerp, e.l0, e.l1 });
+        }
+    }
+
     ProgressUpdater updater(1);
     if (!g_quiet) {
         updater.start();
@@ -240,6 +258,31 @@ void CubemapIBL::roughnessFilter(Cubemap& dst,
             return;
         }
 
+        if (fast) {
+            mat3f R;
+            const size_t numSamples = fastCache.size();
+            for (size_t x=0 ; x<dim ; ++x, ++data) {
+                const double2 p(dst.center(x, y));
+                const float3 N(dst.getDirectionFor(f, p.x, p.y));
+
+                const float3 up = std::abs(N.z)<0.999f ? float3(0,0,1) : float3(1,0,0);
+                R[0] = normalize(cross(up, N));
+                R[1] = cross(N, R[0]);
+                R[2] = N;
+
+                float3 Li = 0;
+                for (size_t sample = 0; sample < numSamples; sample++) {
+                    const FastCacheEntry& e = fastCache[sample];
+                    const double3 L(R * e.L);
+                    const float3 c0 = Cubemap::trilinearFilterAt(
+                            levels[e.l0], levels[e.l1], e.lerp, L);
+                    Li += c0 * e.brdf_NoL;
+                }
+                Cubemap::writeAt(data, Cubemap::Texel(Li));
+            }
+            return;
+        }
+
         mat3 R;
         const size_t numSamples = cache.size();
         for (size_t x=0 ; x<dim ; ++x, ++data) {
@@ -29,9 +29,14 @@ class CubemapIBL {
 public:
     /*
      * Compute roughness LOD using importance sampling GGX
+     *
+     * When fast is true, the integration runs in single precision. Combined with a small number
+     * of samples, this relies on the pre-filtered importance sampling to hide the noise and is
+     * meant for previews, the double precision path is the reference.
      */
     static void roughnessFilter(Cubemap& dst,
-            const std::vector<Cubemap>& levels, double linearRoughness, size_t maxNumSamples = 1024);
+            const std::vector<Cubemap>& levels, double linearRoughness, size_t maxNumSamples = 1024,
+            bool fast = false);
 
     static void DFG(Image& dst, bool multiscatter = false);
 
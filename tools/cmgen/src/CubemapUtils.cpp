@@ -42,45 +42,110 @@ void CubemapUtils::clamp(Image& src) {
     }
 }
 
+// Calls sample(x, y) for each texel of a width x height equirectangular image that contributes to
+// the texel (x, y) of face f of dst, and returns how many times it was called.
+template<typename SAMPLE>
+static size_t sampleEquirectangular(const Cubemap& dst, size_t width, size_t height,
+        Cubemap::Face f, size_t x, size_t y, SAMPLE sample) {
+    const double r = width * 0.5 * M_1_PI;
+
+    // calculate how many samples we need based on dx, dy in the source
+    // x =  cos(phi) sin(theta)
+    // y = -sin(phi)
+    // z = -cos(phi) cos(theta)
+    const double3 s0(dst.getDirectionFor(f, x, y));
+    const double t0 = std::atan2(s0.x, -s0.z);
+    const double p0 = std::asin(s0.y);
+    const double3 s1(dst.getDirectionFor(f, x+1, y+1));
+    const double t1 = std::atan2(s1.x, -s1.z);
+    const double p1 = std::asin(s1.y);
+    const double dt = std::abs(t1 - t0);
+    const double dp = std::abs(p1 - p0);
+    const double dx = std::abs(r*dt);
+    const double dy = std::abs(r*dp*s0.y);
+    const size_t numSamples = (size_t const)std::ceil(std::max(dx, dy));
+    const float iNumSamples = 1.0f / numSamples;
+
+    for (size_t i = 0; i < numSamples; i++) {
+        // Generate numSamples in our destination pixels and map them to input pixels
+        const double2 h = hammersley(uint32_t(i), iNumSamples);
+        const double3 s(dst.getDirectionFor(f, x + h.x, y + h.y));
+        float xf = float(std::atan2(s.x, -s.z) * M_1_PI);   // range [-1.0, 1.0]
+        float yf = float(std::asin(-s.y) * (2 * M_1_PI));   // range [-1.0, 1.0]
+        xf = (xf + 1) * 0.5f * (width -1);           // range [0, width [
+        yf = (yf + 1) * 0.5f * (height-1);           // range [0, height[
+        sample((uint32_t)xf, (uint32_t)yf);
+    }
+    return numSamples;
+}
+
 void CubemapUtils::equirectangularToCubemap(Cubemap& dst, const Image& src) {
     const size_t width = src.getWidth();
     const size_t height = src.getHeight();
-    const double r = width * 0.5 * M_1_PI;
 
     process<EmptyState>(dst,
             [&](EmptyState&, size_t y, Cubemap::Face f, Cubemap::Texel* data, size_t dim) {
         for (size_t x=0 ; x<dim ; ++x, ++data) {
-            // calculate how many samples we need based on dx, dy in the source
-            // x =  cos(phi) sin(theta)
-            // y = -sin(phi)
-            // z = -cos(phi) cos(theta)
-            const double3 s0(dst.getDirectionFor(f, x, y));
-            const double t0 = std::atan2(s0.x, -s0.z);
-            const double p0 = std::asin(s0.y);
-            const double3 s1(dst.getDirectionFor(f, x+1, y+1));
-            const double t1 = std::atan2(s1.x, -s1.z);
-            const double p1 = std::asin(s1.y);
-            const double dt = std::abs(t1 - t0);
-            const double dp = std::abs(p1 - p0);
-            const double dx = std::abs(r*dt);
-            const double dy = std::abs(r*dp*s0.y);
-            const size_t numSamples = (size_t const)std::ceil(std::max(dx, dy));
-            const float iNumSamples = 1.0f / numSamples;
-
             float3 c = 0;
-            for (size_t sample = 0; sample < numSamples; sample++) {
-                // Generate numSamples in our destination pixels and map them to input pixels
-                const double2 h = hammersley(uint32_t(sample), iNumSamples);
-                const double3 s(dst.getDirectionFor(f, x + h.x, y + h.y));
-                float xf = float(std::atan2(s.x, -s.z) * M_1_PI);   // range [-1.0, 1.0]
-                float yf = float(std::asin(-s.y) * (2 * M_1_PI));   // range [-1.0, 1.0]
-                xf = (xf + 1) * 0.5f * (width -1);           // range [0, width [
-                yf = (yf + 1) * 0.5f * (height-1);           // range [0, height[
+            const size_t numSamples = sampleEquirectangular(dst, width, height, f, x, y,
+                    [&](uint32_t sx, uint32_t sy) {
                 // we can't use filterAt() here because it reads past the width/height
                 // which is okay for cubmaps but not for square images
-                c += Cubemap::sampleAt(src.getPixelRef((uint32_t)xf, (uint32_t)yf));
-            }
-            c *= iNumSamples;
+                c += Cubemap::sampleAt(src.getPixelRef(sx, sy));
+            });
+            c *= 1.0f / numSamples;
+            Cubemap::writeAt(data, c);
+        }
+    });
+}
+
+CubemapUtils::EquirectangularToCubemap::EquirectangularToCubemap(
+        Cubemap& dst, size_t width, size_t height) : mDst(dst), mRows(height) {
+    const size_t dim = dst.getDimensions();
+    mSums.resize(6 * dim * dim, float3(0));
+    mSampleCounts.resize(6 * dim * dim);
+
+    // Find where the samples of each destination row fall in parallel, then bucket them by
+    // source row.
+    struct RowSample {
+        uint32_t y;
+        Sample sample;
+    };
+    std::vector<std::vector<RowSample>> samples(6 * dim);
+    process<EmptyState>(dst,
+            [&](EmptyState&, size_t y, Cubemap::Face f, Cubemap::Texel*, size_t dim) {
+        std::vector<RowSample>& rowSamples = samples[size_t(f) * dim + y];
+        for (size_t x=0 ; x<dim ; ++x) {
+            const uint32_t texel = uint32_t((size_t(f) * dim + y) * dim + x);
+            mSampleCounts[texel] = uint32_t(sampleEquirectangular(dst, width, height, f, x, y,
+                    [&](uint32_t sx, uint32_t sy) {
+                rowSamples.push_back({ sy, { texel, sx }});
+            }));
+        }
+    });
+    for (std::vector<RowSample>& rowSamples : samples) {
+        for (RowSample const& s : rowSamples) {
+            mRows[s.y].push_back(s.sample);
+        }
+        std::vector<RowSample>().swap(rowSamples);
+    }
+}
+
+void CubemapUtils::EquirectangularToCubemap::addRow(size_t y, float3 const* data) {
+    for (Sample const& s : mRows[y]) {
+        // same clamping as clamp()
+        mSums[s.texel] += min(data[s.x], float3(256.0f));
+    }
+    std::vector<Sample>().swap(mRows[y]);
+}
+
+void CubemapUtils::EquirectangularToCubemap::finish() {
+    process<EmptyState>(mDst,
+            [&](EmptyState&, size_t y, Cubemap::Face f, Cubemap::Texel* data, size_t dim) {
+        for (size_t x=0 ; x<dim ; ++x, ++data) {
+            const size_t texel = (size_t(f) * dim + y) * dim + x;
+            float3 c = mSums[texel];
+            c *= 1.0f / mSampleCounts[texel];
             Cubemap::writeAt(data, c);
         }
     });
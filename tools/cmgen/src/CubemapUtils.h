@@ -19,6 +19,11 @@
 
 #include <utils/JobSystem.h>
 
+#include <algorithm>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
 #include "Cubemap.h"
 #include "Image.h"
 
@@ -49,6 +54,29 @@ public:
     // Convert equirectangular Image to a Cubemap
     static void equirectangularToCubemap(Cubemap& dst, const Image& src);
 
+    // Converts an equirectangular image to a Cubemap as its rows arrive, in any order, so that
+    // the whole image never needs to be in memory. The result is the same as clamp() followed
+    // by equirectangularToCubemap().
+    class EquirectangularToCubemap {
+    public:
+        EquirectangularToCubemap(Cubemap& dst, size_t width, size_t height);
+
+        void addRow(size_t y, math::float3 const* data);
+
+        // Writes the cubemap, once all the rows have been added.
+        void finish();
+
+    private:
+        struct Sample {
+            uint32_t texel;  // index of the destination texel, (face * dim + y) * dim + x
+            uint32_t x;      // column in the source row
+        };
+        Cubemap& mDst;
+        std::vector<std::vector<Sample>> mRows;  // samples that fall in each source row
+        std::vector<math::float3> mSums;
+        std::vector<uint32_t> mSampleCounts;
+    };
+
     // clamp image to acceptable range
     static void clamp(Image& src);
 
@@ -92,48 +120,60 @@ void CubemapUtils::process( const Cubemap& cm,
 
     const size_t dim = cm.getDimensions();
 
-    // multithread only on large-ish cubemaps
-    STATE states[6];
-    for (STATE& s : states) {
-        s = prototype;
+    // Stateful passes split each face in bands of rows, each with its own STATE, so that they
+    // can run in parallel too. The bands don't depend on the number of threads and are reduced
+    // in order, so the result is always the same.
+    constexpr size_t BANDS_PER_FACE = 8;
+    const bool stateless = std::is_same<STATE, CubemapUtils::EmptyState>::value;
+    const size_t bandCount = stateless ? 1 : std::min(dim, BANDS_PER_FACE);
+    std::unique_ptr<STATE[]> states(new STATE[6 * bandCount]);
+    for (size_t i = 0; i < 6 * bandCount; i++) {
+        states[i] = prototype;
     }
 
     JobSystem::Job* parent = js.createJob();
     for (size_t faceIndex = 0; faceIndex < 6; faceIndex++) {
         const Cubemap::Face f = (Cubemap::Face)faceIndex;
-        JobSystem::Job* face = jobs::createJob(js, parent,
-                [ faceIndex, &states, f, &cm, &dim, &proc ]
-                        (utils::JobSystem& js, utils::JobSystem::Job* parent) {
-                    STATE& s = states[faceIndex];
-                    const Image& image(cm.getImageForFace(f));
-
-                    auto parallelJobTask = [ &image, &proc, &s, dim, f ](size_t y0, size_t c) {
-                        for (size_t y = y0; y < y0 + c; y++) {
-                            Cubemap::Texel* data =
-                                    static_cast<Cubemap::Texel*>(image.getPixelRef(0, y));
-                            proc(s, y, f, data, dim);
-                        }
-                    };
-
-                    if (std::is_same<STATE, CubemapUtils::EmptyState>::value) {
+        const Image& image(cm.getImageForFace(f));
+
+        auto processRows = [ &image, &proc, dim, f ](STATE& s, size_t y0, size_t c) {
+            for (size_t y = y0; y < y0 + c; y++) {
+                Cubemap::Texel* data = static_cast<Cubemap::Texel*>(image.getPixelRef(0, y));
+                proc(s, y, f, data, dim);
+            }
+        };
+
+        if (stateless) {
+            STATE& s = states[faceIndex];
+            JobSystem::Job* face = jobs::createJob(js, parent,
+                    [ &s, processRows, dim ](utils::JobSystem& js, utils::JobSystem::Job* parent) {
+                        auto parallelJobTask = [ &s, &processRows ](size_t y0, size_t c) {
+                            processRows(s, y0, c);
+                        };
                         auto job = jobs::parallel_for(js, parent, 0, uint32_t(dim),
                                 std::ref(parallelJobTask), jobs::CountSplitter<1, 8>());
 
                         // we need to wait here because parallelJobTask is passed by reference
                         js.runAndWait(job);
-                    } else {
-                        // if we have a per-thread STATE, we can't parallel_for()
-                        parallelJobTask(0, dim);
-                    }
-                }, std::ref(js), parent);
-        js.run(face);
+                    }, std::ref(js), parent);
+            js.run(face);
+        } else {
+            for (size_t band = 0; band < bandCount; band++) {
+                const size_t y0 = dim * band / bandCount;
+                const size_t y1 = dim * (band + 1) / bandCount;
+                STATE& s = states[faceIndex * bandCount + band];
+                js.run(jobs::createJob(js, parent, [ &s, processRows, y0, y1 ]() {
+                    processRows(s, y0, y1 - y0);
+                }));
+            }
+        }
     }
     // wait for all our threads to finish
     js.runAndWait(parent);
     js.reset();
 
-    for (STATE& s : states) {
-        reduce(s);
+    for (size_t i = 0; i < 6 * bandCount; i++) {
+        reduce(states[i]);
     }
 }
 
@@ -20,6 +20,8 @@
 #include <fstream>
 
 #include <iomanip>
+#include <memory>
+#include <vector>
 
 #include <math/scalar.h>
 #include <math/vec4.h>
@@ -27,6 +29,7 @@
 #include <imageio/ImageDecoder.h>
 #include <imageio/ImageEncoder.h>
 
+#include <utils/JobSystem.h>
 #include <utils/Path.h>
 
 #include <getopt/getopt.h>
@@ -42,6 +45,43 @@ using namespace image;
 
 // -----------------------------------------------------------------------------------------------
 
+// Receives the rows of the input image as they're decoded. Equirectangular images are converted
+// to a cubemap right away, so that they never need to be entirely in memory. Other images are
+// kept whole.
+class InputImageHandler : public ImageDecoder::RowHandler {
+public:
+    size_t width = 0;
+    size_t height = 0;
+    size_t channels = 0;
+
+    Image image;
+
+    Image cubemapImage;
+    std::unique_ptr<Cubemap> cubemap;
+    std::unique_ptr<CubemapUtils::EquirectangularToCubemap> equirectangular;
+
+    bool begin(uint32_t w, uint32_t h, uint32_t c) override;
+    void row(uint32_t y, float const* data) override;
+};
+
+// An environment given on the command line, with the base level of its cubemap once it's loaded.
+struct Environment {
+    explicit Environment(const char* name) : iname(name) { }
+
+    utils::Path iname;
+
+    // Images store the actual data
+    std::vector<Image> images;
+
+    // Cubemaps are just views on Images
+    std::vector<Cubemap> levels;
+
+    // cmgen exits with this code when the environment can't be loaded
+    int exitCode = -1;
+};
+
+// -----------------------------------------------------------------------------------------------
+
 enum class ShFile {
     SH_NONE, SH_CROSS, SH_TEXT
 };
@@ -74,12 +114,19 @@ static bool g_dfg_multiscatter = false;
 static bool g_deploy = false;
 static utils::Path g_deploy_dir;
 
-static size_t g_num_samples = 1024;
+static size_t g_num_samples = 0;    // 0 means the default of the integrator
+static bool g_ibl_fast = false;
 
 static bool g_mirror = false;
 
+// the images are encoded and written by the children of this job, see saveImage()
+static utils::JobSystem::Job* g_encoding = nullptr;
+
 // -----------------------------------------------------------------------------------------------
 
+static utils::JobSystem::Job* startLoading(utils::JobSystem& js, Environment& env);
+static void loadEnvironment(Environment& env);
+static void processEnvironment(Environment& env);
 static void generateMipmaps(std::vector<Cubemap>& levels, std::vector<Image>& images);
 static void sphericalHarmonics(const utils::Path& iname, const Cubemap& inputCubemap);
 static void iblRoughnessPrefilter(const utils::Path& iname, const std::vector<Cubemap>& levels,
@@ -104,9 +151,11 @@ static void printUsage(char* name) {
             "CMGEN is a command-line tool for generating SH and mipmap levels from an env map.\n"
             "Cubemaps and equirectangular formats are both supported, automatically detected \n"
             "according to the aspect ratio of the source image.\n"
+            "Several input files are processed one after the other, the next one being\n"
+            "decoded and the previous one being written while one is filtered.\n"
             "\n"
             "Usages:\n"
-            "    CMGEN [options] <input-file>\n"
+            "    CMGEN [options] <input-file> [<input-file>...]\n"
             "    CMGEN [options] <uv[N]>\n"
             "\n"
             "Supported input formats:\n"
@@ -122,7 +171,7 @@ static void printUsage(char* name) {
             "       Print copyright and license information\n\n"
             "   --quiet, -q\n"
             "       Quiet mode. Suppress all non-error output\n\n"
-            "   --format=[exr|hdr|psd|rgbm|png|dds], -f [exr|hdr|psd|rgbm|png|dds]\n"
+            "   --format=[exr|hdr|psd|rgbm|png|dds|ktx], -f [exr|hdr|psd|rgbm|png|dds|ktx]\n"
             "       specify output file format\n\n"
             "   --compression=COMPRESSION, -c COMPRESSION\n"
             "       format specific compression:\n"
@@ -131,7 +180,8 @@ static void printUsage(char* name) {
             "           Radiance: Ignored\n"
             "           Photoshop: 16 (default), 32\n"
             "           OpenEXR: RAW, RLE, ZIPS, ZIP, PIZ (default)\n"
-            "           DDS: 8, 16 (default), 32\n\n"
+            "           DDS: 8, 16 (default), 32\n"
+            "           KTX: etc2 (default), dxt1\n\n"
             "   --size=power-of-two, -s power-of-two\n"
             "       size of the output cubemaps (base level), 256 by default\n\n"
             "   --deploy=dir, -x dir\n"
@@ -143,7 +193,9 @@ static void printUsage(char* name) {
             "   --mirror\n"
             "       Mirrors generated cubemaps for reflections\n\n"
             "   --ibl-samples=numSamples\n"
-            "       Number of samples to use for IBL integrations (default 1024)\n\n"
+            "       Number of samples to use for IBL integrations (default 1024, 64 with --ibl-fast)\n\n"
+            "   --ibl-fast\n"
+            "       Fast, lower quality IBL integration in single precision, for previews\n\n"
             "\n"
             "Private use only:\n"
             "   --ibl-dfg=filename.[exr|hdr|psd|png|rgbm|dds|h|hpp|c|cpp|inc|txt]\n"
@@ -198,6 +250,7 @@ static int handleCommandLineArgments(int argc, char* argv[]) {
             { "ibl-dfg",              required_argument, nullptr, 'a' },
             { "ibl-dfg-multiscatter",       no_argument, nullptr, 'u' },
             { "ibl-samples",          required_argument, nullptr, 'k' },
+            { "ibl-fast",                   no_argument, nullptr, 'F' },
             { "deploy",               required_argument, nullptr, 'x' },
             { "mirror",                     no_argument, nullptr, 'm' },
             { "debug",                      no_argument, nullptr, 'd' },
@@ -247,6 +300,10 @@ static int handleCommandLineArgments(int argc, char* argv[]) {
                     g_format = ImageEncoder::Format::DDS_LINEAR;
                     format_specified = true;
                 }
+                if (arg == "ktx") {
+                    g_format = ImageEncoder::Format::KTX;
+                    format_specified = true;
+                }
                 break;
             case 'c':
                 g_compression = arg;
@@ -315,6 +372,9 @@ static int handleCommandLineArgments(int argc, char* argv[]) {
             case 'k':
                 g_num_samples = (size_t)std::stoi(arg);
                 break;
+            case 'F':
+                g_ibl_fast = true;
+                break;
             case 'x':
                 g_deploy = true;
                 g_deploy_dir = arg;
@@ -328,6 +388,11 @@ static int handleCommandLineArgments(int argc, char* argv[]) {
         }
     }
 
+    if (!g_num_samples) {
+        // the pre-filtered importance sampling hides the noise of fewer samples well enough
+        g_num_samples = g_ibl_fast ? 64 : 1024;
+    }
+
     if (g_deploy && !format_specified) {
         g_format = ImageEncoder::Format::RGBM;
     }
@@ -338,6 +403,37 @@ static int handleCommandLineArgments(int argc, char* argv[]) {
     return optind;
 }
 
+bool InputImageHandler::begin(uint32_t w, uint32_t h, uint32_t c) {
+    width = w;
+    height = h;
+    channels = c;
+    if (channels != 3) {
+        return false;
+    }
+    if (width == 2 * height) {
+        // we assume a spherical (equirectangular) image, which we will convert to a cross image
+        size_t dim = g_output_size ? g_output_size : 256;
+        if (!g_quiet) {
+            std::cout << "Converting equirectangular image... " << std::endl;
+        }
+        cubemap.reset(new Cubemap(CubemapUtils::create(cubemapImage, dim)));
+        equirectangular.reset(new CubemapUtils::EquirectangularToCubemap(*cubemap, width, height));
+    } else {
+        const size_t bpp = sizeof(float3), bpr = bpp * width;
+        std::unique_ptr<uint8_t[]> buf(new uint8_t[height * bpr]);
+        image = Image(std::move(buf), width, height, bpr, bpp);
+    }
+    return true;
+}
+
+void InputImageHandler::row(uint32_t y, float const* data) {
+    if (equirectangular) {
+        equirectangular->addRow(y, reinterpret_cast<float3 const*>(data));
+    } else {
+        memcpy(image.getPixelRef(0, y), data, width * sizeof(float3));
+    }
+}
+
 int main(int argc, char* argv[]) {
     int option_index = handleCommandLineArgments(argc, argv);
     int num_args = argc - option_index;
@@ -346,80 +442,100 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    utils::JobSystem& js = CubemapUtils::getJobSystem();
+    g_encoding = js.createJob();
+
     if (g_dfg) {
         if (!g_quiet) {
             std::cout << "Generating IBL DFG LUT..." << std::endl;
         }
         size_t size = g_output_size ? g_output_size : 128;
         iblLutDfg(g_dfg_filename, size, g_dfg_multiscatter);
-        if (num_args < 1) return 0;
+        if (num_args < 1) {
+            js.runAndWait(g_encoding);
+            return 0;
+        }
     }
 
-    std::string command(argv[option_index]);
-    utils::Path iname(command);
-
-    if (g_deploy) {
-        utils::Path out_dir = g_deploy_dir + iname.getNameWithoutExtension();
+    // The environments are pipelined: the next one is loaded while the current one is
+    // filtered, and the images of the previous one are encoded in the background. The encoding
+    // jobs of each environment have their own parent, since a job can only have so many children.
+    utils::JobSystem::Job* encoded = js.createJob();
+    std::unique_ptr<Environment> env(new Environment(argv[option_index]));
+    utils::JobSystem::Job* loading = startLoading(js, *env);
+    for (int i = option_index; i < argc; i++) {
+        js.runAndWait(loading);
+        if (env->exitCode >= 0) {
+            js.runAndWait(encoded);
+            js.runAndWait(g_encoding);
+            return env->exitCode;
+        }
 
-        // generate pre-scaled irradiance sh to text file
-        g_sh_compute = 3;
-        g_sh_shader = true;
-        g_sh_irradiance = true;
-        g_sh_filename = out_dir + "sh.txt";
-        g_sh_file = ShFile::SH_TEXT;
-        g_sh_output = true;
+        std::unique_ptr<Environment> next;
+        if (i + 1 < argc) {
+            next.reset(new Environment(argv[i + 1]));
+            loading = startLoading(js, *next);
+        }
 
-        // faces
-        g_extract_dir = g_deploy_dir;
-        g_extract_faces = true;
+        processEnvironment(*env);
+        env = std::move(next);
 
-        // prefilter
-        g_prefilter = true;
-        g_prefilter_dir = g_deploy_dir;
+        js.runAndWait(encoded);
+        encoded = g_encoding;
+        g_encoding = js.createJob();
     }
 
-    if (g_debug) {
-        if (g_prefilter && !g_is_mipmap) {
-            g_is_mipmap = true;
-            g_is_mipmap_dir = g_prefilter_dir;
-        }
-    }
+    // wait for the last images to be written
+    js.runAndWait(encoded);
+    js.runAndWait(g_encoding);
+    return 0;
+}
 
-    // Images store the actual data
-    std::vector<Image> images;
+utils::JobSystem::Job* startLoading(utils::JobSystem& js, Environment& env) {
+    // the loading job is the child of a job that only runs when it's waited on, which keeps the
+    // job alive until then
+    utils::JobSystem::Job* loading = js.createJob();
+    js.run(utils::jobs::createJob(js, loading, [&env]() {
+        loadEnvironment(env);
+    }));
+    return loading;
+}
 
-    // Cubemaps are just views on Images
-    std::vector<Cubemap> levels;
+void loadEnvironment(Environment& env) {
+    const utils::Path& iname = env.iname;
 
     if (iname.exists()) {
         if (!g_quiet) {
             std::cout << "Decoding image..." << std::endl;
         }
         std::ifstream input_stream(iname.getPath(), std::ios::binary);
-        LinearImage linputImage = ImageDecoder::decode(input_stream, iname.getPath());
-        if (!linputImage.isValid()) {
-            std::cerr << "Unable to open image: " << iname.getPath() << std::endl;
-            exit(1);
-        }
-        if (linputImage.getChannels() != 3) {
+        InputImageHandler handler;
+        const bool decoded = ImageDecoder::decode(input_stream, iname.getPath(), handler);
+        if (handler.channels != 0 && handler.channels != 3) {
             std::cerr << "Input image must be RGB (3 channels)! This image has "
-                      << linputImage.getChannels() << " channels." << std::endl;
-            exit(1);
+                      << handler.channels << " channels." << std::endl;
+            env.exitCode = 1;
+            return;
         }
-
-        // Convert from LinearImage to the deprecated Image object which is used throughout cmgen.
-        std::unique_ptr<uint8_t[]> buf(new uint8_t[
-                linputImage.getWidth() * linputImage.getHeight() * sizeof(float3)]);
-        const size_t width = linputImage.getWidth(), height = linputImage.getHeight();
-        const size_t bpp = sizeof(float) * 3, bpr = bpp * width;
-        memcpy(buf.get(), linputImage.getPixelRef(), height * bpr);
-        Image inputImage(std::move(buf), width, height, bpr, bpp);
-
-        CubemapUtils::clamp(inputImage);
-
-        if ((isPOT(width) && (width * 3 == height * 4)) ||
+        if (!decoded) {
+            std::cerr << "Unable to open image: " << iname.getPath() << std::endl;
+            env.exitCode = 1;
+            return;
+        }
+        const size_t width = handler.width, height = handler.height;
+
+        if (handler.equirectangular) {
+            // the equirectangular image was converted to a cubemap while it was decoded
+            handler.equirectangular->finish();
+            handler.cubemap->makeSeamless();
+            env.images.push_back(std::move(handler.cubemapImage));
+            env.levels.push_back(std::move(*handler.cubemap));
+        } else if ((isPOT(width) && (width * 3 == height * 4)) ||
             (isPOT(height) && (height * 3 == width * 4))) {
             // This is cross cubemap
+            Image& inputImage = handler.image;
+            CubemapUtils::clamp(inputImage);
+
             const bool isHorizontal = width > height;
             size_t dim = std::max(height, width) / 4;
             if (!g_quiet) {
@@ -430,27 +546,16 @@ int main(int argc, char* argv[]) {
             Cubemap cml = CubemapUtils::create(temp, dim, isHorizontal);
             CubemapUtils::copyImage(temp, inputImage);
             cml.makeSeamless();
-            images.push_back(std::move(temp));
-            levels.push_back(std::move(cml));
-        } else if (width == 2 * height) {
-            // we assume a spherical (equirectangular) image, which we will convert to a cross image
-            size_t dim = g_output_size ? g_output_size : 256;
-            if (!g_quiet) {
-                std::cout << "Converting equirectangular image... " << std::endl;
-            }
-            Image temp;
-            Cubemap cml = CubemapUtils::create(temp, dim);
-            CubemapUtils::equirectangularToCubemap(cml, inputImage);
-            cml.makeSeamless();
-            images.push_back(std::move(temp));
-            levels.push_back(std::move(cml));
+            env.images.push_back(std::move(temp));
+            env.levels.push_back(std::move(cml));
         } else {
             std::cerr << "Aspect ratio not supported: " << width << "x" << height << std::endl;
             std::cerr << "Supported aspect ratios:" << std::endl;
             std::cerr << "  2:1, lat/long or equirectangular" << std::endl;
             std::cerr << "  3:4, vertical cross (height must be power of two)" << std::endl;
             std::cerr << "  4:3, horizontal cross (width must be power of two)" << std::endl;
-            exit(0);
+            env.exitCode = 0;
+            return;
         }
     } else {
         if (!g_quiet) {
@@ -473,8 +578,41 @@ int main(int argc, char* argv[]) {
         }
 
         cml.makeSeamless();
-        images.push_back(std::move(temp));
-        levels.push_back(std::move(cml));
+        env.images.push_back(std::move(temp));
+        env.levels.push_back(std::move(cml));
+    }
+}
+
+void processEnvironment(Environment& env) {
+    const utils::Path& iname = env.iname;
+    std::vector<Image>& images = env.images;
+    std::vector<Cubemap>& levels = env.levels;
+
+    if (g_deploy) {
+        utils::Path out_dir = g_deploy_dir + iname.getNameWithoutExtension();
+
+        // generate pre-scaled irradiance sh to text file
+        g_sh_compute = 3;
+        g_sh_shader = true;
+        g_sh_irradiance = true;
+        g_sh_filename = out_dir + "sh.txt";
+        g_sh_file = ShFile::SH_TEXT;
+        g_sh_output = true;
+
+        // faces
+        g_extract_dir = g_deploy_dir;
+        g_extract_faces = true;
+
+        // prefilter
+        g_prefilter = true;
+        g_prefilter_dir = g_deploy_dir;
+    }
+
+    if (g_debug) {
+        if (g_prefilter && !g_is_mipmap) {
+            g_is_mipmap = true;
+            g_is_mipmap_dir = g_prefilter_dir;
+        }
     }
 
     // Now generate all the mipmap levels
@@ -534,7 +672,8 @@ int main(int argc, char* argv[]) {
             const size_t dim = g_output_size ? g_output_size : cm.getDimensions();
             Image image;
             Cubemap blurred = CubemapUtils::create(image, dim);
-            CubemapIBL::roughnessFilter(blurred, levels, linear_roughness, g_num_samples);
+            CubemapIBL::roughnessFilter(blurred, levels, linear_roughness, g_num_samples,
+                    g_ibl_fast);
             if (!g_quiet) {
                 std::cout << "Extract faces..." << std::endl;
             }
@@ -546,8 +685,6 @@ int main(int argc, char* argv[]) {
             extractCubemapFaces(iname, cm, g_extract_dir);
         }
     }
-
-    return 0;
 }
 
 void generateMipmaps(std::vector<Cubemap>& levels, std::vector<Image>& images) {
@@ -727,7 +864,7 @@ void iblRoughnessPrefilter(const utils::Path& iname,
         }
         Image image;
         Cubemap dst = CubemapUtils::create(image, dim);
-        CubemapIBL::roughnessFilter(dst, levels, linear_roughness, numSamples);
+        CubemapIBL::roughnessFilter(dst, levels, linear_roughness, numSamples, g_ibl_fast);
 
         if (g_debug) {
             ImageEncoder::Format debug_format = ImageEncoder::Format::PNG;
@@ -816,7 +953,6 @@ void extractCubemapFaces(const utils::Path& iname, const Cubemap& cm, const util
 
 static void saveImage(const std::string& path, ImageEncoder::Format format, const Image& image,
         const std::string& compression) {
-    std::ofstream outputStream(path, std::ios::binary | std::ios::trunc);
     LinearImage linearImage(image.getWidth(), image.getHeight(), 3);
 
     // Copy row by row since the image has padding.
@@ -828,5 +964,7 @@ static void saveImage(const std::string& path, ImageEncoder::Format format, cons
         memcpy(dst, src, w * 12);
     }
 
-    ImageEncoder::encode(outputStream, format, linearImage, compression, path);
+    // the copy is encoded in the background, while the caller computes the next image
+    ImageEncoder::encode(CubemapUtils::getJobSystem(), g_encoding, path, format, linearImage,
+            compression);
 }
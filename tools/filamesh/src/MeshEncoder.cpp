@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MeshEncoder.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace math;
+
+namespace {
+
+std::vector<uint8_t> deflate(std::vector<uint8_t> const& data) {
+    uLongf size = compressBound(uLong(data.size()));
+    std::vector<uint8_t> result(size);
+    compress2(result.data(), &size, data.data(), uLong(data.size()), Z_BEST_COMPRESSION);
+    result.resize(size);
+    return result;
+}
+
+inline uint16_t zigzag(int16_t v) {
+    return uint16_t((uint16_t(v) << 1u) ^ uint16_t(v >> 15));
+}
+
+// Stores count elements of N 16-bit words as the difference with the previous element, and
+// splits the bytes in planes (all the low bytes of word 0, all the high bytes of word 0, etc.),
+// which compresses a lot better than the raw interleaved data.
+template<size_t N>
+std::vector<uint8_t> encodeDeltas(uint16_t const* words, size_t count) {
+    std::vector<uint8_t> planes(count * N * 2);
+    for (size_t c = 0; c < N; c++) {
+        uint8_t* lo = planes.data() + count * c * 2;
+        uint8_t* hi = lo + count;
+        uint16_t previous = 0;
+        for (size_t i = 0; i < count; i++) {
+            const uint16_t w = words[i * N + c];
+            const uint16_t z = zigzag(int16_t(uint16_t(w - previous)));
+            lo[i] = uint8_t(z);
+            hi[i] = uint8_t(z >> 8u);
+            previous = w;
+        }
+    }
+    return planes;
+}
+
+template<size_t N>
+std::vector<uint8_t> encodePlanes(uint8_t const* bytes, size_t count) {
+    std::vector<uint8_t> planes(count * N);
+    for (size_t b = 0; b < N; b++) {
+        for (size_t i = 0; i < count; i++) {
+            planes[b * count + i] = bytes[i * N + b];
+        }
+    }
+    return planes;
+}
+
+} // anonymous namespace
+
+void MeshEncoder::computeQuantization(half4 const* positions, size_t count,
+        float3& origin, float3& scale) {
+    float3 bmin(std::numeric_limits<float>::max());
+    float3 bmax(std::numeric_limits<float>::lowest());
+    for (size_t i = 0; i < count; i++) {
+        const float3 p{ float(positions[i].x), float(positions[i].y), float(positions[i].z) };
+        bmin = min(bmin, p);
+        bmax = max(bmax, p);
+    }
+    if (count == 0) {
+        bmin = bmax = 0;
+    }
+    origin = bmin;
+    scale = (bmax - bmin) / 65535.0f;
+    for (size_t c = 0; c < 3; c++) {
+        if (scale[c] == 0) {
+            scale[c] = 1;
+        }
+    }
+}
+
+std::vector<uint8_t> MeshEncoder::encodePositions(half4 const* positions, size_t count,
+        float3 origin, float3 scale) {
+    std::vector<uint16_t> words(count * 3);
+    for (size_t i = 0; i < count; i++) {
+        for (size_t c = 0; c < 3; c++) {
+            const float q = std::round((float(positions[i][c]) - origin[c]) / scale[c]);
+            words[i * 3 + c] = uint16_t(std::min(std::max(q, 0.0f), 65535.0f));
+        }
+    }
+    return deflate(encodeDeltas<3>(words.data(), count));
+}
+
+std::vector<uint8_t> MeshEncoder::encodeTangents(short4 const* tangents, size_t count) {
+    // the three smallest components of a unit quaternion are in [-1/sqrt(2), 1/sqrt(2)]
+    const float sqrt2 = std::sqrt(2.0f);
+    std::vector<uint32_t> packed(count);
+    for (size_t i = 0; i < count; i++) {
+        float4 q = float4(tangents[i]) / 32767.0f;
+        // the sign of w is the handedness of the tangent frame, it must be preserved
+        const bool reflection = q.w < 0;
+        size_t largest = 0;
+        for (size_t c = 1; c < 4; c++) {
+            if (std::abs(q[c]) > std::abs(q[largest])) {
+                largest = c;
+            }
+        }
+        if (q[largest] < 0) {
+            q = -q;
+        }
+        uint32_t bits = uint32_t(largest) << 27u | uint32_t(reflection) << 29u;
+        for (size_t c = 0, k = 0; c < 4; c++) {
+            if (c != largest) {
+                const float u = std::round((q[c] * sqrt2 + 1.0f) * 0.5f * 511.0f);
+                bits |= uint32_t(std::min(std::max(u, 0.0f), 511.0f)) << (k * 9u);
+                k++;
+            }
+        }
+        packed[i] = bits;
+    }
+    return deflate(encodePlanes<4>(reinterpret_cast<uint8_t const*>(packed.data()), count));
+}
+
+std::vector<uint8_t> MeshEncoder::encodeColors(ubyte4 const* colors, size_t count) {
+    return deflate(encodePlanes<4>(reinterpret_cast<uint8_t const*>(colors), count));
+}
+
+std::vector<uint8_t> MeshEncoder::encodeUVs(half2 const* uvs, size_t count) {
+    std::vector<uint16_t> words(count * 2);
+    for (size_t i = 0; i < count; i++) {
+        words[i * 2 + 0] = getBits(uvs[i].x);
+        words[i * 2 + 1] = getBits(uvs[i].y);
+    }
+    return deflate(encodeDeltas<2>(words.data(), count));
+}
+
+std::vector<uint8_t> MeshEncoder::encodeIndices(uint32_t const* indices, size_t count) {
+    // zigzag-encoded difference with the previous index, as a LEB128 varint
+    std::vector<uint8_t> bytes;
+    bytes.reserve(count * 2);
+    uint32_t previous = 0;
+    for (size_t i = 0; i < count; i++) {
+        const int32_t delta = int32_t(indices[i] - previous);
+        uint32_t z = (uint32_t(delta) << 1u) ^ uint32_t(delta >> 31);
+        while (z >= 0x80) {
+            bytes.push_back(uint8_t(z | 0x80u));
+            z >>= 7u;
+        }
+        bytes.push_back(uint8_t(z));
+        previous = indices[i];
+    }
+    return deflate(bytes);
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMESH_MESHENCODER_H
+#define TNT_FILAMESH_MESHENCODER_H
+
+#include <math/half.h>
+#include <math/vec2.h>
+#include <math/vec3.h>
+#include <math/vec4.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+/*
+ * Encodes the streams of the compressed mesh format (see README.md). Each function returns the
+ * zlib-compressed stream. The decoder is filamesh::MeshDecoder in libs/filameshio.
+ */
+class MeshEncoder {
+public:
+    // positions are quantized to 16 bits per component: p = origin + q * scale
+    static void computeQuantization(math::half4 const* positions, size_t count,
+            math::float3& origin, math::float3& scale);
+
+    static std::vector<uint8_t> encodePositions(math::half4 const* positions, size_t count,
+            math::float3 origin, math::float3 scale);
+
+    // tangent frame quaternions, stored as their three smallest components in 32 bits
+    static std::vector<uint8_t> encodeTangents(math::short4 const* tangents, size_t count);
+
+    static std::vector<uint8_t> encodeColors(math::ubyte4 const* colors, size_t count);
+
+    static std::vector<uint8_t> encodeUVs(math::half2 const* uvs, size_t count);
+
+    static std::vector<uint8_t> encodeIndices(uint32_t const* indices, size_t count);
+};
+
+#endif // TNT_FILAMESH_MESHENCODER_H
@@ -0,0 +1,470 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace math;
+
+namespace {
+
+// Sum of the squared distances to a set of planes: Q(p) = p.A.p + 2 b.p + c, A is symmetric
+struct Quadric {
+    double a00 = 0, a01 = 0, a02 = 0, a11 = 0, a12 = 0, a22 = 0;
+    double b0 = 0, b1 = 0, b2 = 0;
+    double c = 0;
+
+    // plane n.p + d = 0, n must be normalized
+    static Quadric fromPlane(double3 const& n, double d, double weight) {
+        Quadric q;
+        q.a00 = weight * n.x * n.x; q.a01 = weight * n.x * n.y; q.a02 = weight * n.x * n.z;
+        q.a11 = weight * n.y * n.y; q.a12 = weight * n.y * n.z; q.a22 = weight * n.z * n.z;
+        q.b0 = weight * n.x * d; q.b1 = weight * n.y * d; q.b2 = weight * n.z * d;
+        q.c = weight * d * d;
+        return q;
+    }
+
+    Quadric& operator+=(Quadric const& rhs) {
+        a00 += rhs.a00; a01 += rhs.a01; a02 += rhs.a02;
+        a11 += rhs.a11; a12 += rhs.a12; a22 += rhs.a22;
+        b0 += rhs.b0; b1 += rhs.b1; b2 += rhs.b2;
+        c += rhs.c;
+        return *this;
+    }
+
+    double error(double3 const& p) const {
+        const double x = p.x, y = p.y, z = p.z;
+        const double pap = a00 * x * x + a11 * y * y + a22 * z * z +
+                2 * (a01 * x * y + a02 * x * z + a12 * y * z);
+        return std::abs(pap + 2 * (b0 * x + b1 * y + b2 * z) + c);
+    }
+};
+
+} // anonymous namespace
+
+void MeshOptimizer::optimizeVertexCache(uint32_t* indices, size_t indexCount,
+        size_t vertexCount, std::vector<uint32_t>* clusters) {
+    const size_t triangleCount = indexCount / 3;
+    if (clusters) {
+        clusters->clear();
+    }
+    if (triangleCount == 0) {
+        return;
+    }
+
+    // vertex -> triangles adjacency, stored as a compressed list
+    std::vector<uint32_t> liveTriangles(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; i++) {
+        liveTriangles[indices[i]]++;
+    }
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++) {
+        adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+    }
+    std::vector<uint32_t> adjacency(adjacencyOffsets[vertexCount]);
+    {
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; i++) {
+            adjacency[fill[indices[i]]++] = uint32_t(i / 3);
+        }
+    }
+
+    const uint32_t cacheSize = CACHE_SIZE;
+    std::vector<uint32_t> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32_t> deadEnd;
+    std::vector<uint32_t> candidates;
+    std::vector<uint32_t> result;
+    result.reserve(triangleCount * 3);
+
+    uint32_t time = cacheSize + 1;
+    size_t cursor = 0;
+    int64_t fanningVertex = 0;
+    bool newCluster = true;
+
+    while (fanningVertex >= 0) {
+        const uint32_t f = uint32_t(fanningVertex);
+        if (newCluster && clusters) {
+            clusters->push_back(uint32_t(result.size() / 3));
+        }
+
+        // emit all the remaining triangles around the fanning vertex
+        candidates.clear();
+        for (uint32_t a = adjacencyOffsets[f], e = adjacencyOffsets[f + 1]; a < e; a++) {
+            const uint32_t t = adjacency[a];
+            if (emitted[t]) {
+                continue;
+            }
+            for (size_t k = 0; k < 3; k++) {
+                const uint32_t v = indices[t * 3 + k];
+                result.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                liveTriangles[v]--;
+                if (time - cacheTime[v] > cacheSize) {
+                    cacheTime[v] = time++;
+                }
+            }
+            emitted[t] = true;
+        }
+
+        // pick the candidate that's the most likely to still be in the cache after its
+        // remaining triangles are emitted
+        fanningVertex = -1;
+        int64_t bestPriority = -1;
+        for (uint32_t v : candidates) {
+            if (liveTriangles[v] > 0) {
+                int64_t priority = 0;
+                if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize) {
+                    priority = time - cacheTime[v];
+                }
+                if (priority > bestPriority) {
+                    bestPriority = priority;
+                    fanningVertex = v;
+                }
+            }
+        }
+
+        // dead-end: go back to a recently used vertex, or to the next vertex in input order.
+        // This breaks the locality of the sequence, so it's where a new cluster starts.
+        newCluster = fanningVertex < 0;
+        while (fanningVertex < 0 && !deadEnd.empty()) {
+            const uint32_t v = deadEnd.back();
+            deadEnd.pop_back();
+            if (liveTriangles[v] > 0) {
+                fanningVertex = v;
+            }
+        }
+        while (fanningVertex < 0 && cursor < vertexCount) {
+            if (liveTriangles[cursor] > 0) {
+                fanningVertex = int64_t(cursor);
+            }
+            cursor++;
+        }
+    }
+
+    std::copy(result.begin(), result.end(), indices);
+}
+
+void MeshOptimizer::optimizeOverdraw(uint32_t* indices, size_t indexCount,
+        float3 const* positions, std::vector<uint32_t> const& clusters) {
+    const size_t triangleCount = indexCount / 3;
+    const size_t clusterCount = clusters.size();
+    if (clusterCount < 2) {
+        return;
+    }
+
+    // area-weighted centroid of the whole mesh
+    double3 meshCenter = 0;
+    double meshArea = 0;
+    for (size_t t = 0; t < triangleCount; t++) {
+        const float3 p0 = positions[indices[t * 3]];
+        const float3 p1 = positions[indices[t * 3 + 1]];
+        const float3 p2 = positions[indices[t * 3 + 2]];
+        const double area = length(cross(p1 - p0, p2 - p0));
+        meshCenter += double3(p0 + p1 + p2) * (area / 3.0);
+        meshArea += area;
+    }
+    meshCenter /= std::max(meshArea, std::numeric_limits<double>::min());
+
+    // sort the clusters by how much they face outwards
+    struct Cluster {
+        uint32_t first;
+        uint32_t last;
+        float sortKey;
+    };
+    std::vector<Cluster> sorted(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++) {
+        const uint32_t first = clusters[c];
+        const uint32_t last = c + 1 < clusterCount ? clusters[c + 1] : uint32_t(triangleCount);
+        double3 center = 0;
+        double3 normal = 0;
+        double area = 0;
+        for (uint32_t t = first; t < last; t++) {
+            const float3 p0 = positions[indices[t * 3]];
+            const float3 p1 = positions[indices[t * 3 + 1]];
+            const float3 p2 = positions[indices[t * 3 + 2]];
+            const double3 n(cross(p1 - p0, p2 - p0));    // length is twice the area
+            const double a = length(n);
+            center += double3(p0 + p1 + p2) * (a / 3.0);
+            normal += n;
+            area += a;
+        }
+        center /= std::max(area, std::numeric_limits<double>::min());
+        const double normalLength = length(normal);
+        const double3 n = normalLength > 0 ? normal / normalLength : double3{ 0 };
+        sorted[c] = { first, last, float(dot(center - meshCenter, n)) };
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](Cluster const& lhs, Cluster const& rhs) {
+        return lhs.sortKey > rhs.sortKey;
+    });
+
+    std::vector<uint32_t> result;
+    result.reserve(triangleCount * 3);
+    for (Cluster const& cluster : sorted) {
+        result.insert(result.end(), indices + cluster.first * 3, indices + cluster.last * 3);
+    }
+    std::copy(result.begin(), result.end(), indices);
+}
+
+void MeshOptimizer::optimizeVertexFetch(uint32_t* indices, size_t indexCount,
+        size_t vertexCount, std::vector<uint32_t>& remap) {
+    const uint32_t unused = std::numeric_limits<uint32_t>::max();
+    remap.assign(vertexCount, unused);
+    uint32_t next = 0;
+    for (size_t i = 0; i < indexCount; i++) {
+        uint32_t& index = remap[indices[i]];
+        if (index == unused) {
+            index = next++;
+        }
+        indices[i] = index;
+    }
+    for (size_t v = 0; v < vertexCount; v++) {
+        if (remap[v] == unused) {
+            remap[v] = next++;
+        }
+    }
+}
+
+size_t MeshOptimizer::simplify(uint32_t* indices, size_t indexCount,
+        float3 const* positions, size_t vertexCount, size_t targetIndexCount) {
+    indexCount -= indexCount % 3;
+    if (indexCount <= targetIndexCount) {
+        return indexCount;
+    }
+
+    // weld the vertices that share a position: remap[v] is the first vertex at v's position
+    std::vector<uint32_t> remap(vertexCount);
+    std::vector<bool> locked(vertexCount, false);
+    {
+        std::vector<uint32_t> sorted(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++) {
+            sorted[v] = uint32_t(v);
+        }
+        auto less = [positions](uint32_t lhs, uint32_t rhs) {
+            float3 const& a = positions[lhs];
+            float3 const& b = positions[rhs];
+            return a.x != b.x ? a.x < b.x : (a.y != b.y ? a.y < b.y : a.z < b.z);
+        };
+        std::sort(sorted.begin(), sorted.end(), less);
+        for (size_t i = 0; i < vertexCount;) {
+            size_t j = i + 1;
+            while (j < vertexCount && !less(sorted[i], sorted[j])) {
+                j++;
+            }
+            for (size_t k = i; k < j; k++) {
+                remap[sorted[k]] = sorted[i];
+                // attribute seams can't move without tearing the mesh
+                locked[sorted[k]] = j - i > 1;
+            }
+            i = j;
+        }
+    }
+
+    // lock the vertices of the edges that aren't shared by exactly two triangles (borders and
+    // non-manifold edges)
+    {
+        std::vector<uint64_t> edges;
+        edges.reserve(indexCount);
+        for (size_t i = 0; i < indexCount; i += 3) {
+            for (size_t k = 0; k < 3; k++) {
+                uint32_t a = remap[indices[i + k]];
+                uint32_t b = remap[indices[i + (k + 1) % 3]];
+                if (a > b) std::swap(a, b);
+                edges.push_back((uint64_t(a) << 32u) | b);
+            }
+        }
+        std::sort(edges.begin(), edges.end());
+        for (size_t i = 0; i < edges.size();) {
+            size_t j = i + 1;
+            while (j < edges.size() && edges[j] == edges[i]) {
+                j++;
+            }
+            if (j - i != 2) {
+                locked[uint32_t(edges[i] >> 32u)] = true;
+                locked[uint32_t(edges[i])] = true;
+            }
+            i = j;
+        }
+        for (size_t v = 0; v < vertexCount; v++) {
+            locked[v] = locked[v] || locked[remap[v]];
+        }
+    }
+
+    // area-weighted quadrics of the planes of the triangles around each (welded) vertex
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < indexCount; i += 3) {
+        const double3 p0(positions[indices[i]]);
+        const double3 p1(positions[indices[i + 1]]);
+        const double3 p2(positions[indices[i + 2]]);
+        const double3 n = cross(p1 - p0, p2 - p0);
+        const double area = length(n) * 0.5;
+        if (area > 0) {
+            const double3 normal = n / (area * 2);
+            const Quadric q = Quadric::fromPlane(normal, -dot(normal, p0), area);
+            for (size_t k = 0; k < 3; k++) {
+                quadrics[remap[indices[i + k]]] += q;
+            }
+        }
+    }
+
+    struct Collapse {
+        uint32_t from;
+        uint32_t to;
+        double cost;
+    };
+    std::vector<Collapse> candidates;
+    std::vector<uint32_t> adjacencyOffsets;
+    std::vector<uint32_t> adjacency;
+    std::vector<bool> touched;
+    std::vector<uint32_t> target;
+
+    // Each pass collapses the cheapest edges whose neighborhoods don't overlap, so that the
+    // triangles around a collapse are the ones the pass started with.
+    while (indexCount > targetIndexCount) {
+        const size_t triangleCount = indexCount / 3;
+
+        adjacencyOffsets.assign(vertexCount + 1, 0);
+        for (size_t i = 0; i < indexCount; i++) {
+            adjacencyOffsets[indices[i] + 1]++;
+        }
+        for (size_t v = 0; v < vertexCount; v++) {
+            adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+        }
+        adjacency.resize(indexCount);
+        {
+            std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+            for (size_t i = 0; i < indexCount; i++) {
+                adjacency[fill[indices[i]]++] = uint32_t(i / 3);
+            }
+        }
+
+        candidates.clear();
+        for (size_t i = 0; i < indexCount; i += 3) {
+            for (size_t k = 0; k < 3; k++) {
+                const uint32_t a = indices[i + k];
+                const uint32_t b = indices[i + (k + 1) % 3];
+                const double3 pa(positions[a]);
+                const double3 pb(positions[b]);
+                if (!locked[a]) {
+                    Quadric q = quadrics[a];
+                    q += quadrics[remap[b]];
+                    candidates.push_back({ a, b, q.error(pb) });
+                }
+                if (!locked[b]) {
+                    Quadric q = quadrics[b];
+                    q += quadrics[remap[a]];
+                    candidates.push_back({ b, a, q.error(pa) });
+                }
+            }
+        }
+        std::sort(candidates.begin(), candidates.end(),
+                [](Collapse const& lhs, Collapse const& rhs) { return lhs.cost < rhs.cost; });
+
+        touched.assign(vertexCount, false);
+        target.resize(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++) {
+            target[v] = uint32_t(v);
+        }
+
+        size_t removed = 0;
+        for (Collapse const& collapse : candidates) {
+            if ((triangleCount - removed) * 3 <= targetIndexCount) {
+                break;
+            }
+            const uint32_t v = collapse.from;
+            const uint32_t u = collapse.to;
+            if (touched[remap[v]] || touched[remap[u]]) {
+                continue;
+            }
+
+            // moving v onto u must not flip any of the triangles that are kept
+            const float3 pu = positions[u];
+            bool flips = false;
+            size_t collapsed = 0;
+            for (uint32_t a = adjacencyOffsets[v], e = adjacencyOffsets[v + 1]; a < e; a++) {
+                uint32_t const* t = indices + adjacency[a] * 3;
+                if (remap[t[0]] == remap[u] || remap[t[1]] == remap[u] || remap[t[2]] == remap[u]) {
+                    collapsed++;
+                    continue;
+                }
+                const float3 p0 = positions[t[0]];
+                const float3 p1 = positions[t[1]];
+                const float3 p2 = positions[t[2]];
+                const float3 q0 = t[0] == v ? pu : p0;
+                const float3 q1 = t[1] == v ? pu : p1;
+                const float3 q2 = t[2] == v ? pu : p2;
+                // also reject large rotations, which flip triangles over several passes
+                const float3 before = cross(p1 - p0, p2 - p0);
+                const float3 after = cross(q1 - q0, q2 - q0);
+                if (dot(before, after) <= 0.25f * length(before) * length(after)) {
+                    flips = true;
+                    break;
+                }
+            }
+            if (flips) {
+                continue;
+            }
+
+            target[v] = u;
+            quadrics[remap[u]] += quadrics[v];
+            removed += collapsed;
+            for (uint32_t a = adjacencyOffsets[v], e = adjacencyOffsets[v + 1]; a < e; a++) {
+                uint32_t const* t = indices + adjacency[a] * 3;
+                touched[remap[t[0]]] = touched[remap[t[1]]] = touched[remap[t[2]]] = true;
+            }
+        }
+
+        if (removed == 0) {
+            break;
+        }
+
+        // apply the collapses and remove the triangles that became degenerate
+        size_t count = 0;
+        for (size_t i = 0; i < indexCount; i += 3) {
+            const uint32_t a = target[indices[i]];
+            const uint32_t b = target[indices[i + 1]];
+            const uint32_t c = target[indices[i + 2]];
+            if (remap[a] != remap[b] && remap[b] != remap[c] && remap[c] != remap[a]) {
+                indices[count++] = a;
+                indices[count++] = b;
+                indices[count++] = c;
+            }
+        }
+        indexCount = count;
+    }
+    return indexCount;
+}
+
+float MeshOptimizer::computeACMR(uint32_t const* indices, size_t indexCount, size_t vertexCount) {
+    const size_t triangleCount = indexCount / 3;
+    if (triangleCount == 0) {
+        return 0;
+    }
+    // FIFO cache, a vertex is in the cache if it was added less than CACHE_SIZE misses ago
+    std::vector<size_t> addedAt(vertexCount, 0);
+    size_t misses = 0;
+    for (size_t i = 0; i < triangleCount * 3; i++) {
+        const uint32_t v = indices[i];
+        if (addedAt[v] == 0 || misses - addedAt[v] >= CACHE_SIZE) {
+            misses++;
+            addedAt[v] = misses;
+        }
+    }
+    return float(misses) / triangleCount;
+}
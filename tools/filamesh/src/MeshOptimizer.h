@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMESH_MESHOPTIMIZER_H
+#define TNT_FILAMESH_MESHOPTIMIZER_H
+
+#include <math/vec3.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+/*
+ * Reorders the triangles and vertices of an indexed triangle list to make it cheaper to draw,
+ * or simplifies it. All functions work in place on the index buffer and keep the winding of each
+ * triangle.
+ */
+class MeshOptimizer {
+public:
+    // Size of the post-transform vertex cache we optimize for. Most GPUs behave at least as
+    // well as a FIFO cache of this size.
+    static constexpr size_t CACHE_SIZE = 16;
+
+    /*
+     * Reorders the triangles to improve post-transform vertex cache hits, using Tipsify
+     * (Sander, Nehab & Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced
+     * Overdraw", 2007).
+     *
+     * If clusters isn't null, it receives the index of the first triangle of each run of
+     * triangles that starts at a dead-end of the traversal. These runs can be reordered with
+     * optimizeOverdraw() without affecting the cache efficiency much.
+     */
+    static void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount,
+            std::vector<uint32_t>* clusters = nullptr);
+
+    /*
+     * Reorders the clusters returned by optimizeVertexCache() so that the triangles facing
+     * outwards of the mesh are drawn first, which reduces overdraw from most viewpoints.
+     */
+    static void optimizeOverdraw(uint32_t* indices, size_t indexCount,
+            math::float3 const* positions, std::vector<uint32_t> const& clusters);
+
+    /*
+     * Computes a new order of the vertices that follows their first use by the index buffer,
+     * which improves the locality of vertex fetches, and rewrites the indices accordingly.
+     * On return, remap[i] is the new position of vertex i. Unreferenced vertices are moved to
+     * the end of the buffer.
+     */
+    static void optimizeVertexFetch(uint32_t* indices, size_t indexCount, size_t vertexCount,
+            std::vector<uint32_t>& remap);
+
+    /*
+     * Removes triangles by collapsing edges in order of increasing quadric error (Garland &
+     * Heckbert, "Surface Simplification Using Quadric Error Metrics", 1997), until there are at
+     * most targetIndexCount indices left or no edge can be collapsed anymore. Vertices are only
+     * ever moved onto existing vertices, so the vertex buffer doesn't change. Vertices on the
+     * borders of the mesh and on attribute seams (several vertices with the same position)
+     * never move, which keeps the mesh watertight.
+     * Returns the new number of indices.
+     */
+    static size_t simplify(uint32_t* indices, size_t indexCount, math::float3 const* positions,
+            size_t vertexCount, size_t targetIndexCount);
+
+    // Average number of vertices transformed per triangle with a FIFO cache of CACHE_SIZE.
+    static float computeACMR(uint32_t const* indices, size_t indexCount, size_t vertexCount);
+};
+
+#endif // TNT_FILAMESH_MESHOPTIMIZER_H
@@ -17,6 +17,7 @@
 
 #include <fstream>
 #include <iostream>
+#include <sstream>
 
 #include <math/half.h>
 #include <math/mat3.h>
@@ -29,6 +30,8 @@
 #include <getopt/getopt.h>
 
 #include "Box.h"
+#include "MeshEncoder.h"
+#include "MeshOptimizer.h"
 
 using namespace math;
 using namespace utils;
@@ -38,7 +41,7 @@ using namespace utils;
 #include <assimp/cimport.h>
 #include <assimp/scene.h>
 
-static const uint32_t VERSION = 1;
+static const uint32_t VERSION = 2;
 
 using Assimp::Importer;
 
@@ -97,11 +100,29 @@ struct Mesh {
     Box aabb;
 };
 
+enum Optimization : uint32_t {
+    OPTIMIZE_VERTEX_CACHE   = 0x1,
+    OPTIMIZE_OVERDRAW       = 0x2,
+    OPTIMIZE_VERTEX_FETCH   = 0x4,
+};
+
+// Each level of detail has a quarter of the triangles of the previous one and is used when the
+// mesh covers less than half the screen height of the previous one
+static const size_t MAX_LEVEL_OF_DETAIL_COUNT = 4;
+static const float LEVEL_OF_DETAIL_TRIANGLE_RATIO = 0.25f;
+static const float LEVEL_OF_DETAIL_SCREEN_SIZE_RATIO = 0.5f;
+
 // configuration
 bool g_interleaved = false;
+bool g_compressed = false;
+uint32_t g_optimizations = 0;
+uint32_t g_levelOfDetailCount = 1;
 
 uint32_t g_vertexCount = 0;
 std::vector<uint32_t> g_indices;
+// g_levelIndices[part * (g_levelOfDetailCount - 1) + level - 1] are the indices of a part at a
+// simplified level
+std::vector<std::vector<uint32_t>> g_levelIndices;
 // interleaved
 std::vector<Vertex> g_vertices;
 // de-interleaved
@@ -136,6 +157,112 @@ static Box computeAABB(VECTOR const* positions, INDEX const* indices,
     return Box().set(bmin, bmax);
 }
 
+// appends g_levelOfDetailCount - 1 simplified versions of a part to g_levelIndices, the indices
+// must already be in their final vertex order
+static void simplifyMesh(std::vector<uint32_t> const& indices, const float3* positions,
+        size_t vertexCount, size_t indicesOffset) {
+    std::vector<uint32_t> level(indices);
+    float targetCount = float(indices.size());
+    for (size_t l = 1; l < g_levelOfDetailCount; l++) {
+        targetCount *= LEVEL_OF_DETAIL_TRIANGLE_RATIO;
+        level.resize(MeshOptimizer::simplify(level.data(), level.size(), positions, vertexCount,
+                size_t(targetCount)));
+
+        std::vector<uint32_t> optimized(level);
+        if (g_optimizations & (OPTIMIZE_VERTEX_CACHE | OPTIMIZE_OVERDRAW)) {
+            MeshOptimizer::optimizeVertexCache(optimized.data(), optimized.size(), vertexCount);
+        }
+        for (uint32_t& index : optimized) {
+            index += uint32_t(indicesOffset);
+        }
+        g_levelIndices.push_back(std::move(optimized));
+    }
+}
+
+// reorders the triangles and vertices of a mesh according to g_optimizations
+static void optimizeMesh(std::vector<uint32_t>& indices, const float3* positions,
+        size_t vertexCount, std::vector<uint32_t>& order) {
+    if (g_optimizations & (OPTIMIZE_VERTEX_CACHE | OPTIMIZE_OVERDRAW)) {
+        std::vector<uint32_t> clusters;
+        MeshOptimizer::optimizeVertexCache(indices.data(), indices.size(), vertexCount,
+                (g_optimizations & OPTIMIZE_OVERDRAW) ? &clusters : nullptr);
+        if (g_optimizations & OPTIMIZE_OVERDRAW) {
+            MeshOptimizer::optimizeOverdraw(indices.data(), indices.size(), positions, clusters);
+        }
+    }
+
+    if (g_optimizations & OPTIMIZE_VERTEX_FETCH) {
+        std::vector<uint32_t> remap;
+        MeshOptimizer::optimizeVertexFetch(indices.data(), indices.size(), vertexCount, remap);
+        for (size_t j = 0; j < vertexCount; j++) {
+            order[remap[j]] = uint32_t(j);
+        }
+    } else {
+        for (size_t j = 0; j < vertexCount; j++) {
+            order[j] = uint32_t(j);
+        }
+    }
+}
+
+// writes the compression parameters and the compressed vertex and index streams
+static void writeCompressed(std::ofstream& out, bool hasUV1) {
+    std::vector<decltype(Vertex::position)> positions(g_positions);
+    std::vector<decltype(Vertex::tangents)> tangents(g_tangents);
+    std::vector<decltype(Vertex::color)> colors(g_colors);
+    std::vector<decltype(Vertex::uv0)> uv0(g_uv0);
+    if (g_interleaved) {
+        for (Vertex const& v : g_vertices) {
+            positions.push_back(v.position);
+            tangents.push_back(v.tangents);
+            colors.push_back(v.color);
+            uv0.push_back(v.uv0);
+        }
+    }
+
+    float3 origin, scale;
+    MeshEncoder::computeQuantization(positions.data(), g_vertexCount, origin, scale);
+
+    std::vector<uint8_t> streams[] = {
+            MeshEncoder::encodePositions(positions.data(), g_vertexCount, origin, scale),
+            MeshEncoder::encodeTangents(tangents.data(), g_vertexCount),
+            MeshEncoder::encodeColors(colors.data(), g_vertexCount),
+            MeshEncoder::encodeUVs(uv0.data(), g_vertexCount),
+            hasUV1 ? MeshEncoder::encodeUVs(g_uv1.data(), g_vertexCount) : std::vector<uint8_t>{},
+            MeshEncoder::encodeIndices(g_indices.data(), g_indices.size())
+    };
+
+    write(out, origin);
+    write(out, scale);
+    for (auto const& stream : streams) {
+        write(out, uint32_t(stream.size()));
+    }
+    for (auto const& stream : streams) {
+        write(out, stream.data(), uint32_t(stream.size()));
+    }
+}
+
+static bool parseOptimizations(const std::string& arg) {
+    std::istringstream stream(arg);
+    std::string name;
+    g_optimizations = 0;
+    while (std::getline(stream, name, ',')) {
+        if (name == "none") {
+            g_optimizations = 0;
+        } else if (name == "cache") {
+            g_optimizations |= OPTIMIZE_VERTEX_CACHE;
+        } else if (name == "overdraw") {
+            g_optimizations |= OPTIMIZE_OVERDRAW;
+        } else if (name == "fetch") {
+            g_optimizations |= OPTIMIZE_VERTEX_FETCH;
+        } else if (name == "all") {
+            g_optimizations |= OPTIMIZE_VERTEX_CACHE | OPTIMIZE_OVERDRAW | OPTIMIZE_VERTEX_FETCH;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
 template<bool INTERLEAVED>
 void processNode(const aiScene* scene, const aiNode* node, std::vector<Mesh>& meshes) {
     for (size_t i = 0; i < node->mNumMeshes; ++i) {
@@ -178,7 +305,30 @@ void processNode(const aiScene* scene, const aiNode* node, std::vector<Mesh>& me
                     g_uv0.reserve(g_vertexCount);
                 }
 
-                for (size_t j = 0; j < numVertices; j++) {
+                // all faces should be triangles since we configure assimp to triangulate faces
+                std::vector<uint32_t> indices;
+                indices.reserve(numFaces * faces[0].mNumIndices);
+                for (size_t j = 0; j < numFaces; ++j) {
+                    const aiFace& face = faces[j];
+                    for (size_t k = 0; k < face.mNumIndices; ++k) {
+                        indices.push_back(face.mIndices[k]);
+                    }
+                }
+
+                // order[n] is the source vertex stored at position n
+                std::vector<uint32_t> order(numVertices);
+                optimizeMesh(indices, vertices, numVertices, order);
+
+                if (g_levelOfDetailCount > 1) {
+                    std::vector<float3> orderedVertices(numVertices);
+                    for (size_t n = 0; n < numVertices; n++) {
+                        orderedVertices[n] = vertices[order[n]];
+                    }
+                    simplifyMesh(indices, orderedVertices.data(), numVertices, indicesOffset);
+                }
+
+                for (size_t n = 0; n < numVertices; n++) {
+                    const size_t j = order[n];
                     quatf q = mat3f::packTangentFrame({tangents[j], bitangents[j], normals[j]});
 
                     color = colors ? colors[j] : float4(1.0f);
@@ -197,16 +347,11 @@ void processNode(const aiScene* scene, const aiNode* node, std::vector<Mesh>& me
                     }
                 }
 
-                // all faces should be triangles since we configure assimp to triangulate faces
-                size_t indicesCount = numFaces * faces[0].mNumIndices;
+                size_t indicesCount = indices.size();
                 size_t indexBufferOffset = g_indices.size();
                 g_indices.reserve(g_indices.size() + indicesCount);
-
-                for (size_t j = 0; j < numFaces; ++j) {
-                    const aiFace& face = faces[j];
-                    for (size_t k = 0; k < face.mNumIndices; ++k) {
-                        g_indices.push_back(uint32_t(face.mIndices[k] + indicesOffset));
-                    }
+                for (uint32_t index : indices) {
+                    g_indices.push_back(uint32_t(index + indicesOffset));
                 }
 
                 size_t stride = INTERLEAVED ? sizeof(Vertex) : sizeof(Vertex::position);
@@ -245,6 +390,17 @@ static void printUsage(const char* name) {
                     "       Print copyright and license information\n\n"
                     "   --interleaved, -i\n"
                     "       interleaves mesh attributes\n\n"
+                    "   --optimize=[none|cache|overdraw|fetch|all], -O [...]\n"
+                    "       reorder triangles and vertices to draw the mesh faster, several\n"
+                    "       optimizations can be separated by commas (default: none)\n"
+                    "           cache:    post-transform vertex cache locality\n"
+                    "           overdraw: draw outward facing triangles first (implies cache)\n"
+                    "           fetch:    vertex fetch locality\n\n"
+                    "   --compress, -c\n"
+                    "       quantize, delta-code and deflate the vertices and indices\n\n"
+                    "   --lod=<count>, -L <count>\n"
+                    "       generate levels of detail, each simplified level has a quarter of the\n"
+                    "       triangles of the previous one (default: 1, max: 4)\n\n"
     );
 
     const std::string from("FILAMESH");
@@ -261,11 +417,14 @@ static void license() {
 }
 
 static int handleArguments(int argc, char* argv[]) {
-    static constexpr const char* OPTSTR = "hil";
+    static constexpr const char* OPTSTR = "hilcO:L:";
     static const struct option OPTIONS[] = {
-            { "help",        no_argument, 0, 'h' },
-            { "license",     no_argument, 0, 'l' },
-            { "interleaved", no_argument, 0, 'i' },
+            { "help",        no_argument,       0, 'h' },
+            { "license",     no_argument,       0, 'l' },
+            { "interleaved", no_argument,       0, 'i' },
+            { "compress",    no_argument,       0, 'c' },
+            { "optimize",    required_argument, 0, 'O' },
+            { "lod",         required_argument, 0, 'L' },
             { 0, 0, 0, 0 }  // termination of the option list
     };
 
@@ -287,6 +446,25 @@ static int handleArguments(int argc, char* argv[]) {
             case 'i':
                 g_interleaved = true;
                 break;
+            case 'c':
+                g_compressed = true;
+                break;
+            case 'O':
+                if (!parseOptimizations(optarg)) {
+                    std::cerr << "Unknown optimization in " << optarg << std::endl;
+                    exit(1);
+                }
+                break;
+            case 'L': {
+                const int count = atoi(optarg);
+                if (count < 1 || count > int(MAX_LEVEL_OF_DETAIL_COUNT)) {
+                    std::cerr << "The number of levels of detail must be between 1 and "
+                              << MAX_LEVEL_OF_DETAIL_COUNT << std::endl;
+                    exit(1);
+                }
+                g_levelOfDetailCount = uint32_t(count);
+                break;
+            }
         }
     }
 
@@ -352,6 +530,21 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    // the simplified levels are stored after the parts in the index buffer, level by level
+    struct Level {
+        uint32_t offset;
+        uint32_t count;
+    };
+    std::vector<Level> levels;
+    for (size_t l = 1; l < g_levelOfDetailCount; l++) {
+        for (size_t i = 0; i < meshes.size(); i++) {
+            std::vector<uint32_t> const& indices =
+                    g_levelIndices[i * (g_levelOfDetailCount - 1) + l - 1];
+            levels.push_back({ uint32_t(g_indices.size()), uint32_t(indices.size()) });
+            g_indices.insert(g_indices.end(), indices.begin(), indices.end());
+        }
+    }
+
     const bool hasIndex16 = g_vertexCount < std::numeric_limits<uint16_t>::max();
     const bool hasUV1 = g_uv1.size() > 0;
 
@@ -360,7 +553,7 @@ int main(int argc, char* argv[]) {
         aabb.unionSelf(meshes.at(i).aabb);
     }
 
-    write(out, "FILAMESH", 8 * sizeof(char));
+    write(out, g_compressed ? "FILAMESZ" : "FILAMESH", 8 * sizeof(char));
 
     Header header;
     header.version = VERSION;
@@ -397,13 +590,18 @@ int main(int argc, char* argv[]) {
     }
     header.vertexCount = g_vertexCount;
     header.vertexSize = g_vertexCount * sizeof(Vertex);
+    if (hasUV1) {
+        header.vertexSize += g_vertexCount * sizeof(Vertex::uv0);
+    }
     header.indexType = uint32_t(hasIndex16 ? 1 : 0);
     header.indexCount = g_indices.size();
     header.indexSize = g_indices.size() * (hasIndex16 ? sizeof(uint16_t) : sizeof(uint32_t));
 
     write(out, header);
 
-    if (g_interleaved) {
+    if (g_compressed) {
+        writeCompressed(out, hasUV1);
+    } else if (g_interleaved) {
         write(out, g_vertices.data(), uint32_t(g_vertices.size()));
     } else {
         write(out, g_positions.data(), uint32_t(g_positions.size()));
@@ -415,15 +613,17 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    if (!hasIndex16) {
-        write(out, g_indices.data(), uint32_t(g_indices.size()));
-    } else {
-        std::vector<uint16_t> smallIndices;
-        smallIndices.resize(g_indices.size());
-        for (size_t i = 0; i < g_indices.size(); i++) {
-            smallIndices[i] = static_cast<uint16_t>(g_indices[i]);
+    if (!g_compressed) {
+        if (!hasIndex16) {
+            write(out, g_indices.data(), uint32_t(g_indices.size()));
+        } else {
+            std::vector<uint16_t> smallIndices;
+            smallIndices.resize(g_indices.size());
+            for (size_t i = 0; i < g_indices.size(); i++) {
+                smallIndices[i] = static_cast<uint16_t>(g_indices[i]);
+            }
+            write(out, smallIndices.data(), uint32_t(smallIndices.size()));
         }
-        write(out, smallIndices.data(), uint32_t(smallIndices.size()));
     }
 
     write(out, meshes.data(), header.parts);
@@ -446,6 +646,14 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    write(out, g_levelOfDetailCount);
+    float screenSize = 1.0f;
+    for (size_t l = 1; l < g_levelOfDetailCount; l++) {
+        screenSize *= LEVEL_OF_DETAIL_SCREEN_SIZE_RATIO;
+        write(out, screenSize);
+        write(out, levels.data() + (l - 1) * meshes.size(), uint32_t(meshes.size()));
+    }
+
     out.flush();
     out.close();
 
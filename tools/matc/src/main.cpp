@@ -19,6 +19,7 @@
 #include <iostream>
 #include <memory>
 
+#include "matc/BatchCompiler.h"
 #include "matc/Compiler.h"
 #include "matc/CommandlineConfig.h"
 #include "matc/MaterialCompiler.h"
@@ -33,6 +34,23 @@ int main(int argc, char** argv) {
         return EXIT_FAILURE;
     }
 
+    // a single material with a cache is a batch of one
+    const bool cached = !parameters.getCacheDirectory().empty() &&
+            parameters.getInput() && parameters.getOutput();
+    if (!parameters.getBatchManifest().empty() || cached) {
+        BatchCompiler batch(parameters);
+        batch.setCacheDirectory(parameters.getCacheDirectory());
+        if (!parameters.getBatchManifest().empty()) {
+            if (!batch.addManifest(parameters.getBatchManifest())) {
+                return EXIT_FAILURE;
+            }
+        } else {
+            batch.addMaterial(parameters.getInput()->getName(),
+                    static_cast<FilesystemOutput*>(parameters.getOutput())->getPath());
+        }
+        return batch.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     std::unique_ptr<Compiler> compiler = nullptr;
     switch (parameters.getMode()) {
         case CommandlineConfig::Mode::MATERIAL:
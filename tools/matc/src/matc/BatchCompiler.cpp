@@ -0,0 +1,319 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "BatchCompiler.h"
+
+#include "CommandlineConfig.h"
+#include "MaterialCompiler.h"
+
+#include <shaders/Shaders.h>
+
+#include <utils/JobSystem.h>
+#include <utils/Path.h>
+
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <stdio.h>
+#include <string.h>
+
+using namespace utils;
+
+namespace matc {
+
+namespace {
+
+// Bump this when the output of matc changes for reasons the cache key doesn't capture.
+static constexpr const char* CACHE_VERSION = "matc-cache-2";
+
+// 64-bit FNV-1a
+class Hasher {
+public:
+    void add(const void* data, size_t size) noexcept {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++) {
+            mHash = (mHash ^ p[i]) * 0x100000001b3llu;
+        }
+    }
+
+    void add(const char* s) noexcept {
+        // include the terminator so that consecutive strings can't alias
+        add(s, strlen(s) + 1);
+    }
+
+    uint64_t get() const noexcept { return mHash; }
+
+private:
+    uint64_t mHash = 0xcbf29ce484222325llu;
+};
+
+// The code generated for a material depends on filamat's shader sources as much as on the
+// material itself.
+uint64_t getShaderSourcesHash() noexcept {
+    static const uint64_t sHash = []() {
+        using namespace filament::shaders;
+        const char* const sources[] = {
+                brdf_fs, common_getters_fs, common_graphics_fs, common_lighting_fs,
+                common_material_fs, common_material_vs, common_math_fs, common_types_fs,
+                conversion_functions_fs, depth_main_fs, depth_main_vs, dithering_fs, fxaa_fs,
+                getters_fs, getters_vs, light_directional_fs, light_indirect_fs,
+                light_punctual_fs, main_fs, main_vs, post_process_fs, post_process_vs,
+                post_process_cs,
+                shading_lit_fs, shading_model_cloth_fs, shading_model_standard_fs,
+                shading_model_subsurface_fs, shading_parameters_fs, shading_unlit_fs,
+                shadowing_fs, shadowing_vs, tone_mapping_fs, variables_fs, variables_vs
+        };
+        Hasher hasher;
+        for (const char* source : sources) {
+            hasher.add(source);
+        }
+        return hasher.get();
+    }();
+    return sHash;
+}
+
+// An input that serves a material source already read in memory.
+class MemoryInput : public Config::Input {
+public:
+    MemoryInput(const std::string& name, std::unique_ptr<const char[]> data, size_t size)
+            : mName(name), mData(std::move(data)), mSize(size) {
+    }
+
+    ssize_t open() noexcept override {
+        return ssize_t(mSize);
+    }
+
+    std::unique_ptr<const char[]> read() noexcept override {
+        return std::move(mData);
+    }
+
+    bool close() noexcept override {
+        return false;
+    }
+
+    const char* getName() const noexcept override {
+        return mName.c_str();
+    }
+
+private:
+    const std::string mName;
+    std::unique_ptr<const char[]> mData;
+    size_t mSize;
+};
+
+// The options of the batch, with the input and output of a single material. Each material needs
+// its own Config since compiling it can change the optimization level.
+class EntryConfig : public Config {
+public:
+    EntryConfig(const Config& base, Input* input, const std::string& output)
+            : Config(base), mBase(base), mInput(input), mOutput(output.c_str()) {
+    }
+
+    Output* getOutput() const noexcept override {
+        return const_cast<FilesystemOutput*>(&mOutput);
+    }
+
+    Input* getInput() const noexcept override {
+        return mInput;
+    }
+
+    std::string toString() const noexcept override {
+        return mBase.toString() + mInput->getName();
+    }
+
+private:
+    const Config& mBase;
+    Input* mInput;
+    FilesystemOutput mOutput;
+};
+
+std::unique_ptr<const char[]> readFile(const std::string& path, size_t* size) noexcept {
+    std::ifstream file(path.c_str(), std::ifstream::binary | std::ios::ate);
+    if (!file) {
+        return nullptr;
+    }
+    *size = size_t(file.tellg());
+    file.seekg(0, std::ios::beg);
+    std::unique_ptr<char[]> buffer(new char[*size]);
+    if (!file.read(buffer.get(), *size)) {
+        return nullptr;
+    }
+    return std::unique_ptr<const char[]>(std::move(buffer));
+}
+
+bool copyFile(const std::string& from, const std::string& to) noexcept {
+    std::ifstream in(from.c_str(), std::ifstream::binary);
+    std::ofstream out(to.c_str(), std::ofstream::out | std::ofstream::binary);
+    if (!in || !out) {
+        return false;
+    }
+    out << in.rdbuf();
+    out.close();
+    return !out.fail();
+}
+
+} // anonymous namespace
+
+bool BatchCompiler::addManifest(const std::string& path) noexcept {
+    std::ifstream manifest(path.c_str());
+    if (!manifest) {
+        std::cerr << "Unable to open manifest '" << path << "'" << std::endl;
+        return false;
+    }
+
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(manifest, line)) {
+        lineNumber++;
+        std::istringstream fields(line);
+        std::string input;
+        std::string output;
+        if (!(fields >> input) || input[0] == '#') {
+            continue;
+        }
+        if (!(fields >> output)) {
+            std::cerr << path << ":" << lineNumber << ": missing output filename." << std::endl;
+            return false;
+        }
+        addMaterial(input, output);
+    }
+    return true;
+}
+
+uint64_t BatchCompiler::computeKey(const Config& config,
+        const char* source, size_t size) noexcept {
+    Hasher hasher;
+    hasher.add(CACHE_VERSION);
+
+    const uint64_t shaders = getShaderSourcesHash();
+    hasher.add(&shaders, sizeof(shaders));
+
+    // every option which affects the output
+    const uint8_t options[] = {
+            uint8_t(config.getMode()),
+            uint8_t(config.getPlatform()),
+            uint8_t(config.getTargetApi()),
+            uint8_t(config.getOptimizationLevel()),
+            uint8_t(config.getOutputFormat()),
+            uint8_t(config.isDebug()),
+            config.getVariantFilter(),
+            uint8_t(config.compressShaders())
+    };
+    hasher.add(options, sizeof(options));
+
+    for (const auto& entry : config.getVariantProfile()) {
+        hasher.add(entry.first.c_str());
+        hasher.add(&entry.second, sizeof(entry.second));
+    }
+
+    hasher.add(source, size);
+    return hasher.get();
+}
+
+bool BatchCompiler::isCacheable() const noexcept {
+    // reflection and shader printing write to stdout, not to the output file
+    return !mCacheDirectory.empty() &&
+            mConfig.getReflectionTarget() == Config::Metadata::NONE &&
+            !mConfig.printShaders();
+}
+
+bool BatchCompiler::run() noexcept {
+    if (mConfig.getMode() != Config::Mode::MATERIAL) {
+        std::cerr << "Only materials can be compiled in batch." << std::endl;
+        return false;
+    }
+
+    const bool cacheable = isCacheable();
+    if (cacheable) {
+        Path cache(mCacheDirectory);
+        if (!cache.isDirectory() && !cache.mkdirRecursive()) {
+            std::cerr << "Unable to create cache directory '" << mCacheDirectory << "'"
+                    << std::endl;
+            return false;
+        }
+    }
+
+    // shared by all the materials
+    MaterialCompiler compiler;
+
+    std::atomic<bool> success = { true };
+    std::atomic<uint32_t> hits = { 0 };
+
+    auto compile = [&](const Entry& entry, size_t index) {
+        size_t size = 0;
+        std::unique_ptr<const char[]> source = readFile(entry.input, &size);
+        if (!source) {
+            std::cerr << "Unable to read material source file '" << entry.input << "'"
+                    << std::endl;
+            return false;
+        }
+
+        std::string cached;
+        if (cacheable) {
+            char key[17];
+            snprintf(key, sizeof(key), "%016llx",
+                    (unsigned long long) computeKey(mConfig, source.get(), size));
+            cached = Path::concat(mCacheDirectory, key).getPath();
+            if (Path(cached).isFile() && copyFile(cached, entry.output)) {
+                hits++;
+                return true;
+            }
+        }
+
+        MemoryInput input(entry.input, std::move(source), size);
+        EntryConfig config(mConfig, &input, entry.output);
+        if (!compiler.start(config)) {
+            return false;
+        }
+
+        if (cacheable) {
+            // entries appear atomically, so that concurrent builds never see a partial one
+            std::string temporary(cached + "." + std::to_string(index) + ".tmp");
+            if (!copyFile(entry.output, temporary) ||
+                    rename(temporary.c_str(), cached.c_str()) != 0) {
+                remove(temporary.c_str());
+                std::cerr << "Warning: unable to cache '" << entry.output << "'" << std::endl;
+            }
+        }
+        return true;
+    };
+
+    JobSystem js;
+    js.adopt();
+
+    auto work = [&](uint32_t start, uint32_t count) {
+        for (uint32_t i = start, e = start + count; i < e; i++) {
+            if (!compile(mEntries[i], i)) {
+                std::cerr << "Could not compile '" << mEntries[i].input << "'" << std::endl;
+                success = false;
+            }
+        }
+    };
+
+    js.runAndWait(jobs::parallel_for(js, nullptr, 0, uint32_t(mEntries.size()),
+            std::cref(work), jobs::CountSplitter<1, 8>()));
+
+    js.emancipate();
+
+    if (cacheable) {
+        std::cout << mEntries.size() << " materials, " << hits << " found in cache" << std::endl;
+    }
+    return success;
+}
+
+} // namespace matc
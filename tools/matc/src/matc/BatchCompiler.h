@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_BATCHCOMPILER_H
+#define TNT_BATCHCOMPILER_H
+
+#include "Config.h"
+
+#include <string>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace matc {
+
+/*
+ * Compiles a list of materials in a single process, with the options of a base Config.
+ *
+ * The materials share one MaterialCompiler (so glslang is initialized once) and are compiled
+ * concurrently on a JobSystem, whose threads also generate the shaders of each material.
+ *
+ * When a cache directory is set, the output of each material is stored there under a key
+ * computed from the material source, the compilation options and the version of filamat's
+ * shader sources. A material whose key is already in the cache isn't compiled again, its output
+ * is copied from the cache instead.
+ */
+class BatchCompiler {
+public:
+    explicit BatchCompiler(const Config& config) noexcept : mConfig(config) { }
+
+    // Adds the materials listed in a manifest, one "<input> <output>" pair per line.
+    // Empty lines and lines starting with '#' are ignored.
+    bool addManifest(const std::string& path) noexcept;
+
+    void addMaterial(const std::string& input, const std::string& output) noexcept {
+        mEntries.push_back({ input, output });
+    }
+
+    // Enables the on-disk cache, the directory is created if needed.
+    void setCacheDirectory(const std::string& path) noexcept {
+        mCacheDirectory = path;
+    }
+
+    // Returns true if all the materials compiled successfully.
+    bool run() noexcept;
+
+    // Returns the cache key of a material source compiled with the specified options.
+    static uint64_t computeKey(const Config& config, const char* source, size_t size) noexcept;
+
+private:
+    struct Entry {
+        std::string input;
+        std::string output;
+    };
+
+    bool isCacheable() const noexcept;
+
+    const Config& mConfig;
+    std::vector<Entry> mEntries;
+    std::string mCacheDirectory;
+};
+
+} // namespace matc
+
+#endif // TNT_BATCHCOMPILER_H
@@ -26,6 +26,8 @@
 #include <sstream>
 #include <string>
 
+#include <stdlib.h>
+
 using namespace utils;
 
 namespace matc {
@@ -36,6 +38,7 @@ static void usage(char* name) {
             "MATC is a command-line tool to compile material definition.\n"
             "Usages:\n"
             "    MATC [options] <input-file>\n"
+            "    MATC [options] --batch=<manifest>\n"
             "\n"
             "Supported input formats:\n"
             "    Filament material definition (.mat)\n"
@@ -52,7 +55,9 @@ static void usage(char* name) {
             "   --optimize, -O, -x\n"
             "       Optimize generated shader code for performance\n\n"
             "   --optimize-size, -S\n"
-            "       Optimize generated shader code for performance and size\n\n"
+            "       Optimize generated shader code for performance and size\n"
+            "       With either option, SPIR-V is also stripped of debug information (unless\n"
+            "       --debug is set) and its IDs are canonicalized, so identical shaders are shared\n\n"
             "   --preprocessor-only, -E\n"
             "       Optimize by running only the preprocessor\n\n"
             "   --api, -a\n"
@@ -61,8 +66,21 @@ static void usage(char* name) {
             "       Reflect the specified metadata as JSON: parameters\n\n"
             "   --variant-filter=<filter>, -v <filter>\n"
             "       Filter out specified comma-separated variants:\n"
-            "           directionalLighting, dynamicLighting, shadowReceiver, skinning\n"
+            "           directionalLighting, dynamicLighting, shadowReceiver, skinning, instancing\n"
             "       This variant filter is merged the filter from the material, if any\n\n"
+            "   --variant-profile=<file>\n"
+            "       Only generate the variants listed for the material in a usage profile\n"
+            "       recorded at runtime with Material::getUsedVariants(). Each line of the\n"
+            "       profile is a material name followed by a mask of used variants\n\n"
+            "   --compress\n"
+            "       Compress the shaders, they are decompressed at runtime when first used\n\n"
+            "   --batch=<manifest>\n"
+            "       Compile all the materials listed in the manifest, in parallel, with the same\n"
+            "       options. Each line of the manifest is an input and an output file separated\n"
+            "       by whitespace, lines starting with # are ignored\n\n"
+            "   --cache=<directory>\n"
+            "       Store the compiled materials in the specified directory, and reuse them when\n"
+            "       neither the material source, the options nor matc have changed\n\n"
             "Internal use only:\n"
             "   --output-format, -f\n"
             "       Specify output format: blob (default) or header\n\n"
@@ -80,6 +98,26 @@ static void usage(char* name) {
     printf("%s", usage.c_str());
 }
 
+static bool parseVariantProfile(const std::string& path, Config::VariantProfile& profile) {
+    std::ifstream file(path.c_str());
+    if (!file) {
+        std::cerr << "Unable to open variant profile '" << path << "'" << std::endl;
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        // the name is everything up to the mask, it can contain spaces
+        size_t separator = line.find_last_of(" \t");
+        if (separator == std::string::npos) {
+            continue;
+        }
+        std::string name(line.substr(0, line.find_last_not_of(" \t", separator) + 1));
+        uint32_t variants = uint32_t(strtoul(line.c_str() + separator + 1, nullptr, 0));
+        profile[name] |= variants;
+    }
+    return true;
+}
+
 static void license() {
     std::cout <<
     #include "licenses/licenses.inc"
@@ -108,6 +146,10 @@ bool CommandlineConfig::parse() {
             { "api",               required_argument, nullptr, 'a' },
             { "reflect",           required_argument, nullptr, 'r' },
             { "print",                   no_argument, nullptr, 't' },
+            { "compress",                no_argument, nullptr, 'z' },
+            { "variant-profile",   required_argument, nullptr, 'u' },
+            { "batch",             required_argument, nullptr, 'b' },
+            { "cache",             required_argument, nullptr, 'c' },
             { 0, 0, 0, 0 }  // termination of the option list
     };
 
@@ -196,6 +238,8 @@ bool CommandlineConfig::parse() {
                         variantFilter |= filament::Variant::SHADOW_RECEIVER;
                     } else if (item == "skinning") {
                         variantFilter |= filament::Variant::SKINNING;
+                    } else if (item == "instancing") {
+                        variantFilter |= filament::Variant::INSTANCING;
                     }
                 }
                 mVariantFilter = variantFilter;
@@ -217,6 +261,20 @@ bool CommandlineConfig::parse() {
             case 't':
                 mPrintShaders = true;
                 break;
+            case 'z':
+                mCompressShaders = true;
+                break;
+            case 'u':
+                if (!parseVariantProfile(arg, mVariantProfile)) {
+                    return false;
+                }
+                break;
+            case 'b':
+                mBatchManifest = arg;
+                break;
+            case 'c':
+                mCacheDirectory = arg;
+                break;
         }
     }
 
@@ -224,6 +282,10 @@ bool CommandlineConfig::parse() {
         std::cerr << "Only one input file should be specified on the command line." << std::endl;
         return false;
     }
+    if (mArgc - optind > 0 && !mBatchManifest.empty()) {
+        std::cerr << "Input files must be listed in the manifest in batch mode." << std::endl;
+        return false;
+    }
     if (mArgc - optind > 0) {
         mInput = new FilesystemInput(mArgv[optind]);
     }
@@ -50,6 +50,10 @@ public:
         mFile.close();
         return mFile.fail();
     };
+
+    const std::string& getPath() const noexcept {
+        return mPath;
+    }
 private:
     const std::string mPath;
     std::ofstream mFile;
@@ -123,6 +127,16 @@ public:
         return parameters;
     }
 
+    // Path of the batch manifest, empty when compiling a single material.
+    const std::string& getBatchManifest() const noexcept {
+        return mBatchManifest;
+    }
+
+    // Directory of the compilation cache, empty when the cache is disabled.
+    const std::string& getCacheDirectory() const noexcept {
+        return mCacheDirectory;
+    }
+
 private:
     bool parse();
 
@@ -131,6 +145,9 @@ private:
 
     FilesystemInput* mInput = nullptr;
     FilesystemOutput* mOutput = nullptr;
+
+    std::string mBatchManifest;
+    std::string mCacheDirectory;
 };
 
 } // namespace matc
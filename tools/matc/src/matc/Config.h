@@ -22,8 +22,10 @@
 
 #include <filamat/MaterialBuilder.h>
 
+#include <map>
 #include <memory>
 #include <ostream>
+#include <string>
 
 #include <utils/compiler.h>
 
@@ -136,6 +138,17 @@ public:
         return mVariantFilter;
     }
 
+    bool compressShaders() const noexcept {
+        return mCompressShaders;
+    }
+
+    // Variants used by each material at runtime, by material name, see
+    // filament::Material::getUsedVariants(). Empty if no profile was given.
+    using VariantProfile = std::map<std::string, uint32_t>;
+    const VariantProfile& getVariantProfile() const noexcept {
+        return mVariantProfile;
+    }
+
 protected:
     bool mDebug = false;
     bool mIsValid = true;
@@ -147,6 +160,8 @@ protected:
     OutputFormat mOutputFormat = OutputFormat::BLOB;
     TargetApi mTargetApi = TargetApi::OPENGL;
     uint8_t mVariantFilter = 0;
+    bool mCompressShaders = false;
+    VariantProfile mVariantProfile;
 };
 
 }
@@ -277,6 +277,12 @@ bool MaterialCompiler::run(const Config& config) {
     }
 
     Config::Optimization optimizationLevel = config.getOptimizationLevel();
+    // Materials can opt into full optimization, which also minifies their GLSL
+    if (builder.getOptimizeShaders() && optimizationLevel < Config::Optimization::SIZE) {
+        optimizationLevel = Config::Optimization::PERFORMANCE;
+        const_cast<Config&>(config).setOptimizationLevel(optimizationLevel);
+    }
+
     // Drop the optimization level to preprocessor when the material uses external samplers
     // samplerExternalOES in GLSL is currently not fully supported in SPIR-V/Vulkan and
     // proper handling is lacking in glslang and spirv-cross
@@ -291,7 +297,19 @@ bool MaterialCompiler::run(const Config& config) {
         .platform(config.getPlatform())
         .targetApi(config.getTargetApi())
         .codeGenTargetApi(config.getCodeGenTargetApi())
-        .variantFilter(config.getVariantFilter() | builder.getVariantFilter());
+        .variantFilter(config.getVariantFilter() | builder.getVariantFilter())
+        .compressShaders(config.compressShaders());
+
+    const Config::VariantProfile& profile = config.getVariantProfile();
+    if (!profile.empty()) {
+        auto pos = profile.find(builder.getName().c_str_safe());
+        if (pos != profile.end()) {
+            builder.usedVariants(pos->second);
+        } else {
+            std::cerr << "Warning: material " << input->getName() << " is not in the variant "
+                         "profile, all its variants are generated." << std::endl;
+        }
+    }
 
     // At this point the builder may be able to generate valid shaders if the user populated the
     // properties section in the config file properly. If she hasn't, guess them.
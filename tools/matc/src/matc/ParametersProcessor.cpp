@@ -47,6 +47,7 @@ static constexpr const char* PARAM_KEY_MASK_THRESHOLD    = "maskThreshold";
 static constexpr const char* PARAM_KEY_SHADOW_MULTIPLIER = "shadowMultiplier";
 static constexpr const char* PARAM_KEY_SHADING           = "shadingModel";
 static constexpr const char* PARAM_KEY_VARIANT_FILTER    = "variantFilter";
+static constexpr const char* PARAM_KEY_OPTIMIZE_SHADERS  = "optimizeShaders";
 
 ParametersProcessor::ParametersProcessor() {
     mConfigProcessor[PARAM_KEY_NAME]              = &ParametersProcessor::processName;
@@ -67,6 +68,7 @@ ParametersProcessor::ParametersProcessor() {
     mConfigProcessor[PARAM_KEY_SHADOW_MULTIPLIER] = &ParametersProcessor::processShadowMultiplier;
     mConfigProcessor[PARAM_KEY_SHADING]           = &ParametersProcessor::processShading;
     mConfigProcessor[PARAM_KEY_VARIANT_FILTER]    = &ParametersProcessor::processVariantFilter;
+    mConfigProcessor[PARAM_KEY_OPTIMIZE_SHADERS]  = &ParametersProcessor::processOptimizeShaders;
 
     mRootAsserts[PARAM_KEY_NAME]              = JsonishValue::Type::STRING;
     mRootAsserts[PARAM_KEY_INTERPOLATION]     = JsonishValue::Type::STRING;
@@ -86,6 +88,7 @@ ParametersProcessor::ParametersProcessor() {
     mRootAsserts[PARAM_KEY_SHADOW_MULTIPLIER] = JsonishValue::Type::BOOL;
     mRootAsserts[PARAM_KEY_SHADING]           = JsonishValue::Type::STRING;
     mRootAsserts[PARAM_KEY_VARIANT_FILTER]    = JsonishValue::Type::ARRAY;
+    mRootAsserts[PARAM_KEY_OPTIMIZE_SHADERS]  = JsonishValue::Type::BOOL;
 
     mStringToInterpolation["smooth"] = MaterialBuilder::Interpolation::SMOOTH;
     mStringToInterpolation["flat"] = MaterialBuilder::Interpolation::FLAT;
@@ -98,6 +101,7 @@ ParametersProcessor::ParametersProcessor() {
     mStringToTransparencyMode["default"] = MaterialBuilder::TransparencyMode::DEFAULT;
     mStringToTransparencyMode["twoPassesOneSide"] = MaterialBuilder::TransparencyMode::TWO_PASSES_ONE_SIDE;
     mStringToTransparencyMode["twoPassesTwoSides"] = MaterialBuilder::TransparencyMode::TWO_PASSES_TWO_SIDES;
+    mStringToTransparencyMode["orderIndependent"] = MaterialBuilder::TransparencyMode::ORDER_INDEPENDENT;
 
     mStringToVertexDomain["device"] = MaterialBuilder::VertexDomain::DEVICE;
     mStringToVertexDomain["object"] = MaterialBuilder::VertexDomain::OBJECT;
@@ -125,6 +129,7 @@ ParametersProcessor::ParametersProcessor() {
     mStringToVariant["dynamicLighting"] = filament::Variant::DYNAMIC_LIGHTING;
     mStringToVariant["shadowReceiver"] = filament::Variant::SHADOW_RECEIVER;
     mStringToVariant["skinning"] = filament::Variant::SKINNING;
+    mStringToVariant["instancing"] = filament::Variant::INSTANCING;
 }
 
 bool ParametersProcessor::process(filamat::MaterialBuilder& builder, const JsonishObject& jsonObject) {
@@ -482,6 +487,12 @@ bool ParametersProcessor::processVariantFilter(filamat::MaterialBuilder& builder
     return true;
 }
 
+bool ParametersProcessor::processOptimizeShaders(filamat::MaterialBuilder& builder,
+        const JsonishValue& value) {
+    builder.optimizeShaders(value.toJsonBool()->getBool());
+    return true;
+}
+
 filamat::MaterialBuilder::Variable ParametersProcessor::intToVariable(size_t i) const noexcept {
     switch (i) {
         case 0: return MaterialBuilder::Variable::CUSTOM0;
@@ -75,6 +75,32 @@ Package PostprocessMaterialBuilder::build() {
             glslEntry.variant = static_cast<uint8_t>(k);
             spirvEntry.variant = static_cast<uint8_t>(k);
 
+            // Compute shaders are only used by the OpenGL backend
+            if (filament::isComputeStage(filament::PostProcessStage(k))) {
+                if (targetApi != TargetApi::OPENGL) {
+                    continue;
+                }
+                std::string cs = ShaderPostProcessGenerator::createPostProcessComputeProgram(
+                        shaderModel, targetApi, codeGenTargetApi,
+                        filament::PostProcessStage(k), firstSampler);
+                if (mPostprocessorCallback != nullptr) {
+                    bool ok = mPostprocessorCallback(cs, filament::driver::ShaderType::COMPUTE,
+                            shaderModel, &cs, pSpirv);
+                    if (!ok) {
+                        // An error occured while postProcessing, aborting.
+                        errorOccured = true;
+                        break;
+                    }
+                }
+                glslEntry.stage = filament::driver::ShaderType::COMPUTE;
+                glslEntry.shaderSize = cs.size();
+                glslEntry.shader = (char*)malloc(glslEntry.shaderSize + 1);
+                strcpy(glslEntry.shader, cs.c_str());
+                glslDictionary.addText(glslEntry.shader);
+                glslEntries.push_back(glslEntry);
+                continue;
+            }
+
             // Vertex Shader
             std::string vs = ShaderPostProcessGenerator::createPostProcessVertexProgram(
                     shaderModel, targetApi, codeGenTargetApi,
@@ -20,6 +20,8 @@
 #include <sstream>
 #include <vector>
 
+#include <ctype.h>
+
 #include <GlslangToSpv.h>
 #include <SPVRemapper.h>
 #include <localintermediate.h>
@@ -124,6 +126,95 @@ static std::string shrinkString(const std::string& s) {
     return r;
 }
 
+/**
+ * Removes the names of the functions, parameters and variables which aren't part of the shader's
+ * interface, SPIRV-Cross then gives them short generated names. The names of the inputs, outputs,
+ * uniforms, samplers and types are kept, the GL backend and the linker need them.
+ */
+static void stripLocalNames(GLSLPostProcessor::SpirvBlob& spirv) {
+    constexpr size_t HEADER_SIZE = 5;
+    if (spirv.size() <= HEADER_SIZE) {
+        return;
+    }
+
+    std::vector<bool> local(spirv[3], false);  // indexed by id, word 3 is the id bound
+    for (size_t i = HEADER_SIZE; i < spirv.size(); i += spirv[i] >> 16) {
+        const uint32_t count = spirv[i] >> 16;
+        const uint32_t op = spirv[i] & 0xFFFF;
+        if (count == 0 || i + count > spirv.size()) {
+            return;  // malformed, leave it alone
+        }
+        if (count < 3 || spirv[i + 2] >= local.size()) {
+            continue;
+        }
+        if (op == spv::OpFunction || op == spv::OpFunctionParameter) {
+            local[spirv[i + 2]] = true;
+        } else if (op == spv::OpVariable && count > 3) {
+            const uint32_t storage = spirv[i + 3];
+            local[spirv[i + 2]] = storage == spv::StorageClassFunction ||
+                    storage == spv::StorageClassPrivate;
+        }
+    }
+
+    GLSLPostProcessor::SpirvBlob stripped(spirv.begin(), spirv.begin() + HEADER_SIZE);
+    stripped.reserve(spirv.size());
+    for (size_t i = HEADER_SIZE; i < spirv.size(); i += spirv[i] >> 16) {
+        const uint32_t count = spirv[i] >> 16;
+        const uint32_t op = spirv[i] & 0xFFFF;
+        if (op == spv::OpName && count > 1 && spirv[i + 1] < local.size() && local[spirv[i + 1]]) {
+            continue;
+        }
+        stripped.insert(stripped.end(), spirv.begin() + i, spirv.begin() + i + count);
+    }
+    spirv.swap(stripped);
+}
+
+/**
+ * Removes the white spaces which don't separate two tokens, e.g. around operators and after
+ * commas. Lines are preserved, and preprocessor directives are left untouched.
+ */
+static std::string minifyWhitespace(const std::string& s) {
+    auto isWordChar = [](char c) {
+        return isalnum((unsigned char) c) || c == '_' || c == '.';
+    };
+    // spaces between these must be kept, e.g. "a - -b"
+    auto isSign = [](char c) {
+        return c == '+' || c == '-';
+    };
+
+    std::string r;
+    r.reserve(s.length());
+
+    bool directive = false;
+    bool lineStart = true;
+    for (size_t i = 0, n = s.length(); i < n; i++) {
+        const char c = s[i];
+        if (lineStart && c != ' ' && c != '\t') {
+            directive = c == '#';
+            lineStart = false;
+        }
+        if (c == '\n') {
+            lineStart = true;
+        } else if ((c == ' ' || c == '\t') && !directive) {
+            size_t next = s.find_first_not_of(" \t", i);
+            if (next == std::string::npos) {
+                break;
+            }
+            const char after = s[next];
+            const char before = r.empty() ? '\n' : r.back();
+            const bool needed = (isWordChar(before) && isWordChar(after)) ||
+                    (isSign(before) && isSign(after));
+            if (needed) {
+                r += ' ';
+            }
+            i = next - 1;
+            continue;
+        }
+        r += c;
+    }
+    return r;
+}
+
 bool GLSLPostProcessor::process(const std::string& inputShader,
         filament::driver::ShaderType shaderType, filament::driver::ShaderModel shaderModel,
         std::string* outputGlsl, SpirvBlob* outputSpirv) {
@@ -145,6 +236,8 @@ bool GLSLPostProcessor::process(const std::string& inputShader,
 
     if (shaderType == filament::driver::VERTEX) {
         mShLang = EShLangVertex;
+    } else if (shaderType == filament::driver::COMPUTE) {
+        mShLang = EShLangCompute;
     } else {
         mShLang = EShLangFragment;
     }
@@ -261,7 +354,18 @@ void GLSLPostProcessor::fullOptimization(const TShader& tShader,
     remapper.remap(spirv, spv::spirvbin_base_t::DCE_ALL);
 
     if (mSpirvOutput) {
-        *mSpirvOutput = spirv;
+        // Vulkan doesn't need the debug names, and canonical IDs make identical shaders
+        // byte-identical so they are shared in the material's SPIR-V dictionary (and compress
+        // better). The GLSL transpiled below still needs the names, so we work on a copy.
+        SpirvBlob canonical(spirv);
+        uint32_t options = spv::spirvbin_base_t::MAP_ALL | spv::spirvbin_base_t::DCE_ALL;
+        if (!mConfig.isDebug()) {
+            options |= spv::spirvbin_base_t::STRIP;
+        }
+        spv::spirvbin_t canonicalizer(0);
+        canonicalizer.registerErrorHandler(errorHandler);
+        canonicalizer.remap(canonical, options);
+        *mSpirvOutput = std::move(canonical);
     }
 
     // Transpile back to GLSL
@@ -269,16 +373,29 @@ void GLSLPostProcessor::fullOptimization(const TShader& tShader,
         CompilerGLSL::Options glslOptions;
         glslOptions.es = shaderModel == filament::driver::ShaderModel::GL_ES_30;
         glslOptions.version = shaderVersionFromModel(shaderModel);
+        if (mShLang == EShLangCompute) {
+            // compute shaders need ES 3.1 or GL 4.3, see CodeGenerator::generateProlog()
+            glslOptions.version = glslOptions.es ? 310 : 430;
+        }
         glslOptions.enable_420pack_extension = glslOptions.version >= 420;
         glslOptions.fragment.default_float_precision = glslOptions.es ?
                 CompilerGLSL::Options::Precision::Mediump : CompilerGLSL::Options::Precision::Highp;
         glslOptions.fragment.default_int_precision = glslOptions.es ?
                 CompilerGLSL::Options::Precision::Mediump : CompilerGLSL::Options::Precision::Highp;
 
+        // Minified shaders are smaller and faster to parse for the driver
+        const bool minify = !mConfig.isDebug();
+        if (minify) {
+            stripLocalNames(spirv);
+        }
+
         CompilerGLSL glslCompiler(move(spirv));
         glslCompiler.set_common_options(glslOptions);
 
         *mGlslOutput = glslCompiler.compile();
+        if (minify) {
+            *mGlslOutput = minifyWhitespace(*mGlslOutput);
+        }
     }
 }
 
@@ -18,6 +18,7 @@
 
 #include "MockConfig.h"
 
+#include <matc/BatchCompiler.h>
 #include <matc/sca/ASTHelpers.h>
 #include <matc/MaterialLexer.h>
 
@@ -469,6 +470,24 @@ TEST_F(MaterialCompiler, EmptyName) {
     builder.name("");
     filamat::Package result = builder.build();
 }
+
+TEST(BatchCompiler, CacheKey) {
+    const std::string source("material { name : key }");
+    MockConfig config;
+    const uint64_t key = matc::BatchCompiler::computeKey(config, source.c_str(), source.size());
+
+    // the key is stable
+    EXPECT_EQ(key, matc::BatchCompiler::computeKey(config, source.c_str(), source.size()));
+
+    // and changes with the source...
+    const std::string other("material { name : other }");
+    EXPECT_NE(key, matc::BatchCompiler::computeKey(config, other.c_str(), other.size()));
+
+    // ...and with the options
+    config.setOptimizationLevel(matc::Config::Optimization::SIZE);
+    EXPECT_NE(key, matc::BatchCompiler::computeKey(config, source.c_str(), source.size()));
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
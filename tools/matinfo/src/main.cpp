@@ -30,12 +30,18 @@
 
 #include <utils/Path.h>
 
+#include <matc/sca/GLSLTools.h>
+#include <matc/sca/builtinResource.h>
+
 #include <spirv_glsl.hpp>
 #include <spirv-tools/libspirv.h>
 
+#include <chrono>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <map>
 
 using namespace filaflat;
 using namespace utils;
@@ -47,6 +53,8 @@ struct Config {
     bool printSPIRV = false;
     bool transpile = false;
     bool binary = false;
+    bool reportSizes = false;
+    bool timeParsing = false;
     uint64_t shaderIndex;
 };
 
@@ -75,6 +83,13 @@ static void printUsage(const char* name) {
                     "       Print the nth Vulkan shader transpiled into GLSL\n\n"
                     "   --dump-binary=[index], -b\n"
                     "       Dump binary SPIRV for the nth Vulkan shader to 'out.spv'\n\n"
+                    "   --report-sizes, -r\n"
+                    "       Print the size of each shader once expanded from the dictionaries,\n"
+                    "       with its lines (GLSL) or instructions (SPIRV), and the totals per\n"
+                    "       shader model\n\n"
+                    "   --time-parsing, -t\n"
+                    "       With --report-sizes, also time the parsing of each GLSL shader by\n"
+                    "       glslang\n\n"
                     "   --license\n"
                     "       Print copyright and license information\n\n"
     );
@@ -93,7 +108,7 @@ static void license() {
 }
 
 static int handleArguments(int argc, char* argv[], Config* config) {
-    static constexpr const char* OPTSTR = "hlg:s:v:b:";
+    static constexpr const char* OPTSTR = "hlg:s:v:b:rt";
     static const struct option OPTIONS[] = {
             { "help",         no_argument,       0, 'h' },
             { "license",      no_argument,       0, 'l' },
@@ -101,6 +116,8 @@ static int handleArguments(int argc, char* argv[], Config* config) {
             { "print-spirv",  required_argument, 0, 's' },
             { "print-vkglsl", required_argument, 0, 'v' },
             { "dump-binary",  required_argument, 0, 'b' },
+            { "report-sizes", no_argument,       0, 'r' },
+            { "time-parsing", no_argument,       0, 't' },
             { 0, 0, 0, 0 }  // termination of the option list
     };
 
@@ -135,6 +152,12 @@ static int handleArguments(int argc, char* argv[], Config* config) {
                 config->shaderIndex = static_cast<uint64_t>(std::stoi(arg));
                 config->binary = true;
                 break;
+            case 'r':
+                config->reportSizes = true;
+                break;
+            case 't':
+                config->timeParsing = true;
+                break;
         }
     }
 
@@ -214,6 +237,7 @@ const char* toString(filament::TransparencyMode transparencyMode) {
         case filament::TransparencyMode::DEFAULT: return "default";
         case filament::TransparencyMode::TWO_PASSES_ONE_SIDE: return "two passes, one side";
         case filament::TransparencyMode::TWO_PASSES_TWO_SIDES: return "two passes, two sides";
+        case filament::TransparencyMode::ORDER_INDEPENDENT: return "order independent";
     }
 }
 
@@ -241,6 +265,7 @@ const char* toString(filament::driver::ShaderType stage) {
     switch (stage) {
         case filament::driver::ShaderType::VERTEX: return "vs";
         case filament::driver::ShaderType::FRAGMENT: return "fs";
+        case filament::driver::ShaderType::COMPUTE: return "cs";
         default: break;
     }
     return "--";
@@ -285,6 +310,8 @@ const char* toString(filament::SamplerInterfaceBlock::Type type) {
         case filament::driver::SamplerType::SAMPLER_2D: return "sampler2D";
         case filament::driver::SamplerType::SAMPLER_CUBEMAP: return "samplerCubemap";
         case filament::driver::SamplerType::SAMPLER_EXTERNAL: return "samplerExternal";
+        case filament::driver::SamplerType::SAMPLER_2D_ARRAY: return "sampler2DArray";
+        case filament::driver::SamplerType::SAMPLER_3D: return "sampler3D";
     }
 }
 
@@ -671,6 +698,143 @@ static bool printVkInfo(ChunkContainer container) {
     return true;
 }
 
+static size_t countLines(const char* text) {
+    size_t lines = 0;
+    for (const char* c = text; *c; c++) {
+        lines += *c == '\n';
+    }
+    return lines;
+}
+
+static size_t countInstructions(uint32_t const* words, size_t count) {
+    // The module starts with a header of 5 words, and the first word of each instruction holds
+    // its word count in its high 16 bits.
+    size_t instructions = 0;
+    for (size_t i = 5; i < count; instructions++) {
+        const uint32_t wordCount = words[i] >> 16u;
+        if (wordCount == 0) {
+            break;
+        }
+        i += wordCount;
+    }
+    return instructions;
+}
+
+// Returns the time glslang takes to parse the shader in milliseconds, or a negative value if
+// the shader can't be parsed.
+static double timeParsing(const char* text, const ShaderInfo& item) {
+    using namespace glslang;
+
+    TShader tShader(item.pipelineStage == filament::driver::ShaderType::VERTEX ?
+            EShLanguage::EShLangVertex : EShLanguage::EShLangFragment);
+    tShader.setStrings(&text, 1);
+
+    matc::GLSLangCleaner cleaner;
+    int version = matc::GLSLTools::glslangVersionFromShaderModel(item.shaderModel);
+    auto start = std::chrono::steady_clock::now();
+    bool ok = tShader.parse(&DefaultTBuiltInResource, version, false, EShMessages::EShMsgDefault);
+    std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - start;
+    return ok ? duration.count() : -1.0;
+}
+
+static bool printShaderSizes(const Config& config, filament::driver::Backend backend,
+        const ChunkContainer& container, void* data, size_t size) {
+    const bool vulkan = backend == filament::driver::Backend::VULKAN;
+    std::vector<ShaderInfo> info;
+    if (!(vulkan ? getVkShaderInfo(container, &info) : getGlShaderInfo(container, &info))) {
+        return false;
+    }
+    if (info.empty()) {
+        return true;
+    }
+
+    MaterialParser parser(backend, data, size);
+    if (!parser.parse()) {
+        return false;
+    }
+
+    const bool timed = config.timeParsing && !vulkan;
+    std::cout << (vulkan ? "Vulkan shader sizes:" : "GLSL shader sizes:") << std::endl;
+    std::cout << "    " << std::setw(25) << std::left << "Shader";
+    std::cout << std::setw(9) << std::right << "Size";
+    std::cout << std::setw(14) << std::right << (vulkan ? "Instructions" : "Lines");
+    if (timed) {
+        std::cout << std::setw(12) << std::right << "Parsing";
+    }
+    std::cout << std::endl;
+
+    struct Total {
+        size_t count = 0;
+        size_t size = 0;
+        size_t lines = 0;
+        double time = 0.0;
+    };
+    std::map<filament::driver::ShaderModel, Total> totals;
+
+    filaflat::ShaderBuilder builder;
+    for (uint64_t i = 0; i < info.size(); ++i) {
+        const auto& item = info[i];
+        if (!parser.getShader(item.shaderModel, item.variant, item.pipelineStage, builder)) {
+            return false;
+        }
+
+        size_t shaderSize;
+        size_t lines;
+        if (vulkan) {
+            shaderSize = builder.size();
+            lines = countInstructions(reinterpret_cast<uint32_t const*>(builder.getShader()),
+                    shaderSize / 4);
+        } else {
+            shaderSize = strlen(builder.getShader());
+            lines = countLines(builder.getShader());
+        }
+
+        std::cout << "    #";
+        std::cout << std::setw(4) << std::left << i;
+        std::cout << std::setw(6) << std::left << toString(item.shaderModel);
+        std::cout << " ";
+        std::cout << std::setw(2) << std::left << toString(item.pipelineStage);
+        std::cout << " ";
+        std::cout << "0x" << std::hex << std::setfill('0') << std::setw(2)
+                  << std::right << (int) item.variant;
+        std::cout << std::setfill(' ') << std::dec << "      ";
+        std::cout << std::setw(9) << std::right << shaderSize;
+        std::cout << std::setw(14) << std::right << lines;
+
+        Total& total = totals[item.shaderModel];
+        total.count++;
+        total.size += shaderSize;
+        total.lines += lines;
+
+        if (timed) {
+            double time = timeParsing(builder.getShader(), item);
+            if (time < 0.0) {
+                std::cout << std::setw(12) << std::right << "error";
+            } else {
+                std::cout << std::setw(9) << std::right << std::fixed << std::setprecision(2)
+                          << time << " ms" << std::defaultfloat;
+                total.time += time;
+            }
+        }
+        std::cout << std::endl;
+    }
+
+    for (const auto& entry : totals) {
+        const Total& total = entry.second;
+        std::cout << "    Total " << std::setw(6) << std::left << toString(entry.first);
+        std::cout << std::setw(4) << std::right << total.count << " shaders  ";
+        std::cout << std::setw(9) << std::right << total.size;
+        std::cout << std::setw(14) << std::right << total.lines;
+        if (timed) {
+            std::cout << std::setw(9) << std::right << std::fixed << std::setprecision(2)
+                      << total.time << " ms" << std::defaultfloat;
+        }
+        std::cout << std::endl;
+    }
+    std::cout << std::endl;
+    return true;
+}
+
 static bool printMaterialInfo(const ChunkContainer& container) {
     if (!printMaterial(container)) {
         return false;
@@ -798,6 +962,23 @@ static bool parseChunks(Config config, void* data, size_t size) {
         }
     }
 
+    if (config.reportSizes) {
+        if (config.timeParsing) {
+            matc::GLSLTools::init();
+        }
+        bool ok = printShaderSizes(config, filament::driver::Backend::OPENGL,
+                container, data, size) &&
+                printShaderSizes(config, filament::driver::Backend::VULKAN,
+                container, data, size);
+        if (config.timeParsing) {
+            matc::GLSLTools::terminate();
+        }
+        if (!ok) {
+            std::cerr << "The source material is invalid." << std::endl;
+        }
+        return ok;
+    }
+
     if (!printMaterialInfo(container)) {
         std::cerr << "The source material is invalid." << std::endl;
         return false;
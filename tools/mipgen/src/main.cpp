@@ -20,12 +20,17 @@
 #include <imageio/ImageDecoder.h>
 #include <imageio/ImageEncoder.h>
 
+#include <utils/JobSystem.h>
 #include <utils/Path.h>
 
 #include <getopt/getopt.h>
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
 
 using namespace image;
 using namespace std;
@@ -54,7 +59,7 @@ Options:
        print copyright and license information
    --gallery, -g
        generate HTML gallery for review purposes (mipmap.html)
-   --format=[exr|hdr|rgbm|psd|png|dds], -f [exr|hdr|rgbm|psd|png|dds]
+   --format=[exr|hdr|rgbm|psd|png|dds|ktx], -f [exr|hdr|rgbm|psd|png|dds|ktx]
        specify output file format, inferred from output pattern if omitted
    --kernel=[box|nearest|hermite|gaussian|normals|mitchell|lanczos|min], -k [filter]
        specify filter kernel type (defaults to LANCZOS)
@@ -65,6 +70,7 @@ Options:
            Photoshop: 16 (default), 32
            OpenEXR: RAW, RLE, ZIPS, ZIP, PIZ (default)
            DDS: 8, 16 (default), 32
+           KTX: etc2 (default), dxt1
 
 Example:
     MIPGEN -g --kernel=hermite grassland.png mip_%03d.png
@@ -166,6 +172,10 @@ static int handleArguments(int argc, char* argv[]) {
                     g_format = ImageEncoder::Format::DDS_LINEAR;
                     g_formatSpecified = true;
                 }
+                if (arg == "ktx") {
+                    g_format = ImageEncoder::Format::KTX_LINEAR;
+                    g_formatSpecified = true;
+                }
                 break;
             case 'c':
                 g_compression = arg;
@@ -198,36 +208,54 @@ int main(int argc, char* argv[]) {
         exit(1);
     }
 
-    puts("Generating miplevels...");
-    uint32_t count = getMipmapCount(sourceImage);
-    vector<LinearImage> miplevels(count);
-    generateMipmaps(sourceImage, g_filter, miplevels.data(), count);
+    const uint32_t mipCount = getMipmapCount(sourceImage);
 
-    puts("Writing image files to disk...");
+    // Format all the filenames first, so that a bad pattern is reported before doing any work.
+    vector<string> paths(mipCount);
     char path[256];
-    uint32_t mip = 1; // start at 1 because 0 is the original image
-    for (auto image: miplevels) {
-        int result = snprintf(path, sizeof(path), outputPattern.c_str(), mip++);
+    for (uint32_t mip = 1; mip <= mipCount; ++mip) { // start at 1 because 0 is the original image
+        int result = snprintf(path, sizeof(path), outputPattern.c_str(), mip);
         if (result < 0 || result >= sizeof(path)) {
             cerr << "Output pattern is too long." << endl;
             exit(1);
         }
-        ofstream outputStream(path, ios::binary | ios::trunc);
-        if (!outputStream) {
-            cerr << "The output file cannot be opened: " << path << endl;
-        } else {
+        paths[mip - 1] = path;
+    }
+
+    puts("Generating and writing miplevels...");
+
+    // Each miplevel is resampled from the source and written to disk in its own job, and it is
+    // released as soon as it's written, so that the miplevels are never all in memory at once.
+    JobSystem js;
+    js.adopt();
+    mutex errorLock;
+    auto generate = [&](uint32_t start, uint32_t count) {
+        for (uint32_t n = start; n < start + count; ++n) {
+            const uint32_t width = std::max(sourceImage.getWidth() >> (n + 1), 1u);
+            const uint32_t height = std::max(sourceImage.getHeight() >> (n + 1), 1u);
+            LinearImage image = resampleImage(sourceImage, width, height, g_filter, &js);
+            const char* path = paths[n].c_str();
+            ofstream outputStream(path, ios::binary | ios::trunc);
+            if (!outputStream) {
+                lock_guard<mutex> lock(errorLock);
+                cerr << "The output file cannot be opened: " << path << endl;
+                continue;
+            }
             ImageEncoder::encode(outputStream, g_format, image, g_compression, path);
             outputStream.close();
             if (!outputStream) {
+                lock_guard<mutex> lock(errorLock);
                 cerr << "An error occurred while writing the output file: " << path << endl;
             }
         }
-    }
+    };
+    js.runAndWait(jobs::parallel_for(js, nullptr, 0, mipCount,
+            std::cref(generate), jobs::CountSplitter<1, 8>()));
+    js.emancipate();
 
     if (g_createGallery) {
         puts("Generating mipmaps.html...");
         char tag[256];
-        mip = 1;
         const char* pattern = R"(<image src="%s" width="%dpx" height="%dpx">)";
         const uint32_t width = sourceImage.getWidth();
         const uint32_t height = sourceImage.getHeight();
@@ -239,9 +267,8 @@ int main(int argc, char* argv[]) {
             exit(1);
         }
         html << tag << std::endl;
-        for (auto image: miplevels) {
-            snprintf(path, sizeof(path), outputPattern.c_str(), mip++);
-            result = snprintf(tag, sizeof(tag), pattern, path, width, height);
+        for (const string& path : paths) {
+            result = snprintf(tag, sizeof(tag), pattern, path.c_str(), width, height);
             if (result < 0 || result >= sizeof(tag)) {
                 cerr << "Output pattern is too long." << endl;
                 exit(1);
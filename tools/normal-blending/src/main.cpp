@@ -20,9 +20,12 @@
 
 #include <math/vec3.h>
 
+#include <image/ImageOps.h>
+
 #include <imageio/ImageDecoder.h>
 #include <imageio/ImageEncoder.h>
 
+#include <utils/JobSystem.h>
 #include <utils/Path.h>
 
 #include <getopt/getopt.h>
@@ -34,7 +37,8 @@ static image::ImageEncoder::Format g_format = image::ImageEncoder::Format::PNG;
 static bool g_formatSpecified = false;
 static std::string g_compression = "";
 
-static void blend(const LinearImage& normal, const LinearImage& detail, LinearImage output);
+static void blend(const LinearImage& normal, const LinearImage& detail, LinearImage output,
+        utils::JobSystem& js);
 
 static void printUsage(const char* name) {
     std::string execName(utils::Path(name).getName());
@@ -191,7 +195,10 @@ int main(int argc, char* argv[]) {
     size_t height = normalImage.getHeight();
     LinearImage image(width, height, 3);
 
-    blend(normalImage, detailImage, image);
+    utils::JobSystem js;
+    js.adopt();
+
+    blend(normalImage, detailImage, image, js);
 
     if (!g_formatSpecified) {
         g_format = ImageEncoder::chooseFormat(outputMap);
@@ -212,22 +219,25 @@ int main(int argc, char* argv[]) {
     }
 }
 
-void blend(const LinearImage& normal, const LinearImage& detail, LinearImage output) {
+void blend(const LinearImage& normal, const LinearImage& detail, LinearImage output,
+        utils::JobSystem& js) {
     const size_t width = output.getWidth();
-    const size_t height = output.getHeight();
-
-    for (size_t y = 0; y < height; y++) {
-        auto normalRow = normal.get<float3>(0, y);
-        auto detailRow = detail.get<float3>(0, y);
-        auto outputRow = output.get<float3>(0, y);
 
-        for (size_t x = 0; x < width; x++, normalRow++, detailRow++, outputRow++) {
-            // Reoriented Normal Mapping
-            float3 t = *normalRow * float3( 2,  2, 2) + float3(-1, -1,  0);
-            float3 u = *detailRow * float3(-2, -2, 2) + float3( 1,  1, -1);
-            float3 r = normalize(t * dot(t, u) - u * t.z);
-
-            *outputRow = r * 0.5 + 0.5;
+    processRows(output.getHeight(),
+            [&normal, &detail, &output, width](uint32_t start, uint32_t count) {
+        for (size_t y = start; y < start + count; y++) {
+            float3 const* UTILS_RESTRICT normalRow = normal.get<float3>(0, y);
+            float3 const* UTILS_RESTRICT detailRow = detail.get<float3>(0, y);
+            float3* UTILS_RESTRICT outputRow = output.get<float3>(0, y);
+
+            for (size_t x = 0; x < width; x++) {
+                // Reoriented Normal Mapping
+                float3 t = normalRow[x] * float3( 2,  2, 2) + float3(-1, -1,  0);
+                float3 u = detailRow[x] * float3(-2, -2, 2) + float3( 1,  1, -1);
+                float3 r = normalize(t * dot(t, u) - u * t.z);
+
+                outputRow[x] = r * 0.5f + 0.5f;
+            }
         }
-    }
+    }, &js);
 }
@@ -177,25 +177,49 @@ inline bool isPOT(size_t x) {
     return !(x & (x - 1));
 }
 
-float solveVMF(const float2& pos, const size_t sampleCount, const float roughness,
-        const LinearImage& normal) {
-
-    float3 averageNormal(0.0f);
-    float2 topLeft(-float(sampleCount) / 2.0f + 0.5f);
-
-    for (size_t y = 0; y < sampleCount; y++) {
-        for (size_t x = 0; x < sampleCount; x++) {
-            float2 offset(topLeft + float2(x, y));
-            float2 samplePos(floor(pos + offset) + 0.5f);
-            float3 sampleNormal = *normal.get<float3>(size_t(samplePos.x), size_t(samplePos.y));
-            sampleNormal = sampleNormal * 2.0f - 1.0f;
-
-            averageNormal += normalize(sampleNormal);
+// Averages the normalized normals of the normal map per block of 2^i x 2^i texels, for each
+// level i. The level i + 1 is the average of the 2x2 blocks of the level i, so that the whole
+// pyramid costs about as much as its first level, instead of one pass over the normal map per
+// level.
+static std::vector<LinearImage> averageNormals(const LinearImage& normal, size_t mipLevels,
+        JobSystem& js) {
+    std::vector<LinearImage> levels;
+    levels.reserve(mipLevels);
+
+    const size_t width = normal.getWidth();
+    const size_t height = normal.getHeight();
+    LinearImage first(width, height, 3);
+    processRows(height, [&normal, &first, width](uint32_t start, uint32_t count) {
+        for (size_t y = start; y < start + count; y++) {
+            float3 const* UTILS_RESTRICT src = normal.get<float3>(0, y);
+            float3* UTILS_RESTRICT dst = first.get<float3>(0, y);
+            for (size_t x = 0; x < width; x++) {
+                dst[x] = normalize(src[x] * 2.0f - 1.0f);
+            }
         }
+    }, &js);
+    levels.push_back(std::move(first));
+
+    for (size_t i = 1; i < mipLevels; i++) {
+        const LinearImage& prev = levels.back();
+        const size_t w = width >> i;
+        LinearImage level(w, height >> i, 3);
+        processRows(height >> i, [&prev, &level, w](uint32_t start, uint32_t count) {
+            for (size_t y = start; y < start + count; y++) {
+                float3 const* UTILS_RESTRICT a = prev.get<float3>(0, y * 2);
+                float3 const* UTILS_RESTRICT b = prev.get<float3>(0, y * 2 + 1);
+                float3* UTILS_RESTRICT dst = level.get<float3>(0, y);
+                for (size_t x = 0; x < w; x++) {
+                    dst[x] = (a[x * 2] + a[x * 2 + 1] + b[x * 2] + b[x * 2 + 1]) * 0.25f;
+                }
+            }
+        }, &js);
+        levels.push_back(std::move(level));
     }
+    return levels;
+}
 
-    averageNormal /= (sampleCount * sampleCount);
-
+inline float solveVMF(const float3& averageNormal, const float roughness) {
     float r = length(averageNormal);
     float kappa = 10000.0f;
 
@@ -210,42 +234,28 @@ float solveVMF(const float2& pos, const size_t sampleCount, const float roughnes
     return std::sqrt(roughness * roughness + (2.0f / kappa));
 }
 
-void prefilter(const LinearImage& normal, const size_t mipLevel, LinearImage& output) {
+// 'normals' are the average normals of the level, see averageNormals(), and 'roughness' the
+// roughness map of the level, if any
+void prefilter(const LinearImage& normals, const LinearImage* roughness, LinearImage& output,
+        JobSystem& js) {
     const size_t width = output.getWidth();
-    const size_t height = output.getHeight();
-    const size_t sampleCount = 1u << mipLevel;
-
-    for (size_t y = 0; y < height; y++) {
-        auto outputRow = output.get<float3>(0, y);
-        for (size_t x = 0; x < width; x++, outputRow++) {
-            const float2 uv = (float2(x, y) + 0.5f) / float2(width, height);
-            const float2 pos = uv * normal.getWidth();
-            const float roughness = g_roughness;
-            *outputRow = float3(solveVMF(pos, sampleCount, roughness, normal));
-        }
-    }
-}
-
-template<bool FIRST_MIP>
-void prefilter(const LinearImage& normal, const LinearImage& roughness, const size_t mipLevel,
-        LinearImage& output) {
-    const size_t width = output.getWidth();
-    const size_t height = output.getHeight();
-    const size_t sampleCount = 1u << mipLevel;
-
-    for (size_t y = 0; y < height; y++) {
-        auto outputRow = output.get<float3>(0, y);
-        for (size_t x = 0; x < width; x++, outputRow++) {
-            auto data = roughness.get<float3>(x, y);
-            if (FIRST_MIP) {
-                *outputRow = *data;
+    processRows(output.getHeight(),
+            [&normals, roughness, &output, width](uint32_t start, uint32_t count) {
+        for (size_t y = start; y < start + count; y++) {
+            float3 const* UTILS_RESTRICT normal = normals.get<float3>(0, y);
+            float3* UTILS_RESTRICT outputRow = output.get<float3>(0, y);
+            if (roughness) {
+                float3 const* UTILS_RESTRICT data = roughness->get<float3>(0, y);
+                for (size_t x = 0; x < width; x++) {
+                    outputRow[x] = float3(solveVMF(normal[x], data[x].r));
+                }
             } else {
-                const float2 uv = (float2(x, y) + 0.5f) / float2(width, height);
-                const float2 pos = uv * normal.getWidth();
-                *outputRow = float3(solveVMF(pos, sampleCount, data->r, normal));
+                for (size_t x = 0; x < width; x++) {
+                    outputRow[x] = float3(solveVMF(normal[x], g_roughness));
+                }
             }
         }
-    }
+    }, &js);
 }
 
 int main(int argc, char* argv[]) {
@@ -344,6 +354,9 @@ int main(int argc, char* argv[]) {
             break;
     }
 
+    JobSystem js;
+    js.adopt();
+
     if (hasRoughnessMap) {
         mipImages.push_back(std::move(roughnessImage));
         LinearImage* prevMip = &mipImages.at(0);
@@ -354,29 +367,28 @@ int main(int argc, char* argv[]) {
 
             LinearImage image(w, h, 3);
 
-            for (size_t y = 0; y < h; y++) {
-                auto dst = image.get<float3>(0, y);
-                for (size_t x = 0; x < w; x++, dst++) {
-                    float3 aa = *prevMip->get<float3>(x * 2,     y * 2);
-                    float3 ba = *prevMip->get<float3>(x * 2 + 1, y * 2);
-                    float3 ab = *prevMip->get<float3>(x * 2,     y * 2 + 1);
-                    float3 bb = *prevMip->get<float3>(x * 2 + 1, y * 2 + 1);
-                    *dst = (aa + ba + ab + bb) / 4.0f;
+            processRows(h, [prevMip, &image, w](uint32_t start, uint32_t count) {
+                for (size_t y = start; y < start + count; y++) {
+                    float3 const* UTILS_RESTRICT a = prevMip->get<float3>(0, y * 2);
+                    float3 const* UTILS_RESTRICT b = prevMip->get<float3>(0, y * 2 + 1);
+                    float3* UTILS_RESTRICT dst = image.get<float3>(0, y);
+                    for (size_t x = 0; x < w; x++) {
+                        dst[x] = (a[x * 2] + a[x * 2 + 1] + b[x * 2] + b[x * 2 + 1]) / 4.0f;
+                    }
                 }
-            }
+            }, &js);
 
             mipImages.push_back(std::move(image));
             prevMip = &mipImages.at(i);
         }
     }
 
-    JobSystem js;
-    js.adopt();
+    const std::vector<LinearImage> normalMips = averageNormals(normalImage, mipLevels, js);
 
     JobSystem::Job* parent = js.createJob();
     for (size_t i = 0; i < mipLevels; i++) {
         JobSystem::Job* mip = jobs::createJob(js, parent,
-                [&normalImage, &mipImages, outputMap, i, width, height, exportGrayscale, hasRoughnessMap]() {
+                [&js, &normalMips, &mipImages, outputMap, i, width, height, exportGrayscale, hasRoughnessMap]() {
             const size_t w = width >> i;
             const size_t h = height >> i;
 
@@ -384,21 +396,14 @@ int main(int argc, char* argv[]) {
 
             if (i == 0) {
                 if (hasRoughnessMap) {
-                    if (mipImages.at(0).getWidth() == image.getWidth()) {
-                        const size_t size = image.getWidth() * image.getHeight() * 12;
-                        memcpy(image.getPixelRef(), mipImages.at(0).getPixelRef(), size);
-                    } else {
-                        prefilter<true>(normalImage, mipImages.at(0), 0, image);
-                    }
+                    const size_t size = image.getWidth() * image.getHeight() * 12;
+                    memcpy(image.getPixelRef(), mipImages.at(0).getPixelRef(), size);
                 } else {
                     std::fill_n(image.get<float3>(), w * h, float3(g_roughness));
                 }
             } else {
-                if (hasRoughnessMap) {
-                    prefilter<false>(normalImage, mipImages.at(i), i, image);
-                } else {
-                    prefilter(normalImage, i, image);
-                }
+                prefilter(normalMips.at(i), hasRoughnessMap ? &mipImages.at(i) : nullptr,
+                        image, js);
             }
 
             const std::string ext = outputMap.getExtension();
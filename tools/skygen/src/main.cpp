@@ -171,6 +171,8 @@ static void generateSky(LinearImage image) {
         case ImageEncoder::Format::PNG_LINEAR: break;
         case ImageEncoder::Format::HDR: break;
         case ImageEncoder::Format::RGBM: break;
+        case ImageEncoder::Format::KTX: break;
+        case ImageEncoder::Format::KTX_LINEAR: break;
         case ImageEncoder::Format::PSD:
             if (g_compression != "32") {
                 hdrScale = 1.0f / maxValue;